@@ -26,39 +26,37 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImage/MemoryBudget.h"
 
 // ----------------------------------------------------------
 
-static const int CACHE_SIZE = 32;
 static const int BLOCK_SIZE = (64 * 1024) - 8;
 
 // ----------------------------------------------------------
 
-#ifdef _WIN32
-#pragma pack(push, 1)
-#else
-#pragma pack(1)
-#endif // _WIN32
-
 struct Block {
-     unsigned nr;
-     unsigned next;
-     uint8_t *data;
+	unsigned nr;
+	unsigned next;
+	uint8_t *data;
 };
 
-#ifdef _WIN32
-#pragma pack(pop)
-#else
-#pragma pack()
-#endif // _WIN32
-
 // ----------------------------------------------------------
 
+/**
+Page cache of the multipage bitmaps. Files are chains of blocks, the blocks in memory
+are carved from slabs and kept in an LRU list, the least used ones are swapped out to
+a file when the memory budget set by FreeImage_SetMultiBitmapCacheSize is exceeded.
+Blocks are read and written at their offset in the file (pread / pwrite), without seeks.
+*/
 class CacheFile {
-	typedef std::list<Block *> PageCache;
-	typedef std::list<Block *>::iterator PageCacheIt;
-	typedef std::map<int, PageCacheIt> PageMap;
-	typedef std::map<int, PageCacheIt>::iterator PageMapIt;
+	/// entry of the page table, indexed by block number
+	struct Page {
+		Block block{};
+		int lru_prev{ -1 };			//! intrusive LRU list of the blocks in memory
+		int lru_next{ -1 };
+		bool used{};
+		bool dirty{};				//! not written to the file yet
+	};
 
 public :
 	CacheFile();
@@ -78,14 +76,25 @@ private :
 	FIBOOL unlockBlock(int nr);
 	FIBOOL deleteBlock(int nr);
 
+	uint8_t *allocateData();
+	void lruPushFront(int nr);
+	void lruRemove(int nr);
+
+	FIBOOL readBlock(unsigned nr, uint8_t *data);
+	FIBOOL writeBlock(unsigned nr, const uint8_t *data);
+
 private :
-	FILE *m_file;
+	intptr_t m_file;								//! descriptor or HANDLE of the cache file, -1 if none
 	std::string m_filename;
-	std::list<int> m_free_pages;
-	PageCache m_page_cache_mem;
-	PageCache m_page_cache_disk;
-	PageMap m_page_map;
-	int m_page_count;
+	std::vector<Page> m_pages;						//! page table, block 0 is never used
+	std::vector<unsigned> m_free_pages;
+	std::vector<std::unique_ptr<uint8_t[]>> m_slabs;
+	std::vector<uint8_t *> m_free_data;				//! unused blocks of the slabs
+	MemoryCharge m_slab_charge;						//! slabs, counted in FreeImage_GetMemoryUsage
+	int m_lru_head;
+	int m_lru_tail;
+	size_t m_mem_blocks;
+	size_t m_max_mem_blocks;
 	Block *m_current_block;
 	FIBOOL m_keep_in_memory;
 };
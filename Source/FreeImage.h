@@ -127,6 +127,9 @@
 
 FI_STRUCT (FIBITMAP) { void *data; };
 FI_STRUCT (FIMULTIBITMAP) { void *data; };
+FI_STRUCT (FIBITMAPPOOL) { void *data; };
+FI_STRUCT (FIIMAGECACHE) { void *data; };
+FI_STRUCT (FIJPEGTABLES) { void *data; };
 
 // Types used in the library (directly copied from Windows) -----------------
 
@@ -229,6 +232,15 @@ typedef struct tagFIRGBAF {
 	float alpha;
 } FIRGBAF;
 
+/** 64-bit RGBA Half Float (IEEE 754 binary16 bit patterns)
+*/
+typedef struct tagFIRGBAH {
+	uint16_t red;
+	uint16_t green;
+	uint16_t blue;
+	uint16_t alpha;
+} FIRGBAH;
+
 /** Data structure for COMPLEXF type (complex number)
 */
 typedef struct tagFICOMPLEXF {
@@ -421,6 +433,7 @@ FI_ENUM(FREE_IMAGE_FORMAT) {
 	FIF_JXR		= 36,
 	FIF_HEIF	= FIF_MAX_USER_ID + 1,
 	FIF_AVIF,
+	FIF_FIRAW,	//! FreeImage raw bitmap: aligned pixel rows, palette, ICC profile and metadata as they are in memory
 };
 
 /** Image type used in FreeImage.
@@ -442,6 +455,7 @@ FI_ENUM(FREE_IMAGE_TYPE) {
 	FIT_RGB32   = 13,	//! 96-bit RGB image			: 3 x 32-bit
 	FIT_RGBA32  = 14,	//! 128-bit RGBA image		: 4 x 32-bit
 	FIT_COMPLEXF = 15,	//! array of FICOMPLEXF		: 2 x 32-bit IEEE floating point
+	FIT_RGBAH	= 16,	//! 64-bit RGBA half float image	: 4 x 16-bit IEEE half floating point
 };
 
 /** Image color type used in FreeImage.
@@ -478,6 +492,15 @@ FI_ENUM(FREE_IMAGE_DITHER) {
 	FID_BAYER16x16	= 6		//! Bayer ordered dispersed dot dithering (order 4 dithering matrix)
 };
 
+/** Binarization methods.
+Constants used in FreeImage_Binarize.
+*/
+FI_ENUM(FREE_IMAGE_BINARIZE) {
+	FIB_OTSU		= 0,	//! Global threshold maximizing the between-class variance (Otsu)
+	FIB_MEAN		= 1,	//! Local mean threshold m * (1 - k) (Bradley & Roth)
+	FIB_SAUVOLA		= 2		//! Local threshold m * (1 + k * (s / 128 - 1)) from the mean and standard deviation (Sauvola)
+};
+
 /** Lossless JPEG transformations
 Constants used in FreeImage_JPEGTransform
 */
@@ -489,7 +512,8 @@ FI_ENUM(FREE_IMAGE_JPEG_OPERATION) {
 	FIJPEG_OP_TRANSVERSE	= 4,	//! transpose across UR-to-LL axis
 	FIJPEG_OP_ROTATE_90		= 5,	//! 90-degree clockwise rotation
 	FIJPEG_OP_ROTATE_180	= 6,	//! 180-degree rotation
-	FIJPEG_OP_ROTATE_270	= 7		//! 270-degree clockwise (or 90 ccw)
+	FIJPEG_OP_ROTATE_270	= 7,	//! 270-degree clockwise (or 90 ccw)
+	FIJPEG_OP_EXIF_ORIENT	= 8		//! transformation given by the Exif 'Orientation' tag, which is reset to top-left
 };
 
 /** Tone mapping operators.
@@ -503,6 +527,14 @@ FI_ENUM(FREE_IMAGE_TMO) {
 	FITMO_LINEAR     = 4	//! Global brightness scaling through YUV colorspace
 };
 
+/** Poisson equation solvers.
+Constants used in FreeImage_TmoFattal02Ex.
+*/
+FI_ENUM(FREE_IMAGE_POISSON_SOLVER) {
+	FIPS_MULTIGRID	= 0,	//! Full multigrid V-cycles on a square grid of (2^j + 1)x(2^j + 1) pixels
+	FIPS_DCT		= 1		//! Direct solution by discrete cosine transforms on a grid of the image size
+};
+
 /** Upsampling / downsampling filters. 
 Constants used in FreeImage_Rescale.
 */
@@ -531,6 +563,18 @@ FI_ENUM(FREE_IMAGE_COLOR_CHANNEL) {
 	FICC_PHASE	= 9		//! Complex images: use phase
 };
 
+/** Deflate strategies.
+Constants used in FreeImage_SetZLibOptions, same values as the ZLib strategies.
+*/
+FI_ENUM(FREE_IMAGE_ZSTRATEGY) {
+	FIZS_FORMAT_DEFAULT	= -1,	//! Strategy chosen by the plugin
+	FIZS_DEFAULT		= 0,	//! Z_DEFAULT_STRATEGY
+	FIZS_FILTERED		= 1,	//! Z_FILTERED, for filtered or predicted rows
+	FIZS_HUFFMAN_ONLY	= 2,	//! Z_HUFFMAN_ONLY, no string matching
+	FIZS_RLE			= 3,	//! Z_RLE, matches at distance one only
+	FIZS_FIXED			= 4		//! Z_FIXED, no dynamic Huffman codes
+};
+
 // Metadata support ---------------------------------------------------------
 
 /**
@@ -598,6 +642,8 @@ typedef unsigned (DLL_CALLCONV *FI_ReadProc) (void *buffer, unsigned size, unsig
 typedef unsigned (DLL_CALLCONV *FI_WriteProc) (void *buffer, unsigned size, unsigned count, fi_handle handle);
 typedef int (DLL_CALLCONV *FI_SeekProc) (fi_handle handle, long offset, int origin);
 typedef long (DLL_CALLCONV *FI_TellProc) (fi_handle handle);
+typedef int (DLL_CALLCONV *FI_SeekProc64) (fi_handle handle, int64_t offset, int origin);
+typedef int64_t (DLL_CALLCONV *FI_TellProc64) (fi_handle handle);
 
 #if (defined(_WIN32) || defined(__WIN32__))
 #pragma pack(push, 1)
@@ -612,6 +658,15 @@ FI_STRUCT(FreeImageIO) {
     FI_TellProc  tell_proc;     //! pointer to the function used to aquire the current position
 };
 
+/** Same as FreeImageIO with 64-bit offsets, for streams larger than 2 GB.
+*/
+FI_STRUCT(FreeImageIO64) {
+	FI_ReadProc    read_proc;     //! pointer to the function used to read data
+	FI_WriteProc   write_proc;    //! pointer to the function used to write data
+	FI_SeekProc64  seek_proc;     //! pointer to the function used to seek
+	FI_TellProc64  tell_proc;     //! pointer to the function used to aquire the current position
+};
+
 #if (defined(_WIN32) || defined(__WIN32__))
 #pragma pack(pop)
 #else
@@ -623,10 +678,217 @@ Handle to a memory I/O stream
 */
 FI_STRUCT (FIMEMORY) { void *data; };
 
+/**
+Handle to an asynchronous load or save
+*/
+FI_STRUCT (FIASYNCJOB) { void *data; };
+
+/**
+Handle to a read buffer over a FreeImageIO stream
+*/
+FI_STRUCT (FIBUFFEREDIO) { void *data; };
+
+/**
+Handle to an incremental reader of the rows of an image
+*/
+FI_STRUCT (FISCANLINEREADER) { void *data; };
+
+/**
+Handle to a recorded sequence of image operations
+*/
+FI_STRUCT (FIPIPELINE) { void *data; };
+
+/**
+Handle to a fixed palette and its nearest colour lookup, shared by the images it remaps
+*/
+FI_STRUCT (FIPALETTEMAPPER) { void *data; };
+
+/**
+Handle to a streaming resizer, filtering the rows of an image as they are pushed
+*/
+FI_STRUCT (FIRESIZER) { void *data; };
+
+/**
+Handle to a forward-only multipage writer, encoding each page as it is written
+*/
+FI_STRUCT (FIMULTIWRITER) { void *data; };
+
+/**
+Completion callbacks of asynchronous loads and saves, called from a library thread.
+The loaded bitmap is NULL on failure or cancellation, it is owned by the callback.
+*/
+typedef void (DLL_CALLCONV *FI_LoadCompletedProc) (FIBITMAP *dib, void *user_data);
+typedef void (DLL_CALLCONV *FI_SaveCompletedProc) (FIBOOL success, void *user_data);
+/**
+Callback of FreeImage_LoadBatch, called on the calling thread in files order.
+fif is the detected format, dib is NULL on failure and is owned by the callback.
+*/
+typedef void (DLL_CALLCONV *FI_BatchLoadedProc) (unsigned index, FREE_IMAGE_FORMAT fif, FIBITMAP *dib, void *user_data);
+/**
+Trace callbacks of FreeImage_SetTraceCallback, called on the thread running the operation.
+category is "load", "save", "convert", "rescale" or "metadata"; name is the plugin format of loads and saves
+and the function otherwise. Both strings are static. Operations may nest, e.g. metadata parsing inside a load.
+*/
+typedef void (DLL_CALLCONV *FI_TraceBeginProc) (const char *category, const char *name, void *user_data);
+typedef void (DLL_CALLCONV *FI_TraceEndProc) (const char *category, const char *name, uint64_t duration_ns, void *user_data);
+
+/**
+Second level storage of an image cache (see FreeImage_SetImageCacheStorage).
+Store is called with a bitmap evicted from memory, which is released after the call.
+Fetch returns a new bitmap stored under key, or NULL. Both are called from any thread, without lock held.
+*/
+typedef FIBOOL (DLL_CALLCONV *FI_ImageCacheStoreProc) (const char *key, FIBITMAP *dib, void *user_data);
+typedef FIBITMAP *(DLL_CALLCONV *FI_ImageCacheFetchProc) (const char *key, void *user_data);
+/**
+Callback of FreeImage_LoadWithRowCallback, called on the loading thread when count rows starting at first_row
+(counted from the top of the image) are decoded into dib. The bitmap is owned by the loader until the load returns.
+*/
+typedef void (DLL_CALLCONV *FI_RowsDecodedProc) (FIBITMAP *dib, unsigned first_row, unsigned count, void *user_data);
+/**
+Callback of FreeImage_LoadProgressive, called on the loading thread when the coarse pass pass (counted from 0) of pass_count
+is decoded into dib, pass_count is 0 when the number of passes isn't known in advance. The bitmap is owned by the loader until the load returns.
+*/
+typedef void (DLL_CALLCONV *FI_PassDecodedProc) (FIBITMAP *dib, unsigned pass, unsigned pass_count, void *user_data);
+/**
+Callback of a streaming resizer, called on the pushing thread with destination row row (counted from the top of the image).
+bits holds FreeImage_GetLine bytes of a row of the destination type, it is only valid during the call.
+*/
+typedef void (DLL_CALLCONV *FI_RowsResizedProc) (const uint8_t *bits, unsigned row, void *user_data);
+/**
+Overflow callback of FreeImage_OpenMemoryWritable, called on the writing thread when a write needs more than capacity bytes.
+It returns a buffer of at least required bytes (storing its size in capacity) holding the used bytes already written
+at its start, e.g. data itself grown in place or a larger buffer the used bytes were copied to, or NULL to fail the write.
+*/
+typedef uint8_t *(DLL_CALLCONV *FI_MemoryOverflowProc) (uint8_t *data, uint64_t used, uint64_t required, uint64_t *capacity, void *user_data);
+
 #endif // FREEIMAGE_IO
 
+// Memory allocation routines -----------------------------------------------
+
+/**
+Allocates a memory block of 'size' bytes aligned on 'alignment' bytes boundary
+*/
+typedef void *(DLL_CALLCONV *FI_MallocProc) (size_t size, size_t alignment, void *user_ctx);
+/**
+Releases a memory block allocated by FI_MallocProc
+*/
+typedef void (DLL_CALLCONV *FI_FreeProc) (void *ptr, void *user_ctx);
+
+// Image information --------------------------------------------------------
+
+/**
+Image properties filled by FreeImage_GetImageInfo, without allocating a bitmap.
+width, height, bpp and image_type are those of the bitmap loaded with default flags.
+*/
+FI_STRUCT (FIIMAGEINFO) {
+	uint32_t width;						//! width in pixels
+	uint32_t height;					//! height in pixels
+	uint32_t bpp;						//! bits per pixel
+	FREE_IMAGE_TYPE image_type;			//! image data type
+	FREE_IMAGE_COLOR_TYPE color_type;	//! colour model, palettes aren't scanned for greyscale by the plugins probes
+	uint32_t page_count;				//! number of pages, 1 for single image formats
+	FIBOOL has_alpha;					//! TRUE if the image has an alpha channel or a transparency table
+	uint32_t orientation;				//! Exif orientation (1 to 8), 0 if unknown
+	FIBOOL has_icc_profile;				//! TRUE if the image embeds an ICC profile
+	FIBOOL interlaced;					//! TRUE for progressive JPEG and interlaced PNG images
+	uint32_t tile_width;				//! tile size of tiled TIFF images, 0 for images in strips or lines
+	uint32_t tile_height;
+};
+
+/**
+Estimated cost of a load, filled by FreeImage_EstimateDecodeCost from the image header.
+Estimates are rough, meant to route images (e.g. huge or slow to decode ones to dedicated workers), not to predict times.
+*/
+FI_STRUCT (FIDECODECOST) {
+	FIIMAGEINFO info;					//! probed properties, see FreeImage_GetImageInfo
+	uint64_t pixels;					//! pixels decoded by the load, of one page for multipage formats
+	uint64_t bitmap_bytes;				//! pixel bytes of the bitmap returned by the load
+	uint64_t memory_bytes;				//! peak memory of the load: the bitmap and the working buffers of the codec
+	uint64_t cpu_cost;					//! relative CPU cost, about 1 per pixel byte for uncompressed formats
+};
+
+// Statistics ---------------------------------------------------------------
+
+/**
+Counters of the library filled by FreeImage_GetStats, summed over all threads since start or FreeImage_ResetStats.
+Times are wall times of the outermost operation of each kind on a thread, nested operations of the same kind aren't counted twice.
+Allocations are the pixel and working buffers of the bitmap allocator (see FreeImage_SetAllocator).
+*/
+FI_STRUCT (FISTATS) {
+	uint64_t load_count;				//! plugin loads, pages of multipage bitmaps included
+	uint64_t load_ns;					//! time spent in plugin loads (container parsing, decoding, conversion to the bitmap)
+	uint64_t bytes_read;				//! bytes consumed from the IO handles by the loads
+	uint64_t save_count;				//! plugin saves
+	uint64_t save_ns;					//! time spent in plugin saves
+	uint64_t bytes_written;				//! bytes written to the IO handles by the saves
+	uint64_t convert_count;				//! FreeImage_ConvertToXXX, FreeImage_ConvertInPlace and FreeImage_ConvertInto calls
+	uint64_t convert_ns;
+	uint64_t rescale_count;				//! resampling passes of FreeImage_Rescale and related functions
+	uint64_t rescale_ns;
+	uint64_t metadata_count;			//! Exif directories, Exif tags of TIFF files and IPTC profiles parsed
+	uint64_t metadata_ns;
+	uint64_t allocations;				//! blocks allocated
+	uint64_t allocated_bytes;			//! bytes allocated
+	uint64_t bitmap_bytes;				//! bytes currently allocated, not reset by FreeImage_ResetStats
+	uint64_t peak_bitmap_bytes;			//! highest bitmap_bytes
+};
+
+/**
+Memory held by the library, filled by FreeImage_GetMemoryUsage.
+Memory of the plugins' codecs and their temporary buffers isn't counted.
+*/
+FI_STRUCT (FIMEMORYUSAGE) {
+	uint64_t bitmap_bytes;				//! pixels, palettes and working buffers of the bitmap allocator
+	uint64_t metadata_bytes;			//! tags of the metadata models
+	uint64_t cache_bytes;				//! blocks of the multipage caches held in memory
+	uint64_t total_bytes;				//! sum of the above
+	uint64_t peak_bytes;				//! highest total_bytes since start
+	uint64_t limit_bytes;				//! process limit (see FreeImage_SetMemoryLimit), 0 if none
+	uint64_t thread_used_bytes;			//! bytes charged to the budget of the calling thread
+	uint64_t thread_budget_bytes;		//! budget of the calling thread (see FreeImage_SetThreadMemoryBudget), 0 if none
+};
+
+/**
+Counters of an image cache, filled by FreeImage_GetImageCacheStats
+*/
+FI_STRUCT (FIIMAGECACHESTATS) {
+	uint64_t hits;						//! lookups served from memory
+	uint64_t storage_hits;				//! lookups served by the second level storage
+	uint64_t misses;					//! lookups found nowhere
+	uint64_t evictions;					//! bitmaps evicted from memory
+	uint64_t entries;					//! bitmaps in memory
+	uint64_t bytes;						//! memory size of the bitmaps in memory (see FreeImage_GetMemorySize)
+};
+
+// Load options -------------------------------------------------------------
+
+/**
+Bits of FILOADOPTIONS::metadata_models
+*/
+#define FIMD_MASK(model)	(1u << (model))		//! metadata model (FIMD_xxx)
+#define FIMD_MASK_ICC		0x80000000u			//! ICC profile
+#define FIMD_MASK_ALL		0xFFFFFFFFu			//! all metadata models and the ICC profile
+
+/**
+Options of FreeImage_LoadEx
+*/
+FI_STRUCT (FILOADOPTIONS) {
+	int flags;							//! load flags, as in FreeImage_Load
+	uint32_t metadata_models;			//! FIMD_MASK bits of the metadata models to keep, FIMD_MASK_ICC to keep the ICC profile
+};
+
 // Plugin routines ----------------------------------------------------------
 
+/**
+Optional fast paths of a plugin, see FreeImage_FIFSupportsFeature
+*/
+FI_ENUM(FREE_IMAGE_FEATURE) {
+	FIFEATURE_IMAGE_INFO		= 0,	//! probes headers without loading a bitmap (FreeImage_GetImageInfo)
+	FIFEATURE_SCALED_LOAD		= 1,	//! decodes at a reduced size (FreeImage_LoadScaled)
+	FIFEATURE_REGION_LOAD		= 2,	//! decodes a rectangle only (FreeImage_LoadRegion)
+	FIFEATURE_SCANLINE_READER	= 3		//! decodes rows as they are requested (FreeImage_OpenScanlineReader)
+};
+
 #ifndef PLUGINS
 #define PLUGINS
 
@@ -646,6 +908,8 @@ typedef FIBOOL (DLL_CALLCONV *FI_SupportsExportBPPProc)(int bpp);
 typedef FIBOOL (DLL_CALLCONV *FI_SupportsExportTypeProc)(FREE_IMAGE_TYPE type);
 typedef FIBOOL (DLL_CALLCONV *FI_SupportsICCProfilesProc)(void);
 typedef FIBOOL (DLL_CALLCONV *FI_SupportsNoPixelsProc)(void);
+typedef FIBOOL (DLL_CALLCONV *FI_GetImageInfoProc)(FreeImageIO *io, fi_handle handle, FIIMAGEINFO *info, void *data);
+typedef unsigned (DLL_CALLCONV *FI_ConcurrencyProc)(void);
 
 FI_STRUCT (Plugin) {
 	FI_FormatProc format_proc FI_DEFAULT(NULL);
@@ -664,6 +928,8 @@ FI_STRUCT (Plugin) {
 	FI_SupportsExportTypeProc supports_export_type_proc FI_DEFAULT(NULL);
 	FI_SupportsICCProfilesProc supports_icc_profiles_proc FI_DEFAULT(NULL);
 	FI_SupportsNoPixelsProc supports_no_pixels_proc FI_DEFAULT(NULL);
+	FI_GetImageInfoProc get_image_info_proc FI_DEFAULT(NULL);
+	FI_ConcurrencyProc concurrency_proc FI_DEFAULT(NULL);
 };
 
 typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
@@ -688,6 +954,14 @@ typedef FIBOOL(DLL_CALLCONV* FI_SupportsExportTypeProc2)(void* ctx, FREE_IMAGE_T
 typedef FIBOOL(DLL_CALLCONV* FI_SupportsICCProfilesProc2)(void* ctx);
 typedef FIBOOL(DLL_CALLCONV* FI_SupportsNoPixelsProc2)(void* ctx);
 typedef void(DLL_CALLCONV* FI_ReleaseProc2)(void* ctx);
+typedef FIBOOL(DLL_CALLCONV* FI_GetImageInfoProc2)(void* ctx, FreeImageIO* io, fi_handle handle, FIIMAGEINFO* info, void* data);
+typedef uint32_t(DLL_CALLCONV* FI_ConcurrencyProc2)(void* ctx);
+typedef FIBOOL(DLL_CALLCONV* FI_SupportsFeatureProc2)(void* ctx, FREE_IMAGE_FEATURE feature);
+typedef FIBITMAP* (DLL_CALLCONV* FI_LoadScaledProc2)(void* ctx, FreeImageIO* io, fi_handle handle, uint32_t max_width, uint32_t max_height, uint32_t flags, void* data);
+typedef FIBITMAP* (DLL_CALLCONV* FI_LoadRegionProc2)(void* ctx, FreeImageIO* io, fi_handle handle, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t flags, void* data);
+typedef void* (DLL_CALLCONV* FI_OpenScanlineReaderProc2)(void* ctx, FreeImageIO* io, fi_handle handle, uint32_t flags, FIBITMAP** info);
+typedef uint32_t(DLL_CALLCONV* FI_ReadScanlinesProc2)(void* ctx, void* reader, uint8_t* bits, uint32_t count, uint32_t pitch);
+typedef void(DLL_CALLCONV* FI_CloseScanlineReaderProc2)(void* ctx, void* reader);
 
 FI_STRUCT(Plugin2) {
 	FI_FormatProc2 format_proc FI_DEFAULT(NULL);
@@ -707,6 +981,19 @@ FI_STRUCT(Plugin2) {
 	FI_SupportsICCProfilesProc2 supports_icc_profiles_proc FI_DEFAULT(NULL);
 	FI_SupportsNoPixelsProc2 supports_no_pixels_proc FI_DEFAULT(NULL);
 	FI_ReleaseProc2 release_proc FI_DEFAULT(NULL);
+	FI_GetImageInfoProc2 get_image_info_proc FI_DEFAULT(NULL);
+	FI_ConcurrencyProc2 concurrency_proc FI_DEFAULT(NULL);
+	// Optional fast paths, used when supports_feature_proc reports the feature (or, without it, when the procs are set).
+	// load_scaled_proc decodes at a reduced size, at least max_width x max_height when the image is larger, the result
+	// is then fitted. load_region_proc decodes the left, top, right, bottom rectangle (right and bottom excluded).
+	// open_scanline_reader_proc returns a reader of the rows from the top of the image and a bitmap describing them
+	// (owned by FreeImage afterwards), or NULL to fall back to a full load.
+	FI_SupportsFeatureProc2 supports_feature_proc FI_DEFAULT(NULL);
+	FI_LoadScaledProc2 load_scaled_proc FI_DEFAULT(NULL);
+	FI_LoadRegionProc2 load_region_proc FI_DEFAULT(NULL);
+	FI_OpenScanlineReaderProc2 open_scanline_reader_proc FI_DEFAULT(NULL);
+	FI_ReadScanlinesProc2 read_scanlines_proc FI_DEFAULT(NULL);
+	FI_CloseScanlineReaderProc2 close_scanline_reader_proc FI_DEFAULT(NULL);
 };
 
 // Plugin behaviour hould be invariant to FIF_SOMETHING enum value
@@ -730,14 +1017,33 @@ FI_STRUCT (FIDEPENDENCY) {
 };
 
 
+// Plugin concurrency capabilities ------------------------------------------
+// A plugin reporting FIF_CONCURRENT_LOAD (resp. FIF_CONCURRENT_SAVE) keeps no mutable
+// state outside of the handle it is given, so that several threads may load (resp. save)
+// distinct images of this format at the same time. Plugins without these bits must be
+// serialized by the caller. Registry lookups are always safe to call concurrently,
+// only FreeImage_Initialise / FreeImage_DeInitialise must not race with other calls.
+
+#define FIF_CONCURRENT_NONE	0x0
+#define FIF_CONCURRENT_LOAD	0x1	//! Load, Validate, GetImageInfo and page counting are reentrant
+#define FIF_CONCURRENT_SAVE	0x2	//! Save is reentrant
+
 // Load / Save flag constants -----------------------------------------------
 
 #define FIF_LOAD_NOPIXELS 0x8000	//! loading: load the image header only (not supported by all plugins, default to full loading)
+#define FIF_LOAD_NOMETADATA 0x4000	//! loading: skip metadata models (Exif, IPTC, XMP, comments, ...), the ICC profile and animation model are kept
 
 #define BMP_DEFAULT         0
 #define BMP_SAVE_RLE        1
 #define CUT_DEFAULT         0
 #define DDS_DEFAULT			0
+#define DDS_MIPMAP(n)		(((n) & 0x1F) << 24)	//! load the mipmap level n instead of the full size texture (n = 0), clamped to the last level
+#define DDS_SAVE_BC1		0x0001	//! save with BC1 (DXT1) compression, alpha < 128 is transparent
+#define DDS_SAVE_BC3		0x0002	//! save with BC3 (DXT5) compression
+#define DDS_SAVE_BC7		0x0004	//! save with BC7 compression (DX10 header)
+#define DDS_SAVE_MIPMAPS	0x0008	//! save the full mipmap chain down to 1x1
+#define DDS_SAVE_FAST		0x0010	//! faster block compression, lower quality
+#define DDS_SAVE_BEST		0x0020	//! slower block compression, higher quality
 #define EXR_DEFAULT			0		//! save data as half with piz-based wavelet compression
 #define EXR_FLOAT			0x0001	//! save data as float instead of as half (not recommended)
 #define EXR_NONE			0x0002	//! save with no compression
@@ -746,13 +1052,21 @@ FI_STRUCT (FIDEPENDENCY) {
 #define EXR_PXR24			0x0010	//! save with lossy 24-bit float compression
 #define EXR_B44				0x0020	//! save with lossy 44% float compression - goes to 22% when combined with EXR_LC
 #define EXR_LC				0x0040	//! save images with one luminance and two chroma channels, rather than as RGB (lossy compression)
+#define EXR_ZIPS			0x0080	//! save with zlib compression, one scan line at a time
+#define EXR_DWAA			0x0100	//! save with lossy DCT based compression, in blocks of 32 scan lines
+#define EXR_DWAB			0x0200	//! save with lossy DCT based compression, in blocks of 256 scan lines (faster to decode)
+#define EXR_HALF			0x0400	//! load HALF channels as a FIT_RGBAH image instead of expanding them to float
+#define EXR_LEVEL(n)		(((n) & 0x1F) << 24)	//! load the mipmap level n (ripmap level n, n) of tiled files instead of the full size image (n = 0), clamped to the last level
 #define FAXG3_DEFAULT		0
 #define GIF_DEFAULT			0
 #define GIF_LOAD256			1		//! load the image as a 256 color image with ununsed palette entries, if it's 16 or 2 color
 #define GIF_PLAYBACK		2		//! 'Play' the GIF to generate each frame (as 32bpp) instead of returning raw frame data when loading
+#define GIF_GLOBALPALETTE	4		//! when saving, write the frames whose colors all appear in the global palette (the first page's) without a local palette
 #define HDR_DEFAULT			0
 #define ICO_DEFAULT         0
 #define ICO_MAKEALPHA		1		//! convert to 32bpp and create an alpha channel from the AND-mask when loading
+#define ICO_LOAD_BEST_FIT	2		//! load the icon best fitting the ICO_SIZE size (the largest one without a size) instead of the page, only this icon is decoded
+#define ICO_SIZE(n)			(((n) & 0x7FFF) << 16)	//! size requested with ICO_LOAD_BEST_FIT, the smallest icon at least that large is loaded
 #define IFF_DEFAULT         0
 #define J2K_DEFAULT			0		//! save with a 16:1 rate
 #define JP2_DEFAULT			0		//! save with a 16:1 rate
@@ -774,6 +1088,7 @@ FI_STRUCT (FIDEPENDENCY) {
 #define JPEG_SUBSAMPLING_444 0x10000	//! save with no chroma subsampling (4:4:4)
 #define JPEG_OPTIMIZE		0x20000		//! on saving, compute optimal Huffman coding tables (can reduce a few percent of file size)
 #define JPEG_BASELINE		0x40000		//! save basic JPEG, without metadata or any markers
+#define JPEG_PARALLEL		0x80000		//! on saving, encode bands of MCU rows concurrently, separated by restart markers (ignored with JPEG_PROGRESSIVE)
 #define KOALA_DEFAULT       0
 #define LBM_DEFAULT         0
 #define MNG_DEFAULT         0
@@ -783,14 +1098,17 @@ FI_STRUCT (FIDEPENDENCY) {
 #define PCD_BASEDIV16       3		//! load the bitmap sized 192 x 128
 #define PCX_DEFAULT         0
 #define PFM_DEFAULT         0
+#define PFM_INPLACE			0x0001	//! FreeImage_LoadMapped: pixels in machine byte order are used in place, stored upside down (FIO_FLIP_VERTICAL orientation)
 #define PICT_DEFAULT        0
 #define PNG_DEFAULT         0
 #define PNG_IGNOREGAMMA		1		//! loading: avoid gamma correction
+#define PNG_FAST_TRUSTED			0x0800	//! loading: trusted input, skip the CRC and Adler-32 checks and the sRGB profile check, ignore unknown chunks
 #define PNG_Z_BEST_SPEED			0x0001	//! save using ZLib level 1 compression flag (default value is 6)
 #define PNG_Z_DEFAULT_COMPRESSION	0x0006	//! save using ZLib level 6 compression flag (default recommended value)
 #define PNG_Z_BEST_COMPRESSION		0x0009	//! save using ZLib level 9 compression flag (default value is 6)
 #define PNG_Z_NO_COMPRESSION		0x0100	//! save without ZLib compression
 #define PNG_INTERLACED				0x0200	//! save using Adam7 interlacing (use | to combine with other save flags)
+#define PNG_PARALLEL				0x0400	//! save filtering and compressing bands of rows on the library thread pool (not with PNG_INTERLACED)
 #define PNM_DEFAULT         0
 #define PNM_SAVE_RAW        0       //! if set the writer saves in RAW format (i.e. P4, P5 or P6)
 #define PNM_SAVE_ASCII      1       //! if set the writer saves in ASCII format (i.e. P1, P2 or P3)
@@ -806,6 +1124,7 @@ FI_STRUCT (FIDEPENDENCY) {
 #define RAW_DISPLAY			2		//! load the file as RGB 24-bit
 #define RAW_HALFSIZE		4		//! output a half-size color image
 #define RAW_UNPROCESSED		8		//! output a FIT_UINT16 raw Bayer image
+#define RAW_FASTDEMOSAIC	16		//! demosaic with a bilinear interpolation instead of AHD (faster, lower quality)
 #define SGI_DEFAULT			0
 #define TARGA_DEFAULT       0
 #define TARGA_LOAD_RGB888   1       //! if set the loader converts RGB555 and ARGB8888 -> RGB888.
@@ -821,14 +1140,29 @@ FI_STRUCT (FIDEPENDENCY) {
 #define TIFF_LZW			0x4000	//! save using LZW compression
 #define TIFF_JPEG			0x8000	//! save using JPEG compression
 #define TIFF_LOGLUV			0x10000	//! save using LogLuv compression
+#define TIFF_TILED			0x20000	//! save as 256x256 tiles instead of strips (use | to combine with compression flags)
+#define TIFF_PYRAMID		0x40000	//! save as tiles followed by reduced resolution SubIFDs, each half the size of the previous one, down to one tile
+#define TIFF_BIGTIFF		0x80000	//! save as BigTIFF (64-bit offsets), needed by multipage files over 4 GB (chosen automatically when the first image is larger)
+#define TIFF_LEVEL(n)		(((n) & 0x3F) << 24)	//! load the reduced resolution SubIFD n of a pyramid instead of the full resolution image (n = 0)
 #define WBMP_DEFAULT        0
 #define XBM_DEFAULT			0
 #define XPM_DEFAULT			0
 #define WEBP_DEFAULT		0		//! save with good quality (75:1)
 #define WEBP_LOSSLESS		0x100	//! save in lossless mode
+#define WEBP_METHOD(n)		((((n) % 7) + 1) << 9)	//! save with the quality/speed trade-off n (0=fast, 6=slower-better), 6 when not specified
+#define WEBP_MULTITHREAD	0x1000	//! encode using a second thread (use | to combine with other save flags)
+#define WEBP_PARTITIONS(n)	(((n) & 3) << 13)	//! save lossy data in 2^n token partitions (n = 0..3), allowing the decoder to use more threads
+#define WEBP_FAST			0x8000	//! fastest encoding (method 0, multithreaded), meant for thumbnails and other latency-sensitive outputs
 #define JXR_DEFAULT			0		//! save with quality 80 and no chroma subsampling (4:4:4)
 #define JXR_LOSSLESS		0x0064	//! save lossless
 #define JXR_PROGRESSIVE		0x2000	//! save as a progressive-JXR (use | to combine with other save flags)
+#define HEIF_DEFAULT		0		//! save with good quality (75:1)
+#define HEIF_PREVIEW		0x0001	//! load the embedded thumbnail instead of the primary image when there is one (HEIF and AVIF)
+#define HEIF_LOSSLESS		0x0100	//! save in lossless mode (4:4:4 unless another chroma flag is given)
+#define HEIF_SPEED(n)		((((n) % 10) + 1) << 9)	//! save with the encoder speed n (0=slower-better, 9=fastest), the encoder default when not specified
+#define HEIF_CHROMA_420		0x2000	//! save with 4:2:0 chroma subsampling
+#define HEIF_CHROMA_422		0x4000	//! save with 4:2:2 chroma subsampling
+#define HEIF_CHROMA_444		0x6000	//! save without chroma subsampling
 
 // Background filling options ---------------------------------------------------------
 // Constants used in FreeImage_FillBackground and FreeImage_EnlargeCanvas
@@ -838,6 +1172,7 @@ FI_STRUCT (FIDEPENDENCY) {
 #define FI_COLOR_FIND_EQUAL_COLOR		0x02	//! For palettized images: lookup equal RGB color from palette
 #define FI_COLOR_ALPHA_IS_INDEX			0x04	//! The color's rgbReserved member (alpha) contains the palette index to be used
 #define FI_COLOR_PALETTE_SEARCH_MASK	(FI_COLOR_FIND_EQUAL_COLOR | FI_COLOR_ALPHA_IS_INDEX)	// No color lookup is performed
+#define FI_CANVAS_VIEW					0x08	//! FreeImage_EnlargeCanvas: a crop that enlarges no side returns a view sharing the pixels of src (see FreeImage_Copy)
 
 // RescaleEx options ---------------------------------------------------------
 // Constants used in FreeImage_RescaleEx
@@ -845,16 +1180,125 @@ FI_STRUCT (FIDEPENDENCY) {
 #define FI_RESCALE_DEFAULT			0x00    //! default options; none of the following other options apply
 #define FI_RESCALE_TRUE_COLOR		0x01	//! for non-transparent greyscale images, convert to 24-bit if src bitdepth <= 8 (default is a 8-bit greyscale image). 
 #define FI_RESCALE_OMIT_METADATA	0x02	//! do not copy metadata to the rescaled image
+#define FI_RESCALE_PREMULTIPLY_ALPHA	0x04	//! filter colors premultiplied with alpha (32-bit, FIT_RGBA16 and FIT_RGBAF images), avoids dark halos around transparent areas; 32-bit images are premultiplied within the filter passes
+#define FI_RESCALE_COMPUTE_DEVICE	0x08	//! rescale float images on the GPU of an available compute backend, even if FICB_CPU is selected (see FreeImage_SetComputeBackend)
+#define FI_RESCALE_SHARPEN		0x10	//! unsharp mask the rescaled image as it is written, by default amount 50% and Gaussian sigma 0.8 pixel
+#define FI_RESCALE_SHARPEN_AMOUNT(percent)	(FI_RESCALE_SHARPEN | (((unsigned)(percent) & 0xFF) << 16))	//! FI_RESCALE_SHARPEN with an amount of 1 to 255%
+#define FI_RESCALE_SHARPEN_RADIUS(tenths)	(FI_RESCALE_SHARPEN | (((unsigned)(tenths) & 0xFF) << 24))	//! FI_RESCALE_SHARPEN with a Gaussian sigma in tenths of a pixel, from 0.1 to 8.0 pixels
+#define FI_RESCALE_LINEAR_LIGHT	0x20	//! filter 8, 24 and 32-bit sRGB samples in linear light (in float), decoded and re-encoded within the filter passes; alpha stays linear
+
+// Copy options ---------------------------------------------------------
+// Constants used in FreeImage_Copy
+
+#define FI_COPY_DEFAULT		0x00	//! pixels are copied into a new bitmap
+#define FI_COPY_VIEW		0x01	//! return a view sharing the pixels of the source when the rectangle allows it (see FreeImage_CreateView)
+
+// CPU features ---------------------------------------------------------
+// Constants used in FreeImage_GetCPUFeatures and FreeImage_SetCPUFeatures
+
+#define FI_CPU_NONE		0x00		//! no SIMD instructions, scalar code only
+#define FI_CPU_SSE2		0x01		//! x86 SSE2
+#define FI_CPU_SSSE3	0x02		//! x86 SSSE3
+#define FI_CPU_SSE41	0x04		//! x86 SSE4.1
+#define FI_CPU_AVX2		0x08		//! x86 AVX2
+#define FI_CPU_AVX512	0x10		//! x86 AVX-512 F, BW and VL
+#define FI_CPU_F16C		0x20		//! x86 F16C (half float conversions)
+#define FI_CPU_NEON		0x100		//! ARM NEON (Advanced SIMD)
+#define FI_CPU_ALL		0xFFFFFFFF	//! all features supported by the CPU
+
+// Memory streams growth ------------------------------------------------
+// Constants used in FreeImage_OpenMemoryEx
+
+#define FIMEMORY_GROW_DOUBLE	0	//! the buffer size is doubled, default of FreeImage_OpenMemory
+#define FIMEMORY_GROW_LINEAR	1	//! the buffer grows by steps of the reserved size (at least 64 KB)
+#define FIMEMORY_GROW_CHUNKED	2	//! data is stored in chunks of the reserved size (at least 64 KB) and never moved, FreeImage_AcquireMemory makes it contiguous
+
+// File access hints --------------------------------------------------------
+// Constants used in FreeImage_SetFileHints
+
+#define FIFILE_HINT_SEQUENTIAL	0x01	//! files of formats decoded front to back are read ahead more aggressively
+#define FIFILE_HINT_WILLNEED	0x02	//! whole files are prefetched into the page cache when opened
+#define FIFILE_HINT_DONTNEED	0x04	//! files are dropped from the page cache once loaded, so that bulk loads don't evict other data
 
 // Color conversion parameters
 FI_ENUM(FREE_IMAGE_CVT_COLOR_PARAM) {
 	FICPARAM_YUV_STANDARD_DEFAULT = 0,
-	FICPARAM_YUV_STANDARD_JPEG = FICPARAM_YUV_STANDARD_DEFAULT
+	FICPARAM_YUV_STANDARD_JPEG = FICPARAM_YUV_STANDARD_DEFAULT,	//! JPEG (T-REC-T.871), BT.601 coefficients, full range
+	FICPARAM_YUV_STANDARD_BT601 = 1,	//! ITU-R BT.601 (SD video), limited range
+	FICPARAM_YUV_STANDARD_BT709 = 2,	//! ITU-R BT.709 (HD video), limited range
+	FICPARAM_YUV_STANDARD_BT2020 = 3	//! ITU-R BT.2020 (UHD video, non constant luminance), limited range
+};
+
+// Planar YUV layouts, see FreeImage_ConvertToYUVPlanes
+FI_ENUM(FREE_IMAGE_YUV_PLANES) {
+	FIYUV_I420 = 0,	//! 4:2:0, Y plane, U plane and V plane of half width and height
+	FIYUV_NV12 = 1	//! 4:2:0, Y plane and a plane of interleaved U, V samples of half width and height
+};
+
+// Tensor layouts, see FreeImage_ExportTensor
+FI_ENUM(FREE_IMAGE_TENSOR_LAYOUT) {
+	FITL_CHW = 0,	//! planar, a plane of height rows of width elements per channel
+	FITL_HWC = 1	//! interleaved, height rows of width pixels of channels elements (NHWC for a batch of one image)
+};
+
+// Tensor element types, see FreeImage_ExportTensor
+FI_ENUM(FREE_IMAGE_TENSOR_TYPE) {
+	FITT_UINT8 = 0,	//! 8-bit unsigned, 255 * value rounded and clamped to [0, 255]
+	FITT_HALF = 1,	//! IEEE 754 half float
+	FITT_FLOAT = 2	//! 32-bit float
+};
+
+// Transfer functions, see FreeImage_ConvertTransfer
+FI_ENUM(FREE_IMAGE_TRANSFER) {
+	FITF_SRGB_TO_LINEAR = 0,	//! decode sRGB (IEC 61966-2-1) samples to linear light
+	FITF_LINEAR_TO_SRGB = 1,	//! encode linear light to sRGB
+	FITF_PQ_TO_LINEAR = 2,	//! SMPTE ST 2084 (PQ) EOTF, 1 is 10000 cd/m2
+	FITF_LINEAR_TO_PQ = 3,	//! inverse PQ EOTF
+	FITF_HLG_TO_LINEAR = 4,	//! inverse ARIB STD-B67 (HLG) OETF, scene linear light in [0, 1]
+	FITF_LINEAR_TO_HLG = 5	//! HLG OETF
+};
+
+// Image comparison metrics, see FreeImage_ComputeMetric
+FI_ENUM(FREE_IMAGE_METRIC) {
+	FIMETRIC_PSNR = 0,		//! peak signal to noise ratio in dB, +infinity for identical images
+	FIMETRIC_SSIM = 1,		//! structural similarity (Wang et al. 2004), 1 for identical images
+	FIMETRIC_MSSSIM = 2		//! multi-scale structural similarity over up to 5 scales
+};
+
+/**
+Targets of FreeImage_SaveToMemoryTarget. With a size target only, the highest quality whose encoding fits is chosen.
+With a quality target, the lowest quality whose decoded image reaches min_metric is chosen, its encoding must also fit
+when both targets are given.
+*/
+FI_STRUCT (FIENCODETARGET) {
+	uint64_t max_bytes;			//! largest encoded size in bytes, 0 for no size target
+	FREE_IMAGE_METRIC metric;	//! metric comparing the decoded image to the saved one (see FreeImage_ComputeMetric)
+	double min_metric;			//! smallest metric of the decoded image, 0 for no quality target
+};
+
+/**
+Tensor written by FreeImage_ExportTensor. Samples are read in [0, 1]: 8 and 16-bit samples are divided by their maximum,
+float samples are taken as is. Tensor channel c holds (sample[order[c]] - mean[c]) * scale[c].
+*/
+FI_STRUCT (FITENSORDESC) {
+	uint32_t width;						//! tensor width, 0 for the image width
+	uint32_t height;					//! tensor height, 0 for the image height
+	FREE_IMAGE_FILTER filter;			//! filter rescaling the image to width x height
+	FREE_IMAGE_TENSOR_LAYOUT layout;	//! planar or interleaved channels
+	FREE_IMAGE_TENSOR_TYPE type;		//! element type
+	uint32_t channels;					//! number of tensor channels, 1 to 4
+	uint32_t order[4];					//! image channel of each tensor channel: 0 red, 1 green, 2 blue, 3 alpha, e.g. { 2, 1, 0 } for BGR
+	float mean[4];						//! subtracted from the samples of each tensor channel
+	float scale[4];						//! multiplies the centered samples of each tensor channel, 1 / std for a standard normalization
 };
 
 // Alpha blending operation type
 FI_ENUM(FREE_IMAGE_ALPHA_OPERATION) {
-	FIAO_SrcAlpha		///< Use only src alpha, ignore dst alpha
+	FIAO_SrcAlpha	= 0,	///< Use only src alpha, ignore dst alpha
+	FIAO_SrcOver	= 1,	///< Premultiplied src over dst: src + dst * (1 - src alpha)
+	FIAO_Multiply	= 2,	///< Premultiplied multiply: src * dst + src * (1 - dst alpha) + dst * (1 - src alpha)
+	FIAO_Screen		= 3,	///< Premultiplied screen: src + dst - src * dst
+	FIAO_Add		= 4		///< Premultiplied addition: src + dst, clamped for 8-bit channels
 };
 
 
@@ -868,6 +1312,95 @@ extern "C" {
 DLL_API void DLL_CALLCONV FreeImage_Initialise(FIBOOL load_local_plugins_only FI_DEFAULT(FALSE));
 DLL_API void DLL_CALLCONV FreeImage_DeInitialise(void);
 
+// Multithreading routines --------------------------------------------------
+
+/**
+ * Sets number of threads used by the library for parallel processing (including a calling thread).
+ * 0 selects the number of hardware threads, 1 disables multithreading.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetThreadCount(uint32_t count);
+
+/**
+ * Returns number of threads used by the library for parallel processing
+ */
+DLL_API uint32_t DLL_CALLCONV FreeImage_GetThreadCount(void);
+
+// Profiling routines -------------------------------------------------------
+
+/**
+ * Sets callbacks called when loads, saves, conversions, rescales and metadata parsing begin and end, e.g. to emit
+ * tracing spans. Either callback may be NULL, both NULL remove the callbacks. Callbacks must be thread safe and fast.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetTraceCallback(FI_TraceBeginProc begin, FI_TraceEndProc end, void *user_data FI_DEFAULT(NULL));
+
+/**
+ * Fills stats with the counters of the library, which are always collected.
+ */
+DLL_API void DLL_CALLCONV FreeImage_GetStats(FISTATS *stats);
+DLL_API void DLL_CALLCONV FreeImage_ResetStats(void);
+
+// Memory routines ----------------------------------------------------------
+
+/**
+ * Fills usage with the memory currently held by the library, which is always tracked.
+ */
+DLL_API void DLL_CALLCONV FreeImage_GetMemoryUsage(FIMEMORYUSAGE *usage);
+
+/**
+ * Sets the most memory the library may hold over all threads, 0 removes the limit.
+ * Allocations of bitmaps, metadata and cache blocks beyond the limit fail before memory is requested from the system,
+ * so that e.g. a file declaring huge dimensions fails to load instead of exhausting the memory.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetMemoryLimit(uint64_t bytes);
+
+/**
+ * Gives the calling thread a new budget: memory allocated by the thread from now on, while it is held, may not
+ * exceed bytes. Memory is credited back to the budget when released, whatever thread releases it.
+ * 0 removes the budget. Setting a budget before a call and removing it after makes a per-call budget.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SetThreadMemoryBudget(uint64_t bytes);
+
+// CPU features routines ----------------------------------------------------
+
+/**
+ * Returns FI_CPU_* instruction sets used by SIMD kernels: features supported by the CPU
+ * and allowed by FreeImage_SetCPUFeatures
+ */
+DLL_API uint32_t DLL_CALLCONV FreeImage_GetCPUFeatures(void);
+
+/**
+ * Restricts SIMD kernels to the FI_CPU_* instruction sets in mask, unsupported features are ignored.
+ * FI_CPU_NONE forces the scalar code (e.g. for debugging), FI_CPU_ALL restores the default.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetCPUFeatures(uint32_t mask);
+
+// Compute backend routines -------------------------------------------------
+
+/** Compute backends.
+Constants used in FreeImage_SetComputeBackend.
+*/
+FI_ENUM(FREE_IMAGE_COMPUTE_BACKEND) {
+	FICB_CPU	= 0,	//! CPU code (default)
+	FICB_OPENCL	= 1		//! OpenCL GPU device (library built with FREEIMAGE_WITH_OPENCL)
+};
+
+/**
+ * Returns TRUE if backend is compiled in and finds a usable device
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_IsComputeBackendAvailable(FREE_IMAGE_COMPUTE_BACKEND backend);
+
+/**
+ * Selects the backend of the float rescale filters and of the Drago03 and Reinhard05 tone mapping operators.
+ * Operations the device cannot run fall back to the CPU code. Returns FALSE and keeps the current backend
+ * if backend is not available.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SetComputeBackend(FREE_IMAGE_COMPUTE_BACKEND backend);
+
+/**
+ * Returns the backend selected by FreeImage_SetComputeBackend
+ */
+DLL_API FREE_IMAGE_COMPUTE_BACKEND DLL_CALLCONV FreeImage_GetComputeBackend(void);
+
 // Version routines ---------------------------------------------------------
 
 DLL_API const char *DLL_CALLCONV FreeImage_GetVersion(void);
@@ -887,31 +1420,258 @@ DLL_API const FIDEPENDENCY* DLL_CALLCONV FreeImage_GetDependencyInfo(uint32_t in
 
 // Message output functions -------------------------------------------------
 
+/**
+Message codes, see FreeImage_SetThreadOutputMessage and FreeImage_GetLastMessageCode
+*/
+FI_ENUM(FREE_IMAGE_MESSAGE) {
+	FIMSG_NONE						= 0,	//! no message
+	FIMSG_GENERIC					= 1,	//! message without a more specific code
+	FIMSG_WARNING					= 2,	//! warning, the operation went on
+	FIMSG_MEMORY					= 3,	//! memory allocation failed
+	FIMSG_DIB_MEMORY				= 4,	//! bitmap allocation failed (invalid size or lack of memory)
+	FIMSG_PARSING					= 5,	//! malformed data
+	FIMSG_MAGIC_NUMBER				= 6,	//! invalid signature
+	FIMSG_UNSUPPORTED_FORMAT		= 7,	//! unsupported variant of the format
+	FIMSG_UNSUPPORTED_COMPRESSION	= 8		//! unsupported compression type
+};
+
 typedef void (*FreeImage_OutputMessageFunction)(FREE_IMAGE_FORMAT fif, const char *msg);
 typedef void (DLL_CALLCONV *FreeImage_OutputMessageFunctionStdCall)(FREE_IMAGE_FORMAT fif, const char *msg); 
+typedef void (DLL_CALLCONV *FreeImage_ThreadOutputMessageFunction)(FREE_IMAGE_FORMAT fif, FREE_IMAGE_MESSAGE code, const char *msg, void *user_data);
 
 DLL_API void DLL_CALLCONV FreeImage_SetOutputMessageStdCall(FreeImage_OutputMessageFunctionStdCall omf); 
 DLL_API void DLL_CALLCONV FreeImage_SetOutputMessage(FreeImage_OutputMessageFunction omf);
+/**
+ * Sets the message handler of the calling thread, NULL to remove it. The messages of the thread go to this handler
+ * instead of the process-wide ones, so that busy threads don't share one handler. Messages of work done on the
+ * thread pool are output on the pool threads, which use the process-wide handlers.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetThreadOutputMessage(FreeImage_ThreadOutputMessageFunction omf, void *user_data FI_DEFAULT(NULL));
 DLL_API void DLL_CALLCONV FreeImage_OutputMessageProc(int fif, const char *fmt, ...);
+/**
+ * Outputs a message like FreeImage_OutputMessageProc with its code, see FreeImage_GetLastMessageCode.
+ */
+DLL_API void DLL_CALLCONV FreeImage_OutputMessageProcEx(int fif, FREE_IMAGE_MESSAGE code, const char *fmt, ...);
+/**
+ * Returns the last message output by the library on the calling thread, "" if none, and its format in fif when not NULL.
+ * Messages are recorded whether an output handler is set or not. The string belongs to the thread and is overwritten
+ * by its next message; messages of work done on the thread pool are recorded by the pool threads.
+ */
+DLL_API const char *DLL_CALLCONV FreeImage_GetLastMessage(FREE_IMAGE_FORMAT *fif FI_DEFAULT(NULL));
+/**
+ * Returns the code of the last message output on the calling thread, FIMSG_NONE if none.
+ * Messages output by FreeImage_OutputMessageProc have FIMSG_WARNING if they start with "Warning", FIMSG_GENERIC otherwise.
+ */
+DLL_API FREE_IMAGE_MESSAGE DLL_CALLCONV FreeImage_GetLastMessageCode(void);
+DLL_API void DLL_CALLCONV FreeImage_ClearLastMessage(void);
 
 // Allocate / Clone / Unload routines ---------------------------------------
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Allocate(int width, int height, int bpp, unsigned red_mask FI_DEFAULT(0), unsigned green_mask FI_DEFAULT(0), unsigned blue_mask FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_AllocateT(FREE_IMAGE_TYPE type, int width, int height, int bpp FI_DEFAULT(8), unsigned red_mask FI_DEFAULT(0), unsigned green_mask FI_DEFAULT(0), unsigned blue_mask FI_DEFAULT(0));
+/**
+ * Clones a bitmap. Pixels are shared with the clone (copy-on-write): the first call to
+ * FreeImage_GetBits or FreeImage_GetScanLine on either bitmap makes its private copy.
+ */
 DLL_API FIBITMAP * DLL_CALLCONV FreeImage_Clone(FIBITMAP *dib);
 DLL_API void DLL_CALLCONV FreeImage_Unload(FIBITMAP *dib);
 
+/**
+ * Sets functions used for allocating bitmaps storage. Passing nullptr for both functions restores the default allocator.
+ * Memory blocks remember their allocator, so bitmaps allocated before the call are released correctly.
+ * Returns FALSE if only one of the functions is provided.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SetAllocator(FI_MallocProc malloc_proc, FI_FreeProc free_proc, void *user_ctx);
+
+/**
+ * Creates a pool of recyclable bitmaps of the same type and size.
+ * Bitmaps taken from the pool are returned back to it by FreeImage_Unload, keeping at most 'capacity' bitmaps for reuse.
+ */
+DLL_API FIBITMAPPOOL *DLL_CALLCONV FreeImage_CreateBitmapPool(FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned capacity);
+/**
+ * Deletes the pool. Bitmaps still in use stay valid and are released normally by FreeImage_Unload.
+ */
+DLL_API void DLL_CALLCONV FreeImage_DeleteBitmapPool(FIBITMAPPOOL *pool);
+/**
+ * Takes a bitmap from the pool or allocates a new one if the pool is empty.
+ * Header, palette, metadata, ICC profile and thumbnail are reset, but pixels of a recycled bitmap are not cleared.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_AllocateFromPool(FIBITMAPPOOL *pool);
+
 // Header loading routines
 DLL_API FIBOOL DLL_CALLCONV FreeImage_HasPixels(FIBITMAP *dib);
+/**
+ * Fills info with the size, type and properties of an image, the stream position is restored.
+ * BMP, JPEG and PNG parse their headers without heap allocations, other formats load a header only bitmap
+ * (FIF_LOAD_NOPIXELS). Returns FALSE if the image can't be probed.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_GetImageInfo(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, FIIMAGEINFO *info);
+/**
+ * Estimates the memory and CPU cost of loading an image with flags, from FreeImage_GetImageInfo and a cost model of the
+ * codec (compression, progressive or interlaced images, codec buffers). The stream position is restored.
+ * Returns FALSE if the image can't be probed.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_EstimateDecodeCost(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags, FIDECODECOST *cost);
 
 // Load / Save routines -----------------------------------------------------
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Load(FREE_IMAGE_FORMAT fif, const char *filename, int flags FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
+/**
+ * Same as FreeImage_Load, but the file is memory mapped and decoded from a read-only memory stream.
+ * Falls back to FreeImage_Load if the file can't be mapped (empty, larger than 4 GB or not a regular file).
+ * FIF_FIRAW files are not decoded: the bitmap wraps the pixels of the mapping, kept until the bitmap and its clones
+ * are unloaded, and writing to the pixels makes a private copy first. So are FIF_PFM files loaded with PFM_INPLACE.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadMapped(FREE_IMAGE_FORMAT fif, const char *filename, int flags FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadMappedU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags FI_DEFAULT(0));
+/**
+ * Loads an image fitted into max_width x max_height, keeping its aspect ratio (images are never enlarged).
+ * JPEG and WebP decode at a reduced size, JPEG-2000 at a lower resolution level, JPEG XR at a reduced resolution (down to 1/16),
+ * ICO the smallest icon large enough, DDS from a smaller mipmap level and RAW at half size when possible (with RAW_PREVIEW,
+ * the smallest embedded preview large enough), the result is then rescaled to the exact size.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadScaled(FREE_IMAGE_FORMAT fif, const char *filename, unsigned max_width, unsigned max_height, int flags FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadScaledU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, unsigned max_width, unsigned max_height, int flags FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadScaledFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, unsigned max_width, unsigned max_height, int flags FI_DEFAULT(0));
+/**
+ * Loads the left, top, right, bottom rectangle of an image (in pixels from the top left corner, right and bottom excluded).
+ * JPEG only decodes the iMCU columns of the rectangle and skips the rows above it with libjpeg-turbo,
+ * TIFF only decodes the strips or tiles intersecting the rectangle (of the level selected with TIFF_LEVEL),
+ * HEIF and AVIF grid images only decode the tiles intersecting the rectangle,
+ * JPEG-2000 only decodes the code-blocks intersecting the rectangle,
+ * JPEG XR only decodes the tiles intersecting the rectangle (down to its bottom for untiled images),
+ * other formats are loaded then cropped. Returns NULL if the rectangle isn't inside the image.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadRegion(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int left, int top, int right, int bottom, int flags FI_DEFAULT(0));
+/**
+ * Same as FreeImage_LoadFromHandle, calling callback as rows are decoded so that they can be processed before the load ends.
+ * Non-interlaced PNG images report their rows progressively, other formats report all rows once decoded.
+ * Rows of dib are final when reported, rows are reported once each and in order.
+ */
+/**
+ * Same as FreeImage_Load and FreeImage_LoadFromHandle with options->flags, keeping only the metadata models of options->metadata_models.
+ * The Exif, maker note, IPTC, XMP and GeoTIFF parsers skip the models which aren't kept, other models are removed once loaded.
+ * The ICC profile is removed when FIMD_MASK_ICC isn't set. A NULL options loads with default flags and all metadata.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadEx(FREE_IMAGE_FORMAT fif, const char *filename, const FILOADOPTIONS *options);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadExFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, const FILOADOPTIONS *options);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadWithRowCallback(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags, FI_RowsDecodedProc callback, void *user_data FI_DEFAULT(0));
+/**
+ * Same as FreeImage_LoadFromHandle, reporting the approximations of progressive JPEG and interlaced PNG and GIF images
+ * as their passes are decoded: each scan of a progressive JPEG, the 7 Adam7 passes of a PNG with their pixels filling
+ * the blocks still missing, the 4 passes of a GIF with their rows repeated down. The whole bitmap holds the approximation
+ * when reported, before any JPEG_EXIFROTATE rotation. The last pass isn't reported, it is the returned bitmap.
+ * Other images load as usual, without calls.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadProgressive(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags, FI_PassDecodedProc callback, void *user_data FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_Save(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const char *filename, int flags FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveU(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const wchar_t *filename, int flags FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveToHandle(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
+/**
+ * Same as FreeImage_LoadFromHandle and FreeImage_SaveToHandle with 64-bit IO functions.
+ * Plugins still seek with long offsets, positions beyond LONG_MAX are reported as seek / tell errors to them.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadFromHandle64(FREE_IMAGE_FORMAT fif, FreeImageIO64 *io, fi_handle handle, int flags FI_DEFAULT(0));
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveToHandle64(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FreeImageIO64 *io, fi_handle handle, int flags FI_DEFAULT(0));
+/**
+ * Saves 8-bit Y, Cb and Cr planes as a JPEG image, without colour conversion nor chroma downsampling.
+ * The chroma planes are subsampled as requested by the JPEG_SUBSAMPLING_xxx flag (4:2:0 by default):
+ * (width + 1) / 2 x (height + 1) / 2 pixels for 4:2:0, (width + 1) / 2 x height for 4:2:2, (width + 3) / 4 x height for 4:1:1.
+ * Returns FALSE when JPEG isn't supported or a plane is missing.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveJPEGPlanes(FreeImageIO *io, fi_handle handle, unsigned width, unsigned height, const uint8_t *const *planes, const unsigned *pitches, int flags FI_DEFAULT(0));
+/**
+ * Builds Huffman tables from a representative image saved with flags (subsampling and quality matter),
+ * completed so that they code any image. Saving a batch of similar images with the same tables avoids
+ * the optimisation pass of JPEG_OPTIMIZE on each of them. Returns NULL when JPEG isn't supported or sample can't be saved.
+ */
+DLL_API FIJPEGTABLES *DLL_CALLCONV FreeImage_CreateJPEGTables(FIBITMAP *sample, int flags FI_DEFAULT(0));
+DLL_API void DLL_CALLCONV FreeImage_DeleteJPEGTables(FIJPEGTABLES *tables);
+/**
+ * Saves dib as a JPEG image coded with the Huffman tables of FreeImage_CreateJPEGTables (JPEG_OPTIMIZE is ignored).
+ * Progressive images keep tables of their own.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveJPEGWithTables(FIBITMAP *dib, FreeImageIO *io, fi_handle handle, const FIJPEGTABLES *tables, int flags FI_DEFAULT(0));
+
+// Asynchronous Load / Save routines ----------------------------------------
+
+/**
+ * Loads or saves a file on the library thread pool, the callback is called exactly once when the job is finished.
+ * Saved bitmaps are cloned (pixels are shared copy-on-write), so dib can be modified or unloaded right away.
+ * Without thread pool workers (see FreeImage_SetThreadCount) the job runs on the calling thread.
+ * Returns NULL if the job could not be started, otherwise the handle must be released by FreeImage_CloseAsync.
+ */
+DLL_API FIASYNCJOB *DLL_CALLCONV FreeImage_LoadAsync(FREE_IMAGE_FORMAT fif, const char *filename, int flags, FI_LoadCompletedProc callback, void *user_data FI_DEFAULT(0));
+DLL_API FIASYNCJOB *DLL_CALLCONV FreeImage_LoadAsyncU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags, FI_LoadCompletedProc callback, void *user_data FI_DEFAULT(0));
+DLL_API FIASYNCJOB *DLL_CALLCONV FreeImage_SaveAsync(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const char *filename, int flags FI_DEFAULT(0), FI_SaveCompletedProc callback FI_DEFAULT(0), void *user_data FI_DEFAULT(0));
+DLL_API FIASYNCJOB *DLL_CALLCONV FreeImage_SaveAsyncU(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const wchar_t *filename, int flags FI_DEFAULT(0), FI_SaveCompletedProc callback FI_DEFAULT(0), void *user_data FI_DEFAULT(0));
+/**
+ * Requests cancellation: a pending job doesn't start, a running job fails its next read or write.
+ * The callback is still called, with a NULL bitmap or FALSE. A partially saved file is removed.
+ */
+DLL_API void DLL_CALLCONV FreeImage_CancelAsync(FIASYNCJOB *job);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_IsAsyncCompleted(FIASYNCJOB *job);
+/**
+ * Waits until the callback returns, then returns TRUE if the file was loaded or saved
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_WaitAsync(FIASYNCJOB *job);
+/**
+ * Releases the handle, a running job is not cancelled
+ */
+DLL_API void DLL_CALLCONV FreeImage_CloseAsync(FIASYNCJOB *job);
+/**
+ * Detects the format of and loads count files, like FreeImage_GetFileType followed by FreeImage_Load.
+ * The library thread pool reads the next files while the current one is decoded, and the format found for an
+ * extension is tried first for the next files with the same extension. Returns the number of loaded files.
+ */
+DLL_API unsigned DLL_CALLCONV FreeImage_LoadBatch(const char **filenames, unsigned count, int flags, FI_BatchLoadedProc callback, void *user_data FI_DEFAULT(0));
+
+// Decoded image cache routines ---------------------------------------------
+
+/**
+ * Creates a thread safe LRU cache of decoded bitmaps holding at most max_bytes (see FreeImage_GetMemorySize).
+ * Bitmaps are returned as clones sharing the cached pixels copy-on-write (see FreeImage_Clone): they are released
+ * by FreeImage_Unload as usual, and writing to one makes its private copy, the cached bitmap is never modified.
+ */
+DLL_API FIIMAGECACHE *DLL_CALLCONV FreeImage_CreateImageCache(uint64_t max_bytes);
+/**
+ * Deletes the cache, bitmaps returned by the cache stay valid
+ */
+DLL_API void DLL_CALLCONV FreeImage_DeleteImageCache(FIIMAGECACHE *cache);
+/**
+ * Sets a second level storage receiving the bitmaps evicted from memory and queried on misses.
+ * NULL functions remove the storage.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetImageCacheStorage(FIIMAGECACHE *cache, FI_ImageCacheStoreProc store, FI_ImageCacheFetchProc fetch, void *user_data FI_DEFAULT(NULL));
+/**
+ * Uses a directory as second level storage: evicted bitmaps are written in a raw format (pixels, palette, ICC profile
+ * and metadata as they are in memory) and read back through a memory mapping of the file, without decoding.
+ * Returns FALSE if the directory can't be created.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SetImageCacheDirectory(FIIMAGECACHE *cache, const char *path);
+/**
+ * Returns a share of the bitmap cached under key, NULL if it isn't cached
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GetCachedImage(FIIMAGECACHE *cache, const char *key);
+/**
+ * Caches a share of dib under key, replacing a previous bitmap, and evicts the least recently used bitmaps
+ * beyond the size of the cache. Bitmaps larger than the cache go to the second level storage only.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PutCachedImage(FIIMAGECACHE *cache, const char *key, FIBITMAP *dib);
+/**
+ * FreeImage_Load, or FreeImage_LoadScaled when max_width and max_height aren't 0, through the cache.
+ * Keys start with "file:" and are made of the path, size and modification time of the file, fif, flags and the maximum size.
+ * FIF_UNKNOWN detects the format.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadCached(FIIMAGECACHE *cache, FREE_IMAGE_FORMAT fif, const char *filename, unsigned max_width FI_DEFAULT(0), unsigned max_height FI_DEFAULT(0), int flags FI_DEFAULT(0));
+/**
+ * Same as FreeImage_LoadCached for the content of a memory stream from its current position, keys start with "mem:"
+ * and are made of a 64-bit hash and the size of the content.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadFromMemoryCached(FIIMAGECACHE *cache, FREE_IMAGE_FORMAT fif, FIMEMORY *stream, unsigned max_width FI_DEFAULT(0), unsigned max_height FI_DEFAULT(0), int flags FI_DEFAULT(0));
+DLL_API void DLL_CALLCONV FreeImage_GetImageCacheStats(FIIMAGECACHE *cache, FIIMAGECACHESTATS *stats);
 
 // Memory I/O stream routines -----------------------------------------------
 
@@ -919,15 +1679,102 @@ DLL_API FIMEMORY *DLL_CALLCONV FreeImage_OpenMemory(uint8_t *data FI_DEFAULT(0),
 DLL_API void DLL_CALLCONV FreeImage_CloseMemory(FIMEMORY *stream);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int flags FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveToMemory(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FIMEMORY *stream, int flags FI_DEFAULT(0));
+/**
+ * Saves dib to stream with the encoder quality meeting a size and/or quality target (see FIENCODETARGET), for JPEG, WebP,
+ * HEIF, AVIF and JXR lossy encodings. The quality bits of flags are ignored, other flags apply to every trial encoding.
+ * Trial encodings run in parallel on the library thread pool, large images are searched on a half size proxy first.
+ * The chosen quality (1 to 100) is returned in quality. Returns FALSE when no quality meets the target, nothing is written then.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveToMemoryTarget(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FIMEMORY *stream, const FIENCODETARGET *target, int flags FI_DEFAULT(0), int *quality FI_DEFAULT(NULL));
 DLL_API long DLL_CALLCONV FreeImage_TellMemory(FIMEMORY *stream);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SeekMemory(FIMEMORY *stream, long offset, int origin);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_AcquireMemory(FIMEMORY *stream, uint8_t **data, uint32_t *size_in_bytes);
 DLL_API unsigned DLL_CALLCONV FreeImage_ReadMemory(void *buffer, unsigned size, unsigned count, FIMEMORY *stream);
 DLL_API unsigned DLL_CALLCONV FreeImage_WriteMemory(const void *buffer, unsigned size, unsigned count, FIMEMORY *stream);
+/**
+ * 64-bit variants of the memory stream functions, memory streams can grow beyond 2 GB on 64-bit systems.
+ * FreeImage_TellMemory returns -1 and FreeImage_AcquireMemory fails when the position or the size don't fit their types.
+ */
+DLL_API FIMEMORY *DLL_CALLCONV FreeImage_OpenMemory64(uint8_t *data FI_DEFAULT(0), uint64_t size_in_bytes FI_DEFAULT(0));
+/**
+ * Opens a read/write memory stream with reserve_bytes preallocated and a FIMEMORY_GROW_* growth policy.
+ * Reserving the expected size avoids reallocations, chunked streams are never reallocated.
+ */
+DLL_API FIMEMORY *DLL_CALLCONV FreeImage_OpenMemoryEx(uint64_t reserve_bytes, int growth_policy FI_DEFAULT(FIMEMORY_GROW_DOUBLE));
+/**
+ * Opens an empty read/write memory stream writing into the capacity bytes of buffer, owned by the caller, so that
+ * FreeImage_SaveToMemory encodes straight into it. When a write needs more space, overflow is asked for a larger buffer,
+ * without it the write fails. FreeImage_AcquireMemory returns the buffer written last and the number of written bytes.
+ * The stream never frees the buffers.
+ */
+DLL_API FIMEMORY *DLL_CALLCONV FreeImage_OpenMemoryWritable(uint8_t *buffer, uint64_t capacity, FI_MemoryOverflowProc overflow FI_DEFAULT(NULL), void *user_data FI_DEFAULT(NULL));
+DLL_API int64_t DLL_CALLCONV FreeImage_TellMemory64(FIMEMORY *stream);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SeekMemory64(FIMEMORY *stream, int64_t offset, int origin);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_AcquireMemory64(FIMEMORY *stream, uint8_t **data, uint64_t *size_in_bytes);
+/**
+ * Returns the unread bytes of a stream opened by the memory IO functions, without copying them, or NULL for other and chunked streams.
+ * Plugins can decode from this pointer and then seek over the consumed bytes. The position is not moved,
+ * the pointer stays valid until the stream is written or closed.
+ */
+DLL_API const uint8_t *DLL_CALLCONV FreeImage_PeekMemoryIO(FreeImageIO *io, fi_handle handle, uint64_t *available FI_DEFAULT(0));
 
 DLL_API FIMULTIBITMAP *DLL_CALLCONV FreeImage_LoadMultiBitmapFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int flags FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveMultiBitmapToMemory(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap, FIMEMORY *stream, int flags);
 
+// Buffered I/O routines ---------------------------------------------------
+
+/**
+ * Wraps a stream read through small io calls with a buffer_size bytes read buffer, seeks within the buffer don't
+ * reach the stream. Fills buffered_io with the procs to use with the returned handle, or returns NULL on failure.
+ */
+DLL_API FIBUFFEREDIO *DLL_CALLCONV FreeImage_CreateBufferedIO(FreeImageIO *io, fi_handle handle, unsigned buffer_size, FreeImageIO *buffered_io);
+/**
+ * Moves the wrapped stream to the position of the buffered stream and releases the buffer
+ */
+DLL_API void DLL_CALLCONV FreeImage_CloseBufferedIO(FIBUFFEREDIO *stream);
+/**
+ * When buffer_size isn't 0, FreeImage_LoadFromHandle buffers the reads of user IO functions (not of files or memory streams).
+ * Disabled by default.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetLoadBuffering(unsigned buffer_size);
+/**
+ * Sets the size of the buffers between the codecs and the IO functions, JPEG reads and writes buffer_size bytes
+ * per io call. 4096 bytes by default, sizes below 512 bytes are rounded up.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetStreamBufferSize(unsigned buffer_size);
+/**
+ * Returns the size set by FreeImage_SetStreamBufferSize
+ */
+DLL_API unsigned DLL_CALLCONV FreeImage_GetStreamBufferSize(void);
+/**
+ * Sets the FIFILE_HINT_* page cache hints given for the files read by FreeImage_Load, FreeImage_LoadEx and FreeImage_LoadScaled
+ * (with posix_fadvise, ignored where it isn't available). No hints by default.
+ * Whatever the hints, files of formats decoded front to back are read through a 128 KB stdio buffer.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetFileHints(unsigned hints);
+DLL_API unsigned DLL_CALLCONV FreeImage_GetFileHints(void);
+
+// Scanline reader routines ------------------------------------------------
+
+/**
+ * Opens a reader decoding the rows of an image as they are requested, without loading the whole bitmap.
+ * PNG (non interlaced), PNM, HDR, JPEG (without JPEG_EXIFROTATE) and BMP images (uncompressed or RLE, with a Windows header)
+ * are decoded incrementally, other formats, TIFF included, are fully loaded when opened.
+ * Returns NULL if the image can't be decoded.
+ */
+DLL_API FISCANLINEREADER *DLL_CALLCONV FreeImage_OpenScanlineReader(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
+/**
+ * Returns a bitmap describing the rows (size, type, palette, metadata), owned by the reader. Its pixels may not be loaded.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GetScanlineReaderInfo(FISCANLINEREADER *reader);
+/**
+ * Decodes the next count rows into bits, pitch bytes apart (at least FreeImage_GetLine of the info bitmap).
+ * Rows come from the top of the image, i.e. the first row is FreeImage_GetScanLine(dib, height - 1) of the loaded bitmap.
+ * Returns the number of decoded rows, less than count at the end of the image or on error.
+ */
+DLL_API unsigned DLL_CALLCONV FreeImage_ReadScanlines(FISCANLINEREADER *reader, uint8_t *bits, unsigned count, unsigned pitch);
+DLL_API void DLL_CALLCONV FreeImage_CloseScanlineReader(FISCANLINEREADER *reader);
+
 // Plugin Interface ---------------------------------------------------------
 
 DLL_API FREE_IMAGE_FORMAT DLL_CALLCONV FreeImage_RegisterLocalPlugin(FI_InitProc proc_address, const char *format FI_DEFAULT(0), const char *description FI_DEFAULT(0), const char *extension FI_DEFAULT(0), const char *regexpr FI_DEFAULT(0));
@@ -981,6 +1828,12 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_FIFSupportsExportBPP(FREE_IMAGE_FORMAT fif
 DLL_API FIBOOL DLL_CALLCONV FreeImage_FIFSupportsExportType(FREE_IMAGE_FORMAT fif, FREE_IMAGE_TYPE type);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_FIFSupportsICCProfiles(FREE_IMAGE_FORMAT fif);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_FIFSupportsNoPixels(FREE_IMAGE_FORMAT fif);
+/**
+ * Returns TRUE when the plugin of fif has a fast path for feature. Without it, FreeImage_LoadScaled, FreeImage_LoadRegion and
+ * FreeImage_OpenScanlineReader load the whole image then rescale, crop or copy its rows, FreeImage_GetImageInfo loads a header only bitmap.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_FIFSupportsFeature(FREE_IMAGE_FORMAT fif, FREE_IMAGE_FEATURE feature);
+DLL_API unsigned DLL_CALLCONV FreeImage_GetFIFConcurrency(FREE_IMAGE_FORMAT fif);
 
 // Multipaging interface ----------------------------------------------------
 
@@ -988,14 +1841,47 @@ DLL_API FIMULTIBITMAP * DLL_CALLCONV FreeImage_OpenMultiBitmap(FREE_IMAGE_FORMAT
 DLL_API FIMULTIBITMAP * DLL_CALLCONV FreeImage_OpenMultiBitmapFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_CloseMultiBitmap(FIMULTIBITMAP *bitmap, int flags FI_DEFAULT(0));
+/**
+ * Sets the memory used by the page cache of each multipage bitmap opened with keep_cache_in_memory FALSE,
+ * the least used pages are swapped out to the cache file beyond it. 2 MB by default, read when the bitmap is opened.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetMultiBitmapCacheSize(unsigned size);
+/**
+ * Returns the size set by FreeImage_SetMultiBitmapCacheSize
+ */
+DLL_API unsigned DLL_CALLCONV FreeImage_GetMultiBitmapCacheSize(void);
 DLL_API int DLL_CALLCONV FreeImage_GetPageCount(FIMULTIBITMAP *bitmap);
 DLL_API void DLL_CALLCONV FreeImage_AppendPage(FIMULTIBITMAP *bitmap, FIBITMAP *data);
 DLL_API void DLL_CALLCONV FreeImage_InsertPage(FIMULTIBITMAP *bitmap, int page, FIBITMAP *data);
 DLL_API void DLL_CALLCONV FreeImage_DeletePage(FIMULTIBITMAP *bitmap, int page);
 DLL_API FIBITMAP * DLL_CALLCONV FreeImage_LockPage(FIMULTIBITMAP *bitmap, int page);
+/**
+ * Locks count pages at once, out[i] receives the page pages[i] or NULL if it can't be locked (see FreeImage_LockPage).
+ * Pages of bitmaps opened from a file or a memory stream are decoded in parallel by the thread pool when the
+ * plugin reports FIF_CONCURRENT_LOAD, each thread reading the source through its own handle.
+ * Returns TRUE if all the pages were locked. Unlock the pages with FreeImage_UnlockPage.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_LockPages(FIMULTIBITMAP *bitmap, const int *pages, int count, FIBITMAP **out);
 DLL_API void DLL_CALLCONV FreeImage_UnlockPage(FIMULTIBITMAP *bitmap, FIBITMAP *data, FIBOOL changed);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_MovePage(FIMULTIBITMAP *bitmap, int target, int source);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_GetLockedPageNumbers(FIMULTIBITMAP *bitmap, int *pages, int *count);
+/**
+ * Opens a forward-only writer of a new multipage image (e.g. TIFF, GIF, ICO) to handle.
+ * Pages are encoded straight to the destination by FreeImage_WritePage, without going through the page cache
+ * of FreeImage_OpenMultiBitmap. flags are the save flags of the plugin, used for every page.
+ * Returns NULL if the format can't be saved.
+ */
+DLL_API FIMULTIWRITER *DLL_CALLCONV FreeImage_OpenMultiBitmapWriter(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
+/**
+ * Encodes dib as the next page. Once a page fails, the following ones are rejected.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_WritePage(FIMULTIWRITER *writer, FIBITMAP *dib);
+DLL_API int DLL_CALLCONV FreeImage_GetWrittenPageCount(FIMULTIWRITER *writer);
+/**
+ * Completes the image and releases the writer, the handle stays open.
+ * Returns TRUE if all the pages were written.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_CloseMultiBitmapWriter(FIMULTIWRITER *writer);
 
 // File type request routines ------------------------------------------------
 
@@ -1024,6 +1910,12 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_LookupSVGColor(const char *szColor, uint8_
 
 DLL_API uint8_t *DLL_CALLCONV FreeImage_GetBits(FIBITMAP *dib);
 DLL_API uint8_t *DLL_CALLCONV FreeImage_GetScanLine(FIBITMAP *dib, int scanline);
+/**
+ * Read-only pixels access. Unlike FreeImage_GetBits and FreeImage_GetScanLine
+ * it never makes a private copy of pixels shared with clones (see FreeImage_Clone).
+ */
+DLL_API const uint8_t *DLL_CALLCONV FreeImage_GetConstBits(FIBITMAP *dib);
+DLL_API const uint8_t *DLL_CALLCONV FreeImage_GetConstScanLine(FIBITMAP *dib, int scanline);
 
 DLL_API FIBOOL DLL_CALLCONV FreeImage_GetPixelIndex(FIBITMAP *dib, unsigned x, unsigned y, uint8_t *value);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_GetPixelColor(FIBITMAP *dib, unsigned x, unsigned y, FIRGBA8 *value);
@@ -1083,6 +1975,18 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_SetThumbnail(FIBITMAP *dib, FIBITMAP *thum
 DLL_API FIICCPROFILE *DLL_CALLCONV FreeImage_GetICCProfile(FIBITMAP *dib);
 DLL_API FIICCPROFILE *DLL_CALLCONV FreeImage_CreateICCProfile(FIBITMAP *dib, void *data, long size);
 DLL_API void DLL_CALLCONV FreeImage_DestroyICCProfile(FIBITMAP *dib);
+/**
+ * Converts in place the pixels of dib from its ICC profile to the RGB profile dst_profile, which then replaces it. An image without
+ * profile is sRGB, a NULL dst_profile converts to sRGB and removes the profile. 24, 32-bit, FIT_RGB16, FIT_RGBA16, FIT_RGBF and FIT_RGBAF
+ * images, alpha is kept, colours out of the destination gamut are clipped. Matrix/TRC profiles (Display P3, Adobe RGB, ...) are supported
+ * natively, LUT based profiles aren't supported. Transforms are cached process wide, keyed by the profiles contents.
+ * Returns FALSE when the image type or a profile isn't supported, the image is then unchanged.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ApplyICCTransform(FIBITMAP *dib, const FIICCPROFILE *dst_profile FI_DEFAULT(NULL));
+/**
+ * Converts dib to sRGB, see FreeImage_ApplyICCTransform. An image without profile is left unchanged.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ConvertToSRGB(FIBITMAP *dib);
 
 // Line conversion routines -------------------------------------------------
 
@@ -1140,7 +2044,31 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertTo32Bits(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ColorQuantize(FIBITMAP *dib, FREE_IMAGE_QUANTIZE quantize);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ColorQuantizeEx(FIBITMAP *dib, FREE_IMAGE_QUANTIZE quantize FI_DEFAULT(FIQ_WUQUANT), int PaletteSize FI_DEFAULT(256), int ReserveSize FI_DEFAULT(0), FIRGBA8 *ReservePalette FI_DEFAULT(NULL));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Threshold(FIBITMAP *dib, uint8_t T);
+/**
+ * Converts an image to 1-bit with a global or local threshold: a pixel is white if greater than the threshold.
+ * Local thresholds are computed over a window x window neighbourhood (3 to 257, clipped at borders), k is the
+ * sensitivity of local methods (0.2 is a common value for both), window and k are ignored by FIB_OTSU.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Binarize(FIBITMAP *dib, FREE_IMAGE_BINARIZE method, unsigned window FI_DEFAULT(31), double k FI_DEFAULT(0.2));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Dither(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm);
+/**
+ * Dithers an image to levels evenly spaced grey levels (2 to 256). Two levels give a 1-bit image as FreeImage_Dither,
+ * up to 16 levels a 4-bit image and more levels an 8-bit image, with a greyscale palette of the levels.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_DitherEx(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm, unsigned levels FI_DEFAULT(2));
+/**
+ * Prepares the remapping of images to a fixed palette of 1 to 256 colours, such as the palette of a first frame
+ * quantized by FreeImage_ColorQuantizeEx, and reused for the following frames. The nearest colour lookup is built once.
+ * If dither is TRUE, the images are remapped with Floyd-Steinberg error diffusion.
+ */
+DLL_API FIPALETTEMAPPER *DLL_CALLCONV FreeImage_CreatePaletteMapper(const FIRGBA8 *palette, int count, FIBOOL dither FI_DEFAULT(FALSE));
+DLL_API void DLL_CALLCONV FreeImage_DeletePaletteMapper(FIPALETTEMAPPER *mapper);
+/**
+ * Returns an 8-bit image of the mapper palette, each pixel takes the nearest palette colour (Euclidean RGB distance,
+ * smallest index on ties). Bitmaps other than 24 or 32-bit are converted to 24-bit first.
+ * A mapper is read only, threads may remap images with the same mapper concurrently.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ApplyPaletteMapper(FIBITMAP *dib, FIPALETTEMAPPER *mapper);
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertFromRawBits(uint8_t *bits, int width, int height, int pitch, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, FIBOOL topdown FI_DEFAULT(FALSE));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertFromRawBitsEx(FIBOOL copySource, uint8_t *bits, FREE_IMAGE_TYPE type, int width, int height, int pitch, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, FIBOOL topdown FI_DEFAULT(FALSE));
@@ -1155,14 +2083,56 @@ DLL_API void DLL_CALLCONV FreeImage_ConvertToRawBits(uint8_t *bits, FIBITMAP *di
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToFloat(FIBITMAP *dib, FIBOOL scale_linear FI_DEFAULT(TRUE));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGBF(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGBAF(FIBITMAP *dib);
+/**
+ * Same as FreeImage_ConvertToRGBF / FreeImage_ConvertToRGBAF, but 8-bit and 16-bit samples are decoded from the sRGB
+ * transfer function to linear light. Alpha stays linear, other image types are converted as by the functions above.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToLinearRGBF(FIBITMAP *dib);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToLinearRGBAF(FIBITMAP *dib);
+/**
+ * Converts an image to a FIT_RGBAH image type (half the memory of FIT_RGBAF).
+ * Float values are rounded to the nearest half and kept out of [0, 1], other types are converted through FreeImage_ConvertToRGBAF.
+ * FreeImage_ConvertToRGBF and FreeImage_ConvertToRGBAF expand FIT_RGBAH images without clamping.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGBAH(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToUINT16(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGB16(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGBA16(FIBITMAP *dib);
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToStandardType(FIBITMAP *src, FIBOOL scale_linear FI_DEFAULT(TRUE));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_linear FI_DEFAULT(TRUE));
+/**
+ * Converts an image to dst_type / dst_bpp within its own memory, without allocating a new bitmap.
+ * Supported conversions never expand pixels: FIT_BITMAP 32 to 24-bit, FIT_BITMAP 24 or 32-bit and FIT_UINT16 to 8-bit greyscale,
+ * FIT_RGB16 to 24-bit, FIT_RGBA16 to 24 or 32-bit or FIT_RGB16, FIT_RGBAF to FIT_RGBF and FIT_RGBF or FIT_RGBAF to FIT_FLOAT.
+ * Pixels are converted like the matching FreeImage_ConvertTo* function does, metadata is kept. dst_bpp may be 0 for types other than FIT_BITMAP.
+ * Returns FALSE and leaves the image untouched for any other conversion.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ConvertInPlace(FIBITMAP *dib, FREE_IMAGE_TYPE dst_type, unsigned dst_bpp);
+/**
+ * Converts src to the type and bit depth of dst, an already allocated image of the same size, and copies src metadata into dst.
+ * dst may wrap caller memory (see FreeImage_AllocateHeaderForBits). Conversions to the format of src and to 24 or 32-bit FIT_BITMAP
+ * write dst directly, other conversions go through a temporary image.
+ * Returns FALSE if the sizes differ or the conversion is not supported.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ConvertInto(FIBITMAP *dst, FIBITMAP *src);
 
 DLL_API FIBITMAP* DLL_CALLCONV FreeImage_ConvertToColor(FIBITMAP* dib, FREE_IMAGE_COLOR_TYPE dst_color, int64_t fisrt_param FI_DEFAULT(0), int64_t second_param FI_DEFAULT(0));
+/**
+ * Converts a 24 or 32-bit image to 8-bit YUV 4:2:0 planes in caller memory, e.g. the input buffers of a video encoder.
+ * planes[0] receives Y, planes[1] U (or interleaved U, V for FIYUV_NV12) and planes[2] V (unused for FIYUV_NV12), strides are in bytes.
+ * Planes are written top-down, chroma is averaged over 2x2 blocks. Returns FALSE for other images, unknown parameters or strides too small.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ConvertToYUVPlanes(FIBITMAP* dib, FREE_IMAGE_YUV_PLANES layout, uint8_t* const planes[3], const unsigned strides[3], FREE_IMAGE_CVT_COLOR_PARAM yuv_standard FI_DEFAULT(FICPARAM_YUV_STANDARD_DEFAULT));
+
+/**
+ * Writes dib as a tensor of desc->channels x desc->height x desc->width elements (or height x width x channels) into dst,
+ * rows top-down, e.g. the input of a neural network. The image is rescaled first if the tensor has another size.
+ * 8-bit greyscale, 24/32-bit, FIT_UINT16, RGB[A]16, FIT_FLOAT and RGB[A]F images are read, converted and normalized in one
+ * parallel pass; greyscale images give the same red, green and blue samples, missing alpha samples read 1.
+ * Other images are converted by FreeImage_ConvertToRGBF or FreeImage_ConvertToRGBAF first.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ExportTensor(FIBITMAP *dib, const FITENSORDESC *desc, void *dst);
 
 // Tone mapping operators ---------------------------------------------------
 
@@ -1171,6 +2141,11 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_TmoDrago03(FIBITMAP *src, double gamma
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_TmoReinhard05(FIBITMAP *src, double intensity FI_DEFAULT(0), double contrast FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_TmoReinhard05Ex(FIBITMAP *src, double intensity FI_DEFAULT(0), double contrast FI_DEFAULT(0), double adaptation FI_DEFAULT(1), double color_correction FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_TmoFattal02(FIBITMAP *src, double color_saturation FI_DEFAULT(0.5), double attenuation FI_DEFAULT(0.85));
+/**
+ * FreeImage_TmoFattal02 integrating the attenuated gradients with the given Poisson solver.
+ * FIPS_DCT solves the equation exactly with mirrored boundaries and needs no power of two padding.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_TmoFattal02Ex(FIBITMAP *src, double color_saturation FI_DEFAULT(0.5), double attenuation FI_DEFAULT(0.85), FREE_IMAGE_POISSON_SOLVER solver FI_DEFAULT(FIPS_MULTIGRID));
 /**
  * Trivial tonemapping by diving by `2^max_bits - 1` and then applying std::clamp to range [0, 255].
  * Floating point types are multiplied by 256 and then clamped, `max_value` is ignored.
@@ -1195,6 +2170,17 @@ DLL_API uint32_t DLL_CALLCONV FreeImage_ZLibUncompress(uint8_t *target, uint32_t
 DLL_API uint32_t DLL_CALLCONV FreeImage_ZLibGZip(uint8_t *target, uint32_t target_size, uint8_t *source, uint32_t source_size);
 DLL_API uint32_t DLL_CALLCONV FreeImage_ZLibGUnzip(uint8_t *target, uint32_t target_size, uint8_t *source, uint32_t source_size);
 DLL_API uint32_t DLL_CALLCONV FreeImage_ZLibCRC32(uint32_t crc, uint8_t *source, uint32_t source_size);
+/**
+ * Sets the deflate level (0 to 9, -1 for the format default) and strategy used by a format when saving:
+ * FIF_PNG, FIF_TIFF (TIFF_DEFLATE and TIFF_ADOBE_DEFLATE, level only) or FIF_UNKNOWN for FreeImage_ZLibCompress
+ * and FreeImage_ZLibGZip. The PNG_Z_* save flags take precedence over the level.
+ * @return Returns FALSE for other formats or values out of range
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SetZLibOptions(FREE_IMAGE_FORMAT fif, int level, FREE_IMAGE_ZSTRATEGY strategy);
+/**
+ * Returns the options set by FreeImage_SetZLibOptions, -1 and FIZS_FORMAT_DEFAULT if not set
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_GetZLibOptions(FREE_IMAGE_FORMAT fif, int *level, FREE_IMAGE_ZSTRATEGY *strategy);
 
 // --------------------------------------------------------------------------
 // Metadata routines
@@ -1229,6 +2215,10 @@ DLL_API void DLL_CALLCONV FreeImage_FindCloseMetadata(FIMETADATA *mdhandle);
 
 // metadata setter and getter
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SetMetadata(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, FITAG *tag);
+/**
+ * Returns a tag attached to the bitmap. Metadata is shared copy-on-write with bitmaps derived by
+ * FreeImage_Clone and FreeImage_CloneMetadata: the tag is read-only, modify it through FreeImage_SetMetadata.
+ */
 DLL_API FIBOOL DLL_CALLCONV FreeImage_GetMetadata(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, FITAG **tag);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SetMetadataKeyValue(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, const char *value);
 
@@ -1236,8 +2226,10 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_SetMetadataKeyValue(FREE_IMAGE_MDMODEL mod
 DLL_API unsigned DLL_CALLCONV FreeImage_GetMetadataCount(FREE_IMAGE_MDMODEL model, FIBITMAP *dib);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_CloneMetadata(FIBITMAP *dst, FIBITMAP *src);
 
-// tag to C string conversion
+// tag to C string conversion, the string belongs to the calling thread until its next call
 DLL_API const char* DLL_CALLCONV FreeImage_TagToString(FREE_IMAGE_MDMODEL model, FITAG *tag, char *Make FI_DEFAULT(NULL));
+// same into a caller buffer, truncated and null terminated, returns the length of the whole string (like snprintf)
+DLL_API unsigned DLL_CALLCONV FreeImage_TagToStringBuf(FREE_IMAGE_MDMODEL model, FITAG *tag, char *buffer, unsigned size);
 
 // --------------------------------------------------------------------------
 // JPEG lossless transformation routines
@@ -1251,26 +2243,157 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_JPEGTransformFromHandle(FreeImageIO* src_i
 DLL_API FIBOOL DLL_CALLCONV FreeImage_JPEGTransformCombined(const char *src_file, const char *dst_file, FREE_IMAGE_JPEG_OPERATION operation, int* left, int* top, int* right, int* bottom, FIBOOL perfect FI_DEFAULT(TRUE));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_JPEGTransformCombinedU(const wchar_t *src_file, const wchar_t *dst_file, FREE_IMAGE_JPEG_OPERATION operation, int* left, int* top, int* right, int* bottom, FIBOOL perfect FI_DEFAULT(TRUE));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_JPEGTransformCombinedFromMemory(FIMEMORY* src_stream, FIMEMORY* dst_stream, FREE_IMAGE_JPEG_OPERATION operation, int* left, int* top, int* right, int* bottom, FIBOOL perfect FI_DEFAULT(TRUE));
+/**
+ * Applies the same lossless transformation to count JPEG streams, reusing one pair of libjpeg objects.
+ * results (may be NULL) receives the status of each stream. Returns the number of streams transformed.
+ */
+DLL_API unsigned DLL_CALLCONV FreeImage_JPEGTransformBatch(FIMEMORY** src_streams, FIMEMORY** dst_streams, unsigned count, FREE_IMAGE_JPEG_OPERATION operation, FIBOOL perfect FI_DEFAULT(TRUE), FIBOOL* results FI_DEFAULT(NULL));
+/**
+ * Loads a JPEG image at 1/8 of its size from the DC coefficients of its blocks, without inverse DCT nor upsampling:
+ * each pixel is the average of the 8x8 block it stands for. Returns an 8-bit greyscale or a 24-bit RGB image,
+ * CMYK images are not supported. Progressive images are still read in full.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_JPEGLoadDC(const char *filename);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_JPEGLoadDCFromHandle(FreeImageIO *io, fi_handle handle);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_JPEGLoadDCFromMemory(FIMEMORY *stream);
+/**
+ * Writes a JPEG thumbnail of a JPEG image scaled in the DCT domain, without decoding nor re-encoding samples:
+ * the low frequency coefficients of each group of 2x2, 4x4 or 8x8 blocks make one block of the thumbnail,
+ * requantised with the tables of the source. The scale is the largest of 1, 1/2, 1/4 and 1/8 fitting
+ * max_pixel_size, so the thumbnail is larger than requested when 1/8 doesn't fit.
+ * ICC profiles are kept, other metadata are dropped.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_JPEGFastThumbnail(const char *src_file, const char *dst_file, int max_pixel_size);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_JPEGFastThumbnailFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO* dst_io, fi_handle dst_handle, int max_pixel_size);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_JPEGFastThumbnailFromMemory(FIMEMORY* src_stream, FIMEMORY* dst_stream, int max_pixel_size);
 
 
 // --------------------------------------------------------------------------
 // Image manipulation toolkit
 // --------------------------------------------------------------------------
 
+// orientation of stored pixels (see FreeImage_CreateView), the displayed image is
+// the stored image transposed first when FIO_TRANSPOSE is set, then mirrored
+#define FIO_NORMAL			0x00	//! pixels are stored in display order
+#define FIO_FLIP_HORIZONTAL	0x01	//! displayed rows are mirrored
+#define FIO_FLIP_VERTICAL	0x02	//! displayed image is upside down
+#define FIO_TRANSPOSE		0x04	//! stored rows are displayed as columns
+
 // rotation and flipping
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Rotate(FIBITMAP *dib, double angle, const void *bkcolor FI_DEFAULT(NULL));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RotateEx(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, FIBOOL use_mask);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_FlipHorizontal(FIBITMAP *dib);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_FlipVertical(FIBITMAP *dib);
+/**
+ * Orientation (FIO_xxx flags) describing how the stored pixels of dib are displayed, FIO_NORMAL by default.
+ * Pixel access and toolkit functions always work on stored pixels; consumers able to walk pixels with signed steps
+ * (see FreeImage_GetOrientedLayout) or FreeImage_ApplyOrientation honour it.
+ */
+DLL_API unsigned DLL_CALLCONV FreeImage_GetOrientation(FIBITMAP *dib);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SetOrientation(FIBITMAP *dib, unsigned orientation);
+/**
+ * Describes the displayed image without moving pixels: displayed pixel (x, y), counted from the top-left corner,
+ * starts at origin + y * row_step + x * pixel_step (steps in bytes, possibly negative). width and height are the displayed size.
+ * Returns FALSE for 1-, 2- and 4-bit images whose orientation mirrors or transposes rows. Any output may be NULL.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_GetOrientedLayout(FIBITMAP *dib, unsigned *width, unsigned *height, uint8_t **origin, int *row_step, int *pixel_step);
+/**
+ * Returns a new bitmap whose stored pixels are in display order (orientation FIO_NORMAL).
+ * Transposition relies on FreeImage_Rotate, NULL is returned for image types it does not support.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ApplyOrientation(FIBITMAP *dib);
+/**
+ * Converts the Exif 'Orientation' tag of dib into FIO_xxx flags, FIO_NORMAL when absent.
+ * FreeImage_CreateView(dib, 0, 0, width, height, FreeImage_GetExifOrientation(dib)) displays the image upright without rotating it.
+ */
+DLL_API unsigned DLL_CALLCONV FreeImage_GetExifOrientation(FIBITMAP *dib);
+/**
+ * Warps dib with the affine matrix {m0, m1, m2, m3, m4, m5} in a single resampling pass.
+ * The matrix maps source to destination pixel coordinates with the origin at the top-left corner:
+ * x' = m0 * x + m1 * y + m2, y' = m3 * x + m4 * y + m5.
+ * When dst_width or dst_height is not positive, the destination is the bounding box of the transformed image and the translation is ignored.
+ * Pixels mapped outside the source are filled with bkcolor (black when NULL). 8-bit palettized images are sampled with the nearest pixel.
+ * Supports 8, 24 and 32-bit bitmaps, FIT_UINT16, FIT_RGB16, FIT_RGBA16, FIT_FLOAT, FIT_RGBF and FIT_RGBAF images.
+ * Returns NULL if the matrix is not invertible.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_AffineTransform(FIBITMAP *dib, const double *matrix, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_BILINEAR), const void *bkcolor FI_DEFAULT(NULL), int dst_width FI_DEFAULT(0), int dst_height FI_DEFAULT(0));
+
+// filtering routines
+// Separable filters of 8-bit greyscale, 24 and 32-bit bitmaps and of all other image types (not 1, 4, 16-bit or palettized bitmaps).
+// Image edges are replicated, all channels (alpha included) are filtered. Rows are processed by parallel bands with SIMD kernels,
+// results do not depend on the number of threads.
+/**
+ * Mean of the (2 * radius + 1) x (2 * radius + 1) neighbourhood of every pixel, in a time that does not depend on the radius.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_BoxBlur(FIBITMAP *dib, unsigned radius);
+/**
+ * Gaussian blur of standard deviation sigma (in pixels), sampled over 3 sigma for sigma up to 8, approximated by three box filters above.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GaussianBlur(FIBITMAP *dib, double sigma);
+/**
+ * Sharpens dib to dib + amount * (dib - blur), blur being the Gaussian blur of standard deviation sigma.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_UnsharpMask(FIBITMAP *dib, double sigma, double amount);
+/**
+ * Filters rows with kernel_x then columns with kernel_y (kernel_x when NULL), kernel[i] weighs the pixel at offset i - size / 2.
+ * Kernel sizes must be odd, weights are not normalized.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Convolve(FIBITMAP *dib, const double *kernel_x, unsigned size_x, const double *kernel_y FI_DEFAULT(NULL), unsigned size_y FI_DEFAULT(0));
 
 // upsampling / downsampling
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Rescale(FIBITMAP *dib, int dst_width, int dst_height, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, FIBOOL convert FI_DEFAULT(TRUE));
+/**
+ * Makes count thumbnails of dib, thumbnails[i] fitting in sizes[i] x sizes[i] like FreeImage_MakeThumbnail (without conversion).
+ * Each thumbnail is filtered from a larger one at least twice its size when there is one, from dib otherwise; thumbnails
+ * which do not depend on each other are made in parallel. Load a file with FreeImage_LoadScaled, given the largest size,
+ * to decode it only once at a reduced resolution. Returns FALSE, with all thumbnails NULL, if one of them cannot be made.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_MakeThumbnailSet(FIBITMAP *dib, const int *sizes, unsigned count, FREE_IMAGE_FILTER filter, FIBITMAP **thumbnails);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RescaleRect(FIBITMAP *dib, int dst_width, int dst_height, int left, int top, int right, int bottom, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), unsigned flags FI_DEFAULT(0));
+/**
+ * Rescales src to the size of dst, an already allocated image which may wrap caller memory (see FreeImage_AllocateHeaderForBits).
+ * dst must have the type and bit depth FreeImage_Rescale would return; a 24-bit dst implies FI_RESCALE_TRUE_COLOR.
+ * FIT_UINT16, FIT_RGB16 and FIT_RGBA16 images may also be rescaled into an 8, 24 or 32-bit dst, keeping the high byte of each sample.
+ * When both sizes are equal, works like FreeImage_ConvertInto. Returns FALSE if dst does not match.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_RescaleInto(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), unsigned flags FI_DEFAULT(0));
+/**
+ * Creates a resizer of the rows of an image of the type and size of info (which may be header only, e.g. the bitmap of
+ * FreeImage_GetScanlineReaderInfo) to dst_width x dst_height. 8-bit greyscale, 24-bit, 32-bit, FIT_UINT16, FIT_RGB16,
+ * FIT_RGBA16, FIT_FLOAT, FIT_RGBF and FIT_RGBAF rows are supported, destination rows keep their type. Only the rows of
+ * a vertical filter window are kept, as horizontally filtered floats. Returns NULL if the image type is not supported.
+ */
+DLL_API FIRESIZER *DLL_CALLCONV FreeImage_CreateResizer(FIBITMAP *info, int dst_width, int dst_height, FREE_IMAGE_FILTER filter, FI_RowsResizedProc callback, void *user_data FI_DEFAULT(0));
+/**
+ * Pushes the next count source rows, pitch bytes apart, starting from the top of the image. The callback receives every
+ * destination row whose filter window is complete before the call returns. Returns the number of destination rows emitted.
+ */
+DLL_API unsigned DLL_CALLCONV FreeImage_ResizerPushRows(FIRESIZER *resizer, const uint8_t *bits, unsigned count, unsigned pitch);
+DLL_API void DLL_CALLCONV FreeImage_DeleteResizer(FIRESIZER *resizer);
+/**
+ * Rescales the rows of reader, which has not been read from yet, as they are decoded; decoding and filtering overlap and the source image is never loaded
+ * whole (when the format is decoded incrementally, see FreeImage_OpenScanlineReader). Returns NULL on failure.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RescaleScanlines(FISCANLINEREADER *reader, int dst_width, int dst_height, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM));
 
 // color manipulation routines (point operations)
+/**
+ * Applies one lookup table per channel in a single pass: 256 uint8_t entries for 8, 24 and 32-bit images (palettes of
+ * palletized images), 65536 uint16_t entries for FIT_UINT16, FIT_RGB16 and FIT_RGBA16 images. Greyscale images use lutR,
+ * lutA is only used with an alpha channel. A NULL table leaves its channel unchanged.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ApplyLUTs(FIBITMAP *dib, const void *lutR, const void *lutG, const void *lutB, const void *lutA FI_DEFAULT(NULL));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_AdjustCurve(FIBITMAP *dib, uint8_t *LUT, FREE_IMAGE_COLOR_CHANNEL channel);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_AdjustGamma(FIBITMAP *dib, double gamma);
+/**
+ * Returns a copy of dib with the samples converted by a transfer function (see FREE_IMAGE_TRANSFER), e.g. to linearise sRGB
+ * images before resizing or compositing. Samples are normalized to [0, 1]; alpha channels are kept.
+ * 8-bit (including palettes), 24, 32-bit, FIT_UINT16, FIT_RGB16 and FIT_RGBA16 images use exact lookup tables and keep their type,
+ * FIT_FLOAT, FIT_RGBF and FIT_RGBAF images use polynomial approximations (relative error below 1e-6 for sRGB and HLG, 1e-4 for PQ).
+ * Returns NULL for other types.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertTransfer(FIBITMAP *dib, FREE_IMAGE_TRANSFER transfer);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_AdjustBrightness(FIBITMAP *dib, double percentage);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_AdjustContrast(FIBITMAP *dib, double percentage);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_Invert(FIBITMAP *dib);
@@ -1280,9 +2403,19 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_Invert(FIBITMAP *dib);
  * Returns histogram bounds in `minVal` and `maxVal`. Each chanel histogram is optionally returned in histR/histG/histB.
  * For RGB/RGBA color types optionally returns brightness histogram in histL.
  * For Complex images optionally returns Abs histrogram in histB.
+ * FIT_RGBAH images are binned as floats, palettized and 16-bit FIT_BITMAP images by their 24-bit colors.
+ * Pixels are counted by parallel bands of scanlines.
  */
 DLL_API FIBOOL DLL_CALLCONV FreeImage_MakeHistogram(FIBITMAP* dib, uint32_t binsNumber, void* minVal, void* maxVal, uint32_t* histR, uint32_t strideR FI_DEFAULT(1u),
 	uint32_t* histG FI_DEFAULT(NULL), uint32_t strideG  FI_DEFAULT(1u), uint32_t* histB FI_DEFAULT(NULL), uint32_t strideB  FI_DEFAULT(1u), uint32_t* histL FI_DEFAULT(NULL), uint32_t strideL FI_DEFAULT(1u));
+/**
+ * Compares b to the reference image a, both of the same size and type (greyscale, 24 or 32-bit, or any non-bitmap type).
+ * Channels are compared separately with samples normalized to [0, 1] (integer samples are divided by the range of their type,
+ * float samples are taken as is). Returns the metric over all channels and, when channels is not NULL, the metric of every
+ * channel (at most 4, red, green, blue, alpha order; real and imaginary parts for complex images).
+ * Returns -1 if the images can't be compared.
+ */
+DLL_API double DLL_CALLCONV FreeImage_ComputeMetric(FIBITMAP *a, FIBITMAP *b, FREE_IMAGE_METRIC metric, double *channels FI_DEFAULT(NULL));
 
 DLL_API int DLL_CALLCONV FreeImage_GetAdjustColorsLookupTable(uint8_t *LUT, double brightness, double contrast, double gamma, FIBOOL invert);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_AdjustColors(FIBITMAP *dib, double brightness, double contrast, double gamma, FIBOOL invert FI_DEFAULT(FALSE));
@@ -1296,21 +2429,80 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GetChannel(FIBITMAP *dib, FREE_IMAGE_CO
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SetChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GetComplexChannel(FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SetComplexChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel);
+/**
+ * Splits a 24- or 32-bit, RGB[A]16 or RGB[A]F image into FreeImage_GetChannelsNumber(dib) greyscale planes (8-bit, FIT_UINT16
+ * or FIT_FLOAT) in red, green, blue, alpha order, reading the image once.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SplitChannels(FIBITMAP *dib, FIBITMAP **planes);
+/**
+ * Interleaves 3 or 4 greyscale planes of the same size and type, in red, green, blue, alpha order, into a new 24- or 32-bit,
+ * RGB[A]16 or RGB[A]F image. Returns NULL if the planes do not match.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MergeChannels(FIBITMAP **planes, unsigned count);
 
 // copy / paste / composite routines
-DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Copy(FIBITMAP *dib, int left, int top, int right, int bottom);
+/**
+ * Copies the rectangle of dib into a new bitmap. With FI_COPY_VIEW, a view sharing the pixels of dib is returned
+ * instead when possible, dib must then outlive it.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Copy(FIBITMAP *dib, int left, int top, int right, int bottom, int flags FI_DEFAULT(FI_COPY_DEFAULT));
+/**
+ * Same as FreeImage_Copy, writing into dst, an already allocated image with the type and bit depth of src and the size of the rectangle.
+ * dst may wrap caller memory (see FreeImage_AllocateHeaderForBits). Returns FALSE if dst does not match.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_CopyInto(FIBITMAP *dst, FIBITMAP *src, int left, int top, int right, int bottom);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_Paste(FIBITMAP *dst, FIBITMAP *src, int left, int top, int alpha);
-DLL_API FIBITMAP *DLL_CALLCONV FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom);
+/**
+ * Creates a view sharing the pixels of the rectangle of dib (in stored pixel coordinates); dib must outlive the view.
+ * orientation (FIO_xxx flags) is applied on top of the orientation of dib, see FreeImage_GetOrientedLayout.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom, unsigned orientation FI_DEFAULT(FIO_NORMAL));
 
+/**
+ * Multiplies the colors of a 32-bit FIT_BITMAP, FIT_RGBA16 or FIT_RGBAF image with its alpha channel.
+ */
 DLL_API FIBOOL DLL_CALLCONV FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib);
+/**
+ * Divides the colors of a premultiplied 32-bit FIT_BITMAP, FIT_RGBA16 or FIT_RGBAF image by its alpha channel.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_UnPreMultiplyWithAlpha(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Composite(FIBITMAP *fg, FIBOOL useFileBkg FI_DEFAULT(FALSE), FIRGBA8 *appBkColor FI_DEFAULT(NULL), FIBITMAP *bg FI_DEFAULT(NULL));
 /**
  * Draws bitmap with specified alpha blending type
+ * Supports 32-bit FIT_BITMAP, FIT_RGBAF and FIT_RGBAH images of the same type. FIAO_SrcAlpha expects straight colors
+ * and keeps dst alpha, the other operations expect premultiplied colors (see FreeImage_PreMultiplyWithAlpha).
  * @param left X offset of top left corner of drawn bitmap
  * @param top Y offset of top left corner of drawn bitmap
  */
 DLL_API FIBOOL DLL_CALLCONV FreeImage_DrawBitmap(FIBITMAP* dst, FIBITMAP* src, FREE_IMAGE_ALPHA_OPERATION alpha, int32_t left FI_DEFAULT(0), int32_t top FI_DEFAULT(0));
 
+// pipelines of operations
+/**
+ * Creates an empty pipeline. Operations added by the FreeImage_Pipeline* functions are only recorded,
+ * FreeImage_ExecutePipeline applies them in order and gives the same result as the matching sequence of
+ * FreeImage_ConvertTo24Bits, FreeImage_ConvertTo32Bits, FreeImage_Rescale, FreeImage_AdjustCurve, FreeImage_AdjustColors,
+ * FreeImage_Invert, FreeImage_PreMultiplyWithAlpha and FreeImage_UnsharpMask calls.
+ */
+DLL_API FIPIPELINE *DLL_CALLCONV FreeImage_CreatePipeline(void);
+DLL_API void DLL_CALLCONV FreeImage_DeletePipeline(FIPIPELINE *pipeline);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PipelineConvertTo24Bits(FIPIPELINE *pipeline);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PipelineConvertTo32Bits(FIPIPELINE *pipeline);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PipelineRescale(FIPIPELINE *pipeline, int dst_width, int dst_height, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM));
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PipelineAdjustCurve(FIPIPELINE *pipeline, const uint8_t *LUT, FREE_IMAGE_COLOR_CHANNEL channel);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PipelineAdjustColors(FIPIPELINE *pipeline, double brightness, double contrast, double gamma, FIBOOL invert FI_DEFAULT(FALSE));
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PipelineInvert(FIPIPELINE *pipeline);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PipelinePreMultiplyWithAlpha(FIPIPELINE *pipeline);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PipelineUnsharpMask(FIPIPELINE *pipeline, double sigma, double amount);
+/**
+ * Returns a new image with the recorded operations applied to dib, dib is not modified; NULL if an operation does not apply.
+ * Point operations work on 24 or 32-bit images, so other sources must start with a conversion.
+ * Conversions and point operations up to the next rescale are fused: the image is streamed once in bands of
+ * a few rows, each band being converted and processed by all operations while it stays in the cache.
+ * Consecutive curves and inversions are composed into a single lookup per channel.
+ * Only a rescale or an unsharp mask needs its input as a full image.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ExecutePipeline(FIPIPELINE *pipeline, FIBITMAP *dib);
+
 // background filling routines
 DLL_API FIBOOL DLL_CALLCONV FreeImage_FillBackground(FIBITMAP *dib, const void *color, int options FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_EnlargeCanvas(FIBITMAP *src, int left, int top, int right, int bottom, const void *color, int options FI_DEFAULT(0));
@@ -1319,6 +2511,23 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_AllocateExT(FREE_IMAGE_TYPE type, int w
 
 // miscellaneous algorithms
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MultigridPoissonSolver(FIBITMAP *Laplacian, int ncycle FI_DEFAULT(3));
+/**
+ * Solves a Poisson equation whose Laplacian is a FIT_FLOAT image, with mirrored (Neumann) boundaries,
+ * by discrete cosine transforms. Returns the solution remapped to [0..1], of the size of the Laplacian.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_DCTPoissonSolver(FIBITMAP *Laplacian);
+/**
+ * Returns the 2D discrete Fourier transform (not normalized) of an 8-bit greyscale, FIT_UINT16, FIT_INT16, FIT_UINT32, FIT_INT32,
+ * FIT_FLOAT, FIT_DOUBLE, FIT_COMPLEX or FIT_COMPLEXF image, as a FIT_COMPLEXF image for FIT_FLOAT and FIT_COMPLEXF sources and
+ * a FIT_COMPLEX image otherwise. Frequency (0, 0) is the first pixel of the first scanline, spectra are not shifted.
+ * Any size is supported, powers of two are fastest. Rows and columns are transformed in double precision by parallel bands.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_FFT2D(FIBITMAP *src);
+/**
+ * Returns the inverse 2D discrete Fourier transform of a FIT_COMPLEX or FIT_COMPLEXF image, divided by the number of pixels,
+ * in the type of src. FreeImage_GetComplexChannel(FICC_REAL) extracts the real part of a transformed real image.
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_IFFT2D(FIBITMAP *src);
 
 /**
  * Finds pixels with min and max brightness.
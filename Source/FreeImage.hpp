@@ -11,7 +11,10 @@
 #define FREEIMAGE_HPP
 
 #include <cassert>
+#include <cstddef>
 #include <filesystem>
+#include <future>
+#include <iterator>
 #include <limits>
 #include <memory>
 #include <optional>
@@ -135,7 +138,8 @@ namespace fi
         eRgbF     = FIT_RGBF,
         eRgbaF    = FIT_RGBAF,
         eRgb32    = FIT_RGB32,
-        eRgba32   = FIT_RGBA32
+        eRgba32   = FIT_RGBA32,
+        eRgbaH    = FIT_RGBAH
     };
 
     enum class ColorType
@@ -247,7 +251,11 @@ namespace fi
 
     enum class AlphaOperation
     {
-        eSrcAlpha = FIAO_SrcAlpha
+        eSrcAlpha = FIAO_SrcAlpha,
+        eSrcOver = FIAO_SrcOver,
+        eMultiply = FIAO_Multiply,
+        eScreen = FIAO_Screen,
+        eAdd = FIAO_Add
     };
 
 
@@ -273,6 +281,141 @@ namespace fi
 #define FREEIMAGERE_CHECKED_CALL(Func_, ...) fi::ImageError::CheckedCall(#Func_, &::Func_, ##__VA_ARGS__)
 
 
+    /**
+     * Failure of a non-throwing call: the failed function and the last message of the library on the
+     * calling thread (see FreeImage_GetLastMessage). Nothing is allocated, message stays valid until the
+     * next message output on the thread.
+     */
+    struct Error
+    {
+        const char* function = "";
+        ImageFormat format = ImageFormat::eUnknown;
+        const char* message = "";
+
+        static
+        Error FromLastMessage(const char* function) noexcept
+        {
+            FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
+            const char* message = FreeImage_GetLastMessage(&fif);
+            return Error{ function, static_cast<ImageFormat>(fif), message };
+        }
+    };
+
+    /**
+     * Value or Error of a non-throwing call, after std::expected. Move-only
+     */
+    template <typename Ty_>
+    class Result
+    {
+    public:
+        Result(Ty_&& value) noexcept(std::is_nothrow_move_constructible_v<Ty_>)
+            : mValue(std::move(value))
+        { }
+
+        Result(const Error& error) noexcept
+            : mError(error)
+        { }
+
+        Result(const Result&) = delete;
+        Result(Result&&) = default;
+
+        Result& operator=(const Result&) = delete;
+        Result& operator=(Result&&) = default;
+
+        explicit
+        operator bool() const noexcept
+        {
+            return mValue.has_value();
+        }
+
+        bool HasValue() const noexcept
+        {
+            return mValue.has_value();
+        }
+
+        /**
+         * Returns the value, throws ImageError if the call failed
+         */
+        Ty_& Value() &
+        {
+            ThrowIfError_();
+            return *mValue;
+        }
+
+        Ty_&& Value() &&
+        {
+            ThrowIfError_();
+            return std::move(*mValue);
+        }
+
+        Ty_& operator*() & noexcept
+        {
+            return *mValue;
+        }
+
+        Ty_* operator->() noexcept
+        {
+            return &*mValue;
+        }
+
+        const Error& GetError() const noexcept
+        {
+            return mError;
+        }
+
+    private:
+        void ThrowIfError_() const
+        {
+            if (!mValue) {
+                throw ImageError(std::string("FreeImageRe: ") + mError.function + " failed. " + mError.message);
+            }
+        }
+
+        std::optional<Ty_> mValue;
+        Error mError;
+    };
+
+    /**
+     * Success or Error of a non-throwing call without value
+     */
+    template <>
+    class Result<void>
+    {
+    public:
+        Result() noexcept = default;
+
+        Result(const Error& error) noexcept
+            : mError(error), mFailed(true)
+        { }
+
+        Result(const Result&) = delete;
+        Result(Result&&) = default;
+
+        Result& operator=(const Result&) = delete;
+        Result& operator=(Result&&) = default;
+
+        explicit
+        operator bool() const noexcept
+        {
+            return !mFailed;
+        }
+
+        bool HasValue() const noexcept
+        {
+            return !mFailed;
+        }
+
+        const Error& GetError() const noexcept
+        {
+            return mError;
+        }
+
+    private:
+        Error mError;
+        bool mFailed = false;
+    };
+
+
     inline
     ImageFormat DetectFormat(const char* filename)
     {
@@ -577,6 +720,379 @@ namespace fi
 
 
 
+    /**
+     * Handle of an asynchronous load or save, allows cancelling it
+     */
+    class AsyncJob
+    {
+    public:
+        AsyncJob() = default;
+
+        explicit
+        AsyncJob(FIASYNCJOB* handle)
+            : mHandlePtr(handle, &::FreeImage_CloseAsync)
+        { }
+
+        void Cancel()
+        {
+            if (mHandlePtr) {
+                FreeImage_CancelAsync(mHandlePtr.get());
+            }
+        }
+
+        bool IsCompleted() const
+        {
+            return mHandlePtr && FreeImage_IsAsyncCompleted(mHandlePtr.get());
+        }
+
+        /**
+         * Waits for the completion, returns true if the file was loaded or saved
+         */
+        bool Wait()
+        {
+            return mHandlePtr && FreeImage_WaitAsync(mHandlePtr.get());
+        }
+
+    private:
+        std::unique_ptr<FIASYNCJOB, decltype(&::FreeImage_CloseAsync)> mHandlePtr{ nullptr, &::FreeImage_CloseAsync };
+    };
+
+
+    /**
+     * Memory budget of the calls made on this thread while the scope lives, see FreeImage_SetThreadMemoryBudget.
+     * Scopes don't nest: the thread has no budget after the scope.
+     */
+    class MemoryBudgetScope
+    {
+    public:
+        explicit
+        MemoryBudgetScope(uint64_t bytes)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_SetThreadMemoryBudget, bytes);
+        }
+
+        ~MemoryBudgetScope()
+        {
+            FreeImage_SetThreadMemoryBudget(0);
+        }
+
+        MemoryBudgetScope(const MemoryBudgetScope&) = delete;
+        MemoryBudgetScope& operator=(const MemoryBudgetScope&) = delete;
+    };
+
+
+    /**
+     * Operations recorded for Bitmap::Apply, see FreeImage_ExecutePipeline
+     */
+    class Pipeline
+    {
+    public:
+        Pipeline()
+            : mHandlePtr(FREEIMAGERE_CHECKED_CALL(FreeImage_CreatePipeline), &::FreeImage_DeletePipeline)
+        { }
+
+        Pipeline& ConvertTo24Bits()
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PipelineConvertTo24Bits, NativeHandle_());
+            return *this;
+        }
+
+        Pipeline& ConvertTo32Bits()
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PipelineConvertTo32Bits, NativeHandle_());
+            return *this;
+        }
+
+        Pipeline& Rescale(uint32_t dstWidth, uint32_t dstHeight, FilterType filter = FilterType::eCatmullRom)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PipelineRescale, NativeHandle_(), details::narrow_cast<int>(dstWidth), details::narrow_cast<int>(dstHeight), static_cast<FREE_IMAGE_FILTER>(filter));
+            return *this;
+        }
+
+        Pipeline& AdjustCurve(const uint8_t* lut, ColorChannel channel)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PipelineAdjustCurve, NativeHandle_(), lut, static_cast<FREE_IMAGE_COLOR_CHANNEL>(channel));
+            return *this;
+        }
+
+        Pipeline& AdjustColors(double brightness, double contrast, double gamma, bool invert = false)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PipelineAdjustColors, NativeHandle_(), brightness, contrast, gamma, invert);
+            return *this;
+        }
+
+        Pipeline& Invert()
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PipelineInvert, NativeHandle_());
+            return *this;
+        }
+
+        Pipeline& PreMultiplyWithAlpha()
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PipelinePreMultiplyWithAlpha, NativeHandle_());
+            return *this;
+        }
+
+        FIPIPELINE* NativeHandle_() const noexcept
+        {
+            return mHandlePtr.get();
+        }
+
+    private:
+        std::unique_ptr<FIPIPELINE, decltype(&::FreeImage_DeletePipeline)> mHandlePtr;
+    };
+
+
+    /**
+     * Typed 2D view of pixels, rows are GetPitch() bytes apart (negative for a flipped view).
+     * Row y is the scanline y of the bitmap, i.e. rows go from the bottom to the top unless flipped.
+     * Accessors don't check bounds (except debug asserts), so loops over rows compile down to pointer
+     * arithmetic and can be vectorised. A view doesn't own the pixels, it is valid while the bitmap is.
+     */
+    template <typename Pixel_>
+    class ImageView
+    {
+        using Byte_ = std::conditional_t<std::is_const_v<Pixel_>, const uint8_t, uint8_t>;
+    public:
+        using value_type = std::remove_const_t<Pixel_>;
+        using pointer = Pixel_*;
+        using reference = Pixel_&;
+
+        /**
+         * Pixels of one row
+         */
+        class Row
+        {
+        public:
+            Row(Pixel_* data, uint32_t width) noexcept
+                : mData(data), mWidth(width)
+            { }
+
+            Pixel_* begin() const noexcept
+            {
+                return mData;
+            }
+
+            Pixel_* end() const noexcept
+            {
+                return mData + mWidth;
+            }
+
+            Pixel_* data() const noexcept
+            {
+                return mData;
+            }
+
+            uint32_t size() const noexcept
+            {
+                return mWidth;
+            }
+
+            Pixel_& operator[](uint32_t x) const noexcept
+            {
+                assert(x < mWidth);
+                return mData[x];
+            }
+
+        private:
+            Pixel_* mData;
+            uint32_t mWidth;
+        };
+
+        class RowIterator
+        {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = Row;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = Row;
+
+            RowIterator(Byte_* bits, uint32_t width, std::ptrdiff_t pitch) noexcept
+                : mBits(bits), mWidth(width), mPitch(pitch)
+            { }
+
+            Row operator*() const noexcept
+            {
+                return Row(static_cast<Pixel_*>(static_cast<std::conditional_t<std::is_const_v<Pixel_>, const void*, void*>>(mBits)), mWidth);
+            }
+
+            Row operator[](difference_type n) const noexcept
+            {
+                return *(*this + n);
+            }
+
+            RowIterator& operator++() noexcept
+            {
+                mBits += mPitch;
+                return *this;
+            }
+
+            RowIterator operator++(int) noexcept
+            {
+                RowIterator tmp(*this);
+                ++*this;
+                return tmp;
+            }
+
+            RowIterator& operator--() noexcept
+            {
+                mBits -= mPitch;
+                return *this;
+            }
+
+            RowIterator operator--(int) noexcept
+            {
+                RowIterator tmp(*this);
+                --*this;
+                return tmp;
+            }
+
+            RowIterator& operator+=(difference_type n) noexcept
+            {
+                mBits += n * mPitch;
+                return *this;
+            }
+
+            RowIterator& operator-=(difference_type n) noexcept
+            {
+                mBits -= n * mPitch;
+                return *this;
+            }
+
+            friend RowIterator operator+(RowIterator it, difference_type n) noexcept
+            {
+                return it += n;
+            }
+
+            friend RowIterator operator-(RowIterator it, difference_type n) noexcept
+            {
+                return it -= n;
+            }
+
+            friend difference_type operator-(const RowIterator& lhs, const RowIterator& rhs) noexcept
+            {
+                return lhs.mPitch ? (lhs.mBits - rhs.mBits) / lhs.mPitch : 0;
+            }
+
+            friend bool operator==(const RowIterator& lhs, const RowIterator& rhs) noexcept
+            {
+                return lhs.mBits == rhs.mBits;
+            }
+
+            friend bool operator!=(const RowIterator& lhs, const RowIterator& rhs) noexcept
+            {
+                return lhs.mBits != rhs.mBits;
+            }
+
+            friend bool operator<(const RowIterator& lhs, const RowIterator& rhs) noexcept
+            {
+                return (rhs - lhs) > 0;
+            }
+
+        private:
+            Byte_* mBits;
+            uint32_t mWidth;
+            std::ptrdiff_t mPitch;
+        };
+
+        using iterator = RowIterator;
+
+        ImageView() = default;
+
+        ImageView(Byte_* bits, uint32_t width, uint32_t height, std::ptrdiff_t pitch) noexcept
+            : mBits(bits), mWidth(width), mHeight(height), mPitch(pitch)
+        { }
+
+        /**
+         * Read-only view of a mutable view
+         */
+        template <typename Other_, typename = std::enable_if_t<std::is_same_v<const Other_, Pixel_> && !std::is_const_v<Other_>>>
+        ImageView(const ImageView<Other_>& other) noexcept
+            : ImageView(other.GetBits(), other.GetWidth(), other.GetHeight(), other.GetPitch())
+        { }
+
+        Byte_* GetBits() const noexcept
+        {
+            return mBits;
+        }
+
+        uint32_t GetWidth() const noexcept
+        {
+            return mWidth;
+        }
+
+        uint32_t GetHeight() const noexcept
+        {
+            return mHeight;
+        }
+
+        std::ptrdiff_t GetPitch() const noexcept
+        {
+            return mPitch;
+        }
+
+        bool Empty() const noexcept
+        {
+            return !mBits || !mWidth || !mHeight;
+        }
+
+        Pixel_* GetRow(uint32_t y) const noexcept
+        {
+            assert(y < mHeight);
+            return static_cast<Pixel_*>(static_cast<std::conditional_t<std::is_const_v<Pixel_>, const void*, void*>>(mBits + static_cast<std::ptrdiff_t>(y) * mPitch));
+        }
+
+        Row operator[](uint32_t y) const noexcept
+        {
+            return Row(GetRow(y), mWidth);
+        }
+
+        Pixel_& operator()(uint32_t x, uint32_t y) const noexcept
+        {
+            assert(x < mWidth);
+            return GetRow(y)[x];
+        }
+
+        RowIterator begin() const noexcept
+        {
+            return RowIterator(mBits, mWidth, mPitch);
+        }
+
+        RowIterator end() const noexcept
+        {
+            return RowIterator(mBits + static_cast<std::ptrdiff_t>(mHeight) * mPitch, mWidth, mPitch);
+        }
+
+        /**
+         * View of the rectangle of width x height pixels starting at pixel (x, y)
+         */
+        ImageView SubView(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const noexcept
+        {
+            assert(x <= mWidth && width <= mWidth - x);
+            assert(y <= mHeight && height <= mHeight - y);
+            return ImageView(mBits + static_cast<std::ptrdiff_t>(y) * mPitch + static_cast<std::ptrdiff_t>(x) * sizeof(Pixel_), width, height, mPitch);
+        }
+
+        /**
+         * View of the same pixels with the rows in reverse order, e.g. top-down for a bitmap
+         */
+        ImageView Flipped() const noexcept
+        {
+            if (!mHeight) {
+                return *this;
+            }
+            return ImageView(mBits + static_cast<std::ptrdiff_t>(mHeight - 1) * mPitch, mWidth, mHeight, -mPitch);
+        }
+
+    private:
+        Byte_* mBits{};
+        uint32_t mWidth{};
+        uint32_t mHeight{};
+        std::ptrdiff_t mPitch{};
+    };
+
+
     class Bitmap
     {
         class BitmapDeleter;
@@ -755,6 +1271,24 @@ namespace fi
             return static_cast<std::add_const_t<Ty_>*>(static_cast<const void*>(GetScanLine(scanline)));
         }
 
+        /**
+         * Typed view of the pixels, the pixel size is checked once against the bpp of the bitmap
+         * (e.g. FIRGBA8 or RGBQUAD for 32-bit bitmaps, float for FIT_FLOAT). Throws ImageError if it differs.
+         */
+        template <typename Pixel_>
+        ImageView<Pixel_> View()
+        {
+            CheckPixelSize_(sizeof(Pixel_));
+            return ImageView<Pixel_>(GetBits(), GetWidth(), GetHeight(), GetPitch());
+        }
+
+        template <typename Pixel_>
+        ImageView<const Pixel_> View() const
+        {
+            CheckPixelSize_(sizeof(Pixel_));
+            return ImageView<const Pixel_>(FreeImage_GetConstBits(NativeHandle_()), GetWidth(), GetHeight(), GetPitch());
+        }
+
         ImageType GetImageType() const
         {
             return static_cast<ImageType>(FreeImage_GetImageType(NativeHandle_()));
@@ -820,6 +1354,11 @@ namespace fi
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ConvertToRGBAF, NativeHandle_()));
         }
 
+        Bitmap ConvertToRGBAH() const
+        {
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ConvertToRGBAH, NativeHandle_()));
+        }
+
         Bitmap ConvertToUINT16() const
         {
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ConvertToUINT16, NativeHandle_()));
@@ -880,9 +1419,9 @@ namespace fi
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_TmoReinhard05Ex, NativeHandle_(), intensity, contrast, adaptation, colorCorrection));
         }
 
-        Bitmap TmoFattal02(ToneMappingAlgorithm tmo, double colorSaturation = 0.5, double attenuation = 0.85) const
+        Bitmap TmoFattal02(ToneMappingAlgorithm tmo, double colorSaturation = 0.5, double attenuation = 0.85, FREE_IMAGE_POISSON_SOLVER solver = FIPS_MULTIGRID) const
         {
-            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_TmoFattal02, NativeHandle_(), colorSaturation, attenuation));
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_TmoFattal02Ex, NativeHandle_(), colorSaturation, attenuation, solver));
         }
 
         Bitmap TmoClamp(ToneMappingAlgorithm tmo, double maxValue = 0.0) const
@@ -980,6 +1519,12 @@ namespace fi
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_RotateEx, NativeHandle_(), angle, xShift, yShift, xOrigin, yOrigin, useMask));
         }
 
+        Bitmap AffineTransform(const double* matrix, FilterType filter = FilterType::eBilinear, const void* bkcolor = nullptr, uint32_t dstWidth = 0, uint32_t dstHeight = 0) const
+        {
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_AffineTransform, NativeHandle_(), matrix, static_cast<FREE_IMAGE_FILTER>(filter), bkcolor,
+                details::narrow_cast<int>(dstWidth), details::narrow_cast<int>(dstHeight)));
+        }
+
         Bitmap& FlipHorizontal()
         {
             FREEIMAGERE_CHECKED_CALL(FreeImage_FlipHorizontal, NativeHandle_());
@@ -1014,6 +1559,12 @@ namespace fi
             return *this;
         }
 
+        Bitmap& ApplyLUTs(const void* lutR, const void* lutG, const void* lutB, const void* lutA = nullptr)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_ApplyLUTs, NativeHandle_(), lutR, lutG, lutB, lutA);
+            return *this;
+        }
+
         Bitmap& AdjustGamma(double gamma)
         {
             FREEIMAGERE_CHECKED_CALL(FreeImage_AdjustGamma, NativeHandle_(), gamma);
@@ -1079,6 +1630,32 @@ namespace fi
             return FreeImage_SetChannel(NativeHandle_(), src.NativeHandle_(), static_cast<FREE_IMAGE_COLOR_CHANNEL>(channel));
         }
 
+        std::vector<Bitmap> SplitChannels() const
+        {
+            FIBITMAP* planes[4]{};
+            FREEIMAGERE_CHECKED_CALL(FreeImage_SplitChannels, NativeHandle_(), planes);
+            std::vector<Bitmap> res;
+            for (uint32_t c = 0; c < FreeImage_GetChannelsNumber(NativeHandle_()); ++c) {
+                res.emplace_back(planes[c]);
+            }
+            return res;
+        }
+
+        bool ExportTensor(const FITENSORDESC& desc, void* dst) const
+        {
+            return FreeImage_ExportTensor(NativeHandle_(), &desc, dst);
+        }
+
+        static
+        Bitmap MergeChannels(const std::vector<Bitmap>& planes)
+        {
+            FIBITMAP* handles[4]{};
+            for (size_t c = 0; c < planes.size() && c < 4; ++c) {
+                handles[c] = planes[c].NativeHandle_();
+            }
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_MergeChannels, handles, static_cast<unsigned>(planes.size())));
+        }
+
         Bitmap GetComplexChannel(ColorChannel channel) const
         {
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_GetComplexChannel, NativeHandle_(), static_cast<FREE_IMAGE_COLOR_CHANNEL>(channel)));
@@ -1089,9 +1666,9 @@ namespace fi
             return FreeImage_SetComplexChannel(NativeHandle_(), src.NativeHandle_(), static_cast<FREE_IMAGE_COLOR_CHANNEL>(channel));
         }
 
-        Bitmap Copy(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) const
+        Bitmap Copy(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, int flags = FI_COPY_DEFAULT) const
         {
-            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_Copy, NativeHandle_(), details::narrow_cast<int>(left), details::narrow_cast<int>(top), details::narrow_cast<int>(right), details::narrow_cast<int>(bottom)));
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_Copy, NativeHandle_(), details::narrow_cast<int>(left), details::narrow_cast<int>(top), details::narrow_cast<int>(right), details::narrow_cast<int>(bottom), flags));
         }
 
         bool Paste(const Bitmap& src, uint32_t left, uint32_t top, uint32_t alpha)
@@ -1099,9 +1676,19 @@ namespace fi
             return FreeImage_Paste(NativeHandle_(), src.NativeHandle_(), details::narrow_cast<int>(left), details::narrow_cast<int>(top), details::narrow_cast<int>(alpha));
         }
 
-        Bitmap CreateView(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
+        Bitmap CreateView(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t orientation = FIO_NORMAL)
+        {
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_CreateView, NativeHandle_(), details::narrow_cast<int>(left), details::narrow_cast<int>(top), details::narrow_cast<int>(right), details::narrow_cast<int>(bottom), orientation));
+        }
+
+        uint32_t GetOrientation() const
+        {
+            return FreeImage_GetOrientation(NativeHandle_());
+        }
+
+        Bitmap ApplyOrientation() const
         {
-            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_CreateView, NativeHandle_(), details::narrow_cast<int>(left), details::narrow_cast<int>(top), details::narrow_cast<int>(right), details::narrow_cast<int>(bottom)));
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ApplyOrientation, NativeHandle_()));
         }
 
         Bitmap& PreMultiplyWithAlpha()
@@ -1110,6 +1697,20 @@ namespace fi
             return *this;
         }
 
+        Bitmap& UnPreMultiplyWithAlpha()
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_UnPreMultiplyWithAlpha, NativeHandle_());
+            return *this;
+        }
+
+        /**
+         * Returns a new bitmap with the operations of the pipeline applied
+         */
+        Bitmap Apply(const Pipeline& pipeline) const
+        {
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ExecutePipeline, pipeline.NativeHandle_(), NativeHandle_()));
+        }
+
         Bitmap Composite(bool useFileBkg = false, const FIRGBA8* appBkColor = nullptr, const Bitmap* bg = nullptr) const
         {
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_Composite, NativeHandle_(), useFileBkg, const_cast<FIRGBA8*>(appBkColor), (bg ? bg->NativeHandle_() : nullptr)));
@@ -1159,6 +1760,108 @@ namespace fi
             return FreeImage_SaveToHandle(static_cast<FREE_IMAGE_FORMAT>(fif), NativeHandle_(), io, handle, flags);
         }
 
+        /**
+         * Non-throwing loads, failures return the Error with the last message of the library instead of throwing
+         */
+        static
+        Result<Bitmap> TryLoad(ImageFormat fif, const char* filename, int flags = 0) noexcept
+        {
+            if (fif == ImageFormat::eUnknown) {
+                return Error{ "FreeImage_Load", fif, "unknown format" };
+            }
+            FreeImage_ClearLastMessage();
+            return TryWrap_(FreeImage_Load(static_cast<FREE_IMAGE_FORMAT>(fif), filename, flags), "FreeImage_Load");
+        }
+
+        static
+        Result<Bitmap> TryLoad(ImageFormat fif, const wchar_t* filename, int flags = 0) noexcept
+        {
+            if (fif == ImageFormat::eUnknown) {
+                return Error{ "FreeImage_LoadU", fif, "unknown format" };
+            }
+            FreeImage_ClearLastMessage();
+            return TryWrap_(FreeImage_LoadU(static_cast<FREE_IMAGE_FORMAT>(fif), filename, flags), "FreeImage_LoadU");
+        }
+
+        static
+        Result<Bitmap> TryLoad(ImageFormat fif, const std::filesystem::path& filename, int flags = 0) noexcept
+        {
+            return TryLoad(fif, filename.c_str(), flags);
+        }
+
+        static
+        Result<Bitmap> TryLoad(ImageFormat fif, FreeImageIO* io, fi_handle handle, int flags = 0) noexcept
+        {
+            if (fif == ImageFormat::eUnknown) {
+                return Error{ "FreeImage_LoadFromHandle", fif, "unknown format" };
+            }
+            FreeImage_ClearLastMessage();
+            return TryWrap_(FreeImage_LoadFromHandle(static_cast<FREE_IMAGE_FORMAT>(fif), io, handle, flags), "FreeImage_LoadFromHandle");
+        }
+
+        Result<void> TrySave(ImageFormat fif, const char* filename, int flags = 0) const noexcept
+        {
+            FreeImage_ClearLastMessage();
+            return TryResult_(FreeImage_Save(static_cast<FREE_IMAGE_FORMAT>(fif), NativeHandle_(), filename, flags), "FreeImage_Save");
+        }
+
+        Result<void> TrySave(ImageFormat fif, const wchar_t* filename, int flags = 0) const noexcept
+        {
+            FreeImage_ClearLastMessage();
+            return TryResult_(FreeImage_SaveU(static_cast<FREE_IMAGE_FORMAT>(fif), NativeHandle_(), filename, flags), "FreeImage_SaveU");
+        }
+
+        Result<void> TrySave(ImageFormat fif, const std::filesystem::path& filename, int flags = 0) const noexcept
+        {
+            return TrySave(fif, filename.c_str(), flags);
+        }
+
+        Result<void> TrySave(ImageFormat fif, FreeImageIO* io, fi_handle handle, int flags = 0) const noexcept
+        {
+            FreeImage_ClearLastMessage();
+            return TryResult_(FreeImage_SaveToHandle(static_cast<FREE_IMAGE_FORMAT>(fif), NativeHandle_(), io, handle, flags), "FreeImage_SaveToHandle");
+        }
+
+        /**
+         * Loads a file on the library thread pool. The future throws ImageError if loading fails or is cancelled by job.
+         */
+        static
+        std::future<Bitmap> LoadAsync(ImageFormat fif, const std::filesystem::path& filename, int flags = 0, AsyncJob* job = nullptr)
+        {
+            auto promise = std::make_unique<std::promise<Bitmap>>();
+            auto future = promise->get_future();
+            FIASYNCJOB* handle = StartLoadAsync_(static_cast<FREE_IMAGE_FORMAT>(RequireKnownFormat(fif)), filename.c_str(), flags, &OnLoaded_, promise.get());
+            if (!handle) {
+                throw ImageError("Bitmap[LoadAsync]: failed to start loading");
+            }
+            // owned by the callback now
+            promise.release();
+            AsyncJob started(handle);
+            if (job) {
+                *job = std::move(started);
+            }
+            return future;
+        }
+
+        /**
+         * Saves a copy of the bitmap on the library thread pool, the future holds the save result
+         */
+        std::future<bool> SaveAsync(ImageFormat fif, const std::filesystem::path& filename, int flags = 0, AsyncJob* job = nullptr) const
+        {
+            auto promise = std::make_unique<std::promise<bool>>();
+            auto future = promise->get_future();
+            FIASYNCJOB* handle = StartSaveAsync_(static_cast<FREE_IMAGE_FORMAT>(RequireKnownFormat(fif)), NativeHandle_(), filename.c_str(), flags, &OnSaved_, promise.get());
+            if (!handle) {
+                throw ImageError("Bitmap[SaveAsync]: failed to start saving");
+            }
+            promise.release();
+            AsyncJob started(handle);
+            if (job) {
+                *job = std::move(started);
+            }
+            return future;
+        }
+
 
         /**
          * Returns native FIBIMAP handle and disabples ownership. Deleter won't be called.
@@ -1186,6 +1889,89 @@ namespace fi
     private:
         friend class MultiBitmap;
 
+        static
+        Result<Bitmap> TryWrap_(FIBITMAP* dib, const char* function) noexcept
+        {
+            if (!dib) {
+                return Error::FromLastMessage(function);
+            }
+            try {
+                // the bitmap is unloaded if the shared state can't be allocated
+                return Bitmap(dib);
+            }
+            catch (...) {
+                return Error{ function, ImageFormat::eUnknown, "out of memory" };
+            }
+        }
+
+        static
+        Result<void> TryResult_(FIBOOL success, const char* function) noexcept
+        {
+            if (!success) {
+                return Error::FromLastMessage(function);
+            }
+            return {};
+        }
+
+        void CheckPixelSize_(size_t size) const
+        {
+            if (!HasPixels() || (GetBPP() != size * 8)) {
+                throw ImageError("Bitmap[View]: pixel type doesn't match the bitmap");
+            }
+        }
+
+        static
+        FIASYNCJOB* StartLoadAsync_(FREE_IMAGE_FORMAT fif, const char* filename, int flags, FI_LoadCompletedProc callback, void* user_data)
+        {
+            return FreeImage_LoadAsync(fif, filename, flags, callback, user_data);
+        }
+
+        static
+        FIASYNCJOB* StartLoadAsync_(FREE_IMAGE_FORMAT fif, const wchar_t* filename, int flags, FI_LoadCompletedProc callback, void* user_data)
+        {
+            return FreeImage_LoadAsyncU(fif, filename, flags, callback, user_data);
+        }
+
+        static
+        FIASYNCJOB* StartSaveAsync_(FREE_IMAGE_FORMAT fif, FIBITMAP* dib, const char* filename, int flags, FI_SaveCompletedProc callback, void* user_data)
+        {
+            return FreeImage_SaveAsync(fif, dib, filename, flags, callback, user_data);
+        }
+
+        static
+        FIASYNCJOB* StartSaveAsync_(FREE_IMAGE_FORMAT fif, FIBITMAP* dib, const wchar_t* filename, int flags, FI_SaveCompletedProc callback, void* user_data)
+        {
+            return FreeImage_SaveAsyncU(fif, dib, filename, flags, callback, user_data);
+        }
+
+        static
+        void DLL_CALLCONV OnLoaded_(FIBITMAP* dib, void* user_data) noexcept
+        {
+            std::unique_ptr<std::promise<Bitmap>> promise(static_cast<std::promise<Bitmap>*>(user_data));
+            try {
+                if (dib) {
+                    promise->set_value(Bitmap(dib));
+                }
+                else {
+                    promise->set_exception(std::make_exception_ptr(ImageError("Bitmap[LoadAsync]: loading failed or was cancelled")));
+                }
+            }
+            catch (...) {
+                // the Bitmap took the ownership even if set_value failed
+            }
+        }
+
+        static
+        void DLL_CALLCONV OnSaved_(FIBOOL success, void* user_data) noexcept
+        {
+            std::unique_ptr<std::promise<bool>> promise(static_cast<std::promise<bool>*>(user_data));
+            try {
+                promise->set_value(success != FALSE);
+            }
+            catch (...) {
+            }
+        }
+
         class BitmapDeleter
         {
         public:
@@ -1404,6 +2190,16 @@ namespace fi
         virtual bool SupportsExportTypeProc(FREE_IMAGE_TYPE /*type*/) { return false; };
         virtual bool SupportsICCProfilesProc() { return false; };
         virtual bool SupportsNoPixelsProc() { return false; };
+        virtual bool GetImageInfoProc(FreeImageIO* /*io*/, fi_handle /*handle*/, FIIMAGEINFO* /*info*/, void* /*data*/) { return false; };
+        virtual uint32_t ConcurrencyProc() { return FIF_CONCURRENT_NONE; };
+
+        // Optional fast paths (see FreeImage_FIFSupportsFeature), used for the features SupportsFeatureProc reports
+        virtual bool SupportsFeatureProc(FREE_IMAGE_FEATURE /*feature*/) { return false; };
+        virtual FIBITMAP* LoadScaledProc(FreeImageIO* /*io*/, fi_handle /*handle*/, uint32_t /*max_width*/, uint32_t /*max_height*/, uint32_t /*flags*/, void* /*data*/) { return nullptr; };
+        virtual FIBITMAP* LoadRegionProc(FreeImageIO* /*io*/, fi_handle /*handle*/, uint32_t /*left*/, uint32_t /*top*/, uint32_t /*right*/, uint32_t /*bottom*/, uint32_t /*flags*/, void* /*data*/) { return nullptr; };
+        virtual void* OpenScanlineReaderProc(FreeImageIO* /*io*/, fi_handle /*handle*/, uint32_t /*flags*/, FIBITMAP** /*info*/) { return nullptr; };
+        virtual uint32_t ReadScanlinesProc(void* /*reader*/, uint8_t* /*bits*/, uint32_t /*count*/, uint32_t /*pitch*/) { return 0U; };
+        virtual void CloseScanlineReaderProc(void* /*reader*/) {};
     };
 
 
@@ -1429,6 +2225,14 @@ namespace fi
             static FIBOOL SupportsExportTypeProc(void* ctx, FREE_IMAGE_TYPE type) try { return unwrap(ctx).SupportsExportTypeProc(type); } catch (...) { return FALSE; };
             static FIBOOL SupportsICCProfilesProc(void* ctx) try { return unwrap(ctx).SupportsICCProfilesProc(); } catch (...) { return FALSE; };
             static FIBOOL SupportsNoPixelsProc(void* ctx) try { return unwrap(ctx).SupportsNoPixelsProc(); } catch (...) { return FALSE; };
+            static FIBOOL GetImageInfoProc(void* ctx, FreeImageIO* io, fi_handle handle, FIIMAGEINFO* info, void* data) try { return unwrap(ctx).GetImageInfoProc(io, handle, info, data); } catch (...) { return FALSE; };
+            static uint32_t ConcurrencyProc(void* ctx) try { return unwrap(ctx).ConcurrencyProc(); } catch (...) { return FIF_CONCURRENT_NONE; };
+            static FIBOOL SupportsFeatureProc(void* ctx, FREE_IMAGE_FEATURE feature) try { return unwrap(ctx).SupportsFeatureProc(feature); } catch (...) { return FALSE; };
+            static FIBITMAP* LoadScaledProc(void* ctx, FreeImageIO* io, fi_handle handle, uint32_t max_width, uint32_t max_height, uint32_t flags, void* data) try { return unwrap(ctx).LoadScaledProc(io, handle, max_width, max_height, flags, data); } catch (...) { return nullptr; };
+            static FIBITMAP* LoadRegionProc(void* ctx, FreeImageIO* io, fi_handle handle, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t flags, void* data) try { return unwrap(ctx).LoadRegionProc(io, handle, left, top, right, bottom, flags, data); } catch (...) { return nullptr; };
+            static void* OpenScanlineReaderProc(void* ctx, FreeImageIO* io, fi_handle handle, uint32_t flags, FIBITMAP** info) try { return unwrap(ctx).OpenScanlineReaderProc(io, handle, flags, info); } catch (...) { return nullptr; };
+            static uint32_t ReadScanlinesProc(void* ctx, void* reader, uint8_t* bits, uint32_t count, uint32_t pitch) try { return unwrap(ctx).ReadScanlinesProc(reader, bits, count, pitch); } catch (...) { return 0U; };
+            static void CloseScanlineReaderProc(void* ctx, void* reader) try { unwrap(ctx).CloseScanlineReaderProc(reader); } catch (...) { };
 
             static void DLL_CALLCONV ReleaseProc(void* ctx) {
                 delete static_cast<Plugin2Wrapper*>(ctx);
@@ -1457,6 +2261,14 @@ namespace fi
                 plugin->supports_icc_profiles_proc = &This::SupportsICCProfilesProc;
                 plugin->supports_no_pixels_proc = &This::SupportsNoPixelsProc;
                 plugin->release_proc = &This::ReleaseProc;
+                plugin->get_image_info_proc = &This::GetImageInfoProc;
+                plugin->concurrency_proc = &This::ConcurrencyProc;
+                plugin->supports_feature_proc = &This::SupportsFeatureProc;
+                plugin->load_scaled_proc = &This::LoadScaledProc;
+                plugin->load_region_proc = &This::LoadRegionProc;
+                plugin->open_scanline_reader_proc = &This::OpenScanlineReaderProc;
+                plugin->read_scanlines_proc = &This::ReadScanlinesProc;
+                plugin->close_scanline_reader_proc = &This::CloseScanlineReaderProc;
 
                 return TRUE;
             }
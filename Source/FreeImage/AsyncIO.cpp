@@ -0,0 +1,429 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "FreeImageIO.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+	/**
+	Shared state of one asynchronous load or save.
+	It is referenced by the FIASYNCJOB handle and by the pending task.
+	*/
+	struct AsyncJob
+	{
+		std::atomic<int> refs{ 2 };
+		std::atomic<bool> cancelled{ false };
+
+		std::mutex mutex;
+		std::condition_variable finished;
+		bool done{ false };
+		FIBOOL result{ FALSE };
+
+		void Complete(FIBOOL success) {
+			std::lock_guard<std::mutex> lock(mutex);
+			result = success;
+			done = true;
+			finished.notify_all();
+		}
+	};
+
+	void ReleaseJob(AsyncJob *job) {
+		if (job->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			delete job;
+		}
+	}
+
+	/**
+	File handle failing reads and writes once the job is cancelled, so that plugins stop early
+	*/
+	struct CancellableFile
+	{
+		FILE *file;
+		const std::atomic<bool> *cancelled;
+	};
+
+	unsigned DLL_CALLCONV
+	_CancellableReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+		auto *h = (CancellableFile*)handle;
+		if (h->cancelled->load(std::memory_order_relaxed)) {
+			return 0;
+		}
+		return (unsigned)fread(buffer, size, count, h->file);
+	}
+
+	unsigned DLL_CALLCONV
+	_CancellableWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+		auto *h = (CancellableFile*)handle;
+		if (h->cancelled->load(std::memory_order_relaxed)) {
+			return 0;
+		}
+		return (unsigned)fwrite(buffer, size, count, h->file);
+	}
+
+	int DLL_CALLCONV
+	_CancellableSeekProc(fi_handle handle, long offset, int origin) {
+		return fseek(((CancellableFile*)handle)->file, offset, origin);
+	}
+
+	long DLL_CALLCONV
+	_CancellableTellProc(fi_handle handle) {
+		return ftell(((CancellableFile*)handle)->file);
+	}
+
+	void SetCancellableIO(FreeImageIO *io) {
+		io->read_proc  = _CancellableReadProc;
+		io->seek_proc  = _CancellableSeekProc;
+		io->tell_proc  = _CancellableTellProc;
+		io->write_proc = _CancellableWriteProc;
+	}
+
+	template <typename Char_>
+	FILE* OpenFile(const std::basic_string<Char_>& filename, bool read) {
+#ifdef _WIN32
+		if constexpr (std::is_same_v<Char_, wchar_t>) {
+			return _wfopen(filename.c_str(), read ? L"rb" : L"wb");
+		}
+		else
+#endif
+		if constexpr (std::is_same_v<Char_, char>) {
+			return fopen(filename.c_str(), read ? "rb" : "wb");
+		}
+		else {
+			return nullptr;
+		}
+	}
+
+	template <typename Char_>
+	void RemoveFile(const std::basic_string<Char_>& filename) {
+#ifdef _WIN32
+		if constexpr (std::is_same_v<Char_, wchar_t>) {
+			_wremove(filename.c_str());
+		}
+		else
+#endif
+		if constexpr (std::is_same_v<Char_, char>) {
+			remove(filename.c_str());
+		}
+	}
+
+	/**
+	Runs task on the library thread pool, or on the calling thread if the pool is not running or has no workers
+	*/
+	FIASYNCJOB* StartJob(AsyncJob *job, std::function<void()> task) {
+		FIASYNCJOB *handle = nullptr;
+		try {
+			handle = new FIASYNCJOB{ job };
+			if (!ThreadPool::Instance().Submit(task)) {
+				task();
+			}
+			return handle;
+		}
+		catch (...) {
+			delete handle;
+			delete job;
+			FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+			return nullptr;
+		}
+	}
+
+	template <typename Char_>
+	FIASYNCJOB* LoadAsync(FREE_IMAGE_FORMAT fif, const Char_ *filename, int flags, FI_LoadCompletedProc callback, void *user_data) {
+		if (!filename || !callback) {
+			return nullptr;
+		}
+		AsyncJob *job = nullptr;
+		try {
+			job = new AsyncJob;
+			std::basic_string<Char_> path(filename);
+			return StartJob(job, [=, path = std::move(path)]() {
+				FIBITMAP *dib = nullptr;
+				if (!job->cancelled.load(std::memory_order_relaxed)) {
+					if (FILE *file = OpenFile(path, true)) {
+						FreeImageIO io;
+						SetCancellableIO(&io);
+						CancellableFile handle{ file, &job->cancelled };
+						dib = FreeImage_LoadFromHandle(fif, &io, (fi_handle)&handle, flags);
+						fclose(file);
+					} else {
+						FreeImage_OutputMessageProc((int)fif, "FreeImage_LoadAsync: failed to open input file");
+					}
+				}
+				if (dib && job->cancelled.load(std::memory_order_relaxed)) {
+					// the plugin might not have noticed the failing reads
+					FreeImage_Unload(dib);
+					dib = nullptr;
+				}
+				const FIBOOL success = dib ? TRUE : FALSE;
+				callback(dib, user_data);
+				job->Complete(success);
+				ReleaseJob(job);
+			});
+		}
+		catch (...) {
+			delete job;
+			FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+			return nullptr;
+		}
+	}
+
+	template <typename Char_>
+	FIASYNCJOB* SaveAsync(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const Char_ *filename, int flags, FI_SaveCompletedProc callback, void *user_data) {
+		if (!filename || !dib) {
+			return nullptr;
+		}
+		// pixels are shared copy-on-write, the caller can modify or unload dib right away
+		FIBITMAP *clone = FreeImage_Clone(dib);
+		if (!clone) {
+			return nullptr;
+		}
+		AsyncJob *job = nullptr;
+		try {
+			job = new AsyncJob;
+			std::basic_string<Char_> path(filename);
+			return StartJob(job, [=, path = std::move(path)]() {
+				FIBOOL success = FALSE;
+				if (!job->cancelled.load(std::memory_order_relaxed)) {
+					if (FILE *file = OpenFile(path, false)) {
+						FreeImageIO io;
+						SetCancellableIO(&io);
+						CancellableFile handle{ file, &job->cancelled };
+						success = FreeImage_SaveToHandle(fif, clone, &io, (fi_handle)&handle, flags);
+						fclose(file);
+						if (job->cancelled.load(std::memory_order_relaxed)) {
+							// don't leave a truncated file
+							RemoveFile(path);
+							success = FALSE;
+						}
+					} else {
+						FreeImage_OutputMessageProc((int)fif, "FreeImage_SaveAsync: failed to open output file");
+					}
+				}
+				FreeImage_Unload(clone);
+				if (callback) {
+					callback(success, user_data);
+				}
+				job->Complete(success);
+				ReleaseJob(job);
+			});
+		}
+		catch (...) {
+			delete job;
+			FreeImage_Unload(clone);
+			FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+			return nullptr;
+		}
+	}
+
+	AsyncJob* GetJob(FIASYNCJOB *handle) {
+		return handle ? static_cast<AsyncJob*>(handle->data) : nullptr;
+	}
+
+	// ----------------------------------------------------------
+
+	/**
+	Bytes of one file of a batch, read ahead by a pool task
+	*/
+	struct PrefetchedFile
+	{
+		std::vector<uint8_t> bytes;
+		bool loaded{ false };
+
+		std::mutex mutex;
+		std::condition_variable finished;
+		bool done{ false };
+
+		void Read(const char *filename) {
+			if (FILE *file = fopen(filename, "rb")) {
+				try {
+					// memory streams are limited to 4 GB
+					if (fseek(file, 0, SEEK_END) == 0) {
+						const long size = ftell(file);
+						if (size > 0 && (unsigned long)size <= UINT32_MAX && fseek(file, 0, SEEK_SET) == 0) {
+							bytes.resize((size_t)size);
+							loaded = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+						}
+					}
+				}
+				catch (const std::bad_alloc &) {
+					loaded = false;
+				}
+				fclose(file);
+			}
+			if (!loaded) {
+				std::vector<uint8_t>().swap(bytes);
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			done = true;
+			finished.notify_all();
+		}
+
+		void Wait() {
+			std::unique_lock<std::mutex> lock(mutex);
+			finished.wait(lock, [this] { return done; });
+		}
+	};
+
+	std::string GetLowerExtension(const char *filename) {
+		const char *place = strrchr(filename, '.');
+		std::string extension(place ? place + 1 : "");
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+		return extension;
+	}
+
+	/**
+	Detects the format of a file, trying last format found for the same extension first
+	*/
+	FREE_IMAGE_FORMAT DetectBatchFormat(FIMEMORY *stream, const std::string& extension, std::map<std::string, FREE_IMAGE_FORMAT>& formats) {
+		const auto cached = formats.find(extension);
+		// TIFF signatures are revalidated against RAW by the full detection
+		if (cached != formats.end() && cached->second != FIF_TIFF && FreeImage_ValidateFromMemory(cached->second, stream)) {
+			return cached->second;
+		}
+		const FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromMemory(stream, 0);
+		if (fif != FIF_UNKNOWN) {
+			formats[extension] = fif;
+		}
+		return fif;
+	}
+
+} // namespace
+
+
+// ==========================================================
+//   Public API
+// ==========================================================
+
+FIASYNCJOB * DLL_CALLCONV
+FreeImage_LoadAsync(FREE_IMAGE_FORMAT fif, const char *filename, int flags, FI_LoadCompletedProc callback, void *user_data) {
+	return LoadAsync(fif, filename, flags, callback, user_data);
+}
+
+FIASYNCJOB * DLL_CALLCONV
+FreeImage_LoadAsyncU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags, FI_LoadCompletedProc callback, void *user_data) {
+	return LoadAsync(fif, filename, flags, callback, user_data);
+}
+
+FIASYNCJOB * DLL_CALLCONV
+FreeImage_SaveAsync(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const char *filename, int flags, FI_SaveCompletedProc callback, void *user_data) {
+	return SaveAsync(fif, dib, filename, flags, callback, user_data);
+}
+
+FIASYNCJOB * DLL_CALLCONV
+FreeImage_SaveAsyncU(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const wchar_t *filename, int flags, FI_SaveCompletedProc callback, void *user_data) {
+	return SaveAsync(fif, dib, filename, flags, callback, user_data);
+}
+
+void DLL_CALLCONV
+FreeImage_CancelAsync(FIASYNCJOB *handle) {
+	if (AsyncJob *job = GetJob(handle)) {
+		job->cancelled.store(true, std::memory_order_relaxed);
+	}
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_IsAsyncCompleted(FIASYNCJOB *handle) {
+	if (AsyncJob *job = GetJob(handle)) {
+		std::lock_guard<std::mutex> lock(job->mutex);
+		return job->done ? TRUE : FALSE;
+	}
+	return FALSE;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_WaitAsync(FIASYNCJOB *handle) {
+	if (AsyncJob *job = GetJob(handle)) {
+		std::unique_lock<std::mutex> lock(job->mutex);
+		job->finished.wait(lock, [job] { return job->done; });
+		return job->result;
+	}
+	return FALSE;
+}
+
+void DLL_CALLCONV
+FreeImage_CloseAsync(FIASYNCJOB *handle) {
+	if (AsyncJob *job = GetJob(handle)) {
+		ReleaseJob(job);
+		delete handle;
+	}
+}
+
+unsigned DLL_CALLCONV
+FreeImage_LoadBatch(const char **filenames, unsigned count, int flags, FI_BatchLoadedProc callback, void *user_data) {
+	if (!filenames || !callback) {
+		return 0;
+	}
+
+	unsigned loaded = 0;
+	try {
+		// the next files are read by the pool while the current one is decoded
+		const unsigned window = std::max<unsigned>(2, FreeImage_GetThreadCount());
+		std::deque<std::shared_ptr<PrefetchedFile>> pending;
+		unsigned next = 0;
+		auto prefetch = [&]() {
+			auto file = std::make_shared<PrefetchedFile>();
+			const char *filename = filenames[next++];
+			pending.push_back(file);
+			if (!filename) {
+				file->Read("");
+			}
+			// waiting for pool tasks from a worker could deadlock
+			else if (ThreadPool::IsWorkerThread() || !ThreadPool::Instance().Submit([file, filename]() { file->Read(filename); })) {
+				file->Read(filename);
+			}
+		};
+
+		std::map<std::string, FREE_IMAGE_FORMAT> formats;
+		for (unsigned index = 0; index < count; ++index) {
+			while (next < count && pending.size() < window) {
+				prefetch();
+			}
+			std::shared_ptr<PrefetchedFile> file = std::move(pending.front());
+			pending.pop_front();
+			file->Wait();
+
+			FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
+			FIBITMAP *dib = nullptr;
+			if (file->loaded) {
+				if (FIMEMORY *stream = FreeImage_OpenMemory(file->bytes.data(), (uint32_t)file->bytes.size())) {
+					fif = DetectBatchFormat(stream, GetLowerExtension(filenames[index]), formats);
+					if (fif != FIF_UNKNOWN) {
+						dib = FreeImage_LoadFromMemory(fif, stream, flags);
+					}
+					FreeImage_CloseMemory(stream);
+				}
+			} else {
+				FreeImage_OutputMessageProc(FIF_UNKNOWN, "FreeImage_LoadBatch: failed to read file %s", filenames[index] ? filenames[index] : "(null)");
+			}
+			// release the bytes before the callback
+			file.reset();
+
+			if (dib) {
+				++loaded;
+			}
+			callback(index, fif, dib, user_data);
+		}
+		// nothing is left in flight since every prefetched file has been waited for
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return loaded;
+}
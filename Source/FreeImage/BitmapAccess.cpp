@@ -29,6 +29,8 @@
 #endif 
 
 #include <stdlib.h>
+#include <atomic>
+#include <mutex>
 #if defined(_WIN32) || defined(_WIN64) || defined(__MINGW32__)
 #include <malloc.h>
 #endif // _WIN32 || _WIN64 || __MINGW32__
@@ -37,6 +39,8 @@
 #include "FreeImageIO.h"
 #include "Utilities.h"
 #include "MapIntrospector.h"
+#include "MemoryBudget.h"
+#include "Trace.h"
 
 #include "../Metadata/FreeImageTag.h"
 
@@ -57,22 +61,211 @@ respectively, of each pixel. This is valid when used with 16 and 32-bits per pix
 //  Metadata definitions
 // ----------------------------------------------------------
 
-/** helper for map<key, value> where value is a pointer to a FreeImage tag */
-typedef std::map<std::string, FITAG*> TAGMAP;
+/**
+Tags of a metadata model, sorted by key.
+Tags are packed copies (see FreeImage_PackTag) allocated in an arena owned by the map, with their key interned in the arena :
+loading a model costs a few arena chunks instead of several allocations per tag. 
+The memory of replaced or removed tags is reclaimed with the map.
+*/
+class TAGMAP {
+public:
+	TAGMAP() = default;
+	TAGMAP(const TAGMAP&) = delete;
+	TAGMAP& operator=(const TAGMAP&) = delete;
+
+	~TAGMAP() {
+		clear();
+	}
+
+	size_t size() const {
+		return mEntries.size();
+	}
+
+	bool empty() const {
+		return mEntries.empty();
+	}
 
-/** helper for map<FREE_IMAGE_MDMODEL, TAGMAP*> */
-typedef std::map<int, TAGMAP*> METADATAMAP;
+	/// returns the tag at a position in key order
+	FITAG* at(size_t pos) const {
+		return mEntries[pos].tag;
+	}
+
+	/// returns the key of the tag at a position in key order
+	const char* keyAt(size_t pos) const {
+		return mEntries[pos].key;
+	}
+
+	/// returns the tag stored under key, NULL if there is none
+	FITAG* find(const char *key) const {
+		auto i = lowerBound(key);
+		return ((i != mEntries.end()) && (strcmp(i->key, key) == 0)) ? i->tag : nullptr;
+	}
+
+	/// stores a copy of a tag under key, replacing a previous tag, returns false if out of memory
+	bool set(const char *key, FITAG *tag) {
+		try {
+			void *block = allocate(FreeImage_GetPackedTagSize(tag));
+			FITAG *packed = FreeImage_PackTag(tag, block);
+			// intern the key : the packed key stays in the arena when the tag key is modified
+			const char *interned = FreeImage_GetTagKey(packed);
+			if (!interned || (strcmp(interned, key) != 0)) {
+				const size_t key_length = strlen(key) + 1;
+				auto *copy = static_cast<char*>(allocate(key_length));
+				memcpy(copy, key, key_length);
+				interned = copy;
+			}
+
+			auto i = lowerBound(key);
+			if ((i != mEntries.end()) && (strcmp(i->key, key) == 0)) {
+				FreeImage_DeleteTag(i->tag);
+				i->key = interned;
+				i->tag = packed;
+			} else {
+				mEntries.insert(i, { interned, packed });
+			}
+			return true;
+		}
+		catch (const std::bad_alloc &) {
+			return false;
+		}
+	}
+
+	/// removes the tag stored under key
+	void erase(const char *key) {
+		auto i = lowerBound(key);
+		if ((i != mEntries.end()) && (strcmp(i->key, key) == 0)) {
+			FreeImage_DeleteTag(i->tag);
+			mEntries.erase(i);
+		}
+	}
+
+	void clear() {
+		for (auto &i : mEntries) {
+			// packed tags only release the members modified after packing
+			FreeImage_DeleteTag(i.tag);
+		}
+		mEntries.clear();
+		mChunks.clear();
+		mCharge.Release();
+		mCursor = nullptr;
+		mAvailable = 0;
+		mChunkBytes = 0;
+	}
+
+	void swap(TAGMAP &other) noexcept {
+		mEntries.swap(other.mEntries);
+		mChunks.swap(other.mChunks);
+		mCharge.swap(other.mCharge);
+		std::swap(mCursor, other.mCursor);
+		std::swap(mAvailable, other.mAvailable);
+		std::swap(mChunkBytes, other.mChunkBytes);
+	}
+
+	/// returns the memory used by the entries and the arena
+	size_t memorySize() const {
+		return mEntries.capacity() * sizeof(Entry) + mChunks.capacity() * sizeof(mChunks[0]) + mChunkBytes;
+	}
+
+private:
+	struct Entry {
+		const char *key;
+		FITAG *tag;
+	};
+
+	/// largest arena chunk size, larger blocks get a chunk of their own
+	static constexpr size_t kChunkSize = 4096;
+
+	std::vector<Entry>::iterator lowerBound(const char *key) {
+		return std::lower_bound(mEntries.begin(), mEntries.end(), key, [](const Entry &entry, const char *k) {
+			return strcmp(entry.key, k) < 0;
+		});
+	}
+
+	std::vector<Entry>::const_iterator lowerBound(const char *key) const {
+		return const_cast<TAGMAP*>(this)->lowerBound(key);
+	}
+
+	/// allocates size bytes aligned on 8 bytes in the arena
+	void* allocate(size_t size) {
+		size = (size + 7) & ~(size_t)7;
+		if (size > kChunkSize / 4) {
+			mCharge.Add(size);
+			mChunks.emplace_back(new uint64_t[size / 8]);
+			mChunkBytes += size;
+			return mChunks.back().get();
+		}
+		if (size > mAvailable) {
+			// chunks grow with the arena, small models stay small
+			const size_t chunk = std::min(kChunkSize, std::max({ size, (size_t)256, mChunkBytes }));
+			mCharge.Add(chunk);
+			mChunks.emplace_back(new uint64_t[chunk / 8]);
+			mChunkBytes += chunk;
+			mCursor = reinterpret_cast<uint8_t*>(mChunks.back().get());
+			mAvailable = chunk;
+		}
+		void *block = mCursor;
+		mCursor += size;
+		mAvailable -= size;
+		return block;
+	}
+
+	std::vector<Entry> mEntries;
+	std::vector<std::unique_ptr<uint64_t[]>> mChunks;
+	MemoryCharge mCharge{ MemoryPool::eMetadata };	// chunks, counted in FreeImage_GetMemoryUsage
+	uint8_t *mCursor{};
+	size_t mAvailable{};
+	size_t mChunkBytes{};
+};
+
+/**
+Profile whose tags are parsed model by model, the first time each model is accessed (see FreeImage_DeferMetadata)
+*/
+struct DeferredProfile {
+	std::atomic<unsigned> refs{ 1 };
+	std::vector<uint8_t> profile;
+	FI_ParseMetadataProc parse{};
+};
+
+/**
+Tags of a metadata model.
+Models are shared by copy-on-write between bitmaps derived from each other (clones, converted or rescaled images),
+a private copy is made by the first modification.
+*/
+struct SharedTagMap {
+	std::atomic<unsigned> refs{ 1 };
+	TAGMAP tags;
+	/** profile the tags are still to be parsed from, NULL once they are */
+	std::atomic<DeferredProfile*> deferred{ nullptr };
+	/** profile the tags were read from, dropped when they are modified (see FreeImage_SetMetadataSource) */
+	std::vector<uint8_t> source;
+};
+
+/** helper for map<FREE_IMAGE_MDMODEL, SharedTagMap*> */
+typedef std::map<int, SharedTagMap*> METADATAMAP;
 
 /** helper for metadata iterator */
 FI_STRUCT (METADATAHEADER) { 
-	long pos;		//! current position when iterating the map
-	TAGMAP *tagmap;	//! pointer to the tag map
+	long pos;				//! current position when iterating the map
+	const TAGMAP *tagmap;	//! pointer to the tag map
 };
 
 // ----------------------------------------------------------
 //  FIBITMAP definition
 // ----------------------------------------------------------
 
+class BitmapPool;
+
+/**
+Pixels shared by copy-on-write clones.
+The block is the data block of the bitmap the pixels were allocated with, it is released with the last reference.
+Read-only pixels kept alive by an owner (see FreeImage_AllocateHeaderForSharedBits) have no block and are never written.
+*/
+struct SharedPixels {
+	std::atomic<unsigned> refs;
+	void *block;
+	std::shared_ptr<const void> owner;
+};
+
 /**
 FreeImage header structure
 */
@@ -101,7 +294,7 @@ FI_STRUCT (FREEIMAGEHEADER) {
 	/** space to hold ICC profile */
 	FIICCPROFILE iccProfile;
 
-	/** contains a list of metadata models attached to the bitmap */
+	/** contains a list of metadata models attached to the bitmap, allocated on first use */
 	METADATAMAP *metadata;
 
 	/** FALSE if the FIBITMAP only contains the header and no pixel data */
@@ -118,6 +311,18 @@ FI_STRUCT (FREEIMAGEHEADER) {
 	unsigned external_pitch;
 	//@}
 
+	/** pool owning the bitmap, NULL otherwise */
+	BitmapPool *pool;
+
+	/** pixels shared with clones, NULL if pixels are owned exclusively */
+	std::atomic<SharedPixels*> shared;
+
+	/** header block replaced by UnshareBits, released with the bitmap since other threads may still read through it */
+	void *retired;
+
+	/** how the stored pixels are displayed (FIO_xxx flags), see FreeImage_GetOrientedLayout */
+	unsigned orientation;
+
 	//uint8_t filler[1];			 // fill to 32-bit alignment
 };
 
@@ -140,33 +345,35 @@ FI_STRUCT (FREEIMAGERGBMASKS) {
 
 #if (defined(_WIN32) || defined(_WIN64)) && !defined(__MINGW32__)
 
-void* FreeImage_Aligned_Malloc(size_t amount, size_t alignment) {
-	assert(alignment == FIBITMAP_ALIGNMENT);
+static void* DLL_CALLCONV
+DefaultAlignedMalloc(size_t amount, size_t alignment, void* /*user_ctx*/) {
 	return _aligned_malloc(amount, alignment);
 }
 
-void FreeImage_Aligned_Free(void* mem) {
+static void DLL_CALLCONV
+DefaultAlignedFree(void* mem, void* /*user_ctx*/) {
 	_aligned_free(mem);
 }
 
 #elif defined (__MINGW32__)
 
-void* FreeImage_Aligned_Malloc(size_t amount, size_t alignment) {
-	assert(alignment == FIBITMAP_ALIGNMENT);
+static void* DLL_CALLCONV
+DefaultAlignedMalloc(size_t amount, size_t alignment, void* /*user_ctx*/) {
 	return __mingw_aligned_malloc (amount, alignment);
 }
 
-void FreeImage_Aligned_Free(void* mem) {
+static void DLL_CALLCONV
+DefaultAlignedFree(void* mem, void* /*user_ctx*/) {
 	__mingw_aligned_free (mem);
 }
 
 #else
 
-void* FreeImage_Aligned_Malloc(size_t amount, size_t alignment) {
-	assert(alignment == FIBITMAP_ALIGNMENT);
+static void* DLL_CALLCONV
+DefaultAlignedMalloc(size_t amount, size_t alignment, void* /*user_ctx*/) {
 	/*
 	In some rare situations, the malloc routines can return misaligned memory. 
-	The routine FreeImage_Aligned_Malloc allocates a bit more memory to do
+	The routine DefaultAlignedMalloc allocates a bit more memory to do
 	aligned writes.  Normally, it *should* allocate "alignment" extra memory and then writes
 	one dword back the true pointer.  But if the memory manager returns a
 	misaligned block that is less than a dword from the next alignment, 
@@ -182,17 +389,166 @@ void* FreeImage_Aligned_Malloc(size_t amount, size_t alignment) {
 	*/
 	void* mem_real = malloc(amount + 2 * alignment);
 	if (!mem_real) return nullptr;
-	char* mem_align = (char*)((unsigned long)(2 * alignment - (unsigned long)mem_real % (unsigned long)alignment) + (unsigned long)mem_real);
-	*((long*)mem_align - 1) = (long)mem_real;
+	char* mem_align = (char*)((uintptr_t)(2 * alignment - (uintptr_t)mem_real % (uintptr_t)alignment) + (uintptr_t)mem_real);
+	*((void**)mem_align - 1) = mem_real;
 	return mem_align;
 }
 
-void FreeImage_Aligned_Free(void* mem) {
-	free((void*)*((long*)mem - 1));
+static void DLL_CALLCONV
+DefaultAlignedFree(void* mem, void* /*user_ctx*/) {
+	free(*((void**)mem - 1));
+}
+
+/**
+Same as DefaultAlignedMalloc with zeroed memory, released by DefaultAlignedFree.
+Large blocks come from fresh pages of the system, which are only committed when first written.
+*/
+#define FREEIMAGE_HAS_ALIGNED_CALLOC 1
+
+static void*
+DefaultAlignedCalloc(size_t amount, size_t alignment) {
+	void* mem_real = calloc(1, amount + 2 * alignment);
+	if (!mem_real) return nullptr;
+	char* mem_align = (char*)((uintptr_t)(2 * alignment - (uintptr_t)mem_real % (uintptr_t)alignment) + (uintptr_t)mem_real);
+	*((void**)mem_align - 1) = mem_real;
+	return mem_align;
 }
 
 #endif // _WIN32 || _WIN64
 
+namespace {
+
+	/**
+	Allocator used for bitmaps storage, see FreeImage_SetAllocator
+	*/
+	struct Allocator
+	{
+		FI_MallocProc malloc_proc{ &DefaultAlignedMalloc };
+		FI_FreeProc free_proc{ &DefaultAlignedFree };
+		void* user_ctx{ nullptr };
+	};
+
+	/**
+	Bookkeeping stored right before each aligned block.
+	Every block remembers its allocator, so it is released properly even if the allocator was changed in between.
+	*/
+	struct AllocationPrefix
+	{
+		FI_FreeProc free_proc;
+		void* user_ctx;
+		void* block;
+		size_t size;		// requested amount, for the statistics
+		ThreadBudget* budget;	// budget charged with the block, see FreeImage_SetThreadMemoryBudget
+	};
+
+	static_assert(sizeof(AllocationPrefix) <= FIBITMAP_ALIGNMENT, "Allocation prefix must fit in the alignment padding");
+
+	std::mutex gAllocatorMutex;
+	Allocator gAllocator;
+
+	Allocator CurrentAllocator() {
+		std::lock_guard<std::mutex> lock(gAllocatorMutex);
+		return gAllocator;
+	}
+
+} // namespace
+
+void* FreeImage_Aligned_Malloc(size_t amount, size_t alignment) {
+	assert(alignment == FIBITMAP_ALIGNMENT);
+	if (amount > std::numeric_limits<size_t>::max() - alignment) {
+		return nullptr;
+	}
+	ThreadBudget* budget = AcquireThreadBudget();
+	if (!ReserveMemory(MemoryPool::eBitmap, amount, budget)) {
+		ReleaseThreadBudget(budget);
+		return nullptr;
+	}
+	const Allocator allocator = CurrentAllocator();
+	// one extra alignment block in front keeps the prefix without breaking the alignment
+	auto* block = static_cast<uint8_t*>(allocator.malloc_proc(amount + alignment, alignment, allocator.user_ctx));
+	if (!block) {
+		ReleaseMemory(MemoryPool::eBitmap, amount, budget);
+		ReleaseThreadBudget(budget);
+		return nullptr;
+	}
+	assert((uintptr_t)block % alignment == 0);
+	uint8_t* mem = block + alignment;
+	auto* prefix = reinterpret_cast<AllocationPrefix*>(mem) - 1;
+	prefix->free_proc = allocator.free_proc;
+	prefix->user_ctx  = allocator.user_ctx;
+	prefix->block     = block;
+	prefix->size      = amount;
+	prefix->budget    = budget;
+	TraceAllocated(amount);
+	return mem;
+}
+
+void* FreeImage_Aligned_Calloc(size_t amount, size_t alignment) {
+#ifdef FREEIMAGE_HAS_ALIGNED_CALLOC
+	assert(alignment == FIBITMAP_ALIGNMENT);
+	if (amount > std::numeric_limits<size_t>::max() - 3 * alignment) {
+		return nullptr;
+	}
+	const Allocator allocator = CurrentAllocator();
+	if (allocator.malloc_proc == &DefaultAlignedMalloc) {
+		ThreadBudget* budget = AcquireThreadBudget();
+		if (!ReserveMemory(MemoryPool::eBitmap, amount, budget)) {
+			ReleaseThreadBudget(budget);
+			return nullptr;
+		}
+		// the default allocator lets the system provide zeroed pages instead of writing them
+		auto* block = static_cast<uint8_t*>(DefaultAlignedCalloc(amount + alignment, alignment));
+		if (!block) {
+			ReleaseMemory(MemoryPool::eBitmap, amount, budget);
+			ReleaseThreadBudget(budget);
+			return nullptr;
+		}
+		uint8_t* mem = block + alignment;
+		auto* prefix = reinterpret_cast<AllocationPrefix*>(mem) - 1;
+		prefix->free_proc = &DefaultAlignedFree;
+		prefix->user_ctx  = nullptr;
+		prefix->block     = block;
+		prefix->size      = amount;
+		prefix->budget    = budget;
+		TraceAllocated(amount);
+		return mem;
+	}
+#endif
+	void* mem = FreeImage_Aligned_Malloc(amount, alignment);
+	if (mem) {
+		memset(mem, 0, amount);
+	}
+	return mem;
+}
+
+void FreeImage_Aligned_Free(void* mem) {
+	if (mem) {
+		const auto* prefix = static_cast<AllocationPrefix*>(mem) - 1;
+		TraceReleased(prefix->size);
+		ReleaseMemory(MemoryPool::eBitmap, prefix->size, prefix->budget);
+		ReleaseThreadBudget(prefix->budget);
+		prefix->free_proc(prefix->block, prefix->user_ctx);
+	}
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_SetAllocator(FI_MallocProc malloc_proc, FI_FreeProc free_proc, void* user_ctx) {
+	if (!malloc_proc != !free_proc) {
+		// both functions are required
+		return FALSE;
+	}
+	std::lock_guard<std::mutex> lock(gAllocatorMutex);
+	if (malloc_proc) {
+		gAllocator.malloc_proc = malloc_proc;
+		gAllocator.free_proc   = free_proc;
+		gAllocator.user_ctx    = user_ctx;
+	}
+	else {
+		gAllocator = Allocator{};
+	}
+	return TRUE;
+}
+
 // ----------------------------------------------------------
 //  FIBITMAP memory management
 // ----------------------------------------------------------
@@ -374,6 +730,9 @@ FreeImage_AllocateBitmap(FIBOOL header_only, uint8_t *ext_bits, unsigned ext_pit
 		case FIT_RGBAF:
 			bpp = 8 * sizeof(FIRGBAF);
 			break;
+		case FIT_RGBAH:
+			bpp = 8 * sizeof(FIRGBAH);
+			break;
 		default:
 			return nullptr;
 	}
@@ -400,15 +759,14 @@ FreeImage_AllocateBitmap(FIBOOL header_only, uint8_t *ext_bits, unsigned ext_pit
 			break;
 		}
 
-		bitmap->data = static_cast<uint8_t *>(FreeImage_Aligned_Malloc(dib_size * sizeof(uint8_t), FIBITMAP_ALIGNMENT));
+		// zeroed memory, pages of large images are not committed before they are written
+		bitmap->data = static_cast<uint8_t *>(FreeImage_Aligned_Calloc(dib_size * sizeof(uint8_t), FIBITMAP_ALIGNMENT));
 
 		if (!bitmap->data) {
 			break;
 		}
 		std::unique_ptr<void, decltype(&FreeImage_Aligned_Free)> safeData(bitmap->data, &FreeImage_Aligned_Free);
 
-		memset(bitmap->data, 0, dib_size);
-
 		// write out the FREEIMAGEHEADER
 
 		auto *fih = (FREEIMAGEHEADER *)bitmap->data;
@@ -428,13 +786,9 @@ FreeImage_AllocateBitmap(FIBOOL header_only, uint8_t *ext_bits, unsigned ext_pit
 		iccProfile->data = 0;
 		iccProfile->flags = 0;
 
-		// initialize metadata models list
+		// metadata models list is allocated on first use
 
-		fih->metadata = new(std::nothrow) METADATAMAP;
-
-		if (!fih->metadata) {
-			break;
-		}
+		fih->metadata = nullptr;
 
 		// initialize attached thumbnail
 
@@ -486,11 +840,554 @@ FreeImage_AllocateBitmap(FIBOOL header_only, uint8_t *ext_bits, unsigned ext_pit
 	return nullptr;
 }
 
+// ----------------------------------------------------------
+//  Copy-on-write pixels
+// ----------------------------------------------------------
+
+namespace {
+
+	/// Serializes sharing and unsharing of pixels
+	std::mutex gSharedPixelsMutex;
+
+} // namespace
+
+/**
+Returns the shared pixels of a bitmap with an extra reference, creating them for exclusively owned pixels
+*/
+static SharedPixels *
+AcquireSharedPixels(FIBITMAP *dib) {
+	std::lock_guard<std::mutex> lock(gSharedPixelsMutex);
+	auto *fih = (FREEIMAGEHEADER *)dib->data;
+	SharedPixels *shared = fih->shared.load(std::memory_order_acquire);
+	if (!shared) {
+		shared = new(std::nothrow) SharedPixels;
+		if (!shared) {
+			return nullptr;
+		}
+		shared->refs.store(1, std::memory_order_relaxed);
+		shared->block = dib->data;
+		fih->shared.store(shared, std::memory_order_release);
+	}
+	shared->refs.fetch_add(1, std::memory_order_relaxed);
+	return shared;
+}
+
+static void
+ReleaseSharedPixels(SharedPixels *shared) {
+	if (shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		if (!shared->owner) {
+			FreeImage_Aligned_Free(shared->block);
+		}
+		delete shared;
+	}
+}
+
+/**
+Releases the chain of header blocks retired by UnshareBits
+*/
+static void
+ReleaseRetiredBlocks(void *block) {
+	while (block) {
+		void *next = ((FREEIMAGEHEADER *)block)->retired;
+		FreeImage_Aligned_Free(block);
+		block = next;
+	}
+}
+
+/**
+Makes pixels of a bitmap exclusively owned, copying them if they are still used by other bitmaps.
+Only the data block is replaced, so the FIBITMAP handle stays valid.
+The header only block of a clone is retired rather than released, a reader which fetched it before the swap can still use it.
+*/
+static bool
+UnshareBits(FIBITMAP *dib) {
+	std::lock_guard<std::mutex> lock(gSharedPixelsMutex);
+	auto *fih = (FREEIMAGEHEADER *)dib->data;
+	SharedPixels *shared = fih->shared.load(std::memory_order_acquire);
+	if (!shared) {
+		// unshared by another thread
+		return true;
+	}
+	if (shared->refs.load(std::memory_order_acquire) == 1 && shared->block == dib->data) {
+		// the last user of its own pixels
+		fih->shared.store(nullptr, std::memory_order_release);
+		delete shared;
+		return true;
+	}
+	if ((shared->refs.load(std::memory_order_acquire) == 1) && !shared->owner) {
+		// the last user of pixels allocated by another bitmap, writing is safe
+		return true;
+	}
+
+	const unsigned width  = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned bpp    = FreeImage_GetBPP(dib);
+	const FIBOOL need_masks = FreeImage_HasRGBMasks(dib);
+
+	const size_t header_size = FreeImage_GetInternalImageSize(TRUE, width, height, bpp, need_masks);
+	const size_t dib_size = FreeImage_GetInternalImageSize(FALSE, width, height, bpp, need_masks);
+	if (dib_size == 0) {
+		return false;
+	}
+	auto *block = static_cast<uint8_t *>(FreeImage_Aligned_Malloc(dib_size, FIBITMAP_ALIGNMENT));
+	if (!block) {
+		return false;
+	}
+
+	// copy the header with palette and masks, then the pixels
+	memcpy(block, dib->data, header_size);
+	const uint8_t *src_bits = FreeImage_GetConstBits(dib);
+	const unsigned src_pitch = FreeImage_GetPitch(dib);
+	const unsigned line = FreeImage_GetLine(dib);
+	const unsigned dst_pitch = CalculatePitch(line);
+	for (unsigned y = 0; y < height; ++y) {
+		memcpy(block + header_size + (size_t)y * dst_pitch, src_bits + (size_t)y * src_pitch, line);
+	}
+
+	auto *new_fih = (FREEIMAGEHEADER *)block;
+	new_fih->external_bits = nullptr;
+	new_fih->external_pitch = 0;
+	new_fih->shared.store(nullptr, std::memory_order_relaxed);
+
+	void *old_block = dib->data;
+	if (shared->block != old_block) {
+		// header only block of a clone
+		new_fih->retired = old_block;
+	}
+	dib->data = block;
+	ReleaseSharedPixels(shared);
+	return true;
+}
+
+// ----------------------------------------------------------
+//  In-place pixel format change
+// ----------------------------------------------------------
+
+bool
+FreeImage_ReformatInPlace(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp, const std::function<void(uint8_t*, const uint8_t*)>& convert_line) {
+	if (!dib || FreeImage_HasRGBMasks(dib) || ((type == FIT_BITMAP) && (bpp == 16))) {
+		// RGB masks are not relocated
+		return false;
+	}
+
+	const unsigned width   = FreeImage_GetWidth(dib);
+	const unsigned height  = FreeImage_GetHeight(dib);
+	const unsigned src_bpp = FreeImage_GetBPP(dib);
+	const FIBOOL has_pixels = FreeImage_HasPixels(dib);
+
+	// pixels still used by clones are copied first
+	if (has_pixels && ((FREEIMAGEHEADER *)dib->data)->shared.load(std::memory_order_acquire)) {
+		if (!UnshareBits(dib)) {
+			return false;
+		}
+	}
+
+	auto *fih = (FREEIMAGEHEADER *)dib->data;
+	const bool external = (fih->external_bits != nullptr);
+
+	// the block must hold the new header, palette and pixels
+	const size_t src_header_size = FreeImage_GetInternalImageSize(TRUE, width, height, src_bpp, FALSE);
+	const size_t dst_header_size = FreeImage_GetInternalImageSize(TRUE, width, height, bpp, FALSE);
+	const unsigned dst_line = CalculateLine(width, bpp);
+	if (external) {
+		// user provided pixels keep their pitch
+		if ((dst_header_size > src_header_size) || (dst_line > fih->external_pitch)) {
+			return false;
+		}
+	}
+	else {
+		const size_t src_size = FreeImage_GetInternalImageSize(!has_pixels, width, height, src_bpp, FALSE);
+		const size_t dst_size = FreeImage_GetInternalImageSize(!has_pixels, width, height, bpp, FALSE);
+		if ((dst_size == 0) || (dst_size > src_size) || (CalculatePitch(dst_line) > FreeImage_GetPitch(dib))) {
+			return false;
+		}
+	}
+
+	if (has_pixels) {
+		// compact the scanlines from the first one, a destination line never overlaps a source line not yet converted
+		uint8_t *bits = FreeImage_GetBits(dib);
+		const unsigned src_pitch = FreeImage_GetPitch(dib);
+		const unsigned dst_pitch = external ? src_pitch : CalculatePitch(dst_line);
+		for (unsigned y = 0; y < height; ++y) {
+			convert_line(bits + (size_t)y * dst_pitch, bits + (size_t)y * src_pitch);
+		}
+		if (!external && (dst_header_size != src_header_size)) {
+			// make room for the new palette
+			memmove(static_cast<uint8_t *>(dib->data) + dst_header_size, bits, (size_t)dst_pitch * height);
+		}
+	}
+
+	fih->type = type;
+	fih->transparent = FALSE;
+	fih->transparency_count = 0;
+	memset(fih->transparent_table, 0xff, 256);
+
+	auto *bih = FreeImage_GetInfoHeader(dib);
+	bih->biCompression  = BI_RGB;
+	bih->biBitCount     = (uint16_t)bpp;
+	bih->biClrUsed      = CalculateUsedPaletteEntries(bpp);
+	bih->biClrImportant = bih->biClrUsed;
+
+	if (bpp == 8) {
+		// greyscale, as FreeImage_ConvertTo8Bits
+		CREATE_GREYSCALE_PALETTE(FreeImage_GetPalette(dib), 256);
+	}
+	return true;
+}
+
+// ----------------------------------------------------------
+//  Copy-on-write metadata
+// ----------------------------------------------------------
+
+static SharedTagMap *
+RetainTagMap(SharedTagMap *tagmap) {
+	tagmap->refs.fetch_add(1, std::memory_order_relaxed);
+	return tagmap;
+}
+
+static void
+ReleaseDeferredProfile(DeferredProfile *deferred) {
+	if (deferred->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete deferred;
+	}
+}
+
+static void
+ReleaseTagMap(SharedTagMap *tagmap) {
+	if (tagmap->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		if (auto *deferred = tagmap->deferred.load(std::memory_order_acquire)) {
+			ReleaseDeferredProfile(deferred);
+		}
+		delete tagmap;
+	}
+}
+
+/// serializes the parsing of deferred models, which may be shared by several bitmaps
+static std::mutex s_deferred_mutex;
+
+/**
+Parses the tags of a deferred model on its first access.
+The tags are parsed into a scratch bitmap then moved into the model : the model is logically unchanged 
+and may still be shared with other bitmaps.
+*/
+static void
+ParseDeferredTags(int model, SharedTagMap *tagmap) {
+	if (!tagmap->deferred.load(std::memory_order_acquire)) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(s_deferred_mutex);
+
+	auto *deferred = tagmap->deferred.load(std::memory_order_relaxed);
+	if (!deferred) {
+		// parsed by another thread
+		return;
+	}
+	if (FIBITMAP *scratch = FreeImage_AllocateHeader(TRUE, 1, 1, 8)) {
+		const auto &profile = deferred->profile;
+		if (deferred->parse(scratch, (FREE_IMAGE_MDMODEL)model, profile.data(), (unsigned)profile.size())) {
+			if (auto *metadata = ((FREEIMAGEHEADER *)scratch->data)->metadata) {
+				if (auto it{ metadata->find(model) }; it != metadata->end()) {
+					tagmap->tags.swap(it->second->tags);
+				}
+			}
+		}
+		FreeImage_Unload(scratch);
+	}
+	tagmap->deferred.store(nullptr, std::memory_order_release);
+	ReleaseDeferredProfile(deferred);
+}
+
+/**
+Releases all models of a metadata models list
+*/
+static void
+ClearMetadata(METADATAMAP *metadata) {
+	for (auto &i : *metadata) {
+		ReleaseTagMap(i.second);
+	}
+	metadata->clear();
+}
+
+/**
+Returns tags of a metadata model for reading, NULL if the model doesn't exist or has no tags
+*/
+static const TAGMAP *
+FindTagMap(FIBITMAP *dib, int model) {
+	if (const auto *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata) {
+		if (auto it{ metadata->find(model) }; it != metadata->end()) {
+			ParseDeferredTags(model, it->second);
+			if (!it->second->tags.empty()) {
+				return &it->second->tags;
+			}
+		}
+	}
+	return nullptr;
+}
+
+/**
+Returns the metadata models list of a bitmap, allocating it on first use
+*/
+static METADATAMAP *
+GetMetadataMap(FIBITMAP *dib) {
+	auto *fih = (FREEIMAGEHEADER *)dib->data;
+	if (!fih->metadata) {
+		fih->metadata = new(std::nothrow) METADATAMAP();
+	}
+	return fih->metadata;
+}
+
+/**
+Returns tags of a metadata model for writing.
+The model is created if it doesn't exist and copied if it is still shared with other bitmaps.
+*/
+static TAGMAP *
+GetWritableTagMap(FIBITMAP *dib, int model) {
+	try {
+		auto *metadata = GetMetadataMap(dib);
+		if (!metadata) {
+			return nullptr;
+		}
+		auto &tagmap = (*metadata)[model];
+		if (!tagmap) {
+			tagmap = new SharedTagMap();
+		}
+		ParseDeferredTags(model, tagmap);
+		if (tagmap->refs.load(std::memory_order_acquire) > 1) {
+			auto *copy = new SharedTagMap();
+			try {
+				for (size_t i = 0; i < tagmap->tags.size(); i++) {
+					if (!copy->tags.set(tagmap->tags.keyAt(i), tagmap->tags.at(i))) {
+						throw std::bad_alloc();
+					}
+				}
+			}
+			catch (...) {
+				ReleaseTagMap(copy);
+				throw;
+			}
+			ReleaseTagMap(tagmap);
+			tagmap = copy;
+		}
+		// the tags won't match their source profile anymore
+		tagmap->source = std::vector<uint8_t>();
+		return &tagmap->tags;
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+// ----------------------------------------------------------
+//  FIBITMAP pool
+// ----------------------------------------------------------
+
+/**
+Pool of recyclable bitmaps of the same type and size.
+Bitmaps are linked to the pool through FREEIMAGEHEADER::pool, so FreeImage_Unload hands them back.
+The pool is destroyed when it was deleted by the user and no bitmap is in use anymore.
+*/
+class BitmapPool
+{
+public:
+	BitmapPool(FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned capacity)
+		: mType(type), mWidth(width), mHeight(height), mBpp(bpp), mCapacity(capacity)
+	{ }
+
+	BitmapPool(const BitmapPool&) = delete;
+	BitmapPool& operator=(const BitmapPool&) = delete;
+
+	/**
+	Allocates the first bitmap and keeps its header as reference for resetting recycled bitmaps
+	*/
+	bool Init() {
+		FIBITMAP *dib = FreeImage_AllocateT(mType, mWidth, mHeight, mBpp);
+		if (!dib) {
+			return false;
+		}
+		const auto *begin = static_cast<const uint8_t*>(dib->data);
+		const uint8_t *end = FreeImage_GetBits(dib);
+		mHeaderImage.assign(begin, end);
+		((FREEIMAGEHEADER *)dib->data)->pool = this;
+		mFree.push_back(dib);
+		return true;
+	}
+
+	FIBITMAP* Acquire() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!mFree.empty()) {
+				FIBITMAP *dib = mFree.back();
+				mFree.pop_back();
+				++mOutstanding;
+				return dib;
+			}
+		}
+		FIBITMAP *dib = FreeImage_AllocateT(mType, mWidth, mHeight, mBpp);
+		if (dib) {
+			((FREEIMAGEHEADER *)dib->data)->pool = this;
+			std::lock_guard<std::mutex> lock(mMutex);
+			++mOutstanding;
+		}
+		return dib;
+	}
+
+	/**
+	Called by FreeImage_Unload. Returns true if the bitmap was taken back, false if it has to be released.
+	*/
+	bool Recycle(FIBITMAP *dib) {
+		bool keep = false;
+		bool destroy = false;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			--mOutstanding;
+			// bitmaps sharing pixels with clones are not reused
+			keep = !mDeleted && (mFree.size() < mCapacity) && !((FREEIMAGEHEADER *)dib->data)->shared.load(std::memory_order_acquire);
+			destroy = mDeleted && (mOutstanding == 0);
+		}
+		if (!keep) {
+			((FREEIMAGEHEADER *)dib->data)->pool = nullptr;
+			if (destroy) {
+				delete this;
+			}
+			return false;
+		}
+
+		Reset(dib);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFree.push_back(dib);
+		return true;
+	}
+
+	/**
+	Called by FreeImage_DeleteBitmapPool
+	*/
+	void Delete() {
+		std::vector<FIBITMAP*> unused;
+		bool destroy = false;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mDeleted = true;
+			unused.swap(mFree);
+			destroy = (mOutstanding == 0);
+		}
+		for (FIBITMAP *dib : unused) {
+			((FREEIMAGEHEADER *)dib->data)->pool = nullptr;
+			FreeImage_Unload(dib);
+		}
+		if (destroy) {
+			delete this;
+		}
+	}
+
+private:
+	~BitmapPool() = default;
+
+	/**
+	Releases attached data and restores the header, palette and masks of a fresh bitmap
+	*/
+	void Reset(FIBITMAP *dib) {
+		auto *fih = (FREEIMAGEHEADER *)dib->data;
+
+		if (fih->iccProfile.data) {
+			free(fih->iccProfile.data);
+		}
+
+		auto *metadata = fih->metadata;
+		if (metadata) {
+			ClearMetadata(metadata);
+		}
+
+		FreeImage_Unload(fih->thumbnail);
+
+		ReleaseRetiredBlocks(fih->retired);
+
+		memcpy(dib->data, mHeaderImage.data(), mHeaderImage.size());
+		fih->metadata = metadata;
+		fih->pool = this;
+	}
+
+	const FREE_IMAGE_TYPE mType;
+	const int mWidth;
+	const int mHeight;
+	const int mBpp;
+	const size_t mCapacity;
+
+	std::mutex mMutex;
+	std::vector<FIBITMAP*> mFree;
+	std::vector<uint8_t> mHeaderImage;
+	size_t mOutstanding{ 0 };
+	bool mDeleted{ false };
+};
+
+FIBITMAPPOOL * DLL_CALLCONV
+FreeImage_CreateBitmapPool(FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned capacity) {
+	try {
+		if (capacity == 0) {
+			return nullptr;
+		}
+		std::unique_ptr<FIBITMAPPOOL> handle(new FIBITMAPPOOL);
+		auto *pool = new BitmapPool(type, width, height, bpp, capacity);
+		if (!pool->Init()) {
+			pool->Delete();
+			return nullptr;
+		}
+		handle->data = pool;
+		return handle.release();
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void DLL_CALLCONV
+FreeImage_DeleteBitmapPool(FIBITMAPPOOL *pool) {
+	if (pool) {
+		static_cast<BitmapPool*>(pool->data)->Delete();
+		delete pool;
+	}
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_AllocateFromPool(FIBITMAPPOOL *pool) {
+	if (!pool) {
+		return nullptr;
+	}
+	try {
+		return static_cast<BitmapPool*>(pool->data)->Acquire();
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+// ----------------------------------------------------------
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_AllocateHeaderForBits(uint8_t *ext_bits, unsigned ext_pitch, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask) {
 	return FreeImage_AllocateBitmap(FALSE, ext_bits, ext_pitch, type, width, height, bpp, red_mask, green_mask, blue_mask);
 }
 
+FIBITMAP *
+FreeImage_AllocateHeaderForSharedBits(const uint8_t *bits, unsigned pitch, std::shared_ptr<const void> owner, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask) {
+	auto *shared = new(std::nothrow) SharedPixels;
+	if (!shared) {
+		return nullptr;
+	}
+	shared->refs.store(1, std::memory_order_relaxed);
+	shared->block = nullptr;
+	shared->owner = std::move(owner);
+
+	FIBITMAP *dib = FreeImage_AllocateBitmap(FALSE, const_cast<uint8_t *>(bits), pitch, type, width, height, bpp, red_mask, green_mask, blue_mask);
+	if (!dib) {
+		delete shared;
+		return nullptr;
+	}
+	((FREEIMAGEHEADER *)dib->data)->shared.store(shared, std::memory_order_release);
+	return dib;
+}
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_AllocateHeaderT(FIBOOL header_only, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask) {
 	return FreeImage_AllocateBitmap(header_only, nullptr, 0, type, width, height, bpp, red_mask, green_mask, blue_mask);
@@ -515,31 +1412,38 @@ void DLL_CALLCONV
 FreeImage_Unload(FIBITMAP *dib) {
 	if (dib) {	
 		if (dib->data) {
+			// return pooled bitmaps to their pool
+			if (auto *pool = ((FREEIMAGEHEADER *)dib->data)->pool) {
+				if (pool->Recycle(dib)) {
+					return;
+				}
+			}
+
 			// delete possible icc profile ...
 			if (FreeImage_GetICCProfile(dib)->data) {
 				free(FreeImage_GetICCProfile(dib)->data);
 			}
 
 			// delete metadata models
-			auto *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata;
-
-			for (auto &i : *metadata) {
-				if (auto *tagmap = i.second) {
-					for (auto &j : *tagmap) {
-						FreeImage_DeleteTag(j.second);
-					}
-
-					delete tagmap;
-				}
+			if (auto *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata) {
+				ClearMetadata(metadata);
+				delete metadata;
 			}
 
-			delete metadata;
-
 			// delete embedded thumbnail
 			FreeImage_Unload(FreeImage_GetThumbnail(dib));
 
 			// delete bitmap ...
-			FreeImage_Aligned_Free(dib->data);
+			ReleaseRetiredBlocks(((FREEIMAGEHEADER *)dib->data)->retired);
+			if (auto *shared = ((FREEIMAGEHEADER *)dib->data)->shared.load(std::memory_order_acquire)) {
+				// ... keeping the block with shared pixels alive for clones
+				if (shared->block != dib->data) {
+					FreeImage_Aligned_Free(dib->data);
+				}
+				ReleaseSharedPixels(shared);
+			} else {
+				FreeImage_Aligned_Free(dib->data);
+			}
 		}
 
 		free(dib);		// ... and the wrapper
@@ -568,18 +1472,34 @@ FreeImage_Clone(FIBITMAP *dib) {
 	// check whether this image has masks defined ...
 	FIBOOL need_masks = (bpp == 16 && type == FIT_BITMAP) ? TRUE : FALSE;
 
+	// pixels owned by the library are shared with the clone until one of them is modified,
+	// user provided pixel buffers are always copied
+	SharedPixels *shared = nullptr;
+	if (!header_only && (!ext_bits || ((FREEIMAGEHEADER *)dib->data)->shared.load(std::memory_order_acquire))) {
+		shared = AcquireSharedPixels(dib);
+		if (!shared) {
+			return nullptr;
+		}
+	}
+
 	// allocate a new dib
-	FIBITMAP *new_dib = FreeImage_AllocateHeaderT(header_only, type, width, height, bpp,
+	FIBITMAP *new_dib = shared
+		? FreeImage_AllocateHeaderForBits(const_cast<uint8_t*>(FreeImage_GetConstBits(dib)), FreeImage_GetPitch(dib), type, width, height, bpp,
+			FreeImage_GetRedMask(dib), FreeImage_GetGreenMask(dib), FreeImage_GetBlueMask(dib))
+		: FreeImage_AllocateHeaderT(header_only, type, width, height, bpp,
 			FreeImage_GetRedMask(dib), FreeImage_GetGreenMask(dib), FreeImage_GetBlueMask(dib));
 
+	if (!new_dib && shared) {
+		ReleaseSharedPixels(shared);
+	}
+
 	if (new_dib) {
 		// save ICC profile links
 		FIICCPROFILE *src_iccProfile = FreeImage_GetICCProfile(dib);
 		FIICCPROFILE *dst_iccProfile = FreeImage_GetICCProfile(new_dib);
 
-		// save metadata links
+		// save metadata link
 		auto *src_metadata = ((FREEIMAGEHEADER *)dib->data)->metadata;
-		auto *dst_metadata = ((FREEIMAGEHEADER *)new_dib->data)->metadata;
 
 		// calculate the size of the dst image
 		// align the palette and the pixels on a FIBITMAP_ALIGNMENT bytes alignment boundary
@@ -588,7 +1508,7 @@ FreeImage_Clone(FIBITMAP *dib) {
 		
 		// when using a user provided pixel buffer, force a 'header only' calculation		
 
-		size_t dib_size = FreeImage_GetInternalImageSize(header_only || ext_bits, width, height, bpp, need_masks);
+		size_t dib_size = FreeImage_GetInternalImageSize(header_only || ext_bits || shared, width, height, bpp, need_masks);
 
 		// copy the bitmap + internal pointers (remember to restore new_dib internal pointers later)
 		memcpy(new_dib->data, dib->data, dib_size);
@@ -596,8 +1516,8 @@ FreeImage_Clone(FIBITMAP *dib) {
 		// reset ICC profile link for new_dib
 		memset(dst_iccProfile, 0, sizeof(FIICCPROFILE));
 
-		// restore metadata link for new_dib
-		((FREEIMAGEHEADER *)new_dib->data)->metadata = dst_metadata;
+		// reset metadata link for new_dib
+		((FREEIMAGEHEADER *)new_dib->data)->metadata = nullptr;
 
 		// reset thumbnail link for new_dib
 		((FREEIMAGEHEADER *)new_dib->data)->thumbnail = nullptr;
@@ -606,29 +1526,34 @@ FreeImage_Clone(FIBITMAP *dib) {
 		((FREEIMAGEHEADER *)new_dib->data)->external_bits = nullptr;
 		((FREEIMAGEHEADER *)new_dib->data)->external_pitch = 0;
 
+		// clones never belong to a pool
+		((FREEIMAGEHEADER *)new_dib->data)->pool = nullptr;
+
+		// retired blocks stay with the source
+		((FREEIMAGEHEADER *)new_dib->data)->retired = nullptr;
+
+		// link shared pixels
+		if (shared) {
+			((FREEIMAGEHEADER *)new_dib->data)->external_bits = const_cast<uint8_t*>(FreeImage_GetConstBits(dib));
+			((FREEIMAGEHEADER *)new_dib->data)->external_pitch = FreeImage_GetPitch(dib);
+		}
+		((FREEIMAGEHEADER *)new_dib->data)->shared.store(shared, std::memory_order_release);
+
 		// copy possible ICC profile
 		FreeImage_CreateICCProfile(new_dib, src_iccProfile->data, src_iccProfile->size);
 		dst_iccProfile->flags = src_iccProfile->flags;
 
-		// copy metadata models
-		for (auto &i : *src_metadata) {
-			int model = i.first;
-
-			if (auto *src_tagmap = i.second) {
-				// create a metadata model
-				if (auto *dst_tagmap = new(std::nothrow) TAGMAP()) {
-					// fill the model
-					for (auto &j : *src_tagmap) {
-						std::string dst_key = j.first;
-						auto *dst_tag = FreeImage_CloneTag(j.second);
-
-						// assign key and tag value
-						(*dst_tagmap)[dst_key] = dst_tag;
+		// share metadata models
+		if (src_metadata && !src_metadata->empty()) {
+			if (auto *dst_metadata = new(std::nothrow) METADATAMAP()) {
+				try {
+					for (auto &i : *src_metadata) {
+						(*dst_metadata)[i.first] = RetainTagMap(i.second);
 					}
-
-					// assign model and tagmap
-					(*dst_metadata)[model] = dst_tagmap;
 				}
+				catch (...) {
+				}
+				((FREEIMAGEHEADER *)new_dib->data)->metadata = dst_metadata;
 			}
 		}
 
@@ -636,7 +1561,7 @@ FreeImage_Clone(FIBITMAP *dib) {
 		FreeImage_SetThumbnail(new_dib, FreeImage_GetThumbnail(dib));
 
 		// copy user provided pixel buffer (if any)
-		if (ext_bits) {
+		if (ext_bits && !shared) {
 			const unsigned pitch = FreeImage_GetPitch(dib);
 			const unsigned linesize = FreeImage_GetLine(dib);
 			for (unsigned y = 0; y < height; y++) {
@@ -653,8 +1578,8 @@ FreeImage_Clone(FIBITMAP *dib) {
 
 // ----------------------------------------------------------
 
-uint8_t * DLL_CALLCONV
-FreeImage_GetBits(FIBITMAP *dib) {
+const uint8_t * DLL_CALLCONV
+FreeImage_GetConstBits(FIBITMAP *dib) {
 	if (!FreeImage_HasPixels(dib)) {
 		return nullptr;
 	}
@@ -671,6 +1596,22 @@ FreeImage_GetBits(FIBITMAP *dib) {
 	return (uint8_t *)lp;
 }
 
+uint8_t * DLL_CALLCONV
+FreeImage_GetBits(FIBITMAP *dib) {
+	if (!FreeImage_HasPixels(dib)) {
+		return nullptr;
+	}
+
+	// writable access to shared pixels makes a private copy first
+	if (((FREEIMAGEHEADER *)dib->data)->shared.load(std::memory_order_acquire)) {
+		if (!UnshareBits(dib)) {
+			return nullptr;
+		}
+	}
+
+	return const_cast<uint8_t *>(FreeImage_GetConstBits(dib));
+}
+
 // ----------------------------------------------------------
 //  DIB information functions
 // ----------------------------------------------------------
@@ -739,6 +1680,7 @@ FreeImage_GetColorType2(FIBITMAP* dib, FIBOOL scan_alpha) {
 			case FIT_RGBA32:
 			case FIT_RGBA16:
 			case FIT_RGBAF:
+			case FIT_RGBAH:
 				if (icc_profile) {
 					if ((icc_profile->flags & FIICC_COLOR_IS_CMYK) == FIICC_COLOR_IS_CMYK) {
 						return FIC_CMYK;
@@ -991,6 +1933,7 @@ FreeImage_IsTransparent(FIBITMAP *dib) {
 				break;
 			case FIT_RGBA16:
 			case FIT_RGBAF:
+			case FIT_RGBAH:
 				return (((FreeImage_GetICCProfile(dib)->flags) & FIICC_COLOR_IS_CMYK) == FIICC_COLOR_IS_CMYK) ? FALSE : TRUE;
 			default:
 				break;
@@ -1169,6 +2112,66 @@ FreeImage_GetPitch(FIBITMAP *dib) {
 	return 0;
 }
 
+unsigned DLL_CALLCONV
+FreeImage_GetOrientation(FIBITMAP *dib) {
+	return dib ? ((FREEIMAGEHEADER *)dib->data)->orientation : FIO_NORMAL;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_SetOrientation(FIBITMAP *dib, unsigned orientation) {
+	if (!dib || (orientation & ~(FIO_FLIP_HORIZONTAL | FIO_FLIP_VERTICAL | FIO_TRANSPOSE))) {
+		return FALSE;
+	}
+	((FREEIMAGEHEADER *)dib->data)->orientation = orientation;
+	return TRUE;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_GetOrientedLayout(FIBITMAP *dib, unsigned *width, unsigned *height, uint8_t **origin, int *row_step, int *pixel_step) {
+	if (!FreeImage_HasPixels(dib)) {
+		return FALSE;
+	}
+	const unsigned orientation = FreeImage_GetOrientation(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	if ((bpp < 8) && (orientation & (FIO_FLIP_HORIZONTAL | FIO_TRANSPOSE))) {
+		// packed pixels can only be walked by rows
+		return FALSE;
+	}
+
+	const unsigned stored_width = FreeImage_GetWidth(dib);
+	const unsigned stored_height = FreeImage_GetHeight(dib);
+	uint8_t *top_left = FreeImage_GetScanLine(dib, stored_height - 1);
+	if (!top_left) {
+		return FALSE;
+	}
+
+	// stored rows are bottom-up, so walking down the image goes back one pitch
+	const ptrdiff_t stored_pixel = bpp / 8;
+	const ptrdiff_t stored_row = -static_cast<ptrdiff_t>(FreeImage_GetPitch(dib));
+
+	// the transposition exchanges the axes, then mirrors start from the far end of their axis
+	const bool transpose = (orientation & FIO_TRANSPOSE) != 0;
+	ptrdiff_t x_step = transpose ? stored_row : stored_pixel;
+	ptrdiff_t y_step = transpose ? stored_pixel : stored_row;
+	const unsigned display_width = transpose ? stored_height : stored_width;
+	const unsigned display_height = transpose ? stored_width : stored_height;
+	if (orientation & FIO_FLIP_HORIZONTAL) {
+		top_left += x_step * (ptrdiff_t)(display_width - 1);
+		x_step = -x_step;
+	}
+	if (orientation & FIO_FLIP_VERTICAL) {
+		top_left += y_step * (ptrdiff_t)(display_height - 1);
+		y_step = -y_step;
+	}
+
+	if (width) *width = display_width;
+	if (height) *height = display_height;
+	if (origin) *origin = top_left;
+	if (row_step) *row_step = (int)y_step;
+	if (pixel_step) *pixel_step = (int)x_step;
+	return TRUE;
+}
+
 unsigned DLL_CALLCONV
 FreeImage_GetColorsUsed(FIBITMAP *dib) {
 	return dib ? FreeImage_GetInfoHeader(dib)->biClrUsed : 0;
@@ -1252,6 +2255,7 @@ FreeImage_GetChannelsNumber(FIBITMAP* dib) {
 	case FIT_RGBA32:
 	case FIT_RGBA16:
 	case FIT_RGBAF:
+	case FIT_RGBAH:
 		return 4;
 
 	case FIT_COMPLEXF:
@@ -1274,12 +2278,7 @@ FreeImage_FindFirstMetadata(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, FITAG **tag
 	}
 
 	// get the metadata model
-	auto *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata;
-	TAGMAP *tagmap{};
-	if (auto it{ metadata->find(model) }; it != metadata->end()) {
-		tagmap = it->second;
-	}
-	if (tagmap) {
+	if (const TAGMAP *tagmap = FindTagMap(dib, model)) {
 		// allocate a handle
 		if (auto *handle = (FIMETADATA *)malloc(sizeof(FIMETADATA))) {
 			// calculate the size of a METADATAHEADER
@@ -1295,8 +2294,7 @@ FreeImage_FindFirstMetadata(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, FITAG **tag
 				mdh->tagmap = tagmap;
 
 				// get the first element
-				TAGMAP::iterator i = tagmap->begin();
-				*tag = i->second;
+				*tag = tagmap->at(0);
 
 				return handle;
 			}
@@ -1315,7 +2313,7 @@ FreeImage_FindNextMetadata(FIMETADATA *mdhandle, FITAG **tag) {
 	}
 
 	METADATAHEADER *mdh = (METADATAHEADER *)mdhandle->data;
-	TAGMAP *tagmap = mdh->tagmap;
+	const TAGMAP *tagmap = mdh->tagmap;
 
 	int current_pos = mdh->pos;
 	int mapsize     = (int)tagmap->size();
@@ -1323,8 +2321,7 @@ FreeImage_FindNextMetadata(FIMETADATA *mdhandle, FITAG **tag) {
 	if (current_pos < mapsize) {
 		// get the tag element at position pos
 
-		auto i{ std::next(tagmap->begin(), current_pos) };
-		*tag = i->second;
+		*tag = tagmap->at(current_pos);
 		mdh->pos++;
 		
 		return TRUE;
@@ -1350,38 +2347,34 @@ FreeImage_CloneMetadata(FIBITMAP *dst, FIBITMAP *src) {
 		return FALSE;
 	}
 
-	// get metadata links
+	// get metadata link
 	auto *src_metadata = ((FREEIMAGEHEADER *)src->data)->metadata;
-	auto *dst_metadata = ((FREEIMAGEHEADER *)dst->data)->metadata;
-
-	// copy metadata models, *except* the FIMD_ANIMATION model
-	for (auto &i : *src_metadata) {
-		int model = i.first;
-		if (model == (int)FIMD_ANIMATION) {
-			continue;
-		}
 
-		if (auto *src_tagmap = i.second) {
-			if (dst_metadata->find(model) != dst_metadata->end()) {
-				// destroy dst model
-				FreeImage_SetMetadata((FREE_IMAGE_MDMODEL)model, dst, nullptr, nullptr);
-			}
-
-			// create a metadata model
-			if (auto *dst_tagmap = new(std::nothrow) TAGMAP()) {
-				// fill the model
-				for (auto &j : *src_tagmap) {
-					std::string dst_key = j.first;
-					auto *dst_tag = FreeImage_CloneTag(j.second);
+	// share metadata models, *except* the FIMD_ANIMATION model
+	if (src_metadata && src != dst) {
+		try {
+			for (auto &i : *src_metadata) {
+				int model = i.first;
+				if (model == (int)FIMD_ANIMATION) {
+					continue;
+				}
 
-					// assign key and tag value
-					(*dst_tagmap)[dst_key] = dst_tag;
+				auto *dst_metadata = GetMetadataMap(dst);
+				if (!dst_metadata) {
+					return FALSE;
 				}
 
-				// assign model and tagmap
-				(*dst_metadata)[model] = dst_tagmap;
+				// replace dst model
+				auto &dst_tagmap = (*dst_metadata)[model];
+				if (dst_tagmap) {
+					ReleaseTagMap(dst_tagmap);
+				}
+				dst_tagmap = RetainTagMap(i.second);
 			}
 		}
+		catch (...) {
+			return FALSE;
+		}
 	}
 
 	// clone resolution 
@@ -1399,26 +2392,20 @@ FreeImage_SetMetadata(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key,
 		return FALSE;
 	}
 
-	TAGMAP *tagmap{};
-
-	// get the metadata model
-	auto *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata;
-	auto model_iterator = metadata->find(model);
-	if (model_iterator != metadata->end()) {
-		tagmap = model_iterator->second;
-	}
-
 	if (key) {
 
-		if (!tag && !tagmap) {
-			// remove a tag from an unknown tagmap, nothing to do
-			return TRUE;
+		if (!tag) {
+			// remove a tag from an unknown tagmap or an unknown tag, nothing to do
+			const TAGMAP *tagmap = FindTagMap(dib, model);
+			if (!tagmap || !tagmap->find(key)) {
+				return TRUE;
+			}
 		}
 
+		// get a private copy of the model, create it if this model doesn't exist
+		TAGMAP *tagmap = GetWritableTagMap(dib, model);
 		if (!tagmap) {
-			// this model, doesn't exist: create it 
-			tagmap = new(std::nothrow) TAGMAP();
-			(*metadata)[model] = tagmap;
+			return FALSE;
 		}
 		
 		if (tag) {
@@ -1453,31 +2440,24 @@ FreeImage_SetMetadata(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key,
 					break;
 			}
 
-			// delete existing tag
-			if (auto *old_tag = (*tagmap)[key]) {
-				FreeImage_DeleteTag(old_tag);
+			// store a copy of the tag, replacing an existing tag
+			if (!tagmap->set(key, tag)) {
+				FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+				return FALSE;
 			}
-
-			// create a new tag
-			(*tagmap)[key] = FreeImage_CloneTag(tag);
 		}
 		else {
 			// delete existing tag
-			if (auto i{ tagmap->find(key) }; i != tagmap->end()) {
-				FreeImage_DeleteTag(i->second);
-				tagmap->erase(i);
-			}
+			tagmap->erase(key);
 		}
 	}
 	else {
 		// destroy the metadata model
-		if (tagmap) {
-			for (auto &e : *tagmap) {
-				FreeImage_DeleteTag(e.second);
+		if (auto *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata) {
+			if (auto model_iterator = metadata->find(model); model_iterator != metadata->end()) {
+				ReleaseTagMap(model_iterator->second);
+				metadata->erase(model_iterator);
 			}
-
-			delete tagmap;
-			metadata->erase(model_iterator);
 		}
 	}
 
@@ -1493,16 +2473,9 @@ FreeImage_GetMetadata(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key,
 	*tag = nullptr;
 
 	// get the metadata model
-	auto *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata;
-	if (!metadata->empty()) {
-		if (auto model_iterator{ metadata->find(model) }; model_iterator != metadata->end() ) {
-			// this model exists : try to get the requested tag
-			auto *tagmap = model_iterator->second;
-			if (auto tag_iterator = tagmap->find(key); tag_iterator != tagmap->end() ) {
-				// get the requested tag
-				*tag = tag_iterator->second;
-			} 
-		}
+	if (const TAGMAP *tagmap = FindTagMap(dib, model)) {
+		// this model exists : try to get the requested tag
+		*tag = tagmap->find(key);
 	}
 
 	return (*tag) ? TRUE : FALSE;
@@ -1550,12 +2523,9 @@ FreeImage_GetMetadataCount(FREE_IMAGE_MDMODEL model, FIBITMAP *dib) {
 	}
 
 	// get the metadata model
-	auto *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata;
-	if (auto it{ metadata->find(model) }; it != metadata->end()) {
-		if (auto *tagmap = it->second) {
-			// get the tag count
-			return (unsigned)tagmap->size();
-		}
+	if (const TAGMAP *tagmap = FindTagMap(dib, model)) {
+		// get the tag count
+		return (unsigned)tagmap->size();
 	}
 
 	// this model, doesn't exist: return
@@ -1564,6 +2534,101 @@ FreeImage_GetMetadataCount(FREE_IMAGE_MDMODEL model, FIBITMAP *dib) {
 
 // ----------------------------------------------------------
 
+FIBOOL
+FreeImage_DeferMetadata(FIBITMAP *dib, const FREE_IMAGE_MDMODEL *models, unsigned count, const uint8_t *profile, unsigned length, FI_ParseMetadataProc parse) {
+	if (!dib || !models || !count || !profile || !parse) {
+		return FALSE;
+	}
+
+	auto *metadata = GetMetadataMap(dib);
+	if (!metadata) {
+		return FALSE;
+	}
+
+	// a model already holding tags is completed by an immediate parse
+	for (unsigned i = 0; i < count; i++) {
+		if (metadata->find(models[i]) != metadata->end()) {
+			return FALSE;
+		}
+	}
+
+	DeferredProfile *deferred{};
+	unsigned added = 0;
+	try {
+		deferred = new DeferredProfile();
+		deferred->profile.assign(profile, profile + length);
+		deferred->parse = parse;
+
+		for (; added < count; added++) {
+			auto *tagmap = new SharedTagMap();
+			deferred->refs.fetch_add(1, std::memory_order_relaxed);
+			tagmap->deferred.store(deferred, std::memory_order_relaxed);
+			try {
+				(*metadata)[models[added]] = tagmap;
+			}
+			catch (...) {
+				ReleaseTagMap(tagmap);
+				throw;
+			}
+		}
+		ReleaseDeferredProfile(deferred);
+		return TRUE;
+	}
+	catch (...) {
+		// remove the models deferred so far
+		for (unsigned i = 0; i < added; i++) {
+			if (auto it{ metadata->find(models[i]) }; it != metadata->end()) {
+				ReleaseTagMap(it->second);
+				metadata->erase(it);
+			}
+		}
+		if (deferred) {
+			ReleaseDeferredProfile(deferred);
+		}
+	}
+	return FALSE;
+}
+
+FIBOOL
+FreeImage_SetMetadataSource(FIBITMAP *dib, FREE_IMAGE_MDMODEL model, const uint8_t *profile, unsigned length) {
+	if (!dib || !profile || !length) {
+		return FALSE;
+	}
+	if (auto *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata) {
+		if (auto it{ metadata->find(model) }; it != metadata->end()) {
+			auto *tagmap = it->second;
+			// sources are attached by the loaders, before the model is shared
+			if ((tagmap->refs.load(std::memory_order_acquire) == 1) && !tagmap->tags.empty()) {
+				try {
+					tagmap->source.assign(profile, profile + length);
+					return TRUE;
+				}
+				catch (const std::bad_alloc &) {
+					FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+				}
+			}
+		}
+	}
+	return FALSE;
+}
+
+FIBOOL
+FreeImage_GetMetadataSource(FIBITMAP *dib, FREE_IMAGE_MDMODEL model, const uint8_t **profile, unsigned *length) {
+	if (!dib || !profile || !length) {
+		return FALSE;
+	}
+	if (const auto *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata) {
+		if (auto it{ metadata->find(model) }; (it != metadata->end()) && !it->second->source.empty()) {
+			*profile = it->second->source.data();
+			*length = (unsigned)it->second->source.size();
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+// ----------------------------------------------------------
+
 unsigned DLL_CALLCONV
 FreeImage_GetMemorySize(FIBITMAP *dib) {
 	if (!dib) {
@@ -1572,7 +2637,8 @@ FreeImage_GetMemorySize(FIBITMAP *dib) {
 	auto *header = (FREEIMAGEHEADER *)dib->data;
 	auto *bih = FreeImage_GetInfoHeader(dib);
 
-	FIBOOL header_only = !header->has_pixels || header->external_bits;
+	// pixels shared by copy-on-write clones are accounted in each of them, like metadata models
+	FIBOOL header_only = !header->has_pixels || (header->external_bits && !header->shared.load(std::memory_order_acquire));
 	FIBOOL need_masks = bih->biCompression == BI_BITFIELDS;
 	unsigned width = bih->biWidth;
 	unsigned height = bih->biHeight;
@@ -1594,7 +2660,7 @@ FreeImage_GetMemorySize(FIBITMAP *dib) {
 		size += FreeImage_GetMemorySize(header->thumbnail);
 	}
 
-	// add metadata size
+	// add metadata size, models shared with other bitmaps are accounted in each of them
 	auto *md = header->metadata;
 	if (!md) {
 		return (unsigned)size;
@@ -1608,25 +2674,24 @@ FreeImage_GetMemorySize(FIBITMAP *dib) {
 		return (unsigned)size;
 	}
 
-	unsigned tags = 0;
+	const DeferredProfile *last_deferred{};
 
 	for (auto &i : *md) {
 		if (auto *tm = i.second) {
-			for (auto &j : *tm) {
-				++tags;
-				const std::string & key = j.first;
-				size += key.capacity();
-				size += FreeImage_GetTagMemorySize(j.second);
+			size += tm->tags.memorySize() + tm->source.capacity();
+			// add profiles not parsed yet, once for the models sharing them
+			const auto *deferred = tm->deferred.load(std::memory_order_acquire);
+			if (deferred && (deferred != last_deferred)) {
+				size += sizeof(DeferredProfile) + deferred->profile.capacity();
+				last_deferred = deferred;
 			}
 		}
 	}
 
-	// add size of all TAGMAP instances
-	size += models * sizeof(TAGMAP);
+	// add size of all SharedTagMap instances
+	size += models * sizeof(SharedTagMap);
 	// add size of tree nodes in METADATAMAP
 	size += MapIntrospector<METADATAMAP>::GetNodesMemorySize(models);
-	// add size of tree nodes in TAGMAP
-	size += MapIntrospector<TAGMAP>::GetNodesMemorySize(tags);
 
 	return (unsigned)size;
 }
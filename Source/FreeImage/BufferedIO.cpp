@@ -0,0 +1,225 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "FreeImageIO.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <memory>
+#include <new>
+
+
+namespace {
+
+	/// Buffer size of FreeImage_LoadFromHandle, 0 if disabled
+	std::atomic<unsigned> gLoadBuffering{ 0 };
+
+	/// Buffer size of the codec stream managers
+	std::atomic<unsigned> gStreamBufferSize{ 4096 };
+
+	struct BufferedStream
+	{
+		FreeImageIO io;
+		fi_handle handle;
+		std::unique_ptr<uint8_t[]> buffer;
+		unsigned capacity;
+		long window_start;		// stream position of buffer[0]
+		unsigned window_length;	// valid bytes in buffer
+		long position;			// position seen by the reader
+		long stream_position;	// position of the underlying stream, -1 if unknown
+	};
+
+	BufferedStream* ToStream(fi_handle handle) {
+		return (BufferedStream*)((FIBUFFEREDIO*)handle)->data;
+	}
+
+	bool SyncStream(BufferedStream *s) {
+		if (s->stream_position != s->position) {
+			if (s->io.seek_proc(s->handle, s->position, SEEK_SET) != 0) {
+				s->stream_position = -1;
+				return false;
+			}
+			s->stream_position = s->position;
+		}
+		return true;
+	}
+
+	unsigned DLL_CALLCONV
+	_BufferedReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+		BufferedStream *s = ToStream(handle);
+		const unsigned long long total = (unsigned long long)size * count;
+		auto *dst = (uint8_t*)buffer;
+		unsigned long long copied = 0;
+
+		while (copied < total) {
+			// bytes already in the window
+			if (s->position >= s->window_start && s->position - s->window_start < (long)s->window_length) {
+				const unsigned offset = (unsigned)(s->position - s->window_start);
+				const unsigned n = (unsigned)std::min<unsigned long long>(s->window_length - offset, total - copied);
+				memcpy(dst + copied, s->buffer.get() + offset, n);
+				copied += n;
+				s->position += (long)n;
+				continue;
+			}
+			if (!SyncStream(s)) {
+				break;
+			}
+			const unsigned long long remaining = total - copied;
+			if (remaining >= s->capacity) {
+				// large reads go straight to the caller buffer
+				const unsigned n = s->io.read_proc(dst + copied, 1, (unsigned)std::min<unsigned long long>(remaining, UINT_MAX), s->handle);
+				copied += n;
+				s->position += (long)n;
+				s->stream_position = s->position;
+				if (n == 0) {
+					break;
+				}
+				continue;
+			}
+			const unsigned n = s->io.read_proc(s->buffer.get(), 1, s->capacity, s->handle);
+			s->window_start = s->position;
+			s->window_length = n;
+			s->stream_position = s->position + (long)n;
+			if (n == 0) {
+				break;
+			}
+		}
+		return size ? (unsigned)(copied / size) : 0;
+	}
+
+	unsigned DLL_CALLCONV
+	_BufferedWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+		BufferedStream *s = ToStream(handle);
+		if (!SyncStream(s)) {
+			return 0;
+		}
+		// the window might hold overwritten bytes
+		s->window_length = 0;
+		const unsigned n = s->io.write_proc(buffer, size, count, s->handle);
+		s->position += (long)((unsigned long long)n * size);
+		s->stream_position = s->position;
+		return n;
+	}
+
+	int DLL_CALLCONV
+	_BufferedSeekProc(fi_handle handle, long offset, int origin) {
+		BufferedStream *s = ToStream(handle);
+		switch (origin) {
+			case SEEK_SET:
+				if (offset < 0) {
+					return -1;
+				}
+				s->position = offset;
+				return 0;
+			case SEEK_CUR:
+				if (s->position + offset < 0) {
+					return -1;
+				}
+				s->position += offset;
+				return 0;
+			default: {
+				// only the underlying stream knows its end
+				const int result = s->io.seek_proc(s->handle, offset, origin);
+				if (result == 0) {
+					s->position = s->stream_position = s->io.tell_proc(s->handle);
+				} else {
+					s->stream_position = -1;
+				}
+				return result;
+			}
+		}
+	}
+
+	long DLL_CALLCONV
+	_BufferedTellProc(fi_handle handle) {
+		return ToStream(handle)->position;
+	}
+
+} // namespace
+
+
+unsigned
+GetLoadBuffering(const FreeImageIO *io) {
+	const unsigned buffer_size = gLoadBuffering.load(std::memory_order_relaxed);
+	if (!buffer_size || !io) {
+		return 0;
+	}
+	// FILE streams have their own buffer, memory streams don't need one
+	FreeImageIO library_io;
+	SetDefaultIO(&library_io);
+	if (io->read_proc == library_io.read_proc) {
+		return 0;
+	}
+	SetMemoryIO(&library_io);
+	if (io->read_proc == library_io.read_proc || io->read_proc == _BufferedReadProc) {
+		return 0;
+	}
+	return buffer_size;
+}
+
+// =====================================================================
+// Buffered IO functions
+// =====================================================================
+
+FIBUFFEREDIO * DLL_CALLCONV
+FreeImage_CreateBufferedIO(FreeImageIO *io, fi_handle handle, unsigned buffer_size, FreeImageIO *buffered_io) {
+	if (!io || !buffered_io || !io->read_proc || !io->seek_proc || !io->tell_proc) {
+		return nullptr;
+	}
+	try {
+		std::unique_ptr<BufferedStream> s(new BufferedStream);
+		s->io = *io;
+		s->handle = handle;
+		s->capacity = std::max(buffer_size, 16u);
+		s->buffer.reset(new uint8_t[s->capacity]);
+		// unseekable streams don't tell their position, count from where they are
+		const long position = io->tell_proc(handle);
+		s->position = s->stream_position = s->window_start = std::max(position, 0L);
+		s->window_length = 0;
+
+		auto *stream = new FIBUFFEREDIO;
+		stream->data = s.release();
+
+		buffered_io->read_proc  = _BufferedReadProc;
+		buffered_io->write_proc = _BufferedWriteProc;
+		buffered_io->seek_proc  = _BufferedSeekProc;
+		buffered_io->tell_proc  = _BufferedTellProc;
+		return stream;
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return nullptr;
+}
+
+void DLL_CALLCONV
+FreeImage_CloseBufferedIO(FIBUFFEREDIO *stream) {
+	if (stream) {
+		auto *s = (BufferedStream*)stream->data;
+		// leave the underlying stream where the reader stopped
+		SyncStream(s);
+		delete s;
+		delete stream;
+	}
+}
+
+void DLL_CALLCONV
+FreeImage_SetLoadBuffering(unsigned buffer_size) {
+	gLoadBuffering.store(buffer_size, std::memory_order_relaxed);
+}
+
+void DLL_CALLCONV
+FreeImage_SetStreamBufferSize(unsigned buffer_size) {
+	gStreamBufferSize.store(std::max(buffer_size, 512u), std::memory_order_relaxed);
+}
+
+unsigned DLL_CALLCONV
+FreeImage_GetStreamBufferSize() {
+	return gStreamBufferSize.load(std::memory_order_relaxed);
+}
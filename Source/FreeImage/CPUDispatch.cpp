@@ -0,0 +1,169 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "CPUDispatch.h"
+#include <mutex>
+#include <vector>
+
+#if FREEIMAGE_SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+namespace {
+
+	/// Serializes tables filling
+	std::mutex gDispatchMutex;
+
+	std::vector<CPUDispatch::SelectKernels>& Fillers() {
+		static std::vector<CPUDispatch::SelectKernels> fillers;
+		return fillers;
+	}
+
+#if FREEIMAGE_SIMD_X86
+
+	void Cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuidex(info, (int)leaf, (int)subleaf);
+		for (int i = 0; i < 4; ++i) {
+			regs[i] = (unsigned)info[i];
+		}
+#else
+		if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3])) {
+			regs[0] = regs[1] = regs[2] = regs[3] = 0;
+		}
+#endif
+	}
+
+	/// Returns registers state enabled by the OS
+	unsigned long long Xgetbv() {
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned lo, hi;
+		__asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+		return ((unsigned long long)hi << 32) | lo;
+#endif
+	}
+
+	uint32_t DetectFeatures() {
+		uint32_t features = FI_CPU_NONE;
+		unsigned regs[4];
+
+		Cpuid(0, 0, regs);
+		const unsigned max_leaf = regs[0];
+		if (max_leaf < 1) {
+			return features;
+		}
+
+		Cpuid(1, 0, regs);
+		if (regs[3] & (1u << 26)) {
+			features |= FI_CPU_SSE2;
+		}
+		if (regs[2] & (1u << 9)) {
+			features |= FI_CPU_SSSE3;
+		}
+		if (regs[2] & (1u << 19)) {
+			features |= FI_CPU_SSE41;
+		}
+
+		// AVX registers have to be saved by the OS
+		const bool osxsave = (regs[2] & (1u << 27)) != 0;
+		const bool avx = (regs[2] & (1u << 28)) != 0;
+		const bool f16c = (regs[2] & (1u << 29)) != 0;
+		if (!osxsave || !avx) {
+			return features;
+		}
+		const unsigned long long xcr0 = Xgetbv();
+		if ((xcr0 & 0x6) != 0x6) {
+			return features;
+		}
+		if (f16c) {
+			features |= FI_CPU_F16C;
+		}
+		if (max_leaf < 7) {
+			return features;
+		}
+
+		Cpuid(7, 0, regs);
+		if (regs[1] & (1u << 5)) {
+			features |= FI_CPU_AVX2;
+		}
+		const unsigned avx512 = (1u << 16) | (1u << 30) | (1u << 31);	// F, BW, VL
+		if ((regs[1] & avx512) == avx512 && (xcr0 & 0xE0) == 0xE0) {
+			features |= FI_CPU_AVX512;
+		}
+		return features;
+	}
+
+#elif FREEIMAGE_SIMD_NEON
+
+	uint32_t DetectFeatures() {
+		// NEON is part of the compiler target
+		return FI_CPU_NEON;
+	}
+
+#else
+
+	uint32_t DetectFeatures() {
+		return FI_CPU_NONE;
+	}
+
+#endif
+
+} // namespace
+
+
+CPUDispatch& CPUDispatch::Instance()
+{
+	static CPUDispatch instance;
+	return instance;
+}
+
+CPUDispatch::CPUDispatch()
+	: mDetected(DetectFeatures()), mEnabled(mDetected)
+{ }
+
+void CPUDispatch::SetFeaturesMask(uint32_t mask)
+{
+	std::lock_guard<std::mutex> lock(gDispatchMutex);
+	const uint32_t features = mDetected & mask;
+	mEnabled.store(features, std::memory_order_release);
+	for (auto select : Fillers()) {
+		select(features);
+	}
+}
+
+void CPUDispatch::Register(SelectKernels select)
+{
+	std::lock_guard<std::mutex> lock(gDispatchMutex);
+	Fillers().push_back(select);
+	select(mEnabled.load(std::memory_order_acquire));
+}
+
+
+// ==========================================================
+//   Public API
+// ==========================================================
+
+uint32_t DLL_CALLCONV
+FreeImage_GetCPUFeatures() {
+	return CPUDispatch::Instance().GetFeatures();
+}
+
+void DLL_CALLCONV
+FreeImage_SetCPUFeatures(uint32_t mask) {
+	try {
+		CPUDispatch::Instance().SetFeaturesMask(mask);
+	}
+	catch (...) {
+	}
+}
@@ -0,0 +1,96 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_CPU_DISPATCH_H_
+#define FREEIMAGE_CPU_DISPATCH_H_
+
+#include "FreeImage.h"
+#include <atomic>
+
+// ----------------------------------------------------------
+//  Instruction sets available to SIMD kernels
+// ----------------------------------------------------------
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FREEIMAGE_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define FREEIMAGE_SIMD_X86 0
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define FREEIMAGE_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define FREEIMAGE_SIMD_NEON 0
+#endif
+
+#if FREEIMAGE_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+// enables instructions beyond the compiler target in one function, it must be called only if the CPU supports them
+#define FI_TARGET(isa) __attribute__((target(isa)))
+#else
+#define FI_TARGET(isa)
+#endif
+
+/**
+Runtime selection of SIMD kernels.
+CPU features are detected once (FreeImage_Initialise or first use), kernels modules register a callback
+filling their function pointers tables for the enabled features. Callbacks run again when the features are
+restricted by FreeImage_SetCPUFeatures, so tables entries have to be atomic.
+*/
+class CPUDispatch
+{
+public:
+	using SelectKernels = void (*)(uint32_t features);
+
+	static CPUDispatch& Instance();
+
+	/**
+	Returns FI_CPU_* features supported by the CPU (and the OS)
+	*/
+	uint32_t GetDetectedFeatures() const {
+		return mDetected;
+	}
+
+	/**
+	Returns FI_CPU_* features used by kernels
+	*/
+	uint32_t GetFeatures() const {
+		return mEnabled.load(std::memory_order_acquire);
+	}
+
+	/**
+	Restricts kernels to the features in mask and refills all tables
+	*/
+	void SetFeaturesMask(uint32_t mask);
+
+	/**
+	Adds a tables filler and calls it with the current features
+	*/
+	void Register(SelectKernels select);
+
+	CPUDispatch(const CPUDispatch&) = delete;
+	CPUDispatch& operator=(const CPUDispatch&) = delete;
+
+private:
+	CPUDispatch();
+	~CPUDispatch() = default;
+
+	const uint32_t mDetected;
+	std::atomic<uint32_t> mEnabled;
+};
+
+/**
+Registers a kernels tables filler during static initialization of a translation unit
+*/
+struct CPUDispatchRegistrar
+{
+	explicit CPUDispatchRegistrar(CPUDispatch::SelectKernels select) {
+		CPUDispatch::Instance().Register(select);
+	}
+};
+
+#endif // FREEIMAGE_CPU_DISPATCH_H_
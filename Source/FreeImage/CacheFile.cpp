@@ -25,17 +25,47 @@
 #pragma warning (disable : 4786) // identifier was truncated to 'number' characters
 #endif 
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
 #include "CacheFile.h"
 
+#include <atomic>
+
+// ----------------------------------------------------------
+
+namespace {
+
+	/// Memory budget of the page caches, in bytes
+	std::atomic<unsigned> gCacheSize{ 2 * 1024 * 1024 };
+
+	/// Number of blocks carved from a slab
+	const size_t SLAB_BLOCKS = 8;
+
+	/// Position of a block in the cache file
+	uint64_t blockOffset(unsigned nr) {
+		return (uint64_t)(nr - 1) * BLOCK_SIZE;
+	}
+
+} // namespace
+
 // ----------------------------------------------------------
 
 CacheFile::CacheFile() :
-m_file{},
-m_free_pages(),
-m_page_cache_mem(),
-m_page_cache_disk(),
-m_page_map(),
-m_page_count(0),
+m_file(-1),
+m_pages(1),
+m_slab_charge(MemoryPool::eCache),
+m_lru_head(-1),
+m_lru_tail(-1),
+m_mem_blocks(0),
+m_max_mem_blocks(0),
 m_current_block{},
 m_keep_in_memory(TRUE) {
 }
@@ -47,14 +77,20 @@ CacheFile::~CacheFile() {
 FIBOOL
 CacheFile::open(const std::string& filename, FIBOOL keep_in_memory) {
 
-  assert(!m_file);
+  assert(m_file == -1);
 
   m_filename = filename;
   m_keep_in_memory = keep_in_memory;
+  m_max_mem_blocks = std::max<size_t>(gCacheSize.load(std::memory_order_relaxed) / BLOCK_SIZE, 2);
 
 	if ((!m_filename.empty()) && (!m_keep_in_memory)) {
-		m_file = fopen(m_filename.c_str(), "w+b"); 
-		return (m_file != nullptr);
+#ifdef _WIN32
+		HANDLE file = CreateFileA(m_filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, nullptr);
+		m_file = (file != INVALID_HANDLE_VALUE) ? (intptr_t)file : -1;
+#else
+		m_file = ::open(m_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+#endif // _WIN32
+		return (m_file != -1);
 	}
 
 	return (m_keep_in_memory == TRUE);
@@ -64,103 +100,212 @@ void
 CacheFile::close() {
 	// dispose the cache entries
 
-	while (!m_page_cache_disk.empty()) {
-		Block *block = *m_page_cache_disk.begin();
-		m_page_cache_disk.pop_front();
-		delete [] block->data;
-		delete block;
-	}
-	while (!m_page_cache_mem.empty()) { 
-		Block *block = *m_page_cache_mem.begin(); 
-		m_page_cache_mem.pop_front(); 
-		delete [] block->data; 
-		delete block; 
-	} 
-
-	if (m_file) {
+	m_pages.assign(1, Page());
+	m_free_pages.clear();
+	m_free_data.clear();
+	m_slabs.clear();
+	m_slab_charge.Release();
+	m_lru_head = m_lru_tail = -1;
+	m_mem_blocks = 0;
+
+	if (m_file != -1) {
 		// close the file
-		fclose(m_file);
-		m_file = nullptr;
+#ifdef _WIN32
+		CloseHandle((HANDLE)m_file);
+#else
+		::close((int)m_file);
+#endif // _WIN32
+		m_file = -1;
 		
 		// delete the file
 		remove(m_filename.c_str());
 	}
 }
 
+uint8_t *
+CacheFile::allocateData() {
+	if (m_free_data.empty()) {
+		// carve a new slab, the free list can hold all the blocks of the slabs
+
+		// throws std::bad_alloc beyond the memory limits, as a failed allocation
+
+		m_free_data.reserve((m_slabs.size() + 1) * SLAB_BLOCKS);
+		m_slab_charge.Add(SLAB_BLOCKS * BLOCK_SIZE);
+		m_slabs.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[SLAB_BLOCKS * BLOCK_SIZE]));
+
+		uint8_t *slab = m_slabs.back().get();
+		for (size_t i = SLAB_BLOCKS; i-- > 0; ) {
+			m_free_data.push_back(slab + i * BLOCK_SIZE);
+		}
+	}
+
+	uint8_t *data = m_free_data.back();
+	m_free_data.pop_back();
+	return data;
+}
+
 void
-CacheFile::cleanupMemCache() {
-	if (!m_keep_in_memory) {
-		if (m_page_cache_mem.size() > CACHE_SIZE) {
-			// flush the least used block to file
+CacheFile::lruPushFront(int nr) {
+	Page &page = m_pages[nr];
+	page.lru_prev = -1;
+	page.lru_next = m_lru_head;
+	if (m_lru_head != -1) {
+		m_pages[m_lru_head].lru_prev = nr;
+	} else {
+		m_lru_tail = nr;
+	}
+	m_lru_head = nr;
+}
 
-			Block *old_block = m_page_cache_mem.back();
-			fseek(m_file, old_block->nr * BLOCK_SIZE, SEEK_SET);
-			fwrite(old_block->data, BLOCK_SIZE, 1, m_file);
+void
+CacheFile::lruRemove(int nr) {
+	Page &page = m_pages[nr];
+	if (page.lru_prev != -1) {
+		m_pages[page.lru_prev].lru_next = page.lru_next;
+	} else {
+		m_lru_head = page.lru_next;
+	}
+	if (page.lru_next != -1) {
+		m_pages[page.lru_next].lru_prev = page.lru_prev;
+	} else {
+		m_lru_tail = page.lru_prev;
+	}
+	page.lru_prev = page.lru_next = -1;
+}
 
-			// remove the data
+FIBOOL
+CacheFile::readBlock(unsigned nr, uint8_t *data) {
+	const uint64_t offset = blockOffset(nr);
+#ifdef _WIN32
+	OVERLAPPED position{};
+	position.Offset = (DWORD)offset;
+	position.OffsetHigh = (DWORD)(offset >> 32);
+	DWORD size = 0;
+	return ReadFile((HANDLE)m_file, data, BLOCK_SIZE, &size, &position) && (size == BLOCK_SIZE);
+#else
+	for (size_t done = 0; done < BLOCK_SIZE; ) {
+		const ssize_t size = pread((int)m_file, data + done, BLOCK_SIZE - done, (off_t)(offset + done));
+		if (size <= 0) {
+			if ((size < 0) && (errno == EINTR)) {
+				continue;
+			}
+			return FALSE;
+		}
+		done += (size_t)size;
+	}
+	return TRUE;
+#endif // _WIN32
+}
 
-			delete [] old_block->data;
-			old_block->data = nullptr;
+FIBOOL
+CacheFile::writeBlock(unsigned nr, const uint8_t *data) {
+	const uint64_t offset = blockOffset(nr);
+#ifdef _WIN32
+	OVERLAPPED position{};
+	position.Offset = (DWORD)offset;
+	position.OffsetHigh = (DWORD)(offset >> 32);
+	DWORD size = 0;
+	return WriteFile((HANDLE)m_file, data, BLOCK_SIZE, &size, &position) && (size == BLOCK_SIZE);
+#else
+	for (size_t done = 0; done < BLOCK_SIZE; ) {
+		const ssize_t size = pwrite((int)m_file, data + done, BLOCK_SIZE - done, (off_t)(offset + done));
+		if (size < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return FALSE;
+		}
+		done += (size_t)size;
+	}
+	return TRUE;
+#endif // _WIN32
+}
+
+void
+CacheFile::cleanupMemCache() {
+	if (!m_keep_in_memory) {
+		while (m_mem_blocks > m_max_mem_blocks) {
+			// flush the least used block to file, unless it is already there
+
+			const int nr = m_lru_tail;
+			Page &page = m_pages[nr];
+			if (page.dirty) {
+				if (!writeBlock(nr, page.block.data)) {
+					// keep the blocks in memory, over budget
+					break;
+				}
+				page.dirty = false;
+			}
 
-			// move the block to another list
+			// give the data back to the slabs
 
-			m_page_cache_disk.splice(m_page_cache_disk.begin(), m_page_cache_mem, --m_page_cache_mem.end());
-			m_page_map[old_block->nr] = m_page_cache_disk.begin();
+			lruRemove(nr);
+			m_free_data.push_back(page.block.data);
+			page.block.data = nullptr;
+			m_mem_blocks--;
 		}
 	}
 }
 
 int
 CacheFile::allocateBlock() {
-	Block *block = new Block;
-	block->data = new uint8_t[BLOCK_SIZE];
-	block->next = 0;
+	uint8_t *data = allocateData();
 
+	unsigned nr;
 	if (!m_free_pages.empty()) {
-		block->nr = *m_free_pages.begin();
-		m_free_pages.pop_front();
+		nr = m_free_pages.back();
+		m_free_pages.pop_back();
 	} else {
-		block->nr = m_page_count++;
+		m_pages.emplace_back();
+		nr = (unsigned)(m_pages.size() - 1);
 	}
 
-	m_page_cache_mem.push_front(block);
-	m_page_map[block->nr] = m_page_cache_mem.begin();
+	Page &page = m_pages[nr];
+	page.block.nr = nr;
+	page.block.next = 0;
+	page.block.data = data;
+	page.used = true;
+	page.dirty = true;
+
+	lruPushFront(nr);
+	m_mem_blocks++;
 
 	cleanupMemCache();
 
-	return block->nr;
+	return nr;
 }
 
 Block *
 CacheFile::lockBlock(int nr) {
-	if (!m_current_block) {
-		PageMapIt it = m_page_map.find(nr);
-
-		if (it != m_page_map.end()) {
-			m_current_block = *(it->second);
+	if ((!m_current_block) && (nr > 0) && ((size_t)nr < m_pages.size()) && m_pages[nr].used) {
+		Page &page = m_pages[nr];
 
-			// the block is swapped out to disc. load it back
-			// and remove the block from the cache. it might get cached
-			// again as soon as the memory buffer fills up
+		if (!page.block.data) {
+			// the block is swapped out to disc. load it back, it is swapped
+			// out again once it is the least used block of a full memory cache
 
-			if (!m_current_block->data) {
-				m_current_block->data = new uint8_t[BLOCK_SIZE];
+			uint8_t *data = allocateData();
 
-				fseek(m_file, m_current_block->nr * BLOCK_SIZE, SEEK_SET);
-				fread(m_current_block->data, BLOCK_SIZE, 1, m_file);
-
-				m_page_cache_mem.splice(m_page_cache_mem.begin(), m_page_cache_disk, it->second);
-				m_page_map[nr] = m_page_cache_mem.begin();
+			if (!readBlock(nr, data)) {
+				m_free_data.push_back(data);
+				return nullptr;
 			}
+			page.block.data = data;
+
+			m_mem_blocks++;
+		} else {
+			lruRemove(nr);
+		}
+		lruPushFront(nr);
 
-			// if the memory cache size is too large, swap an item to disc
+		// if the memory cache size is too large, swap an item to disc
 
-			cleanupMemCache();
+		cleanupMemCache();
 
-			// return the current block
+		// return the current block
 
-			return m_current_block;
-		}
+		m_current_block = &page.block;
+		return m_current_block;
 	}
 
 	return nullptr;
@@ -177,14 +322,17 @@ CacheFile::unlockBlock(int nr) {
 
 FIBOOL
 CacheFile::deleteBlock(int nr) {
-	if (!m_current_block) {
-		PageMapIt it = m_page_map.find(nr);
+	if ((!m_current_block) && (nr > 0) && ((size_t)nr < m_pages.size()) && m_pages[nr].used) {
+		Page &page = m_pages[nr];
 
 		// remove block from cache
 
-		if (it != m_page_map.end()) {
-			m_page_map.erase(nr);
+		if (page.block.data) {
+			lruRemove(nr);
+			m_free_data.push_back(page.block.data);
+			m_mem_blocks--;
 		}
+		page = Page();
 
 		// add block to free page list
 
@@ -207,6 +355,9 @@ CacheFile::readFile(uint8_t *data, int nr, int size) {
 
 			Block *block = lockBlock(copy_nr);
 
+			if (!block)
+				return FALSE;
+
 			block_nr = block->next;
 
 			memcpy(data + s, block->data, (s + BLOCK_SIZE > size) ? size - s : BLOCK_SIZE);
@@ -214,7 +365,7 @@ CacheFile::readFile(uint8_t *data, int nr, int size) {
 			unlockBlock(copy_nr);
 
 			s += BLOCK_SIZE;
-		} while (block_nr != 0);
+		} while ((block_nr != 0) && (s < size));
 
 		return TRUE;
 	}
@@ -225,30 +376,27 @@ CacheFile::readFile(uint8_t *data, int nr, int size) {
 int
 CacheFile::writeFile(uint8_t *data, int size) {
 	if ((data) && (size > 0)) {
-		int nr_blocks_required = 1 + (size / BLOCK_SIZE);
-		int count = 0;
 		int s = 0;
-		int stored_alloc;
-		int alloc;
-		
-		stored_alloc = alloc = allocateBlock();
+		int alloc = allocateBlock();
+		const int stored_alloc = alloc;
 
 		do {
-			int copy_alloc = alloc;
+			// allocate the next block first, allocations move the page table
 
-			Block *block = lockBlock(copy_alloc);
+			const int next = (size - s > BLOCK_SIZE) ? allocateBlock() : 0;
 
-			block->next = 0;
+			Block *block = lockBlock(alloc);
 
-			memcpy(block->data, data + s, (s + BLOCK_SIZE > size) ? size - s : BLOCK_SIZE);
+			block->next = next;
+			m_pages[alloc].dirty = true;
 
-			if (count + 1 < nr_blocks_required)
-				alloc = block->next = allocateBlock();
+			memcpy(block->data, data + s, (s + BLOCK_SIZE > size) ? size - s : BLOCK_SIZE);
 
-			unlockBlock(copy_alloc);
+			unlockBlock(alloc);
 
+			alloc = next;
 			s += BLOCK_SIZE;			
-		} while (++count < nr_blocks_required);
+		} while (alloc != 0);
 
 		return stored_alloc;
 	}
@@ -274,3 +422,14 @@ CacheFile::deleteFile(int nr) {
 	} while (nr != 0);
 }
 
+// ----------------------------------------------------------
+
+void DLL_CALLCONV
+FreeImage_SetMultiBitmapCacheSize(unsigned size) {
+	gCacheSize.store(size, std::memory_order_relaxed);
+}
+
+unsigned DLL_CALLCONV
+FreeImage_GetMultiBitmapCacheSize() {
+	return gCacheSize.load(std::memory_order_relaxed);
+}
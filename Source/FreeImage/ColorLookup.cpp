@@ -69,22 +69,19 @@ Perform a binary search on a color array
 */
 static int
 FreeImage_LookupNamedColor(const char *szColor, const NamedColor *color_array, int ncolors) {
-	int i;
+	int i, j;
     char color[64];
 
     // make lower case name, squezze white space
 
-    for (i = 0; szColor[i] && i < sizeof(color) - 1; i++) {
-		if (isspace(szColor[i])) {
+    for (i = 0, j = 0; szColor[i] && j < (int)sizeof(color) - 1; i++) {
+		const unsigned char c = (unsigned char)szColor[i];
+		if (isspace(c)) {
             continue;
 		}
-		if (isupper(szColor[i])) {
-			color[i] = (char)tolower(szColor[i]);
-		} else {
-            color[i] = szColor[i];
-		}
+		color[j++] = (char)tolower(c);
     }
-    color[i] = 0;
+    color[j] = 0;
 
     return binsearch(color, color_array, ncolors);
 }
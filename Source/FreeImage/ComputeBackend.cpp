@@ -0,0 +1,67 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "ComputeBackend.h"
+#include <atomic>
+
+
+namespace {
+
+	/// Backend selected by FreeImage_SetComputeBackend
+	std::atomic<FREE_IMAGE_COMPUTE_BACKEND> gBackend{ FICB_CPU };
+
+	ComputeDevice* GetBackendDevice(FREE_IMAGE_COMPUTE_BACKEND backend) {
+		switch (backend) {
+#if FREEIMAGE_WITH_OPENCL
+			case FICB_OPENCL:
+				return GetOpenCLDevice();
+#endif
+			default:
+				return nullptr;
+		}
+	}
+
+} // namespace
+
+ComputeDevice* GetComputeDevice(bool force) {
+	const FREE_IMAGE_COMPUTE_BACKEND backend = gBackend.load(std::memory_order_acquire);
+	if (backend != FICB_CPU) {
+		return GetBackendDevice(backend);
+	}
+	return force ? GetBackendDevice(FICB_OPENCL) : nullptr;
+}
+
+
+// ==========================================================
+//   Public API
+// ==========================================================
+
+FIBOOL DLL_CALLCONV
+FreeImage_IsComputeBackendAvailable(FREE_IMAGE_COMPUTE_BACKEND backend) {
+	if (backend == FICB_CPU) {
+		return TRUE;
+	}
+	try {
+		return GetBackendDevice(backend) ? TRUE : FALSE;
+	}
+	catch (...) {
+		return FALSE;
+	}
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_SetComputeBackend(FREE_IMAGE_COMPUTE_BACKEND backend) {
+	if (!FreeImage_IsComputeBackendAvailable(backend)) {
+		return FALSE;
+	}
+	gBackend.store(backend, std::memory_order_release);
+	return TRUE;
+}
+
+FREE_IMAGE_COMPUTE_BACKEND DLL_CALLCONV
+FreeImage_GetComputeBackend() {
+	return gBackend.load(std::memory_order_acquire);
+}
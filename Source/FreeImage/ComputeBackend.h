@@ -0,0 +1,90 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_COMPUTE_BACKEND_H_
+#define FREEIMAGE_COMPUTE_BACKEND_H_
+
+#include "FreeImage.h"
+
+class CWeightsTable;
+
+/**
+Parameters of the Drago03 operator, shared by the rows of the image
+*/
+struct Drago03Params {
+	float avgLum;		// average luminance (world adaptation luminance)
+	float exposure;		// exposure parameter
+	float Lmax;			// maximum luminance normalized by the average luminance
+	float divider;		// log10(Lmax + 1)
+	float biasP;		// log(bias) / log(0.5)
+	float gamma;		// gamma correction, 1 means no correction
+	float gammaStart;	// REC709 curve: linear below gammaStart
+	float gammaSlope;	// REC709 curve: slope of the linear part
+	float gammaExponent;	// REC709 curve: exponent above gammaStart
+};
+
+/**
+Parameters of the Reinhard05 operator, computed from the image statistics
+*/
+struct Reinhard05Params {
+	float f;			// exp(-intensity)
+	float m;			// contrast
+	float a;			// adaptation
+	float c;			// color correction
+	float I_g[3];		// global light adaptation of each channel
+};
+
+/**
+Operations offloaded to a compute device.<br>
+Every operation may fail (unsupported image, out of device memory, lost device ...),
+it then returns nullptr / false and the caller runs its CPU code, so results never depend on the device availability.
+*/
+class ComputeDevice
+{
+public:
+	virtual ~ComputeDevice() = default;
+
+	/**
+	Separable rescale of a FIT_FLOAT, FIT_RGBF or FIT_RGBAF rectangle, same weights as CResizeEngine
+	@param src Source image
+	@param src_left Left of the rectangle
+	@param src_offset_y First scanline of the rectangle (measured from the bottom)
+	@param src_width Width of the rectangle
+	@param src_height Height of the rectangle
+	@param x_weights Weights table from src_width to the width of the result
+	@param y_weights Weights table from src_height to the height of the result
+	@return Returns the rescaled image, nullptr if the device failed
+	*/
+	virtual FIBITMAP* Rescale(FIBITMAP *src, unsigned src_left, unsigned src_offset_y, unsigned src_width, unsigned src_height,
+		const CWeightsTable &x_weights, unsigned dst_width, const CWeightsTable &y_weights, unsigned dst_height) = 0;
+
+	/**
+	Drago03 mapping of a RGBF image into a 24-bit image of the same size (Yxy, log mapping, RGB, gamma correction, clamping)
+	*/
+	virtual bool ToneMapDrago03(FIBITMAP *src, FIBITMAP *dst, const Drago03Params &params) = 0;
+
+	/**
+	Reinhard05 mapping of a RGBF image, in place
+	@param min_color Minimum of the mapped values
+	@param max_color Maximum of the mapped values
+	*/
+	virtual bool ToneMapReinhard05(FIBITMAP *dib, const Reinhard05Params &params, float *min_color, float *max_color) = 0;
+};
+
+/**
+Returns the device of the compute backend selected by FreeImage_SetComputeBackend, nullptr for FICB_CPU
+@param force Returns the device of the first available backend, even if FICB_CPU is selected
+*/
+ComputeDevice* GetComputeDevice(bool force = false);
+
+#if FREEIMAGE_WITH_OPENCL
+/**
+Returns the OpenCL device, created on first use, nullptr if there is no usable GPU
+*/
+ComputeDevice* GetOpenCLDevice();
+#endif
+
+#endif // FREEIMAGE_COMPUTE_BACKEND_H_
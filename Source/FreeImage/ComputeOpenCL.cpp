@@ -0,0 +1,558 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "ComputeBackend.h"
+
+#if FREEIMAGE_WITH_OPENCL
+
+#include "Utilities.h"
+#include "ToneMapping.h"
+#include "Resize.h"
+
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 120
+#endif
+#include <CL/cl.h>
+
+#include <climits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace {
+
+	/**
+	Kernels of the device, they run the operations of the CPU code in single precision.
+	Images are uploaded as rows of stride floats (bytes for 24-bit images), rows keep the bottom-up order of FreeImage.
+	*/
+	const char kProgramSource[] = R"CL(
+
+	/// weighted sums of the samples of each row, one work item per destination pixel
+	__kernel void rescale_rows(__global const float *src, int src_stride, __global float *dst, int dst_stride,
+		int channels, __global const int *bounds, __global const float *weights, int window)
+	{
+		const int x = get_global_id(0);
+		const int y = get_global_id(1);
+		const int left = bounds[2 * x];
+		const int count = bounds[2 * x + 1];
+		__global const float *w = weights + x * window;
+		__global const float *s = src + y * src_stride + left * channels;
+		__global float *d = dst + y * dst_stride + x * channels;
+		for (int c = 0; c < channels; c++) {
+			float value = 0;
+			for (int i = 0; i < count; i++) {
+				value += w[i] * s[i * channels + c];
+			}
+			d[c] = value;
+		}
+	}
+
+	/// weighted sums of the samples of each column, one work item per destination sample
+	__kernel void rescale_columns(__global const float *src, int src_stride, __global float *dst, int dst_stride,
+		__global const int *bounds, __global const float *weights, int window)
+	{
+		const int x = get_global_id(0);
+		const int y = get_global_id(1);
+		const int left = bounds[2 * y];
+		const int count = bounds[2 * y + 1];
+		__global const float *w = weights + y * window;
+		__global const float *s = src + left * src_stride + x;
+		float value = 0;
+		for (int i = 0; i < count; i++) {
+			value += w[i] * s[i * src_stride];
+		}
+		dst[y * dst_stride + x] = value;
+	}
+
+	/// pow of PowFloats, 0 for x <= 0
+	inline float pow0(float x, float e) {
+		return (x > 0) ? pow(x, e) : 0;
+	}
+
+	/// clamps to [0..1] (NaN gives 0) and rounds to a byte
+	inline uchar to_byte(float value) {
+		value = (value > 0) ? ((value < 1) ? value : 1) : 0;
+		return (uchar)(255.0f * value + 0.5f);
+	}
+
+	/// Pade approximation of log(x + 1), see pade_log in tmoDrago03.cpp
+	inline float pade_log(float x) {
+		if (x < 1) {
+			return (x * (6 + x) / (6 + 4 * x));
+		} else if (x < 2) {
+			return (x * (6 + 0.7662f * x) / (5.9897f + 3.7658f * x));
+		}
+		return log(x + 1);
+	}
+
+	/// Drago03 mapping, matrices holds RGB2XYZ then XYZ2RGB, gamma holds the start, slope and exponent of the REC709 curve
+	__kernel void drago03(__global const float *src, int src_stride, __global uchar *dst, int dst_stride,
+		__constant float *matrices, float avgLum, float exposure, float Lmax, float divider, float biasP,
+		int apply_gamma, float start, float slope, float exponent, int red, int blue)
+	{
+		const float EPSILON = 1e-06f;
+		const int x = get_global_id(0);
+		const int y = get_global_id(1);
+		__global const float *p = src + y * src_stride + 3 * x;
+		__constant float *m = matrices;
+
+		// convert to Yxy
+		float X = m[0] * p[0] + m[1] * p[1] + m[2] * p[2];
+		float Y = m[3] * p[0] + m[4] * p[1] + m[5] * p[2];
+		float Z = m[6] * p[0] + m[7] * p[1] + m[8] * p[2];
+		const float W = X + Y + Z;
+		float cx = 0, cy = 0;
+		if (W > 0) {
+			cx = X / W;
+			cy = Y / W;
+		} else {
+			Y = 0;
+		}
+
+		// log mapping of the luminance
+		const float Yw = (Y / avgLum) * exposure;
+		const float interpol = log(fmax(2 + pow0(Yw / Lmax, biasP) * 8, FLT_MIN));
+		Y = (pade_log(Yw) / interpol) / divider;
+
+		// convert back to RGB
+		if ((Y > EPSILON) && (cx > EPSILON) && (cy > EPSILON)) {
+			X = (cx * Y) / cy;
+			Z = (X / cx) - X - Y;
+		} else {
+			X = Z = EPSILON;
+		}
+		float rgb[3];
+		for (int i = 0; i < 3; i++) {
+			rgb[i] = m[9 + 3 * i] * X + m[10 + 3 * i] * Y + m[11 + 3 * i] * Z;
+			if (apply_gamma) {
+				rgb[i] = (rgb[i] <= start) ? rgb[i] * slope : (1.099f * pow0(rgb[i], exponent) - 0.099f);
+			}
+		}
+
+		__global uchar *d = dst + y * dst_stride + 3 * x;
+		d[red] = to_byte(rgb[0]);
+		d[1] = to_byte(rgb[1]);
+		d[blue] = to_byte(rgb[2]);
+	}
+
+	/// Reinhard05 mapping in place, minimum and maximum of the mapped values are reduced by 16x16 work-groups into partial
+	__kernel __attribute__((reqd_work_group_size(16, 16, 1)))
+	void reinhard05(__global float *data, int stride, int width, int height,
+		float f, float m, float a, float c, float I_g0, float I_g1, float I_g2, __global float *partial)
+	{
+		__local float local_min[256];
+		__local float local_max[256];
+
+		const int x = get_global_id(0);
+		const int y = get_global_id(1);
+		const int id = get_local_id(1) * 16 + get_local_id(0);
+		float min_value = +1e6f;
+		float max_value = -1e6f;
+
+		if ((x < width) && (y < height)) {
+			__global float *color = data + y * stride + 3 * x;
+			const float I_g[3] = { I_g0, I_g1, I_g2 };
+			const float L = fmax(0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2], 0.0f);
+			for (int i = 0; i < 3; i++) {
+				const float I_l = c * color[i] + (1 - c) * L;
+				const float I_a = pow0(f * (a * I_l + (1 - a) * I_g[i]), m);
+				const float denominator = color[i] + I_a;
+				color[i] = (denominator != 0) ? color[i] / denominator : 0;
+				min_value = fmin(min_value, color[i]);
+				max_value = fmax(max_value, color[i]);
+			}
+		}
+
+		local_min[id] = min_value;
+		local_max[id] = max_value;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		for (int offset = 128; offset > 0; offset >>= 1) {
+			if (id < offset) {
+				local_min[id] = fmin(local_min[id], local_min[id + offset]);
+				local_max[id] = fmax(local_max[id], local_max[id + offset]);
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+		}
+		if (id == 0) {
+			const int group = get_group_id(1) * get_num_groups(0) + get_group_id(0);
+			partial[2 * group] = local_min[0];
+			partial[2 * group + 1] = local_max[0];
+		}
+	}
+
+	)CL";
+
+	/// Side of the work-groups of the reinhard05 kernel
+	const size_t kGroupSide = 16;
+
+	/**
+	Owner of an OpenCL object
+	*/
+	template <typename T, cl_int (CL_API_CALL *Release)(T)>
+	class CLHandle
+	{
+	public:
+		CLHandle() = default;
+
+		explicit CLHandle(T handle)
+		: mHandle(handle) {
+		}
+
+		~CLHandle() {
+			if (mHandle) {
+				Release(mHandle);
+			}
+		}
+
+		CLHandle(const CLHandle&) = delete;
+		CLHandle& operator=(const CLHandle&) = delete;
+
+		CLHandle& operator=(T handle) {
+			if (mHandle) {
+				Release(mHandle);
+			}
+			mHandle = handle;
+			return *this;
+		}
+
+		T get() const {
+			return mHandle;
+		}
+
+		explicit operator bool() const {
+			return mHandle != nullptr;
+		}
+
+	private:
+		T mHandle{};
+	};
+
+	using ContextHandle = CLHandle<cl_context, clReleaseContext>;
+	using QueueHandle = CLHandle<cl_command_queue, clReleaseCommandQueue>;
+	using ProgramHandle = CLHandle<cl_program, clReleaseProgram>;
+	using KernelHandle = CLHandle<cl_kernel, clReleaseKernel>;
+	using MemHandle = CLHandle<cl_mem, clReleaseMemObject>;
+
+	/// Sets the arguments of a kernel, stops at the first error
+	template <typename... Args>
+	cl_int SetKernelArgs(cl_kernel kernel, const Args&... args) {
+		cl_uint index = 0;
+		cl_int err = CL_SUCCESS;
+		((err = (err == CL_SUCCESS) ? clSetKernelArg(kernel, index++, sizeof(Args), &args) : err), ...);
+		return err;
+	}
+
+	/**
+	Weights of a CWeightsTable flattened for the device: left boundary and count of each destination position,
+	then window weights per position
+	*/
+	struct FlatWeights {
+		std::vector<cl_int> bounds;
+		std::vector<float> weights;
+		cl_int window{ 0 };
+
+		FlatWeights(const CWeightsTable &table, unsigned length)
+		: bounds(2 * (size_t)length) {
+			for (unsigned i = 0; i < length; i++) {
+				const cl_int count = (cl_int)(table.getRightBoundary(i) - table.getLeftBoundary(i));
+				window = MAX(window, count);
+			}
+			weights.assign((size_t)length * window, 0.0f);
+			for (unsigned i = 0; i < length; i++) {
+				const unsigned left = table.getLeftBoundary(i);
+				const unsigned count = table.getRightBoundary(i) - left;
+				bounds[2 * i] = (cl_int)left;
+				bounds[2 * i + 1] = (cl_int)count;
+				for (unsigned k = 0; k < count; k++) {
+					weights[(size_t)window * i + k] = (float)table.getWeight(i, k);
+				}
+			}
+		}
+	};
+
+	/// Returns the samples per pixel of the float images rescaled by the device, 0 for other types
+	unsigned GetFloatChannels(FIBITMAP *dib) {
+		switch (FreeImage_GetImageType(dib)) {
+			case FIT_FLOAT:
+				return 1;
+			case FIT_RGBF:
+				return 3;
+			case FIT_RGBAF:
+				return 4;
+			default:
+				return 0;
+		}
+	}
+
+	/// Kernels index arithmetic is done on int
+	bool FitsInt(size_t elements) {
+		return elements <= (size_t)INT_MAX;
+	}
+
+	/**
+	First GPU device of the OpenCL platforms.<br>
+	Calls are serialized, kernels arguments belong to the kernel objects.
+	*/
+	class OpenCLDevice final : public ComputeDevice
+	{
+	public:
+		/// Returns nullptr if there is no GPU or if the program does not build
+		static std::unique_ptr<OpenCLDevice> Create() {
+			cl_uint platform_count = 0;
+			if ((clGetPlatformIDs(0, nullptr, &platform_count) != CL_SUCCESS) || !platform_count) {
+				return nullptr;
+			}
+			std::vector<cl_platform_id> platforms(platform_count);
+			if (clGetPlatformIDs(platform_count, platforms.data(), nullptr) != CL_SUCCESS) {
+				return nullptr;
+			}
+			for (cl_platform_id platform : platforms) {
+				cl_device_id device{};
+				cl_uint device_count = 0;
+				if ((clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, &device_count) == CL_SUCCESS) && device_count) {
+					std::unique_ptr<OpenCLDevice> result(new OpenCLDevice());
+					if (result->Init(device)) {
+						return result;
+					}
+				}
+			}
+			return nullptr;
+		}
+
+		FIBITMAP* Rescale(FIBITMAP *src, unsigned src_left, unsigned src_offset_y, unsigned src_width, unsigned src_height,
+			const CWeightsTable &x_weights, unsigned dst_width, const CWeightsTable &y_weights, unsigned dst_height) override {
+
+			const unsigned channels = GetFloatChannels(src);
+			if (!channels || !FitsInt((size_t)MAX(src_width, dst_width) * channels * MAX(src_height, dst_height))) {
+				return nullptr;
+			}
+			FIBITMAP *dst = FreeImage_AllocateT(FreeImage_GetImageType(src), dst_width, dst_height);
+			if (!dst) {
+				return nullptr;
+			}
+			const FlatWeights x_flat(x_weights, dst_width);
+			const FlatWeights y_flat(y_weights, dst_height);
+
+			const cl_int src_stride = (cl_int)(src_width * channels);
+			const cl_int dst_stride = (cl_int)(dst_width * channels);
+			const cl_int cl_channels = (cl_int)channels;
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			cl_int err = CL_SUCCESS;
+			MemHandle src_buffer(clCreateBuffer(mContext.get(), CL_MEM_READ_ONLY, sizeof(float) * src_stride * src_height, nullptr, &err));
+			MemHandle tmp_buffer(clCreateBuffer(mContext.get(), CL_MEM_READ_WRITE, sizeof(float) * dst_stride * src_height, nullptr, &err));
+			MemHandle dst_buffer(clCreateBuffer(mContext.get(), CL_MEM_WRITE_ONLY, sizeof(float) * dst_stride * dst_height, nullptr, &err));
+			MemHandle x_bounds(CreateInput(x_flat.bounds));
+			MemHandle x_values(CreateInput(x_flat.weights));
+			MemHandle y_bounds(CreateInput(y_flat.bounds));
+			MemHandle y_values(CreateInput(y_flat.weights));
+			if (!src_buffer || !tmp_buffer || !dst_buffer || !x_bounds || !x_values || !y_bounds || !y_values) {
+				FreeImage_Unload(dst);
+				return nullptr;
+			}
+
+			const size_t row_bytes = sizeof(float) * src_stride;
+			const size_t src_origin[3] = { sizeof(float) * channels * src_left, src_offset_y, 0 };
+			const size_t src_region[3] = { row_bytes, src_height, 1 };
+			const size_t dst_region[3] = { sizeof(float) * dst_stride, dst_height, 1 };
+			const size_t zero[3] = { 0, 0, 0 };
+			const size_t rows_size[2] = { dst_width, src_height };
+			const size_t columns_size[2] = { (size_t)dst_stride, dst_height };
+
+			err = clEnqueueWriteBufferRect(mQueue.get(), src_buffer.get(), CL_TRUE, zero, src_origin, src_region,
+				row_bytes, 0, FreeImage_GetPitch(src), 0, FreeImage_GetConstBits(src), 0, nullptr, nullptr);
+			if (err == CL_SUCCESS) {
+				err = SetKernelArgs(mRescaleRows.get(), src_buffer.get(), src_stride, tmp_buffer.get(), dst_stride,
+					cl_channels, x_bounds.get(), x_values.get(), x_flat.window);
+			}
+			if (err == CL_SUCCESS) {
+				err = clEnqueueNDRangeKernel(mQueue.get(), mRescaleRows.get(), 2, nullptr, rows_size, nullptr, 0, nullptr, nullptr);
+			}
+			if (err == CL_SUCCESS) {
+				err = SetKernelArgs(mRescaleColumns.get(), tmp_buffer.get(), dst_stride, dst_buffer.get(), dst_stride,
+					y_bounds.get(), y_values.get(), y_flat.window);
+			}
+			if (err == CL_SUCCESS) {
+				err = clEnqueueNDRangeKernel(mQueue.get(), mRescaleColumns.get(), 2, nullptr, columns_size, nullptr, 0, nullptr, nullptr);
+			}
+			if (err == CL_SUCCESS) {
+				err = clEnqueueReadBufferRect(mQueue.get(), dst_buffer.get(), CL_TRUE, zero, zero, dst_region,
+					sizeof(float) * dst_stride, 0, FreeImage_GetPitch(dst), 0, FreeImage_GetBits(dst), 0, nullptr, nullptr);
+			}
+			if (err != CL_SUCCESS) {
+				clFinish(mQueue.get());
+				FreeImage_Unload(dst);
+				return nullptr;
+			}
+			return dst;
+		}
+
+		bool ToneMapDrago03(FIBITMAP *src, FIBITMAP *dst, const Drago03Params &params) override {
+			const unsigned width = FreeImage_GetWidth(src);
+			const unsigned height = FreeImage_GetHeight(src);
+			if ((FreeImage_GetImageType(src) != FIT_RGBF) || !FitsInt((size_t)width * 3 * height)) {
+				return false;
+			}
+			float matrices[2][3][3];
+			GetYxyMatrices(matrices[0], matrices[1]);
+
+			const cl_int src_stride = (cl_int)(width * 3);
+			const cl_int dst_stride = (cl_int)(width * 3);
+			const cl_int apply_gamma = (params.gamma != 1) ? 1 : 0;
+			const cl_int red = FI_RGBA_RED;
+			const cl_int blue = FI_RGBA_BLUE;
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			cl_int err = CL_SUCCESS;
+			MemHandle src_buffer(clCreateBuffer(mContext.get(), CL_MEM_READ_ONLY, sizeof(float) * src_stride * height, nullptr, &err));
+			MemHandle dst_buffer(clCreateBuffer(mContext.get(), CL_MEM_WRITE_ONLY, (size_t)dst_stride * height, nullptr, &err));
+			MemHandle matrices_buffer(clCreateBuffer(mContext.get(), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(matrices), matrices, &err));
+			if (!src_buffer || !dst_buffer || !matrices_buffer) {
+				return false;
+			}
+
+			const size_t zero[3] = { 0, 0, 0 };
+			const size_t src_region[3] = { sizeof(float) * src_stride, height, 1 };
+			const size_t dst_region[3] = { (size_t)dst_stride, height, 1 };
+			const size_t global_size[2] = { width, height };
+
+			err = clEnqueueWriteBufferRect(mQueue.get(), src_buffer.get(), CL_TRUE, zero, zero, src_region,
+				sizeof(float) * src_stride, 0, FreeImage_GetPitch(src), 0, FreeImage_GetConstBits(src), 0, nullptr, nullptr);
+			if (err == CL_SUCCESS) {
+				err = SetKernelArgs(mDrago03.get(), src_buffer.get(), src_stride, dst_buffer.get(), dst_stride, matrices_buffer.get(),
+					params.avgLum, params.exposure, params.Lmax, params.divider, params.biasP,
+					apply_gamma, params.gammaStart, params.gammaSlope, params.gammaExponent, red, blue);
+			}
+			if (err == CL_SUCCESS) {
+				err = clEnqueueNDRangeKernel(mQueue.get(), mDrago03.get(), 2, nullptr, global_size, nullptr, 0, nullptr, nullptr);
+			}
+			if (err == CL_SUCCESS) {
+				err = clEnqueueReadBufferRect(mQueue.get(), dst_buffer.get(), CL_TRUE, zero, zero, dst_region,
+					dst_stride, 0, FreeImage_GetPitch(dst), 0, FreeImage_GetBits(dst), 0, nullptr, nullptr);
+			}
+			if (err != CL_SUCCESS) {
+				clFinish(mQueue.get());
+				return false;
+			}
+			return true;
+		}
+
+		bool ToneMapReinhard05(FIBITMAP *dib, const Reinhard05Params &params, float *min_color, float *max_color) override {
+			const unsigned width = FreeImage_GetWidth(dib);
+			const unsigned height = FreeImage_GetHeight(dib);
+			if ((FreeImage_GetImageType(dib) != FIT_RGBF) || !FitsInt((size_t)width * 3 * height)) {
+				return false;
+			}
+
+			const cl_int stride = (cl_int)(width * 3);
+			const cl_int cl_width = (cl_int)width;
+			const cl_int cl_height = (cl_int)height;
+			const size_t groups_x = (width + kGroupSide - 1) / kGroupSide;
+			const size_t groups_y = (height + kGroupSide - 1) / kGroupSide;
+			std::vector<float> partial(2 * groups_x * groups_y);
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			cl_int err = CL_SUCCESS;
+			MemHandle data_buffer(clCreateBuffer(mContext.get(), CL_MEM_READ_WRITE, sizeof(float) * stride * height, nullptr, &err));
+			MemHandle partial_buffer(clCreateBuffer(mContext.get(), CL_MEM_WRITE_ONLY, sizeof(float) * partial.size(), nullptr, &err));
+			if (!data_buffer || !partial_buffer) {
+				return false;
+			}
+
+			const size_t zero[3] = { 0, 0, 0 };
+			const size_t region[3] = { sizeof(float) * stride, height, 1 };
+			const size_t global_size[2] = { groups_x * kGroupSide, groups_y * kGroupSide };
+			const size_t local_size[2] = { kGroupSide, kGroupSide };
+
+			err = clEnqueueWriteBufferRect(mQueue.get(), data_buffer.get(), CL_TRUE, zero, zero, region,
+				sizeof(float) * stride, 0, FreeImage_GetPitch(dib), 0, FreeImage_GetConstBits(dib), 0, nullptr, nullptr);
+			if (err == CL_SUCCESS) {
+				err = SetKernelArgs(mReinhard05.get(), data_buffer.get(), stride, cl_width, cl_height,
+					params.f, params.m, params.a, params.c, params.I_g[0], params.I_g[1], params.I_g[2], partial_buffer.get());
+			}
+			if (err == CL_SUCCESS) {
+				err = clEnqueueNDRangeKernel(mQueue.get(), mReinhard05.get(), 2, nullptr, global_size, local_size, 0, nullptr, nullptr);
+			}
+			if (err == CL_SUCCESS) {
+				err = clEnqueueReadBuffer(mQueue.get(), partial_buffer.get(), CL_TRUE, 0, sizeof(float) * partial.size(), partial.data(), 0, nullptr, nullptr);
+			}
+			if (err == CL_SUCCESS) {
+				err = clEnqueueReadBufferRect(mQueue.get(), data_buffer.get(), CL_TRUE, zero, zero, region,
+					sizeof(float) * stride, 0, FreeImage_GetPitch(dib), 0, FreeImage_GetBits(dib), 0, nullptr, nullptr);
+			}
+			if (err != CL_SUCCESS) {
+				clFinish(mQueue.get());
+				return false;
+			}
+
+			*min_color = +1e6F;
+			*max_color = -1e6F;
+			for (size_t i = 0; i < partial.size(); i += 2) {
+				*min_color = MIN(*min_color, partial[i]);
+				*max_color = MAX(*max_color, partial[i + 1]);
+			}
+			return true;
+		}
+
+	private:
+		OpenCLDevice() = default;
+
+		bool Init(cl_device_id device) {
+			cl_int err = CL_SUCCESS;
+			mContext = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+			if (!mContext) {
+				return false;
+			}
+			mQueue = clCreateCommandQueue(mContext.get(), device, 0, &err);
+			if (!mQueue) {
+				return false;
+			}
+			const char *source = kProgramSource;
+			mProgram = clCreateProgramWithSource(mContext.get(), 1, &source, nullptr, &err);
+			if (!mProgram || (clBuildProgram(mProgram.get(), 1, &device, "-cl-std=CL1.2", nullptr, nullptr) != CL_SUCCESS)) {
+				return false;
+			}
+			mRescaleRows = clCreateKernel(mProgram.get(), "rescale_rows", &err);
+			mRescaleColumns = clCreateKernel(mProgram.get(), "rescale_columns", &err);
+			mDrago03 = clCreateKernel(mProgram.get(), "drago03", &err);
+			mReinhard05 = clCreateKernel(mProgram.get(), "reinhard05", &err);
+			return mRescaleRows && mRescaleColumns && mDrago03 && mReinhard05;
+		}
+
+		/// Read-only buffer initialized with the content of values
+		template <typename T>
+		cl_mem CreateInput(const std::vector<T> &values) {
+			cl_int err = CL_SUCCESS;
+			return clCreateBuffer(mContext.get(), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(T) * values.size(), const_cast<T*>(values.data()), &err);
+		}
+
+		std::mutex mMutex;
+		ContextHandle mContext;
+		QueueHandle mQueue;
+		ProgramHandle mProgram;
+		KernelHandle mRescaleRows;
+		KernelHandle mRescaleColumns;
+		KernelHandle mDrago03;
+		KernelHandle mReinhard05;
+	};
+
+} // namespace
+
+ComputeDevice* GetOpenCLDevice() {
+	// never released: the OpenCL runtime may be unloaded before static destructors run
+	static OpenCLDevice *const device = []() -> OpenCLDevice* {
+		try {
+			return OpenCLDevice::Create().release();
+		}
+		catch (...) {
+			return nullptr;
+		}
+	}();
+	return device;
+}
+
+#endif // FREEIMAGE_WITH_OPENCL
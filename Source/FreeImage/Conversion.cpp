@@ -26,6 +26,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "Quantizers.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 
@@ -76,12 +77,12 @@ FIBOOL SwapRedBlue32(FIBITMAP* dib) {
 	const unsigned pitch = FreeImage_GetPitch(dib);
 	const unsigned lineSize = FreeImage_GetLine(dib);
 	
-	uint8_t* line = FreeImage_GetBits(dib);
-	for (unsigned y = 0; y < height; ++y, line += pitch) {
-		for (uint8_t* pixel = line; pixel < line + lineSize ; pixel += bytesperpixel) {
-			INPLACESWAP(pixel[0], pixel[2]);
+	uint8_t* bits = FreeImage_GetBits(dib);
+	ParallelFor(0, height, CalculateBandRows(lineSize), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; ++y) {
+			SwapRedBlue(bits + static_cast<size_t>(y) * pitch, lineSize / bytesperpixel, bytesperpixel);
 		}
-	}
+	});
 	
 	return TRUE;
 }
@@ -134,23 +135,30 @@ static void
 _convertCMYKtoRGBA(unsigned width, unsigned height, uint8_t* line_start, unsigned pitch, unsigned samplesperpixel) {
 	const FIBOOL hasBlack = (samplesperpixel > 3) ? TRUE : FALSE;
 	const T MAX_VAL = std::numeric_limits<T>::max();
-		
-	T K = 0;
-	for (unsigned y = 0; y < height; y++) {
-		T *line = (T*)line_start;
-
-		for (unsigned x = 0; x < width; x++) {
-			if (hasBlack) {
-				K = line[FI_RGBA_ALPHA];			
-				line[FI_RGBA_ALPHA] = MAX_VAL; // TODO write the first extra channel as alpha!
-			}			
-			
-			CMYKToRGB<T>(line[0], line[1], line[2], K, line);
-			
-			line += samplesperpixel;
+
+	ParallelFor(0, height, CalculateBandRows(pitch), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			T *line = (T*)(line_start + (size_t)pitch * y);
+
+			if (samplesperpixel == 4) {
+				// vectorized, the black channel is replaced by an opaque alpha
+				ConvertCMYKToRGBA(line, width);
+				continue;
+			}
+
+			T K = 0;
+			for (unsigned x = 0; x < width; x++) {
+				if (hasBlack) {
+					K = line[FI_RGBA_ALPHA];
+					line[FI_RGBA_ALPHA] = MAX_VAL; // TODO write the first extra channel as alpha!
+				}
+
+				CMYKToRGB<T>(line[0], line[1], line[2], K, line);
+
+				line += samplesperpixel;
+			}
 		}
-		line_start += pitch;
-	}
+	});
 }
 
 FIBOOL 
@@ -188,118 +196,64 @@ ConvertCMYKtoRGBA(FIBITMAP* dib) {
 // ----------------------------------------------------------
 
 /**
-CIELab -> XYZ conversion from http://www.easyrgb.com/
-*/
-static void 
-CIELabToXYZ(float L, float a, float b, float *X, float *Y, float *Z) {
-	float pow_3;
-	
-	// CIELab -> XYZ conversion 
-	// ------------------------
-	float var_Y = (L + 16.F ) / 116.F;
-	float var_X = a / 500.F + var_Y;
-	float var_Z = var_Y - b / 200.F;
-
-	pow_3 = powf(var_Y, 3);
-	if (pow_3 > 0.008856F) {
-		var_Y = pow_3;
-	} else {
-		var_Y = ( var_Y - 16.F / 116.F ) / 7.787F;
-	}
-	pow_3 = powf(var_X, 3);
-	if (pow_3 > 0.008856F) {
-		var_X = pow_3;
-	} else {
-		var_X = ( var_X - 16.F / 116.F ) / 7.787F;
-	}
-	pow_3 = powf(var_Z, 3);
-	if (pow_3 > 0.008856F) {
-		var_Z = pow_3;
-	} else {
-		var_Z = ( var_Z - 16.F / 116.F ) / 7.787F;
-	}
-
-	static const float ref_X =  95.047F;
-	static const float ref_Y = 100.000F;
-	static const float ref_Z = 108.883F;
-
-	*X = ref_X * var_X;	// ref_X = 95.047 (Observer= 2 deg, Illuminant= D65)
-	*Y = ref_Y * var_Y;	// ref_Y = 100.000
-	*Z = ref_Z * var_Z;	// ref_Z = 108.883
-}
-
-/**
-XYZ -> RGB conversion from http://www.easyrgb.com/
+CIELab -> XYZ -> linear RGB conversion of a line from http://www.easyrgb.com/ (Observer = 2 deg, Illuminant = D65)
 */
+template<class T>
 static void 
-XYZToRGB(float X, float Y, float Z, float *R, float *G, float *B) {
-	float var_X = X / 100; // X from 0 to  95.047 (Observer = 2 deg, Illuminant = D65)
-	float var_Y = Y / 100; // Y from 0 to 100.000
-	float var_Z = Z / 100; // Z from 0 to 108.883
-
-	float var_R = var_X *  3.2406F + var_Y * -1.5372F + var_Z * -0.4986F;
-	float var_G = var_X * -0.9689F + var_Y *  1.8758F + var_Z *  0.0415F;
-	float var_B = var_X *  0.0557F + var_Y * -0.2040F + var_Z *  1.0570F;
-
-	float exponent = 1.F / 2.4F;
+CIELabToLinearRGB(const T *line, unsigned width, unsigned samplesperpixel, float *rgb) {
+	const float max_val = std::numeric_limits<T>::max();
+	const float sL = 100.F / max_val;
+	const float sa = 256.F / max_val;
+	const float sb = 256.F / max_val;
 
-	if (var_R > 0.0031308F) {
-		var_R = 1.055F * powf(var_R, exponent) - 0.055F;
-	} else {
-		var_R = 12.92F * var_R;
-	}
-	if (var_G > 0.0031308F) {
-		var_G = 1.055F * powf(var_G, exponent) - 0.055F;
-	} else {
-		var_G = 12.92F * var_G;
+	// inverse of the CIELab companding, cubes are computed by multiplications
+	auto expand = [](float t) {
+		const float t3 = t * t * t;
+		return (t3 > 0.008856F) ? t3 : (t - 16.F / 116.F) / 7.787F;
+	};
+
+	for (unsigned x = 0; x < width; x++, line += samplesperpixel, rgb += 3) {
+		const float var_Y = (line[0] * sL + 16.F) / 116.F;
+		const float var_X = (line[1] * sa - 128.F) / 500.F + var_Y;
+		const float var_Z = var_Y - (line[2] * sb - 128.F) / 200.F;
+
+		// XYZ scaled to [0..1], ref_X = 95.047, ref_Y = 100.000, ref_Z = 108.883
+		const float X = 0.95047F * expand(var_X);
+		const float Y = expand(var_Y);
+		const float Z = 1.08883F * expand(var_Z);
+
+		rgb[0] = X *  3.2406F + Y * -1.5372F + Z * -0.4986F;
+		rgb[1] = X * -0.9689F + Y *  1.8758F + Z *  0.0415F;
+		rgb[2] = X *  0.0557F + Y * -0.2040F + Z *  1.0570F;
 	}
-	if (var_B > 0.0031308F) {
-		var_B = 1.055F * powf(var_B, exponent) - 0.055F;
-	} else {
-		var_B = 12.92F * var_B;
-	}
-
-	*R = var_R;
-	*G = var_G;
-	*B = var_B;
 }
 
 template<class T>
 static void 
-CIELabToRGB(float L, float a, float b, T *rgb) {
-	float X, Y, Z;
-	float R, G, B;
+_convertLABtoRGB(unsigned width, unsigned height, uint8_t* line_start, unsigned pitch, unsigned samplesperpixel) {
 	const float max_val = std::numeric_limits<T>::max();
 
-	CIELabToXYZ(L, a, b, &X, &Y, &Z);
-	XYZToRGB(X, Y, Z, &R, &G, &B);
-	
-	// clamp values to [0..max_val]
-	T red	= (T)CLAMP(R * max_val, 0.0F, max_val);
-	T green	= (T)CLAMP(G * max_val, 0.0F, max_val);
-	T blue	= (T)CLAMP(B * max_val, 0.0F, max_val);
+	ParallelFor(0, height, CalculateBandRows(pitch), [&](unsigned first, unsigned last) {
+		std::vector<float> rgb(width * 3);
 
-	assignRGB(red, green, blue, rgb);
-}
+		for (unsigned y = first; y < last; y++) {
+			T *line = (T*)(line_start + (size_t)pitch * y);
 
-template<class T>
-static void 
-_convertLABtoRGB(unsigned width, unsigned height, uint8_t* line_start, unsigned pitch, unsigned samplesperpixel) {
-	const unsigned max_val = std::numeric_limits<T>::max();
-	const float sL = 100.F / max_val;
-	const float sa = 256.F / max_val;
-	const float sb = 256.F / max_val;
-	
-	for (unsigned y = 0; y < height; y++) {
-		T *line = (T*)line_start;
+			CIELabToLinearRGB(line, width, samplesperpixel, rgb.data());
+			// sRGB companding by the vectorized transfer function
+			ApplyTransfer(rgb.data(), width * 3, 3, FITF_LINEAR_TO_SRGB);
 
-		for (unsigned x = 0; x < width; x++) {
-			CIELabToRGB(line[0]* sL, line[1]* sa - 128.F, line[2]* sb - 128.F, line);
-			
-			line += samplesperpixel;
+			const float *v = rgb.data();
+			for (unsigned x = 0; x < width; x++, line += samplesperpixel, v += 3) {
+				// clamp values to [0..max_val]
+				const T red   = (T)CLAMP(v[0] * max_val, 0.0F, max_val);
+				const T green = (T)CLAMP(v[1] * max_val, 0.0F, max_val);
+				const T blue  = (T)CLAMP(v[2] * max_val, 0.0F, max_val);
+
+				assignRGB(red, green, blue, line);
+			}
 		}
-		line_start += pitch;
-	}
+	});
 }
 
 FIBOOL
@@ -437,27 +391,51 @@ FreeImage_ColorQuantizeEx(FIBITMAP *dib, FREE_IMAGE_QUANTIZE quantize, int Palet
 
 // ==========================================================
 
+/**
+Returns true when 24- or 32-bit masks describe the byte order opposite to the FI_RGBA order (RGB(A) on a BGR(A) build
+and vice versa), the red and blue bytes of such pixels are swapped by the raw bits conversions.
+*/
+static bool
+IsSwappedLayout(FREE_IMAGE_TYPE type, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask) {
+	return (type == FIT_BITMAP) && ((bpp == 24) || (bpp == 32))
+		&& (red_mask == FI_RGBA_BLUE_MASK) && (green_mask == FI_RGBA_GREEN_MASK) && (blue_mask == FI_RGBA_RED_MASK);
+}
+
+/**
+Wraps or copies a user provided pixel buffer.
+Without copySource the buffer is wrapped as is and no pixel is converted; only topdown buffers are flipped in place.
+With copySource rows are copied in parallel bands straight into their flipped position, 24- and 32-bit buffers in the
+opposite byte order (see IsSwappedLayout) are swapped into the FI_RGBA order while copying.
+*/
 FIBITMAP * DLL_CALLCONV
 FreeImage_ConvertFromRawBitsEx(FIBOOL copySource, uint8_t *bits, FREE_IMAGE_TYPE type, int width, int height, int pitch, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, FIBOOL topdown) {
 	FIBITMAP *dib{};
 
 	if (copySource) {
+		const bool swap = IsSwappedLayout(type, bpp, red_mask, green_mask, blue_mask);
+		if (swap) {
+			red_mask = FI_RGBA_RED_MASK;
+			blue_mask = FI_RGBA_BLUE_MASK;
+		}
 		// allocate a FIBITMAP with internally managed pixel buffer
 		dib = FreeImage_AllocateT(type, width, height, bpp, red_mask, green_mask, blue_mask);
 		if (!dib) {
 			return nullptr;
 		}
-		// copy user provided pixel buffer into the dib
+		// copy user provided pixel buffer into the dib, flipping pixels vertically if needed
 		const unsigned linesize = FreeImage_GetLine(dib);
-		for (int y = 0; y < height; y++) {
-			memcpy(FreeImage_GetScanLine(dib, y), bits, linesize);
-			// next line in user's buffer
-			bits += pitch;
-		}
-		// flip pixels vertically if needed
-		if (topdown) {
-			FreeImage_FlipVertical(dib);
-		}
+		const unsigned dst_pitch = FreeImage_GetPitch(dib);
+		uint8_t *dst_bits = FreeImage_GetBits(dib);
+		const auto rows = static_cast<unsigned>(height);
+		ParallelFor(0, rows, CalculateBandRows(linesize), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				uint8_t *dst_line = dst_bits + static_cast<size_t>(topdown ? rows - y - 1 : y) * dst_pitch;
+				memcpy(dst_line, bits + static_cast<ptrdiff_t>(y) * pitch, linesize);
+				if (swap) {
+					SwapRedBlue(dst_line, static_cast<unsigned>(width), bpp / 8);
+				}
+			}
+		});
 	}
 	else {
 		// allocate a FIBITMAP using a wrapper to user provided pixel buffer
@@ -479,83 +457,106 @@ FreeImage_ConvertFromRawBits(uint8_t *bits, int width, int height, int pitch, un
 	return FreeImage_ConvertFromRawBitsEx(TRUE /* copySource */, bits, FIT_BITMAP, width, height, pitch, bpp, red_mask, green_mask, blue_mask, topdown);
 }
 
-void DLL_CALLCONV
-FreeImage_ConvertToRawBits(uint8_t *bits, FIBITMAP *dib, int pitch, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, FIBOOL topdown) {
-	if (FreeImage_HasPixels(dib) && bits) {
-		for (unsigned i = 0; i < FreeImage_GetHeight(dib); ++i) {
-			uint8_t *scanline = FreeImage_GetScanLine(dib, topdown ? (FreeImage_GetHeight(dib) - i - 1) : i);
+/**
+Converts a scanline of dib into a line of the raw buffer with bpp bits per pixel.
+*/
+static void
+ConvertToRawLine(uint8_t *bits, uint8_t *scanline, FIBITMAP *dib, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, FIBOOL bIsTransparent) {
+	if ((bpp == 16) && (FreeImage_GetBPP(dib) == 16)) {
+		// convert 555 to 565 or vice versa
+
+		if ((red_mask == FI16_555_RED_MASK) && (green_mask == FI16_555_GREEN_MASK) && (blue_mask == FI16_555_BLUE_MASK)) {
+			if ((FreeImage_GetRedMask(dib) == FI16_565_RED_MASK) && (FreeImage_GetGreenMask(dib) == FI16_565_GREEN_MASK) && (FreeImage_GetBlueMask(dib) == FI16_565_BLUE_MASK)) {
+				FreeImage_ConvertLine16_565_To16_555(bits, scanline, FreeImage_GetWidth(dib));
+			} else {
+				memcpy(bits, scanline, FreeImage_GetLine(dib));
+			}
+		} else {
+			if ((FreeImage_GetRedMask(dib) == FI16_555_RED_MASK) && (FreeImage_GetGreenMask(dib) == FI16_555_GREEN_MASK) && (FreeImage_GetBlueMask(dib) == FI16_555_BLUE_MASK)) {
+				FreeImage_ConvertLine16_555_To16_565(bits, scanline, FreeImage_GetWidth(dib));
+			} else {
+				memcpy(bits, scanline, FreeImage_GetLine(dib));
+			}
+		}
+	} else if (FreeImage_GetBPP(dib) != bpp) {
+		switch (FreeImage_GetBPP(dib)) {
+			case 1 :
+				switch (bpp) {
+					CONVERT(1, 8)
+					CONVERTTO16WITHPALETTE(1)
+					CONVERTWITHPALETTE(1, 24)
+					CONVERTTO32WITHPALETTE(1)
+				}
 
-			if ((bpp == 16) && (FreeImage_GetBPP(dib) == 16)) {
-				// convert 555 to 565 or vice versa
+				break;
 
-				if ((red_mask == FI16_555_RED_MASK) && (green_mask == FI16_555_GREEN_MASK) && (blue_mask == FI16_555_BLUE_MASK)) {
-					if ((FreeImage_GetRedMask(dib) == FI16_565_RED_MASK) && (FreeImage_GetGreenMask(dib) == FI16_565_GREEN_MASK) && (FreeImage_GetBlueMask(dib) == FI16_565_BLUE_MASK)) {
-						FreeImage_ConvertLine16_565_To16_555(bits, scanline, FreeImage_GetWidth(dib));
-					} else {
-						memcpy(bits, scanline, FreeImage_GetLine(dib));
-					}
-				} else {
-					if ((FreeImage_GetRedMask(dib) == FI16_555_RED_MASK) && (FreeImage_GetGreenMask(dib) == FI16_555_GREEN_MASK) && (FreeImage_GetBlueMask(dib) == FI16_555_BLUE_MASK)) {
-						FreeImage_ConvertLine16_555_To16_565(bits, scanline, FreeImage_GetWidth(dib));
-					} else {
-						memcpy(bits, scanline, FreeImage_GetLine(dib));
-					}
+			case 4 :
+				switch (bpp) {
+					CONVERT(4, 8)
+					CONVERTTO16WITHPALETTE(4)
+					CONVERTWITHPALETTE(4, 24)
+					CONVERTTO32WITHPALETTE(4)
 				}
-			} else if (FreeImage_GetBPP(dib) != bpp) {
-                FIBOOL bIsTransparent = FreeImage_IsTransparent(dib);
-				switch (FreeImage_GetBPP(dib)) {
-					case 1 :
-						switch (bpp) {
-							CONVERT(1, 8)
-							CONVERTTO16WITHPALETTE(1)
-							CONVERTWITHPALETTE(1, 24)
-                            CONVERTTO32WITHPALETTE(1)
-                        }
-
-						break;
-
-					case 4 :
-						switch (bpp) {
-							CONVERT(4, 8)
-							CONVERTTO16WITHPALETTE(4)
-							CONVERTWITHPALETTE(4, 24)
-                            CONVERTTO32WITHPALETTE(4)
-						}
 
-						break;
+				break;
 
-					case 8 :
-						switch (bpp) {
-							CONVERTTO16WITHPALETTE(8)
-							CONVERTWITHPALETTE(8, 24)
-                            CONVERTTO32WITHPALETTE(8)
-						}
-
-						break;
+			case 8 :
+				switch (bpp) {
+					CONVERTTO16WITHPALETTE(8)
+					CONVERTWITHPALETTE(8, 24)
+					CONVERTTO32WITHPALETTE(8)
+				}
 
-					case 24 :
-						switch (bpp) {
-							CONVERT(24, 8)
-							CONVERTTO16(24)
-							CONVERT(24, 32)
-						}
+				break;
 
-						break;
+			case 24 :
+				switch (bpp) {
+					CONVERT(24, 8)
+					CONVERTTO16(24)
+					CONVERT(24, 32)
+				}
 
-					case 32 :
-						switch (bpp) {
-							CONVERT(32, 8)
-							CONVERTTO16(32)
-							CONVERT(32, 24)
-						}
+				break;
 
-						break;
+			case 32 :
+				switch (bpp) {
+					CONVERT(32, 8)
+					CONVERTTO16(32)
+					CONVERT(32, 24)
 				}
-			} else {
-				memcpy(bits, scanline, FreeImage_GetLine(dib));
-			}
 
-			bits += pitch;
+				break;
 		}
+	} else {
+		memcpy(bits, scanline, FreeImage_GetLine(dib));
+	}
+}
+
+/**
+Converts dib into a user provided buffer, rows are converted in parallel bands.
+24- and 32-bit targets in the opposite byte order (see IsSwappedLayout) get their red and blue bytes swapped.
+The pixels of dib are only read, a copy-on-write clone is never detached.
+*/
+void DLL_CALLCONV
+FreeImage_ConvertToRawBits(uint8_t *bits, FIBITMAP *dib, int pitch, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, FIBOOL topdown) {
+	if (FreeImage_HasPixels(dib) && bits) {
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+		const unsigned src_pitch = FreeImage_GetPitch(dib);
+		auto *src_bits = const_cast<uint8_t *>(FreeImage_GetConstBits(dib));
+		const FIBOOL bIsTransparent = FreeImage_IsTransparent(dib);
+		const bool swap = (FreeImage_GetImageType(dib) == FIT_BITMAP) && IsSwappedLayout(FIT_BITMAP, bpp, red_mask, green_mask, blue_mask);
+
+		ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(dib)), [&](unsigned first, unsigned last) {
+			for (unsigned i = first; i < last; ++i) {
+				uint8_t *line = bits + static_cast<ptrdiff_t>(i) * pitch;
+				uint8_t *scanline = src_bits + static_cast<size_t>(topdown ? (height - i - 1) : i) * src_pitch;
+
+				ConvertToRawLine(line, scanline, dib, bpp, red_mask, green_mask, blue_mask, bIsTransparent);
+				if (swap) {
+					SwapRedBlue(line, width, bpp / 8);
+				}
+			}
+		});
 	}
 }
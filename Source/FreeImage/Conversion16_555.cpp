@@ -23,6 +23,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 
@@ -80,7 +82,7 @@ FreeImage_ConvertLine16_565_To16_555(uint8_t *target, uint8_t *source, int width
 	uint16_t *src_bits = (uint16_t *)source;
 	uint16_t *new_bits = (uint16_t *)target;
 
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	for (int cols = ConvertLine16_565To555_SIMD(target, source, width_in_pixels); cols < width_in_pixels; cols++) {
 		new_bits[cols] = RGB555((((src_bits[cols] & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT) * 0xFF) / 0x1F,
 			                    (((src_bits[cols] & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT) * 0xFF) / 0x3F,
 								(((src_bits[cols] & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT) * 0xFF) / 0x1F);
@@ -115,6 +117,7 @@ FreeImage_ConvertLine32To16_555(uint8_t *target, uint8_t *source, int width_in_p
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_ConvertTo16Bits555(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertTo16Bits555");
 	if (!FreeImage_HasPixels(dib) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) return nullptr;
 
 	const int width = FreeImage_GetWidth(dib);
@@ -128,9 +131,9 @@ FreeImage_ConvertTo16Bits555(FIBITMAP *dib) {
 			if (!new_dib) {
 				return nullptr;
 			}
-			for (int rows = 0; rows < height; rows++) {
-				FreeImage_ConvertLine16_565_To16_555(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-			}
+			ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+				FreeImage_ConvertLine16_565_To16_555(dst_line, src_line, width);
+			});
 
 			// copy metadata from src to dst
 			FreeImage_CloneMetadata(new_dib, dib);
@@ -154,45 +157,45 @@ FreeImage_ConvertTo16Bits555(FIBITMAP *dib) {
 		switch (bpp) {
 			case 1 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine1To16_555(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine1To16_555(dst_line, src_line, width, FreeImage_GetPalette(dib));
+				});
 
 				return new_dib;
 			}
 
 			case 4 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine4To16_555(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine4To16_555(dst_line, src_line, width, FreeImage_GetPalette(dib));
+				});
 
 				return new_dib;
 			}
 
 			case 8 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine8To16_555(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine8To16_555(dst_line, src_line, width, FreeImage_GetPalette(dib));
+				});
 
 				return new_dib;
 			}
 
 			case 24 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine24To16_555(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine24To16_555(dst_line, src_line, width);
+				});
 
 				return new_dib;
 			}
 
 			case 32 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine32To16_555(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine32To16_555(dst_line, src_line, width);
+				});
 
 				return new_dib;
 			}
@@ -23,6 +23,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 //  internal conversions X to 16 bits (565)
@@ -76,7 +78,7 @@ FreeImage_ConvertLine16_555_To16_565(uint8_t *target, uint8_t *source, int width
 	uint16_t *src_bits = (uint16_t *)source;
 	uint16_t *new_bits = (uint16_t *)target;
 
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	for (int cols = ConvertLine16_555To565_SIMD(target, source, width_in_pixels); cols < width_in_pixels; cols++) {
 		new_bits[cols] = RGB565((((src_bits[cols] & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT) * 0xFF) / 0x1F,
 			                    (((src_bits[cols] & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT) * 0xFF) / 0x1F,
 								(((src_bits[cols] & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT) * 0xFF) / 0x1F);
@@ -111,6 +113,7 @@ FreeImage_ConvertLine32To16_565(uint8_t *target, uint8_t *source, int width_in_p
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_ConvertTo16Bits565(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertTo16Bits565");
 	if (!FreeImage_HasPixels(dib) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) return nullptr;
 
 	const int width = FreeImage_GetWidth(dib);
@@ -124,9 +127,9 @@ FreeImage_ConvertTo16Bits565(FIBITMAP *dib) {
 			if (!new_dib) {
 				return nullptr;
 			}
-			for (int rows = 0; rows < height; rows++) {
-				FreeImage_ConvertLine16_555_To16_565(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-			}
+			ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+				FreeImage_ConvertLine16_555_To16_565(dst_line, src_line, width);
+			});
 
 			// copy metadata from src to dst
 			FreeImage_CloneMetadata(new_dib, dib);
@@ -150,45 +153,45 @@ FreeImage_ConvertTo16Bits565(FIBITMAP *dib) {
 		switch (bpp) {
 			case 1 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine1To16_565(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine1To16_565(dst_line, src_line, width, FreeImage_GetPalette(dib));
+				});
 
 				return new_dib;
 			}
 
 			case 4 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine4To16_565(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine4To16_565(dst_line, src_line, width, FreeImage_GetPalette(dib));
+				});
 
 				return new_dib;
 			}
 
 			case 8 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine8To16_565(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine8To16_565(dst_line, src_line, width, FreeImage_GetPalette(dib));
+				});
 
 				return new_dib;
 			}
 
 			case 24 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine24To16_565(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine24To16_565(dst_line, src_line, width);
+				});
 
 				return new_dib;
 			}
 
 			case 32 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine32To16_565(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine32To16_565(dst_line, src_line, width);
+				});
 
 				return new_dib;
 			}
@@ -24,6 +24,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 //  internal conversions X to 24 bits
@@ -105,7 +107,10 @@ FreeImage_ConvertLine16To24_565(uint8_t *target, uint8_t *source, int width_in_p
 
 void DLL_CALLCONV
 FreeImage_ConvertLine32To24(uint8_t *target, uint8_t *source, int width_in_pixels) {
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	const int converted = ConvertLine32To24_SIMD(target, source, width_in_pixels);
+	target += 3 * converted;
+	source += 4 * converted;
+	for (int cols = converted; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_BLUE] = source[FI_RGBA_BLUE];
 		target[FI_RGBA_GREEN] = source[FI_RGBA_GREEN];
 		target[FI_RGBA_RED] = source[FI_RGBA_RED];
@@ -119,94 +124,84 @@ FreeImage_ConvertLine32To24(uint8_t *target, uint8_t *source, int width_in_pixel
 //   smart convert X to 24 bits
 // ----------------------------------------------------------
 
-FIBITMAP * DLL_CALLCONV
-FreeImage_ConvertTo24Bits(FIBITMAP *dib) {
-	if (!FreeImage_HasPixels(dib)) return nullptr;
+bool
+ConvertTo24BitsInto(FIBITMAP *new_dib, FIBITMAP *dib) {
+	if (!FreeImage_HasPixels(dib) || !FreeImage_HasPixels(new_dib)) return false;
 
 	const unsigned bpp = FreeImage_GetBPP(dib);
 	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
 
 	if ((image_type != FIT_BITMAP) && (image_type != FIT_RGB16) && (image_type != FIT_RGBA16)) {
-		return nullptr;
+		return false;
 	}
 	
 	const int width = FreeImage_GetWidth(dib);
 	const int height = FreeImage_GetHeight(dib);
 
+	if ((FreeImage_GetImageType(new_dib) != FIT_BITMAP) || (FreeImage_GetBPP(new_dib) != 24) ||
+		((int)FreeImage_GetWidth(new_dib) != width) || ((int)FreeImage_GetHeight(new_dib) != height)) {
+		return false;
+	}
+
 	if (image_type == FIT_BITMAP) {
 		if (bpp == 24) {
-			return FreeImage_Clone(dib);
-		}
-
-		FIBITMAP *new_dib = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-		if (!new_dib) {
-			return nullptr;
+			ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+				memcpy(dst_line, src_line, FreeImage_GetLine(dib));
+			});
+			return true;
 		}
 
-		// copy metadata from src to dst
-		FreeImage_CloneMetadata(new_dib, dib);
-
 		switch (bpp) {
 			case 1 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine1To24(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));					
-				}
-				return new_dib;
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine1To24(dst_line, src_line, width, FreeImage_GetPalette(dib));
+				});
+				return true;
 			}
 
 			case 4 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine4To24(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-				}
-				return new_dib;
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine4To24(dst_line, src_line, width, FreeImage_GetPalette(dib));
+				});
+				return true;
 			}
 				
 			case 8 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine8To24(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-				}
-				return new_dib;
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine8To24(dst_line, src_line, width, FreeImage_GetPalette(dib));
+				});
+				return true;
 			}
 
 			case 16 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					if ((FreeImage_GetRedMask(dib) == FI16_565_RED_MASK) && (FreeImage_GetGreenMask(dib) == FI16_565_GREEN_MASK) && (FreeImage_GetBlueMask(dib) == FI16_565_BLUE_MASK)) {
-						FreeImage_ConvertLine16To24_565(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-					} else {
-						// includes case where all the masks are 0
-						FreeImage_ConvertLine16To24_555(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-					}
+				if (IS_FORMAT_RGB565(dib)) {
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine16To24_565(dst_line, src_line, width);
+					});
+				} else {
+					// includes case where all the masks are 0
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine16To24_555(dst_line, src_line, width);
+					});
 				}
-				return new_dib;
+				return true;
 			}
 
 			case 32 :
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine32To24(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-				}
-				return new_dib;
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine32To24(dst_line, src_line, width);
+				});
+				return true;
 			}
 		}
 	
 	} else if (image_type == FIT_RGB16) {
-		FIBITMAP *new_dib = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-		if (!new_dib) {
-			return nullptr;
-		}
-
-		// copy metadata from src to dst
-		FreeImage_CloneMetadata(new_dib, dib);
-
-		const unsigned src_pitch = FreeImage_GetPitch(dib);
-		const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-		const uint8_t *src_bits = FreeImage_GetBits(dib);
-		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
-		for (int rows = 0; rows < height; rows++) {
+		ConvertScanLines(new_dib, dib, [&](uint8_t *dst_bits, uint8_t *src_bits) {
 			const FIRGB16 *src_pixel = (FIRGB16*)src_bits;
 			FIRGB8 *dst_pixel = (FIRGB8*)dst_bits;
 			for (int cols = 0; cols < width; cols++) {
@@ -214,26 +209,12 @@ FreeImage_ConvertTo24Bits(FIBITMAP *dib) {
 				dst_pixel[cols].green = (uint8_t)(src_pixel[cols].green >> 8);
 				dst_pixel[cols].blue  = (uint8_t)(src_pixel[cols].blue  >> 8);
 			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
+		});
 
-		return new_dib;
+		return true;
 
 	} else if (image_type == FIT_RGBA16) {
-		FIBITMAP *new_dib = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-		if (!new_dib) {
-			return nullptr;
-		}
-
-		// copy metadata from src to dst
-		FreeImage_CloneMetadata(new_dib, dib);
-
-		const unsigned src_pitch = FreeImage_GetPitch(dib);
-		const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-		const uint8_t *src_bits = FreeImage_GetBits(dib);
-		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
-		for (int rows = 0; rows < height; rows++) {
+		ConvertScanLines(new_dib, dib, [&](uint8_t *dst_bits, uint8_t *src_bits) {
 			const FIRGBA16 *src_pixel = (FIRGBA16*)src_bits;
 			FIRGB8 *dst_pixel = (FIRGB8*)dst_bits;
 			for (int cols = 0; cols < width; cols++) {
@@ -241,12 +222,41 @@ FreeImage_ConvertTo24Bits(FIBITMAP *dib) {
 				dst_pixel[cols].green = (uint8_t)(src_pixel[cols].green >> 8);
 				dst_pixel[cols].blue  = (uint8_t)(src_pixel[cols].blue  >> 8);
 			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
+		});
 
-		return new_dib;
+		return true;
+	}
+
+	return false;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_ConvertTo24Bits(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertTo24Bits");
+	if (!FreeImage_HasPixels(dib)) return nullptr;
+
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+
+	if ((image_type != FIT_BITMAP) && (image_type != FIT_RGB16) && (image_type != FIT_RGBA16)) {
+		return nullptr;
+	}
+	if ((image_type == FIT_BITMAP) && (bpp == 24)) {
+		return FreeImage_Clone(dib);
+	}
+
+	FIBITMAP *new_dib = FreeImage_Allocate(FreeImage_GetWidth(dib), FreeImage_GetHeight(dib), 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if (!new_dib) {
+		return nullptr;
+	}
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(new_dib, dib);
+
+	if (!ConvertTo24BitsInto(new_dib, dib)) {
+		FreeImage_Unload(new_dib);
+		return nullptr;
 	}
 
-	return nullptr;
+	return new_dib;
 }
@@ -24,6 +24,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 //  internal conversions X to 32 bits
@@ -54,7 +56,9 @@ FreeImage_ConvertLine4To32(uint8_t *target, uint8_t *source, int width_in_pixels
 
 void DLL_CALLCONV
 FreeImage_ConvertLine8To32(uint8_t *target, uint8_t *source, int width_in_pixels, FIRGBA8 *palette) {
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	const int converted = ConvertLine8To32_SIMD(target, source, width_in_pixels, palette);
+	target += 4 * converted;
+	for (int cols = converted; cols < width_in_pixels; cols++) {
 		const uint8_t idx = source[cols];
 
 		target[FI_RGBA_BLUE]	= palette[idx].blue;
@@ -69,7 +73,9 @@ void DLL_CALLCONV
 FreeImage_ConvertLine16To32_555(uint8_t *target, uint8_t *source, int width_in_pixels) {
 	uint16_t *bits = (uint16_t *)source;
 
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	const int converted = ConvertLine16To32_555_SIMD(target, source, width_in_pixels);
+	target += 4 * converted;
+	for (int cols = converted; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = (uint8_t)((((bits[cols] & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_GREEN] = (uint8_t)((((bits[cols] & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_BLUE]  = (uint8_t)((((bits[cols] & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT) * 0xFF) / 0x1F);
@@ -82,7 +88,9 @@ void DLL_CALLCONV
 FreeImage_ConvertLine16To32_565(uint8_t *target, uint8_t *source, int width_in_pixels) {
 	uint16_t *bits = (uint16_t *)source;
 
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	const int converted = ConvertLine16To32_565_SIMD(target, source, width_in_pixels);
+	target += 4 * converted;
+	for (int cols = converted; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = (uint8_t)((((bits[cols] & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_GREEN] = (uint8_t)((((bits[cols] & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT) * 0xFF) / 0x3F);
 		target[FI_RGBA_BLUE]  = (uint8_t)((((bits[cols] & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT) * 0xFF) / 0x1F);
@@ -107,7 +115,10 @@ The bug occurs in release mode only, when the image height is equal to 537
 */
 void DLL_CALLCONV
 FreeImage_ConvertLine24To32(uint8_t *target, uint8_t *source, int width_in_pixels) {
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	const int converted = ConvertLine24To32_SIMD(target, source, width_in_pixels);
+	target += 4 * converted;
+	source += 3 * converted;
+	for (int cols = converted; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = source[FI_RGBA_RED];
 		target[FI_RGBA_GREEN] = source[FI_RGBA_GREEN];
 		target[FI_RGBA_BLUE]  = source[FI_RGBA_BLUE];
@@ -173,136 +184,126 @@ FreeImage_ConvertLine8To32MapTransparency(uint8_t *target, uint8_t *source, int
 
 // ----------------------------------------------------------
 
-FIBITMAP * DLL_CALLCONV
-FreeImage_ConvertTo32Bits(FIBITMAP *dib) {
-	if (!FreeImage_HasPixels(dib)) return nullptr;
+bool
+ConvertTo32BitsInto(FIBITMAP *new_dib, FIBITMAP *dib) {
+	if (!FreeImage_HasPixels(dib) || !FreeImage_HasPixels(new_dib)) return false;
 
 	const int bpp = FreeImage_GetBPP(dib);
 	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
 	
 	if ((image_type != FIT_BITMAP) && (image_type != FIT_RGB16) && (image_type != FIT_RGBA16)) {
-		return nullptr;
+		return false;
 	}
 	
 	const int width = FreeImage_GetWidth(dib);
 	const int height = FreeImage_GetHeight(dib);
 
+	if ((FreeImage_GetImageType(new_dib) != FIT_BITMAP) || (FreeImage_GetBPP(new_dib) != 32) ||
+		((int)FreeImage_GetWidth(new_dib) != width) || ((int)FreeImage_GetHeight(new_dib) != height)) {
+		return false;
+	}
+
 	if (image_type == FIT_BITMAP) {
 
 		if (bpp == 32) {
-			return FreeImage_Clone(dib);
-		}
-
-		FIBITMAP *new_dib = FreeImage_Allocate(width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-		if (!new_dib) {
-			return nullptr;
+			ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+				memcpy(dst_line, src_line, FreeImage_GetLine(dib));
+			});
+			return true;
 		}
 
-		// copy metadata from src to dst
-		FreeImage_CloneMetadata(new_dib, dib);
-
 		FIBOOL bIsTransparent = FreeImage_IsTransparent(dib);
 
 		switch (bpp) {
 			case 1:
 			{
 				if (bIsTransparent) {
-					for (int rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine1To32MapTransparency(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib), FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine1To32MapTransparency(dst_line, src_line, width, FreeImage_GetPalette(dib), FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
+					});
 				} else {
-					for (int rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine1To32(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine1To32(dst_line, src_line, width, FreeImage_GetPalette(dib));
+					});
 				}
 
-				return new_dib;
+				return true;
 			}
 
 			case 2:
 			{
 				if (bIsTransparent) {
-					for (int rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine2To32MapTransparency(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib), FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine2To32MapTransparency(dst_line, src_line, width, FreeImage_GetPalette(dib), FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
+					});
 				}
 				else {
-					for (int rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine2To32(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine2To32(dst_line, src_line, width, FreeImage_GetPalette(dib));
+					});
 				}
 
-				return new_dib;
+				return true;
 			}
 
 			case 4:
 			{
 				if (bIsTransparent) {
-					for (int rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine4To32MapTransparency(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib), FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine4To32MapTransparency(dst_line, src_line, width, FreeImage_GetPalette(dib), FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
+					});
 				} else {
-					for (int rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine4To32(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine4To32(dst_line, src_line, width, FreeImage_GetPalette(dib));
+					});
 				}
 
-				return new_dib;
+				return true;
 			}
 				
 			case 8:
 			{
 				if (bIsTransparent) {
-					for (int rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine8To32MapTransparency(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib), FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine8To32MapTransparency(dst_line, src_line, width, FreeImage_GetPalette(dib), FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
+					});
 				} else {
-					for (int rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine8To32(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine8To32(dst_line, src_line, width, FreeImage_GetPalette(dib));
+					});
 				}
 
-				return new_dib;
+				return true;
 			}
 
 			case 16:
 			{
-				for (int rows = 0; rows < height; rows++) {
-					if ((FreeImage_GetRedMask(dib) == FI16_565_RED_MASK) && (FreeImage_GetGreenMask(dib) == FI16_565_GREEN_MASK) && (FreeImage_GetBlueMask(dib) == FI16_565_BLUE_MASK)) {
-						FreeImage_ConvertLine16To32_565(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-					} else {
-						// includes case where all the masks are 0
-						FreeImage_ConvertLine16To32_555(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-					}
+				if (IS_FORMAT_RGB565(dib)) {
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine16To32_565(dst_line, src_line, width);
+					});
+				} else {
+					// includes case where all the masks are 0
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine16To32_555(dst_line, src_line, width);
+					});
 				}
 
-				return new_dib;
+				return true;
 			}
 
 			case 24:
 			{
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine24To32(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine24To32(dst_line, src_line, width);
+				});
 
-				return new_dib;
+				return true;
 			}
 		}
 
 	} else if (image_type == FIT_RGB16) {
-		FIBITMAP *new_dib = FreeImage_Allocate(width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-		if (!new_dib) {
-			return nullptr;
-		}
-
-		// copy metadata from src to dst
-		FreeImage_CloneMetadata(new_dib, dib);
-
-		const unsigned src_pitch = FreeImage_GetPitch(dib);
-		const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-		const uint8_t *src_bits = FreeImage_GetBits(dib);
-		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
-		for (int rows = 0; rows < height; rows++) {
+		ConvertScanLines(new_dib, dib, [&](uint8_t *dst_bits, uint8_t *src_bits) {
 			const FIRGB16 *src_pixel = (FIRGB16*)src_bits;
 			FIRGBA8 *dst_pixel = (FIRGBA8*)dst_bits;
 			for (int cols = 0; cols < width; cols++) {
@@ -311,26 +312,12 @@ FreeImage_ConvertTo32Bits(FIBITMAP *dib) {
 				dst_pixel[cols].blue		= (uint8_t)(src_pixel[cols].blue  >> 8);
 				dst_pixel[cols].alpha = (uint8_t)0xFF;
 			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
+		});
 
-		return new_dib;
+		return true;
 
 	} else if (image_type == FIT_RGBA16) {
-		FIBITMAP *new_dib = FreeImage_Allocate(width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-		if (!new_dib) {
-			return nullptr;
-		}
-
-		// copy metadata from src to dst
-		FreeImage_CloneMetadata(new_dib, dib);
-
-		const unsigned src_pitch = FreeImage_GetPitch(dib);
-		const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-		const uint8_t *src_bits = FreeImage_GetBits(dib);
-		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
-		for (int rows = 0; rows < height; rows++) {
+		ConvertScanLines(new_dib, dib, [&](uint8_t *dst_bits, uint8_t *src_bits) {
 			const FIRGBA16 *src_pixel = (FIRGBA16*)src_bits;
 			FIRGBA8 *dst_pixel = (FIRGBA8*)dst_bits;
 			for (int cols = 0; cols < width; cols++) {
@@ -339,12 +326,41 @@ FreeImage_ConvertTo32Bits(FIBITMAP *dib) {
 				dst_pixel[cols].blue		= (uint8_t)(src_pixel[cols].blue  >> 8);
 				dst_pixel[cols].alpha = (uint8_t)(src_pixel[cols].alpha >> 8);
 			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
+		});
 
-		return new_dib;
+		return true;
 	}
 	
-	return nullptr;
+	return false;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_ConvertTo32Bits(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertTo32Bits");
+	if (!FreeImage_HasPixels(dib)) return nullptr;
+
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+
+	if ((image_type != FIT_BITMAP) && (image_type != FIT_RGB16) && (image_type != FIT_RGBA16)) {
+		return nullptr;
+	}
+	if ((image_type == FIT_BITMAP) && (bpp == 32)) {
+		return FreeImage_Clone(dib);
+	}
+
+	FIBITMAP *new_dib = FreeImage_Allocate(FreeImage_GetWidth(dib), FreeImage_GetHeight(dib), 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if (!new_dib) {
+		return nullptr;
+	}
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(new_dib, dib);
+
+	if (!ConvertTo32BitsInto(new_dib, dib)) {
+		FreeImage_Unload(new_dib);
+		return nullptr;
+	}
+
+	return new_dib;
 }
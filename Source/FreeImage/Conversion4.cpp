@@ -21,6 +21,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
 
 // ----------------------------------------------------------
 //  internal conversions X to 4 bits
@@ -140,6 +141,7 @@ FreeImage_ConvertLine32To4(uint8_t *target, uint8_t *source, int width_in_pixels
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_ConvertTo4Bits(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertTo4Bits");
 	if (!FreeImage_HasPixels(dib)) return nullptr;
 
 	const int bpp = FreeImage_GetBPP(dib);
@@ -189,9 +191,9 @@ FreeImage_ConvertTo4Bits(FIBITMAP *dib) {
 
 				// Expand and copy the bitmap data
 
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine1To4(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine1To4(dst_line, src_line, width);
+				});
 				return new_dib;
 			}
 
@@ -199,9 +201,9 @@ FreeImage_ConvertTo4Bits(FIBITMAP *dib) {
 			{
 				// Expand and copy the bitmap data
 
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine8To4(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width, FreeImage_GetPalette(dib));
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine8To4(dst_line, src_line, width, FreeImage_GetPalette(dib));
+				});
 				return new_dib;
 			}
 
@@ -209,12 +211,14 @@ FreeImage_ConvertTo4Bits(FIBITMAP *dib) {
 			{
 				// Expand and copy the bitmap data
 
-				for (int rows = 0; rows < height; rows++) {
-					if ((FreeImage_GetRedMask(dib) == FI16_565_RED_MASK) && (FreeImage_GetGreenMask(dib) == FI16_565_GREEN_MASK) && (FreeImage_GetBlueMask(dib) == FI16_565_BLUE_MASK)) {
-						FreeImage_ConvertLine16To4_565(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-					} else {
-						FreeImage_ConvertLine16To4_555(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-					}
+				if (IS_FORMAT_RGB565(dib)) {
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine16To4_565(dst_line, src_line, width);
+					});
+				} else {
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine16To4_555(dst_line, src_line, width);
+					});
 				}
 				
 				return new_dib;
@@ -224,9 +228,9 @@ FreeImage_ConvertTo4Bits(FIBITMAP *dib) {
 			{
 				// Expand and copy the bitmap data
 
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine24To4(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);					
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine24To4(dst_line, src_line, width);
+				});
 				return new_dib;
 			}
 
@@ -234,9 +238,9 @@ FreeImage_ConvertTo4Bits(FIBITMAP *dib) {
 			{
 				// Expand and copy the bitmap data
 
-				for (int rows = 0; rows < height; rows++) {
-					FreeImage_ConvertLine32To4(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-				}
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+					FreeImage_ConvertLine32To4(dst_line, src_line, width);
+				});
 				return new_dib;
 			}
 		}
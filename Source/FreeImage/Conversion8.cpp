@@ -25,6 +25,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 //  internal conversions X to 8 bits
@@ -32,7 +34,8 @@
 
 void DLL_CALLCONV
 FreeImage_ConvertLine1To8(uint8_t *target, uint8_t *source, int width_in_pixels) {
-	for (unsigned cols = 0; cols < (unsigned)width_in_pixels; cols++)
+	const unsigned converted = ConvertLine1To8_SIMD(target, source, width_in_pixels);
+	for (unsigned cols = converted; cols < (unsigned)width_in_pixels; cols++)
 		target[cols] = (source[cols >> 3] & (0x80 >> (cols & 0x07))) != 0 ? 255 : 0;	
 }
 
@@ -96,6 +99,7 @@ FreeImage_ConvertLine32To8(uint8_t *target, uint8_t *source, int width_in_pixels
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_ConvertTo8Bits(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertTo8Bits");
 	if (!FreeImage_HasPixels(dib)) {
 		return nullptr;
 	}
@@ -143,9 +147,9 @@ FreeImage_ConvertTo8Bits(FIBITMAP *dib) {
 					}
 
 					// Expand and copy the bitmap data
-					for (unsigned rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine1To8(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine1To8(dst_line, src_line, width);
+					});
 					return new_dib;
 				}
 
@@ -157,9 +161,9 @@ FreeImage_ConvertTo8Bits(FIBITMAP *dib) {
 					}
 
 					// Expand and copy the bitmap data
-					for (unsigned rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine4To8(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);					
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine4To8(dst_line, src_line, width);
+					});
 					return new_dib;
 				}
 
@@ -167,13 +171,13 @@ FreeImage_ConvertTo8Bits(FIBITMAP *dib) {
 				{
 					// Expand and copy the bitmap data
 					if (IS_FORMAT_RGB565(dib)) {
-						for (unsigned rows = 0; rows < height; rows++) {
-							FreeImage_ConvertLine16To8_565(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-						}
+						ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+							FreeImage_ConvertLine16To8_565(dst_line, src_line, width);
+						});
 					} else {
-						for (unsigned rows = 0; rows < height; rows++) {
-							FreeImage_ConvertLine16To8_555(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-						}
+						ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+							FreeImage_ConvertLine16To8_555(dst_line, src_line, width);
+						});
 					}
 					return new_dib;
 				}
@@ -181,38 +185,31 @@ FreeImage_ConvertTo8Bits(FIBITMAP *dib) {
 				case 24 :
 				{
 					// Expand and copy the bitmap data
-					for (unsigned rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine24To8(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);					
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine24To8(dst_line, src_line, width);
+					});
 					return new_dib;
 				}
 
 				case 32 :
 				{
 					// Expand and copy the bitmap data
-					for (unsigned rows = 0; rows < height; rows++) {
-						FreeImage_ConvertLine32To8(FreeImage_GetScanLine(new_dib, rows), FreeImage_GetScanLine(dib, rows), width);
-					}
+					ConvertScanLines(new_dib, dib, [&](uint8_t *dst_line, uint8_t *src_line) {
+						FreeImage_ConvertLine32To8(dst_line, src_line, width);
+					});
 					return new_dib;
 				}
 			}
 
 		} else if (image_type == FIT_UINT16) {
 
-			const unsigned src_pitch = FreeImage_GetPitch(dib);
-			const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-			const uint8_t *src_bits = FreeImage_GetBits(dib);
-			uint8_t *dst_bits = FreeImage_GetBits(new_dib);
-
-			for (unsigned rows = 0; rows < height; rows++) {
+			ConvertScanLines(new_dib, dib, [&](uint8_t *dst_bits, uint8_t *src_bits) {
 				const uint16_t *const src_pixel = (uint16_t*)src_bits;
 				uint8_t *dst_pixel = (uint8_t*)dst_bits;
 				for (unsigned cols = 0; cols < width; cols++) {
 					dst_pixel[cols] = (uint8_t)(src_pixel[cols] >> 8);
 				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
-			}
+			});
 			return new_dib;
 		}
 
@@ -223,6 +220,7 @@ FreeImage_ConvertTo8Bits(FIBITMAP *dib) {
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_ConvertToGreyscale(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToGreyscale");
 	if (!FreeImage_HasPixels(dib)) {
 		return nullptr;
 	}
@@ -252,48 +250,36 @@ FreeImage_ConvertToGreyscale(FIBITMAP *dib) {
 			pal++;
 		}
 
-		const uint8_t *src_bits = FreeImage_GetBits(dib);
-		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
-
-		const unsigned src_pitch = FreeImage_GetPitch(dib);
-		const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-
 		switch (bpp) {
 			case 1:
 			{
-				for (unsigned y = 0; y < height; y++) {
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_bits, uint8_t *src_bits) {
 					for (unsigned x = 0; x < width; x++) {
 						const unsigned pixel = (src_bits[x >> 3] & (0x80 >> (x & 0x07))) != 0;
 						dst_bits[x] = grey_pal[pixel];
 					}
-					src_bits += src_pitch;
-					dst_bits += dst_pitch;
-				}
+				});
 			}
 			break;
 
 			case 4:
 			{
-				for (unsigned y = 0; y < height; y++) {
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_bits, uint8_t *src_bits) {
 					for (unsigned x = 0; x < width; x++) {
 						const unsigned pixel = x & 0x01 ? src_bits[x >> 1] & 0x0F : src_bits[x >> 1] >> 4;
 						dst_bits[x] = grey_pal[pixel];
 					}
-					src_bits += src_pitch;
-					dst_bits += dst_pitch;
-				}
+				});
 			}
 			break;
 
 			case 8:
 			{
-				for (unsigned y = 0; y < height; y++) {
+				ConvertScanLines(new_dib, dib, [&](uint8_t *dst_bits, uint8_t *src_bits) {
 					for (unsigned x = 0; x < width; x++) {
 						dst_bits[x] = grey_pal[src_bits[x]];
 					}
-					src_bits += src_pitch;
-					dst_bits += dst_pitch;
-				}
+				});
 			}
 			break;
 		}
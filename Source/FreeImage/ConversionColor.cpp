@@ -40,3 +40,8 @@ FIBITMAP* FreeImage_ConvertToColor(FIBITMAP* dib, FREE_IMAGE_COLOR_TYPE dst_colo
 	}
 	return nullptr;
 }
+
+FIBOOL DLL_CALLCONV FreeImage_ConvertToYUVPlanes(FIBITMAP* dib, FREE_IMAGE_YUV_PLANES layout, uint8_t* const planes[3], const unsigned strides[3], FREE_IMAGE_CVT_COLOR_PARAM yuv_standard)
+{
+	return ConvertRgbToYuvPlanes(dib, layout, planes, strides, yuv_standard) ? TRUE : FALSE;
+}
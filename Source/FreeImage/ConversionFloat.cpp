@@ -21,7 +21,9 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
 #include "SimpleTools.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 //   smart convert X to Float
@@ -30,6 +32,7 @@
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_ConvertToFloat(FIBITMAP *dib, FIBOOL scale_linear) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToFloat");
 	FIBITMAP *src{};
 	FIBITMAP *dst{};
 
@@ -63,6 +66,11 @@ FreeImage_ConvertToFloat(FIBITMAP *dib, FIBOOL scale_linear) {
 		case FIT_RGBAF:
 			src = dib;
 			break;
+		case FIT_RGBAH:
+			// half floats are expanded first
+			src = FreeImage_ConvertToRGBAF(dib);
+			if (!src) return nullptr;
+			break;
 		case FIT_FLOAT:
 			// float type : clone the src
 			return FreeImage_Clone(dib);
@@ -89,34 +97,31 @@ FreeImage_ConvertToFloat(FIBITMAP *dib, FIBOOL scale_linear) {
 	// convert from src type to float
 	switch (src_type) {
 		case FIT_BITMAP:
-			if (scale_linear) {
-				BitmapTransform<float, uint8_t>(dst, src, [](uint8_t v) { 
-					return static_cast<float>(v) / static_cast<float>(std::numeric_limits<uint8_t>::max()); });
-			}
-			else {
-				BitmapTransform<float, uint8_t>(dst, src, [](uint8_t v) { return static_cast<float>(v); });
-			}
-			break;
+		{
+			const float divisor = scale_linear ? static_cast<float>(std::numeric_limits<uint8_t>::max()) : 1.0F;
+			ConvertScanLines(dst, src, [width, divisor](uint8_t *dst_line, uint8_t *src_line) {
+				ConvertToFloat(reinterpret_cast<float*>(dst_line), src_line, width, divisor);
+			});
+		}
+		break;
 
 		case FIT_UINT16:
-			if (scale_linear) {
-				BitmapTransform<float, uint16_t>(dst, src, [](uint16_t v) { 
-					return static_cast<float>(v) / static_cast<float>(std::numeric_limits<uint16_t>::max()); });
-			}
-			else {
-				BitmapTransform<float, uint16_t>(dst, src, [](uint16_t v) { return static_cast<float>(v); });
-			}
-			break;
+		{
+			const float divisor = scale_linear ? static_cast<float>(std::numeric_limits<uint16_t>::max()) : 1.0F;
+			ConvertScanLines(dst, src, [width, divisor](uint8_t *dst_line, uint8_t *src_line) {
+				ConvertToFloat(reinterpret_cast<float*>(dst_line), reinterpret_cast<const uint16_t*>(src_line), width, divisor);
+			});
+		}
+		break;
 
 		case FIT_INT16:
-			if (scale_linear) {
-				BitmapTransform<float, int16_t>(dst, src, [](int16_t v) {
-					return static_cast<float>(v) / static_cast<float>(std::numeric_limits<int16_t>::max()); });
-			}
-			else {
-				BitmapTransform<float, int16_t>(dst, src, [](int16_t v) { return static_cast<float>(v); });
-			}
-			break;
+		{
+			const float divisor = scale_linear ? static_cast<float>(std::numeric_limits<int16_t>::max()) : 1.0F;
+			ConvertScanLines(dst, src, [width, divisor](uint8_t *dst_line, uint8_t *src_line) {
+				ConvertToFloat(reinterpret_cast<float*>(dst_line), reinterpret_cast<const int16_t*>(src_line), width, divisor);
+			});
+		}
+		break;
 
 		case FIT_UINT32:
 			if (scale_linear) {
@@ -124,7 +129,7 @@ FreeImage_ConvertToFloat(FIBITMAP *dib, FIBOOL scale_linear) {
 					return static_cast<float>(static_cast<double>(v) / static_cast<double>(std::numeric_limits<uint32_t>::max())); });
 			}
 			else {
-				BitmapTransform<float, uint32_t>(dst, src, [](uint32_t v) { return static_cast<float>(v); });
+				BitmapTransform<float, uint32_t>(exec::par_unseq, dst, src, [](uint32_t v) { return static_cast<float>(v); });
 			}
 			break;
 
@@ -134,7 +139,7 @@ FreeImage_ConvertToFloat(FIBITMAP *dib, FIBOOL scale_linear) {
 					return static_cast<float>(static_cast<double>(v) / static_cast<double>(std::numeric_limits<int32_t>::max())); });
 			}
 			else {
-				BitmapTransform<float, int32_t>(dst, src, [](int32_t v) { return static_cast<float>(v); });
+				BitmapTransform<float, int32_t>(exec::par_unseq, dst, src, [](int32_t v) { return static_cast<float>(v); });
 			}
 			break;
 
@@ -194,6 +199,7 @@ FreeImage_ConvertToFloat(FIBITMAP *dib, FIBOOL scale_linear) {
 			break;
 
 		case FIT_RGBAF:
+		case FIT_RGBAH:
 			if (scale_linear) {
 				BitmapTransform<float, FIRGBAF>(dst, src, [](const FIRGBAF& p) {
 					return CLAMP(LUMA_REC709(p.red, p.green, p.blue), 0.0F, 1.0F); });
@@ -205,7 +211,7 @@ FreeImage_ConvertToFloat(FIBITMAP *dib, FIBOOL scale_linear) {
 			break;
 
 		case FIT_DOUBLE:
-			BitmapTransform<float, double>(dst, src, [](double v) { return static_cast<float>(v); });
+			BitmapTransform<float, double>(exec::par_unseq, dst, src, [](double v) { return static_cast<float>(v); });
 			break;
 	}
 
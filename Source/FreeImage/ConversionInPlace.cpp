@@ -0,0 +1,175 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "Trace.h"
+
+// ----------------------------------------------------------
+//   in-place conversions
+// ----------------------------------------------------------
+
+/**
+Converts every pixel of dib from Src_ to Dst_ within its own pixel buffer.
+Each source pixel is read before the destination pixel, which may overlap it, is written.
+*/
+template <typename Src_, typename Dst_, typename Convert_>
+static FIBOOL
+ReformatPixels(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp, Convert_ convert) {
+	static_assert(sizeof(Dst_) <= sizeof(Src_), "In-place conversions cannot expand pixels");
+	const unsigned width = FreeImage_GetWidth(dib);
+	return FreeImage_ReformatInPlace(dib, type, bpp, [&](uint8_t *dst_line, const uint8_t *src_line) {
+		for (unsigned x = 0; x < width; x++) {
+			Src_ src;
+			memcpy(&src, src_line + x * sizeof(Src_), sizeof(Src_));
+			const Dst_ dst = convert(src);
+			memcpy(dst_line + x * sizeof(Dst_), &dst, sizeof(Dst_));
+		}
+	}) ? TRUE : FALSE;
+}
+
+static FIRGB8
+ToRGB8(uint16_t red, uint16_t green, uint16_t blue) {
+	FIRGB8 dst;
+	dst.red   = (uint8_t)(red   >> 8);
+	dst.green = (uint8_t)(green >> 8);
+	dst.blue  = (uint8_t)(blue  >> 8);
+	return dst;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_ConvertInPlace(FIBITMAP *dib, FREE_IMAGE_TYPE dst_type, unsigned dst_bpp) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertInPlace");
+	if (!dib) {
+		return FALSE;
+	}
+
+	const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType(dib);
+	const unsigned src_bpp = FreeImage_GetBPP(dib);
+
+	// the bit depth of types other than FIT_BITMAP is implied
+	unsigned type_bpp = dst_bpp;
+	switch (dst_type) {
+		case FIT_BITMAP:
+			break;
+		case FIT_FLOAT:
+			type_bpp = 8 * sizeof(float);
+			break;
+		case FIT_RGB16:
+			type_bpp = 8 * sizeof(FIRGB16);
+			break;
+		case FIT_RGBF:
+			type_bpp = 8 * sizeof(FIRGBF);
+			break;
+		default:
+			type_bpp = (src_type == dst_type) ? src_bpp : 0;
+			break;
+	}
+	if ((dst_bpp != 0) && (dst_bpp != type_bpp)) {
+		return FALSE;
+	}
+	dst_bpp = type_bpp;
+
+	if ((src_type == dst_type) && (src_bpp == dst_bpp)) {
+		return TRUE;
+	}
+
+	switch (src_type) {
+		case FIT_BITMAP:
+			// as FreeImage_ConvertTo24Bits and FreeImage_ConvertTo8Bits
+			if ((dst_type == FIT_BITMAP) && (src_bpp == 32) && (dst_bpp == 24)) {
+				return ReformatPixels<FIRGBA8, FIRGB8>(dib, FIT_BITMAP, 24, [](const FIRGBA8& p) {
+					FIRGB8 dst;
+					dst.red = p.red;
+					dst.green = p.green;
+					dst.blue = p.blue;
+					return dst;
+				});
+			}
+			if ((dst_type == FIT_BITMAP) && (src_bpp == 32) && (dst_bpp == 8)) {
+				return ReformatPixels<FIRGBA8, uint8_t>(dib, FIT_BITMAP, 8, [](const FIRGBA8& p) {
+					return GREY(p.red, p.green, p.blue); });
+			}
+			if ((dst_type == FIT_BITMAP) && (src_bpp == 24) && (dst_bpp == 8)) {
+				return ReformatPixels<FIRGB8, uint8_t>(dib, FIT_BITMAP, 8, [](const FIRGB8& p) {
+					return GREY(p.red, p.green, p.blue); });
+			}
+			break;
+
+		case FIT_UINT16:
+			// as FreeImage_ConvertTo8Bits
+			if ((dst_type == FIT_BITMAP) && (dst_bpp == 8)) {
+				return ReformatPixels<uint16_t, uint8_t>(dib, FIT_BITMAP, 8, [](uint16_t v) {
+					return (uint8_t)(v >> 8); });
+			}
+			break;
+
+		case FIT_RGB16:
+			// as FreeImage_ConvertTo24Bits
+			if ((dst_type == FIT_BITMAP) && (dst_bpp == 24)) {
+				return ReformatPixels<FIRGB16, FIRGB8>(dib, FIT_BITMAP, 24, [](const FIRGB16& p) {
+					return ToRGB8(p.red, p.green, p.blue); });
+			}
+			break;
+
+		case FIT_RGBA16:
+			// as FreeImage_ConvertTo24Bits, FreeImage_ConvertTo32Bits and FreeImage_ConvertToRGB16
+			if ((dst_type == FIT_BITMAP) && (dst_bpp == 24)) {
+				return ReformatPixels<FIRGBA16, FIRGB8>(dib, FIT_BITMAP, 24, [](const FIRGBA16& p) {
+					return ToRGB8(p.red, p.green, p.blue); });
+			}
+			if ((dst_type == FIT_BITMAP) && (dst_bpp == 32)) {
+				return ReformatPixels<FIRGBA16, FIRGBA8>(dib, FIT_BITMAP, 32, [](const FIRGBA16& p) {
+					FIRGBA8 dst;
+					dst.red   = (uint8_t)(p.red   >> 8);
+					dst.green = (uint8_t)(p.green >> 8);
+					dst.blue  = (uint8_t)(p.blue  >> 8);
+					dst.alpha = (uint8_t)(p.alpha >> 8);
+					return dst;
+				});
+			}
+			if (dst_type == FIT_RGB16) {
+				return ReformatPixels<FIRGBA16, FIRGB16>(dib, FIT_RGB16, dst_bpp, [](const FIRGBA16& p) {
+					FIRGB16 dst;
+					dst.red   = p.red;
+					dst.green = p.green;
+					dst.blue  = p.blue;
+					return dst;
+				});
+			}
+			break;
+
+		case FIT_RGBF:
+			// as FreeImage_ConvertToFloat with scale_linear
+			if (dst_type == FIT_FLOAT) {
+				return ReformatPixels<FIRGBF, float>(dib, FIT_FLOAT, dst_bpp, [](const FIRGBF& p) {
+					return CLAMP(LUMA_REC709(p.red, p.green, p.blue), 0.0F, 1.0F); });
+			}
+			break;
+
+		case FIT_RGBAF:
+			// as FreeImage_ConvertToRGBF and FreeImage_ConvertToFloat with scale_linear
+			if (dst_type == FIT_RGBF) {
+				return ReformatPixels<FIRGBAF, FIRGBF>(dib, FIT_RGBF, dst_bpp, [](const FIRGBAF& p) {
+					FIRGBF dst;
+					dst.red   = CLAMP(p.red, 0.0F, 1.0F);
+					dst.green = CLAMP(p.green, 0.0F, 1.0F);
+					dst.blue  = CLAMP(p.blue, 0.0F, 1.0F);
+					return dst;
+				});
+			}
+			if (dst_type == FIT_FLOAT) {
+				return ReformatPixels<FIRGBAF, float>(dib, FIT_FLOAT, dst_bpp, [](const FIRGBAF& p) {
+					return CLAMP(LUMA_REC709(p.red, p.green, p.blue), 0.0F, 1.0F); });
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	return FALSE;
+}
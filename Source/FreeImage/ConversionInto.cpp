@@ -0,0 +1,126 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "Trace.h"
+
+// ----------------------------------------------------------
+//   conversions into a caller provided bitmap
+// ----------------------------------------------------------
+
+static bool
+HasSameFormat(FIBITMAP *dst, FIBITMAP *src) {
+	if ((FreeImage_GetImageType(dst) != FreeImage_GetImageType(src)) || (FreeImage_GetBPP(dst) != FreeImage_GetBPP(src))) {
+		return false;
+	}
+	if (FreeImage_HasRGBMasks(src) || FreeImage_HasRGBMasks(dst)) {
+		return (FreeImage_GetRedMask(dst) == FreeImage_GetRedMask(src)) &&
+			(FreeImage_GetGreenMask(dst) == FreeImage_GetGreenMask(src)) &&
+			(FreeImage_GetBlueMask(dst) == FreeImage_GetBlueMask(src));
+	}
+	return true;
+}
+
+/**
+Writes the pixels of src into dst without any intermediate bitmap.
+Handles a dst of the same format as src and 24 or 32-bit FIT_BITMAP destinations.
+*/
+static bool
+ConvertPixels(FIBITMAP *dst, FIBITMAP *src) {
+	if (HasSameFormat(dst, src)) {
+		const unsigned line = FreeImage_GetLine(src);
+		ConvertScanLines(dst, src, [line](uint8_t *dst_line, uint8_t *src_line) {
+			memcpy(dst_line, src_line, line);
+		});
+		if (FreeImage_GetColorsUsed(src) > 0) {
+			memcpy(FreeImage_GetPalette(dst), FreeImage_GetPalette(src), FreeImage_GetColorsUsed(src) * sizeof(FIRGBA8));
+		}
+		FreeImage_SetTransparencyTable(dst, FreeImage_GetTransparencyTable(src), FreeImage_GetTransparencyCount(src));
+		return true;
+	}
+	if (FreeImage_GetImageType(dst) == FIT_BITMAP) {
+		switch (FreeImage_GetBPP(dst)) {
+			case 24:
+				return ConvertTo24BitsInto(dst, src);
+			case 32:
+				return ConvertTo32BitsInto(dst, src);
+		}
+	}
+	return false;
+}
+
+/**
+Converts a FIT_BITMAP image to the bit depth of dst with the allocating converters.
+24 and 32-bit images are returned as a clone, ConvertPixels writes them into dst directly.
+*/
+static FIBITMAP*
+ConvertBitmapLike(FIBITMAP *dib, FIBITMAP *dst) {
+	switch (FreeImage_GetBPP(dst)) {
+		case 1:
+			return FreeImage_Threshold(dib, 128);
+		case 4:
+			return FreeImage_ConvertTo4Bits(dib);
+		case 8:
+			return FreeImage_ConvertTo8Bits(dib);
+		case 16:
+			return IS_FORMAT_RGB565(dst) ? FreeImage_ConvertTo16Bits565(dib) : FreeImage_ConvertTo16Bits555(dib);
+		case 24:
+		case 32:
+			return FreeImage_Clone(dib);
+	}
+	return nullptr;
+}
+
+/**
+Converts src to the format of dst, or to a format ConvertPixels can write into dst.
+*/
+static FIBITMAP*
+ConvertLike(FIBITMAP *src, FIBITMAP *dst) {
+	const FREE_IMAGE_TYPE dst_type = FreeImage_GetImageType(dst);
+	if (dst_type != FIT_BITMAP) {
+		return FreeImage_ConvertToType(src, dst_type, TRUE);
+	}
+	if (FreeImage_GetImageType(src) == FIT_BITMAP) {
+		return ConvertBitmapLike(src, dst);
+	}
+	FIBITMAP *standard = FreeImage_ConvertToType(src, FIT_BITMAP, TRUE);
+	if (!standard || HasSameFormat(dst, standard) || (FreeImage_GetBPP(dst) >= 24)) {
+		return standard;
+	}
+	FIBITMAP *converted = ConvertBitmapLike(standard, dst);
+	FreeImage_Unload(standard);
+	return converted;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_ConvertInto(FIBITMAP *dst, FIBITMAP *src) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertInto");
+	if (!FreeImage_HasPixels(src) || !FreeImage_HasPixels(dst) || (dst == src)) {
+		return FALSE;
+	}
+	if ((FreeImage_GetWidth(dst) != FreeImage_GetWidth(src)) || (FreeImage_GetHeight(dst) != FreeImage_GetHeight(src))) {
+		return FALSE;
+	}
+
+	if (!ConvertPixels(dst, src)) {
+		// go through the allocating converters, then write the result into dst
+		FIBITMAP *converted = ConvertLike(src, dst);
+		if (!converted) {
+			return FALSE;
+		}
+		const bool result = ConvertPixels(dst, converted);
+		FreeImage_Unload(converted);
+		if (!result) {
+			return FALSE;
+		}
+	}
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, src);
+
+	return TRUE;
+}
@@ -21,6 +21,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
 
 // ----------------------------------------------------------
 //   smart convert X to RGBA16
@@ -28,6 +29,7 @@
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_ConvertToRGBA16(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToRGBA16");
 	FIBITMAP *src{};
 	FIBITMAP *dst{};
 
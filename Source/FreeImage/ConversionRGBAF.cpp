@@ -22,13 +22,15 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 //   smart convert X to RGBAF
 // ----------------------------------------------------------
 
-FIBITMAP * DLL_CALLCONV
-FreeImage_ConvertToRGBAF(FIBITMAP *dib) {
+static FIBITMAP *
+ConvertToRGBAF(FIBITMAP *dib, bool srgb) {
 	FIBITMAP *src{};
 	FIBITMAP *dst{};
 
@@ -40,9 +42,9 @@ FreeImage_ConvertToRGBAF(FIBITMAP *dib) {
 	switch (src_type) {
 		case FIT_BITMAP:
 		{
-			// allow conversion from 32-bit
+			// allow conversion from 24- and 32-bit
 			const FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
-			if (color_type != FIC_RGBALPHA) {
+			if (((color_type != FIC_RGB) && (color_type != FIC_RGBALPHA)) || (FreeImage_GetBPP(dib) < 24)) {
 				src = FreeImage_ConvertTo32Bits(dib);
 				if (!src) return nullptr;
 			} else {
@@ -78,6 +80,10 @@ FreeImage_ConvertToRGBAF(FIBITMAP *dib) {
 			// allow conversion from 96-bit RGBF
 			src = dib;
 			break;
+		case FIT_RGBAH:
+			// allow conversion from 64-bit RGBAH
+			src = dib;
+			break;
 		case FIT_RGBAF:
 			// RGBAF type : clone the src
 			return FreeImage_Clone(dib);
@@ -110,95 +116,51 @@ FreeImage_ConvertToRGBAF(FIBITMAP *dib) {
 	switch (src_type) {
 		case FIT_BITMAP:
 		{
-			// calculate the number of bytes per pixel (4 for 32-bit)
+			// calculate the number of bytes per pixel (3 for 24-bit or 4 for 32-bit), 24-bit pixels get an opaque alpha
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = src_bits;
-				auto *dst_pixel = (FIRGBAF*)dst_bits;
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					dst_pixel->red   = (float)(src_pixel[FI_RGBA_RED])   / 255.0F;
-					dst_pixel->green = (float)(src_pixel[FI_RGBA_GREEN]) / 255.0F;
-					dst_pixel->blue  = (float)(src_pixel[FI_RGBA_BLUE])  / 255.0F;
-					dst_pixel->alpha = (float)(src_pixel[FI_RGBA_ALPHA]) / 255.0F;
-
-					src_pixel += bytespp;
-					dst_pixel++;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
-			}
+			const unsigned order[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+			const float *table = GetByteToFloatTable(srgb);
+			const float *alpha_table = GetByteToFloatTable(false);
+
+			ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+				// convert and scale to the range [0..1], alpha is always linear
+				LookupToFloat((float*)dst_line, 4, src_line, bytespp, order, width, table, alpha_table);
+			});
 		}
 		break;
 
 		case FIT_UINT16:
 		{
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = (const uint16_t*)src_bits;
-				auto *dst_pixel = (FIRGBAF*)dst_bits;
-
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					const float dst_value = (float)src_pixel[x] / 65535.0F;
-					dst_pixel[x].red   = dst_value;
-					dst_pixel[x].green = dst_value;
-					dst_pixel[x].blue  = dst_value;
-					dst_pixel[x].alpha = 1.0F;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
-			}
-		}
-		break;
-
-		case FIT_RGB16:
-		{
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = (const FIRGB16*)src_bits;
-				auto *dst_pixel = (FIRGBAF*)dst_bits;
+			const unsigned order[4] = { 0, 0, 0, 1 };
+			const float *table = GetWordToFloatTable(srgb);
 
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					dst_pixel[x].red   = (float)(src_pixel[x].red)   / 65535.0F;
-					dst_pixel[x].green = (float)(src_pixel[x].green) / 65535.0F;
-					dst_pixel[x].blue  = (float)(src_pixel[x].blue)  / 65535.0F;
-					dst_pixel[x].alpha = 1.0F;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
-			}
+			ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+				// convert and scale to the range [0..1]
+				LookupToFloat((float*)dst_line, 4, (const uint16_t*)src_line, 1, order, width, table, table);
+			});
 		}
 		break;
 
 		case FIT_RGBA16:
-		{
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = (const FIRGBA16*)src_bits;
-				auto *dst_pixel = (FIRGBAF*)dst_bits;
-
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					dst_pixel[x].red   = (float)(src_pixel[x].red)   / 65535.0F;
-					dst_pixel[x].green = (float)(src_pixel[x].green) / 65535.0F;
-					dst_pixel[x].blue  = (float)(src_pixel[x].blue)  / 65535.0F;
-					dst_pixel[x].alpha = (float)(src_pixel[x].alpha) / 65535.0F;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
+			if (!srgb) {
+				// same channel layout, convert all the samples of a line at once
+				ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+					ConvertToFloat((float*)dst_line, (const uint16_t*)src_line, 4 * width, 65535.0F);
+				});
+				break;
 			}
+			[[fallthrough]];
+		case FIT_RGB16:
+		{
+			const unsigned order[4] = { 0, 1, 2, 3 };
+			const unsigned samples = (src_type == FIT_RGBA16) ? 4 : 3;
+			const float *table = GetWordToFloatTable(srgb);
+			const float *alpha_table = GetWordToFloatTable(false);
+
+			ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+				// convert and scale to the range [0..1], alpha is always linear
+				LookupToFloat((float*)dst_line, 4, (const uint16_t*)src_line, samples, order, width, table, alpha_table);
+			});
 		}
 		break;
 
@@ -291,6 +253,20 @@ FreeImage_ConvertToRGBAF(FIBITMAP *dib) {
 			}
 		}
 		break;
+
+		case FIT_RGBAH:
+		{
+			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
+			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
+
+			for (unsigned y = 0; y < height; y++) {
+				// expand the half values as they are (no clamping)
+				ConvertHalfToFloat((float*)dst_bits, (const uint16_t*)src_bits, 4 * width);
+				src_bits += src_pitch;
+				dst_bits += dst_pitch;
+			}
+		}
+		break;
 	}
 
 	if (src != dib) {
@@ -300,3 +276,14 @@ FreeImage_ConvertToRGBAF(FIBITMAP *dib) {
 	return dst;
 }
 
+FIBITMAP * DLL_CALLCONV
+FreeImage_ConvertToRGBAF(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToRGBAF");
+	return ConvertToRGBAF(dib, false);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_ConvertToLinearRGBAF(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToLinearRGBAF");
+	return ConvertToRGBAF(dib, true);
+}
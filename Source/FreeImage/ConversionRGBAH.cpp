@@ -0,0 +1,85 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "Trace.h"
+#include "ConversionSIMD.h"
+
+// ----------------------------------------------------------
+//   smart convert X to RGBAH
+// ----------------------------------------------------------
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_ConvertToRGBAH(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToRGBAH");
+	if (!FreeImage_HasPixels(dib)) return nullptr;
+
+	const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType(dib);
+
+	// check for allowed conversions
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> converted(nullptr, &FreeImage_Unload);
+	FIBITMAP *src = dib;
+	switch (src_type) {
+		case FIT_RGBAH:
+			// RGBAH type : clone the src
+			return FreeImage_Clone(dib);
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			// float values are rounded as they are
+			break;
+		default:
+			// other types are scaled to [0..1] as RGBAF first
+			converted.reset(FreeImage_ConvertToRGBAF(dib));
+			if (!converted) return nullptr;
+			src = converted.get();
+			break;
+	}
+
+	// allocate dst image
+
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	FIBITMAP *dst = FreeImage_AllocateT(FIT_RGBAH, width, height);
+	if (!dst) return nullptr;
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, src);
+
+	// convert from src type to RGBAH
+
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	const unsigned dst_pitch = FreeImage_GetPitch(dst);
+
+	auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
+	auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
+
+	if (FreeImage_GetImageType(src) == FIT_RGBAF) {
+		for (unsigned y = 0; y < height; y++) {
+			ConvertFloatToHalf((uint16_t*)dst_bits, (const float*)src_bits, 4 * width);
+			src_bits += src_pitch;
+			dst_bits += dst_pitch;
+		}
+	} else {
+		// RGBF, add an opaque alpha
+		std::vector<FIRGBAF> line(width);
+		for (unsigned y = 0; y < height; y++) {
+			auto *src_pixel = (const FIRGBF*)src_bits;
+			for (unsigned x = 0; x < width; x++) {
+				line[x].red   = src_pixel[x].red;
+				line[x].green = src_pixel[x].green;
+				line[x].blue  = src_pixel[x].blue;
+				line[x].alpha = 1.0F;
+			}
+			ConvertFloatToHalf((uint16_t*)dst_bits, (const float*)line.data(), 4 * width);
+			src_bits += src_pitch;
+			dst_bits += dst_pitch;
+		}
+	}
+
+	return dst;
+}
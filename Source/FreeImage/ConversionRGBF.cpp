@@ -21,13 +21,15 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 //   smart convert X to RGBF
 // ----------------------------------------------------------
 
-FIBITMAP * DLL_CALLCONV
-FreeImage_ConvertToRGBF(FIBITMAP *dib) {
+static FIBITMAP *
+ConvertToRGBF(FIBITMAP *dib, bool srgb) {
 	FIBITMAP *src{};
 	FIBITMAP *dst{};
 
@@ -41,7 +43,7 @@ FreeImage_ConvertToRGBF(FIBITMAP *dib) {
 		{
 			// allow conversion from 24- and 32-bit
 			const FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
-			if ((color_type != FIC_RGB) && (color_type != FIC_RGBALPHA)) {
+			if (((color_type != FIC_RGB) && (color_type != FIC_RGBALPHA)) || (FreeImage_GetBPP(dib) < 24)) {
 				src = FreeImage_ConvertTo24Bits(dib);
 				if (!src) return nullptr;
 			} else {
@@ -81,6 +83,10 @@ FreeImage_ConvertToRGBF(FIBITMAP *dib) {
 			// allow conversion from 128-bit RGBAF
 			src = dib;
 			break;
+		case FIT_RGBAH:
+			// allow conversion from 64-bit RGBAH (ignore the alpha channel)
+			src = dib;
+			break;
 		case FIT_RGBF:
 			// RGBF type : clone the src
 			return FreeImage_Clone(dib);
@@ -115,89 +121,47 @@ FreeImage_ConvertToRGBF(FIBITMAP *dib) {
 		{
 			// calculate the number of bytes per pixel (3 for 24-bit or 4 for 32-bit)
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+			const unsigned order[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+			const float *table = GetByteToFloatTable(srgb);
 
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = src_bits;
-				auto *dst_pixel = (FIRGBF*)dst_bits;
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					dst_pixel->red   = (float)(src_pixel[FI_RGBA_RED])   / 255.0F;
-					dst_pixel->green = (float)(src_pixel[FI_RGBA_GREEN]) / 255.0F;
-					dst_pixel->blue  = (float)(src_pixel[FI_RGBA_BLUE])  / 255.0F;
-
-					src_pixel += bytespp;
-					dst_pixel ++;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
-			}
+			ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+				// convert and scale to the range [0..1]
+				LookupToFloat((float*)dst_line, 3, src_line, bytespp, order, width, table, table);
+			});
 		}
 		break;
 
 		case FIT_UINT16:
 		{
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = (const uint16_t*)src_bits;
-				auto *dst_pixel = (FIRGBF*)dst_bits;
+			const unsigned order[4] = { 0, 0, 0, 1 };
+			const float *table = GetWordToFloatTable(srgb);
 
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					const float dst_value = (float)src_pixel[x] / 65535.0F;
-					dst_pixel[x].red   = dst_value;
-					dst_pixel[x].green = dst_value;
-					dst_pixel[x].blue  = dst_value;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
-			}
+			ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+				// convert and scale to the range [0..1]
+				LookupToFloat((float*)dst_line, 3, (const uint16_t*)src_line, 1, order, width, table, table);
+			});
 		}
 		break;
 
 		case FIT_RGB16:
-		{
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = (const FIRGB16*)src_bits;
-				auto *dst_pixel = (FIRGBF*)dst_bits;
-
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					dst_pixel[x].red   = (float)(src_pixel[x].red)   / 65535.0F;
-					dst_pixel[x].green = (float)(src_pixel[x].green) / 65535.0F;
-					dst_pixel[x].blue  = (float)(src_pixel[x].blue)  / 65535.0F;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
+			if (!srgb) {
+				// same channel layout, convert all the samples of a line at once
+				ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+					ConvertToFloat((float*)dst_line, (const uint16_t*)src_line, 3 * width, 65535.0F);
+				});
+				break;
 			}
-		}
-		break;
-
+			[[fallthrough]];
 		case FIT_RGBA16:
 		{
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = (const FIRGBA16*)src_bits;
-				auto *dst_pixel = (FIRGBF*)dst_bits;
-
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					dst_pixel[x].red   = (float)(src_pixel[x].red)   / 65535.0F;
-					dst_pixel[x].green = (float)(src_pixel[x].green) / 65535.0F;
-					dst_pixel[x].blue  = (float)(src_pixel[x].blue)  / 65535.0F;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
-			}
+			const unsigned order[4] = { 0, 1, 2, 3 };
+			const unsigned samples = (src_type == FIT_RGBA16) ? 4 : 3;
+			const float *table = GetWordToFloatTable(srgb);
+
+			ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+				// convert and scale to the range [0..1], skip the alpha channel
+				LookupToFloat((float*)dst_line, 3, (const uint16_t*)src_line, samples, order, width, table, table);
+			});
 		}
 		break;
 
@@ -309,6 +273,29 @@ FreeImage_ConvertToRGBF(FIBITMAP *dib) {
 			}
 		}
 		break;
+
+		case FIT_RGBAH:
+		{
+			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
+			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
+			std::vector<FIRGBAF> line(width);
+
+			for (unsigned y = 0; y < height; y++) {
+				// expand the half values as they are (no clamping, HDR values are kept for tone mapping)
+				ConvertHalfToFloat((float*)line.data(), (const uint16_t*)src_bits, 4 * width);
+				auto *dst_pixel = (FIRGBF*)dst_bits;
+
+				for (unsigned x = 0; x < width; x++) {
+					// skip alpha channel
+					dst_pixel[x].red   = line[x].red;
+					dst_pixel[x].green = line[x].green;
+					dst_pixel[x].blue  = line[x].blue;
+				}
+				src_bits += src_pitch;
+				dst_bits += dst_pitch;
+			}
+		}
+		break;
 	}
 
 	if (src != dib) {
@@ -318,3 +305,14 @@ FreeImage_ConvertToRGBF(FIBITMAP *dib) {
 	return dst;
 }
 
+FIBITMAP * DLL_CALLCONV
+FreeImage_ConvertToRGBF(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToRGBF");
+	return ConvertToRGBF(dib, false);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_ConvertToLinearRGBF(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToLinearRGBF");
+	return ConvertToRGBF(dib, true);
+}
@@ -0,0 +1,2179 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "ConversionSIMD.h"
+#include "CPUDispatch.h"
+#include "Utilities.h"
+
+namespace {
+
+	/// Smallest float which is not below 1e-32, the black threshold of FloatToRGBE
+	const float kRGBEBlackThreshold = 0x1.9f623ep-107f;
+
+	/**
+	Coefficients of the transfer function approximations, shared by the kernels and the scalar code.
+	log2(m) for m in [sqrt(1/2), sqrt(2)) is 2 / ln(2) * (t + t^3 / 3 + t^5 / 5 + t^7 / 7) with t = (m - 1) / (m + 1),
+	2^f for f in [-1/2, 1/2] is the Taylor series of exp(f * ln(2)) up to f^6. Both have relative errors below 2e-7.
+	*/
+	namespace fx {
+		const float kSqrt2 = 1.41421356f;
+		const float kLog2C1 = 2.88539008f;
+		const float kLog2C3 = 0.961796694f;
+		const float kLog2C5 = 0.577078016f;
+		const float kLog2C7 = 0.412198583f;
+		const float kExp2C1 = 0.693147181f;
+		const float kExp2C2 = 0.240226507f;
+		const float kExp2C3 = 0.0555041087f;
+		const float kExp2C4 = 0.00961812911f;
+		const float kExp2C5 = 0.00133335581f;
+		const float kExp2C6 = 0.000154035304f;
+		const float kLn2 = 0.693147181f;
+		const float kLog2E = 1.44269504f;
+
+		// IEC 61966-2-1 (sRGB)
+		const float kSrgbDecodeThreshold = 0.04045f;
+		const float kSrgbEncodeThreshold = 0.0031308f;
+		const float kSrgbSlope = 12.92f;
+		const float kSrgbInvSlope = 1.0f / 12.92f;
+		const float kSrgbOffset = 0.055f;
+		const float kSrgbScale = 1.055f;
+		const float kSrgbInvScale = 1.0f / 1.055f;
+		const float kSrgbGamma = 2.4f;
+		const float kSrgbInvGamma = 1.0f / 2.4f;
+
+		// SMPTE ST 2084 (PQ)
+		const float kPqM1 = 0.1593017578125f;
+		const float kPqM2 = 78.84375f;
+		const float kPqInvM1 = 1.0f / 0.1593017578125f;
+		const float kPqInvM2 = 1.0f / 78.84375f;
+		const float kPqC1 = 0.8359375f;
+		const float kPqC2 = 18.8515625f;
+		const float kPqC3 = 18.6875f;
+
+		// ARIB STD-B67 (HLG)
+		const float kHlgA = 0.17883277f;
+		const float kHlgB = 0.28466892f;
+		const float kHlgC = 0.55991073f;
+		const float kHlgExp2Scale = 1.44269504f / 0.17883277f;
+		const float kThird = 1.0f / 3.0f;
+		const float kTwelfth = 1.0f / 12.0f;
+	}
+
+#if FREEIMAGE_SIMD_X86
+
+	// ----------------------------------------------------------
+	//  SSE2 / SSSE3 / AVX2 kernels
+	// ----------------------------------------------------------
+
+	FI_TARGET("ssse3")
+	int Line1To8_SSSE3(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+		const __m128i bits = _mm_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+		int cols = 0;
+		for (; cols + 16 <= width_in_pixels; cols += 16) {
+			uint16_t packed;
+			memcpy(&packed, source + (cols >> 3), sizeof(packed));
+			__m128i v = _mm_shuffle_epi8(_mm_cvtsi32_si128(packed), spread);
+			v = _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits);
+			_mm_storeu_si128((__m128i *)(target + cols), v);
+		}
+		return cols;
+	}
+
+	FI_TARGET("avx2")
+	int Line8To32_AVX2(uint8_t *target, const uint8_t *source, int width_in_pixels, const FIRGBA8 *palette) {
+		const int *entries = reinterpret_cast<const int *>(palette);
+		const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+#if FI_RGBA_RED != 0
+		// palette entries are stored as RGBA
+		const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+			2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+#endif
+		int cols = 0;
+		for (; cols + 8 <= width_in_pixels; cols += 8) {
+			const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(source + cols)));
+			__m256i v = _mm256_i32gather_epi32(entries, index, 4);
+#if FI_RGBA_RED != 0
+			v = _mm256_shuffle_epi8(v, swap);
+#endif
+			_mm256_storeu_si256((__m256i *)(target + 4 * cols), _mm256_or_si256(v, alpha));
+		}
+		return cols;
+	}
+
+	/**
+	Expands 16-bit pixels with 5 or 6 bits channels to 8 bits, bit exact with x * 0xFF / 0x1F and x * 0xFF / 0x3F.
+	8-bit channels are computed as (x * 1053) >> 7 and (x << 2) + ((x * 49) >> 10) respectively.
+	*/
+	template <bool rgb565>
+	int Line16To32_SSE2(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		const __m128i mask5 = _mm_set1_epi16(0x1F);
+		const __m128i mask6 = _mm_set1_epi16(0x3F);
+		const __m128i mul5 = _mm_set1_epi16(1053);
+		const __m128i mul6 = _mm_set1_epi16(49);
+		const __m128i alpha = _mm_set1_epi16((short)0xFF00);
+		int cols = 0;
+		for (; cols + 8 <= width_in_pixels; cols += 8) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(source + 2 * cols));
+			__m128i r = rgb565 ? _mm_srli_epi16(v, 11) : _mm_and_si128(_mm_srli_epi16(v, 10), mask5);
+			__m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), rgb565 ? mask6 : mask5);
+			__m128i b = _mm_and_si128(v, mask5);
+			r = _mm_srli_epi16(_mm_mullo_epi16(r, mul5), 7);
+			b = _mm_srli_epi16(_mm_mullo_epi16(b, mul5), 7);
+			g = rgb565
+				? _mm_add_epi16(_mm_slli_epi16(g, 2), _mm_srli_epi16(_mm_mullo_epi16(g, mul6), 10))
+				: _mm_srli_epi16(_mm_mullo_epi16(g, mul5), 7);
+#if FI_RGBA_RED == 0
+			const __m128i lo = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+			const __m128i hi = _mm_or_si128(b, alpha);
+#else
+			const __m128i lo = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+			const __m128i hi = _mm_or_si128(r, alpha);
+#endif
+			_mm_storeu_si128((__m128i *)(target + 4 * cols), _mm_unpacklo_epi16(lo, hi));
+			_mm_storeu_si128((__m128i *)(target + 4 * cols + 16), _mm_unpackhi_epi16(lo, hi));
+		}
+		return cols;
+	}
+
+	FI_TARGET("ssse3")
+	int Line24To32_SSSE3(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+		int cols = 0;
+		for (; cols + 16 <= width_in_pixels; cols += 16) {
+			// 48 bytes hold 16 pixels, each register is realigned on 4 of them
+			const __m128i in0 = _mm_loadu_si128((const __m128i *)(source));
+			const __m128i in1 = _mm_loadu_si128((const __m128i *)(source + 16));
+			const __m128i in2 = _mm_loadu_si128((const __m128i *)(source + 32));
+			const __m128i p0 = in0;
+			const __m128i p1 = _mm_alignr_epi8(in1, in0, 12);
+			const __m128i p2 = _mm_alignr_epi8(in2, in1, 8);
+			const __m128i p3 = _mm_srli_si128(in2, 4);
+			_mm_storeu_si128((__m128i *)(target),      _mm_or_si128(_mm_shuffle_epi8(p0, shuffle), alpha));
+			_mm_storeu_si128((__m128i *)(target + 16), _mm_or_si128(_mm_shuffle_epi8(p1, shuffle), alpha));
+			_mm_storeu_si128((__m128i *)(target + 32), _mm_or_si128(_mm_shuffle_epi8(p2, shuffle), alpha));
+			_mm_storeu_si128((__m128i *)(target + 48), _mm_or_si128(_mm_shuffle_epi8(p3, shuffle), alpha));
+			source += 48;
+			target += 64;
+		}
+		return cols;
+	}
+
+	FI_TARGET("ssse3")
+	int Line32To24_SSSE3(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		int cols = 0;
+		for (; cols + 16 <= width_in_pixels; cols += 16) {
+			// 4 registers of 4 packed pixels are merged into 48 bytes
+			const __m128i s0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(source)), shuffle);
+			const __m128i s1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(source + 16)), shuffle);
+			const __m128i s2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(source + 32)), shuffle);
+			const __m128i s3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(source + 48)), shuffle);
+			_mm_storeu_si128((__m128i *)(target),      _mm_or_si128(s0, _mm_slli_si128(s1, 12)));
+			_mm_storeu_si128((__m128i *)(target + 16), _mm_or_si128(_mm_srli_si128(s1, 4), _mm_slli_si128(s2, 8)));
+			_mm_storeu_si128((__m128i *)(target + 32), _mm_or_si128(_mm_srli_si128(s2, 8), _mm_slli_si128(s3, 4)));
+			source += 64;
+			target += 48;
+		}
+		return cols;
+	}
+
+	/// 565 to 555 drops the low green bit, bit exact with RGB555 of the 8-bit expansion
+	int Line16_565To555_SSE2(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		const __m128i rg = _mm_set1_epi16(0x7FE0);
+		const __m128i mask5 = _mm_set1_epi16(0x1F);
+		int cols = 0;
+		for (; cols + 8 <= width_in_pixels; cols += 8) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(source + 2 * cols));
+			const __m128i out = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 1), rg), _mm_and_si128(v, mask5));
+			_mm_storeu_si128((__m128i *)(target + 2 * cols), out);
+		}
+		return cols;
+	}
+
+	/// 555 to 565 widens green as 2 * g + (g > 17), bit exact with RGB565 of the 8-bit expansion
+	int Line16_555To565_SSE2(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		const __m128i red = _mm_set1_epi16((short)0xF800);
+		const __m128i mask5 = _mm_set1_epi16(0x1F);
+		const __m128i half = _mm_set1_epi16(17);
+		int cols = 0;
+		for (; cols + 8 <= width_in_pixels; cols += 8) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(source + 2 * cols));
+			const __m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), mask5);
+			const __m128i g6 = _mm_sub_epi16(_mm_slli_epi16(g, 1), _mm_cmpgt_epi16(g, half));
+			const __m128i out = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi16(v, 1), red), _mm_slli_epi16(g6, 5)), _mm_and_si128(v, mask5));
+			_mm_storeu_si128((__m128i *)(target + 2 * cols), out);
+		}
+		return cols;
+	}
+
+	FI_TARGET("ssse3")
+	int SwapRedBlue24_SSSE3(uint8_t *data, int count) {
+		// 5 pixels per register, the 16th byte is stored back unchanged
+		const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+		int i = 0;
+		for (; 3 * i + 16 <= 3 * count; i += 5) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(data + 3 * i));
+			_mm_storeu_si128((__m128i *)(data + 3 * i), _mm_shuffle_epi8(v, shuffle));
+		}
+		return i;
+	}
+
+	FI_TARGET("ssse3")
+	int SwapRedBlue32_SSSE3(uint8_t *data, int count) {
+		const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(data + 4 * i));
+			_mm_storeu_si128((__m128i *)(data + 4 * i), _mm_shuffle_epi8(v, shuffle));
+		}
+		return i;
+	}
+
+	/**
+	Interleaves 16 bytes of 4 planes at a time, bytes then words are unpacked
+	*/
+	int InterleavePlanes32_SSE2(uint8_t *target, const uint8_t *const *planes, int count) {
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const __m128i p0 = _mm_loadu_si128((const __m128i *)(planes[0] + i));
+			const __m128i p1 = _mm_loadu_si128((const __m128i *)(planes[1] + i));
+			const __m128i p2 = _mm_loadu_si128((const __m128i *)(planes[2] + i));
+			const __m128i p3 = _mm_loadu_si128((const __m128i *)(planes[3] + i));
+			const __m128i lo01 = _mm_unpacklo_epi8(p0, p1);
+			const __m128i hi01 = _mm_unpackhi_epi8(p0, p1);
+			const __m128i lo23 = _mm_unpacklo_epi8(p2, p3);
+			const __m128i hi23 = _mm_unpackhi_epi8(p2, p3);
+			_mm_storeu_si128((__m128i *)(target + 4 * i),      _mm_unpacklo_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i *)(target + 4 * i + 16), _mm_unpackhi_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i *)(target + 4 * i + 32), _mm_unpacklo_epi16(hi01, hi23));
+			_mm_storeu_si128((__m128i *)(target + 4 * i + 48), _mm_unpackhi_epi16(hi01, hi23));
+		}
+		return i;
+	}
+
+	/**
+	Interleaves 16 bytes of 3 planes at a time, as 4 bytes pixels packed to 3 bytes as in Line32To24_SSSE3
+	*/
+	FI_TARGET("ssse3")
+	int InterleavePlanes24_SSSE3(uint8_t *target, const uint8_t *const *planes, int count) {
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const __m128i p0 = _mm_loadu_si128((const __m128i *)(planes[0] + i));
+			const __m128i p1 = _mm_loadu_si128((const __m128i *)(planes[1] + i));
+			const __m128i p2 = _mm_loadu_si128((const __m128i *)(planes[2] + i));
+			const __m128i lo01 = _mm_unpacklo_epi8(p0, p1);
+			const __m128i hi01 = _mm_unpackhi_epi8(p0, p1);
+			const __m128i lo22 = _mm_unpacklo_epi8(p2, p2);
+			const __m128i hi22 = _mm_unpackhi_epi8(p2, p2);
+			const __m128i s0 = _mm_shuffle_epi8(_mm_unpacklo_epi16(lo01, lo22), shuffle);
+			const __m128i s1 = _mm_shuffle_epi8(_mm_unpackhi_epi16(lo01, lo22), shuffle);
+			const __m128i s2 = _mm_shuffle_epi8(_mm_unpacklo_epi16(hi01, hi22), shuffle);
+			const __m128i s3 = _mm_shuffle_epi8(_mm_unpackhi_epi16(hi01, hi22), shuffle);
+			_mm_storeu_si128((__m128i *)(target + 3 * i),      _mm_or_si128(s0, _mm_slli_si128(s1, 12)));
+			_mm_storeu_si128((__m128i *)(target + 3 * i + 16), _mm_or_si128(_mm_srli_si128(s1, 4), _mm_slli_si128(s2, 8)));
+			_mm_storeu_si128((__m128i *)(target + 3 * i + 32), _mm_or_si128(_mm_srli_si128(s2, 8), _mm_slli_si128(s3, 4)));
+		}
+		return i;
+	}
+
+	/**
+	Reverses the bytes of 4 words at a time: words are swapped within each dword, then bytes within each word
+	*/
+	int SwapBytes32_SSE2(uint32_t *target, const uint32_t *source, int count) {
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(source + i));
+			v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+			_mm_storeu_si128((__m128i *)(target + i), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+		}
+		return i;
+	}
+
+	FI_TARGET("ssse3")
+	int SwapBytes32_SSSE3(uint32_t *target, const uint32_t *source, int count) {
+		const __m128i shuffle = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m128i v0 = _mm_loadu_si128((const __m128i *)(source + i));
+			const __m128i v1 = _mm_loadu_si128((const __m128i *)(source + i + 4));
+			_mm_storeu_si128((__m128i *)(target + i), _mm_shuffle_epi8(v0, shuffle));
+			_mm_storeu_si128((__m128i *)(target + i + 4), _mm_shuffle_epi8(v1, shuffle));
+		}
+		return i;
+	}
+
+	FI_TARGET("avx,f16c")
+	int HalfToFloat_F16C(float *target, const uint16_t *source, int count) {
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			_mm256_storeu_ps(target + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(source + i))));
+		}
+		return i;
+	}
+
+	FI_TARGET("avx,f16c")
+	int FloatToHalf_F16C(uint16_t *target, const float *source, int count) {
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			_mm_storeu_si128((__m128i *)(target + i), _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT));
+		}
+		return i;
+	}
+
+	/**
+	Converts 4 RGBE pixels at a time. The 2^(e - 136) scale is built from the exponent bits and applied
+	as two factors 2^(e/2 - 68), both normal floats, so that small exponents round like the scalar code.
+	*/
+	int RGBEToFloat_SSE2(FIRGBF *target, const uint8_t *source, int count) {
+		const __m128i mask = _mm_set1_epi32(0xFF);
+		const __m128i bias = _mm_set1_epi32(127 - 68);
+		float *dst = reinterpret_cast<float *>(target);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(source + 4 * i));
+			const __m128i e = _mm_srli_epi32(v, 24);
+			const __m128i e1 = _mm_srli_epi32(e, 1);
+			const __m128i e2 = _mm_sub_epi32(e, e1);
+			const __m128 s1 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e1, bias), 23));
+			const __m128 s2 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e2, bias), 23));
+			const __m128 black = _mm_castsi128_ps(_mm_cmpeq_epi32(e, _mm_setzero_si128()));
+			const __m128 r = _mm_andnot_ps(black, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(v, mask)), s1), s2));
+			const __m128 g = _mm_andnot_ps(black, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 8), mask)), s1), s2));
+			const __m128 b = _mm_andnot_ps(black, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 16), mask)), s1), s2));
+			// interleave to r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+			const __m128 rg_lo = _mm_unpacklo_ps(r, g);
+			const __m128 rg_hi = _mm_unpackhi_ps(r, g);
+			const __m128 out0 = _mm_shuffle_ps(rg_lo, _mm_shuffle_ps(b, rg_lo, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0));
+			const __m128 out1 = _mm_shuffle_ps(_mm_shuffle_ps(rg_lo, b, _MM_SHUFFLE(1, 1, 3, 3)), rg_hi, _MM_SHUFFLE(1, 0, 2, 0));
+			const __m128 out2 = _mm_shuffle_ps(_mm_shuffle_ps(b, rg_hi, _MM_SHUFFLE(2, 2, 2, 2)), _mm_shuffle_ps(rg_hi, b, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			_mm_storeu_ps(dst + 3 * i, out0);
+			_mm_storeu_ps(dst + 3 * i + 4, out1);
+			_mm_storeu_ps(dst + 3 * i + 8, out2);
+		}
+		return i;
+	}
+
+	/**
+	Converts 4 float pixels at a time. frexp is replaced by the exponent bits of the largest channel,
+	which is normal above the 1e-32 black threshold.
+	*/
+	int FloatToRGBE_SSE2(uint8_t *target, const FIRGBF *source, int count) {
+		const __m128i mask = _mm_set1_epi32(0xFF);
+		const __m128i bias = _mm_set1_epi32(127 + 8 + 126);
+		const __m128i offset = _mm_set1_epi32(128 - 126);
+		const __m128 threshold = _mm_set1_ps(kRGBEBlackThreshold);
+		const float *src = reinterpret_cast<const float *>(source);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			// deinterleave r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+			const __m128 in0 = _mm_loadu_ps(src + 3 * i);
+			const __m128 in1 = _mm_loadu_ps(src + 3 * i + 4);
+			const __m128 in2 = _mm_loadu_ps(src + 3 * i + 8);
+			const __m128 r = _mm_shuffle_ps(in0, _mm_shuffle_ps(in1, in2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+			const __m128 g = _mm_shuffle_ps(_mm_shuffle_ps(in0, in1, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(in1, in2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 b = _mm_shuffle_ps(_mm_shuffle_ps(in0, in1, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(in2, in2, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+			// same operand order as the scalar comparisons
+			const __m128 v = _mm_max_ps(b, _mm_max_ps(g, r));
+			const __m128i exponent = _mm_and_si128(_mm_srli_epi32(_mm_castps_si128(v), 23), mask);
+			const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(bias, exponent), 23));
+			__m128i rgbe = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(r, scale)), mask);
+			rgbe = _mm_or_si128(rgbe, _mm_slli_epi32(_mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(g, scale)), mask), 8));
+			rgbe = _mm_or_si128(rgbe, _mm_slli_epi32(_mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(b, scale)), mask), 16));
+			rgbe = _mm_or_si128(rgbe, _mm_slli_epi32(_mm_add_epi32(exponent, offset), 24));
+			rgbe = _mm_andnot_si128(_mm_castps_si128(_mm_cmplt_ps(v, threshold)), rgbe);
+			_mm_storeu_si128((__m128i *)(target + 4 * i), rgbe);
+		}
+		return i;
+	}
+
+	/**
+	Transforms 4 pixels of 3 floats at a time, all pixels are loaded before being stored so that target may be source
+	*/
+	int TransformFloat3_SSE2(float *target, const float *source, int count, const float (&matrix)[3][3]) {
+		__m128 m[3][3];
+		for (int j = 0; j < 3; j++) {
+			for (int k = 0; k < 3; k++) {
+				m[j][k] = _mm_set1_ps(matrix[j][k]);
+			}
+		}
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			// deinterleave x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+			const __m128 in0 = _mm_loadu_ps(source + 3 * i);
+			const __m128 in1 = _mm_loadu_ps(source + 3 * i + 4);
+			const __m128 in2 = _mm_loadu_ps(source + 3 * i + 8);
+			const __m128 x = _mm_shuffle_ps(in0, _mm_shuffle_ps(in1, in2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+			const __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(in0, in1, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(in1, in2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(in0, in1, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(in2, in2, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][0], x), _mm_mul_ps(m[0][1], y)), _mm_mul_ps(m[0][2], z));
+			const __m128 g = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[1][0], x), _mm_mul_ps(m[1][1], y)), _mm_mul_ps(m[1][2], z));
+			const __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[2][0], x), _mm_mul_ps(m[2][1], y)), _mm_mul_ps(m[2][2], z));
+			// interleave to r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+			const __m128 rg_lo = _mm_unpacklo_ps(r, g);
+			const __m128 rg_hi = _mm_unpackhi_ps(r, g);
+			const __m128 out0 = _mm_shuffle_ps(rg_lo, _mm_shuffle_ps(b, rg_lo, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0));
+			const __m128 out1 = _mm_shuffle_ps(_mm_shuffle_ps(rg_lo, b, _MM_SHUFFLE(1, 1, 3, 3)), rg_hi, _MM_SHUFFLE(1, 0, 2, 0));
+			const __m128 out2 = _mm_shuffle_ps(_mm_shuffle_ps(b, rg_hi, _MM_SHUFFLE(2, 2, 2, 2)), _mm_shuffle_ps(rg_hi, b, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			_mm_storeu_ps(target + 3 * i, out0);
+			_mm_storeu_ps(target + 3 * i + 4, out1);
+			_mm_storeu_ps(target + 3 * i + 8, out2);
+		}
+		return i;
+	}
+
+	/**
+	Converts 8 values (8 or 16-bit) at a time as static_cast<float>(v) / divisor
+	*/
+	template <typename T>
+	int IntToFloat_SSE2(float *target, const T *source, int count, float divisor) {
+		const __m128 d = _mm_set1_ps(divisor);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m128i v;
+			if constexpr (sizeof(T) == 1) {
+				v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(source + i)), _mm_setzero_si128());
+			} else {
+				v = _mm_loadu_si128((const __m128i *)(source + i));
+			}
+			__m128i lo, hi;
+			if constexpr (std::is_signed_v<T>) {
+				lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+				hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			} else {
+				lo = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+				hi = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+			}
+			_mm_storeu_ps(target + i, _mm_div_ps(_mm_cvtepi32_ps(lo), d));
+			_mm_storeu_ps(target + i + 4, _mm_div_ps(_mm_cvtepi32_ps(hi), d));
+		}
+		return i;
+	}
+
+	/**
+	Updates min and max with 8 values at a time. Unsigned values are biased by 0x8000 to use the signed instructions.
+	*/
+	template <typename T>
+	int MinMaxInt16_SSE2(const T *source, int count, T &min, T &max) {
+		const __m128i bias = _mm_set1_epi16(std::is_signed_v<T> ? 0 : (short)0x8000);
+		__m128i vmin = _mm_xor_si128(_mm_set1_epi16((short)min), bias);
+		__m128i vmax = _mm_xor_si128(_mm_set1_epi16((short)max), bias);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(source + i)), bias);
+			vmin = _mm_min_epi16(vmin, v);
+			vmax = _mm_max_epi16(vmax, v);
+		}
+		T mins[8], maxs[8];
+		_mm_storeu_si128((__m128i *)mins, _mm_xor_si128(vmin, bias));
+		_mm_storeu_si128((__m128i *)maxs, _mm_xor_si128(vmax, bias));
+		for (int k = 0; k < 8; k++) {
+			min = std::min(min, mins[k]);
+			max = std::max(max, maxs[k]);
+		}
+		return i;
+	}
+
+	/**
+	Updates min and max with 4 values at a time. MINPS / MAXPS return their second operand
+	if one is a NaN, so NaNs are skipped like by the scalar comparisons.
+	*/
+	int MinMaxFloat_SSE2(const float *source, int count, float &min, float &max) {
+		__m128 vmin = _mm_set1_ps(min);
+		__m128 vmax = _mm_set1_ps(max);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const __m128 v = _mm_loadu_ps(source + i);
+			vmin = _mm_min_ps(v, vmin);
+			vmax = _mm_max_ps(v, vmax);
+		}
+		float mins[4], maxs[4];
+		_mm_storeu_ps(mins, vmin);
+		_mm_storeu_ps(maxs, vmax);
+		for (int k = 0; k < 4; k++) {
+			min = std::min(min, mins[k]);
+			max = std::max(max, maxs[k]);
+		}
+		return i;
+	}
+
+	/// Returns the 4 int32 (uint8_t)(scale * x + 0.5) of 4 int32 or float x, computed in double precision
+	inline __m128i ScaleToInt_SSE2(__m128d lo, __m128d hi, __m128d scale) {
+		const __m128d half = _mm_set1_pd(0.5);
+		const __m128i a = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(lo, scale), half));
+		const __m128i b = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(hi, scale), half));
+		// the scalar cast to uint8_t keeps the low byte of the truncated value
+		return _mm_and_si128(_mm_unpacklo_epi64(a, b), _mm_set1_epi32(0xFF));
+	}
+
+	/**
+	Converts 8 values at a time as (uint8_t)(scale * (v - min) + 0.5), the difference being computed on int
+	*/
+	template <typename T>
+	int ScaleInt16ToByte_SSE2(uint8_t *target, const T *source, int count, T min, double scale) {
+		const __m128i vmin = _mm_set1_epi32(min);
+		const __m128d vscale = _mm_set1_pd(scale);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(source + i));
+			__m128i lo, hi;
+			if constexpr (std::is_signed_v<T>) {
+				lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+				hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			} else {
+				lo = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+				hi = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+			}
+			lo = _mm_sub_epi32(lo, vmin);
+			hi = _mm_sub_epi32(hi, vmin);
+			const __m128i q0 = ScaleToInt_SSE2(_mm_cvtepi32_pd(lo), _mm_cvtepi32_pd(_mm_srli_si128(lo, 8)), vscale);
+			const __m128i q1 = ScaleToInt_SSE2(_mm_cvtepi32_pd(hi), _mm_cvtepi32_pd(_mm_srli_si128(hi, 8)), vscale);
+			const __m128i q = _mm_packs_epi32(q0, q1);
+			_mm_storel_epi64((__m128i *)(target + i), _mm_packus_epi16(q, q));
+		}
+		return i;
+	}
+
+	/**
+	Converts 8 values at a time as (uint8_t)(scale * (v - min) + 0.5), the difference being computed on float
+	*/
+	int ScaleFloatToByte_SSE2(uint8_t *target, const float *source, int count, float min, double scale) {
+		const __m128 vmin = _mm_set1_ps(min);
+		const __m128d vscale = _mm_set1_pd(scale);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m128 lo = _mm_sub_ps(_mm_loadu_ps(source + i), vmin);
+			const __m128 hi = _mm_sub_ps(_mm_loadu_ps(source + i + 4), vmin);
+			const __m128i q0 = ScaleToInt_SSE2(_mm_cvtps_pd(lo), _mm_cvtps_pd(_mm_movehl_ps(lo, lo)), vscale);
+			const __m128i q1 = ScaleToInt_SSE2(_mm_cvtps_pd(hi), _mm_cvtps_pd(_mm_movehl_ps(hi, hi)), vscale);
+			const __m128i q = _mm_packs_epi32(q0, q1);
+			_mm_storel_epi64((__m128i *)(target + i), _mm_packus_epi16(q, q));
+		}
+		return i;
+	}
+
+	/**
+	Converts 8 values at a time as MIN(255, MAX(0, int(v + 0.5))), the sum being computed on double
+	*/
+	int RoundFloatToByte_SSE2(uint8_t *target, const float *source, int count) {
+		const __m128d half = _mm_set1_pd(0.5);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m128 lo = _mm_loadu_ps(source + i);
+			const __m128 hi = _mm_loadu_ps(source + i + 4);
+			const __m128i q0 = _mm_unpacklo_epi64(
+				_mm_cvttpd_epi32(_mm_add_pd(_mm_cvtps_pd(lo), half)),
+				_mm_cvttpd_epi32(_mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(lo, lo)), half)));
+			const __m128i q1 = _mm_unpacklo_epi64(
+				_mm_cvttpd_epi32(_mm_add_pd(_mm_cvtps_pd(hi), half)),
+				_mm_cvttpd_epi32(_mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(hi, hi)), half)));
+			// saturating packs clamp to [0, 255]
+			const __m128i q = _mm_packs_epi32(q0, q1);
+			_mm_storel_epi64((__m128i *)(target + i), _mm_packus_epi16(q, q));
+		}
+		return i;
+	}
+
+	/// Selects a where mask is set, b elsewhere
+	inline __m128 Select_SSE2(__m128 mask, __m128 a, __m128 b) {
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	/// See FastLog2, x must be positive and normal
+	inline __m128 Log2_SSE2(__m128 x) {
+		const __m128i bits = _mm_castps_si128(x);
+		__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xFF)), _mm_set1_epi32(127)));
+		__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+		const __m128 high = _mm_cmpgt_ps(m, _mm_set1_ps(fx::kSqrt2));
+		m = Select_SSE2(high, _mm_mul_ps(m, _mm_set1_ps(0.5f)), m);
+		e = _mm_add_ps(e, _mm_and_ps(high, _mm_set1_ps(1.0f)));
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+		const __m128 t2 = _mm_mul_ps(t, t);
+		__m128 p = _mm_add_ps(_mm_set1_ps(fx::kLog2C5), _mm_mul_ps(t2, _mm_set1_ps(fx::kLog2C7)));
+		p = _mm_add_ps(_mm_set1_ps(fx::kLog2C3), _mm_mul_ps(t2, p));
+		p = _mm_add_ps(_mm_set1_ps(fx::kLog2C1), _mm_mul_ps(t2, p));
+		return _mm_add_ps(e, _mm_mul_ps(t, p));
+	}
+
+	/// See FastExp2
+	inline __m128 Exp2_SSE2(__m128 x) {
+		x = _mm_max_ps(x, _mm_set1_ps(-126.0f));
+		x = _mm_min_ps(x, _mm_set1_ps(126.0f));
+		// n = floor(x + 1/2) from the truncation
+		const __m128 r = _mm_add_ps(x, _mm_set1_ps(0.5f));
+		__m128i n = _mm_cvttps_epi32(r);
+		n = _mm_add_epi32(n, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(n), r)));
+		const __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(n));
+		__m128 p = _mm_add_ps(_mm_set1_ps(fx::kExp2C5), _mm_mul_ps(f, _mm_set1_ps(fx::kExp2C6)));
+		p = _mm_add_ps(_mm_set1_ps(fx::kExp2C4), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(fx::kExp2C3), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(fx::kExp2C2), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(fx::kExp2C1), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(f, p));
+		return _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23)));
+	}
+
+	/// See FastPow, 0 for x <= 0
+	inline __m128 Pow_SSE2(__m128 x, float y) {
+		const __m128 positive = _mm_cmpgt_ps(x, _mm_setzero_ps());
+		const __m128 v = Exp2_SSE2(_mm_mul_ps(_mm_set1_ps(y), Log2_SSE2(_mm_max_ps(x, _mm_set1_ps(FLT_MIN)))));
+		return _mm_and_ps(positive, v);
+	}
+
+	inline __m128 Clamp01_SSE2(__m128 x) {
+		return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	}
+
+	/// See TransferValue
+	template <FREE_IMAGE_TRANSFER transfer>
+	inline __m128 Transfer_SSE2(__m128 v) {
+		if constexpr (transfer == FITF_SRGB_TO_LINEAR) {
+			const __m128 linear = _mm_mul_ps(v, _mm_set1_ps(fx::kSrgbInvSlope));
+			const __m128 curve = Pow_SSE2(_mm_mul_ps(_mm_add_ps(v, _mm_set1_ps(fx::kSrgbOffset)), _mm_set1_ps(fx::kSrgbInvScale)), fx::kSrgbGamma);
+			return Select_SSE2(_mm_cmple_ps(v, _mm_set1_ps(fx::kSrgbDecodeThreshold)), linear, curve);
+		} else if constexpr (transfer == FITF_LINEAR_TO_SRGB) {
+			const __m128 linear = _mm_mul_ps(v, _mm_set1_ps(fx::kSrgbSlope));
+			const __m128 curve = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(fx::kSrgbScale), Pow_SSE2(v, fx::kSrgbInvGamma)), _mm_set1_ps(fx::kSrgbOffset));
+			return Select_SSE2(_mm_cmple_ps(v, _mm_set1_ps(fx::kSrgbEncodeThreshold)), linear, curve);
+		} else if constexpr (transfer == FITF_PQ_TO_LINEAR) {
+			const __m128 p = Pow_SSE2(Clamp01_SSE2(v), fx::kPqInvM2);
+			const __m128 num = _mm_max_ps(_mm_sub_ps(p, _mm_set1_ps(fx::kPqC1)), _mm_setzero_ps());
+			const __m128 den = _mm_sub_ps(_mm_set1_ps(fx::kPqC2), _mm_mul_ps(_mm_set1_ps(fx::kPqC3), p));
+			return Pow_SSE2(_mm_div_ps(num, den), fx::kPqInvM1);
+		} else if constexpr (transfer == FITF_LINEAR_TO_PQ) {
+			const __m128 p = Pow_SSE2(Clamp01_SSE2(v), fx::kPqM1);
+			const __m128 num = _mm_add_ps(_mm_set1_ps(fx::kPqC1), _mm_mul_ps(_mm_set1_ps(fx::kPqC2), p));
+			const __m128 den = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(fx::kPqC3), p));
+			return Pow_SSE2(_mm_div_ps(num, den), fx::kPqM2);
+		} else if constexpr (transfer == FITF_HLG_TO_LINEAR) {
+			const __m128 e = Clamp01_SSE2(v);
+			const __m128 low = _mm_mul_ps(_mm_mul_ps(e, e), _mm_set1_ps(fx::kThird));
+			const __m128 high = _mm_mul_ps(_mm_add_ps(Exp2_SSE2(_mm_mul_ps(_mm_sub_ps(e, _mm_set1_ps(fx::kHlgC)), _mm_set1_ps(fx::kHlgExp2Scale))), _mm_set1_ps(fx::kHlgB)), _mm_set1_ps(fx::kTwelfth));
+			return Select_SSE2(_mm_cmple_ps(e, _mm_set1_ps(0.5f)), low, high);
+		} else {
+			const __m128 e = Clamp01_SSE2(v);
+			const __m128 low = _mm_sqrt_ps(_mm_mul_ps(e, _mm_set1_ps(3.0f)));
+			const __m128 arg = _mm_max_ps(_mm_sub_ps(_mm_mul_ps(e, _mm_set1_ps(12.0f)), _mm_set1_ps(fx::kHlgB)), _mm_set1_ps(FLT_MIN));
+			const __m128 high = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(fx::kHlgA), Log2_SSE2(arg)), _mm_set1_ps(fx::kLn2)), _mm_set1_ps(fx::kHlgC));
+			return Select_SSE2(_mm_cmple_ps(e, _mm_set1_ps(fx::kTwelfth)), low, high);
+		}
+	}
+
+	/**
+	Applies a transfer function to 4 values at a time, in place. With 4 channels, the alpha lane of each pixel is kept.
+	*/
+	template <FREE_IMAGE_TRANSFER transfer>
+	int Transfer_SSE2(float *data, int count, unsigned channels) {
+		const __m128 keep = (channels == 4) ? _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0)) : _mm_setzero_ps();
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const __m128 v = _mm_loadu_ps(data + i);
+			_mm_storeu_ps(data + i, Select_SSE2(keep, v, Transfer_SSE2<transfer>(v)));
+		}
+		return i;
+	}
+
+	int Log2Floats_SSE2(float *target, const float *source, int count) {
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_ps(target + i, Log2_SSE2(_mm_max_ps(_mm_loadu_ps(source + i), _mm_set1_ps(FLT_MIN))));
+		}
+		return i;
+	}
+
+	int PowFloats_SSE2(float *target, const float *source, int count, float exponent) {
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_ps(target + i, Pow_SSE2(_mm_loadu_ps(source + i), exponent));
+		}
+		return i;
+	}
+
+	/**
+	Shuffle masks splitting 16 pixels of 8-bit samples or 8 pixels of 16-bit samples, loaded in as many registers as channels,
+	into one register per colour channel, and merging the channels back. Alpha bytes are selected from the loaded registers.
+	*/
+	template <unsigned sample_size, unsigned channels>
+	struct YuvShuffles {
+		int8_t split[3][channels][16]{};
+		int8_t merge[channels][3][16]{};
+		int8_t alpha[channels][16]{};
+
+		constexpr YuvShuffles() {
+			constexpr unsigned pixel_size = sample_size * channels;
+			for (unsigned k = 0; k < channels; k++) {
+				for (unsigned j = 0; j < 16; j++) {
+					const unsigned q = 16 * k + j;
+					for (unsigned c = 0; c < 3; c++) {
+						const unsigned p = (j / sample_size) * pixel_size + c * sample_size + j % sample_size;
+						split[c][k][j] = (p / 16 == k) ? (int8_t)(p % 16) : (int8_t)-1;
+						merge[k][c][j] = ((q % pixel_size) / sample_size == c) ? (int8_t)((q / pixel_size) * sample_size + q % sample_size) : (int8_t)-1;
+					}
+					alpha[k][j] = ((q % pixel_size) / sample_size == 3) ? (int8_t)-1 : (int8_t)0;
+				}
+			}
+		}
+	};
+
+	/**
+	Applies the 3x3 fixed point transform to 8 pixels of 32-bit channels x, results are clamped to [0, max]
+	*/
+	FI_TARGET("avx2")
+	inline void TransformYuvLanes_AVX2(__m256i *y, const __m256i *x, const __m256i (*matrix)[3], const __m256i *input_offset, const __m256i *output_offset, __m256i max) {
+		const __m256i round = _mm256_set1_epi32(1 << 11);
+		const __m256i x0 = _mm256_sub_epi32(x[0], input_offset[0]);
+		const __m256i x1 = _mm256_sub_epi32(x[1], input_offset[1]);
+		const __m256i x2 = _mm256_sub_epi32(x[2], input_offset[2]);
+		for (unsigned j = 0; j < 3; j++) {
+			__m256i acc = _mm256_add_epi32(_mm256_mullo_epi32(x0, matrix[j][0]), round);
+			acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(x1, matrix[j][1]));
+			acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(x2, matrix[j][2]));
+			acc = _mm256_add_epi32(_mm256_srai_epi32(acc, 12), output_offset[j]);
+			y[j] = _mm256_min_epi32(_mm256_max_epi32(acc, _mm256_setzero_si256()), max);
+		}
+	}
+
+	/**
+	Transforms 16 (8-bit samples) or 8 (16-bit samples) pixels at a time, channels being computed on 32-bit lanes
+	*/
+	template <typename T, unsigned channels>
+	FI_TARGET("avx2")
+	int TransformYuv_AVX2(T *target, const T *source, int count, const YuvTransform &transform) {
+		static constexpr YuvShuffles<sizeof(T), channels> kShuffles{};
+		constexpr int step = 16 / sizeof(T);
+
+		__m128i split[3][channels], merge[channels][3], alpha[channels];
+		for (unsigned k = 0; k < channels; k++) {
+			for (unsigned c = 0; c < 3; c++) {
+				split[c][k] = _mm_loadu_si128((const __m128i *)kShuffles.split[c][k]);
+				merge[k][c] = _mm_loadu_si128((const __m128i *)kShuffles.merge[k][c]);
+			}
+			alpha[k] = _mm_loadu_si128((const __m128i *)kShuffles.alpha[k]);
+		}
+		__m256i matrix[3][3], input_offset[3], output_offset[3];
+		for (unsigned j = 0; j < 3; j++) {
+			for (unsigned i = 0; i < 3; i++) {
+				matrix[j][i] = _mm256_set1_epi32(transform.matrix[j][i]);
+			}
+			input_offset[j] = _mm256_set1_epi32(transform.input_offset[j]);
+			output_offset[j] = _mm256_set1_epi32(transform.output_offset[j]);
+		}
+		const __m256i max = _mm256_set1_epi32(std::numeric_limits<T>::max());
+
+		int i = 0;
+		for (; i + step <= count; i += step) {
+			__m128i in[channels], planes[3];
+			for (unsigned k = 0; k < channels; k++) {
+				in[k] = _mm_loadu_si128((const __m128i *)(source + i * channels) + k);
+			}
+			for (unsigned c = 0; c < 3; c++) {
+				planes[c] = _mm_shuffle_epi8(in[0], split[c][0]);
+				for (unsigned k = 1; k < channels; k++) {
+					planes[c] = _mm_or_si128(planes[c], _mm_shuffle_epi8(in[k], split[c][k]));
+				}
+			}
+			__m256i x[3], y[3];
+			if constexpr (sizeof(T) == 1) {
+				__m256i z[3];
+				for (unsigned c = 0; c < 3; c++) {
+					x[c] = _mm256_cvtepu8_epi32(planes[c]);
+				}
+				TransformYuvLanes_AVX2(y, x, matrix, input_offset, output_offset, max);
+				for (unsigned c = 0; c < 3; c++) {
+					x[c] = _mm256_cvtepu8_epi32(_mm_srli_si128(planes[c], 8));
+				}
+				TransformYuvLanes_AVX2(z, x, matrix, input_offset, output_offset, max);
+				for (unsigned c = 0; c < 3; c++) {
+					planes[c] = _mm_packus_epi16(
+						_mm_packus_epi32(_mm256_castsi256_si128(y[c]), _mm256_extracti128_si256(y[c], 1)),
+						_mm_packus_epi32(_mm256_castsi256_si128(z[c]), _mm256_extracti128_si256(z[c], 1)));
+				}
+			} else {
+				for (unsigned c = 0; c < 3; c++) {
+					x[c] = _mm256_cvtepu16_epi32(planes[c]);
+				}
+				TransformYuvLanes_AVX2(y, x, matrix, input_offset, output_offset, max);
+				for (unsigned c = 0; c < 3; c++) {
+					planes[c] = _mm_packus_epi32(_mm256_castsi256_si128(y[c]), _mm256_extracti128_si256(y[c], 1));
+				}
+			}
+			for (unsigned k = 0; k < channels; k++) {
+				__m128i out = _mm_and_si128(in[k], alpha[k]);
+				for (unsigned c = 0; c < 3; c++) {
+					out = _mm_or_si128(out, _mm_shuffle_epi8(planes[c], merge[k][c]));
+				}
+				_mm_storeu_si128((__m128i *)(target + i * channels) + k, out);
+			}
+		}
+		return i;
+	}
+
+	/**
+	Converts 4 (8-bit samples) or 2 (16-bit samples) CMYK pixels at a time in place to RGBA.
+	(MAX - C) * (MAX - K) / MAX is truncated exactly as (p + (p >> bits) + 1) >> bits.
+	*/
+	int CMYKToRGBA8_SSE2(uint8_t *data, int count) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ones = _mm_set1_epi8(-1);
+		const __m128i one = _mm_set1_epi16(1);
+		const __m128i alpha = _mm_setr_epi16(0, 0, 0, 0xFF, 0, 0, 0, 0xFF);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const __m128i inv = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data + 4 * i)), ones);
+			__m128i half[2] = { _mm_unpacklo_epi8(inv, zero), _mm_unpackhi_epi8(inv, zero) };
+			for (auto &v : half) {
+				const __m128i k = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+				const __m128i p = _mm_mullo_epi16(v, k);
+				v = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(p, _mm_srli_epi16(p, 8)), one), 8);
+#if FI_RGBA_RED != 0
+				v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+#endif
+				v = _mm_or_si128(v, alpha);
+			}
+			_mm_storeu_si128((__m128i *)(data + 4 * i), _mm_packus_epi16(half[0], half[1]));
+		}
+		return i;
+	}
+
+	int CMYKToRGBA16_SSE2(uint16_t *data, int count) {
+		const __m128i ones = _mm_set1_epi8(-1);
+		const __m128i one = _mm_set1_epi32(1);
+		const __m128i bias = _mm_set1_epi32(0x8000);
+		const __m128i alpha = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+		int i = 0;
+		for (; i + 2 <= count; i += 2) {
+			const __m128i inv = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data + 4 * i)), ones);
+			const __m128i k = _mm_shufflehi_epi16(_mm_shufflelo_epi16(inv, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			const __m128i lo = _mm_mullo_epi16(inv, k);
+			const __m128i hi = _mm_mulhi_epu16(inv, k);
+			__m128i p[2] = { _mm_unpacklo_epi16(lo, hi), _mm_unpackhi_epi16(lo, hi) };
+			for (auto &v : p) {
+				v = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(v, _mm_srli_epi32(v, 16)), one), 16);
+				// signed saturation of packs keeps values biased into the int16 range
+				v = _mm_sub_epi32(v, bias);
+			}
+			const __m128i v = _mm_xor_si128(_mm_packs_epi32(p[0], p[1]), _mm_set1_epi16((short)0x8000));
+			_mm_storeu_si128((__m128i *)(data + 4 * i), _mm_or_si128(v, alpha));
+		}
+		return i;
+	}
+
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+
+	// ----------------------------------------------------------
+	//  NEON kernels
+	// ----------------------------------------------------------
+
+	int Line1To8_NEON(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		static const uint8_t kBits[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+		const uint8x8_t bits = vld1_u8(kBits);
+		int cols = 0;
+		for (; cols + 8 <= width_in_pixels; cols += 8) {
+			vst1_u8(target + cols, vtst_u8(vdup_n_u8(source[cols >> 3]), bits));
+		}
+		return cols;
+	}
+
+	template <bool rgb565>
+	int Line16To32_NEON(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		const uint16x8_t mask5 = vdupq_n_u16(0x1F);
+		const uint16x8_t mask6 = vdupq_n_u16(0x3F);
+		int cols = 0;
+		for (; cols + 8 <= width_in_pixels; cols += 8) {
+			const uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(source + 2 * cols));
+			uint16x8_t r = rgb565 ? vshrq_n_u16(v, 11) : vandq_u16(vshrq_n_u16(v, 10), mask5);
+			uint16x8_t g = vandq_u16(vshrq_n_u16(v, 5), rgb565 ? mask6 : mask5);
+			uint16x8_t b = vandq_u16(v, mask5);
+			r = vshrq_n_u16(vmulq_n_u16(r, 1053), 7);
+			b = vshrq_n_u16(vmulq_n_u16(b, 1053), 7);
+			g = rgb565
+				? vaddq_u16(vshlq_n_u16(g, 2), vshrq_n_u16(vmulq_n_u16(g, 49), 10))
+				: vshrq_n_u16(vmulq_n_u16(g, 1053), 7);
+			uint8x8x4_t out;
+			out.val[FI_RGBA_RED]   = vmovn_u16(r);
+			out.val[FI_RGBA_GREEN] = vmovn_u16(g);
+			out.val[FI_RGBA_BLUE]  = vmovn_u16(b);
+			out.val[FI_RGBA_ALPHA] = vdup_n_u8(0xFF);
+			vst4_u8(target + 4 * cols, out);
+		}
+		return cols;
+	}
+
+	int Line24To32_NEON(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		int cols = 0;
+		for (; cols + 16 <= width_in_pixels; cols += 16) {
+			const uint8x16x3_t in = vld3q_u8(source + 3 * cols);
+			uint8x16x4_t out;
+			out.val[0] = in.val[0];
+			out.val[1] = in.val[1];
+			out.val[2] = in.val[2];
+			out.val[3] = vdupq_n_u8(0xFF);
+			vst4q_u8(target + 4 * cols, out);
+		}
+		return cols;
+	}
+
+	int Line32To24_NEON(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		int cols = 0;
+		for (; cols + 16 <= width_in_pixels; cols += 16) {
+			const uint8x16x4_t in = vld4q_u8(source + 4 * cols);
+			uint8x16x3_t out;
+			out.val[0] = in.val[0];
+			out.val[1] = in.val[1];
+			out.val[2] = in.val[2];
+			vst3q_u8(target + 3 * cols, out);
+		}
+		return cols;
+	}
+
+	/// See Line16_565To555_SSE2
+	int Line16_565To555_NEON(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		const uint16x8_t rg = vdupq_n_u16(0x7FE0);
+		const uint16x8_t mask5 = vdupq_n_u16(0x1F);
+		int cols = 0;
+		for (; cols + 8 <= width_in_pixels; cols += 8) {
+			const uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(source + 2 * cols));
+			const uint16x8_t out = vorrq_u16(vandq_u16(vshrq_n_u16(v, 1), rg), vandq_u16(v, mask5));
+			vst1q_u8(target + 2 * cols, vreinterpretq_u8_u16(out));
+		}
+		return cols;
+	}
+
+	/// See Line16_555To565_SSE2
+	int Line16_555To565_NEON(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+		const uint16x8_t red = vdupq_n_u16(0xF800);
+		const uint16x8_t mask5 = vdupq_n_u16(0x1F);
+		const uint16x8_t half = vdupq_n_u16(17);
+		int cols = 0;
+		for (; cols + 8 <= width_in_pixels; cols += 8) {
+			const uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(source + 2 * cols));
+			const uint16x8_t g = vandq_u16(vshrq_n_u16(v, 5), mask5);
+			const uint16x8_t g6 = vsubq_u16(vshlq_n_u16(g, 1), vcgtq_u16(g, half));
+			const uint16x8_t out = vorrq_u16(vorrq_u16(vandq_u16(vshlq_n_u16(v, 1), red), vshlq_n_u16(g6, 5)), vandq_u16(v, mask5));
+			vst1q_u8(target + 2 * cols, vreinterpretq_u8_u16(out));
+		}
+		return cols;
+	}
+
+	int SwapRedBlue24_NEON(uint8_t *data, int count) {
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x3_t v = vld3q_u8(data + 3 * i);
+			const uint8x16_t red = v.val[0];
+			v.val[0] = v.val[2];
+			v.val[2] = red;
+			vst3q_u8(data + 3 * i, v);
+		}
+		return i;
+	}
+
+	int SwapRedBlue32_NEON(uint8_t *data, int count) {
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t v = vld4q_u8(data + 4 * i);
+			const uint8x16_t red = v.val[0];
+			v.val[0] = v.val[2];
+			v.val[2] = red;
+			vst4q_u8(data + 4 * i, v);
+		}
+		return i;
+	}
+
+	int InterleavePlanes24_NEON(uint8_t *target, const uint8_t *const *planes, int count) {
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x3_t v;
+			v.val[0] = vld1q_u8(planes[0] + i);
+			v.val[1] = vld1q_u8(planes[1] + i);
+			v.val[2] = vld1q_u8(planes[2] + i);
+			vst3q_u8(target + 3 * i, v);
+		}
+		return i;
+	}
+
+	int InterleavePlanes32_NEON(uint8_t *target, const uint8_t *const *planes, int count) {
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t v;
+			v.val[0] = vld1q_u8(planes[0] + i);
+			v.val[1] = vld1q_u8(planes[1] + i);
+			v.val[2] = vld1q_u8(planes[2] + i);
+			v.val[3] = vld1q_u8(planes[3] + i);
+			vst4q_u8(target + 4 * i, v);
+		}
+		return i;
+	}
+
+	int SwapBytes32_NEON(uint32_t *target, const uint32_t *source, int count) {
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			vst1q_u8((uint8_t *)(target + i), vrev32q_u8(vld1q_u8((const uint8_t *)(source + i))));
+		}
+		return i;
+	}
+
+	/// See RGBEToFloat_SSE2
+	int RGBEToFloat_NEON(FIRGBF *target, const uint8_t *source, int count) {
+		const uint32x4_t mask = vdupq_n_u32(0xFF);
+		const uint32x4_t bias = vdupq_n_u32(127 - 68);
+		float *dst = reinterpret_cast<float *>(target);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(source + 4 * i));
+			const uint32x4_t e = vshrq_n_u32(v, 24);
+			const uint32x4_t e1 = vshrq_n_u32(e, 1);
+			const uint32x4_t e2 = vsubq_u32(e, e1);
+			const float32x4_t s1 = vreinterpretq_f32_u32(vshlq_n_u32(vaddq_u32(e1, bias), 23));
+			const float32x4_t s2 = vreinterpretq_f32_u32(vshlq_n_u32(vaddq_u32(e2, bias), 23));
+			const uint32x4_t nonzero = vtstq_u32(e, e);
+			float32x4x3_t out;
+			out.val[0] = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(vmulq_f32(vcvtq_f32_u32(vandq_u32(v, mask)), s1), s2)), nonzero));
+			out.val[1] = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(vmulq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(v, 8), mask)), s1), s2)), nonzero));
+			out.val[2] = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(vmulq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(v, 16), mask)), s1), s2)), nonzero));
+			vst3q_f32(dst + 3 * i, out);
+		}
+		return i;
+	}
+
+	/// See FloatToRGBE_SSE2
+	int FloatToRGBE_NEON(uint8_t *target, const FIRGBF *source, int count) {
+		const uint32x4_t mask = vdupq_n_u32(0xFF);
+		const uint32x4_t bias = vdupq_n_u32(127 + 8 + 126);
+		const uint32x4_t offset = vdupq_n_u32(128 - 126);
+		const float32x4_t threshold = vdupq_n_f32(kRGBEBlackThreshold);
+		const float *src = reinterpret_cast<const float *>(source);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const float32x4x3_t in = vld3q_f32(src + 3 * i);
+			float32x4_t v = vbslq_f32(vcgtq_f32(in.val[1], in.val[0]), in.val[1], in.val[0]);
+			v = vbslq_f32(vcgtq_f32(in.val[2], v), in.val[2], v);
+			const uint32x4_t exponent = vandq_u32(vshrq_n_u32(vreinterpretq_u32_f32(v), 23), mask);
+			const float32x4_t scale = vreinterpretq_f32_u32(vshlq_n_u32(vsubq_u32(bias, exponent), 23));
+			uint32x4_t rgbe = vandq_u32(vreinterpretq_u32_s32(vcvtq_s32_f32(vmulq_f32(in.val[0], scale))), mask);
+			rgbe = vorrq_u32(rgbe, vshlq_n_u32(vandq_u32(vreinterpretq_u32_s32(vcvtq_s32_f32(vmulq_f32(in.val[1], scale))), mask), 8));
+			rgbe = vorrq_u32(rgbe, vshlq_n_u32(vandq_u32(vreinterpretq_u32_s32(vcvtq_s32_f32(vmulq_f32(in.val[2], scale))), mask), 16));
+			rgbe = vorrq_u32(rgbe, vshlq_n_u32(vaddq_u32(exponent, offset), 24));
+			rgbe = vbicq_u32(rgbe, vcltq_f32(v, threshold));
+			vst1q_u8(target + 4 * i, vreinterpretq_u8_u32(rgbe));
+		}
+		return i;
+	}
+
+	/// See TransformFloat3_SSE2, separate multiplies and adds (no fused multiply-add) to match the scalar code
+	int TransformFloat3_NEON(float *target, const float *source, int count, const float (&matrix)[3][3]) {
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const float32x4x3_t in = vld3q_f32(source + 3 * i);
+			float32x4x3_t out;
+			for (int j = 0; j < 3; j++) {
+				out.val[j] = vaddq_f32(vaddq_f32(vmulq_n_f32(in.val[0], matrix[j][0]), vmulq_n_f32(in.val[1], matrix[j][1])), vmulq_n_f32(in.val[2], matrix[j][2]));
+			}
+			vst3q_f32(target + 3 * i, out);
+		}
+		return i;
+	}
+
+	/**
+	Applies the 3x3 fixed point transform to 4 pixels of 32-bit channels x, results are clamped to [0, max]
+	*/
+	inline void TransformYuvLanes_NEON(int32x4_t *y, const int32x4_t *x, const YuvTransform &transform, int32_t max) {
+		const int32x4_t x0 = vsubq_s32(x[0], vdupq_n_s32(transform.input_offset[0]));
+		const int32x4_t x1 = vsubq_s32(x[1], vdupq_n_s32(transform.input_offset[1]));
+		const int32x4_t x2 = vsubq_s32(x[2], vdupq_n_s32(transform.input_offset[2]));
+		for (unsigned j = 0; j < 3; j++) {
+			int32x4_t acc = vmulq_n_s32(x0, transform.matrix[j][0]);
+			acc = vmlaq_n_s32(acc, x1, transform.matrix[j][1]);
+			acc = vmlaq_n_s32(acc, x2, transform.matrix[j][2]);
+			// rounding shift, (acc + 2048) >> 12
+			acc = vaddq_s32(vrshrq_n_s32(acc, 12), vdupq_n_s32(transform.output_offset[j]));
+			y[j] = vminq_s32(vmaxq_s32(acc, vdupq_n_s32(0)), vdupq_n_s32(max));
+		}
+	}
+
+	/**
+	Transforms 16 pixels of 8-bit samples at a time, deinterleaved by vld3 / vld4
+	*/
+	template <unsigned channels>
+	int TransformYuv8_NEON(uint8_t *target, const uint8_t *source, int count, const YuvTransform &transform) {
+		using Pixels = std::conditional_t<channels == 4, uint8x16x4_t, uint8x16x3_t>;
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			Pixels v;
+			if constexpr (channels == 4) {
+				v = vld4q_u8(source + i * channels);
+			} else {
+				v = vld3q_u8(source + i * channels);
+			}
+			uint16x8_t lo[3], hi[3];
+			for (unsigned c = 0; c < 3; c++) {
+				lo[c] = vmovl_u8(vget_low_u8(v.val[c]));
+				hi[c] = vmovl_u8(vget_high_u8(v.val[c]));
+			}
+			uint16x4_t quarters[3][4];
+			for (unsigned q = 0; q < 4; q++) {
+				int32x4_t x[3], y[3];
+				for (unsigned c = 0; c < 3; c++) {
+					const uint16x8_t half = (q < 2) ? lo[c] : hi[c];
+					x[c] = vreinterpretq_s32_u32(vmovl_u16((q & 1) ? vget_high_u16(half) : vget_low_u16(half)));
+				}
+				TransformYuvLanes_NEON(y, x, transform, 255);
+				for (unsigned c = 0; c < 3; c++) {
+					quarters[c][q] = vqmovun_s32(y[c]);
+				}
+			}
+			for (unsigned c = 0; c < 3; c++) {
+				v.val[c] = vcombine_u8(
+					vqmovn_u16(vcombine_u16(quarters[c][0], quarters[c][1])),
+					vqmovn_u16(vcombine_u16(quarters[c][2], quarters[c][3])));
+			}
+			if constexpr (channels == 4) {
+				vst4q_u8(target + i * channels, v);
+			} else {
+				vst3q_u8(target + i * channels, v);
+			}
+		}
+		return i;
+	}
+
+	/**
+	Transforms 8 pixels of 16-bit samples at a time, deinterleaved by vld3 / vld4
+	*/
+	template <unsigned channels>
+	int TransformYuv16_NEON(uint16_t *target, const uint16_t *source, int count, const YuvTransform &transform) {
+		using Pixels = std::conditional_t<channels == 4, uint16x8x4_t, uint16x8x3_t>;
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			Pixels v;
+			if constexpr (channels == 4) {
+				v = vld4q_u16(source + i * channels);
+			} else {
+				v = vld3q_u16(source + i * channels);
+			}
+			int32x4_t x[3], y[3], z[3];
+			for (unsigned c = 0; c < 3; c++) {
+				x[c] = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v.val[c])));
+			}
+			TransformYuvLanes_NEON(y, x, transform, 65535);
+			for (unsigned c = 0; c < 3; c++) {
+				x[c] = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v.val[c])));
+			}
+			TransformYuvLanes_NEON(z, x, transform, 65535);
+			for (unsigned c = 0; c < 3; c++) {
+				v.val[c] = vcombine_u16(vqmovun_s32(y[c]), vqmovun_s32(z[c]));
+			}
+			if constexpr (channels == 4) {
+				vst4q_u16(target + i * channels, v);
+			} else {
+				vst3q_u16(target + i * channels, v);
+			}
+		}
+		return i;
+	}
+
+	/// See CMYKToRGBA8_SSE2, 16 pixels at a time deinterleaved by vld4
+	int CMYKToRGBA8_NEON(uint8_t *data, int count) {
+		const uint16x8_t one = vdupq_n_u16(1);
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const uint8x16x4_t v = vld4q_u8(data + 4 * i);
+			const uint8x16_t k = vmvnq_u8(v.val[3]);
+			uint8x16_t rgb[3];
+			for (unsigned c = 0; c < 3; c++) {
+				const uint8x16_t inv = vmvnq_u8(v.val[c]);
+				uint16x8_t lo = vmull_u8(vget_low_u8(inv), vget_low_u8(k));
+				uint16x8_t hi = vmull_u8(vget_high_u8(inv), vget_high_u8(k));
+				lo = vaddq_u16(vsraq_n_u16(lo, lo, 8), one);
+				hi = vaddq_u16(vsraq_n_u16(hi, hi, 8), one);
+				rgb[c] = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+			}
+			uint8x16x4_t out;
+			out.val[FI_RGBA_RED] = rgb[0];
+			out.val[FI_RGBA_GREEN] = rgb[1];
+			out.val[FI_RGBA_BLUE] = rgb[2];
+			out.val[FI_RGBA_ALPHA] = vdupq_n_u8(0xFF);
+			vst4q_u8(data + 4 * i, out);
+		}
+		return i;
+	}
+
+	/// See CMYKToRGBA16_SSE2, 8 pixels at a time deinterleaved by vld4
+	int CMYKToRGBA16_NEON(uint16_t *data, int count) {
+		const uint32x4_t one = vdupq_n_u32(1);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			uint16x8x4_t v = vld4q_u16(data + 4 * i);
+			const uint16x8_t k = vmvnq_u16(v.val[3]);
+			for (unsigned c = 0; c < 3; c++) {
+				const uint16x8_t inv = vmvnq_u16(v.val[c]);
+				uint32x4_t lo = vmull_u16(vget_low_u16(inv), vget_low_u16(k));
+				uint32x4_t hi = vmull_u16(vget_high_u16(inv), vget_high_u16(k));
+				lo = vaddq_u32(vsraq_n_u32(lo, lo, 16), one);
+				hi = vaddq_u32(vsraq_n_u32(hi, hi, 16), one);
+				v.val[c] = vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+			}
+			v.val[3] = vdupq_n_u16(0xFFFF);
+			vst4q_u16(data + 4 * i, v);
+		}
+		return i;
+	}
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+	// half precision conversions are part of ARMv8 NEON
+
+	int HalfToFloat_NEON(float *target, const uint16_t *source, int count) {
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			vst1q_f32(target + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(source + i))));
+		}
+		return i;
+	}
+
+	int FloatToHalf_NEON(uint16_t *target, const float *source, int count) {
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			vst1_u16(target + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(source + i))));
+		}
+		return i;
+	}
+#define FREEIMAGE_SIMD_NEON_FP16 1
+
+	// float division and across vector reductions are part of ARMv8 NEON
+
+	/// See IntToFloat_SSE2
+	template <typename T>
+	int IntToFloat_NEON(float *target, const T *source, int count, float divisor) {
+		const float32x4_t d = vdupq_n_f32(divisor);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			float32x4_t lo, hi;
+			if constexpr (sizeof(T) == 1) {
+				const uint16x8_t v = vmovl_u8(vld1_u8(reinterpret_cast<const uint8_t *>(source + i)));
+				lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(v)));
+				hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(v)));
+			} else if constexpr (std::is_signed_v<T>) {
+				const int16x8_t v = vld1q_s16(reinterpret_cast<const int16_t *>(source + i));
+				lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+				hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+			} else {
+				const uint16x8_t v = vld1q_u16(reinterpret_cast<const uint16_t *>(source + i));
+				lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(v)));
+				hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(v)));
+			}
+			vst1q_f32(target + i, vdivq_f32(lo, d));
+			vst1q_f32(target + i + 4, vdivq_f32(hi, d));
+		}
+		return i;
+	}
+
+	int MinMaxUInt16_NEON(const uint16_t *source, int count, uint16_t &min, uint16_t &max) {
+		uint16x8_t vmin = vdupq_n_u16(min);
+		uint16x8_t vmax = vdupq_n_u16(max);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const uint16x8_t v = vld1q_u16(source + i);
+			vmin = vminq_u16(vmin, v);
+			vmax = vmaxq_u16(vmax, v);
+		}
+		min = vminvq_u16(vmin);
+		max = vmaxvq_u16(vmax);
+		return i;
+	}
+
+	int MinMaxInt16_NEON(const int16_t *source, int count, int16_t &min, int16_t &max) {
+		int16x8_t vmin = vdupq_n_s16(min);
+		int16x8_t vmax = vdupq_n_s16(max);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const int16x8_t v = vld1q_s16(source + i);
+			vmin = vminq_s16(vmin, v);
+			vmax = vmaxq_s16(vmax, v);
+		}
+		min = vminvq_s16(vmin);
+		max = vmaxvq_s16(vmax);
+		return i;
+	}
+
+	/// FMINNM / FMAXNM return the number if one operand is a NaN, so NaNs are skipped like by the scalar comparisons
+	int MinMaxFloat_NEON(const float *source, int count, float &min, float &max) {
+		float32x4_t vmin = vdupq_n_f32(min);
+		float32x4_t vmax = vdupq_n_f32(max);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const float32x4_t v = vld1q_f32(source + i);
+			vmin = vminnmq_f32(vmin, v);
+			vmax = vmaxnmq_f32(vmax, v);
+		}
+		min = vminnmvq_f32(vmin);
+		max = vmaxnmvq_f32(vmax);
+		return i;
+	}
+
+	/// See Log2_SSE2
+	inline float32x4_t Log2_NEON(float32x4_t x) {
+		const uint32x4_t bits = vreinterpretq_u32_f32(x);
+		float32x4_t e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(bits, 23), vdupq_n_u32(0xFF))), vdupq_n_s32(127)));
+		float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007FFFFF)), vdupq_n_u32(0x3F800000)));
+		const uint32x4_t high = vcgtq_f32(m, vdupq_n_f32(fx::kSqrt2));
+		m = vbslq_f32(high, vmulq_f32(m, vdupq_n_f32(0.5f)), m);
+		e = vaddq_f32(e, vreinterpretq_f32_u32(vandq_u32(high, vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+		const float32x4_t one = vdupq_n_f32(1.0f);
+		const float32x4_t t = vdivq_f32(vsubq_f32(m, one), vaddq_f32(m, one));
+		const float32x4_t t2 = vmulq_f32(t, t);
+		float32x4_t p = vaddq_f32(vdupq_n_f32(fx::kLog2C5), vmulq_f32(t2, vdupq_n_f32(fx::kLog2C7)));
+		p = vaddq_f32(vdupq_n_f32(fx::kLog2C3), vmulq_f32(t2, p));
+		p = vaddq_f32(vdupq_n_f32(fx::kLog2C1), vmulq_f32(t2, p));
+		return vaddq_f32(e, vmulq_f32(t, p));
+	}
+
+	/// See Exp2_SSE2
+	inline float32x4_t Exp2_NEON(float32x4_t x) {
+		x = vmaxq_f32(x, vdupq_n_f32(-126.0f));
+		x = vminq_f32(x, vdupq_n_f32(126.0f));
+		const float32x4_t r = vaddq_f32(x, vdupq_n_f32(0.5f));
+		int32x4_t n = vcvtq_s32_f32(r);
+		n = vaddq_s32(n, vreinterpretq_s32_u32(vcgtq_f32(vcvtq_f32_s32(n), r)));
+		const float32x4_t f = vsubq_f32(x, vcvtq_f32_s32(n));
+		float32x4_t p = vaddq_f32(vdupq_n_f32(fx::kExp2C5), vmulq_f32(f, vdupq_n_f32(fx::kExp2C6)));
+		p = vaddq_f32(vdupq_n_f32(fx::kExp2C4), vmulq_f32(f, p));
+		p = vaddq_f32(vdupq_n_f32(fx::kExp2C3), vmulq_f32(f, p));
+		p = vaddq_f32(vdupq_n_f32(fx::kExp2C2), vmulq_f32(f, p));
+		p = vaddq_f32(vdupq_n_f32(fx::kExp2C1), vmulq_f32(f, p));
+		p = vaddq_f32(vdupq_n_f32(1.0f), vmulq_f32(f, p));
+		return vmulq_f32(p, vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(n, vdupq_n_s32(127)), 23)));
+	}
+
+	/// See Pow_SSE2
+	inline float32x4_t Pow_NEON(float32x4_t x, float y) {
+		const uint32x4_t positive = vcgtq_f32(x, vdupq_n_f32(0.0f));
+		const float32x4_t v = Exp2_NEON(vmulq_f32(vdupq_n_f32(y), Log2_NEON(vmaxq_f32(x, vdupq_n_f32(FLT_MIN)))));
+		return vreinterpretq_f32_u32(vandq_u32(positive, vreinterpretq_u32_f32(v)));
+	}
+
+	inline float32x4_t Clamp01_NEON(float32x4_t x) {
+		return vminq_f32(vmaxq_f32(x, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+	}
+
+	/// See Transfer_SSE2
+	template <FREE_IMAGE_TRANSFER transfer>
+	inline float32x4_t Transfer_NEON(float32x4_t v) {
+		if constexpr (transfer == FITF_SRGB_TO_LINEAR) {
+			const float32x4_t linear = vmulq_f32(v, vdupq_n_f32(fx::kSrgbInvSlope));
+			const float32x4_t curve = Pow_NEON(vmulq_f32(vaddq_f32(v, vdupq_n_f32(fx::kSrgbOffset)), vdupq_n_f32(fx::kSrgbInvScale)), fx::kSrgbGamma);
+			return vbslq_f32(vcleq_f32(v, vdupq_n_f32(fx::kSrgbDecodeThreshold)), linear, curve);
+		} else if constexpr (transfer == FITF_LINEAR_TO_SRGB) {
+			const float32x4_t linear = vmulq_f32(v, vdupq_n_f32(fx::kSrgbSlope));
+			const float32x4_t curve = vsubq_f32(vmulq_f32(vdupq_n_f32(fx::kSrgbScale), Pow_NEON(v, fx::kSrgbInvGamma)), vdupq_n_f32(fx::kSrgbOffset));
+			return vbslq_f32(vcleq_f32(v, vdupq_n_f32(fx::kSrgbEncodeThreshold)), linear, curve);
+		} else if constexpr (transfer == FITF_PQ_TO_LINEAR) {
+			const float32x4_t p = Pow_NEON(Clamp01_NEON(v), fx::kPqInvM2);
+			const float32x4_t num = vmaxq_f32(vsubq_f32(p, vdupq_n_f32(fx::kPqC1)), vdupq_n_f32(0.0f));
+			const float32x4_t den = vsubq_f32(vdupq_n_f32(fx::kPqC2), vmulq_f32(vdupq_n_f32(fx::kPqC3), p));
+			return Pow_NEON(vdivq_f32(num, den), fx::kPqInvM1);
+		} else if constexpr (transfer == FITF_LINEAR_TO_PQ) {
+			const float32x4_t p = Pow_NEON(Clamp01_NEON(v), fx::kPqM1);
+			const float32x4_t num = vaddq_f32(vdupq_n_f32(fx::kPqC1), vmulq_f32(vdupq_n_f32(fx::kPqC2), p));
+			const float32x4_t den = vaddq_f32(vdupq_n_f32(1.0f), vmulq_f32(vdupq_n_f32(fx::kPqC3), p));
+			return Pow_NEON(vdivq_f32(num, den), fx::kPqM2);
+		} else if constexpr (transfer == FITF_HLG_TO_LINEAR) {
+			const float32x4_t e = Clamp01_NEON(v);
+			const float32x4_t low = vmulq_f32(vmulq_f32(e, e), vdupq_n_f32(fx::kThird));
+			const float32x4_t high = vmulq_f32(vaddq_f32(Exp2_NEON(vmulq_f32(vsubq_f32(e, vdupq_n_f32(fx::kHlgC)), vdupq_n_f32(fx::kHlgExp2Scale))), vdupq_n_f32(fx::kHlgB)), vdupq_n_f32(fx::kTwelfth));
+			return vbslq_f32(vcleq_f32(e, vdupq_n_f32(0.5f)), low, high);
+		} else {
+			const float32x4_t e = Clamp01_NEON(v);
+			const float32x4_t low = vsqrtq_f32(vmulq_f32(e, vdupq_n_f32(3.0f)));
+			const float32x4_t arg = vmaxq_f32(vsubq_f32(vmulq_f32(e, vdupq_n_f32(12.0f)), vdupq_n_f32(fx::kHlgB)), vdupq_n_f32(FLT_MIN));
+			const float32x4_t high = vaddq_f32(vmulq_f32(vmulq_f32(vdupq_n_f32(fx::kHlgA), Log2_NEON(arg)), vdupq_n_f32(fx::kLn2)), vdupq_n_f32(fx::kHlgC));
+			return vbslq_f32(vcleq_f32(e, vdupq_n_f32(fx::kTwelfth)), low, high);
+		}
+	}
+
+	/// See Transfer_SSE2
+	template <FREE_IMAGE_TRANSFER transfer>
+	int Transfer_NEON(float *data, int count, unsigned channels) {
+		static const uint32_t kAlphaLane[4] = { 0, 0, 0, 0xFFFFFFFF };
+		const uint32x4_t keep = (channels == 4) ? vld1q_u32(kAlphaLane) : vdupq_n_u32(0);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const float32x4_t v = vld1q_f32(data + i);
+			vst1q_f32(data + i, vbslq_f32(keep, v, Transfer_NEON<transfer>(v)));
+		}
+		return i;
+	}
+
+	int Log2Floats_NEON(float *target, const float *source, int count) {
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			vst1q_f32(target + i, Log2_NEON(vmaxq_f32(vld1q_f32(source + i), vdupq_n_f32(FLT_MIN))));
+		}
+		return i;
+	}
+
+	int PowFloats_NEON(float *target, const float *source, int count, float exponent) {
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			vst1q_f32(target + i, Pow_NEON(vld1q_f32(source + i), exponent));
+		}
+		return i;
+	}
+#endif
+
+#endif // FREEIMAGE_SIMD_NEON
+
+	// ----------------------------------------------------------
+	//  Kernels selection
+	// ----------------------------------------------------------
+
+	using LineKernel = int (*)(uint8_t *target, const uint8_t *source, int width_in_pixels);
+	using PaletteLineKernel = int (*)(uint8_t *target, const uint8_t *source, int width_in_pixels, const FIRGBA8 *palette);
+
+	int NoKernel(uint8_t *, const uint8_t *, int) {
+		return 0;
+	}
+
+	int NoPaletteKernel(uint8_t *, const uint8_t *, int, const FIRGBA8 *) {
+		return 0;
+	}
+
+	using HalfToFloatKernel = int (*)(float *target, const uint16_t *source, int count);
+	using FloatToHalfKernel = int (*)(uint16_t *target, const float *source, int count);
+
+	int NoHalfToFloatKernel(float *, const uint16_t *, int) {
+		return 0;
+	}
+
+	int NoFloatToHalfKernel(uint16_t *, const float *, int) {
+		return 0;
+	}
+
+	using RGBEToFloatKernel = int (*)(FIRGBF *target, const uint8_t *source, int count);
+	using FloatToRGBEKernel = int (*)(uint8_t *target, const FIRGBF *source, int count);
+
+	int NoRGBEToFloatKernel(FIRGBF *, const uint8_t *, int) {
+		return 0;
+	}
+
+	int NoFloatToRGBEKernel(uint8_t *, const FIRGBF *, int) {
+		return 0;
+	}
+
+	using TransformFloat3Kernel = int (*)(float *target, const float *source, int count, const float (&matrix)[3][3]);
+
+	int NoTransformFloat3Kernel(float *, const float *, int, const float (&)[3][3]) {
+		return 0;
+	}
+
+	template <typename T>
+	using ToFloatKernel = int (*)(float *target, const T *source, int count, float divisor);
+	template <typename T>
+	using MinMaxKernel = int (*)(const T *source, int count, T &min, T &max);
+	template <typename T>
+	using ScaleToByteKernel = int (*)(uint8_t *target, const T *source, int count, T min, double scale);
+	using RoundToByteKernel = int (*)(uint8_t *target, const float *source, int count);
+
+	template <typename T>
+	int NoToFloatKernel(float *, const T *, int, float) {
+		return 0;
+	}
+
+	template <typename T>
+	int NoMinMaxKernel(const T *, int, T &, T &) {
+		return 0;
+	}
+
+	template <typename T>
+	int NoScaleToByteKernel(uint8_t *, const T *, int, T, double) {
+		return 0;
+	}
+
+	int NoRoundToByteKernel(uint8_t *, const float *, int) {
+		return 0;
+	}
+
+	using TransferKernel = int (*)(float *data, int count, unsigned channels);
+
+	int NoTransferKernel(float *, int, unsigned) {
+		return 0;
+	}
+
+	const unsigned kTransferCount = FITF_LINEAR_TO_HLG + 1;
+
+	using Log2Kernel = int (*)(float *target, const float *source, int count);
+
+	int NoLog2Kernel(float *, const float *, int) {
+		return 0;
+	}
+
+	using PowKernel = int (*)(float *target, const float *source, int count, float exponent);
+
+	int NoPowKernel(float *, const float *, int, float) {
+		return 0;
+	}
+
+	using SwapKernel = int (*)(uint8_t *data, int count);
+
+	int NoSwapKernel(uint8_t *, int) {
+		return 0;
+	}
+
+	using InterleaveKernel = int (*)(uint8_t *target, const uint8_t *const *planes, int count);
+
+	int NoInterleaveKernel(uint8_t *, const uint8_t *const *, int) {
+		return 0;
+	}
+
+	using ByteSwapKernel = int (*)(uint32_t *target, const uint32_t *source, int count);
+
+	int NoByteSwapKernel(uint32_t *, const uint32_t *, int) {
+		return 0;
+	}
+
+	template <typename T>
+	using CMYKKernel = int (*)(T *data, int count);
+
+	template <typename T>
+	int NoCMYKKernel(T *, int) {
+		return 0;
+	}
+
+	template <typename T>
+	using YuvKernel = int (*)(T *target, const T *source, int count, const YuvTransform &transform);
+
+	template <typename T>
+	int NoYuvKernel(T *, const T *, int, const YuvTransform &) {
+		return 0;
+	}
+
+	/// Kernels for the enabled CPU features, all lines are converted by the scalar code until selection
+	struct ConversionKernels {
+		std::atomic<LineKernel> line1To8{ NoKernel };
+		std::atomic<PaletteLineKernel> line8To32{ NoPaletteKernel };
+		std::atomic<LineKernel> line16To32_555{ NoKernel };
+		std::atomic<LineKernel> line16To32_565{ NoKernel };
+		std::atomic<LineKernel> line24To32{ NoKernel };
+		std::atomic<LineKernel> line32To24{ NoKernel };
+		std::atomic<LineKernel> line16_555To565{ NoKernel };
+		std::atomic<LineKernel> line16_565To555{ NoKernel };
+		std::atomic<SwapKernel> swap24{ NoSwapKernel };
+		std::atomic<SwapKernel> swap32{ NoSwapKernel };
+		std::atomic<InterleaveKernel> interleave24{ NoInterleaveKernel };
+		std::atomic<InterleaveKernel> interleave32{ NoInterleaveKernel };
+		std::atomic<ByteSwapKernel> byteSwap32{ NoByteSwapKernel };
+		std::atomic<HalfToFloatKernel> halfToFloat{ NoHalfToFloatKernel };
+		std::atomic<FloatToHalfKernel> floatToHalf{ NoFloatToHalfKernel };
+		std::atomic<RGBEToFloatKernel> rgbeToFloat{ NoRGBEToFloatKernel };
+		std::atomic<FloatToRGBEKernel> floatToRGBE{ NoFloatToRGBEKernel };
+		std::atomic<TransformFloat3Kernel> transformFloat3{ NoTransformFloat3Kernel };
+		std::atomic<ToFloatKernel<uint8_t>> uint8ToFloat{ NoToFloatKernel<uint8_t> };
+		std::atomic<ToFloatKernel<uint16_t>> uint16ToFloat{ NoToFloatKernel<uint16_t> };
+		std::atomic<ToFloatKernel<int16_t>> int16ToFloat{ NoToFloatKernel<int16_t> };
+		std::atomic<MinMaxKernel<uint16_t>> minMaxUInt16{ NoMinMaxKernel<uint16_t> };
+		std::atomic<MinMaxKernel<int16_t>> minMaxInt16{ NoMinMaxKernel<int16_t> };
+		std::atomic<MinMaxKernel<float>> minMaxFloat{ NoMinMaxKernel<float> };
+		std::atomic<ScaleToByteKernel<uint16_t>> scaleUInt16ToByte{ NoScaleToByteKernel<uint16_t> };
+		std::atomic<ScaleToByteKernel<int16_t>> scaleInt16ToByte{ NoScaleToByteKernel<int16_t> };
+		std::atomic<ScaleToByteKernel<float>> scaleFloatToByte{ NoScaleToByteKernel<float> };
+		std::atomic<RoundToByteKernel> roundFloatToByte{ NoRoundToByteKernel };
+		/// indexed by FREE_IMAGE_TRANSFER
+		std::atomic<TransferKernel> transfer[kTransferCount]{ NoTransferKernel, NoTransferKernel, NoTransferKernel, NoTransferKernel, NoTransferKernel, NoTransferKernel };
+		std::atomic<Log2Kernel> log2Floats{ NoLog2Kernel };
+		std::atomic<PowKernel> powFloats{ NoPowKernel };
+		std::atomic<YuvKernel<uint8_t>> yuv24{ NoYuvKernel<uint8_t> };
+		std::atomic<YuvKernel<uint8_t>> yuv32{ NoYuvKernel<uint8_t> };
+		std::atomic<YuvKernel<uint16_t>> yuv48{ NoYuvKernel<uint16_t> };
+		std::atomic<YuvKernel<uint16_t>> yuv64{ NoYuvKernel<uint16_t> };
+		std::atomic<CMYKKernel<uint8_t>> cmyk32{ NoCMYKKernel<uint8_t> };
+		std::atomic<CMYKKernel<uint16_t>> cmyk64{ NoCMYKKernel<uint16_t> };
+	};
+
+	ConversionKernels gKernels;
+
+	void SelectConversionKernels(uint32_t features) {
+		LineKernel line1To8 = NoKernel;
+		PaletteLineKernel line8To32 = NoPaletteKernel;
+		LineKernel line16To32_555 = NoKernel;
+		LineKernel line16To32_565 = NoKernel;
+		LineKernel line24To32 = NoKernel;
+		LineKernel line32To24 = NoKernel;
+		LineKernel line16_555To565 = NoKernel;
+		LineKernel line16_565To555 = NoKernel;
+		SwapKernel swap24 = NoSwapKernel;
+		SwapKernel swap32 = NoSwapKernel;
+		InterleaveKernel interleave24 = NoInterleaveKernel;
+		InterleaveKernel interleave32 = NoInterleaveKernel;
+		ByteSwapKernel byteSwap32 = NoByteSwapKernel;
+		HalfToFloatKernel halfToFloat = NoHalfToFloatKernel;
+		FloatToHalfKernel floatToHalf = NoFloatToHalfKernel;
+		RGBEToFloatKernel rgbeToFloat = NoRGBEToFloatKernel;
+		FloatToRGBEKernel floatToRGBE = NoFloatToRGBEKernel;
+		TransformFloat3Kernel transformFloat3 = NoTransformFloat3Kernel;
+		ToFloatKernel<uint8_t> uint8ToFloat = NoToFloatKernel<uint8_t>;
+		ToFloatKernel<uint16_t> uint16ToFloat = NoToFloatKernel<uint16_t>;
+		ToFloatKernel<int16_t> int16ToFloat = NoToFloatKernel<int16_t>;
+		MinMaxKernel<uint16_t> minMaxUInt16 = NoMinMaxKernel<uint16_t>;
+		MinMaxKernel<int16_t> minMaxInt16 = NoMinMaxKernel<int16_t>;
+		MinMaxKernel<float> minMaxFloat = NoMinMaxKernel<float>;
+		ScaleToByteKernel<uint16_t> scaleUInt16ToByte = NoScaleToByteKernel<uint16_t>;
+		ScaleToByteKernel<int16_t> scaleInt16ToByte = NoScaleToByteKernel<int16_t>;
+		ScaleToByteKernel<float> scaleFloatToByte = NoScaleToByteKernel<float>;
+		RoundToByteKernel roundFloatToByte = NoRoundToByteKernel;
+		TransferKernel transfer[kTransferCount] = { NoTransferKernel, NoTransferKernel, NoTransferKernel, NoTransferKernel, NoTransferKernel, NoTransferKernel };
+		Log2Kernel log2Floats = NoLog2Kernel;
+		PowKernel powFloats = NoPowKernel;
+		YuvKernel<uint8_t> yuv24 = NoYuvKernel<uint8_t>;
+		YuvKernel<uint8_t> yuv32 = NoYuvKernel<uint8_t>;
+		YuvKernel<uint16_t> yuv48 = NoYuvKernel<uint16_t>;
+		YuvKernel<uint16_t> yuv64 = NoYuvKernel<uint16_t>;
+		CMYKKernel<uint8_t> cmyk32 = NoCMYKKernel<uint8_t>;
+		CMYKKernel<uint16_t> cmyk64 = NoCMYKKernel<uint16_t>;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			line16To32_555 = Line16To32_SSE2<false>;
+			line16To32_565 = Line16To32_SSE2<true>;
+			line16_555To565 = Line16_555To565_SSE2;
+			line16_565To555 = Line16_565To555_SSE2;
+			rgbeToFloat = RGBEToFloat_SSE2;
+			floatToRGBE = FloatToRGBE_SSE2;
+			transformFloat3 = TransformFloat3_SSE2;
+			uint8ToFloat = IntToFloat_SSE2<uint8_t>;
+			uint16ToFloat = IntToFloat_SSE2<uint16_t>;
+			int16ToFloat = IntToFloat_SSE2<int16_t>;
+			minMaxUInt16 = MinMaxInt16_SSE2<uint16_t>;
+			minMaxInt16 = MinMaxInt16_SSE2<int16_t>;
+			minMaxFloat = MinMaxFloat_SSE2;
+			scaleUInt16ToByte = ScaleInt16ToByte_SSE2<uint16_t>;
+			scaleInt16ToByte = ScaleInt16ToByte_SSE2<int16_t>;
+			scaleFloatToByte = ScaleFloatToByte_SSE2;
+			roundFloatToByte = RoundFloatToByte_SSE2;
+			transfer[FITF_SRGB_TO_LINEAR] = Transfer_SSE2<FITF_SRGB_TO_LINEAR>;
+			transfer[FITF_LINEAR_TO_SRGB] = Transfer_SSE2<FITF_LINEAR_TO_SRGB>;
+			transfer[FITF_PQ_TO_LINEAR] = Transfer_SSE2<FITF_PQ_TO_LINEAR>;
+			transfer[FITF_LINEAR_TO_PQ] = Transfer_SSE2<FITF_LINEAR_TO_PQ>;
+			transfer[FITF_HLG_TO_LINEAR] = Transfer_SSE2<FITF_HLG_TO_LINEAR>;
+			transfer[FITF_LINEAR_TO_HLG] = Transfer_SSE2<FITF_LINEAR_TO_HLG>;
+			log2Floats = Log2Floats_SSE2;
+			powFloats = PowFloats_SSE2;
+			cmyk32 = CMYKToRGBA8_SSE2;
+			cmyk64 = CMYKToRGBA16_SSE2;
+			interleave32 = InterleavePlanes32_SSE2;
+			byteSwap32 = SwapBytes32_SSE2;
+		}
+		if (features & FI_CPU_SSSE3) {
+			line1To8 = Line1To8_SSSE3;
+			line24To32 = Line24To32_SSSE3;
+			line32To24 = Line32To24_SSSE3;
+			swap24 = SwapRedBlue24_SSSE3;
+			swap32 = SwapRedBlue32_SSSE3;
+			interleave24 = InterleavePlanes24_SSSE3;
+			byteSwap32 = SwapBytes32_SSSE3;
+		}
+		if (features & FI_CPU_AVX2) {
+			line8To32 = Line8To32_AVX2;
+			yuv24 = TransformYuv_AVX2<uint8_t, 3>;
+			yuv32 = TransformYuv_AVX2<uint8_t, 4>;
+			yuv48 = TransformYuv_AVX2<uint16_t, 3>;
+			yuv64 = TransformYuv_AVX2<uint16_t, 4>;
+		}
+		if (features & FI_CPU_F16C) {
+			halfToFloat = HalfToFloat_F16C;
+			floatToHalf = FloatToHalf_F16C;
+		}
+#elif FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			line1To8 = Line1To8_NEON;
+			line16To32_555 = Line16To32_NEON<false>;
+			line16To32_565 = Line16To32_NEON<true>;
+			line24To32 = Line24To32_NEON;
+			line32To24 = Line32To24_NEON;
+			line16_555To565 = Line16_555To565_NEON;
+			line16_565To555 = Line16_565To555_NEON;
+			swap24 = SwapRedBlue24_NEON;
+			swap32 = SwapRedBlue32_NEON;
+			interleave24 = InterleavePlanes24_NEON;
+			interleave32 = InterleavePlanes32_NEON;
+			byteSwap32 = SwapBytes32_NEON;
+			rgbeToFloat = RGBEToFloat_NEON;
+			floatToRGBE = FloatToRGBE_NEON;
+			transformFloat3 = TransformFloat3_NEON;
+			yuv24 = TransformYuv8_NEON<3>;
+			yuv32 = TransformYuv8_NEON<4>;
+			yuv48 = TransformYuv16_NEON<3>;
+			yuv64 = TransformYuv16_NEON<4>;
+			cmyk32 = CMYKToRGBA8_NEON;
+			cmyk64 = CMYKToRGBA16_NEON;
+#if FREEIMAGE_SIMD_NEON_FP16
+			halfToFloat = HalfToFloat_NEON;
+			floatToHalf = FloatToHalf_NEON;
+			uint8ToFloat = IntToFloat_NEON<uint8_t>;
+			uint16ToFloat = IntToFloat_NEON<uint16_t>;
+			int16ToFloat = IntToFloat_NEON<int16_t>;
+			minMaxUInt16 = MinMaxUInt16_NEON;
+			minMaxInt16 = MinMaxInt16_NEON;
+			minMaxFloat = MinMaxFloat_NEON;
+			transfer[FITF_SRGB_TO_LINEAR] = Transfer_NEON<FITF_SRGB_TO_LINEAR>;
+			transfer[FITF_LINEAR_TO_SRGB] = Transfer_NEON<FITF_LINEAR_TO_SRGB>;
+			transfer[FITF_PQ_TO_LINEAR] = Transfer_NEON<FITF_PQ_TO_LINEAR>;
+			transfer[FITF_LINEAR_TO_PQ] = Transfer_NEON<FITF_LINEAR_TO_PQ>;
+			transfer[FITF_HLG_TO_LINEAR] = Transfer_NEON<FITF_HLG_TO_LINEAR>;
+			transfer[FITF_LINEAR_TO_HLG] = Transfer_NEON<FITF_LINEAR_TO_HLG>;
+			log2Floats = Log2Floats_NEON;
+			powFloats = PowFloats_NEON;
+#endif
+		}
+#endif
+		gKernels.line1To8.store(line1To8, std::memory_order_relaxed);
+		gKernels.line8To32.store(line8To32, std::memory_order_relaxed);
+		gKernels.line16To32_555.store(line16To32_555, std::memory_order_relaxed);
+		gKernels.line16To32_565.store(line16To32_565, std::memory_order_relaxed);
+		gKernels.line24To32.store(line24To32, std::memory_order_relaxed);
+		gKernels.line32To24.store(line32To24, std::memory_order_relaxed);
+		gKernels.line16_555To565.store(line16_555To565, std::memory_order_relaxed);
+		gKernels.line16_565To555.store(line16_565To555, std::memory_order_relaxed);
+		gKernels.swap24.store(swap24, std::memory_order_relaxed);
+		gKernels.swap32.store(swap32, std::memory_order_relaxed);
+		gKernels.interleave24.store(interleave24, std::memory_order_relaxed);
+		gKernels.interleave32.store(interleave32, std::memory_order_relaxed);
+		gKernels.byteSwap32.store(byteSwap32, std::memory_order_relaxed);
+		gKernels.halfToFloat.store(halfToFloat, std::memory_order_relaxed);
+		gKernels.floatToHalf.store(floatToHalf, std::memory_order_relaxed);
+		gKernels.rgbeToFloat.store(rgbeToFloat, std::memory_order_relaxed);
+		gKernels.floatToRGBE.store(floatToRGBE, std::memory_order_relaxed);
+		gKernels.transformFloat3.store(transformFloat3, std::memory_order_relaxed);
+		gKernels.uint8ToFloat.store(uint8ToFloat, std::memory_order_relaxed);
+		gKernels.uint16ToFloat.store(uint16ToFloat, std::memory_order_relaxed);
+		gKernels.int16ToFloat.store(int16ToFloat, std::memory_order_relaxed);
+		gKernels.minMaxUInt16.store(minMaxUInt16, std::memory_order_relaxed);
+		gKernels.minMaxInt16.store(minMaxInt16, std::memory_order_relaxed);
+		gKernels.minMaxFloat.store(minMaxFloat, std::memory_order_relaxed);
+		gKernels.scaleUInt16ToByte.store(scaleUInt16ToByte, std::memory_order_relaxed);
+		gKernels.scaleInt16ToByte.store(scaleInt16ToByte, std::memory_order_relaxed);
+		gKernels.scaleFloatToByte.store(scaleFloatToByte, std::memory_order_relaxed);
+		gKernels.roundFloatToByte.store(roundFloatToByte, std::memory_order_relaxed);
+		for (unsigned i = 0; i < kTransferCount; i++) {
+			gKernels.transfer[i].store(transfer[i], std::memory_order_relaxed);
+		}
+		gKernels.log2Floats.store(log2Floats, std::memory_order_relaxed);
+		gKernels.powFloats.store(powFloats, std::memory_order_relaxed);
+		gKernels.yuv24.store(yuv24, std::memory_order_relaxed);
+		gKernels.yuv32.store(yuv32, std::memory_order_relaxed);
+		gKernels.yuv48.store(yuv48, std::memory_order_relaxed);
+		gKernels.yuv64.store(yuv64, std::memory_order_relaxed);
+		gKernels.cmyk32.store(cmyk32, std::memory_order_relaxed);
+		gKernels.cmyk64.store(cmyk64, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectConversionKernels);
+
+} // namespace
+
+// ----------------------------------------------------------
+
+int ConvertLine1To8_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	return gKernels.line1To8.load(std::memory_order_relaxed)(target, source, width_in_pixels);
+}
+
+int ConvertLine8To32_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels, const FIRGBA8 *palette) {
+	return gKernels.line8To32.load(std::memory_order_relaxed)(target, source, width_in_pixels, palette);
+}
+
+int ConvertLine16To32_555_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	return gKernels.line16To32_555.load(std::memory_order_relaxed)(target, source, width_in_pixels);
+}
+
+int ConvertLine16To32_565_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	return gKernels.line16To32_565.load(std::memory_order_relaxed)(target, source, width_in_pixels);
+}
+
+int ConvertLine24To32_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	return gKernels.line24To32.load(std::memory_order_relaxed)(target, source, width_in_pixels);
+}
+
+int ConvertLine32To24_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	return gKernels.line32To24.load(std::memory_order_relaxed)(target, source, width_in_pixels);
+}
+
+int ConvertLine16_555To565_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	return gKernels.line16_555To565.load(std::memory_order_relaxed)(target, source, width_in_pixels);
+}
+
+int ConvertLine16_565To555_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	return gKernels.line16_565To555.load(std::memory_order_relaxed)(target, source, width_in_pixels);
+}
+
+// ----------------------------------------------------------
+
+void ConvertHalfToFloat(float *target, const uint16_t *source, unsigned count) {
+	unsigned i = (unsigned)gKernels.halfToFloat.load(std::memory_order_relaxed)(target, source, (int)count);
+	for (; i < count; i++) {
+		target[i] = HalfToFloat(source[i]);
+	}
+}
+
+void ConvertFloatToHalf(uint16_t *target, const float *source, unsigned count) {
+	unsigned i = (unsigned)gKernels.floatToHalf.load(std::memory_order_relaxed)(target, source, (int)count);
+	for (; i < count; i++) {
+		target[i] = FloatToHalf(source[i]);
+	}
+}
+
+// ----------------------------------------------------------
+
+void ConvertRGBEToFloat(FIRGBF *target, const uint8_t *source, unsigned count) {
+	unsigned i = (unsigned)gKernels.rgbeToFloat.load(std::memory_order_relaxed)(target, source, (int)count);
+	for (; i < count; i++) {
+		RGBEToFloat(&target[i], &source[4 * i]);
+	}
+}
+
+void ConvertFloatToRGBE(uint8_t *target, const FIRGBF *source, unsigned count) {
+	unsigned i = (unsigned)gKernels.floatToRGBE.load(std::memory_order_relaxed)(target, source, (int)count);
+	for (; i < count; i++) {
+		FloatToRGBE(&target[4 * i], &source[i]);
+	}
+}
+
+// ----------------------------------------------------------
+
+void TransformFloat3(float *target, const float *source, unsigned count, const float (&matrix)[3][3]) {
+	unsigned i = (unsigned)gKernels.transformFloat3.load(std::memory_order_relaxed)(target, source, (int)count, matrix);
+	for (; i < count; i++) {
+		const float x = source[3 * i], y = source[3 * i + 1], z = source[3 * i + 2];
+		for (unsigned j = 0; j < 3; j++) {
+			target[3 * i + j] = matrix[j][0] * x + matrix[j][1] * y + matrix[j][2] * z;
+		}
+	}
+}
+
+// ----------------------------------------------------------
+
+void ConvertToFloat(float *target, const uint8_t *source, unsigned count, float divisor) {
+	unsigned i = (unsigned)gKernels.uint8ToFloat.load(std::memory_order_relaxed)(target, source, (int)count, divisor);
+	for (; i < count; i++) {
+		target[i] = static_cast<float>(source[i]) / divisor;
+	}
+}
+
+void ConvertToFloat(float *target, const uint16_t *source, unsigned count, float divisor) {
+	unsigned i = (unsigned)gKernels.uint16ToFloat.load(std::memory_order_relaxed)(target, source, (int)count, divisor);
+	for (; i < count; i++) {
+		target[i] = static_cast<float>(source[i]) / divisor;
+	}
+}
+
+void ConvertToFloat(float *target, const int16_t *source, unsigned count, float divisor) {
+	unsigned i = (unsigned)gKernels.int16ToFloat.load(std::memory_order_relaxed)(target, source, (int)count, divisor);
+	for (; i < count; i++) {
+		target[i] = static_cast<float>(source[i]) / divisor;
+	}
+}
+
+// ----------------------------------------------------------
+
+template <typename T>
+static std::vector<float> MakeFloatTable(bool srgb) {
+	const unsigned size = 1u << (8 * sizeof(T));
+	const float max = static_cast<float>(size - 1);
+	std::vector<float> table(size);
+	for (unsigned v = 0; v < size; v++) {
+		if (srgb) {
+			const double c = v / static_cast<double>(size - 1);
+			table[v] = static_cast<float>((c <= 0.04045) ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+		} else {
+			// same expression as the scalar conversions
+			table[v] = static_cast<float>(v) / max;
+		}
+	}
+	return table;
+}
+
+const float* GetByteToFloatTable(bool srgb) {
+	static const std::vector<float> linear = MakeFloatTable<uint8_t>(false);
+	static const std::vector<float> decoded = MakeFloatTable<uint8_t>(true);
+	return srgb ? decoded.data() : linear.data();
+}
+
+const float* GetWordToFloatTable(bool srgb) {
+	static const std::vector<float> linear = MakeFloatTable<uint16_t>(false);
+	static const std::vector<float> decoded = MakeFloatTable<uint16_t>(true);
+	return srgb ? decoded.data() : linear.data();
+}
+
+template <typename T>
+static void LookupToFloatImpl(float *target, unsigned target_channels, const T *source, unsigned source_channels,
+	const unsigned order[4], unsigned count, const float *table, const float *alpha_table) {
+	const bool has_alpha = (target_channels == 4) && (order[3] < source_channels);
+	for (unsigned i = 0; i < count; i++) {
+		target[0] = table[source[order[0]]];
+		target[1] = table[source[order[1]]];
+		target[2] = table[source[order[2]]];
+		if (target_channels == 4) {
+			target[3] = has_alpha ? alpha_table[source[order[3]]] : 1.0F;
+		}
+		target += target_channels;
+		source += source_channels;
+	}
+}
+
+void LookupToFloat(float *target, unsigned target_channels, const uint8_t *source, unsigned source_channels,
+	const unsigned order[4], unsigned count, const float *table, const float *alpha_table) {
+	LookupToFloatImpl(target, target_channels, source, source_channels, order, count, table, alpha_table);
+}
+
+void LookupToFloat(float *target, unsigned target_channels, const uint16_t *source, unsigned source_channels,
+	const unsigned order[4], unsigned count, const float *table, const float *alpha_table) {
+	LookupToFloatImpl(target, target_channels, source, source_channels, order, count, table, alpha_table);
+}
+
+// ----------------------------------------------------------
+
+template <typename T>
+static void UpdateMinMax(const MinMaxKernel<T> kernel, const T *source, unsigned count, T &min, T &max) {
+	unsigned i = (unsigned)kernel(source, (int)count, min, max);
+	for (; i < count; i++) {
+		// NaNs fail both comparisons
+		if (source[i] < min) min = source[i];
+		if (source[i] > max) max = source[i];
+	}
+}
+
+void UpdateMinMax(const uint16_t *source, unsigned count, uint16_t &min, uint16_t &max) {
+	UpdateMinMax(gKernels.minMaxUInt16.load(std::memory_order_relaxed), source, count, min, max);
+}
+
+void UpdateMinMax(const int16_t *source, unsigned count, int16_t &min, int16_t &max) {
+	UpdateMinMax(gKernels.minMaxInt16.load(std::memory_order_relaxed), source, count, min, max);
+}
+
+void UpdateMinMax(const float *source, unsigned count, float &min, float &max) {
+	UpdateMinMax(gKernels.minMaxFloat.load(std::memory_order_relaxed), source, count, min, max);
+}
+
+// ----------------------------------------------------------
+
+template <typename T>
+static void ScaleToByte(const ScaleToByteKernel<T> kernel, uint8_t *target, const T *source, unsigned count, T min, double scale) {
+	unsigned i = (unsigned)kernel(target, source, (int)count, min, scale);
+	for (; i < count; i++) {
+		target[i] = (uint8_t)(scale * (source[i] - min) + 0.5);
+	}
+}
+
+void ScaleToByte(uint8_t *target, const uint16_t *source, unsigned count, uint16_t min, double scale) {
+	ScaleToByte(gKernels.scaleUInt16ToByte.load(std::memory_order_relaxed), target, source, count, min, scale);
+}
+
+void ScaleToByte(uint8_t *target, const int16_t *source, unsigned count, int16_t min, double scale) {
+	ScaleToByte(gKernels.scaleInt16ToByte.load(std::memory_order_relaxed), target, source, count, min, scale);
+}
+
+void ScaleToByte(uint8_t *target, const float *source, unsigned count, float min, double scale) {
+	ScaleToByte(gKernels.scaleFloatToByte.load(std::memory_order_relaxed), target, source, count, min, scale);
+}
+
+void RoundToByte(uint8_t *target, const float *source, unsigned count) {
+	unsigned i = (unsigned)gKernels.roundFloatToByte.load(std::memory_order_relaxed)(target, source, (int)count);
+	for (; i < count; i++) {
+		const int q = int(source[i] + 0.5);
+		target[i] = (uint8_t)MIN(255, MAX(0, q));
+	}
+}
+
+// ----------------------------------------------------------
+
+/// log2(x) for positive normal x, same operations as Log2_SSE2
+static float FastLog2(float x) {
+	uint32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	int e = (int)((bits >> 23) & 0xFF) - 127;
+	bits = (bits & 0x007FFFFF) | 0x3F800000;
+	float m;
+	memcpy(&m, &bits, sizeof(m));
+	if (m > fx::kSqrt2) {
+		m = m * 0.5f;
+		e++;
+	}
+	const float t = (m - 1.0f) / (m + 1.0f);
+	const float t2 = t * t;
+	return (float)e + t * (fx::kLog2C1 + t2 * (fx::kLog2C3 + t2 * (fx::kLog2C5 + t2 * fx::kLog2C7)));
+}
+
+/// 2^x, same operations as Exp2_SSE2
+static float FastExp2(float x) {
+	x = (x > -126.0f) ? x : -126.0f;
+	x = (x < 126.0f) ? x : 126.0f;
+	const float r = x + 0.5f;
+	int n = (int)r;
+	if ((float)n > r) {
+		n--;
+	}
+	const float f = x - (float)n;
+	const float p = 1.0f + f * (fx::kExp2C1 + f * (fx::kExp2C2 + f * (fx::kExp2C3 + f * (fx::kExp2C4 + f * (fx::kExp2C5 + f * fx::kExp2C6)))));
+	const uint32_t bits = (uint32_t)(n + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return p * scale;
+}
+
+/// x^y, 0 for x <= 0
+static float FastPow(float x, float y) {
+	return (x > 0.0f) ? FastExp2(y * FastLog2(MAX(x, FLT_MIN))) : 0.0f;
+}
+
+static float Clamp01(float x) {
+	return MIN(MAX(x, 0.0f), 1.0f);
+}
+
+static float TransferFloat(float v, FREE_IMAGE_TRANSFER transfer) {
+	switch (transfer) {
+		case FITF_SRGB_TO_LINEAR:
+			return (v <= fx::kSrgbDecodeThreshold) ? v * fx::kSrgbInvSlope : FastPow((v + fx::kSrgbOffset) * fx::kSrgbInvScale, fx::kSrgbGamma);
+		case FITF_LINEAR_TO_SRGB:
+			return (v <= fx::kSrgbEncodeThreshold) ? v * fx::kSrgbSlope : fx::kSrgbScale * FastPow(v, fx::kSrgbInvGamma) - fx::kSrgbOffset;
+		case FITF_PQ_TO_LINEAR:
+		{
+			const float p = FastPow(Clamp01(v), fx::kPqInvM2);
+			return FastPow(MAX(p - fx::kPqC1, 0.0f) / (fx::kPqC2 - fx::kPqC3 * p), fx::kPqInvM1);
+		}
+		case FITF_LINEAR_TO_PQ:
+		{
+			const float p = FastPow(Clamp01(v), fx::kPqM1);
+			return FastPow((fx::kPqC1 + fx::kPqC2 * p) / (1.0f + fx::kPqC3 * p), fx::kPqM2);
+		}
+		case FITF_HLG_TO_LINEAR:
+		{
+			const float e = Clamp01(v);
+			return (e <= 0.5f) ? e * e * fx::kThird : (FastExp2((e - fx::kHlgC) * fx::kHlgExp2Scale) + fx::kHlgB) * fx::kTwelfth;
+		}
+		case FITF_LINEAR_TO_HLG:
+		{
+			const float e = Clamp01(v);
+			return (e <= fx::kTwelfth) ? std::sqrt(e * 3.0f) : fx::kHlgA * FastLog2(MAX(e * 12.0f - fx::kHlgB, FLT_MIN)) * fx::kLn2 + fx::kHlgC;
+		}
+		default:
+			return v;
+	}
+}
+
+void ApplyTransfer(float *data, unsigned count, unsigned channels, FREE_IMAGE_TRANSFER transfer) {
+	if ((unsigned)transfer >= kTransferCount) {
+		return;
+	}
+	// kernels process whole groups of 4 values, so that i % 4 is the channel of 4 channel pixels
+	unsigned i = (unsigned)gKernels.transfer[transfer].load(std::memory_order_relaxed)(data, (int)count, channels);
+	for (; i < count; i++) {
+		if ((channels != 4) || (i % 4 != 3)) {
+			data[i] = TransferFloat(data[i], transfer);
+		}
+	}
+}
+
+void Log2Floats(float *target, const float *source, unsigned count) {
+	unsigned i = (unsigned)gKernels.log2Floats.load(std::memory_order_relaxed)(target, source, (int)count);
+	for (; i < count; i++) {
+		target[i] = FastLog2(MAX(source[i], FLT_MIN));
+	}
+}
+
+void PowFloats(float *target, const float *source, unsigned count, float exponent) {
+	unsigned i = (unsigned)gKernels.powFloats.load(std::memory_order_relaxed)(target, source, (int)count, exponent);
+	for (; i < count; i++) {
+		target[i] = FastPow(source[i], exponent);
+	}
+}
+
+// ----------------------------------------------------------
+
+template <typename T>
+static void TransformYuv(const YuvKernel<T> kernel, T *target, const T *source, unsigned count, unsigned channels, const YuvTransform &transform) {
+	unsigned i = (unsigned)kernel(target, source, (int)count, transform);
+	for (; i < count; i++) {
+		const T *in = source + i * channels;
+		T *out = target + i * channels;
+		const int32_t x0 = in[0] - transform.input_offset[0];
+		const int32_t x1 = in[1] - transform.input_offset[1];
+		const int32_t x2 = in[2] - transform.input_offset[2];
+		for (unsigned j = 0; j < 3; j++) {
+			const int32_t y = ((transform.matrix[j][0] * x0 + transform.matrix[j][1] * x1 + transform.matrix[j][2] * x2 + (1 << 11)) >> 12) + transform.output_offset[j];
+			out[j] = static_cast<T>(std::clamp<int32_t>(y, 0, std::numeric_limits<T>::max()));
+		}
+		if (channels == 4) {
+			out[3] = in[3];
+		}
+	}
+}
+
+void TransformYuv(uint8_t *target, const uint8_t *source, unsigned count, unsigned channels, const YuvTransform &transform) {
+	TransformYuv((channels == 4 ? gKernels.yuv32 : gKernels.yuv24).load(std::memory_order_relaxed), target, source, count, channels, transform);
+}
+
+void TransformYuv(uint16_t *target, const uint16_t *source, unsigned count, unsigned channels, const YuvTransform &transform) {
+	TransformYuv((channels == 4 ? gKernels.yuv64 : gKernels.yuv48).load(std::memory_order_relaxed), target, source, count, channels, transform);
+}
+
+// ----------------------------------------------------------
+
+template <typename T>
+static void ConvertCMYKToRGBA(const CMYKKernel<T> kernel, T *data, unsigned count) {
+	constexpr unsigned max_val = std::numeric_limits<T>::max();
+	unsigned i = (unsigned)kernel(data, (int)count);
+	for (; i < count; i++) {
+		T *pixel = data + 4 * i;
+		const unsigned k = max_val - pixel[3];
+		const T r = (T)((max_val - pixel[0]) * k / max_val);
+		const T g = (T)((max_val - pixel[1]) * k / max_val);
+		const T b = (T)((max_val - pixel[2]) * k / max_val);
+		if constexpr (sizeof(T) == 1) {
+			pixel[FI_RGBA_RED] = r;
+			pixel[FI_RGBA_GREEN] = g;
+			pixel[FI_RGBA_BLUE] = b;
+		} else {
+			pixel[0] = r;
+			pixel[1] = g;
+			pixel[2] = b;
+		}
+		pixel[3] = (T)max_val;
+	}
+}
+
+void ConvertCMYKToRGBA(uint8_t *data, unsigned count) {
+	ConvertCMYKToRGBA(gKernels.cmyk32.load(std::memory_order_relaxed), data, count);
+}
+
+void ConvertCMYKToRGBA(uint16_t *data, unsigned count) {
+	ConvertCMYKToRGBA(gKernels.cmyk64.load(std::memory_order_relaxed), data, count);
+}
+
+// ----------------------------------------------------------
+
+void SwapRedBlue(uint8_t *data, unsigned count, unsigned bytespp) {
+	const SwapKernel kernel = (bytespp == 4) ? gKernels.swap32.load(std::memory_order_relaxed) : gKernels.swap24.load(std::memory_order_relaxed);
+	unsigned i = (unsigned)kernel(data, (int)count);
+	for (uint8_t *pixel = data + i * bytespp; i < count; i++, pixel += bytespp) {
+		INPLACESWAP(pixel[0], pixel[2]);
+	}
+}
+
+void InterleavePlanes(uint8_t *target, const uint8_t *const *planes, unsigned count, unsigned channels) {
+	const InterleaveKernel kernel = (channels == 4) ? gKernels.interleave32.load(std::memory_order_relaxed) : gKernels.interleave24.load(std::memory_order_relaxed);
+	unsigned i = (unsigned)kernel(target, planes, (int)count);
+	for (uint8_t *pixel = target + i * channels; i < count; i++, pixel += channels) {
+		for (unsigned k = 0; k < channels; k++) {
+			pixel[k] = planes[k][i];
+		}
+	}
+}
+
+void SwapBytes32(uint32_t *target, const uint32_t *source, unsigned count) {
+	unsigned i = (unsigned)gKernels.byteSwap32.load(std::memory_order_relaxed)(target, source, (int)count);
+	for (; i < count; i++) {
+		target[i] = __SwapUInt32(source[i]);
+	}
+}
@@ -0,0 +1,181 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_CONVERSION_SIMD_H_
+#define FREEIMAGE_CONVERSION_SIMD_H_
+
+#include "FreeImage.h"
+
+// ----------------------------------------------------------
+//  SIMD kernels of the FreeImage_ConvertLine* functions
+// ----------------------------------------------------------
+
+// Each kernel converts the longest beginning of a line it can process with vector instructions
+// supported by the running CPU and returns the number of converted pixels (0 if no kernel is available).
+// Remaining pixels are left to the scalar code of the calling FreeImage_ConvertLine* function.
+// Results are bit exact with the scalar code.
+
+int ConvertLine1To8_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels);
+int ConvertLine8To32_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels, const FIRGBA8 *palette);
+int ConvertLine16To32_555_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels);
+int ConvertLine16To32_565_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels);
+int ConvertLine24To32_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels);
+int ConvertLine32To24_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels);
+int ConvertLine16_555To565_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels);
+int ConvertLine16_565To555_SIMD(uint8_t *target, const uint8_t *source, int width_in_pixels);
+
+// ----------------------------------------------------------
+//  Half float conversions
+// ----------------------------------------------------------
+
+// Convert count values with the F16C or NEON kernels, the remaining values with HalfToFloat / FloatToHalf.
+// Results are bit exact between the kernels and the scalar code (floats are rounded to the nearest half, ties to even).
+
+void ConvertHalfToFloat(float *target, const uint16_t *source, unsigned count);
+void ConvertFloatToHalf(uint16_t *target, const float *source, unsigned count);
+
+// ----------------------------------------------------------
+//  RGBE conversions
+// ----------------------------------------------------------
+
+// Convert count pixels with the SSE2 or NEON kernels, the remaining pixels with RGBEToFloat / FloatToRGBE.
+// Exponents are handled with bit manipulations instead of ldexp / frexp, results are bit exact with the scalar code
+// for finite values.
+
+void ConvertRGBEToFloat(FIRGBF *target, const uint8_t *source, unsigned count);
+void ConvertFloatToRGBE(uint8_t *target, const FIRGBF *source, unsigned count);
+
+// ----------------------------------------------------------
+//  3x3 float transforms
+// ----------------------------------------------------------
+
+// Transforms count pixels of 3 floats (e.g. RGB <-> XYZ) with the SSE2 or NEON kernels, the remaining pixels with
+// the scalar code: target[j] = matrix[j][0] * source[0] + matrix[j][1] * source[1] + matrix[j][2] * source[2].
+// Products are summed in the same order by the kernels and the scalar code, results are bit exact.
+// target may be source.
+
+void TransformFloat3(float *target, const float *source, unsigned count, const float (&matrix)[3][3]);
+
+// ----------------------------------------------------------
+//  Greyscale type conversions
+// ----------------------------------------------------------
+
+// Convert count values with the SSE2 or NEON kernels, the remaining values with the scalar code.
+// Results are bit exact with the scalar code for finite values.
+
+// target = static_cast<float>(source) / divisor
+void ConvertToFloat(float *target, const uint8_t *source, unsigned count, float divisor);
+void ConvertToFloat(float *target, const uint16_t *source, unsigned count, float divisor);
+void ConvertToFloat(float *target, const int16_t *source, unsigned count, float divisor);
+
+// Lowers min and raises max to the extrema of the count values, NaNs are skipped
+void UpdateMinMax(const uint16_t *source, unsigned count, uint16_t &min, uint16_t &max);
+void UpdateMinMax(const int16_t *source, unsigned count, int16_t &min, int16_t &max);
+void UpdateMinMax(const float *source, unsigned count, float &min, float &max);
+
+// target = (uint8_t)(scale * (source - min) + 0.5), the linear scaling of FreeImage_ConvertToStandardType
+void ScaleToByte(uint8_t *target, const uint16_t *source, unsigned count, uint16_t min, double scale);
+void ScaleToByte(uint8_t *target, const int16_t *source, unsigned count, int16_t min, double scale);
+void ScaleToByte(uint8_t *target, const float *source, unsigned count, float min, double scale);
+
+// target = MIN(255, MAX(0, int(source + 0.5))), the rounding of FreeImage_ConvertToStandardType
+void RoundToByte(uint8_t *target, const float *source, unsigned count);
+
+// ----------------------------------------------------------
+//  Lookup table float conversions
+// ----------------------------------------------------------
+
+// Tables of 256 (8-bit) or 65536 (16-bit) entries mapping a sample to [0..1], built on first use.
+// Linear tables hold static_cast<float>(v) / max, bit exact with the scalar conversions,
+// sRGB tables decode the sRGB transfer function to linear light.
+
+const float* GetByteToFloatTable(bool srgb);
+const float* GetWordToFloatTable(bool srgb);
+
+// Converts count pixels of source_channels samples into pixels of target_channels (3 or 4) floats.
+// Target channel c reads the source sample order[c] through table; with 4 target channels the alpha sample
+// order[3] reads alpha_table, or is set to 1 when order[3] >= source_channels.
+
+void LookupToFloat(float *target, unsigned target_channels, const uint8_t *source, unsigned source_channels,
+	const unsigned order[4], unsigned count, const float *table, const float *alpha_table);
+void LookupToFloat(float *target, unsigned target_channels, const uint16_t *source, unsigned source_channels,
+	const unsigned order[4], unsigned count, const float *table, const float *alpha_table);
+
+// ----------------------------------------------------------
+//  Transfer functions
+// ----------------------------------------------------------
+
+// Applies a transfer function in place to count values of pixels with channels (1, 3 or 4) floats, the fourth channel
+// (alpha) is kept. pow, exp and log are approximated by polynomials with relative errors below 2e-7, kernels and scalar
+// code run the same operations but may differ by a few ulps where the compiler fuses multiply-adds.
+
+void ApplyTransfer(float *data, unsigned count, unsigned channels, FREE_IMAGE_TRANSFER transfer);
+
+// Elementary functions of count values with the same polynomials, target may be source.
+// NaNs and infinities are not handled.
+
+// target = log2(MAX(source, FLT_MIN))
+void Log2Floats(float *target, const float *source, unsigned count);
+// target = source^exponent, 0 for source <= 0
+void PowFloats(float *target, const float *source, unsigned count, float exponent);
+
+// ----------------------------------------------------------
+//  YUV transforms
+// ----------------------------------------------------------
+
+/**
+Fixed point 3x3 transform between RGB and YUV samples, with 12 fractional bits.
+Channels are indexed in memory order: output channel j is
+clamp(((sum of matrix[j][i] * (in[i] - input_offset[i]) + 2048) >> 12) + output_offset[j]).
+*/
+struct YuvTransform {
+	int32_t matrix[3][3];
+	int32_t input_offset[3];
+	int32_t output_offset[3];
+};
+
+// Transform count pixels of 3 or 4 channels with the AVX2 or NEON kernels, the remaining pixels with the scalar code.
+// A fourth (alpha) channel is copied. target and source must not overlap.
+
+void TransformYuv(uint8_t *target, const uint8_t *source, unsigned count, unsigned channels, const YuvTransform &transform);
+void TransformYuv(uint16_t *target, const uint16_t *source, unsigned count, unsigned channels, const YuvTransform &transform);
+
+// ----------------------------------------------------------
+//  CMYK conversions
+// ----------------------------------------------------------
+
+// Convert count pixels of 4 samples in place from CMYK to RGBA with the SSE2 or NEON kernels, the remaining pixels
+// with the scalar code. R, G, B = (MAX - C, M, Y) * (MAX - K) / MAX truncated, alpha is set to MAX; 8-bit pixels are
+// written in FI_RGBA order, 16-bit pixels as RGBA. Results are bit exact between the kernels and the scalar code.
+
+void ConvertCMYKToRGBA(uint8_t *data, unsigned count);
+void ConvertCMYKToRGBA(uint16_t *data, unsigned count);
+
+// ----------------------------------------------------------
+//  Channel swaps
+// ----------------------------------------------------------
+
+// Swaps the first and third bytes of count pixels of bytespp (3 or 4) bytes in place with the SSSE3 or NEON kernels,
+// the remaining pixels with the scalar code. Converts BGR(A) to RGB(A) and back.
+
+void SwapRedBlue(uint8_t *data, unsigned count, unsigned bytespp);
+
+// Interleaves count bytes of each of the channels (3 or 4) planes into count pixels of channels bytes,
+// planes[k] giving byte k of the pixels, with the SSE2 / SSSE3 or NEON kernels, the remaining pixels with the scalar code.
+// A plane may be given for several bytes (e.g. greyscale to RGB).
+
+void InterleavePlanes(uint8_t *target, const uint8_t *const *planes, unsigned count, unsigned channels);
+
+// ----------------------------------------------------------
+//  Byte order
+// ----------------------------------------------------------
+
+// Reverses the byte order of count 32-bit words from source into target (which may be source) with the SSE2 / SSSE3
+// or NEON kernels, the remaining words with the scalar code. Converts big endian floats and integers to little endian and back.
+
+void SwapBytes32(uint32_t *target, const uint32_t *source, unsigned count);
+
+#endif // FREEIMAGE_CONVERSION_SIMD_H_
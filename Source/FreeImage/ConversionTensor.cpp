@@ -0,0 +1,252 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "ConversionSIMD.h"
+
+#include <type_traits>
+#include <vector>
+
+
+namespace {
+
+	/**
+	Layout of the samples of the images read directly by FreeImage_ExportTensor
+	*/
+	struct SampleLayout
+	{
+		FREE_IMAGE_TYPE sample_type{ FIT_UNKNOWN };	// FIT_BITMAP for bytes, FIT_UINT16 or FIT_FLOAT
+		unsigned channels{ 0 };						// samples per pixel
+		unsigned index[4]{};						// sample of red, green, blue and alpha, channels if missing
+	};
+
+	bool GetSampleLayout(FIBITMAP *dib, SampleLayout &layout) {
+		switch (FreeImage_GetImageType(dib)) {
+			case FIT_BITMAP:
+				switch (FreeImage_GetBPP(dib)) {
+					case 8:
+						if (FreeImage_GetColorType(dib) != FIC_MINISBLACK) {
+							return false;
+						}
+						layout = { FIT_BITMAP, 1, { 0, 0, 0, 1 } };
+						return true;
+					case 24:
+						layout = { FIT_BITMAP, 3, { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, 3 } };
+						return true;
+					case 32:
+						layout = { FIT_BITMAP, 4, { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA } };
+						return true;
+					default:
+						return false;
+				}
+			case FIT_UINT16:
+				layout = { FIT_UINT16, 1, { 0, 0, 0, 1 } };
+				return true;
+			case FIT_RGB16:
+				layout = { FIT_UINT16, 3, { 0, 1, 2, 3 } };
+				return true;
+			case FIT_RGBA16:
+				layout = { FIT_UINT16, 4, { 0, 1, 2, 3 } };
+				return true;
+			case FIT_FLOAT:
+				layout = { FIT_FLOAT, 1, { 0, 0, 0, 1 } };
+				return true;
+			case FIT_RGBF:
+				layout = { FIT_FLOAT, 3, { 0, 1, 2, 3 } };
+				return true;
+			case FIT_RGBAF:
+				layout = { FIT_FLOAT, 4, { 0, 1, 2, 3 } };
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	/**
+	Reads width pixels of src into channels interleaved floats in [0, 1], tensor channel c reading the sample order[c].
+	Missing samples (order[c] >= source_channels) read 1.
+	*/
+	template <typename T>
+	void DecodeRow(float *target, unsigned channels, const T *src, unsigned source_channels, const unsigned order[4], unsigned width, const float *table) {
+		if constexpr (!std::is_same_v<T, float>) {
+			if ((channels >= 3) && (order[0] < source_channels) && (order[1] < source_channels) && (order[2] < source_channels)) {
+				// lookup kernels, alpha is the only sample which may be missing
+				LookupToFloat(target, channels, src, source_channels, order, width, table, table);
+				return;
+			}
+		}
+		for (unsigned x = 0; x < width; x++, src += source_channels, target += channels) {
+			for (unsigned c = 0; c < channels; c++) {
+				if (order[c] >= source_channels) {
+					target[c] = 1.0f;
+				} else if constexpr (std::is_same_v<T, float>) {
+					target[c] = src[order[c]];
+				} else {
+					target[c] = table[src[order[c]]];
+				}
+			}
+		}
+	}
+
+	/// data = data * a[c] + b[c] for the channels interleaved floats of count pixels
+	template <unsigned Channels_>
+	void NormalizePixels(float *data, unsigned count, const float a[4], const float b[4]) {
+		for (unsigned x = 0; x < count; x++, data += Channels_) {
+			for (unsigned c = 0; c < Channels_; c++) {
+				data[c] = data[c] * a[c] + b[c];
+			}
+		}
+	}
+
+	void NormalizePixels(float *data, unsigned channels, unsigned count, const float a[4], const float b[4]) {
+		switch (channels) {
+			case 1: NormalizePixels<1>(data, count, a, b); break;
+			case 2: NormalizePixels<2>(data, count, a, b); break;
+			case 3: NormalizePixels<3>(data, count, a, b); break;
+			default: NormalizePixels<4>(data, count, a, b); break;
+		}
+	}
+
+	/// Stores count normalized floats as tensor elements
+	void StoreElements(void *target, const float *source, unsigned count, FREE_IMAGE_TENSOR_TYPE type) {
+		switch (type) {
+			case FITT_UINT8:
+				RoundToByte(static_cast<uint8_t *>(target), source, count);
+				break;
+			case FITT_HALF:
+				ConvertFloatToHalf(static_cast<uint16_t *>(target), source, count);
+				break;
+			default:
+				if (target != source) {
+					memcpy(target, source, count * sizeof(float));
+				}
+				break;
+		}
+	}
+
+	size_t GetElementSize(FREE_IMAGE_TENSOR_TYPE type) {
+		switch (type) {
+			case FITT_UINT8:
+				return 1;
+			case FITT_HALF:
+				return 2;
+			case FITT_FLOAT:
+				return 4;
+			default:
+				return 0;
+		}
+	}
+
+} // namespace
+
+FIBOOL DLL_CALLCONV
+FreeImage_ExportTensor(FIBITMAP *dib, const FITENSORDESC *desc, void *dst) {
+	if (!FreeImage_HasPixels(dib) || !desc || !dst) {
+		return FALSE;
+	}
+	const size_t element_size = GetElementSize(desc->type);
+	const unsigned channels = desc->channels;
+	if (!element_size || (channels < 1) || (channels > 4) || ((desc->layout != FITL_CHW) && (desc->layout != FITL_HWC))) {
+		return FALSE;
+	}
+	for (unsigned c = 0; c < channels; c++) {
+		if (desc->order[c] > 3) {
+			return FALSE;
+		}
+	}
+
+	const unsigned width = desc->width ? desc->width : FreeImage_GetWidth(dib);
+	const unsigned height = desc->height ? desc->height : FreeImage_GetHeight(dib);
+
+	// a rescaled image has the size of the tensor, it is the only intermediate of sources read directly
+	FIBITMAP *src = dib;
+	FIBITMAP *rescaled = nullptr;
+	FIBITMAP *converted = nullptr;
+	if ((width != FreeImage_GetWidth(dib)) || (height != FreeImage_GetHeight(dib))) {
+		rescaled = FreeImage_RescaleRect(dib, width, height, 0, 0, FreeImage_GetWidth(dib), FreeImage_GetHeight(dib), desc->filter, FI_RESCALE_OMIT_METADATA);
+		if (!rescaled) {
+			return FALSE;
+		}
+		src = rescaled;
+	}
+	SampleLayout layout;
+	if (!GetSampleLayout(src, layout)) {
+		// palettized, 1, 4 and 16-bit images and the other types go through floats
+		const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType(src);
+		const bool alpha = FreeImage_IsTransparent(src) || (src_type == FIT_RGBAH) || (src_type == FIT_RGBA32);
+		converted = alpha ? FreeImage_ConvertToRGBAF(src) : FreeImage_ConvertToRGBF(src);
+		if (!converted || !GetSampleLayout(converted, layout)) {
+			FreeImage_Unload(converted);
+			FreeImage_Unload(rescaled);
+			return FALSE;
+		}
+		src = converted;
+	}
+
+	// tensor channel c is sample[order[c]] * a[c] + b[c], bytes are stored as 255 * value
+	const float range = (desc->type == FITT_UINT8) ? 255.0f : 1.0f;
+	unsigned order[4] = { 0, 0, 0, 0 };
+	float a[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	float b[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (unsigned c = 0; c < channels; c++) {
+		order[c] = layout.index[desc->order[c]];
+		a[c] = desc->scale[c] * range;
+		b[c] = -desc->mean[c] * desc->scale[c] * range;
+	}
+	const float *table = nullptr;
+	if (layout.sample_type == FIT_BITMAP) {
+		table = GetByteToFloatTable(false);
+	} else if (layout.sample_type == FIT_UINT16) {
+		table = GetWordToFloatTable(false);
+	}
+
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	const uint8_t *src_bits = FreeImage_GetConstBits(src);
+	uint8_t *dst_bits = static_cast<uint8_t *>(dst);
+	const size_t plane_size = (size_t)width * height * element_size;
+	const size_t row_size = (size_t)width * channels * element_size;
+	const bool planar = (desc->layout == FITL_CHW);
+
+	ParallelFor(0, height, CalculateBandRows((size_t)width * channels * sizeof(float)), [&](unsigned first, unsigned last) {
+		std::vector<float> pixels((size_t)width * channels);
+		std::vector<float> plane(planar ? width : 0);
+		for (unsigned y = first; y < last; y++) {
+			// tensors are stored top-down
+			const uint8_t *src_line = src_bits + (size_t)src_pitch * (height - 1 - y);
+			// interleaved floats are decoded in place
+			float *target = (!planar && (desc->type == FITT_FLOAT)) ? reinterpret_cast<float *>(dst_bits + row_size * y) : pixels.data();
+			switch (layout.sample_type) {
+				case FIT_BITMAP:
+					DecodeRow(target, channels, src_line, layout.channels, order, width, table);
+					break;
+				case FIT_UINT16:
+					DecodeRow(target, channels, reinterpret_cast<const uint16_t *>(src_line), layout.channels, order, width, table);
+					break;
+				default:
+					DecodeRow(target, channels, reinterpret_cast<const float *>(src_line), layout.channels, order, width, table);
+					break;
+			}
+			NormalizePixels(target, channels, width, a, b);
+
+			if (!planar) {
+				StoreElements(dst_bits + row_size * y, target, width * channels, desc->type);
+				continue;
+			}
+			for (unsigned c = 0; c < channels; c++) {
+				for (unsigned x = 0; x < width; x++) {
+					plane[x] = target[(size_t)x * channels + c];
+				}
+				StoreElements(dst_bits + plane_size * c + (size_t)width * element_size * y, plane.data(), width, desc->type);
+			}
+		}
+	});
+
+	FreeImage_Unload(converted);
+	FreeImage_Unload(rescaled);
+
+	return TRUE;
+}
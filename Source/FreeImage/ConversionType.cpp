@@ -22,6 +22,54 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
+#include "ConversionSIMD.h"
+#include <mutex>
+
+// ----------------------------------------------------------
+
+// Line helpers of the templates below, overloaded for the types having SIMD kernels
+
+template<class Tdst, class Tsrc> static void
+ConvertTypeLine(Tdst *dst_bits, const Tsrc *src_bits, unsigned width) {
+	for (unsigned x = 0; x < width; x++) {
+		dst_bits[x] = static_cast<Tdst>(src_bits[x]);
+	}
+}
+
+static void
+ConvertTypeLine(float *dst_bits, const uint16_t *src_bits, unsigned width) {
+	ConvertToFloat(dst_bits, src_bits, width, 1.0F);
+}
+
+static void
+ConvertTypeLine(float *dst_bits, const int16_t *src_bits, unsigned width) {
+	ConvertToFloat(dst_bits, src_bits, width, 1.0F);
+}
+
+template<class Tsrc> static void
+UpdateMinMax(const Tsrc *bits, unsigned width, Tsrc& min, Tsrc& max) {
+	Tsrc l_min, l_max;
+	MAXMIN(bits, width, l_max, l_min);
+	if (l_max > max) max = l_max;
+	if (l_min < min) min = l_min;
+}
+
+template<class Tsrc> static void
+ScaleToByte(uint8_t *dst_bits, const Tsrc *src_bits, unsigned width, Tsrc min, double scale) {
+	for (unsigned x = 0; x < width; x++) {
+		dst_bits[x] = (uint8_t)( scale * (src_bits[x] - min) + 0.5);
+	}
+}
+
+template<class Tsrc> static void
+RoundToByte(uint8_t *dst_bits, const Tsrc *src_bits, unsigned width) {
+	for (unsigned x = 0; x < width; x++) {
+		// rounding
+		int q = int(src_bits[x] + 0.5);
+		dst_bits[x] = (uint8_t) MIN(255, MAX(0, q));
+	}
+}
 
 // ----------------------------------------------------------
 
@@ -52,14 +100,9 @@ CONVERT_TYPE<Tdst, Tsrc>::convert(FIBITMAP *src, FREE_IMAGE_TYPE dst_type) {
 
 	// convert from src_type to dst_type
 	
-	for (unsigned y = 0; y < height; y++) {
-		const Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-		Tdst *dst_bits = reinterpret_cast<Tdst*>(FreeImage_GetScanLine(dst, y));
-
-		for (unsigned x = 0; x < width; x++) {
-			*dst_bits++ = static_cast<Tdst>(*src_bits++);
-		}
-	}
+	ConvertScanLines(dst, src, [width](uint8_t *dst_line, uint8_t *src_line) {
+		ConvertTypeLine(reinterpret_cast<Tdst*>(dst_line), reinterpret_cast<const Tsrc*>(src_line), width);
+	});
 
 	return dst;
 }
@@ -79,7 +122,6 @@ public:
 template<class Tsrc> FIBITMAP* 
 CONVERT_TO_BYTE<Tsrc>::convert(FIBITMAP *src, FIBOOL scale_linear) {
 	FIBITMAP *dst{};
-	unsigned x, y;
 
 	const unsigned width	= FreeImage_GetWidth(src);
 	const unsigned height = FreeImage_GetHeight(src);
@@ -103,15 +145,21 @@ CONVERT_TO_BYTE<Tsrc>::convert(FIBITMAP *src, FIBOOL scale_linear) {
 		Tsrc max, min;
 		double scale;
 
-		// find the min and max value of the image
-		Tsrc l_min, l_max;
+		// find the min and max value of the image, each band of scanlines is scanned
+		// in parallel and merged into the image extrema
 		min = 255, max = 0;
-		for (y = 0; y < height; y++) {
-			Tsrc *bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-			MAXMIN(bits, width, l_max, l_min);
+		std::mutex merge_mutex;
+		const unsigned pitch = FreeImage_GetPitch(src);
+		const uint8_t *src_bits = FreeImage_GetConstBits(src);
+		ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(src)), [&](unsigned first, unsigned last) {
+			Tsrc l_min = 255, l_max = 0;
+			for (unsigned y = first; y < last; y++) {
+				UpdateMinMax(reinterpret_cast<const Tsrc*>(src_bits + (size_t)pitch * y), width, l_min, l_max);
+			}
+			std::lock_guard<std::mutex> lock(merge_mutex);
 			if (l_max > max) max = l_max;
 			if (l_min < min) min = l_min;
-		}
+		});
 		if (max == min) {
 			max = 255; min = 0;
 		}
@@ -120,23 +168,13 @@ CONVERT_TO_BYTE<Tsrc>::convert(FIBITMAP *src, FIBOOL scale_linear) {
 		scale = 255 / (double)(max - min);
 
 		// scale to 8-bit
-		for (y = 0; y < height; y++) {
-			Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-			uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
-			for (x = 0; x < width; x++) {
-				dst_bits[x] = (uint8_t)( scale * (src_bits[x] - min) + 0.5);
-			}
-		}
+		ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+			ScaleToByte(dst_line, reinterpret_cast<const Tsrc*>(src_line), width, min, scale);
+		});
 	} else {
-		for (y = 0; y < height; y++) {
-			Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-			uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
-			for (x = 0; x < width; x++) {
-				// rounding
-				int q = int(src_bits[x] + 0.5);
-				dst_bits[x] = (uint8_t) MIN(255, MAX(0, q));
-			}
-		}
+		ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+			RoundToByte(dst_line, reinterpret_cast<const Tsrc*>(src_line), width);
+		});
 	}
 
 	return dst;
@@ -235,6 +273,7 @@ For complex images, the magnitude is extracted as a double image, then converted
 */
 FIBITMAP* DLL_CALLCONV
 FreeImage_ConvertToStandardType(FIBITMAP *src, FIBOOL scale_linear) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToStandardType");
 	FIBITMAP *dst{};
 
 	if (!src) return nullptr;
@@ -285,6 +324,8 @@ FreeImage_ConvertToStandardType(FIBITMAP *src, FIBOOL scale_linear) {
 			break;
 		case FIT_RGBAF:		// 128-bit RGBA float image: 4 x 32-bit IEEE floating point
 			break;
+		case FIT_RGBAH:		// 64-bit RGBA half float image: 4 x 16-bit IEEE half floating point
+			break;
 	}
 
 	if (!dst) {
@@ -305,6 +346,7 @@ FreeImage_ConvertToStandardType(FIBITMAP *src, FIBOOL scale_linear) {
 
 FIBITMAP* DLL_CALLCONV
 FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_linear) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToType");
 	FIBITMAP *dst{};
 
 	if (!FreeImage_HasPixels(src)) return nullptr;
@@ -355,6 +397,9 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGBAH:
+					dst = FreeImage_ConvertToRGBAH(src);
+					break;
 			}
 			break;
 		case FIT_UINT16:
@@ -389,6 +434,9 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGBAH:
+					dst = FreeImage_ConvertToRGBAH(src);
+					break;
 			}
 			break;
 		case FIT_INT16:
@@ -419,6 +467,8 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 					break;
 				case FIT_RGBAF:
 					break;
+				case FIT_RGBAH:
+					break;
 			}
 			break;
 		case FIT_UINT32:
@@ -449,6 +499,8 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 					break;
 				case FIT_RGBAF:
 					break;
+				case FIT_RGBAH:
+					break;
 			}
 			break;
 		case FIT_INT32:
@@ -479,6 +531,8 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 					break;
 				case FIT_RGBAF:
 					break;
+				case FIT_RGBAH:
+					break;
 			}
 			break;
 		case FIT_FLOAT:
@@ -510,6 +564,9 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGBAH:
+					dst = FreeImage_ConvertToRGBAH(src);
+					break;
 			}
 			break;
 		case FIT_DOUBLE:
@@ -538,6 +595,8 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 					break;
 				case FIT_RGBAF:
 					break;
+				case FIT_RGBAH:
+					break;
 			}
 			break;
 		case FIT_COMPLEX:
@@ -564,6 +623,8 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 					break;
 				case FIT_RGBAF:
 					break;
+				case FIT_RGBAH:
+					break;
 			}
 			break;
 		case FIT_RGB16:
@@ -596,6 +657,9 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGBAH:
+					dst = FreeImage_ConvertToRGBAH(src);
+					break;
 			}
 			break;
 		case FIT_RGBA16:
@@ -628,6 +692,9 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGBAH:
+					dst = FreeImage_ConvertToRGBAH(src);
+					break;
 			}
 			break;
 		case FIT_RGBF:
@@ -656,6 +723,9 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGBAH:
+					dst = FreeImage_ConvertToRGBAH(src);
+					break;
 			}
 			break;
 		case FIT_RGBAF:
@@ -684,6 +754,24 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 				case FIT_RGBF:
 					dst = FreeImage_ConvertToRGBF(src);
 					break;
+				case FIT_RGBAH:
+					dst = FreeImage_ConvertToRGBAH(src);
+					break;
+			}
+			break;
+		case FIT_RGBAH:
+			switch (dst_type) {
+				case FIT_FLOAT:
+					dst = FreeImage_ConvertToFloat(src);
+					break;
+				case FIT_RGBF:
+					dst = FreeImage_ConvertToRGBF(src);
+					break;
+				case FIT_RGBAF:
+					dst = FreeImage_ConvertToRGBAF(src);
+					break;
+				default:
+					break;
 			}
 			break;
 	}
@@ -21,6 +21,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Trace.h"
 
 // ----------------------------------------------------------
 //   smart convert X to UINT16
@@ -28,6 +29,7 @@
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_ConvertToUINT16(FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eConvert, "FreeImage_ConvertToUINT16");
 	FIBITMAP *src{};
 	FIBITMAP *dst{};
 
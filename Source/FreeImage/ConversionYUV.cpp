@@ -8,7 +8,10 @@
 #include "ConversionYUV.h"
 
 #include <memory>
+#include <vector>
 #include "SimpleTools.h"
+#include "ConversionSIMD.h"
+#include "Utilities.h"
 
 
 namespace {
@@ -31,33 +34,127 @@ namespace {
 		}
 	};
 
+	/**
+	 * Calls func with a YuvStandard instance selected by standard_version, returns false for unknown standards
+	 */
+	template <typename Function_>
+	bool WithYuvStandard(int64_t standard_version, Function_ func)
+	{
+		switch (standard_version) {
+		case FICPARAM_YUV_STANDARD_JPEG:
+			func(YuvJPEG{});
+			return true;
+		case FICPARAM_YUV_STANDARD_BT601:
+			func(YuvBT601{});
+			return true;
+		case FICPARAM_YUV_STANDARD_BT709:
+			func(YuvBT709{});
+			return true;
+		case FICPARAM_YUV_STANDARD_BT2020:
+			func(YuvBT2020{});
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	/**
+	 * Builds the fixed point transform of the integer conversions of YuvStandard_, the same coefficients as its R, G, B and Y, U, V functions.
+	 * red, green and blue are the memory indexes of the FIRGB* members holding R, G, B (or Y, U, V).
+	 */
+	template <typename YuvStandard_, typename Ty_>
+	YuvTransform MakeYuvTransform(bool to_yuv, unsigned red, unsigned green, unsigned blue)
+	{
+		using Coefficients = typename YuvStandard_::Coefficients;
+		int32_t matrix[3][3]{};
+		int32_t input_offset[3]{};
+		int32_t output_offset[3]{};
+		if (to_yuv) {
+			const double luma[3] = { Coefficients::kYR, Coefficients::kYG, Coefficients::kYB };
+			const double u[3] = { Coefficients::kUR, Coefficients::kUG, Coefficients::kUB };
+			const double v[3] = { Coefficients::kVR, Coefficients::kVG, Coefficients::kVB };
+			for (unsigned i = 0; i < 3; i++) {
+				matrix[0][i] = YuvStandard_::template FxLuma<Ty_>(luma[i]);
+				matrix[1][i] = YuvStandard_::template FxChroma<Ty_>(u[i]);
+				matrix[2][i] = YuvStandard_::template FxChroma<Ty_>(v[i]);
+			}
+			output_offset[0] = YuvStandard_::template MakeLumaOffset<Ty_>();
+			output_offset[1] = output_offset[2] = YuvStandard_::template MakeChromaOffset<Ty_>();
+		}
+		else {
+			const int32_t luma = YuvStandard_::template FxInvLuma<Ty_>(1.0);
+			matrix[0][0] = matrix[1][0] = matrix[2][0] = luma;
+			matrix[0][2] = YuvStandard_::template FxInvChroma<Ty_>(Coefficients::kRV);
+			matrix[1][1] = YuvStandard_::template FxInvChroma<Ty_>(Coefficients::kGU);
+			matrix[1][2] = YuvStandard_::template FxInvChroma<Ty_>(Coefficients::kGV);
+			matrix[2][1] = YuvStandard_::template FxInvChroma<Ty_>(Coefficients::kBU);
+			input_offset[0] = YuvStandard_::template MakeLumaOffset<Ty_>();
+			input_offset[1] = input_offset[2] = YuvStandard_::template MakeChromaOffset<Ty_>();
+		}
+
+		// reorder channels to memory order
+		const unsigned index[3] = { red, green, blue };
+		YuvTransform transform{};
+		for (unsigned j = 0; j < 3; j++) {
+			for (unsigned i = 0; i < 3; i++) {
+				transform.matrix[index[j]][index[i]] = matrix[j][i];
+			}
+			transform.input_offset[index[j]] = input_offset[j];
+			transform.output_offset[index[j]] = output_offset[j];
+		}
+		return transform;
+	}
+
+	template <typename YuvStandard_>
+	YuvTransform MakeBitmapYuvTransform(bool to_yuv)
+	{
+		return MakeYuvTransform<YuvStandard_, uint8_t>(to_yuv, FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE);
+	}
+
+	template <typename Ty_>
+	void TransformBitmap(FIBITMAP* dst, FIBITMAP* src, unsigned channels, const YuvTransform& transform)
+	{
+		const unsigned width = FreeImage_GetWidth(src);
+		ConvertScanLines(dst, src, [&](uint8_t* dst_line, uint8_t* src_line) {
+			TransformYuv(reinterpret_cast<Ty_*>(dst_line), reinterpret_cast<const Ty_*>(src_line), width, channels, transform);
+		});
+	}
+
 } // namespace
 
-template <typename Converter_>
-static std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> ConvertImpl(FIBITMAP* src, Converter_ cvt)
+template <typename YuvStandard_, bool ToYuv_>
+static std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> ConvertImpl(FIBITMAP* src)
 {
+	using Converter = std::conditional_t<ToYuv_, RgbToYuvConverter<YuvStandard_>, YuvToRgbConverter<YuvStandard_>>;
+
 	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst{
 		FreeImage_AllocateT(FreeImage_GetImageType(src), FreeImage_GetWidth(src), FreeImage_GetHeight(src), FreeImage_GetBPP(src)), &::FreeImage_Unload };
+	if (!dst) {
+		return dst;
+	}
 
 	switch (FreeImage_GetImageType(src)) {
 	case FIT_BITMAP: {
 			const auto bpp = FreeImage_GetBPP(src);
-			if (bpp == 32) {
-				BitmapTransform<FIRGBA8>(dst.get(), src, cvt);
-			}
-			else if (bpp == 24) {
-				BitmapTransform<FIRGB8>(dst.get(), src, cvt);
+			if (bpp == 32 || bpp == 24) {
+				TransformBitmap<uint8_t>(dst.get(), src, bpp / 8, MakeBitmapYuvTransform<YuvStandard_>(ToYuv_));
 			}
 			else {
-				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>{ nullptr, & ::FreeImage_Unload };
+				return std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>{ nullptr, &::FreeImage_Unload };
 			}
 		}
 		break;
+	case FIT_RGB16:
+		TransformBitmap<uint16_t>(dst.get(), src, 3, MakeYuvTransform<YuvStandard_, uint16_t>(ToYuv_, 0, 1, 2));
+		break;
+	case FIT_RGBA16:
+		TransformBitmap<uint16_t>(dst.get(), src, 4, MakeYuvTransform<YuvStandard_, uint16_t>(ToYuv_, 0, 1, 2));
+		break;
 	case FIT_RGBF:
-		BitmapTransform<FIRGBF>(dst.get(), src, cvt);
+		BitmapTransform<FIRGBF>(dst.get(), src, Converter{});
 		break;
 	case FIT_RGBAF:
-		BitmapTransform<FIRGBAF>(dst.get(), src, cvt);
+		BitmapTransform<FIRGBAF>(dst.get(), src, Converter{});
 		break;
 	default:
 		// ToDo: Add all other types here...
@@ -71,11 +168,7 @@ FIBITMAP* ConvertRgbToYuv(FIBITMAP* dib, int64_t standard_version)
 {
 	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> result{ nullptr,  &::FreeImage_Unload };
 
-	switch (standard_version) {
-	case FICPARAM_YUV_STANDARD_JPEG:
-		result = ConvertImpl(dib, RgbToYuvConverter<YuvJPEG>{});
-		break;
-	default:
+	if (!WithYuvStandard(standard_version, [&](auto standard) { result = ConvertImpl<decltype(standard), true>(dib); })) {
 		return nullptr;
 	}
 
@@ -92,13 +185,86 @@ FIBITMAP* ConvertYuvToRgb(FIBITMAP* dib, int64_t standard_version)
 {
 	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> result{ nullptr,  &::FreeImage_Unload };
 
-	switch (standard_version) {
-	case FICPARAM_YUV_STANDARD_JPEG:
-		result = ConvertImpl(dib, YuvToRgbConverter<YuvJPEG>{});
-		break;
-	default:
+	if (!WithYuvStandard(standard_version, [&](auto standard) { result = ConvertImpl<decltype(standard), false>(dib); })) {
 		return nullptr;
 	}
 
 	return result.release();
 }
+
+
+template <typename YuvStandard_>
+static void ConvertToPlanesImpl(FIBITMAP* dib, FREE_IMAGE_YUV_PLANES layout, uint8_t* const planes[3], const unsigned strides[3])
+{
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned channels = FreeImage_GetBPP(dib) / 8;
+	const unsigned chroma_width = (width + 1) / 2;
+	const YuvTransform transform = MakeBitmapYuvTransform<YuvStandard_>(true);
+
+	// planes are top-down, each chroma row is computed from a pair of rows
+	ParallelFor(0, (height + 1) / 2, CalculateBandRows(2 * FreeImage_GetLine(dib)), [&](unsigned first, unsigned last) {
+		std::vector<uint8_t> yuv(2 * width * channels);
+		for (unsigned pair = first; pair < last; ++pair) {
+			const unsigned rows = std::min(2u, height - 2 * pair);
+			for (unsigned r = 0; r < rows; ++r) {
+				const unsigned row = 2 * pair + r;
+				uint8_t* line = yuv.data() + r * width * channels;
+				TransformYuv(line, FreeImage_GetConstScanLine(dib, height - 1 - row), width, channels, transform);
+				uint8_t* luma = planes[0] + (size_t)strides[0] * row;
+				for (unsigned x = 0; x < width; ++x) {
+					luma[x] = line[x * channels + FI_RGBA_RED];
+				}
+			}
+
+			// average the chroma of each 2x2 block, blocks on odd edges average the available pixels
+			uint8_t* u_line = planes[1] + (size_t)strides[1] * pair;
+			uint8_t* v_line = (layout == FIYUV_I420) ? planes[2] + (size_t)strides[2] * pair : u_line + 1;
+			const unsigned step = (layout == FIYUV_I420) ? 1 : 2;
+			for (unsigned cx = 0; cx < chroma_width; ++cx) {
+				const unsigned cols = std::min(2u, width - 2 * cx);
+				const unsigned count = cols * rows;
+				unsigned u = count / 2, v = count / 2;
+				for (unsigned r = 0; r < rows; ++r) {
+					const uint8_t* pixel = yuv.data() + (r * width + 2 * cx) * channels;
+					for (unsigned c = 0; c < cols; ++c, pixel += channels) {
+						u += pixel[FI_RGBA_GREEN];
+						v += pixel[FI_RGBA_BLUE];
+					}
+				}
+				u_line[cx * step] = static_cast<uint8_t>(u / count);
+				v_line[cx * step] = static_cast<uint8_t>(v / count);
+			}
+		}
+	});
+}
+
+bool ConvertRgbToYuvPlanes(FIBITMAP* dib, FREE_IMAGE_YUV_PLANES layout, uint8_t* const planes[3], const unsigned strides[3], int64_t standard_version)
+{
+	if (!FreeImage_HasPixels(dib) || (FreeImage_GetImageType(dib) != FIT_BITMAP) || !planes || !strides) {
+		return false;
+	}
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	if ((bpp != 24) && (bpp != 32)) {
+		return false;
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned chroma_width = (width + 1) / 2;
+	switch (layout) {
+	case FIYUV_I420:
+		if (!planes[0] || !planes[1] || !planes[2] || (strides[0] < width) || (strides[1] < chroma_width) || (strides[2] < chroma_width)) {
+			return false;
+		}
+		break;
+	case FIYUV_NV12:
+		if (!planes[0] || !planes[1] || (strides[0] < width) || (strides[1] < 2 * chroma_width)) {
+			return false;
+		}
+		break;
+	default:
+		return false;
+	}
+
+	return WithYuvStandard(standard_version, [&](auto standard) { ConvertToPlanesImpl<decltype(standard)>(dib, layout, planes, strides); });
+}
@@ -18,10 +18,49 @@
 
 
 /**
- * Conversion according to JPEG sstandard, T-REC-T.871
+ * Full range coefficients of the JPEG standard, T-REC-T.871
  */
-struct YuvJPEG
+struct YuvCoefficientsJPEG
 {
+	static constexpr bool kStudioRange = false;
+
+	static constexpr double kYR = 0.299, kYG = 0.587, kYB = 0.114;
+	static constexpr double kUR = -0.168736, kUG = -0.331264, kUB = 0.5;
+	static constexpr double kVR = 0.5, kVG = -0.418688, kVB = -0.081312;
+
+	static constexpr double kRV = 1.402;
+	static constexpr double kGU = -0.344136, kGV = -0.714136;
+	static constexpr double kBU = 1.772;
+};
+
+/**
+ * Limited range ("studio swing") coefficients of the ITU-R recommendations,
+ * derived from the luma weights Kr and Kb given in 1/10000
+ */
+template <int32_t Kr_, int32_t Kb_>
+struct YuvCoefficientsITU
+{
+	static constexpr bool kStudioRange = true;
+
+	static constexpr double kYR = Kr_ / 10000.0, kYB = Kb_ / 10000.0, kYG = 1.0 - kYR - kYB;
+	static constexpr double kUR = -kYR / (2.0 * (1.0 - kYB)), kUG = -kYG / (2.0 * (1.0 - kYB)), kUB = 0.5;
+	static constexpr double kVR = 0.5, kVG = -kYG / (2.0 * (1.0 - kYR)), kVB = -kYB / (2.0 * (1.0 - kYR));
+
+	static constexpr double kRV = 2.0 * (1.0 - kYR);
+	static constexpr double kGU = -2.0 * kYB * (1.0 - kYB) / kYG, kGV = -2.0 * kYR * (1.0 - kYR) / kYG;
+	static constexpr double kBU = 2.0 * (1.0 - kYB);
+};
+
+
+/**
+ * YUV conversions with the coefficients of a standard.
+ * Studio range standards map Y to [16, 235] and U, V to [16, 240] (8-bit codes scaled to the sample depth, [16/255, 235/255] for floats).
+ */
+template <typename Coefficients_>
+struct YuvStandard
+{
+	using Coefficients = Coefficients_;
+
 	static constexpr uint32_t kDefaultFractionalBits = 12;
 
 	template <uint32_t Qb_>
@@ -50,6 +89,50 @@ struct YuvJPEG
 		return 0x1 << 15;
 	}
 
+	template <typename Ty_>
+	static constexpr int32_t MakeLumaOffset()
+	{
+		if constexpr (Coefficients_::kStudioRange) {
+			return 16 << (8 * sizeof(Ty_) - 8);
+		}
+		return 0;
+	}
+
+	template <typename FTy_>
+	static constexpr FTy_ FloatLumaOffset()
+	{
+		return static_cast<FTy_>(Coefficients_::kStudioRange ? 16.0 / 255.0 : 0.0);
+	}
+
+	/**
+	 * Range of Y (levels = 219) or U, V (levels = 224) relative to the full range of the sample type
+	 */
+	template <typename Ty_, uint32_t Levels_>
+	static constexpr double RangeScale()
+	{
+		if constexpr (!Coefficients_::kStudioRange) {
+			return 1.0;
+		}
+		else if constexpr (std::is_floating_point_v<Ty_>) {
+			return Levels_ / 255.0;
+		}
+		else {
+			return Levels_ * static_cast<double>(uint64_t(1) << (8 * sizeof(Ty_) - 8)) / std::numeric_limits<Ty_>::max();
+		}
+	}
+
+	template <typename Ty_>
+	static constexpr double LumaScale()
+	{
+		return RangeScale<Ty_, 219>();
+	}
+
+	template <typename Ty_>
+	static constexpr double ChromaScale()
+	{
+		return RangeScale<Ty_, 224>();
+	}
+
 
 	template <typename Ty_>
 	static constexpr Ty_ FxPointClamp(int32_t val)
@@ -64,84 +147,124 @@ struct YuvJPEG
 	}
 
 
+	// fixed point coefficients of the integer conversions
+
+	template <typename Ty_, uint32_t Qb_ = kDefaultFractionalBits>
+	static constexpr int32_t FxLuma(double k)
+	{
+		return MakeFxPoint<Qb_>(k * LumaScale<Ty_>());
+	}
+
+	template <typename Ty_, uint32_t Qb_ = kDefaultFractionalBits>
+	static constexpr int32_t FxChroma(double k)
+	{
+		return MakeFxPoint<Qb_>(k * ChromaScale<Ty_>());
+	}
+
+	template <typename Ty_, uint32_t Qb_ = kDefaultFractionalBits>
+	static constexpr int32_t FxInvLuma(double k)
+	{
+		return MakeFxPoint<Qb_>(k / LumaScale<Ty_>());
+	}
+
+	template <typename Ty_, uint32_t Qb_ = kDefaultFractionalBits>
+	static constexpr int32_t FxInvChroma(double k)
+	{
+		return MakeFxPoint<Qb_>(k / ChromaScale<Ty_>());
+	}
+
+
 	template <uint32_t Qb_ = kDefaultFractionalBits, typename Ty_>
 	static constexpr std::enable_if_t<!std::is_floating_point_v<Ty_>, Ty_> R(Ty_ y, Ty_ u, Ty_ v)
 	{
-		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(MakeFxPoint<Qb_>(y) + MakeFxPoint<Qb_>(1.402) * (v - MakeChromaOffset<Ty_>())));
+		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(FxInvLuma<Ty_, Qb_>(1.0) * (y - MakeLumaOffset<Ty_>()) + FxInvChroma<Ty_, Qb_>(Coefficients_::kRV) * (v - MakeChromaOffset<Ty_>())));
 	}
 
 	template <uint32_t Qb_ = kDefaultFractionalBits, typename Ty_>
 	static constexpr std::enable_if_t<!std::is_floating_point_v<Ty_>, Ty_> G(Ty_ y, Ty_ u, Ty_ v)
 	{
-		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(MakeFxPoint<Qb_>(y) - MakeFxPoint<Qb_>(0.344136) * (u - MakeChromaOffset<Ty_>()) - MakeFxPoint<Qb_>(0.714136) * (v - MakeChromaOffset<Ty_>())));
+		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(FxInvLuma<Ty_, Qb_>(1.0) * (y - MakeLumaOffset<Ty_>()) + FxInvChroma<Ty_, Qb_>(Coefficients_::kGU) * (u - MakeChromaOffset<Ty_>()) + FxInvChroma<Ty_, Qb_>(Coefficients_::kGV) * (v - MakeChromaOffset<Ty_>())));
 	}
 
 	template <uint32_t Qb_ = kDefaultFractionalBits, typename Ty_>
 	static constexpr std::enable_if_t<!std::is_floating_point_v<Ty_>, Ty_> B(Ty_ y, Ty_ u, Ty_ v)
 	{
-		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(MakeFxPoint<Qb_>(y) + MakeFxPoint<Qb_>(1.772) * (u - MakeChromaOffset<Ty_>())));
+		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(FxInvLuma<Ty_, Qb_>(1.0) * (y - MakeLumaOffset<Ty_>()) + FxInvChroma<Ty_, Qb_>(Coefficients_::kBU) * (u - MakeChromaOffset<Ty_>())));
 	}
 
 
 	template <uint32_t Qb_ = kDefaultFractionalBits, typename Ty_>
 	static constexpr std::enable_if_t<!std::is_floating_point_v<Ty_>, Ty_> Y(Ty_ r, Ty_ g, Ty_ b)
 	{
-		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(MakeFxPoint<Qb_>(0.114) * b + MakeFxPoint<Qb_>(0.587) * g + MakeFxPoint<Qb_>(0.299) * r));
+		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(FxLuma<Ty_, Qb_>(Coefficients_::kYB) * b + FxLuma<Ty_, Qb_>(Coefficients_::kYG) * g + FxLuma<Ty_, Qb_>(Coefficients_::kYR) * r) + MakeLumaOffset<Ty_>());
 	}
 
 	template <uint32_t Qb_ = kDefaultFractionalBits, typename Ty_>
 	static constexpr std::enable_if_t<!std::is_floating_point_v<Ty_>, Ty_> U(Ty_ r, Ty_ g, Ty_ b)
 	{
-		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(MakeFxPoint<Qb_>(0.5) * b - MakeFxPoint<Qb_>(0.331264) * g - MakeFxPoint<Qb_>(0.168736) * r) + MakeChromaOffset<Ty_>());
+		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(FxChroma<Ty_, Qb_>(Coefficients_::kUB) * b + FxChroma<Ty_, Qb_>(Coefficients_::kUG) * g + FxChroma<Ty_, Qb_>(Coefficients_::kUR) * r) + MakeChromaOffset<Ty_>());
 	}
 
 	template <uint32_t Qb_ = kDefaultFractionalBits, typename Ty_>
 	static constexpr std::enable_if_t<!std::is_floating_point_v<Ty_>, Ty_> V(Ty_ r, Ty_ g, Ty_ b)
 	{
-		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(MakeFxPoint<Qb_>(0.5) * r - MakeFxPoint<Qb_>(0.418688) * g - MakeFxPoint<Qb_>(0.081312) * b) + MakeChromaOffset<Ty_>());
+		return FxPointClamp<Ty_>(FxPointDivide<Qb_>(FxChroma<Ty_, Qb_>(Coefficients_::kVR) * r + FxChroma<Ty_, Qb_>(Coefficients_::kVG) * g + FxChroma<Ty_, Qb_>(Coefficients_::kVB) * b) + MakeChromaOffset<Ty_>());
 	}
 
 
 	template <typename FTy_>
 	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> R(FTy_ y, FTy_ u, FTy_ v)
 	{
-		return FloatClamp<FTy_>(y + static_cast<FTy_>(1.402) * (v - static_cast<FTy_>(0.5)));
+		return FloatClamp<FTy_>(static_cast<FTy_>(1.0 / LumaScale<FTy_>()) * (y - FloatLumaOffset<FTy_>()) + static_cast<FTy_>(Coefficients_::kRV / ChromaScale<FTy_>()) * (v - static_cast<FTy_>(0.5)));
 	}
 
 	template <typename FTy_>
 	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> G(FTy_ y, FTy_ u, FTy_ v)
 	{
-		return FloatClamp<FTy_>(y - static_cast<FTy_>(0.344136) * (u - static_cast<FTy_>(0.5)) - static_cast<FTy_>(0.714136) * (v - static_cast<FTy_>(0.5)));
+		return FloatClamp<FTy_>(static_cast<FTy_>(1.0 / LumaScale<FTy_>()) * (y - FloatLumaOffset<FTy_>()) + static_cast<FTy_>(Coefficients_::kGU / ChromaScale<FTy_>()) * (u - static_cast<FTy_>(0.5)) + static_cast<FTy_>(Coefficients_::kGV / ChromaScale<FTy_>()) * (v - static_cast<FTy_>(0.5)));
 	}
 
 	template <typename FTy_>
 	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> B(FTy_ y, FTy_ u, FTy_ v)
 	{
-		return FloatClamp<FTy_>(y + static_cast<FTy_>(1.772) * (u - static_cast<FTy_>(0.5)));
+		return FloatClamp<FTy_>(static_cast<FTy_>(1.0 / LumaScale<FTy_>()) * (y - FloatLumaOffset<FTy_>()) + static_cast<FTy_>(Coefficients_::kBU / ChromaScale<FTy_>()) * (u - static_cast<FTy_>(0.5)));
 	}
 
 
 	template <typename FTy_>
 	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> Y(FTy_ r, FTy_ g, FTy_ b)
 	{
-		return FloatClamp<FTy_>(static_cast<FTy_>(0.114) * b + static_cast<FTy_>(0.587) * g + static_cast<FTy_>(0.299) * r);
+		return FloatClamp<FTy_>(static_cast<FTy_>(Coefficients_::kYB * LumaScale<FTy_>()) * b + static_cast<FTy_>(Coefficients_::kYG * LumaScale<FTy_>()) * g + static_cast<FTy_>(Coefficients_::kYR * LumaScale<FTy_>()) * r + FloatLumaOffset<FTy_>());
 	}
 
 	template <typename FTy_>
 	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> U(FTy_ r, FTy_ g, FTy_ b)
 	{
-		return FloatClamp<FTy_>(static_cast<FTy_>(0.5) * b - static_cast<FTy_>(0.331264) * g - static_cast<FTy_>(0.168736) * r + static_cast<FTy_>(0.5));
+		return FloatClamp<FTy_>(static_cast<FTy_>(Coefficients_::kUB * ChromaScale<FTy_>()) * b + static_cast<FTy_>(Coefficients_::kUG * ChromaScale<FTy_>()) * g + static_cast<FTy_>(Coefficients_::kUR * ChromaScale<FTy_>()) * r + static_cast<FTy_>(0.5));
 	}
 
 	template <typename FTy_>
 	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> V(FTy_ r, FTy_ g, FTy_ b)
 	{
-		return FloatClamp<FTy_>(static_cast<FTy_>(0.5) * r - static_cast<FTy_>(0.418688) * g - static_cast<FTy_>(0.081312) * b + static_cast<FTy_>(0.5));
+		return FloatClamp<FTy_>(static_cast<FTy_>(Coefficients_::kVR * ChromaScale<FTy_>()) * r + static_cast<FTy_>(Coefficients_::kVG * ChromaScale<FTy_>()) * g + static_cast<FTy_>(Coefficients_::kVB * ChromaScale<FTy_>()) * b + static_cast<FTy_>(0.5));
 	}
 
 };
 
 
+/**
+ * Conversion according to JPEG standard, T-REC-T.871
+ */
+using YuvJPEG = YuvStandard<YuvCoefficientsJPEG>;
+
+/**
+ * Conversions according to ITU-R BT.601, BT.709 and BT.2020 (limited range)
+ */
+using YuvBT601 = YuvStandard<YuvCoefficientsITU<2990, 1140>>;
+using YuvBT709 = YuvStandard<YuvCoefficientsITU<2126, 722>>;
+using YuvBT2020 = YuvStandard<YuvCoefficientsITU<2627, 593>>;
+
+
 template <typename YuvStandard_>
 constexpr FIRGBAF YuvToRgb(const FIRGBAF& p) {
 	FIRGBAF res{
@@ -232,5 +355,10 @@ FIBITMAP* ConvertRgbToYuv(FIBITMAP* dib, int64_t standard_version);
 
 FIBITMAP* ConvertYuvToRgb(FIBITMAP* dib, int64_t standard_version);
 
+/**
+ * Converts a 24 or 32-bit image to 8-bit 4:2:0 planes written top-down, see FreeImage_ConvertToYUVPlanes
+ */
+bool ConvertRgbToYuvPlanes(FIBITMAP* dib, FREE_IMAGE_YUV_PLANES layout, uint8_t* const planes[3], const unsigned strides[3], int64_t standard_version);
+
 
 #endif //FREEIMAGE_CONVERSION_YUV_H_
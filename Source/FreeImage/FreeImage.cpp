@@ -31,6 +31,8 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#include <atomic>
+
 //----------------------------------------------------------------------
 
 static const char *s_copyright = "This program uses FreeImage, a free, open source image library supporting all common bitmap formats. See http://freeimage.sourceforge.net for details";
@@ -119,16 +121,24 @@ std::unique_ptr<FIDEPENDENCY> MakeRawDependencyInfo();
 std::unique_ptr<FIDEPENDENCY> MakeWebpDependencyInfo();
 std::unique_ptr<FIDEPENDENCY> MakeJxrDependencyInfo();
 std::unique_ptr<FIDEPENDENCY> MakeHeifDependencyInfo();
+std::unique_ptr<FIDEPENDENCY> MakeDeflateDependencyInfo();
 
 namespace {
 	
 	std::unique_ptr<FIDEPENDENCY> MakeZLibDependencyInfo() {
 		auto info = std::make_unique<FIDEPENDENCY>();
 		info->type = FIDEP_STATIC;
+#ifdef ZLIBNG_VERSION
+		info->name = "zlib-ng";
+		info->fullVersion  = ZLIBNG_VERSION;
+		info->majorVersion = ZLIBNG_VER_MAJOR;
+		info->minorVersion = ZLIBNG_VER_MINOR;
+#else
 		info->name = "zlib";
 		info->fullVersion  = ZLIB_VERSION;
 		info->majorVersion = ZLIB_VER_MAJOR;
 		info->minorVersion = ZLIB_VER_MINOR;
+#endif
 		return info;
 	}
 
@@ -151,6 +161,9 @@ namespace {
 	private:
 		DependenciesTable() {
 			Append(MakeZLibDependencyInfo());
+#if FREEIMAGE_WITH_LIBDEFLATE
+			Append(MakeDeflateDependencyInfo());
+#endif
 #if FREEIMAGE_WITH_LIBPNG
 			Append(MakePngDependencyInfo());
 #endif
@@ -223,123 +236,177 @@ FreeImage_IsLittleEndian() {
 
 //----------------------------------------------------------------------
 
-static FreeImage_OutputMessageFunction freeimage_outputmessage_proc{};
-static FreeImage_OutputMessageFunctionStdCall freeimage_outputmessagestdcall_proc{};
+// process-wide handlers, read without locking by the threads outputting messages
+static std::atomic<FreeImage_OutputMessageFunction> freeimage_outputmessage_proc{};
+static std::atomic<FreeImage_OutputMessageFunctionStdCall> freeimage_outputmessagestdcall_proc{};
 
 void DLL_CALLCONV
 FreeImage_SetOutputMessage(FreeImage_OutputMessageFunction omf) {
-	freeimage_outputmessage_proc = omf;
+	freeimage_outputmessage_proc.store(omf, std::memory_order_relaxed);
 }
 
 void DLL_CALLCONV
 FreeImage_SetOutputMessageStdCall(FreeImage_OutputMessageFunctionStdCall omf) {
-	freeimage_outputmessagestdcall_proc = omf;
+	freeimage_outputmessagestdcall_proc.store(omf, std::memory_order_relaxed);
 }
 
-void DLL_CALLCONV
-FreeImage_OutputMessageProc(int fif, const char *fmt, ...) {
-	const int MSG_SIZE = 512; // 512 bytes should be more than enough for a short message
-
-	if (fmt && (freeimage_outputmessage_proc || freeimage_outputmessagestdcall_proc)) {
-		char message[MSG_SIZE];
-		memset(message, 0, MSG_SIZE);
-
-		// initialize the optional parameter list
-
-		va_list arg;
-		va_start(arg, fmt);
-
-		// check the length of the format string
-
-		int str_length = (int)( (strlen(fmt) > MSG_SIZE) ? MSG_SIZE : strlen(fmt) );
-
-		// parse the format string and put the result in 'message'
-
-		for (int i = 0, j = 0; i < str_length; ++i) {
-			if (fmt[i] == '%') {
-				if (i + 1 < str_length) {
-					switch (tolower(fmt[i + 1])) {
-						case '%' :
-							message[j++] = '%';
-							break;
-
-						case 'o' : // octal numbers
-						{
-							char tmp[16];
-
-							_itoa(va_arg(arg, int), tmp, 8);
-
-							strcat(message, tmp);
-
-							j += (int)strlen(tmp);
-
-							++i;
-
-							break;
-						}
+namespace {
 
-						case 'i' : // decimal numbers
-						case 'd' :
-						{
-							char tmp[16];
+	const int MSG_SIZE = 512; // 512 bytes should be more than enough for a short message
 
-							_itoa(va_arg(arg, int), tmp, 10);
+	/// last message output on a thread, kept without allocation for FreeImage_GetLastMessage, and the handler of the thread
+	struct MessageContext {
+		FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
+		char message[MSG_SIZE] = {};
+		FREE_IMAGE_MESSAGE code = FIMSG_NONE;
+		bool code_pending = false;	// code not derived from message yet
+		FreeImage_ThreadOutputMessageFunction handler = nullptr;
+		void *user_data = nullptr;
+	};
 
-							strcat(message, tmp);
+	thread_local MessageContext s_message_context;
 
-							j += (int)strlen(tmp);
+	/// appends src to dst[0..j), truncating to MSG_SIZE - 1 characters
+	void AppendMessage(char *dst, int &j, const char *src) {
+		while (src && *src && (j < MSG_SIZE - 1)) {
+			dst[j++] = *src++;
+		}
+	}
 
-							++i;
+	/// Returns the code of a message output without one, from the "Warning" prefix
+	FREE_IMAGE_MESSAGE GetMessageCode(const char *message) {
+		if (!*message) {
+			return FIMSG_NONE;
+		}
+		return (strncmp(message, "Warning", 7) == 0) ? FIMSG_WARNING : FIMSG_GENERIC;
+	}
 
-							break;
-						}
+	FREE_IMAGE_MESSAGE GetContextCode(MessageContext &context) {
+		if (context.code_pending) {
+			context.code = GetMessageCode(context.message);
+			context.code_pending = false;
+		}
+		return context.code;
+	}
 
-						case 'x' : // hexadecimal numbers
-						{
-							char tmp[16];
+	/// Formats a message and outputs it, code is derived from the message on request when FIMSG_NONE
+	void OutputMessage(int fif, FREE_IMAGE_MESSAGE code, const char *fmt, va_list arg) {
 
-							_itoa(va_arg(arg, int), tmp, 16);
+		// the message is formatted in the context of the calling thread, so that it can be retrieved
+		// with FreeImage_GetLastMessage whether an output handler is set or not
 
-							strcat(message, tmp);
+		MessageContext &context = s_message_context;
+		char *message = context.message;
+		int j = 0;
 
-							j += (int)strlen(tmp);
+		// parse the format string and put the result in 'message'
 
-							++i;
+		for (int i = 0; fmt[i] && (j < MSG_SIZE - 1); ++i) {
+			if ((fmt[i] == '%') && fmt[i + 1]) {
+				char tmp[16];
+				switch (tolower(fmt[i + 1])) {
+					case '%' :
+						message[j++] = '%';
+						break;
+
+					case 'o' : // octal numbers
+						_itoa(va_arg(arg, int), tmp, 8);
+						AppendMessage(message, j, tmp);
+						break;
+
+					case 'i' : // decimal numbers
+					case 'd' :
+						_itoa(va_arg(arg, int), tmp, 10);
+						AppendMessage(message, j, tmp);
+						break;
+
+					case 'x' : // hexadecimal numbers
+						_itoa(va_arg(arg, int), tmp, 16);
+						AppendMessage(message, j, tmp);
+						break;
+
+					case 's' : // strings
+						AppendMessage(message, j, va_arg(arg, const char*));
+						break;
+
+					default:
+						// unknown conversions are dropped
+						break;
+				}
+				++i;
+			} else {
+				message[j++] = fmt[i];
+			}
+		}
+		message[j] = '\0';
+		context.fif = (FREE_IMAGE_FORMAT)fif;
+		context.code = code;
+		context.code_pending = (code == FIMSG_NONE);
 
-							break;
-						}
+		// output the message to the user program, the handler of the thread replaces the process-wide ones
 
-						case 's' : // strings
-						{
-							char *tmp = va_arg(arg, char*);
+		if (context.handler) {
+			context.handler((FREE_IMAGE_FORMAT)fif, GetContextCode(context), message, context.user_data);
+			return;
+		}
 
-							strcat(message, tmp);
+		if (const FreeImage_OutputMessageFunction omf = freeimage_outputmessage_proc.load(std::memory_order_relaxed))
+			omf((FREE_IMAGE_FORMAT)fif, message);
 
-							j += (int)strlen(tmp);
+		if (const FreeImage_OutputMessageFunctionStdCall omf = freeimage_outputmessagestdcall_proc.load(std::memory_order_relaxed))
+			omf((FREE_IMAGE_FORMAT)fif, message); 
+	}
 
-							++i;
+} // namespace
 
-							break;
-						}
-					};
-				} else {
-					message[j++] = fmt[i];
-				}
-			} else {
-				message[j++] = fmt[i];
-			};
-		}
+void DLL_CALLCONV
+FreeImage_SetThreadOutputMessage(FreeImage_ThreadOutputMessageFunction omf, void *user_data) {
+	MessageContext &context = s_message_context;
+	context.handler = omf;
+	context.user_data = omf ? user_data : nullptr;
+}
 
-		// deinitialize the optional parameter list
+void DLL_CALLCONV
+FreeImage_OutputMessageProc(int fif, const char *fmt, ...) {
+	if (!fmt) {
+		return;
+	}
+	va_list arg;
+	va_start(arg, fmt);
+	OutputMessage(fif, FIMSG_NONE, fmt, arg);
+	va_end(arg);
+}
 
-		va_end(arg);
+void DLL_CALLCONV
+FreeImage_OutputMessageProcEx(int fif, FREE_IMAGE_MESSAGE code, const char *fmt, ...) {
+	if (!fmt) {
+		return;
+	}
+	va_list arg;
+	va_start(arg, fmt);
+	OutputMessage(fif, code, fmt, arg);
+	va_end(arg);
+}
 
-		// output the message to the user program
+const char * DLL_CALLCONV
+FreeImage_GetLastMessage(FREE_IMAGE_FORMAT *fif) {
+	const MessageContext &context = s_message_context;
+	if (fif) {
+		*fif = context.fif;
+	}
+	return context.message;
+}
 
-		if (freeimage_outputmessage_proc)
-			freeimage_outputmessage_proc((FREE_IMAGE_FORMAT)fif, message);
+FREE_IMAGE_MESSAGE DLL_CALLCONV
+FreeImage_GetLastMessageCode() {
+	return GetContextCode(s_message_context);
+}
 
-		if (freeimage_outputmessagestdcall_proc)
-			freeimage_outputmessagestdcall_proc((FREE_IMAGE_FORMAT)fif, message); 
-	}
+void DLL_CALLCONV
+FreeImage_ClearLastMessage() {
+	MessageContext &context = s_message_context;
+	context.fif = FIF_UNKNOWN;
+	context.message[0] = '\0';
+	context.code = FIMSG_NONE;
+	context.code_pending = false;
 }
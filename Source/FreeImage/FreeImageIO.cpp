@@ -23,6 +23,15 @@
 #include "Utilities.h"
 #include "FreeImageIO.h"
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <new>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
+
 // =====================================================================
 // File IO functions
 // =====================================================================
@@ -47,6 +56,24 @@ _TellProc(fi_handle handle) {
 	return ftell((FILE *)handle);
 }
 
+int DLL_CALLCONV
+_SeekProc64(fi_handle handle, int64_t offset, int origin) {
+#ifdef _WIN32
+	return _fseeki64((FILE *)handle, offset, origin);
+#else
+	return fseeko((FILE *)handle, (off_t)offset, origin);
+#endif
+}
+
+int64_t DLL_CALLCONV
+_TellProc64(fi_handle handle) {
+#ifdef _WIN32
+	return _ftelli64((FILE *)handle);
+#else
+	return (int64_t)ftello((FILE *)handle);
+#endif
+}
+
 // ----------------------------------------------------------
 
 void
@@ -57,66 +84,296 @@ SetDefaultIO(FreeImageIO *io) {
 	io->write_proc = _WriteProc;
 }
 
+void
+SetDefaultIO64(FreeImageIO64 *io) {
+	io->read_proc  = _ReadProc;
+	io->seek_proc  = _SeekProc64;
+	io->tell_proc  = _TellProc64;
+	io->write_proc = _WriteProc;
+}
+
+// ----------------------------------------------------------
+//   Files loaded by filename
+// ----------------------------------------------------------
+
+namespace {
+
+	std::atomic<unsigned> gFileHints{ 0 };
+
+	// stdio buffer of the files of formats decoded front to back: fewer, larger reads
+	const size_t SEQUENTIAL_FILE_BUFFER = 128 * 1024;
+
+	/**
+	Returns true if the plugin of fif reads its files from front to back.
+	The other ones seek to offsets stored in the file, where a large buffer would read bytes that are skipped.
+	*/
+	bool IsSequentialFormat(FREE_IMAGE_FORMAT fif) {
+		switch (fif) {
+			case FIF_UNKNOWN:
+			case FIF_ICO:
+			case FIF_TIFF:
+			case FIF_EXR:
+			case FIF_RAW:
+			case FIF_JXR:
+			case FIF_HEIF:
+			case FIF_AVIF:
+				return false;
+			default:
+				return true;
+		}
+	}
+
+	void AdviseFile(FILE *handle, int advice) {
+#if !defined(_WIN32) && defined(POSIX_FADV_NORMAL)
+		posix_fadvise(fileno(handle), 0, 0, advice);
+#else
+		(void)handle;
+		(void)advice;
+#endif
+	}
+
+} // namespace
+
+LoadFile::LoadFile(FREE_IMAGE_FORMAT fif, FILE *handle)
+	: mHandle(handle), mHints(gFileHints.load(std::memory_order_relaxed))
+{
+	if (!mHandle) {
+		return;
+	}
+	const bool sequential = IsSequentialFormat(fif);
+	if (sequential) {
+		// the buffer must be set before the first read
+		mBuffer.reset(new(std::nothrow) char[SEQUENTIAL_FILE_BUFFER]);
+		if (mBuffer && setvbuf(mHandle, mBuffer.get(), _IOFBF, SEQUENTIAL_FILE_BUFFER) != 0) {
+			mBuffer.reset();
+		}
+	}
+#if !defined(_WIN32) && defined(POSIX_FADV_NORMAL)
+	if (sequential && (mHints & FIFILE_HINT_SEQUENTIAL)) {
+		AdviseFile(mHandle, POSIX_FADV_SEQUENTIAL);
+	}
+	if (mHints & FIFILE_HINT_WILLNEED) {
+		AdviseFile(mHandle, POSIX_FADV_WILLNEED);
+	}
+#endif
+}
+
+LoadFile::~LoadFile() {
+	if (mHandle) {
+#if !defined(_WIN32) && defined(POSIX_FADV_NORMAL)
+		if (mHints & FIFILE_HINT_DONTNEED) {
+			AdviseFile(mHandle, POSIX_FADV_DONTNEED);
+		}
+#endif
+		fclose(mHandle);
+	}
+}
+
+void DLL_CALLCONV
+FreeImage_SetFileHints(unsigned hints) {
+	gFileHints.store(hints & (FIFILE_HINT_SEQUENTIAL | FIFILE_HINT_WILLNEED | FIFILE_HINT_DONTNEED), std::memory_order_relaxed);
+}
+
+unsigned DLL_CALLCONV
+FreeImage_GetFileHints() {
+	return gFileHints.load(std::memory_order_relaxed);
+}
+
 // =====================================================================
 // Memory IO functions
 // =====================================================================
 
+// largest memory stream the address space allows
+static const int64_t MAX_MEMORY_LENGTH = (int64_t)std::min<uint64_t>(PTRDIFF_MAX, INT64_MAX);
+
+// ----------------------------------------------------------
+//   Stream storage
+// ----------------------------------------------------------
+
+void
+FreeMemoryChunks(FIMEMORYHEADER *mem_header) {
+	if (mem_header->chunks) {
+		for (uint8_t *chunk : mem_header->chunks->chunks) {
+			free(chunk);
+		}
+		delete mem_header->chunks;
+		mem_header->chunks = nullptr;
+	}
+}
+
+FIBOOL
+FlattenMemoryChunks(FIMEMORYHEADER *mem_header) {
+	FIMEMORYCHUNKS *chunks = mem_header->chunks;
+	if (!chunks) {
+		return TRUE;
+	}
+	auto *data = (uint8_t*)malloc((size_t)std::max<int64_t>(mem_header->file_length, 1));
+	if (!data) {
+		return FALSE;
+	}
+	for (int64_t offset = 0; offset < mem_header->file_length; offset += chunks->chunk_size) {
+		memcpy(data + offset, chunks->chunks[(size_t)(offset / chunks->chunk_size)], (size_t)std::min(chunks->chunk_size, mem_header->file_length - offset));
+	}
+	FreeMemoryChunks(mem_header);
+
+	// the stream is contiguous from now on
+	mem_header->data = data;
+	mem_header->data_length = std::max<int64_t>(mem_header->file_length, 1);
+	mem_header->growth_policy = FIMEMORY_GROW_DOUBLE;
+	return TRUE;
+}
+
+/**
+Copies length bytes at position to buffer, the bytes must be in the stream
+*/
+static void
+ReadStream(const FIMEMORYHEADER *mem_header, int64_t position, void *buffer, int64_t length) {
+	if (const FIMEMORYCHUNKS *chunks = mem_header->chunks) {
+		auto *dst = (uint8_t*)buffer;
+		while (length > 0) {
+			const int64_t offset = position % chunks->chunk_size;
+			const int64_t n = std::min(length, chunks->chunk_size - offset);
+			memcpy(dst, chunks->chunks[(size_t)(position / chunks->chunk_size)] + offset, (size_t)n);
+			dst += n;
+			position += n;
+			length -= n;
+		}
+	} else {
+		memcpy(buffer, (const char *)mem_header->data + position, (size_t)length);
+	}
+}
+
+/**
+Copies length bytes of buffer at position, the storage must be large enough
+*/
+static void
+WriteStream(FIMEMORYHEADER *mem_header, int64_t position, const void *buffer, int64_t length) {
+	if (FIMEMORYCHUNKS *chunks = mem_header->chunks) {
+		auto *src = (const uint8_t*)buffer;
+		while (length > 0) {
+			const int64_t offset = position % chunks->chunk_size;
+			const int64_t n = std::min(length, chunks->chunk_size - offset);
+			memcpy(chunks->chunks[(size_t)(position / chunks->chunk_size)] + offset, src, (size_t)n);
+			src += n;
+			position += n;
+			length -= n;
+		}
+	} else {
+		memcpy((char *)mem_header->data + position, buffer, (size_t)length);
+	}
+}
+
+/**
+Grows the storage so that it holds more than end_position bytes
+*/
+static FIBOOL
+ReserveStream(FIMEMORYHEADER *mem_header, int64_t end_position) {
+	if (end_position < mem_header->data_length) {
+		return TRUE;
+	}
+
+	if (mem_header->user_writable) {
+		// the caller-provided buffer can be filled up, more space comes from the overflow callback
+		if (end_position <= mem_header->data_length) {
+			return TRUE;
+		}
+		if (!mem_header->overflow) {
+			return FALSE;
+		}
+		uint64_t capacity = (uint64_t)mem_header->data_length;
+		uint8_t *newdata = mem_header->overflow((uint8_t*)mem_header->data, (uint64_t)mem_header->file_length, (uint64_t)end_position, &capacity, mem_header->overflow_data);
+		if (!newdata || capacity < (uint64_t)end_position) {
+			return FALSE;
+		}
+		mem_header->data = newdata;
+		mem_header->data_length = (int64_t)std::min<uint64_t>(capacity, MAX_MEMORY_LENGTH);
+		return TRUE;
+	}
+
+	if (FIMEMORYCHUNKS *chunks = mem_header->chunks) {
+		//add chunks, written data is never moved
+		try {
+			while (end_position >= mem_header->data_length) {
+				auto *chunk = (uint8_t*)malloc((size_t)chunks->chunk_size);
+				if (!chunk) {
+					return FALSE;
+				}
+				chunks->chunks.push_back(chunk);
+				mem_header->data_length += chunks->chunk_size;
+			}
+		}
+		catch (const std::bad_alloc &) {
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	int64_t newdatalen;
+	if (mem_header->growth_policy == FIMEMORY_GROW_LINEAR) {
+		//round up to the next growth step
+		const int64_t steps = end_position / mem_header->growth_step + 1;
+		newdatalen = (steps > MAX_MEMORY_LENGTH / mem_header->growth_step) ? MAX_MEMORY_LENGTH : steps * mem_header->growth_step;
+	} else {
+		//double the data block size, default to 4K if nothing yet
+		newdatalen = mem_header->data_length ? mem_header->data_length : 4096;
+		while (end_position >= newdatalen) {
+			//stop doubling at the address space limit
+			newdatalen = (newdatalen > MAX_MEMORY_LENGTH / 2) ? MAX_MEMORY_LENGTH : (newdatalen << 1);
+		}
+	}
+	void *newdata = realloc( mem_header->data, (size_t)newdatalen );
+	if (!newdata) {
+		return FALSE;
+	}
+	mem_header->data = newdata;
+	mem_header->data_length = newdatalen;
+	return TRUE;
+}
+
+// ----------------------------------------------------------
+
 unsigned DLL_CALLCONV 
 _MemoryReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
-	unsigned x;
-
 	auto *mem_header = (FIMEMORYHEADER*)(((FIMEMORY*)handle)->data);
 
-	for (x = 0; x < count; x++) {
-		long remaining_bytes = mem_header->file_length - mem_header->current_position;
-		//if there isn't size bytes left to read, set pos to eof and return a short count
-		if (remaining_bytes < (long)size) {
-			if (remaining_bytes > 0) {
-				memcpy( buffer, (char *)mem_header->data + mem_header->current_position, remaining_bytes );
-			}
-			mem_header->current_position = mem_header->file_length;
-			break;
+	if (size == 0) {
+		return count;
+	}
+	const int64_t remaining_bytes = std::max<int64_t>(mem_header->file_length - mem_header->current_position, 0);
+
+	//copy all the full items at once
+	const unsigned full_items = (unsigned)std::min<int64_t>(count, remaining_bytes / size);
+	const int64_t full_bytes = (int64_t)full_items * size;
+	if (full_bytes) {
+		ReadStream(mem_header, mem_header->current_position, buffer, full_bytes);
+	}
+	mem_header->current_position += full_bytes;
+
+	//if there isn't size bytes left to read, copy the partial item, set pos to eof and return a short count
+	if (full_items < count) {
+		if (full_bytes < remaining_bytes) {
+			ReadStream(mem_header, mem_header->current_position, (char *)buffer + full_bytes, remaining_bytes - full_bytes);
 		}
-		//copy size bytes count times
-		memcpy(buffer, (char *)mem_header->data + mem_header->current_position, size);
-		mem_header->current_position += size;
-		buffer = (char *)buffer + size;
+		mem_header->current_position = mem_header->file_length;
 	}
-	return x;
+	return full_items;
 }
 
 unsigned DLL_CALLCONV 
 _MemoryWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
-	void *newdata;
-	long newdatalen;
-
 	auto *mem_header = (FIMEMORYHEADER*)(((FIMEMORY*)handle)->data);
 
-	//double the data block size if we need to
-	while ((mem_header->current_position + (long)(size * count)) >= mem_header->data_length) {
-		//if we are at or above 1G, we cant double without going negative
-		if (mem_header->data_length & 0x40000000) {
-			//max 2G
-			if (mem_header->data_length == 0x7FFFFFFF) {
-				return 0;
-			}
-			newdatalen = 0x7FFFFFFF;
-		} else if (mem_header->data_length == 0) {
-			//default to 4K if nothing yet
-			newdatalen = 4096;
-		} else {
-			//double size
-			newdatalen = mem_header->data_length << 1;
-		}
-		newdata = realloc( mem_header->data, newdatalen );
-		if (!newdata) {
-			return 0;
-		}
-		mem_header->data = newdata;
-		mem_header->data_length = newdatalen;
+	const int64_t write_length = (int64_t)size * count;
+	if (write_length >= MAX_MEMORY_LENGTH - mem_header->current_position) {
+		return 0;
 	}
-	memcpy( (char *)mem_header->data + mem_header->current_position, buffer, size * count );
-	mem_header->current_position += size * count;
+	const int64_t end_position = mem_header->current_position + write_length;
+
+	if (!ReserveStream(mem_header, end_position)) {
+		return 0;
+	}
+	WriteStream(mem_header, mem_header->current_position, buffer, write_length);
+	mem_header->current_position = end_position;
 	if (mem_header->current_position > mem_header->file_length) {
 		mem_header->file_length = mem_header->current_position;
 	}
@@ -124,46 +381,53 @@ _MemoryWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle)
 }
 
 int DLL_CALLCONV 
-_MemorySeekProc(fi_handle handle, long offset, int origin) {
+_MemorySeekProc64(fi_handle handle, int64_t offset, int origin) {
 	auto *mem_header = (FIMEMORYHEADER*)(((FIMEMORY*)handle)->data);
 
 	// you can use _MemorySeekProc to reposition the pointer anywhere in a file
 	// the pointer can also be positioned beyond the end of the file
 
+	int64_t base = 0;
 	switch (origin) { //0 to filelen-1 are 'inside' the file
 		default:
-		case SEEK_SET: //can fseek() to 0-7FFFFFFF always
-			if (offset >= 0) {
-				mem_header->current_position = offset;
-				return 0;
-			}
+		case SEEK_SET:
 			break;
 
 		case SEEK_CUR:
-			if (mem_header->current_position + offset >= 0) {
-				mem_header->current_position += offset;
-				return 0;
-			}
+			base = mem_header->current_position;
 			break;
 
 		case SEEK_END:
-			if (mem_header->file_length + offset >= 0) {
-				mem_header->current_position = mem_header->file_length + offset;
-				return 0;
-			}
+			base = mem_header->file_length;
 			break;
 	}
 
+	if ((offset < 0) ? (base + offset >= 0) : (offset < MAX_MEMORY_LENGTH - base)) {
+		mem_header->current_position = base + offset;
+		return 0;
+	}
 	return -1;
 }
 
-long DLL_CALLCONV 
-_MemoryTellProc(fi_handle handle) {
+int64_t DLL_CALLCONV 
+_MemoryTellProc64(fi_handle handle) {
 	auto *mem_header = (const FIMEMORYHEADER*)(((const FIMEMORY*)handle)->data);
 
 	return mem_header->current_position;
 }
 
+int DLL_CALLCONV 
+_MemorySeekProc(fi_handle handle, long offset, int origin) {
+	return _MemorySeekProc64(handle, offset, origin);
+}
+
+long DLL_CALLCONV 
+_MemoryTellProc(fi_handle handle) {
+	const int64_t position = _MemoryTellProc64(handle);
+	// the position doesn't fit a 32-bit long
+	return (position <= LONG_MAX) ? (long)position : -1L;
+}
+
 // ----------------------------------------------------------
 
 void
@@ -173,3 +437,11 @@ SetMemoryIO(FreeImageIO *io) {
 	io->tell_proc  = _MemoryTellProc;
 	io->write_proc = _MemoryWriteProc;
 }
+
+void
+SetMemoryIO64(FreeImageIO64 *io) {
+	io->read_proc  = _MemoryReadProc;
+	io->seek_proc  = _MemorySeekProc64;
+	io->tell_proc  = _MemoryTellProc64;
+	io->write_proc = _MemoryWriteProc;
+}
@@ -5,9 +5,18 @@
 
 #if FREEIMAGE_WITH_PYTHON_BINDINGS
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <system_error>
+#include <thread>
+#include <vector>
 #include "pybind11/numpy.h"
+#include "pybind11/stl.h"
 #include "FreeImage.hpp"
 
 #ifdef _WIN32
@@ -50,13 +59,13 @@ namespace
     }
 
 
-    std::tuple<pybind11::array, fi::ImageFormat> LoadWithFormat(const PathStringType& path, int flags)
+    /**
+     * Exposes the pixels of bitmap as an array without copying, the capsule owns the bitmap.
+     */
+    pybind11::array WrapBitmap(std::unique_ptr<fi::Bitmap> bitmapPtr)
     {
-        const auto format = fi::DetectFormat(path.c_str());
-        if (format == fi::ImageFormat::eUnknown) {
-            throw std::runtime_error("Failed to deduce image format");
-        }
-        const auto bitmapCapsule = pybind11::capsule(new fi::Bitmap(format, path.c_str(), flags), "BitmapRef", [](void* p) { delete static_cast<fi::Bitmap*>(p); });
+        const auto bitmapCapsule = pybind11::capsule(bitmapPtr.get(), "BitmapRef", [](void* p) { delete static_cast<fi::Bitmap*>(p); });
+        bitmapPtr.release();
         const auto& bitmap = *bitmapCapsule.get_pointer<fi::Bitmap>(); // not null
         const auto bpp = bitmap.GetBPP();
         if (bpp % 8 != 0) {
@@ -64,7 +73,61 @@ namespace
         }
         const std::array<pybind11::ssize_t, 3> shape = { bitmap.GetHeight(), bitmap.GetWidth(), bitmap.GetChannelsNumber() };
         const std::array<pybind11::ssize_t, 3> strides = { bitmap.GetPitch(), bpp / 8,  bpp / 8 / bitmap.GetChannelsNumber() };
-        return std::make_tuple(pybind11::array(DeduceDType(bitmap), shape, strides, bitmap.GetBits(), bitmapCapsule), format);
+        return pybind11::array(DeduceDType(bitmap), shape, strides, bitmap.GetBits(), bitmapCapsule);
+    }
+
+
+    std::tuple<pybind11::array, fi::ImageFormat> LoadWithFormat(const PathStringType& path, int flags)
+    {
+        std::unique_ptr<fi::Bitmap> bitmap;
+        fi::ImageFormat format;
+        {
+            pybind11::gil_scoped_release release;
+            format = fi::DetectFormat(path.c_str());
+            if (format == fi::ImageFormat::eUnknown) {
+                throw std::runtime_error("Failed to deduce image format");
+            }
+            bitmap = std::make_unique<fi::Bitmap>(format, path.c_str(), flags);
+        }
+        return std::make_tuple(WrapBitmap(std::move(bitmap)), format);
+    }
+
+
+    /**
+     * Decodes an encoded image held by any contiguous buffer (bytes, bytearray, memoryview, numpy array).
+     * The buffer is read in place, the GIL is released while decoding.
+     */
+    std::tuple<pybind11::array, fi::ImageFormat> DecodeWithFormat(const pybind11::buffer& buffer, int flags)
+    {
+        const pybind11::buffer_info info = buffer.request();
+        pybind11::ssize_t expectedStride = info.itemsize;
+        for (pybind11::ssize_t i = info.ndim - 1; i >= 0; --i) {
+            if (info.shape[i] > 1 && info.strides[i] != expectedStride) {
+                throw std::runtime_error("Buffer must be contiguous");
+            }
+            expectedStride *= info.shape[i];
+        }
+        const auto size = static_cast<uint64_t>(info.size * info.itemsize);
+        if (size == 0) {
+            throw std::runtime_error("Buffer is empty");
+        }
+
+        std::unique_ptr<fi::Bitmap> bitmap;
+        fi::ImageFormat format;
+        {
+            pybind11::gil_scoped_release release;
+            // the memory stream only reads from the buffer, it is never written or freed
+            const std::unique_ptr<FIMEMORY, decltype(&FreeImage_CloseMemory)> stream(FreeImage_OpenMemory64(static_cast<uint8_t*>(info.ptr), size), &FreeImage_CloseMemory);
+            if (!stream) {
+                throw std::runtime_error("Failed to open memory stream");
+            }
+            format = static_cast<fi::ImageFormat>(FreeImage_GetFileTypeFromMemory(stream.get(), 0));
+            if (format == fi::ImageFormat::eUnknown) {
+                throw std::runtime_error("Failed to deduce image format");
+            }
+            bitmap = std::make_unique<fi::Bitmap>(FREEIMAGERE_CHECKED_CALL(FreeImage_LoadFromMemory, static_cast<FREE_IMAGE_FORMAT>(format), stream.get(), flags));
+        }
+        return std::make_tuple(WrapBitmap(std::move(bitmap)), format);
     }
 
 
@@ -162,12 +225,25 @@ namespace
         return static_cast<uint32_t>(s);
     }
 
-    bool Save(fi::ImageFormat format, const pybind11::array& arr, const PathStringType& path, int flags)
+    bool Save(fi::ImageFormat format, pybind11::array arr, const PathStringType& path, int flags)
     {
-        if (arr.ndim() < 2 && arr.ndim() > 3) {
+        if (arr.ndim() < 2 || arr.ndim() > 3) {
             throw std::runtime_error("Array must have 2 or 3 dims.");
         }
 
+        // FreeImage doesn't support arbitrary pixel stride nor negative pitch,
+        // such arrays are made C-contiguous once, all others are wrapped in place
+        const auto itemsize = static_cast<pybind11::ssize_t>(arr.itemsize());
+        const bool packedPixels = (arr.ndim() == 2)
+            ? arr.strides(1) == itemsize
+            : (arr.strides(2) == itemsize && arr.strides(1) == itemsize * arr.shape(2));
+        if (!packedPixels || arr.strides(0) <= 0) {
+            arr = pybind11::array::ensure(arr, pybind11::array::c_style);
+            if (!arr) {
+                throw std::runtime_error("Failed to make array C-contiguous");
+            }
+        }
+
         std::array<pybind11::ssize_t, 3> shape   = {1, 1, 1};
         std::array<pybind11::ssize_t, 3> strides = {1, 1, 1};
         for (pybind11::ssize_t i = 0; i < arr.ndim(); ++i) {
@@ -192,13 +268,192 @@ namespace
             throw std::runtime_error("Unsupported pixel stride");
         }
 
-        // Attach header and save
+        // Attach header (FreeImage_AllocateHeaderForBits, no copy) and save
         const auto bmpView = fi::Bitmap::FromRawBits(false, static_cast<uint8_t*>(const_cast<void*>(arr.data())), imageType, NarrowCastSize(shape.at(1)), NarrowCastSize(shape.at(0)),
             NarrowCastSize(arr.strides(0)), NarrowCastSize(bpp), 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF);
 
+        // arr keeps the pixels alive while the GIL is released
+        pybind11::gil_scoped_release release;
         return bmpView.Save(format, path.c_str(), flags);
     }
 
+
+    using BitmapPtr = std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)>;
+
+    std::string LastLoadError()
+    {
+        const char* message = FreeImage_GetLastMessage();
+        return (message && *message) ? message : "unsupported or unreadable file";
+    }
+
+    FIBITMAP* LoadFile(const std::string& path, unsigned maxWidth, unsigned maxHeight, int flags)
+    {
+        const FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(path.c_str(), 0);
+        if (fif == FIF_UNKNOWN) {
+            return nullptr;
+        }
+        return (maxWidth && maxHeight) ? FreeImage_LoadScaled(fif, path.c_str(), maxWidth, maxHeight, flags) : FreeImage_Load(fif, path.c_str(), flags);
+    }
+
+    FIBITMAP* LoadFile(const std::wstring& path, unsigned maxWidth, unsigned maxHeight, int flags)
+    {
+        const FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeU(path.c_str(), 0);
+        if (fif == FIF_UNKNOWN) {
+            return nullptr;
+        }
+        return (maxWidth && maxHeight) ? FreeImage_LoadScaledU(fif, path.c_str(), maxWidth, maxHeight, flags) : FreeImage_LoadU(fif, path.c_str(), flags);
+    }
+
+    /**
+     * Converts dib to the type, bpp and size of a batch output array, dib is returned as is when it already matches.
+     */
+    BitmapPtr FitToBatch(BitmapPtr dib, FREE_IMAGE_TYPE type, unsigned bpp, unsigned width, unsigned height)
+    {
+        // palettized 8-bit images are expanded to grey levels, not copied as indices
+        const bool palettized = (type == FIT_BITMAP && bpp == 8 && FreeImage_GetColorType(dib.get()) != FIC_MINISBLACK);
+        if (FreeImage_GetImageType(dib.get()) != type || FreeImage_GetBPP(dib.get()) != bpp || palettized) {
+            FIBITMAP* converted = nullptr;
+            if (type != FIT_BITMAP) {
+                converted = FreeImage_ConvertToType(dib.get(), type, TRUE);
+            }
+            else if (bpp == 8) {
+                converted = FreeImage_ConvertToGreyscale(dib.get());
+            }
+            else if (bpp == 24) {
+                converted = FreeImage_ConvertTo24Bits(dib.get());
+            }
+            else if (bpp == 32) {
+                converted = FreeImage_ConvertTo32Bits(dib.get());
+            }
+            dib.reset(converted);
+        }
+        if (dib && (FreeImage_GetWidth(dib.get()) != width || FreeImage_GetHeight(dib.get()) != height)) {
+            dib.reset(FreeImage_Rescale(dib.get(), static_cast<int>(width), static_cast<int>(height), FILTER_BILINEAR));
+        }
+        return dib;
+    }
+
+    /**
+     * Calls body(index) for every index of [0, count) on threads workers, the calling thread being one of them.
+     * body must not throw.
+     */
+    template <typename Body_>
+    void RunWorkers(size_t count, unsigned threads, Body_&& body)
+    {
+        if (threads == 0) {
+            threads = std::max(1U, FreeImage_GetThreadCount());
+        }
+        threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+
+        std::atomic<size_t> next{ 0 };
+        const auto worker = [&]() {
+            for (size_t index = next++; index < count; index = next++) {
+                body(index);
+            }
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (unsigned t = 1; t < threads; ++t) {
+            try {
+                workers.emplace_back(worker);
+            }
+            catch (const std::system_error&) {
+                // go on with the workers started so far
+                break;
+            }
+        }
+        worker();
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+    /**
+     * Loads paths on C++ threads with the GIL released.
+     * Without out, returns a list of arrays, images are fitted into max_size x max_size when max_size is not 0 (FreeImage_LoadScaled).
+     * With out, a writable C-contiguous (N, H, W[, C]) array, every image is fitted into W x H, converted to the dtype and channels
+     * of out and rescaled to W x H, then copied into out[i]; out is returned. Rows are in the order of load().
+     */
+    pybind11::object LoadBatch(const std::vector<PathStringType>& paths, int flags, unsigned maxSize, unsigned threads, std::optional<pybind11::array> out)
+    {
+        const size_t count = paths.size();
+        std::vector<BitmapPtr> bitmaps;
+        bitmaps.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            bitmaps.emplace_back(nullptr, &FreeImage_Unload);
+        }
+        std::vector<std::string> errors(count);
+
+        if (!out) {
+            {
+                pybind11::gil_scoped_release release;
+                RunWorkers(count, threads, [&](size_t index) {
+                    FreeImage_ClearLastMessage();
+                    bitmaps[index].reset(LoadFile(paths[index], maxSize, maxSize, flags));
+                    if (!bitmaps[index]) {
+                        errors[index] = LastLoadError();
+                    }
+                });
+            }
+            pybind11::list result;
+            for (size_t i = 0; i < count; ++i) {
+                if (!bitmaps[i]) {
+                    throw std::runtime_error("Failed to load batch item " + std::to_string(i) + ": " + errors[i]);
+                }
+                auto bitmap = std::make_unique<fi::Bitmap>(bitmaps[i].get());
+                bitmaps[i].release();
+                result.append(WrapBitmap(std::move(bitmap)));
+            }
+            return std::move(result);
+        }
+
+        pybind11::array& arr = *out;
+        if (arr.ndim() < 3 || arr.ndim() > 4) {
+            throw std::runtime_error("Output array must have 3 or 4 dims (N, H, W[, C]).");
+        }
+        if (!arr.writeable() || !(arr.flags() & pybind11::array::c_style)) {
+            throw std::runtime_error("Output array must be writable and C-contiguous.");
+        }
+        if (static_cast<size_t>(arr.shape(0)) != count) {
+            throw std::runtime_error("Output array must have one item per path.");
+        }
+        const uint32_t height = NarrowCastSize(arr.shape(1));
+        const uint32_t width  = NarrowCastSize(arr.shape(2));
+        pybind11::ssize_t channels = (arr.ndim() == 4) ? arr.shape(3) : 1;
+        if (arr.dtype().num() >= pybind11::detail::npy_api::NPY_CFLOAT_ && arr.dtype().num() <= pybind11::detail::npy_api::NPY_CLONGDOUBLE_) {
+            channels *= 2;
+        }
+        const auto [imageType, bpp] = DeduceFiType(arr.dtype(), channels);
+        const auto type = static_cast<FREE_IMAGE_TYPE>(imageType);
+        const size_t rowBytes = static_cast<size_t>(width) * bpp / 8;
+        uint8_t* const dstBits = static_cast<uint8_t*>(arr.mutable_data());
+
+        {
+            pybind11::gil_scoped_release release;
+            RunWorkers(count, threads, [&, bpp = bpp](size_t index) {
+                FreeImage_ClearLastMessage();
+                BitmapPtr dib(LoadFile(paths[index], width, height, flags), &FreeImage_Unload);
+                if (dib) {
+                    dib = FitToBatch(std::move(dib), type, static_cast<unsigned>(bpp), width, height);
+                }
+                if (!dib) {
+                    errors[index] = LastLoadError();
+                    return;
+                }
+                uint8_t* dst = dstBits + index * height * rowBytes;
+                for (uint32_t y = 0; y < height; ++y, dst += rowBytes) {
+                    std::memcpy(dst, FreeImage_GetScanLine(dib.get(), static_cast<int>(y)), rowBytes);
+                }
+            });
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!errors[i].empty()) {
+                throw std::runtime_error("Failed to load batch item " + std::to_string(i) + ": " + errors[i]);
+            }
+        }
+        return arr;
+    }
+
 } // namespace
 
 PYBIND11_MODULE(FreeImage, m) {
@@ -216,10 +471,24 @@ PYBIND11_MODULE(FreeImage, m) {
         return pybind11::make_tuple(std::move(img), pybind11::int_(static_cast<int>(f)));
     }, pybind11::arg("path"), pybind11::arg("flags") = 0);
 
+    m.def("decode", [](const pybind11::buffer& buffer, int flags) {
+        auto [img, f] = DecodeWithFormat(buffer, flags);
+        (void)f;
+        return img;
+    }, pybind11::arg("buffer"), pybind11::arg("flags") = 0);
+
+    m.def("decodef", [](const pybind11::buffer& buffer, int flags) {
+        auto [img, f] = DecodeWithFormat(buffer, flags);
+        return pybind11::make_tuple(std::move(img), pybind11::int_(static_cast<int>(f)));
+    }, pybind11::arg("buffer"), pybind11::arg("flags") = 0);
+
     m.def("save", [](int format, const pybind11::array& arr, const PathStringType& path, int flags) {
         return pybind11::bool_(Save(static_cast<fi::ImageFormat>(format), arr, path, flags));
     }, pybind11::arg("format"), pybind11::arg("arr"), pybind11::arg("path"), pybind11::arg("flags") = 0);
 
+    m.def("load_batch", &LoadBatch, pybind11::arg("paths"), pybind11::arg("flags") = 0, pybind11::arg("max_size") = 0,
+        pybind11::arg("threads") = 0, pybind11::arg("out") = pybind11::none());
+
 
     // Format constants
     m.attr("FIF_BMP") = pybind11::int_(static_cast<int>(FIF_BMP));
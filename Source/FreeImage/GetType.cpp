@@ -29,16 +29,177 @@
 #include "FreeImageIO.h"
 #include "Plugin.h"
 
+#include <algorithm>
+#include <vector>
+
 // =====================================================================
 // Generic stream file type access
 // =====================================================================
 
+namespace {
+
+	/**
+	Stream seen through a header window read once: plugins validating from the first bytes
+	don't touch the underlying stream, longer reads and seeks fall through to it.
+	*/
+	struct HeaderWindow
+	{
+		static constexpr unsigned SIZE = 512;
+
+		FreeImageIO *io;
+		fi_handle handle;
+		long start;			// position of the window in the stream
+		unsigned length;	// valid bytes in the window
+		long position;		// current position seen by plugins
+		long stream_position;	// position of the underlying stream, -1 if unknown
+		uint8_t bytes[SIZE];
+	};
+
+	unsigned DLL_CALLCONV
+	_WindowReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+		auto *w = (HeaderWindow*)handle;
+		const unsigned long total = (unsigned long)size * count;
+		if (total == 0) {
+			return 0;
+		}
+		// the whole read is in the window
+		if (w->position >= w->start && (unsigned long)(w->position - w->start) + total <= w->length) {
+			memcpy(buffer, w->bytes + (w->position - w->start), total);
+			w->position += (long)total;
+			return count;
+		}
+		if (w->stream_position != w->position) {
+			if (w->io->seek_proc(w->handle, w->position, SEEK_SET) != 0) {
+				w->stream_position = -1;
+				return 0;
+			}
+		}
+		const unsigned n = w->io->read_proc(buffer, size, count, w->handle);
+		w->stream_position = w->io->tell_proc(w->handle);
+		w->position = w->stream_position;
+		return n;
+	}
+
+	unsigned DLL_CALLCONV
+	_WindowWriteProc(void * /*buffer*/, unsigned /*size*/, unsigned /*count*/, fi_handle /*handle*/) {
+		return 0;
+	}
+
+	int DLL_CALLCONV
+	_WindowSeekProc(fi_handle handle, long offset, int origin) {
+		auto *w = (HeaderWindow*)handle;
+		switch (origin) {
+			case SEEK_SET:
+				w->position = offset;
+				return 0;
+			case SEEK_CUR:
+				w->position += offset;
+				return 0;
+			default: {
+				// only the underlying stream knows its end
+				const int result = w->io->seek_proc(w->handle, offset, origin);
+				w->stream_position = (result == 0) ? w->io->tell_proc(w->handle) : -1;
+				if (result == 0) {
+					w->position = w->stream_position;
+				}
+				return result;
+			}
+		}
+	}
+
+	long DLL_CALLCONV
+	_WindowTellProc(fi_handle handle) {
+		return ((HeaderWindow*)handle)->position;
+	}
+
+	/**
+	Magic bytes of formats with a signature, matching formats are validated before the other ones
+	*/
+	struct FormatSignature
+	{
+		FREE_IMAGE_FORMAT fif;
+		unsigned offset;
+		unsigned length;
+		const char *bytes;
+	};
+
+	const FormatSignature kSignatures[] = {
+		{ FIF_PNG,  0, 8, "\x89PNG\r\n\x1a\n" },
+		{ FIF_MNG,  0, 8, "\x8aMNG\r\n\x1a\n" },
+		{ FIF_JNG,  0, 8, "\x8bJNG\r\n\x1a\n" },
+		{ FIF_JPEG, 0, 3, "\xff\xd8\xff" },
+		{ FIF_GIF,  0, 4, "GIF8" },
+		{ FIF_TIFF, 0, 4, "II*\0" },
+		{ FIF_TIFF, 0, 4, "MM\0*" },
+		{ FIF_TIFF, 0, 4, "II+\0" },
+		{ FIF_TIFF, 0, 4, "MM\0+" },
+		{ FIF_BMP,  0, 2, "BM" },
+		{ FIF_PSD,  0, 4, "8BPS" },
+		{ FIF_EXR,  0, 4, "\x76\x2f\x31\x01" },
+		{ FIF_JP2,  0, 12, "\0\0\0\x0cjP  \r\n\x87\n" },
+		{ FIF_J2K,  0, 4, "\xff\x4f\xff\x51" },
+		{ FIF_WEBP, 8, 4, "WEBP" },
+		{ FIF_DDS,  0, 4, "DDS " },
+		{ FIF_HDR,  0, 2, "#?" },
+		{ FIF_JXR,  0, 3, "II\xbc" },
+		{ FIF_ICO,  0, 4, "\0\0\1\0" },
+		{ FIF_HEIF, 4, 4, "ftyp" },
+		{ FIF_AVIF, 4, 4, "ftyp" },
+		{ FIF_FIRAW, 0, 8, "FIRAW\r\n\x1a" },
+	};
+
+	bool MatchSignature(const HeaderWindow& window, const FormatSignature& signature) {
+		return signature.offset + signature.length <= window.length
+			&& memcmp(window.bytes + signature.offset, signature.bytes, signature.length) == 0;
+	}
+
+	bool ValidateNode(const PluginNodeBase *node, FreeImageIO *io, HeaderWindow& window) {
+		return node && node->IsEnabled() && node->Validate(io, (fi_handle)&window);
+	}
+
+} // namespace
+
 FREE_IMAGE_FORMAT DLL_CALLCONV
 FreeImage_GetFileTypeFromHandle(FreeImageIO *io, fi_handle handle, int size) {
 	FREE_IMAGE_FORMAT deducedFif{ FIF_UNKNOWN };
-	if (handle) {
-		for (const auto& [fif, node] : PluginsRegistrySingleton::Instance()->NodesCRange()) {
-			if (node && node->IsEnabled() && node->Validate(io, handle)) {
+	if (!handle) {
+		return deducedFif;
+	}
+
+	// read the header once
+	HeaderWindow window;
+	window.io = io;
+	window.handle = handle;
+	window.start = io->tell_proc(handle);
+	window.length = io->read_proc(window.bytes, 1, HeaderWindow::SIZE, handle);
+	window.position = window.start;
+	window.stream_position = -1;
+
+	FreeImageIO windowIO;
+	windowIO.read_proc  = _WindowReadProc;
+	windowIO.write_proc = _WindowWriteProc;
+	windowIO.seek_proc  = _WindowSeekProc;
+	windowIO.tell_proc  = _WindowTellProc;
+
+	auto& plugins = PluginsRegistrySingleton::Instance();
+
+	// formats with matching magic bytes first
+	std::vector<FREE_IMAGE_FORMAT> tried;
+	for (const FormatSignature& signature : kSignatures) {
+		if (MatchSignature(window, signature) && std::find(tried.begin(), tried.end(), signature.fif) == tried.end()) {
+			tried.push_back(signature.fif);
+			if (ValidateNode(plugins->FindFromFIF(signature.fif), &windowIO, window)) {
+				deducedFif = signature.fif;
+				break;
+			}
+		}
+	}
+
+	// then the other plugins in the registry order
+	if (deducedFif == FIF_UNKNOWN) {
+		const auto nodes = plugins->Snapshot();
+		for (const auto& [fif, node] : *nodes) {
+			if (std::find(tried.begin(), tried.end(), fif) == tried.end() && ValidateNode(node.get(), &windowIO, window)) {
 				deducedFif = fif;
 				break;
 			}
@@ -48,11 +209,13 @@ FreeImage_GetFileTypeFromHandle(FreeImageIO *io, fi_handle handle, int size) {
 	if (deducedFif == FIF_TIFF) {
 		// many camera raw files use a TIFF signature ...
 		// ... try to revalidate against FIF_RAW (even if it breaks the code genericity)
-		if (FreeImage_ValidateFIF(FIF_RAW, io, handle)) {
+		if (ValidateNode(plugins->FindFromFIF(FIF_RAW), &windowIO, window)) {
 			deducedFif = FIF_RAW;
 		}
 	}
 
+	io->seek_proc(handle, window.start, SEEK_SET);
+
 	return deducedFif;
 }
 
@@ -25,102 +25,337 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "CPUDispatch.h"
+
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 static const int WHITE = 255;
 static const int BLACK = 0;
 
+// ==========================================================
+// Grey levels of the dithered images
+//
+
+/**
+Evenly spaced grey levels 0..levels-1 of values 0..255 (levels = 2 gives BLACK and WHITE)
+*/
+struct GreyLevels {
+	int levels;
+
+	/// Nearest level of a grey value, that may be out of [0..255], the middle rounds down
+	int Level(int value) const {
+		const int scaled = value * (levels - 1) + (WHITE / 2);
+		return (scaled < 0) ? 0 : std::min(levels - 1, scaled / WHITE);
+	}
+
+	/// Grey value of a level
+	int Value(int level) const {
+		return (level * WHITE + (levels - 1) / 2) / (levels - 1);
+	}
+
+	/// Grey value of the level of value - offset
+	int Quantize(int value, int offset) const {
+		return Value(Level(value - offset));
+	}
+};
+
+// ==========================================================
+// Row kernels
+//
+
+namespace {
+
+	/// Bilevel ordered dithering of a row: WHITE where src >= threshold, BLACK elsewhere
+	using OrderedLineKernel = void (*)(uint8_t *dst, const uint8_t *src, const uint8_t *threshold, unsigned width);
+
+	void OrderedLine(uint8_t *dst, const uint8_t *src, const uint8_t *threshold, unsigned width) {
+		for (unsigned x = 0; x < width; x++) {
+			dst[x] = (src[x] >= threshold[x]) ? WHITE : BLACK;
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+	void OrderedLine_SSE2(uint8_t *dst, const uint8_t *src, const uint8_t *threshold, unsigned width) {
+		unsigned x = 0;
+		for (; x + 16 <= width; x += 16) {
+			const __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+			const __m128i t = _mm_loadu_si128((const __m128i *)(threshold + x));
+			// max(s, t) == s <=> s >= t, the comparison mask is the WHITE / BLACK value
+			_mm_storeu_si128((__m128i *)(dst + x), _mm_cmpeq_epi8(_mm_max_epu8(s, t), s));
+		}
+		OrderedLine(dst + x, src + x, threshold + x, width - x);
+	}
+#endif
+
+#if FREEIMAGE_SIMD_NEON
+	void OrderedLine_NEON(uint8_t *dst, const uint8_t *src, const uint8_t *threshold, unsigned width) {
+		unsigned x = 0;
+		for (; x + 16 <= width; x += 16) {
+			vst1q_u8(dst + x, vcgeq_u8(vld1q_u8(src + x), vld1q_u8(threshold + x)));
+		}
+		OrderedLine(dst + x, src + x, threshold + x, width - x);
+	}
+#endif
+
+	/// Packs a row to 1-bit, MSB first: bit x is set where src >= threshold
+	using ThresholdLineKernel = void (*)(uint8_t *dst, const uint8_t *src, const uint8_t *threshold, unsigned width);
+
+	void ThresholdLine(uint8_t *dst, const uint8_t *src, const uint8_t *threshold, unsigned width) {
+		for (unsigned x = 0; x < width; x += 8) {
+			const unsigned count = std::min(8u, width - x);
+			unsigned byte = 0;
+			for (unsigned i = 0; i < count; i++) {
+				byte |= (src[x + i] >= threshold[x + i]) ? (0x80 >> i) : 0;
+			}
+			dst[x >> 3] = (uint8_t)byte;
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+	/// Bit reversal of a byte, movemask gives the first pixel in the lowest bit
+	struct ReversedBits {
+		uint8_t table[256];
+
+		ReversedBits() {
+			for (unsigned i = 0; i < 256; i++) {
+				unsigned r = 0;
+				for (unsigned b = 0; b < 8; b++) {
+					r |= ((i >> b) & 1) << (7 - b);
+				}
+				table[i] = (uint8_t)r;
+			}
+		}
+	};
+
+	const ReversedBits gReversedBits;
+
+	void ThresholdLine_SSE2(uint8_t *dst, const uint8_t *src, const uint8_t *threshold, unsigned width) {
+		unsigned x = 0;
+		for (; x + 16 <= width; x += 16) {
+			const __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+			const __m128i t = _mm_loadu_si128((const __m128i *)(threshold + x));
+			const unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(s, t), s));
+			dst[x >> 3] = gReversedBits.table[mask & 0xFF];
+			dst[(x >> 3) + 1] = gReversedBits.table[mask >> 8];
+		}
+		ThresholdLine(dst + (x >> 3), src + x, threshold + x, width - x);
+	}
+#endif
+
+#if FREEIMAGE_SIMD_NEON
+	void ThresholdLine_NEON(uint8_t *dst, const uint8_t *src, const uint8_t *threshold, unsigned width) {
+		static const uint8_t weights[16] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+		const uint8x16_t w = vld1q_u8(weights);
+		unsigned x = 0;
+		for (; x + 16 <= width; x += 16) {
+			const uint8x16_t bits = vandq_u8(vcgeq_u8(vld1q_u8(src + x), vld1q_u8(threshold + x)), w);
+			// three pairwise additions sum the bits of each half into a byte
+			uint8x8_t sum = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+			sum = vpadd_u8(sum, sum);
+			sum = vpadd_u8(sum, sum);
+			dst[x >> 3] = vget_lane_u8(sum, 0);
+			dst[(x >> 3) + 1] = vget_lane_u8(sum, 1);
+		}
+		ThresholdLine(dst + (x >> 3), src + x, threshold + x, width - x);
+	}
+#endif
+
+	std::atomic<OrderedLineKernel> gOrderedLine{ OrderedLine };
+	std::atomic<ThresholdLineKernel> gThresholdLine{ ThresholdLine };
+
+	void SelectHalftoningKernels(unsigned features) {
+		OrderedLineKernel ordered = OrderedLine;
+		ThresholdLineKernel threshold = ThresholdLine;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			ordered = OrderedLine_SSE2;
+			threshold = ThresholdLine_SSE2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			ordered = OrderedLine_NEON;
+			threshold = ThresholdLine_NEON;
+		}
+#endif
+		gOrderedLine.store(ordered, std::memory_order_relaxed);
+		gThresholdLine.store(threshold, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectHalftoningKernels);
+
+} // namespace
+
+// ==========================================================
 // Floyd & Steinberg error diffusion dithering
 // This algorithm use the following filter
 //          *   7
 //      3   5   1     (1/16)
-static FIBITMAP* FloydSteinberg(FIBITMAP *dib) {
+//
+// Borders are dithered first with a random threshold, in a fixed order. The interior pixel (x, y) then depends on
+// the errors of row y - 1 up to x + 1, so rows run concurrently in a diagonal wavefront: threads claim rows in
+// order and each row trails the previous one, waiting for its published progress. A row only waits for rows claimed
+// before it, which are being processed, and a single thread claims all rows in turn, so the schedule cannot stall.
+// The result does not depend on the number of threads.
+//
+static FIBITMAP* FloydSteinberg(FIBITMAP *dib, const GreyLevels &grey) {
 
 #define RAND(RN) (((seed = 1103515245 * seed + 12345) >> 12) % (RN))
-#define INITERR(X, Y) (((int) X) - (((int) Y) ? WHITE : BLACK) + ((WHITE/2)-((int)X)) / 2)
+#define INITERR(X, Y) (((int) X) - ((int) Y) + ((WHITE/2)-((int)X)) / (2 * (grey.levels - 1)))
 
 	int seed = 0;
 	int x, y, p, pixel, threshold, error;
-	uint8_t *bits, *new_bits;
+	const uint8_t *bits;
+	uint8_t *new_bits;
 	FIBITMAP *new_dib{};
 
 	// allocate a 8-bit DIB
 	const int width = FreeImage_GetWidth(dib);
 	const int height = FreeImage_GetHeight(dib);
-	const int pitch = FreeImage_GetPitch(dib);
 	new_dib = FreeImage_Allocate(width, height, 8);
 	if (!new_dib) return nullptr;
 
-	// allocate space for error arrays
-	int *lerr = (int*)malloc (width * sizeof(int));
-	int *cerr = (int*)malloc (width * sizeof(int));
-	memset(lerr, 0, width * sizeof(int));
-	memset(cerr, 0, width * sizeof(int));
+	// rows in flight never exceed the number of lanes, a ring of lanes + 2 error rows is never overwritten too early
+	const unsigned lanes = std::max(1u, FreeImage_GetThreadCount());
+	const unsigned ring = lanes + 2;
+	std::vector<int> errors((size_t)ring * width);
+	std::vector<std::atomic<int>> progress(height);
 
 	// left border
 	error = 0;
 	for (y = 0; y < height; y++) {
-		bits = FreeImage_GetScanLine(dib, y);
+		bits = FreeImage_GetConstScanLine(dib, y);
 		new_bits = FreeImage_GetScanLine(new_dib, y);
 
 		threshold = (WHITE / 2 + RAND(129) - 64);
 		pixel = bits[0] + error;
-		p = (pixel > threshold) ? WHITE : BLACK;
+		p = grey.Quantize(pixel, threshold - WHITE / 2);
 		error = pixel - p;
 		new_bits[0] = (uint8_t)p;
 	}
 	// right border
 	error = 0;
 	for (y = 0; y < height; y++) {
-		bits = FreeImage_GetScanLine(dib, y);
+		bits = FreeImage_GetConstScanLine(dib, y);
 		new_bits = FreeImage_GetScanLine(new_dib, y);
 
 		threshold = (WHITE / 2 + RAND(129) - 64);
 		pixel = bits[width-1] + error;
-		p = (pixel > threshold) ? WHITE : BLACK;
+		p = grey.Quantize(pixel, threshold - WHITE / 2);
 		error = pixel - p;
 		new_bits[width-1] = (uint8_t)p;
 	}
 	// top border
-	bits = FreeImage_GetBits(dib);
+	bits = FreeImage_GetConstBits(dib);
 	new_bits = FreeImage_GetBits(new_dib);
+	int *lerr = errors.data();
 	error = 0;
 	for (x = 0; x < width; x++) {
 		threshold = (WHITE / 2 + RAND(129) - 64);
 		pixel = bits[x] + error;
-		p = (pixel > threshold) ? WHITE : BLACK;
+		p = grey.Quantize(pixel, threshold - WHITE / 2);
 		error = pixel - p;
 		new_bits[x] = (uint8_t)p;
 		lerr[x] = INITERR(bits[x], p);
 	}
+	progress[0].store(width, std::memory_order_relaxed);
 
 	// interior bits
-	for (y = 1; y < height; y++) {
-		// scan left to right
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
+	const int chunk = 64;
+	std::atomic<int> next_row{ 1 };
 
-	    cerr[0] = INITERR(bits[0], new_bits[0]);
-		for (x = 1; x < width - 1; x++) {
-			error = (lerr[x-1] + 5 * lerr[x] + 3 * lerr[x+1] + 7 * cerr[x-1]) / 16;
-			pixel = bits[x] + error;
-			if (pixel > (WHITE / 2)) {
-				new_bits[x] = WHITE;
-				cerr[x] = pixel - WHITE; 
-			} else {
-				new_bits[x] = BLACK;
-				cerr[x] = pixel - BLACK; 
+	auto wait = [&](int row, int count) {
+		while (progress[row].load(std::memory_order_acquire) < count) {
+			std::this_thread::yield();
+		}
+	};
+
+	auto dither_row = [&](int y) {
+		// scan left to right
+		const uint8_t *bits = FreeImage_GetConstScanLine(dib, y);
+		uint8_t *new_bits = FreeImage_GetScanLine(new_dib, y);
+		const int *lerr = errors.data() + (size_t)((y - 1) % ring) * width;
+		int *cerr = errors.data() + (size_t)(y % ring) * width;
+
+		// progress counts the errors of the row available from the left
+		cerr[0] = INITERR(bits[0], new_bits[0]);
+		for (int x0 = 1; x0 < width - 1; x0 += chunk) {
+			const int x1 = std::min(x0 + chunk, width - 1);
+			wait(y - 1, std::min(width, x1 + 1));
+			for (int x = x0; x < x1; x++) {
+				const int error = (lerr[x-1] + 5 * lerr[x] + 3 * lerr[x+1] + 7 * cerr[x-1]) / 16;
+				const int pixel = bits[x] + error;
+				const int p = grey.Quantize(pixel, 0);
+				new_bits[x] = (uint8_t)p;
+				cerr[x] = pixel - p;
 			}
+			progress[y].store(x1, std::memory_order_release);
 		}
-		// set errors for ends of the row
-		cerr[0] = INITERR (bits[0], new_bits[0]);
+		// set errors for ends of the row (the first one is already set, rows below may be reading it)
 		cerr[width - 1] = INITERR (bits[width - 1], new_bits[width - 1]);
 
-		// swap error buffers
-		int *terr = lerr; lerr = cerr; cerr = terr;
+		wait(y - 1, width);
+		progress[y].store(width, std::memory_order_release);
+	};
+
+	ParallelFor(0, lanes, 1, [&](unsigned, unsigned) {
+		for (int y = next_row.fetch_add(1); y < height; y = next_row.fetch_add(1)) {
+			dither_row(y);
+		}
+	});
+
+#undef RAND
+#undef INITERR
+
+	return new_dib;
+}
+
+// ==========================================================
+// Ordered dithering
+//
+
+/**
+Dithers rows with threshold lines of l x width values, row y uses the line y % l: a pixel gets the upper of the two
+levels around it where the fraction of its value between them, in [0..254], is >= threshold.
+With two levels, the fraction is the pixel value itself and rows are compared to their thresholds with SIMD.
+*/
+static FIBITMAP* OrderedDither(FIBITMAP *dib, const std::vector<uint8_t> &thresholds, int l, const GreyLevels &grey) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	FIBITMAP *new_dib = FreeImage_Allocate(width, height, 8);
+	if (!new_dib) return nullptr;
+
+	// lower and upper grey values and fraction of every pixel value
+	uint8_t lower[256], upper[256], fraction[256];
+	for (int i = 0; i < 256; i++) {
+		const int scaled = i * (grey.levels - 1);
+		const int level = scaled / WHITE;
+		lower[i] = (uint8_t)grey.Value(level);
+		upper[i] = (uint8_t)grey.Value(std::min(level + 1, grey.levels - 1));
+		fraction[i] = (uint8_t)(scaled % WHITE);
 	}
 
-	free(lerr);
-	free(cerr);
+	const OrderedLineKernel ordered = gOrderedLine.load(std::memory_order_relaxed);
+
+	ParallelFor(0, height, CalculateBandRows(width), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			const uint8_t *bits = FreeImage_GetConstScanLine(dib, y);
+			uint8_t *new_bits = FreeImage_GetScanLine(new_dib, y);
+			const uint8_t *threshold = thresholds.data() + (size_t)(y % l) * width;
+			if (grey.levels == 2) {
+				ordered(new_bits, bits, threshold, width);
+			} else {
+				for (unsigned x = 0; x < width; x++) {
+					new_bits[x] = (fraction[bits[x]] >= threshold[x]) ? upper[bits[x]] : lower[bits[x]];
+				}
+			}
+		}
+	});
 
 	return new_dib;
 }
@@ -158,42 +393,26 @@ static int dithervalue(int x, int y, int size) {
 
 // Ordered dithering with a Bayer matrix of size 2^order by 2^order
 //
-static FIBITMAP* OrderedDispersedDot(FIBITMAP *dib, int order) {
-	int x, y;
-	uint8_t *bits, *new_bits;
-	FIBITMAP *new_dib{};
-
-	// allocate a 8-bit DIB
+static FIBITMAP* OrderedDispersedDot(FIBITMAP *dib, int order, const GreyLevels &grey) {
 	const int width = FreeImage_GetWidth(dib);
-	const int height = FreeImage_GetHeight(dib);
-	new_dib = FreeImage_Allocate(width, height, 8);
-	if (!new_dib) return nullptr;
 
 	// build the dithering matrix
 	int l = (1 << order);	// square of dither matrix order; the dimensions of the matrix
-	auto *matrix = (uint8_t*)malloc(l*l * sizeof(uint8_t));
+	std::vector<uint8_t> matrix(l*l);
 	for (int i = 0; i < l*l; i++) {
 		// according to "Purdue University: Digital Image Processing Laboratory: Image Halftoning, April 30th, 2006
 		matrix[i] = (uint8_t)( 255 * (((double)dithervalue(i / l, i % l, order) + 0.5) / (l*l)) );
 	}
 
-	// perform the dithering
-	for (y = 0; y < height; y++) {
-		// scan left to right
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
-		for (x = 0; x < width; x++) {
-			if (bits[x] > matrix[(x % l) + l * (y % l)]) {
-				new_bits[x] = WHITE;
-			} else {
-				new_bits[x] = BLACK;
-			}
+	// threshold lines, a pixel is WHITE if bits[x] > matrix[(x % l) + l * (y % l)]
+	std::vector<uint8_t> thresholds((size_t)l * width);
+	for (int y = 0; y < l; y++) {
+		for (int x = 0; x < width; x++) {
+			thresholds[(size_t)y * width + x] = (uint8_t)(matrix[(x % l) + l * y] + 1);
 		}
 	}
 
-	free(matrix);
-
-	return new_dib;
+	return OrderedDither(dib, thresholds, l, grey);
 }
 
 // ==========================================================
@@ -205,9 +424,9 @@ static FIBITMAP* OrderedDispersedDot(FIBITMAP *dib, int order) {
 // See also : The newsprint web site at http://www.cl.cam.ac.uk/~and1000/newsprint/
 // for more technical info on this dithering technique
 //
-static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
+static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order, const GreyLevels &grey) {
 	// Order-3 clustered dithering matrix.
-	int cluster3[] = {
+	static const int cluster3[] = {
 	  9,11,10, 8, 6, 7,
 	  12,17,16, 5, 0, 1,
 	  13,14,15, 4, 3, 2,
@@ -217,7 +436,7 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	};
 
 	// Order-4 clustered dithering matrix. 
-	int cluster4[] = {
+	static const int cluster4[] = {
 	  18,20,19,16,13,11,12,15,
 	  27,28,29,22, 4, 3, 2, 9,
 	  26,31,30,21, 5, 0, 1,10,
@@ -229,7 +448,7 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	};
 
 	// Order-8 clustered dithering matrix. 
-	int cluster8[] = {
+	static const int cluster8[] = {
 	   64, 69, 77, 87, 86, 76, 68, 67, 63, 58, 50, 40, 41, 51, 59, 60,
 	   70, 94,100,109,108, 99, 93, 75, 57, 33, 27, 18, 19, 28, 34, 52,
 	   78,101,114,116,115,112, 98, 83, 49, 26, 13, 11, 12, 15, 29, 44,
@@ -248,18 +467,10 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	   62, 55, 47, 37, 36, 46, 54, 61, 65, 72, 80, 90, 91, 81, 73, 66
 	};
 
-	int x, y, pixel;
-	uint8_t *bits, *new_bits;
-	FIBITMAP *new_dib{};
-
-	// allocate a 8-bit DIB
 	const int width = FreeImage_GetWidth(dib);
-	const int height = FreeImage_GetHeight(dib);
-	new_dib = FreeImage_Allocate(width, height, 8);
-	if (!new_dib) return nullptr;
 
 	// select the dithering matrix
-	int *matrix{};
+	const int *matrix{};
 	switch (order) {
 		case 3:
 			matrix = &cluster3[0];
@@ -274,116 +485,177 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 			return nullptr;
 	}
 
-	// scale the dithering matrix
+	// scale the dithering matrix into threshold lines, a pixel is WHITE if bits[x] >= matrix[(y % l) + l * (x % l)]
 	int l = 2 * order;
 	int scale = 256 / (l * order);
-	for (y = 0; y < l; y++) {
-		for (x = 0; x < l; x++) {
-			matrix[y*l + x] *= scale;
+	std::vector<uint8_t> thresholds((size_t)l * width);
+	for (int y = 0; y < l; y++) {
+		for (int x = 0; x < width; x++) {
+			thresholds[(size_t)y * width + x] = (uint8_t)(matrix[y + l * (x % l)] * scale);
 		}
 	}
 
-	// perform the dithering
-	for (y = 0; y < height; y++) {
-		// scan left to right
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
-		for (x = 0; x < width; x++) {
-			pixel = bits[x];
-			if (pixel >= matrix[(y % l) + l * (x % l)]) {
-				new_bits[x] = WHITE;
+	return OrderedDither(dib, thresholds, l, grey);
+}
+
+// ==========================================================
+// Packing of grey levels into 4-bit or 8-bit palettized images
+//
+static FIBITMAP* PackLevels(FIBITMAP *dib8, const GreyLevels &grey) {
+	const unsigned width = FreeImage_GetWidth(dib8);
+	const unsigned height = FreeImage_GetHeight(dib8);
+	const unsigned bpp = (grey.levels <= 16) ? 4 : 8;
+
+	FIBITMAP *new_dib = FreeImage_Allocate(width, height, bpp);
+	if (!new_dib) return nullptr;
+
+	FIRGBA8 *pal = FreeImage_GetPalette(new_dib);
+	for (int i = 0; i < grey.levels; i++) {
+		pal[i].red = pal[i].green = pal[i].blue = (uint8_t)grey.Value(i);
+	}
+
+	uint8_t level[256];
+	for (int i = 0; i < 256; i++) {
+		level[i] = (uint8_t)grey.Level(i);
+	}
+
+	ParallelFor(0, height, CalculateBandRows(width), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			const uint8_t *bits8 = FreeImage_GetConstScanLine(dib8, y);
+			uint8_t *new_bits = FreeImage_GetScanLine(new_dib, y);
+			if (bpp == 8) {
+				for (unsigned x = 0; x < width; x++) {
+					new_bits[x] = level[bits8[x]];
+				}
 			} else {
-				new_bits[x] = BLACK;
+				for (unsigned x = 0; x < width; x++) {
+					const uint8_t nibble = level[bits8[x]];
+					if (x & 1) {
+						new_bits[x >> 1] |= nibble;
+					} else {
+						new_bits[x >> 1] = (uint8_t)(nibble << 4);
+					}
+				}
 			}
 		}
-	}
+	});
 
 	return new_dib;
 }
 
+// ==========================================================
+// Conversion helpers
+//
+
+/**
+Converts an image to 8-bit greyscale, returns dib itself when it is already greyscale
+*/
+static FIBITMAP* ConvertToGrey8(FIBITMAP *dib) {
+	switch (FreeImage_GetBPP(dib)) {
+		case 8:
+			if (FreeImage_GetColorType(dib) == FIC_MINISBLACK) {
+				return dib;
+			}
+			return FreeImage_ConvertToGreyscale(dib);
+		case 4:
+		case 16:
+		case 24:
+		case 32:
+			return FreeImage_ConvertToGreyscale(dib);
+	}
+	return nullptr;
+}
+
+/**
+Clones a 1-bit image with a monochrome palette
+*/
+static FIBITMAP* CloneMonochrome(FIBITMAP *dib) {
+	// Just clone the dib and adjust the palette if needed
+	FIBITMAP *new_dib = FreeImage_Clone(dib);
+	if (!new_dib) return nullptr;
+	if (FreeImage_GetColorType(new_dib) == FIC_PALETTE) {
+		// Build a monochrome palette
+		FIRGBA8 *pal = FreeImage_GetPalette(new_dib);
+		pal[0].red = pal[0].green = pal[0].blue = 0;
+		pal[1].red = pal[1].green = pal[1].blue = 255;
+	}
+	return new_dib;
+}
 
 // ==========================================================
 // Halftoning function
 //
 FIBITMAP * DLL_CALLCONV
 FreeImage_Dither(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm) {
+	return FreeImage_DitherEx(dib, algorithm, 2);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_DitherEx(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm, unsigned levels) {
 	FIBITMAP *input{}, *dib8{};
 
 	if (!FreeImage_HasPixels(dib)) return nullptr;
+	if ((levels < 2) || (levels > 256)) return nullptr;
 
 	const unsigned bpp = FreeImage_GetBPP(dib);
 
 	if (bpp == 1) {
-		// Just clone the dib and adjust the palette if needed
-		FIBITMAP *new_dib = FreeImage_Clone(dib);
-		if (!new_dib) return nullptr;
-		if (FreeImage_GetColorType(new_dib) == FIC_PALETTE) {
-			// Build a monochrome palette
-			FIRGBA8 *pal = FreeImage_GetPalette(new_dib);
-			pal[0].red = pal[0].green = pal[0].blue = 0;
-			pal[1].red = pal[1].green = pal[1].blue = 255;
-		}
-		return new_dib;
+		if (levels != 2) return nullptr;
+		return CloneMonochrome(dib);
 	}
 
 	// Convert the input dib to a 8-bit greyscale dib
-	//
-	switch (bpp) {
-		case 8:
-			if (FreeImage_GetColorType(dib) == FIC_MINISBLACK) {
-				input = dib;
-			} else {
-				input = FreeImage_ConvertToGreyscale(dib);
-			} 
-			break;
-		case 4:
-		case 16:
-		case 24:
-		case 32:
-			input = FreeImage_ConvertToGreyscale(dib);
-			break;			
-	}
+	input = ConvertToGrey8(dib);
 	if (!input) return nullptr;
 
+	const GreyLevels grey{ (int)levels };
+
 	// Apply the dithering algorithm
 	switch (algorithm) {
 		case FID_FS:
-			dib8 = FloydSteinberg(input);
+			dib8 = FloydSteinberg(input, grey);
 			break;
 		case FID_BAYER4x4:
-			dib8 = OrderedDispersedDot(input, 2);
+			dib8 = OrderedDispersedDot(input, 2, grey);
 			break;
 		case FID_BAYER8x8:
-			dib8 = OrderedDispersedDot(input, 3);
+			dib8 = OrderedDispersedDot(input, 3, grey);
 			break;
 		case FID_BAYER16x16:
-			dib8 = OrderedDispersedDot(input, 4);
+			dib8 = OrderedDispersedDot(input, 4, grey);
 			break;
 		case FID_CLUSTER6x6:
-			dib8 = OrderedClusteredDot(input, 3);
+			dib8 = OrderedClusteredDot(input, 3, grey);
 			break;
 		case FID_CLUSTER8x8:
-			dib8 = OrderedClusteredDot(input, 4);
+			dib8 = OrderedClusteredDot(input, 4, grey);
 			break;
 		case FID_CLUSTER16x16:
-			dib8 = OrderedClusteredDot(input, 8);
+			dib8 = OrderedClusteredDot(input, 8, grey);
 			break;
 	}
 	if (input != dib) {
 		FreeImage_Unload(input);
 	}
+	if (!dib8) return nullptr;
 
-	// Build a greyscale palette (needed by threshold)
-	FIRGBA8 *grey_pal = FreeImage_GetPalette(dib8);
-	for (int i = 0; i < 256; i++) {
-		grey_pal[i].red	= (uint8_t)i;
-		grey_pal[i].green = (uint8_t)i;
-		grey_pal[i].blue	= (uint8_t)i;
-	}
+	FIBITMAP *new_dib{};
+	if (levels == 2) {
+		// Build a greyscale palette (needed by threshold)
+		FIRGBA8 *grey_pal = FreeImage_GetPalette(dib8);
+		for (int i = 0; i < 256; i++) {
+			grey_pal[i].red	= (uint8_t)i;
+			grey_pal[i].green = (uint8_t)i;
+			grey_pal[i].blue	= (uint8_t)i;
+		}
 
-	// Convert to 1-bit
-	FIBITMAP *new_dib = FreeImage_Threshold(dib8, 128);
+		// Convert to 1-bit
+		new_dib = FreeImage_Threshold(dib8, 128);
+	} else {
+		new_dib = PackLevels(dib8, grey);
+	}
 	FreeImage_Unload(dib8);
+	if (!new_dib) return nullptr;
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(new_dib, dib);
@@ -392,80 +664,247 @@ FreeImage_Dither(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm) {
 }
 
 // ==========================================================
-// Thresholding function
+// Thresholding functions
 //
+
+/**
+Packs a greyscale image to a new 1-bit image, threshold(y, line) returns the width threshold values of row y,
+either its own or written to line. Rows are processed by parallel bands
+*/
+template <typename Threshold_>
+static FIBITMAP* PackThreshold(FIBITMAP *dib8, const Threshold_ &threshold) {
+	const unsigned width = FreeImage_GetWidth(dib8);
+	const unsigned height = FreeImage_GetHeight(dib8);
+
+	FIBITMAP *new_dib = FreeImage_Allocate(width, height, 1);
+	if (!new_dib) return nullptr;
+	// Build a monochrome palette
+	FIRGBA8 *pal = FreeImage_GetPalette(new_dib);
+	pal[0].red = pal[0].green = pal[0].blue = 0;
+	pal[1].red = pal[1].green = pal[1].blue = 255;
+
+	const ThresholdLineKernel pack = gThresholdLine.load(std::memory_order_relaxed);
+
+	ParallelFor(0, height, CalculateBandRows(width), [&](unsigned first, unsigned last) {
+		std::vector<uint8_t> line(width);
+		for (unsigned y = first; y < last; y++) {
+			pack(FreeImage_GetScanLine(new_dib, y), FreeImage_GetConstScanLine(dib8, y), threshold(y, line.data()), width);
+		}
+	});
+
+	return new_dib;
+}
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_Threshold(FIBITMAP *dib, uint8_t T) {
-	FIBITMAP *dib8{};
-
 	if (!FreeImage_HasPixels(dib)) return nullptr;
 
-	const unsigned bpp = FreeImage_GetBPP(dib);
+	if (FreeImage_GetBPP(dib) == 1) {
+		return CloneMonochrome(dib);
+	}
 
-	if (bpp == 1) {
-		// Just clone the dib and adjust the palette if needed
-		FIBITMAP *new_dib = FreeImage_Clone(dib);
-		if (!new_dib) return nullptr;
-		if (FreeImage_GetColorType(new_dib) == FIC_PALETTE) {
-			// Build a monochrome palette
-			FIRGBA8 *pal = FreeImage_GetPalette(new_dib);
-			pal[0].red = pal[0].green = pal[0].blue = 0;
-			pal[1].red = pal[1].green = pal[1].blue = 255;
+	// Convert the input dib to a 8-bit greyscale dib
+	FIBITMAP *dib8 = ConvertToGrey8(dib);
+	if (!dib8) return nullptr;
+
+	// Perform the thresholding, a pixel is white if >= T
+	const std::vector<uint8_t> thresholds(FreeImage_GetWidth(dib), T);
+	FIBITMAP *new_dib = PackThreshold(dib8, [&thresholds](unsigned, uint8_t *) {
+		return thresholds.data();
+	});
+	if (dib8 != dib) {
+		FreeImage_Unload(dib8);
+	}
+	if (!new_dib) return nullptr;
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(new_dib, dib);
+
+	return new_dib;
+}
+
+// ==========================================================
+// Adaptive binarization
+//
+
+/**
+Histogram of a greyscale image, pixels are counted by parallel bands of scanlines
+*/
+static void GreyHistogram(FIBITMAP *dib8, uint32_t *histo) {
+	const unsigned width = FreeImage_GetWidth(dib8);
+	const unsigned height = FreeImage_GetHeight(dib8);
+	const unsigned threads = std::max(1u, FreeImage_GetThreadCount());
+	const unsigned grain = std::max(CalculateBandRows(width), (height + threads - 1) / threads);
+
+	std::fill(histo, histo + 256, 0);
+	std::mutex mutex;
+	ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+		uint32_t local[256] = {};
+		for (unsigned y = first; y < last; y++) {
+			const uint8_t *bits = FreeImage_GetConstScanLine(dib8, y);
+			for (unsigned x = 0; x < width; x++) {
+				++local[bits[x]];
+			}
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		for (unsigned i = 0; i < 256; i++) {
+			histo[i] += local[i];
 		}
-		return new_dib;
+	});
+}
+
+/**
+Otsu threshold of a histogram: the first level of the upper class that maximizes the between-class variance
+*/
+static uint8_t OtsuThreshold(const uint32_t *histo) {
+	double total = 0, sum = 0;
+	for (int i = 0; i < 256; i++) {
+		total += histo[i];
+		sum += (double)i * histo[i];
 	}
 
-	// Convert the input dib to a 8-bit greyscale dib
-	//
-	switch (bpp) {
-		case 8:
-			if (FreeImage_GetColorType(dib) == FIC_MINISBLACK) {
-				dib8 = dib;
-			} else {
-				dib8 = FreeImage_ConvertToGreyscale(dib);
-			} 
-			break;
-		case 4:
-		case 16:
-		case 24:
-		case 32:
-			dib8 = FreeImage_ConvertToGreyscale(dib);
-			break;
+	double best = -1, lower_count = 0, lower_sum = 0;
+	int threshold = 0;
+	for (int t = 0; t < 255; t++) {
+		lower_count += histo[t];
+		lower_sum += (double)t * histo[t];
+		const double upper_count = total - lower_count;
+		if ((lower_count == 0) || (upper_count == 0)) {
+			continue;
+		}
+		const double delta = lower_sum / lower_count - (sum - lower_sum) / upper_count;
+		const double variance = lower_count * upper_count * delta * delta;
+		if (variance > best) {
+			best = variance;
+			threshold = t + 1;
+		}
+	}
+	return (uint8_t)threshold;
+}
+
+/**
+Integral images of the values and squared values of a greyscale image, of (width + 1) x (height + 1) sums.
+Sums wrap around modulo 2^32, which keeps the sums of windows up to 257 x 257 pixels exact.
+Rows are summed by parallel bands, then columns are accumulated by parallel bands of columns.
+*/
+struct IntegralImages {
+	unsigned stride;
+	std::vector<uint32_t> sum, squares;
+
+	explicit IntegralImages(FIBITMAP *dib8)
+	: stride(FreeImage_GetWidth(dib8) + 1) {
+		const unsigned width = FreeImage_GetWidth(dib8);
+		const unsigned height = FreeImage_GetHeight(dib8);
+
+		sum.assign((size_t)stride * (height + 1), 0);
+		squares.assign((size_t)stride * (height + 1), 0);
+
+		ParallelFor(0, height, CalculateBandRows(width), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				const uint8_t *bits = FreeImage_GetConstScanLine(dib8, y);
+				uint32_t *s = sum.data() + (size_t)stride * (y + 1);
+				uint32_t *q = squares.data() + (size_t)stride * (y + 1);
+				for (unsigned x = 0; x < width; x++) {
+					s[x + 1] = s[x] + bits[x];
+					q[x + 1] = q[x] + (uint32_t)bits[x] * bits[x];
+				}
+			}
+		});
+		ParallelFor(1, stride, CalculateBandRows((size_t)height * sizeof(uint32_t)), [&](unsigned first, unsigned last) {
+			for (unsigned y = 1; y <= height; y++) {
+				uint32_t *s = sum.data() + (size_t)stride * y;
+				uint32_t *q = squares.data() + (size_t)stride * y;
+				const uint32_t *s_above = s - stride;
+				const uint32_t *q_above = q - stride;
+				for (unsigned x = first; x < last; x++) {
+					s[x] += s_above[x];
+					q[x] += q_above[x];
+				}
+			}
+		});
+	}
+
+	/// Sum of the window [x0, x1) x [y0, y1)
+	static uint32_t Window(const std::vector<uint32_t> &integral, unsigned stride, unsigned x0, unsigned y0, unsigned x1, unsigned y1) {
+		const uint32_t *top = integral.data() + (size_t)stride * y0;
+		const uint32_t *bottom = integral.data() + (size_t)stride * y1;
+		return bottom[x1] - bottom[x0] - top[x1] + top[x0];
 	}
+};
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_Binarize(FIBITMAP *dib, FREE_IMAGE_BINARIZE method, unsigned window, double k) {
+	if (!FreeImage_HasPixels(dib)) return nullptr;
+
+	if ((method != FIB_OTSU) && ((window < 3) || (window > 257))) return nullptr;
+
+	if (FreeImage_GetBPP(dib) == 1) {
+		return CloneMonochrome(dib);
+	}
+
+	// Convert the input dib to a 8-bit greyscale dib
+	FIBITMAP *dib8 = ConvertToGrey8(dib);
 	if (!dib8) return nullptr;
 
-	// Allocate a new 1-bit DIB
-	const int width = FreeImage_GetWidth(dib);
-	const int height = FreeImage_GetHeight(dib);
-	FIBITMAP *new_dib = FreeImage_Allocate(width, height, 1);
-	if (!new_dib) return nullptr;
-	// Build a monochrome palette
-	FIRGBA8 *pal = FreeImage_GetPalette(new_dib);
-	pal[0].red = pal[0].green = pal[0].blue = 0;
-	pal[1].red = pal[1].green = pal[1].blue = 255;
+	const unsigned width = FreeImage_GetWidth(dib8);
+	const unsigned height = FreeImage_GetHeight(dib8);
+	const unsigned radius = window / 2;
 
-	// Perform the thresholding
-	//
-	for (int y = 0; y < height; y++) {
-		const uint8_t *bits8 = FreeImage_GetScanLine(dib8, y);
-		uint8_t *bits1 = FreeImage_GetScanLine(new_dib, y);
-		for (int x = 0; x < width; x++) {
-			if (bits8[x] < T) {
-				// Set bit(x, y) to 0
-				bits1[x >> 3] &= (0xFF7F >> (x & 0x7));
-			} else {
-				// Set bit(x, y) to 1
-				bits1[x >> 3] |= (0x80 >> (x & 0x7));
+	FIBITMAP *new_dib{};
+
+	try {
+		switch (method) {
+			case FIB_OTSU:
+			{
+				uint32_t histo[256];
+				GreyHistogram(dib8, histo);
+				const std::vector<uint8_t> thresholds(width, OtsuThreshold(histo));
+				new_dib = PackThreshold(dib8, [&thresholds](unsigned, uint8_t *) {
+					return thresholds.data();
+				});
+				break;
+			}
+			case FIB_MEAN:
+			case FIB_SAUVOLA:
+			{
+				const IntegralImages integral(dib8);
+				const bool sauvola = (method == FIB_SAUVOLA);
+				new_dib = PackThreshold(dib8, [&](unsigned y, uint8_t *line) -> const uint8_t * {
+					const unsigned y0 = (y > radius) ? y - radius : 0;
+					const unsigned y1 = std::min(height, y + radius + 1);
+					for (unsigned x = 0; x < width; x++) {
+						const unsigned x0 = (x > radius) ? x - radius : 0;
+						const unsigned x1 = std::min(width, x + radius + 1);
+						const double count = (double)(x1 - x0) * (y1 - y0);
+						const double mean = IntegralImages::Window(integral.sum, integral.stride, x0, y0, x1, y1) / count;
+						double T{};
+						if (sauvola) {
+							// T = m (1 + k (s / R - 1)) with R = 128, the dynamic range of the standard deviation
+							const double variance = IntegralImages::Window(integral.squares, integral.stride, x0, y0, x1, y1) / count - mean * mean;
+							T = mean * (1 + k * (std::sqrt(std::max(0.0, variance)) / 128 - 1));
+						} else {
+							// T = m (1 - k)
+							T = mean * (1 - k);
+						}
+						// a pixel is white if > T
+						line[x] = (uint8_t)std::clamp((int)std::floor(T) + 1, 0, 255);
+					}
+					return static_cast<const uint8_t *>(line);
+				});
+				break;
 			}
 		}
+	} catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
 	}
+
 	if (dib8 != dib) {
 		FreeImage_Unload(dib8);
 	}
+	if (!new_dib) return nullptr;
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(new_dib, dib);
 
 	return new_dib;
 }
-
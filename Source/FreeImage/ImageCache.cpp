@@ -0,0 +1,473 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "FreeImageIO.h"
+#include "Utilities.h"
+#include "MappedFile.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    constexpr uint32_t kFileMagic = 0x4349'4946;   // "FIIC"
+
+    uint64_t Hash64(const void* data, size_t size, uint64_t hash = 0xCBF2'9CE4'8422'2325ull)
+    {
+        // FNV-1a
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 0x0000'0100'0000'01B3ull;
+        }
+        return hash;
+    }
+
+    struct CacheEntry
+    {
+        std::string key;
+        FIBITMAP* dib;
+        size_t bytes;
+    };
+
+    /**
+     * LRU list of the bitmaps in memory, most recently used first, indexed by key
+     */
+    struct ImageCache
+    {
+        std::mutex mutex;
+        uint64_t maxBytes;
+        uint64_t bytes{ 0 };
+        std::list<CacheEntry> lru;
+        std::unordered_map<std::string, std::list<CacheEntry>::iterator> index;
+
+        FI_ImageCacheStoreProc store{ nullptr };
+        FI_ImageCacheFetchProc fetch{ nullptr };
+        void* userData{ nullptr };
+        std::filesystem::path directory;
+
+        std::atomic<uint64_t> hits{ 0 };
+        std::atomic<uint64_t> storageHits{ 0 };
+        std::atomic<uint64_t> misses{ 0 };
+        std::atomic<uint64_t> evictions{ 0 };
+
+        explicit ImageCache(uint64_t max_bytes)
+            : maxBytes(max_bytes)
+        { }
+
+        ~ImageCache() {
+            for (auto& entry : lru) {
+                FreeImage_Unload(entry.dib);
+            }
+        }
+    };
+
+    ImageCache* ToCache(FIIMAGECACHE* cache)
+    {
+        return cache ? static_cast<ImageCache*>(cache->data) : nullptr;
+    }
+
+    // ----------------------------------------------------------
+    //   Directory storage
+    // ----------------------------------------------------------
+
+    std::filesystem::path EntryPath(const std::filesystem::path& directory, const std::string& key)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.fic", (unsigned long long)Hash64(key.data(), key.size()));
+        return directory / name;
+    }
+
+    /**
+     * File layout: magic, key length, key, raw bitmap (see FreeImage_EncodeRawBitmap).
+     * Written to a temporary file renamed at the end, so that readers never see a partial file.
+     */
+    bool WriteEntryFile(const std::filesystem::path& directory, const std::string& key, FIBITMAP* dib)
+    {
+        std::vector<uint8_t> buffer;
+        try {
+            const uint32_t header[2] = { kFileMagic, static_cast<uint32_t>(key.size()) };
+            buffer.insert(buffer.end(), reinterpret_cast<const uint8_t*>(header), reinterpret_cast<const uint8_t*>(header + 2));
+            buffer.insert(buffer.end(), key.begin(), key.end());
+            FreeImage_EncodeRawBitmap(dib, buffer);
+        }
+        catch (const std::bad_alloc&) {
+            FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+            return false;
+        }
+
+        const std::filesystem::path target = EntryPath(directory, key);
+        std::filesystem::path temporary = target;
+        temporary += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file || !file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size())) {
+                file.close();
+                std::error_code ec;
+                std::filesystem::remove(temporary, ec);
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temporary, target, ec);
+        if (ec) {
+            std::filesystem::remove(temporary, ec);
+            return false;
+        }
+        return true;
+    }
+
+    FIBITMAP* ReadEntryFile(const std::filesystem::path& directory, const std::string& key)
+    {
+        const MappedFile file(EntryPath(directory, key).native().c_str());
+        const uint8_t* data = file.data();
+        const size_t size = file.size();
+        if (!data || size < 2 * sizeof(uint32_t)) {
+            return nullptr;
+        }
+        uint32_t header[2];
+        memcpy(header, data, sizeof(header));
+        if (header[0] != kFileMagic || header[1] != key.size() || size - sizeof(header) < key.size()) {
+            return nullptr;
+        }
+        // different keys may hash to the same file
+        if (memcmp(data + sizeof(header), key.data(), key.size()) != 0) {
+            return nullptr;
+        }
+        const size_t offset = sizeof(header) + key.size();
+        return FreeImage_DecodeRawBitmap(data + offset, size - offset);
+    }
+
+    // ----------------------------------------------------------
+
+    /**
+     * Sends evicted bitmaps to the storage and releases them, without the lock held
+     */
+    void Retire(ImageCache* cache, std::vector<CacheEntry>& evicted, FI_ImageCacheStoreProc store, void* userData, const std::filesystem::path& directory)
+    {
+        for (auto& entry : evicted) {
+            if (store) {
+                store(entry.key.c_str(), entry.dib, userData);
+            }
+            else if (!directory.empty()) {
+                WriteEntryFile(directory, entry.key, entry.dib);
+            }
+            FreeImage_Unload(entry.dib);
+        }
+        cache->evictions.fetch_add(evicted.size(), std::memory_order_relaxed);
+    }
+
+    /**
+     * Takes ownership of dib and returns a share of it, or dib itself if it doesn't fit in memory
+     */
+    FIBITMAP* Insert(ImageCache* cache, const std::string& key, FIBITMAP* dib)
+    {
+        const size_t bytes = FreeImage_GetMemorySize(dib);
+        std::vector<CacheEntry> evicted;
+        FI_ImageCacheStoreProc store;
+        void* userData;
+        std::filesystem::path directory;
+        FIBITMAP* share = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(cache->mutex);
+            store = cache->store;
+            userData = cache->userData;
+            directory = cache->directory;
+
+            auto found = cache->index.find(key);
+            if (found != cache->index.end()) {
+                cache->bytes -= found->second->bytes;
+                evicted.push_back(std::move(*found->second));
+                cache->lru.erase(found->second);
+                cache->index.erase(found);
+            }
+            if (bytes <= cache->maxBytes) {
+                share = FreeImage_Clone(dib);
+            }
+            if (share) {
+                try {
+                    cache->lru.push_front(CacheEntry{ key, dib, bytes });
+                    try {
+                        cache->index.emplace(key, cache->lru.begin());
+                    }
+                    catch (...) {
+                        cache->lru.pop_front();
+                        throw;
+                    }
+                    cache->bytes += bytes;
+                }
+                catch (const std::bad_alloc&) {
+                    FreeImage_Unload(share);
+                    share = nullptr;
+                }
+            }
+            while (cache->bytes > cache->maxBytes && !cache->lru.empty()) {
+                CacheEntry& last = cache->lru.back();
+                cache->bytes -= last.bytes;
+                cache->index.erase(last.key);
+                evicted.push_back(std::move(last));
+                cache->lru.pop_back();
+            }
+        }
+        // a replaced bitmap is outdated, it isn't sent to the storage
+        if (!evicted.empty() && evicted.front().key == key) {
+            FreeImage_Unload(evicted.front().dib);
+            evicted.erase(evicted.begin());
+        }
+        Retire(cache, evicted, store, userData, directory);
+        if (!share) {
+            // too large for the memory, goes to the storage only
+            if (store) {
+                store(key.c_str(), dib, userData);
+            }
+            else if (!directory.empty()) {
+                WriteEntryFile(directory, key, dib);
+            }
+            return dib;
+        }
+        return share;
+    }
+
+    /**
+     * Looks for key in memory then in the storage, returns a share or NULL
+     */
+    FIBITMAP* Lookup(ImageCache* cache, const std::string& key)
+    {
+        FI_ImageCacheFetchProc fetch;
+        void* userData;
+        std::filesystem::path directory;
+        {
+            std::lock_guard<std::mutex> lock(cache->mutex);
+            auto found = cache->index.find(key);
+            if (found != cache->index.end()) {
+                cache->lru.splice(cache->lru.begin(), cache->lru, found->second);
+                FIBITMAP* share = FreeImage_Clone(found->second->dib);
+                if (share) {
+                    cache->hits.fetch_add(1, std::memory_order_relaxed);
+                }
+                return share;
+            }
+            fetch = cache->fetch;
+            userData = cache->userData;
+            directory = cache->directory;
+        }
+        // concurrent misses on a key may fetch it twice, the last one inserted wins
+        FIBITMAP* dib = nullptr;
+        if (fetch) {
+            dib = fetch(key.c_str(), userData);
+        }
+        else if (!directory.empty()) {
+            dib = ReadEntryFile(directory, key);
+        }
+        if (!dib) {
+            cache->misses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        cache->storageHits.fetch_add(1, std::memory_order_relaxed);
+        return Insert(cache, key, dib);
+    }
+
+    /**
+     * Appends the part of a key common to file and memory loads
+     */
+    void AppendLoadKey(std::string& key, FREE_IMAGE_FORMAT fif, unsigned max_width, unsigned max_height, int flags)
+    {
+        char suffix[64];
+        snprintf(suffix, sizeof(suffix), "|%d|%d|%ux%u", static_cast<int>(fif), flags, max_width, max_height);
+        key += suffix;
+    }
+
+} // namespace
+
+
+// ==========================================================
+//   Public API
+// ==========================================================
+
+FIIMAGECACHE* DLL_CALLCONV
+FreeImage_CreateImageCache(uint64_t max_bytes)
+{
+    auto* cache = new(std::nothrow) FIIMAGECACHE;
+    if (cache) {
+        cache->data = new(std::nothrow) ImageCache(max_bytes);
+        if (cache->data) {
+            return cache;
+        }
+        delete cache;
+    }
+    FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+    return nullptr;
+}
+
+void DLL_CALLCONV
+FreeImage_DeleteImageCache(FIIMAGECACHE* cache)
+{
+    if (cache) {
+        delete ToCache(cache);
+        delete cache;
+    }
+}
+
+void DLL_CALLCONV
+FreeImage_SetImageCacheStorage(FIIMAGECACHE* cache, FI_ImageCacheStoreProc store, FI_ImageCacheFetchProc fetch, void* user_data)
+{
+    if (ImageCache* impl = ToCache(cache)) {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        impl->store = store;
+        impl->fetch = fetch;
+        impl->userData = user_data;
+        impl->directory.clear();
+    }
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_SetImageCacheDirectory(FIIMAGECACHE* cache, const char* path)
+{
+    ImageCache* impl = ToCache(cache);
+    if (!impl || !path) {
+        return FALSE;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(path, ec);
+    if (ec || !std::filesystem::is_directory(path, ec)) {
+        FreeImage_OutputMessageProc(FIF_UNKNOWN, "Can't use %s as image cache directory", path);
+        return FALSE;
+    }
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->store = nullptr;
+    impl->fetch = nullptr;
+    impl->userData = nullptr;
+    impl->directory = path;
+    return TRUE;
+}
+
+FIBITMAP* DLL_CALLCONV
+FreeImage_GetCachedImage(FIIMAGECACHE* cache, const char* key)
+{
+    ImageCache* impl = ToCache(cache);
+    if (!impl || !key) {
+        return nullptr;
+    }
+    return Lookup(impl, key);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PutCachedImage(FIIMAGECACHE* cache, const char* key, FIBITMAP* dib)
+{
+    ImageCache* impl = ToCache(cache);
+    if (!impl || !key || !dib) {
+        return FALSE;
+    }
+    FIBITMAP* owned = FreeImage_Clone(dib);
+    if (!owned) {
+        return FALSE;
+    }
+    FIBITMAP* share = Insert(impl, key, owned);
+    FreeImage_Unload(share);
+    return TRUE;
+}
+
+FIBITMAP* DLL_CALLCONV
+FreeImage_LoadCached(FIIMAGECACHE* cache, FREE_IMAGE_FORMAT fif, const char* filename, unsigned max_width, unsigned max_height, int flags)
+{
+    ImageCache* impl = ToCache(cache);
+    if (!impl || !filename) {
+        return nullptr;
+    }
+    std::error_code ec;
+    const uintmax_t size = std::filesystem::file_size(filename, ec);
+    if (ec) {
+        FreeImage_OutputMessageProc(fif, "FreeImage_LoadCached: failed to open file %s", filename);
+        return nullptr;
+    }
+    const auto mtime = std::filesystem::last_write_time(filename, ec).time_since_epoch().count();
+    if (fif == FIF_UNKNOWN) {
+        fif = FreeImage_GetFileType(filename);
+    }
+
+    std::string key;
+    try {
+        key = "file:" + std::string(filename) + ":" + std::to_string(size) + ":" + std::to_string(mtime);
+        AppendLoadKey(key, fif, max_width, max_height, flags);
+    }
+    catch (const std::bad_alloc&) {
+        FreeImage_OutputMessageProcEx(fif, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+        return nullptr;
+    }
+    if (FIBITMAP* dib = Lookup(impl, key)) {
+        return dib;
+    }
+    FIBITMAP* dib = (max_width && max_height)
+        ? FreeImage_LoadScaled(fif, filename, max_width, max_height, flags)
+        : FreeImage_Load(fif, filename, flags);
+    return dib ? Insert(impl, key, dib) : nullptr;
+}
+
+FIBITMAP* DLL_CALLCONV
+FreeImage_LoadFromMemoryCached(FIIMAGECACHE* cache, FREE_IMAGE_FORMAT fif, FIMEMORY* stream, unsigned max_width, unsigned max_height, int flags)
+{
+    ImageCache* impl = ToCache(cache);
+    uint8_t* data = nullptr;
+    uint32_t size = 0;
+    if (!impl || !stream || !FreeImage_AcquireMemory(stream, &data, &size)) {
+        return nullptr;
+    }
+    const long position = FreeImage_TellMemory(stream);
+    if (position < 0 || static_cast<uint32_t>(position) > size) {
+        return nullptr;
+    }
+    const uint64_t hash = Hash64(data + position, size - position);
+    if (fif == FIF_UNKNOWN) {
+        fif = FreeImage_GetFileTypeFromMemory(stream);
+    }
+
+    std::string key;
+    try {
+        char prefix[64];
+        snprintf(prefix, sizeof(prefix), "mem:%016llx:%u", (unsigned long long)hash, size - static_cast<uint32_t>(position));
+        key = prefix;
+        AppendLoadKey(key, fif, max_width, max_height, flags);
+    }
+    catch (const std::bad_alloc&) {
+        FreeImage_OutputMessageProcEx(fif, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+        return nullptr;
+    }
+    if (FIBITMAP* dib = Lookup(impl, key)) {
+        return dib;
+    }
+    FreeImageIO io;
+    SetMemoryIO(&io);
+    FIBITMAP* dib = (max_width && max_height)
+        ? FreeImage_LoadScaledFromHandle(fif, &io, static_cast<fi_handle>(stream), max_width, max_height, flags)
+        : FreeImage_LoadFromHandle(fif, &io, static_cast<fi_handle>(stream), flags);
+    return dib ? Insert(impl, key, dib) : nullptr;
+}
+
+void DLL_CALLCONV
+FreeImage_GetImageCacheStats(FIIMAGECACHE* cache, FIIMAGECACHESTATS* stats)
+{
+    ImageCache* impl = ToCache(cache);
+    if (!impl || !stats) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    stats->hits         = impl->hits.load(std::memory_order_relaxed);
+    stats->storage_hits = impl->storageHits.load(std::memory_order_relaxed);
+    stats->misses       = impl->misses.load(std::memory_order_relaxed);
+    stats->evictions    = impl->evictions.load(std::memory_order_relaxed);
+    stats->entries      = impl->lru.size();
+    stats->bytes        = impl->bytes;
+}
@@ -22,6 +22,146 @@
 #include "Quantizers.h"
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "CPUDispatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace {
+
+	/// Color of a 24-bit pixel, read bytewise since a 32-bit load may overrun the last pixel of a bitmap
+	inline unsigned GetColor24(const uint8_t *bits) {
+		unsigned color = 0;
+		memcpy(&color, bits, 3);
+		return color;
+	}
+
+	inline unsigned GetColor32(const uint8_t *bits) {
+		unsigned color;
+		memcpy(&color, bits, 4);
+		return color & 0x00FFFFFF;
+	}
+
+	unsigned MatchRun24(const uint8_t *bits, unsigned count, unsigned color) {
+		unsigned n = 0;
+		while ((n < count) && (GetColor24(bits + 3 * n) == color)) {
+			++n;
+		}
+		return n;
+	}
+
+	unsigned MatchRun32(const uint8_t *bits, unsigned count, unsigned color) {
+		unsigned n = 0;
+		while ((n < count) && (GetColor32(bits + 4 * n) == color)) {
+			++n;
+		}
+		return n;
+	}
+
+#if FREEIMAGE_SIMD_X86
+	unsigned MatchRun24_SSE2(const uint8_t *bits, unsigned count, unsigned color) {
+		// 5 pixels of color in the first 15 bytes, 6 pixels are readable so a 16-byte load stays in the line
+		uint8_t pattern[16];
+		for (unsigned i = 0; i < 16; i++) {
+			pattern[i] = ((const uint8_t *)&color)[i % 3];
+		}
+		const __m128i run = _mm_loadu_si128((const __m128i *)pattern);
+		unsigned n = 0;
+		for (; n + 6 <= count; n += 5) {
+			const __m128i pixels = _mm_loadu_si128((const __m128i *)(bits + 3 * n));
+			if ((_mm_movemask_epi8(_mm_cmpeq_epi8(pixels, run)) & 0x7FFF) != 0x7FFF) {
+				break;
+			}
+		}
+		return n + MatchRun24(bits + 3 * n, count - n, color);
+	}
+
+	unsigned MatchRun32_SSE2(const uint8_t *bits, unsigned count, unsigned color) {
+		const __m128i run = _mm_set1_epi32((int)color);
+		const __m128i mask = _mm_set1_epi32(0x00FFFFFF);
+		unsigned n = 0;
+		for (; n + 4 <= count; n += 4) {
+			const __m128i pixels = _mm_and_si128(_mm_loadu_si128((const __m128i *)(bits + 4 * n)), mask);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(pixels, run)) != 0xFFFF) {
+				break;
+			}
+		}
+		return n + MatchRun32(bits + 4 * n, count - n, color);
+	}
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+	/// Returns true if the first bytes of a comparison result are all set
+	inline bool AllEqual_NEON(uint8x16_t eq, uint64_t high_mask) {
+		const uint64x2_t lanes = vreinterpretq_u64_u8(eq);
+		return (vgetq_lane_u64(lanes, 0) == ~0ull) && ((vgetq_lane_u64(lanes, 1) | ~high_mask) == ~0ull);
+	}
+
+	unsigned MatchRun24_NEON(const uint8_t *bits, unsigned count, unsigned color) {
+		// 5 pixels of color in the first 15 bytes, 6 pixels are readable so a 16-byte load stays in the line
+		uint8_t pattern[16];
+		for (unsigned i = 0; i < 16; i++) {
+			pattern[i] = ((const uint8_t *)&color)[i % 3];
+		}
+		const uint8x16_t run = vld1q_u8(pattern);
+		unsigned n = 0;
+		for (; n + 6 <= count; n += 5) {
+			if (!AllEqual_NEON(vceqq_u8(vld1q_u8(bits + 3 * n), run), 0x00FFFFFFFFFFFFFFull)) {
+				break;
+			}
+		}
+		return n + MatchRun24(bits + 3 * n, count - n, color);
+	}
+
+	unsigned MatchRun32_NEON(const uint8_t *bits, unsigned count, unsigned color) {
+		const uint32x4_t run = vdupq_n_u32(color);
+		const uint32x4_t mask = vdupq_n_u32(0x00FFFFFF);
+		unsigned n = 0;
+		for (; n + 4 <= count; n += 4) {
+			const uint32x4_t pixels = vandq_u32(vreinterpretq_u32_u8(vld1q_u8(bits + 4 * n)), mask);
+			if (!AllEqual_NEON(vreinterpretq_u8_u32(vceqq_u32(pixels, run)), ~0ull)) {
+				break;
+			}
+		}
+		return n + MatchRun32(bits + 4 * n, count - n, color);
+	}
+#endif // FREEIMAGE_SIMD_NEON
+
+	using MatchRunKernel = unsigned (*)(const uint8_t *bits, unsigned count, unsigned color);
+
+	std::atomic<MatchRunKernel> gMatchRun24{ MatchRun24 };
+	std::atomic<MatchRunKernel> gMatchRun32{ MatchRun32 };
+
+	void SelectLFPQuantizerKernels(unsigned features) {
+		MatchRunKernel run24 = MatchRun24, run32 = MatchRun32;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			run24 = MatchRun24_SSE2;
+			run32 = MatchRun32_SSE2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			run24 = MatchRun24_NEON;
+			run32 = MatchRun32_NEON;
+		}
+#endif
+		gMatchRun24.store(run24, std::memory_order_relaxed);
+		gMatchRun32.store(run32, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectLFPQuantizerKernels);
+
+	/// Colors found by a band of scanlines
+	struct BandColors {
+		unsigned first, last;
+		std::vector<unsigned> colors;
+		uint8_t remap[256];
+		bool identity;
+	};
+
+} // namespace
 
 LFPQuantizer::LFPQuantizer(unsigned PaletteSize) :
 		m_size(0), m_limit(PaletteSize), m_index(0) {
@@ -29,10 +169,24 @@ LFPQuantizer::LFPQuantizer(unsigned PaletteSize) :
 	memset(m_map, 0xFF, MAP_SIZE * sizeof(MapEntry));
 }
 
+LFPQuantizer::LFPQuantizer(const LFPQuantizer &other) :
+		m_size(other.m_size), m_limit(other.m_limit), m_index(other.m_index) {
+	m_map = new MapEntry[MAP_SIZE];
+	memcpy(m_map, other.m_map, MAP_SIZE * sizeof(MapEntry));
+}
+
 LFPQuantizer::~LFPQuantizer() {
     delete[] m_map;
 }
 
+/**
+ * Scanlines are converted by parallel bands, each band adds its colors
+ * to its own copy of the hash table (seeded with the reserve palette)
+ * and stops all bands as soon as its palette is full. The bands tables
+ * are then merged in scanline order, so that colors get the indices of
+ * a sequential scan, and the indices of the bands that differ are
+ * remapped.
+ */
 FIBITMAP* LFPQuantizer::Quantize(FIBITMAP *dib, int ReserveSize, FIRGBA8 *ReservePalette) {
 
 	if (ReserveSize > 0 && ReservePalette) {
@@ -50,94 +204,120 @@ FIBITMAP* LFPQuantizer::Quantize(FIBITMAP *dib, int ReserveSize, FIRGBA8 *Reserv
 	const unsigned src_pitch = FreeImage_GetPitch(dib);
 	const unsigned dst_pitch = FreeImage_GetPitch(dib8);
 
-	const uint8_t * const src_bits = FreeImage_GetBits(dib);
+	const uint8_t * const src_bits = FreeImage_GetConstBits(dib);
 	uint8_t * const dst_bits = FreeImage_GetBits(dib8);
 
-	unsigned last_color = -1;
-	int last_index = 0;
-
-	if (FreeImage_GetBPP(dib) == 24) {
-
-		// Getting the source pixel as an unsigned int is much faster than
-		// working with FI_RGBA_xxx and shifting. However, this may fail
-		// for the very last pixel, since its rgbReserved member (alpha)
-		// may actually point to an address beyond the bitmap's memory. So,
-		// we do not process the last scanline in the first loop.
-
-		// Process all but the last scanline.
-		for (unsigned y = 0; y < height - 1; ++y) {
-			uint8_t *dst_line = dst_bits + y * dst_pitch;
-			const uint8_t *src_line = src_bits + y * src_pitch;
-			for (unsigned x = 0; x < width; ++x) {
-				const unsigned color = *((unsigned *) src_line) & 0x00FFFFFF;
-				if (color != last_color) {
-					last_color = color;
-					last_index = GetIndexForColor(color);
-					if (last_index == -1) {
-						FreeImage_Unload(dib8);
-						return nullptr;
-					}
-				}
-				dst_line[x] = last_index;
-				src_line += 3;
+	const unsigned bytespp = FreeImage_GetBPP(dib) / 8;
+	const MatchRunKernel match_run = (bytespp == 3 ? gMatchRun24 : gMatchRun32).load(std::memory_order_relaxed);
+
+	const unsigned threads = std::max(1u, FreeImage_GetThreadCount());
+	const unsigned grain = std::max(CalculateBandRows(FreeImage_GetLine(dib)), (height + threads - 1) / threads);
+
+	std::vector<BandColors> bands;
+	std::mutex mutex;
+	std::atomic<bool> full{ false };
+
+	ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+		LFPQuantizer band(*this);
+		for (unsigned y = first; y < last; ++y) {
+			if (full.load(std::memory_order_relaxed)) {
+				return;
+			}
+			if (!band.QuantizeLine(dst_bits + (size_t)y * dst_pitch, src_bits + (size_t)y * src_pitch, width, bytespp, match_run)) {
+				full.store(true, std::memory_order_relaxed);
+				return;
 			}
 		}
+		BandColors colors{ first, last, band.GetColorsFrom(m_index) };
+		std::lock_guard<std::mutex> lock(mutex);
+		bands.push_back(std::move(colors));
+	});
 
-		// Process all but the last pixel of the last scanline.
-		uint8_t *dst_line = dst_bits + (height - 1) * dst_pitch;
-		const uint8_t *src_line = src_bits + (height - 1) * src_pitch;
-		for (unsigned x = 0; x < width - 1; ++x) {
-			const unsigned color = *((unsigned *) src_line) & 0x00FFFFFF;
-			if (color != last_color) {
-				last_color = color;
-				last_index = GetIndexForColor(color);
-				if (last_index == -1) {
-					FreeImage_Unload(dib8);
-					return nullptr;
-				}
-			}
-			dst_line[x] = last_index;
-			src_line += 3;
-		}
-
-		// Process the last pixel (src_line should already point to it).
-		const unsigned color = 0 | src_line[FI_RGBA_BLUE] << FI_RGBA_BLUE_SHIFT
-				| src_line[FI_RGBA_GREEN] << FI_RGBA_GREEN_SHIFT
-				| src_line[FI_RGBA_RED] << FI_RGBA_RED_SHIFT;
-		if (color != last_color) {
-			last_color = color;
-			last_index = GetIndexForColor(color);
-			if (last_index == -1) {
+	if (full.load()) {
+		FreeImage_Unload(dib8);
+		return nullptr;
+	}
+
+	// merge the bands colors in scanline order
+	std::sort(bands.begin(), bands.end(), [](const BandColors &a, const BandColors &b) {
+		return a.first < b.first;
+	});
+	const unsigned first_index = m_index;
+	for (BandColors &band : bands) {
+		band.identity = true;
+		for (unsigned i = 0; i < 256; ++i) {
+			band.remap[i] = (uint8_t)i;
+		}
+		for (size_t i = 0; i < band.colors.size(); ++i) {
+			const int index = GetIndexForColor(band.colors[i]);
+			if (index == -1) {
 				FreeImage_Unload(dib8);
 				return nullptr;
 			}
+			const unsigned local_index = first_index + (unsigned)i;
+			band.remap[local_index] = (uint8_t)index;
+			band.identity = band.identity && ((unsigned)index == local_index);
 		}
-		dst_line[width - 1] = last_index;
-
-	} else {
-		for (unsigned y = 0; y < height; ++y) {
-			uint8_t *dst_line = dst_bits + y * dst_pitch;
-			const uint8_t *src_line = src_bits + y * src_pitch;
-			for (unsigned x = 0; x < width; ++x) {
-				const unsigned color = *((unsigned *) src_line) & 0x00FFFFFF;
-				if (color != last_color) {
-					last_color = color;
-					last_index = GetIndexForColor(color);
-					if (last_index == -1) {
-						FreeImage_Unload(dib8);
-						return nullptr;
-					}
+	}
+
+	ParallelFor(0, (unsigned)bands.size(), 1, [&](unsigned first, unsigned last) {
+		for (unsigned b = first; b < last; ++b) {
+			const BandColors &band = bands[b];
+			if (band.identity) {
+				continue;
+			}
+			for (unsigned y = band.first; y < band.last; ++y) {
+				uint8_t *dst_line = dst_bits + (size_t)y * dst_pitch;
+				for (unsigned x = 0; x < width; ++x) {
+					dst_line[x] = band.remap[dst_line[x]];
 				}
-				dst_line[x] = last_index;
-				src_line += 4;
 			}
 		}
-	}
+	});
 
 	WritePalette(FreeImage_GetPalette(dib8));
 	return dib8;
 }
 
+/**
+ * Converts a scanline into palette indices. Each color change costs a
+ * hash table lookup, the pixels that follow with the same color are
+ * found by match_run and filled at once.
+ * @return false, if there is no space left in the palette
+ */
+bool LFPQuantizer::QuantizeLine(uint8_t *dst_line, const uint8_t *src_line, unsigned width, unsigned bytespp, MatchRunKernel match_run) {
+	unsigned x = 0;
+	while (x < width) {
+		const uint8_t *pixel = src_line + (size_t)x * bytespp;
+		const unsigned color = (bytespp == 3) ? GetColor24(pixel) : GetColor32(pixel);
+		const int index = GetIndexForColor(color);
+		if (index == -1) {
+			return false;
+		}
+		const unsigned run = 1 + match_run(pixel + bytespp, width - x - 1, color);
+		memset(dst_line + x, index, run);
+		x += run;
+	}
+	return true;
+}
+
+/**
+ * Returns the colors added since the palette index first, in the order
+ * of their indices. Reserved colors are not included, since they are
+ * put to the end of the palette.
+ * @param first the first palette index
+ * @return the list of colors
+ */
+std::vector<unsigned> LFPQuantizer::GetColorsFrom(unsigned first) const {
+	std::vector<unsigned> colors(m_index > first ? m_index - first : 0);
+	for (unsigned i = 0; i < MAP_SIZE; ++i) {
+		if ((m_map[i].color != EMPTY_BUCKET) && (m_map[i].index >= first) && (m_map[i].index < m_index)) {
+			colors[m_map[i].index - first] = m_map[i].color;
+		}
+	}
+	return colors;
+}
+
 /**
  * Returns the palette index of the specified color. Tries to put the
  * color into the map, if it's not already present in the map. In that
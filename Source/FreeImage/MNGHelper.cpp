@@ -564,6 +564,139 @@ mng_LoadFromMemoryHandle(FIMEMORY *hmem, int flags = 0) {
 	return dib;
 }
 
+/**
+Read-only stream made of parts of the MNG / JNG stream and of small headers kept in memory. 
+The PNG and JPEG plugins decode the chunks data through this view, 
+the chunks are read from the source stream without being copied in a memory stream. 
+*/
+class MNGStreamView {
+public:
+	MNGStreamView(FreeImageIO *io, fi_handle handle) : _source_io(io), _source(handle) {
+		_io.read_proc = ReadProc;
+		_io.write_proc = WriteProc;
+		_io.seek_proc = SeekProc;
+		_io.tell_proc = TellProc;
+	}
+
+	FIBOOL IsEmpty() const {
+		return _segments.empty();
+	}
+
+	/** Appends a copy of a few bytes (signature, chunk headers) */
+	void AddMemory(const void *data, uint32_t size) {
+		Segment segment;
+		segment.bytes.assign((const uint8_t*)data, (const uint8_t*)data + size);
+		Append(std::move(segment), size);
+	}
+
+	/** Appends size bytes of the source stream, starting at offset */
+	void AddStream(long offset, uint32_t size) {
+		if (size) {
+			Segment segment;
+			segment.offset = offset;
+			Append(std::move(segment), size);
+		}
+	}
+
+	/** Decodes the view, the position of the source stream is preserved */
+	FIBITMAP* Load(int flags) {
+		FIBITMAP *dib{};
+		const long source_pos = _source_io->tell_proc(_source);
+		_source_pos = source_pos;
+		_pos = 0;
+		const FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromHandle(&_io, (fi_handle)this, 0);
+		if (fif != FIF_UNKNOWN) {
+			_pos = 0;
+			dib = FreeImage_LoadFromHandle(fif, &_io, (fi_handle)this, flags);
+		}
+		_source_io->seek_proc(_source, source_pos, SEEK_SET);
+		return dib;
+	}
+
+private:
+	struct Segment {
+		uint64_t start = 0;			// position in the view
+		uint32_t size = 0;
+		long offset = -1;			// position in the source stream, -1 for bytes
+		std::vector<uint8_t> bytes;
+	};
+
+	void Append(Segment&& segment, uint32_t size) {
+		segment.start = _size;
+		segment.size = size;
+		_size += size;
+		_segments.push_back(std::move(segment));
+	}
+
+	static unsigned DLL_CALLCONV ReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+		auto *view = (MNGStreamView*)handle;
+		if (!size || (view->_pos >= view->_size)) {
+			return 0;
+		}
+		uint64_t wanted = std::min<uint64_t>((uint64_t)size * count, view->_size - view->_pos);
+		wanted -= wanted % size;
+
+		// first segment containing the position
+		auto segment = std::upper_bound(view->_segments.begin(), view->_segments.end(), view->_pos, [](uint64_t pos, const Segment& s) { return pos < s.start; }) - 1;
+
+		auto *dst = (uint8_t*)buffer;
+		uint64_t done = 0;
+		while (done < wanted) {
+			const uint64_t skip = view->_pos - segment->start;
+			const auto chunk = (unsigned)std::min<uint64_t>(segment->size - skip, wanted - done);
+			if (segment->offset < 0) {
+				memcpy(dst + done, segment->bytes.data() + skip, chunk);
+			} else {
+				// consecutive reads of a segment don't seek
+				const long source_pos = segment->offset + (long)skip;
+				if (source_pos != view->_source_pos) {
+					view->_source_io->seek_proc(view->_source, source_pos, SEEK_SET);
+				}
+				if (view->_source_io->read_proc(dst + done, 1, chunk, view->_source) != chunk) {
+					view->_source_pos = -1;
+					break;
+				}
+				view->_source_pos = source_pos + (long)chunk;
+			}
+			done += chunk;
+			view->_pos += chunk;
+			++segment;
+		}
+		return (unsigned)(done / size);
+	}
+
+	static unsigned DLL_CALLCONV WriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+		return 0;
+	}
+
+	static int DLL_CALLCONV SeekProc(fi_handle handle, long offset, int origin) {
+		auto *view = (MNGStreamView*)handle;
+		int64_t pos = offset;
+		if (origin == SEEK_CUR) {
+			pos += (int64_t)view->_pos;
+		} else if (origin == SEEK_END) {
+			pos += (int64_t)view->_size;
+		}
+		if (pos < 0) {
+			return -1;
+		}
+		view->_pos = (uint64_t)pos;
+		return 0;
+	}
+
+	static long DLL_CALLCONV TellProc(fi_handle handle) {
+		return (long)((MNGStreamView*)handle)->_pos;
+	}
+
+	FreeImageIO _io;
+	FreeImageIO *_source_io;
+	fi_handle _source;
+	std::vector<Segment> _segments;
+	uint64_t _size = 0;
+	uint64_t _pos = 0;
+	long _source_pos = -1;		// position of the source stream
+};
+
 /**
 Write a chunk in a PNG stream from the current position. 
 @param chunk_name Name of the chunk
@@ -599,19 +732,18 @@ mng_WriteChunk(uint8_t *chunk_name, uint8_t *chunk_data, uint32_t length, FIMEMO
 }
 
 /**
-Wrap a IDAT chunk as a PNG stream. 
-The stream has the structure { g_png_signature, IHDR, IDAT, IEND }
+Write the start of a PNG stream wrapping IDAT chunks. 
+The stream has the structure { g_png_signature, IHDR, IDAT, ..., IDAT, IEND }, 
+the header is { g_png_signature, IHDR }. 
 The image is assumed to be a greyscale image. 
 
 @param jng_width Image width
 @param jng_height Image height
 @param jng_alpha_sample_depth Bits per pixel
-@param mChunk PNG grayscale IDAT format
-@param mLength IDAT chunk length
 @param hPngMemory Output memory stream
 */
 static void 
-mng_WritePNGStream(uint32_t jng_width, uint32_t jng_height, uint8_t jng_alpha_sample_depth, uint8_t *mChunk, uint32_t mLength, FIMEMORY *hPngMemory) {
+mng_WritePNGHeader(uint32_t jng_width, uint32_t jng_height, uint8_t jng_alpha_sample_depth, FIMEMORY *hPngMemory) {
 	// PNG grayscale IDAT format
 
 	uint8_t data[14];
@@ -646,13 +778,6 @@ mng_WritePNGStream(uint32_t jng_width, uint32_t jng_height, uint8_t jng_alpha_sa
 	data[12] = 0;	// interlace_method 0 (jng_alpha_interlace_method)
 
 	mng_WriteChunk(mng_IHDR, &data[0], 13, hPngMemory);
-
-	// write a IDAT chunk ...
-	mng_WriteChunk(mng_IDAT, mChunk, mLength, hPngMemory);
-
-	// write a IEND chunk ...
-	mng_WriteChunk(mng_IEND, nullptr, 0, hPngMemory);
-
 }
 
 // --------------------------------------------------------------------------
@@ -723,9 +848,11 @@ mng_ReadChunks(int format_id, FreeImageIO *io, fi_handle handle, long Offset, in
 	FIBITMAP *dib{};
 	FIBITMAP *dib_alpha{};
 
-	FIMEMORY *hJpegMemory{};
 	FIMEMORY *hPngMemory{};
-	FIMEMORY *hIDATMemory{};
+
+	// the JDAT and IDAT chunks are decoded from the source stream
+	MNGStreamView jpeg_view(io, handle);
+	MNGStreamView alpha_view(io, handle);
 
 	// ---
 	uint32_t jng_width = 0;
@@ -753,7 +880,6 @@ mng_ReadChunks(int format_id, FreeImageIO *io, fi_handle handle, long Offset, in
 	FIRGBA8 rgbBkColor = {0, 0, 0, 0};
 	uint16_t bk_red, bk_green, bk_blue;
 	FIBOOL hasBkColor = FALSE;
-	FIBOOL mHasIDAT = FALSE;
 
 	tEXtMAP key_value_pair;
 
@@ -880,6 +1006,20 @@ mng_ReadChunks(int format_id, FreeImageIO *io, fi_handle handle, long Offset, in
 						break;
 					}
 					
+					if (!m_HasGlobalPalette) {
+						// decode the { IHDR, ..., IEND } chunks in place, as a PNG stream
+						MNGStreamView png_view(io, handle);
+						png_view.AddMemory(g_png_signature, 8);
+						png_view.AddStream(Offset, m_TotalBytesOfChunks);
+
+						if (dib) FreeImage_Unload(dib);
+						dib = png_view.Load(flags);
+
+						// stop after the first image
+						mEnd = TRUE;
+						break;
+					}
+
 					// wrap the { IHDR, ..., IEND } chunks as a PNG stream
 					if (!hPngMemory) {
 						hPngMemory = FreeImage_OpenMemory();
@@ -908,7 +1048,7 @@ mng_ReadChunks(int format_id, FreeImageIO *io, fi_handle handle, long Offset, in
 					FreeImage_WriteMemory(mChunk, 1, m_TotalBytesOfChunks, hPngMemory);
 
 					// plug in global PLTE if local PLTE exists
-					if (m_HasGlobalPalette) {
+					{
 						// ensure we remove some local chunks, so that global
 						// "PLTE" can be inserted right before "IDAT".
 						mng_RemoveChunk(hPngMemory, mng_PLTE);
@@ -948,27 +1088,31 @@ mng_ReadChunks(int format_id, FreeImageIO *io, fi_handle handle, long Offset, in
 					break;
 
 				case JDAT:
-					if (!hJpegMemory) {
-						hJpegMemory = FreeImage_OpenMemory();
-					}
-					// as there may be several JDAT chunks, concatenate them
-					FreeImage_WriteMemory(mChunk, 1, mLength, hJpegMemory);
+					// as there may be several JDAT chunks, the view concatenates their data
+					jpeg_view.AddStream(Offset, mLength);
 					break;
 
 				case IDAT:
-					if (!header_only && (jng_alpha_compression_method == 0)) {
+					if (!header_only && (jng_alpha_compression_method == 0) && mLength) {
 						// PNG grayscale IDAT format
-						if (!hIDATMemory) {
-							hIDATMemory = FreeImage_OpenMemory();
-							mHasIDAT = TRUE;
+						if (alpha_view.IsEmpty()) {
+							// wrap the IDAT chunks as a PNG stream
+							hPngMemory = FreeImage_OpenMemory();
+							mng_WritePNGHeader(jng_width, jng_height, jng_alpha_sample_depth, hPngMemory);
+							uint8_t *data{};
+							uint32_t size_in_bytes = 0;
+							FreeImage_AcquireMemory(hPngMemory, &data, &size_in_bytes);
+							alpha_view.AddMemory(data, size_in_bytes);
+							FreeImage_CloseMemory(hPngMemory);
+							hPngMemory = nullptr;
 						}
-						// as there may be several IDAT chunks, concatenate them
-						FreeImage_WriteMemory(mChunk, 1, mLength, hIDATMemory);
+						// the whole chunk (length, name, array, crc) is a valid PNG IDAT chunk
+						alpha_view.AddStream(LastOffset, mLength + 12);
 					}
 					break;
 
 				case IEND:
-					if (!hJpegMemory) {
+					if (jpeg_view.IsEmpty()) {
 						mEnd = TRUE;
 						break;
 					}
@@ -976,27 +1120,18 @@ mng_ReadChunks(int format_id, FreeImageIO *io, fi_handle handle, long Offset, in
 					if (dib) {
 						FreeImage_Unload(dib);
 					}
-					dib = mng_LoadFromMemoryHandle(hJpegMemory, flags);
+					dib = jpeg_view.Load(flags);
 
 					// load the PNG alpha layer
-					if (mHasIDAT) {
-						uint8_t *data{};
-						uint32_t size_in_bytes = 0;
-
-						// get a pointer to the IDAT buffer
-						FreeImage_AcquireMemory(hIDATMemory, &data, &size_in_bytes);
-						if (data && size_in_bytes) {
-							// wrap the IDAT chunk as a PNG stream
-							if (!hPngMemory) {
-								hPngMemory = FreeImage_OpenMemory();
-							}
-							mng_WritePNGStream(jng_width, jng_height, jng_alpha_sample_depth, data, size_in_bytes, hPngMemory);
-							// load the PNG
-							if (dib_alpha) {
-								FreeImage_Unload(dib_alpha);
-							}
-							dib_alpha = mng_LoadFromMemoryHandle(hPngMemory, flags);
+					if (!alpha_view.IsEmpty()) {
+						// end the PNG stream
+						const uint8_t iend_chunk[12] = { 0, 0, 0, 0, 73, 69, 78, 68, 0xAE, 0x42, 0x60, 0x82 };
+						alpha_view.AddMemory(iend_chunk, sizeof(iend_chunk));
+						// load the PNG
+						if (dib_alpha) {
+							FreeImage_Unload(dib_alpha);
 						}
+						dib_alpha = alpha_view.Load(flags);
 					}
 					// stop the parsing
 					mEnd = TRUE;
@@ -1041,9 +1176,7 @@ mng_ReadChunks(int format_id, FreeImageIO *io, fi_handle handle, long Offset, in
 			} // switch (GetChunckType)
 		} // while (!mEnd)
 
-		FreeImage_CloseMemory(hJpegMemory);
 		FreeImage_CloseMemory(hPngMemory);
-		FreeImage_CloseMemory(hIDATMemory);
 		free(mChunk);
 		free(PLTE_file_chunk);
 
@@ -1081,15 +1214,13 @@ mng_ReadChunks(int format_id, FreeImageIO *io, fi_handle handle, long Offset, in
 		return dib;
 
 	} catch(const char *text) {
-		FreeImage_CloseMemory(hJpegMemory);
 		FreeImage_CloseMemory(hPngMemory);
-		FreeImage_CloseMemory(hIDATMemory);
 		free(mChunk);
 		free(PLTE_file_chunk);
 		FreeImage_Unload(dib);
 		FreeImage_Unload(dib_alpha);
 		if (text) {
-			FreeImage_OutputMessageProc(format_id, text);
+			FreeImage_OutputMessageProcEx(format_id, GetThrownMessageCode(text), text);
 		}
 		return nullptr;
 	}
@@ -1279,7 +1410,7 @@ mng_WriteJNG(int format_id, FreeImageIO *io, FIBITMAP *dib, fi_handle handle, in
 		}
 		FreeImage_Unload(dib_alpha);
 		if (text) {
-			FreeImage_OutputMessageProc(format_id, text);
+			FreeImage_OutputMessageProcEx(format_id, GetThrownMessageCode(text), text);
 		}
 		return FALSE;
 	}
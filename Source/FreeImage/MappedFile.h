@@ -0,0 +1,107 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_MAPPED_FILE_H_
+#define FREEIMAGE_MAPPED_FILE_H_
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Read-only mapping of a whole file, empty if the file can't be mapped (or is empty or larger than 4 GB)
+ */
+class MappedFile
+{
+public:
+#ifdef _WIN32
+    template <typename Char_>
+    MappedFile(const Char_ *filename) {
+        HANDLE file;
+        if constexpr (std::is_same_v<Char_, wchar_t>) {
+            file = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        } else {
+            file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        }
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER length;
+        if (GetFileSizeEx(file, &length) && length.QuadPart > 0 && length.QuadPart <= UINT32_MAX) {
+            if (HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+                mData = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                if (mData) {
+                    mSize = static_cast<uint32_t>(length.QuadPart);
+                }
+                // the view keeps the mapping alive
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+    }
+
+    ~MappedFile() {
+        if (mData) {
+            UnmapViewOfFile(mData);
+        }
+    }
+#else
+    MappedFile(const char *filename) {
+        const int fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (uint64_t)st.st_size <= UINT32_MAX) {
+            void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+                mData = static_cast<uint8_t*>(data);
+                mSize = static_cast<uint32_t>(st.st_size);
+            }
+        }
+        // the mapping stays valid after closing the descriptor
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (mData) {
+            munmap(mData, mSize);
+        }
+    }
+#endif
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    uint8_t* data() const {
+        return mData;
+    }
+
+    uint32_t size() const {
+        return mSize;
+    }
+
+private:
+    uint8_t *mData{};
+    uint32_t mSize{};
+};
+
+#endif // FREEIMAGE_MAPPED_FILE_H_
@@ -0,0 +1,221 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "MemoryBudget.h"
+#include "Utilities.h"
+#include <atomic>
+#include <charconv>
+#include <new>
+#include <utility>
+
+
+struct ThreadBudget
+{
+    std::atomic<unsigned> refs{ 1 };
+    std::atomic<uint64_t> used{ 0 };
+    uint64_t limit{ 0 };
+};
+
+namespace {
+
+    constexpr size_t kPools = static_cast<size_t>(MemoryPool::eCount);
+
+    std::atomic<uint64_t> gPoolBytes[kPools];
+    std::atomic<uint64_t> gTotalBytes{ 0 };
+    std::atomic<uint64_t> gPeakBytes{ 0 };
+    std::atomic<uint64_t> gLimit{ 0 };
+
+    /**
+     * Owns the reference of the thread to its budget, dropped when the thread ends
+     */
+    struct ThreadBudgetHolder
+    {
+        ThreadBudget* budget{ nullptr };
+
+        ~ThreadBudgetHolder() {
+            ReleaseThreadBudget(budget);
+        }
+    };
+
+    thread_local ThreadBudgetHolder tBudget;
+
+    /**
+     * Adds bytes to counter unless the sum would exceed limit (0 means no limit).
+     * result receives the new value, or the current one if it failed.
+     */
+    bool AddBounded(std::atomic<uint64_t>& counter, uint64_t bytes, uint64_t limit, uint64_t& result)
+    {
+        uint64_t current = counter.load(std::memory_order_relaxed);
+        do {
+            if (limit && (bytes > limit || current > limit - bytes)) {
+                result = current;
+                return false;
+            }
+        } while (!counter.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+        result = current + bytes;
+        return true;
+    }
+
+    /**
+     * Decimal text of a byte count, the message formatter has no 64-bit conversions
+     */
+    struct ByteCount
+    {
+        char text[24]{};
+
+        explicit ByteCount(uint64_t value) {
+            std::to_chars(text, text + sizeof(text) - 1, value);
+        }
+    };
+
+    void UpdatePeak(uint64_t value)
+    {
+        uint64_t peak = gPeakBytes.load(std::memory_order_relaxed);
+        while (value > peak && !gPeakBytes.compare_exchange_weak(peak, value, std::memory_order_relaxed)) {
+        }
+    }
+
+} // namespace
+
+
+ThreadBudget* AcquireThreadBudget()
+{
+    ThreadBudget* budget = tBudget.budget;
+    if (budget) {
+        budget->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return budget;
+}
+
+void ReleaseThreadBudget(ThreadBudget* budget)
+{
+    if (budget && budget->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete budget;
+    }
+}
+
+ThreadBudgetScope::ThreadBudgetScope(ThreadBudget* budget)
+    : mPrevious(tBudget.budget)
+{
+    if (budget) {
+        budget->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    tBudget.budget = budget;
+}
+
+ThreadBudgetScope::~ThreadBudgetScope()
+{
+    ReleaseThreadBudget(tBudget.budget);
+    tBudget.budget = mPrevious;
+}
+
+bool ReserveMemory(MemoryPool pool, size_t bytes, ThreadBudget* budget)
+{
+    uint64_t total = 0;
+    const uint64_t limit = gLimit.load(std::memory_order_relaxed);
+    if (!AddBounded(gTotalBytes, bytes, limit, total)) {
+        FreeImage_OutputMessageProc(FIF_UNKNOWN, "Memory limit exceeded: %s bytes requested, %s of %s bytes in use",
+            ByteCount(bytes).text, ByteCount(total).text, ByteCount(limit).text);
+        return false;
+    }
+    if (budget) {
+        uint64_t used = 0;
+        if (!AddBounded(budget->used, bytes, budget->limit, used)) {
+            gTotalBytes.fetch_sub(bytes, std::memory_order_relaxed);
+            FreeImage_OutputMessageProc(FIF_UNKNOWN, "Thread memory budget exceeded: %s bytes requested, %s of %s bytes in use",
+                ByteCount(bytes).text, ByteCount(used).text, ByteCount(budget->limit).text);
+            return false;
+        }
+    }
+    gPoolBytes[static_cast<size_t>(pool)].fetch_add(bytes, std::memory_order_relaxed);
+    UpdatePeak(total);
+    return true;
+}
+
+void ReleaseMemory(MemoryPool pool, size_t bytes, ThreadBudget* budget)
+{
+    gPoolBytes[static_cast<size_t>(pool)].fetch_sub(bytes, std::memory_order_relaxed);
+    gTotalBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    if (budget) {
+        budget->used.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+}
+
+// ----------------------------------------------------------
+
+void MemoryCharge::Add(size_t bytes)
+{
+    if (!mBytes && !mBudget) {
+        mBudget = AcquireThreadBudget();
+    }
+    if (!ReserveMemory(mPool, bytes, mBudget)) {
+        throw std::bad_alloc();
+    }
+    mBytes += bytes;
+}
+
+void MemoryCharge::Release()
+{
+    if (mBytes) {
+        ReleaseMemory(mPool, mBytes, mBudget);
+        mBytes = 0;
+    }
+    ReleaseThreadBudget(mBudget);
+    mBudget = nullptr;
+}
+
+void MemoryCharge::swap(MemoryCharge& other) noexcept
+{
+    std::swap(mPool, other.mPool);
+    std::swap(mBytes, other.mBytes);
+    std::swap(mBudget, other.mBudget);
+}
+
+
+// ==========================================================
+//   Public API
+// ==========================================================
+
+void DLL_CALLCONV
+FreeImage_GetMemoryUsage(FIMEMORYUSAGE* usage)
+{
+    if (!usage) {
+        return;
+    }
+    usage->bitmap_bytes   = gPoolBytes[static_cast<size_t>(MemoryPool::eBitmap)].load(std::memory_order_relaxed);
+    usage->metadata_bytes = gPoolBytes[static_cast<size_t>(MemoryPool::eMetadata)].load(std::memory_order_relaxed);
+    usage->cache_bytes    = gPoolBytes[static_cast<size_t>(MemoryPool::eCache)].load(std::memory_order_relaxed);
+    usage->total_bytes    = gTotalBytes.load(std::memory_order_relaxed);
+    usage->peak_bytes     = gPeakBytes.load(std::memory_order_relaxed);
+    usage->limit_bytes    = gLimit.load(std::memory_order_relaxed);
+
+    const ThreadBudget* budget = tBudget.budget;
+    usage->thread_used_bytes   = budget ? budget->used.load(std::memory_order_relaxed) : 0;
+    usage->thread_budget_bytes = budget ? budget->limit : 0;
+}
+
+void DLL_CALLCONV
+FreeImage_SetMemoryLimit(uint64_t bytes)
+{
+    gLimit.store(bytes, std::memory_order_relaxed);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_SetThreadMemoryBudget(uint64_t bytes)
+{
+    ThreadBudget* budget = nullptr;
+    if (bytes) {
+        budget = new(std::nothrow) ThreadBudget;
+        if (!budget) {
+            FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+            return FALSE;
+        }
+        budget->limit = bytes;
+    }
+    ReleaseThreadBudget(tBudget.budget);
+    tBudget.budget = budget;
+    return TRUE;
+}
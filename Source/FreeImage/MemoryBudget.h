@@ -0,0 +1,94 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_MEMORY_BUDGET_H_
+#define FREEIMAGE_MEMORY_BUDGET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "FreeImage.h"
+
+/**
+ * Kinds of memory reported by FreeImage_GetMemoryUsage
+ */
+enum class MemoryPool : unsigned
+{
+    eBitmap,
+    eMetadata,
+    eCache,
+    eCount
+};
+
+/**
+ * Budget of a thread, see FreeImage_SetThreadMemoryBudget.
+ * Reference counted: memory charged to a budget keeps it alive until it is released, on whatever thread.
+ */
+struct ThreadBudget;
+
+/**
+ * Returns the budget of the calling thread with a reference added, NULL if the thread has none
+ */
+ThreadBudget* AcquireThreadBudget();
+void ReleaseThreadBudget(ThreadBudget* budget);
+
+/**
+ * Makes budget (may be NULL) the budget of the calling thread until the scope ends, then restores the previous one.
+ * Pool tasks run this way under the budget of the thread which submitted them.
+ */
+class ThreadBudgetScope
+{
+public:
+    explicit ThreadBudgetScope(ThreadBudget* budget);
+    ~ThreadBudgetScope();
+
+    ThreadBudgetScope(const ThreadBudgetScope&) = delete;
+    ThreadBudgetScope& operator=(const ThreadBudgetScope&) = delete;
+
+private:
+    ThreadBudget* mPrevious;
+};
+
+/**
+ * Charges bytes to a pool, checked against the process limit (FreeImage_SetMemoryLimit) and budget (may be NULL).
+ * Nothing is charged and an error is reported if a limit would be exceeded, the allocation must fail then.
+ */
+bool ReserveMemory(MemoryPool pool, size_t bytes, ThreadBudget* budget);
+void ReleaseMemory(MemoryPool pool, size_t bytes, ThreadBudget* budget);
+
+/**
+ * Memory of an owner growing in steps (tag arena, cache slabs), charged to the budget of the thread making
+ * the first step and released at once.
+ */
+class MemoryCharge
+{
+public:
+    explicit MemoryCharge(MemoryPool pool)
+        : mPool(pool)
+    { }
+
+    ~MemoryCharge() {
+        Release();
+    }
+
+    MemoryCharge(const MemoryCharge&) = delete;
+    MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+    /**
+     * Charges bytes more, throws std::bad_alloc if a limit would be exceeded
+     */
+    void Add(size_t bytes);
+
+    void Release();
+
+    void swap(MemoryCharge& other) noexcept;
+
+private:
+    MemoryPool mPool;
+    size_t mBytes{ 0 };
+    ThreadBudget* mBudget{ nullptr };
+};
+
+#endif // FREEIMAGE_MEMORY_BUDGET_H_
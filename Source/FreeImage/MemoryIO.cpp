@@ -24,6 +24,9 @@
 #include "Utilities.h"
 #include "FreeImageIO.h"
 
+#include <algorithm>
+#include <new>
+
 // =====================================================================
 
 
@@ -33,6 +36,15 @@
 
 FIMEMORY * DLL_CALLCONV 
 FreeImage_OpenMemory(uint8_t *data, uint32_t size_in_bytes) {
+	return FreeImage_OpenMemory64(data, size_in_bytes);
+}
+
+FIMEMORY * DLL_CALLCONV 
+FreeImage_OpenMemory64(uint8_t *data, uint64_t size_in_bytes) {
+	if (size_in_bytes > (uint64_t)INT64_MAX) {
+		return nullptr;
+	}
+
 	// allocate a memory handle
 	auto *stream = (FIMEMORY*)malloc(sizeof(FIMEMORY));
 	if (stream) {
@@ -48,7 +60,7 @@ FreeImage_OpenMemory(uint8_t *data, uint32_t size_in_bytes) {
 				// wrap a user buffer
 				mem_header->delete_me = FALSE;
 				mem_header->data = (uint8_t*)data;
-				mem_header->data_length = mem_header->file_length = size_in_bytes;
+				mem_header->data_length = mem_header->file_length = (int64_t)size_in_bytes;
 			} else {
 				mem_header->delete_me = TRUE;
 			}
@@ -62,10 +74,74 @@ FreeImage_OpenMemory(uint8_t *data, uint32_t size_in_bytes) {
 }
 
 
+FIMEMORY * DLL_CALLCONV 
+FreeImage_OpenMemoryEx(uint64_t reserve_bytes, int growth_policy) {
+	if (growth_policy != FIMEMORY_GROW_DOUBLE && growth_policy != FIMEMORY_GROW_LINEAR && growth_policy != FIMEMORY_GROW_CHUNKED) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FreeImage_OpenMemoryEx: unknown growth policy %d", growth_policy);
+		return nullptr;
+	}
+	if (reserve_bytes > (uint64_t)PTRDIFF_MAX) {
+		return nullptr;
+	}
+
+	FIMEMORY *stream = FreeImage_OpenMemory64();
+	if (!stream) {
+		return nullptr;
+	}
+	FIMEMORYHEADER *mem_header = (FIMEMORYHEADER*)(stream->data);
+
+	const int64_t min_step = 65536;
+	mem_header->growth_policy = growth_policy;
+	mem_header->growth_step = std::max<int64_t>((int64_t)reserve_bytes, min_step);
+
+	if (growth_policy == FIMEMORY_GROW_CHUNKED) {
+		mem_header->chunks = new(std::nothrow) FIMEMORYCHUNKS;
+		if (!mem_header->chunks) {
+			FreeImage_CloseMemory(stream);
+			return nullptr;
+		}
+		mem_header->chunks->chunk_size = mem_header->growth_step;
+	}
+	else if (reserve_bytes) {
+		mem_header->data = malloc((size_t)reserve_bytes);
+		if (!mem_header->data) {
+			FreeImage_CloseMemory(stream);
+			return nullptr;
+		}
+		mem_header->data_length = (int64_t)reserve_bytes;
+	}
+	return stream;
+}
+
+
+FIMEMORY * DLL_CALLCONV 
+FreeImage_OpenMemoryWritable(uint8_t *buffer, uint64_t capacity, FI_MemoryOverflowProc overflow, void *user_data) {
+	if ((!buffer && capacity) || capacity > (uint64_t)PTRDIFF_MAX) {
+		return nullptr;
+	}
+
+	FIMEMORY *stream = FreeImage_OpenMemory64();
+	if (!stream) {
+		return nullptr;
+	}
+	FIMEMORYHEADER *mem_header = (FIMEMORYHEADER*)(stream->data);
+
+	// write into a user buffer, the stream starts empty
+	mem_header->delete_me = FALSE;
+	mem_header->user_writable = TRUE;
+	mem_header->data = buffer;
+	mem_header->data_length = (int64_t)capacity;
+	mem_header->overflow = overflow;
+	mem_header->overflow_data = user_data;
+	return stream;
+}
+
+
 void DLL_CALLCONV
 FreeImage_CloseMemory(FIMEMORY *stream) {
 	if (stream && stream->data) {
 		FIMEMORYHEADER *mem_header = (FIMEMORYHEADER*)(stream->data);
+		FreeMemoryChunks(mem_header);
 		if (mem_header->delete_me) {
 			free(mem_header->data);
 		}
@@ -99,7 +175,7 @@ FreeImage_SaveToMemory(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FIMEMORY *stream, i
 
 		FIMEMORYHEADER *mem_header = (FIMEMORYHEADER*)(stream->data);
 
-		if (mem_header->delete_me == TRUE) {
+		if (IsMemoryWritable(mem_header)) {
 			return FreeImage_SaveToHandle(fif, dib, &io, (fi_handle)stream, flags);
 		} else {
 			// do not save in a user buffer
@@ -116,17 +192,66 @@ FreeImage_SaveToMemory(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FIMEMORY *stream, i
 
 FIBOOL DLL_CALLCONV
 FreeImage_AcquireMemory(FIMEMORY *stream, uint8_t **data, uint32_t *size_in_bytes) {
+	uint64_t size64 = 0;
+	if (FreeImage_AcquireMemory64(stream, data, &size64)) {
+		if (size64 <= UINT32_MAX) {
+			*size_in_bytes = (uint32_t)size64;
+			return TRUE;
+		}
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "Memory stream is larger than 4 GB, use FreeImage_AcquireMemory64");
+	}
+
+	return FALSE;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_AcquireMemory64(FIMEMORY *stream, uint8_t **data, uint64_t *size_in_bytes) {
 	if (stream) {
 		FIMEMORYHEADER *mem_header = (FIMEMORYHEADER*)(stream->data);
 
+		// chunked streams are copied into a single buffer once
+		if (!FlattenMemoryChunks(mem_header)) {
+			FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+			return FALSE;
+		}
+
 		*data = (uint8_t*)mem_header->data;
-		*size_in_bytes = mem_header->file_length;
+		*size_in_bytes = (uint64_t)mem_header->file_length;
 		return TRUE;
 	}
 
 	return FALSE;
 }
 
+/**
+Gets the unread bytes of a memory stream seen through its IO functions
+@param io IO functions used by a plugin
+@param handle Stream handle
+@param available Number of bytes after the current position
+@return Returns a pointer to the current position, NULL if the stream is not a memory stream
+*/
+const uint8_t * DLL_CALLCONV
+FreeImage_PeekMemoryIO(FreeImageIO *io, fi_handle handle, uint64_t *available) {
+	if (available) {
+		*available = 0;
+	}
+
+	FreeImageIO memory_io;
+	SetMemoryIO(&memory_io);
+
+	if (!io || !handle || io->read_proc != memory_io.read_proc) {
+		return nullptr;
+	}
+	auto *mem_header = (const FIMEMORYHEADER*)(((const FIMEMORY*)handle)->data);
+	if (mem_header->chunks || mem_header->current_position > mem_header->file_length) {
+		return nullptr;
+	}
+	if (available) {
+		*available = (uint64_t)(mem_header->file_length - mem_header->current_position);
+	}
+	return (const uint8_t *)mem_header->data + mem_header->current_position;
+}
+
 // =====================================================================
 // Seeking in Memory stream
 // =====================================================================
@@ -168,6 +293,37 @@ FreeImage_TellMemory(FIMEMORY *stream) {
 	return -1L;
 }
 
+/**
+Same as FreeImage_SeekMemory with a 64-bit offset
+*/
+FIBOOL DLL_CALLCONV
+FreeImage_SeekMemory64(FIMEMORY *stream, int64_t offset, int origin) {
+	FreeImageIO64 io;
+	SetMemoryIO64(&io);
+
+	if (stream) {
+		int success = io.seek_proc((fi_handle)stream, offset, origin);
+		return (success == 0) ? TRUE : FALSE;
+	}
+
+	return FALSE;
+}
+
+/**
+Same as FreeImage_TellMemory with a 64-bit position
+*/
+int64_t DLL_CALLCONV
+FreeImage_TellMemory64(FIMEMORY *stream) {
+	FreeImageIO64 io;
+	SetMemoryIO64(&io);
+
+	if (stream) {
+		return io.tell_proc((fi_handle)stream);
+	}
+
+	return -1;
+}
+
 // =====================================================================
 // Reading or Writing in Memory stream
 // =====================================================================
@@ -208,7 +364,7 @@ FreeImage_WriteMemory(const void *buffer, unsigned size, unsigned count, FIMEMOR
 
 		auto *mem_header = (FIMEMORYHEADER*)(((FIMEMORY*)stream)->data);
 
-		if (mem_header->delete_me == TRUE) {
+		if (IsMemoryWritable(mem_header)) {
 			return io.write_proc((void *)buffer, size, count, stream);
 		} else {
 			// do not write in a user buffer
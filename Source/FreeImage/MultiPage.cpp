@@ -90,7 +90,255 @@ public:
 
 // ----------------------------------------------------------
 
-typedef std::list<PageBlock> BlockList;
+/**
+Sequence of the page blocks of a multipage bitmap, in an implicit treap: blocks are ordered by position
+and every node knows the number of pages of its subtree, so that finding the block of a page, inserting
+and erasing blocks are O(log n). Nodes aren't moved by the tree operations, iterators stay valid until
+their block is erased.
+*/
+class BlockList {
+	struct Node {
+		PageBlock block;
+		int pages;			//! pages of the subtree
+		uint32_t priority;
+		Node *left;
+		Node *right;
+		Node *parent;
+	};
+
+public:
+	class iterator {
+	public:
+		iterator(Node *node = nullptr) : mNode(node) {
+		}
+
+		const PageBlock &operator*() const { return mNode->block; }
+		const PageBlock *operator->() const { return &mNode->block; }
+
+		iterator &operator++() {
+			mNode = BlockList::next(mNode);
+			return *this;
+		}
+		iterator operator++(int) {
+			iterator tmp(*this);
+			mNode = BlockList::next(mNode);
+			return tmp;
+		}
+
+		bool operator==(const iterator &other) const { return mNode == other.mNode; }
+		bool operator!=(const iterator &other) const { return mNode != other.mNode; }
+
+	private:
+		friend class BlockList;
+		Node *mNode;
+	};
+
+	BlockList() = default;
+	BlockList(const BlockList &) = delete;
+	BlockList &operator=(const BlockList &) = delete;
+
+	~BlockList() {
+		clear();
+	}
+
+	iterator begin() const {
+		Node *node = mRoot;
+		while (node && node->left) {
+			node = node->left;
+		}
+		return iterator(node);
+	}
+
+	iterator end() const {
+		return iterator();
+	}
+
+	/// Number of pages of all the blocks
+	int pageCount() const {
+		return mRoot ? mRoot->pages : 0;
+	}
+
+	/// Returns the block holding a page and the page offset in the block, or end() for pages out of range
+	iterator find(int position, int &offset) const {
+		Node *node = mRoot;
+		while (node && (position >= 0)) {
+			const int left = pagesOf(node->left);
+			if (position < left) {
+				node = node->left;
+				continue;
+			}
+			position -= left;
+			if (position < node->block.getPageCount()) {
+				offset = position;
+				return iterator(node);
+			}
+			position -= node->block.getPageCount();
+			node = node->right;
+		}
+		return end();
+	}
+
+	/// Inserts a block before pos (at the end for end())
+	iterator insert(iterator pos, const PageBlock &block) {
+		Node *node = new Node{ block, block.getPageCount(), nextPriority(), nullptr, nullptr, nullptr };
+
+		if (!mRoot) {
+			mRoot = node;
+			return iterator(node);
+		}
+
+		// attach as a leaf right before pos
+
+		Node *parent;
+		if (!pos.mNode) {
+			for (parent = mRoot; parent->right; parent = parent->right);
+			parent->right = node;
+		} else if (!pos.mNode->left) {
+			parent = pos.mNode;
+			parent->left = node;
+		} else {
+			for (parent = pos.mNode->left; parent->right; parent = parent->right);
+			parent->right = node;
+		}
+		node->parent = parent;
+		addPages(parent, node->pages);
+
+		// restore the heap order of the priorities
+
+		while (node->parent && (node->parent->priority < node->priority)) {
+			rotateUp(node);
+		}
+
+		return iterator(node);
+	}
+
+	void push_back(const PageBlock &block) {
+		insert(end(), block);
+	}
+
+	void push_front(const PageBlock &block) {
+		insert(begin(), block);
+	}
+
+	/// Erases a block, returns the next one
+	iterator erase(iterator pos) {
+		Node *node = pos.mNode;
+		Node *following = next(node);
+
+		// rotate the node down until it has a single child
+
+		while (node->left && node->right) {
+			rotateUp((node->left->priority > node->right->priority) ? node->left : node->right);
+		}
+
+		Node *child = node->left ? node->left : node->right;
+		if (child) {
+			child->parent = node->parent;
+		}
+		replaceChild(node, child);
+		addPages(node->parent, -node->block.getPageCount());
+
+		delete node;
+
+		return iterator(following);
+	}
+
+	/// Replaces a block
+	void assign(iterator pos, const PageBlock &block) {
+		const int delta = block.getPageCount() - pos.mNode->block.getPageCount();
+		pos.mNode->block = block;
+		addPages(pos.mNode, delta);
+	}
+
+	void clear() {
+		// post-order deletion without recursion
+
+		Node *node = mRoot;
+		while (node) {
+			if (node->left) {
+				node = node->left;
+			} else if (node->right) {
+				node = node->right;
+			} else {
+				Node *parent = node->parent;
+				if (parent) {
+					((parent->left == node) ? parent->left : parent->right) = nullptr;
+				}
+				delete node;
+				node = parent;
+			}
+		}
+		mRoot = nullptr;
+	}
+
+private:
+	static int pagesOf(const Node *node) {
+		return node ? node->pages : 0;
+	}
+
+	static Node *next(Node *node) {
+		if (node->right) {
+			for (node = node->right; node->left; node = node->left);
+			return node;
+		}
+		while (node->parent && (node->parent->right == node)) {
+			node = node->parent;
+		}
+		return node->parent;
+	}
+
+	static void addPages(Node *node, int delta) {
+		for (; node; node = node->parent) {
+			node->pages += delta;
+		}
+	}
+
+	void replaceChild(Node *node, Node *child) {
+		if (!node->parent) {
+			mRoot = child;
+		} else if (node->parent->left == node) {
+			node->parent->left = child;
+		} else {
+			node->parent->right = child;
+		}
+	}
+
+	/// Rotates a node above its parent, keeping the order of the blocks
+	void rotateUp(Node *node) {
+		Node *parent = node->parent;
+		if (parent->left == node) {
+			parent->left = node->right;
+			if (node->right) {
+				node->right->parent = parent;
+			}
+			node->right = parent;
+		} else {
+			parent->right = node->left;
+			if (node->left) {
+				node->left->parent = parent;
+			}
+			node->left = parent;
+		}
+		node->parent = parent->parent;
+		replaceChild(parent, node);
+		parent->parent = node;
+
+		parent->pages = pagesOf(parent->left) + pagesOf(parent->right) + parent->block.getPageCount();
+		node->pages = pagesOf(node->left) + pagesOf(node->right) + node->block.getPageCount();
+	}
+
+	uint32_t nextPriority() {
+		// xorshift32
+		mSeed ^= mSeed << 13;
+		mSeed ^= mSeed >> 17;
+		mSeed ^= mSeed << 5;
+		return mSeed;
+	}
+
+	Node *mRoot{};
+	uint32_t mSeed{ 0x9E3779B9 };
+};
+
 typedef BlockList::iterator BlockListIterator;
 
 // ----------------------------------------------------------
@@ -102,10 +350,11 @@ struct MULTIBITMAPHEADER {
 		, fif(FIF_UNKNOWN)
 		, handle{}
 		, changed(FALSE)
-		, page_count(0)
 		, read_only(TRUE)
 		, cache_fif(fif)
 		, load_flags(0)
+		, read_data{}
+		, from_memory(FALSE)
 	{
 		SetDefaultIO(&io);
 	}
@@ -117,12 +366,27 @@ struct MULTIBITMAPHEADER {
 	CacheFile m_cachefile;
 	std::map<FIBITMAP *, int> locked_pages;
 	FIBOOL changed;
-	int page_count;
 	BlockList m_blocks;
 	std::string m_filename;
 	FIBOOL read_only;
 	FREE_IMAGE_FORMAT cache_fif;
 	int load_flags;
+	void *read_data; // source opened once for all the pages loaded, so plugins can keep decoding state
+	FIBOOL from_memory; // handle is a FIMEMORY stream
+};
+
+/**
+Destination of a forward-only multipage writer, the plugin stays open between pages
+*/
+struct MULTIWRITERHEADER {
+	PluginNodeBase *node{};
+	FREE_IMAGE_FORMAT fif{ FIF_UNKNOWN };
+	FreeImageIO io{};
+	fi_handle handle{};
+	int flags{ 0 };
+	void *data{};
+	int page_count{ 0 };
+	FIBOOL success{ TRUE };
 };
 
 // =====================================================================
@@ -143,8 +407,292 @@ ReplaceExtension(std::string& dst_filename, const std::string& src_filename, con
 	}
 }
 
+// =====================================================================
+// Raw page format of the cache
+// =====================================================================
+
+/**
+Header of the pages stored in the cache, followed by the palette, the transparency table,
+the ICC profile, the metadata tags, the scanlines and the thumbnail page when PAGE_THUMBNAIL is set
+*/
+struct PageHeader {
+	uint32_t magic;
+	uint32_t type;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bpp;
+	uint32_t masks[3];
+	uint32_t dots_per_meter[2];
+	uint32_t palette_size;
+	uint32_t transparency_count;
+	uint32_t icc_size;
+	uint32_t icc_flags;
+	uint32_t tag_count;
+	uint32_t flags;
+	FIRGBA8 background;
+};
+
+/// Header of a metadata tag, followed by its key, description and value
+struct PageTagHeader {
+	uint16_t model;
+	uint16_t id;
+	uint16_t type;
+	uint16_t key_length;
+	uint16_t description_length;
+	uint32_t count;
+	uint32_t length;
+};
+
+const uint32_t PAGE_MAGIC = 0x47415046;	// "FPAG"
+
+enum : uint32_t {
+	PAGE_PIXELS      = 0x01,
+	PAGE_TRANSPARENT = 0x02,
+	PAGE_BACKGROUND  = 0x04,
+	PAGE_THUMBNAIL   = 0x08
+};
+
+inline void
+PagePut(std::vector<uint8_t> &buffer, const void *data, size_t size) {
+	const auto *bytes = static_cast<const uint8_t *>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+/// Bounds checked reads of a page
+class PageReader {
+public:
+	PageReader(const uint8_t *data, size_t size) : mData(data), mEnd(data + size) {
+	}
+
+	const uint8_t *take(size_t size) {
+		if ((size_t)(mEnd - mData) < size) {
+			return nullptr;
+		}
+		const uint8_t *data = mData;
+		mData += size;
+		return data;
+	}
+
+	bool get(void *data, size_t size) {
+		const uint8_t *src = take(size);
+		if (src && size) {
+			memcpy(data, src, size);
+		}
+		return src != nullptr;
+	}
+
+private:
+	const uint8_t *mData;
+	const uint8_t *mEnd;
+};
+
+/**
+Appends a page to a buffer in the raw page format: scanlines are copied as they are,
+instead of encoding the page in the format of the multipage bitmap
+*/
+void
+EncodePage(FIBITMAP *dib, std::vector<uint8_t> &buffer, bool with_pixels = true) {
+	PageHeader header{};
+	header.magic = PAGE_MAGIC;
+	header.type = FreeImage_GetImageType(dib);
+	header.width = FreeImage_GetWidth(dib);
+	header.height = FreeImage_GetHeight(dib);
+	header.bpp = FreeImage_GetBPP(dib);
+	header.masks[0] = FreeImage_GetRedMask(dib);
+	header.masks[1] = FreeImage_GetGreenMask(dib);
+	header.masks[2] = FreeImage_GetBlueMask(dib);
+	header.dots_per_meter[0] = FreeImage_GetDotsPerMeterX(dib);
+	header.dots_per_meter[1] = FreeImage_GetDotsPerMeterY(dib);
+	header.palette_size = FreeImage_GetPalette(dib) ? FreeImage_GetColorsUsed(dib) : 0;
+	header.transparency_count = FreeImage_GetTransparencyCount(dib);
+
+	const FIICCPROFILE *icc = FreeImage_GetICCProfile(dib);
+	header.icc_size = (icc && icc->data) ? icc->size : 0;
+	header.icc_flags = icc ? icc->flags : 0;
+
+	for (int model = FIMD_COMMENTS; model <= FIMD_EXIF_RAW; model++) {
+		header.tag_count += FreeImage_GetMetadataCount((FREE_IMAGE_MDMODEL)model, dib);
+	}
+
+	FIBITMAP *thumbnail = FreeImage_GetThumbnail(dib);
+
+	header.flags = ((with_pixels && FreeImage_HasPixels(dib)) ? PAGE_PIXELS : 0)
+		| (FreeImage_IsTransparent(dib) ? PAGE_TRANSPARENT : 0)
+		| (FreeImage_GetBackgroundColor(dib, &header.background) ? PAGE_BACKGROUND : 0)
+		| (thumbnail ? PAGE_THUMBNAIL : 0);
+
+	PagePut(buffer, &header, sizeof(header));
+	PagePut(buffer, FreeImage_GetPalette(dib), header.palette_size * sizeof(FIRGBA8));
+	PagePut(buffer, FreeImage_GetTransparencyTable(dib), header.transparency_count);
+	PagePut(buffer, header.icc_size ? icc->data : nullptr, header.icc_size);
+
+	// metadata
+
+	for (int model = FIMD_COMMENTS; model <= FIMD_EXIF_RAW; model++) {
+		FITAG *tag = nullptr;
+		FIMETADATA *mdhandle = FreeImage_FindFirstMetadata((FREE_IMAGE_MDMODEL)model, dib, &tag);
+		if (mdhandle) {
+			do {
+				const char *key = FreeImage_GetTagKey(tag);
+				const char *description = FreeImage_GetTagDescription(tag);
+
+				PageTagHeader tag_header{};
+				tag_header.model = (uint16_t)model;
+				tag_header.id = FreeImage_GetTagID(tag);
+				tag_header.type = (uint16_t)FreeImage_GetTagType(tag);
+				tag_header.key_length = key ? (uint16_t)strlen(key) : 0;
+				tag_header.description_length = description ? (uint16_t)strlen(description) : 0;
+				tag_header.count = FreeImage_GetTagCount(tag);
+				tag_header.length = FreeImage_GetTagValue(tag) ? FreeImage_GetTagLength(tag) : 0;
+
+				PagePut(buffer, &tag_header, sizeof(tag_header));
+				PagePut(buffer, key, tag_header.key_length);
+				PagePut(buffer, description, tag_header.description_length);
+				PagePut(buffer, FreeImage_GetTagValue(tag), tag_header.length);
+			} while (FreeImage_FindNextMetadata(mdhandle, &tag));
+
+			FreeImage_FindCloseMetadata(mdhandle);
+		}
+	}
+
+	// pixels
+
+	if (header.flags & PAGE_PIXELS) {
+		const unsigned line = FreeImage_GetLine(dib);
+		for (unsigned y = 0; y < header.height; y++) {
+			PagePut(buffer, FreeImage_GetConstScanLine(dib, y), line);
+		}
+	}
+
+	if (thumbnail) {
+		EncodePage(thumbnail, buffer);
+	}
+}
+
+/**
+Reads a page written by EncodePage, returns NULL if the page is truncated or can't be allocated.
+Pixels of a page written without them are wrapped or allocated as given by pixels.
+*/
+FIBITMAP *
+DecodePage(PageReader &in, const RawBitmapPixels *pixels = nullptr) {
+	PageHeader header;
+	if (!in.get(&header, sizeof(header)) || (header.magic != PAGE_MAGIC)) {
+		return nullptr;
+	}
+
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib((pixels && pixels->bits)
+		? FreeImage_AllocateHeaderForSharedBits(pixels->bits, pixels->pitch, pixels->owner, (FREE_IMAGE_TYPE)header.type,
+			header.width, header.height, header.bpp, header.masks[0], header.masks[1], header.masks[2])
+		: FreeImage_AllocateHeaderT(!(pixels || (header.flags & PAGE_PIXELS)), (FREE_IMAGE_TYPE)header.type,
+			header.width, header.height, header.bpp, header.masks[0], header.masks[1], header.masks[2]), &FreeImage_Unload);
+	if (!dib) {
+		return nullptr;
+	}
+
+	FreeImage_SetDotsPerMeterX(dib.get(), header.dots_per_meter[0]);
+	FreeImage_SetDotsPerMeterY(dib.get(), header.dots_per_meter[1]);
+
+	if (header.palette_size) {
+		if ((header.palette_size != FreeImage_GetColorsUsed(dib.get())) || !in.get(FreeImage_GetPalette(dib.get()), header.palette_size * sizeof(FIRGBA8))) {
+			return nullptr;
+		}
+	}
+
+	const uint8_t *table = in.take(header.transparency_count);
+	if (!table) {
+		return nullptr;
+	}
+	if (header.transparency_count) {
+		FreeImage_SetTransparencyTable(dib.get(), const_cast<uint8_t *>(table), (int)header.transparency_count);
+	}
+	FreeImage_SetTransparent(dib.get(), (header.flags & PAGE_TRANSPARENT) ? TRUE : FALSE);
+
+	if (header.flags & PAGE_BACKGROUND) {
+		FreeImage_SetBackgroundColor(dib.get(), &header.background);
+	}
+
+	if (header.icc_size) {
+		const uint8_t *icc_data = in.take(header.icc_size);
+		if (!icc_data) {
+			return nullptr;
+		}
+		if (FIICCPROFILE *icc = FreeImage_CreateICCProfile(dib.get(), const_cast<uint8_t *>(icc_data), (long)header.icc_size)) {
+			icc->flags = (uint16_t)header.icc_flags;
+		}
+	} else if (header.icc_flags) {
+		FreeImage_GetICCProfile(dib.get())->flags = (uint16_t)header.icc_flags;
+	}
+
+	// metadata
+
+	for (uint32_t i = 0; i < header.tag_count; i++) {
+		PageTagHeader tag_header;
+		if (!in.get(&tag_header, sizeof(tag_header))) {
+			return nullptr;
+		}
+		const uint8_t *key = in.take(tag_header.key_length);
+		const uint8_t *description = in.take(tag_header.description_length);
+		const uint8_t *value = in.take(tag_header.length);
+		if (!key || !description || !value) {
+			return nullptr;
+		}
+
+		const std::string tag_key((const char *)key, tag_header.key_length);
+		const std::string tag_description((const char *)description, tag_header.description_length);
+
+		std::unique_ptr<FITAG, decltype(&FreeImage_DeleteTag)> tag(FreeImage_CreateTag(), &FreeImage_DeleteTag);
+		if (!tag) {
+			return nullptr;
+		}
+		FreeImage_SetTagKey(tag.get(), tag_key.c_str());
+		if (tag_header.description_length) {
+			FreeImage_SetTagDescription(tag.get(), tag_description.c_str());
+		}
+		FreeImage_SetTagID(tag.get(), tag_header.id);
+		FreeImage_SetTagType(tag.get(), (FREE_IMAGE_MDTYPE)tag_header.type);
+		FreeImage_SetTagCount(tag.get(), tag_header.count);
+		FreeImage_SetTagLength(tag.get(), tag_header.length);
+		if (tag_header.length) {
+			FreeImage_SetTagValue(tag.get(), value);
+		}
+		FreeImage_SetMetadata((FREE_IMAGE_MDMODEL)tag_header.model, dib.get(), tag_key.c_str(), tag.get());
+	}
+
+	// pixels
+
+	if (header.flags & PAGE_PIXELS) {
+		const unsigned line = FreeImage_GetLine(dib.get());
+		for (unsigned y = 0; y < header.height; y++) {
+			if (!in.get(FreeImage_GetScanLine(dib.get(), y), line)) {
+				return nullptr;
+			}
+		}
+	}
+
+	if (header.flags & PAGE_THUMBNAIL) {
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> thumbnail(DecodePage(in), &FreeImage_Unload);
+		if (!thumbnail) {
+			return nullptr;
+		}
+		FreeImage_SetThumbnail(dib.get(), thumbnail.get());
+	}
+
+	return dib.release();
+}
+
 } //< ns
 
+void
+FreeImage_EncodeRawBitmap(FIBITMAP *dib, std::vector<uint8_t> &buffer, bool with_pixels) {
+	EncodePage(dib, buffer, with_pixels);
+}
+
+FIBITMAP *
+FreeImage_DecodeRawBitmap(const uint8_t *data, size_t size, const RawBitmapPixels *pixels) {
+	PageReader in(data, size);
+	return DecodePage(in, pixels);
+}
+
 
 // =====================================================================
 // Internal Multipage functions
@@ -163,32 +711,21 @@ FreeImage_FindBlock(FIMULTIBITMAP *bitmap, int position) {
 
 	// step 1: find the block that matches the given position
 
-	int prev_count = 0;
-	int count = 0;
-	BlockListIterator i;
-
-	for (i = header->m_blocks.begin(); i != header->m_blocks.end(); ++i) {
-		prev_count = count;
-		
-		count += i->getPageCount();
-
-		if (count > position) {
-			break;
-		}
-	}
+	int offset = 0;
+	BlockListIterator i = header->m_blocks.find(position, offset);
 
 	// step 2: make sure we found the node. from here it gets a little complicated:
 	// * if the block is single page, just return it
 	// * if the block is a span of pages, split it in 3 new blocks
 	//   and return the middle block, which is now a single page
 
-	if ((i != header->m_blocks.end()) && (count > position)) {
+	if (i != header->m_blocks.end()) {
 		
 		if (i->isSinglePage()) {
 			return i;
 		}
 
-		const int item = i->getStart() + (position - prev_count);
+		const int item = i->getStart() + offset;
 
 		// left part
 
@@ -215,11 +752,79 @@ FreeImage_FindBlock(FIMULTIBITMAP *bitmap, int position) {
 		return block_target;
 	}
 
-	// we should never go here ...
-	assert(false);
+	// the position is out of range
+
 	return header->m_blocks.end();
 }
 
+/**
+Returns the plugin data of the source, opened on first use and kept until FreeImage_CloseMultiBitmap
+*/
+static void *
+FreeImage_GetReadData(MULTIBITMAPHEADER *header) {
+	if (!header->read_data && header->handle) {
+		header->io.seek_proc(header->handle, 0, SEEK_SET);
+		header->read_data = header->node->Open(&header->io, header->handle, true);
+	}
+	return header->read_data;
+}
+
+static void
+FreeImage_CloseReadData(MULTIBITMAPHEADER *header) {
+	if (header->read_data) {
+		header->node->Close(&header->io, header->handle, header->read_data);
+		header->read_data = nullptr;
+	}
+}
+
+/**
+Stores a page in the cache in the raw page format, returns an invalid block on failure
+or if the format of the multipage bitmap can't save the page
+*/
+static PageBlock
+FreeImage_WritePageToCache(MULTIBITMAPHEADER *header, FIBITMAP *data) {
+	const FREE_IMAGE_TYPE type = FreeImage_GetImageType(data);
+	if (!FreeImage_FIFSupportsExportType(header->cache_fif, type)) {
+		return {};
+	}
+	if ((type == FIT_BITMAP) && !FreeImage_FIFSupportsExportBPP(header->cache_fif, FreeImage_GetBPP(data))) {
+		return {};
+	}
+
+	try {
+		std::vector<uint8_t> buffer;
+		buffer.reserve(FreeImage_GetMemorySize(data));
+		EncodePage(data, buffer);
+		if (buffer.size() > INT_MAX) {
+			return {};
+		}
+
+		const int ref = header->m_cachefile.writeFile(buffer.data(), (int)buffer.size());
+		return PageBlock(BLOCK_REFERENCE, ref, (int)buffer.size());
+	} catch (std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return {};
+}
+
+/**
+Loads a page stored in the cache by FreeImage_WritePageToCache
+*/
+static FIBITMAP *
+FreeImage_ReadPageFromCache(MULTIBITMAPHEADER *header, const PageBlock &block) {
+	std::unique_ptr<uint8_t[]> buffer(new(std::nothrow) uint8_t[block.getSize()]);
+	if (!buffer) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+		return nullptr;
+	}
+	if (!header->m_cachefile.readFile(buffer.get(), block.getReference(), block.getSize())) {
+		return nullptr;
+	}
+
+	PageReader in(buffer.get(), block.getSize());
+	return DecodePage(in);
+}
+
 int DLL_CALLCONV
 FreeImage_InternalGetPageCount(FIMULTIBITMAP *bitmap) {
 	if (bitmap) {
@@ -273,14 +878,14 @@ FreeImage_OpenMultiBitmap(FREE_IMAGE_FORMAT fif, const char *filename, FIBOOL cr
 
 				bitmap->data = header.get();
 
-				// cache the page count
+				// count the pages of the source
 
-				header->page_count = FreeImage_InternalGetPageCount(bitmap.get());
+				const int page_count = FreeImage_InternalGetPageCount(bitmap.get());
 
 				// allocate a continueus block to describe the bitmap
 
 				if (!create_new) {
-					header->m_blocks.push_back(PageBlock(BLOCK_CONTINUEUS, 0, header->page_count - 1));
+					header->m_blocks.push_back(PageBlock(BLOCK_CONTINUEUS, 0, page_count - 1));
 				}
 
 				// set up the cache
@@ -336,13 +941,13 @@ FreeImage_OpenMultiBitmapFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_h
 
 					bitmap->data = header.get();
 
-					// cache the page count
+					// count the pages of the source
 
-					header->page_count = FreeImage_InternalGetPageCount(bitmap.get());
+					const int page_count = FreeImage_InternalGetPageCount(bitmap.get());
 
 					// allocate a continueus block to describe the bitmap
 					
-					header->m_blocks.push_back(PageBlock(BLOCK_CONTINUEUS, 0, header->page_count - 1));
+					header->m_blocks.push_back(PageBlock(BLOCK_CONTINUEUS, 0, page_count - 1));
 					
 					// no need to open cache - it is in-memory by default
 
@@ -375,13 +980,7 @@ FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap,
 			// dst data
 			void *data = node->Open(io, handle, false);
 			// src data
-			void *data_read{};
-
-			if (header->handle) {
-				// open src
-				header->io.seek_proc(header->handle, 0, SEEK_SET);
-				data_read = header->node->Open(&header->io, header->handle, true);
-			}
+			void *data_read = FreeImage_GetReadData(header);
 
 			// write all the pages to the file using handle and io
 
@@ -409,20 +1008,9 @@ FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap,
 
 						case BLOCK_REFERENCE:
 						{
-							// read the compressed data
-
-							auto *compressed_data = (uint8_t*)malloc(i->getSize() * sizeof(uint8_t));
-							
-							header->m_cachefile.readFile((uint8_t *)compressed_data, i->getReference(), i->getSize());
-
-							// uncompress the data
+							// read the page from the cache
 
-							FIMEMORY *hmem = FreeImage_OpenMemory(compressed_data, i->getSize());
-							FIBITMAP *dib = FreeImage_LoadFromMemory(header->cache_fif, hmem, 0);
-							FreeImage_CloseMemory(hmem);
-
-							// get rid of the buffer
-							free(compressed_data);
+							FIBITMAP *dib = FreeImage_ReadPageFromCache(header, *i);
 
 							// save the data
 
@@ -441,9 +1029,7 @@ FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap,
 				}
 			}
 
-			// close the files
-
-			header->node->Close(&header->io, header->handle, data_read);
+			// close the destination, the source stays open for the next pages
 
 			node->Close(io, handle, data);
 
@@ -489,6 +1075,7 @@ FreeImage_CloseMultiBitmap(FIMULTIBITMAP *bitmap, int flags) {
 							FreeImage_OutputMessageProc(header->fif, "Failed to close %s, %s", spool_name.c_str(), strerror(errno));
 						}
 					}
+					FreeImage_CloseReadData(header);
 					if (header->handle) {
 						fclose((FILE *)header->handle);
 					}
@@ -509,6 +1096,7 @@ FreeImage_CloseMultiBitmap(FIMULTIBITMAP *bitmap, int flags) {
 				}
 
 			} else {
+				FreeImage_CloseReadData(header);
 				if (header->handle && !header->m_filename.empty()) {
 					fclose((FILE *)header->handle);
 				}
@@ -540,15 +1128,7 @@ FreeImage_GetPageCount(FIMULTIBITMAP *bitmap) {
 	if (bitmap) {
 		auto *header = FreeImage_GetMultiBitmapHeader(bitmap);
 
-		if (header->page_count == -1) {
-			header->page_count = 0;
-
-			for (BlockListIterator i = header->m_blocks.begin(); i != header->m_blocks.end(); ++i) {
-				header->page_count += i->getPageCount();
-			}
-		}
-
-		return header->page_count;
+		return header->m_blocks.pageCount();
 	}
 
 	return 0;
@@ -556,41 +1136,11 @@ FreeImage_GetPageCount(FIMULTIBITMAP *bitmap) {
 
 static PageBlock
 FreeImage_SavePageToBlock(MULTIBITMAPHEADER *header, FIBITMAP *data) {
-	PageBlock res;
-
 	if (header->read_only || !header->locked_pages.empty()) {
-		return res;
-	}
-
-	uint32_t compressed_size = 0;
-	uint8_t *compressed_data{};
-
-	// compress the bitmap data
-
-	// open a memory handle
-	FIMEMORY *hmem = FreeImage_OpenMemory();
-	if (!hmem) {
-		return res;
-	}
-	// save the file to memory
-	if (!FreeImage_SaveToMemory(header->cache_fif, data, hmem, 0)) {
-		FreeImage_CloseMemory(hmem);
-		return res;
-	}
-	// get the buffer from the memory stream
-	if (!FreeImage_AcquireMemory(hmem, &compressed_data, &compressed_size)) {
-		FreeImage_CloseMemory(hmem);
-		return res;
+		return {};
 	}
 
-	// write the compressed data to the cache
-	int ref = header->m_cachefile.writeFile(compressed_data, compressed_size);
-	// get rid of the compressed data
-	FreeImage_CloseMemory(hmem);
-	
-	res = PageBlock(BLOCK_REFERENCE, ref, compressed_size);
-	
-	return res;
+	return FreeImage_WritePageToCache(header, data);
 }
 
 void DLL_CALLCONV
@@ -605,7 +1155,6 @@ FreeImage_AppendPage(FIMULTIBITMAP *bitmap, FIBITMAP *data) {
 		// add the block
 		header->m_blocks.push_back(block);
 		header->changed = TRUE;
-		header->page_count = -1;
 	}
 }
 
@@ -630,7 +1179,6 @@ FreeImage_InsertPage(FIMULTIBITMAP *bitmap, int page, FIBITMAP *data) {
 		}
 
 		header->changed = TRUE;
-		header->page_count = -1;
 	}
 }
 
@@ -656,7 +1204,6 @@ FreeImage_DeletePage(FIMULTIBITMAP *bitmap, int page) {
 					}
 
 					header->changed = TRUE;
-					header->page_count = -1;
 				}
 			}
 		}
@@ -676,34 +1223,160 @@ FreeImage_LockPage(FIMULTIBITMAP *bitmap, int page) {
 			}
 		}
 
-		// open the bitmap
+		BlockListIterator i = FreeImage_FindBlock(bitmap, page);
 
-		header->io.seek_proc(header->handle, 0, SEEK_SET);
+		if (i == header->m_blocks.end()) {
+			return nullptr;
+		}
+
+		FIBITMAP* dib = nullptr;
+
+		if (i->m_type == BLOCK_REFERENCE) {
+			// pages added or modified are read from the cache
 
-		void *data = header->node->Open(&header->io, header->handle, true);
+			dib = FreeImage_ReadPageFromCache(header, *i);
+		} else {
+			// open the bitmap, the plugin data is reused by the next pages
+
+			void *data = FreeImage_GetReadData(header);
+
+			// load the bitmap data
+
+			if (data) {
+				dib = header->node->Load(&header->io, header->handle, i->getStart(), header->load_flags, data);
+			}
+		}
 
-		// load the bitmap data
+		if (dib) {
+			header->locked_pages[dib] = page;
 
-		if (data) {
-			FIBITMAP* dib = header->node->Load(&header->io, header->handle, page, header->load_flags, data);
+			return dib;
+		}
+	}
+
+	return nullptr;
+}
 
-			// close the file
+FIBOOL DLL_CALLCONV
+FreeImage_LockPages(FIMULTIBITMAP *bitmap, const int *pages, int count, FIBITMAP **out) {
+	if (!bitmap || !pages || !out || (count <= 0)) {
+		return FALSE;
+	}
 
-			header->node->Close(&header->io, header->handle, data);
+	auto *header = FreeImage_GetMultiBitmapHeader(bitmap);
 
-			// if there was still another bitmap open, get rid of it
+	std::fill(out, out + count, nullptr);
 
-			if (dib) {
-				header->locked_pages[dib] = page;
+	try {
+		// find the pages on the calling thread: pages added or modified are read from the cache,
+		// the others are loaded from the source, sorted by position
+
+		struct SourcePage {
+			int position;
+			int index;
+		};
+		std::vector<SourcePage> loads;
+
+		std::set<int> locked;
+		for (const auto &i : header->locked_pages) {
+			locked.insert(i.second);
+		}
 
-				return dib;
+		const int page_count = FreeImage_GetPageCount(bitmap);
+		for (int i = 0; i < count; i++) {
+			if ((pages[i] < 0) || (pages[i] >= page_count) || !locked.insert(pages[i]).second) {
+				continue;
 			}
 
-			return nullptr;
+			BlockListIterator block = FreeImage_FindBlock(bitmap, pages[i]);
+
+			if (block == header->m_blocks.end()) {
+				continue;
+			}
+			if (block->m_type == BLOCK_REFERENCE) {
+				out[i] = FreeImage_ReadPageFromCache(header, *block);
+			} else {
+				loads.push_back({ block->getStart(), i });
+			}
+		}
+
+		std::sort(loads.begin(), loads.end(), [](const SourcePage &a, const SourcePage &b) {
+			return a.position < b.position;
+		});
+
+		// decode the source pages, by parallel bands reading the source through their own handle when the plugin is reentrant
+
+		const bool own_handles = header->handle && (header->from_memory || !header->m_filename.empty());
+		const uint32_t threads = FreeImage_GetThreadCount();
+
+		if ((loads.size() > 1) && (threads > 1) && own_handles && (header->node->GetConcurrency() & FIF_CONCURRENT_LOAD)) {
+			const unsigned grain = (unsigned)((loads.size() + 2 * threads - 1) / (2 * threads));
+
+			ParallelFor(0, (unsigned)loads.size(), grain, [&](unsigned first, unsigned last) {
+				FreeImageIO io;
+				fi_handle handle{};
+				FILE *file{};
+				FIMEMORY *stream{};
+
+				if (header->from_memory) {
+					uint8_t *data{};
+					uint32_t size = 0;
+					if (!FreeImage_AcquireMemory((FIMEMORY *)header->handle, &data, &size)) {
+						return;
+					}
+					SetMemoryIO(&io);
+					handle = stream = FreeImage_OpenMemory(data, size);
+				} else {
+					SetDefaultIO(&io);
+					handle = file = fopen(header->m_filename.c_str(), "rb");
+				}
+
+				if (handle) {
+					if (void *data = header->node->Open(&io, handle, true)) {
+						for (unsigned k = first; k < last; k++) {
+							out[loads[k].index] = header->node->Load(&io, handle, loads[k].position, header->load_flags, data);
+						}
+						header->node->Close(&io, handle, data);
+					}
+				}
+
+				if (file) {
+					fclose(file);
+				}
+				if (stream) {
+					FreeImage_CloseMemory(stream);
+				}
+			});
+		} else if (!loads.empty()) {
+			if (void *data = FreeImage_GetReadData(header)) {
+				for (const SourcePage &page : loads) {
+					out[page.index] = header->node->Load(&header->io, header->handle, page.position, header->load_flags, data);
+				}
+			}
+		}
+
+		// lock the pages
+
+		FIBOOL success = TRUE;
+		for (int i = 0; i < count; i++) {
+			if (out[i]) {
+				header->locked_pages[out[i]] = pages[i];
+			} else {
+				success = FALSE;
+			}
 		}
+		return success;
+	} catch (std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
 	}
 
-	return nullptr;
+	for (int i = 0; i < count; i++) {
+		if (out[i] && (header->locked_pages.find(out[i]) == header->locked_pages.end())) {
+			FreeImage_Unload(out[i]);
+		}
+		out[i] = nullptr;
+	}
+	return FALSE;
 }
 
 void DLL_CALLCONV
@@ -723,31 +1396,15 @@ FreeImage_UnlockPage(FIMULTIBITMAP *bitmap, FIBITMAP *page, FIBOOL changed) {
 
 				BlockListIterator i = FreeImage_FindBlock(bitmap, header->locked_pages[page]);
 
-				// compress the data
-
-				uint32_t compressed_size = 0;
-				uint8_t *compressed_data{};
-
-				// open a memory handle
-				FIMEMORY *hmem = FreeImage_OpenMemory();
-				// save the page to memory
-				FreeImage_SaveToMemory(header->cache_fif, page, hmem, 0);
-				// get the buffer from the memory stream
-				FreeImage_AcquireMemory(hmem, &compressed_data, &compressed_size);
-
 				// write the data to the cache
-				
-				if (i->m_type == BLOCK_REFERENCE) {
-					header->m_cachefile.deleteFile(i->getReference());
-				}
 
-				int iPage = header->m_cachefile.writeFile(compressed_data, compressed_size);
-				
-				*i = PageBlock(BLOCK_REFERENCE, iPage, compressed_size);
-				
-				// get rid of the compressed data
+				if (const PageBlock block = FreeImage_WritePageToCache(header, page)) {
+					if (i->m_type == BLOCK_REFERENCE) {
+						header->m_cachefile.deleteFile(i->getReference());
+					}
 
-				FreeImage_CloseMemory(hmem);
+					header->m_blocks.assign(i, block);
+				}
 			}
 
 			// reset the locked page so that another page can be locked
@@ -836,18 +1493,19 @@ FreeImage_LoadMultiBitmapFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int
 					header->read_only = read_only;
 					header->cache_fif = fif;
 					header->load_flags = flags;
+					header->from_memory = TRUE;
 
 					// store the MULTIBITMAPHEADER in the surrounding FIMULTIBITMAP structure
 
 					bitmap->data = header.get();
 
-					// cache the page count
+					// count the pages of the source
 
-					header->page_count = FreeImage_InternalGetPageCount(bitmap.get());
+					const int page_count = FreeImage_InternalGetPageCount(bitmap.get());
 
 					// allocate a continueus block to describe the bitmap
 
-					header->m_blocks.push_back(PageBlock(BLOCK_CONTINUEUS, 0, header->page_count - 1));
+					header->m_blocks.push_back(PageBlock(BLOCK_CONTINUEUS, 0, page_count - 1));
 
 					// no need to open cache - it is in-memory by default
 
@@ -872,3 +1530,89 @@ FreeImage_SaveMultiBitmapToMemory(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap,
 
 	return FALSE;
 }
+
+// =====================================================================
+// Forward-only multipage writer
+// =====================================================================
+
+FIMULTIWRITER * DLL_CALLCONV
+FreeImage_OpenMultiBitmapWriter(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags) {
+	if (!io || !handle) {
+		return nullptr;
+	}
+
+	auto& plugins = PluginsRegistrySingleton::Instance();
+	PluginNodeBase *node = plugins ? plugins->FindFromFIF(fif) : nullptr;
+	if (!node || !node->IsEnabled() || !node->SupportsSave()) {
+		FreeImage_OutputMessageProc(fif, "FreeImage_OpenMultiBitmapWriter: the format can't be saved");
+		return nullptr;
+	}
+
+	try {
+		auto writer = std::make_unique<FIMULTIWRITER>();
+		auto header = std::make_unique<MULTIWRITERHEADER>();
+		header->node = node;
+		header->fif = fif;
+		header->io = *io;
+		header->handle = handle;
+		header->flags = flags;
+
+		// open the destination once, each page is then encoded straight to it
+
+		header->data = node->Open(&header->io, handle, false);
+
+		writer->data = header.release();
+		return writer.release();
+	} catch (std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(fif, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return nullptr;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_WritePage(FIMULTIWRITER *writer, FIBITMAP *dib) {
+	if (!writer || !writer->data || !dib) {
+		return FALSE;
+	}
+	auto *header = static_cast<MULTIWRITERHEADER *>(writer->data);
+
+	// a failed page leaves the destination in an unknown state
+	if (!header->success) {
+		return FALSE;
+	}
+	if (!FreeImage_HasPixels(dib)) {
+		FreeImage_OutputMessageProc(header->fif, "FreeImage_WritePage: cannot save \"header only\" formats");
+		return FALSE;
+	}
+
+	header->success = header->node->Save(dib, &header->io, header->handle, header->page_count, header->flags, header->data) ? TRUE : FALSE;
+	if (header->success) {
+		++header->page_count;
+	}
+	return header->success;
+}
+
+int DLL_CALLCONV
+FreeImage_GetWrittenPageCount(FIMULTIWRITER *writer) {
+	return (writer && writer->data) ? static_cast<MULTIWRITERHEADER *>(writer->data)->page_count : 0;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_CloseMultiBitmapWriter(FIMULTIWRITER *writer) {
+	if (!writer) {
+		return FALSE;
+	}
+	FIBOOL success = FALSE;
+	if (auto *header = static_cast<MULTIWRITERHEADER *>(writer->data)) {
+
+		// let the plugin write its trailer (GIF) or last directory links (TIFF)
+
+		header->node->Close(&header->io, header->handle, header->data);
+		success = header->success;
+
+		delete header;
+	}
+	delete writer;
+
+	return success;
+}
@@ -33,6 +33,11 @@
 #include "Quantizers.h"
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "CPUDispatch.h"
+
+#include <algorithm>
+#include <climits>
+#include <vector>
 
 
 // Four primes near 500 - assume no image has a length so large
@@ -46,6 +51,289 @@
 
 // ----------------------------------------------------------------
 
+namespace {
+
+	/**
+	Distance of every neuron to a biased (b,g,r) sample for NNQuantizer::contest, with the freq and bias update.
+	@return Returns the best biased neuron, bestpos receives the closest neuron (first one on ties)
+	*/
+	using ContestKernel = int (*)(int (*network)[4], int *bias, int *freq, int netsize, int b, int g, int r, int *bestpos);
+
+	/**
+	Exhaustive search for the unbiased (b,g,r) colour in the sorted network, equivalent to NNQuantizer::inxsearch.
+	planes holds the blue, green and red values of the neurons in three planes of stride neurons (a multiple of 4,
+	padded with unreachable neurons). On ties, inxsearch keeps the first neuron visited from netindex[g] outwards
+	(start, start - 1, start + 1, start - 2, ...), i.e. the one of smallest zigzag rank of k - start:
+	keys (dist << 9) | rank are unique and their minimum is the neuron found by inxsearch.
+	@return Returns the position of the neuron in the sorted network
+	*/
+	using SearchKernel = int (*)(const int32_t *planes, unsigned stride, int b, int g, int r, int start);
+
+	/// Offset k - start of a neuron from its rank (d << 1) ^ (d >> 31) in the inxsearch visiting order
+	inline int UnZigZag(int z) {
+		return (z >> 1) ^ -(z & 1);
+	}
+
+	/// Continues a contest from neuron i with the best distances found so far
+	int ContestTail(int (*network)[4], int *bias, int *freq, int i, int netsize, int b, int g, int r, int bestd, int bestpos, int bestbiasd, int bestbiaspos, int *best) {
+		for (; i < netsize; i++) {
+			const int *n = network[i];
+			const int dist = abs(n[FI_RGBA_BLUE] - b) + abs(n[FI_RGBA_GREEN] - g) + abs(n[FI_RGBA_RED] - r);
+			if (dist < bestd) {
+				bestd = dist;
+				bestpos = i;
+			}
+			const int biasdist = dist - (bias[i] >> (intbiasshift - netbiasshift));
+			if (biasdist < bestbiasd) {
+				bestbiasd = biasdist;
+				bestbiaspos = i;
+			}
+			const int betafreq = (freq[i] >> betashift);
+			freq[i] -= betafreq;
+			bias[i] += (betafreq << gammashift);
+		}
+		*best = bestpos;
+		return bestbiaspos;
+	}
+
+	int ContestNeurons(int (*network)[4], int *bias, int *freq, int netsize, int b, int g, int r, int *bestpos) {
+		return ContestTail(network, bias, freq, 0, netsize, b, g, r, INT_MAX, -1, INT_MAX, -1, bestpos);
+	}
+
+	/// Smallest of 4 lanes values, the smallest position on ties
+	inline void ReduceLanes(const int32_t value[4], const int32_t position[4], int &best, int &best_position) {
+		best = value[0];
+		best_position = position[0];
+		for (int lane = 1; lane < 4; lane++) {
+			if ((value[lane] < best) || ((value[lane] == best) && (position[lane] < best_position))) {
+				best = value[lane];
+				best_position = position[lane];
+			}
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+	inline __m128i Abs_SSE2(__m128i x) {
+		const __m128i sign = _mm_srai_epi32(x, 31);
+		return _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+	}
+
+	inline __m128i Select_SSE2(__m128i mask, __m128i a, __m128i b) {
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	int ContestNeurons_SSE2(int (*network)[4], int *bias, int *freq, int netsize, int b, int g, int r, int *bestpos) {
+		int target[4] = {};
+		target[FI_RGBA_BLUE] = b;
+		target[FI_RGBA_GREEN] = g;
+		target[FI_RGBA_RED] = r;
+		const __m128i t0 = _mm_set1_epi32(target[0]);
+		const __m128i t1 = _mm_set1_epi32(target[1]);
+		const __m128i t2 = _mm_set1_epi32(target[2]);
+		const __m128i four = _mm_set1_epi32(4);
+
+		__m128i position = _mm_setr_epi32(0, 1, 2, 3);
+		__m128i bestd = _mm_set1_epi32(INT_MAX), bestbiasd = bestd;
+		__m128i best = _mm_set1_epi32(-1), bestbias = best;
+
+		int i = 0;
+		for (; i + 4 <= netsize; i += 4) {
+			// transpose 4 neurons into channels
+			const __m128i n0 = _mm_loadu_si128((const __m128i *)network[i]);
+			const __m128i n1 = _mm_loadu_si128((const __m128i *)network[i + 1]);
+			const __m128i n2 = _mm_loadu_si128((const __m128i *)network[i + 2]);
+			const __m128i n3 = _mm_loadu_si128((const __m128i *)network[i + 3]);
+			const __m128i lo01 = _mm_unpacklo_epi32(n0, n1), lo23 = _mm_unpacklo_epi32(n2, n3);
+			const __m128i hi01 = _mm_unpackhi_epi32(n0, n1), hi23 = _mm_unpackhi_epi32(n2, n3);
+			const __m128i c0 = _mm_unpacklo_epi64(lo01, lo23);
+			const __m128i c1 = _mm_unpackhi_epi64(lo01, lo23);
+			const __m128i c2 = _mm_unpacklo_epi64(hi01, hi23);
+
+			const __m128i dist = _mm_add_epi32(_mm_add_epi32(Abs_SSE2(_mm_sub_epi32(c0, t0)), Abs_SSE2(_mm_sub_epi32(c1, t1))), Abs_SSE2(_mm_sub_epi32(c2, t2)));
+			const __m128i nearer = _mm_cmplt_epi32(dist, bestd);
+			bestd = Select_SSE2(nearer, dist, bestd);
+			best = Select_SSE2(nearer, position, best);
+
+			const __m128i vbias = _mm_loadu_si128((const __m128i *)(bias + i));
+			const __m128i biasdist = _mm_sub_epi32(dist, _mm_srai_epi32(vbias, intbiasshift - netbiasshift));
+			const __m128i better = _mm_cmplt_epi32(biasdist, bestbiasd);
+			bestbiasd = Select_SSE2(better, biasdist, bestbiasd);
+			bestbias = Select_SSE2(better, position, bestbias);
+
+			const __m128i vfreq = _mm_loadu_si128((const __m128i *)(freq + i));
+			const __m128i betafreq = _mm_srai_epi32(vfreq, betashift);
+			_mm_storeu_si128((__m128i *)(freq + i), _mm_sub_epi32(vfreq, betafreq));
+			_mm_storeu_si128((__m128i *)(bias + i), _mm_add_epi32(vbias, _mm_slli_epi32(betafreq, gammashift)));
+
+			position = _mm_add_epi32(position, four);
+		}
+
+		alignas(16) int32_t value[4], lane_position[4];
+		int d, pos, biasd, biaspos;
+		_mm_store_si128((__m128i *)value, bestd);
+		_mm_store_si128((__m128i *)lane_position, best);
+		ReduceLanes(value, lane_position, d, pos);
+		_mm_store_si128((__m128i *)value, bestbiasd);
+		_mm_store_si128((__m128i *)lane_position, bestbias);
+		ReduceLanes(value, lane_position, biasd, biaspos);
+
+		return ContestTail(network, bias, freq, i, netsize, b, g, r, d, pos, biasd, biaspos, bestpos);
+	}
+
+	int SearchNeurons_SSE2(const int32_t *planes, unsigned stride, int b, int g, int r, int start) {
+		const int32_t *blue = planes, *green = planes + stride, *red = planes + 2 * stride;
+		const __m128i vb = _mm_set1_epi32(b), vg = _mm_set1_epi32(g), vr = _mm_set1_epi32(r);
+		const __m128i four = _mm_set1_epi32(4);
+		__m128i offset = _mm_sub_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(start));
+		__m128i best = _mm_set1_epi32(INT_MAX);
+
+		for (unsigned k = 0; k < stride; k += 4) {
+			const __m128i db = Abs_SSE2(_mm_sub_epi32(_mm_load_si128((const __m128i *)(blue + k)), vb));
+			const __m128i dg = Abs_SSE2(_mm_sub_epi32(_mm_load_si128((const __m128i *)(green + k)), vg));
+			const __m128i dr = Abs_SSE2(_mm_sub_epi32(_mm_load_si128((const __m128i *)(red + k)), vr));
+			const __m128i dist = _mm_add_epi32(_mm_add_epi32(db, dg), dr);
+			const __m128i rank = _mm_xor_si128(_mm_slli_epi32(offset, 1), _mm_srai_epi32(offset, 31));
+			const __m128i key = _mm_or_si128(_mm_slli_epi32(dist, 9), rank);
+			best = Select_SSE2(_mm_cmplt_epi32(key, best), key, best);
+			offset = _mm_add_epi32(offset, four);
+		}
+
+		alignas(16) int32_t value[4];
+		_mm_store_si128((__m128i *)value, best);
+		const int key = std::min(std::min(value[0], value[1]), std::min(value[2], value[3]));
+		return start + UnZigZag(key & 511);
+	}
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+	int ContestNeurons_NEON(int (*network)[4], int *bias, int *freq, int netsize, int b, int g, int r, int *bestpos) {
+		int target[4] = {};
+		target[FI_RGBA_BLUE] = b;
+		target[FI_RGBA_GREEN] = g;
+		target[FI_RGBA_RED] = r;
+		const int32x4_t t0 = vdupq_n_s32(target[0]);
+		const int32x4_t t1 = vdupq_n_s32(target[1]);
+		const int32x4_t t2 = vdupq_n_s32(target[2]);
+		const int32x4_t four = vdupq_n_s32(4);
+
+		static const int32_t first_positions[4] = { 0, 1, 2, 3 };
+		int32x4_t position = vld1q_s32(first_positions);
+		int32x4_t bestd = vdupq_n_s32(INT_MAX), bestbiasd = bestd;
+		int32x4_t best = vdupq_n_s32(-1), bestbias = best;
+
+		int i = 0;
+		for (; i + 4 <= netsize; i += 4) {
+			// deinterleave 4 neurons into channels
+			const int32x4x4_t n = vld4q_s32(network[i]);
+			const int32x4_t dist = vaddq_s32(vaddq_s32(vabdq_s32(n.val[0], t0), vabdq_s32(n.val[1], t1)), vabdq_s32(n.val[2], t2));
+			const uint32x4_t nearer = vcltq_s32(dist, bestd);
+			bestd = vbslq_s32(nearer, dist, bestd);
+			best = vbslq_s32(nearer, position, best);
+
+			const int32x4_t vbias = vld1q_s32(bias + i);
+			const int32x4_t biasdist = vsubq_s32(dist, vshrq_n_s32(vbias, intbiasshift - netbiasshift));
+			const uint32x4_t better = vcltq_s32(biasdist, bestbiasd);
+			bestbiasd = vbslq_s32(better, biasdist, bestbiasd);
+			bestbias = vbslq_s32(better, position, bestbias);
+
+			const int32x4_t vfreq = vld1q_s32(freq + i);
+			const int32x4_t betafreq = vshrq_n_s32(vfreq, betashift);
+			vst1q_s32(freq + i, vsubq_s32(vfreq, betafreq));
+			vst1q_s32(bias + i, vaddq_s32(vbias, vshlq_n_s32(betafreq, gammashift)));
+
+			position = vaddq_s32(position, four);
+		}
+
+		int32_t value[4], lane_position[4];
+		int d, pos, biasd, biaspos;
+		vst1q_s32(value, bestd);
+		vst1q_s32(lane_position, best);
+		ReduceLanes(value, lane_position, d, pos);
+		vst1q_s32(value, bestbiasd);
+		vst1q_s32(lane_position, bestbias);
+		ReduceLanes(value, lane_position, biasd, biaspos);
+
+		return ContestTail(network, bias, freq, i, netsize, b, g, r, d, pos, biasd, biaspos, bestpos);
+	}
+
+	int SearchNeurons_NEON(const int32_t *planes, unsigned stride, int b, int g, int r, int start) {
+		const int32_t *blue = planes, *green = planes + stride, *red = planes + 2 * stride;
+		const int32x4_t vb = vdupq_n_s32(b), vg = vdupq_n_s32(g), vr = vdupq_n_s32(r);
+		const int32x4_t four = vdupq_n_s32(4);
+		static const int32_t first_offsets[4] = { 0, 1, 2, 3 };
+		int32x4_t offset = vsubq_s32(vld1q_s32(first_offsets), vdupq_n_s32(start));
+		int32x4_t best = vdupq_n_s32(INT_MAX);
+
+		for (unsigned k = 0; k < stride; k += 4) {
+			const int32x4_t dist = vaddq_s32(vaddq_s32(vabdq_s32(vld1q_s32(blue + k), vb), vabdq_s32(vld1q_s32(green + k), vg)), vabdq_s32(vld1q_s32(red + k), vr));
+			const int32x4_t rank = veorq_s32(vshlq_n_s32(offset, 1), vshrq_n_s32(offset, 31));
+			best = vminq_s32(best, vorrq_s32(vshlq_n_s32(dist, 9), rank));
+			offset = vaddq_s32(offset, four);
+		}
+
+		int32_t value[4];
+		vst1q_s32(value, best);
+		const int key = std::min(std::min(value[0], value[1]), std::min(value[2], value[3]));
+		return start + UnZigZag(key & 511);
+	}
+#endif // FREEIMAGE_SIMD_NEON
+
+	std::atomic<ContestKernel> gContestNeurons{ ContestNeurons };
+	/// nullptr when the scalar inxsearch is used
+	std::atomic<SearchKernel> gSearchNeurons{ nullptr };
+
+	void SelectNNQuantizerKernels(unsigned features) {
+		ContestKernel contest = ContestNeurons;
+		SearchKernel search = nullptr;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			contest = ContestNeurons_SSE2;
+			search = SearchNeurons_SSE2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			contest = ContestNeurons_NEON;
+			search = SearchNeurons_NEON;
+		}
+#endif
+		gContestNeurons.store(contest, std::memory_order_relaxed);
+		gSearchNeurons.store(search, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectNNQuantizerKernels);
+
+	/**
+	Direct mapped cache of colour searches, indexed by the 15-bit colour (5 bits per channel).
+	An entry holds the full 24-bit colour and its palette index, so that a hit returns the exact search result.
+	*/
+	class ColorCache
+	{
+	public:
+		ColorCache()
+		: mEntries(32768, 0) {
+			// colour 0 belongs to slot 0, white stands for an empty slot 0
+			mEntries[0] = 0xFFFFFFu << 8;
+		}
+
+		template <typename Search>
+		uint8_t Find(int b, int g, int r, Search search) {
+			const uint32_t color = ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b;
+			uint32_t &entry = mEntries[((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3)];
+			if ((entry >> 8) != color) {
+				entry = (color << 8) | (uint8_t)search(b, g, r);
+			}
+			return (uint8_t)entry;
+		}
+
+	private:
+		std::vector<uint32_t> mEntries;
+	};
+
+} // namespace
+
+// ----------------------------------------------------------------
+
 NNQuantizer::NNQuantizer(int PaletteSize)
 {
 	netsize = PaletteSize;
@@ -235,43 +523,9 @@ int NNQuantizer::contest(int b, int g, int r) {
 	// for frequently chosen neurons, freq[i] is high and bias[i] is negative
 	// bias[i] = gamma*((1/netsize)-freq[i])
 
-	int i,dist,a,biasdist,betafreq;
-	int bestpos,bestbiaspos,bestd,bestbiasd;
-	int *p,*f, *n;
-
-	bestd = ~(((int) 1)<<31);
-	bestbiasd = bestd;
-	bestpos = -1;
-	bestbiaspos = bestpos;
-	p = bias;
-	f = freq;
+	int bestpos;
+	const int bestbiaspos = gContestNeurons.load(std::memory_order_relaxed)(network, bias, freq, netsize, b, g, r, &bestpos);
 
-	for (i = 0; i < netsize; i++) {
-		n = network[i];
-		dist = n[FI_RGBA_BLUE] - b;
-		if (dist < 0)
-			dist = -dist;
-		a = n[FI_RGBA_GREEN] - g;
-		if (a < 0)
-			a = -a;
-		dist += a;
-		a = n[FI_RGBA_RED] - r;
-		if (a < 0)
-			a = -a;
-		dist += a;
-		if (dist < bestd) {
-			bestd = dist;
-			bestpos = i;
-		}
-		biasdist = dist - ((*p)>>(intbiasshift-netbiasshift));
-		if (biasdist < bestbiasd) {
-			bestbiasd = biasdist;
-			bestbiaspos = i;
-		}
-		betafreq = (*f >> betashift);
-		*f++ -= betafreq;
-		*p++ += (betafreq << gammashift);
-	}
 	freq[bestpos] += beta;
 	bias[bestpos] -= betagamma;
 	return bestbiaspos;
@@ -490,18 +744,49 @@ FIBITMAP* NNQuantizer::Quantize(FIBITMAP *dib, int ReserveSize, FIRGBA8 *Reserve
 
 	inxbuild();
 
-	// 6) Write output image using inxsearch(b,g,r)
-
-	for (uint16_t rows = 0; rows < img_height; rows++) {
-		uint8_t *new_bits = FreeImage_GetScanLine(new_dib, rows);			
-		uint8_t *bits = FreeImage_GetScanLine(dib_ptr, rows);
+	// 6) Write output image using inxsearch(b,g,r), or its SIMD equivalent, by parallel bands of rows
 
-		for (uint16_t cols = 0; cols < img_width; cols++) {
-			new_bits[cols] = (uint8_t)inxsearch(bits[FI_RGBA_BLUE], bits[FI_RGBA_GREEN], bits[FI_RGBA_RED]);
+	const SearchKernel search_neurons = gSearchNeurons.load(std::memory_order_relaxed);
 
-			bits += 3;
+	// sorted network as blue, green and red planes, padded with neurons farther than any colour
+	const unsigned stride = (netsize + 3) & ~3u;
+	std::vector<int32_t> planes;
+	if (search_neurons) {
+		planes.assign(3 * (size_t)stride, 4096);
+		for (int k = 0; k < netsize; k++) {
+			planes[k] = network[k][FI_RGBA_BLUE];
+			planes[stride + k] = network[k][FI_RGBA_GREEN];
+			planes[2 * stride + k] = network[k][FI_RGBA_RED];
 		}
 	}
+	auto search = [&](int b, int g, int r) -> int {
+		if (search_neurons) {
+			return network[search_neurons(planes.data(), stride, b, g, r, netindex[g])][3];
+		}
+		return inxsearch(b, g, r);
+	};
+
+	const unsigned src_pitch = FreeImage_GetPitch(dib_ptr);
+	const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
+	const uint8_t *src_bits = FreeImage_GetConstBits(dib_ptr);
+	uint8_t *dst_bits = FreeImage_GetBits(new_dib);
+	const unsigned threads = std::max(1u, FreeImage_GetThreadCount());
+	// one cache per band, about one band per thread
+	const unsigned grain = std::max(CalculateBandRows(img_line), ((unsigned)img_height + threads - 1) / threads);
+
+	ParallelFor(0, img_height, grain, [&](unsigned first, unsigned last) {
+		ColorCache cache;
+		for (unsigned rows = first; rows < last; rows++) {
+			const uint8_t *bits = src_bits + (size_t)src_pitch * rows;
+			uint8_t *new_bits = dst_bits + (size_t)dst_pitch * rows;
+
+			for (int cols = 0; cols < img_width; cols++) {
+				new_bits[cols] = cache.Find(bits[FI_RGBA_BLUE], bits[FI_RGBA_GREEN], bits[FI_RGBA_RED], search);
+
+				bits += 3;
+			}
+		}
+	});
 
 	return (FIBITMAP*) new_dib;
 }
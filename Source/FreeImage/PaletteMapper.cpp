@@ -0,0 +1,277 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <vector>
+
+
+namespace {
+
+	/// Cells of 8 x 8 x 8 colours, indexed by the 15-bit colour
+	constexpr unsigned kCellBits = 5;
+	constexpr unsigned kCellSize = 1 << (8 - kCellBits);
+	constexpr unsigned kCells = 1 << (3 * kCellBits);
+
+	inline unsigned CellIndex(unsigned r, unsigned g, unsigned b) {
+		return ((r >> (8 - kCellBits)) << (2 * kCellBits)) | ((g >> (8 - kCellBits)) << kCellBits) | (b >> (8 - kCellBits));
+	}
+
+	/**
+	Nearest palette colour lookup.
+	Every cell of the colour cube lists the palette entries that may be the nearest one of a colour of the cell:
+	an entry whose distance to the cell box exceeds the smallest farthest distance of an entry to the box is never
+	the nearest. Most cells have a single candidate, the others a few, so a lookup costs a handful of distances.
+	*/
+	class PaletteMapper
+	{
+	public:
+		PaletteMapper(const FIRGBA8 *palette, unsigned count, bool dither)
+		: mCount(count), mDither(dither), mOffsets(kCells + 1) {
+			memset(mPalette, 0, sizeof(mPalette));
+			memcpy(mPalette, palette, count * sizeof(FIRGBA8));
+
+			// candidates of the cells of each red plane, then concatenated
+			const unsigned planes = 1 << kCellBits;
+			std::vector<std::vector<uint8_t>> plane_candidates(planes);
+			ParallelFor(0, planes, 1, [&](unsigned first, unsigned last) {
+				std::vector<unsigned> min_distance(mCount);
+				for (unsigned r = first; r < last; r++) {
+					std::vector<uint8_t> &candidates = plane_candidates[r];
+					for (unsigned g = 0; g < planes; g++) {
+						for (unsigned b = 0; b < planes; b++) {
+							const unsigned lo[3] = { r * kCellSize, g * kCellSize, b * kCellSize };
+							unsigned bound = UINT_MAX;
+							for (unsigned i = 0; i < mCount; i++) {
+								const int value[3] = { mPalette[i].red, mPalette[i].green, mPalette[i].blue };
+								unsigned nearest = 0, farthest = 0;
+								for (int c = 0; c < 3; c++) {
+									const int low = (int)lo[c], high = (int)(lo[c] + kCellSize - 1);
+									const int inside = (value[c] < low) ? low - value[c] : (value[c] > high) ? value[c] - high : 0;
+									const int outside = std::max(std::abs(value[c] - low), std::abs(value[c] - high));
+									nearest += inside * inside;
+									farthest += outside * outside;
+								}
+								min_distance[i] = nearest;
+								bound = std::min(bound, farthest);
+							}
+							const size_t start = candidates.size();
+							for (unsigned i = 0; i < mCount; i++) {
+								if (min_distance[i] <= bound) {
+									candidates.push_back((uint8_t)i);
+								}
+							}
+							mOffsets[(r << (2 * kCellBits)) | (g << kCellBits) | b] = (uint32_t)(candidates.size() - start);
+						}
+					}
+				}
+			});
+
+			// cells counts to offsets
+			size_t total = 0;
+			for (unsigned r = 0; r < planes; r++) {
+				total += plane_candidates[r].size();
+			}
+			mCandidates.reserve(total);
+			uint32_t offset = 0;
+			for (unsigned r = 0; r < planes; r++) {
+				mCandidates.insert(mCandidates.end(), plane_candidates[r].begin(), plane_candidates[r].end());
+				for (unsigned cell = r << (2 * kCellBits); cell < ((r + 1) << (2 * kCellBits)); cell++) {
+					const uint32_t count = mOffsets[cell];
+					mOffsets[cell] = offset;
+					offset += count;
+				}
+			}
+			mOffsets[kCells] = offset;
+		}
+
+		/// Index of the nearest palette colour, the smallest index on ties
+		uint8_t Nearest(int r, int g, int b) const {
+			const unsigned cell = CellIndex(r, g, b);
+			const uint8_t *candidate = mCandidates.data() + mOffsets[cell];
+			const uint8_t *end = mCandidates.data() + mOffsets[cell + 1];
+			uint8_t best = *candidate;
+			if (end - candidate > 1) {
+				int best_distance = INT_MAX;
+				for (; candidate < end; ++candidate) {
+					const FIRGBA8 &entry = mPalette[*candidate];
+					const int dr = entry.red - r, dg = entry.green - g, db = entry.blue - b;
+					const int distance = dr * dr + dg * dg + db * db;
+					if (distance < best_distance) {
+						best_distance = distance;
+						best = *candidate;
+					}
+				}
+			}
+			return best;
+		}
+
+		const FIRGBA8* GetPalette() const {
+			return mPalette;
+		}
+
+		unsigned GetCount() const {
+			return mCount;
+		}
+
+		bool GetDither() const {
+			return mDither;
+		}
+
+	private:
+		FIRGBA8 mPalette[256];
+		unsigned mCount;
+		bool mDither;
+		std::vector<uint32_t> mOffsets;		// first candidate of each cell
+		std::vector<uint8_t> mCandidates;	// ascending palette indices per cell
+	};
+
+	/// Diffused error in 1/16 units to a colour offset, rounded half away from zero
+	inline int RoundError(int error) {
+		return (error >= 0) ? (error + 8) / 16 : -((8 - error) / 16);
+	}
+
+	inline PaletteMapper* ToMapper(FIPALETTEMAPPER *mapper) {
+		return static_cast<PaletteMapper *>(mapper->data);
+	}
+
+	/// Remaps the pixels to their nearest colours by parallel bands of scanlines
+	void MapNearest(FIBITMAP *dst, FIBITMAP *src, const PaletteMapper &mapper) {
+		const unsigned width = FreeImage_GetWidth(src);
+		const unsigned bytespp = FreeImage_GetLine(src) / width;
+		ConvertScanLines(dst, src, [&](uint8_t *dst_line, uint8_t *src_line) {
+			// runs of identical pixels share a lookup
+			int last_r = -1, last_g = -1, last_b = -1;
+			uint8_t last_index = 0;
+			for (unsigned x = 0; x < width; x++, src_line += bytespp) {
+				const int r = src_line[FI_RGBA_RED], g = src_line[FI_RGBA_GREEN], b = src_line[FI_RGBA_BLUE];
+				if ((r != last_r) || (g != last_g) || (b != last_b)) {
+					last_r = r;
+					last_g = g;
+					last_b = b;
+					last_index = mapper.Nearest(r, g, b);
+				}
+				dst_line[x] = last_index;
+			}
+		});
+	}
+
+	/**
+	Floyd-Steinberg error diffusion from the top scanline down, left to right.
+	Errors are kept in 1/16 units, each row depends on the previous one so the rows are remapped sequentially.
+	*/
+	void MapDithered(FIBITMAP *dst, FIBITMAP *src, const PaletteMapper &mapper) {
+		const unsigned width = FreeImage_GetWidth(src);
+		const unsigned height = FreeImage_GetHeight(src);
+		const unsigned bytespp = FreeImage_GetLine(src) / width;
+		const FIRGBA8 *palette = mapper.GetPalette();
+
+		// errors of the current and next rows, with a guard pixel on each side
+		std::vector<int> current(3 * (width + 2), 0), next(3 * (width + 2), 0);
+
+		for (unsigned row = 0; row < height; row++) {
+			const unsigned y = height - 1 - row;
+			const uint8_t *src_line = FreeImage_GetConstBits(src) + (size_t)FreeImage_GetPitch(src) * y;
+			uint8_t *dst_line = FreeImage_GetBits(dst) + (size_t)FreeImage_GetPitch(dst) * y;
+			std::fill(next.begin(), next.end(), 0);
+
+			for (unsigned x = 0; x < width; x++, src_line += bytespp) {
+				int *error = &current[3 * (x + 1)];
+				const int r = std::min(255, std::max(0, src_line[FI_RGBA_RED] + RoundError(error[0])));
+				const int g = std::min(255, std::max(0, src_line[FI_RGBA_GREEN] + RoundError(error[1])));
+				const int b = std::min(255, std::max(0, src_line[FI_RGBA_BLUE] + RoundError(error[2])));
+				const uint8_t index = mapper.Nearest(r, g, b);
+				dst_line[x] = index;
+
+				const int diff[3] = { r - palette[index].red, g - palette[index].green, b - palette[index].blue };
+				int *below = &next[3 * (x + 1)];
+				for (int c = 0; c < 3; c++) {
+					error[3 + c] += 7 * diff[c];
+					below[c - 3] += 3 * diff[c];
+					below[c] += 5 * diff[c];
+					below[c + 3] += diff[c];
+				}
+			}
+			std::swap(current, next);
+		}
+	}
+
+} // namespace
+
+// ----------------------------------------------------------
+
+FIPALETTEMAPPER * DLL_CALLCONV
+FreeImage_CreatePaletteMapper(const FIRGBA8 *palette, int count, FIBOOL dither) {
+	if (!palette || (count < 1) || (count > 256)) {
+		return nullptr;
+	}
+	try {
+		std::unique_ptr<PaletteMapper> mapper(new PaletteMapper(palette, (unsigned)count, dither != FALSE));
+		FIPALETTEMAPPER *handle = new FIPALETTEMAPPER{ mapper.get() };
+		mapper.release();
+		return handle;
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+		return nullptr;
+	}
+}
+
+void DLL_CALLCONV
+FreeImage_DeletePaletteMapper(FIPALETTEMAPPER *mapper) {
+	if (mapper) {
+		delete ToMapper(mapper);
+		delete mapper;
+	}
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_ApplyPaletteMapper(FIBITMAP *dib, FIPALETTEMAPPER *mapper) {
+	if (!mapper || !FreeImage_HasPixels(dib) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
+		return nullptr;
+	}
+	const PaletteMapper &palette_mapper = *ToMapper(mapper);
+
+	// other bit depths go through a 24-bit copy
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> converted(nullptr, &::FreeImage_Unload);
+	FIBITMAP *src = dib;
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	if ((bpp != 24) && (bpp != 32)) {
+		converted.reset(FreeImage_ConvertTo24Bits(dib));
+		if (!converted) {
+			return nullptr;
+		}
+		src = converted.get();
+	}
+
+	FIBITMAP *dst = FreeImage_Allocate(FreeImage_GetWidth(src), FreeImage_GetHeight(src), 8);
+	if (!dst) {
+		return nullptr;
+	}
+	memcpy(FreeImage_GetPalette(dst), palette_mapper.GetPalette(), palette_mapper.GetCount() * sizeof(FIRGBA8));
+
+	try {
+		if (palette_mapper.GetDither()) {
+			MapDithered(dst, src, palette_mapper);
+		} else {
+			MapNearest(dst, src, palette_mapper);
+		}
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_Unload(dst);
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+		return nullptr;
+	}
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, dib);
+
+	return dst;
+}
@@ -35,6 +35,14 @@ FreeImage_GetScanLine(FIBITMAP *dib, int scanline) {
 	return CalculateScanLine(FreeImage_GetBits(dib), FreeImage_GetPitch(dib), scanline);
 }
 
+const uint8_t * DLL_CALLCONV
+FreeImage_GetConstScanLine(FIBITMAP *dib, int scanline) {
+	if (!FreeImage_HasPixels(dib)) {
+		return nullptr;
+	}
+	return CalculateScanLine(FreeImage_GetConstBits(dib), FreeImage_GetPitch(dib), scanline);
+}
+
 FIBOOL DLL_CALLCONV
 FreeImage_GetPixelIndex(FIBITMAP *dib, unsigned x, unsigned y, uint8_t *value) {
 	uint8_t shift;
@@ -33,15 +33,28 @@
 #include <io.h>
 #else
 #include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif // _WIN32
 
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "FreeImageIO.h"
 #include "Plugin.h"
+#include "ThreadPool.h"
+#include "CPUDispatch.h"
+#include "MappedFile.h"
 
 #include "../Metadata/FreeImageTag.h"
 
+#include <algorithm>
+#include <climits>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 
 // =====================================================================
 // Plugin search list
@@ -83,6 +96,38 @@ PluginNodeBase::~PluginNodeBase() {
 #endif
 }
 
+namespace {
+
+	/// Metadata models kept by the FreeImage_LoadEx running on this thread, FIMD_MASK_ALL otherwise
+	thread_local uint32_t tMetadataModels = FIMD_MASK_ALL;
+
+} // namespace
+
+FIBOOL
+FreeImage_LoadsMetadataModel(FREE_IMAGE_MDMODEL model) {
+	return ((model >= FIMD_COMMENTS) && (model < 31) && (tMetadataModels & FIMD_MASK(model))) ? TRUE : FALSE;
+}
+
+FIBITMAP* PluginNodeBase::DropMetadata(FIBITMAP* dib, int flags) {
+	if (!dib) {
+		return dib;
+	}
+	const bool no_metadata = ((flags & FIF_LOAD_NOMETADATA) == FIF_LOAD_NOMETADATA);
+	if (no_metadata || (tMetadataModels != FIMD_MASK_ALL)) {
+		for (int model = FIMD_COMMENTS; model <= FIMD_EXIF_RAW; model++) {
+			// animation metadata is needed to play the frames
+			const bool dropped = no_metadata ? (model != FIMD_ANIMATION) : !FreeImage_LoadsMetadataModel((FREE_IMAGE_MDMODEL)model);
+			if (dropped) {
+				FreeImage_SetMetadata((FREE_IMAGE_MDMODEL)model, dib, nullptr, nullptr);
+			}
+		}
+	}
+	if ((tMetadataModels & FIMD_MASK_ICC) == 0) {
+		FreeImage_DestroyICCProfile(dib);
+	}
+	return dib;
+}
+
 
 class PluginNodeV1
 	: public PluginNodeBase
@@ -209,6 +254,24 @@ private:
 		return false;
 	}
 
+	bool DoSupportsImageInfo() const override {
+		return (mPlugin->get_image_info_proc != nullptr);
+	}
+
+	bool DoGetImageInfo(FreeImageIO* io, fi_handle handle, FIIMAGEINFO* info, void* data) override {
+		if (mPlugin->get_image_info_proc) {
+			return mPlugin->get_image_info_proc(io, handle, info, data);
+		}
+		return false;
+	}
+
+	uint32_t DoGetConcurrency() const override {
+		if (mPlugin->concurrency_proc) {
+			return mPlugin->concurrency_proc();
+		}
+		return FIF_CONCURRENT_NONE;
+	}
+
 
 	/** The actual plugin, holding the function pointers */
 	std::unique_ptr<Plugin> mPlugin = std::make_unique<Plugin>();
@@ -346,75 +409,363 @@ private:
 		return false;
 	}
 
+	bool DoSupportsImageInfo() const override {
+		return (mPlugin->get_image_info_proc != nullptr);
+	}
+
+	bool DoGetImageInfo(FreeImageIO* io, fi_handle handle, FIIMAGEINFO* info, void* data) override {
+		if (mPlugin->get_image_info_proc) {
+			return mPlugin->get_image_info_proc(mContext, io, handle, info, data);
+		}
+		return false;
+	}
+
+	uint32_t DoGetConcurrency() const override {
+		if (mPlugin->concurrency_proc) {
+			return mPlugin->concurrency_proc(mContext);
+		}
+		return FIF_CONCURRENT_NONE;
+	}
+
+	bool DoSupportsFeature(FREE_IMAGE_FEATURE feature) const override {
+		if (mPlugin->supports_feature_proc && !mPlugin->supports_feature_proc(mContext, feature)) {
+			return false;
+		}
+		switch (feature) {
+			case FIFEATURE_IMAGE_INFO:
+				return (mPlugin->get_image_info_proc != nullptr);
+			case FIFEATURE_SCALED_LOAD:
+				return (mPlugin->load_scaled_proc != nullptr);
+			case FIFEATURE_REGION_LOAD:
+				return (mPlugin->load_region_proc != nullptr);
+			case FIFEATURE_SCANLINE_READER:
+				return mPlugin->open_scanline_reader_proc && mPlugin->read_scanlines_proc && mPlugin->close_scanline_reader_proc;
+			default:
+				return false;
+		}
+	}
+
+	FIBITMAP* DoLoadScaled(FreeImageIO* io, fi_handle handle, unsigned max_width, unsigned max_height, int flags) override {
+		void* data = DoOpen(io, handle, true);
+		FIBITMAP* bitmap = mPlugin->load_scaled_proc(mContext, io, handle, max_width, max_height, flags, data);
+		DoClose(io, handle, data);
+		return bitmap;
+	}
+
+	FIBITMAP* DoLoadRegion(FreeImageIO* io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags) override {
+		void* data = DoOpen(io, handle, true);
+		FIBITMAP* bitmap = mPlugin->load_region_proc(mContext, io, handle, left, top, right, bottom, flags, data);
+		DoClose(io, handle, data);
+		return bitmap;
+	}
+
+	std::unique_ptr<ScanlineDecoder> DoOpenScanlineReader(FreeImageIO* io, fi_handle handle, int flags) override {
+		FIBITMAP* info = nullptr;
+		void* reader = mPlugin->open_scanline_reader_proc(mContext, io, handle, flags, &info);
+		if (!reader || !info) {
+			if (reader) {
+				mPlugin->close_scanline_reader_proc(mContext, reader);
+			}
+			FreeImage_Unload(info);
+			return nullptr;
+		}
+		return std::make_unique<PluginScanlineDecoder>(info, mContext, reader, mPlugin->read_scanlines_proc, mPlugin->close_scanline_reader_proc);
+	}
+
+	/**
+	Rows read by the reader of a plugin, closed with the decoder
+	*/
+	class PluginScanlineDecoder : public ScanlineDecoder
+	{
+	public:
+		PluginScanlineDecoder(FIBITMAP* info, void* ctx, void* reader, FI_ReadScanlinesProc2 read_proc, FI_CloseScanlineReaderProc2 close_proc)
+			: ScanlineDecoder(info), mContext(ctx), mReader(reader), mReadProc(read_proc), mCloseProc(close_proc)
+		{ }
+
+		~PluginScanlineDecoder() override {
+			mCloseProc(mContext, mReader);
+		}
+
+		unsigned Read(uint8_t* buffer, unsigned count, unsigned pitch) override {
+			return std::min<unsigned>(mReadProc(mContext, mReader, buffer, count, pitch), count);
+		}
+
+	private:
+		void* mContext;
+		void* mReader;
+		FI_ReadScanlinesProc2 mReadProc;
+		FI_CloseScanlineReaderProc2 mCloseProc;
+	};
+
 private:
 	/** The actual plugin, holding the function pointers */
 	void* mContext = nullptr;
 	std::unique_ptr<Plugin2> mPlugin = std::make_unique<Plugin2>();
 };
 
+namespace {
+
+	/**
+	Size of a width x height image fitted into max_width x max_height, never enlarged
+	*/
+	void FitSize(unsigned width, unsigned height, unsigned max_width, unsigned max_height, unsigned *fit_width, unsigned *fit_height) {
+		const double scale = std::min({ 1.0, (double)max_width / width, (double)max_height / height });
+		*fit_width = std::max(1u, (unsigned)(width * scale + 0.5));
+		*fit_height = std::max(1u, (unsigned)(height * scale + 0.5));
+	}
+
+	/**
+	Load flags asking the plugin to decode at a reduced size at least fit_width x fit_height
+	*/
+	int ScaledLoadFlags(FREE_IMAGE_FORMAT fif, int flags, unsigned width, unsigned height, unsigned fit_width, unsigned fit_height) {
+		const unsigned requested_size = std::max(fit_width, fit_height);
+		switch (fif) {
+			case FIF_JPEG:
+			case FIF_WEBP:
+			case FIF_J2K:
+			case FIF_JP2:
+			case FIF_JXR:
+				// requested size of the longest side in the upper 16 bits
+				if ((requested_size < std::max(width, height)) && (requested_size <= 0x7FFF)) {
+					flags = (flags & 0xFFFF) | (int)(requested_size << 16);
+				}
+				break;
+			case FIF_RAW:
+				if ((width / 2 >= fit_width) && (height / 2 >= fit_height)) {
+					flags |= RAW_HALFSIZE;
+				}
+				// RAW_PREVIEW picks the smallest embedded preview at least that large
+				if (requested_size <= 0x7FFF) {
+					flags = (flags & 0xFFFF) | (int)(requested_size << 16);
+				}
+				break;
+			case FIF_ICO:
+				// smallest icon of the directory at least fit_width x fit_height
+				flags = (flags & 0xFFFF) | ICO_LOAD_BEST_FIT | ICO_SIZE(std::min(requested_size, 0x7FFFu));
+				break;
+			case FIF_DDS:
+			{
+				// smallest mipmap level at least fit_width x fit_height, below the level already requested
+				int level = (flags >> 24) & 0x1F;
+				for (unsigned n = 1; (level < 0x1F) && ((width >> n) >= fit_width) && ((height >> n) >= fit_height); n++) {
+					level++;
+				}
+				flags = (flags & 0xFFFFFF) | DDS_MIPMAP(level);
+				break;
+			}
+			case FIF_EXR:
+			{
+				// smallest mipmap / ripmap level at least fit_width x fit_height, the plugin clamps it to the levels of the file
+				int level = (flags >> 24) & 0x1F;
+				for (unsigned n = 1; (level < 0x1F) && ((width >> n) >= fit_width) && ((height >> n) >= fit_height); n++) {
+					level++;
+				}
+				flags = (flags & 0xFFFFFF) | EXR_LEVEL(level);
+				break;
+			}
+			default:
+				break;
+		}
+		return flags;
+	}
+
+	/**
+	The left, top, right, bottom rectangle of dib, which is unloaded
+	*/
+	FIBITMAP* CropRegion(FIBITMAP* dib, unsigned left, unsigned top, unsigned right, unsigned bottom) {
+		if (!dib) {
+			return nullptr;
+		}
+		FIBITMAP *region = FreeImage_Copy(dib, (int)left, (int)top, (int)right, (int)bottom);
+		FreeImage_Unload(dib);
+		return region;
+	}
+
+} // namespace
+
+/**
+Internal plugins, whose fast paths are implemented by the codecs of their formats
+*/
+class PluginNodeInternal final
+	: public PluginNodeV1
+{
+public:
+	PluginNodeInternal(FI_InitProc func, void* ctx, int id, void* instance, const char* format, const char* description, const char* extension, const char* regexpr)
+		: PluginNodeV1(func, ctx, id, instance, format, description, extension, regexpr), mFif(static_cast<FREE_IMAGE_FORMAT>(id))
+	{ }
+
+private:
+	bool DoSupportsFeature(FREE_IMAGE_FEATURE feature) const override {
+		switch (feature) {
+			case FIFEATURE_SCALED_LOAD:
+				// reduced decodes are asked with load flags, from the size in the header
+				switch (mFif) {
+					case FIF_JPEG:
+					case FIF_WEBP:
+					case FIF_J2K:
+					case FIF_JP2:
+					case FIF_JXR:
+					case FIF_RAW:
+					case FIF_ICO:
+					case FIF_DDS:
+					case FIF_EXR:
+						return SupportsNoPixels();
+					default:
+						return false;
+				}
+			case FIFEATURE_REGION_LOAD:
+				return (mFif == FIF_JPEG) || (mFif == FIF_TIFF) || (mFif == FIF_J2K) || (mFif == FIF_JP2) || (mFif == FIF_JXR) || (mFif == FIF_EXR);
+			case FIFEATURE_SCANLINE_READER:
+				return (mFif == FIF_BMP) || (mFif == FIF_HDR) || (mFif == FIF_JPEG) || (mFif == FIF_PNG) || (mFif == FIF_PBM) || (mFif == FIF_PBMRAW) || (mFif == FIF_PGM) || (mFif == FIF_PGMRAW) || (mFif == FIF_PPM) || (mFif == FIF_PPMRAW);
+			default:
+				return PluginNodeV1::DoSupportsFeature(feature);
+		}
+	}
+
+	FIBITMAP* DoLoadScaled(FreeImageIO* io, fi_handle handle, unsigned max_width, unsigned max_height, int flags) override {
+		// the original size tells how much the plugin can reduce while decoding (the largest icon of icon files)
+		int scaled_flags = flags;
+		const long start = io->tell_proc(handle);
+		const int header_flags = (mFif == FIF_ICO) ? ((flags & 0xFFFF) | ICO_LOAD_BEST_FIT) : flags;
+		if (FIBITMAP *header = Load(io, handle, -1, header_flags | FIF_LOAD_NOPIXELS)) {
+			const unsigned width = FreeImage_GetWidth(header);
+			const unsigned height = FreeImage_GetHeight(header);
+			FreeImage_Unload(header);
+
+			unsigned fit_width, fit_height;
+			FitSize(width, height, max_width, max_height, &fit_width, &fit_height);
+			scaled_flags = ScaledLoadFlags(mFif, flags, width, height, fit_width, fit_height);
+		}
+		io->seek_proc(handle, start, SEEK_SET);
+		return Load(io, handle, -1, scaled_flags);
+	}
+
+	FIBITMAP* DoLoadRegion(FreeImageIO* io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags) override {
+		switch (mFif) {
+#if FREEIMAGE_WITH_LIBJPEG
+			case FIF_JPEG:
+				// rotated images are cropped after the rotation
+				if ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE) {
+					return CropRegion(Load(io, handle, -1, flags), left, top, right, bottom);
+				}
+				return LoadRegionJPEG(io, handle, left, top, right, bottom, flags);
+#endif
+#if FREEIMAGE_WITH_LIBTIFF
+			case FIF_TIFF:
+				return LoadRegionTIFF(io, handle, left, top, right, bottom, flags);
+#endif
+#if FREEIMAGE_WITH_LIBOPENJPEG
+			case FIF_J2K:
+				return LoadRegionJ2K(io, handle, left, top, right, bottom, flags);
+			case FIF_JP2:
+				return LoadRegionJP2(io, handle, left, top, right, bottom, flags);
+#endif
+#if FREEIMAGE_WITH_LIBJXR
+			case FIF_JXR:
+				return LoadRegionJXR(io, handle, left, top, right, bottom, flags);
+#endif
+#if FREEIMAGE_WITH_LIBOPENEXR
+			case FIF_EXR:
+				return LoadRegionEXR(io, handle, left, top, right, bottom, flags);
+#endif
+			default:
+				return CropRegion(Load(io, handle, -1, flags), left, top, right, bottom);
+		}
+	}
+
+	std::unique_ptr<ScanlineDecoder> DoOpenScanlineReader(FreeImageIO* io, fi_handle handle, int flags) override {
+		switch (mFif) {
+			case FIF_BMP:
+				return CreateScanlineDecoderBMP(io, handle, flags);
+			case FIF_HDR:
+				return CreateScanlineDecoderHDR(io, handle, flags);
+#if FREEIMAGE_WITH_LIBJPEG
+			case FIF_JPEG:
+				return CreateScanlineDecoderJPEG(io, handle, flags);
+#endif
+#if FREEIMAGE_WITH_LIBPNG
+			case FIF_PNG:
+				return CreateScanlineDecoderPNG(io, handle, flags);
+#endif
+			case FIF_PBM:
+			case FIF_PBMRAW:
+			case FIF_PGM:
+			case FIF_PGMRAW:
+			case FIF_PPM:
+			case FIF_PPMRAW:
+				return CreateScanlineDecoderPNM(io, handle, flags);
+			default:
+				return nullptr;
+		}
+	}
+
+	FREE_IMAGE_FORMAT mFif;
+};
+
 
 PluginsRegistry::PluginsRegistry()
 {
 	// internal plugins initialization
-	Put(FIF_BMP, InitBMP);
-	Put(FIF_ICO, InitICO);
+	PutInternal(FIF_BMP, InitBMP);
+	PutInternal(FIF_ICO, InitICO);
 #if FREEIMAGE_WITH_LIBJPEG
-	Put(FIF_JPEG, InitJPEG);
+	PutInternal(FIF_JPEG, InitJPEG);
 #endif
-	Put(FIF_JNG, InitJNG);
-	Put(FIF_KOALA, InitKOALA);
-	Put(FIF_IFF, InitIFF);
-	Put(FIF_MNG, InitMNG);
-	Put(FIF_PBM, InitPNM, false, nullptr, "PBM", "Portable Bitmap (ASCII)", "pbm", "^P1");
-	Put(FIF_PBMRAW, InitPNM, false, nullptr, "PBMRAW", "Portable Bitmap (RAW)", "pbm", "^P4");
-	Put(FIF_PCD, InitPCD);
-	Put(FIF_PCX, InitPCX);
-	Put(FIF_PGM, InitPNM, false, nullptr, "PGM", "Portable Greymap (ASCII)", "pgm", "^P2");
-	Put(FIF_PGMRAW, InitPNM, false, nullptr, "PGMRAW", "Portable Greymap (RAW)", "pgm", "^P5");
+	PutInternal(FIF_JNG, InitJNG);
+	PutInternal(FIF_KOALA, InitKOALA);
+	PutInternal(FIF_IFF, InitIFF);
+	PutInternal(FIF_MNG, InitMNG);
+	PutInternal(FIF_PBM, InitPNM, "PBM", "Portable Bitmap (ASCII)", "pbm", "^P1");
+	PutInternal(FIF_PBMRAW, InitPNM, "PBMRAW", "Portable Bitmap (RAW)", "pbm", "^P4");
+	PutInternal(FIF_PCD, InitPCD);
+	PutInternal(FIF_PCX, InitPCX);
+	PutInternal(FIF_PGM, InitPNM, "PGM", "Portable Greymap (ASCII)", "pgm", "^P2");
+	PutInternal(FIF_PGMRAW, InitPNM, "PGMRAW", "Portable Greymap (RAW)", "pgm", "^P5");
 #if FREEIMAGE_WITH_LIBPNG
-	Put(FIF_PNG, InitPNG);
+	PutInternal(FIF_PNG, InitPNG);
 #endif
-	Put(FIF_PPM, InitPNM, false, nullptr, "PPM", "Portable Pixelmap (ASCII)", "ppm", "^P3");
-	Put(FIF_PPMRAW, InitPNM, false, nullptr, "PPMRAW", "Portable Pixelmap (RAW)", "ppm", "^P6");
-	Put(FIF_RAS, InitRAS);
-	Put(FIF_TARGA, InitTARGA);
+	PutInternal(FIF_PPM, InitPNM, "PPM", "Portable Pixelmap (ASCII)", "ppm", "^P3");
+	PutInternal(FIF_PPMRAW, InitPNM, "PPMRAW", "Portable Pixelmap (RAW)", "ppm", "^P6");
+	PutInternal(FIF_RAS, InitRAS);
+	PutInternal(FIF_TARGA, InitTARGA);
 #if FREEIMAGE_WITH_LIBTIFF
-	Put(FIF_TIFF, InitTIFF);
+	PutInternal(FIF_TIFF, InitTIFF);
 #endif
-	Put(FIF_WBMP, InitWBMP);
-	Put(FIF_PSD, InitPSD);
-	Put(FIF_CUT, InitCUT);
-	Put(FIF_XBM, InitXBM);
-	Put(FIF_XPM, InitXPM);
-	Put(FIF_DDS, InitDDS);
-	Put(FIF_GIF, InitGIF);
-	Put(FIF_HDR, InitHDR);
+	PutInternal(FIF_WBMP, InitWBMP);
+	PutInternal(FIF_PSD, InitPSD);
+	PutInternal(FIF_CUT, InitCUT);
+	PutInternal(FIF_XBM, InitXBM);
+	PutInternal(FIF_XPM, InitXPM);
+	PutInternal(FIF_DDS, InitDDS);
+	PutInternal(FIF_GIF, InitGIF);
+	PutInternal(FIF_HDR, InitHDR);
 #if FREEIMAGE_WITH_LIBTIFF
-	Put(FIF_FAXG3, InitG3);
+	PutInternal(FIF_FAXG3, InitG3);
 #endif
-	Put(FIF_SGI, InitSGI);
+	PutInternal(FIF_SGI, InitSGI);
 #if FREEIMAGE_WITH_LIBOPENEXR
-	Put(FIF_EXR, InitEXR);
+	PutInternal(FIF_EXR, InitEXR);
 #endif
 #if FREEIMAGE_WITH_LIBOPENJPEG
-	Put(FIF_J2K, InitJ2K);
-	Put(FIF_JP2, InitJP2);
+	PutInternal(FIF_J2K, InitJ2K);
+	PutInternal(FIF_JP2, InitJP2);
 #endif
-	Put(FIF_PFM, InitPFM);
-	Put(FIF_PICT, InitPICT);
+	PutInternal(FIF_PFM, InitPFM);
+	PutInternal(FIF_PICT, InitPICT);
 #if FREEIMAGE_WITH_LIBRAW
-	Put(FIF_RAW, InitRAW);
+	PutInternal(FIF_RAW, InitRAW);
 #endif
 #if FREEIMAGE_WITH_LIBWEBP
-	Put(FIF_WEBP, InitWEBP);
+	PutInternal(FIF_WEBP, InitWEBP);
 #endif
 #if FREEIMAGE_WITH_LIBJXR
-	Put(FIF_JXR, InitJXR);
+	PutInternal(FIF_JXR, InitJXR);
 #endif
 #if FREEIMAGE_WITH_LIBHEIF
 	Put(FIF_HEIF, CreatePluginHEIF());
 	Put(FIF_AVIF, CreatepluginAVIF());
 #endif
+	PutInternal(FIF_FIRAW, InitFIRAW);
 
 	mNextId = FIF_JXR + 1;
 }
@@ -425,21 +776,34 @@ PluginsRegistry::~PluginsRegistry() = default;
 template <typename PluginType_, typename InitFunc_>
 bool PluginsRegistry::ResetImpl(FREE_IMAGE_FORMAT fif, InitFunc_ init_proc, void* ctx, bool force, void* instance, const char* format, const char* description, const char* extension, const char* regexpr)
 {
+	// readers keep using the published map, changes are made on a copy
+	auto plugins = std::make_shared<PluginsMap>(*Snapshot());
+
 	if (init_proc == nullptr) {
 		// clear plugin node
-		return (mPlugins.erase(fif) > 0);
+		auto it = plugins->find(fif);
+		if (it == plugins->end()) {
+			return false;
+		}
+		mRetired.push_back(std::move(it->second));
+		plugins->erase(it);
+		std::atomic_store(&mPlugins, PluginsSnapshot(std::move(plugins)));
+		return true;
 	}
 
 	// instert or assign new
-	std::unique_ptr<PluginNodeBase>& dst_node = mPlugins[fif];
+	std::shared_ptr<PluginNodeBase>& dst_node = (*plugins)[fif];
 	if (dst_node && !force) {
 		// already in use
 		return false;
 	}
 
-	std::unique_ptr<PluginNodeBase> new_node{ nullptr };
+	std::shared_ptr<PluginNodeBase> new_node{ nullptr };
 	try {
-		new_node = std::make_unique<PluginType_>(init_proc, ctx, fif, instance, format, description, extension, regexpr);
+		new_node = std::make_shared<PluginType_>(init_proc, ctx, fif, instance, format, description, extension, regexpr);
+		if (dst_node) {
+			mRetired.push_back(dst_node);
+		}
 	}
 	catch (...) {
 		// ToDo: report error here
@@ -447,21 +811,31 @@ bool PluginsRegistry::ResetImpl(FREE_IMAGE_FORMAT fif, InitFunc_ init_proc, void
 	}
 
 	dst_node.swap(new_node);
+	std::atomic_store(&mPlugins, PluginsSnapshot(std::move(plugins)));
 	return true;
 }
 
 bool PluginsRegistry::Put(FREE_IMAGE_FORMAT fif, FI_InitProc init_proc, bool force, void* instance, const char* format, const char* description, const char* extension, const char* regexpr)
 {
+	std::lock_guard<std::mutex> lock(mWriteMutex);
 	return ResetImpl<PluginNodeV1>(fif, init_proc, /* ctx = */ nullptr, force, instance, format, description, extension, regexpr);
 }
 
+bool PluginsRegistry::PutInternal(FREE_IMAGE_FORMAT fif, FI_InitProc init_proc, const char* format, const char* description, const char* extension, const char* regexpr)
+{
+	std::lock_guard<std::mutex> lock(mWriteMutex);
+	return ResetImpl<PluginNodeInternal>(fif, init_proc, /* ctx = */ nullptr, /* force = */ false, /* instance = */ nullptr, format, description, extension, regexpr);
+}
+
 bool PluginsRegistry::Put(FREE_IMAGE_FORMAT fif, FI_InitProc2 init_proc, void* ctx, bool force, void* instance)
 {
+	std::lock_guard<std::mutex> lock(mWriteMutex);
 	return ResetImpl<PluginNodeV2>(fif, init_proc, ctx, force, instance);
 }
 
 bool PluginsRegistry::Put(FREE_IMAGE_FORMAT fif, std::unique_ptr<fi::Plugin2> plugin)
 {
+	std::lock_guard<std::mutex> lock(mWriteMutex);
 	if (!plugin) {
 		return ResetImpl<PluginNodeV2>(fif, nullptr, nullptr, false, nullptr);
 	}
@@ -475,6 +849,7 @@ bool PluginsRegistry::Put(FREE_IMAGE_FORMAT fif, std::unique_ptr<fi::Plugin2> pl
 
 FREE_IMAGE_FORMAT PluginsRegistry::Append(FI_InitProc init_proc, void* instance, const char* format, const char* description, const char* extension, const char* regexpr)
 {
+	std::lock_guard<std::mutex> lock(mWriteMutex);
 	if (mNextId >= FIF_MAX_USER_ID) {
 		return FIF_UNKNOWN;
 	}
@@ -488,6 +863,7 @@ FREE_IMAGE_FORMAT PluginsRegistry::Append(FI_InitProc init_proc, void* instance,
 
 FREE_IMAGE_FORMAT PluginsRegistry::Append(FI_InitProc2 init_proc, void* ctx, void* instance)
 {
+	std::lock_guard<std::mutex> lock(mWriteMutex);
 	if (mNextId >= FIF_MAX_USER_ID) {
 		return FIF_UNKNOWN;
 	}
@@ -506,7 +882,8 @@ std::tuple<FREE_IMAGE_FORMAT, PluginNodeBase*> PluginsRegistry::FindFromFormat(c
 		return std::make_tuple(FIF_UNKNOWN, nullptr);
 	}
 
-	for (auto& [fif, node] : mPlugins) {
+	const auto plugins = Snapshot();
+	for (auto& [fif, node] : *plugins) {
 		if (!node || !node->IsEnabled()) {
 			continue;
 		}
@@ -530,7 +907,8 @@ std::tuple<FREE_IMAGE_FORMAT, PluginNodeBase*> PluginsRegistry::FindFromMime(con
 		return std::make_tuple(FIF_UNKNOWN, nullptr);
 	}
 
-	for (auto& [fif, node] : mPlugins) {
+	const auto plugins = Snapshot();
+	for (auto& [fif, node] : *plugins) {
 		if (!node || !node->IsEnabled()) {
 			continue;
 		}
@@ -550,8 +928,9 @@ std::tuple<FREE_IMAGE_FORMAT, PluginNodeBase*> PluginsRegistry::FindFromMime(con
 
 PluginNodeBase* PluginsRegistry::FindFromFIF(FREE_IMAGE_FORMAT fif) const
 {
-	auto it = mPlugins.find(fif);
-	if (it != mPlugins.cend()) {
+	const auto plugins = Snapshot();
+	auto it = plugins->find(fif);
+	if (it != plugins->cend()) {
 		auto& node = (*it).second;
 		if (node && node->IsEnabled()) {
 			return node.get();
@@ -586,6 +965,7 @@ PluginsRegistrySingleton& PluginsRegistrySingleton::Instance()
 
 bool PluginsRegistrySingleton::AddRef()
 {
+	std::lock_guard<std::mutex> lock(mRefMutex);
 	bool firstRef = false;
 	if (mRefCounter++ == 0) {
 		mInstance.reset(new PluginsRegistry());
@@ -596,6 +976,7 @@ bool PluginsRegistrySingleton::AddRef()
 
 bool PluginsRegistrySingleton::DecRef()
 {
+	std::lock_guard<std::mutex> lock(mRefMutex);
 	bool lastRef = false;
 	if (--mRefCounter == 0) {
 		mInstance.reset();
@@ -610,11 +991,17 @@ bool PluginsRegistrySingleton::DecRef()
 
 void DLL_CALLCONV
 FreeImage_Initialise(FIBOOL load_local_plugins_only) {
-	// initialise the TagLib singleton
-	const TagLib& s = TagLib::instance();
+	// plugins only register their descriptors here, libraries (OpenEXR, libtiff, libheif)
+	// and the TagLib singleton are set up when first used
 
 	auto& plugins = PluginsRegistrySingleton::Instance();
 	if (plugins.AddRef()) {
+		// allow parallel processing
+		ThreadPool::Instance().Start();
+
+		// detect SIMD instruction sets
+		CPUDispatch::Instance();
+
 		// external plugin initialization
 #ifdef _WIN32
 		if (!load_local_plugins_only) {
@@ -678,7 +1065,9 @@ FreeImage_Initialise(FIBOOL load_local_plugins_only) {
 
 void DLL_CALLCONV
 FreeImage_DeInitialise() {
-	PluginsRegistrySingleton::Instance().DecRef();
+	if (PluginsRegistrySingleton::Instance().DecRef()) {
+		ThreadPool::Instance().Stop();
+	}
 }
 
 
@@ -686,26 +1075,219 @@ FreeImage_DeInitialise() {
 // Plugin System Load/Save Functions
 // =====================================================================
 
+namespace {
+
+	/**
+	Calls load(io, handle), through buffered reads of the user IO functions when FreeImage_SetLoadBuffering asks so
+	*/
+	template <typename Load_>
+	FIBITMAP* LoadBuffered(FreeImageIO *io, fi_handle handle, Load_ load) {
+		if (const unsigned buffer_size = GetLoadBuffering(io)) {
+			FreeImageIO buffered_io;
+			if (FIBUFFEREDIO *buffered = FreeImage_CreateBufferedIO(io, handle, buffer_size, &buffered_io)) {
+				FIBITMAP *bitmap = load(&buffered_io, (fi_handle)buffered);
+				FreeImage_CloseBufferedIO(buffered);
+				return bitmap;
+			}
+		}
+		return load(io, handle);
+	}
+
+} // namespace
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_LoadFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags) {
 	FIBITMAP *bitmap{};
 	if (auto& plugins = PluginsRegistrySingleton::Instance()) {
 		if (auto* node = plugins->FindFromFIF(fif)) {
-			bitmap = node->Load(io, handle, -1, flags);
+			bitmap = LoadBuffered(io, handle, [&](FreeImageIO *load_io, fi_handle load_handle) {
+				return node->Load(load_io, load_handle, -1, flags);
+			});
 		}
 	}	
 	return bitmap;
 }
 
+void
+FreeImage_FillImageInfo(FIBITMAP *dib, FIIMAGEINFO *info) {
+	info->width = FreeImage_GetWidth(dib);
+	info->height = FreeImage_GetHeight(dib);
+	info->bpp = FreeImage_GetBPP(dib);
+	info->image_type = FreeImage_GetImageType(dib);
+	info->color_type = FreeImage_GetColorType2(dib, FALSE);
+	info->has_alpha = (info->color_type == FIC_RGBALPHA) || FreeImage_IsTransparent(dib);
+	info->has_icc_profile = (FreeImage_GetICCProfile(dib)->size != 0);
+
+	FITAG *tag{};
+	if (FreeImage_GetMetadata(FIMD_EXIF_MAIN, dib, "Orientation", &tag) && (FreeImage_GetTagType(tag) == FIDT_SHORT)) {
+		const unsigned orientation = *static_cast<const uint16_t*>(FreeImage_GetTagValue(tag));
+		info->orientation = ((orientation >= 1) && (orientation <= 8)) ? orientation : 0;
+	}
+}
+
+/**
+Fills an image info from a header only bitmap, for plugins without image info callback
+*/
+static bool
+GetImageInfoFromHeader(PluginNodeBase *node, FreeImageIO *io, fi_handle handle, FIIMAGEINFO *info) {
+	if (!node->SupportsNoPixels()) {
+		return false;
+	}
+	void *data = node->Open(io, handle, true);
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(node->Load(io, handle, -1, FIF_LOAD_NOPIXELS, data), &FreeImage_Unload);
+	if (dib) {
+		FreeImage_FillImageInfo(dib.get(), info);
+
+		const int page_count = node->GetPageCount(io, handle, data);
+		info->page_count = (page_count > 0) ? (uint32_t)page_count : 1;
+	}
+	node->Close(io, handle, data);
+
+	return (dib != nullptr);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_GetImageInfo(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, FIIMAGEINFO *info) {
+	if (!io || !info) {
+		return FALSE;
+	}
+	*info = {};
+	info->page_count = 1;
+
+	bool result = false;
+	if (auto& plugins = PluginsRegistrySingleton::Instance()) {
+		if (auto* node = plugins->FindFromFIF(fif)) {
+			const long start = io->tell_proc(handle);
+			result = node->GetImageInfo(io, handle, info);
+			if (!result) {
+				// no callback, or a probe the plugin can't handle
+				*info = {};
+				info->page_count = 1;
+				io->seek_proc(handle, start, SEEK_SET);
+				result = GetImageInfoFromHeader(node, io, handle, info);
+			}
+			io->seek_proc(handle, start, SEEK_SET);
+		}
+	}
+	return result ? TRUE : FALSE;
+}
+
+namespace {
+
+	/**
+	Cost model of a codec: CPU cost per pixel byte of the bitmap, working memory per pixel
+	*/
+	struct CodecCost {
+		double cpu_factor;
+		double buffer_bytes_per_pixel;
+	};
+
+	CodecCost GetCodecCost(FREE_IMAGE_FORMAT fif) {
+		switch (fif) {
+			case FIF_FIRAW:
+				// rows read as they are
+				return { 0.5, 0.0 };
+			case FIF_BMP: case FIF_ICO: case FIF_PBMRAW: case FIF_PGMRAW: case FIF_PPMRAW:
+			case FIF_RAS: case FIF_WBMP: case FIF_PFM: case FIF_KOALA:
+				return { 1.0, 0.0 };
+			case FIF_TARGA: case FIF_PCX: case FIF_LBM: case FIF_CUT: case FIF_SGI: case FIF_PSD: case FIF_PCD: case FIF_DDS:
+				return { 2.0, 0.0 };
+			case FIF_GIF: case FIF_HDR: case FIF_PICT: case FIF_FAXG3:
+				return { 3.0, 0.0 };
+			case FIF_TIFF:
+				// RGBA raster of the photometric conversions
+				return { 3.0, 4.0 };
+			case FIF_PBM: case FIF_PGM: case FIF_PPM: case FIF_XBM: case FIF_XPM:
+				// text parsing
+				return { 4.0, 0.0 };
+			case FIF_JPEG: case FIF_PNG:
+				return { 4.0, 0.0 };
+			case FIF_JNG: case FIF_MNG:
+				return { 5.0, 0.0 };
+			case FIF_EXR:
+				// half or float frame buffer
+				return { 6.0, 8.0 };
+			case FIF_WEBP: case FIF_JXR:
+				return { 6.0, 4.0 };
+			case FIF_HEIF:
+				return { 10.0, 3.0 };
+			case FIF_AVIF:
+				return { 15.0, 3.0 };
+			case FIF_RAW:
+				// demosaicing of 4 x 16-bit samples per pixel
+				return { 20.0, 8.0 };
+			case FIF_J2K: case FIF_JP2:
+				// 32-bit planes per component
+				return { 25.0, 16.0 };
+			default:
+				return { 4.0, 0.0 };
+		}
+	}
+
+} // namespace
+
+FIBOOL DLL_CALLCONV
+FreeImage_EstimateDecodeCost(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags, FIDECODECOST *cost) {
+	if (!cost) {
+		return FALSE;
+	}
+	*cost = {};
+	if (!FreeImage_GetImageInfo(fif, io, handle, &cost->info)) {
+		return FALSE;
+	}
+	const FIIMAGEINFO &info = cost->info;
+
+	if ((flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS) {
+		// the header is parsed, no pixel is decoded
+		cost->cpu_cost = 1;
+		return TRUE;
+	}
+
+	uint64_t width = info.width;
+	uint64_t height = info.height;
+	CodecCost codec = GetCodecCost(fif);
+
+	if (fif == FIF_RAW) {
+		if ((flags & RAW_PREVIEW) == RAW_PREVIEW) {
+			// the embedded preview is usually a reduced JPEG
+			codec = GetCodecCost(FIF_JPEG);
+			width = (width + 3) / 4;
+			height = (height + 3) / 4;
+		} else if ((flags & RAW_HALFSIZE) == RAW_HALFSIZE) {
+			width = (width + 1) / 2;
+			height = (height + 1) / 2;
+		}
+	}
+	if (info.interlaced) {
+		if (fif == FIF_JPEG) {
+			// progressive scans keep the whole image of 16-bit DCT coefficients and decode it in several passes
+			codec.cpu_factor *= 2.0;
+			codec.buffer_bytes_per_pixel += 2.0 * ((info.bpp + 7) / 8);
+		} else {
+			// Adam7 passes
+			codec.cpu_factor *= 1.5;
+		}
+	}
+	if (info.tile_width && info.tile_height) {
+		// tiles are decoded one at a time into the bitmap, without a full image raster
+		codec.buffer_bytes_per_pixel = 0.0;
+	}
+
+	cost->pixels = width * height;
+	cost->bitmap_bytes = ((width * info.bpp + 31) / 32) * 4 * height;
+	cost->memory_bytes = cost->bitmap_bytes + (uint64_t)(codec.buffer_bytes_per_pixel * (double)cost->pixels);
+	cost->cpu_cost = (uint64_t)(codec.cpu_factor * (double)cost->bitmap_bytes);
+	return TRUE;
+}
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_Load(FREE_IMAGE_FORMAT fif, const char *filename, int flags) {
 	FreeImageIO io;
 	SetDefaultIO(&io);
 
 	FIBITMAP *bitmap{};
-	if (auto *handle = fopen(filename, "rb")) {
-		bitmap = FreeImage_LoadFromHandle(fif, &io, (fi_handle)handle, flags);
-		fclose(handle);
+	if (LoadFile file{ fif, fopen(filename, "rb") }) {
+		bitmap = FreeImage_LoadFromHandle(fif, &io, (fi_handle)file.Get(), flags);
 	} else {
 		FreeImage_OutputMessageProc((int)fif, "FreeImage_Load: failed to open file %s", filename);
 	}
@@ -720,9 +1302,8 @@ FreeImage_LoadU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags) {
 
 	FIBITMAP *bitmap{};
 #ifdef _WIN32	
-	if (auto *handle = _wfopen(filename, L"rb")) {
-		bitmap = FreeImage_LoadFromHandle(fif, &io, (fi_handle)handle, flags);
-		fclose(handle);
+	if (LoadFile file{ fif, _wfopen(filename, L"rb") }) {
+		bitmap = FreeImage_LoadFromHandle(fif, &io, (fi_handle)file.Get(), flags);
 	} else {
 		FreeImage_OutputMessageProc((int)fif, "FreeImage_LoadU: failed to open input file");
 	}
@@ -730,6 +1311,274 @@ FreeImage_LoadU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags) {
 	return bitmap;
 }
 
+namespace {
+
+	FIBITMAP* LoadFromMapping(FREE_IMAGE_FORMAT fif, const std::shared_ptr<const MappedFile>& file, int flags) {
+		if ((fif == FIF_FIRAW) && FreeImage_IsPluginEnabled(fif) == TRUE) {
+			// pixels are used in place, the bitmap keeps the mapping
+			return LoadMappedFIRAW(file->data(), file->size(), file, flags);
+		}
+		if ((fif == FIF_PFM) && (flags & PFM_INPLACE) && FreeImage_IsPluginEnabled(fif) == TRUE) {
+			if (FIBITMAP *bitmap = LoadMappedPFM(file->data(), file->size(), file, flags)) {
+				return bitmap;
+			}
+		}
+		FIBITMAP *bitmap{};
+		// wrap the mapping, it is never written since a user buffer is read only
+		if (FIMEMORY *stream = FreeImage_OpenMemory(file->data(), file->size())) {
+			bitmap = FreeImage_LoadFromMemory(fif, stream, flags);
+			FreeImage_CloseMemory(stream);
+		}
+		return bitmap;
+	}
+
+} // namespace
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadMapped(FREE_IMAGE_FORMAT fif, const char *filename, int flags) {
+	if (!filename) {
+		return nullptr;
+	}
+	try {
+		const auto file = std::make_shared<const MappedFile>(filename);
+		if (file->data()) {
+			return LoadFromMapping(fif, file, flags);
+		}
+	}
+	catch (...) {
+		return nullptr;
+	}
+	// empty, huge or special files
+	return FreeImage_Load(fif, filename, flags);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadMappedU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags) {
+	if (!filename) {
+		return nullptr;
+	}
+#ifdef _WIN32
+	try {
+		const auto file = std::make_shared<const MappedFile>(filename);
+		if (file->data()) {
+			return LoadFromMapping(fif, file, flags);
+		}
+	}
+	catch (...) {
+		return nullptr;
+	}
+#endif
+	return FreeImage_LoadU(fif, filename, flags);
+}
+
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadScaledFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, unsigned max_width, unsigned max_height, int flags) {
+	auto& plugins = PluginsRegistrySingleton::Instance();
+	PluginNodeBase *node = plugins ? plugins->FindFromFIF(fif) : nullptr;
+	if (!node || !handle || !max_width || !max_height) {
+		return nullptr;
+	}
+	flags &= ~FIF_LOAD_NOPIXELS;
+
+	// plugins without reduced decodes load the whole image
+	const bool scaled = node->SupportsFeature(FIFEATURE_SCALED_LOAD);
+	FIBITMAP *dib = LoadBuffered(io, handle, [&](FreeImageIO *load_io, fi_handle load_handle) {
+		return scaled ? node->LoadScaled(load_io, load_handle, max_width, max_height, flags) : node->Load(load_io, load_handle, -1, flags);
+	});
+	if (!dib) {
+		return nullptr;
+	}
+
+	// refine the reduced decode to the exact size
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	unsigned fit_width, fit_height;
+	FitSize(width, height, max_width, max_height, &fit_width, &fit_height);
+	if ((fit_width != width) || (fit_height != height)) {
+		if (FIBITMAP *scaled = FreeImage_Rescale(dib, (int)fit_width, (int)fit_height, FILTER_BILINEAR)) {
+			FreeImage_Unload(dib);
+			dib = scaled;
+		}
+	}
+	return dib;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadRegion(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int left, int top, int right, int bottom, int flags) {
+	if (!io || !handle || (left < 0) || (top < 0) || (left >= right) || (top >= bottom)) {
+		return nullptr;
+	}
+	flags &= ~FIF_LOAD_NOPIXELS;
+
+	auto& plugins = PluginsRegistrySingleton::Instance();
+	PluginNodeBase *node = plugins ? plugins->FindFromFIF(fif) : nullptr;
+	if (!node) {
+		return nullptr;
+	}
+	if (node->SupportsFeature(FIFEATURE_REGION_LOAD)) {
+		return node->LoadRegion(io, handle, (unsigned)left, (unsigned)top, (unsigned)right, (unsigned)bottom, flags);
+	}
+	return CropRegion(FreeImage_LoadFromHandle(fif, io, handle, flags), (unsigned)left, (unsigned)top, (unsigned)right, (unsigned)bottom);
+}
+
+namespace {
+
+	/// Row callback of the FreeImage_LoadWithRowCallback running on this thread
+	struct RowCallback
+	{
+		FI_RowsDecodedProc proc;
+		void *user_data;
+		FIBITMAP *dib;		// first bitmap reported by the plugin, nullptr until then
+		unsigned next_row;	// rows before it were reported
+	};
+
+	thread_local RowCallback *tRowCallback = nullptr;
+
+	/// Pass callback of the FreeImage_LoadProgressive running on this thread
+	struct PassCallback
+	{
+		FI_PassDecodedProc proc;
+		void *user_data;
+		FIBITMAP *dib;		// first bitmap reported by the plugin, nullptr until then
+	};
+
+	thread_local PassCallback *tPassCallback = nullptr;
+
+} // namespace
+
+bool
+ReportsPasses() {
+	return tPassCallback != nullptr;
+}
+
+void
+NotifyPassDecoded(FIBITMAP *dib, unsigned pass, unsigned pass_count) {
+	PassCallback *callback = tPassCallback;
+	if (!callback || !dib) {
+		return;
+	}
+	// nested loads (thumbnails, embedded images) report other bitmaps
+	if (!callback->dib) {
+		callback->dib = dib;
+	} else if (callback->dib != dib) {
+		return;
+	}
+	callback->proc(dib, pass, pass_count, callback->user_data);
+}
+
+void
+NotifyRowsDecoded(FIBITMAP *dib, unsigned first, unsigned count) {
+	RowCallback *callback = tRowCallback;
+	if (!callback || !dib || !count) {
+		return;
+	}
+	// nested loads (thumbnails, embedded images) report other bitmaps
+	if (!callback->dib) {
+		callback->dib = dib;
+	} else if (callback->dib != dib) {
+		return;
+	}
+	if (first != callback->next_row) {
+		return;
+	}
+	callback->next_row = first + count;
+	callback->proc(dib, first, count, callback->user_data);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadExFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, const FILOADOPTIONS *options) {
+	if (!options) {
+		return FreeImage_LoadFromHandle(fif, io, handle, 0);
+	}
+
+	const uint32_t previous = std::exchange(tMetadataModels, options->metadata_models);
+	FIBITMAP *dib = FreeImage_LoadFromHandle(fif, io, handle, options->flags);
+	tMetadataModels = previous;
+	return dib;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadEx(FREE_IMAGE_FORMAT fif, const char *filename, const FILOADOPTIONS *options) {
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	FIBITMAP *bitmap{};
+	if (LoadFile file{ fif, fopen(filename, "rb") }) {
+		bitmap = FreeImage_LoadExFromHandle(fif, &io, (fi_handle)file.Get(), options);
+	} else {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_LoadEx: failed to open file %s", filename);
+	}
+
+	return bitmap;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadWithRowCallback(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags, FI_RowsDecodedProc callback, void *user_data) {
+	if (!callback) {
+		return FreeImage_LoadFromHandle(fif, io, handle, flags);
+	}
+
+	RowCallback state{ callback, user_data, nullptr, 0 };
+	RowCallback *previous = std::exchange(tRowCallback, &state);
+	FIBITMAP *dib = FreeImage_LoadFromHandle(fif, io, handle, flags);
+	tRowCallback = previous;
+
+	// the rows the plugin didn't report, or all of them
+	if (dib && FreeImage_HasPixels(dib)) {
+		const unsigned height = FreeImage_GetHeight(dib);
+		const unsigned next_row = (state.dib == dib) ? state.next_row : 0;
+		if (next_row < height) {
+			callback(dib, next_row, height - next_row, user_data);
+		}
+	}
+	return dib;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadProgressive(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags, FI_PassDecodedProc callback, void *user_data) {
+	if (!callback || ((flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS)) {
+		return FreeImage_LoadFromHandle(fif, io, handle, flags);
+	}
+
+	PassCallback state{ callback, user_data, nullptr };
+	PassCallback *previous = std::exchange(tPassCallback, &state);
+	FIBITMAP *dib = FreeImage_LoadFromHandle(fif, io, handle, flags);
+	tPassCallback = previous;
+	return dib;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadScaled(FREE_IMAGE_FORMAT fif, const char *filename, unsigned max_width, unsigned max_height, int flags) {
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	FIBITMAP *bitmap{};
+	if (LoadFile file{ fif, fopen(filename, "rb") }) {
+		bitmap = FreeImage_LoadScaledFromHandle(fif, &io, (fi_handle)file.Get(), max_width, max_height, flags);
+	} else {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_LoadScaled: failed to open file %s", filename);
+	}
+
+	return bitmap;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadScaledU([[maybe_unused]] FREE_IMAGE_FORMAT fif, [[maybe_unused]] const wchar_t *filename, [[maybe_unused]] unsigned max_width, [[maybe_unused]] unsigned max_height, [[maybe_unused]] int flags) {
+	FIBITMAP *bitmap{};
+#ifdef _WIN32	
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	if (LoadFile file{ fif, _wfopen(filename, L"rb") }) {
+		bitmap = FreeImage_LoadScaledFromHandle(fif, &io, (fi_handle)file.Get(), max_width, max_height, flags);
+	} else {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_LoadScaledU: failed to open input file");
+	}
+#endif
+	return bitmap;
+}
+
 FIBOOL DLL_CALLCONV
 FreeImage_SaveToHandle(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FreeImageIO *io, fi_handle handle, int flags) {
 	// cannot save "header only" formats
@@ -748,6 +1597,133 @@ FreeImage_SaveToHandle(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FreeImageIO *io, fi
 	return result;
 }
 
+namespace {
+
+	/// FreeImageIO64 handle seen through the long offsets of FreeImageIO
+	struct HandleIO64
+	{
+		FreeImageIO64 *io;
+		fi_handle handle;
+	};
+
+	unsigned DLL_CALLCONV
+	_HandleReadProc64(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+		auto *h = (HandleIO64*)handle;
+		return h->io->read_proc(buffer, size, count, h->handle);
+	}
+
+	unsigned DLL_CALLCONV
+	_HandleWriteProc64(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+		auto *h = (HandleIO64*)handle;
+		return h->io->write_proc(buffer, size, count, h->handle);
+	}
+
+	int DLL_CALLCONV
+	_HandleSeekProc64(fi_handle handle, long offset, int origin) {
+		auto *h = (HandleIO64*)handle;
+		return h->io->seek_proc(h->handle, offset, origin);
+	}
+
+	long DLL_CALLCONV
+	_HandleTellProc64(fi_handle handle) {
+		auto *h = (HandleIO64*)handle;
+		const int64_t position = h->io->tell_proc(h->handle);
+		return (position <= LONG_MAX) ? (long)position : -1L;
+	}
+
+	void SetHandleIO64(FreeImageIO *io) {
+		io->read_proc  = _HandleReadProc64;
+		io->seek_proc  = _HandleSeekProc64;
+		io->tell_proc  = _HandleTellProc64;
+		io->write_proc = _HandleWriteProc64;
+	}
+
+} // namespace
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadFromHandle64(FREE_IMAGE_FORMAT fif, FreeImageIO64 *io64, fi_handle handle, int flags) {
+	if (!io64) {
+		return nullptr;
+	}
+	FreeImageIO io;
+	SetHandleIO64(&io);
+	HandleIO64 h{ io64, handle };
+	return FreeImage_LoadFromHandle(fif, &io, (fi_handle)&h, flags);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_SaveToHandle64(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FreeImageIO64 *io64, fi_handle handle, int flags) {
+	if (!io64) {
+		return FALSE;
+	}
+	FreeImageIO io;
+	SetHandleIO64(&io);
+	HandleIO64 h{ io64, handle };
+	return FreeImage_SaveToHandle(fif, dib, &io, (fi_handle)&h, flags);
+}
+
+
+FIBOOL DLL_CALLCONV
+FreeImage_SaveJPEGPlanes(FreeImageIO *io, fi_handle handle, unsigned width, unsigned height, const uint8_t *const *planes, const unsigned *pitches, int flags) {
+	if (!io || !handle || !width || !height || !planes || !pitches) {
+		return FALSE;
+	}
+#if FREEIMAGE_WITH_LIBJPEG
+	auto& plugins = PluginsRegistrySingleton::Instance();
+	if (plugins && plugins->FindFromFIF(FIF_JPEG)) {
+		return SaveJPEGPlanes(io, handle, width, height, planes, pitches, flags);
+	}
+#endif
+	return FALSE;
+}
+
+FIJPEGTABLES* DLL_CALLCONV
+FreeImage_CreateJPEGTables(FIBITMAP *sample, int flags) {
+	if (!FreeImage_HasPixels(sample)) {
+		return nullptr;
+	}
+#if FREEIMAGE_WITH_LIBJPEG
+	auto& plugins = PluginsRegistrySingleton::Instance();
+	if (plugins && plugins->FindFromFIF(FIF_JPEG)) {
+		JPEGTables *data = CreateJPEGTables(sample, flags);
+		if (!data) {
+			return nullptr;
+		}
+		auto *tables = new(std::nothrow) FIJPEGTABLES;
+		if (tables) {
+			tables->data = data;
+			return tables;
+		}
+		DeleteJPEGTables(data);
+		FreeImage_OutputMessageProcEx(FIF_JPEG, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+#endif
+	return nullptr;
+}
+
+void DLL_CALLCONV
+FreeImage_DeleteJPEGTables(FIJPEGTABLES *tables) {
+	if (tables) {
+#if FREEIMAGE_WITH_LIBJPEG
+		DeleteJPEGTables(static_cast<JPEGTables*>(tables->data));
+#endif
+		delete tables;
+	}
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_SaveJPEGWithTables(FIBITMAP *dib, FreeImageIO *io, fi_handle handle, const FIJPEGTABLES *tables, int flags) {
+	if (!FreeImage_HasPixels(dib) || !io || !handle || !tables) {
+		return FALSE;
+	}
+#if FREEIMAGE_WITH_LIBJPEG
+	auto& plugins = PluginsRegistrySingleton::Instance();
+	if (plugins && plugins->FindFromFIF(FIF_JPEG)) {
+		return SaveJPEGWithTables(io, handle, dib, static_cast<const JPEGTables*>(tables->data), flags);
+	}
+#endif
+	return FALSE;
+}
 
 FIBOOL DLL_CALLCONV
 FreeImage_Save(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const char *filename, int flags) {
@@ -999,6 +1975,24 @@ FreeImage_FIFSupportsNoPixels(FREE_IMAGE_FORMAT fif) {
 	return FALSE;
 }
 
+FIBOOL DLL_CALLCONV
+FreeImage_FIFSupportsFeature(FREE_IMAGE_FORMAT fif, FREE_IMAGE_FEATURE feature) {
+	if (auto& plugins = PluginsRegistrySingleton::Instance()) {
+		auto node = plugins->FindFromFIF(fif);
+		return (node && node->SupportsFeature(feature)) ? TRUE : FALSE;
+	}
+	return FALSE;
+}
+
+unsigned DLL_CALLCONV
+FreeImage_GetFIFConcurrency(FREE_IMAGE_FORMAT fif) {
+	if (auto& plugins = PluginsRegistrySingleton::Instance()) {
+		auto node = plugins->FindFromFIF(fif);
+		return node ? node->GetConcurrency() : FIF_CONCURRENT_NONE;
+	}
+	return FIF_CONCURRENT_NONE;
+}
+
 FREE_IMAGE_FORMAT DLL_CALLCONV
 FreeImage_GetFIFFromFilename(const char *filename) {
 	if (!filename) {
@@ -1011,22 +2005,29 @@ FreeImage_GetFIFFromFilename(const char *filename) {
 		const char* extension = (place ? ++place : filename);
 
 		// look for the extension in the plugin table
-		for (const auto& [fif, node] : plugins->NodesCRange()) {
+		const auto nodes = plugins->Snapshot();
+		for (const auto& [fif, node] : *nodes) {
 			if (node && node->IsEnabled()) {
 				// compare the format id with the extension
 				if (FreeImage_stricmp(node->GetFormat(), extension) == 0) {
 					return fif;
 				}
-				// make a copy of the extension list and split it
+				// split the extension list (strtok is not reentrant)
 				if (const char* extension_list = node->GetExtension()) {
-					auto copy = std::string(extension_list);
-					// get the first token
-					char* token = strtok(copy.data(), ",");
-					while (token) {
-						if (FreeImage_stricmp(token, extension) == 0) {
-							return fif;
+					std::string token;
+					for (const char* c = extension_list; ; ++c) {
+						if (*c == ',' || *c == '\0') {
+							if (!token.empty() && FreeImage_stricmp(token.c_str(), extension) == 0) {
+								return fif;
+							}
+							token.clear();
+							if (*c == '\0') {
+								break;
+							}
+						}
+						else {
+							token.push_back(*c);
 						}
-						token = strtok(nullptr, ",");
 					}
 				}
 			}
@@ -27,11 +27,49 @@
 #ifndef PLUGIN_H
 #define PLUGIN_H
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 #include "yato/range.h"
 #include "FreeImage.hpp"
 #include "Utilities.h"
+#include "Trace.h"
+
+
+// =====================================================================
+//  Scanline decoders
+// =====================================================================
+
+/**
+Incremental decoder of the rows of an image, used by FreeImage_OpenScanlineReader.
+Rows are decoded from the top of the image, in the scanline layout of FreeImage bitmaps.
+*/
+class ScanlineDecoder
+{
+public:
+	explicit ScanlineDecoder(FIBITMAP* info)
+		: mInfo(info, &FreeImage_Unload)
+	{ }
+
+	virtual ~ScanlineDecoder() = default;
+
+	/**
+	Bitmap describing the decoded rows (size, type, palette, metadata), its pixels may not be loaded
+	*/
+	FIBITMAP* GetInfo() const {
+		return mInfo.get();
+	}
+
+	/**
+	Decodes up to count rows, pitch bytes apart, returns the number of decoded rows
+	*/
+	virtual unsigned Read(uint8_t* buffer, unsigned count, unsigned pitch) = 0;
+
+private:
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> mInfo;
+};
 
 
 // =====================================================================
@@ -61,8 +99,7 @@ public:
 
 	bool SetEnabled(bool value = true)
 	{
-		std::swap(mEnabled, value);
-		return value;
+		return mEnabled.exchange(value);
 	}
 
 	void* Open(FreeImageIO* io, fi_handle handle, bool open_for_reading) {
@@ -81,27 +118,81 @@ public:
 	}
 
 	FIBITMAP* Load(FreeImageIO* io, fi_handle handle, int page, int flags) {
+		TraceScope trace(TraceCategory::eLoad, GetFormat());
+		const long start = io->tell_proc(handle);
 		void* data = DoOpen(io, handle, true);
 		auto bitmap = DoLoad(io, handle, page, flags, data);
 		DoClose(io, handle, data);
-		return bitmap;
+		trace.SetBytes(Advance(io, handle, start));
+		return DropMetadata(bitmap, flags);
 	}
 
 	// load from already opened io
 	FIBITMAP* Load(FreeImageIO* io, fi_handle handle, int page, int flags, void* data) {
-		return DoLoad(io, handle, page, flags, data);
+		TraceScope trace(TraceCategory::eLoad, GetFormat());
+		const long start = io->tell_proc(handle);
+		auto bitmap = DoLoad(io, handle, page, flags, data);
+		trace.SetBytes(Advance(io, handle, start));
+		return DropMetadata(bitmap, flags);
 	}
 
+	// removes the metadata models of a bitmap loaded with FIF_LOAD_NOMETADATA, for plugins which don't skip them while decoding
+	static FIBITMAP* DropMetadata(FIBITMAP* dib, int flags);
+
 	bool Save(FIBITMAP* dib, FreeImageIO* io, fi_handle handle, int page, int flags) {
+		TraceScope trace(TraceCategory::eSave, GetFormat());
+		const long start = io->tell_proc(handle);
 		void* data = DoOpen(io, handle, false);
 		const bool result = DoSave(dib, io, handle, page, flags, data);
 		DoClose(io, handle, data);
+		trace.SetBytes(Advance(io, handle, start));
 		return result;
 	}
 
 	// Save to already opened io
 	bool Save(FIBITMAP* dib, FreeImageIO* io, fi_handle handle, int page, int flags, void* data) {
-		return DoSave(dib, io, handle, page, flags, data);
+		TraceScope trace(TraceCategory::eSave, GetFormat());
+		const long start = io->tell_proc(handle);
+		const bool result = DoSave(dib, io, handle, page, flags, data);
+		trace.SetBytes(Advance(io, handle, start));
+		return result;
+	}
+
+	// page count from already opened io
+	int GetPageCount(FreeImageIO* io, fi_handle handle, void* data) {
+		return DoGetPageCount(io, handle, data);
+	}
+
+	// returns false if the plugin has no image info callback or can't probe the image
+	bool GetImageInfo(FreeImageIO* io, fi_handle handle, FIIMAGEINFO* info) {
+		if (!DoSupportsImageInfo()) {
+			return false;
+		}
+		void* data = DoOpen(io, handle, true);
+		const bool result = DoGetImageInfo(io, handle, info, data);
+		DoClose(io, handle, data);
+		return result;
+	}
+
+	/**
+	Decodes at a reduced size, at least max_width x max_height when the image is larger, see FIFEATURE_SCALED_LOAD
+	*/
+	FIBITMAP* LoadScaled(FreeImageIO* io, fi_handle handle, unsigned max_width, unsigned max_height, int flags) {
+		return DropMetadata(DoLoadScaled(io, handle, max_width, max_height, flags), flags);
+	}
+
+	/**
+	Decodes the left, top, right, bottom rectangle (right and bottom excluded), see FIFEATURE_REGION_LOAD
+	*/
+	FIBITMAP* LoadRegion(FreeImageIO* io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags) {
+		return DropMetadata(DoLoadRegion(io, handle, left, top, right, bottom, flags), flags);
+	}
+
+	/**
+	Returns an incremental decoder of the rows, or nullptr when the image must be fully loaded, see FIFEATURE_SCANLINE_READER
+	*/
+	std::unique_ptr<ScanlineDecoder> OpenScanlineReader(FreeImageIO* io, fi_handle handle, int flags) {
+		return DoOpenScanlineReader(io, handle, flags);
 	}
 
 	int GetPageCount(FreeImageIO* io, fi_handle handle) {
@@ -168,7 +259,21 @@ public:
 		return DoSupportsNoPixels();
 	}
 
+	uint32_t GetConcurrency() const {
+		return DoGetConcurrency();
+	}
+
+	bool SupportsFeature(FREE_IMAGE_FEATURE feature) const {
+		return DoSupportsFeature(feature);
+	}
+
 private:
+	// bytes read or written since start, as far as the position of the handle tells (0 if it moved backwards)
+	static uint64_t Advance(FreeImageIO* io, fi_handle handle, long start) {
+		const long end = io->tell_proc(handle);
+		return (start >= 0 && end > start) ? static_cast<uint64_t>(end - start) : 0;
+	}
+
 	virtual void* DoOpen(FreeImageIO* io, fi_handle handle, bool open_for_reading) = 0;
 
 	virtual void DoClose(FreeImageIO* io, fi_handle handle, void* data) = 0;
@@ -203,11 +308,36 @@ private:
 
 	virtual bool DoSupportsNoPixels() const = 0;
 
+	virtual bool DoSupportsImageInfo() const = 0;
+
+	virtual bool DoGetImageInfo(FreeImageIO* io, fi_handle handle, FIIMAGEINFO* info, void* data) = 0;
+
+	virtual uint32_t DoGetConcurrency() const = 0;
+
+protected:
+	// Optional fast paths, only called when DoSupportsFeature reports them. They open and close the handle themselves.
+
+	virtual bool DoSupportsFeature(FREE_IMAGE_FEATURE feature) const {
+		return (feature == FIFEATURE_IMAGE_INFO) && DoSupportsImageInfo();
+	}
+
+	virtual FIBITMAP* DoLoadScaled(FreeImageIO* /*io*/, fi_handle /*handle*/, unsigned /*max_width*/, unsigned /*max_height*/, int /*flags*/) {
+		return nullptr;
+	}
+
+	virtual FIBITMAP* DoLoadRegion(FreeImageIO* /*io*/, fi_handle /*handle*/, unsigned /*left*/, unsigned /*top*/, unsigned /*right*/, unsigned /*bottom*/, int /*flags*/) {
+		return nullptr;
+	}
+
+	virtual std::unique_ptr<ScanlineDecoder> DoOpenScanlineReader(FreeImageIO* /*io*/, fi_handle /*handle*/, int /*flags*/) {
+		return nullptr;
+	}
+
 private:
 	/** Handle to a user plugin DLL (NULL for standard plugins) */
 	void* mInstance{ nullptr };
-	/** Enable/Disable switch */
-	bool mEnabled{ true };
+	/** Enable/Disable switch, may be flipped while other threads are loading */
+	std::atomic<bool> mEnabled{ true };
 
 	/** Unique format string for the plugin */
 	const char* mFormat{ nullptr };
@@ -225,11 +355,18 @@ private:
 // =====================================================================
 
 
+/**
+ * Readers never lock: every lookup works on an immutable snapshot of the plugin map,
+ * loaded atomically. Writers (Put / Append) serialize on a mutex, copy the current map,
+ * modify the copy and publish it. Nodes removed or replaced by a writer are retired
+ * instead of destroyed, so that a node pointer returned by a lookup stays valid until
+ * the registry itself is released by FreeImage_DeInitialise.
+ */
 class PluginsRegistry
 {
 public:
-	using PluginsMap = std::map<FREE_IMAGE_FORMAT, std::unique_ptr<PluginNodeBase>>;
-	using PluginNodeIterator = typename PluginsMap::iterator;
+	using PluginsMap = std::map<FREE_IMAGE_FORMAT, std::shared_ptr<PluginNodeBase>>;
+	using PluginsSnapshot = std::shared_ptr<const PluginsMap>;
 	using PluginNodeConstIterator = typename PluginsMap::const_iterator;
 
 
@@ -257,38 +394,47 @@ public:
 
 	PluginNodeBase* FindFromFIF(FREE_IMAGE_FORMAT fif) const;
 
-	PluginNodeConstIterator NodesCBegin() const {
-		return mPlugins.cbegin();
-	}
-
-	PluginNodeConstIterator NodesCEnd() const {
-		return mPlugins.cend();
-	}
-
-	yato::range<PluginNodeConstIterator> NodesCRange() const {
-		return yato::make_range(NodesCBegin(), NodesCEnd());
+	/**
+	 * Current set of plugins. Hold on to the returned snapshot while iterating it.
+	 */
+	PluginsSnapshot Snapshot() const {
+		return std::atomic_load(&mPlugins);
 	}
 
 	size_t GetNextFif() const {
-		return mPlugins.size();
+		return Snapshot()->size();
 	}
 
 	size_t GetFifCount2() const {
-		return mPlugins.size();
+		return Snapshot()->size();
 	}
 
 	FREE_IMAGE_FORMAT GetFifFromIndex(size_t index) const {
 		// ToDo: consider refactoring to a O(1) complexity
-		return std::next(mPlugins.cbegin(), index)->first;
+		const auto plugins = Snapshot();
+		if (index >= plugins->size()) {
+			return FIF_UNKNOWN;
+		}
+		return std::next(plugins->cbegin(), index)->first;
 	}
 
 private:
+	/**
+	 * Registers a plugin built in the library, its fast paths are dispatched by format
+	 */
+	bool PutInternal(FREE_IMAGE_FORMAT fif, FI_InitProc init_proc, const char* format = nullptr, const char* description = nullptr, const char* extension = nullptr, const char* regexpr = nullptr);
+
+	/**
+	 * Requires mWriteMutex to be held
+	 */
 	template <typename PluginType_, typename InitFunc_>
 	bool ResetImpl(FREE_IMAGE_FORMAT fif, InitFunc_ init_proc, void* ctx, bool force, void* instance,
 		const char* format = nullptr, const char* description = nullptr, const char* extension = nullptr, const char* regexpr = nullptr);
 
 
-	PluginsMap mPlugins{ };
+	PluginsSnapshot mPlugins{ std::make_shared<const PluginsMap>() };
+	std::vector<std::shared_ptr<PluginNodeBase>> mRetired{ };
+	std::mutex mWriteMutex{ };
 	int32_t mNextId = 0;
 };
 
@@ -334,11 +480,94 @@ private:
 	PluginsRegistrySingleton();
 
 	std::unique_ptr<PluginsRegistry> mInstance{ nullptr };
+	std::mutex mRefMutex{ };
 	uint32_t mRefCounter{ 0 };
 };
 
 
 
+/**
+Native scanline decoders of the internal plugins, return nullptr when the stream can't be decoded incrementally
+*/
+std::unique_ptr<ScanlineDecoder> CreateScanlineDecoderBMP(FreeImageIO *io, fi_handle handle, int flags);
+std::unique_ptr<ScanlineDecoder> CreateScanlineDecoderHDR(FreeImageIO *io, fi_handle handle, int flags);
+std::unique_ptr<ScanlineDecoder> CreateScanlineDecoderJPEG(FreeImageIO *io, fi_handle handle, int flags);
+std::unique_ptr<ScanlineDecoder> CreateScanlineDecoderPNG(FreeImageIO *io, fi_handle handle, int flags);
+std::unique_ptr<ScanlineDecoder> CreateScanlineDecoderPNM(FreeImageIO *io, fi_handle handle, int flags);
+
+/**
+Reports rows decoded into dib to the callback of the FreeImage_LoadWithRowCallback running on this thread, if any.
+first is counted from the top of the image, rows must be reported in order. Other bitmaps are ignored.
+*/
+void NotifyRowsDecoded(FIBITMAP *dib, unsigned first, unsigned count);
+
+/**
+Returns true when a FreeImage_LoadProgressive runs on this thread: plugins decode progressive and interlaced
+images pass by pass only then.
+*/
+bool ReportsPasses();
+
+/**
+Reports a coarse pass decoded into dib to the callback of the FreeImage_LoadProgressive running on this thread, if any.
+The whole bitmap must hold the approximation of the pass. Other bitmaps than the first reported are ignored.
+*/
+void NotifyPassDecoded(FIBITMAP *dib, unsigned pass, unsigned pass_count);
+
+/**
+Decodes the left, top, right, bottom rectangle of a JPEG image (right and bottom excluded), see FreeImage_LoadRegion
+*/
+FIBITMAP* LoadRegionJPEG(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags);
+
+/**
+Decodes the left, top, right, bottom rectangle of a TIFF image (right and bottom excluded), see FreeImage_LoadRegion
+*/
+FIBITMAP* LoadRegionTIFF(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags);
+
+/**
+Decodes the left, top, right, bottom rectangle of a HEIF or AVIF image (right and bottom excluded), see FreeImage_LoadRegion
+*/
+FIBITMAP* LoadRegionHEIF(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags);
+
+/**
+Decodes the left, top, right, bottom rectangle of a JPEG-2000 codestream or file (right and bottom excluded), see FreeImage_LoadRegion
+*/
+FIBITMAP* LoadRegionJ2K(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags);
+FIBITMAP* LoadRegionJP2(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags);
+
+/**
+Decodes the left, top, right, bottom rectangle of a JPEG XR image (right and bottom excluded), see FreeImage_LoadRegion
+*/
+FIBITMAP* LoadRegionJXR(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags);
+
+/**
+Decodes the left, top, right, bottom rectangle of an OpenEXR image or of its EXR_LEVEL (right and bottom excluded), see FreeImage_LoadRegion
+*/
+FIBITMAP* LoadRegionEXR(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags);
+
+/**
+Compresses YCbCr planes with jpeg_write_raw_data, see FreeImage_SaveJPEGPlanes
+*/
+FIBOOL SaveJPEGPlanes(FreeImageIO *io, fi_handle handle, unsigned width, unsigned height, const uint8_t *const *planes, const unsigned *pitches, int flags);
+
+/**
+Huffman tables shared by JPEG saves, see FreeImage_CreateJPEGTables
+*/
+struct JPEGTables;
+JPEGTables* CreateJPEGTables(FIBITMAP *sample, int flags);
+void DeleteJPEGTables(JPEGTables *tables);
+FIBOOL SaveJPEGWithTables(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, const JPEGTables *tables, int flags);
+
+/**
+Returns a bitmap wrapping the pixels of a FIRAW file mapped in memory, kept alive by owner, see FreeImage_LoadMapped
+*/
+FIBITMAP* LoadMappedFIRAW(const uint8_t *data, size_t size, std::shared_ptr<const void> owner, int flags);
+
+/**
+Returns a bitmap wrapping the pixels of a PFM file mapped in memory, kept alive by owner, see PFM_INPLACE.
+Returns NULL without error when the pixels can't be used in place (swapped, misaligned or truncated), the file is then decoded.
+*/
+FIBITMAP* LoadMappedPFM(const uint8_t *data, size_t size, std::shared_ptr<const void> owner, int flags);
+
 // ==========================================================
 //   Plugin Initialisation Callback
 // ==========================================================
@@ -394,6 +623,7 @@ void DLL_CALLCONV InitRAW(Plugin *plugin, int format_id);
 void DLL_CALLCONV InitJNG(Plugin *plugin, int format_id);
 void DLL_CALLCONV InitWEBP(Plugin *plugin, int format_id);
 void DLL_CALLCONV InitJXR(Plugin *plugin, int format_id);
+void DLL_CALLCONV InitFIRAW(Plugin *plugin, int format_id);
 std::unique_ptr<fi::Plugin2> CreatePluginHEIF();
 std::unique_ptr<fi::Plugin2> CreatepluginAVIF();
 
@@ -0,0 +1,114 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "Plugin.h"
+
+#include <algorithm>
+#include <memory>
+#include <new>
+
+
+namespace {
+
+	/**
+	Rows of a fully loaded bitmap, for the plugins which don't decode incrementally
+	*/
+	class BitmapScanlineDecoder : public ScanlineDecoder
+	{
+	public:
+		explicit BitmapScanlineDecoder(FIBITMAP* dib)
+			: ScanlineDecoder(dib)
+		{ }
+
+		unsigned Read(uint8_t* buffer, unsigned count, unsigned pitch) override {
+			FIBITMAP* dib = GetInfo();
+			const unsigned height = FreeImage_GetHeight(dib);
+			const unsigned line = FreeImage_GetLine(dib);
+
+			const unsigned n = std::min(count, height - mRow);
+			for (unsigned i = 0; i < n; ++i) {
+				memcpy(buffer + (size_t)i * pitch, FreeImage_GetScanLine(dib, height - 1 - mRow - i), line);
+			}
+			mRow += n;
+			return n;
+		}
+
+	private:
+		unsigned mRow{ 0 };
+	};
+
+	ScanlineDecoder* ToDecoder(FISCANLINEREADER* reader) {
+		return reader ? static_cast<ScanlineDecoder*>(reader->data) : nullptr;
+	}
+
+} // namespace
+
+
+FISCANLINEREADER * DLL_CALLCONV
+FreeImage_OpenScanlineReader(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags) {
+	if (!io || !handle) {
+		return nullptr;
+	}
+	flags &= ~FIF_LOAD_NOPIXELS;
+
+	try {
+		const long start = io->tell_proc(handle);
+
+		std::unique_ptr<ScanlineDecoder> decoder;
+		auto& plugins = PluginsRegistrySingleton::Instance();
+		if (PluginNodeBase* node = plugins ? plugins->FindFromFIF(fif) : nullptr) {
+			if (node->SupportsFeature(FIFEATURE_SCANLINE_READER)) {
+				decoder = node->OpenScanlineReader(io, handle, flags);
+			}
+		}
+		if (!decoder) {
+			// restart from the beginning with a full load
+			io->seek_proc(handle, start, SEEK_SET);
+			FIBITMAP* dib = FreeImage_LoadFromHandle(fif, io, handle, flags);
+			if (!dib) {
+				return nullptr;
+			}
+			decoder.reset(new(std::nothrow) BitmapScanlineDecoder(dib));
+			if (!decoder) {
+				FreeImage_Unload(dib);
+				throw std::bad_alloc();
+			}
+		}
+
+		auto* reader = new FISCANLINEREADER;
+		reader->data = decoder.release();
+		return reader;
+	}
+	catch (const std::bad_alloc&) {
+		FreeImage_OutputMessageProcEx(fif, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return nullptr;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_GetScanlineReaderInfo(FISCANLINEREADER *reader) {
+	ScanlineDecoder* decoder = ToDecoder(reader);
+	return decoder ? decoder->GetInfo() : nullptr;
+}
+
+unsigned DLL_CALLCONV
+FreeImage_ReadScanlines(FISCANLINEREADER *reader, uint8_t *bits, unsigned count, unsigned pitch) {
+	ScanlineDecoder* decoder = ToDecoder(reader);
+	if (!decoder || !bits || (pitch < FreeImage_GetLine(decoder->GetInfo()))) {
+		return 0;
+	}
+	return decoder->Read(bits, count, pitch);
+}
+
+void DLL_CALLCONV
+FreeImage_CloseScanlineReader(FISCANLINEREADER *reader) {
+	if (reader) {
+		delete ToDecoder(reader);
+		delete reader;
+	}
+}
@@ -5,15 +5,87 @@
 //===========================================================
 
 #include "SimpleTools.h"
+#include "Utilities.h"
+#include "CPUDispatch.h"
+#include "ConversionSIMD.h"
 #include <cstring>
 #include <algorithm>
+#include <mutex>
 
+namespace
+{
+
+	/**
+	Reduces a one channel image to its min and max values, bands of rows are reduced in parallel
+	by the SSE2 / NEON kernels. NaNs are skipped, returns false if there is no other value.
+	*/
+	template <typename ValueType_>
+	bool ReduceMinMax(FIBITMAP* src, ValueType_& out_min, ValueType_& out_max)
+	{
+		using limits = std::numeric_limits<ValueType_>;
+		const ValueType_ initMin = limits::has_infinity ? limits::infinity() : limits::max();
+		const ValueType_ initMax = limits::has_infinity ? -limits::infinity() : limits::lowest();
+
+		const unsigned width = FreeImage_GetWidth(src);
+		const unsigned height = FreeImage_GetHeight(src);
+		const unsigned pitch = FreeImage_GetPitch(src);
+		const uint8_t* bits = FreeImage_GetConstBits(src);
+
+		ValueType_ minVal = initMin, maxVal = initMax;
+		std::mutex mutex;
+		ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(src)), [&](unsigned first, unsigned last) {
+			ValueType_ bandMin = initMin, bandMax = initMax;
+			for (unsigned y = first; y < last; ++y) {
+				UpdateMinMax(reinterpret_cast<const ValueType_*>(bits + static_cast<size_t>(pitch) * y), width, bandMin, bandMax);
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			minVal = std::min(minVal, bandMin);
+			maxVal = std::max(maxVal, bandMax);
+		});
+
+		out_min = minVal;
+		out_max = maxVal;
+		return !(maxVal < minVal);
+	}
+
+	template <typename ValueType_>
+	void FindMinMaxBrightness(FIBITMAP* src, double* min_brightness, double* max_brightness)
+	{
+		ValueType_ minVal{}, maxVal{};
+		const bool found = ReduceMinMax(src, minVal, maxVal);
+		if (min_brightness) {
+			*min_brightness = found ? static_cast<double>(minVal) : 0.0;
+		}
+		if (max_brightness) {
+			*max_brightness = found ? static_cast<double>(maxVal) : 0.0;
+		}
+	}
+
+} // namespace
 
 FIBOOL FreeImage_FindMinMax(FIBITMAP* dib, double* min_brightness, double* max_brightness, void** min_ptr, void** max_ptr)
 {
 	if (!FreeImage_HasPixels(dib)) {
 		return FALSE;
 	}
+
+	if (!min_ptr && !max_ptr) {
+		// without pixels to locate, one channel images are reduced by the SIMD kernels
+		switch (FreeImage_GetImageType(dib)) {
+		case FIT_FLOAT:
+			FindMinMaxBrightness<float>(dib, min_brightness, max_brightness);
+			return TRUE;
+		case FIT_UINT16:
+			FindMinMaxBrightness<uint16_t>(dib, min_brightness, max_brightness);
+			return TRUE;
+		case FIT_INT16:
+			FindMinMaxBrightness<int16_t>(dib, min_brightness, max_brightness);
+			return TRUE;
+		default:
+			break;
+		}
+	}
+
 	std::tuple<void*, void*, double, double> res{};
 	bool success = false;
 
@@ -108,7 +180,7 @@ FIBOOL FreeImage_FindMinMax(FIBITMAP* dib, double* min_brightness, double* max_b
 		success = true;
 		break;
 	case FIT_INT16:
-		res = FindMinMax<int32_t>(dib);
+		res = FindMinMax<int16_t>(dib);
 		success = true;
 		break;
 	default:
@@ -136,6 +208,19 @@ FIBOOL FreeImage_FindMinMax(FIBITMAP* dib, double* min_brightness, double* max_b
 namespace
 {
 
+	template <typename PixelType_>
+	inline void AccumulateMinMax(PixelType_& minVal, PixelType_& maxVal, const PixelType_& lo, const PixelType_& hi)
+	{
+		SetChannel<0>(minVal, std::min(GetChannel<0>(minVal), GetChannel<0>(lo)));
+		SetChannel<1>(minVal, std::min(GetChannel<1>(minVal), GetChannel<1>(lo)));
+		SetChannel<2>(minVal, std::min(GetChannel<2>(minVal), GetChannel<2>(lo)));
+		SetChannel<3>(minVal, std::min(GetChannel<3>(minVal), GetChannel<3>(lo)));
+		SetChannel<0>(maxVal, std::max(GetChannel<0>(maxVal), GetChannel<0>(hi)));
+		SetChannel<1>(maxVal, std::max(GetChannel<1>(maxVal), GetChannel<1>(hi)));
+		SetChannel<2>(maxVal, std::max(GetChannel<2>(maxVal), GetChannel<2>(hi)));
+		SetChannel<3>(maxVal, std::max(GetChannel<3>(maxVal), GetChannel<3>(hi)));
+	}
+
 	template <typename PixelType_>
 	void FindMinMaxValueImpl(FIBITMAP* src, void* out_min_value, void* out_max_value)
 	{
@@ -143,25 +228,34 @@ namespace
 		PixelFill(minVal, std::numeric_limits<ToValueType<PixelType_>>::max());
 		PixelFill(maxVal, std::numeric_limits<ToValueType<PixelType_>>::lowest());
 
-		const unsigned width = FreeImage_GetWidth(src);
-		const unsigned height = FreeImage_GetHeight(src);
-		const unsigned src_pitch = FreeImage_GetPitch(src);
-
-		uint8_t* src_bits = FreeImage_GetBits(src);
-		for (unsigned y = 0; y < height; ++y) {
-			auto src_pixel = static_cast<PixelType_*>(static_cast<void*>(src_bits));
-			for (unsigned x = 0; x < width; ++x) {
-				const PixelType_ val = src_pixel[x];
-				SetChannel<0>(minVal, std::min(GetChannel<0>(minVal), GetChannel<0>(val)));
-				SetChannel<1>(minVal, std::min(GetChannel<1>(minVal), GetChannel<1>(val)));
-				SetChannel<2>(minVal, std::min(GetChannel<2>(minVal), GetChannel<2>(val)));
-				SetChannel<3>(minVal, std::min(GetChannel<3>(minVal), GetChannel<3>(val)));
-				SetChannel<0>(maxVal, std::max(GetChannel<0>(maxVal), GetChannel<0>(val)));
-				SetChannel<1>(maxVal, std::max(GetChannel<1>(maxVal), GetChannel<1>(val)));
-				SetChannel<2>(maxVal, std::max(GetChannel<2>(maxVal), GetChannel<2>(val)));
-				SetChannel<3>(maxVal, std::max(GetChannel<3>(maxVal), GetChannel<3>(val)));
+		if constexpr (std::is_same_v<PixelType_, uint16_t> || std::is_same_v<PixelType_, int16_t> || std::is_same_v<PixelType_, float>) {
+			PixelType_ lo, hi;
+			if (ReduceMinMax(src, lo, hi)) {
+				minVal = lo;
+				maxVal = hi;
 			}
-			src_bits += src_pitch;
+		}
+		else {
+			const unsigned width = FreeImage_GetWidth(src);
+			const unsigned height = FreeImage_GetHeight(src);
+			const unsigned src_pitch = FreeImage_GetPitch(src);
+			const uint8_t* src_bits = FreeImage_GetConstBits(src);
+
+			// every band reduces its rows to partial extrema, merged once the band is done
+			std::mutex mutex;
+			ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(src)), [&](unsigned first, unsigned last) {
+				PixelType_ bandMin, bandMax;
+				PixelFill(bandMin, std::numeric_limits<ToValueType<PixelType_>>::max());
+				PixelFill(bandMax, std::numeric_limits<ToValueType<PixelType_>>::lowest());
+				for (unsigned y = first; y < last; ++y) {
+					auto src_pixel = static_cast<const PixelType_*>(static_cast<const void*>(src_bits + static_cast<size_t>(src_pitch) * y));
+					for (unsigned x = 0; x < width; ++x) {
+						AccumulateMinMax(bandMin, bandMax, src_pixel[x], src_pixel[x]);
+					}
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				AccumulateMinMax(minVal, maxVal, bandMin, bandMax);
+			});
 		}
 
 		if (out_min_value) {
@@ -247,7 +341,7 @@ FIBOOL FreeImage_FindMinMaxValue(FIBITMAP* dib, void* min_value, void* max_value
 		FindMinMaxValueImpl<uint16_t>(dib, min_value, max_value);
 		break;
 	case FIT_INT16:
-		FindMinMaxValueImpl<uint16_t>(dib, min_value, max_value);
+		FindMinMaxValueImpl<int16_t>(dib, min_value, max_value);
 		break;
 	case FIT_COMPLEX:
 		FindMinMaxValueImpl<FICOMPLEX>(dib, min_value, max_value);
@@ -263,6 +357,76 @@ FIBOOL FreeImage_FindMinMaxValue(FIBITMAP* dib, void* min_value, void* max_value
 }
 
 
+namespace {
+
+	/// Copies bytes of a row, non-temporal kernels need a store fence once their rows are done
+	using StreamRowKernel = void (*)(uint8_t* dst, const uint8_t* src, size_t bytes);
+
+	void CopyRow(uint8_t* dst, const uint8_t* src, size_t bytes) {
+		std::memcpy(dst, src, bytes);
+	}
+
+#if FREEIMAGE_SIMD_X86
+	void StreamRow_SSE2(uint8_t* dst, const uint8_t* src, size_t bytes) {
+		// non-temporal stores need 16 bytes aligned addresses
+		size_t x = std::min<size_t>(bytes, (16 - ((uintptr_t)dst & 15)) & 15);
+		std::memcpy(dst, src, x);
+		for (; x + 64 <= bytes; x += 64) {
+			const __m128i a = _mm_loadu_si128((const __m128i*)(src + x));
+			const __m128i b = _mm_loadu_si128((const __m128i*)(src + x + 16));
+			const __m128i c = _mm_loadu_si128((const __m128i*)(src + x + 32));
+			const __m128i d = _mm_loadu_si128((const __m128i*)(src + x + 48));
+			_mm_stream_si128((__m128i*)(dst + x), a);
+			_mm_stream_si128((__m128i*)(dst + x + 16), b);
+			_mm_stream_si128((__m128i*)(dst + x + 32), c);
+			_mm_stream_si128((__m128i*)(dst + x + 48), d);
+		}
+		for (; x + 16 <= bytes; x += 16) {
+			_mm_stream_si128((__m128i*)(dst + x), _mm_loadu_si128((const __m128i*)(src + x)));
+		}
+		std::memcpy(dst + x, src + x, bytes - x);
+	}
+#endif
+
+	std::atomic<StreamRowKernel> gStreamRow{ CopyRow };
+
+	void SelectFillKernels(unsigned features) {
+		StreamRowKernel stream = CopyRow;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			stream = StreamRow_SSE2;
+		}
+#endif
+		gStreamRow.store(stream, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectFillKernels);
+
+	/// Fills of more bytes bypass the caches, they would only evict data still in use
+	constexpr size_t kStreamingFillBytes = 4 * 1024 * 1024;
+
+} // namespace
+
+void FillScanLines(uint8_t* bits, unsigned pitch, unsigned height, const uint8_t* row, unsigned line_bytes)
+{
+	const bool streaming = (size_t)line_bytes * height >= kStreamingFillBytes;
+	const StreamRowKernel copy = streaming ? gStreamRow.load(std::memory_order_relaxed) : CopyRow;
+	ParallelFor(0, height, CalculateBandRows(line_bytes), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; ++y) {
+			uint8_t* dst = bits + (size_t)pitch * y;
+			if (dst != row) {
+				copy(dst, row, line_bytes);
+			}
+		}
+#if FREEIMAGE_SIMD_X86
+		if (copy != CopyRow) {
+			// make the non-temporal stores visible before the band is reported done
+			_mm_sfence();
+		}
+#endif
+	});
+}
+
 FIBOOL FreeImage_Fill(FIBITMAP* dib, const void* value_ptr, size_t value_size)
 {
 	if (!FreeImage_HasPixels(dib)) {
@@ -272,17 +436,15 @@ FIBOOL FreeImage_Fill(FIBITMAP* dib, const void* value_ptr, size_t value_size)
 		return FALSE;
 	}
 
-	const unsigned width  = FreeImage_GetWidth(dib);
 	const unsigned height = FreeImage_GetHeight(dib);
 	const unsigned pitch  = FreeImage_GetPitch(dib);
+	const unsigned line   = FreeImage_GetLine(dib);
 
-	uint8_t* dst_line = FreeImage_GetBits(dib);
-	for (unsigned y = 0; y < height; ++y, dst_line += pitch) {
-		uint8_t* dst_pixel = dst_line;
-		for (unsigned x = 0; x < width; ++x, dst_pixel += value_size) {
-			std::memcpy(dst_pixel, value_ptr, value_size);
-		}
-	}
+	// build the first scanline, then copy it to the others
+	uint8_t* first_line = FreeImage_GetBits(dib);
+	std::memcpy(first_line, value_ptr, value_size);
+	RepeatPattern(first_line, value_size, line);
+	FillScanLines(first_line, pitch, height, first_line, line);
 
 	return TRUE;
 }
@@ -8,51 +8,126 @@
 #define FREEIMAGE_SIMPLE_TOOLS_H_
 
 #include "ConversionYUV.h"
+#include "Utilities.h"
 #include <cmath>
 #include <tuple>
 #include <memory>
+#include <mutex>
 
 
 using UniqueBitmap = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
 
 
-template <typename DstPixel_, typename SrcPixel_ = DstPixel_, typename PixelVisitor_>
-void BitmapForEach(FIBITMAP* src, PixelVisitor_ vis)
+/**
+Execution policies of BitmapForEach and BitmapTransform, after std::execution.
+seq visits the rows in order on the calling thread. par processes bands of rows on the library
+thread pool (see ParallelFor), the operation is then called concurrently and must not modify shared
+state. par_unseq also lets the compiler vectorise the loop over a row, assuming the pixels of a row
+are independent and the source and destination don't overlap.
+*/
+namespace exec
+{
+    struct SequencedPolicy {};
+    struct ParallelPolicy {};
+    struct ParallelUnsequencedPolicy {};
+
+    inline constexpr SequencedPolicy seq{};
+    inline constexpr ParallelPolicy par{};
+    inline constexpr ParallelUnsequencedPolicy par_unseq{};
+}
+
+#if defined(__clang__)
+#define FI_VECTORIZE_LOOP _Pragma("clang loop vectorize(enable)")
+#elif defined(__GNUC__)
+#define FI_VECTORIZE_LOOP _Pragma("GCC ivdep")
+#elif defined(_MSC_VER)
+#define FI_VECTORIZE_LOOP __pragma(loop(ivdep))
+#else
+#define FI_VECTORIZE_LOOP
+#endif
+
+namespace details
+{
+    template <typename Policy_, typename RowBody_>
+    void ForEachRow(const Policy_&, unsigned height, size_t line_bytes, RowBody_&& body)
+    {
+        if constexpr (std::is_same_v<Policy_, exec::SequencedPolicy>) {
+            for (unsigned y = 0; y < height; ++y) {
+                body(y);
+            }
+        }
+        else {
+            ParallelFor(0, height, CalculateBandRows(line_bytes), [&](unsigned first, unsigned last) {
+                for (unsigned y = first; y < last; ++y) {
+                    body(y);
+                }
+            });
+        }
+    }
+}
+
+template <typename DstPixel_, typename SrcPixel_ = DstPixel_, typename Policy_, typename PixelVisitor_>
+void BitmapForEach(const Policy_& policy, FIBITMAP* src, PixelVisitor_ vis)
 {
     const unsigned width = FreeImage_GetWidth(src);
     const unsigned height = FreeImage_GetHeight(src);
     const unsigned src_pitch = FreeImage_GetPitch(src);
 
-    const uint8_t* src_bits = FreeImage_GetBits(src);
-    for (unsigned y = 0; y < height; ++y) {
-        auto src_pixel = static_cast<const SrcPixel_*>(static_cast<const void*>(src_bits));
+    const uint8_t* src_bits = FreeImage_GetConstBits(src);
+    details::ForEachRow(policy, height, FreeImage_GetLine(src), [&](unsigned y) {
+        auto src_pixel = static_cast<const SrcPixel_*>(static_cast<const void*>(src_bits + static_cast<size_t>(src_pitch) * y));
         for (unsigned x = 0; x < width; ++x) {
             vis(src_pixel[x], x, y);
         }
-        src_bits += src_pitch;
-    }
+    });
 }
 
-template <typename DstPixel_, typename SrcPixel_ = DstPixel_, typename UnaryOperation_>
-void BitmapTransform(FIBITMAP* dst, FIBITMAP* src, UnaryOperation_ unary_op)
+/**
+Calls vis(pixel, x, y) for every pixel of src, row by row on the calling thread (visitors usually accumulate)
+*/
+template <typename DstPixel_, typename SrcPixel_ = DstPixel_, typename PixelVisitor_>
+void BitmapForEach(FIBITMAP* src, PixelVisitor_ vis)
+{
+    BitmapForEach<DstPixel_, SrcPixel_>(exec::seq, src, std::move(vis));
+}
+
+template <typename DstPixel_, typename SrcPixel_ = DstPixel_, typename Policy_, typename UnaryOperation_>
+void BitmapTransform(const Policy_& policy, FIBITMAP* dst, FIBITMAP* src, UnaryOperation_ unary_op)
 {
 	const unsigned width = FreeImage_GetWidth(src);
 	const unsigned height = FreeImage_GetHeight(src);
 	const unsigned src_pitch = FreeImage_GetPitch(src);
 	const unsigned dst_pitch = FreeImage_GetPitch(dst);
 
-	const uint8_t* src_bits = FreeImage_GetBits(src);
+	const uint8_t* src_bits = FreeImage_GetConstBits(src);
 	uint8_t* dst_bits = FreeImage_GetBits(dst);
 
-	for (unsigned y = 0; y < height; ++y) {
-		auto src_pixel = static_cast<const SrcPixel_*>(static_cast<const void*>(src_bits));
-		auto dst_pixel = static_cast<DstPixel_*>(static_cast<void*>(dst_bits));
-		for (unsigned x = 0; x < width; ++x) {
-			dst_pixel[x] = unary_op(src_pixel[x]);
+	details::ForEachRow(policy, height, std::max(FreeImage_GetLine(src), FreeImage_GetLine(dst)), [&](unsigned y) {
+		auto src_pixel = static_cast<const SrcPixel_*>(static_cast<const void*>(src_bits + static_cast<size_t>(src_pitch) * y));
+		auto dst_pixel = static_cast<DstPixel_*>(static_cast<void*>(dst_bits + static_cast<size_t>(dst_pitch) * y));
+		if constexpr (std::is_same_v<Policy_, exec::ParallelUnsequencedPolicy>) {
+			const SrcPixel_* __restrict src_row = src_pixel;
+			DstPixel_* __restrict dst_row = dst_pixel;
+			FI_VECTORIZE_LOOP
+			for (unsigned x = 0; x < width; ++x) {
+				dst_row[x] = unary_op(src_row[x]);
+			}
 		}
-		src_bits += src_pitch;
-		dst_bits += dst_pitch;
-	}
+		else {
+			for (unsigned x = 0; x < width; ++x) {
+				dst_pixel[x] = unary_op(src_pixel[x]);
+			}
+		}
+	});
+}
+
+/**
+Stores unary_op(pixel) of every pixel of src into dst, by parallel bands of rows (see exec::par)
+*/
+template <typename DstPixel_, typename SrcPixel_ = DstPixel_, typename UnaryOperation_>
+void BitmapTransform(FIBITMAP* dst, FIBITMAP* src, UnaryOperation_ unary_op)
+{
+	BitmapTransform<DstPixel_, SrcPixel_>(exec::par, dst, src, std::move(unary_op));
 }
 
 template <typename Ty_>
@@ -312,6 +387,10 @@ struct YuvBrightness
 };
 
 
+/**
+Finds the pixels of min and max brightness, NaNs are skipped. Bands of rows are scanned in parallel,
+on ties the partial results keep the first pixel in scan order like a serial scan.
+*/
 template <typename PixelTy_, typename BrightnessOp_ = Brightness>
 std::tuple<PixelTy_*, PixelTy_*, double, double> FindMinMax(FIBITMAP* src, BrightnessOp_ brightnessOp = BrightnessOp_{})
 {
@@ -321,34 +400,50 @@ std::tuple<PixelTy_*, PixelTy_*, double, double> FindMinMax(FIBITMAP* src, Brigh
         const unsigned h = FreeImage_GetHeight(src);
         const unsigned w = FreeImage_GetWidth(src);
         const unsigned pitch = FreeImage_GetPitch(src);
-        auto srcLine = static_cast<uint8_t*>(static_cast<void*>(FreeImage_GetBits(src)));
-        for (unsigned j = 0; j < h; ++j, srcLine += pitch) {
-            auto pixIt = static_cast<PixelTy_*>(static_cast<void*>(srcLine));
-            for (unsigned i = 0; i < w; ++i, ++pixIt) {
-                if (IsNan(*pixIt)) {
-                    continue;
-                }
-                const auto b = static_cast<double>(brightnessOp(*pixIt));
-                if (!minIt || !maxIt) {
-                    minIt  = maxIt = pixIt;
-                    minVal = maxVal = b;
-                }
-                else {
-                    if (b < minVal) {
-                        minIt = pixIt;
-                        minVal = b;
+        uint8_t* bits = FreeImage_GetBits(src);
+        std::mutex mutex;
+        ParallelFor(0, h, CalculateBandRows(FreeImage_GetLine(src)), [&](unsigned first, unsigned last) {
+            PixelTy_* bandMinIt{}, * bandMaxIt{};
+            double bandMinVal = 0.0, bandMaxVal = 0.0;
+            for (unsigned j = first; j < last; ++j) {
+                auto pixIt = static_cast<PixelTy_*>(static_cast<void*>(bits + static_cast<size_t>(pitch) * j));
+                for (unsigned i = 0; i < w; ++i, ++pixIt) {
+                    if (IsNan(*pixIt)) {
+                        continue;
                     }
-                    if (maxVal < b) {
-                        maxIt = pixIt;
-                        maxVal = b;
+                    const auto b = static_cast<double>(brightnessOp(*pixIt));
+                    if (!bandMinIt || !bandMaxIt) {
+                        bandMinIt  = bandMaxIt = pixIt;
+                        bandMinVal = bandMaxVal = b;
+                    }
+                    else {
+                        if (b < bandMinVal) {
+                            bandMinIt = pixIt;
+                            bandMinVal = b;
+                        }
+                        if (bandMaxVal < b) {
+                            bandMaxIt = pixIt;
+                            bandMaxVal = b;
+                        }
                     }
                 }
             }
-        }
+            if (!bandMinIt) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!minIt || bandMinVal < minVal || (bandMinVal == minVal && bandMinIt < minIt)) {
+                minIt = bandMinIt;
+                minVal = bandMinVal;
+            }
+            if (!maxIt || maxVal < bandMaxVal || (bandMaxVal == maxVal && bandMaxIt < maxIt)) {
+                maxIt = bandMaxIt;
+                maxVal = bandMaxVal;
+            }
+        });
     }
     return std::make_tuple(minIt, maxIt, minVal, maxVal);
 }
 
 
-
 #endif //FREEIMAGE_SIMPLE_TOOLS_H_
@@ -0,0 +1,265 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// --------------------------------------------------------------------------
+// Target size / target quality encoding
+// The encoder quality (1 to 100) is searched for the threshold of a predicate that holds up to it: "the encoding fits"
+// for a size target, "the decoded image misses the metric" for a quality target. Each round encodes a few candidate
+// qualities in parallel on the thread pool and narrows the interval to the candidates bracketing the threshold.
+// Large images are searched on a half size proxy first, the full size search then starts around the proxy threshold.
+// --------------------------------------------------------------------------
+
+namespace {
+
+	using BitmapPtr = std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)>;
+	using MemoryPtr = std::unique_ptr<FIMEMORY, decltype(&FreeImage_CloseMemory)>;
+
+	/// Images with both sides at least this large are searched on a proxy first
+	const unsigned kProxyMinSide = 512;
+
+	/// Distance between the candidates of a round started around a hint
+	const int kHintSpacing = 3;
+
+	/// Qualities 1 to 100 and the virtual bounds 0 (always passes) and 101 (always fails)
+	const int kQualityCount = 102;
+
+	/**
+	Encodes an image at candidate qualities, keeping the encodings, and evaluates the target predicate on them.
+	Candidates may be evaluated concurrently.
+	*/
+	class TrialEncoder {
+	public:
+		TrialEncoder(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, int flags, const FIENCODETARGET& target, double size_scale)
+			: mFif(fif), mDib(dib), mFlags(flags), mTarget(target), mSizeScale(size_scale), mEncodings(kQualityCount) {
+		}
+
+		/**
+		Size predicate: the encoding at quality fits in max_bytes (scaled for proxies).
+		Metric predicate: the decoded encoding at quality misses min_metric.
+		*/
+		bool Passes(int quality, bool metric) {
+			std::vector<uint8_t> data;
+			if (!Encode(quality, data)) {
+				// an encoding that failed neither fits nor reaches the metric
+				return metric;
+			}
+			bool result;
+			if (metric) {
+				result = !(Measure(data) >= mTarget.min_metric);
+			} else {
+				result = (double)data.size() * mSizeScale <= (double)mTarget.max_bytes;
+			}
+			std::lock_guard<std::mutex> lock(mMutex);
+			mEncodings[quality] = std::move(data);
+			return result;
+		}
+
+		/// Releases the encodings other than the ones at lo and hi
+		void Keep(int lo, int hi) {
+			for (int quality = 0; quality < kQualityCount; quality++) {
+				if ((quality != lo) && (quality != hi)) {
+					std::vector<uint8_t>().swap(mEncodings[quality]);
+				}
+			}
+		}
+
+		const std::vector<uint8_t>& Encoding(int quality) const {
+			return mEncodings[quality];
+		}
+
+	private:
+		bool Encode(int quality, std::vector<uint8_t>& data) {
+			MemoryPtr stream(FreeImage_OpenMemory(), &FreeImage_CloseMemory);
+			if (!stream || !FreeImage_SaveToMemory(mFif, mDib, stream.get(), mFlags | quality)) {
+				return false;
+			}
+			uint8_t *bytes = nullptr;
+			uint64_t size = 0;
+			if (!FreeImage_AcquireMemory64(stream.get(), &bytes, &size) || !size) {
+				return false;
+			}
+			data.assign(bytes, bytes + size);
+			return true;
+		}
+
+		/// Returns the metric of the decoded data against the image, -1 if the data can't be compared
+		double Measure(std::vector<uint8_t>& data) {
+			MemoryPtr stream(FreeImage_OpenMemory(data.data(), (uint32_t)data.size()), &FreeImage_CloseMemory);
+			BitmapPtr decoded(stream ? FreeImage_LoadFromMemory(mFif, stream.get()) : nullptr, &FreeImage_Unload);
+			if (!decoded) {
+				return -1;
+			}
+			FIBITMAP *reference = Reference(decoded.get());
+			return reference ? FreeImage_ComputeMetric(reference, decoded.get(), mTarget.metric) : -1;
+		}
+
+		/// Returns the image in the type and depth of the decoded images (e.g. 24-bit for JPEG encodings of 32-bit images)
+		FIBITMAP *Reference(FIBITMAP *decoded) {
+			const FREE_IMAGE_TYPE type = FreeImage_GetImageType(decoded);
+			const unsigned bpp = FreeImage_GetBPP(decoded);
+			if ((FreeImage_GetImageType(mDib) == type) && (FreeImage_GetBPP(mDib) == bpp)) {
+				return mDib;
+			}
+			std::call_once(mConverted, [&] {
+				FIBITMAP *converted = nullptr;
+				if (type != FIT_BITMAP) {
+					converted = FreeImage_ConvertToType(mDib, type);
+				} else if (bpp == 8) {
+					converted = FreeImage_ConvertToGreyscale(mDib);
+				} else if (bpp == 24) {
+					converted = FreeImage_ConvertTo24Bits(mDib);
+				} else if (bpp == 32) {
+					converted = FreeImage_ConvertTo32Bits(mDib);
+				}
+				mReference.reset(converted);
+			});
+			return mReference.get();
+		}
+
+		FREE_IMAGE_FORMAT mFif;
+		FIBITMAP *mDib;
+		int mFlags;
+		const FIENCODETARGET& mTarget;
+		double mSizeScale;
+		std::mutex mMutex;
+		std::vector<std::vector<uint8_t>> mEncodings;
+		std::once_flag mConverted;
+		BitmapPtr mReference{ nullptr, &FreeImage_Unload };
+	};
+
+	/**
+	Returns the largest quality in [0, 100] passing a predicate that holds up to a threshold, the predicate failing at 101.
+	Rounds evaluate up to width candidates in parallel, a first round around hint (when not 0) spaces them by kHintSpacing.
+	@param lo Set to the returned quality
+	@param hi Set to the smallest failing quality found, 101 if none
+	*/
+	void SearchThreshold(TrialEncoder& encoder, bool metric, int hint, unsigned width, int& lo, int& hi) {
+		lo = 0;
+		hi = kQualityCount - 1;
+		bool first = (hint > 0);
+		while (hi - lo > 1) {
+			std::vector<int> candidates;
+			for (unsigned i = 0; i < width; i++) {
+				const int candidate = first
+					? hint + ((int)i - (int)width / 2) * kHintSpacing
+					: lo + (int)(((int64_t)(hi - lo) * (i + 1)) / (width + 1));
+				if ((candidate > lo) && (candidate < hi)) {
+					candidates.push_back(candidate);
+				}
+			}
+			std::sort(candidates.begin(), candidates.end());
+			candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+			if (candidates.empty()) {
+				candidates.push_back(lo + (hi - lo) / 2);
+			}
+			first = false;
+
+			std::vector<char> passes(candidates.size());
+			ParallelFor(0, (unsigned)candidates.size(), 1, [&](unsigned begin, unsigned end) {
+				for (unsigned i = begin; i < end; i++) {
+					passes[i] = encoder.Passes(candidates[i], metric);
+				}
+			});
+			// the first failing candidate bounds the threshold, later passing candidates (noise) are ignored
+			for (size_t i = 0; i < candidates.size(); i++) {
+				if (!passes[i]) {
+					hi = candidates[i];
+					break;
+				}
+				lo = candidates[i];
+			}
+			encoder.Keep(lo, hi);
+		}
+	}
+
+	/// Returns the quality meeting the target on encoder (0 if none), hint as in SearchThreshold
+	int SearchQuality(TrialEncoder& encoder, const FIENCODETARGET& target, int hint, unsigned width) {
+		int lo, hi;
+		if (target.min_metric > 0) {
+			// lowest quality reaching the metric
+			SearchThreshold(encoder, true, hint ? hint - 1 : 0, width, lo, hi);
+			return (hi < kQualityCount - 1) ? hi : 0;
+		}
+		// highest quality fitting in the size
+		SearchThreshold(encoder, false, hint, width, lo, hi);
+		return lo;
+	}
+
+	/// Returns the quality bits of the save flags of formats supported by FreeImage_SaveToMemoryTarget, 0 for other formats
+	int QualityFlags(FREE_IMAGE_FORMAT fif, int flags) {
+		switch (fif) {
+			case FIF_JPEG:
+				return 0x7F | JPEG_QUALITYSUPERB | JPEG_QUALITYGOOD | JPEG_QUALITYNORMAL | JPEG_QUALITYAVERAGE | JPEG_QUALITYBAD;
+			case FIF_WEBP:
+				return (flags & WEBP_LOSSLESS) ? 0 : 0x7F;
+			case FIF_HEIF:
+			case FIF_AVIF:
+				return (flags & HEIF_LOSSLESS) ? 0 : 0x7F;
+			case FIF_JXR:
+				return 0x7F;
+			default:
+				return 0;
+		}
+	}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+FIBOOL DLL_CALLCONV
+FreeImage_SaveToMemoryTarget(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FIMEMORY *stream, const FIENCODETARGET *target, int flags, int *quality) {
+	if (!stream || !target || !FreeImage_HasPixels(dib)) {
+		return FALSE;
+	}
+	const int quality_flags = QualityFlags(fif, flags);
+	if (!quality_flags) {
+		FreeImage_OutputMessageProc(fif, "FreeImage_SaveToMemoryTarget: the format has no lossy quality setting");
+		return FALSE;
+	}
+	if (!target->max_bytes && !(target->min_metric > 0)) {
+		return FALSE;
+	}
+	flags &= ~quality_flags;
+	const unsigned width = std::clamp(FreeImage_GetThreadCount(), 1U, 8U);
+
+	// narrow the search on a half size proxy
+	int hint = 0;
+	const unsigned dib_width = FreeImage_GetWidth(dib), dib_height = FreeImage_GetHeight(dib);
+	if ((dib_width >= kProxyMinSide) && (dib_height >= kProxyMinSide)) {
+		BitmapPtr proxy(FreeImage_Rescale(dib, dib_width / 2, dib_height / 2, FILTER_BOX), &FreeImage_Unload);
+		if (proxy) {
+			const double size_scale = ((double)dib_width * dib_height) / ((double)FreeImage_GetWidth(proxy.get()) * FreeImage_GetHeight(proxy.get()));
+			TrialEncoder proxy_encoder(fif, proxy.get(), flags, *target, size_scale);
+			hint = SearchQuality(proxy_encoder, *target, 0, width);
+		}
+	}
+
+	TrialEncoder encoder(fif, dib, flags, *target, 1);
+	const int found = SearchQuality(encoder, *target, hint, width);
+	if (!found) {
+		return FALSE;
+	}
+	const std::vector<uint8_t>& data = encoder.Encoding(found);
+	if (data.empty() || (data.size() > UINT32_MAX) || (target->max_bytes && (data.size() > target->max_bytes))) {
+		return FALSE;
+	}
+	if (FreeImage_WriteMemory(data.data(), 1, (unsigned)data.size(), stream) != data.size()) {
+		return FALSE;
+	}
+	if (quality) {
+		*quality = found;
+	}
+	return TRUE;
+}
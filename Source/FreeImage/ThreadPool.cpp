@@ -0,0 +1,279 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "ThreadPool.h"
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "MemoryBudget.h"
+#include <atomic>
+#include <exception>
+
+
+namespace {
+
+    thread_local bool gIsWorkerThread = false;
+
+    uint32_t DefaultThreadCount()
+    {
+        const uint32_t hw = std::thread::hardware_concurrency();
+        return hw > 0 ? hw : 1;
+    }
+
+    /**
+     * Shared state of one ParallelFor call.
+     * Bands are handed out through an atomic counter, so threads finishing early pick up remaining bands.
+     */
+    struct ParallelJob
+    {
+        std::function<void(unsigned, unsigned)> body;
+        unsigned begin{ 0 };
+        unsigned count{ 0 };
+        unsigned bands{ 0 };
+
+        std::atomic<unsigned> nextBand{ 0 };
+        std::atomic<unsigned> doneBands{ 0 };
+
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error;
+
+        void Run()
+        {
+            for (;;) {
+                const unsigned band = nextBand.fetch_add(1, std::memory_order_relaxed);
+                if (band >= bands) {
+                    break;
+                }
+                const unsigned first = begin + static_cast<unsigned>(static_cast<uint64_t>(count) * band / bands);
+                const unsigned last  = begin + static_cast<unsigned>(static_cast<uint64_t>(count) * (band + 1) / bands);
+                try {
+                    body(first, last);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                if (doneBands.fetch_add(1, std::memory_order_acq_rel) + 1 == bands) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished.notify_all();
+                }
+            }
+        }
+
+        void Wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [this] { return doneBands.load(std::memory_order_acquire) == bands; });
+        }
+    };
+
+} // namespace
+
+
+ThreadPool& ThreadPool::Instance()
+{
+    static ThreadPool instance;
+    return instance;
+}
+
+ThreadPool::~ThreadPool()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mRunning = false;
+    JoinWorkers(lock);
+}
+
+void ThreadPool::Start()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mThreadCount == 0) {
+        mThreadCount = DefaultThreadCount();
+    }
+    mRunning = true;
+}
+
+void ThreadPool::Stop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mRunning = false;
+    JoinWorkers(lock);
+}
+
+void ThreadPool::SetThreadCount(uint32_t count)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (count == 0) {
+        count = DefaultThreadCount();
+    }
+    if (count != mThreadCount) {
+        // Workers are respawned with the new count on the next submitted task
+        JoinWorkers(lock);
+        mThreadCount = count;
+    }
+}
+
+uint32_t ThreadPool::GetThreadCount() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mThreadCount != 0 ? mThreadCount : DefaultThreadCount();
+}
+
+bool ThreadPool::Submit(Task task)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!mRunning || mStopping || mThreadCount <= 1) {
+        return false;
+    }
+    if (mWorkers.empty()) {
+        try {
+            SpawnWorkers(lock);
+        }
+        catch (...) {
+            // Failed to create threads, fallback to the calling thread
+            JoinWorkers(lock);
+            return false;
+        }
+    }
+    ThreadBudget* budget = AcquireThreadBudget();
+    try {
+        mTasks.push_back({ std::move(task), budget });
+    }
+    catch (...) {
+        ReleaseThreadBudget(budget);
+        throw;
+    }
+    lock.unlock();
+    mCondition.notify_one();
+    return true;
+}
+
+bool ThreadPool::IsWorkerThread()
+{
+    return gIsWorkerThread;
+}
+
+void ThreadPool::SpawnWorkers(std::unique_lock<std::mutex>& /*lock*/)
+{
+    // The calling thread of ParallelFor always takes part in processing, so one thread less is enough
+    const uint32_t workersCount = mThreadCount - 1;
+    mWorkers.reserve(workersCount);
+    for (uint32_t i = 0; i < workersCount; ++i) {
+        mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+void ThreadPool::JoinWorkers(std::unique_lock<std::mutex>& lock)
+{
+    if (mWorkers.empty()) {
+        return;
+    }
+    mStopping = true;
+    std::vector<std::thread> workers;
+    workers.swap(mWorkers);
+    lock.unlock();
+    mCondition.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    lock.lock();
+    mStopping = false;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    gIsWorkerThread = true;
+    for (;;) {
+        PendingTask pending;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this] { return mStopping || !mTasks.empty(); });
+            if (mTasks.empty()) {
+                // Stopping and nothing left to do
+                break;
+            }
+            pending = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        ThreadBudgetScope scope(pending.budget);
+        ReleaseThreadBudget(pending.budget);
+        pending.task();
+    }
+}
+
+
+// ==========================================================
+//   Parallel execution helpers
+// ==========================================================
+
+void ParallelFor(unsigned begin, unsigned end, unsigned min_grain, const std::function<void(unsigned, unsigned)>& body)
+{
+    if (begin >= end) {
+        return;
+    }
+    const unsigned count = end - begin;
+    const unsigned grain = std::max(1u, min_grain);
+
+    auto& pool = ThreadPool::Instance();
+    const uint32_t threads = ThreadPool::IsWorkerThread() ? 1 : pool.GetThreadCount();
+
+    // A few bands per thread smooth out uneven rows without too much scheduling overhead
+    const unsigned maxBands = static_cast<unsigned>(std::min<uint64_t>(static_cast<uint64_t>(threads) * 4, count));
+    const unsigned bands = std::min(maxBands, (count + grain - 1) / grain);
+    if (threads <= 1 || bands <= 1) {
+        body(begin, end);
+        return;
+    }
+
+    auto job = std::make_shared<ParallelJob>();
+    job->body  = body;
+    job->begin = begin;
+    job->count = count;
+    job->bands = bands;
+
+    const unsigned helpers = std::min<unsigned>(threads - 1, bands - 1);
+    for (unsigned i = 0; i < helpers; ++i) {
+        if (!pool.Submit([job] { job->Run(); })) {
+            break;
+        }
+    }
+
+    job->Run();
+    job->Wait();
+
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+
+// ==========================================================
+//   Public API
+// ==========================================================
+
+void DLL_CALLCONV
+FreeImage_SetThreadCount(uint32_t count)
+{
+    try {
+        ThreadPool::Instance().SetThreadCount(count);
+    }
+    catch (...) {
+    }
+}
+
+uint32_t DLL_CALLCONV
+FreeImage_GetThreadCount()
+{
+    try {
+        return ThreadPool::Instance().GetThreadCount();
+    }
+    catch (...) {
+        return 1;
+    }
+}
@@ -0,0 +1,91 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_THREAD_POOL_H_
+#define FREEIMAGE_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadBudget;
+
+/**
+ * Library-wide pool of worker threads.
+ * The pool is started by FreeImage_Initialise and stopped by FreeImage_DeInitialise.
+ * Workers are spawned lazily on the first submitted task, so an idle library costs no threads.
+ * Kernels should not use the pool directly but go through ParallelFor (see Utilities.h).
+ */
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    static ThreadPool& Instance();
+
+    /**
+     * Allows accepting tasks
+     */
+    void Start();
+
+    /**
+     * Runs all pending tasks and joins workers. Submit() fails after this call until next Start()
+     */
+    void Stop();
+
+    /**
+     * Sets total number of threads taking part in parallel loops (including a calling thread).
+     * 0 selects hardware concurrency, 1 disables multithreading.
+     */
+    void SetThreadCount(uint32_t count);
+
+    /**
+     * Returns total number of threads taking part in parallel loops (including a calling thread)
+     */
+    uint32_t GetThreadCount() const;
+
+    /**
+     * Enqueues a task. Returns false if the pool is not running, then the caller has to execute the task itself.
+     * The task runs under the memory budget of the calling thread (see FreeImage_SetThreadMemoryBudget).
+     */
+    bool Submit(Task task);
+
+    /**
+     * Returns true if called from one of the pool workers
+     */
+    static bool IsWorkerThread();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+    ThreadPool() = default;
+    ~ThreadPool();
+
+    struct PendingTask
+    {
+        Task task;
+        ThreadBudget* budget{ nullptr };   // reference acquired by Submit
+    };
+
+    void WorkerLoop();
+    void SpawnWorkers(std::unique_lock<std::mutex>& lock);
+    void JoinWorkers(std::unique_lock<std::mutex>& lock);
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<PendingTask> mTasks;
+    std::vector<std::thread> mWorkers;
+    uint32_t mThreadCount{ 0 };
+    bool mRunning{ false };
+    bool mStopping{ false };
+};
+
+#endif // FREEIMAGE_THREAD_POOL_H_
@@ -0,0 +1,175 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "Trace.h"
+#include "Utilities.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace {
+
+    constexpr size_t kCategories = static_cast<size_t>(TraceCategory::eCount);
+
+    const char* const kCategoryNames[kCategories] = { "load", "save", "convert", "rescale", "metadata" };
+
+    struct TraceHooks
+    {
+        FI_TraceBeginProc begin{ nullptr };
+        FI_TraceEndProc end{ nullptr };
+        void* user_data{ nullptr };
+    };
+
+    /**
+     * Current callbacks, replaced as a whole so that a thread never sees the begin of one set and the end of another.
+     * Replaced sets are kept until exit since running operations may still use them.
+     */
+    std::atomic<const TraceHooks*> gHooks{ nullptr };
+    std::mutex gHooksMutex;
+    std::vector<std::unique_ptr<TraceHooks>> gHooksHistory;
+
+    struct CategoryCounters
+    {
+        std::atomic<uint64_t> count{ 0 };
+        std::atomic<uint64_t> ns{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+    };
+
+    CategoryCounters gCounters[kCategories];
+
+    std::atomic<uint64_t> gAllocations{ 0 };
+    std::atomic<uint64_t> gAllocatedBytes{ 0 };
+    std::atomic<uint64_t> gBitmapBytes{ 0 };
+    std::atomic<uint64_t> gPeakBitmapBytes{ 0 };
+
+    thread_local unsigned tDepth[kCategories] = {};
+
+    void UpdatePeak(uint64_t value)
+    {
+        uint64_t peak = gPeakBitmapBytes.load(std::memory_order_relaxed);
+        while (value > peak && !gPeakBitmapBytes.compare_exchange_weak(peak, value, std::memory_order_relaxed)) {
+        }
+    }
+
+} // namespace
+
+
+TraceScope::TraceScope(TraceCategory category, const char* name)
+    : mCategory(category), mName(name ? name : ""), mOutermost(tDepth[static_cast<size_t>(category)]++ == 0)
+{
+    const TraceHooks* hooks = gHooks.load(std::memory_order_acquire);
+    if (hooks && hooks->begin) {
+        hooks->begin(kCategoryNames[static_cast<size_t>(category)], mName, hooks->user_data);
+    }
+    mStart = std::chrono::steady_clock::now();
+}
+
+TraceScope::~TraceScope()
+{
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStart).count();
+    const auto ns = static_cast<uint64_t>(elapsed > 0 ? elapsed : 0);
+    const size_t index = static_cast<size_t>(mCategory);
+    --tDepth[index];
+
+    if (mOutermost) {
+        CategoryCounters& counters = gCounters[index];
+        counters.count.fetch_add(1, std::memory_order_relaxed);
+        counters.ns.fetch_add(ns, std::memory_order_relaxed);
+        if (mBytes) {
+            counters.bytes.fetch_add(mBytes, std::memory_order_relaxed);
+        }
+    }
+
+    const TraceHooks* hooks = gHooks.load(std::memory_order_acquire);
+    if (hooks && hooks->end) {
+        hooks->end(kCategoryNames[index], mName, ns, hooks->user_data);
+    }
+}
+
+void TraceAllocated(size_t bytes)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    gAllocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    UpdatePeak(gBitmapBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void TraceReleased(size_t bytes)
+{
+    gBitmapBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+
+// ==========================================================
+//   Public API
+// ==========================================================
+
+void DLL_CALLCONV
+FreeImage_SetTraceCallback(FI_TraceBeginProc begin, FI_TraceEndProc end, void* user_data)
+{
+    try {
+        std::lock_guard<std::mutex> lock(gHooksMutex);
+        if (!begin && !end) {
+            gHooks.store(nullptr, std::memory_order_release);
+            return;
+        }
+        auto hooks = std::make_unique<TraceHooks>();
+        hooks->begin = begin;
+        hooks->end = end;
+        hooks->user_data = user_data;
+        gHooksHistory.push_back(std::move(hooks));
+        gHooks.store(gHooksHistory.back().get(), std::memory_order_release);
+    }
+    catch (const std::bad_alloc&) {
+        FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+    }
+}
+
+void DLL_CALLCONV
+FreeImage_GetStats(FISTATS* stats)
+{
+    if (!stats) {
+        return;
+    }
+    const auto get = [](const std::atomic<uint64_t>& value) { return value.load(std::memory_order_relaxed); };
+    const CategoryCounters& load     = gCounters[static_cast<size_t>(TraceCategory::eLoad)];
+    const CategoryCounters& save     = gCounters[static_cast<size_t>(TraceCategory::eSave)];
+    const CategoryCounters& convert  = gCounters[static_cast<size_t>(TraceCategory::eConvert)];
+    const CategoryCounters& rescale  = gCounters[static_cast<size_t>(TraceCategory::eRescale)];
+    const CategoryCounters& metadata = gCounters[static_cast<size_t>(TraceCategory::eMetadata)];
+
+    stats->load_count        = get(load.count);
+    stats->load_ns           = get(load.ns);
+    stats->bytes_read        = get(load.bytes);
+    stats->save_count        = get(save.count);
+    stats->save_ns           = get(save.ns);
+    stats->bytes_written     = get(save.bytes);
+    stats->convert_count     = get(convert.count);
+    stats->convert_ns        = get(convert.ns);
+    stats->rescale_count     = get(rescale.count);
+    stats->rescale_ns        = get(rescale.ns);
+    stats->metadata_count    = get(metadata.count);
+    stats->metadata_ns       = get(metadata.ns);
+    stats->allocations       = get(gAllocations);
+    stats->allocated_bytes   = get(gAllocatedBytes);
+    stats->bitmap_bytes      = get(gBitmapBytes);
+    stats->peak_bitmap_bytes = get(gPeakBitmapBytes);
+}
+
+void DLL_CALLCONV
+FreeImage_ResetStats()
+{
+    for (CategoryCounters& counters : gCounters) {
+        counters.count.store(0, std::memory_order_relaxed);
+        counters.ns.store(0, std::memory_order_relaxed);
+        counters.bytes.store(0, std::memory_order_relaxed);
+    }
+    gAllocations.store(0, std::memory_order_relaxed);
+    gAllocatedBytes.store(0, std::memory_order_relaxed);
+    // live bytes stay, the peak restarts from them
+    gPeakBitmapBytes.store(gBitmapBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
@@ -0,0 +1,64 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_TRACE_H_
+#define FREEIMAGE_TRACE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "FreeImage.h"
+
+/**
+ * Operations counted in FISTATS and reported to the trace callbacks (see FreeImage_SetTraceCallback).
+ */
+enum class TraceCategory : unsigned
+{
+    eLoad,
+    eSave,
+    eConvert,
+    eRescale,
+    eMetadata,
+    eCount
+};
+
+/**
+ * Times an operation from construction to destruction and calls the trace callbacks around it.
+ * Nested operations of the same category on a thread are reported to the callbacks, but only the
+ * outermost one is counted in the statistics, so that a conversion calling another one isn't counted twice.
+ * Costs two clock reads and a few relaxed atomic operations.
+ */
+class TraceScope
+{
+public:
+    TraceScope(TraceCategory category, const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    /**
+     * Bytes read or written by a load or a save, counted when the scope ends
+     */
+    void SetBytes(uint64_t bytes) {
+        mBytes = bytes;
+    }
+
+private:
+    TraceCategory mCategory;
+    const char* mName;
+    bool mOutermost;
+    uint64_t mBytes{ 0 };
+    std::chrono::steady_clock::time_point mStart;
+};
+
+/**
+ * Allocator accounting, called for every block of FreeImage_Aligned_Malloc / FreeImage_Aligned_Free
+ */
+void TraceAllocated(size_t bytes);
+void TraceReleased(size_t bytes);
+
+#endif // FREEIMAGE_TRACE_H_
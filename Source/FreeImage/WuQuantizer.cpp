@@ -34,6 +34,10 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
 ///////////////////////////////////////////////////////////////////////
 
 // Size of a 3D array : 33 x 33 x 33
@@ -44,6 +48,52 @@
 
 #define MAXCOLOR	256
 
+namespace {
+
+	/**
+	Moments of a histogram cell, counted by each band of the image before they are merged
+	*/
+	struct CellMoments {
+		int32_t wt, mr, mg, mb;
+		int64_t m2;		// exact sum of c^2
+	};
+
+	/**
+	Converts a histogram into cumulative moments, mmt[r][g][b] = sum of the cells [1..r][1..g][1..b].<br>
+	The sum is separable: running sums along the blue lines, then along green (rows of 33 contiguous values),
+	then along red (planes of 33 x 33 contiguous values). The last two passes add contiguous arrays, which
+	the compiler vectorizes.
+	*/
+	template <typename T>
+	void CumulateMoments(T *mmt) {
+		for (int r = 1; r <= 32; r++) {
+			for (int g = 1; g <= 32; g++) {
+				T *line = mmt + INDEX(r, g, 0);
+				for (int b = 2; b <= 32; b++) {
+					line[b] += line[b - 1];
+				}
+			}
+		}
+		for (int r = 1; r <= 32; r++) {
+			for (int g = 2; g <= 32; g++) {
+				T *row = mmt + INDEX(r, g, 0);
+				const T *previous = row - 33;
+				for (int b = 0; b < 33; b++) {
+					row[b] += previous[b];
+				}
+			}
+		}
+		for (int r = 2; r <= 32; r++) {
+			T *plane = mmt + INDEX(r, 0, 0);
+			const T *previous = plane - 1089;
+			for (int i = 0; i < 1089; i++) {
+				plane[i] += previous[i];
+			}
+		}
+	}
+
+} // namespace
+
 // Constructor / Destructor
 
 WuQuantizer::WuQuantizer(FIBITMAP *dib) {
@@ -54,7 +104,6 @@ WuQuantizer::WuQuantizer(FIBITMAP *dib) {
 
 	gm2 = nullptr;
 	wt = mr = mg = mb = nullptr;
-	Qadd = nullptr;
 
 	// Allocate 3D arrays
 	gm2 = static_cast<float*>(calloc(SIZE_3D, sizeof(float)));
@@ -63,16 +112,12 @@ WuQuantizer::WuQuantizer(FIBITMAP *dib) {
 	mg = static_cast<int32_t*>(calloc(SIZE_3D, sizeof(int32_t)));
 	mb = static_cast<int32_t*>(calloc(SIZE_3D, sizeof(int32_t)));
 
-	// Allocate Qadd
-	Qadd = static_cast<uint16_t*>(calloc(static_cast<size_t>(width) * height, sizeof(uint16_t)));
-
-	if (!gm2 || !wt || !mr || !mg || !mb || !Qadd) {
+	if (!gm2 || !wt || !mr || !mg || !mb) {
 		if (gm2)	free(gm2);
 		if (wt)	free(wt);
 		if (mr)	free(mr);
 		if (mg)	free(mg);
 		if (mb)	free(mb);
-		if (Qadd)  free(Qadd);
 		throw FI_MSG_ERROR_MEMORY;
 	}
 }
@@ -83,7 +128,6 @@ WuQuantizer::~WuQuantizer() {
 	if (mr)	free(mr);
 	if (mg)	free(mg);
 	if (mb)	free(mb);
-	if (Qadd)  free(Qadd);
 }
 
 
@@ -92,59 +136,49 @@ WuQuantizer::~WuQuantizer() {
 // NB: these must start out 0!
 
 // Build 3-D color histogram of counts, r/g/b, c^2
+// Bands of rows (about one per thread) count their pixels in a private histogram, merged at the end of the band.
+// Sums of c^2 are exact integers, so the histogram does not depend on the number of bands.
 void 
-WuQuantizer::Hist3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, float *m2, int ReserveSize, FIRGBA8 *ReservePalette) {
+WuQuantizer::Hist3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, double *m2, int ReserveSize, FIRGBA8 *ReservePalette) {
 	int ind = 0;
 	int inr, ing, inb, table[256];
 	int i;
-	unsigned y, x;
 
 	for (i = 0; i < 256; i++)
 		table[i] = i * i;
 
-	if (FreeImage_GetBPP(m_dib) == 24) {
-		size_t rowOffset = 0;
-		for (y = 0; y < height; y++) {
-			uint8_t *bits = FreeImage_GetScanLine(m_dib, y);
-
-			for (x = 0; x < width; x++)	{
-				inr = (bits[FI_RGBA_RED] >> 3) + 1;
-				ing = (bits[FI_RGBA_GREEN] >> 3) + 1;
-				inb = (bits[FI_RGBA_BLUE] >> 3) + 1;
-				ind = INDEX(inr, ing, inb);
-				Qadd[rowOffset + x] = (uint16_t)ind;
-				// [inr][ing][inb]
-				vwt[ind]++;
-				vmr[ind] += bits[FI_RGBA_RED];
-				vmg[ind] += bits[FI_RGBA_GREEN];
-				vmb[ind] += bits[FI_RGBA_BLUE];
-				m2[ind] += (float)(table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]]);
-				bits += 3;
+	const unsigned bytespp = FreeImage_GetLine(m_dib) / width;
+	const uint8_t *bits = FreeImage_GetConstBits(m_dib);
+	const unsigned threads = std::max(1u, FreeImage_GetThreadCount());
+	// a band counts at least as many pixels as it merges cells
+	const unsigned grain = std::max({ CalculateBandRows(FreeImage_GetLine(m_dib)), (height + threads - 1) / threads, (SIZE_3D + width - 1) / width });
+
+	std::mutex mutex;
+	ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+		std::vector<CellMoments> local(SIZE_3D, CellMoments{});
+		for (unsigned y = first; y < last; y++) {
+			const uint8_t *pixel = bits + (size_t)pitch * y;
+			for (unsigned x = 0; x < width; x++, pixel += bytespp) {
+				const int red = pixel[FI_RGBA_RED], green = pixel[FI_RGBA_GREEN], blue = pixel[FI_RGBA_BLUE];
+				const int r = (red >> 3) + 1, g = (green >> 3) + 1, b = (blue >> 3) + 1;
+				// [r][g][b]
+				CellMoments &cell = local[INDEX(r, g, b)];
+				cell.wt++;
+				cell.mr += red;
+				cell.mg += green;
+				cell.mb += blue;
+				cell.m2 += table[red] + table[green] + table[blue];
 			}
-			rowOffset += width;
 		}
-	} else {
-		size_t rowOffset = 0;
-		for (y = 0; y < height; y++) {
-			uint8_t *bits = FreeImage_GetScanLine(m_dib, y);
-
-			for (x = 0; x < width; x++)	{
-				inr = (bits[FI_RGBA_RED] >> 3) + 1;
-				ing = (bits[FI_RGBA_GREEN] >> 3) + 1;
-				inb = (bits[FI_RGBA_BLUE] >> 3) + 1;
-				ind = INDEX(inr, ing, inb);
-				Qadd[rowOffset + x] = (uint16_t)ind;
-				// [inr][ing][inb]
-				vwt[ind]++;
-				vmr[ind] += bits[FI_RGBA_RED];
-				vmg[ind] += bits[FI_RGBA_GREEN];
-				vmb[ind] += bits[FI_RGBA_BLUE];
-				m2[ind] += (float)(table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]]);
-				bits += 4;
-			}
-			rowOffset += width;
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int k = 0; k < SIZE_3D; k++) {
+			vwt[k] += local[k].wt;
+			vmr[k] += local[k].mr;
+			vmg[k] += local[k].mg;
+			vmb[k] += local[k].mb;
+			m2[k] += (double)local[k].m2;
 		}
-	}
+	});
 
 	if (ReserveSize > 0) {
 		int max = 0;
@@ -161,7 +195,7 @@ WuQuantizer::Hist3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, floa
 			mr[ind] = max * ReservePalette[i].red;
 			mg[ind] = max * ReservePalette[i].green;
 			mb[ind] = max * ReservePalette[i].blue;
-			gm2[ind] = (float)max * (float)(table[ReservePalette[i].red] + table[ReservePalette[i].green] + table[ReservePalette[i].blue]);
+			m2[ind] = (double)max * (double)(table[ReservePalette[i].red] + table[ReservePalette[i].green] + table[ReservePalette[i].blue]);
 		}
 	}
 }
@@ -179,42 +213,16 @@ WuQuantizer::Hist3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, floa
 // the sums of the above quantities over any desired box.
 
 // Compute cumulative moments
+// Sums of c^2 are cumulated in double precision, where they are exact, then rounded once to float
 void 
-WuQuantizer::M3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, float *m2) {
-	unsigned ind1, ind2;
-	uint8_t i, r, g, b;
-	int32_t line, line_r, line_g, line_b;
-	int32_t area[33], area_r[33], area_g[33], area_b[33];
-	float line2, area2[33];
-
-    for (r = 1; r <= 32; r++) {
-		for (i = 0; i <= 32; i++) {
-			area2[i] = 0;
-			area[i] = area_r[i] = area_g[i] = area_b[i] = 0;
-		}
-		for (g = 1; g <= 32; g++) {
-			line2 = 0;
-			line = line_r = line_g = line_b = 0;
-			for (b = 1; b <= 32; b++) {			 
-				ind1 = INDEX(r, g, b); // [r][g][b]
-				line += vwt[ind1];
-				line_r += vmr[ind1]; 
-				line_g += vmg[ind1]; 
-				line_b += vmb[ind1];
-				line2 += m2[ind1];
-				area[b] += line;
-				area_r[b] += line_r;
-				area_g[b] += line_g;
-				area_b[b] += line_b;
-				area2[b] += line2;
-				ind2 = ind1 - 1089; // [r-1][g][b]
-				vwt[ind1] = vwt[ind2] + area[b];
-				vmr[ind1] = vmr[ind2] + area_r[b];
-				vmg[ind1] = vmg[ind2] + area_g[b];
-				vmb[ind1] = vmb[ind2] + area_b[b];
-				m2[ind1] = m2[ind2] + area2[b];
-			}
-		}
+WuQuantizer::M3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, double *m2) {
+	CumulateMoments(vwt);
+	CumulateMoments(vmr);
+	CumulateMoments(vmg);
+	CumulateMoments(vmb);
+	CumulateMoments(m2);
+	for (int i = 0; i < SIZE_3D; i++) {
+		gm2[i] = (float)m2[i];
 	}
 }
 
@@ -455,11 +463,13 @@ WuQuantizer::Quantize(int PaletteSize, int ReserveSize, FIRGBA8 *ReservePalette)
 		
 		// Compute 3D histogram
 
-		Hist3D(wt, mr, mg, mb, gm2, ReserveSize, ReservePalette);
+		std::vector<double> m2(SIZE_3D, 0.0);
+
+		Hist3D(wt, mr, mg, mb, m2.data(), ReserveSize, ReservePalette);
 
 		// Compute moments
 
-		M3D(wt, mr, mg, mb, gm2);
+		M3D(wt, mr, mg, mb, m2.data());
 
 		cube[0].r0 = cube[0].g0 = cube[0].b0 = 0;
 		cube[0].r1 = cube[0].g1 = cube[0].b1 = 32;
@@ -533,17 +543,25 @@ WuQuantizer::Quantize(int PaletteSize, int ReserveSize, FIRGBA8 *ReservePalette)
 			}
 		}
 
-		int npitch = FreeImage_GetPitch(new_dib);
-
-		size_t rowOffset = 0;
-		for (unsigned y = 0; y < height; y++) {
-			uint8_t *new_bits = FreeImage_GetBits(new_dib) + (y * npitch);
-
-			for (unsigned x = 0; x < width; x++) {
-				new_bits[x] = tag[Qadd[rowOffset + x]];
+		// remap the pixels by parallel bands, tag is the inverse colormap of the histogram cells
+
+		const unsigned npitch = FreeImage_GetPitch(new_dib);
+		const unsigned bytespp = FreeImage_GetLine(m_dib) / width;
+		const uint8_t *src_bits = FreeImage_GetConstBits(m_dib);
+		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
+
+		ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(m_dib)), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				const uint8_t *pixel = src_bits + (size_t)pitch * y;
+				uint8_t *new_bits = dst_bits + (size_t)npitch * y;
+				for (unsigned x = 0; x < width; x++, pixel += bytespp) {
+					const int r = (pixel[FI_RGBA_RED] >> 3) + 1;
+					const int g = (pixel[FI_RGBA_GREEN] >> 3) + 1;
+					const int b = (pixel[FI_RGBA_BLUE] >> 3) + 1;
+					new_bits[x] = tag[INDEX(r, g, b)];
+				}
 			}
-			rowOffset += width;
-		}
+		});
 
 		// output 'new_pal' as color look-up table contents,
 		// 'new_bits' as the quantized image (array of table addresses).
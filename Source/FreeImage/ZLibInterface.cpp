@@ -22,10 +22,131 @@
 #include "zlib.h"
 #include "FreeImage.h"
 #include "Utilities.h"
+#if FREEIMAGE_WITH_LIBDEFLATE
+#include "libdeflate.h"
+#endif
+#ifdef ZLIBNG_VERSION
+#define OS_CODE 0xFF	// zlib-ng doesn't install zutil.h, write "unknown"
+#else
 #include "zutil.h"	/* must be the last header because of error C3163 in VS2008 (_vsnprintf defined in stdio.h) */
+#endif
+
+#include <atomic>
+#include <memory>
+
+namespace {
+
+	struct ZLibOptions
+	{
+		std::atomic<int> level{ -1 };
+		std::atomic<int> strategy{ FIZS_FORMAT_DEFAULT };
+	};
+
+	/// Options of FIF_UNKNOWN (whole-buffer functions), FIF_PNG and FIF_TIFF
+	ZLibOptions gZLibOptions[3];
+
+	ZLibOptions* FindZLibOptions(FREE_IMAGE_FORMAT fif) {
+		switch (fif) {
+			case FIF_UNKNOWN:
+				return &gZLibOptions[0];
+			case FIF_PNG:
+				return &gZLibOptions[1];
+			case FIF_TIFF:
+				return &gZLibOptions[2];
+			default:
+				return nullptr;
+		}
+	}
+
+	/**
+	compress2 with a strategy
+	*/
+	int Deflate(uint8_t *target, uLongf *target_size, const uint8_t *source, uLong source_size, int level, int strategy) {
+		if (strategy == Z_DEFAULT_STRATEGY) {
+			return compress2(target, target_size, source, source_size, level);
+		}
+		z_stream stream{};
+		int zerr = deflateInit2(&stream, level, Z_DEFLATED, MAX_WBITS, 8, strategy);
+		if (zerr != Z_OK) {
+			return zerr;
+		}
+		stream.next_in = const_cast<uint8_t*>(source);
+		stream.avail_in = (uInt)source_size;
+		stream.next_out = target;
+		stream.avail_out = (uInt)*target_size;
+		zerr = deflate(&stream, Z_FINISH);
+		*target_size = stream.total_out;
+		deflateEnd(&stream);
+		return (zerr == Z_STREAM_END) ? Z_OK : (zerr == Z_OK) ? Z_BUF_ERROR : zerr;
+	}
+
+#if FREEIMAGE_WITH_LIBDEFLATE
+
+	struct CompressorDeleter {
+		void operator()(libdeflate_compressor *c) const { libdeflate_free_compressor(c); }
+	};
+
+	struct DecompressorDeleter {
+		void operator()(libdeflate_decompressor *d) const { libdeflate_free_decompressor(d); }
+	};
+
+	/**
+	Compressor of the calling thread, kept between calls with the same level.
+	@return Returns nullptr if libdeflate doesn't apply, zlib does the work then
+	*/
+	libdeflate_compressor* GetCompressor(int level, int strategy) {
+		if ((level < 1) || (strategy != Z_DEFAULT_STRATEGY)) {
+			return nullptr;
+		}
+		thread_local std::unique_ptr<libdeflate_compressor, CompressorDeleter> compressor;
+		thread_local int compressor_level = 0;
+		if (!compressor || (compressor_level != level)) {
+			compressor.reset(libdeflate_alloc_compressor(level));
+			compressor_level = level;
+		}
+		return compressor.get();
+	}
+
+	libdeflate_decompressor* GetDecompressor() {
+		thread_local std::unique_ptr<libdeflate_decompressor, DecompressorDeleter> decompressor(libdeflate_alloc_decompressor());
+		return decompressor.get();
+	}
+
+#endif // FREEIMAGE_WITH_LIBDEFLATE
+
+	/**
+	Level and strategy of the whole-buffer functions
+	*/
+	void GetBufferOptions(int default_level, int *level, int *strategy) {
+		*level = gZLibOptions[0].level.load(std::memory_order_relaxed);
+		if (*level < 0) {
+			*level = default_level;
+		}
+		*strategy = gZLibOptions[0].strategy.load(std::memory_order_relaxed);
+		if (*strategy < 0) {
+			*strategy = Z_DEFAULT_STRATEGY;
+		}
+	}
+
+} // namespace
+
+#if FREEIMAGE_WITH_LIBDEFLATE
+
+std::unique_ptr<FIDEPENDENCY> MakeDeflateDependencyInfo() {
+	auto info = std::make_unique<FIDEPENDENCY>();
+	info->type = FIDEP_STATIC;
+	info->name = "libdeflate";
+	info->fullVersion  = LIBDEFLATE_VERSION_STRING;
+	info->majorVersion = LIBDEFLATE_VERSION_MAJOR;
+	info->minorVersion = LIBDEFLATE_VERSION_MINOR;
+	return info;
+}
+
+#endif // FREEIMAGE_WITH_LIBDEFLATE
 
 /**
-Compresses a source buffer into a target buffer, using the ZLib library. 
+Compresses a source buffer into a target buffer, using the ZLib library 
+(or libdeflate when available) with the options of FreeImage_SetZLibOptions(FIF_UNKNOWN, ...). 
 Upon entry, target_size is the total size of the destination buffer, 
 which must be at least 0.1% larger than source_size plus 12 bytes. 
 
@@ -38,9 +159,21 @@ which must be at least 0.1% larger than source_size plus 12 bytes.
 */
 uint32_t DLL_CALLCONV 
 FreeImage_ZLibCompress(uint8_t *target, uint32_t target_size, uint8_t *source, uint32_t source_size) {
+	int level, strategy;
+	GetBufferOptions(Z_DEFAULT_COMPRESSION, &level, &strategy);
+
+#if FREEIMAGE_WITH_LIBDEFLATE
+	if (libdeflate_compressor *compressor = GetCompressor((level == Z_DEFAULT_COMPRESSION) ? 6 : level, strategy)) {
+		// libdeflate needs a little more room than zlib, retry with zlib when it fails
+		if (const size_t size = libdeflate_zlib_compress(compressor, source, source_size, target, target_size)) {
+			return (uint32_t)size;
+		}
+	}
+#endif
+
 	uLongf dest_len = (uLongf)target_size;
 
-	int zerr = compress(target, &dest_len, source, source_size);
+	int zerr = Deflate(target, &dest_len, source, source_size, level, strategy);
 	switch (zerr) {
 		case Z_MEM_ERROR:	// not enough memory
 		case Z_BUF_ERROR:	// not enough room in the output buffer
@@ -70,6 +203,16 @@ compression library.
 */
 uint32_t DLL_CALLCONV 
 FreeImage_ZLibUncompress(uint8_t *target, uint32_t target_size, uint8_t *source, uint32_t source_size) {
+#if FREEIMAGE_WITH_LIBDEFLATE
+	if (libdeflate_decompressor *decompressor = GetDecompressor()) {
+		// errors are reported by zlib below
+		size_t size = 0;
+		if (libdeflate_zlib_decompress(decompressor, source, source_size, target, target_size, &size) == LIBDEFLATE_SUCCESS) {
+			return (uint32_t)size;
+		}
+	}
+#endif
+
 	uLongf dest_len = (uLongf)target_size;
 
 	int zerr = uncompress(target, &dest_len, source, source_size);
@@ -101,13 +244,24 @@ which must be at least 0.1% larger than source_size plus 24 bytes.
 */
 uint32_t DLL_CALLCONV 
 FreeImage_ZLibGZip(uint8_t *target, uint32_t target_size, uint8_t *source, uint32_t source_size) {
+	int level, strategy;
+	GetBufferOptions(Z_BEST_COMPRESSION, &level, &strategy);
+
+#if FREEIMAGE_WITH_LIBDEFLATE
+	if (libdeflate_compressor *compressor = GetCompressor((level == Z_DEFAULT_COMPRESSION) ? 6 : level, strategy)) {
+		if (const size_t size = libdeflate_gzip_compress(compressor, source, source_size, target, target_size)) {
+			return (uint32_t)size;
+		}
+	}
+#endif
+
 	uLongf dest_len = (uLongf)target_size - 12;
 	uint32_t crc = crc32(0L, nullptr, 0);
 
     // set up header (stolen from zlib/gzio.c)
     snprintf((char *)target, target_size / sizeof(char), "%c%c%c%c%c%c%c%c", 0x1f, 0x8b,
          Z_DEFLATED, 0 /*flags*/, 0,0,0,0 /*time*/);
-    int zerr = compress2(target + 8, &dest_len, source, source_size, Z_BEST_COMPRESSION);
+    int zerr = Deflate(target + 8, &dest_len, source, source_size, level, strategy);
 	switch (zerr) {
 		case Z_MEM_ERROR:	// not enough memory
 		case Z_BUF_ERROR:	// not enough room in the output buffer
@@ -177,6 +331,16 @@ static int checkheader(z_stream *stream) {
 
 uint32_t DLL_CALLCONV 
 FreeImage_ZLibGUnzip(uint8_t *target, uint32_t target_size, uint8_t *source, uint32_t source_size) {
+#if FREEIMAGE_WITH_LIBDEFLATE
+	if (libdeflate_decompressor *decompressor = GetDecompressor()) {
+		// libdeflate checks the trailer, zlib below accepts damaged ones
+		size_t size = 0;
+		if (libdeflate_gzip_decompress(decompressor, source, source_size, target, target_size, &size) == LIBDEFLATE_SUCCESS) {
+			return (uint32_t)size;
+		}
+	}
+#endif
+
     uint32_t src_len  = source_size;
     uint32_t dest_len = target_size;
     int   zerr     = Z_DATA_ERROR;
@@ -219,5 +383,44 @@ If source is NULL, this function returns the required initial value for the crc.
 uint32_t DLL_CALLCONV 
 FreeImage_ZLibCRC32(uint32_t crc, uint8_t *source, uint32_t source_size) {
 
+#if FREEIMAGE_WITH_LIBDEFLATE
+    return libdeflate_crc32(crc, source, source_size);
+#else
     return crc32(crc, source, source_size);
+#endif
+}
+
+/**
+Sets the deflate level and strategy of a format.
+
+@param fif FIF_PNG, FIF_TIFF or FIF_UNKNOWN for FreeImage_ZLibCompress and FreeImage_ZLibGZip
+@param level 0 (stored) to 9 (best compression), -1 for the format default
+@param strategy Deflate strategy, FIZS_FORMAT_DEFAULT for the format default
+@return Returns FALSE if fif doesn't use deflate or the values are out of range
+@see FreeImage_GetZLibOptions
+*/
+FIBOOL DLL_CALLCONV
+FreeImage_SetZLibOptions(FREE_IMAGE_FORMAT fif, int level, FREE_IMAGE_ZSTRATEGY strategy) {
+	ZLibOptions *options = FindZLibOptions(fif);
+	if (!options || (level < -1) || (level > 9) || (strategy < FIZS_FORMAT_DEFAULT) || (strategy > FIZS_FIXED)) {
+		return FALSE;
+	}
+	options->level.store(level, std::memory_order_relaxed);
+	options->strategy.store(strategy, std::memory_order_relaxed);
+	return TRUE;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_GetZLibOptions(FREE_IMAGE_FORMAT fif, int *level, FREE_IMAGE_ZSTRATEGY *strategy) {
+	const ZLibOptions *options = FindZLibOptions(fif);
+	if (!options) {
+		return FALSE;
+	}
+	if (level) {
+		*level = options->level.load(std::memory_order_relaxed);
+	}
+	if (strategy) {
+		*strategy = (FREE_IMAGE_ZSTRATEGY)options->strategy.load(std::memory_order_relaxed);
+	}
+	return TRUE;
 }
@@ -6,6 +6,7 @@
 
 #include "FreeImage.h"
 #include "SimpleTools.h"
+#include "Utilities.h"
 #include <algorithm>
 #include <memory>
 #include <limits>
@@ -24,6 +25,7 @@ FIBITMAP* FreeImage_TmoClamp(FIBITMAP* src, double max_value)
     uint32_t dstBpp = 32;
     switch (imageType) {
     case FIT_RGBAF:
+    case FIT_RGBAH:
     case FIT_RGBA32:
     case FIT_RGBA16:
         dstBpp = 32;
@@ -46,6 +48,7 @@ FIBITMAP* FreeImage_TmoClamp(FIBITMAP* src, double max_value)
     if (max_value <= 0.0) {
         switch (imageType) {
         case FIT_RGBAF:
+        case FIT_RGBAH:
         case FIT_RGBF:
         case FIT_DOUBLE:
         case FIT_FLOAT:
@@ -87,6 +90,11 @@ FIBITMAP* FreeImage_TmoClamp(FIBITMAP* src, double max_value)
             return FIRGBA8{ ClampFloat(p.red), ClampFloat(p.green), ClampFloat(p.blue), ClampFloat(p.alpha) };
         });
         break;
+    case FIT_RGBAH:
+        BitmapTransform<FIRGBA8, FIRGBAH>(dst.get(), src, [&](const FIRGBAH& p) {
+            return FIRGBA8{ ClampFloat(HalfToFloat(p.red)), ClampFloat(HalfToFloat(p.green)), ClampFloat(HalfToFloat(p.blue)), ClampFloat(HalfToFloat(p.alpha)) };
+        });
+        break;
     case FIT_RGBF:
         BitmapTransform<FIRGB8, FIRGBF>(dst.get(), src, [&](const FIRGBF& p) {
             return FIRGB8{ ClampFloat(p.red), ClampFloat(p.green), ClampFloat(p.blue) };
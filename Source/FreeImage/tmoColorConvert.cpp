@@ -23,6 +23,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "CPUDispatch.h"
 #include <algorithm>
 
 // ----------------------------------------------------------
@@ -123,6 +124,356 @@ static const float XYZ2RGB[3][3] = {
 static const float EPSILON = 1e-06F;
 static const float INF = 1e+10F;
 
+// ----------------------------------------------------------
+//  SIMD row kernels
+// ----------------------------------------------------------
+
+// Kernels split groups of pixels into one register per channel, run the operations of the scalar code in the same
+// order, and return the number of pixels they processed. Results are bit exact with the scalar code where the
+// compiler does not fuse its multiply-adds.
+
+namespace {
+
+	using YxyRowKernel = unsigned (*)(FIRGBF *target, const FIRGBF *source, unsigned width);
+	using RGBFRowKernel = unsigned (*)(FIRGBF *pixel, unsigned width);
+	using LuminanceRowKernel = unsigned (*)(float *target, const FIRGBF *source, unsigned width);
+	using ClampRowKernel = unsigned (*)(uint8_t *target, const FIRGBF *source, unsigned width);
+
+#if FREEIMAGE_SIMD_X86
+
+	/// Splits 4 pixels of 3 floats, loaded in v0, v1, v2, into one register per channel
+	inline void Deinterleave3_SSE2(__m128 v0, __m128 v1, __m128 v2, __m128 &a, __m128 &b, __m128 &c) {
+		// v0 = a0 b0 c0 a1, v1 = b1 c1 a2 b2, v2 = c2 a3 b3 c3
+		const __m128 high = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 1, 3, 2));	// a2 b2 a3 b3
+		const __m128 low = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 0, 2, 1));	// b0 c0 b1 c1
+		a = _mm_shuffle_ps(v0, high, _MM_SHUFFLE(2, 0, 3, 0));
+		b = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 2, 0));
+		c = _mm_shuffle_ps(low, v2, _MM_SHUFFLE(3, 0, 3, 1));
+	}
+
+	/// Merges one register per channel into 4 pixels of 3 floats a, b, c
+	inline void Interleave3_SSE2(__m128 a, __m128 b, __m128 c, __m128 &v0, __m128 &v1, __m128 &v2) {
+		v0 = _mm_shuffle_ps(_mm_unpacklo_ps(a, b), _mm_shuffle_ps(c, a, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0));
+		v1 = _mm_shuffle_ps(_mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 2, 1)), _mm_unpackhi_ps(a, b), _MM_SHUFFLE(1, 0, 2, 0));
+		v2 = _mm_shuffle_ps(_mm_shuffle_ps(c, a, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	}
+
+	inline void Load3_SSE2(const FIRGBF *source, __m128 &r, __m128 &g, __m128 &b) {
+		const float *p = &source->red;
+		Deinterleave3_SSE2(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _mm_loadu_ps(p + 8), r, g, b);
+	}
+
+	inline void Store3_SSE2(FIRGBF *target, __m128 r, __m128 g, __m128 b) {
+		__m128 v0, v1, v2;
+		Interleave3_SSE2(r, g, b, v0, v1, v2);
+		float *p = &target->red;
+		_mm_storeu_ps(p, v0);
+		_mm_storeu_ps(p + 4, v1);
+		_mm_storeu_ps(p + 8, v2);
+	}
+
+	/// 0 + m[0] * a + m[1] * b + m[2] * c, as the scalar code
+	inline __m128 Dot3_SSE2(const float m[3], __m128 a, __m128 b, __m128 c) {
+		__m128 v = _mm_add_ps(_mm_setzero_ps(), _mm_mul_ps(_mm_set1_ps(m[0]), a));
+		v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(m[1]), b));
+		return _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(m[2]), c));
+	}
+
+	/// See ConvertRowRGBFToYxy
+	unsigned RGBFToYxyRow_SSE2(FIRGBF *target, const FIRGBF *source, unsigned width) {
+		unsigned x = 0;
+		for (; x + 4 <= width; x += 4) {
+			__m128 r, g, b;
+			Load3_SSE2(source + x, r, g, b);
+			const __m128 X = Dot3_SSE2(RGB2XYZ[0], r, g, b);
+			const __m128 Y = Dot3_SSE2(RGB2XYZ[1], r, g, b);
+			const __m128 Z = Dot3_SSE2(RGB2XYZ[2], r, g, b);
+			const __m128 W = _mm_add_ps(_mm_add_ps(X, Y), Z);
+			const __m128 positive = _mm_cmpgt_ps(W, _mm_setzero_ps());
+			Store3_SSE2(target + x, _mm_and_ps(positive, Y), _mm_and_ps(positive, _mm_div_ps(X, W)), _mm_and_ps(positive, _mm_div_ps(Y, W)));
+		}
+		return x;
+	}
+
+	/// See ConvertRowYxyToRGBF
+	unsigned YxyToRGBFRow_SSE2(FIRGBF *pixel, unsigned width) {
+		const __m128 epsilon = _mm_set1_ps(EPSILON);
+		unsigned i = 0;
+		for (; i + 4 <= width; i += 4) {
+			__m128 Y, x, y;
+			Load3_SSE2(pixel + i, Y, x, y);
+			const __m128 valid = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(Y, epsilon), _mm_cmpgt_ps(x, epsilon)), _mm_cmpgt_ps(y, epsilon));
+			__m128 X = _mm_div_ps(_mm_mul_ps(x, Y), y);
+			__m128 Z = _mm_sub_ps(_mm_sub_ps(_mm_div_ps(X, x), X), Y);
+			X = _mm_or_ps(_mm_and_ps(valid, X), _mm_andnot_ps(valid, epsilon));
+			Z = _mm_or_ps(_mm_and_ps(valid, Z), _mm_andnot_ps(valid, epsilon));
+			Store3_SSE2(pixel + i, Dot3_SSE2(XYZ2RGB[0], X, Y, Z), Dot3_SSE2(XYZ2RGB[1], X, Y, Z), Dot3_SSE2(XYZ2RGB[2], X, Y, Z));
+		}
+		return i;
+	}
+
+	/// See ConvertRowRGBFToY
+	unsigned RGBFToYRow_SSE2(float *target, const FIRGBF *source, unsigned width) {
+		unsigned x = 0;
+		for (; x + 4 <= width; x += 4) {
+			__m128 r, g, b;
+			Load3_SSE2(source + x, r, g, b);
+			const __m128 L = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.2126F), r), _mm_mul_ps(_mm_set1_ps(0.7152F), g)), _mm_mul_ps(_mm_set1_ps(0.0722F), b));
+			// maxps returns the second operand for NaNs
+			_mm_storeu_ps(target + x, _mm_max_ps(L, _mm_setzero_ps()));
+		}
+		return x;
+	}
+
+	/// (uint8_t)(255 * clamp(v) + 0.5) of 4 values, NaN gives 0
+	inline __m128i ClampToInt_SSE2(__m128 v) {
+		v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0F));
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(255.0F), v), _mm_set1_ps(0.5F)));
+	}
+
+	/// See ClampConvertRowRGBFTo24
+	unsigned ClampRowTo24_SSE2(uint8_t *target, const FIRGBF *source, unsigned width) {
+		unsigned x = 0;
+		for (; x + 8 <= width; x += 8) {
+			__m128i words[3];
+			for (int k = 0; k < 2; k++) {
+				__m128 channels[3], v[3];
+				Load3_SSE2(source + x + 4 * k, channels[FI_RGBA_RED], channels[FI_RGBA_GREEN], channels[FI_RGBA_BLUE]);
+				Interleave3_SSE2(channels[0], channels[1], channels[2], v[0], v[1], v[2]);
+				// 8 pixels are 24 values, packed into 3 registers of 16-bit words
+				const __m128i i0 = ClampToInt_SSE2(v[0]);
+				const __m128i i1 = ClampToInt_SSE2(v[1]);
+				const __m128i i2 = ClampToInt_SSE2(v[2]);
+				if (k == 0) {
+					words[0] = _mm_packs_epi32(i0, i1);
+					words[1] = i2;
+				} else {
+					words[1] = _mm_packs_epi32(words[1], i0);
+					words[2] = _mm_packs_epi32(i1, i2);
+				}
+			}
+			uint8_t *p = target + 3 * x;
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm_packus_epi16(words[0], words[1]));
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(p + 16), _mm_packus_epi16(words[2], words[2]));
+		}
+		return x;
+	}
+
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+
+	/// See RGBFToYRow_SSE2
+	unsigned RGBFToYRow_NEON(float *target, const FIRGBF *source, unsigned width) {
+		const float32x4_t zero = vdupq_n_f32(0);
+		unsigned x = 0;
+		for (; x + 4 <= width; x += 4) {
+			const float32x4x3_t rgb = vld3q_f32(&source[x].red);
+			const float32x4_t L = vaddq_f32(vaddq_f32(vmulq_f32(vdupq_n_f32(0.2126F), rgb.val[0]), vmulq_f32(vdupq_n_f32(0.7152F), rgb.val[1])), vmulq_f32(vdupq_n_f32(0.0722F), rgb.val[2]));
+			vst1q_f32(target + x, vbslq_f32(vcgtq_f32(L, zero), L, zero));
+		}
+		return x;
+	}
+
+	/// See ClampToInt_SSE2
+	inline uint32x4_t ClampToInt_NEON(float32x4_t v) {
+		const float32x4_t zero = vdupq_n_f32(0);
+		v = vminq_f32(vbslq_f32(vcgtq_f32(v, zero), v, zero), vdupq_n_f32(1.0F));
+		return vcvtq_u32_f32(vaddq_f32(vmulq_f32(vdupq_n_f32(255.0F), v), vdupq_n_f32(0.5F)));
+	}
+
+	/// See ClampConvertRowRGBFTo24
+	unsigned ClampRowTo24_NEON(uint8_t *target, const FIRGBF *source, unsigned width) {
+		unsigned x = 0;
+		for (; x + 8 <= width; x += 8) {
+			const float32x4x3_t low = vld3q_f32(&source[x].red);
+			const float32x4x3_t high = vld3q_f32(&source[x + 4].red);
+			uint8x8_t channels[3];
+			for (int c = 0; c < 3; c++) {
+				channels[c] = vmovn_u16(vcombine_u16(vmovn_u32(ClampToInt_NEON(low.val[c])), vmovn_u32(ClampToInt_NEON(high.val[c]))));
+			}
+			uint8x8x3_t bgr;
+			bgr.val[FI_RGBA_RED] = channels[0];
+			bgr.val[FI_RGBA_GREEN] = channels[1];
+			bgr.val[FI_RGBA_BLUE] = channels[2];
+			vst3_u8(target + 3 * x, bgr);
+		}
+		return x;
+	}
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+
+	// float division is part of ARMv8 NEON
+
+	/// See Dot3_SSE2
+	inline float32x4_t Dot3_NEON(const float m[3], float32x4_t a, float32x4_t b, float32x4_t c) {
+		float32x4_t v = vaddq_f32(vdupq_n_f32(0), vmulq_f32(vdupq_n_f32(m[0]), a));
+		v = vaddq_f32(v, vmulq_f32(vdupq_n_f32(m[1]), b));
+		return vaddq_f32(v, vmulq_f32(vdupq_n_f32(m[2]), c));
+	}
+
+	inline float32x4_t And_NEON(uint32x4_t mask, float32x4_t v) {
+		return vreinterpretq_f32_u32(vandq_u32(mask, vreinterpretq_u32_f32(v)));
+	}
+
+	/// See RGBFToYxyRow_SSE2
+	unsigned RGBFToYxyRow_NEON(FIRGBF *target, const FIRGBF *source, unsigned width) {
+		unsigned x = 0;
+		for (; x + 4 <= width; x += 4) {
+			const float32x4x3_t rgb = vld3q_f32(&source[x].red);
+			const float32x4_t X = Dot3_NEON(RGB2XYZ[0], rgb.val[0], rgb.val[1], rgb.val[2]);
+			const float32x4_t Y = Dot3_NEON(RGB2XYZ[1], rgb.val[0], rgb.val[1], rgb.val[2]);
+			const float32x4_t Z = Dot3_NEON(RGB2XYZ[2], rgb.val[0], rgb.val[1], rgb.val[2]);
+			const float32x4_t W = vaddq_f32(vaddq_f32(X, Y), Z);
+			const uint32x4_t positive = vcgtq_f32(W, vdupq_n_f32(0));
+			float32x4x3_t Yxy;
+			Yxy.val[0] = And_NEON(positive, Y);
+			Yxy.val[1] = And_NEON(positive, vdivq_f32(X, W));
+			Yxy.val[2] = And_NEON(positive, vdivq_f32(Y, W));
+			vst3q_f32(&target[x].red, Yxy);
+		}
+		return x;
+	}
+
+	/// See YxyToRGBFRow_SSE2
+	unsigned YxyToRGBFRow_NEON(FIRGBF *pixel, unsigned width) {
+		const float32x4_t epsilon = vdupq_n_f32(EPSILON);
+		unsigned i = 0;
+		for (; i + 4 <= width; i += 4) {
+			const float32x4x3_t Yxy = vld3q_f32(&pixel[i].red);
+			const float32x4_t Y = Yxy.val[0], x = Yxy.val[1], y = Yxy.val[2];
+			const uint32x4_t valid = vandq_u32(vandq_u32(vcgtq_f32(Y, epsilon), vcgtq_f32(x, epsilon)), vcgtq_f32(y, epsilon));
+			float32x4_t X = vdivq_f32(vmulq_f32(x, Y), y);
+			float32x4_t Z = vsubq_f32(vsubq_f32(vdivq_f32(X, x), X), Y);
+			X = vbslq_f32(valid, X, epsilon);
+			Z = vbslq_f32(valid, Z, epsilon);
+			float32x4x3_t rgb;
+			rgb.val[0] = Dot3_NEON(XYZ2RGB[0], X, Y, Z);
+			rgb.val[1] = Dot3_NEON(XYZ2RGB[1], X, Y, Z);
+			rgb.val[2] = Dot3_NEON(XYZ2RGB[2], X, Y, Z);
+			vst3q_f32(&pixel[i].red, rgb);
+		}
+		return i;
+	}
+
+#endif // __aarch64__
+
+#endif // FREEIMAGE_SIMD_NEON
+
+	std::atomic<YxyRowKernel> gRGBFToYxyRow{ nullptr };
+	std::atomic<RGBFRowKernel> gYxyToRGBFRow{ nullptr };
+	std::atomic<LuminanceRowKernel> gRGBFToYRow{ nullptr };
+	std::atomic<ClampRowKernel> gClampRowTo24{ nullptr };
+
+	void SelectColorConvertKernels(uint32_t features) {
+		YxyRowKernel toYxy = nullptr;
+		RGBFRowKernel toRGBF = nullptr;
+		LuminanceRowKernel toY = nullptr;
+		ClampRowKernel clamp = nullptr;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			toYxy = RGBFToYxyRow_SSE2;
+			toRGBF = YxyToRGBFRow_SSE2;
+			toY = RGBFToYRow_SSE2;
+			clamp = ClampRowTo24_SSE2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			toY = RGBFToYRow_NEON;
+			clamp = ClampRowTo24_NEON;
+#if defined(__aarch64__) || defined(_M_ARM64)
+			toYxy = RGBFToYxyRow_NEON;
+			toRGBF = YxyToRGBFRow_NEON;
+#endif
+		}
+#endif
+		gRGBFToYxyRow.store(toYxy, std::memory_order_relaxed);
+		gYxyToRGBFRow.store(toRGBF, std::memory_order_relaxed);
+		gRGBFToYRow.store(toY, std::memory_order_relaxed);
+		gClampRowTo24.store(clamp, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectColorConvertKernels);
+
+} // namespace
+
+// ----------------------------------------------------------
+
+/**
+Convert a row of floating point RGB data to Yxy, target may be source.<br>
+On output, pixel->red == Y, pixel->green == x, pixel->blue == y
+*/
+void 
+ConvertRowRGBFToYxy(FIRGBF *target, const FIRGBF *source, unsigned width) {
+	float result[3];
+
+	const YxyRowKernel kernel = gRGBFToYxyRow.load(std::memory_order_relaxed);
+	for (unsigned x = kernel ? kernel(target, source, width) : 0; x < width; x++) {
+		const float red = source[x].red, green = source[x].green, blue = source[x].blue;
+		for (int i = 0; i < 3; i++) {
+			result[i] = 0;
+			result[i] += RGB2XYZ[i][0] * red;
+			result[i] += RGB2XYZ[i][1] * green;
+			result[i] += RGB2XYZ[i][2] * blue;
+		}
+		const float W = result[0] + result[1] + result[2];
+		const float Y = result[1];
+		if (W > 0) { 
+			target[x].red   = Y;			    // Y 
+			target[x].green = result[0] / W;	// x 
+			target[x].blue  = result[1] / W;	// y 	
+		} else {
+			target[x].red = target[x].green = target[x].blue = 0;
+		}
+	}
+}
+
+/**
+Copy the RGB to XYZ and XYZ to RGB matrices used by the Yxy conversions
+*/
+void 
+GetYxyMatrices(float rgb_to_xyz[3][3], float xyz_to_rgb[3][3]) {
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			rgb_to_xyz[i][j] = RGB2XYZ[i][j];
+			xyz_to_rgb[i][j] = XYZ2RGB[i][j];
+		}
+	}
+}
+
+/**
+Convert in-place a row of Yxy data to floating point RGB data.<br>
+On input, pixel->red == Y, pixel->green == x, pixel->blue == y
+*/
+void 
+ConvertRowYxyToRGBF(FIRGBF *pixel, unsigned width) {
+	float result[3];
+	float X, Y, Z;
+
+	const RGBFRowKernel kernel = gYxyToRGBFRow.load(std::memory_order_relaxed);
+	for (unsigned x = kernel ? kernel(pixel, width) : 0; x < width; x++) {
+		Y = pixel[x].red;	        // Y 
+		result[1] = pixel[x].green;	// x 
+		result[2] = pixel[x].blue;	// y 
+		if ((Y > EPSILON) && (result[1] > EPSILON) && (result[2] > EPSILON)) {
+			X = (result[1] * Y) / result[2];
+			Z = (X / result[1]) - X - Y;
+		} else {
+			X = Z = EPSILON;
+		}
+		for (int i = 0; i < 3; i++) {
+			result[i] = 0;
+			result[i] += XYZ2RGB[i][0] * X;
+			result[i] += XYZ2RGB[i][1] * Y;
+			result[i] += XYZ2RGB[i][2] * Z;
+		}
+		pixel[x].red   = result[0];	// R
+		pixel[x].green = result[1];	// G
+		pixel[x].blue  = result[2];	// B
+	}
+}
+
 /**
 Convert in-place floating point RGB data to Yxy.<br>
 On output, pixel->red == Y, pixel->green == x, pixel->blue == y
@@ -131,8 +482,6 @@ On output, pixel->red == Y, pixel->green == x, pixel->blue == y
 */
 FIBOOL 
 ConvertInPlaceRGBFToYxy(FIBITMAP *dib) {
-	float result[3];
-
 	if (FreeImage_GetImageType(dib) != FIT_RGBF)
 		return FALSE;
 
@@ -141,28 +490,12 @@ ConvertInPlaceRGBFToYxy(FIBITMAP *dib) {
 	const unsigned pitch  = FreeImage_GetPitch(dib);
 	
 	auto *bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (unsigned y = 0; y < height; y++) {
-		auto *pixel = (FIRGBF*)bits;
-		for (unsigned x = 0; x < width; x++) {
-			result[0] = result[1] = result[2] = 0;
-			for (int i = 0; i < 3; i++) {
-				result[i] += RGB2XYZ[i][0] * pixel[x].red;
-				result[i] += RGB2XYZ[i][1] * pixel[x].green;
-				result[i] += RGB2XYZ[i][2] * pixel[x].blue;
-			}
-			const float W = result[0] + result[1] + result[2];
-			const float Y = result[1];
-			if (W > 0) { 
-				pixel[x].red   = Y;			    // Y 
-				pixel[x].green = result[0] / W;	// x 
-				pixel[x].blue  = result[1] / W;	// y 	
-			} else {
-				pixel[x].red = pixel[x].green = pixel[x].blue = 0;
-			}
+	ParallelFor(0, height, CalculateBandRows(pitch), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			auto *pixel = (FIRGBF*)(bits + (size_t)pitch * y);
+			ConvertRowRGBFToYxy(pixel, pixel, width);
 		}
-		// next line
-		bits += pitch;
-	}
+	});
 
 	return TRUE;
 }
@@ -175,9 +508,6 @@ On input, pixel->red == Y, pixel->green == x, pixel->blue == y
 */
 FIBOOL 
 ConvertInPlaceYxyToRGBF(FIBITMAP *dib) {
-	float result[3];
-	float X, Y, Z;
-
 	if (FreeImage_GetImageType(dib) != FIT_RGBF)
 		return FALSE;
 
@@ -186,34 +516,11 @@ ConvertInPlaceYxyToRGBF(FIBITMAP *dib) {
 	const unsigned pitch  = FreeImage_GetPitch(dib);
 
 	auto *bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (unsigned y = 0; y < height; y++) {
-		auto *pixel = (FIRGBF*)bits;
-		for (unsigned x = 0; x < width; x++) {
-			Y = pixel[x].red;	        // Y 
-			result[1] = pixel[x].green;	// x 
-			result[2] = pixel[x].blue;	// y 
-			if ((Y > EPSILON) && (result[1] > EPSILON) && (result[2] > EPSILON)) {
-				X = (result[1] * Y) / result[2];
-				Z = (X / result[1]) - X - Y;
-			} else {
-				X = Z = EPSILON;
-			}
-			pixel[x].red   = X;
-			pixel[x].green = Y;
-			pixel[x].blue  = Z;
-			result[0] = result[1] = result[2] = 0;
-			for (int i = 0; i < 3; i++) {
-				result[i] += XYZ2RGB[i][0] * pixel[x].red;
-				result[i] += XYZ2RGB[i][1] * pixel[x].green;
-				result[i] += XYZ2RGB[i][2] * pixel[x].blue;
-			}
-			pixel[x].red   = result[0];	// R
-			pixel[x].green = result[1];	// G
-			pixel[x].blue  = result[2];	// B
+	ParallelFor(0, height, CalculateBandRows(pitch), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			ConvertRowYxyToRGBF((FIRGBF*)(bits + (size_t)pitch * y), width);
 		}
-		// next line
-		bits += pitch;
-	}
+	});
 
 	return TRUE;
 }
@@ -263,6 +570,33 @@ LuminanceFromYxy(FIBITMAP *Yxy, float *maxLum, float *minLum, float *worldLum) {
 	return TRUE;
 }
 
+/// Clamps to [0..1], NaN gives 0
+static inline float 
+Clamp01(const float value) {
+	return (value > 0) ? ((value < 1) ? value : 1) : 0;
+}
+
+/**
+Clamp a row of RGBF values to [0..1], highest values to display white, 
+then convert to 24-bit RGB
+*/
+void 
+ClampConvertRowRGBFTo24(uint8_t *target, const FIRGBF *source, unsigned width) {
+	const ClampRowKernel kernel = gClampRowTo24.load(std::memory_order_relaxed);
+	const unsigned first = kernel ? kernel(target, source, width) : 0;
+	target += 3 * first;
+	for (unsigned x = first; x < width; x++) {
+		const float red   = Clamp01(source[x].red);
+		const float green = Clamp01(source[x].green);
+		const float blue  = Clamp01(source[x].blue);
+		
+		target[FI_RGBA_RED]   = (uint8_t)(255.0F * red   + 0.5F);
+		target[FI_RGBA_GREEN] = (uint8_t)(255.0F * green + 0.5F);
+		target[FI_RGBA_BLUE]  = (uint8_t)(255.0F * blue  + 0.5F);
+		target += 3;
+	}
+}
+
 /**
 Clamp RGBF image highest values to display white, 
 then convert to 24-bit RGB
@@ -281,29 +615,31 @@ ClampConvertRGBFTo24(FIBITMAP *src) {
 	const unsigned src_pitch  = FreeImage_GetPitch(src);
 	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
 
-	auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
+	auto *src_bits = FreeImage_GetConstBits(src);
 	auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
 
-	for (unsigned y = 0; y < height; y++) {
-		auto *src_pixel = (const FIRGBF*)src_bits;
-		auto *dst_pixel = dst_bits;
-		for (unsigned x = 0; x < width; x++) {
-			const float red   = (src_pixel[x].red > 1)   ? 1 : src_pixel[x].red;
-			const float green = (src_pixel[x].green > 1) ? 1 : src_pixel[x].green;
-			const float blue  = (src_pixel[x].blue > 1)  ? 1 : src_pixel[x].blue;
-			
-			dst_pixel[FI_RGBA_RED]   = (uint8_t)(255.0F * red   + 0.5F);
-			dst_pixel[FI_RGBA_GREEN] = (uint8_t)(255.0F * green + 0.5F);
-			dst_pixel[FI_RGBA_BLUE]  = (uint8_t)(255.0F * blue  + 0.5F);
-			dst_pixel += 3;
+	ParallelFor(0, height, CalculateBandRows(src_pitch), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			ClampConvertRowRGBFTo24(dst_bits + (size_t)dst_pitch * y, (const FIRGBF*)(src_bits + (size_t)src_pitch * y), width);
 		}
-		src_bits += src_pitch;
-		dst_bits += dst_pitch;
-	}
+	});
 
 	return dst;
 }
 
+/**
+Extract the luminance of a row of RGBF pixels, negative values are set to 0
+@see ConvertRGBFToY
+*/
+void 
+ConvertRowRGBFToY(float *target, const FIRGBF *source, unsigned width) {
+	const LuminanceRowKernel kernel = gRGBFToYRow.load(std::memory_order_relaxed);
+	for (unsigned x = kernel ? kernel(target, source, width) : 0; x < width; x++) {
+		const float L = LUMA_REC709(source[x].red, source[x].green, source[x].blue);
+		target[x] = (L > 0) ? L : 0;
+	}
+}
+
 /**
 Extract the luminance channel L from a RGBF image. 
 Luminance is calculated from the sRGB model (RGB2XYZ matrix) 
@@ -327,21 +663,14 @@ ConvertRGBFToY(FIBITMAP *src) {
 	const unsigned src_pitch  = FreeImage_GetPitch(src);
 	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
 
-	
-	auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
+	auto *src_bits = FreeImage_GetConstBits(src);
 	auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
 
-	for (unsigned y = 0; y < height; y++) {
-		auto *src_pixel = (const FIRGBF*)src_bits;
-		auto *dst_pixel = (float*)dst_bits;
-		for (unsigned x = 0; x < width; x++) {
-			const float L = LUMA_REC709(src_pixel[x].red, src_pixel[x].green, src_pixel[x].blue);
-			dst_pixel[x] = (L > 0) ? L : 0;
+	ParallelFor(0, height, CalculateBandRows(src_pitch), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			ConvertRowRGBFToY((float*)(dst_bits + (size_t)dst_pitch * y), (const FIRGBF*)(src_bits + (size_t)src_pitch * y), width);
 		}
-		// next line
-		src_bits += src_pitch;
-		dst_bits += dst_pitch;
-	}
+	});
 
 	return dst;
 }
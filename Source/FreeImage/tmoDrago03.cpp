@@ -22,6 +22,10 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "ConversionSIMD.h"
+#include "ComputeBackend.h"
+
+#include <vector>
 
 // ----------------------------------------------------------
 // Logarithmic mapping operator
@@ -31,187 +35,62 @@
 // Eurographics 2003.
 // ----------------------------------------------------------
 
-/**
-Bias function
-*/
-static inline double 
-biasFunction(const double b, const double x) {
-	return pow (x, b);		// pow(x, log(bias)/log(0.5)
-}
+static const float LN2 = 0.693147181F;
 
 /**
 Pad approximation of log(x + 1)
 x(6+x)/(6+4x) good if x < 1
 x*(6 + 0.7662x)/(5.9897 + 3.7658x) between 1 and 2
 See http://www.nezumi.demon.co.uk/consult/logx.htm
+@param log_x1 log(x + 1), used when x >= 2
 */
-static inline double 
-pade_log(const double x) {
+static inline float 
+pade_log(const float x, const float log_x1) {
 	if (x < 1) {
 		return (x * (6 + x) / (6 + 4 * x));
 	} else if (x < 2) {
-		return (x * (6 + 0.7662 * x) / (5.9897 + 3.7658 * x));
+		return (x * (6 + 0.7662F * x) / (5.9897F + 3.7658F * x));
 	}
-	return log(x + 1);
+	return log_x1;
 }
 
 /**
-Log mapping operator
-@param dib Input / Output Yxy image
-@param maxLum Maximum luminance
-@param avgLum Average luminance (world adaptation luminance)
-@param biasParam Bias parameter (a zero value default to 0.85)
-@param exposure Exposure parameter (default to 0)
-@return Returns TRUE if successful, returns FALSE otherwise
+Log mapping operator of a row, in place
+@param Y Input / Output luminance values
+@param Yw Scratch buffer of width values
+@param logs Scratch buffer of width values
+@param width Number of values
+@param params Operator parameters
 */
-static FIBOOL 
-ToneMappingDrago03(FIBITMAP *dib, const float maxLum, const float avgLum, float biasParam, const float exposure) {
-	const float LOG05 = -0.693147F;	// log(0.5) 
-
-	double Lmax, divider, interpol, biasP;
-	unsigned x, y;
-	double L;
-
-	if (FreeImage_GetImageType(dib) != FIT_RGBF)
-		return FALSE;
-
-	const unsigned width  = FreeImage_GetWidth(dib);
-	const unsigned height = FreeImage_GetHeight(dib);
-	const unsigned pitch  = FreeImage_GetPitch(dib);
-
-
-	// arbitrary Bias Parameter 
-	if (biasParam == 0) 
-		biasParam = 0.85F;
-
-	// normalize maximum luminance by average luminance
-	Lmax = maxLum / avgLum;
-	
-	divider = log10(Lmax+1);
-	biasP = log(biasParam)/LOG05;
-
-#if !defined(DRAGO03_FAST)
-
-	/**
-	Normal tone mapping of every pixel
-	further acceleration is obtained by a Pad approximation of log(x + 1)
-	*/
-	auto *bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (y = 0; y < height; y++) {
-		auto *pixel = (FIRGBF*)bits;
-		for (x = 0; x < width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
-		}
-		// next line
-		bits += pitch;
+static void 
+ToneMappingDrago03(float *Y, float *Yw, float *logs, unsigned width, const Drago03Params &params) {
+	// world luminance, then bias function pow(Yw / Lmax, biasP)
+	for (unsigned x = 0; x < width; x++) {
+		Yw[x] = (Y[x] / params.avgLum) * params.exposure;
+		logs[x] = Yw[x] / params.Lmax;
 	}
-
-#else
-	unsigned index;
-	int i, j;
-
-	unsigned max_width  = width - (width % 3);
-	unsigned max_height = height - (height % 3); 
-	unsigned fpitch = pitch / sizeof(FIRGBF);
-
-	/**
-	fast tone mapping
-	split the image into 3x3 pixel tiles and perform the computation for each group of 9 pixels
-	further acceleration is obtained by a Pad approximation of log(x + 1)
-	=> produce artifacts and not so faster, so the code has been disabled
-	*/
-#define PIXEL(x, y)	image[y*fpitch + x].red
-
-	FIRGBF *image = (FIRGBF*)FreeImage_GetBits(dib);
-	for (y = 0; y < max_height; y += 3) {
-		for (x = 0; x < max_width; x += 3) {
-			double average = 0;
-			for (i = 0; i < 3; i++) {
-				for (j = 0; j < 3; j++) {
-					index = (y + i)*fpitch + (x + j);
-					image[index].red /= (float)avgLum;
-					image[index].red *= exposure; 
-					average += image[index].red;
-				}
-			}
-			average = average / 9 - PIXEL(x, y);
-			if (average > -1 && average < 1) {
-				interpol = log(2 + pow(PIXEL(x + 1, y + 1) / Lmax, biasP) * 8);
-				for (i = 0; i < 3; i++) {
-					for (j = 0; j < 3; j++) {
-						index = (y + i)*fpitch + (x + j);
-						L = pade_log(image[index].red);// log(image[index].red + 1)
-						image[index].red = (float)((L / interpol) / divider);
-					}
-				}
-			}
-			else {
-				for (i = 0; i < 3; i++) {
-					for (j = 0; j < 3; j++) {
-						index = (y + i)*fpitch + (x + j);
-						interpol = log(2 + pow(image[index].red / Lmax, biasP) * 8);
-						L = pade_log(image[index].red);// log(image[index].red + 1)
-						image[index].red = (float)((L / interpol) / divider);
-					}
-				}
-			}
-		} //x
-	} // y
-
-	/**
-	Normal tone mapping of every pixel for the remaining right and bottom bands
-	*/
-	uint8_t *bits;
-
-	// right band
-	bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (y = 0; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for (x = max_width; x < width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
-		}
-		// next line
-		bits += pitch;
+	PowFloats(logs, logs, width, params.biasP);
+	// interpolation log(2 + 8 * bias) in Y, log(Yw + 1) in logs
+	for (unsigned x = 0; x < width; x++) {
+		Y[x] = 2 + logs[x] * 8;
+		logs[x] = Yw[x] + 1;
 	}
-	// bottom band
-	bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (y = max_height; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for (x = 0; x < max_width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
-		}
-		// next line
-		bits += pitch;
+	Log2Floats(Y, Y, width);
+	Log2Floats(logs, logs, width);
+	for (unsigned x = 0; x < width; x++) {
+		const float interpol = Y[x] * LN2;
+		const float L = pade_log(Yw[x], logs[x] * LN2);// log(Yw + 1)
+		Y[x] = (L / interpol) / params.divider;
 	}
-
-#endif	// DRAGO03_FAST
-
-	return TRUE;
 }
 
 /**
-Custom gamma correction based on the ITU-R BT.709 standard
-@param dib RGBF image to be corrected
-@param gammaval Gamma value (2.2 is a good default value)
-@return Returns TRUE if successful, returns FALSE otherwise
+Parameters of the custom gamma correction based on the ITU-R BT.709 standard
+@param params Operator parameters, gamma (2.2 is a good default value) is read, the curve is written
 */
-static FIBOOL 
-REC709GammaCorrection(FIBITMAP *dib, const float gammaval) {
-	if (FreeImage_GetImageType(dib) != FIT_RGBF)
-		return FALSE;
-
+static void 
+REC709GammaParams(Drago03Params &params) {
+	const float gammaval = params.gamma;
 	float slope = 4.5F;
 	float start = 0.018F;
 	
@@ -223,24 +102,24 @@ REC709GammaCorrection(FIBITMAP *dib, const float gammaval) {
 		start = (float)(0.018 * ((2 - gammaval) * 7.5));
 		slope = (float)(4.5 / ((2 - gammaval) * 7.5));
 	}
+	params.gammaStart = start;
+	params.gammaSlope = slope;
+	params.gammaExponent = fgamma;
+}
 
-	const unsigned width  = FreeImage_GetWidth(dib);
-	const unsigned height = FreeImage_GetHeight(dib);
-	const unsigned pitch  = FreeImage_GetPitch(dib);
-
-	auto *bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (unsigned y = 0; y < height; y++) {
-		auto *pixel = (float*)bits;
-		for (unsigned x = 0; x < width; x++) {
-			for (int i = 0; i < 3; i++) {
-				*pixel = (*pixel <= start) ? *pixel * slope : (1.099F * pow(*pixel, fgamma) - 0.099F);
-				pixel++;
-			}
-		}
-		bits += pitch;
+/**
+Custom gamma correction based on the ITU-R BT.709 standard
+@param data Input / Output values
+@param curve Scratch buffer of count values
+@param count Number of values
+@param params Operator parameters (see REC709GammaParams)
+*/
+static void 
+REC709GammaCorrection(float *data, float *curve, unsigned count, const Drago03Params &params) {
+	PowFloats(curve, data, count, params.gammaExponent);
+	for (unsigned i = 0; i < count; i++) {
+		data[i] = (data[i] <= params.gammaStart) ? data[i] * params.gammaSlope : (1.099F * curve[i] - 0.099F);
 	}
-
-	return TRUE;
 }
 
 // ----------------------------------------------------------
@@ -248,7 +127,10 @@ REC709GammaCorrection(FIBITMAP *dib, const float gammaval) {
 // ----------------------------------------------------------
 
 /**
-Apply the Adaptive Logarithmic Mapping operator to a HDR image and convert to 24-bit RGB
+Apply the Adaptive Logarithmic Mapping operator to a HDR image and convert to 24-bit RGB.<br>
+The image is read twice by parallel bands: a first pass gets the maximum and log average luminance,
+a second pass converts each row to Yxy, maps the luminance, converts back to RGB, applies the gamma correction
+and writes the 24-bit pixels.
 @param src Input RGB16 or RGB[A]F image
 @param gamma Gamma correction (gamma > 0). 1 means no correction, 2.2 in the original paper.
 @param exposure Exposure parameter (0 means no correction, 0 in the original paper)
@@ -256,35 +138,111 @@ Apply the Adaptive Logarithmic Mapping operator to a HDR image and convert to 24
 */
 FIBITMAP* DLL_CALLCONV 
 FreeImage_TmoDrago03(FIBITMAP *src, double gamma, double exposure) {
-	float maxLum, minLum, avgLum;
-
 	if (!FreeImage_HasPixels(src)) return nullptr;
 
-	// working RGBF variable
-	auto *dib = FreeImage_ConvertToRGBF(src);
-	if (!dib) return nullptr;
+	// RGBF images are read directly, other types through a working RGBF image
+	FIBITMAP *converted = nullptr;
+	FIBITMAP *rgbf = src;
+	if (FreeImage_GetImageType(src) != FIT_RGBF) {
+		converted = FreeImage_ConvertToRGBF(src);
+		if (!converted) return nullptr;
+		rgbf = converted;
+	}
+
+	const unsigned width  = FreeImage_GetWidth(rgbf);
+	const unsigned height = FreeImage_GetHeight(rgbf);
+	const unsigned pitch  = FreeImage_GetPitch(rgbf);
+	const uint8_t *bits   = FreeImage_GetConstBits(rgbf);
+
+	FIBITMAP *dst = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if (!dst) {
+		FreeImage_Unload(converted);
+		return nullptr;
+	}
+
+	const unsigned band_rows = CalculateBandRows(pitch);
+
+	// get the luminance, rows are summed in order whatever the number of threads
+
+	std::vector<float> row_max(height);
+	std::vector<double> row_sum(height);
+
+	ParallelFor(0, height, band_rows, [&](unsigned first, unsigned last) {
+		std::vector<FIRGBF> Yxy(width);
+		std::vector<float> logs(width);
+		for (unsigned y = first; y < last; y++) {
+			ConvertRowRGBFToYxy(Yxy.data(), (const FIRGBF*)(bits + (size_t)pitch * y), width);
+			float max_lum = 0;
+			for (unsigned x = 0; x < width; x++) {
+				const float Y = MAX(0.0F, Yxy[x].red);	// avoid negative values
+				max_lum = (max_lum < Y) ? Y : max_lum;	// max Luminance in the scene
+				logs[x] = 2.3e-5F + Y;					// contrast constant in Tumblin paper
+			}
+			Log2Floats(logs.data(), logs.data(), width);
+			double sum = 0;
+			for (unsigned x = 0; x < width; x++) {
+				sum += logs[x];
+			}
+			row_max[y] = max_lum;
+			row_sum[y] = sum;
+		}
+	});
+
+	float maxLum = 0;
+	double sum = 0;
+	for (unsigned y = 0; y < height; y++) {
+		maxLum = MAX(maxLum, row_max[y]);
+		sum += row_sum[y];
+	}
 
 	// default algorithm parameters
-	const float biasParam = 0.85F;
-	const float expoParam = (float)pow(2.0, exposure); //default exposure is 1, 2^0
 
-	// convert to Yxy
-	ConvertInPlaceRGBFToYxy(dib);
-	// get the luminance
-	LuminanceFromYxy(dib, &maxLum, &minLum, &avgLum);
-	// perform the tone mapping
-	ToneMappingDrago03(dib, maxLum, avgLum, biasParam, expoParam);
-	// convert back to RGBF
-	ConvertInPlaceYxyToRGBF(dib);
-	if (gamma != 1) {
-		// perform gamma correction
-		REC709GammaCorrection(dib, (float)gamma);
+	Drago03Params params;
+	params.avgLum = (float)exp(LN2 * sum / (static_cast<double>(width) * height));
+	params.exposure = (float)pow(2.0, exposure); //default exposure is 1, 2^0
+	// normalize maximum luminance by average luminance
+	params.Lmax = maxLum / params.avgLum;
+	params.divider = (float)log10(params.Lmax + 1);
+	// arbitrary Bias Parameter 
+	const float biasParam = 0.85F;
+	params.biasP = (float)(log(biasParam) / log(0.5));
+	params.gamma = (float)gamma;
+	REC709GammaParams(params);
+
+	// perform the tone mapping, on the compute device if one is selected
+
+	const unsigned dst_pitch = FreeImage_GetPitch(dst);
+	uint8_t *dst_bits = FreeImage_GetBits(dst);
+
+	ComputeDevice *device = GetComputeDevice();
+	if (!device || !device->ToneMapDrago03(rgbf, dst, params)) {
+		ParallelFor(0, height, band_rows, [&](unsigned first, unsigned last) {
+			std::vector<FIRGBF> pixels(width);
+			std::vector<float> Y(width), Yw(width), logs(width), curve(3 * (size_t)width);
+			for (unsigned y = first; y < last; y++) {
+				// convert to Yxy
+				ConvertRowRGBFToYxy(pixels.data(), (const FIRGBF*)(bits + (size_t)pitch * y), width);
+				for (unsigned x = 0; x < width; x++) {
+					Y[x] = pixels[x].red;
+				}
+				ToneMappingDrago03(Y.data(), Yw.data(), logs.data(), width, params);
+				for (unsigned x = 0; x < width; x++) {
+					pixels[x].red = Y[x];
+				}
+				// convert back to RGBF
+				ConvertRowYxyToRGBF(pixels.data(), width);
+				if (params.gamma != 1) {
+					// perform gamma correction
+					REC709GammaCorrection((float*)pixels.data(), curve.data(), 3 * width, params);
+				}
+				// clamp image highest values to display white, then convert to 24-bit RGB
+				ClampConvertRowRGBFTo24(dst_bits + (size_t)dst_pitch * y, pixels.data(), width);
+			}
+		});
 	}
-	// clamp image highest values to display white, then convert to 24-bit RGB
-	FIBITMAP *dst = ClampConvertRGBFTo24(dib);
 
 	// clean-up and return
-	FreeImage_Unload(dib);
+	FreeImage_Unload(converted);
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(dst, src);
@@ -22,6 +22,10 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "CPUDispatch.h"
+
+#include <atomic>
+#include <vector>
 
 // ----------------------------------------------------------
 // Gradient domain HDR compression
@@ -34,151 +38,260 @@
 
 static const float EPSILON = 1e-4F;
 
+// ----------------------------------------------------------
+//  Pyramids
+// ----------------------------------------------------------
+
 /**
-Performs a 5 by 5 gaussian filtering using two 1D convolutions, 
-followed by a subsampling by 2. 
-@param dib Input image
-@return Returns a blurred image of size SIZE(dib)/2
-@see GaussianPyramid
+Level of a pyramid of float images
 */
-static FIBITMAP* GaussianLevel5x5(FIBITMAP *dib) {
-	FIBITMAP *h_dib{}, *v_dib{}, *dst{};
-	float *src_pixel, *dst_pixel;
+struct PyramidLevel {
+	unsigned width;
+	unsigned height;
+	unsigned pitch;		// in floats
+	float *bits;
+};
 
-	try {
-		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
-		if (image_type != FIT_FLOAT) throw(1);
-
-		const unsigned width = FreeImage_GetWidth(dib);
-		const unsigned height = FreeImage_GetHeight(dib);
-
-		h_dib = FreeImage_AllocateT(image_type, width, height);
-		v_dib = FreeImage_AllocateT(image_type, width, height);
-		if (!h_dib || !v_dib) throw(1);
+/**
+Pyramid of float images, each level is half the size of the previous one.
+Levels are stored in one arena allocated once, except a first level referring to an existing image.
+*/
+struct Pyramid {
+	std::vector<PyramidLevel> levels;
+	std::vector<float> arena;
+};
 
-		const unsigned pitch = FreeImage_GetPitch(dib) / sizeof(float);
+/**
+Sets the sizes of the levels first_level .. nlevels-1 of a pyramid whose level 0 is width x height,
+and allocates them in the arena.
+@return Returns TRUE if successful, returns FALSE otherwise
+*/
+static FIBOOL AllocatePyramid(Pyramid &pyramid, unsigned width, unsigned height, int first_level, int nlevels) {
+	try {
+		pyramid.levels.assign(nlevels, PyramidLevel{});
+		size_t size = 0;
+		for (int k = 0; k < nlevels; k++) {
+			PyramidLevel &level = pyramid.levels[k];
+			level.width = width;
+			level.height = height;
+			// rows of 16 bytes multiples
+			level.pitch = (width + 3) & ~3u;
+			if (k >= first_level) {
+				size += (size_t)level.pitch * height;
+			}
+			width /= 2;
+			height /= 2;
+		}
+		pyramid.arena.assign(size, 0);
+		float *bits = pyramid.arena.data();
+		for (int k = first_level; k < nlevels; k++) {
+			PyramidLevel &level = pyramid.levels[k];
+			level.bits = bits;
+			bits += (size_t)level.pitch * level.height;
+		}
+		return TRUE;
+	} catch(const std::bad_alloc &) {
+		return FALSE;
+	}
+}
 
-		// horizontal convolution dib -> h_dib
+namespace {
 
-		src_pixel = (float*)FreeImage_GetBits(dib);
-		dst_pixel = (float*)FreeImage_GetBits(h_dib);
+	/**
+	5-tap binomial filter [1 4 6 4 1] / 16 of a row at the even columns 0, 2, ... < 2 * count.
+	Columns are mirrored around 0 on the left and duplicated on the right.
+	*/
+	using ReduceRowKernel = unsigned (*)(float *dst, const float *src, unsigned first, unsigned count);
 
-		for (unsigned y = 0; y < height; y++) {
-			// work on line y
-			for (unsigned x = 2; x < width - 2; x++) {
-				dst_pixel[x] = src_pixel[x-2] + src_pixel[x+2] + 4 * (src_pixel[x-1] + src_pixel[x+1]) + 6 * src_pixel[x];
-				dst_pixel[x] /= 16;
-			}
-			// boundary mirroring
-			dst_pixel[0] = (2 * src_pixel[2] + 8 * src_pixel[1] + 6 * src_pixel[0]) / 16;
-			dst_pixel[1] = (src_pixel[3] + 4 * (src_pixel[0] + src_pixel[2]) + 7 * src_pixel[1]) / 16;
-			dst_pixel[width-2] = (src_pixel[width-4] + 5 * src_pixel[width-1] + 4 * src_pixel[width-3] + 6 * src_pixel[width-2]) / 16;
-			dst_pixel[width-1] = (src_pixel[width-3] + 5 * src_pixel[width-2] + 10 * src_pixel[width-1]) / 16;
+	inline unsigned MirrorIndex(int x, unsigned n) {
+		return (x < 0) ? (unsigned)(-x) : ((unsigned)x >= n) ? 2 * n - 1 - (unsigned)x : (unsigned)x;
+	}
 
-			// next line
-			src_pixel += pitch;
-			dst_pixel += pitch;
+	void ReduceRowBorder(float *dst, const float *src, unsigned width, unsigned first, unsigned last) {
+		for (unsigned i = first; i < last; i++) {
+			const int x = 2 * (int)i;
+			const float a = src[MirrorIndex(x - 2, width)];
+			const float b = src[MirrorIndex(x - 1, width)];
+			const float d = src[MirrorIndex(x + 1, width)];
+			const float e = src[MirrorIndex(x + 2, width)];
+			dst[i] = (a + e + 4 * (b + d) + 6 * src[x]) / 16;
 		}
+	}
 
-		// vertical convolution h_dib -> v_dib
+	unsigned ReduceRow(float *dst, const float *src, unsigned first, unsigned count) {
+		for (unsigned i = first; i < count; i++) {
+			const float *s = src + 2 * i;
+			dst[i] = (s[-2] + s[2] + 4 * (s[-1] + s[1]) + 6 * s[0]) / 16;
+		}
+		return count;
+	}
 
-		src_pixel = (float*)FreeImage_GetBits(h_dib);
-		dst_pixel = (float*)FreeImage_GetBits(v_dib);
+#if FREEIMAGE_SIMD_X86
+
+	unsigned ReduceRow_SSE2(float *dst, const float *src, unsigned first, unsigned count) {
+		const __m128 four = _mm_set1_ps(4.0F);
+		const __m128 six = _mm_set1_ps(6.0F);
+		const __m128 sixteenth = _mm_set1_ps(1.0F / 16);
+		unsigned i = first;
+		// columns 2i - 2 .. 2i + 9 are read
+		for (; i + 4 < count; i += 4) {
+			const float *s = src + 2 * i;
+			const __m128 lo = _mm_loadu_ps(s - 2);
+			const __m128 mid = _mm_loadu_ps(s + 2);
+			const __m128 center_lo = _mm_loadu_ps(s);
+			const __m128 center_hi = _mm_loadu_ps(s + 4);
+			const __m128 left2 = _mm_shuffle_ps(lo, mid, _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 left1 = _mm_shuffle_ps(lo, mid, _MM_SHUFFLE(3, 1, 3, 1));
+			const __m128 center = _mm_shuffle_ps(center_lo, center_hi, _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 right1 = _mm_shuffle_ps(center_lo, center_hi, _MM_SHUFFLE(3, 1, 3, 1));
+			const __m128 right2 = _mm_shuffle_ps(mid, _mm_loadu_ps(s + 6), _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(left2, right2), _mm_mul_ps(four, _mm_add_ps(left1, right1))), _mm_mul_ps(six, center));
+			_mm_storeu_ps(dst + i, _mm_mul_ps(sum, sixteenth));
+		}
+		return i;
+	}
 
-		for (unsigned x = 0; x < width; x++) {		
-			// work on column x
-			for (unsigned y = 2; y < height - 2; y++) {
-				const unsigned index = y*pitch + x;
-				dst_pixel[index] = src_pixel[index-2*pitch] + src_pixel[index+2*pitch] + 4 * (src_pixel[index-pitch] + src_pixel[index+pitch]) + 6 * src_pixel[index];
-				dst_pixel[index] /= 16;
-			}
-			// boundary mirroring
-			dst_pixel[x] = (2 * src_pixel[x+2*pitch] + 8 * src_pixel[x+pitch] + 6 * src_pixel[x]) / 16;
-			dst_pixel[x+pitch] = (src_pixel[x+3*pitch] + 4 * (src_pixel[x] + src_pixel[x+2*pitch]) + 7 * src_pixel[x+pitch]) / 16;
-			dst_pixel[(height-2)*pitch+x] = (src_pixel[(height-4)*pitch+x] + 5 * src_pixel[(height-1)*pitch+x] + 4 * src_pixel[(height-3)*pitch+x] + 6 * src_pixel[(height-2)*pitch+x]) / 16;
-			dst_pixel[(height-1)*pitch+x] = (src_pixel[(height-3)*pitch+x] + 5 * src_pixel[(height-2)*pitch+x] + 10 * src_pixel[(height-1)*pitch+x]) / 16;
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+
+	unsigned ReduceRow_NEON(float *dst, const float *src, unsigned first, unsigned count) {
+		const float32x4_t four = vdupq_n_f32(4.0F);
+		const float32x4_t six = vdupq_n_f32(6.0F);
+		const float32x4_t sixteenth = vdupq_n_f32(1.0F / 16);
+		unsigned i = first;
+		for (; i + 4 < count; i += 4) {
+			const float *s = src + 2 * i;
+			const float32x4x2_t left = vld2q_f32(s - 2);
+			const float32x4x2_t center = vld2q_f32(s);
+			const float32x4_t right2 = vld2q_f32(s + 2).val[0];
+			const float32x4_t sum = vaddq_f32(vaddq_f32(vaddq_f32(left.val[0], right2), vmulq_f32(four, vaddq_f32(left.val[1], center.val[1]))), vmulq_f32(six, center.val[0]));
+			vst1q_f32(dst + i, vmulq_f32(sum, sixteenth));
 		}
+		return i;
+	}
 
-		FreeImage_Unload(h_dib); h_dib = nullptr;
+#endif // FREEIMAGE_SIMD_NEON
 
-		// perform downsampling
+	std::atomic<ReduceRowKernel> gReduceRow{ nullptr };
 
-		dst = FreeImage_Rescale(v_dib, width/2, height/2, FILTER_BILINEAR);
+	void SelectFattalKernels(uint32_t features) {
+		ReduceRowKernel reduce = nullptr;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			reduce = ReduceRow_SSE2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			reduce = ReduceRow_NEON;
+		}
+#endif
+		gReduceRow.store(reduce, std::memory_order_relaxed);
+	}
 
-		FreeImage_Unload(v_dib);
+	const CPUDispatchRegistrar gRegistrar(SelectFattalKernels);
 
-		return dst;
+} // namespace
 
-	} catch(int) {
-		if (h_dib) FreeImage_Unload(h_dib);
-		if (v_dib) FreeImage_Unload(v_dib);
-		if (dst) FreeImage_Unload(dst);
-		return nullptr;
-	}
+/**
+Performs a 5 by 5 gaussian filtering using two 1D convolutions, 
+fused with a subsampling by 2 (only the even rows and columns are filtered).
+Rows of dst are processed by parallel bands, each band filters horizontally the source rows it needs
+into a small ring of rows, then combines them vertically.
+@param dst Output level, of size SIZE(src)/2
+@param src Input level
+@see GaussianPyramid
+*/
+static void GaussianLevel5x5(const PyramidLevel &dst, const PyramidLevel &src) {
+	const unsigned width = src.width;
+	const unsigned height = src.height;
+	const ReduceRowKernel kernel = gReduceRow.load(std::memory_order_relaxed);
+
+	// interior outputs read the columns 2i - 2 .. 2i + 2
+	const unsigned interior_first = 1;
+	const unsigned interior_last = MAX(interior_first, MIN(dst.width, (width - 1) / 2));
+
+	ParallelFor(0, dst.height, CalculateBandRows((size_t)width * 5 * sizeof(float)), [&](unsigned first, unsigned last) {
+		// horizontally filtered source rows, indexed by source row modulo 5
+		std::vector<float> ring((size_t)dst.width * 5);
+		int rows[5] = { -1, -1, -1, -1, -1 };
+
+		auto filtered = [&](int y) -> const float* {
+			const unsigned sy = MirrorIndex(y, height);
+			float *row = ring.data() + (size_t)dst.width * (sy % 5);
+			if (rows[sy % 5] != (int)sy) {
+				const float *s = src.bits + (size_t)src.pitch * sy;
+				ReduceRowBorder(row, s, width, 0, interior_first);
+				unsigned i = kernel ? kernel(row, s, interior_first, interior_last) : interior_first;
+				i = ReduceRow(row, s, i, interior_last);
+				ReduceRowBorder(row, s, width, i, dst.width);
+				rows[sy % 5] = (int)sy;
+			}
+			return row;
+		};
+
+		for (unsigned j = first; j < last; j++) {
+			const int y = 2 * (int)j;
+			const float *a = filtered(y - 2);
+			const float *b = filtered(y - 1);
+			const float *c = filtered(y);
+			const float *d = filtered(y + 1);
+			const float *e = filtered(y + 2);
+			float *out = dst.bits + (size_t)dst.pitch * j;
+			for (unsigned i = 0; i < dst.width; i++) {
+				out[i] = (a[i] + e[i] + 4 * (b[i] + d[i]) + 6 * c[i]) / 16;
+			}
+		}
+	});
 }
 
 /**
 Compute a Gaussian pyramid using the specified number of levels. 
-@param H Original bitmap
-@param pyramid Resulting pyramid array 
+@param H Original bitmap, first level of the pyramid
+@param pyramid Resulting pyramid
 @param nlevels Number of resolution levels
 @return Returns TRUE if successful, returns FALSE otherwise
 */
-static FIBOOL GaussianPyramid(FIBITMAP *H, FIBITMAP **pyramid, int nlevels) {
-	try {
-		// first level is the original image
-		pyramid[0] = FreeImage_Clone(H);
-		if (!pyramid[0]) throw(1);
-		// compute next levels
-		for (int k = 1; k < nlevels; k++) {
-			pyramid[k] = GaussianLevel5x5(pyramid[k-1]);
-			if (!pyramid[k]) throw(1);
-		}
-		return TRUE;
-	} catch(int) {
-		for (int k = 0; k < nlevels; k++) {
-			if (pyramid[k]) {
-				FreeImage_Unload(pyramid[k]);
-				pyramid[k] = nullptr;
-			}
-		}
+static FIBOOL GaussianPyramid(FIBITMAP *H, Pyramid &pyramid, int nlevels) {
+	if (!AllocatePyramid(pyramid, FreeImage_GetWidth(H), FreeImage_GetHeight(H), 1, nlevels)) {
 		return FALSE;
 	}
+	// first level is the original image
+	pyramid.levels[0].pitch = FreeImage_GetPitch(H) / sizeof(float);
+	pyramid.levels[0].bits = (float*)FreeImage_GetBits(H);
+	// compute next levels
+	for (int k = 1; k < nlevels; k++) {
+		GaussianLevel5x5(pyramid.levels[k], pyramid.levels[k-1]);
+	}
+	return TRUE;
 }
 
 /**
 Compute the gradient magnitude of an input image H using central differences, 
 and returns the average gradient. 
+@param G [out] Gradient magnitude
 @param H Input image
-@param avgGrad [out] Average gradient
 @param k Level number
-@return Returns the gradient magnitude if successful, returns NULL otherwise
+@return Returns the average gradient
 @see GradientPyramid
 */
-static FIBITMAP* GradientLevel(FIBITMAP *H, float *avgGrad, int k) {
-	FIBITMAP *G{};
-
-	try {
-		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(H);
-		if (image_type != FIT_FLOAT) throw(1);
-
-		const unsigned width = FreeImage_GetWidth(H);
-		const unsigned height = FreeImage_GetHeight(H);
-
-		G = FreeImage_AllocateT(image_type, width, height);
-		if (!G) throw(1);
-		
-		const unsigned pitch = FreeImage_GetPitch(H) / sizeof(float);
-		
-		const float divider = (float)(1 << (k + 1));
-		float average = 0;
-		
-		float *src_pixel = (float*)FreeImage_GetBits(H);
-		float *dst_pixel = (float*)FreeImage_GetBits(G);
-
-		for (unsigned y = 0; y < height; y++) {
+static float GradientLevel(const PyramidLevel &G, const PyramidLevel &H, int k) {
+	const unsigned width = H.width;
+	const unsigned height = H.height;
+	const unsigned pitch = H.pitch;
+	const float divider = (float)(1 << (k + 1));
+
+	// sums of rows, added in order so that the average does not depend on the bands
+	std::vector<double> row_sums(height);
+
+	ParallelFor(0, height, CalculateBandRows((size_t)width * 3 * sizeof(float)), [&](unsigned first, unsigned last) {
+		const float *src_pixel = H.bits;
+		for (unsigned y = first; y < last; y++) {
 			const unsigned n = (y == 0 ? 0 : y-1);
 			const unsigned s = (y+1 == height ? y : y+1);
+			float *dst_pixel = G.bits + (size_t)G.pitch * y;
+			float average = 0;
 			for (unsigned x = 0; x < width; x++) {
 				const unsigned w = (x == 0 ? 0 : x-1);
 				const unsigned e = (x+1 == width ? x : x+1);		
@@ -190,18 +303,15 @@ static FIBITMAP* GradientLevel(FIBITMAP *H, float *avgGrad, int k) {
 				// average gradient
 				average += dst_pixel[x];
 			}
-			// next line
-			dst_pixel += pitch;
+			row_sums[y] = average;
 		}
-		
-		*avgGrad = average / (static_cast<float>(width) * height);
-
-		return G;
+	});
 
-	} catch(int) {
-		if (G) FreeImage_Unload(G);
-		return nullptr;
+	double average = 0;
+	for (unsigned y = 0; y < height; y++) {
+		average += row_sums[y];
 	}
+	return (float)(average / ((double)width * height));
 }
 
 /**
@@ -212,23 +322,15 @@ Calculate gradient magnitude and its average value on each pyramid level
 @param avgGrad [out] Average gradient on each level (array of size nlevels)
 @return Returns TRUE if successful, returns FALSE otherwise
 */
-static FIBOOL GradientPyramid(FIBITMAP **pyramid, int nlevels, FIBITMAP **gradients, float *avgGrad) {
-	try {
-		for (int k = 0; k < nlevels; k++) {
-			FIBITMAP *Hk = pyramid[k];
-			gradients[k] = GradientLevel(Hk, &avgGrad[k], k);
-			if (!gradients[k]) throw(1);
-		}
-		return TRUE;
-	} catch(int) {
-		for (int k = 0; k < nlevels; k++) {
-			if (gradients[k]) {
-				FreeImage_Unload(gradients[k]);
-				gradients[k] = nullptr;
-			}
-		}
+static FIBOOL GradientPyramid(const Pyramid &pyramid, int nlevels, Pyramid &gradients, float *avgGrad) {
+	const PyramidLevel &H0 = pyramid.levels[0];
+	if (!AllocatePyramid(gradients, H0.width, H0.height, 0, nlevels)) {
 		return FALSE;
 	}
+	for (int k = 0; k < nlevels; k++) {
+		avgGrad[k] = GradientLevel(gradients.levels[k], pyramid.levels[k], k);
+	}
+	return TRUE;
 }
 
 /**
@@ -240,9 +342,9 @@ Compute the gradient attenuation function PHI(x, y)
 @param beta Parameter beta in the paper
 @return Returns the attenuation matrix Phi if successful, returns NULL otherwise
 */
-static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, float alpha, float beta) {
-	float *src_pixel, *dst_pixel;
+static FIBITMAP* PhiMatrix(const Pyramid &gradients, float *avgGrad, int nlevels, float alpha, float beta) {
 	FIBITMAP **phi{};
+	FIBITMAP *L{};
 
 	try {
 		phi = static_cast<FIBITMAP**>(calloc(nlevels, sizeof(FIBITMAP*)));
@@ -251,11 +353,10 @@ static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, fl
 		for (int k = nlevels-1; k >= 0; k--) {
 			// compute phi(k)
 
-			FIBITMAP *Gk = gradients[k];
+			const PyramidLevel &Gk = gradients.levels[k];
 
-			const unsigned width = FreeImage_GetWidth(Gk);
-			const unsigned height = FreeImage_GetHeight(Gk);
-			const unsigned pitch = FreeImage_GetPitch(Gk) / sizeof(float);
+			const unsigned width = Gk.width;
+			const unsigned height = Gk.height;
 
 			// parameter alpha is 0.1 times the average gradient magnitude
 			// also, note the factor of 2**k in the denominator; 
@@ -266,42 +367,43 @@ static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, fl
 
 			phi[k] = FreeImage_AllocateT(FIT_FLOAT, width, height);
 			if (!phi[k]) throw(1);
-			
-			src_pixel = (float*)FreeImage_GetBits(Gk);
-			dst_pixel = (float*)FreeImage_GetBits(phi[k]);
-			for (unsigned y = 0; y < height; y++) {
-				for (unsigned x = 0; x < width; x++) {
-					// compute (alpha / grad) * (grad / alpha) ** beta
-					const float v = src_pixel[x] / ALPHA;
-					const float value = (float)pow((float)v, (float)(beta-1));
-					dst_pixel[x] = (value > 1) ? 1 : value;
-				}
-				// next line
-				src_pixel += pitch;
-				dst_pixel += pitch;
-			}
 
 			if (k < nlevels-1) {
-				// compute PHI(k) = L( PHI(k+1) ) * phi(k)
-				FIBITMAP *L = FreeImage_Rescale(phi[k+1], width, height, FILTER_BILINEAR);
+				// PHI(k) = L( PHI(k+1) ) * phi(k)
+				L = FreeImage_Rescale(phi[k+1], width, height, FILTER_BILINEAR);
 				if (!L) throw(1);
 
-				src_pixel = (float*)FreeImage_GetBits(L);
-				dst_pixel = (float*)FreeImage_GetBits(phi[k]);
-				for (unsigned y = 0; y < height; y++) {
+				// PHI(k+1) is no longer needed
+				FreeImage_Unload(phi[k+1]);
+				phi[k+1] = nullptr;
+			}
+
+			const unsigned pitch = FreeImage_GetPitch(phi[k]) / sizeof(float);
+			float *phi_bits = (float*)FreeImage_GetBits(phi[k]);
+			const float *l_bits = L ? (const float*)FreeImage_GetBits(L) : nullptr;
+
+			ParallelFor(0, height, CalculateBandRows((size_t)width * sizeof(float)), [&](unsigned first, unsigned last) {
+				for (unsigned y = first; y < last; y++) {
+					const float *src_pixel = Gk.bits + (size_t)Gk.pitch * y;
+					float *dst_pixel = phi_bits + (size_t)pitch * y;
 					for (unsigned x = 0; x < width; x++) {
-						dst_pixel[x] *= src_pixel[x];
+						// compute (alpha / grad) * (grad / alpha) ** beta
+						const float v = src_pixel[x] / ALPHA;
+						const float value = (float)pow((float)v, (float)(beta-1));
+						dst_pixel[x] = (value > 1) ? 1 : value;
+					}
+					if (l_bits) {
+						const float *l_pixel = l_bits + (size_t)pitch * y;
+						for (unsigned x = 0; x < width; x++) {
+							dst_pixel[x] *= l_pixel[x];
+						}
 					}
-					// next line
-					src_pixel += pitch;
-					dst_pixel += pitch;
 				}
+			});
 
+			if (L) {
 				FreeImage_Unload(L);
-
-				// PHI(k+1) is no longer needed
-				FreeImage_Unload(phi[k+1]);
-				phi[k+1] = nullptr;
+				L = nullptr;
 			}
 
 			// next level
@@ -315,6 +417,7 @@ static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, fl
 		return dst;
 
 	} catch(int) {
+		if (L) FreeImage_Unload(L);
 		if (phi) {
 			for (int k = nlevels-1; k >= 0; k--) {
 				if (phi[k]) FreeImage_Unload(phi[k]);
@@ -489,20 +592,20 @@ Gradient Domain HDR tone mapping operator
 @param Y Image luminance values
 @param alpha Parameter alpha of the paper (suggested value is 0.1)
 @param beta Parameter beta of the paper (suggested value is between 0.8 and 0.9)
+@param solver Poisson equation solver
 @return returns the tone mapped luminance
 */
-static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
+static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta, FREE_IMAGE_POISSON_SOLVER solver) {
 	const unsigned MIN_PYRAMID_SIZE = 32;	// minimun size (width or height) of the coarsest level of the pyramid
 
 	FIBITMAP *H{};
-	FIBITMAP **pyramid{};
-	FIBITMAP **gradients{};
+	Pyramid pyramid;
+	Pyramid gradients;
 	FIBITMAP *phy{};
 	FIBITMAP *divG{};
 	FIBITMAP *U{};
 	float *avgGrad{};
 
-	int k;
 	int nlevels = 0;
 
 	try {
@@ -518,36 +621,27 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 			nlevels++;
 			minsize /= 2;
 		}
+		// small images use the original image only
+		nlevels = MAX(nlevels, 1);
 
 		// create the Gaussian pyramid
-		pyramid = static_cast<FIBITMAP**>(calloc(nlevels, sizeof(FIBITMAP*)));
-		if (!pyramid) throw(1);
-
 		if (!GaussianPyramid(H, pyramid, nlevels)) throw(1);
 
 		// calculate gradient magnitude and its average value on each pyramid level
-		gradients = static_cast<FIBITMAP**>(calloc(nlevels, sizeof(FIBITMAP*)));
-		if (!gradients) throw(1);
 		avgGrad = (float*)malloc(nlevels * sizeof(float));
 		if (!avgGrad) throw(1);
 
 		if (!GradientPyramid(pyramid, nlevels, gradients, avgGrad)) throw(1);
 
 		// free the Gaussian pyramid
-		for (k = 0; k < nlevels; k++) {
-			if (pyramid[k]) FreeImage_Unload(pyramid[k]);
-		}
-		free(pyramid); pyramid = nullptr;
+		pyramid = Pyramid();
 
 		// compute the gradient attenuation function PHI(x, y)
 		phy = PhiMatrix(gradients, avgGrad, nlevels, alpha, beta);
 		if (!phy) throw(1);
 
 		// free the gradient pyramid
-		for (k = 0; k < nlevels; k++) {
-			if (gradients[k]) FreeImage_Unload(gradients[k]);
-		}
-		free(gradients); gradients = nullptr;
+		gradients = Pyramid();
 		free(avgGrad); avgGrad = nullptr;
 
 		// compute gradients in x and y directions, attenuate them with the attenuation matrix, 
@@ -559,8 +653,8 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 		FreeImage_Unload(H); H = nullptr;
 		FreeImage_Unload(phy); phy = nullptr;
 
-		// solve the PDE (Poisson equation) using a multigrid solver and 3 cycles
-		FIBITMAP *U = FreeImage_MultigridPoissonSolver(divG, 3);
+		// solve the PDE (Poisson equation) using a multigrid solver and 3 cycles, or directly using cosine transforms
+		FIBITMAP *U = (solver == FIPS_DCT) ? FreeImage_DCTPoissonSolver(divG) : FreeImage_MultigridPoissonSolver(divG, 3);
 		if (!U) throw(1);
 
 		FreeImage_Unload(divG);
@@ -572,18 +666,6 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 
 	} catch(int) {
 		if (H) FreeImage_Unload(H);
-		if (pyramid) {
-			for (int i = 0; i < nlevels; i++) {
-				if (pyramid[i]) FreeImage_Unload(pyramid[i]);
-			}
-			free(pyramid);
-		}
-		if (gradients) {
-			for (int i = 0; i < nlevels; i++) {
-				if (gradients[i]) FreeImage_Unload(gradients[i]);
-			}
-			free(gradients);
-		}
 		if (avgGrad) free(avgGrad);
 		if (phy) FreeImage_Unload(phy);
 		if (divG) FreeImage_Unload(divG);
@@ -602,10 +684,11 @@ Apply the Gradient Domain High Dynamic Range Compression to a RGBF image and con
 @param dib Input RGBF / RGB16 image
 @param color_saturation Color saturation (s parameter in the paper) in [0.4..0.6]
 @param attenuation Atenuation factor (beta parameter in the paper) in [0.8..0.9]
+@param solver Poisson equation solver, FIPS_MULTIGRID or FIPS_DCT
 @return Returns a 24-bit RGB image if successful, returns NULL otherwise
 */
 FIBITMAP* DLL_CALLCONV 
-FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation) {	
+FreeImage_TmoFattal02Ex(FIBITMAP *dib, double color_saturation, double attenuation, FREE_IMAGE_POISSON_SOLVER solver) {	
 	const float alpha = 0.1F;									// parameter alpha = 0.1
 	const float beta = (float)MAX(0.8, MIN(0.9, attenuation));	// parameter beta = [0.8..0.9]
 	const float s = (float)MAX(0.4, MIN(0.6, color_saturation));// exponent s controls color saturation = [0.4..0.6]
@@ -628,7 +711,7 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 		if (!Yin) throw(1);
 
 		// perform the tone mapping
-		Yout = tmoFattal02(Yin, alpha, beta);
+		Yout = tmoFattal02(Yin, alpha, beta, solver);
 		if (!Yout) throw(1);
 
 		// clip low and high values and normalize to [0..1]
@@ -684,3 +767,16 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 		return nullptr;
 	}
 }
+
+/**
+Apply the Gradient Domain High Dynamic Range Compression to a RGBF image and convert to 24-bit RGB,
+the Poisson equation is solved by the multigrid solver
+@param dib Input RGBF / RGB16 image
+@param color_saturation Color saturation (s parameter in the paper) in [0.4..0.6]
+@param attenuation Atenuation factor (beta parameter in the paper) in [0.8..0.9]
+@return Returns a 24-bit RGB image if successful, returns NULL otherwise
+*/
+FIBITMAP* DLL_CALLCONV 
+FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation) {
+	return FreeImage_TmoFattal02Ex(dib, color_saturation, attenuation, FIPS_MULTIGRID);
+}
@@ -110,6 +110,11 @@ FIBITMAP* FreeImage_TmoLinear(FIBITMAP* src, double max_value, FREE_IMAGE_CVT_CO
     if (imageType == FIT_BITMAP) {
         return FreeImage_Clone(src);
     }
+    if (imageType == FIT_RGBAH) {
+        // half floats are mapped through their float expansion
+        std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbaf(FreeImage_ConvertToRGBAF(src), &::FreeImage_Unload);
+        return rgbaf ? FreeImage_TmoLinear(rgbaf.get(), max_value, yuv_standard) : nullptr;
+    }
 
     uint32_t dstBpp = 32;
     switch (imageType) {
@@ -144,9 +149,8 @@ FIBITMAP* FreeImage_TmoLinear(FIBITMAP* src, double max_value, FREE_IMAGE_CVT_CO
         return nullptr;
     }
 
-    void* minPixel{}, * maxPixel{};
     double minBrightness = 0.0, maxBrightness = 0.0;
-    if (!FreeImage_FindMinMax(src, &minBrightness, &maxBrightness, &minPixel, &maxPixel)) {
+    if (!FreeImage_FindMinMax(src, &minBrightness, &maxBrightness)) {
         return nullptr;
     }
 
@@ -23,7 +23,10 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "ConversionSIMD.h"
+#include "ComputeBackend.h"
 #include <algorithm>
+#include <vector>
 
 // ----------------------------------------------------------
 // Global and/or local tone mapping operator
@@ -34,33 +37,43 @@
 //     Journal of Graphics Tools, vol. 7, no. 1, pp. 45-51, 2003.
 // ----------------------------------------------------------
 
+static const float LN2 = 0.693147181F;
+
+/**
+Statistics of a row, summed in row order whatever the number of threads
+*/
+struct Reinhard05RowStats {
+	float maxLum, minLum;	// max and min luminance
+	double sumLum;			// sum of the luminance
+	double sumLogLum;		// sum of log2(2.3e-5 + luminance)
+	double sumColor[3];		// sums of the channels
+};
+
 /**
-Tone mapping operator
+Tone mapping operator, in place.<br>
+Statistics are computed by a parallel reduction (only if they are really needed), then each row is mapped
+by parallel bands, with pow computed for the whole row by PowFloats, or by the selected compute device.
 @param dib Input / Output RGBF image
-@param Y Input luminance image version of dib
 @param f Overall intensity in range [-8:8] : default to 0
 @param m Contrast in range [0.3:1) : default to 0
 @param a Adaptation in range [0:1] : default to 1
 @param c Color correction in range [0:1] : default to 0
+@param min_color Minimum of the mapped values
+@param max_color Maximum of the mapped values
 @return Returns TRUE if successful, returns FALSE otherwise
-@see LuminanceFromY
 */
 static FIBOOL 
-ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, float c) {
-	float Cav[3];		// channel average
+ToneMappingReinhard05(FIBITMAP *dib, float f, float m, float a, float c, float *min_color, float *max_color) {
+	float Cav[3] = { 0, 0, 0 };	// channel average
 	float Lav = 0;		// average luminance
 	float Llav = 0;		// log average luminance
 	float minLum = 1;	// min luminance
 	float maxLum = 1;	// max luminance
-
-	float L;		// pixel luminance
-	float I_g, I_l; // global and local light adaptation
-	float I_a;		// interpolated pixel light adaptation
-	float k;		// key (low-key means overall dark image, high-key means overall light image)
+	float k = 0;		// key (low-key means overall dark image, high-key means overall light image)
 
 	// check input parameters 
 
-	if ((FreeImage_GetImageType(dib) != FIT_RGBF) || (FreeImage_GetImageType(Y) != FIT_FLOAT)) {
+	if (FreeImage_GetImageType(dib) != FIT_RGBF) {
 		return FALSE;
 	}
 
@@ -71,130 +84,138 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 
 	const unsigned width  = FreeImage_GetWidth(dib);
 	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned pitch  = FreeImage_GetPitch(dib);
+	uint8_t *bits = FreeImage_GetBits(dib);
 
-	const unsigned dib_pitch  = FreeImage_GetPitch(dib);
-	const unsigned y_pitch    = FreeImage_GetPitch(Y);
-
-	int i;
-	unsigned x, y;
-	uint8_t *bits{}, *Ybits{};
+	const unsigned band_rows = CalculateBandRows(pitch);
+	const double image_size = (double)width * height;
 
 	// get statistics about the data (but only if its really needed)
 
 	f = exp(-f);
-	if ((m == 0) || (a != 1) && (c != 1)) {
-		// avoid these calculations if its not needed after ...
-		LuminanceFromY(Y, &maxLum, &minLum, &Lav, &Llav);
-		k = (log(maxLum) - Llav) / (log(maxLum) - log(minLum));
-		if (k < 0) {
-			// pow(k, 1.4F) is undefined ...
-			// there's an ambiguity about the calculation of Llav between Reinhard papers and the various implementations  ...
-			// try another world adaptation luminance formula using instead 'worldLum = log(Llav)'
-			k = (log(maxLum) - log(Llav)) / (log(maxLum) - log(minLum));
-			if (k < 0) m = 0.3F;
-		}
-	}
-	m = (m > 0) ? m : (float)(0.3 + 0.7 * pow(k, 1.4F));
-
-	float max_color = -1e6F;
-	float min_color = +1e6F;
-
-	// tone map image
-
-	bits  = (uint8_t*)FreeImage_GetBits(dib);
-	Ybits = (uint8_t*)FreeImage_GetBits(Y);
-
-	if ((a == 1) && (c == 0)) {
-		// when using default values, use a fastest code
-
-		for (y = 0; y < height; y++) {
-			float *Y     = (float*)Ybits;
-			float *color = (float*)bits;
-
-			for (x = 0; x < width; x++) {
-				I_a = Y[x];	// luminance(x, y)
-				for (i = 0; i < 3; i++) {
-					*color /= ( *color + pow(f * I_a, m) );
-					
-					max_color = (*color > max_color) ? *color : max_color;
-					min_color = (*color < min_color) ? *color : min_color;
-
-					color++;
+	const bool need_luminance = (m == 0) || (a != 1) && (c != 1);
+	// channel averages are not needed when (a == 1) or (c == 0)
+	const bool need_channels = (a != 1) && (c != 0);
+	if (need_luminance || need_channels) {
+		std::vector<Reinhard05RowStats> row_stats(height);
+
+		ParallelFor(0, height, band_rows, [&](unsigned first, unsigned last) {
+			std::vector<float> Y(width), logs(width);
+			for (unsigned y = first; y < last; y++) {
+				const auto *pixel = (const FIRGBF*)(bits + (size_t)pitch * y);
+				Reinhard05RowStats &stats = row_stats[y];
+				ConvertRowRGBFToY(Y.data(), pixel, width);
+				stats.maxLum = -1e20F;
+				stats.minLum = 1e20F;
+				stats.sumLum = 0;
+				for (unsigned x = 0; x < width; x++) {
+					stats.maxLum = MAX(stats.maxLum, Y[x]);	// max Luminance in the scene
+					stats.minLum = MIN(stats.minLum, Y[x]);	// min Luminance in the scene
+					stats.sumLum += Y[x];					// average luminance
+					logs[x] = 2.3e-5F + Y[x];				// contrast constant in Tumblin paper
 				}
-			}
-			// next line
-			bits  += dib_pitch;
-			Ybits += y_pitch;
-		}
-	} else {
-		// complete algorithm
-
-		// channel averages
-
-		Cav[0] = Cav[1] = Cav[2] = 0;
-		if ((a != 1) && (c != 0)) {
-			// channel averages are not needed when (a == 1) or (c == 0)
-			bits = (uint8_t*)FreeImage_GetBits(dib);
-			for (y = 0; y < height; y++) {
-				auto *color = (const float*)bits;
-				for (x = 0; x < width; x++) {
-					for (i = 0; i < 3; i++) {
-						Cav[i] += *color;
-						color++;
+				Log2Floats(logs.data(), logs.data(), width);
+				stats.sumLogLum = 0;
+				for (unsigned x = 0; x < width; x++) {
+					stats.sumLogLum += logs[x];
+				}
+				stats.sumColor[0] = stats.sumColor[1] = stats.sumColor[2] = 0;
+				if (need_channels) {
+					for (unsigned x = 0; x < width; x++) {
+						stats.sumColor[0] += pixel[x].red;
+						stats.sumColor[1] += pixel[x].green;
+						stats.sumColor[2] += pixel[x].blue;
 					}
 				}
-				// next line
-				bits += dib_pitch;
 			}
-			const float image_size = (float)width * height;
-			for (i = 0; i < 3; i++) {
-				Cav[i] /= image_size;
+		});
+
+		float max_lum = -1e20F, min_lum = 1e20F;
+		double sumLum = 0, sumLogLum = 0, sumColor[3] = { 0, 0, 0 };
+		for (const Reinhard05RowStats &stats : row_stats) {
+			max_lum = MAX(max_lum, stats.maxLum);
+			min_lum = MIN(min_lum, stats.minLum);
+			sumLum += stats.sumLum;
+			sumLogLum += stats.sumLogLum;
+			for (int i = 0; i < 3; i++) {
+				sumColor[i] += stats.sumColor[i];
 			}
 		}
-
-		// perform tone mapping
-
-		bits = (uint8_t*)FreeImage_GetBits(dib);
-		for (y = 0; y < height; y++) {
-			const float *Y     = (float*)Ybits;
-			auto *color = (float*)bits;
-
-			for (x = 0; x < width; x++) {
-				L = Y[x];	// luminance(x, y)
-				for (i = 0; i < 3; i++) {
-					I_l = c * *color + (1-c) * L;
-					I_g = c * Cav[i] + (1-c) * Lav;
-					I_a = a * I_l + (1-a) * I_g;
-					*color /= ( *color + pow(f * I_a, m) );
-					
-					max_color = (*color > max_color) ? *color : max_color;
-					min_color = (*color < min_color) ? *color : min_color;
-
-					color++;
-				}
+		if (need_channels) {
+			for (int i = 0; i < 3; i++) {
+				Cav[i] = (float)(sumColor[i] / image_size);
 			}
-			// next line
-			bits  += dib_pitch;
-			Ybits += y_pitch;
 		}
+		if (need_luminance) {
+			maxLum = max_lum;
+			minLum = min_lum;
+			Lav = (float)(sumLum / image_size);
+			// average log luminance, a.k.a. world adaptation luminance
+			Llav = (float)exp(LN2 * sumLogLum / image_size);
+
+			k = (log(maxLum) - Llav) / (log(maxLum) - log(minLum));
+			if (k < 0) {
+				// pow(k, 1.4F) is undefined ...
+				// there's an ambiguity about the calculation of Llav between Reinhard papers and the various implementations  ...
+				// try another world adaptation luminance formula using instead 'worldLum = log(Llav)'
+				k = (log(maxLum) - log(Llav)) / (log(maxLum) - log(minLum));
+				if (k < 0) m = 0.3F;
+			}
+		}
+	}
+	m = (m > 0) ? m : (float)(0.3 + 0.7 * pow(k, 1.4F));
+
+	// global light adaptation of each channel
+	float I_g[3];
+	for (int i = 0; i < 3; i++) {
+		I_g[i] = c * Cav[i] + (1-c) * Lav;
 	}
 
-	// normalize intensities
-
-	if (max_color != min_color) {
-		bits = (uint8_t*)FreeImage_GetBits(dib);
-		const float range = max_color - min_color;
-		for (y = 0; y < height; y++) {
-			auto *color = (float*)bits;
-			for(x = 0; x < width; x++) {
-				for (i = 0; i < 3; i++) {
-					*color = (*color - min_color) / range;
-					color++;
+	// tone map image, on the compute device if one is selected
+	// with the default values (a == 1) and (c == 0), the pixel light adaptation is the luminance
+
+	if (ComputeDevice *device = GetComputeDevice()) {
+		const Reinhard05Params params = { f, m, a, c, { I_g[0], I_g[1], I_g[2] } };
+		if (device->ToneMapReinhard05(dib, params, min_color, max_color)) {
+			return TRUE;
+		}
+	}
+
+	std::vector<float> row_min(height), row_max(height);
+
+	ParallelFor(0, height, band_rows, [&](unsigned first, unsigned last) {
+		std::vector<float> Y(width), I_a(3 * (size_t)width);
+		for (unsigned y = first; y < last; y++) {
+			auto *color = (float*)(bits + (size_t)pitch * y);
+			ConvertRowRGBFToY(Y.data(), (const FIRGBF*)color, width);
+			for (unsigned x = 0; x < width; x++) {
+				const float L = Y[x];	// luminance(x, y)
+				for (int i = 0; i < 3; i++) {
+					const float I_l = c * color[3 * x + i] + (1-c) * L;	// local light adaptation
+					I_a[3 * x + i] = f * (a * I_l + (1-a) * I_g[i]);	// interpolated pixel light adaptation
 				}
 			}
-			// next line
-			bits += dib_pitch;
+			PowFloats(I_a.data(), I_a.data(), 3 * width, m);
+
+			float max_value = -1e6F;
+			float min_value = +1e6F;
+			for (unsigned i = 0; i < 3 * width; i++) {
+				const float denominator = color[i] + I_a[i];
+				color[i] = (denominator != 0) ? color[i] / denominator : 0;
+
+				max_value = (color[i] > max_value) ? color[i] : max_value;
+				min_value = (color[i] < min_value) ? color[i] : min_value;
+			}
+			row_min[y] = min_value;
+			row_max[y] = max_value;
 		}
+	});
+
+	*max_color = -1e6F;
+	*min_color = +1e6F;
+	for (unsigned y = 0; y < height; y++) {
+		*max_color = MAX(*max_color, row_max[y]);
+		*min_color = MIN(*min_color, row_min[y]);
 	}
 
 	return TRUE;
@@ -221,19 +242,40 @@ FreeImage_TmoReinhard05Ex(FIBITMAP *src, double intensity, double contrast, doub
 	auto *dib = FreeImage_ConvertToRGBF(src);
 	if (!dib) return nullptr;
 
-	// get the Luminance channel
-	auto *Y = ConvertRGBFToY(dib);
-	if (!Y) {
+	// perform the tone mapping
+	float min_color, max_color;
+	ToneMappingReinhard05(dib, (float)intensity, (float)contrast, (float)adaptation, (float)color_correction, &min_color, &max_color);
+
+	const unsigned width  = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	FIBITMAP *dst = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if (!dst) {
 		FreeImage_Unload(dib);
 		return nullptr;
 	}
 
-	// perform the tone mapping
-	ToneMappingReinhard05(dib, Y, (float)intensity, (float)contrast, (float)adaptation, (float)color_correction);
-	// not needed anymore
-	FreeImage_Unload(Y);
-	// clamp image highest values to display white, then convert to 24-bit RGB
-	FIBITMAP *dst = ClampConvertRGBFTo24(dib);
+	// normalize intensities, clamp image highest values to display white, then convert to 24-bit RGB
+
+	const unsigned src_pitch = FreeImage_GetPitch(dib);
+	const unsigned dst_pitch = FreeImage_GetPitch(dst);
+	uint8_t *src_bits = FreeImage_GetBits(dib);
+	uint8_t *dst_bits = FreeImage_GetBits(dst);
+	const float range = max_color - min_color;
+
+	ParallelFor(0, height, CalculateBandRows(src_pitch), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			auto *color = (FIRGBF*)(src_bits + (size_t)src_pitch * y);
+			if (range != 0) {
+				for (unsigned x = 0; x < width; x++) {
+					color[x].red   = (color[x].red   - min_color) / range;
+					color[x].green = (color[x].green - min_color) / range;
+					color[x].blue  = (color[x].blue  - min_color) / range;
+				}
+			}
+			ClampConvertRowRGBFTo24(dst_bits + (size_t)dst_pitch * y, color, width);
+		}
+	});
 
 	// clean-up and return
 	FreeImage_Unload(dib);
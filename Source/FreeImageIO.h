@@ -26,8 +26,20 @@
 #include "FreeImage.h"
 #endif
 
+#include <cstdio>
+#include <memory>
+#include <vector>
+
 // ----------------------------------------------------------
 
+/**
+Storage of FIMEMORY_GROW_CHUNKED streams, chunks are allocated with malloc
+*/
+struct FIMEMORYCHUNKS {
+	int64_t chunk_size;
+	std::vector<uint8_t*> chunks;
+};
+
 FI_STRUCT (FIMEMORYHEADER) {
 	/**
 	Flag used to remember to delete the 'data' buffer.
@@ -39,13 +51,25 @@ FI_STRUCT (FIMEMORYHEADER) {
 	file_length is equal to the input buffer size when the buffer is a wrapped buffer, i.e. file_length == data_length. 
 	file_length is the amount of the written bytes when the buffer is a read/write buffer.
 	*/
-	long file_length;
+	int64_t file_length;
 	/**
 	When using read-only input buffers, data_length is equal to the input buffer size, i.e. the file_length.
 	When using read/write buffers, data_length is the size of the allocated buffer, 
 	whose size is greater than or equal to file_length.
 	*/
-	long data_length;
+	int64_t data_length;
+	/**
+	One of the FIMEMORY_GROW_* policies of read/write buffers
+	*/
+	int growth_policy;
+	/**
+	Allocation increment of FIMEMORY_GROW_LINEAR buffers
+	*/
+	int64_t growth_step;
+	/**
+	Chunks of FIMEMORY_GROW_CHUNKED buffers, data is unused while they are set
+	*/
+	FIMEMORYCHUNKS *chunks;
 	/**
 	start buffer address
 	*/
@@ -53,11 +77,79 @@ FI_STRUCT (FIMEMORYHEADER) {
 	/**
 	Current position into the memory stream
 	*/
-	long current_position;
+	int64_t current_position;
+	/**
+	TRUE for caller-provided buffers opened with FreeImage_OpenMemoryWritable, which are written but never freed
+	*/
+	FIBOOL user_writable;
+	/**
+	Callback providing more space to user writable buffers, and its user data
+	*/
+	FI_MemoryOverflowProc overflow;
+	void *overflow_data;
 };
 
+/**
+Returns TRUE if the stream can be written, i.e. it is not a read-only wrapped buffer
+*/
+inline FIBOOL
+IsMemoryWritable(const FIMEMORYHEADER *mem_header) {
+	return mem_header->delete_me || mem_header->user_writable;
+}
+
 void SetDefaultIO(FreeImageIO *io);
 
 void SetMemoryIO(FreeImageIO *io);
 
+void SetDefaultIO64(FreeImageIO64 *io);
+
+void SetMemoryIO64(FreeImageIO64 *io);
+
+/**
+File read by a load by filename, through the default IO functions.
+Files of formats decoded front to back get a larger stdio buffer, the page cache hints
+of FreeImage_SetFileHints are given when the file is opened and when it is closed.
+*/
+class LoadFile
+{
+public:
+	/**
+	@param fif Format of the file
+	@param handle File opened for reading or NULL, closed by the destructor
+	*/
+	LoadFile(FREE_IMAGE_FORMAT fif, FILE *handle);
+	~LoadFile();
+
+	LoadFile(const LoadFile&) = delete;
+	LoadFile& operator=(const LoadFile&) = delete;
+
+	FILE* Get() const {
+		return mHandle;
+	}
+
+	explicit operator bool() const {
+		return mHandle != nullptr;
+	}
+
+private:
+	FILE *mHandle;
+	unsigned mHints;
+	std::unique_ptr<char[]> mBuffer;	// stdio buffer, released after the file is closed
+};
+
+/**
+Releases the chunks of a FIMEMORY_GROW_CHUNKED stream
+*/
+void FreeMemoryChunks(FIMEMORYHEADER *mem_header);
+
+/**
+Copies the chunks of a FIMEMORY_GROW_CHUNKED stream into a single buffer, the stream then grows by doubling
+*/
+FIBOOL FlattenMemoryChunks(FIMEMORYHEADER *mem_header);
+
+/**
+Buffer size FreeImage_LoadFromHandle uses for io, 0 if the reads aren't buffered (see FreeImage_SetLoadBuffering)
+*/
+unsigned GetLoadBuffering(const FreeImageIO *io);
+
 #endif // !FREEIMAGE_IO_H
@@ -0,0 +1,462 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "Filters.h"
+#include "../FreeImage/CPUDispatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+
+namespace {
+
+	/// Side of the destination tiles processed by one task, in pixels
+	const unsigned kTileSize = 64;
+
+	/// Filter values per unit of distance in the weights table
+	const unsigned kTableResolution = 256;
+
+	/// Fractional bits of the fixed point bilinear weights
+	const int kBilinearBits = 7;
+
+	/**
+	Everything a tile needs: images, the inverse mapping and the sampling filter.
+	Destination pixel (x, y) samples the source at u = m[0] * x + m[1] * y + m[2], v = m[3] * x + m[4] * y + m[5],
+	all coordinates are scanline indices (bottom-up) with pixel centres at integers.
+	*/
+	struct WarpContext {
+		const uint8_t *src_bits;
+		unsigned src_pitch;
+		int src_width;
+		int src_height;
+		uint8_t *dst_bits;
+		unsigned dst_pitch;
+		unsigned dst_width;
+		unsigned dst_height;
+		unsigned bytespp;
+		double m[6];
+		/// background pixel, used for samples outside the source
+		uint8_t background[16];
+		/// filter values at i / kTableResolution, empty for nearest neighbour sampling
+		std::vector<float> table;
+		/// filter radius in source pixels along u and v
+		double support_u, support_v;
+		/// table entries per source pixel along u and v
+		double step_u, step_v;
+	};
+
+	/// Returns the source pixel at (x, y) or the background
+	inline const uint8_t* SourcePixel(const WarpContext &ctx, int x, int y) {
+		if ((x < 0) || (y < 0) || (x >= ctx.src_width) || (y >= ctx.src_height)) {
+			return ctx.background;
+		}
+		return ctx.src_bits + static_cast<size_t>(y) * ctx.src_pitch + static_cast<size_t>(x) * ctx.bytespp;
+	}
+
+	template <typename T>
+	inline T StoreSample(float value) {
+		if constexpr (std::is_floating_point_v<T>) {
+			return static_cast<T>(value);
+		} else {
+			constexpr float max_val = static_cast<float>(std::numeric_limits<T>::max());
+			return static_cast<T>(std::floor(CLAMP(value, 0.0f, max_val) + 0.5f));
+		}
+	}
+
+	void NearestRow(const WarpContext &ctx, uint8_t *dst, unsigned x0, unsigned x1, unsigned y) {
+		for (unsigned x = x0; x < x1; x++) {
+			const double u = ctx.m[0] * x + ctx.m[1] * y + ctx.m[2];
+			const double v = ctx.m[3] * x + ctx.m[4] * y + ctx.m[5];
+			memcpy(dst, SourcePixel(ctx, static_cast<int>(std::floor(u + 0.5)), static_cast<int>(std::floor(v + 0.5))), ctx.bytespp);
+			dst += ctx.bytespp;
+		}
+	}
+
+	/**
+	Separable filtering over the footprint of the filter, out of bounds taps read the background.
+	Weights are normalized by their sum.
+	*/
+	template <typename T, unsigned C>
+	void FilterRow(const WarpContext &ctx, uint8_t *dst, unsigned x0, unsigned x1, unsigned y) {
+		const int last_entry = static_cast<int>(ctx.table.size()) - 1;
+		auto weight = [&](double distance, double step) {
+			const int index = static_cast<int>(std::fabs(distance) * step + 0.5);
+			return (index > last_entry) ? 0.0f : ctx.table[index];
+		};
+		std::vector<float> weights_u(static_cast<size_t>(2 * ctx.support_u) + 2);
+		std::vector<float> weights_v(static_cast<size_t>(2 * ctx.support_v) + 2);
+
+		for (unsigned x = x0; x < x1; x++, dst += sizeof(T) * C) {
+			const double u = ctx.m[0] * x + ctx.m[1] * y + ctx.m[2];
+			const double v = ctx.m[3] * x + ctx.m[4] * y + ctx.m[5];
+			const int left = static_cast<int>(std::ceil(u - ctx.support_u));
+			const int right = static_cast<int>(std::floor(u + ctx.support_u));
+			const int top = static_cast<int>(std::ceil(v - ctx.support_v));
+			const int bottom = static_cast<int>(std::floor(v + ctx.support_v));
+			if ((right < 0) || (bottom < 0) || (left >= ctx.src_width) || (top >= ctx.src_height)) {
+				memcpy(dst, ctx.background, sizeof(T) * C);
+				continue;
+			}
+			const unsigned taps_u = std::min<unsigned>(right - left + 1, static_cast<unsigned>(weights_u.size()));
+			const unsigned taps_v = std::min<unsigned>(bottom - top + 1, static_cast<unsigned>(weights_v.size()));
+			for (unsigned i = 0; i < taps_u; i++) {
+				weights_u[i] = weight(left + static_cast<int>(i) - u, ctx.step_u);
+			}
+			for (unsigned j = 0; j < taps_v; j++) {
+				weights_v[j] = weight(top + static_cast<int>(j) - v, ctx.step_v);
+			}
+
+			float acc[C] = {};
+			float sum = 0;
+			for (unsigned j = 0; j < taps_v; j++) {
+				if (weights_v[j] == 0) {
+					continue;
+				}
+				for (unsigned i = 0; i < taps_u; i++) {
+					const float w = weights_u[i] * weights_v[j];
+					if (w == 0) {
+						continue;
+					}
+					const T *pixel = reinterpret_cast<const T *>(SourcePixel(ctx, left + static_cast<int>(i), top + static_cast<int>(j)));
+					for (unsigned c = 0; c < C; c++) {
+						acc[c] += w * static_cast<float>(pixel[c]);
+					}
+					sum += w;
+				}
+			}
+			T *out = reinterpret_cast<T *>(dst);
+			if (sum == 0) {
+				memcpy(out, ctx.background, sizeof(T) * C);
+				continue;
+			}
+			for (unsigned c = 0; c < C; c++) {
+				out[c] = StoreSample<T>(acc[c] / sum);
+			}
+		}
+	}
+
+	/// Source position in fixed point with kBilinearBits fractional bits
+	inline int64_t ToFixed(double value) {
+		return static_cast<int64_t>(std::floor(value * (1 << kBilinearBits) + 0.5));
+	}
+
+	/**
+	Bilinear interpolation of 8-bit samples with 7-bit weights: rows are blended first, then the two results.
+	The kernels compute the same integer operations.
+	*/
+	template <unsigned C>
+	inline void BlendBilinear(uint8_t *dst, const uint8_t *p00, const uint8_t *p01, const uint8_t *p10, const uint8_t *p11, int ax, int ay) {
+		const int one = 1 << kBilinearBits;
+		for (unsigned c = 0; c < C; c++) {
+			const int top = p00[c] * (one - ax) + p01[c] * ax;
+			const int bottom = p10[c] * (one - ax) + p11[c] * ax;
+			dst[c] = static_cast<uint8_t>((top * (one - ay) + bottom * ay + (1 << (2 * kBilinearBits - 1))) >> (2 * kBilinearBits));
+		}
+	}
+
+	template <unsigned C>
+	struct ScalarBlend {
+		void operator()(uint8_t *dst, const uint8_t *p00, const uint8_t *p01, const uint8_t *p10, const uint8_t *p11, int ax, int ay) const {
+			BlendBilinear<C>(dst, p00, p01, p10, p11, ax, ay);
+		}
+	};
+
+	template <unsigned C, class Blend>
+	void BilinearRowT(const WarpContext &ctx, uint8_t *dst, unsigned x0, unsigned x1, unsigned y) {
+		const Blend blend;
+		const int mask = (1 << kBilinearBits) - 1;
+		for (unsigned x = x0; x < x1; x++, dst += C) {
+			const int64_t fu = ToFixed(ctx.m[0] * x + ctx.m[1] * y + ctx.m[2]);
+			const int64_t fv = ToFixed(ctx.m[3] * x + ctx.m[4] * y + ctx.m[5]);
+			const int64_t u0 = fu >> kBilinearBits;
+			const int64_t v0 = fv >> kBilinearBits;
+			if ((u0 < -1) || (v0 < -1) || (u0 >= ctx.src_width) || (v0 >= ctx.src_height)) {
+				memcpy(dst, ctx.background, C);
+				continue;
+			}
+			const int iu = static_cast<int>(u0);
+			const int iv = static_cast<int>(v0);
+			blend(dst, SourcePixel(ctx, iu, iv), SourcePixel(ctx, iu + 1, iv), SourcePixel(ctx, iu, iv + 1), SourcePixel(ctx, iu + 1, iv + 1),
+				static_cast<int>(fu & mask), static_cast<int>(fv & mask));
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+
+	/// See BlendBilinear, the 4 channels of a pixel are blended at once with _mm_madd_epi16
+	struct BlendSSE2 {
+		void operator()(uint8_t *dst, const uint8_t *p00, const uint8_t *p01, const uint8_t *p10, const uint8_t *p11, int ax, int ay) const {
+			const int one = 1 << kBilinearBits;
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i wu = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(ax) << 16) | static_cast<uint32_t>(one - ax)));
+			const __m128i wv = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(ay) << 16) | static_cast<uint32_t>(one - ay)));
+			int32_t s00, s01, s10, s11;
+			memcpy(&s00, p00, 4);
+			memcpy(&s01, p01, 4);
+			memcpy(&s10, p10, 4);
+			memcpy(&s11, p11, 4);
+			// channels of both pixels of a row are interleaved
+			const __m128i top = _mm_madd_epi16(_mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128(s00), _mm_cvtsi32_si128(s01)), zero), wu);
+			const __m128i bottom = _mm_madd_epi16(_mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128(s10), _mm_cvtsi32_si128(s11)), zero), wu);
+			const __m128i rows = _mm_unpacklo_epi16(_mm_packs_epi32(top, top), _mm_packs_epi32(bottom, bottom));
+			__m128i value = _mm_madd_epi16(rows, wv);
+			value = _mm_srai_epi32(_mm_add_epi32(value, _mm_set1_epi32(1 << (2 * kBilinearBits - 1))), 2 * kBilinearBits);
+			value = _mm_packs_epi32(value, value);
+			const int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(value, value));
+			memcpy(dst, &packed, 4);
+		}
+	};
+
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+
+	/// See BlendBilinear, the 4 channels of a pixel are blended at once
+	struct BlendNEON {
+		void operator()(uint8_t *dst, const uint8_t *p00, const uint8_t *p01, const uint8_t *p10, const uint8_t *p11, int ax, int ay) const {
+			const int one = 1 << kBilinearBits;
+			uint32_t s00, s01, s10, s11;
+			memcpy(&s00, p00, 4);
+			memcpy(&s01, p01, 4);
+			memcpy(&s10, p10, 4);
+			memcpy(&s11, p11, 4);
+			const uint16x4_t c00 = vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(s00))));
+			const uint16x4_t c01 = vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(s01))));
+			const uint16x4_t c10 = vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(s10))));
+			const uint16x4_t c11 = vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(s11))));
+			const uint32x4_t top = vmlal_n_u16(vmull_n_u16(c00, static_cast<uint16_t>(one - ax)), c01, static_cast<uint16_t>(ax));
+			const uint32x4_t bottom = vmlal_n_u16(vmull_n_u16(c10, static_cast<uint16_t>(one - ax)), c11, static_cast<uint16_t>(ax));
+			uint32x4_t value = vmlaq_n_u32(vmulq_n_u32(top, static_cast<uint32_t>(one - ay)), bottom, static_cast<uint32_t>(ay));
+			value = vshrq_n_u32(vaddq_u32(value, vdupq_n_u32(1 << (2 * kBilinearBits - 1))), 2 * kBilinearBits);
+			const uint8x8_t packed = vmovn_u16(vcombine_u16(vmovn_u32(value), vmovn_u32(value)));
+			vst1_lane_u32(reinterpret_cast<uint32_t *>(dst), vreinterpret_u32_u8(packed), 0);
+		}
+	};
+
+#endif // FREEIMAGE_SIMD_NEON
+
+	using RowKernel = void (*)(const WarpContext &ctx, uint8_t *dst, unsigned x0, unsigned x1, unsigned y);
+
+	/// Bilinear row kernel of 32-bit images for the enabled CPU features
+	std::atomic<RowKernel> gBilinear32{ BilinearRowT<4, ScalarBlend<4>> };
+
+	void SelectWarpKernels(uint32_t features) {
+		RowKernel bilinear32 = BilinearRowT<4, ScalarBlend<4>>;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			bilinear32 = BilinearRowT<4, BlendSSE2>;
+		}
+#elif FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			bilinear32 = BilinearRowT<4, BlendNEON>;
+		}
+#endif
+		gBilinear32.store(bilinear32, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectWarpKernels);
+
+	std::unique_ptr<CGenericFilter> CreateWarpFilter(FREE_IMAGE_FILTER filter) {
+		switch (filter) {
+			case FILTER_BOX:
+				return std::make_unique<CBoxFilter>();
+			case FILTER_BICUBIC:
+				return std::make_unique<CBicubicFilter>();
+			case FILTER_BILINEAR:
+				return std::make_unique<CBilinearFilter>();
+			case FILTER_BSPLINE:
+				return std::make_unique<CBSplineFilter>();
+			case FILTER_CATMULLROM:
+				return std::make_unique<CCatmullRomFilter>();
+			case FILTER_LANCZOS3:
+				return std::make_unique<CLanczos3Filter>();
+		}
+		return nullptr;
+	}
+
+	/// Returns the row kernel for a pixel layout and a filter, nullptr if the image type is not supported
+	RowKernel SelectRowKernel(FREE_IMAGE_TYPE type, unsigned bpp, bool nearest, bool bilinear) {
+		if (nearest) {
+			return NearestRow;
+		}
+		switch (type) {
+			case FIT_BITMAP:
+				switch (bpp) {
+					case 8:
+						return bilinear ? BilinearRowT<1, ScalarBlend<1>> : FilterRow<uint8_t, 1>;
+					case 24:
+						return bilinear ? BilinearRowT<3, ScalarBlend<3>> : FilterRow<uint8_t, 3>;
+					case 32:
+						return bilinear ? gBilinear32.load(std::memory_order_relaxed) : FilterRow<uint8_t, 4>;
+				}
+				break;
+			case FIT_UINT16:
+				return FilterRow<uint16_t, 1>;
+			case FIT_RGB16:
+				return FilterRow<uint16_t, 3>;
+			case FIT_RGBA16:
+				return FilterRow<uint16_t, 4>;
+			case FIT_FLOAT:
+				return FilterRow<float, 1>;
+			case FIT_RGBF:
+				return FilterRow<float, 3>;
+			case FIT_RGBAF:
+				return FilterRow<float, 4>;
+			default:
+				break;
+		}
+		return nullptr;
+	}
+
+} // namespace
+
+// ==========================================================
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_AffineTransform(FIBITMAP *dib, const double *matrix, FREE_IMAGE_FILTER filter, const void *bkcolor, int dst_width, int dst_height) {
+	if (!FreeImage_HasPixels(dib) || !matrix) {
+		return nullptr;
+	}
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	const int src_width = static_cast<int>(FreeImage_GetWidth(dib));
+	const int src_height = static_cast<int>(FreeImage_GetHeight(dib));
+
+	double a = matrix[0], b = matrix[1], e = matrix[2];
+	double c = matrix[3], d = matrix[4], f = matrix[5];
+	const double det = a * d - b * c;
+	if (!std::isfinite(det) || (std::fabs(det) < 1e-12)) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FreeImage_AffineTransform: the matrix is not invertible");
+		return nullptr;
+	}
+
+	if ((dst_width <= 0) || (dst_height <= 0)) {
+		// bounding box of the transformed source, the translation only moves it
+		const double corners[4][2] = { { 0, 0 }, { double(src_width), 0 }, { 0, double(src_height) }, { double(src_width), double(src_height) } };
+		double min_x = HUGE_VAL, min_y = HUGE_VAL, max_x = -HUGE_VAL, max_y = -HUGE_VAL;
+		for (const auto &corner : corners) {
+			const double x = a * corner[0] + b * corner[1];
+			const double y = c * corner[0] + d * corner[1];
+			min_x = std::min(min_x, x);
+			max_x = std::max(max_x, x);
+			min_y = std::min(min_y, y);
+			max_y = std::max(max_y, y);
+		}
+		const double box_width = std::ceil(max_x - min_x - 1e-6);
+		const double box_height = std::ceil(max_y - min_y - 1e-6);
+		if ((box_width > INT_MAX) || (box_height > INT_MAX)) {
+			return nullptr;
+		}
+		dst_width = std::max(1, static_cast<int>(box_width));
+		dst_height = std::max(1, static_cast<int>(box_height));
+		e = -min_x;
+		f = -min_y;
+	}
+
+	// inverse matrix, from destination to source top-down coordinates
+	const double ia = d / det, ib = -b / det, ie = (b * f - d * e) / det;
+	const double ic = -c / det, id = a / det, iF = (c * e - a * f) / det;
+
+	const bool palette = (image_type == FIT_BITMAP) && (bpp == 8) && (FreeImage_GetColorType(dib) == FIC_PALETTE);
+	// filters are stretched over the footprint of a destination pixel when the image is reduced
+	const double scale_u = std::max(1.0, std::hypot(ia, ib));
+	const double scale_v = std::max(1.0, std::hypot(ic, id));
+	const bool unit_scale = (scale_u == 1.0) && (scale_v == 1.0);
+	const bool nearest = palette || (unit_scale && (filter == FILTER_BOX));
+	const bool bilinear = unit_scale && (filter == FILTER_BILINEAR) && (image_type == FIT_BITMAP);
+
+	const RowKernel kernel = SelectRowKernel(image_type, bpp, nearest, bilinear);
+	if (!kernel || ((image_type == FIT_BITMAP) && (bpp != 8) && (bpp != 24) && (bpp != 32))) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_UNSUPPORTED_FORMAT, FI_MSG_ERROR_UNSUPPORTED_FORMAT);
+		return nullptr;
+	}
+
+	try {
+		auto ctx = std::make_unique<WarpContext>();
+		ctx->src_bits = FreeImage_GetConstBits(dib);
+		ctx->src_pitch = FreeImage_GetPitch(dib);
+		ctx->src_width = src_width;
+		ctx->src_height = src_height;
+		ctx->bytespp = FreeImage_GetLine(dib) / FreeImage_GetWidth(dib);
+		memset(ctx->background, 0, sizeof(ctx->background));
+		if (bkcolor) {
+			memcpy(ctx->background, bkcolor, ctx->bytespp);
+		}
+
+		// destination scanline (x, y) has its centre at (x + 0.5, dst_height - 0.5 - y) in top-down coordinates,
+		// source top-down (s, t) is at scanline (s - 0.5, src_height - 0.5 - t)
+		const double cx = 0.5, cy = dst_height - 0.5;
+		ctx->m[0] = ia;
+		ctx->m[1] = -ib;
+		ctx->m[2] = ia * cx + ib * cy + ie - 0.5;
+		ctx->m[3] = -ic;
+		ctx->m[4] = id;
+		ctx->m[5] = src_height - 0.5 - (ic * cx + id * cy + iF);
+
+		if (!nearest && !bilinear) {
+			auto pFilter = CreateWarpFilter(filter);
+			if (!pFilter) {
+				return nullptr;
+			}
+			const double width = pFilter->GetWidth();
+			ctx->table.resize(static_cast<size_t>(std::ceil(width * kTableResolution)) + 1);
+			for (size_t i = 0; i < ctx->table.size(); i++) {
+				ctx->table[i] = static_cast<float>(pFilter->Filter(static_cast<double>(i) / kTableResolution));
+			}
+			ctx->support_u = width * scale_u;
+			ctx->support_v = width * scale_v;
+			ctx->step_u = kTableResolution / scale_u;
+			ctx->step_v = kTableResolution / scale_v;
+		}
+
+		FIBITMAP *dst = FreeImage_AllocateT(image_type, dst_width, dst_height, bpp,
+			FreeImage_GetRedMask(dib), FreeImage_GetGreenMask(dib), FreeImage_GetBlueMask(dib));
+		if (!dst) {
+			FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_DIB_MEMORY, FI_MSG_ERROR_DIB_MEMORY);
+			return nullptr;
+		}
+		ctx->dst_bits = FreeImage_GetBits(dst);
+		ctx->dst_pitch = FreeImage_GetPitch(dst);
+		ctx->dst_width = dst_width;
+		ctx->dst_height = dst_height;
+
+		// every destination pixel is computed once, tiles keep the source footprint of a task in cache
+		const unsigned tiles_x = (ctx->dst_width + kTileSize - 1) / kTileSize;
+		const unsigned tiles_y = (ctx->dst_height + kTileSize - 1) / kTileSize;
+		const WarpContext &warp = *ctx;
+		ParallelFor(0, tiles_x * tiles_y, 1, [&](unsigned first, unsigned last) {
+			for (unsigned tile = first; tile < last; tile++) {
+				const unsigned x0 = (tile % tiles_x) * kTileSize;
+				const unsigned y0 = (tile / tiles_x) * kTileSize;
+				const unsigned x1 = std::min(warp.dst_width, x0 + kTileSize);
+				const unsigned y1 = std::min(warp.dst_height, y0 + kTileSize);
+				for (unsigned y = y0; y < y1; y++) {
+					kernel(warp, warp.dst_bits + static_cast<size_t>(y) * warp.dst_pitch + static_cast<size_t>(x0) * warp.bytespp, x0, x1, y);
+				}
+			}
+		});
+
+		if ((image_type == FIT_BITMAP) && (bpp == 8)) {
+			// copy palette and transparency table
+			memcpy(FreeImage_GetPalette(dst), FreeImage_GetPalette(dib), FreeImage_GetColorsUsed(dib) * sizeof(FIRGBA8));
+			FreeImage_SetTransparencyTable(dst, FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
+		}
+
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(dst, dib);
+
+		return dst;
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return nullptr;
+}
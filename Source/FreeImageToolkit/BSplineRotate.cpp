@@ -47,6 +47,8 @@ IEEE Transactions on Signal Processing, vol. 41, no. 2, pp. 834-848, February 19
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#include <algorithm>
+
 #define PI	((double)3.14159265358979323846264338327950288419716939937510)
 
 #define ROTATE_QUADRATIC 2L	// Use B-splines of degree 2 (quadratic interpolation)
@@ -58,34 +60,35 @@ IEEE Transactions on Signal Processing, vol. 41, no. 2, pp. 834-848, February 19
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Prototypes definition
 
-static void ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long NbPoles,	double Tolerance);
-static double InitialCausalCoefficient(double *c, long DataLength, double z, double Tolerance);
-static void GetColumn(double *Image, long Width, long x, double *Line, long Height);
-static void	GetRow(double *Image, long y, double *Line, long Width);
-static double InitialAntiCausalCoefficient(double *c, long DataLength, double z);
-static void	PutColumn(double *Image, long Width, long x, double *Line, long Height);
-static void	PutRow(double *Image, long y, double *Line, long Width);
-static bool SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree);
-static double InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, long spline_degree);
+template <class T> static void ConvertToInterpolationCoefficients(T *c, long DataLength, long Stride, long Lanes, const double *z, long NbPoles, double Tolerance);
+template <class T> static void InitialCausalCoefficient(T *c, long DataLength, long Stride, long Lanes, double z, double Tolerance);
+template <class T> static void InitialAntiCausalCoefficient(T *c, long DataLength, long Stride, long Lanes, double z);
+template <class T> static bool SamplesToCoefficients(T *Image, long Width, long Height, long Channels, long spline_degree);
+static void InterpolationWeights(double x, long Length, long spline_degree, double *Weight, long *Index);
 
-static FIBITMAP * Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, FIBOOL use_mask);
+template <class T> static FIBITMAP * RotateSpline(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, FIBOOL use_mask);
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Coefficients routines
 
 /**
- ConvertToInterpolationCoefficients
+ ConvertToInterpolationCoefficients.<br>
+ Filters Lanes independent lines at once: sample n of lane l is c[n * Stride + l], 
+ so that rows (Stride = number of channels) and bands of columns (Stride = line length) 
+ are both processed in place without any copy.
 
  @param c Input samples --> output coefficients
  @param DataLength Number of samples or coefficients
+ @param Stride Distance between two consecutive samples of a lane
+ @param Lanes Number of lanes, stored next to each other
  @param z Poles
  @param NbPoles Number of poles
  @param Tolerance Admissible relative error
 */
-static void 
-ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long NbPoles,	double Tolerance) {
+template <class T> static void 
+ConvertToInterpolationCoefficients(T *c, long DataLength, long Stride, long Lanes, const double *z, long NbPoles, double Tolerance) {
 	double	Lambda = 1;
-	long	n, k;
+	long	n, k, l;
 
 	// special case required by mirror boundaries
 	if (DataLength == 1L) {
@@ -96,39 +99,54 @@ ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long N
 		Lambda = Lambda * (1.0 - z[k]) * (1.0 - 1.0 / z[k]);
 	}
 	// apply the gain 
+	const T gain = (T)Lambda;
 	for (n = 0L; n < DataLength; n++) {
-		c[n] *= Lambda;
+		T *row = c + n * Stride;
+		for (l = 0L; l < Lanes; l++) {
+			row[l] *= gain;
+		}
 	}
 	// loop over all poles 
 	for (k = 0L; k < NbPoles; k++) {
+		const T pole = (T)z[k];
 		// causal initialization 
-		c[0] = InitialCausalCoefficient(c, DataLength, z[k], Tolerance);
+		InitialCausalCoefficient(c, DataLength, Stride, Lanes, z[k], Tolerance);
 		// causal recursion 
 		for (n = 1L; n < DataLength; n++) {
-			c[n] += z[k] * c[n - 1L];
+			T *row = c + n * Stride;
+			const T *prev = row - Stride;
+			for (l = 0L; l < Lanes; l++) {
+				row[l] += pole * prev[l];
+			}
 		}
 		// anticausal initialization 
-		c[DataLength - 1L] = InitialAntiCausalCoefficient(c, DataLength, z[k]);
+		InitialAntiCausalCoefficient(c, DataLength, Stride, Lanes, z[k]);
 		// anticausal recursion 
 		for (n = DataLength - 2L; 0 <= n; n--) {
-			c[n] = z[k] * (c[n + 1L] - c[n]);
+			T *row = c + n * Stride;
+			const T *next = row + Stride;
+			for (l = 0L; l < Lanes; l++) {
+				row[l] = pole * (next[l] - row[l]);
+			}
 		}
 	}
 } 
 
 /**
- InitialCausalCoefficient
+ InitialCausalCoefficient.<br>
+ The initial coefficient of each lane replaces its first sample.
 
  @param c Coefficients
  @param DataLength Number of coefficients
+ @param Stride Distance between two consecutive coefficients of a lane
+ @param Lanes Number of lanes
  @param z Actual pole
  @param Tolerance Admissible relative error
- @return
 */
-static double 
-InitialCausalCoefficient(double	*c, long DataLength, double	z, double Tolerance) {
-	double	Sum, zn, z2n, iz;
-	long	n, Horizon;
+template <class T> static void 
+InitialCausalCoefficient(T *c, long DataLength, long Stride, long Lanes, double z, double Tolerance) {
+	double	zn, z2n, iz;
+	long	n, l, Horizon;
 
 	// this initialization corresponds to mirror boundaries 
 	Horizon = DataLength;
@@ -138,116 +156,60 @@ InitialCausalCoefficient(double	*c, long DataLength, double	z, double Tolerance)
 	if (Horizon < DataLength) {
 		// accelerated loop
 		zn = z;
-		Sum = c[0];
 		for (n = 1L; n < Horizon; n++) {
-			Sum += zn * c[n];
+			const T *row = c + n * Stride;
+			const T w = (T)zn;
+			for (l = 0L; l < Lanes; l++) {
+				c[l] += w * row[l];
+			}
 			zn *= z;
 		}
-		return(Sum);
 	}
 	else {
 		// full loop 
 		zn = z;
 		iz = 1.0 / z;
 		z2n = pow(z, (double)(DataLength - 1L));
-		Sum = c[0] + z2n * c[DataLength - 1L];
+		const T *last = c + (DataLength - 1L) * Stride;
+		for (l = 0L; l < Lanes; l++) {
+			c[l] += (T)z2n * last[l];
+		}
 		z2n *= z2n * iz;
 		for (n = 1L; n <= DataLength - 2L; n++) {
-			Sum += (zn + z2n) * c[n];
+			const T *row = c + n * Stride;
+			const T w = (T)(zn + z2n);
+			for (l = 0L; l < Lanes; l++) {
+				c[l] += w * row[l];
+			}
 			zn *= z;
 			z2n *= iz;
 		}
-		return(Sum / (1.0 - zn * zn));
-	}
-}
-
-/**
- GetColumn
-
- @param Image Input image array
- @param Width Width of the image
- @param x x coordinate of the selected line
- @param Line Output linear array
- @param Height Length of the line
-*/
-static void 
-GetColumn(double *Image, long Width, long x, double *Line, long Height) {
-	long y;
-
-	Image = Image + x;
-	for (y = 0L; y < Height; y++) {
-		Line[y] = (double)*Image;
-		Image += Width;
-	}
-}
-
-/**
- GetRow
-
- @param Image Input image array
- @param y y coordinate of the selected line
- @param Line Output linear array
- @param Width Length of the line
-*/
-static void	
-GetRow(double *Image, long y, double *Line, long Width) {
-	long	x;
-
-	Image = Image + (y * Width);
-	for (x = 0L; x < Width; x++) {
-		Line[x] = (double)*Image++;
+		const T scale = (T)(1.0 / (1.0 - zn * zn));
+		for (l = 0L; l < Lanes; l++) {
+			c[l] *= scale;
+		}
 	}
 }
 
 /**
- InitialAntiCausalCoefficient
+ InitialAntiCausalCoefficient.<br>
+ The initial coefficient of each lane replaces its last coefficient.
 
  @param c Coefficients
  @param DataLength Number of samples or coefficients
+ @param Stride Distance between two consecutive coefficients of a lane
+ @param Lanes Number of lanes
  @param z Actual pole
- @return
 */
-static double 
-InitialAntiCausalCoefficient(double	*c, long DataLength, double	z) {
+template <class T> static void 
+InitialAntiCausalCoefficient(T *c, long DataLength, long Stride, long Lanes, double z) {
 	// this initialization corresponds to mirror boundaries
-	return((z / (z * z - 1.0)) * (z * c[DataLength - 2L] + c[DataLength - 1L]));
-}
-
-/**
- PutColumn
-
- @param Image Output image array
- @param Width Width of the image
- @param x x coordinate of the selected line
- @param Line Input linear array
- @param Height Length of the line and height of the image
-*/
-static void	
-PutColumn(double *Image, long Width, long x, double *Line, long Height) {
-	long	y;
-
-	Image = Image + x;
-	for (y = 0L; y < Height; y++) {
-		*Image = (double)Line[y];
-		Image += Width;
-	}
-}
-
-/**
- PutRow
-
- @param Image Output image array
- @param y y coordinate of the selected line
- @param Line Input linear array
- @param Width length of the line and width of the image
-*/
-static void	
-PutRow(double *Image, long y, double *Line, long Width) {
-	long	x;
-
-	Image = Image + (y * Width);
-	for (x = 0L; x < Width; x++) {
-		*Image++ = (double)Line[x];
+	T *last = c + (DataLength - 1L) * Stride;
+	const T *prev = last - Stride;
+	const T scale = (T)(z / (z * z - 1.0));
+	const T pole = (T)z;
+	for (long l = 0L; l < Lanes; l++) {
+		last[l] = scale * (pole * prev[l] + last[l]);
 	}
 }
 
@@ -258,19 +220,19 @@ PutRow(double *Image, long y, double *Line, long Width) {
  data are processed in-place. 
  Even though this algorithm is robust with respect to quantization, 
  we advocate the use of a floating-point format for the data. 
+ Rows, then bands of columns, are filtered in parallel.
 
- @param Image Input / Output image (in-place processing)
+ @param Image Input / Output image (in-place processing), channels are interleaved
  @param Width Width of the image
  @param Height Height of the image
+ @param Channels Number of channels
  @param spline_degree Degree of the spline model
  @return Returns true if success, false otherwise
 */
-static bool	
-SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree) {
-	double	*Line;
+template <class T> static bool	
+SamplesToCoefficients(T *Image, long Width, long Height, long Channels, long spline_degree) {
 	double	Pole[2];
 	long	NbPoles;
-	long	x, y;
 
 	// recover the poles from a lookup table
 	switch (spline_degree) {
@@ -299,33 +261,27 @@ SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree
 			return false;
 	}
 
+	// the recursion horizon only needs the precision of the coefficients
+	const double Tolerance = (sizeof(T) == sizeof(float)) ? FLT_EPSILON : DBL_EPSILON;
+	const long Line = Width * Channels;
+
 	// convert the image samples into interpolation coefficients 
 
 	// in-place separable process, along x 
-	Line = (double *)malloc(Width * sizeof(double));
-	if (!Line) {
-		// Row allocation failed
-		return false;
-	}
-	for (y = 0L; y < Height; y++) {
-		GetRow(Image, y, Line, Width);
-		ConvertToInterpolationCoefficients(Line, Width, Pole, NbPoles, DBL_EPSILON);
-		PutRow(Image, y, Line, Width);
-	}
-	free(Line);
-
-	// in-place separable process, along y 
-	Line = (double *)malloc(Height * sizeof(double));
-	if (!Line) {
-		// Column allocation failed
-		return false;
-	}
-	for (x = 0L; x < Width; x++) {
-		GetColumn(Image, Width, x, Line, Height);
-		ConvertToInterpolationCoefficients(Line, Height, Pole, NbPoles, DBL_EPSILON);
-		PutColumn(Image, Width, x, Line, Height);
-	}
-	free(Line);
+	ParallelFor(0, (unsigned)Height, CalculateBandRows(Line * sizeof(T)), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			ConvertToInterpolationCoefficients(Image + y * Line, Width, Channels, Channels, Pole, NbPoles, Tolerance);
+		}
+	});
+
+	// in-place separable process, along y, by bands of adjacent columns
+	const long BandLanes = 256 / sizeof(T);
+	ParallelFor(0, (unsigned)((Line + BandLanes - 1) / BandLanes), 1, [&](unsigned first, unsigned last) {
+		for (unsigned band = first; band < last; band++) {
+			const long lane = band * BandLanes;
+			ConvertToInterpolationCoefficients(Image + lane, Height, Line, std::min(BandLanes, Line - lane), Pole, NbPoles, Tolerance);
+		}
+	});
 
 	return true;
 }
@@ -334,173 +290,149 @@ SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree
 // Interpolation routines
 
 /**
-Perform the bidimensional interpolation of an image.
-Given an array of spline coefficients, return the value of 
-the underlying continuous spline model, sampled at the location (x, y). 
+Compute the interpolation weights and indexes along one axis.
 The model degree can be 2 (quadratic), 3 (cubic), 4 (quartic), or 5 (quintic).
+Indexes are folded back into [0 .. Length) with mirror boundary conditions.
 
-@param Bcoeff Input B-spline array of coefficients
-@param Width Width of the image
-@param Height Height of the image
-@param x x coordinate where to interpolate
-@param y y coordinate where to interpolate
+@param x Coordinate where to interpolate
+@param Length Number of coefficients along the axis
 @param spline_degree Degree of the spline model
-@return Returns the value of the underlying continuous spline model, 
-sampled at the location (x, y)
+@param Weight Output weights, spline_degree + 1 values
+@param Index Output indexes, spline_degree + 1 values
 */
-static double 
-InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, long spline_degree) {
-	double	*p;
-	double	xWeight[6], yWeight[6];
-	double	interpolated;
+static void 
+InterpolationWeights(double x, long Length, long spline_degree, double *Weight, long *Index) {
 	double	w, w2, w4, t, t0, t1;
-	long	xIndex[6], yIndex[6];
-	long	Width2 = 2L * Width - 2L, Height2 = 2L * Height - 2L;
-	long	i, j, k;
+	long	Length2 = 2L * Length - 2L;
+	long	i, k;
 
 	// compute the interpolation indexes
 	if (spline_degree & 1L) {
 		i = (long)floor(x) - spline_degree / 2L;
-		j = (long)floor(y) - spline_degree / 2L;
-		for (k = 0; k <= spline_degree; k++) {
-			xIndex[k] = i++;
-			yIndex[k] = j++;
-		}
 	}
 	else {
 		i = (long)floor(x + 0.5) - spline_degree / 2L;
-		j = (long)floor(y + 0.5) - spline_degree / 2L;
-		for (k = 0; k <= spline_degree; k++) {
-			xIndex[k] = i++;
-			yIndex[k] = j++;
-		}
+	}
+	for (k = 0; k <= spline_degree; k++) {
+		Index[k] = i++;
 	}
 
 	// compute the interpolation weights
 	switch (spline_degree) {
 		case 2L:
-			/* x */
-			w = x - (double)xIndex[1];
-			xWeight[1] = 3.0 / 4.0 - w * w;
-			xWeight[2] = (1.0 / 2.0) * (w - xWeight[1] + 1.0);
-			xWeight[0] = 1.0 - xWeight[1] - xWeight[2];
-			/* y */
-			w = y - (double)yIndex[1];
-			yWeight[1] = 3.0 / 4.0 - w * w;
-			yWeight[2] = (1.0 / 2.0) * (w - yWeight[1] + 1.0);
-			yWeight[0] = 1.0 - yWeight[1] - yWeight[2];
+			w = x - (double)Index[1];
+			Weight[1] = 3.0 / 4.0 - w * w;
+			Weight[2] = (1.0 / 2.0) * (w - Weight[1] + 1.0);
+			Weight[0] = 1.0 - Weight[1] - Weight[2];
 			break;
 		case 3L:
-			/* x */
-			w = x - (double)xIndex[1];
-			xWeight[3] = (1.0 / 6.0) * w * w * w;
-			xWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - xWeight[3];
-			xWeight[2] = w + xWeight[0] - 2.0 * xWeight[3];
-			xWeight[1] = 1.0 - xWeight[0] - xWeight[2] - xWeight[3];
-			/* y */
-			w = y - (double)yIndex[1];
-			yWeight[3] = (1.0 / 6.0) * w * w * w;
-			yWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - yWeight[3];
-			yWeight[2] = w + yWeight[0] - 2.0 * yWeight[3];
-			yWeight[1] = 1.0 - yWeight[0] - yWeight[2] - yWeight[3];
+			w = x - (double)Index[1];
+			Weight[3] = (1.0 / 6.0) * w * w * w;
+			Weight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - Weight[3];
+			Weight[2] = w + Weight[0] - 2.0 * Weight[3];
+			Weight[1] = 1.0 - Weight[0] - Weight[2] - Weight[3];
 			break;
 		case 4L:
-			/* x */
-			w = x - (double)xIndex[2];
+			w = x - (double)Index[2];
 			w2 = w * w;
 			t = (1.0 / 6.0) * w2;
-			xWeight[0] = 1.0 / 2.0 - w;
-			xWeight[0] *= xWeight[0];
-			xWeight[0] *= (1.0 / 24.0) * xWeight[0];
+			Weight[0] = 1.0 / 2.0 - w;
+			Weight[0] *= Weight[0];
+			Weight[0] *= (1.0 / 24.0) * Weight[0];
 			t0 = w * (t - 11.0 / 24.0);
 			t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-			xWeight[1] = t1 + t0;
-			xWeight[3] = t1 - t0;
-			xWeight[4] = xWeight[0] + t0 + (1.0 / 2.0) * w;
-			xWeight[2] = 1.0 - xWeight[0] - xWeight[1] - xWeight[3] - xWeight[4];
-			/* y */
-			w = y - (double)yIndex[2];
-			w2 = w * w;
-			t = (1.0 / 6.0) * w2;
-			yWeight[0] = 1.0 / 2.0 - w;
-			yWeight[0] *= yWeight[0];
-			yWeight[0] *= (1.0 / 24.0) * yWeight[0];
-			t0 = w * (t - 11.0 / 24.0);
-			t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-			yWeight[1] = t1 + t0;
-			yWeight[3] = t1 - t0;
-			yWeight[4] = yWeight[0] + t0 + (1.0 / 2.0) * w;
-			yWeight[2] = 1.0 - yWeight[0] - yWeight[1] - yWeight[3] - yWeight[4];
+			Weight[1] = t1 + t0;
+			Weight[3] = t1 - t0;
+			Weight[4] = Weight[0] + t0 + (1.0 / 2.0) * w;
+			Weight[2] = 1.0 - Weight[0] - Weight[1] - Weight[3] - Weight[4];
 			break;
 		case 5L:
-			/* x */
-			w = x - (double)xIndex[2];
+			w = x - (double)Index[2];
 			w2 = w * w;
-			xWeight[5] = (1.0 / 120.0) * w * w2 * w2;
+			Weight[5] = (1.0 / 120.0) * w * w2 * w2;
 			w2 -= w;
 			w4 = w2 * w2;
 			w -= 1.0 / 2.0;
 			t = w2 * (w2 - 3.0);
-			xWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - xWeight[5];
+			Weight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - Weight[5];
 			t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
 			t1 = (-1.0 / 12.0) * w * (t + 4.0);
-			xWeight[2] = t0 + t1;
-			xWeight[3] = t0 - t1;
+			Weight[2] = t0 + t1;
+			Weight[3] = t0 - t1;
 			t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
 			t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-			xWeight[1] = t0 + t1;
-			xWeight[4] = t0 - t1;
-			/* y */
-			w = y - (double)yIndex[2];
-			w2 = w * w;
-			yWeight[5] = (1.0 / 120.0) * w * w2 * w2;
-			w2 -= w;
-			w4 = w2 * w2;
-			w -= 1.0 / 2.0;
-			t = w2 * (w2 - 3.0);
-			yWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - yWeight[5];
-			t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
-			t1 = (-1.0 / 12.0) * w * (t + 4.0);
-			yWeight[2] = t0 + t1;
-			yWeight[3] = t0 - t1;
-			t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
-			t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-			yWeight[1] = t0 + t1;
-			yWeight[4] = t0 - t1;
+			Weight[1] = t0 + t1;
+			Weight[4] = t0 - t1;
 			break;
-		default:
-			// Invalid spline degree
-			return 0;
 	}
 
 	// apply the mirror boundary conditions
 	for (k = 0; k <= spline_degree; k++) {
-		xIndex[k] = (Width == 1L) ? (0L) : ((xIndex[k] < 0L) ?
-			(-xIndex[k] - Width2 * ((-xIndex[k]) / Width2))
-			: (xIndex[k] - Width2 * (xIndex[k] / Width2)));
-		if (Width <= xIndex[k]) {
-			xIndex[k] = Width2 - xIndex[k];
-		}
-		yIndex[k] = (Height == 1L) ? (0L) : ((yIndex[k] < 0L) ?
-			(-yIndex[k] - Height2 * ((-yIndex[k]) / Height2))
-			: (yIndex[k] - Height2 * (yIndex[k] / Height2)));
-		if (Height <= yIndex[k]) {
-			yIndex[k] = Height2 - yIndex[k];
+		Index[k] = (Length == 1L) ? (0L) : ((Index[k] < 0L) ?
+			(-Index[k] - Length2 * ((-Index[k]) / Length2))
+			: (Index[k] - Length2 * (Index[k] / Length2)));
+		if (Length <= Index[k]) {
+			Index[k] = Length2 - Index[k];
 		}
 	}
+}
 
-	// perform interpolation
-	interpolated = 0.0;
-	for (j = 0; j <= spline_degree; j++) {
-		p = Bcoeff + (yIndex[j] * Width);
-		w = 0.0;
-		for (i = 0; i <= spline_degree; i++) {
-			w += xWeight[i] * p[xIndex[i]];
+/**
+Perform the bidimensional interpolation of a row of the output image.
+Weights are computed once per pixel and shared by all channels.
+
+@param Bcoeff Input B-spline array of coefficients, channels are interleaved
+@param Width Width of the image
+@param Height Height of the image
+@param dst_bits Output scanline
+@param x0 x coordinate where to interpolate the first pixel
+@param y0 y coordinate where to interpolate the first pixel
+@param dx x increment between two output pixels
+@param dy y increment between two output pixels
+@param spline_degree Degree of the spline model
+@param use_mask Whether or not to mask the image
+*/
+template <class T, long C> static void 
+InterpolateRow(const T *Bcoeff, long Width, long Height, uint8_t *dst_bits, double x0, double y0, double dx, double dy, long spline_degree, FIBOOL use_mask) {
+	double	xWeight[6], yWeight[6];
+	long	xIndex[6], yIndex[6];
+
+	for (long x = 0; x < Width; x++, dst_bits += C) {
+		const double x1 = x0 + dx * (double)x;
+		const double y1 = y0 + dy * (double)x;
+		if (use_mask) {
+			if ((x1 <= -0.5) || (((double)Width - 0.5) <= x1) || (y1 <= -0.5) || (((double)Height - 0.5) <= y1)) {
+				for (long c = 0; c < C; c++) {
+					dst_bits[c] = 0;
+				}
+				continue;
+			}
+		}
+		InterpolationWeights(x1, Width, spline_degree, xWeight, xIndex);
+		InterpolationWeights(y1, Height, spline_degree, yWeight, yIndex);
+
+		// perform interpolation
+		T interpolated[C] = {};
+		for (long j = 0; j <= spline_degree; j++) {
+			const T *p = Bcoeff + yIndex[j] * Width * C;
+			T w[C] = {};
+			for (long i = 0; i <= spline_degree; i++) {
+				const T *q = p + xIndex[i] * C;
+				const T weight = (T)xWeight[i];
+				for (long c = 0; c < C; c++) {
+					w[c] += weight * q[c];
+				}
+			}
+			const T weight = (T)yWeight[j];
+			for (long c = 0; c < C; c++) {
+				interpolated[c] += weight * w[c];
+			}
+		}
+		// clamp and convert to uint8_t
+		for (long c = 0; c < C; c++) {
+			dst_bits[c] = (uint8_t)MIN(MAX((int)0, (int)(interpolated[c] + (T)0.5)), (int)255);
 		}
-		interpolated += yWeight[j] * w;
 	}
-
-	return interpolated;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -509,8 +441,9 @@ InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, l
 
 /** 
  Image translation and rotation using B-Splines.
+ All channels are converted to coefficients of type T at once, output rows are computed in parallel.
 
- @param dib Input 8-bit greyscale image
+ @param dib Input 8-bit greyscale, 24 or 32-bit image
  @param angle Output image rotation in degree
  @param x_shift Output image horizontal shift
  @param y_shift Output image vertical shift
@@ -520,20 +453,17 @@ InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, l
  @param use_mask Whether or not to mask the image
  @return Returns the translated & rotated dib if successful, returns NULL otherwise
 */
-static FIBITMAP * 
-Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, FIBOOL use_mask) {
-	double	*ImageRasterArray;
-	double	p;
+template <class T> static FIBITMAP * 
+RotateSpline(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, FIBOOL use_mask) {
 	double	a11, a12, a21, a22;
-	double	x0, y0, x1, y1;
-	int		x, y;
+	double	x0, y0;
 	long	spline;
-	bool	bResult;
 
 	const int bpp = FreeImage_GetBPP(dib);
-	if (bpp != 8) {
+	if ((bpp != 8) && (bpp != 24) && (bpp != 32)) {
 		return nullptr;
 	}
+	const long channels = bpp / 8;
 	
 	const int width = FreeImage_GetWidth(dib);
 	const int height = FreeImage_GetHeight(dib);
@@ -555,37 +485,38 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 	}
 
 	// allocate output image
-	FIBITMAP *dst = FreeImage_Allocate(width, height, bpp);
+	FIBITMAP *dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 	if (!dst)
 		return nullptr;
-	// buid a grey scale palette
-	FIRGBA8 *pal = FreeImage_GetPalette(dst);
-	for (int i = 0; i < 256; i++) {
-		pal[i].red = pal[i].green = pal[i].blue = (uint8_t)i;
+	if (bpp == 8) {
+		// buid a grey scale palette
+		FIRGBA8 *pal = FreeImage_GetPalette(dst);
+		for (int i = 0; i < 256; i++) {
+			pal[i].red = pal[i].green = pal[i].blue = (uint8_t)i;
+		}
 	}
 
 	// allocate a temporary array
-	ImageRasterArray = (double*)malloc(width * sizeof(double) * height);
+	const size_t line = (size_t)width * channels;
+	T *ImageRasterArray = (T*)malloc(line * height * sizeof(T));
 	if (!ImageRasterArray) {
 		FreeImage_Unload(dst);
 		return nullptr;
 	}
 	// copy data samples
-	size_t rowOffset = 0;
-	for (y = 0; y < height; y++) {
-		double *pImage = &ImageRasterArray[rowOffset];
-		uint8_t *src_bits = FreeImage_GetScanLine(dib, height-1-y);
-
-		for (x = 0; x < width; x++) {
-			pImage[x] = (double)src_bits[x];
+	ParallelFor(0, height, CalculateBandRows(line * sizeof(T)), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			T *pImage = ImageRasterArray + y * line;
+			const uint8_t *src_bits = FreeImage_GetConstScanLine(dib, height-1-y);
+			for (size_t x = 0; x < line; x++) {
+				pImage[x] = (T)src_bits[x];
+			}
 		}
-		rowOffset += width;
-	}
+	});
 
 	// convert between a representation based on image samples
 	// and a representation based on image B-spline coefficients
-	bResult = SamplesToCoefficients(ImageRasterArray, width, height, spline);
-	if (!bResult) {
+	if (!SamplesToCoefficients(ImageRasterArray, width, height, channels, spline)) {
 		FreeImage_Unload(dst);
 		free(ImageRasterArray);
 		return nullptr;
@@ -603,30 +534,24 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 	y_shift = y_origin - y0;
 
 	// visit all pixels of the output image and assign their value
-	for (y = 0; y < height; y++) {
-		uint8_t *dst_bits = FreeImage_GetScanLine(dst, height-1-y);
-		
-		x0 = a12 * (double)y + x_shift;
-		y0 = a22 * (double)y + y_shift;
-
-		for (x = 0; x < width; x++) {
-			x1 = x0 + a11 * (double)x;
-			y1 = y0 + a21 * (double)x;
-			if (use_mask) {
-				if ((x1 <= -0.5) || (((double)width - 0.5) <= x1) || (y1 <= -0.5) || (((double)height - 0.5) <= y1)) {
-					p = 0;
-				}
-				else {
-					p = (double)InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
-				}
-			}
-			else {
-				p = (double)InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
+	ParallelFor(0, height, 1, [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; y++) {
+			uint8_t *dst_bits = FreeImage_GetScanLine(dst, height-1-y);
+			const double row_x = a12 * (double)y + x_shift;
+			const double row_y = a22 * (double)y + y_shift;
+			switch (channels) {
+				case 1:
+					InterpolateRow<T, 1>(ImageRasterArray, width, height, dst_bits, row_x, row_y, a11, a21, spline, use_mask);
+					break;
+				case 3:
+					InterpolateRow<T, 3>(ImageRasterArray, width, height, dst_bits, row_x, row_y, a11, a21, spline, use_mask);
+					break;
+				case 4:
+					InterpolateRow<T, 4>(ImageRasterArray, width, height, dst_bits, row_x, row_y, a11, a21, spline, use_mask);
+					break;
 			}
-			// clamp and convert to uint8_t
-			dst_bits[x] = (uint8_t)MIN(MAX((int)0, (int)(p + 0.5)), (int)255);
 		}
-	}
+	});
 
 	// free working array and return
 	free(ImageRasterArray);
@@ -636,6 +561,7 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 
 /** 
  Image rotation using a 3rd order (cubic) B-Splines.
+ Coefficients are computed in single precision, which is plenty for 8-bit samples.
 
  @param dib Input dib (8, 24 or 32-bit)
  @param angle Output image rotation
@@ -648,85 +574,17 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 */
 FIBITMAP * DLL_CALLCONV 
 FreeImage_RotateEx(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, FIBOOL use_mask) {
-
-	int x, y, bpp;
-	int channel, nb_channels;
-	uint8_t *src_bits, *dst_bits;
-	FIBITMAP *src8{}, *dst8{}, *dst{};
-
 	if (!FreeImage_HasPixels(dib)) return nullptr;
 
-	try {
-
-		bpp = FreeImage_GetBPP(dib);
-
-		if (bpp == 8) {
-			FIBITMAP *dst_8 = Rotate8Bit(dib, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask);
-			if (dst_8) {
-				// copy metadata from src to dst
-				FreeImage_CloneMetadata(dst_8, dib);
-			}
-			return dst_8;
-		}
-		if ((bpp == 24) || (bpp == 32)) {
-			// allocate dst image
-			const int width  = FreeImage_GetWidth(dib);
-			const int height = FreeImage_GetHeight(dib);
-			if (bpp == 24) {
-				dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-			} else {
-				dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-			}
-			if (!dst) throw(1);
-
-			// allocate a temporary 8-bit dib (no need to build a palette)
-			src8 = FreeImage_Allocate(width, height, 8);
-			if (!src8) throw(1);
-
-			// process each channel separately
-			// -------------------------------
-			nb_channels = (bpp / 8);
-
-			for (channel = 0; channel < nb_channels; channel++) {
-				// extract channel from source dib
-				for (y = 0; y < height; y++) {
-					src_bits = FreeImage_GetScanLine(dib, y);
-					dst_bits = FreeImage_GetScanLine(src8, y);
-					for (x = 0; x < width; x++) {
-						dst_bits[x] = src_bits[channel];
-						src_bits += nb_channels;
-					}
-				}
-
-				// process channel
-				dst8 = Rotate8Bit(src8, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask);
-				if (!dst8) throw(1);
-
-				// insert channel to destination dib
-				for (y = 0; y < height; y++) {
-					src_bits = FreeImage_GetScanLine(dst8, y);
-					dst_bits = FreeImage_GetScanLine(dst, y);
-					for (x = 0; x < width; x++) {
-						dst_bits[channel] = src_bits[x];
-						dst_bits += nb_channels;
-					}
-				}
-
-				FreeImage_Unload(dst8);
-			}
-
-			FreeImage_Unload(src8);
-
-			// copy metadata from src to dst
-			FreeImage_CloneMetadata(dst, dib);
-			
-			return dst;
-		}
-	} catch(int) {
-		if (src8) FreeImage_Unload(src8);
-		if (dst8) FreeImage_Unload(dst8);
-		if (dst)  FreeImage_Unload(dst);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	if ((bpp != 8) && (bpp != 24) && (bpp != 32)) {
+		return nullptr;
 	}
 
-	return nullptr;
+	FIBITMAP *dst = RotateSpline<float>(dib, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask);
+	if (dst) {
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(dst, dib);
+	}
+	return dst;
 }
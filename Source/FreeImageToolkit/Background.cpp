@@ -311,16 +311,14 @@ FillBackgroundBitmap(FIBITMAP *dib, const FIRGBA8 *color, int options) {
 		}
 		case 16: {
 			uint16_t wcolor = RGBQUAD_TO_WORD(dib, color_intl);
-			for (unsigned x = 0; x < width; x++) {
-				((uint16_t *)dst_bits)[x] = wcolor;
-			}
+			memcpy(dst_bits, &wcolor, sizeof(wcolor));
+			RepeatPattern(dst_bits, sizeof(wcolor), FreeImage_GetLine(dib));
 			break;
 		}
 		case 24: {
 			FIRGB8 rgbt = *((FIRGB8 *)color_intl);
-			for (unsigned x = 0; x < width; x++) {
-				((FIRGB8 *)dst_bits)[x] = rgbt;
-			}
+			memcpy(dst_bits, &rgbt, sizeof(rgbt));
+			RepeatPattern(dst_bits, sizeof(rgbt), FreeImage_GetLine(dib));
 			break;
 		}
 		case 32: {
@@ -329,9 +327,8 @@ FillBackgroundBitmap(FIBITMAP *dib, const FIRGBA8 *color, int options) {
 			rgbq.green = ((FIRGB8 *)color_intl)->green;
 			rgbq.red   = ((FIRGB8 *)color_intl)->red;
 			rgbq.alpha = 0xFF;
-			for (unsigned x = 0; x < width; x++) {
-				((FIRGBA8 *)dst_bits)[x] = rgbq;
-			}
+			memcpy(dst_bits, &rgbq, sizeof(rgbq));
+			RepeatPattern(dst_bits, sizeof(rgbq), FreeImage_GetLine(dib));
 			break;
 		}
 		default:
@@ -342,13 +339,7 @@ FillBackgroundBitmap(FIBITMAP *dib, const FIRGBA8 *color, int options) {
 	// 'src_bits' is a pointer to the first scanline and is already
 	// set up correctly.
 	if (src_bits) {
-		unsigned pitch = FreeImage_GetPitch(dib);
-		unsigned bytes = FreeImage_GetLine(dib);
-		dst_bits = src_bits + pitch;
-		for (unsigned y = 1; y < height; y++) {
-			memcpy(dst_bits, src_bits, bytes);
-			dst_bits += pitch;
-		}
+		FillScanLines(src_bits, FreeImage_GetPitch(dib), height, src_bits, FreeImage_GetLine(dib));
 	}
 	return TRUE;
 }
@@ -434,23 +425,13 @@ FreeImage_FillBackground(FIBITMAP *dib, const void *color, int options) {
 	}
 	
 	// first, construct the first scanline (bottom line)
-	unsigned bytespp = (FreeImage_GetBPP(dib) / 8);
+	const unsigned bytespp = (FreeImage_GetBPP(dib) / 8);
 	uint8_t *src_bits = FreeImage_GetScanLine(dib, 0);
-	uint8_t *dst_bits = src_bits;
-	for (unsigned x = 0; x < FreeImage_GetWidth(dib); x++) {
-		memcpy(dst_bits, color, bytespp);
-		dst_bits += bytespp;
-	}
+	memcpy(src_bits, color, bytespp);
+	RepeatPattern(src_bits, bytespp, FreeImage_GetLine(dib));
 
 	// then, copy the first scanline into all following scanlines
-	unsigned height = FreeImage_GetHeight(dib);
-	unsigned pitch = FreeImage_GetPitch(dib);
-	unsigned bytes = FreeImage_GetLine(dib);
-	dst_bits = src_bits + pitch;
-	for (unsigned y = 1; y < height; y++) {
-		memcpy(dst_bits, src_bits, bytes);
-		dst_bits += pitch;
-	}
+	FillScanLines(src_bits, FreeImage_GetPitch(dib), FreeImage_GetHeight(dib), src_bits, FreeImage_GetLine(dib));
 	return TRUE;
 }
 
@@ -725,6 +706,13 @@ FreeImage_AllocateEx(int width, int height, int bpp, const FIRGBA8 *color, int o
  be larger than the input image. Thus, since the specified color is not needed in these cases,
  the pointer color may be NULL.
 
+ When option FI_CANVAS_VIEW is set, such a crop returns a view sharing the pixels of src
+ instead of a copy, whenever FreeImage_CreateView supports the rectangle. The view must be
+ unloaded before src.
+
+ When the image is enlarged, only the added borders are filled with the color, while the
+ pixels of src are copied once into the interior of the new image.
+
  Both parameters color and options work according to function FreeImage_FillBackground. So,
  please refer to the documentation of FreeImage_FillBackground to learn more about parameters
  color and options. For palletized images, the palette of the input image src is
@@ -766,7 +754,8 @@ FreeImage_AllocateEx(int width, int height, int bpp, const FIRGBA8 *color, int o
  @param bottom The number of pixels, the image should be enlarged on its bottom side. Negative
  values shrink the image on its bottom side.
  @param color The color, the enlarged sides of the image should be filled with.
- @param options Options that affect the color search process for palletized images.
+ @param options Options that affect the color search process for palletized images,
+ optionally combined with FI_CANVAS_VIEW.
  @return Returns a pointer to a newly allocated enlarged or shrunken image on success,
  NULL otherwise. This function fails if either the input image is NULL or the pointer to the
  color is NULL, while at least on of left, top, right and bottom is greater than zero. This
@@ -789,10 +778,12 @@ FreeImage_EnlargeCanvas(FIBITMAP *src, int left, int top, int right, int bottom,
 
 	// Relay on FreeImage_Copy, if all parameters left, top, right and
 	// bottom are smaller than or equal zero. The color pointer may be
-	// NULL in this case.
+	// NULL in this case. With FI_CANVAS_VIEW, the crop shares the pixels of src.
 	if ((left <= 0) && (right <= 0) && (top <= 0) && (bottom <= 0)) {
-		return FreeImage_Copy(src, -left, -top,	width + right, height + bottom);
+		return FreeImage_Copy(src, -left, -top,	width + right, height + bottom,
+			(options & FI_CANVAS_VIEW) ? FI_COPY_VIEW : FI_COPY_DEFAULT);
 	}
+	options &= ~FI_CANVAS_VIEW;
 
 	// From here, we need a valid color, since the image will be enlarged on
 	// at least one side. So, fail if we don't have a valid color pointer.
@@ -811,18 +802,20 @@ FreeImage_EnlargeCanvas(FIBITMAP *src, int left, int top, int right, int bottom,
 	FREE_IMAGE_TYPE type = FreeImage_GetImageType(src);
 	unsigned bpp = FreeImage_GetBPP(src);
 
-	FIBITMAP *dst = FreeImage_AllocateExT(
-		type, newWidth, newHeight, bpp, color, options,
-		FreeImage_GetPalette(src),
-		FreeImage_GetRedMask(src),
-		FreeImage_GetGreenMask(src),
-		FreeImage_GetBlueMask(src));
-
-	if (!dst) {
-		return nullptr;
-	}
+	FIBITMAP *dst = nullptr;
 
 	if ((type == FIT_BITMAP) && (bpp <= 4)) {
+		dst = FreeImage_AllocateExT(
+			type, newWidth, newHeight, bpp, color, options,
+			FreeImage_GetPalette(src),
+			FreeImage_GetRedMask(src),
+			FreeImage_GetGreenMask(src),
+			FreeImage_GetBlueMask(src));
+
+		if (!dst) {
+			return nullptr;
+		}
+
 		FIBITMAP *copy = FreeImage_Copy(src,
 			((left >= 0) ? 0 : -left),
 			((top >= 0) ? 0 : -top),
@@ -846,27 +839,61 @@ FreeImage_EnlargeCanvas(FIBITMAP *src, int left, int top, int right, int bottom,
 
 	} else {
 
-		int bytespp = bpp / 8;
-		uint8_t *srcPtr = FreeImage_GetScanLine(src, height - 1 - ((top >= 0) ? 0 : -top));
-		uint8_t *dstPtr = FreeImage_GetScanLine(dst, newHeight - 1 - ((top <= 0) ? 0 : top));
-
-		unsigned srcPitch = FreeImage_GetPitch(src);
-		unsigned dstPitch = FreeImage_GetPitch(dst);
-
-		int lineWidth = bytespp * (width + MIN(0, left) + MIN(0, right));
-		int lines = height + MIN(0, top) + MIN(0, bottom);
-
-		if (left <= 0) {
-			srcPtr += (-left * bytespp);
-		} else {
-			dstPtr += (left * bytespp);
+		// a single scanline filled with the background color, built by
+		// FreeImage_AllocateExT so that palette lookups and 16-bit masks
+		// resolve exactly as for a fully filled canvas
+		FIBITMAP *border = FreeImage_AllocateExT(
+			type, newWidth, 1, bpp, color, options,
+			FreeImage_GetPalette(src),
+			FreeImage_GetRedMask(src),
+			FreeImage_GetGreenMask(src),
+			FreeImage_GetBlueMask(src));
+
+		// the canvas itself is not filled: every pixel is written exactly once below
+		dst = border ? FreeImage_AllocateExT(
+			type, newWidth, newHeight, bpp, nullptr, 0,
+			FreeImage_GetPalette(src),
+			FreeImage_GetRedMask(src),
+			FreeImage_GetGreenMask(src),
+			FreeImage_GetBlueMask(src)) : nullptr;
+
+		if (!dst) {
+			FreeImage_Unload(border);
+			return nullptr;
 		}
 
-		for (int i = 0; i < lines; i++) {
-			memcpy(dstPtr, srcPtr, lineWidth);
-			srcPtr -= srcPitch;
-			dstPtr -= dstPitch;
-		}
+		const unsigned bytespp = bpp / 8;
+		const unsigned srcPitch = FreeImage_GetPitch(src);
+		const unsigned dstPitch = FreeImage_GetPitch(dst);
+		const unsigned dstLine = FreeImage_GetLine(dst);
+		const uint8_t *fill = FreeImage_GetConstBits(border);
+		uint8_t *dstBits = FreeImage_GetBits(dst);
+
+		// scanlines are stored bottom-up, so the bottom border comes first
+		const unsigned bottomLines = MAX(0, bottom);
+		const unsigned topLines = MAX(0, top);
+		const unsigned lines = newHeight - bottomLines - topLines;
+
+		FillScanLines(dstBits, dstPitch, bottomLines, fill, dstLine);
+		FillScanLines(dstBits + (size_t)dstPitch * (bottomLines + lines), dstPitch, topLines, fill, dstLine);
+
+		// interior scanlines: left border, source pixels and right border
+		const size_t leftBytes = (size_t)bytespp * MAX(0, left);
+		const size_t lineBytes = (size_t)bytespp * (width + MIN(0, left) + MIN(0, right));
+		const size_t rightBytes = dstLine - leftBytes - lineBytes;
+		const uint8_t *srcBits = FreeImage_GetConstBits(src)
+			+ (size_t)srcPitch * MAX(0, -bottom) + (size_t)bytespp * MAX(0, -left);
+
+		ParallelFor(0, lines, CalculateBandRows(dstLine), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; ++y) {
+				uint8_t *dstPtr = dstBits + (size_t)dstPitch * (bottomLines + y);
+				memcpy(dstPtr, fill, leftBytes);
+				memcpy(dstPtr + leftBytes, srcBits + (size_t)srcPitch * y, lineBytes);
+				memcpy(dstPtr + leftBytes + lineBytes, fill + leftBytes + lineBytes, rightBytes);
+			}
+		});
+
+		FreeImage_Unload(border);
 	}
 
 	// copy metadata from src to dst
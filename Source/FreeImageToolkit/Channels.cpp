@@ -21,6 +21,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "../FreeImage/CPUDispatch.h"
+#include <atomic>
 
 
 /** @brief Retrieves the red, green, blue or alpha channel of a BGR[A] image. 
@@ -486,3 +488,459 @@ FreeImage_SetComplexChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANN
 
 	return TRUE;
 }
+
+// ----------------------------------------------------------
+//   Planar split / merge of all channels
+// ----------------------------------------------------------
+
+namespace {
+
+	/// De-interleaves the first pixels of a row into planes (in memory order of the channels), returns the number of pixels done
+	using SplitKernel = unsigned (*)(const uint8_t *src, uint8_t *const *planes, unsigned width);
+	/// Interleaves the first pixels of planes (in memory order of the channels) into a row, returns the number of pixels done
+	using MergeKernel = unsigned (*)(uint8_t *dst, const uint8_t *const *planes, unsigned width);
+
+	template <typename T, unsigned N>
+	void SplitRow(const uint8_t *src, uint8_t *const *planes, unsigned first, unsigned width) {
+		const T *pixel = reinterpret_cast<const T *>(src);
+		for (unsigned x = first; x < width; x++) {
+			for (unsigned c = 0; c < N; c++) {
+				reinterpret_cast<T *>(planes[c])[x] = pixel[x * N + c];
+			}
+		}
+	}
+
+	template <typename T, unsigned N>
+	void MergeRow(uint8_t *dst, const uint8_t *const *planes, unsigned first, unsigned width) {
+		T *pixel = reinterpret_cast<T *>(dst);
+		for (unsigned x = first; x < width; x++) {
+			for (unsigned c = 0; c < N; c++) {
+				pixel[x * N + c] = reinterpret_cast<const T *>(planes[c])[x];
+			}
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+
+	/**
+	PSHUFB masks for N channels of S bytes. A block of 16 bytes of every plane is N registers of interleaved pixels:
+	split[c][r] gathers the bytes of channel c held by the source register r, merge[r][c] places the bytes
+	of the plane c into the destination register r. Unused lanes are 0x80 so the shuffled registers can be ORed.
+	*/
+	template <unsigned S, unsigned N>
+	struct ShuffleMasks {
+		alignas(16) uint8_t split[N][N][16];
+		alignas(16) uint8_t merge[N][N][16];
+
+		ShuffleMasks() {
+			for (unsigned c = 0; c < N; c++) {
+				for (unsigned r = 0; r < N; r++) {
+					for (unsigned j = 0; j < 16; j++) {
+						const unsigned pos = ((j / S) * N + c) * S + j % S;
+						split[c][r][j] = (pos / 16 == r) ? (uint8_t)(pos % 16) : 0x80;
+
+						const unsigned element = (16 * r + j) / S;
+						merge[r][c][j] = (element % N == c) ? (uint8_t)((element / N) * S + j % S) : 0x80;
+					}
+				}
+			}
+		}
+	};
+
+	template <unsigned S, unsigned N>
+	FI_TARGET("ssse3")
+	unsigned SplitRow_SSSE3(const uint8_t *src, uint8_t *const *planes, unsigned width) {
+		static const ShuffleMasks<S, N> masks;
+		__m128i mask[N][N];
+		for (unsigned c = 0; c < N; c++) {
+			for (unsigned r = 0; r < N; r++) {
+				mask[c][r] = _mm_load_si128((const __m128i *)masks.split[c][r]);
+			}
+		}
+		constexpr unsigned step = 16 / S;
+		unsigned x = 0;
+		for (; x + step <= width; x += step) {
+			__m128i in[N];
+			for (unsigned r = 0; r < N; r++) {
+				in[r] = _mm_loadu_si128((const __m128i *)(src + (size_t)x * N * S + 16 * r));
+			}
+			for (unsigned c = 0; c < N; c++) {
+				__m128i v = _mm_shuffle_epi8(in[0], mask[c][0]);
+				for (unsigned r = 1; r < N; r++) {
+					v = _mm_or_si128(v, _mm_shuffle_epi8(in[r], mask[c][r]));
+				}
+				_mm_storeu_si128((__m128i *)(planes[c] + (size_t)x * S), v);
+			}
+		}
+		return x;
+	}
+
+	template <unsigned S, unsigned N>
+	FI_TARGET("ssse3")
+	unsigned MergeRow_SSSE3(uint8_t *dst, const uint8_t *const *planes, unsigned width) {
+		static const ShuffleMasks<S, N> masks;
+		__m128i mask[N][N];
+		for (unsigned r = 0; r < N; r++) {
+			for (unsigned c = 0; c < N; c++) {
+				mask[r][c] = _mm_load_si128((const __m128i *)masks.merge[r][c]);
+			}
+		}
+		constexpr unsigned step = 16 / S;
+		unsigned x = 0;
+		for (; x + step <= width; x += step) {
+			__m128i in[N];
+			for (unsigned c = 0; c < N; c++) {
+				in[c] = _mm_loadu_si128((const __m128i *)(planes[c] + (size_t)x * S));
+			}
+			for (unsigned r = 0; r < N; r++) {
+				__m128i v = _mm_shuffle_epi8(in[0], mask[r][0]);
+				for (unsigned c = 1; c < N; c++) {
+					v = _mm_or_si128(v, _mm_shuffle_epi8(in[c], mask[r][c]));
+				}
+				_mm_storeu_si128((__m128i *)(dst + (size_t)x * N * S + 16 * r), v);
+			}
+		}
+		return x;
+	}
+
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+
+	/// VLD3 / VLD4 de-interleave 16 bytes of every channel at once
+	template <unsigned S, unsigned N>
+	unsigned SplitRow_NEON(const uint8_t *src, uint8_t *const *planes, unsigned width) {
+		constexpr unsigned step = 16 / S;
+		unsigned x = 0;
+		for (; x + step <= width; x += step) {
+			const uint8_t *s = src + (size_t)x * N * S;
+			if constexpr (S == 1) {
+				if constexpr (N == 3) {
+					const uint8x16x3_t v = vld3q_u8(s);
+					for (unsigned c = 0; c < N; c++) vst1q_u8(planes[c] + x, v.val[c]);
+				} else {
+					const uint8x16x4_t v = vld4q_u8(s);
+					for (unsigned c = 0; c < N; c++) vst1q_u8(planes[c] + x, v.val[c]);
+				}
+			} else if constexpr (S == 2) {
+				if constexpr (N == 3) {
+					const uint16x8x3_t v = vld3q_u16((const uint16_t *)s);
+					for (unsigned c = 0; c < N; c++) vst1q_u16((uint16_t *)planes[c] + x, v.val[c]);
+				} else {
+					const uint16x8x4_t v = vld4q_u16((const uint16_t *)s);
+					for (unsigned c = 0; c < N; c++) vst1q_u16((uint16_t *)planes[c] + x, v.val[c]);
+				}
+			} else {
+				if constexpr (N == 3) {
+					const uint32x4x3_t v = vld3q_u32((const uint32_t *)s);
+					for (unsigned c = 0; c < N; c++) vst1q_u32((uint32_t *)planes[c] + x, v.val[c]);
+				} else {
+					const uint32x4x4_t v = vld4q_u32((const uint32_t *)s);
+					for (unsigned c = 0; c < N; c++) vst1q_u32((uint32_t *)planes[c] + x, v.val[c]);
+				}
+			}
+		}
+		return x;
+	}
+
+	/// VST3 / VST4 interleave 16 bytes of every plane at once
+	template <unsigned S, unsigned N>
+	unsigned MergeRow_NEON(uint8_t *dst, const uint8_t *const *planes, unsigned width) {
+		constexpr unsigned step = 16 / S;
+		unsigned x = 0;
+		for (; x + step <= width; x += step) {
+			uint8_t *d = dst + (size_t)x * N * S;
+			if constexpr (S == 1) {
+				if constexpr (N == 3) {
+					uint8x16x3_t v;
+					for (unsigned c = 0; c < N; c++) v.val[c] = vld1q_u8(planes[c] + x);
+					vst3q_u8(d, v);
+				} else {
+					uint8x16x4_t v;
+					for (unsigned c = 0; c < N; c++) v.val[c] = vld1q_u8(planes[c] + x);
+					vst4q_u8(d, v);
+				}
+			} else if constexpr (S == 2) {
+				if constexpr (N == 3) {
+					uint16x8x3_t v;
+					for (unsigned c = 0; c < N; c++) v.val[c] = vld1q_u16((const uint16_t *)planes[c] + x);
+					vst3q_u16((uint16_t *)d, v);
+				} else {
+					uint16x8x4_t v;
+					for (unsigned c = 0; c < N; c++) v.val[c] = vld1q_u16((const uint16_t *)planes[c] + x);
+					vst4q_u16((uint16_t *)d, v);
+				}
+			} else {
+				if constexpr (N == 3) {
+					uint32x4x3_t v;
+					for (unsigned c = 0; c < N; c++) v.val[c] = vld1q_u32((const uint32_t *)planes[c] + x);
+					vst3q_u32((uint32_t *)d, v);
+				} else {
+					uint32x4x4_t v;
+					for (unsigned c = 0; c < N; c++) v.val[c] = vld1q_u32((const uint32_t *)planes[c] + x);
+					vst4q_u32((uint32_t *)d, v);
+				}
+			}
+		}
+		return x;
+	}
+
+#endif // FREEIMAGE_SIMD_NEON
+
+	/// Kernels by channel size (1, 2 or 4 bytes) and channels number (3 or 4), null entries use the scalar code
+	std::atomic<SplitKernel> gSplitKernels[3][2];
+	std::atomic<MergeKernel> gMergeKernels[3][2];
+
+	void SelectChannelKernels(unsigned features) {
+		SplitKernel split[3][2] = {};
+		MergeKernel merge[3][2] = {};
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSSE3) {
+			split[0][0] = SplitRow_SSSE3<1, 3>; split[0][1] = SplitRow_SSSE3<1, 4>;
+			split[1][0] = SplitRow_SSSE3<2, 3>; split[1][1] = SplitRow_SSSE3<2, 4>;
+			split[2][0] = SplitRow_SSSE3<4, 3>; split[2][1] = SplitRow_SSSE3<4, 4>;
+			merge[0][0] = MergeRow_SSSE3<1, 3>; merge[0][1] = MergeRow_SSSE3<1, 4>;
+			merge[1][0] = MergeRow_SSSE3<2, 3>; merge[1][1] = MergeRow_SSSE3<2, 4>;
+			merge[2][0] = MergeRow_SSSE3<4, 3>; merge[2][1] = MergeRow_SSSE3<4, 4>;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			split[0][0] = SplitRow_NEON<1, 3>; split[0][1] = SplitRow_NEON<1, 4>;
+			split[1][0] = SplitRow_NEON<2, 3>; split[1][1] = SplitRow_NEON<2, 4>;
+			split[2][0] = SplitRow_NEON<4, 3>; split[2][1] = SplitRow_NEON<4, 4>;
+			merge[0][0] = MergeRow_NEON<1, 3>; merge[0][1] = MergeRow_NEON<1, 4>;
+			merge[1][0] = MergeRow_NEON<2, 3>; merge[1][1] = MergeRow_NEON<2, 4>;
+			merge[2][0] = MergeRow_NEON<4, 3>; merge[2][1] = MergeRow_NEON<4, 4>;
+		}
+#endif
+		for (unsigned i = 0; i < 3; i++) {
+			for (unsigned j = 0; j < 2; j++) {
+				gSplitKernels[i][j].store(split[i][j], std::memory_order_relaxed);
+				gMergeKernels[i][j].store(merge[i][j], std::memory_order_relaxed);
+			}
+		}
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectChannelKernels);
+
+	template <typename T>
+	constexpr unsigned SizeIndex() {
+		return (sizeof(T) == 1) ? 0 : (sizeof(T) == 2) ? 1 : 2;
+	}
+
+	/// Splits src into planes (in memory order of the channels) by parallel bands of scanlines
+	template <typename T, unsigned N>
+	void SplitPixels(FIBITMAP *src, FIBITMAP *const *planes) {
+		const unsigned width  = FreeImage_GetWidth(src);
+		const unsigned height = FreeImage_GetHeight(src);
+		const unsigned src_pitch = FreeImage_GetPitch(src);
+		const unsigned dst_pitch = FreeImage_GetPitch(planes[0]);
+		const uint8_t *src_base = FreeImage_GetConstBits(src);
+		uint8_t *dst_base[N];
+		for (unsigned c = 0; c < N; c++) {
+			dst_base[c] = FreeImage_GetBits(planes[c]);
+		}
+		const SplitKernel kernel = gSplitKernels[SizeIndex<T>()][N - 3].load(std::memory_order_relaxed);
+		ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(src)), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				const uint8_t *src_bits = src_base + (size_t)src_pitch * y;
+				uint8_t *dst_bits[N];
+				for (unsigned c = 0; c < N; c++) {
+					dst_bits[c] = dst_base[c] + (size_t)dst_pitch * y;
+				}
+				const unsigned x = kernel ? kernel(src_bits, dst_bits, width) : 0;
+				SplitRow<T, N>(src_bits, dst_bits, x, width);
+			}
+		});
+	}
+
+	/// Interleaves planes (in memory order of the channels) into dst by parallel bands of scanlines
+	template <typename T, unsigned N>
+	void MergePixels(FIBITMAP *dst, FIBITMAP *const *planes) {
+		const unsigned width  = FreeImage_GetWidth(dst);
+		const unsigned height = FreeImage_GetHeight(dst);
+		const unsigned dst_pitch = FreeImage_GetPitch(dst);
+		uint8_t *dst_base = FreeImage_GetBits(dst);
+		const uint8_t *src_base[N];
+		unsigned src_pitch[N];
+		for (unsigned c = 0; c < N; c++) {
+			src_base[c] = FreeImage_GetConstBits(planes[c]);
+			src_pitch[c] = FreeImage_GetPitch(planes[c]);
+		}
+		const MergeKernel kernel = gMergeKernels[SizeIndex<T>()][N - 3].load(std::memory_order_relaxed);
+		ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(dst)), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				uint8_t *dst_bits = dst_base + (size_t)dst_pitch * y;
+				const uint8_t *src_bits[N];
+				for (unsigned c = 0; c < N; c++) {
+					src_bits[c] = src_base[c] + (size_t)src_pitch[c] * y;
+				}
+				const unsigned x = kernel ? kernel(dst_bits, src_bits, width) : 0;
+				MergeRow<T, N>(dst_bits, src_bits, x, width);
+			}
+		});
+	}
+
+	/**
+	Returns the type of the planes of an interleaved image type, FIT_UNKNOWN if not supported,
+	and orders the channels indices by their position in memory
+	*/
+	FREE_IMAGE_TYPE GetPlaneType(FREE_IMAGE_TYPE image_type, unsigned order[4]) {
+		for (unsigned c = 0; c < 4; c++) {
+			order[c] = c;
+		}
+		switch (image_type) {
+			case FIT_BITMAP:
+				order[FI_RGBA_RED]   = 0;
+				order[FI_RGBA_GREEN] = 1;
+				order[FI_RGBA_BLUE]  = 2;
+				order[FI_RGBA_ALPHA] = 3;
+				return FIT_BITMAP;
+			case FIT_RGB16:
+			case FIT_RGBA16:
+				return FIT_UINT16;
+			case FIT_RGBF:
+			case FIT_RGBAF:
+				return FIT_FLOAT;
+			default:
+				return FIT_UNKNOWN;
+		}
+	}
+
+} // namespace
+
+/** @brief Splits all the channels of a RGB[A] image in one pass.
+@param dib Input image to be processed (24- or 32-bit, RGB[A]16 or RGB[A]F).
+@param planes Receives FreeImage_GetChannelsNumber(dib) greyscale images in red, green, blue, alpha order.
+@return Returns TRUE if successful, FALSE otherwise.
+*/
+FIBOOL DLL_CALLCONV
+FreeImage_SplitChannels(FIBITMAP *dib, FIBITMAP **planes) {
+	if (!FreeImage_HasPixels(dib) || !planes) return FALSE;
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	if ((image_type == FIT_BITMAP) && (bpp != 24) && (bpp != 32)) {
+		return FALSE;
+	}
+	unsigned order[4];
+	const FREE_IMAGE_TYPE plane_type = GetPlaneType(image_type, order);
+	if (plane_type == FIT_UNKNOWN) {
+		return FALSE;
+	}
+
+	// allocate the planes
+	const unsigned channels = FreeImage_GetChannelsNumber(dib);
+	const unsigned width  = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	FIBITMAP *result[4] = {};
+	for (unsigned c = 0; c < channels; c++) {
+		result[c] = FreeImage_AllocateT(plane_type, width, height, 8);
+		if (!result[c]) {
+			for (unsigned i = 0; i < c; i++) {
+				FreeImage_Unload(result[i]);
+			}
+			return FALSE;
+		}
+		if (plane_type == FIT_BITMAP) {
+			// build a greyscale palette
+			FIRGBA8 *pal = FreeImage_GetPalette(result[c]);
+			for (int i = 0; i < 256; i++) {
+				pal[i].blue = pal[i].green = pal[i].red = (uint8_t)i;
+			}
+		}
+	}
+
+	// perform extraction
+	FIBITMAP *memory_planes[4];
+	for (unsigned c = 0; c < channels; c++) {
+		memory_planes[c] = result[order[c]];
+	}
+	switch (plane_type) {
+		case FIT_BITMAP:
+			(channels == 4) ? SplitPixels<uint8_t, 4>(dib, memory_planes) : SplitPixels<uint8_t, 3>(dib, memory_planes);
+			break;
+		case FIT_UINT16:
+			(channels == 4) ? SplitPixels<uint16_t, 4>(dib, memory_planes) : SplitPixels<uint16_t, 3>(dib, memory_planes);
+			break;
+		default:
+			(channels == 4) ? SplitPixels<uint32_t, 4>(dib, memory_planes) : SplitPixels<uint32_t, 3>(dib, memory_planes);
+			break;
+	}
+
+	for (unsigned c = 0; c < channels; c++) {
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(result[c], dib);
+		planes[c] = result[c];
+	}
+
+	return TRUE;
+}
+
+/** @brief Interleaves greyscale images into a RGB[A] image in one pass.
+@param planes Red, green, blue [and alpha] images of the same size and type (8-bit greyscale, FIT_UINT16 or FIT_FLOAT).
+@param count Number of planes, 3 or 4.
+@return Returns a 24- or 32-bit, RGB[A]16 or RGB[A]F image if successful, returns NULL otherwise.
+*/
+FIBITMAP * DLL_CALLCONV
+FreeImage_MergeChannels(FIBITMAP **planes, unsigned count) {
+	if (!planes || ((count != 3) && (count != 4))) return nullptr;
+
+	for (unsigned c = 0; c < count; c++) {
+		if (!FreeImage_HasPixels(planes[c])) return nullptr;
+	}
+
+	// planes should have the same type, width and height
+	const FREE_IMAGE_TYPE plane_type = FreeImage_GetImageType(planes[0]);
+	const unsigned width  = FreeImage_GetWidth(planes[0]);
+	const unsigned height = FreeImage_GetHeight(planes[0]);
+	for (unsigned c = 0; c < count; c++) {
+		if ((FreeImage_GetImageType(planes[c]) != plane_type) || (FreeImage_GetWidth(planes[c]) != width) || (FreeImage_GetHeight(planes[c]) != height)) {
+			return nullptr;
+		}
+		if ((plane_type == FIT_BITMAP) && ((FreeImage_GetBPP(planes[c]) != 8) || (FreeImage_GetColorType(planes[c]) != FIC_MINISBLACK))) {
+			return nullptr;
+		}
+	}
+
+	FIBITMAP *dst = nullptr;
+	switch (plane_type) {
+		case FIT_BITMAP:
+			dst = FreeImage_Allocate(width, height, 8 * count);
+			break;
+		case FIT_UINT16:
+			dst = FreeImage_AllocateT((count == 4) ? FIT_RGBA16 : FIT_RGB16, width, height);
+			break;
+		case FIT_FLOAT:
+			dst = FreeImage_AllocateT((count == 4) ? FIT_RGBAF : FIT_RGBF, width, height);
+			break;
+		default:
+			return nullptr;
+	}
+	if (!dst) return nullptr;
+
+	// perform insertion
+	unsigned order[4];
+	GetPlaneType(FreeImage_GetImageType(dst), order);
+	FIBITMAP *memory_planes[4];
+	for (unsigned c = 0; c < count; c++) {
+		memory_planes[c] = planes[order[c]];
+	}
+	switch (plane_type) {
+		case FIT_BITMAP:
+			(count == 4) ? MergePixels<uint8_t, 4>(dst, memory_planes) : MergePixels<uint8_t, 3>(dst, memory_planes);
+			break;
+		case FIT_UINT16:
+			(count == 4) ? MergePixels<uint16_t, 4>(dst, memory_planes) : MergePixels<uint16_t, 3>(dst, memory_planes);
+			break;
+		default:
+			(count == 4) ? MergePixels<uint32_t, 4>(dst, memory_planes) : MergePixels<uint32_t, 3>(dst, memory_planes);
+			break;
+	}
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, planes[0]);
+
+	return dst;
+}
@@ -35,280 +35,295 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
-
-#define RBLOCK		64	// image blocks of RBLOCK*RBLOCK pixels
+#include "../FreeImage/CPUDispatch.h"
 
 // --------------------------------------------------------------------------
+// Transposition of pixels by square tiles, used by the rotations of multiples of 90 degrees
+
+namespace {
+
+	/// Transposes one full tile: dst row i receives src column i
+	using TransposeTileKernel = void (*)(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch);
+
+	/// Side of a tile in pixels, a SIMD tile holds one 16 bytes register per row (8 bytes for 8-bit pixels)
+	template <unsigned bytespp>
+	constexpr unsigned kTileSize = (bytespp == 2 || bytespp == 4 || bytespp == 8) ? 16 / bytespp : 8;
+
+	/// Transposes a block of width x height source pixels
+	template <unsigned bytespp>
+	inline void TransposeBlock(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch, unsigned width, unsigned height) {
+		for (unsigned i = 0; i < width; i++) {
+			uint8_t *dst_pixel = dst + i * dst_pitch;
+			const uint8_t *src_pixel = src + i * bytespp;
+			for (unsigned j = 0; j < height; j++) {
+				memcpy(dst_pixel, src_pixel, bytespp);
+				dst_pixel += bytespp;
+				src_pixel += src_pitch;
+			}
+		}
+	}
 
-/**
-Skews a row horizontally (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
-Parameter T can be uint8_t, uint16_t of float. 
-@param src Pointer to source image to rotate
-@param dst Pointer to destination image
-@param row Row index
-@param iOffset Skew offset
-@param dWeight Relative weight of right pixel
-@param bkcolor Background color
-*/
-template <class T> void 
-HorizontalSkewT(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double weight, const void *bkcolor = nullptr) {
-	int iXPos;
-
-	const unsigned src_width  = FreeImage_GetWidth(src);
-	const unsigned dst_width  = FreeImage_GetWidth(dst);
-
-	T pxlSrc[4], pxlLeft[4], pxlOldLeft[4];	// 4 = 4*sizeof(T) max
-	
-	// background
-	const T pxlBlack[4] = {0, 0, 0, 0 };
-	const T *pxlBkg = static_cast<const T*>(bkcolor); // assume at least bytespp and 4*sizeof(T) max
-	if (!pxlBkg) {
-		// default background color is black
-		pxlBkg = pxlBlack;
+	template <unsigned bytespp>
+	void TransposeTile(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch) {
+		TransposeBlock<bytespp>(dst, dst_pitch, src, src_pitch, kTileSize<bytespp>, kTileSize<bytespp>);
 	}
 
-	// calculate the number of bytes per pixel
-	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-	// calculate the number of samples per pixel
-	const unsigned samples = bytespp / sizeof(T);
+#if FREEIMAGE_SIMD_X86
 
-	uint8_t *src_bits = FreeImage_GetScanLine(src, row);
-	uint8_t *dst_bits = FreeImage_GetScanLine(dst, row);
+	// rows are interleaved by pairs of growing lanes until each register holds one column
 
-	// fill gap left of skew with background
-	if (bkcolor) {
-		for (int k = 0; k < iOffset; k++) {
-			memcpy(&dst_bits[k * bytespp], bkcolor, bytespp);
+	void TransposeTile8_SSE2(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch) {
+		__m128i r[8];
+		for (unsigned k = 0; k < 8; k++) {
+			r[k] = _mm_loadl_epi64((const __m128i *)(src + k * src_pitch));
+		}
+		const __m128i a0 = _mm_unpacklo_epi8(r[0], r[1]);
+		const __m128i a1 = _mm_unpacklo_epi8(r[2], r[3]);
+		const __m128i a2 = _mm_unpacklo_epi8(r[4], r[5]);
+		const __m128i a3 = _mm_unpacklo_epi8(r[6], r[7]);
+		const __m128i b0 = _mm_unpacklo_epi16(a0, a1);
+		const __m128i b1 = _mm_unpackhi_epi16(a0, a1);
+		const __m128i b2 = _mm_unpacklo_epi16(a2, a3);
+		const __m128i b3 = _mm_unpackhi_epi16(a2, a3);
+		// each register holds two columns
+		const __m128i c[4] = { _mm_unpacklo_epi32(b0, b2), _mm_unpackhi_epi32(b0, b2), _mm_unpacklo_epi32(b1, b3), _mm_unpackhi_epi32(b1, b3) };
+		for (unsigned k = 0; k < 4; k++) {
+			_mm_storel_epi64((__m128i *)(dst + (2 * k) * dst_pitch), c[k]);
+			_mm_storel_epi64((__m128i *)(dst + (2 * k + 1) * dst_pitch), _mm_srli_si128(c[k], 8));
 		}
-		AssignPixel((uint8_t*)&pxlOldLeft[0], (uint8_t*)bkcolor, bytespp);
-	} else {
-		if (iOffset > 0) {
-			memset(dst_bits, 0, iOffset * bytespp);
-		}		
-		memset(&pxlOldLeft[0], 0, bytespp);
 	}
 
-	for (unsigned i = 0; i < src_width; i++) {
-		// loop through row pixels
-		AssignPixel((uint8_t*)&pxlSrc[0], (uint8_t*)src_bits, bytespp);
-		// calculate weights
-		for (unsigned j = 0; j < samples; j++) {
-			pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight + 0.5);
+	void TransposeTile16_SSE2(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch) {
+		__m128i r[8];
+		for (unsigned k = 0; k < 8; k++) {
+			r[k] = _mm_loadu_si128((const __m128i *)(src + k * src_pitch));
 		}
-		// check boundaries 
-		iXPos = i + iOffset;
-		if ((iXPos >= 0) && (iXPos < (int)dst_width)) {
-			// update left over on source
-			for (unsigned j = 0; j < samples; j++) {
-				pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[j]);
-			}
-			AssignPixel((uint8_t*)&dst_bits[iXPos*bytespp], (uint8_t*)&pxlSrc[0], bytespp);
+		__m128i a[8], b[8];
+		for (unsigned k = 0; k < 4; k++) {
+			a[2 * k] = _mm_unpacklo_epi16(r[2 * k], r[2 * k + 1]);
+			a[2 * k + 1] = _mm_unpackhi_epi16(r[2 * k], r[2 * k + 1]);
 		}
-		// save leftover for next pixel in scan
-		AssignPixel((uint8_t*)&pxlOldLeft[0], (uint8_t*)&pxlLeft[0], bytespp);
-
-		// next pixel in scan
-		src_bits += bytespp;
-	}			
-
-	// go to rightmost point of skew
-	iXPos = src_width + iOffset; 
-
-	if ((iXPos >= 0) && (iXPos < (int)dst_width)) {
-		dst_bits = FreeImage_GetScanLine(dst, row) + iXPos * bytespp;
-
-		// If still in image bounds, put leftovers there
-		AssignPixel((uint8_t*)dst_bits, (uint8_t*)&pxlOldLeft[0], bytespp);
-
-		// clear to the right of the skewed line with background
-		dst_bits += bytespp;
-		if (bkcolor) {
-			for (unsigned i = 0; i < dst_width - iXPos - 1; i++) {
-				memcpy(&dst_bits[i * bytespp], bkcolor, bytespp);
-			}
-		} else {
-			memset(dst_bits, 0, bytespp * (dst_width - iXPos - 1));
+		for (unsigned k = 0; k < 2; k++) {
+			b[4 * k] = _mm_unpacklo_epi32(a[4 * k], a[4 * k + 2]);
+			b[4 * k + 1] = _mm_unpackhi_epi32(a[4 * k], a[4 * k + 2]);
+			b[4 * k + 2] = _mm_unpacklo_epi32(a[4 * k + 1], a[4 * k + 3]);
+			b[4 * k + 3] = _mm_unpackhi_epi32(a[4 * k + 1], a[4 * k + 3]);
+		}
+		for (unsigned k = 0; k < 4; k++) {
+			_mm_storeu_si128((__m128i *)(dst + (2 * k) * dst_pitch), _mm_unpacklo_epi64(b[k], b[k + 4]));
+			_mm_storeu_si128((__m128i *)(dst + (2 * k + 1) * dst_pitch), _mm_unpackhi_epi64(b[k], b[k + 4]));
 		}
-
 	}
-}
-
-/**
-Skews a row horizontally (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
-@param src Pointer to source image to rotate
-@param dst Pointer to destination image
-@param row Row index
-@param iOffset Skew offset
-@param dWeight Relative weight of right pixel
-@param bkcolor Background color
-*/
-static void 
-HorizontalSkew(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double dWeight, const void *bkcolor) {
-	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 
-	switch (image_type) {
-		case FIT_BITMAP:
-			switch (FreeImage_GetBPP(src)) {
-				case 8:
-				case 24:
-				case 32:
-					HorizontalSkewT<uint8_t>(src, dst, row, iOffset, dWeight, bkcolor);
-				break;
-			}
-			break;
-		case FIT_UINT16:
-		case FIT_RGB16:
-		case FIT_RGBA16:
-			HorizontalSkewT<uint16_t>(src, dst, row, iOffset, dWeight, bkcolor);
-			break;
-		case FIT_FLOAT:
-		case FIT_RGBF:
-		case FIT_RGBAF:
-			HorizontalSkewT<float>(src, dst, row, iOffset, dWeight, bkcolor);
-			break;
+	void TransposeTile32_SSE2(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch) {
+		const __m128i r0 = _mm_loadu_si128((const __m128i *)(src));
+		const __m128i r1 = _mm_loadu_si128((const __m128i *)(src + src_pitch));
+		const __m128i r2 = _mm_loadu_si128((const __m128i *)(src + 2 * src_pitch));
+		const __m128i r3 = _mm_loadu_si128((const __m128i *)(src + 3 * src_pitch));
+		const __m128i a0 = _mm_unpacklo_epi32(r0, r1);
+		const __m128i a1 = _mm_unpacklo_epi32(r2, r3);
+		const __m128i a2 = _mm_unpackhi_epi32(r0, r1);
+		const __m128i a3 = _mm_unpackhi_epi32(r2, r3);
+		_mm_storeu_si128((__m128i *)(dst), _mm_unpacklo_epi64(a0, a1));
+		_mm_storeu_si128((__m128i *)(dst + dst_pitch), _mm_unpackhi_epi64(a0, a1));
+		_mm_storeu_si128((__m128i *)(dst + 2 * dst_pitch), _mm_unpacklo_epi64(a2, a3));
+		_mm_storeu_si128((__m128i *)(dst + 3 * dst_pitch), _mm_unpackhi_epi64(a2, a3));
 	}
-}
-
-/**
-Skews a column vertically (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
-Parameter T can be uint8_t, uint16_t of float. 
-@param src Pointer to source image to rotate
-@param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
-@param bkcolor Background color
-*/
-template <class T> void 
-VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double weight, const void *bkcolor = nullptr) {
-	int iYPos;
-
-	unsigned src_height = FreeImage_GetHeight(src);
-	unsigned dst_height = FreeImage_GetHeight(dst);
 
-	T pxlSrc[4], pxlLeft[4], pxlOldLeft[4];	// 4 = 4*sizeof(T) max
-
-	// background
-	const T pxlBlack[4] = {0, 0, 0, 0 };
-	const T *pxlBkg = static_cast<const T*>(bkcolor); // assume at least bytespp and 4*sizeof(T) max
-	if (!pxlBkg) {
-		// default background color is black
-		pxlBkg = pxlBlack;
+	void TransposeTile64_SSE2(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch) {
+		const __m128i r0 = _mm_loadu_si128((const __m128i *)(src));
+		const __m128i r1 = _mm_loadu_si128((const __m128i *)(src + src_pitch));
+		_mm_storeu_si128((__m128i *)(dst), _mm_unpacklo_epi64(r0, r1));
+		_mm_storeu_si128((__m128i *)(dst + dst_pitch), _mm_unpackhi_epi64(r0, r1));
 	}
 
-	// calculate the number of bytes per pixel
-	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-	// calculate the number of samples per pixel
-	const unsigned samples = bytespp / sizeof(T);
+#endif // FREEIMAGE_SIMD_X86
 
-	const unsigned src_pitch = FreeImage_GetPitch(src);
-	const unsigned dst_pitch = FreeImage_GetPitch(dst);
-	const unsigned index = col * bytespp;
+#if FREEIMAGE_SIMD_NEON
 
-	const uint8_t *src_bits = FreeImage_GetBits(src) + index;
-	uint8_t *dst_bits = FreeImage_GetBits(dst) + index;
+	// same interleaving as the SSE2 tiles, vzip returns both halves of an interleave
 
-	// fill gap above skew with background
-	if (bkcolor) {
-		for (int k = 0; k < iOffset; k++) {
-			memcpy(dst_bits, bkcolor, bytespp);
-			dst_bits += dst_pitch;
+	void TransposeTile8_NEON(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch) {
+		uint8x8_t r[8];
+		for (unsigned k = 0; k < 8; k++) {
+			r[k] = vld1_u8(src + k * src_pitch);
+		}
+		uint16x8_t a[4];
+		for (unsigned k = 0; k < 4; k++) {
+			const uint8x8x2_t z = vzip_u8(r[2 * k], r[2 * k + 1]);
+			a[k] = vreinterpretq_u16_u8(vcombine_u8(z.val[0], z.val[1]));
 		}
-		memcpy(&pxlOldLeft[0], bkcolor, bytespp);
-	} else {
-		for (int k = 0; k < iOffset; k++) {
-			memset(dst_bits, 0, bytespp);
-			dst_bits += dst_pitch;
+		const uint16x8x2_t b01 = vzipq_u16(a[0], a[1]);
+		const uint16x8x2_t b23 = vzipq_u16(a[2], a[3]);
+		const uint32x4x2_t c01 = vzipq_u32(vreinterpretq_u32_u16(b01.val[0]), vreinterpretq_u32_u16(b23.val[0]));
+		const uint32x4x2_t c23 = vzipq_u32(vreinterpretq_u32_u16(b01.val[1]), vreinterpretq_u32_u16(b23.val[1]));
+		// each register holds two columns
+		const uint8x16_t c[4] = { vreinterpretq_u8_u32(c01.val[0]), vreinterpretq_u8_u32(c01.val[1]), vreinterpretq_u8_u32(c23.val[0]), vreinterpretq_u8_u32(c23.val[1]) };
+		for (unsigned k = 0; k < 4; k++) {
+			vst1_u8(dst + (2 * k) * dst_pitch, vget_low_u8(c[k]));
+			vst1_u8(dst + (2 * k + 1) * dst_pitch, vget_high_u8(c[k]));
 		}
-		memset(&pxlOldLeft[0], 0, bytespp);
 	}
 
-	for (unsigned i = 0; i < src_height; i++) {
-		// loop through column pixels
-		AssignPixel((uint8_t*)(&pxlSrc[0]), src_bits, bytespp);
-		// calculate weights
-		for (unsigned j = 0; j < samples; j++) {
-			pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight + 0.5);
+	void TransposeTile16_NEON(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch) {
+		uint16x8_t r[8];
+		for (unsigned k = 0; k < 8; k++) {
+			r[k] = vreinterpretq_u16_u8(vld1q_u8(src + k * src_pitch));
 		}
-		// check boundaries
-		iYPos = i + iOffset;
-		if ((iYPos >= 0) && (iYPos < (int)dst_height)) {
-			// update left over on source
-			for (unsigned j = 0; j < samples; j++) {
-				pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[j]);
-			}
-			dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
-			AssignPixel(dst_bits, (uint8_t*)(&pxlSrc[0]), bytespp);
+		uint32x4_t a[8], b[8];
+		for (unsigned k = 0; k < 4; k++) {
+			const uint16x8x2_t z = vzipq_u16(r[2 * k], r[2 * k + 1]);
+			a[2 * k] = vreinterpretq_u32_u16(z.val[0]);
+			a[2 * k + 1] = vreinterpretq_u32_u16(z.val[1]);
+		}
+		for (unsigned k = 0; k < 2; k++) {
+			const uint32x4x2_t lo = vzipq_u32(a[4 * k], a[4 * k + 2]);
+			const uint32x4x2_t hi = vzipq_u32(a[4 * k + 1], a[4 * k + 3]);
+			b[4 * k] = lo.val[0];
+			b[4 * k + 1] = lo.val[1];
+			b[4 * k + 2] = hi.val[0];
+			b[4 * k + 3] = hi.val[1];
+		}
+		for (unsigned k = 0; k < 4; k++) {
+			const uint64x2_t top = vreinterpretq_u64_u32(b[k]);
+			const uint64x2_t bottom = vreinterpretq_u64_u32(b[k + 4]);
+			vst1q_u8(dst + (2 * k) * dst_pitch, vreinterpretq_u8_u64(vcombine_u64(vget_low_u64(top), vget_low_u64(bottom))));
+			vst1q_u8(dst + (2 * k + 1) * dst_pitch, vreinterpretq_u8_u64(vcombine_u64(vget_high_u64(top), vget_high_u64(bottom))));
 		}
-		// save leftover for next pixel in scan
-		AssignPixel((uint8_t*)(&pxlOldLeft[0]), (uint8_t*)(&pxlLeft[0]), bytespp);
-
-		// next pixel in scan
-		src_bits += src_pitch;
 	}
-	// go to bottom point of skew
-	iYPos = src_height + iOffset;
-
-	if ((iYPos >= 0) && (iYPos < (int)dst_height)) {
-		dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
-
-		// if still in image bounds, put leftovers there				
-		AssignPixel((uint8_t*)(dst_bits), (uint8_t*)(&pxlOldLeft[0]), bytespp);
 
-		// clear below skewed line with background
-		if (bkcolor) {
-			while (++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				AssignPixel((uint8_t*)(dst_bits), (uint8_t*)(bkcolor), bytespp);
-			}
-		} else {
-			while (++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				memset(dst_bits, 0, bytespp);
+	void TransposeTile32_NEON(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch) {
+		const uint32x4x2_t t0 = vtrnq_u32(vreinterpretq_u32_u8(vld1q_u8(src)), vreinterpretq_u32_u8(vld1q_u8(src + src_pitch)));
+		const uint32x4x2_t t1 = vtrnq_u32(vreinterpretq_u32_u8(vld1q_u8(src + 2 * src_pitch)), vreinterpretq_u32_u8(vld1q_u8(src + 3 * src_pitch)));
+		vst1q_u8(dst, vreinterpretq_u8_u32(vcombine_u32(vget_low_u32(t0.val[0]), vget_low_u32(t1.val[0]))));
+		vst1q_u8(dst + dst_pitch, vreinterpretq_u8_u32(vcombine_u32(vget_low_u32(t0.val[1]), vget_low_u32(t1.val[1]))));
+		vst1q_u8(dst + 2 * dst_pitch, vreinterpretq_u8_u32(vcombine_u32(vget_high_u32(t0.val[0]), vget_high_u32(t1.val[0]))));
+		vst1q_u8(dst + 3 * dst_pitch, vreinterpretq_u8_u32(vcombine_u32(vget_high_u32(t0.val[1]), vget_high_u32(t1.val[1]))));
+	}
+
+	void TransposeTile64_NEON(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch) {
+		const uint64x2_t r0 = vreinterpretq_u64_u8(vld1q_u8(src));
+		const uint64x2_t r1 = vreinterpretq_u64_u8(vld1q_u8(src + src_pitch));
+		vst1q_u8(dst, vreinterpretq_u8_u64(vcombine_u64(vget_low_u64(r0), vget_low_u64(r1))));
+		vst1q_u8(dst + dst_pitch, vreinterpretq_u8_u64(vcombine_u64(vget_high_u64(r0), vget_high_u64(r1))));
+	}
+
+#endif // FREEIMAGE_SIMD_NEON
+
+	/// Tile kernels for the enabled CPU features
+	struct RotateKernels {
+		std::atomic<TransposeTileKernel> tile8{ TransposeTile<1> };
+		std::atomic<TransposeTileKernel> tile16{ TransposeTile<2> };
+		std::atomic<TransposeTileKernel> tile32{ TransposeTile<4> };
+		std::atomic<TransposeTileKernel> tile64{ TransposeTile<8> };
+	};
+
+	RotateKernels gKernels;
+
+	void SelectRotateKernels(uint32_t features) {
+		TransposeTileKernel tile8 = TransposeTile<1>;
+		TransposeTileKernel tile16 = TransposeTile<2>;
+		TransposeTileKernel tile32 = TransposeTile<4>;
+		TransposeTileKernel tile64 = TransposeTile<8>;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			tile8 = TransposeTile8_SSE2;
+			tile16 = TransposeTile16_SSE2;
+			tile32 = TransposeTile32_SSE2;
+			tile64 = TransposeTile64_SSE2;
+		}
+#elif FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			tile8 = TransposeTile8_NEON;
+			tile16 = TransposeTile16_NEON;
+			tile32 = TransposeTile32_NEON;
+			tile64 = TransposeTile64_NEON;
+		}
+#endif
+		gKernels.tile8.store(tile8, std::memory_order_relaxed);
+		gKernels.tile16.store(tile16, std::memory_order_relaxed);
+		gKernels.tile32.store(tile32, std::memory_order_relaxed);
+		gKernels.tile64.store(tile64, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectRotateKernels);
+
+	/**
+	Transposes width x height pixels: dst row i, column j receives src row j, column i.
+	Destination rows are processed by parallel strips whose source columns span at least a cache line,
+	a strip is walked down the source by rows of tiles so that both images are read and written by cache lines.
+	*/
+	template <unsigned bytespp>
+	void TransposeBits(uint8_t *dst_bits, ptrdiff_t dst_pitch, const uint8_t *src_bits, ptrdiff_t src_pitch, unsigned width, unsigned height, TransposeTileKernel tile) {
+		constexpr unsigned tile_size = kTileSize<bytespp>;
+		constexpr unsigned strip = ((64 / bytespp + tile_size - 1) / tile_size) * tile_size;
+		const unsigned strips = (width + strip - 1) / strip;
+		ParallelFor(0, strips, CalculateBandRows(static_cast<size_t>(strip) * height * bytespp), [&](unsigned first, unsigned last) {
+			for (unsigned s = first; s < last; s++) {
+				const unsigned strip_end = MIN(width, (s + 1) * strip);
+				for (unsigned j = 0; j < height; j += tile_size) {
+					const unsigned tile_height = MIN(tile_size, height - j);
+					for (unsigned i = s * strip; i < strip_end; i += tile_size) {
+						const unsigned tile_width = MIN(tile_size, strip_end - i);
+						uint8_t *dst = dst_bits + static_cast<ptrdiff_t>(i) * dst_pitch + static_cast<size_t>(j) * bytespp;
+						const uint8_t *src = src_bits + static_cast<ptrdiff_t>(j) * src_pitch + static_cast<size_t>(i) * bytespp;
+						if ((tile_width == tile_size) && (tile_height == tile_size)) {
+							tile(dst, dst_pitch, src, src_pitch);
+						} else {
+							TransposeBlock<bytespp>(dst, dst_pitch, src, src_pitch, tile_width, tile_height);
+						}
+					}
+				}
 			}
+		});
+	}
+
+	/// Copies a row of width pixels in reverse order
+	template <unsigned bytespp>
+	void ReverseRow(uint8_t *dst, const uint8_t *src, unsigned width) {
+		dst += static_cast<size_t>(width) * bytespp;
+		for (unsigned x = 0; x < width; x++) {
+			dst -= bytespp;
+			memcpy(dst, src, bytespp);
+			src += bytespp;
 		}
 	}
-}
+
+} // namespace
 
 /**
-Skews a column vertically (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
-@param src Pointer to source image to rotate
-@param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
-@param bkcolor Background color
+Transposes the pixels of a 8-, 16-, 24-, 32-, 48-, 64-, 96- or 128-bit image, see TransposeBits.
+Pitches are negative to walk an image upwards.
 */
-static void 
-VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double dWeight, const void *bkcolor) {
-	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
-
-	switch (image_type) {
-		case FIT_BITMAP:
-			switch (FreeImage_GetBPP(src)) {
-				case 8:
-				case 24:
-				case 32:
-					VerticalSkewT<uint8_t>(src, dst, col, iOffset, dWeight, bkcolor);
-					break;
-			}
+static void
+Transpose(uint8_t *dst_bits, ptrdiff_t dst_pitch, const uint8_t *src_bits, ptrdiff_t src_pitch, unsigned width, unsigned height, unsigned bytespp) {
+	switch (bytespp) {
+		case 1:
+			TransposeBits<1>(dst_bits, dst_pitch, src_bits, src_pitch, width, height, gKernels.tile8.load(std::memory_order_relaxed));
 			break;
-		case FIT_UINT16:
-		case FIT_RGB16:
-		case FIT_RGBA16:
-			VerticalSkewT<uint16_t>(src, dst, col, iOffset, dWeight, bkcolor);
+		case 2:
+			TransposeBits<2>(dst_bits, dst_pitch, src_bits, src_pitch, width, height, gKernels.tile16.load(std::memory_order_relaxed));
 			break;
-		case FIT_FLOAT:
-		case FIT_RGBF:
-		case FIT_RGBAF:
-			VerticalSkewT<float>(src, dst, col, iOffset, dWeight, bkcolor);
+		case 3:
+			TransposeBits<3>(dst_bits, dst_pitch, src_bits, src_pitch, width, height, TransposeTile<3>);
+			break;
+		case 4:
+			TransposeBits<4>(dst_bits, dst_pitch, src_bits, src_pitch, width, height, gKernels.tile32.load(std::memory_order_relaxed));
+			break;
+		case 6:
+			TransposeBits<6>(dst_bits, dst_pitch, src_bits, src_pitch, width, height, TransposeTile<6>);
+			break;
+		case 8:
+			TransposeBits<8>(dst_bits, dst_pitch, src_bits, src_pitch, width, height, gKernels.tile64.load(std::memory_order_relaxed));
+			break;
+		case 12:
+			TransposeBits<12>(dst_bits, dst_pitch, src_bits, src_pitch, width, height, TransposeTile<12>);
+			break;
+		case 16:
+			TransposeBits<16>(dst_bits, dst_pitch, src_bits, src_pitch, width, height, TransposeTile<16>);
 			break;
 	}
-} 
+}
 
 /**
 Rotates an image by 90 degrees (counter clockwise). 
@@ -368,41 +383,10 @@ Rotate90(FIBITMAP *src) {
 				}
 			}
 			else if ((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				const uint8_t *bsrc  = FreeImage_GetBits(src);  // source pixels
-				uint8_t *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
+				// dst rows are src columns from the last one, i.e. the transposed src written upwards
 				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-				
-				// for all image blocks of RBLOCK*RBLOCK pixels
-				
-				// x-segment
-				for (unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for (unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for (unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {    // do rotation
-							const unsigned y2 = dst_height - y - 1;
-							// point to src pixel at (y2, xs)
-							const uint8_t *src_bits = bsrc + (xs * src_pitch) + (y2 * bytespp);
-							// point to dst pixel at (xs, y)
-							uint8_t *dst_bits = bdest + (y * dst_pitch) + (xs * bytespp);
-							for (unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {
-								// dst.SetPixel(x, y, src.GetPixel(y2, x));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								dst_bits += bytespp;
-								src_bits += src_pitch;
-							}
-						}
-					}
-				}
+				Transpose(FreeImage_GetBits(dst) + static_cast<size_t>(dst_height - 1) * dst_pitch, -static_cast<ptrdiff_t>(dst_pitch),
+					FreeImage_GetConstBits(src), src_pitch, src_width, src_height, bytespp);
 			}
 			break;
 		case FIT_UINT16:
@@ -411,22 +395,11 @@ Rotate90(FIBITMAP *src) {
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
+		case FIT_RGBAH:
 		{
-			const uint8_t *bsrc  = FreeImage_GetBits(src);  // source pixels
-			uint8_t *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-			// calculate the number of bytes per pixel
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for (unsigned y = 0; y < dst_height; y++) {
-				const uint8_t *src_bits = bsrc + (src_width - 1 - y) * bytespp;
-				uint8_t *dst_bits = bdest + (y * dst_pitch);
-				for (unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += src_pitch;
-					dst_bits += bytespp;
-				}
-			}
+			Transpose(FreeImage_GetBits(dst) + static_cast<size_t>(dst_height - 1) * dst_pitch, -static_cast<ptrdiff_t>(dst_pitch),
+				FreeImage_GetConstBits(src), src_pitch, src_width, src_height, bytespp);
 		}
 		break;
 	}
@@ -442,7 +415,7 @@ Precise rotation, no filters required.
 */
 static FIBITMAP* 
 Rotate180(FIBITMAP *src) {
-	int x, y, k, pos;
+	int k, pos;
 
 	const int bpp = FreeImage_GetBPP(src);
 
@@ -479,21 +452,34 @@ Rotate180(FIBITMAP *src) {
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
+		case FIT_RGBAH:
 		{
 			 // Calculate the number of bytes per pixel
 			const int bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
-			for (y = 0; y < src_height; y++) {
-				const uint8_t *src_bits = FreeImage_GetScanLine(src, y);
-				uint8_t *dst_bits = FreeImage_GetScanLine(dst, dst_height - y - 1) + (dst_width - 1) * bytespp;
-				for (x = 0; x < src_width; x++) {
-					// get pixel at (x, y)
-					// set pixel at (dst_width - x - 1, dst_height - y - 1)
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += bytespp;
-					dst_bits -= bytespp;
-				}
+			void (*reverse)(uint8_t *, const uint8_t *, unsigned){};
+			switch (bytespp) {
+				case 1: reverse = ReverseRow<1>; break;
+				case 2: reverse = ReverseRow<2>; break;
+				case 3: reverse = ReverseRow<3>; break;
+				case 4: reverse = ReverseRow<4>; break;
+				case 6: reverse = ReverseRow<6>; break;
+				case 8: reverse = ReverseRow<8>; break;
+				case 12: reverse = ReverseRow<12>; break;
+				case 16: reverse = ReverseRow<16>; break;
+				default: return dst;
 			}
+
+			// set pixel (x, y) at (dst_width - x - 1, dst_height - y - 1), rows are processed by parallel bands
+			const unsigned src_pitch = FreeImage_GetPitch(src);
+			const unsigned dst_pitch = FreeImage_GetPitch(dst);
+			const uint8_t *src_bits = FreeImage_GetConstBits(src);
+			uint8_t *dst_bits = FreeImage_GetBits(dst);
+			ParallelFor(0, src_height, CalculateBandRows(FreeImage_GetLine(src)), [&](unsigned first, unsigned last) {
+				for (unsigned y = first; y < last; y++) {
+					reverse(dst_bits + static_cast<size_t>(dst_height - y - 1) * dst_pitch, src_bits + static_cast<size_t>(y) * src_pitch, dst_width);
+				}
+			});
 		}
 		break;
 	}
@@ -510,7 +496,7 @@ Code adapted from CxImage (http://www.xdp.it/cximage.htm)
 */
 static FIBITMAP* 
 Rotate270(FIBITMAP *src) {
-	int x2, dlineup;
+	int dlineup;
 
 	const unsigned bpp = FreeImage_GetBPP(src);
 
@@ -560,41 +546,10 @@ Rotate270(FIBITMAP *src) {
 				}
 			} 
 			else if ((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				const uint8_t *bsrc  = FreeImage_GetBits(src);  // source pixels
-				uint8_t *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// Calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
+				// dst rows are src columns read from the last src row, i.e. the transpose of src walked upwards
 				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-				// for all image blocks of RBLOCK*RBLOCK pixels
-
-				// x-segment
-				for (unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for (unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for (unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {    // do rotation
-							x2 = dst_width - x - 1;
-							// point to src pixel at (ys, x2)
-							const uint8_t *src_bits = bsrc + (x2 * src_pitch) + (ys * bytespp);
-							// point to dst pixel at (x, ys)
-							uint8_t *dst_bits = bdest + (ys * dst_pitch) + (x * bytespp);
-							for (unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {
-								// dst.SetPixel(x, y, src.GetPixel(y, x2));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								src_bits += bytespp;
-								dst_bits += dst_pitch;
-							}
-						}
-					}
-				}
+				Transpose(FreeImage_GetBits(dst), dst_pitch,
+					FreeImage_GetConstBits(src) + static_cast<size_t>(src_height - 1) * src_pitch, -static_cast<ptrdiff_t>(src_pitch), src_width, src_height, bytespp);
 			}
 			break;
 		case FIT_UINT16:
@@ -603,22 +558,11 @@ Rotate270(FIBITMAP *src) {
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
+		case FIT_RGBAH:
 		{
-			const uint8_t *bsrc  = FreeImage_GetBits(src);  // source pixels
-			uint8_t *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-			// calculate the number of bytes per pixel
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for (unsigned y = 0; y < dst_height; y++) {
-				const uint8_t *src_bits = bsrc + (src_height - 1) * src_pitch + y * bytespp;
-				uint8_t *dst_bits = bdest + (y * dst_pitch);
-				for (unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits -= src_pitch;
-					dst_bits += bytespp;
-				}
-			}
+			Transpose(FreeImage_GetBits(dst), dst_pitch,
+				FreeImage_GetConstBits(src) + static_cast<size_t>(src_height - 1) * src_pitch, -static_cast<ptrdiff_t>(src_pitch), src_width, src_height, bytespp);
 		}
 		break;
 	}
@@ -628,7 +572,7 @@ Rotate270(FIBITMAP *src) {
 
 /**
 Rotates an image by a given degree in range [-45 .. +45] (counter clockwise) 
-using the 3-shear technique.
+with a single affine resampling pass around the image centre.
 @param src Pointer to source image to rotate
 @param dAngle Rotation angle
 @return Returns a pointer to a newly allocated rotated image if successful, returns NULL otherwise
@@ -637,116 +581,29 @@ static FIBITMAP*
 Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	const double ROTATE_PI = double(3.1415926535897932384626433832795);
 
-	unsigned u;
-
-	const unsigned bpp = FreeImage_GetBPP(src);
-
 	const double dRadAngle = dAngle * ROTATE_PI / double(180); // Angle in radians
 	const double dSinE = sin(dRadAngle);
-	const double dTan = tan(dRadAngle / 2);
-
-	const unsigned src_width  = FreeImage_GetWidth(src);
-	const unsigned src_height = FreeImage_GetHeight(src);
-
-	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
-
-	// Calc first shear (horizontal) destination image dimensions 
-	const unsigned width_1  = src_width + unsigned((double)src_height * fabs(dTan) + 0.5);
-	const unsigned height_1 = src_height; 
-
-	// Perform 1st shear (horizontal)
-	// ----------------------------------------------------------------------
+	const double dCosE = cos(dRadAngle);
 
-	// Allocate image for 1st shear
-	FIBITMAP *dst1 = FreeImage_AllocateT(image_type, width_1, height_1, bpp);
-	if (!dst1) {
-		return nullptr;
-	}
-	
-	for (u = 0; u < height_1; u++) {  
-		double dShear;
-
-		if (dTan >= 0)	{
-			// Positive angle
-			dShear = (u + 0.5) * dTan;
-		}
-		else {
-			// Negative angle
-			dShear = (double(u) - height_1 + 0.5) * dTan;
-		}
-		int iShear = int(floor(dShear));
-		HorizontalSkew(src, dst1, u, iShear, dShear - double(iShear), bkcolor);
-	}
-
-	// Perform 2nd shear  (vertical)
-	// ----------------------------------------------------------------------
+	const double src_width  = FreeImage_GetWidth(src);
+	const double src_height = FreeImage_GetHeight(src);
 
-	// Calc 2nd shear (vertical) destination image dimensions
-	const unsigned width_2  = width_1;
-	unsigned height_2 = unsigned((double)src_width * fabs(dSinE) + (double)src_height * cos(dRadAngle) + 0.5) + 1;
+	// same destination size as the former 3-shear rotation
+	const unsigned dst_width  = unsigned(src_height * fabs(dSinE) + src_width * dCosE + 0.5) + 1;
+	const unsigned dst_height = unsigned(src_width * fabs(dSinE) + src_height * dCosE + 0.5) + 1;
 
-	// Allocate image for 2nd shear
-	FIBITMAP *dst2 = FreeImage_AllocateT(image_type, width_2, height_2, bpp);
-	if (!dst2) {
-		FreeImage_Unload(dst1);
-		return nullptr;
-	}
+	// rotation of the top-down coordinates around the centres of both images
+	const double x_shift = 0.5 * dst_width  - dCosE * 0.5 * src_width + dSinE * 0.5 * src_height;
+	const double y_shift = 0.5 * dst_height - dSinE * 0.5 * src_width - dCosE * 0.5 * src_height;
+	const double matrix[6] = { dCosE, -dSinE, x_shift, dSinE, dCosE, y_shift };
 
-	double dOffset;     // Variable skew offset
-	if (dSinE > 0)	{   
-		// Positive angle
-		dOffset = (src_width - 1.0) * dSinE;
-	}
-	else {
-		// Negative angle
-		dOffset = -dSinE * (double(src_width) - width_2);
-	}
-
-	for (u = 0; u < width_2; u++, dOffset -= dSinE) {
-		int iShear = int(floor(dOffset));
-		VerticalSkew(dst1, dst2, u, iShear, dOffset - double(iShear), bkcolor);
-	}
-
-	// Perform 3rd shear (horizontal)
-	// ----------------------------------------------------------------------
-
-	// Free result of 1st shear
-	FreeImage_Unload(dst1);
-
-	// Calc 3rd shear (horizontal) destination image dimensions
-	const unsigned width_3  = unsigned(double(src_height) * fabs(dSinE) + double(src_width) * cos(dRadAngle) + 0.5) + 1;
-	const unsigned height_3 = height_2;
-
-	// Allocate image for 3rd shear
-	FIBITMAP *dst3 = FreeImage_AllocateT(image_type, width_3, height_3, bpp);
-	if (!dst3) {
-		FreeImage_Unload(dst2);
-		return nullptr;
-	}
-
-	if (dSinE >= 0) {
-		// Positive angle
-		dOffset = (src_width - 1.0) * dSinE * -dTan;
-	}
-	else {
-		// Negative angle
-		dOffset = dTan * ( (src_width - 1.0) * -dSinE + (1.0 - height_3) );
-	}
-	for (u = 0; u < height_3; u++, dOffset += dTan) {
-		int iShear = int(floor(dOffset));
-		HorizontalSkew(dst2, dst3, u, iShear, dOffset - double(iShear), bkcolor);
-	}
-	// Free result of 2nd shear    
-	FreeImage_Unload(dst2);
-
-	// Return result of 3rd shear
-	return dst3;      
+	return FreeImage_AffineTransform(src, matrix, FILTER_BILINEAR, bkcolor, int(dst_width), int(dst_height));
 }
 
 /**
 Rotates a 1-, 8-, 24- or 32-bit image by a given angle (given in degree). 
 Angle is unlimited, except for 1-bit images (limited to integer multiples of 90 degree). 
-3-shears technique is used.
+The residual angle in [-45 .. +45] is applied with FreeImage_AffineTransform.
 @param src Pointer to source image to rotate
 @param dAngle Rotation angle
 @return Returns a pointer to a newly allocated rotated image if successful, returns NULL otherwise
@@ -809,6 +666,11 @@ RotateAny(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		}
 	}
 	else {
+		if ((image != src) && (FreeImage_GetImageType(src) == FIT_BITMAP) && (FreeImage_GetBPP(src) == 8)) {
+			// the palette decides how the last rotation samples indices
+			memcpy(FreeImage_GetPalette(image), FreeImage_GetPalette(src), 256 * sizeof(FIRGBA8));
+		}
+
 		// Perform last rotation
 		FIBITMAP *dst = Rotate45(image, dAngle, bkcolor);
 
@@ -906,6 +768,40 @@ FreeImage_Rotate(FIBITMAP *dib, double angle, const void *bkcolor) {
 				return dst;
 			}
 			break;
+			case FIT_RGBAH:
+			{
+				if (fmod(angle, 90) == 0) {
+					// pixels are only moved
+					FIBITMAP *dst = RotateAny(dib, angle, bkcolor);
+					if (!dst) throw(1);
+
+					// copy metadata from src to dst
+					FreeImage_CloneMetadata(dst, dib);
+
+					return dst;
+				}
+
+				// interpolated as RGBAF, bkcolor is a FIRGBAH
+				std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> src(FreeImage_ConvertToRGBAF(dib), &FreeImage_Unload);
+				if (!src) throw(1);
+
+				FIRGBAF color{};
+				if (bkcolor) {
+					const auto *half = static_cast<const FIRGBAH*>(bkcolor);
+					color = { HalfToFloat(half->red), HalfToFloat(half->green), HalfToFloat(half->blue), HalfToFloat(half->alpha) };
+				}
+				std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> rotated(RotateAny(src.get(), angle, bkcolor ? &color : nullptr), &FreeImage_Unload);
+				if (!rotated) throw(1);
+
+				FIBITMAP *dst = FreeImage_ConvertToRGBAH(rotated.get());
+				if (!dst) throw(1);
+
+				// copy metadata from src to dst
+				FreeImage_CloneMetadata(dst, dib);
+
+				return dst;
+			}
+			break;
 		}
 
 	} catch(int) {
@@ -0,0 +1,671 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "../FreeImage/CPUDispatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// --------------------------------------------------------------------------
+// ICC colour transforms
+// A transform between two RGB profiles runs in 3 steps: input curves map samples to grid coordinates, a 3D lookup
+// table is interpolated (tetrahedral interpolation, SIMD kernels), output curves encode the interpolated values.
+// Matrix/TRC profiles (rXYZ, gXYZ, bXYZ and rTRC, gTRC, bTRC tags, as Display P3, Adobe RGB or sRGB profiles) are
+// evaluated natively: input curves linearise, the table holds the linear transform between both profiles, which its
+// corners represent exactly, output curves are the inverse curves of the destination. Other profiles (LUT based
+// profiles) aren't supported.
+// Transforms are kept in a process wide cache keyed by a hash of both profiles, so that images sharing a profile
+// don't parse it and build the transform again. Pixels are converted by parallel bands of rows.
+// --------------------------------------------------------------------------
+
+namespace {
+
+	/// Number of entries of the input and output curves
+	const unsigned kCurveSize = 4096;
+
+	/// Maximum number of transforms kept by the cache
+	const size_t kMaxCachedTransforms = 16;
+
+	/**
+	Lookup tables of a transform.
+	Output curves are indexed by the square root of the interpolated values, steep encoding curves (gamma 1/2.2) are
+	then almost linear in each interval.
+	*/
+	struct ICCTransform {
+		unsigned grid = 2;					// nodes per axis
+		std::vector<float> nodes;			// 4 floats (r, g, b, unused) per node, r is the slowest axis
+		float input8[3][256];				// grid coordinates of 8-bit samples
+		float input[3][kCurveSize];			// grid coordinates of samples i / (kCurveSize - 1)
+		float output[3][kCurveSize];		// encoded values of interpolated values (i / (kCurveSize - 1))^2
+	};
+
+	// ----------------------------------------------------------
+	//  Matrix/TRC profiles
+	// ----------------------------------------------------------
+
+	uint32_t ReadBE32(const uint8_t *p) {
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+	}
+
+	uint16_t ReadBE16(const uint8_t *p) {
+		return (uint16_t)((p[0] << 8) | p[1]);
+	}
+
+	double ReadS15Fixed16(const uint8_t *p) {
+		return (int32_t)ReadBE32(p) / 65536.0;
+	}
+
+	uint32_t Signature(const char (&s)[5]) {
+		return ((uint32_t)(uint8_t)s[0] << 24) | ((uint32_t)(uint8_t)s[1] << 16) | ((uint32_t)(uint8_t)s[2] << 8) | (uint32_t)(uint8_t)s[3];
+	}
+
+	/**
+	Tone reproduction curve of a channel, maps encoded values in [0, 1] to linear light
+	*/
+	struct ToneCurve {
+		enum class Type { eParametric, eTable } type = Type::eParametric;
+		int function = 0;						// ICC parametric function type, 0 to 4
+		double g = 1, a = 1, b = 0, c = 0, d = 0, e = 0, f = 0;
+		std::vector<double> table;				// sampled curve, first entry at 0, last at 1
+
+		double Evaluate(double x) const {
+			x = std::clamp(x, 0.0, 1.0);
+			if (type == Type::eTable) {
+				const double pos = x * (table.size() - 1);
+				const size_t i = std::min((size_t)pos, table.size() - 2);
+				const double t = pos - i;
+				return table[i] + t * (table[i + 1] - table[i]);
+			}
+			switch (function) {
+				case 0:
+					return std::pow(x, g);
+				case 1:
+					return (x >= -b / a) ? std::pow(std::max(0.0, a * x + b), g) : 0;
+				case 2:
+					return (x >= -b / a) ? std::pow(std::max(0.0, a * x + b), g) + c : c;
+				case 3:
+					return (x >= d) ? std::pow(std::max(0.0, a * x + b), g) : c * x;
+				default:
+					return (x >= d) ? std::pow(std::max(0.0, a * x + b), g) + e : c * x + f;
+			}
+		}
+	};
+
+	/**
+	Inverse of a tone curve, sampled on kInverseSamples points and searched as a monotonic table
+	*/
+	class InverseToneCurve {
+	public:
+		explicit InverseToneCurve(const ToneCurve& curve) : mForward(kInverseSamples) {
+			for (unsigned i = 0; i < kInverseSamples; i++) {
+				mForward[i] = curve.Evaluate(i / (double)(kInverseSamples - 1));
+			}
+			// flat or decreasing parts would make the search ambiguous
+			for (unsigned i = 1; i < kInverseSamples; i++) {
+				mForward[i] = std::max(mForward[i], mForward[i - 1]);
+			}
+		}
+
+		double Evaluate(double y) const {
+			if (y <= mForward.front()) {
+				return 0;
+			}
+			if (y >= mForward.back()) {
+				return 1;
+			}
+			const size_t i = std::upper_bound(mForward.begin(), mForward.end(), y) - mForward.begin() - 1;
+			const double span = mForward[i + 1] - mForward[i];
+			const double t = (span > 0) ? (y - mForward[i]) / span : 0;
+			return (i + t) / (kInverseSamples - 1);
+		}
+
+	private:
+		static const unsigned kInverseSamples = 4096;
+		std::vector<double> mForward;
+	};
+
+	/**
+	RGB matrix/TRC profile: linear RGB = curves(encoded RGB), PCS XYZ (D50) = matrix * linear RGB
+	*/
+	struct MatrixProfile {
+		double matrix[3][3];
+		ToneCurve curves[3];
+	};
+
+	/// sRGB as its ICC profiles define it: D50 adapted primaries and the IEC 61966-2-1 curve
+	MatrixProfile SRGBProfile() {
+		MatrixProfile profile = { {
+			{ 0.4360747, 0.3850649, 0.1430804 },
+			{ 0.2225045, 0.7168786, 0.0606169 },
+			{ 0.0139322, 0.0971045, 0.7141733 }
+		}, {} };
+		for (auto &curve : profile.curves) {
+			curve.function = 3;
+			curve.g = 2.4;
+			curve.a = 1 / 1.055;
+			curve.b = 0.055 / 1.055;
+			curve.c = 1 / 12.92;
+			curve.d = 0.04045;
+		}
+		return profile;
+	}
+
+	/**
+	Reads a curv or para tag. Returns false when the tag is malformed.
+	*/
+	bool ParseToneCurve(const uint8_t *tag, uint32_t size, ToneCurve& curve) {
+		if (size < 12) {
+			return false;
+		}
+		const uint32_t type = ReadBE32(tag);
+		if (type == Signature("curv")) {
+			const uint32_t count = ReadBE32(tag + 8);
+			if ((uint64_t)12 + 2 * (uint64_t)count > size) {
+				return false;
+			}
+			if (count == 0) {
+				curve.function = 0;
+				curve.g = 1;
+			} else if (count == 1) {
+				curve.function = 0;
+				curve.g = ReadBE16(tag + 12) / 256.0;
+			} else {
+				curve.type = ToneCurve::Type::eTable;
+				curve.table.resize(count);
+				for (uint32_t i = 0; i < count; i++) {
+					curve.table[i] = ReadBE16(tag + 12 + 2 * i) / 65535.0;
+				}
+			}
+			return true;
+		}
+		if (type == Signature("para")) {
+			static const unsigned kParameters[5] = { 1, 3, 4, 5, 7 };
+			const unsigned function = ReadBE16(tag + 8);
+			if ((function > 4) || (12 + 4 * kParameters[function] > size)) {
+				return false;
+			}
+			double p[7] = { 1, 1, 0, 0, 0, 0, 0 };
+			for (unsigned i = 0; i < kParameters[function]; i++) {
+				p[i] = ReadS15Fixed16(tag + 12 + 4 * i);
+			}
+			curve.function = (int)function;
+			curve.g = p[0];
+			curve.a = p[1];
+			curve.b = p[2];
+			curve.c = p[3];
+			curve.d = p[4];
+			curve.e = p[5];
+			curve.f = p[6];
+			if ((function == 1 || function == 2) && (curve.a == 0)) {
+				return false;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	Reads the header of an ICC profile. Returns false when data isn't an RGB profile.
+	*/
+	bool IsRGBProfile(const uint8_t *data, uint32_t size) {
+		return (size >= 132) && (ReadBE32(data) <= size) && (ReadBE32(data + 36) == Signature("acsp")) && (ReadBE32(data + 16) == Signature("RGB "));
+	}
+
+	/**
+	Reads the matrix and curves of a matrix/TRC RGB profile. Returns false for other profiles.
+	*/
+	bool ParseMatrixProfile(const uint8_t *data, uint32_t size, MatrixProfile& profile) {
+		if (!IsRGBProfile(data, size) || (ReadBE32(data + 20) != Signature("XYZ "))) {
+			return false;
+		}
+		size = ReadBE32(data);
+		const uint32_t count = ReadBE32(data + 128);
+		if ((uint64_t)132 + 12 * (uint64_t)count > size) {
+			return false;
+		}
+
+		static const char kColumns[3][5] = { "rXYZ", "gXYZ", "bXYZ" };
+		static const char kCurves[3][5] = { "rTRC", "gTRC", "bTRC" };
+		unsigned found = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			const uint8_t *entry = data + 132 + 12 * i;
+			const uint32_t signature = ReadBE32(entry);
+			const uint32_t offset = ReadBE32(entry + 4);
+			const uint32_t length = ReadBE32(entry + 8);
+			if ((uint64_t)offset + length > size) {
+				return false;
+			}
+			const uint8_t *tag = data + offset;
+			for (unsigned c = 0; c < 3; c++) {
+				if (signature == Signature(kColumns[c])) {
+					if ((length < 20) || (ReadBE32(tag) != Signature("XYZ "))) {
+						return false;
+					}
+					for (unsigned row = 0; row < 3; row++) {
+						profile.matrix[row][c] = ReadS15Fixed16(tag + 8 + 4 * row);
+					}
+					found |= 1 << c;
+				} else if (signature == Signature(kCurves[c])) {
+					if (!ParseToneCurve(tag, length, profile.curves[c])) {
+						return false;
+					}
+					found |= 8 << c;
+				}
+			}
+		}
+		return found == 0x3F;
+	}
+
+	bool InvertMatrix(const double (&m)[3][3], double (&inverse)[3][3]) {
+		const double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+			- m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+			+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+		if (std::fabs(det) < 1e-12) {
+			return false;
+		}
+		for (unsigned r = 0; r < 3; r++) {
+			for (unsigned c = 0; c < 3; c++) {
+				// cofactor of m[c][r]
+				const unsigned r0 = (c + 1) % 3, r1 = (c + 2) % 3, c0 = (r + 1) % 3, c1 = (r + 2) % 3;
+				inverse[r][c] = (m[r0][c0] * m[r1][c1] - m[r0][c1] * m[r1][c0]) / det;
+			}
+		}
+		return true;
+	}
+
+
+	/**
+	Builds the transform between two matrix/TRC profiles.
+	The transform between linear values is linear, so the table only needs the corners of the grid; values out of the
+	destination gamut are kept by the table and clipped by the output curves.
+	*/
+	bool BuildMatrixTransform(const MatrixProfile& src, const MatrixProfile& dst, ICCTransform& transform) {
+		double inverse[3][3];
+		if (!InvertMatrix(dst.matrix, inverse)) {
+			return false;
+		}
+		double m[3][3];
+		for (unsigned r = 0; r < 3; r++) {
+			for (unsigned c = 0; c < 3; c++) {
+				m[r][c] = inverse[r][0] * src.matrix[0][c] + inverse[r][1] * src.matrix[1][c] + inverse[r][2] * src.matrix[2][c];
+			}
+		}
+
+		transform.grid = 2;
+		transform.nodes.resize(4 * 8);
+		float *node = transform.nodes.data();
+		for (unsigned r = 0; r < 2; r++) {
+			for (unsigned g = 0; g < 2; g++) {
+				for (unsigned b = 0; b < 2; b++, node += 4) {
+					for (unsigned c = 0; c < 3; c++) {
+						node[c] = (float)(m[c][0] * r + m[c][1] * g + m[c][2] * b);
+					}
+					node[3] = 0;
+				}
+			}
+		}
+
+		for (unsigned c = 0; c < 3; c++) {
+			for (unsigned i = 0; i < 256; i++) {
+				transform.input8[c][i] = (float)src.curves[c].Evaluate(i / 255.0);
+			}
+			const InverseToneCurve encode(dst.curves[c]);
+			for (unsigned i = 0; i < kCurveSize; i++) {
+				const double t = i / (double)(kCurveSize - 1);
+				transform.input[c][i] = (float)src.curves[c].Evaluate(t);
+				transform.output[c][i] = (float)encode.Evaluate(t * t);
+			}
+		}
+		return true;
+	}
+
+	/**
+	Builds the transform between two RGB profiles. A NULL src or dst is sRGB.
+	Returns NULL when a profile isn't supported.
+	*/
+	std::shared_ptr<const ICCTransform> CreateTransform(const FIICCPROFILE *src, const FIICCPROFILE *dst) {
+		auto transform = std::make_shared<ICCTransform>();
+
+		MatrixProfile src_matrix = SRGBProfile(), dst_matrix = SRGBProfile();
+		const bool src_native = !src || ParseMatrixProfile((const uint8_t *)src->data, src->size, src_matrix);
+		const bool dst_native = !dst || ParseMatrixProfile((const uint8_t *)dst->data, dst->size, dst_matrix);
+		if (src_native && dst_native) {
+			return BuildMatrixTransform(src_matrix, dst_matrix, *transform) ? transform : nullptr;
+		}
+		return nullptr;
+	}
+
+	// ----------------------------------------------------------
+	//  Transform cache
+	// ----------------------------------------------------------
+
+	/// FNV-1a hash of a profile, 0 stands for sRGB
+	uint64_t HashProfile(const FIICCPROFILE *profile) {
+		if (!profile) {
+			return 0;
+		}
+		uint64_t hash = 14695981039346656037ULL;
+		const uint8_t *p = (const uint8_t *)profile->data;
+		for (uint32_t i = 0; i < profile->size; i++) {
+			hash = (hash ^ p[i]) * 1099511628211ULL;
+		}
+		return hash | 1;
+	}
+
+	/// Most recently used transforms, the last one is the most recent
+	struct TransformCache {
+		std::mutex mutex;
+		std::vector<std::pair<std::pair<uint64_t, uint64_t>, std::shared_ptr<const ICCTransform>>> entries;
+	};
+
+	TransformCache& GetTransformCache() {
+		static TransformCache cache;
+		return cache;
+	}
+
+	/**
+	Returns the cached transform between two profiles, builds it on a miss. A NULL src or dst is sRGB.
+	*/
+	std::shared_ptr<const ICCTransform> GetTransform(const FIICCPROFILE *src, const FIICCPROFILE *dst) {
+		const std::pair<uint64_t, uint64_t> key(HashProfile(src), HashProfile(dst));
+		TransformCache& cache = GetTransformCache();
+		{
+			std::lock_guard<std::mutex> lock(cache.mutex);
+			for (auto it = cache.entries.begin(); it != cache.entries.end(); ++it) {
+				if (it->first == key) {
+					auto transform = it->second;
+					cache.entries.erase(it);
+					cache.entries.emplace_back(key, transform);
+					return transform;
+				}
+			}
+		}
+
+		// built outside of the lock, concurrent misses on the same key build the same transform
+		auto transform = CreateTransform(src, dst);
+		if (transform) {
+			std::lock_guard<std::mutex> lock(cache.mutex);
+			if (cache.entries.size() >= kMaxCachedTransforms) {
+				cache.entries.erase(cache.entries.begin());
+			}
+			cache.entries.emplace_back(key, transform);
+		}
+		return transform;
+	}
+
+	// ----------------------------------------------------------
+	//  Tetrahedral interpolation
+	// ----------------------------------------------------------
+
+	/**
+	Nodes of the tetrahedron holding a point of a grid cell and the fractions along its edges.
+	The cell is split along its diagonal into 6 tetrahedra, selected by the order of the fractions.
+	*/
+	struct Tetrahedron {
+		size_t base;			// offset of the first vertex, the origin of the cell
+		size_t v1, v2, v3;		// offsets of the other vertices from base, v3 is the opposite corner
+		float f1, f2, f3;		// largest to smallest fraction
+	};
+
+	inline Tetrahedron Locate(const float *coords, unsigned grid) {
+		const size_t stride_b = 4, stride_g = stride_b * grid, stride_r = stride_g * grid;
+		unsigned i[3];
+		float f[3];
+		for (unsigned c = 0; c < 3; c++) {
+			const float x = std::clamp(coords[c], 0.0f, (float)(grid - 1));
+			i[c] = std::min((unsigned)x, grid - 2);
+			f[c] = x - i[c];
+		}
+		Tetrahedron t;
+		t.base = i[0] * stride_r + i[1] * stride_g + i[2] * stride_b;
+		t.v3 = stride_r + stride_g + stride_b;
+		const float fr = f[0], fg = f[1], fb = f[2];
+		if (fr >= fg) {
+			if (fg >= fb) {
+				t.v1 = stride_r; t.v2 = stride_r + stride_g; t.f1 = fr; t.f2 = fg; t.f3 = fb;
+			} else if (fr >= fb) {
+				t.v1 = stride_r; t.v2 = stride_r + stride_b; t.f1 = fr; t.f2 = fb; t.f3 = fg;
+			} else {
+				t.v1 = stride_b; t.v2 = stride_r + stride_b; t.f1 = fb; t.f2 = fr; t.f3 = fg;
+			}
+		} else {
+			if (fr >= fb) {
+				t.v1 = stride_g; t.v2 = stride_r + stride_g; t.f1 = fg; t.f2 = fr; t.f3 = fb;
+			} else if (fg >= fb) {
+				t.v1 = stride_g; t.v2 = stride_g + stride_b; t.f1 = fg; t.f2 = fb; t.f3 = fr;
+			} else {
+				t.v1 = stride_b; t.v2 = stride_g + stride_b; t.f1 = fb; t.f2 = fg; t.f3 = fr;
+			}
+		}
+		return t;
+	}
+
+	/// Interpolates count points of 4 floats (grid coordinates r, g, b, unused) into 4 floats (r, g, b, unused)
+	using InterpolateKernel = void (*)(const float *nodes, unsigned grid, const float *coords, float *out, unsigned count);
+
+	void InterpolateScalar(const float *nodes, unsigned grid, const float *coords, float *out, unsigned count) {
+		for (unsigned i = 0; i < count; i++, coords += 4, out += 4) {
+			const Tetrahedron t = Locate(coords, grid);
+			const float *n0 = nodes + t.base, *n1 = n0 + t.v1, *n2 = n0 + t.v2, *n3 = n0 + t.v3;
+			for (unsigned c = 0; c < 4; c++) {
+				// same operations as the vector kernels, separate multiplies and adds
+				float value = n0[c] + t.f1 * (n1[c] - n0[c]);
+				value = value + t.f2 * (n2[c] - n1[c]);
+				out[c] = value + t.f3 * (n3[c] - n2[c]);
+			}
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+	/// See InterpolateScalar, the channels of a point are interpolated at once
+	void InterpolateSSE2(const float *nodes, unsigned grid, const float *coords, float *out, unsigned count) {
+		for (unsigned i = 0; i < count; i++, coords += 4, out += 4) {
+			const Tetrahedron t = Locate(coords, grid);
+			const float *n = nodes + t.base;
+			const __m128 n0 = _mm_loadu_ps(n);
+			const __m128 n1 = _mm_loadu_ps(n + t.v1);
+			const __m128 n2 = _mm_loadu_ps(n + t.v2);
+			const __m128 n3 = _mm_loadu_ps(n + t.v3);
+			__m128 value = _mm_add_ps(n0, _mm_mul_ps(_mm_set1_ps(t.f1), _mm_sub_ps(n1, n0)));
+			value = _mm_add_ps(value, _mm_mul_ps(_mm_set1_ps(t.f2), _mm_sub_ps(n2, n1)));
+			value = _mm_add_ps(value, _mm_mul_ps(_mm_set1_ps(t.f3), _mm_sub_ps(n3, n2)));
+			_mm_storeu_ps(out, value);
+		}
+	}
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+	/// See InterpolateScalar, separate multiplies and adds (no fused multiply-add) to match the scalar code
+	void InterpolateNEON(const float *nodes, unsigned grid, const float *coords, float *out, unsigned count) {
+		for (unsigned i = 0; i < count; i++, coords += 4, out += 4) {
+			const Tetrahedron t = Locate(coords, grid);
+			const float *n = nodes + t.base;
+			const float32x4_t n0 = vld1q_f32(n);
+			const float32x4_t n1 = vld1q_f32(n + t.v1);
+			const float32x4_t n2 = vld1q_f32(n + t.v2);
+			const float32x4_t n3 = vld1q_f32(n + t.v3);
+			float32x4_t value = vaddq_f32(n0, vmulq_n_f32(vsubq_f32(n1, n0), t.f1));
+			value = vaddq_f32(value, vmulq_n_f32(vsubq_f32(n2, n1), t.f2));
+			value = vaddq_f32(value, vmulq_n_f32(vsubq_f32(n3, n2), t.f3));
+			vst1q_f32(out, value);
+		}
+	}
+#endif // FREEIMAGE_SIMD_NEON
+
+	std::atomic<InterpolateKernel> gInterpolate{ InterpolateScalar };
+
+	void SelectICCKernels(uint32_t features) {
+		InterpolateKernel interpolate = InterpolateScalar;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			interpolate = InterpolateSSE2;
+		}
+#elif FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			interpolate = InterpolateNEON;
+		}
+#endif
+		gInterpolate.store(interpolate, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectICCKernels);
+
+	// ----------------------------------------------------------
+	//  Pixel rows
+	// ----------------------------------------------------------
+
+	/// Linear interpolation of a curve of kCurveSize entries at x in [0, 1]
+	inline float LookupCurve(const float (&curve)[kCurveSize], float x) {
+		const float pos = std::clamp(x, 0.0f, 1.0f) * (kCurveSize - 1);
+		const unsigned i = std::min((unsigned)pos, kCurveSize - 2);
+		return curve[i] + (pos - i) * (curve[i + 1] - curve[i]);
+	}
+
+	/**
+	Converts the rows of an image of 3 or 4 samples of type T per pixel, in RGB(A) order (BGR(A) when bgr is true).
+	Alpha samples are kept, samples are clipped to [0, maximum].
+	*/
+	template <typename T>
+	void TransformPixels(FIBITMAP *dib, const ICCTransform& transform, unsigned samples, bool bgr, float maximum) {
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+		const unsigned pitch = FreeImage_GetPitch(dib);
+		uint8_t *bits = FreeImage_GetBits(dib);
+		const unsigned channel[3] = { bgr ? 2U : 0U, 1U, bgr ? 0U : 2U };
+		const InterpolateKernel interpolate = gInterpolate.load(std::memory_order_relaxed);
+		const float scale = (float)(transform.grid - 1);
+
+		ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(dib)), [&](unsigned first, unsigned last) {
+			std::vector<float> coords(4 * (size_t)width), values(4 * (size_t)width);
+			for (unsigned y = first; y < last; y++) {
+				T *row = (T *)(bits + (size_t)pitch * y);
+				const T *p = row;
+				for (unsigned x = 0; x < width; x++, p += samples) {
+					for (unsigned c = 0; c < 3; c++) {
+						if constexpr (std::is_same_v<T, uint8_t>) {
+							coords[4 * x + c] = transform.input8[c][p[channel[c]]] * scale;
+						} else {
+							coords[4 * x + c] = LookupCurve(transform.input[c], p[channel[c]] / maximum) * scale;
+						}
+					}
+					coords[4 * x + 3] = 0;
+				}
+				interpolate(transform.nodes.data(), transform.grid, coords.data(), values.data(), width);
+				T *q = row;
+				for (unsigned x = 0; x < width; x++, q += samples) {
+					for (unsigned c = 0; c < 3; c++) {
+						const float encoded = LookupCurve(transform.output[c], std::sqrt(std::clamp(values[4 * x + c], 0.0f, 1.0f)));
+						if constexpr (std::is_floating_point_v<T>) {
+							q[channel[c]] = encoded;
+						} else {
+							q[channel[c]] = (T)(std::clamp(encoded, 0.0f, 1.0f) * maximum + 0.5f);
+						}
+					}
+				}
+			}
+		});
+	}
+
+	/**
+	Converts the pixels of dib from src to dst. A NULL src or dst is sRGB.
+	*/
+	bool TransformImage(FIBITMAP *dib, const FIICCPROFILE *src, const FIICCPROFILE *dst) {
+		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+		const unsigned bpp = FreeImage_GetBPP(dib);
+		switch (image_type) {
+			case FIT_BITMAP:
+				if ((bpp != 24) && (bpp != 32)) {
+					return false;
+				}
+				break;
+			case FIT_RGB16:
+			case FIT_RGBA16:
+			case FIT_RGBF:
+			case FIT_RGBAF:
+				break;
+			default:
+				return false;
+		}
+
+		auto transform = GetTransform(src, dst);
+		if (!transform) {
+			return false;
+		}
+		switch (image_type) {
+			case FIT_BITMAP:
+				TransformPixels<uint8_t>(dib, *transform, bpp / 8, FI_RGBA_RED == 2, 255.0f);
+				break;
+			case FIT_RGB16:
+			case FIT_RGBA16:
+				TransformPixels<uint16_t>(dib, *transform, (image_type == FIT_RGB16) ? 3 : 4, false, 65535.0f);
+				break;
+			default:
+				TransformPixels<float>(dib, *transform, (image_type == FIT_RGBF) ? 3 : 4, false, 1.0f);
+				break;
+		}
+		return true;
+	}
+
+	/// Returns the profile of dib, or NULL when dib has none (sRGB)
+	const FIICCPROFILE *GetSourceProfile(FIBITMAP *dib) {
+		const FIICCPROFILE *profile = FreeImage_GetICCProfile(dib);
+		return (profile && profile->data && profile->size) ? profile : nullptr;
+	}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+/**
+Converts the pixels of an image from its ICC profile to another RGB profile, which then replaces it.
+@param dib 24, 32-bit, FIT_RGB16, FIT_RGBA16, FIT_RGBF or FIT_RGBAF image, an image without profile is sRGB
+@param dst_profile Destination profile, NULL for sRGB (the profile of dib is then removed)
+@return Returns TRUE if successful, FALSE when the image type or a profile isn't supported
+*/
+FIBOOL DLL_CALLCONV
+FreeImage_ApplyICCTransform(FIBITMAP *dib, const FIICCPROFILE *dst_profile) {
+	if (!FreeImage_HasPixels(dib)) {
+		return FALSE;
+	}
+	const FIICCPROFILE *src = GetSourceProfile(dib);
+	if (src && (src->flags & (FIICC_COLOR_IS_CMYK | FIICC_COLOR_IS_YUV))) {
+		return FALSE;
+	}
+	const FIICCPROFILE *dst = (dst_profile && dst_profile->data && dst_profile->size) ? dst_profile : nullptr;
+
+	const bool same = (!src && !dst) || (src && dst && (src->size == dst->size) && (memcmp(src->data, dst->data, src->size) == 0));
+	if (!same && !TransformImage(dib, src, dst)) {
+		return FALSE;
+	}
+
+	if (dst) {
+		if (dst != src) {
+			FreeImage_CreateICCProfile(dib, dst->data, (long)dst->size);
+		}
+	} else {
+		FreeImage_DestroyICCProfile(dib);
+	}
+	return TRUE;
+}
+
+/**
+Converts the pixels of an image from its ICC profile to sRGB and removes the profile.
+@param dib 24, 32-bit, FIT_RGB16, FIT_RGBA16, FIT_RGBF or FIT_RGBAF image
+@return Returns TRUE if successful (an image without profile is left unchanged), FALSE otherwise
+*/
+FIBOOL DLL_CALLCONV
+FreeImage_ConvertToSRGB(FIBITMAP *dib) {
+	return FreeImage_ApplyICCTransform(dib, nullptr);
+}
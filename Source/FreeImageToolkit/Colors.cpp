@@ -26,6 +26,12 @@
 #include <complex>
 #include <cstring>
 #include "../FreeImage/SimpleTools.h"
+#include "../FreeImage/ConversionSIMD.h"
+#include "../FreeImage/CPUDispatch.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 // ----------------------------------------------------------
 //   Macros + structures
@@ -40,6 +46,199 @@
 
 // ----------------------------------------------------------
 
+// ----------------------------------------------------------
+//   Lookup tables engine
+// ----------------------------------------------------------
+
+namespace {
+
+	/**
+	Per channel 8-bit lookup tables of a scanline of 1, 3 or 4 bytes per pixel.
+	wide holds the tables of the AVX2 kernel: a scanline is read by dwords, the byte j of the dword d is
+	looked up in wide[d % period][j * 256 + value], which stores the result already shifted to byte j.
+	*/
+	struct ByteLUTs {
+		uint8_t lut[4][256];
+		uint32_t wide[3][1024];
+		unsigned channels;
+		unsigned period;
+	};
+
+	using ByteLUTsKernel = void (*)(uint8_t *row, unsigned width, const ByteLUTs &luts);
+
+	void ApplyByteLUTs(uint8_t *row, unsigned width, const ByteLUTs &luts) {
+		switch (luts.channels) {
+			case 1:
+				for (unsigned x = 0; x < width; x++) {
+					row[x] = luts.lut[0][row[x]];
+				}
+				break;
+			case 3:
+				for (unsigned x = 0; x < width; x++, row += 3) {
+					row[0] = luts.lut[0][row[0]];
+					row[1] = luts.lut[1][row[1]];
+					row[2] = luts.lut[2][row[2]];
+				}
+				break;
+			case 4:
+				for (unsigned x = 0; x < width; x++, row += 4) {
+					row[0] = luts.lut[0][row[0]];
+					row[1] = luts.lut[1][row[1]];
+					row[2] = luts.lut[2][row[2]];
+					row[3] = luts.lut[3][row[3]];
+				}
+				break;
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+	FI_TARGET("avx2")
+	void ApplyByteLUTs_AVX2(uint8_t *row, unsigned width, const ByteLUTs &luts) {
+		const int *tables = reinterpret_cast<const int *>(luts.wide);
+		const unsigned period = luts.period;
+		const size_t bytes = (size_t)width * luts.channels;
+		const size_t step = 32 * period;
+		const __m256i mask = _mm256_set1_epi32(0xFF);
+		// offset of the table of each dword of the vectors of a period
+		__m256i base[3];
+		for (unsigned v = 0; v < period; v++) {
+			alignas(32) int offsets[8];
+			for (unsigned k = 0; k < 8; k++) {
+				offsets[k] = (int)(((8 * v + k) % period) * 1024);
+			}
+			base[v] = _mm256_load_si256((const __m256i *)offsets);
+		}
+		size_t i = 0;
+		for (; i + step <= bytes; i += step) {
+			for (unsigned v = 0; v < period; v++) {
+				__m256i *p = (__m256i *)(row + i + 32 * v);
+				const __m256i px = _mm256_loadu_si256(p);
+				__m256i index = _mm256_add_epi32(_mm256_and_si256(px, mask), base[v]);
+				__m256i r = _mm256_i32gather_epi32(tables, index, 4);
+				index = _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(px, 8), mask), _mm256_add_epi32(base[v], _mm256_set1_epi32(256)));
+				r = _mm256_or_si256(r, _mm256_i32gather_epi32(tables, index, 4));
+				index = _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(px, 16), mask), _mm256_add_epi32(base[v], _mm256_set1_epi32(512)));
+				r = _mm256_or_si256(r, _mm256_i32gather_epi32(tables, index, 4));
+				index = _mm256_add_epi32(_mm256_srli_epi32(px, 24), _mm256_add_epi32(base[v], _mm256_set1_epi32(768)));
+				r = _mm256_or_si256(r, _mm256_i32gather_epi32(tables, index, 4));
+				_mm256_storeu_si256(p, r);
+			}
+		}
+		// i is a multiple of the pixel size, the remaining pixels are done one by one
+		ApplyByteLUTs(row + i, (unsigned)((bytes - i) / luts.channels), luts);
+	}
+#endif
+
+#if FREEIMAGE_SIMD_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+	/// Looks up 16 bytes in a table of 256 bytes with four 64 bytes table lookups
+	inline uint8x16_t Lookup_NEON(const uint8_t *lut, uint8x16_t index) {
+		const uint8x16_t step = vdupq_n_u8(64);
+		uint8x16_t r = vqtbl4q_u8(vld1q_u8_x4(lut), index);
+		index = vsubq_u8(index, step);
+		r = vqtbx4q_u8(r, vld1q_u8_x4(lut + 64), index);
+		index = vsubq_u8(index, step);
+		r = vqtbx4q_u8(r, vld1q_u8_x4(lut + 128), index);
+		index = vsubq_u8(index, step);
+		return vqtbx4q_u8(r, vld1q_u8_x4(lut + 192), index);
+	}
+
+	void ApplyByteLUTs_NEON(uint8_t *row, unsigned width, const ByteLUTs &luts) {
+		unsigned x = 0;
+		switch (luts.channels) {
+			case 1:
+				for (; x + 16 <= width; x += 16) {
+					vst1q_u8(row + x, Lookup_NEON(luts.lut[0], vld1q_u8(row + x)));
+				}
+				break;
+			case 3:
+				for (; x + 16 <= width; x += 16) {
+					uint8x16x3_t v = vld3q_u8(row + 3 * x);
+					for (unsigned c = 0; c < 3; c++) {
+						v.val[c] = Lookup_NEON(luts.lut[c], v.val[c]);
+					}
+					vst3q_u8(row + 3 * x, v);
+				}
+				break;
+			case 4:
+				for (; x + 16 <= width; x += 16) {
+					uint8x16x4_t v = vld4q_u8(row + 4 * x);
+					for (unsigned c = 0; c < 4; c++) {
+						v.val[c] = Lookup_NEON(luts.lut[c], v.val[c]);
+					}
+					vst4q_u8(row + 4 * x, v);
+				}
+				break;
+		}
+		ApplyByteLUTs(row + x * luts.channels, width - x, luts);
+	}
+#endif
+
+	std::atomic<ByteLUTsKernel> gByteLUTs{ ApplyByteLUTs };
+
+	void SelectLUTKernels(unsigned features) {
+		ByteLUTsKernel kernel = ApplyByteLUTs;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_AVX2) {
+			kernel = ApplyByteLUTs_AVX2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+		if (features & FI_CPU_NEON) {
+			kernel = ApplyByteLUTs_NEON;
+		}
+#endif
+		gByteLUTs.store(kernel, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gLUTRegistrar(SelectLUTKernels);
+
+	/**
+	Applies tables[c] to the channel c of the pixels of dib by parallel bands of scanlines, NULL tables keep their channel
+	*/
+	void ApplyByteLUTsToPixels(FIBITMAP *dib, unsigned channels, const uint8_t *const *tables) {
+		auto luts = std::make_unique<ByteLUTs>();
+		luts->channels = channels;
+		luts->period = (channels == 3) ? 3 : 1;
+		for (unsigned c = 0; c < channels; c++) {
+			for (unsigned v = 0; v < 256; v++) {
+				luts->lut[c][v] = tables[c] ? tables[c][v] : (uint8_t)v;
+			}
+		}
+		for (unsigned p = 0; p < luts->period; p++) {
+			for (unsigned j = 0; j < 4; j++) {
+				const uint8_t *lut = luts->lut[(4 * p + j) % channels];
+				for (unsigned v = 0; v < 256; v++) {
+					luts->wide[p][j * 256 + v] = (uint32_t)lut[v] << (8 * j);
+				}
+			}
+		}
+		const ByteLUTsKernel kernel = gByteLUTs.load(std::memory_order_relaxed);
+		const unsigned width = FreeImage_GetWidth(dib);
+		const ByteLUTs &ref = *luts;
+		ConvertScanLines(dib, dib, [&](uint8_t *line, uint8_t *) {
+			kernel(line, width, ref);
+		});
+	}
+
+	/**
+	Same as ApplyByteLUTsToPixels for 16-bit samples, there is no faster gather than scalar loads in tables of 128 KB
+	*/
+	void ApplyWordLUTsToPixels(FIBITMAP *dib, unsigned channels, const uint16_t *const *tables) {
+		const unsigned width = FreeImage_GetWidth(dib);
+		ConvertScanLines(dib, dib, [&](uint8_t *line, uint8_t *) {
+			auto *pixel = (uint16_t *)line;
+			for (unsigned c = 0; c < channels; c++) {
+				if (const uint16_t *lut = tables[c]) {
+					for (unsigned x = 0; x < width; x++) {
+						pixel[x * channels + c] = lut[pixel[x * channels + c]];
+					}
+				}
+			}
+		});
+	}
+
+} // namespace
+
 
 /** @brief Inverts each pixel data.
 
@@ -60,6 +259,11 @@ FreeImage_Invert(FIBITMAP *src) {
 	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 
 	if (image_type == FIT_BITMAP) {
+		uint8_t LUT[256];
+		for (i = 0; i < 256; i++) {
+			LUT[i] = (uint8_t)~i;
+		}
+
 		switch (bpp) {
 			case 1 :
 			case 4 :
@@ -68,21 +272,14 @@ FreeImage_Invert(FIBITMAP *src) {
 				// if the dib has a colormap, just invert it
 				// else, keep the linear grayscale
 
-				if (FreeImage_GetColorType(src) == FIC_PALETTE) {
-					FIRGBA8 *pal = FreeImage_GetPalette(src);
-
-					for (i = 0; i < FreeImage_GetColorsUsed(src); i++) {
-						pal[i].red	= 255 - pal[i].red;
-						pal[i].green = 255 - pal[i].green;
-						pal[i].blue	= 255 - pal[i].blue;
-					}
-				} else {
-					for (y = 0; y < height; y++) {
-						uint8_t *bits = FreeImage_GetScanLine(src, y);
+				if ((FreeImage_GetColorType(src) == FIC_PALETTE) || (bpp == 8)) {
+					return FreeImage_ApplyLUTs(src, LUT, LUT, LUT, nullptr);
+				}
+				for (y = 0; y < height; y++) {
+					uint8_t *bits = FreeImage_GetScanLine(src, y);
 
-						for (x = 0; x < FreeImage_GetLine(src); x++) {
-							bits[x] = ~bits[x];
-						}
+					for (x = 0; x < FreeImage_GetLine(src); x++) {
+						bits[x] = ~bits[x];
 					}
 				}
 
@@ -91,22 +288,9 @@ FreeImage_Invert(FIBITMAP *src) {
 
 			case 24 :
 			case 32 :
-			{
-				// Calculate the number of bytes per pixel (3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / width;
-
-				for (y = 0; y < height; y++) {
-					uint8_t *bits = FreeImage_GetScanLine(src, y);
-					for (x = 0; x < width; x++) {
-						for (k = 0; k < bytespp; k++) {
-							bits[k] = ~bits[k];
-						}
-						bits += bytespp;
-					}
-				}
+				// alpha is inverted too
+				return FreeImage_ApplyLUTs(src, LUT, LUT, LUT, LUT);
 
-				break;
-			}
 			default:
 				return FALSE;
 		}
@@ -133,6 +317,86 @@ FreeImage_Invert(FIBITMAP *src) {
 	return TRUE;
 }
 
+/** @brief Applies one lookup table per channel in a single pass over an image.
+
+Image 1, 4 & 8-bit palletized : the tables are applied to the palette.<br>
+Image 8-bit greyscale & FIT_UINT16 : lutR is applied to the grey values.<br>
+Image 24 & 32-bit, FIT_RGB16 & FIT_RGBA16 : each table is applied to its channel, lutA to
+the alpha channel of 32-bit and FIT_RGBA16 images only.<br>
+8-bit channels use tables of 256 uint8_t, 16-bit channels tables of 65536 uint16_t. A NULL
+table leaves its channel unchanged. Scanlines are processed by parallel bands, 8-bit tables
+with AVX2 gathers or NEON table lookups.
+@param dib Input/output image to be processed.
+@param lutR Lookup table of the red (or grey) channel, or NULL.
+@param lutG Lookup table of the green channel, or NULL.
+@param lutB Lookup table of the blue channel, or NULL.
+@param lutA Lookup table of the alpha channel, or NULL.
+@return Returns TRUE if successful, FALSE otherwise.
+*/
+FIBOOL DLL_CALLCONV
+FreeImage_ApplyLUTs(FIBITMAP *dib, const void *lutR, const void *lutG, const void *lutB, const void *lutA) {
+	if (!FreeImage_HasPixels(dib)) {
+		return FALSE;
+	}
+
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	switch (FreeImage_GetImageType(dib)) {
+		case FIT_BITMAP:
+		{
+			const auto *r = (const uint8_t *)lutR;
+			const auto *g = (const uint8_t *)lutG;
+			const auto *b = (const uint8_t *)lutB;
+			if ((bpp <= 8) && ((bpp < 8) || (FreeImage_GetColorType(dib) == FIC_PALETTE))) {
+				FIRGBA8 *pal = FreeImage_GetPalette(dib);
+				for (unsigned i = 0; i < FreeImage_GetColorsUsed(dib); i++) {
+					pal[i].red = r ? r[pal[i].red] : pal[i].red;
+					pal[i].green = g ? g[pal[i].green] : pal[i].green;
+					pal[i].blue = b ? b[pal[i].blue] : pal[i].blue;
+				}
+				return TRUE;
+			}
+			if (bpp == 8) {
+				if (r) {
+					ApplyByteLUTsToPixels(dib, 1, &r);
+				}
+				return TRUE;
+			}
+			if ((bpp != 24) && (bpp != 32)) {
+				return FALSE;
+			}
+			const uint8_t *tables[4];
+			tables[FI_RGBA_RED] = r;
+			tables[FI_RGBA_GREEN] = g;
+			tables[FI_RGBA_BLUE] = b;
+			tables[FI_RGBA_ALPHA] = (const uint8_t *)lutA;
+			const unsigned channels = bpp / 8;
+			for (unsigned c = 0; c < channels; c++) {
+				if (tables[c]) {
+					ApplyByteLUTsToPixels(dib, channels, tables);
+					break;
+				}
+			}
+			return TRUE;
+		}
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		{
+			const uint16_t *tables[4] = { (const uint16_t *)lutR, (const uint16_t *)lutG, (const uint16_t *)lutB, (const uint16_t *)lutA };
+			const unsigned channels = bpp / 16;
+			for (unsigned c = 0; c < channels; c++) {
+				if (tables[c]) {
+					ApplyWordLUTsToPixels(dib, channels, tables);
+					break;
+				}
+			}
+			return TRUE;
+		}
+		default:
+			return FALSE;
+	}
+}
+
 /** @brief Perfoms an histogram transformation on a 8, 24 or 32-bit image 
 according to the values of a lookup table (LUT).
 
@@ -149,9 +413,6 @@ plane (R,G, and B). Otherwise, the LUT is applied to the specified channel only.
 */
 FIBOOL DLL_CALLCONV 
 FreeImage_AdjustCurve(FIBITMAP *src, uint8_t *LUT, FREE_IMAGE_COLOR_CHANNEL channel) {
-	unsigned x, y;
-	uint8_t *bits{};
-
 	if (!FreeImage_HasPixels(src) || !LUT || (FreeImage_GetImageType(src) != FIT_BITMAP))
 		return FALSE;
 
@@ -159,108 +420,22 @@ FreeImage_AdjustCurve(FIBITMAP *src, uint8_t *LUT, FREE_IMAGE_COLOR_CHANNEL chan
 	if ((bpp != 8) && (bpp != 24) && (bpp != 32))
 		return FALSE;
 
-	// apply the LUT
-	switch (bpp) {
-
-		case 8 :
-		{
-			// if the dib has a colormap, apply the LUT to it
-			// else, apply the LUT to pixel values
-
-			if (FreeImage_GetColorType(src) == FIC_PALETTE) {
-				FIRGBA8 *rgb = FreeImage_GetPalette(src);
-				for (unsigned pal = 0; pal < FreeImage_GetColorsUsed(src); pal++) {
-					rgb->red   = LUT[rgb->red];
-					rgb->green = LUT[rgb->green];
-					rgb->blue  = LUT[rgb->blue];
-					rgb++;
-				}
-			}
-			else {
-				for (y = 0; y < FreeImage_GetHeight(src); y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for (x = 0; x < FreeImage_GetWidth(src); x++) {
-						bits[x] = LUT[ bits[x] ];
-					}
-				}
-			}
-
-			break;
-		}
-
-		case 24 :
-		case 32 :
-		{
-			const int bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			switch (channel) {
-				case FICC_RGB :
-					for (y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for (x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_BLUE]	= LUT[ bits[FI_RGBA_BLUE] ];	// B
-							bits[FI_RGBA_GREEN] = LUT[ bits[FI_RGBA_GREEN] ];	// G
-							bits[FI_RGBA_RED]	= LUT[ bits[FI_RGBA_RED] ];		// R
-							
-							bits += bytespp;
-						}
-					}
-					break;
-
-				case FICC_BLUE :
-					for (y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for (x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_BLUE] = LUT[ bits[FI_RGBA_BLUE] ];		// B
-							
-							bits += bytespp;
-						}
-					}
-					break;
-
-				case FICC_GREEN :
-					for (y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for (x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_GREEN] = LUT[ bits[FI_RGBA_GREEN] ];	// G
-							
-							bits += bytespp;
-						}
-					}
-					break;
-
-				case FICC_RED :
-					for (y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for (x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_RED] = LUT[ bits[FI_RGBA_RED] ];		// R
-							
-							bits += bytespp;
-						}
-					}
-					break;
-					
-				case FICC_ALPHA :
-					if (32 == bpp) {
-						for (y = 0; y < FreeImage_GetHeight(src); y++) {
-							bits =  FreeImage_GetScanLine(src, y);
-							for (x = 0; x < FreeImage_GetWidth(src); x++) {
-								bits[FI_RGBA_ALPHA] = LUT[ bits[FI_RGBA_ALPHA] ];	// A
-								
-								bits += bytespp;
-							}
-						}
-					}
-					break;
-
-				default:
-					break;
-			}
-			break;
-		}
+	// the channel is only used with 24 & 32-bit images
+	if ((bpp == 8) || (channel == FICC_RGB)) {
+		return FreeImage_ApplyLUTs(src, LUT, LUT, LUT, nullptr);
+	}
+	switch (channel) {
+		case FICC_RED :
+			return FreeImage_ApplyLUTs(src, LUT, nullptr, nullptr, nullptr);
+		case FICC_GREEN :
+			return FreeImage_ApplyLUTs(src, nullptr, LUT, nullptr, nullptr);
+		case FICC_BLUE :
+			return FreeImage_ApplyLUTs(src, nullptr, nullptr, LUT, nullptr);
+		case FICC_ALPHA :
+			return FreeImage_ApplyLUTs(src, nullptr, nullptr, nullptr, LUT);
+		default:
+			return TRUE;
 	}
-
-	return TRUE;
 }
 
 /** @brief Performs gamma correction on a 8, 24 or 32-bit image.
@@ -292,6 +467,118 @@ FreeImage_AdjustGamma(FIBITMAP *src, double gamma) {
 	return FreeImage_AdjustCurve(src, LUT, FICC_RGB);
 }
 
+/**
+Evaluates a transfer function in double precision, v is normalized to [0, 1]
+*/
+static double
+TransferValue(double v, FREE_IMAGE_TRANSFER transfer) {
+	// SMPTE ST 2084 (PQ)
+	const double m1 = 2610.0 / 16384, m2 = 2523.0 / 4096 * 128, c1 = 3424.0 / 4096, c2 = 2413.0 / 4096 * 32, c3 = 2392.0 / 4096 * 32;
+	// ARIB STD-B67 (HLG)
+	const double a = 0.17883277, b = 1 - 4 * a, c = 0.5 - a * log(4 * a);
+
+	switch (transfer) {
+		case FITF_SRGB_TO_LINEAR:
+			return (v <= 0.04045) ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+		case FITF_LINEAR_TO_SRGB:
+			return (v <= 0.0031308) ? v * 12.92 : 1.055 * pow(v, 1 / 2.4) - 0.055;
+		case FITF_PQ_TO_LINEAR:
+		{
+			const double p = pow(v, 1 / m2);
+			return pow(MAX(p - c1, 0.0) / (c2 - c3 * p), 1 / m1);
+		}
+		case FITF_LINEAR_TO_PQ:
+		{
+			const double p = pow(v, m1);
+			return pow((c1 + c2 * p) / (1 + c3 * p), m2);
+		}
+		case FITF_HLG_TO_LINEAR:
+			return (v <= 0.5) ? v * v / 3 : (exp((v - c) / a) + b) / 12;
+		case FITF_LINEAR_TO_HLG:
+			return (v <= 1.0 / 12) ? sqrt(3 * v) : a * log(12 * v - b) + c;
+		default:
+			return v;
+	}
+}
+
+/** @brief Converts the samples of an image with a transfer function.
+
+Integer samples are mapped through exact lookup tables, float samples through the polynomial 
+approximations of ApplyTransfer. Alpha channels are kept.
+@param dib Input image, a 8, 24, 32-bit, FIT_UINT16, FIT_RGB16, FIT_RGBA16, FIT_FLOAT, FIT_RGBF or FIT_RGBAF image.
+@param transfer Transfer function to apply.
+@return Returns the converted image of the same type if successful, NULL otherwise.
+*/
+FIBITMAP * DLL_CALLCONV 
+FreeImage_ConvertTransfer(FIBITMAP *dib, FREE_IMAGE_TRANSFER transfer) {
+	if (!FreeImage_HasPixels(dib) || (transfer < FITF_SRGB_TO_LINEAR) || (transfer > FITF_LINEAR_TO_HLG)) {
+		return nullptr;
+	}
+
+	unsigned channels = 0;
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	switch (image_type) {
+		case FIT_BITMAP:
+		{
+			const unsigned bpp = FreeImage_GetBPP(dib);
+			if ((bpp != 8) && (bpp != 24) && (bpp != 32)) {
+				return nullptr;
+			}
+			break;
+		}
+		case FIT_UINT16:
+		case FIT_FLOAT:
+			channels = 1;
+			break;
+		case FIT_RGB16:
+		case FIT_RGBF:
+			channels = 3;
+			break;
+		case FIT_RGBA16:
+		case FIT_RGBAF:
+			channels = 4;
+			break;
+		default:
+			return nullptr;
+	}
+
+	FIBITMAP *dst = FreeImage_Clone(dib);
+	if (!dst) {
+		return nullptr;
+	}
+
+	const unsigned width = FreeImage_GetWidth(dst);
+	switch (image_type) {
+		case FIT_BITMAP:
+		{
+			uint8_t LUT[256];
+			for (int i = 0; i < 256; i++) {
+				LUT[i] = (uint8_t)floor(CLAMP(TransferValue(i / 255.0, transfer), 0.0, 1.0) * 255 + 0.5);
+			}
+			FreeImage_AdjustCurve(dst, LUT, FICC_RGB);
+			break;
+		}
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		{
+			std::vector<uint16_t> LUT(65536);
+			for (unsigned i = 0; i < 65536; i++) {
+				LUT[i] = (uint16_t)floor(CLAMP(TransferValue(i / 65535.0, transfer), 0.0, 1.0) * 65535 + 0.5);
+			}
+			FreeImage_ApplyLUTs(dst, LUT.data(), LUT.data(), LUT.data(), nullptr);
+			break;
+		}
+		default:
+			ConvertScanLines(dst, dst, [&](uint8_t *dst_line, uint8_t *) {
+				ApplyTransfer((float*)dst_line, width * channels, channels, transfer);
+			});
+			break;
+	}
+
+	return dst;
+}
+
 /** @brief Adjusts the brightness of a 8, 24 or 32-bit image by a certain amount.
 
 @param src Input image to be processed.
@@ -344,11 +631,54 @@ FreeImage_AdjustContrast(FIBITMAP *src, double percentage) {
 	return FreeImage_AdjustCurve(src, LUT, FICC_RGB);
 }
 
+namespace {
+
+	/**
+	Computes the 256 bins histogram of value(pixel) over the pixels of dib by parallel bands, about one band per thread.
+	Consecutive pixels are counted in four sub-histograms, so that runs of equal values do not wait for each other's
+	increment, the sub-histograms are merged at the end of the band.
+	*/
+	template <typename Value_>
+	void ByteHistogram(FIBITMAP *dib, unsigned bytespp, uint32_t *histo, const Value_ &value) {
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+		const unsigned pitch = FreeImage_GetPitch(dib);
+		const uint8_t *bits = FreeImage_GetConstBits(dib);
+		const unsigned threads = std::max(1u, FreeImage_GetThreadCount());
+		const unsigned grain = std::max(CalculateBandRows(FreeImage_GetLine(dib)), (height + threads - 1) / threads);
+
+		memset(histo, 0, 256 * sizeof(uint32_t));
+		std::mutex mutex;
+		ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+			uint32_t local[4][256] = {};
+			for (unsigned y = first; y < last; y++) {
+				const uint8_t *pixel = bits + (size_t)pitch * y;
+				unsigned x = 0;
+				for (; x + 4 <= width; x += 4, pixel += 4 * bytespp) {
+					++local[0][value(pixel)];
+					++local[1][value(pixel + bytespp)];
+					++local[2][value(pixel + 2 * bytespp)];
+					++local[3][value(pixel + 3 * bytespp)];
+				}
+				for (; x < width; x++, pixel += bytespp) {
+					++local[0][value(pixel)];
+				}
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			for (unsigned i = 0; i < 256; i++) {
+				histo[i] += local[0][i] + local[1][i] + local[2][i] + local[3][i];
+			}
+		});
+	}
+
+} // namespace
+
 /** @brief Computes image histogram
 
 For 24-bit and 32-bit images, histogram can be computed from red, green, blue and 
 black channels. For 8-bit images, histogram is computed from the black channel. Other 
 bit depth is not supported (nothing is done).
+Pixels are counted by parallel bands of scanlines.
 @param src Input image to be processed.
 @param histo Histogram array to fill. <b>The size of 'histo' is assumed to be 256.</b>
 @param channel Color channel to use
@@ -356,85 +686,40 @@ bit depth is not supported (nothing is done).
 */
 FIBOOL DLL_CALLCONV 
 FreeImage_GetHistogram(FIBITMAP *src, uint32_t *histo, FREE_IMAGE_COLOR_CHANNEL channel) {
-	uint8_t pixel;
-	uint8_t *bits{};
-	unsigned x, y;
-
 	if (!FreeImage_HasPixels(src) || !histo) return FALSE;
 
-	const unsigned width  = FreeImage_GetWidth(src);
-	const unsigned height = FreeImage_GetHeight(src);
 	const unsigned bpp    = FreeImage_GetBPP(src);
 
 	if (bpp == 8) {
-		// clear histogram array
-		memset(histo, 0, 256 * sizeof(uint32_t));
 		// compute histogram for black channel
-		for (y = 0; y < height; y++) {
-			bits = FreeImage_GetScanLine(src, y);
-			for (x = 0; x < width; x++) {
-				// get pixel value
-				pixel = bits[x];
-				histo[pixel]++;
-			}
-		}
+		ByteHistogram(src, 1, histo, [](const uint8_t *pixel) { return pixel[0]; });
 		return TRUE;
 	}
 	else if ((bpp == 24) || (bpp == 32)) {
-		int bytespp = bpp / 8;	// bytes / pixel
-
-		// clear histogram array
-		memset(histo, 0, 256 * sizeof(uint32_t));
+		const unsigned bytespp = bpp / 8;	// bytes / pixel
 
 		switch (channel) {
 			case FICC_RED:
 				// compute histogram for red channel
-				for (y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for (x = 0; x < width; x++) {
-						pixel = bits[FI_RGBA_RED];	// R
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
+				ByteHistogram(src, bytespp, histo, [](const uint8_t *pixel) { return pixel[FI_RGBA_RED]; });
 				return TRUE;
 
 			case FICC_GREEN:
 				// compute histogram for green channel
-				for (y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for (x = 0; x < width; x++) {
-						pixel = bits[FI_RGBA_GREEN];	// G
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
+				ByteHistogram(src, bytespp, histo, [](const uint8_t *pixel) { return pixel[FI_RGBA_GREEN]; });
 				return TRUE;
 
 			case FICC_BLUE:
 				// compute histogram for blue channel
-				for (y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for (x = 0; x < width; x++) {
-						pixel = bits[FI_RGBA_BLUE];	// B
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
+				ByteHistogram(src, bytespp, histo, [](const uint8_t *pixel) { return pixel[FI_RGBA_BLUE]; });
 				return TRUE;
 
 			case FICC_BLACK:
 			case FICC_RGB:
-				// compute histogram for black channel
-				for (y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for (x = 0; x < width; x++) {
-						// RGB to GREY conversion
-						pixel = GREY(bits[FI_RGBA_RED], bits[FI_RGBA_GREEN], bits[FI_RGBA_BLUE]);
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
+				// compute histogram for black channel (RGB to GREY conversion)
+				ByteHistogram(src, bytespp, histo, [](const uint8_t *pixel) {
+					return GREY(pixel[FI_RGBA_RED], pixel[FI_RGBA_GREEN], pixel[FI_RGBA_BLUE]);
+				});
 				return TRUE;
 				
 			default:
@@ -467,11 +752,23 @@ namespace
 			mHist[0] = v;
 		}
 
+		/// Counts pixel in local, a dense histogram of a band of the image
 		template <typename PixelType_, typename IndexFunction_>
-		void Add(const PixelType_& pixel, IndexFunction_&& indexFunction) const
+		void Add(uint32_t* local, const PixelType_& pixel, const IndexFunction_& indexFunction) const
 		{
-			const auto i = std::forward<IndexFunction_>(indexFunction)(PixelSelector_::operator()(pixel));
-			++mHist[i * mStride];
+			++local[indexFunction(PixelSelector_::operator()(pixel))];
+		}
+
+		/// Adds lanes dense histograms of binsNumber bins each to the result
+		void Merge(const uint32_t* local, uint32_t lanes, uint32_t binsNumber) const
+		{
+			for (uint32_t i = 0; i < binsNumber; ++i) {
+				uint32_t sum = 0;
+				for (uint32_t lane = 0; lane < lanes; ++lane) {
+					sum += local[lane * binsNumber + i];
+				}
+				mHist[i * mStride] += sum;
+			}
 		}
 
 	private:
@@ -479,6 +776,52 @@ namespace
 		uint32_t mStride;
 	};
 
+	/**
+	Number of sub-histograms of a band, consecutive pixels are counted in different ones.
+	Runs of equal pixels would otherwise increment the same counter back to back, each increment
+	waiting for the store of the previous one.
+	*/
+	inline uint32_t HistogramLanes(uint32_t binsNumber) {
+		return (binsNumber <= 4096) ? 4 : 1;
+	}
+
+	/**
+	Counts the pixels of dib by parallel bands of scanlines, about one band per thread.
+	Each band fills its own sub-histograms, merged into the results of the builders at the end of the band.
+	*/
+	template <typename PixelType_, typename IndexFunction_, typename... Builders_>
+	void AccumulateHistograms(FIBITMAP* dib, uint32_t binsNumber, const IndexFunction_& indexFunction, const Builders_&... builders)
+	{
+		if constexpr (sizeof...(Builders_) == 0) {
+			return;
+		}
+		else {
+			const unsigned width = FreeImage_GetWidth(dib);
+			const unsigned height = FreeImage_GetHeight(dib);
+			const unsigned pitch = FreeImage_GetPitch(dib);
+			const uint8_t* bits = FreeImage_GetConstBits(dib);
+			const uint32_t lanes = HistogramLanes(binsNumber);
+			const unsigned threads = std::max(1u, FreeImage_GetThreadCount());
+			const unsigned grain = std::max(CalculateBandRows(FreeImage_GetLine(dib)), (height + threads - 1) / threads);
+
+			std::mutex mutex;
+			ParallelFor(0, height, grain, [&](unsigned first, unsigned last) {
+				std::vector<uint32_t> local((size_t)sizeof...(Builders_) * lanes * binsNumber, 0u);
+				for (unsigned y = first; y < last; ++y) {
+					const auto* pixel = reinterpret_cast<const PixelType_*>(bits + (size_t)pitch * y);
+					for (unsigned x = 0; x < width; ++x) {
+						uint32_t* lane = local.data() + (size_t)(x & (lanes - 1)) * binsNumber;
+						size_t b = 0;
+						(..., builders.Add(lane + (b++) * lanes * binsNumber, pixel[x], indexFunction));
+					}
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				size_t b = 0;
+				(..., builders.Merge(local.data() + (b++) * lanes * binsNumber, lanes, binsNumber));
+			});
+		}
+	}
+
 	template <typename PixelType_>
 	class HistogramFloat
 	{
@@ -519,9 +862,7 @@ namespace
 				return std::min(i, mBinsNumber - 1);
 			};
 
-			BitmapForEach<PixelType_>(mBitmap, [&](const PixelType_& p, uint32_t /*x*/, uint32_t /*y*/) {
-				(..., builders.Add(p, CalculateBinIndex));
-			});
+			AccumulateHistograms<PixelType_>(mBitmap, mBinsNumber, CalculateBinIndex, builders...);
 			return true;
 		}
 
@@ -567,9 +908,7 @@ namespace
 				return std::min(i, mBinsNumber - 1);
 			};
 
-			BitmapForEach<PixelType_>(mBitmap, [&](const PixelType_& p, uint32_t /*x*/, uint32_t /*y*/) {
-				(..., builders.Add(p, CalculateBinIndexSigned));
-			});
+			AccumulateHistograms<PixelType_>(mBitmap, mBinsNumber, CalculateBinIndexSigned, builders...);
 			return true;
 		}
 
@@ -612,9 +951,7 @@ namespace
 					return std::min(i, mBinsNumber - 1);
 				};
 
-				BitmapForEach<PixelType_>(mBitmap, [&](const PixelType_& p, uint32_t /*x*/, uint32_t /*y*/) {
-					(..., builders.Add(p, CalculateBinIndexWithoutScale));
-				});
+				AccumulateHistograms<PixelType_>(mBitmap, mBinsNumber, CalculateBinIndexWithoutScale, builders...);
 			}
 			else {
 				const auto CalculateBinIndexWithScale = [&](const ValueType& value) {
@@ -623,9 +960,7 @@ namespace
 					return std::min(i, mBinsNumber - 1);
 				};
 
-				BitmapForEach<PixelType_>(mBitmap, [&](const PixelType_& p, uint32_t /*x*/, uint32_t /*y*/) {
-					(..., builders.Add(p, CalculateBinIndexWithScale));
-				});
+				AccumulateHistograms<PixelType_>(mBitmap, mBinsNumber, CalculateBinIndexWithScale, builders...);
 			}
 			return true;
 		}
@@ -819,6 +1154,11 @@ FIBOOL FreeImage_MakeHistogram(FIBITMAP* dib, uint32_t binsNumber, void* outMinV
 			else if (colorType == FIC_MINISBLACK && bpp == 8) {
 				success = InvokeWithBuilders(HistogramUInt<uint8_t>(dib, binsNumber), HistogramBuilder<SelectIdentity>(histR, strideR));
 			}
+			else if (bpp <= 16) {
+				// palettized and 16-bit pixels are counted by their colors
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgb(FreeImage_ConvertTo24Bits(dib), &::FreeImage_Unload);
+				return rgb ? FreeImage_MakeHistogram(rgb.get(), binsNumber, outMinVal, outMaxVal, histR, strideR, histG, strideG, histB, strideB, histL, strideL) : FALSE;
+			}
 			if (success) {
 				SetIntMinMax<uint8_t>(outMinVal, outMaxVal);
 			}
@@ -842,6 +1182,11 @@ FIBOOL FreeImage_MakeHistogram(FIBITMAP* dib, uint32_t binsNumber, void* outMinV
 				HistogramBuilder<SelectGreen>(histG, strideG), HistogramBuilder<SelectBlue>(histB, strideB), HistogramBuilder<SelectRgbBrightness>(histL, strideL));
 		}
 		break;
+	case FIT_RGBAH: {
+			// half floats are binned as floats
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbaf(FreeImage_ConvertToRGBAF(dib), &::FreeImage_Unload);
+			return rgbaf ? FreeImage_MakeHistogram(rgbaf.get(), binsNumber, outMinVal, outMaxVal, histR, strideR, histG, strideG, histB, strideB, histL, strideL) : FALSE;
+		}
 	case FIT_COMPLEX: {
 			double minVal{}, maxVal{};
 			if (!FindHistogramBounds<FICOMPLEX>(dib, minVal, maxVal, outMinVal, outMaxVal)) {
@@ -1123,6 +1468,231 @@ FreeImage_AdjustColors(FIBITMAP *dib, double brightness, double contrast, double
 	return FALSE;
 }
 
+namespace {
+
+	/**
+	Index of the lowest set bit, mask must not be 0
+	*/
+	inline unsigned LowestBit(unsigned mask) {
+#if defined(__GNUC__) || defined(__clang__)
+		return (unsigned)__builtin_ctz(mask);
+#else
+		unsigned index = 0;
+		while (!(mask & 1)) {
+			mask >>= 1;
+			index++;
+		}
+		return index;
+#endif
+	}
+
+	/// Number of keys compared at once by the FindKey kernels
+	constexpr unsigned kSmallMapKeys = 8;
+
+	/**
+	Returns the index of the first of the kSmallMapKeys keys equal to key, or kSmallMapKeys if none is
+	*/
+	using FindKeyKernel = unsigned (*)(const uint32_t *keys, uint32_t key);
+
+	unsigned FindKey(const uint32_t *keys, uint32_t key) {
+		unsigned i = 0;
+		while ((i < kSmallMapKeys) && (keys[i] != key)) {
+			++i;
+		}
+		return i;
+	}
+
+#if FREEIMAGE_SIMD_X86
+	unsigned FindKey_SSE2(const uint32_t *keys, uint32_t key) {
+		const __m128i k = _mm_set1_epi32((int)key);
+		const __m128i lo = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)keys), k);
+		const __m128i hi = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(keys + 4)), k);
+		const unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(lo)) | ((unsigned)_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4);
+		return mask ? LowestBit(mask) : kSmallMapKeys;
+	}
+#endif
+
+#if FREEIMAGE_SIMD_NEON
+	unsigned FindKey_NEON(const uint32_t *keys, uint32_t key) {
+		static const uint32_t kBits[4] = { 1, 2, 4, 8 };
+		const uint32x4_t k = vdupq_n_u32(key);
+		const uint32x4_t bits = vld1q_u32(kBits);
+		const uint32x4_t lo = vandq_u32(vceqq_u32(vld1q_u32(keys), k), bits);
+		const uint32x4_t hi = vandq_u32(vceqq_u32(vld1q_u32(keys + 4), k), bits);
+		const uint32x4_t both = vorrq_u32(lo, vshlq_n_u32(hi, 4));
+		const uint32x2_t pair = vorr_u32(vget_low_u32(both), vget_high_u32(both));
+		const unsigned mask = vget_lane_u32(vorr_u32(pair, vrev64_u32(pair)), 0);
+		return mask ? LowestBit(mask) : kSmallMapKeys;
+	}
+#endif
+
+	std::atomic<FindKeyKernel> gFindKey{ FindKey };
+
+	void SelectColorMapKernels(unsigned features) {
+		FindKeyKernel find = FindKey;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			find = FindKey_SSE2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			find = FindKey_NEON;
+		}
+#endif
+		gFindKey.store(find, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectColorMapKernels);
+
+	/**
+	Maps packed colors to their replacement.
+	A key is only added once, so the first mapping of a color wins, in the order srccolors[0],
+	dstcolors[0] (with swap), srccolors[1] and so on. Up to kSmallMapKeys keys are compared by
+	vectors, more keys are looked up in an open addressing hash table of at least twice their number.
+	*/
+	class ColorMap {
+	public:
+		ColorMap(const FIRGBA8 *srccolors, const FIRGBA8 *dstcolors, unsigned count, FIBOOL swap, FIBOOL alpha) {
+			Reserve(swap ? 2 * count : count);
+			for (unsigned j = 0; j < count; j++) {
+				Add(Pack(srccolors[j], alpha), Pack(dstcolors[j], alpha));
+				if (swap) {
+					Add(Pack(dstcolors[j], alpha), Pack(srccolors[j], alpha));
+				}
+			}
+			Build();
+		}
+
+		template <class Key>
+		ColorMap(const Key *srckeys, const Key *dstkeys, unsigned count, FIBOOL swap) {
+			Reserve(swap ? 2 * count : count);
+			for (unsigned j = 0; j < count; j++) {
+				Add(srckeys[j], dstkeys[j]);
+				if (swap) {
+					Add(dstkeys[j], srckeys[j]);
+				}
+			}
+			Build();
+		}
+
+		/// Packs a color like the bytes of a 24- or 32-bit pixel read with ReadPixel
+		static uint32_t Pack(const FIRGBA8 &color, FIBOOL alpha) {
+			return ((uint32_t)color.red << 16) | ((uint32_t)color.green << 8) | color.blue | (alpha ? ((uint32_t)color.alpha << 24) : 0);
+		}
+
+		static uint32_t ReadPixel(const uint8_t *bits, FIBOOL alpha) {
+			return ((uint32_t)bits[FI_RGBA_RED] << 16) | ((uint32_t)bits[FI_RGBA_GREEN] << 8) | bits[FI_RGBA_BLUE] | (alpha ? ((uint32_t)bits[FI_RGBA_ALPHA] << 24) : 0);
+		}
+
+		static void WritePixel(uint8_t *bits, uint32_t value, FIBOOL alpha) {
+			bits[FI_RGBA_RED] = (uint8_t)(value >> 16);
+			bits[FI_RGBA_GREEN] = (uint8_t)(value >> 8);
+			bits[FI_RGBA_BLUE] = (uint8_t)value;
+			if (alpha) {
+				bits[FI_RGBA_ALPHA] = (uint8_t)(value >> 24);
+			}
+		}
+
+		/**
+		Returns TRUE and the replacement of key in value, if key is mapped
+		*/
+		bool Find(uint32_t key, uint32_t &value) const {
+			if (mKeys.size() <= kSmallMapKeys) {
+				const unsigned i = mFind(mSmallKeys, key);
+				if (i < mKeys.size()) {
+					value = mValues[i];
+					return true;
+				}
+				return false;
+			}
+			for (uint32_t slot = Hash(key); ; slot = (slot + 1) & mMask) {
+				const uint32_t entry = mSlots[slot];
+				if (!entry) {
+					return false;
+				}
+				if (mKeys[entry - 1] == key) {
+					value = mValues[entry - 1];
+					return true;
+				}
+			}
+		}
+
+	private:
+		void Reserve(size_t count) {
+			unsigned bits = 4;
+			while (((size_t)1 << bits) < 2 * count) {
+				bits++;
+			}
+			mShift = 32 - bits;
+			mMask = (1u << bits) - 1;
+			mSlots.assign(mMask + 1, 0);
+			mKeys.reserve(count);
+			mValues.reserve(count);
+		}
+
+		void Add(uint32_t key, uint32_t value) {
+			uint32_t slot = Hash(key);
+			for (; mSlots[slot]; slot = (slot + 1) & mMask) {
+				if (mKeys[mSlots[slot] - 1] == key) {
+					return;
+				}
+			}
+			mKeys.push_back(key);
+			mValues.push_back(value);
+			mSlots[slot] = (uint32_t)mKeys.size();
+		}
+
+		void Build() {
+			if (mKeys.size() <= kSmallMapKeys) {
+				// unused keys repeat the first one, which is found first anyway
+				for (unsigned i = 0; i < kSmallMapKeys; i++) {
+					mSmallKeys[i] = mKeys[i < mKeys.size() ? i : 0];
+				}
+				mFind = gFindKey.load(std::memory_order_relaxed);
+			}
+		}
+
+		uint32_t Hash(uint32_t key) const {
+			return (key * 0x9E3779B1u) >> mShift;
+		}
+
+		std::vector<uint32_t> mKeys;
+		std::vector<uint32_t> mValues;
+		uint32_t mSmallKeys[kSmallMapKeys]{};
+		FindKeyKernel mFind{ FindKey };
+		/// 1 + index of the key in mKeys, 0 for an empty slot
+		std::vector<uint32_t> mSlots;
+		uint32_t mMask{};
+		unsigned mShift{};
+	};
+
+	/**
+	Replaces the mapped pixels of dib by parallel bands of scanlines, mapPixel(bits) returns TRUE when it
+	changed the pixel at bits. Returns the number of changed pixels.
+	*/
+	template <class MapPixel>
+	unsigned MapPixels(FIBITMAP *dib, unsigned bytespp, const MapPixel &mapPixel) {
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+		const unsigned pitch = FreeImage_GetPitch(dib);
+		uint8_t *bits = FreeImage_GetBits(dib);
+		std::atomic<unsigned> result{ 0 };
+		ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(dib)), [&](unsigned first, unsigned last) {
+			unsigned changed = 0;
+			for (unsigned y = first; y < last; y++) {
+				uint8_t *pixel = bits + (size_t)pitch * y;
+				for (unsigned x = 0; x < width; x++, pixel += bytespp) {
+					changed += mapPixel(pixel) ? 1 : 0;
+				}
+			}
+			result.fetch_add(changed, std::memory_order_relaxed);
+		});
+		return result.load();
+	}
+
+} // namespace
+
 /** @brief Applies color mapping for one or several colors on a 1-, 4- or 8-bit
  palletized or a 16-, 24- or 32-bit high color image.
 
@@ -1145,7 +1715,10 @@ FreeImage_AdjustColors(FIBITMAP *dib, double brightness, double contrast, double
  determined by the image's red- green- and blue-mask).<br>
 
  <b>Note, that this behaviour is different from what FreeImage_ApplyPaletteIndexMapping()
- does, which modifies the actual image data on palletized images.</b>
+ does, which modifies the actual image data on palletized images.</b><br>
+
+ The colors are hashed once per call, so that the cost per pixel does not grow with
+ <i>count</i>. High color images are processed by parallel bands of scanlines.
 
  @param dib Input/output image to be processed.
  @param srccolors Array of colors to be used as the mapping source.
@@ -1175,129 +1748,51 @@ FreeImage_ApplyColorMapping(FIBITMAP *dib, FIRGBA8 *srccolors, FIRGBA8 *dstcolor
 		case 1:
 		case 4:
 		case 8: {
+			const ColorMap map(srccolors, dstcolors, count, swap, FALSE);
 			unsigned size = FreeImage_GetColorsUsed(dib);
 			FIRGBA8 *pal = FreeImage_GetPalette(dib);
-			const FIRGBA8 *a, *b;
 			for (unsigned x = 0; x < size; x++) {
-				for (unsigned j = 0; j < count; j++) {
-					a = srccolors;
-					b = dstcolors;
-					for (int i = (swap ? 0 : 1); i < 2; i++) {
-						if ((pal[x].blue == a[j].blue)&&(pal[x].green == a[j].green) &&(pal[x].red== a[j].red)) {
-							pal[x].blue = b[j].blue;
-							pal[x].green = b[j].green;
-							pal[x].red = b[j].red;
-							result++;
-							j = count;
-							break;
-						}
-						a = dstcolors;
-						b = srccolors;
-					}
+				uint32_t value;
+				if (map.Find(ColorMap::Pack(pal[x], FALSE), value)) {
+					pal[x].blue = (uint8_t)value;
+					pal[x].green = (uint8_t)(value >> 8);
+					pal[x].red = (uint8_t)(value >> 16);
+					result++;
 				}
 			}
 			return result;
 		}
 		case 16: {
-			auto *src16 = (uint16_t *)malloc(sizeof(uint16_t) * count);
-			if (!src16) {
-				return 0;
-			}
-
-			auto *dst16 = (uint16_t *)malloc(sizeof(uint16_t) * count);
-			if (!dst16) {
-				free(src16);
-				return 0;
-			}
-
+			std::vector<uint16_t> src16(count);
+			std::vector<uint16_t> dst16(count);
 			for (unsigned j = 0; j < count; j++) {
 				src16[j] = RGBQUAD_TO_WORD(dib, (srccolors + j));
 				dst16[j] = RGBQUAD_TO_WORD(dib, (dstcolors + j));
 			}
-
-			const unsigned height = FreeImage_GetHeight(dib);
-			const unsigned width = FreeImage_GetWidth(dib);
-			const uint16_t *a, *b;
-			for (unsigned y = 0; y < height; y++) {
-				uint16_t *bits = (uint16_t *)FreeImage_GetScanLine(dib, y);
-				for (unsigned x = 0; x < width; x++, bits++) {
-					for (unsigned j = 0; j < count; j++) {
-						a = src16;
-						b = dst16;
-						for (int i = (swap ? 0 : 1); i < 2; i++) {
-							if (*bits == a[j]) {
-								*bits = b[j];
-								result++;
-								j = count;
-								break;
-							}
-							a = dst16;
-							b = src16;
-						}
-					}
-				}
-			}
-			free(src16);
-			free(dst16);
-			return result;
-		}
-		case 24: {
-			const unsigned height = FreeImage_GetHeight(dib);
-			const unsigned width = FreeImage_GetWidth(dib);
-			const FIRGBA8 *a, *b;
-			for (unsigned y = 0; y < height; y++) {
-				uint8_t *bits = FreeImage_GetScanLine(dib, y);
-				for (unsigned x = 0; x < width; x++, bits += 3) {
-					for (unsigned j = 0; j < count; j++) {
-						a = srccolors;
-						b = dstcolors;
-						for (int i = (swap ? 0 : 1); i < 2; i++) {
-							if ((bits[FI_RGBA_BLUE] == a[j].blue) && (bits[FI_RGBA_GREEN] == a[j].green) &&(bits[FI_RGBA_RED] == a[j].red)) {
-								bits[FI_RGBA_BLUE] = b[j].blue;
-								bits[FI_RGBA_GREEN] = b[j].green;
-								bits[FI_RGBA_RED] = b[j].red;
-								result++;
-								j = count;
-								break;
-							}
-							a = dstcolors;
-							b = srccolors;
-						}
-					}
+			const ColorMap map(src16.data(), dst16.data(), count, swap);
+			return MapPixels(dib, 2, [&map](uint8_t *bits) {
+				uint16_t *pixel = (uint16_t *)bits;
+				uint32_t value;
+				if (map.Find(*pixel, value)) {
+					*pixel = (uint16_t)value;
+					return true;
 				}
-			}
-			return result;
+				return false;
+			});
 		}
+		case 24:
 		case 32: {
-			const unsigned height = FreeImage_GetHeight(dib);
-			const unsigned width = FreeImage_GetWidth(dib);
-			const FIRGBA8 *a, *b;
-			for (unsigned y = 0; y < height; y++) {
-				uint8_t *bits = FreeImage_GetScanLine(dib, y);
-				for (unsigned x = 0; x < width; x++, bits += 4) {
-					for (unsigned j = 0; j < count; j++) {
-						a = srccolors;
-						b = dstcolors;
-						for (int i = (swap ? 0 : 1); i < 2; i++) {
-							if ((bits[FI_RGBA_BLUE] == a[j].blue) &&(bits[FI_RGBA_GREEN] == a[j].green) &&(bits[FI_RGBA_RED] == a[j].red)
-								&&((ignore_alpha) || (bits[FI_RGBA_ALPHA] == a[j].alpha))) {
-								bits[FI_RGBA_BLUE] = b[j].blue;
-								bits[FI_RGBA_GREEN] = b[j].green;
-								bits[FI_RGBA_RED] = b[j].red;
-								if (!ignore_alpha) {
-									bits[FI_RGBA_ALPHA] = b[j].alpha;
-								}
-								result++;
-								j = count;
-								break;
-							}
-							a = dstcolors;
-							b = srccolors;
-						}
-					}
+			// 24-bit pixels have no alpha to compare
+			const FIBOOL alpha = (bpp == 32) && !ignore_alpha;
+			const ColorMap map(srccolors, dstcolors, count, swap, alpha);
+			return MapPixels(dib, bpp / 8, [&map, alpha](uint8_t *bits) {
+				uint32_t value;
+				if (map.Find(ColorMap::ReadPixel(bits, alpha), value)) {
+					ColorMap::WritePixel(bits, value, alpha);
+					return true;
 				}
-			}
-			return result;
+				return false;
+			});
 		}
 		default: {
 			return 0;
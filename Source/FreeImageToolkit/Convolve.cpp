@@ -0,0 +1,695 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "../FreeImage/CPUDispatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+// --------------------------------------------------------------------------
+// Separable filters
+// An image is filtered by parallel bands of rows. A band loads its rows and the rows of its vertical halo,
+// filters every row horizontally, then filters the columns of the band. The image is extended by replicating its
+// edges, so that a band computes its halo rows like any other row and results do not depend on the number of threads.
+// Weighted passes run as a sum of scaled shifted rows, box passes as running sums; rows are added by SIMD kernels.
+// --------------------------------------------------------------------------
+
+namespace {
+
+	/// dst[i] += weight * src[i] for i < count
+	using MultiplyAddKernel = void (*)(float *dst, const float *src, float weight, unsigned count);
+	using MultiplyAddDoubleKernel = void (*)(double *dst, const double *src, double weight, unsigned count);
+
+	template <typename Work>
+	void MultiplyAddRow(Work *dst, const Work *src, Work weight, unsigned count) {
+		for (unsigned i = 0; i < count; i++) {
+			dst[i] += weight * src[i];
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+	void MultiplyAdd_SSE2(float *dst, const float *src, float weight, unsigned count) {
+		const __m128 w = _mm_set1_ps(weight);
+		unsigned i = 0;
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+		}
+		MultiplyAddRow(dst + i, src + i, weight, count - i);
+	}
+
+	FI_TARGET("avx2")
+	void MultiplyAdd_AVX2(float *dst, const float *src, float weight, unsigned count) {
+		// multiply then add like the scalar code, a fused multiply-add would round differently
+		const __m256 w = _mm256_set1_ps(weight);
+		unsigned i = 0;
+		for (; i + 8 <= count; i += 8) {
+			_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(w, _mm256_loadu_ps(src + i))));
+		}
+		MultiplyAddRow(dst + i, src + i, weight, count - i);
+	}
+
+	void MultiplyAddDouble_SSE2(double *dst, const double *src, double weight, unsigned count) {
+		const __m128d w = _mm_set1_pd(weight);
+		unsigned i = 0;
+		for (; i + 2 <= count; i += 2) {
+			_mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(dst + i), _mm_mul_pd(w, _mm_loadu_pd(src + i))));
+		}
+		MultiplyAddRow(dst + i, src + i, weight, count - i);
+	}
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+	void MultiplyAdd_NEON(float *dst, const float *src, float weight, unsigned count) {
+		const float32x4_t w = vdupq_n_f32(weight);
+		unsigned i = 0;
+		for (; i + 4 <= count; i += 4) {
+			vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_f32(w, vld1q_f32(src + i))));
+		}
+		MultiplyAddRow(dst + i, src + i, weight, count - i);
+	}
+#endif // FREEIMAGE_SIMD_NEON
+
+	std::atomic<MultiplyAddKernel> gMultiplyAdd{ MultiplyAddRow<float> };
+	std::atomic<MultiplyAddDoubleKernel> gMultiplyAddDouble{ MultiplyAddRow<double> };
+
+	void SelectConvolveKernels(uint32_t features) {
+		MultiplyAddKernel multiply_add = MultiplyAddRow<float>;
+		MultiplyAddDoubleKernel multiply_add_double = MultiplyAddRow<double>;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			multiply_add = MultiplyAdd_SSE2;
+			multiply_add_double = MultiplyAddDouble_SSE2;
+		}
+		if (features & FI_CPU_AVX2) {
+			multiply_add = MultiplyAdd_AVX2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			multiply_add = MultiplyAdd_NEON;
+		}
+#endif
+		gMultiplyAdd.store(multiply_add, std::memory_order_relaxed);
+		gMultiplyAddDouble.store(multiply_add_double, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectConvolveKernels);
+
+	MultiplyAddKernel SelectMultiplyAdd(float *) {
+		return gMultiplyAdd.load(std::memory_order_relaxed);
+	}
+
+	MultiplyAddDoubleKernel SelectMultiplyAdd(double *) {
+		return gMultiplyAddDouble.load(std::memory_order_relaxed);
+	}
+
+	// ----------------------------------------------------------
+	//  Filters
+	// ----------------------------------------------------------
+
+	/**
+	One dimensional pass of a separable filter over 2 * radius + 1 samples,
+	weights[i] weighs the sample at offset i - radius, a pass without weights sums the samples (box filter)
+	*/
+	struct FilterPass {
+		unsigned radius;
+		std::vector<double> weights;
+	};
+
+	/**
+	Separable filter, box sums are not normalized by the passes: results are multiplied by scale,
+	which keeps the sums of integer samples exact. With unsharp, the filtered image is a blur
+	and the result is the unsharp mask src + amount * (src - blur).
+	*/
+	struct Filter {
+		std::vector<FilterPass> horizontal;
+		std::vector<FilterPass> vertical;
+		double scale = 1;
+		bool unsharp = false;
+		double amount = 0;
+
+		static unsigned Halo(const std::vector<FilterPass> &passes) {
+			unsigned halo = 0;
+			for (const FilterPass &pass : passes) {
+				halo += pass.radius;
+			}
+			return halo;
+		}
+
+		bool HasBox() const {
+			for (const FilterPass &pass : horizontal) {
+				if (pass.weights.empty()) return true;
+			}
+			for (const FilterPass &pass : vertical) {
+				if (pass.weights.empty()) return true;
+			}
+			return false;
+		}
+	};
+
+	/**
+	Applies a pass to count samples of interleaved channels, src holds count + 2 * radius samples
+	*/
+	template <typename Work>
+	void FilterLine(Work *dst, const Work *src, unsigned count, unsigned channels, const FilterPass &pass) {
+		const unsigned n = count * channels;
+		const unsigned size = 2 * pass.radius + 1;
+		if (!pass.weights.empty()) {
+			const auto multiply_add = SelectMultiplyAdd(dst);
+			std::fill(dst, dst + n, Work(0));
+			for (unsigned j = 0; j < size; j++) {
+				multiply_add(dst, src + (size_t)j * channels, (Work)pass.weights[j], n);
+			}
+		} else {
+			for (unsigned c = 0; c < channels; c++) {
+				Work sum = 0;
+				for (unsigned j = 0; j < size; j++) {
+					sum += src[(size_t)j * channels + c];
+				}
+				dst[c] = sum;
+				for (unsigned i = channels + c; i < n; i += channels) {
+					sum += src[i + (size_t)(size - 1) * channels] - src[i - channels];
+					dst[i] = sum;
+				}
+			}
+		}
+	}
+
+	/**
+	Applies a pass to the columns of rows - 2 * radius rows of n samples, src holds rows rows
+	*/
+	template <typename Work>
+	void FilterColumns(Work *dst, const Work *src, unsigned rows, size_t n, const FilterPass &pass) {
+		const auto multiply_add = SelectMultiplyAdd(dst);
+		const unsigned size = 2 * pass.radius + 1;
+		const unsigned count = rows - 2 * pass.radius;
+		if (!pass.weights.empty()) {
+			for (unsigned i = 0; i < count; i++) {
+				Work *out = dst + n * i;
+				std::fill(out, out + n, Work(0));
+				for (unsigned j = 0; j < size; j++) {
+					multiply_add(out, src + n * (i + j), (Work)pass.weights[j], (unsigned)n);
+				}
+			}
+		} else {
+			std::fill(dst, dst + n, Work(0));
+			for (unsigned j = 0; j < size; j++) {
+				multiply_add(dst, src + n * j, Work(1), (unsigned)n);
+			}
+			for (unsigned i = 1; i < count; i++) {
+				Work *out = dst + n * i;
+				std::copy(out - n, out, out);
+				multiply_add(out, src + n * (i + size - 1), Work(1), (unsigned)n);
+				multiply_add(out, src + n * (i - 1), Work(-1), (unsigned)n);
+			}
+		}
+	}
+
+	// ----------------------------------------------------------
+	//  Samples
+	// ----------------------------------------------------------
+
+	/// IEEE half float bit pattern
+	struct Half {
+		uint16_t bits;
+	};
+
+	template <typename Sample, typename Work>
+	inline Work LoadSample(Sample value) {
+		return (Work)value;
+	}
+
+	template <>
+	inline float LoadSample<Half, float>(Half value) {
+		return HalfToFloat(value.bits);
+	}
+
+	template <>
+	inline double LoadSample<Half, double>(Half value) {
+		return HalfToFloat(value.bits);
+	}
+
+	template <typename Sample, typename Work>
+	inline Sample StoreSample(Work value) {
+		if constexpr (std::is_integral_v<Sample>) {
+			const Work rounded = std::floor(value + Work(0.5));
+			if (rounded <= (Work)std::numeric_limits<Sample>::lowest()) return std::numeric_limits<Sample>::lowest();
+			if (rounded >= (Work)std::numeric_limits<Sample>::max()) return std::numeric_limits<Sample>::max();
+			return (Sample)rounded;
+		} else {
+			return (Sample)value;
+		}
+	}
+
+	template <>
+	inline Half StoreSample<Half, float>(float value) {
+		return Half{ FloatToHalf(value) };
+	}
+
+	template <>
+	inline Half StoreSample<Half, double>(double value) {
+		return Half{ FloatToHalf((float)value) };
+	}
+
+	/**
+	Filters src into dst, images of the same size with channels samples of type Sample per pixel
+	*/
+	template <typename Sample, typename Work>
+	void ApplyFilter(FIBITMAP *dst, FIBITMAP *src, unsigned channels, const Filter &filter) {
+		const unsigned width = FreeImage_GetWidth(src);
+		const unsigned height = FreeImage_GetHeight(src);
+		const size_t n = (size_t)width * channels;
+		const unsigned halo_x = Filter::Halo(filter.horizontal);
+		const unsigned halo_y = Filter::Halo(filter.vertical);
+		const Work scale = (Work)filter.scale;
+		const Work amount = (Work)filter.amount;
+
+		ParallelFor(0, height, CalculateBandRows(n * sizeof(Work)), [&](unsigned first, unsigned last) {
+			const unsigned rows = last - first + 2 * halo_y;
+			std::vector<Work> plane(n * rows), other(n * rows);
+			std::vector<Work> line((size_t)(width + 2 * halo_x) * channels), line_other(line.size());
+
+			// load the rows with their halo and filter them horizontally
+			for (unsigned r = 0; r < rows; r++) {
+				const int y = std::clamp((int)(first + r) - (int)halo_y, 0, (int)height - 1);
+				const Sample *bits = reinterpret_cast<const Sample *>(FreeImage_GetConstScanLine(src, y));
+				Work *center = line.data() + (size_t)halo_x * channels;
+				for (size_t i = 0; i < n; i++) {
+					center[i] = LoadSample<Sample, Work>(bits[i]);
+				}
+				for (unsigned x = 0; x < halo_x; x++) {
+					for (unsigned c = 0; c < channels; c++) {
+						line[(size_t)x * channels + c] = center[c];
+						center[n + (size_t)x * channels + c] = center[n - channels + c];
+					}
+				}
+				Work *in = line.data(), *out = line_other.data();
+				unsigned count = width + 2 * halo_x;
+				for (const FilterPass &pass : filter.horizontal) {
+					count -= 2 * pass.radius;
+					FilterLine(out, in, count, channels, pass);
+					std::swap(in, out);
+				}
+				std::copy(in, in + n, plane.data() + n * r);
+			}
+
+			// filter the columns, each pass drops its halo rows
+			Work *in = plane.data(), *out = other.data();
+			unsigned count = rows;
+			for (const FilterPass &pass : filter.vertical) {
+				FilterColumns(out, in, count, n, pass);
+				count -= 2 * pass.radius;
+				std::swap(in, out);
+			}
+
+			for (unsigned y = first; y < last; y++) {
+				const Work *result = in + n * (y - first);
+				Sample *bits = reinterpret_cast<Sample *>(FreeImage_GetScanLine(dst, y));
+				if (filter.unsharp) {
+					const Sample *src_bits = reinterpret_cast<const Sample *>(FreeImage_GetConstScanLine(src, y));
+					for (size_t i = 0; i < n; i++) {
+						const Work value = LoadSample<Sample, Work>(src_bits[i]);
+						bits[i] = StoreSample<Sample, Work>(value + amount * (value - scale * result[i]));
+					}
+				} else {
+					for (size_t i = 0; i < n; i++) {
+						bits[i] = StoreSample<Sample, Work>(scale * result[i]);
+					}
+				}
+			}
+		});
+	}
+
+	/**
+	Filters an image of any type, except palettized, 1, 4 and 16-bit bitmaps.
+	Samples are filtered in float, in double for 32-bit integers, doubles and box sums.
+	*/
+	FIBITMAP* FilterImage(FIBITMAP *dib, const Filter &filter) {
+		if (!FreeImage_HasPixels(dib)) return nullptr;
+
+		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+		const unsigned bpp = FreeImage_GetBPP(dib);
+		if (image_type == FIT_BITMAP) {
+			if ((bpp != 8) && (bpp != 24) && (bpp != 32)) return nullptr;
+			if ((bpp == 8) && (FreeImage_GetColorType(dib) != FIC_MINISBLACK)) return nullptr;
+		}
+
+		FIBITMAP *dst = FreeImage_AllocateT(image_type, FreeImage_GetWidth(dib), FreeImage_GetHeight(dib), bpp,
+			FreeImage_GetRedMask(dib), FreeImage_GetGreenMask(dib), FreeImage_GetBlueMask(dib));
+		if (!dst) {
+			FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_DIB_MEMORY, FI_MSG_ERROR_DIB_MEMORY);
+			return nullptr;
+		}
+
+		const bool box = filter.HasBox();
+		try {
+			switch (image_type) {
+				case FIT_BITMAP:
+					if (box) {
+						ApplyFilter<uint8_t, double>(dst, dib, bpp / 8, filter);
+					} else {
+						ApplyFilter<uint8_t, float>(dst, dib, bpp / 8, filter);
+					}
+					break;
+				case FIT_UINT16:
+				case FIT_RGB16:
+				case FIT_RGBA16:
+					if (box) {
+						ApplyFilter<uint16_t, double>(dst, dib, bpp / 16, filter);
+					} else {
+						ApplyFilter<uint16_t, float>(dst, dib, bpp / 16, filter);
+					}
+					break;
+				case FIT_INT16:
+					if (box) {
+						ApplyFilter<int16_t, double>(dst, dib, 1, filter);
+					} else {
+						ApplyFilter<int16_t, float>(dst, dib, 1, filter);
+					}
+					break;
+				case FIT_UINT32:
+				case FIT_RGB32:
+				case FIT_RGBA32:
+					ApplyFilter<uint32_t, double>(dst, dib, bpp / 32, filter);
+					break;
+				case FIT_INT32:
+					ApplyFilter<int32_t, double>(dst, dib, 1, filter);
+					break;
+				case FIT_FLOAT:
+				case FIT_RGBF:
+				case FIT_RGBAF:
+				case FIT_COMPLEXF:
+					if (box) {
+						ApplyFilter<float, double>(dst, dib, bpp / 32, filter);
+					} else {
+						ApplyFilter<float, float>(dst, dib, bpp / 32, filter);
+					}
+					break;
+				case FIT_DOUBLE:
+				case FIT_COMPLEX:
+					ApplyFilter<double, double>(dst, dib, bpp / 64, filter);
+					break;
+				case FIT_RGBAH:
+					if (box) {
+						ApplyFilter<Half, double>(dst, dib, 4, filter);
+					} else {
+						ApplyFilter<Half, float>(dst, dib, 4, filter);
+					}
+					break;
+				default:
+					FreeImage_Unload(dst);
+					return nullptr;
+			}
+		}
+		catch (const std::bad_alloc &) {
+			FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+			FreeImage_Unload(dst);
+			return nullptr;
+		}
+
+		if ((image_type == FIT_BITMAP) && (bpp == 8)) {
+			// copy the greyscale palette
+			memcpy(FreeImage_GetPalette(dst), FreeImage_GetPalette(dib), FreeImage_GetColorsUsed(dib) * sizeof(FIRGBA8));
+		}
+
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(dst, dib);
+
+		return dst;
+	}
+
+	/// Box pass of 2 * radius + 1 samples
+	FilterPass BoxPass(unsigned radius) {
+		return FilterPass{ radius, {} };
+	}
+
+	/**
+	Gaussian blur filter. Small deviations use the sampled Gaussian over 3 sigma, larger ones three box passes
+	of sizes chosen to match the variance (W. M. Wells, Efficient synthesis of Gaussian filters by cascaded
+	uniform filters, 1986; P. Kovesi, Fast almost-Gaussian filtering, 2010), which cost the same whatever sigma.
+	*/
+	Filter GaussianFilter(double sigma) {
+		static const unsigned kMaxSampledRadius = 24;
+
+		Filter filter;
+		const unsigned radius = (unsigned)std::ceil(3 * sigma);
+		if (radius <= kMaxSampledRadius) {
+			FilterPass pass{ radius, std::vector<double>(2 * radius + 1) };
+			double sum = 0;
+			for (unsigned i = 0; i <= 2 * radius; i++) {
+				const double x = (double)i - radius;
+				pass.weights[i] = std::exp(-x * x / (2 * sigma * sigma));
+				sum += pass.weights[i];
+			}
+			for (double &weight : pass.weights) {
+				weight /= sum;
+			}
+			filter.horizontal.push_back(pass);
+			filter.vertical.push_back(pass);
+		} else {
+			// m passes of size wl and 3 - m passes of size wl + 2, wl odd
+			const int n = 3;
+			const double ideal = std::sqrt(12 * sigma * sigma / n + 1);
+			int wl = (int)std::floor(ideal);
+			if ((wl % 2) == 0) {
+				wl--;
+			}
+			const int m = (int)std::lround((12 * sigma * sigma - n * wl * wl - 4 * n * wl - 3 * n) / (-4.0 * wl - 4));
+			for (int i = 0; i < n; i++) {
+				const int size = (i < m) ? wl : wl + 2;
+				filter.horizontal.push_back(BoxPass(size / 2));
+				filter.vertical.push_back(BoxPass(size / 2));
+				filter.scale /= (double)size * size;
+			}
+		}
+		return filter;
+	}
+
+	/**
+	Unsharp masks an image in place with a single weighted pass per direction, the result matches ApplyFilter.
+	Bands stream their rows through a ring of horizontally filtered rows, a row being overwritten once it left
+	the window. The rows around band boundaries are saved beforehand, neighbouring bands read them there.
+	*/
+	template <typename Sample, typename Work>
+	void SharpenInPlace(FIBITMAP *dib, unsigned channels, const FilterPass &pass, double sharpen) {
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+		const size_t n = (size_t)width * channels;
+		const unsigned radius = pass.radius;
+		const unsigned size = 2 * radius + 1;
+		const Work amount = (Work)sharpen;
+
+		const unsigned band_rows = CalculateBandRows(n * sizeof(Work));
+		const unsigned bands = (height + band_rows - 1) / band_rows;
+
+		// pixels shared with clones are copied once, before the bands read and write them
+		if (!FreeImage_GetBits(dib)) {
+			throw std::bad_alloc();
+		}
+
+		// rows [b - radius, b + radius) of every band boundary b, as they are before sharpening
+		std::vector<Sample> saved(n * 2 * radius * (bands - 1));
+		for (unsigned k = 1; k < bands; k++) {
+			for (unsigned i = 0; i < 2 * radius; i++) {
+				const int y = std::clamp((int)(k * band_rows + i) - (int)radius, 0, (int)height - 1);
+				const Sample *bits = reinterpret_cast<const Sample *>(FreeImage_GetConstScanLine(dib, y));
+				std::copy(bits, bits + n, saved.data() + n * (2 * radius * (k - 1) + i));
+			}
+		}
+
+		ParallelFor(0, bands, 1, [&](unsigned band_begin, unsigned band_end) {
+			const auto multiply_add = SelectMultiplyAdd((Work *)nullptr);
+			std::vector<Work> ring(n * size), result(n);
+			std::vector<Work> line((size_t)(width + 2 * radius) * channels);
+
+			for (unsigned k = band_begin; k < band_end; k++) {
+				const int first = (int)(k * band_rows);
+				const int last = std::min(first + (int)band_rows, (int)height);
+
+				// filters row p horizontally into its ring slot
+				auto load = [&](int p) {
+					const Sample *bits;
+					if ((p < first) && (k > 0)) {
+						bits = saved.data() + n * (2 * radius * (k - 1) + (p - first + radius));
+					} else if ((p >= last) && (k + 1 < bands)) {
+						bits = saved.data() + n * (2 * radius * k + (p - last + radius));
+					} else {
+						bits = reinterpret_cast<const Sample *>(FreeImage_GetConstScanLine(dib, std::clamp(p, 0, (int)height - 1)));
+					}
+					Work *center = line.data() + (size_t)radius * channels;
+					for (size_t i = 0; i < n; i++) {
+						center[i] = LoadSample<Sample, Work>(bits[i]);
+					}
+					for (unsigned x = 0; x < radius; x++) {
+						for (unsigned c = 0; c < channels; c++) {
+							line[(size_t)x * channels + c] = center[c];
+							center[n + (size_t)x * channels + c] = center[n - channels + c];
+						}
+					}
+					FilterLine(ring.data() + n * ((p + radius) % size), line.data(), width, channels, pass);
+				};
+
+				for (int p = first - (int)radius; p < first + (int)radius; p++) {
+					load(p);
+				}
+				for (int y = first; y < last; y++) {
+					load(y + (int)radius);
+					std::fill(result.begin(), result.end(), Work(0));
+					for (unsigned j = 0; j < size; j++) {
+						multiply_add(result.data(), ring.data() + n * ((y + j) % size), (Work)pass.weights[j], (unsigned)n);
+					}
+					Sample *bits = reinterpret_cast<Sample *>(FreeImage_GetScanLine(dib, y));
+					for (size_t i = 0; i < n; i++) {
+						const Work value = LoadSample<Sample, Work>(bits[i]);
+						bits[i] = StoreSample<Sample, Work>(value + amount * (value - result[i]));
+					}
+				}
+			}
+		});
+	}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+/**
+Box blur, the mean of the (2 * radius + 1) x (2 * radius + 1) neighbourhood of every pixel, computed by running sums
+in a time that does not depend on the radius.
+@param dib Input image, 8-bit greyscale, 24 or 32-bit bitmap or any other image type
+@param radius Radius of the box, 0 returns a copy
+@return Returns the blurred image if successful, returns NULL otherwise
+*/
+FIBITMAP* DLL_CALLCONV
+FreeImage_BoxBlur(FIBITMAP *dib, unsigned radius) {
+	try {
+		Filter filter;
+		filter.horizontal.push_back(BoxPass(radius));
+		filter.vertical.push_back(BoxPass(radius));
+		filter.scale = 1.0 / ((2.0 * radius + 1) * (2.0 * radius + 1));
+		return FilterImage(dib, filter);
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return nullptr;
+}
+
+/**
+Gaussian blur of standard deviation sigma.
+@param dib Input image, 8-bit greyscale, 24 or 32-bit bitmap or any other image type
+@param sigma Standard deviation in pixels, greater than 0
+@return Returns the blurred image if successful, returns NULL otherwise
+*/
+FIBITMAP* DLL_CALLCONV
+FreeImage_GaussianBlur(FIBITMAP *dib, double sigma) {
+	if (!(sigma > 0)) return nullptr;
+	try {
+		return FilterImage(dib, GaussianFilter(sigma));
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return nullptr;
+}
+
+/**
+Unsharp mask, src + amount * (src - blur) where blur is the Gaussian blur of standard deviation sigma.
+@param dib Input image, 8-bit greyscale, 24 or 32-bit bitmap or any other image type
+@param sigma Standard deviation of the blur in pixels, greater than 0
+@param amount Strength of the sharpening, e.g. 0.5 to 1.5
+@return Returns the sharpened image if successful, returns NULL otherwise
+*/
+FIBITMAP* DLL_CALLCONV
+FreeImage_UnsharpMask(FIBITMAP *dib, double sigma, double amount) {
+	if (!(sigma > 0)) return nullptr;
+	try {
+		Filter filter = GaussianFilter(sigma);
+		filter.unsharp = true;
+		filter.amount = amount;
+		return FilterImage(dib, filter);
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return nullptr;
+}
+
+/**
+Separable convolution, rows are filtered by kernel_x then columns by kernel_y, image edges are replicated.
+@param dib Input image, 8-bit greyscale, 24 or 32-bit bitmap or any other image type
+@param kernel_x Weights of the row filter, kernel_x[i] weighs the pixel at offset i - size_x / 2
+@param size_x Odd number of weights of kernel_x
+@param kernel_y Weights of the column filter, NULL to use kernel_x
+@param size_y Odd number of weights of kernel_y, ignored when kernel_y is NULL
+@return Returns the filtered image if successful, returns NULL otherwise
+*/
+FIBITMAP* DLL_CALLCONV
+FreeImage_Convolve(FIBITMAP *dib, const double *kernel_x, unsigned size_x, const double *kernel_y, unsigned size_y) {
+	if (!kernel_y) {
+		kernel_y = kernel_x;
+		size_y = size_x;
+	}
+	if (!kernel_x || ((size_x % 2) == 0) || ((size_y % 2) == 0)) return nullptr;
+	try {
+		Filter filter;
+		filter.horizontal.push_back(FilterPass{ size_x / 2, std::vector<double>(kernel_x, kernel_x + size_x) });
+		filter.vertical.push_back(FilterPass{ size_y / 2, std::vector<double>(kernel_y, kernel_y + size_y) });
+		return FilterImage(dib, filter);
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return nullptr;
+}
+
+// --------------------------------------------------------------------------
+
+bool
+UnsharpMaskInPlace(FIBITMAP *dib, double sigma, double amount) {
+	static const double kMaxSigma = 8;
+
+	if (!FreeImage_HasPixels(dib) || !(sigma > 0)) return false;
+
+	// sampled Gaussian only, box passes cannot be streamed in place
+	const Filter filter = GaussianFilter(std::min(sigma, kMaxSigma));
+	const FilterPass &pass = filter.vertical.front();
+
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	try {
+		switch (FreeImage_GetImageType(dib)) {
+			case FIT_BITMAP:
+				if ((bpp != 8) && (bpp != 24) && (bpp != 32)) return false;
+				SharpenInPlace<uint8_t, float>(dib, bpp / 8, pass, amount);
+				return true;
+			case FIT_UINT16:
+			case FIT_RGB16:
+			case FIT_RGBA16:
+				SharpenInPlace<uint16_t, float>(dib, bpp / 16, pass, amount);
+				return true;
+			case FIT_FLOAT:
+			case FIT_RGBF:
+			case FIT_RGBAF:
+				SharpenInPlace<float, float>(dib, bpp / 32, pass, amount);
+				return true;
+			case FIT_DOUBLE:
+				SharpenInPlace<double, double>(dib, 1, pass, amount);
+				return true;
+			default:
+				return false;
+		}
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+		return false;
+	}
+}
@@ -25,11 +25,109 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "../FreeImage/CPUDispatch.h"
 
 // ----------------------------------------------------------
 //   Helpers
 // ----------------------------------------------------------
 
+/////////////////////////////////////////////////////////////
+// Row kernels
+
+namespace {
+
+	/// Blends count bytes of src over dst with a constant alpha in [0..255]
+	using BlendKernel = void (*)(uint8_t *dst, const uint8_t *src, unsigned count, unsigned alpha);
+
+	// (s - d) * a + (d << 8) == s * a + d * (256 - a), which is never negative and fits 16 bits
+
+	void BlendBytes(uint8_t *dst, const uint8_t *src, unsigned count, unsigned alpha) {
+		for (unsigned i = 0; i < count; i++) {
+			dst[i] = (uint8_t)(((src[i] - dst[i]) * (int)alpha + (dst[i] << 8)) >> 8);
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+	void BlendBytes_SSE2(uint8_t *dst, const uint8_t *src, unsigned count, unsigned alpha) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i a = _mm_set1_epi16((short)alpha);
+		const __m128i na = _mm_set1_epi16((short)(256 - alpha));
+		unsigned i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+			const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+			const __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), a), _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), na));
+			const __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), a), _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), na));
+			_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+		}
+		BlendBytes(dst + i, src + i, count - i, alpha);
+	}
+#endif
+
+#if FREEIMAGE_SIMD_NEON
+	void BlendBytes_NEON(uint8_t *dst, const uint8_t *src, unsigned count, unsigned alpha) {
+		// d * (256 - a) is computed as d * (255 - a) + d to stay within 8-bit multipliers
+		const uint8x8_t a = vdup_n_u8((uint8_t)alpha);
+		const uint8x8_t na = vdup_n_u8((uint8_t)(255 - alpha));
+		unsigned i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const uint8x16_t s = vld1q_u8(src + i);
+			const uint8x16_t d = vld1q_u8(dst + i);
+			uint16x8_t lo = vmull_u8(vget_low_u8(s), a);
+			uint16x8_t hi = vmull_u8(vget_high_u8(s), a);
+			lo = vaddw_u8(vmlal_u8(lo, vget_low_u8(d), na), vget_low_u8(d));
+			hi = vaddw_u8(vmlal_u8(hi, vget_high_u8(d), na), vget_high_u8(d));
+			vst1q_u8(dst + i, vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+		}
+		BlendBytes(dst + i, src + i, count - i, alpha);
+	}
+#endif
+
+	std::atomic<BlendKernel> gBlendBytes{ BlendBytes };
+
+	void SelectPasteKernels(unsigned features) {
+		BlendKernel blend = BlendBytes;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			blend = BlendBytes_SSE2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			blend = BlendBytes_NEON;
+		}
+#endif
+		gBlendBytes.store(blend, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectPasteKernels);
+
+	/// Calls row(dst_row, src_row) for height rows of line bytes, by parallel bands
+	template <typename RowFunction>
+	void ForEachRow(uint8_t *dst_bits, unsigned dst_pitch, const uint8_t *src_bits, unsigned src_pitch, unsigned height, unsigned line, RowFunction row) {
+		ParallelFor(0, height, CalculateBandRows(line), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				row(dst_bits + (size_t)dst_pitch * y, src_bits + (size_t)src_pitch * y);
+			}
+		});
+	}
+
+	/// Copies (alpha > 255) or blends rows of bytes
+	void PasteRows(uint8_t *dst_bits, unsigned dst_pitch, const uint8_t *src_bits, unsigned src_pitch, unsigned height, unsigned line, unsigned alpha) {
+		if (alpha > 255) {
+			ForEachRow(dst_bits, dst_pitch, src_bits, src_pitch, height, line, [line](uint8_t *dst, const uint8_t *src) {
+				memcpy(dst, src, line);
+			});
+		} else {
+			const BlendKernel blend = gBlendBytes.load(std::memory_order_relaxed);
+			ForEachRow(dst_bits, dst_pitch, src_bits, src_pitch, height, line, [=](uint8_t *dst, const uint8_t *src) {
+				blend(dst, src, line, alpha);
+			});
+		}
+	}
+
+} // namespace
+
 /////////////////////////////////////////////////////////////
 // Alpha blending / combine functions
 
@@ -206,27 +304,9 @@ Combine8(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 	}
 
 	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x);
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
+	const uint8_t *src_bits = FreeImage_GetConstBits(src_dib);
 
-	if (alpha > 255) {
-		// combine images
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (uint8_t)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	PasteRows(dst_bits, FreeImage_GetPitch(dst_dib), src_bits, FreeImage_GetPitch(src_dib), FreeImage_GetHeight(src_dib), FreeImage_GetLine(src_dib), alpha);
 
 	return TRUE;
 }
@@ -248,23 +328,21 @@ Combine16_555(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsi
 	}
 
 	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 2);
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
+	const uint8_t *src_bits = FreeImage_GetConstBits(src_dib);
+	const unsigned dst_pitch = FreeImage_GetPitch(dst_dib);
+	const unsigned src_pitch = FreeImage_GetPitch(src_dib);
+	const unsigned line = FreeImage_GetLine(src_dib);
 
 	if (alpha > 255) {
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
+		PasteRows(dst_bits, dst_pitch, src_bits, src_pitch, FreeImage_GetHeight(src_dib), line, alpha);
 	} else {
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols += 2) {
+		ForEachRow(dst_bits, dst_pitch, src_bits, src_pitch, FreeImage_GetHeight(src_dib), line, [=](uint8_t *dst_row, const uint8_t *src_row) {
+			for (unsigned cols = 0; cols < line; cols += 2) {
 				FIRGB8 color_s;
 				FIRGB8 color_t;
 				
-				uint16_t *tmp1 = (uint16_t *)&dst_bits[cols];
-				const uint16_t *tmp2 = (uint16_t *)&src_bits[cols];
+				uint16_t *tmp1 = (uint16_t *)&dst_row[cols];
+				const uint16_t *tmp2 = (const uint16_t *)&src_row[cols];
 
 				// convert 16-bit colors to 24-bit
 
@@ -286,10 +364,7 @@ Combine16_555(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsi
 
 				*tmp1 = RGB555(color_s.red, color_s.green, color_s.blue);
 			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
+		});
 	}
 
 	return TRUE;
@@ -308,23 +383,21 @@ Combine16_565(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsi
 	}
 
 	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 2);
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
+	const uint8_t *src_bits = FreeImage_GetConstBits(src_dib);
+	const unsigned dst_pitch = FreeImage_GetPitch(dst_dib);
+	const unsigned src_pitch = FreeImage_GetPitch(src_dib);
+	const unsigned line = FreeImage_GetLine(src_dib);
 
 	if (alpha > 255) {
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
+		PasteRows(dst_bits, dst_pitch, src_bits, src_pitch, FreeImage_GetHeight(src_dib), line, alpha);
 	} else {
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols += 2) {
+		ForEachRow(dst_bits, dst_pitch, src_bits, src_pitch, FreeImage_GetHeight(src_dib), line, [=](uint8_t *dst_row, const uint8_t *src_row) {
+			for (unsigned cols = 0; cols < line; cols += 2) {
 				FIRGB8 color_s;
 				FIRGB8 color_t;
 				
-				uint16_t *tmp1 = (uint16_t *)&dst_bits[cols];
-				const uint16_t *tmp2 = (uint16_t *)&src_bits[cols];
+				uint16_t *tmp1 = (uint16_t *)&dst_row[cols];
+				const uint16_t *tmp2 = (const uint16_t *)&src_row[cols];
 
 				// convert 16-bit colors to 24-bit
 
@@ -346,10 +419,7 @@ Combine16_565(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsi
 
 				*tmp1 = RGB565(color_s.red, color_s.green, color_s.blue);
 			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
+		});
 	}
 	
 	return TRUE;
@@ -372,27 +442,9 @@ Combine24(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 	}
 
 	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 3);
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
-
-	if (alpha > 255) {
-		// combine images
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (uint8_t)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
+	const uint8_t *src_bits = FreeImage_GetConstBits(src_dib);
 
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	PasteRows(dst_bits, FreeImage_GetPitch(dst_dib), src_bits, FreeImage_GetPitch(src_dib), FreeImage_GetHeight(src_dib), FreeImage_GetLine(src_dib), alpha);
 
 	return TRUE;
 }
@@ -414,27 +466,9 @@ Combine32(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 	}
 
 	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 4);
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
+	const uint8_t *src_bits = FreeImage_GetConstBits(src_dib);
 
-	if (alpha > 255) {
-		// combine images
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {
-				dst_bits[cols] = (uint8_t)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	PasteRows(dst_bits, FreeImage_GetPitch(dst_dib), src_bits, FreeImage_GetPitch(src_dib), FreeImage_GetHeight(src_dib), FreeImage_GetLine(src_dib), alpha);
 
 	return TRUE;
 }
@@ -464,15 +498,10 @@ CombineSameType(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y) {
 	}	
 
 	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((dst_height - src_height - y) * dst_pitch) + (x * (src_line / src_width));
-	const uint8_t *src_bits = FreeImage_GetBits(src_dib);	
-
-	// combine images	
-	for (unsigned rows = 0; rows < src_height; rows++) {
-		memcpy(dst_bits, src_bits, src_line);
+	const uint8_t *src_bits = FreeImage_GetConstBits(src_dib);
 
-		dst_bits += dst_pitch;
-		src_bits += src_pitch;
-	}
+	// combine images
+	PasteRows(dst_bits, dst_pitch, src_bits, src_pitch, src_height, src_line, 256);
 
 	return TRUE;
 }
@@ -482,47 +511,15 @@ CombineSameType(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y) {
 // ----------------------------------------------------------
 
 /**
-Copy a sub part of the current image and returns it as a FIBITMAP*.
-Works with any bitmap type.
-@param left Specifies the left position of the cropped rectangle. 
-@param top Specifies the top position of the cropped rectangle. 
-@param right Specifies the right position of the cropped rectangle. 
-@param bottom Specifies the bottom position of the cropped rectangle. 
-@return Returns the subimage if successful, NULL otherwise.
+Copy the sub part of src starting at (left, top) into dst, including palette, transparency, metadata and ICC profile.
+dst has the type and bit depth of src, its size is the size of the copied rectangle.
 */
-FIBITMAP * DLL_CALLCONV 
-FreeImage_Copy(FIBITMAP *src, int left, int top, int right, int bottom) {
-
-	if (!FreeImage_HasPixels(src)) 
-		return nullptr;
-
-	// normalize the rectangle
-	if (right < left) {
-		INPLACESWAP(left, right);
-	}
-	if (bottom < top) {
-		INPLACESWAP(top, bottom);
-	}
-	// check the size of the sub image
-	const int src_width  = FreeImage_GetWidth(src);
-	const int src_height = FreeImage_GetHeight(src);
-	if ((left < 0) || (right > src_width) || (top < 0) || (bottom > src_height)) {
-		return nullptr;
-	}
-
-	// allocate the sub image
+static void
+CopyRect(FIBITMAP *dst, FIBITMAP *src, int left, int top) {
 	const unsigned bpp = FreeImage_GetBPP(src);
-	const int dst_width = (right - left);
-	const int dst_height = (bottom - top);
-
-	FIBITMAP *dst = 
-		FreeImage_AllocateT(FreeImage_GetImageType(src), 
-							dst_width, 
-							dst_height, 
-							bpp, 
-							FreeImage_GetRedMask(src), FreeImage_GetGreenMask(src), FreeImage_GetBlueMask(src));
-
-	if (!dst) return nullptr;
+	const int src_height = FreeImage_GetHeight(src);
+	const int dst_width = FreeImage_GetWidth(dst);
+	const int dst_height = FreeImage_GetHeight(dst);
 
 	// get the dimensions
 	const int dst_line = FreeImage_GetLine(dst);
@@ -531,7 +528,7 @@ FreeImage_Copy(FIBITMAP *src, int left, int top, int right, int bottom) {
 
 	// get the pointers to the bits and such
 
-	const uint8_t *src_bits = FreeImage_GetScanLine(src, src_height - top - dst_height);
+	const uint8_t *src_bits = FreeImage_GetConstScanLine(src, src_height - top - dst_height);
 	switch (bpp) {
 		case 1:
 			// point to x = 0
@@ -595,9 +592,7 @@ FreeImage_Copy(FIBITMAP *src, int left, int top, int right, int bottom) {
 	}
 
 	else if (bpp >= 8) {
-		for (int y = 0; y < dst_height; y++) {
-			memcpy(dst_bits + (y * dst_pitch), src_bits + (y * src_pitch), dst_line);
-		}
+		PasteRows(dst_bits, dst_pitch, src_bits, src_pitch, dst_height, dst_line, 256);
 	}
 
 	// copy metadata from src to dst
@@ -620,10 +615,111 @@ FreeImage_Copy(FIBITMAP *src, int left, int top, int right, int bottom) {
 	FIICCPROFILE *src_profile = FreeImage_GetICCProfile(src); 
 	FIICCPROFILE *dst_profile = FreeImage_CreateICCProfile(dst, src_profile->data, src_profile->size); 
 	dst_profile->flags = src_profile->flags; 
-	
+}
+
+/**
+Copy a sub part of the current image and returns it as a FIBITMAP*.
+Works with any bitmap type.
+@param left Specifies the left position of the cropped rectangle. 
+@param top Specifies the top position of the cropped rectangle. 
+@param right Specifies the right position of the cropped rectangle. 
+@param bottom Specifies the bottom position of the cropped rectangle. 
+@param flags With FI_COPY_VIEW, a view sharing the pixels of src is returned when the rectangle allows it
+(see FreeImage_CreateView), src must then outlive the result. Metadata are not cloned into a view.
+@return Returns the subimage if successful, NULL otherwise.
+*/
+FIBITMAP * DLL_CALLCONV 
+FreeImage_Copy(FIBITMAP *src, int left, int top, int right, int bottom, int flags) {
+
+	if (!FreeImage_HasPixels(src)) 
+		return nullptr;
+
+	// normalize the rectangle
+	if (right < left) {
+		INPLACESWAP(left, right);
+	}
+	if (bottom < top) {
+		INPLACESWAP(top, bottom);
+	}
+	// check the size of the sub image
+	const int src_width  = FreeImage_GetWidth(src);
+	const int src_height = FreeImage_GetHeight(src);
+	if ((left < 0) || (right > src_width) || (top < 0) || (bottom > src_height)) {
+		return nullptr;
+	}
+
+	if (flags & FI_COPY_VIEW) {
+		// views of 1- and 4-bit images must start on a byte boundary, copy otherwise
+		if (FIBITMAP *view = FreeImage_CreateView(src, left, top, right, bottom)) {
+			return view;
+		}
+	}
+
+	// allocate the sub image
+	const unsigned bpp = FreeImage_GetBPP(src);
+	const int dst_width = (right - left);
+	const int dst_height = (bottom - top);
+
+	FIBITMAP *dst = 
+		FreeImage_AllocateT(FreeImage_GetImageType(src), 
+							dst_width, 
+							dst_height, 
+							bpp, 
+							FreeImage_GetRedMask(src), FreeImage_GetGreenMask(src), FreeImage_GetBlueMask(src));
+
+	if (!dst) return nullptr;
+
+	CopyRect(dst, src, left, top);
+
 	return dst;
 }
 
+/**
+Copy a sub part of the current image into an already allocated image.
+dst must have the type and bit depth of src and the size of the rectangle, it may wrap user provided pixels
+(see FreeImage_AllocateHeaderForBits).
+@param left Specifies the left position of the cropped rectangle. 
+@param top Specifies the top position of the cropped rectangle. 
+@param right Specifies the right position of the cropped rectangle. 
+@param bottom Specifies the bottom position of the cropped rectangle. 
+@return Returns TRUE if successful, FALSE otherwise.
+*/
+FIBOOL DLL_CALLCONV 
+FreeImage_CopyInto(FIBITMAP *dst, FIBITMAP *src, int left, int top, int right, int bottom) {
+	if (!FreeImage_HasPixels(src) || !FreeImage_HasPixels(dst)) {
+		return FALSE;
+	}
+
+	// normalize the rectangle
+	if (right < left) {
+		INPLACESWAP(left, right);
+	}
+	if (bottom < top) {
+		INPLACESWAP(top, bottom);
+	}
+	// check the size of the sub image
+	const int src_width  = FreeImage_GetWidth(src);
+	const int src_height = FreeImage_GetHeight(src);
+	if ((left < 0) || (right > src_width) || (top < 0) || (bottom > src_height)) {
+		return FALSE;
+	}
+
+	// check the destination format
+	if ((FreeImage_GetImageType(dst) != FreeImage_GetImageType(src)) || (FreeImage_GetBPP(dst) != FreeImage_GetBPP(src))) {
+		return FALSE;
+	}
+	if (((int)FreeImage_GetWidth(dst) != (right - left)) || ((int)FreeImage_GetHeight(dst) != (bottom - top))) {
+		return FALSE;
+	}
+	if (FreeImage_HasRGBMasks(src) && ((FreeImage_GetRedMask(dst) != FreeImage_GetRedMask(src)) || (FreeImage_GetGreenMask(dst) != FreeImage_GetGreenMask(src)) || (FreeImage_GetBlueMask(dst) != FreeImage_GetBlueMask(src)))) {
+		return FALSE;
+	}
+
+	CopyRect(dst, src, left, top);
+
+	return TRUE;
+}
+
 /**
 Alpha blend or combine a sub part image with the current image.
 The bit depth of dst bitmap must be greater than or equal to the bit depth of src. 
@@ -746,6 +842,21 @@ FreeImage_Paste(FIBITMAP *dst, FIBITMAP *src, int left, int top, int alpha) {
 
 // ----------------------------------------------------------
 
+/**
+Returns the orientation displaying second(first(pixels)).
+A transposition turns the mirror of one axis into the mirror of the other.
+*/
+static unsigned
+ComposeOrientation(unsigned first, unsigned second) {
+	unsigned moved = first & FIO_TRANSPOSE;
+	if (second & FIO_TRANSPOSE) {
+		moved |= ((first & FIO_FLIP_HORIZONTAL) ? FIO_FLIP_VERTICAL : 0) | ((first & FIO_FLIP_VERTICAL) ? FIO_FLIP_HORIZONTAL : 0);
+	} else {
+		moved |= first & (FIO_FLIP_HORIZONTAL | FIO_FLIP_VERTICAL);
+	}
+	return moved ^ second;
+}
+
 /** @brief Creates a dynamic read/write view into a FreeImage bitmap.
 
  A dynamic view is a FreeImage bitmap with its own width and height, that,
@@ -774,19 +885,27 @@ FreeImage_Paste(FIBITMAP *dst, FIBITMAP *src, int left, int top, int alpha) {
  at a byte boundary, the value of parameter left must be a multiple of 8
  for 1-bit images and a multiple of 2 for 4-bit images.
 
+ A view may also carry an orientation: pixels are not moved, consumers
+ read them in display order through FreeImage_GetOrientedLayout or
+ FreeImage_ApplyOrientation.
+
  @param dib The FreeImage bitmap on which to create the view.
  @param left The left position of the view's area.
  @param top The top position of the view's area.
  @param right The right position of the view's area.
  @param bottom The bottom position of the view's area.
+ @param orientation FIO_xxx flags applied on top of the orientation of dib.
  @return Returns a handle to the newly created view or NULL if the view
  was not created.
  */
 FIBITMAP * DLL_CALLCONV
-FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom) {
+FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom, unsigned orientation) {
 	if (!FreeImage_HasPixels(dib)) {
 		return nullptr;
 	}
+	if (orientation & ~(FIO_FLIP_HORIZONTAL | FIO_FLIP_VERTICAL | FIO_TRANSPOSE)) {
+		return nullptr;
+	}
 
 	// normalize the rectangle
 	if (right < left) {
@@ -834,6 +953,9 @@ FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right,
 		return nullptr;
 	}
 
+	// the view orientation is applied after the one of dib
+	FreeImage_SetOrientation(dst, ComposeOrientation(FreeImage_GetOrientation(dib), orientation));
+
 	// copy some basic image properties needed for displaying and saving
 
 	// resolution
@@ -0,0 +1,181 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "ToneMapping.h"
+#include "FFT.h"
+
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <vector>
+
+
+namespace {
+
+	using Complex = FFTPlan::Complex;
+
+	constexpr double kPi = 3.14159265358979323846;
+
+	/**
+	DCT-II X[k] = sum x[j] cos(pi k (2j + 1) / 2n) and its inverse, computed by one complex transform
+	of length n of the samples reordered as even samples followed by odd samples reversed (J. Makhoul, 1980).
+	*/
+	class DCTPlan
+	{
+	public:
+		explicit DCTPlan(unsigned n)
+		: mFFT(FFTPlan::Get(n)), mShift(n) {
+			for (unsigned k = 0; k < n; k++) {
+				mShift[k] = std::polar(1.0, -kPi * k / (2.0 * n));
+			}
+		}
+
+		/// Number of complex work elements needed by Forward and Inverse
+		size_t GetWorkSize() const {
+			return mFFT->GetSize() + mFFT->GetScratchSize();
+		}
+
+		void Forward(double *x, Complex *work) const {
+			const unsigned n = mFFT->GetSize();
+			for (unsigned j = 0; 2 * j < n; j++) {
+				work[j] = x[2 * j];
+			}
+			for (unsigned j = 0; 2 * j + 1 < n; j++) {
+				work[n - 1 - j] = x[2 * j + 1];
+			}
+			mFFT->Transform(work, false, work + n);
+			for (unsigned k = 0; k < n; k++) {
+				x[k] = (mShift[k] * work[k]).real();
+			}
+		}
+
+		void Inverse(double *x, Complex *work) const {
+			const unsigned n = mFFT->GetSize();
+			work[0] = x[0];
+			for (unsigned k = 1; k < n; k++) {
+				work[k] = std::conj(mShift[k]) * Complex(x[k], -x[n - k]);
+			}
+			mFFT->Transform(work, true, work + n);
+			const double scale = 1.0 / n;
+			for (unsigned j = 0; 2 * j < n; j++) {
+				x[2 * j] = work[j].real() * scale;
+			}
+			for (unsigned j = 0; 2 * j + 1 < n; j++) {
+				x[2 * j + 1] = work[n - 1 - j].real() * scale;
+			}
+		}
+
+	private:
+		std::shared_ptr<const FFTPlan> mFFT;	// cached, see FFTPlan::Get
+		std::vector<Complex> mShift;	// exp(-i pi k / 2n)
+	};
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+/**
+Poisson solver based on discrete cosine transforms.
+The cosine basis diagonalizes the 5-point Laplacian with mirrored (Neumann) boundaries, so the solution is exact
+and computed in O(N log N) on a grid of the size of the image: the coefficients of the Laplacian are divided by
+the eigenvalues 2cos(pi k / width) + 2cos(pi l / height) - 4, the constant term (undefined for Neumann boundaries) is zero.
+Rows and columns are transformed in double precision by parallel bands.
+@param Laplacian Laplacian image
+@return Returns the solution remapped to [0..1] if successful, returns NULL otherwise
+*/
+FIBITMAP* DLL_CALLCONV
+FreeImage_DCTPoissonSolver(FIBITMAP *Laplacian) {
+	if (!FreeImage_HasPixels(Laplacian) || (FreeImage_GetImageType(Laplacian) != FIT_FLOAT)) return nullptr;
+
+	const unsigned width = FreeImage_GetWidth(Laplacian);
+	const unsigned height = FreeImage_GetHeight(Laplacian);
+
+	FIBITMAP *U = FreeImage_AllocateT(FIT_FLOAT, width, height);
+	if (!U) return nullptr;
+
+	try {
+		const DCTPlan row_plan(width);
+		const DCTPlan column_plan(height);
+
+		std::vector<double> coefficients((size_t)width * height);
+		std::vector<double> row_eigenvalues(width);
+		for (unsigned k = 0; k < width; k++) {
+			row_eigenvalues[k] = 2 * std::cos(kPi * k / width) - 2;
+		}
+		std::vector<double> column_eigenvalues(height);
+		for (unsigned l = 0; l < height; l++) {
+			column_eigenvalues[l] = 2 * std::cos(kPi * l / height) - 2;
+		}
+
+		const unsigned src_pitch = FreeImage_GetPitch(Laplacian);
+		const uint8_t *src_bits = FreeImage_GetConstBits(Laplacian);
+		const unsigned dst_pitch = FreeImage_GetPitch(U);
+		uint8_t *dst_bits = FreeImage_GetBits(U);
+		double *coef = coefficients.data();
+
+		const unsigned band_rows = CalculateBandRows((size_t)width * sizeof(double));
+
+		// transform the rows of the Laplacian
+		ParallelFor(0, height, band_rows, [&](unsigned first, unsigned last) {
+			std::vector<Complex> work(row_plan.GetWorkSize());
+			for (unsigned y = first; y < last; y++) {
+				const float *src = reinterpret_cast<const float *>(src_bits + (size_t)src_pitch * y);
+				double *line = coef + (size_t)width * y;
+				for (unsigned x = 0; x < width; x++) {
+					line[x] = src[x];
+				}
+				row_plan.Forward(line, work.data());
+			}
+		});
+
+		// transform the columns, solve in the frequency domain, then transform back the columns
+		ParallelFor(0, width, CalculateBandRows((size_t)height * sizeof(double)), [&](unsigned first, unsigned last) {
+			std::vector<Complex> work(column_plan.GetWorkSize());
+			std::vector<double> column(height);
+			for (unsigned k = first; k < last; k++) {
+				for (unsigned y = 0; y < height; y++) {
+					column[y] = coef[(size_t)width * y + k];
+				}
+				column_plan.Forward(column.data(), work.data());
+				for (unsigned l = 0; l < height; l++) {
+					const double eigenvalue = row_eigenvalues[k] + column_eigenvalues[l];
+					column[l] = ((k == 0) && (l == 0)) ? 0 : column[l] / eigenvalue;
+				}
+				column_plan.Inverse(column.data(), work.data());
+				for (unsigned y = 0; y < height; y++) {
+					coef[(size_t)width * y + k] = column[y];
+				}
+			}
+		});
+
+		// transform back the rows
+		ParallelFor(0, height, band_rows, [&](unsigned first, unsigned last) {
+			std::vector<Complex> work(row_plan.GetWorkSize());
+			for (unsigned y = first; y < last; y++) {
+				double *line = coef + (size_t)width * y;
+				row_plan.Inverse(line, work.data());
+				float *dst = reinterpret_cast<float *>(dst_bits + (size_t)dst_pitch * y);
+				for (unsigned x = 0; x < width; x++) {
+					dst[x] = (float)line[x];
+				}
+			}
+		});
+
+	} catch(const std::bad_alloc &) {
+		FreeImage_Unload(U);
+		return nullptr;
+	}
+
+	// remap pixels to [0..1]
+	NormalizeY(U, 0, 1);
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(U, Laplacian);
+
+	return U;
+}
@@ -21,6 +21,11 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "../FreeImage/CPUDispatch.h"
+#include "../FreeImage/ConversionSIMD.h"
+
+#include <array>
+#include <vector>
 
 
 /**
@@ -57,16 +62,9 @@ FreeImage_Composite(FIBITMAP *fg, FIBOOL useFileBkg, FIRGBA8 *appBkColor, FIBITM
 			return nullptr;
 	}
 
-	int bytespp = (bpp == 8) ? 1 : 4;
+	const int bytespp = (bpp == 8) ? 1 : 4;
 
-	
-	int x, y, c;
-	uint8_t alpha = 0, not_alpha;
-	uint8_t index;
-	FIRGBA8 fgc;	// foreground color
 	FIRGBA8 bkc;	// background color
-
-	memset(&fgc, 0, sizeof(FIRGBA8));
 	memset(&bkc, 0, sizeof(FIRGBA8));
 
 	// allocate the composite image
@@ -77,7 +75,7 @@ FreeImage_Composite(FIBITMAP *fg, FIBOOL useFileBkg, FIRGBA8 *appBkColor, FIBITM
 	const FIRGBA8 *pal = FreeImage_GetPalette(fg);
 
 	// retrieve the alpha table from the foreground image
-	FIBOOL bIsTransparent = FreeImage_IsTransparent(fg);
+	const FIBOOL bIsTransparent = FreeImage_IsTransparent(fg);
 	const uint8_t *trns = FreeImage_GetTransparencyTable(fg);
 
 	// retrieve the background color from the foreground image
@@ -99,84 +97,92 @@ FreeImage_Composite(FIBITMAP *fg, FIBOOL useFileBkg, FIRGBA8 *appBkColor, FIBITM
 		}
 	}
 
-	for (y = 0; y < height; y++) {
-		// foreground
-		uint8_t *fg_bits = FreeImage_GetScanLine(fg, y);
-		// background
-		uint8_t *bg_bits = FreeImage_GetScanLine(bg, y);
-		// composite image
-		uint8_t *cp_bits = FreeImage_GetScanLine(composite, y);
-
-		for (x = 0; x < width; x++) {
-
-			// foreground color + alpha
+	// scanlines are independent, they are composited by parallel bands
+	ParallelFor(0, height, CalculateBandRows((size_t)width * (bytespp + 6)), [&](unsigned first, unsigned last) {
+		FIRGBA8 fgc;	// foreground color
+		FIRGBA8 bkp = bkc;	// background color of the pixel
+		memset(&fgc, 0, sizeof(FIRGBA8));
+		uint8_t alpha = 0, not_alpha;
+
+		for (int y = (int)first; y < (int)last; y++) {
+			// foreground
+			const uint8_t *fg_bits = FreeImage_GetConstScanLine(fg, y);
+			// background
+			const uint8_t *bg_bits = bg ? FreeImage_GetConstScanLine(bg, y) : nullptr;
+			// composite image
+			uint8_t *cp_bits = FreeImage_GetScanLine(composite, y);
+
+			for (int x = 0; x < width; x++) {
+
+				// foreground color + alpha
+
+				if (bpp == 8) {
+					// get the foreground color
+					const uint8_t index = fg_bits[0];
+					memcpy(&fgc, &pal[index], sizeof(FIRGBA8));
+					// get the alpha
+					if (bIsTransparent) {
+						alpha = trns[index];
+					} else {
+						alpha = 255;
+					}
+				}
+				else if (bpp == 32) {
+					// get the foreground color
+					fgc.blue  = fg_bits[FI_RGBA_BLUE];
+					fgc.green = fg_bits[FI_RGBA_GREEN];
+					fgc.red   = fg_bits[FI_RGBA_RED];
+					// get the alpha
+					alpha = fg_bits[FI_RGBA_ALPHA];
+				}
 
-			if (bpp == 8) {
-				// get the foreground color
-				index = fg_bits[0];
-				memcpy(&fgc, &pal[index], sizeof(FIRGBA8));
-				// get the alpha
-				if (bIsTransparent) {
-					alpha = trns[index];
-				} else {
-					alpha = 255;
+				// background color
+
+				if (!bHasBkColor) {
+					if (bg) {
+						// get the background color from the background image
+						bkp.blue  = bg_bits[FI_RGBA_BLUE];
+						bkp.green = bg_bits[FI_RGBA_GREEN];
+						bkp.red   = bg_bits[FI_RGBA_RED];
+						bg_bits += 3;
+					}
+					else {
+						// use a checkerboard pattern
+						int c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) * 192;
+						c = c ? c : 255;
+						bkp.blue  = (uint8_t)c;
+						bkp.green = (uint8_t)c;
+						bkp.red   = (uint8_t)c;
+					}
 				}
-			}
-			else if (bpp == 32) {
-				// get the foreground color
-				fgc.blue  = fg_bits[FI_RGBA_BLUE];
-				fgc.green = fg_bits[FI_RGBA_GREEN];
-				fgc.red   = fg_bits[FI_RGBA_RED];
-				// get the alpha
-				alpha = fg_bits[FI_RGBA_ALPHA];
-			}
 
-			// background color
+				// composition
 
-			if (!bHasBkColor) {
-				if (bg) {
-					// get the background color from the background image
-					bkc.blue  = bg_bits[FI_RGBA_BLUE];
-					bkc.green = bg_bits[FI_RGBA_GREEN];
-					bkc.red   = bg_bits[FI_RGBA_RED];
+				if (alpha == 0) {
+					// output = background
+					cp_bits[FI_RGBA_BLUE] = bkp.blue;
+					cp_bits[FI_RGBA_GREEN] = bkp.green;
+					cp_bits[FI_RGBA_RED] = bkp.red;
+				}
+				else if (alpha == 255) {
+					// output = foreground
+					cp_bits[FI_RGBA_BLUE] = fgc.blue;
+					cp_bits[FI_RGBA_GREEN] = fgc.green;
+					cp_bits[FI_RGBA_RED] = fgc.red;
 				}
 				else {
-					// use a checkerboard pattern
-					c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) * 192;
-					c = c ? c : 255;
-					bkc.blue  = (uint8_t)c;
-					bkc.green = (uint8_t)c;
-					bkc.red   = (uint8_t)c;
+					// output = alpha * foreground + (1-alpha) * background
+					not_alpha = (uint8_t)~alpha;
+					cp_bits[FI_RGBA_BLUE] = (uint8_t)((alpha * (uint16_t)fgc.blue  + not_alpha * (uint16_t)bkp.blue) >> 8);
+					cp_bits[FI_RGBA_GREEN] = (uint8_t)((alpha * (uint16_t)fgc.green + not_alpha * (uint16_t)bkp.green) >> 8);
+					cp_bits[FI_RGBA_RED] = (uint8_t)((alpha * (uint16_t)fgc.red   + not_alpha * (uint16_t)bkp.red) >> 8);
 				}
-			}
 
-			// composition
-
-			if (alpha == 0) {
-				// output = background
-				cp_bits[FI_RGBA_BLUE] = bkc.blue;
-				cp_bits[FI_RGBA_GREEN] = bkc.green;
-				cp_bits[FI_RGBA_RED] = bkc.red;
-			}
-			else if (alpha == 255) {
-				// output = foreground
-				cp_bits[FI_RGBA_BLUE] = fgc.blue;
-				cp_bits[FI_RGBA_GREEN] = fgc.green;
-				cp_bits[FI_RGBA_RED] = fgc.red;
+				fg_bits += bytespp;
+				cp_bits += 3;
 			}
-			else {
-				// output = alpha * foreground + (1-alpha) * background
-				not_alpha = (uint8_t)~alpha;
-				cp_bits[FI_RGBA_BLUE] = (uint8_t)((alpha * (uint16_t)fgc.blue  + not_alpha * (uint16_t)bkc.blue) >> 8);
-				cp_bits[FI_RGBA_GREEN] = (uint8_t)((alpha * (uint16_t)fgc.green + not_alpha * (uint16_t)bkc.green) >> 8);
-				cp_bits[FI_RGBA_RED] = (uint8_t)((alpha * (uint16_t)fgc.red   + not_alpha * (uint16_t)bkc.red) >> 8);
-			}
-
-			fg_bits += bytespp;
-			bg_bits += 3;
-			cp_bits += 3;
 		}
-	}
+	});
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(composite, fg);
@@ -184,60 +190,610 @@ FreeImage_Composite(FIBITMAP *fg, FIBOOL useFileBkg, FIRGBA8 *appBkColor, FIBITM
 	return composite;	
 }
 
+// ----------------------------------------------------------
+//   Pre-multiplied alpha
+// ----------------------------------------------------------
+
+namespace {
+
+	// 8-bit channels: (alpha * c + 127) / 255, 16-bit channels: (alpha * c + 32767) / 65535.
+	// Vector kernels compute both divisions as (t + (t >> n)) >> n with t = x + 2^(n-1), which is exact
+	// over the whole range of products, so their results match the scalar code.
+
+	void PreMultiplyRow8(FIRGBA8 *bits, unsigned width) {
+		for (unsigned x = 0; x < width; x++) {
+			const unsigned alpha = bits[x].alpha;
+			bits[x].red = (uint8_t)((alpha * bits[x].red + 127) / 255);
+			bits[x].green = (uint8_t)((alpha * bits[x].green + 127) / 255);
+			bits[x].blue = (uint8_t)((alpha * bits[x].blue + 127) / 255);
+		}
+	}
+
+	void PreMultiplyRow16(FIRGBA16 *bits, unsigned width) {
+		for (unsigned x = 0; x < width; x++) {
+			const uint32_t alpha = bits[x].alpha;
+			bits[x].red = (uint16_t)((alpha * bits[x].red + 32767) / 65535);
+			bits[x].green = (uint16_t)((alpha * bits[x].green + 32767) / 65535);
+			bits[x].blue = (uint16_t)((alpha * bits[x].blue + 32767) / 65535);
+		}
+	}
+
+	void PreMultiplyRowF(FIRGBAF *bits, unsigned width) {
+		for (unsigned x = 0; x < width; x++) {
+			const float alpha = bits[x].alpha;
+			bits[x].red *= alpha;
+			bits[x].green *= alpha;
+			bits[x].blue *= alpha;
+		}
+	}
+
+	/// Pre-multiplies the beginning of a row and returns the number of pixels processed
+	template <typename Pixel>
+	using PreMultiplyKernel = unsigned (*)(Pixel *bits, unsigned width);
+
+	template <typename Pixel>
+	unsigned NoPreMultiply(Pixel *, unsigned) {
+		return 0;
+	}
+
+#if FREEIMAGE_SIMD_X86
+	unsigned PreMultiplyRow8_SSE2(FIRGBA8 *bits, unsigned width) {
+		static_assert(FI_RGBA_ALPHA == 3, "BGRA or RGBA byte order expected");
+		const __m128i zero = _mm_setzero_si128();
+		// alpha is multiplied by 255 which leaves it unchanged
+		const __m128i alpha_lanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+		const __m128i color_lanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+		auto premultiply = [&](__m128i p) {
+			const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, 0xFF), 0xFF);
+			const __m128i t = _mm_add_epi16(_mm_mullo_epi16(p, _mm_or_si128(_mm_and_si128(alpha, color_lanes), alpha_lanes)), _mm_set1_epi16(128));
+			return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+		};
+		unsigned x = 0;
+		for (; x + 4 <= width; x += 4) {
+			const __m128i p = _mm_loadu_si128((const __m128i *)(bits + x));
+			_mm_storeu_si128((__m128i *)(bits + x), _mm_packus_epi16(premultiply(_mm_unpacklo_epi8(p, zero)), premultiply(_mm_unpackhi_epi8(p, zero))));
+		}
+		return x;
+	}
+
+	unsigned PreMultiplyRow16_SSE2(FIRGBA16 *bits, unsigned width) {
+		const __m128i alpha_lanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+		const __m128i color_lanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+		const __m128i half = _mm_set1_epi32(32768);
+		auto divide = [&](__m128i x) {
+			// rounded x / 65535, biased by -32768 for the signed pack
+			const __m128i t = _mm_add_epi32(x, half);
+			return _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(t, _mm_srli_epi32(t, 16)), 16), half);
+		};
+		unsigned x = 0;
+		for (; x + 2 <= width; x += 2) {
+			const __m128i p = _mm_loadu_si128((const __m128i *)(bits + x));
+			const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, 0xFF), 0xFF);
+			const __m128i m = _mm_or_si128(_mm_and_si128(alpha, color_lanes), alpha_lanes);
+			const __m128i lo = _mm_mullo_epi16(p, m);
+			const __m128i hi = _mm_mulhi_epu16(p, m);
+			const __m128i r = _mm_packs_epi32(divide(_mm_unpacklo_epi16(lo, hi)), divide(_mm_unpackhi_epi16(lo, hi)));
+			_mm_storeu_si128((__m128i *)(bits + x), _mm_xor_si128(r, _mm_set1_epi16(-32768)));
+		}
+		return x;
+	}
+
+	unsigned PreMultiplyRowF_SSE2(FIRGBAF *bits, unsigned width) {
+		const __m128 color_lanes = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		const __m128 alpha_one = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+		for (unsigned x = 0; x < width; x++) {
+			const __m128 p = _mm_loadu_ps(&bits[x].red);
+			const __m128 alpha = _mm_shuffle_ps(p, p, 0xFF);
+			_mm_storeu_ps(&bits[x].red, _mm_mul_ps(p, _mm_or_ps(_mm_and_ps(alpha, color_lanes), alpha_one)));
+		}
+		return width;
+	}
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+	unsigned PreMultiplyRow8_NEON(FIRGBA8 *bits, unsigned width) {
+		auto premultiply = [](uint8x8_t c, uint8x8_t alpha) {
+			const uint16x8_t x = vmull_u8(c, alpha);
+			// (x + 128 + ((x + 128) >> 8)) >> 8
+			return vmovn_u16(vrshrq_n_u16(vrsraq_n_u16(x, x, 8), 8));
+		};
+		unsigned x = 0;
+		for (; x + 8 <= width; x += 8) {
+			uint8x8x4_t p = vld4_u8((const uint8_t *)(bits + x));
+			const uint8x8_t alpha = p.val[FI_RGBA_ALPHA];
+			p.val[FI_RGBA_RED] = premultiply(p.val[FI_RGBA_RED], alpha);
+			p.val[FI_RGBA_GREEN] = premultiply(p.val[FI_RGBA_GREEN], alpha);
+			p.val[FI_RGBA_BLUE] = premultiply(p.val[FI_RGBA_BLUE], alpha);
+			vst4_u8((uint8_t *)(bits + x), p);
+		}
+		return x;
+	}
+
+	unsigned PreMultiplyRow16_NEON(FIRGBA16 *bits, unsigned width) {
+		auto premultiply = [](uint16x4_t c, uint16x4_t alpha) {
+			const uint32x4_t t = vaddq_u32(vmull_u16(c, alpha), vdupq_n_u32(32768));
+			return vshrn_n_u32(vaddq_u32(t, vshrq_n_u32(t, 16)), 16);
+		};
+		unsigned x = 0;
+		for (; x + 4 <= width; x += 4) {
+			uint16x4x4_t p = vld4_u16((const uint16_t *)(bits + x));
+			const uint16x4_t alpha = p.val[3];
+			p.val[0] = premultiply(p.val[0], alpha);
+			p.val[1] = premultiply(p.val[1], alpha);
+			p.val[2] = premultiply(p.val[2], alpha);
+			vst4_u16((uint16_t *)(bits + x), p);
+		}
+		return x;
+	}
+
+	unsigned PreMultiplyRowF_NEON(FIRGBAF *bits, unsigned width) {
+		unsigned x = 0;
+		for (; x + 4 <= width; x += 4) {
+			float32x4x4_t p = vld4q_f32(&bits[x].red);
+			p.val[0] = vmulq_f32(p.val[0], p.val[3]);
+			p.val[1] = vmulq_f32(p.val[1], p.val[3]);
+			p.val[2] = vmulq_f32(p.val[2], p.val[3]);
+			vst4q_f32(&bits[x].red, p);
+		}
+		return x;
+	}
+#endif // FREEIMAGE_SIMD_NEON
+
+	struct PreMultiplyKernels {
+		std::atomic<PreMultiplyKernel<FIRGBA8>> row8{ NoPreMultiply<FIRGBA8> };
+		std::atomic<PreMultiplyKernel<FIRGBA16>> row16{ NoPreMultiply<FIRGBA16> };
+		std::atomic<PreMultiplyKernel<FIRGBAF>> rowF{ NoPreMultiply<FIRGBAF> };
+	};
+
+	PreMultiplyKernels gPreMultiplyKernels;
+
+	void SelectPreMultiplyKernels(unsigned features) {
+		PreMultiplyKernel<FIRGBA8> row8 = NoPreMultiply<FIRGBA8>;
+		PreMultiplyKernel<FIRGBA16> row16 = NoPreMultiply<FIRGBA16>;
+		PreMultiplyKernel<FIRGBAF> rowF = NoPreMultiply<FIRGBAF>;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			row8 = PreMultiplyRow8_SSE2;
+			row16 = PreMultiplyRow16_SSE2;
+			rowF = PreMultiplyRowF_SSE2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			row8 = PreMultiplyRow8_NEON;
+			row16 = PreMultiplyRow16_NEON;
+			rowF = PreMultiplyRowF_NEON;
+		}
+#endif
+		gPreMultiplyKernels.row8.store(row8, std::memory_order_relaxed);
+		gPreMultiplyKernels.row16.store(row16, std::memory_order_relaxed);
+		gPreMultiplyKernels.rowF.store(rowF, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gPreMultiplyRegistrar(SelectPreMultiplyKernels);
+
+	// 8-bit un-premultiplication: c * 255 / alpha rounded to nearest is (c * R + 2^15) >> 16 with
+	// R = ceil(255 * 2^16 / alpha), exact for every c <= alpha
+
+	constexpr std::array<uint32_t, 256> MakeReciprocalTable() {
+		std::array<uint32_t, 256> table{};
+		for (uint32_t alpha = 1; alpha < 256; alpha++) {
+			table[alpha] = ((255u << 16) + alpha - 1) / alpha;
+		}
+		return table;
+	}
+
+	constexpr std::array<uint32_t, 256> kReciprocal = MakeReciprocalTable();
+
+	void UnPreMultiplyRow8(FIRGBA8 *bits, unsigned width) {
+		for (unsigned x = 0; x < width; x++) {
+			const uint32_t r = kReciprocal[bits[x].alpha];
+			bits[x].red = (uint8_t)std::min<uint32_t>(255, (bits[x].red * r + 0x8000) >> 16);
+			bits[x].green = (uint8_t)std::min<uint32_t>(255, (bits[x].green * r + 0x8000) >> 16);
+			bits[x].blue = (uint8_t)std::min<uint32_t>(255, (bits[x].blue * r + 0x8000) >> 16);
+		}
+	}
+
+	void UnPreMultiplyRow16(FIRGBA16 *bits, unsigned width) {
+		for (unsigned x = 0; x < width; x++) {
+			const uint32_t alpha = bits[x].alpha;
+			if (alpha == 0) {
+				bits[x].red = bits[x].green = bits[x].blue = 0;
+			} else if (alpha != 65535) {
+				auto divide = [alpha](uint16_t c) {
+					return (uint16_t)std::min<uint64_t>(65535, ((uint64_t)c * 65535 + alpha / 2) / alpha);
+				};
+				bits[x].red = divide(bits[x].red);
+				bits[x].green = divide(bits[x].green);
+				bits[x].blue = divide(bits[x].blue);
+			}
+		}
+	}
+
+	void UnPreMultiplyRowF(FIRGBAF *bits, unsigned width) {
+		for (unsigned x = 0; x < width; x++) {
+			const float alpha = bits[x].alpha;
+			const float scale = (alpha != 0) ? 1 / alpha : 0;
+			bits[x].red *= scale;
+			bits[x].green *= scale;
+			bits[x].blue *= scale;
+		}
+	}
+
+	/// Calls row(scanline, width) for every scanline of dib by parallel bands
+	template <typename Pixel, typename RowFunction>
+	void ForEachScanLine(FIBITMAP *dib, RowFunction row) {
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned pitch = FreeImage_GetPitch(dib);
+		uint8_t *bits = FreeImage_GetBits(dib);
+		ParallelFor(0, FreeImage_GetHeight(dib), CalculateBandRows(width * sizeof(Pixel)), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				row(reinterpret_cast<Pixel *>(bits + (size_t)pitch * y), width);
+			}
+		});
+	}
+
+	template <typename Pixel>
+	void PreMultiply(FIBITMAP *dib, const std::atomic<PreMultiplyKernel<Pixel>> &kernel, void (*scalar)(Pixel *, unsigned)) {
+		const PreMultiplyKernel<Pixel> vector = kernel.load(std::memory_order_relaxed);
+		ForEachScanLine<Pixel>(dib, [&](Pixel *bits, unsigned width) {
+			const unsigned done = vector(bits, width);
+			scalar(bits + done, width - done);
+		});
+	}
+
+} // namespace
+
 /**
-Pre-multiplies a 32-bit image's red-, green- and blue channels with it's alpha channel 
+Pre-multiplies the red-, green- and blue channels of an image with its alpha channel 
 for to be used with e.g. the Windows GDI function AlphaBlend(). 
 The transformation changes the red-, green- and blue channels according to the following equation:  
-channel(x, y) = channel(x, y) * alpha_channel(x, y) / 255  
+channel(x, y) = channel(x, y) * alpha_channel(x, y) / max_value  
+32-bit FIT_BITMAP, FIT_RGBA16 and FIT_RGBAF images are supported, rows are processed by parallel bands.
 @param dib Input/Output dib to be premultiplied
 @return Returns TRUE on success, FALSE otherwise (e.g. when the bitdepth of the source dib cannot be handled). 
 */
 FIBOOL DLL_CALLCONV 
 FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib) {
 	if (!FreeImage_HasPixels(dib)) return FALSE;
-	
-	if ((FreeImage_GetBPP(dib) != 32) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
-		return FALSE;
+
+	switch (FreeImage_GetImageType(dib)) {
+		case FIT_BITMAP:
+			if (FreeImage_GetBPP(dib) != 32) {
+				return FALSE;
+			}
+			PreMultiply<FIRGBA8>(dib, gPreMultiplyKernels.row8, PreMultiplyRow8);
+			return TRUE;
+		case FIT_RGBA16:
+			PreMultiply<FIRGBA16>(dib, gPreMultiplyKernels.row16, PreMultiplyRow16);
+			return TRUE;
+		case FIT_RGBAF:
+			PreMultiply<FIRGBAF>(dib, gPreMultiplyKernels.rowF, PreMultiplyRowF);
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/**
+Reverts FreeImage_PreMultiplyWithAlpha: the red-, green- and blue channels are divided by the alpha channel,
+colors of fully transparent pixels become black. 8-bit channels are divided with a table of reciprocals.
+32-bit FIT_BITMAP, FIT_RGBA16 and FIT_RGBAF images are supported, rows are processed by parallel bands.
+@param dib Input/Output premultiplied dib
+@return Returns TRUE on success, FALSE otherwise (e.g. when the bitdepth of the source dib cannot be handled). 
+*/
+FIBOOL DLL_CALLCONV 
+FreeImage_UnPreMultiplyWithAlpha(FIBITMAP *dib) {
+	if (!FreeImage_HasPixels(dib)) return FALSE;
+
+	switch (FreeImage_GetImageType(dib)) {
+		case FIT_BITMAP:
+			if (FreeImage_GetBPP(dib) != 32) {
+				return FALSE;
+			}
+			ForEachScanLine<FIRGBA8>(dib, UnPreMultiplyRow8);
+			return TRUE;
+		case FIT_RGBA16:
+			ForEachScanLine<FIRGBA16>(dib, UnPreMultiplyRow16);
+			return TRUE;
+		case FIT_RGBAF:
+			ForEachScanLine<FIRGBAF>(dib, UnPreMultiplyRowF);
+			return TRUE;
+		default:
+			return FALSE;
 	}
+}
+
+
+// ----------------------------------------------------------
+//   Blending rows of FreeImage_DrawBitmap
+// ----------------------------------------------------------
+
+namespace {
+
+	// 8-bit channels: (x + 127) / 255 is computed as (t + (t >> 8)) >> 8 with t = x + 128 and x / 255 as
+	// (x + 1 + (x >> 8)) >> 8, both exact for x <= 255 * 255, so that vector kernels match the scalar code
 
-	const int width = FreeImage_GetWidth(dib);
-	const int height = FreeImage_GetHeight(dib);
-
-	for (int y = 0; y < height; y++) {
-		uint8_t *bits = FreeImage_GetScanLine(dib, y);
-		for (int x = 0; x < width; x++, bits += 4) {
-			const uint8_t alpha = bits[FI_RGBA_ALPHA];
-			// slightly faster: care for two special cases
-			if (alpha == 0x00) {
-				// special case for alpha == 0x00
-				// color * 0x00 / 0xFF = 0x00
-				bits[FI_RGBA_BLUE] = 0x00;
-				bits[FI_RGBA_GREEN] = 0x00;
-				bits[FI_RGBA_RED] = 0x00;
-			} else if (alpha == 0xFF) {
-				// nothing to do for alpha == 0xFF
-				// color * 0xFF / 0xFF = color
-				continue;
-			} else {
-				bits[FI_RGBA_BLUE] = (uint8_t)( (alpha * (uint16_t)bits[FI_RGBA_BLUE] + 127) / 255 );
-				bits[FI_RGBA_GREEN] = (uint8_t)( (alpha * (uint16_t)bits[FI_RGBA_GREEN] + 127) / 255 );
-				bits[FI_RGBA_RED] = (uint8_t)( (alpha * (uint16_t)bits[FI_RGBA_RED] + 127) / 255 );
+	inline unsigned Mul255(unsigned a, unsigned b) {
+		return (a * b + 127) / 255;
+	}
+
+	template <FREE_IMAGE_ALPHA_OPERATION op>
+	inline void BlendPixel(FIRGBA8 &d, const FIRGBA8 &s) {
+		const unsigned sa = s.alpha;
+		const unsigned da = d.alpha;
+		auto blend = [&](uint8_t &dc, unsigned sc) {
+			unsigned value;
+			switch (op) {
+				case FIAO_SrcAlpha:
+					value = (sa * sc + (255 - sa) * dc) / 255;
+					break;
+				case FIAO_SrcOver:
+					value = sc + Mul255(dc, 255 - sa);
+					break;
+				case FIAO_Multiply:
+					value = Mul255(sc, dc) + Mul255(sc, 255 - da) + Mul255(dc, 255 - sa);
+					break;
+				case FIAO_Screen:
+					value = sc + dc - Mul255(sc, dc);
+					break;
+				default:
+					value = sc + dc;
+					break;
 			}
+			dc = static_cast<uint8_t>(std::min(value, 255u));
+		};
+		blend(d.red, s.red);
+		blend(d.green, s.green);
+		blend(d.blue, s.blue);
+		if (op != FIAO_SrcAlpha) {
+			// dst alpha is kept by FIAO_SrcAlpha
+			blend(d.alpha, s.alpha);
 		}
 	}
-	return TRUE;
-}
 
+	template <FREE_IMAGE_ALPHA_OPERATION op>
+	void BlendRow(FIRGBA8 *dst, const FIRGBA8 *src, unsigned width) {
+		for (unsigned x = 0; x < width; x++) {
+			BlendPixel<op>(dst[x], src[x]);
+		}
+	}
+
+	/// Blends width pixels of src over dst and returns the number of pixels processed
+	using BlendRowKernel = unsigned (*)(FIRGBA8 *dst, const FIRGBA8 *src, unsigned width);
+
+	unsigned NoBlend(FIRGBA8 *, const FIRGBA8 *, unsigned) {
+		return 0;
+	}
+
+#if FREEIMAGE_SIMD_X86
+	inline __m128i Div255Round_SSE2(__m128i x) {
+		const __m128i t = _mm_add_epi16(x, _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+	}
+
+	/// Blends two pixels held as 16-bit lanes
+	template <FREE_IMAGE_ALPHA_OPERATION op>
+	inline __m128i Blend_SSE2(__m128i s, __m128i d) {
+		static_assert(FI_RGBA_ALPHA == 3, "BGRA or RGBA byte order expected");
+		const __m128i max = _mm_set1_epi16(255);
+		const __m128i nsa = _mm_sub_epi16(max, _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF));
+		switch (op) {
+			case FIAO_SrcAlpha:
+			{
+				const __m128i x = _mm_add_epi16(_mm_mullo_epi16(s, _mm_sub_epi16(max, nsa)), _mm_mullo_epi16(d, nsa));
+				return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+			}
+			case FIAO_SrcOver:
+				return _mm_add_epi16(s, Div255Round_SSE2(_mm_mullo_epi16(d, nsa)));
+			case FIAO_Multiply:
+			{
+				const __m128i nda = _mm_sub_epi16(max, _mm_shufflehi_epi16(_mm_shufflelo_epi16(d, 0xFF), 0xFF));
+				const __m128i sd = Div255Round_SSE2(_mm_mullo_epi16(s, d));
+				return _mm_add_epi16(_mm_add_epi16(sd, Div255Round_SSE2(_mm_mullo_epi16(s, nda))), Div255Round_SSE2(_mm_mullo_epi16(d, nsa)));
+			}
+			case FIAO_Screen:
+				return _mm_sub_epi16(_mm_add_epi16(s, d), Div255Round_SSE2(_mm_mullo_epi16(s, d)));
+			default:
+				return _mm_add_epi16(s, d);
+		}
+	}
+
+	template <FREE_IMAGE_ALPHA_OPERATION op>
+	unsigned BlendRow_SSE2(FIRGBA8 *dst, const FIRGBA8 *src, unsigned width) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i alpha_mask = _mm_set1_epi32((int)FI_RGBA_ALPHA_MASK);
+		unsigned x = 0;
+		for (; x + 4 <= width; x += 4) {
+			const __m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+			const __m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+			const __m128i lo = Blend_SSE2<op>(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+			const __m128i hi = Blend_SSE2<op>(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+			__m128i r = _mm_packus_epi16(lo, hi);
+			if (op == FIAO_SrcAlpha) {
+				r = _mm_or_si128(_mm_andnot_si128(alpha_mask, r), _mm_and_si128(alpha_mask, d));
+			}
+			_mm_storeu_si128((__m128i *)(dst + x), r);
+		}
+		return x;
+	}
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+	inline uint16x8_t Div255Round_NEON(uint16x8_t x) {
+		// (x + 128 + ((x + 128) >> 8)) >> 8
+		return vrshrq_n_u16(vrsraq_n_u16(x, x, 8), 8);
+	}
+
+	template <FREE_IMAGE_ALPHA_OPERATION op>
+	inline uint8x8_t Blend_NEON(uint8x8_t s, uint8x8_t d, uint8x8_t sa, uint8x8_t da) {
+		const uint8x8_t nsa = vmvn_u8(sa);
+		switch (op) {
+			case FIAO_SrcAlpha:
+			{
+				const uint16x8_t x = vmlal_u8(vmull_u8(s, sa), d, nsa);
+				return vshrn_n_u16(vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8)), 8);
+			}
+			case FIAO_SrcOver:
+				return vqadd_u8(s, vmovn_u16(Div255Round_NEON(vmull_u8(d, nsa))));
+			case FIAO_Multiply:
+			{
+				const uint16x8_t sd = vaddq_u16(Div255Round_NEON(vmull_u8(s, d)), Div255Round_NEON(vmull_u8(s, vmvn_u8(da))));
+				return vqmovn_u16(vaddq_u16(sd, Div255Round_NEON(vmull_u8(d, nsa))));
+			}
+			case FIAO_Screen:
+				return vmovn_u16(vsubq_u16(vaddl_u8(s, d), Div255Round_NEON(vmull_u8(s, d))));
+			default:
+				return vqadd_u8(s, d);
+		}
+	}
+
+	template <FREE_IMAGE_ALPHA_OPERATION op>
+	unsigned BlendRow_NEON(FIRGBA8 *dst, const FIRGBA8 *src, unsigned width) {
+		unsigned x = 0;
+		for (; x + 8 <= width; x += 8) {
+			const uint8x8x4_t s = vld4_u8((const uint8_t *)(src + x));
+			uint8x8x4_t d = vld4_u8((const uint8_t *)(dst + x));
+			const uint8x8_t sa = s.val[FI_RGBA_ALPHA];
+			const uint8x8_t da = d.val[FI_RGBA_ALPHA];
+			d.val[FI_RGBA_RED] = Blend_NEON<op>(s.val[FI_RGBA_RED], d.val[FI_RGBA_RED], sa, da);
+			d.val[FI_RGBA_GREEN] = Blend_NEON<op>(s.val[FI_RGBA_GREEN], d.val[FI_RGBA_GREEN], sa, da);
+			d.val[FI_RGBA_BLUE] = Blend_NEON<op>(s.val[FI_RGBA_BLUE], d.val[FI_RGBA_BLUE], sa, da);
+			if (op != FIAO_SrcAlpha) {
+				d.val[FI_RGBA_ALPHA] = Blend_NEON<op>(sa, da, sa, da);
+			}
+			vst4_u8((uint8_t *)(dst + x), d);
+		}
+		return x;
+	}
+#endif // FREEIMAGE_SIMD_NEON
 
+	constexpr unsigned kAlphaOperations = FIAO_Add + 1;
 
-FIBOOL FreeImage_DrawBitmap(FIBITMAP* dst, FIBITMAP* src, FREE_IMAGE_ALPHA_OPERATION alpha, int32_t left, int32_t top)
+	struct BlendKernels {
+		std::atomic<BlendRowKernel> row[kAlphaOperations];
+	};
+
+	BlendKernels gBlendKernels{ { { NoBlend }, { NoBlend }, { NoBlend }, { NoBlend }, { NoBlend } } };
+
+	void SelectBlendKernels(unsigned features) {
+		BlendRowKernel kernels[kAlphaOperations] = { NoBlend, NoBlend, NoBlend, NoBlend, NoBlend };
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			kernels[FIAO_SrcAlpha] = BlendRow_SSE2<FIAO_SrcAlpha>;
+			kernels[FIAO_SrcOver] = BlendRow_SSE2<FIAO_SrcOver>;
+			kernels[FIAO_Multiply] = BlendRow_SSE2<FIAO_Multiply>;
+			kernels[FIAO_Screen] = BlendRow_SSE2<FIAO_Screen>;
+			kernels[FIAO_Add] = BlendRow_SSE2<FIAO_Add>;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			kernels[FIAO_SrcAlpha] = BlendRow_NEON<FIAO_SrcAlpha>;
+			kernels[FIAO_SrcOver] = BlendRow_NEON<FIAO_SrcOver>;
+			kernels[FIAO_Multiply] = BlendRow_NEON<FIAO_Multiply>;
+			kernels[FIAO_Screen] = BlendRow_NEON<FIAO_Screen>;
+			kernels[FIAO_Add] = BlendRow_NEON<FIAO_Add>;
+		}
+#endif
+		for (unsigned op = 0; op < kAlphaOperations; op++) {
+			gBlendKernels.row[op].store(kernels[op], std::memory_order_relaxed);
+		}
+	}
+
+	const CPUDispatchRegistrar gBlendRegistrar(SelectBlendKernels);
+
+	template <FREE_IMAGE_ALPHA_OPERATION op>
+	void BlendRow8(FIRGBA8 *dst, const FIRGBA8 *src, unsigned width) {
+		const unsigned done = gBlendKernels.row[op].load(std::memory_order_relaxed)(dst, src, width);
+		BlendRow<op>(dst + done, src + done, width - done);
+	}
+
+	// float channels, results are not clamped so that HDR values survive
+
+	template <FREE_IMAGE_ALPHA_OPERATION op>
+	void BlendRowF(FIRGBAF *dst, const FIRGBAF *src, unsigned width) {
+		for (unsigned x = 0; x < width; x++) {
+			FIRGBAF &d = dst[x];
+			const FIRGBAF &s = src[x];
+			const float sa = s.alpha;
+			const float da = d.alpha;
+			auto blend = [&](float &dc, float sc) {
+				switch (op) {
+					case FIAO_SrcAlpha:
+						dc = sc * sa + dc * (1 - sa);
+						break;
+					case FIAO_SrcOver:
+						dc = sc + dc * (1 - sa);
+						break;
+					case FIAO_Multiply:
+						dc = sc * dc + sc * (1 - da) + dc * (1 - sa);
+						break;
+					case FIAO_Screen:
+						dc = sc + dc - sc * dc;
+						break;
+					default:
+						dc = sc + dc;
+						break;
+				}
+			};
+			blend(d.red, s.red);
+			blend(d.green, s.green);
+			blend(d.blue, s.blue);
+			if (op != FIAO_SrcAlpha) {
+				blend(d.alpha, s.alpha);
+			}
+		}
+	}
+
+	using BlendRowFunction8 = void (*)(FIRGBA8 *dst, const FIRGBA8 *src, unsigned width);
+	using BlendRowFunctionF = void (*)(FIRGBAF *dst, const FIRGBAF *src, unsigned width);
+
+	template <typename Function>
+	Function SelectOperation(FREE_IMAGE_ALPHA_OPERATION alpha, Function srcAlpha, Function srcOver, Function multiply, Function screen, Function add) {
+		switch (alpha) {
+			case FIAO_SrcAlpha: return srcAlpha;
+			case FIAO_SrcOver: return srcOver;
+			case FIAO_Multiply: return multiply;
+			case FIAO_Screen: return screen;
+			case FIAO_Add: return add;
+			default: return nullptr;
+		}
+	}
+
+} // namespace
+
+/**
+Draws src over dst at (left, top), src is clipped to dst.
+32-bit FIT_BITMAP, FIT_RGBAF and FIT_RGBAH images are supported, src and dst must have the same type.
+FIAO_SrcAlpha blends straight colors and keeps the alpha of dst, other operations expect premultiplied colors.
+Rows are blended by parallel bands.
+*/
+FIBOOL DLL_CALLCONV
+FreeImage_DrawBitmap(FIBITMAP* dst, FIBITMAP* src, FREE_IMAGE_ALPHA_OPERATION alpha, int32_t left, int32_t top)
 {
 	if (!FreeImage_HasPixels(dst) || !FreeImage_HasPixels(src)) {
 		return FALSE;
 	}
 
-	if (FreeImage_GetImageType(dst) != FIT_BITMAP || FreeImage_GetColorType2(dst) != FIC_RGBALPHA || FreeImage_GetBPP(dst) != 32 ||
-			FreeImage_GetImageType(src) != FIT_BITMAP || FreeImage_GetColorType2(src) != FIC_RGBALPHA || FreeImage_GetBPP(src) != 32) {
+	const FREE_IMAGE_TYPE type = FreeImage_GetImageType(dst);
+	if (type != FreeImage_GetImageType(src)) {
+		return FALSE;
+	}
+	if (type == FIT_BITMAP) {
+		if (FreeImage_GetColorType2(dst) != FIC_RGBALPHA || FreeImage_GetBPP(dst) != 32 ||
+				FreeImage_GetColorType2(src) != FIC_RGBALPHA || FreeImage_GetBPP(src) != 32) {
+			return FALSE;
+		}
+	}
+	else if ((type != FIT_RGBAF) && (type != FIT_RGBAH)) {
+		return FALSE;
+	}
+
+	const BlendRowFunction8 blend8 = SelectOperation<BlendRowFunction8>(alpha, BlendRow8<FIAO_SrcAlpha>, BlendRow8<FIAO_SrcOver>, BlendRow8<FIAO_Multiply>, BlendRow8<FIAO_Screen>, BlendRow8<FIAO_Add>);
+	const BlendRowFunctionF blendF = SelectOperation<BlendRowFunctionF>(alpha, BlendRowF<FIAO_SrcAlpha>, BlendRowF<FIAO_SrcOver>, BlendRowF<FIAO_Multiply>, BlendRowF<FIAO_Screen>, BlendRowF<FIAO_Add>);
+	if (!blend8 || !blendF) {
+		// not supported
 		return FALSE;
 	}
 
@@ -255,33 +811,45 @@ FIBOOL FreeImage_DrawBitmap(FIBITMAP* dst, FIBITMAP* src, FREE_IMAGE_ALPHA_OPERA
 	const int32_t roiRight  = std::min(left + srcW, dstW);
 	const int32_t roiBottom = std::min(top + srcH, dstH);
 
-	const int32_t offsetX = roiLeft - left;
-	const int32_t offsetY = roiTop - top;
-
-	if (alpha != FIAO_SrcAlpha) {
-		// not supported
-		return FALSE;
+	if ((roiRight <= roiLeft) || (roiBottom <= roiTop)) {
+		return TRUE;
 	}
 
-	// Y axis is flipped in FI
-	for (int32_t y = roiBottom - roiTop; y > 0; --y) {
-		const auto srcLine = static_cast<const FIRGBA8*>(static_cast<const void*>(FreeImage_GetScanLine(src, srcH - y - offsetY))) + offsetX;
-		const auto dstLine = static_cast<FIRGBA8*>(static_cast<void*>(FreeImage_GetScanLine(dst, dstH - roiTop - y))) + roiLeft;
-		for (int32_t x = 0; x < roiRight - roiLeft; ++x) {
-			const uint8_t alpha = srcLine[x].alpha;
-			if (alpha == 255) {
-				dstLine[x].red   = srcLine[x].red;
-				dstLine[x].green = srcLine[x].green;
-				dstLine[x].blue  = srcLine[x].blue;
+	const int32_t offsetX = roiLeft - left;
+	const int32_t offsetY = roiTop - top;
+	const unsigned width = static_cast<unsigned>(roiRight - roiLeft);
+	const unsigned bytespp = FreeImage_GetBPP(dst) / 8;
+
+	// Y axis is flipped in FI: row y of the ROI is scanline dstH - roiTop - 1 - y of dst
+	const uint8_t *src_bits = FreeImage_GetConstBits(src);
+	uint8_t *dst_bits = FreeImage_GetBits(dst);
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	const unsigned dst_pitch = FreeImage_GetPitch(dst);
+	auto srcLine = [&](unsigned y) { return src_bits + (size_t)src_pitch * (srcH - 1 - offsetY - y) + (size_t)offsetX * bytespp; };
+	auto dstLine = [&](unsigned y) { return dst_bits + (size_t)dst_pitch * (dstH - 1 - roiTop - y) + (size_t)roiLeft * bytespp; };
+
+	ParallelFor(0, static_cast<unsigned>(roiBottom - roiTop), CalculateBandRows((size_t)width * bytespp), [&](unsigned first, unsigned last) {
+		if (type == FIT_BITMAP) {
+			for (unsigned y = first; y < last; y++) {
+				blend8(reinterpret_cast<FIRGBA8 *>(dstLine(y)), reinterpret_cast<const FIRGBA8 *>(srcLine(y)), width);
 			}
-			else if (alpha > 0) {
-				const uint8_t notAlpha = ~alpha;
-				dstLine[x].red   = static_cast<uint8_t>((alpha * srcLine[x].red   + notAlpha * dstLine[x].red)   / 255);
-				dstLine[x].green = static_cast<uint8_t>((alpha * srcLine[x].green + notAlpha * dstLine[x].green) / 255);
-				dstLine[x].blue  = static_cast<uint8_t>((alpha * srcLine[x].blue  + notAlpha * dstLine[x].blue)  / 255);
+		}
+		else if (type == FIT_RGBAF) {
+			for (unsigned y = first; y < last; y++) {
+				blendF(reinterpret_cast<FIRGBAF *>(dstLine(y)), reinterpret_cast<const FIRGBAF *>(srcLine(y)), width);
 			}
 		}
-	}
+		else {
+			// half floats are blended as floats
+			std::vector<FIRGBAF> s(width), d(width);
+			for (unsigned y = first; y < last; y++) {
+				ConvertHalfToFloat(&s[0].red, reinterpret_cast<const uint16_t *>(srcLine(y)), width * 4);
+				ConvertHalfToFloat(&d[0].red, reinterpret_cast<const uint16_t *>(dstLine(y)), width * 4);
+				blendF(d.data(), s.data(), width);
+				ConvertFloatToHalf(reinterpret_cast<uint16_t *>(dstLine(y)), &d[0].red, width * 4);
+			}
+		}
+	});
 
 	return TRUE;
 }
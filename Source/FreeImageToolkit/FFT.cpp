@@ -0,0 +1,408 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "FFT.h"
+#include "../FreeImage/CPUDispatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <list>
+#include <mutex>
+
+namespace {
+
+	using Complex = FFTPlan::Complex;
+
+	constexpr double kPi = 3.14159265358979323846;
+
+	/// Number of plans kept by FFTPlan::Get
+	const size_t kCachedPlans = 16;
+
+	/// Columns gathered together by the column passes of the 2D transforms
+	const unsigned kColumnBlock = 8;
+
+	// ----------------------------------------------------------
+	//  Butterfly kernels
+	// ----------------------------------------------------------
+
+	/**
+	Runs one stage of a radix-2 transform of n elements on blocks of 2 * half elements:
+	for j < half, t = data[j + half] * w[j * step], data[j + half] = data[j] - t, data[j] += t, w conjugated by inverse transforms.
+	Complex products use separate multiplies and adds, the vector kernels match the scalar one.
+	*/
+	using StageKernel = void (*)(Complex *data, unsigned n, unsigned half, const Complex *twiddles, unsigned step, bool inverse);
+
+	void StageScalar(Complex *data, unsigned n, unsigned half, const Complex *twiddles, unsigned step, bool inverse) {
+		double *d = reinterpret_cast<double *>(data);
+		const double *w = reinterpret_cast<const double *>(twiddles);
+		const double sign = inverse ? -1.0 : 1.0;
+		for (unsigned start = 0; start < n; start += 2 * half) {
+			double *lo = d + 2 * (size_t)start, *hi = lo + 2 * (size_t)half;
+			for (unsigned j = 0; j < half; j++) {
+				const double wr = w[2 * (size_t)j * step], wi = sign * w[2 * (size_t)j * step + 1];
+				const double br = hi[2 * j], bi = hi[2 * j + 1];
+				const double tr = br * wr + -(bi * wi);
+				const double ti = bi * wr + br * wi;
+				const double ar = lo[2 * j], ai = lo[2 * j + 1];
+				hi[2 * j] = ar - tr;
+				hi[2 * j + 1] = ai - ti;
+				lo[2 * j] = ar + tr;
+				lo[2 * j + 1] = ai + ti;
+			}
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+	void Stage_SSE2(Complex *data, unsigned n, unsigned half, const Complex *twiddles, unsigned step, bool inverse) {
+		double *d = reinterpret_cast<double *>(data);
+		const double *w = reinterpret_cast<const double *>(twiddles);
+		// negates the real lane of the swapped product, and the imaginary lane of the twiddles of inverse transforms
+		const __m128d negate_re = _mm_set_pd(0.0, -0.0);
+		const __m128d conjugate = inverse ? _mm_set_pd(-0.0, 0.0) : _mm_setzero_pd();
+		for (unsigned start = 0; start < n; start += 2 * half) {
+			double *lo = d + 2 * (size_t)start, *hi = lo + 2 * (size_t)half;
+			for (unsigned j = 0; j < half; j++) {
+				const __m128d tw = _mm_xor_pd(_mm_loadu_pd(w + 2 * (size_t)j * step), conjugate);
+				const __m128d b = _mm_loadu_pd(hi + 2 * j);
+				const __m128d real = _mm_mul_pd(b, _mm_unpacklo_pd(tw, tw));
+				const __m128d imag = _mm_xor_pd(_mm_mul_pd(_mm_shuffle_pd(b, b, 1), _mm_unpackhi_pd(tw, tw)), negate_re);
+				const __m128d t = _mm_add_pd(real, imag);
+				const __m128d a = _mm_loadu_pd(lo + 2 * j);
+				_mm_storeu_pd(hi + 2 * j, _mm_sub_pd(a, t));
+				_mm_storeu_pd(lo + 2 * j, _mm_add_pd(a, t));
+			}
+		}
+	}
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+	void Stage_NEON(Complex *data, unsigned n, unsigned half, const Complex *twiddles, unsigned step, bool inverse) {
+		double *d = reinterpret_cast<double *>(data);
+		const double *w = reinterpret_cast<const double *>(twiddles);
+		const double signs[2] = { -1.0, 1.0 };
+		const float64x2_t negate_re = vld1q_f64(signs);
+		const double sign = inverse ? -1.0 : 1.0;
+		for (unsigned start = 0; start < n; start += 2 * half) {
+			double *lo = d + 2 * (size_t)start, *hi = lo + 2 * (size_t)half;
+			for (unsigned j = 0; j < half; j++) {
+				const float64x2_t wr = vdupq_n_f64(w[2 * (size_t)j * step]);
+				const float64x2_t wi = vdupq_n_f64(sign * w[2 * (size_t)j * step + 1]);
+				const float64x2_t b = vld1q_f64(hi + 2 * j);
+				const float64x2_t real = vmulq_f64(b, wr);
+				const float64x2_t imag = vmulq_f64(vmulq_f64(vextq_f64(b, b, 1), wi), negate_re);
+				const float64x2_t t = vaddq_f64(real, imag);
+				const float64x2_t a = vld1q_f64(lo + 2 * j);
+				vst1q_f64(hi + 2 * j, vsubq_f64(a, t));
+				vst1q_f64(lo + 2 * j, vaddq_f64(a, t));
+			}
+		}
+	}
+#endif // FREEIMAGE_SIMD_NEON
+
+	std::atomic<StageKernel> gStage{ StageScalar };
+
+	void SelectFFTKernels(uint32_t features) {
+		StageKernel stage = StageScalar;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			stage = Stage_SSE2;
+		}
+#elif FREEIMAGE_SIMD_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+		if (features & FI_CPU_NEON) {
+			stage = Stage_NEON;
+		}
+#endif
+		gStage.store(stage, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectFFTKernels);
+
+	// ----------------------------------------------------------
+	//  2D transforms
+	// ----------------------------------------------------------
+
+	template <typename T>
+	void ReadReal(Complex *dst, const uint8_t *src, unsigned width) {
+		const T *p = reinterpret_cast<const T *>(src);
+		for (unsigned x = 0; x < width; x++) {
+			dst[x] = Complex((double)p[x], 0);
+		}
+	}
+
+	template <typename T>
+	void ReadComplex(Complex *dst, const uint8_t *src, unsigned width) {
+		const T *p = reinterpret_cast<const T *>(src);
+		for (unsigned x = 0; x < width; x++) {
+			dst[x] = Complex((double)p[2 * x], (double)p[2 * x + 1]);
+		}
+	}
+
+	using ReadRow = void (*)(Complex *dst, const uint8_t *src, unsigned width);
+
+	ReadRow GetReader(FIBITMAP *dib) {
+		switch (FreeImage_GetImageType(dib)) {
+			case FIT_BITMAP:
+				return ((FreeImage_GetBPP(dib) == 8) && (FreeImage_GetColorType(dib) == FIC_MINISBLACK)) ? ReadReal<uint8_t> : nullptr;
+			case FIT_UINT16:
+				return ReadReal<uint16_t>;
+			case FIT_INT16:
+				return ReadReal<int16_t>;
+			case FIT_UINT32:
+				return ReadReal<uint32_t>;
+			case FIT_INT32:
+				return ReadReal<int32_t>;
+			case FIT_FLOAT:
+				return ReadReal<float>;
+			case FIT_DOUBLE:
+				return ReadReal<double>;
+			case FIT_COMPLEX:
+				return ReadComplex<double>;
+			case FIT_COMPLEXF:
+				return ReadComplex<float>;
+			default:
+				return nullptr;
+		}
+	}
+
+	/**
+	Transforms src into a new complex image of type dst_type.
+	Rows are transformed by parallel bands, then columns by parallel bands of kColumnBlock columns gathered together.
+	Inverse transforms are divided by the number of pixels.
+	*/
+	FIBITMAP *Transform2D(FIBITMAP *src, ReadRow read, FREE_IMAGE_TYPE dst_type, bool inverse) {
+		const unsigned width = FreeImage_GetWidth(src);
+		const unsigned height = FreeImage_GetHeight(src);
+
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dst(FreeImage_AllocateT(dst_type, width, height), &FreeImage_Unload);
+		if (!dst) {
+			return nullptr;
+		}
+
+		try {
+			const std::shared_ptr<const FFTPlan> row_plan = FFTPlan::Get(width);
+			const std::shared_ptr<const FFTPlan> column_plan = FFTPlan::Get(height);
+			std::vector<Complex> data((size_t)width * height);
+			Complex *values = data.data();
+
+			const unsigned src_pitch = FreeImage_GetPitch(src);
+			const uint8_t *src_bits = FreeImage_GetConstBits(src);
+
+			ParallelFor(0, height, CalculateBandRows((size_t)width * sizeof(Complex)), [&](unsigned first, unsigned last) {
+				std::vector<Complex> scratch(row_plan->GetScratchSize());
+				for (unsigned y = first; y < last; y++) {
+					Complex *line = values + (size_t)width * y;
+					read(line, src_bits + (size_t)src_pitch * y, width);
+					row_plan->Transform(line, inverse, scratch.data());
+				}
+			});
+
+			const unsigned blocks = (width + kColumnBlock - 1) / kColumnBlock;
+			ParallelFor(0, blocks, std::max(1U, CalculateBandRows((size_t)height * kColumnBlock * sizeof(Complex))), [&](unsigned first, unsigned last) {
+				std::vector<Complex> scratch(column_plan->GetScratchSize());
+				std::vector<Complex> columns((size_t)height * kColumnBlock);
+				for (unsigned block = first; block < last; block++) {
+					const unsigned x0 = block * kColumnBlock;
+					const unsigned count = std::min(kColumnBlock, width - x0);
+					for (unsigned y = 0; y < height; y++) {
+						const Complex *line = values + (size_t)width * y + x0;
+						for (unsigned c = 0; c < count; c++) {
+							columns[(size_t)height * c + y] = line[c];
+						}
+					}
+					for (unsigned c = 0; c < count; c++) {
+						column_plan->Transform(columns.data() + (size_t)height * c, inverse, scratch.data());
+					}
+					for (unsigned y = 0; y < height; y++) {
+						Complex *line = values + (size_t)width * y + x0;
+						for (unsigned c = 0; c < count; c++) {
+							line[c] = columns[(size_t)height * c + y];
+						}
+					}
+				}
+			});
+
+			const double scale = inverse ? 1.0 / ((double)width * height) : 1.0;
+			const unsigned dst_pitch = FreeImage_GetPitch(dst.get());
+			uint8_t *dst_bits = FreeImage_GetBits(dst.get());
+			ParallelFor(0, height, CalculateBandRows((size_t)width * sizeof(Complex)), [&](unsigned first, unsigned last) {
+				for (unsigned y = first; y < last; y++) {
+					const Complex *line = values + (size_t)width * y;
+					if (dst_type == FIT_COMPLEX) {
+						auto *out = reinterpret_cast<FICOMPLEX *>(dst_bits + (size_t)dst_pitch * y);
+						for (unsigned x = 0; x < width; x++) {
+							out[x].r = line[x].real() * scale;
+							out[x].i = line[x].imag() * scale;
+						}
+					} else {
+						auto *out = reinterpret_cast<FICOMPLEXF *>(dst_bits + (size_t)dst_pitch * y);
+						for (unsigned x = 0; x < width; x++) {
+							out[x].r = (float)(line[x].real() * scale);
+							out[x].i = (float)(line[x].imag() * scale);
+						}
+					}
+				}
+			});
+		} catch (const std::bad_alloc &) {
+			return nullptr;
+		}
+
+		return dst.release();
+	}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+//  FFTPlan
+// --------------------------------------------------------------------------
+
+FFTPlan::FFTPlan(unsigned n)
+: mSize(n) {
+	if ((n & (n - 1)) == 0) {
+		InitRadix2(n);
+	} else {
+		unsigned m = 1;
+		while (m < 2 * n - 1) {
+			m <<= 1;
+		}
+		mConvolution = std::make_unique<FFTPlan>(m);
+		// chirp w[k] = exp(-i pi k^2 / n), k^2 is reduced modulo 2n to keep the angle accurate
+		mChirp.resize(n);
+		for (unsigned k = 0; k < n; k++) {
+			const uint64_t k2 = ((uint64_t)k * k) % (2 * (uint64_t)n);
+			mChirp[k] = std::polar(1.0, -kPi * (double)k2 / n);
+		}
+		// transform of the conjugate chirp, wrapped around for negative indices
+		mChirpSpectrum.assign(m, Complex(0, 0));
+		mChirpSpectrum[0] = std::conj(mChirp[0]);
+		for (unsigned k = 1; k < n; k++) {
+			mChirpSpectrum[k] = mChirpSpectrum[m - k] = std::conj(mChirp[k]);
+		}
+		mConvolution->Radix2(mChirpSpectrum.data(), false);
+	}
+}
+
+std::shared_ptr<const FFTPlan>
+FFTPlan::Get(unsigned n) {
+	static std::mutex s_mutex;
+	static std::list<std::shared_ptr<const FFTPlan>> s_plans;	// most recently used first
+
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for (auto it = s_plans.begin(); it != s_plans.end(); ++it) {
+			if ((*it)->GetSize() == n) {
+				s_plans.splice(s_plans.begin(), s_plans, it);
+				return s_plans.front();
+			}
+		}
+	}
+
+	// plans are built outside of the lock, concurrent builds of one size keep the first one cached
+	auto plan = std::make_shared<const FFTPlan>(n);
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_plans.push_front(plan);
+	if (s_plans.size() > kCachedPlans) {
+		s_plans.pop_back();
+	}
+	return plan;
+}
+
+void
+FFTPlan::Transform(Complex *data, bool inverse, Complex *scratch) const {
+	if (!mConvolution) {
+		Radix2(data, inverse);
+		return;
+	}
+	// an inverse transform is the conjugate of the forward transform of the conjugate
+	const unsigned m = mConvolution->mSize;
+	for (unsigned k = 0; k < mSize; k++) {
+		scratch[k] = (inverse ? std::conj(data[k]) : data[k]) * mChirp[k];
+	}
+	std::fill(scratch + mSize, scratch + m, Complex(0, 0));
+	mConvolution->Radix2(scratch, false);
+	for (unsigned k = 0; k < m; k++) {
+		scratch[k] = std::conj(scratch[k] * mChirpSpectrum[k]);
+	}
+	mConvolution->Radix2(scratch, false);
+	const double scale = 1.0 / m;
+	for (unsigned k = 0; k < mSize; k++) {
+		const Complex value = std::conj(scratch[k]) * scale * mChirp[k];
+		data[k] = inverse ? std::conj(value) : value;
+	}
+}
+
+void
+FFTPlan::InitRadix2(unsigned n) {
+	mReverse.resize(n);
+	unsigned bits = 0;
+	while ((1u << bits) < n) {
+		bits++;
+	}
+	for (unsigned k = 0; k < n; k++) {
+		unsigned r = 0;
+		for (unsigned b = 0; b < bits; b++) {
+			r |= ((k >> b) & 1) << (bits - 1 - b);
+		}
+		mReverse[k] = r;
+	}
+	mTwiddles.resize(n / 2);
+	for (unsigned k = 0; k < n / 2; k++) {
+		mTwiddles[k] = std::polar(1.0, -2.0 * kPi * k / n);
+	}
+}
+
+void
+FFTPlan::Radix2(Complex *data, bool inverse) const {
+	const unsigned n = mSize;
+	for (unsigned k = 0; k < n; k++) {
+		if (k < mReverse[k]) {
+			std::swap(data[k], data[mReverse[k]]);
+		}
+	}
+	const StageKernel stage = gStage.load(std::memory_order_relaxed);
+	for (unsigned len = 2; len <= n; len <<= 1) {
+		stage(data, n, len / 2, mTwiddles.data(), n / len, inverse);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+/**
+Computes the 2D discrete Fourier transform of a greyscale, integer, float or complex image.
+@param src Source image
+@return Returns a FIT_COMPLEXF image for FIT_FLOAT and FIT_COMPLEXF sources, a FIT_COMPLEX image otherwise, NULL on failure
+*/
+FIBITMAP* DLL_CALLCONV
+FreeImage_FFT2D(FIBITMAP *src) {
+	if (!FreeImage_HasPixels(src)) {
+		return nullptr;
+	}
+	const ReadRow read = GetReader(src);
+	if (!read) {
+		return nullptr;
+	}
+	const FREE_IMAGE_TYPE type = FreeImage_GetImageType(src);
+	return Transform2D(src, read, ((type == FIT_FLOAT) || (type == FIT_COMPLEXF)) ? FIT_COMPLEXF : FIT_COMPLEX, false);
+}
+
+/**
+Computes the inverse 2D discrete Fourier transform of a complex image, divided by the number of pixels.
+@param src Source image of type FIT_COMPLEX or FIT_COMPLEXF
+@return Returns an image of the type of src, NULL on failure
+*/
+FIBITMAP* DLL_CALLCONV
+FreeImage_IFFT2D(FIBITMAP *src) {
+	if (!FreeImage_HasPixels(src)) {
+		return nullptr;
+	}
+	const FREE_IMAGE_TYPE type = FreeImage_GetImageType(src);
+	if ((type != FIT_COMPLEX) && (type != FIT_COMPLEXF)) {
+		return nullptr;
+	}
+	return Transform2D(src, GetReader(src), type, true);
+}
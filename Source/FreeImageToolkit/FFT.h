@@ -0,0 +1,59 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_FFT_H
+#define FREEIMAGE_FFT_H
+
+#include <complex>
+#include <memory>
+#include <vector>
+
+/**
+Complex discrete Fourier transform of any length, in double precision.
+Powers of two use an iterative radix-2 transform with SIMD butterflies, other lengths the Bluestein algorithm
+(a chirp convolution computed by a radix-2 transform of at least 2n - 1 elements).
+A plan is read-only once built, threads share it and provide their own scratch buffers.
+*/
+class FFTPlan
+{
+public:
+	using Complex = std::complex<double>;
+
+	explicit FFTPlan(unsigned n);
+
+	/**
+	Returns the plan of length n from a cache of the recently used plans, building it if needed.
+	Throws std::bad_alloc.
+	*/
+	static std::shared_ptr<const FFTPlan> Get(unsigned n);
+
+	unsigned GetSize() const {
+		return mSize;
+	}
+
+	/// Number of scratch elements needed by Transform
+	size_t GetScratchSize() const {
+		return mConvolution ? mConvolution->mSize : 0;
+	}
+
+	/**
+	In-place transform, X[k] = sum x[j] exp(-+2 i pi jk / n), not normalized.
+	*/
+	void Transform(Complex *data, bool inverse, Complex *scratch) const;
+
+private:
+	void InitRadix2(unsigned n);
+	void Radix2(Complex *data, bool inverse) const;
+
+	unsigned mSize;
+	std::vector<unsigned> mReverse;
+	std::vector<Complex> mTwiddles;				// exp(-2 i pi k / n), k < n / 2
+	std::unique_ptr<FFTPlan> mConvolution;		// Bluestein only
+	std::vector<Complex> mChirp;
+	std::vector<Complex> mChirpSpectrum;
+};
+
+#endif // FREEIMAGE_FFT_H
@@ -23,9 +23,319 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "../FreeImage/CPUDispatch.h"
+
+#include <array>
+
+// --------------------------------------------------------------------------
+// In-place mirroring of scanlines
+
+namespace {
+
+	/// Mirrors the outer pixels of a row in place and returns the number of pixels swapped at each end
+	using MirrorKernel = unsigned (*)(uint8_t *bits, unsigned width);
+
+	unsigned NoMirror(uint8_t *, unsigned) {
+		return 0;
+	}
+
+	/// Swaps pixels x and width - 1 - x for x in [first .. width / 2)
+	template <unsigned bytespp>
+	void MirrorPixels(uint8_t *bits, unsigned width, unsigned first) {
+		uint8_t *left = bits + static_cast<size_t>(first) * bytespp;
+		uint8_t *right = bits + static_cast<size_t>(width - 1 - first) * bytespp;
+		uint8_t pixel[bytespp];
+		for (; left < right; left += bytespp, right -= bytespp) {
+			memcpy(pixel, left, bytespp);
+			memcpy(left, right, bytespp);
+			memcpy(right, pixel, bytespp);
+		}
+	}
+
+	constexpr uint8_t ReverseBitsOf(unsigned value) {
+		uint8_t result = 0;
+		for (unsigned bit = 0; bit < 8; bit++) {
+			result |= static_cast<uint8_t>(((value >> bit) & 1) << (7 - bit));
+		}
+		return result;
+	}
+
+	constexpr std::array<uint8_t, 256> MakeReverseTable(bool nibbles) {
+		std::array<uint8_t, 256> table{};
+		for (unsigned i = 0; i < 256; i++) {
+			table[i] = nibbles ? static_cast<uint8_t>((i << 4) | (i >> 4)) : ReverseBitsOf(i);
+		}
+		return table;
+	}
+
+	/// Bit order and nibble order reversal of a byte
+	constexpr std::array<uint8_t, 256> kReverseBits = MakeReverseTable(false);
+	constexpr std::array<uint8_t, 256> kReverseNibbles = MakeReverseTable(true);
+
+	/**
+	Mirrors a row of 1- or 4-bit pixels: bytes are swapped end for end through a reversal table,
+	then the row is shifted left by the unused bits of its last byte.
+	*/
+	void MirrorPackedPixels(uint8_t *bits, unsigned width, unsigned bpp) {
+		const std::array<uint8_t, 256> &table = (bpp == 1) ? kReverseBits : kReverseNibbles;
+		const unsigned line = (width * bpp + 7) / 8;
+		uint8_t *left = bits;
+		uint8_t *right = bits + line - 1;
+		for (; left < right; left++, right--) {
+			const uint8_t value = table[*left];
+			*left = table[*right];
+			*right = value;
+		}
+		if (left == right) {
+			*left = table[*left];
+		}
+		const unsigned shift = line * 8 - width * bpp;
+		if (shift) {
+			for (unsigned c = 0; c + 1 < line; c++) {
+				bits[c] = static_cast<uint8_t>((bits[c] << shift) | (bits[c + 1] >> (8 - shift)));
+			}
+			bits[line - 1] = static_cast<uint8_t>(bits[line - 1] << shift);
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+
+	// a register from each end of the row is reversed and stored at the other end, as long as both stay apart
+
+	inline __m128i Reverse16x16(__m128i v) {
+		v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	}
+
+	struct Reverse8x16 {
+		__m128i operator()(__m128i v) const {
+			v = Reverse16x16(v);
+			return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		}
+	};
+
+	struct Reverse16x8 {
+		__m128i operator()(__m128i v) const {
+			return Reverse16x16(v);
+		}
+	};
+
+	struct Reverse32x4 {
+		__m128i operator()(__m128i v) const {
+			return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+		}
+	};
+
+	struct Reverse64x2 {
+		__m128i operator()(__m128i v) const {
+			return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+		}
+	};
+
+	template <unsigned bytespp, class Reverse>
+	unsigned Mirror_SSE2(uint8_t *bits, unsigned width) {
+		const Reverse reverse;
+		uint8_t *left = bits;
+		uint8_t *right = bits + static_cast<size_t>(width) * bytespp;
+		unsigned count = 0;
+		for (; left + 32 <= right; left += 16, right -= 16, count += 16 / bytespp) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(left));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(right - 16));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(left), reverse(b));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(right - 16), reverse(a));
+		}
+		return count;
+	}
+
+	/**
+	24- and 48-bit pixels: a block of 5 (resp. 2) pixels fills 15 (resp. 12) bytes of a register.
+	The bytes of a register beyond the block belong to pixels not yet mirrored and are stored back unchanged.
+	*/
+	FI_TARGET("ssse3")
+	unsigned Mirror24_SSSE3(uint8_t *bits, unsigned width) {
+		const __m128i from_right = _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -128);
+		const __m128i keep_left = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 15);
+		const __m128i from_left = _mm_setr_epi8(-128, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2);
+		const __m128i keep_right = _mm_setr_epi8(0, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+		uint8_t *left = bits;
+		uint8_t *right = bits + static_cast<size_t>(width) * 3;
+		unsigned count = 0;
+		for (; left + 32 <= right; left += 15, right -= 15, count += 5) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(left));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(right - 16));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(left), _mm_or_si128(_mm_shuffle_epi8(b, from_right), _mm_shuffle_epi8(a, keep_left)));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(right - 16), _mm_or_si128(_mm_shuffle_epi8(a, from_left), _mm_shuffle_epi8(b, keep_right)));
+		}
+		return count;
+	}
+
+	FI_TARGET("ssse3")
+	unsigned Mirror48_SSSE3(uint8_t *bits, unsigned width) {
+		const __m128i from_right = _mm_setr_epi8(10, 11, 12, 13, 14, 15, 4, 5, 6, 7, 8, 9, -128, -128, -128, -128);
+		const __m128i keep_left = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 12, 13, 14, 15);
+		const __m128i from_left = _mm_setr_epi8(-128, -128, -128, -128, 6, 7, 8, 9, 10, 11, 0, 1, 2, 3, 4, 5);
+		const __m128i keep_right = _mm_setr_epi8(0, 1, 2, 3, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+		uint8_t *left = bits;
+		uint8_t *right = bits + static_cast<size_t>(width) * 6;
+		unsigned count = 0;
+		for (; left + 32 <= right; left += 12, right -= 12, count += 2) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(left));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(right - 16));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(left), _mm_or_si128(_mm_shuffle_epi8(b, from_right), _mm_shuffle_epi8(a, keep_left)));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(right - 16), _mm_or_si128(_mm_shuffle_epi8(a, from_left), _mm_shuffle_epi8(b, keep_right)));
+		}
+		return count;
+	}
+
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+
+	struct Reverse8x16 {
+		uint8x16_t operator()(uint8x16_t v) const {
+			v = vrev64q_u8(v);
+			return vextq_u8(v, v, 8);
+		}
+	};
+
+	struct Reverse16x8 {
+		uint8x16_t operator()(uint8x16_t v) const {
+			v = vreinterpretq_u8_u16(vrev64q_u16(vreinterpretq_u16_u8(v)));
+			return vextq_u8(v, v, 8);
+		}
+	};
+
+	struct Reverse32x4 {
+		uint8x16_t operator()(uint8x16_t v) const {
+			v = vreinterpretq_u8_u32(vrev64q_u32(vreinterpretq_u32_u8(v)));
+			return vextq_u8(v, v, 8);
+		}
+	};
+
+	struct Reverse64x2 {
+		uint8x16_t operator()(uint8x16_t v) const {
+			return vextq_u8(v, v, 8);
+		}
+	};
+
+	template <unsigned bytespp, class Reverse>
+	unsigned Mirror_NEON(uint8_t *bits, unsigned width) {
+		const Reverse reverse;
+		uint8_t *left = bits;
+		uint8_t *right = bits + static_cast<size_t>(width) * bytespp;
+		unsigned count = 0;
+		for (; left + 32 <= right; left += 16, right -= 16, count += 16 / bytespp) {
+			const uint8x16_t a = vld1q_u8(left);
+			const uint8x16_t b = vld1q_u8(right - 16);
+			vst1q_u8(left, reverse(b));
+			vst1q_u8(right - 16, reverse(a));
+		}
+		return count;
+	}
+
+	/// 24- and 48-bit pixels are deinterleaved by channel, each channel holds 8 (resp. 4) pixels
+	unsigned Mirror24_NEON(uint8_t *bits, unsigned width) {
+		uint8_t *left = bits;
+		uint8_t *right = bits + static_cast<size_t>(width) * 3;
+		unsigned count = 0;
+		for (; left + 48 <= right; left += 24, right -= 24, count += 8) {
+			uint8x8x3_t a = vld3_u8(left);
+			uint8x8x3_t b = vld3_u8(right - 24);
+			for (int c = 0; c < 3; c++) {
+				a.val[c] = vrev64_u8(a.val[c]);
+				b.val[c] = vrev64_u8(b.val[c]);
+			}
+			vst3_u8(left, b);
+			vst3_u8(right - 24, a);
+		}
+		return count;
+	}
+
+	unsigned Mirror48_NEON(uint8_t *bits, unsigned width) {
+		uint8_t *left = bits;
+		uint8_t *right = bits + static_cast<size_t>(width) * 6;
+		unsigned count = 0;
+		for (; left + 48 <= right; left += 24, right -= 24, count += 4) {
+			uint16x4x3_t a = vld3_u16(reinterpret_cast<const uint16_t *>(left));
+			uint16x4x3_t b = vld3_u16(reinterpret_cast<const uint16_t *>(right - 24));
+			for (int c = 0; c < 3; c++) {
+				a.val[c] = vrev64_u16(a.val[c]);
+				b.val[c] = vrev64_u16(b.val[c]);
+			}
+			vst3_u16(reinterpret_cast<uint16_t *>(left), b);
+			vst3_u16(reinterpret_cast<uint16_t *>(right - 24), a);
+		}
+		return count;
+	}
+
+#endif // FREEIMAGE_SIMD_NEON
+
+	struct FlipKernels {
+		std::atomic<MirrorKernel> mirror8{ NoMirror };
+		std::atomic<MirrorKernel> mirror16{ NoMirror };
+		std::atomic<MirrorKernel> mirror24{ NoMirror };
+		std::atomic<MirrorKernel> mirror32{ NoMirror };
+		std::atomic<MirrorKernel> mirror48{ NoMirror };
+		std::atomic<MirrorKernel> mirror64{ NoMirror };
+	};
+
+	FlipKernels gKernels;
+
+	void SelectFlipKernels(uint32_t features) {
+		MirrorKernel mirror8 = NoMirror;
+		MirrorKernel mirror16 = NoMirror;
+		MirrorKernel mirror24 = NoMirror;
+		MirrorKernel mirror32 = NoMirror;
+		MirrorKernel mirror48 = NoMirror;
+		MirrorKernel mirror64 = NoMirror;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			mirror8 = Mirror_SSE2<1, Reverse8x16>;
+			mirror16 = Mirror_SSE2<2, Reverse16x8>;
+			mirror32 = Mirror_SSE2<4, Reverse32x4>;
+			mirror64 = Mirror_SSE2<8, Reverse64x2>;
+		}
+		if (features & FI_CPU_SSSE3) {
+			mirror24 = Mirror24_SSSE3;
+			mirror48 = Mirror48_SSSE3;
+		}
+#elif FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			mirror8 = Mirror_NEON<1, Reverse8x16>;
+			mirror16 = Mirror_NEON<2, Reverse16x8>;
+			mirror24 = Mirror24_NEON;
+			mirror32 = Mirror_NEON<4, Reverse32x4>;
+			mirror48 = Mirror48_NEON;
+			mirror64 = Mirror_NEON<8, Reverse64x2>;
+		}
+#endif
+		gKernels.mirror8.store(mirror8, std::memory_order_relaxed);
+		gKernels.mirror16.store(mirror16, std::memory_order_relaxed);
+		gKernels.mirror24.store(mirror24, std::memory_order_relaxed);
+		gKernels.mirror32.store(mirror32, std::memory_order_relaxed);
+		gKernels.mirror48.store(mirror48, std::memory_order_relaxed);
+		gKernels.mirror64.store(mirror64, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectFlipKernels);
+
+	/// Mirrors the rows of an image in place: the kernel swaps the outer pixels, the scalar loop the middle ones
+	template <unsigned bytespp>
+	void MirrorRows(uint8_t *bits, unsigned pitch, unsigned width, unsigned height, MirrorKernel kernel) {
+		ParallelFor(0, height, CalculateBandRows(static_cast<size_t>(width) * bytespp), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				uint8_t *row = bits + static_cast<size_t>(y) * pitch;
+				MirrorPixels<bytespp>(row, width, kernel(row, width));
+			}
+		});
+	}
+
+} // namespace
 
 /**
 Flip the image horizontally along the vertical axis.
+Rows are mirrored in place by parallel bands.
 @param src Input image to be processed.
 @return Returns TRUE if successful, FALSE otherwise.
 */
@@ -33,90 +343,57 @@ FIBOOL DLL_CALLCONV
 FreeImage_FlipHorizontal(FIBITMAP *src) {
 	if (!FreeImage_HasPixels(src)) return FALSE;
 
-	const unsigned line   = FreeImage_GetLine(src);
-	const unsigned width	= FreeImage_GetWidth(src);
+	const unsigned bpp    = FreeImage_GetBPP(src);
+	const unsigned pitch  = FreeImage_GetPitch(src);
+	const unsigned width  = FreeImage_GetWidth(src);
 	const unsigned height = FreeImage_GetHeight(src);
 
-	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-	// copy between aligned memories
-	uint8_t *new_bits = (uint8_t*)FreeImage_Aligned_Malloc(line * sizeof(uint8_t), FIBITMAP_ALIGNMENT);
-	if (!new_bits) return FALSE;
+	uint8_t *bits = FreeImage_GetBits(src);
 
 	// mirror the buffer
 
-	for (unsigned y = 0; y < height; y++) {
-		uint8_t *bits = FreeImage_GetScanLine(src, y);
-		memcpy(new_bits, bits, line);
-
-		switch (FreeImage_GetBPP(src)) {
-			case 1 :
-			{
-				for (unsigned x = 0; x < width; x++) {
-					// get pixel at (x, y)
-					FIBOOL value = (new_bits[x >> 3] & (0x80 >> (x & 0x07))) != 0;
-					// set pixel at (new_x, y)
-					unsigned new_x = width - 1 - x;
-					value ? bits[new_x >> 3] |= (0x80 >> (new_x & 0x7)) : bits[new_x >> 3] &= (0xff7f >> (new_x & 0x7));
+	switch (bpp) {
+		case 1:
+		case 4:
+			ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(src)), [&](unsigned first, unsigned last) {
+				for (unsigned y = first; y < last; y++) {
+					MirrorPackedPixels(bits + static_cast<size_t>(y) * pitch, width, bpp);
 				}
-			}
+			});
 			break;
 
-			case 4 :
-			{
-				for (unsigned c = 0; c < line; c++) {
-					bits[c] = new_bits[line - c - 1];
+		case 8:
+			MirrorRows<1>(bits, pitch, width, height, gKernels.mirror8.load(std::memory_order_relaxed));
+			break;
 
-					uint8_t nibble = (bits[c] & 0xF0) >> 4;
+		case 16:
+			MirrorRows<2>(bits, pitch, width, height, gKernels.mirror16.load(std::memory_order_relaxed));
+			break;
 
-					bits[c] = bits[c] << 4;
-					bits[c] |= nibble;
-				}
-			}
+		case 24:
+			MirrorRows<3>(bits, pitch, width, height, gKernels.mirror24.load(std::memory_order_relaxed));
 			break;
 
-			case 8:
-			{
-				auto *dst_data = (uint8_t*) bits;
-				auto *src_data = (const uint8_t*) (new_bits + line - bytespp);
-				for (unsigned c = 0; c < width; c++) {
-					*dst_data++ = *src_data--;
-				}
-			}
+		case 32:
+			MirrorRows<4>(bits, pitch, width, height, gKernels.mirror32.load(std::memory_order_relaxed));
 			break;
 
-			case 16:
-			{
-				auto *dst_data = (uint16_t*) bits;
-				auto *src_data = (const uint16_t*) (new_bits + line - bytespp);
-				for (unsigned c = 0; c < width; c++) {
-					*dst_data++ = *src_data--;
-				}
-			}
+		case 48:
+			MirrorRows<6>(bits, pitch, width, height, gKernels.mirror48.load(std::memory_order_relaxed));
 			break;
 
-			case 24 :
-			case 32 :
-			case 48:
-			case 64:
-			case 96:
-			case 128:
-			{
-				auto *dst_data = (uint8_t*) bits;
-				auto *src_data = (const uint8_t*) (new_bits + line - bytespp);
-				for (unsigned c = 0; c < width; c++) {
-					for (unsigned k = 0; k < bytespp; k++) {
-						*dst_data++ = src_data[k];
-					}
-					src_data -= bytespp;
-				}
-			}
+		case 64:
+			MirrorRows<8>(bits, pitch, width, height, gKernels.mirror64.load(std::memory_order_relaxed));
 			break;
 
-		}
-	}
+		case 96:
+			MirrorRows<12>(bits, pitch, width, height, NoMirror);
+			break;
 
-	FreeImage_Aligned_Free(new_bits);
+		case 128:
+			MirrorRows<16>(bits, pitch, width, height, NoMirror);
+			break;
+	}
 
 	return TRUE;
 }
@@ -124,43 +401,69 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 
 /**
 Flip the image vertically along the horizontal axis.
+Pairs of rows are swapped by parallel bands through a small stack buffer.
 @param src Input image to be processed.
 @return Returns TRUE if successful, FALSE otherwise.
 */
 
 FIBOOL DLL_CALLCONV 
 FreeImage_FlipVertical(FIBITMAP *src) {
-	uint8_t *From, *Mid;
-
 	if (!FreeImage_HasPixels(src)) return FALSE;
 
 	// swap the buffer
 
 	const unsigned pitch  = FreeImage_GetPitch(src);
+	const unsigned line   = FreeImage_GetLine(src);
 	const unsigned height = FreeImage_GetHeight(src);
 
-	// copy between aligned memories
-	Mid = (uint8_t*)FreeImage_Aligned_Malloc(pitch * sizeof(uint8_t), FIBITMAP_ALIGNMENT);
-	if (!Mid) return FALSE;
-
-	From = FreeImage_GetBits(src);
-	
-	unsigned line_s = 0;
-	unsigned line_t = (height-1) * pitch;
-
-	for (unsigned y = 0; y < height/2; y++) {
-
-		memcpy(Mid, From + line_s, pitch);
-		memcpy(From + line_s, From + line_t, pitch);
-		memcpy(From + line_t, Mid, pitch);
+	uint8_t *bits = FreeImage_GetBits(src);
+
+	ParallelFor(0, height / 2, CalculateBandRows(2 * static_cast<size_t>(line)), [&](unsigned first, unsigned last) {
+		uint8_t Mid[4096];
+		for (unsigned y = first; y < last; y++) {
+			uint8_t *line_s = bits + static_cast<size_t>(y) * pitch;
+			uint8_t *line_t = bits + static_cast<size_t>(height - 1 - y) * pitch;
+			for (unsigned offset = 0; offset < line; offset += sizeof(Mid)) {
+				const unsigned size = MIN(line - offset, static_cast<unsigned>(sizeof(Mid)));
+				memcpy(Mid, line_s + offset, size);
+				memcpy(line_s + offset, line_t + offset, size);
+				memcpy(line_t + offset, Mid, size);
+			}
+		}
+	});
 
-		line_s += pitch;
-		line_t -= pitch;
+	return TRUE;
+}
 
+/**
+Returns a copy of the image with pixels stored in display order.
+A transposition is a quarter turn counter clockwise followed by a vertical flip.
+@param src Input image to be processed.
+@return Returns the new image if successful, NULL otherwise.
+*/
+FIBITMAP * DLL_CALLCONV
+FreeImage_ApplyOrientation(FIBITMAP *src) {
+	if (!FreeImage_HasPixels(src)) return nullptr;
+
+	unsigned orientation = FreeImage_GetOrientation(src);
+
+	FIBITMAP *dst{};
+	if (orientation & FIO_TRANSPOSE) {
+		dst = FreeImage_Rotate(src, 90);
+		orientation ^= FIO_FLIP_VERTICAL;
+	} else {
+		dst = FreeImage_Clone(src);
+	}
+	if (!dst) {
+		return nullptr;
 	}
+	FreeImage_SetOrientation(dst, FIO_NORMAL);
 
-	FreeImage_Aligned_Free(Mid);
+	if (((orientation & FIO_FLIP_HORIZONTAL) && !FreeImage_FlipHorizontal(dst)) ||
+		((orientation & FIO_FLIP_VERTICAL) && !FreeImage_FlipVertical(dst))) {
+		FreeImage_Unload(dst);
+		return nullptr;
+	}
 
-	return TRUE;
+	return dst;
 }
-
@@ -40,6 +40,10 @@ extern "C" {
 #include "Utilities.h"
 #include "FreeImageIO.h"
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #if FREEIMAGE_WITH_LIBJPEG
 
 // ----------------------------------------------------------
@@ -69,9 +73,7 @@ ls_jpeg_error_exit (j_common_ptr cinfo) {
 	// allow JPEG with a premature end of file
 	if ((cinfo)->err->msg_parm.i[0] != 13) {
 
-		// let the memory manager delete any temp files before we die
-		jpeg_destroy(cinfo);
-
+		// the caller aborts or destroys the object, which deletes any temp files
 		throw FIF_JPEG;
 	}
 }
@@ -154,18 +156,211 @@ getCropString(char* crop, size_t cropSize, int* left, int* top, int* right, int*
 	return TRUE;
 }
 
+// ----------------------------------------------------------
+//   EXIF orientation
+// ----------------------------------------------------------
+
+/**
+Locations of the EXIF tags rewritten by FIJPEG_OP_EXIF_ORIENT inside a saved APP1 marker
+*/
+struct ExifOrientation {
+	//! SHORT value of the Orientation tag
+	uint8_t *value{};
+	//! PixelXDimension and PixelYDimension entries of the Exif IFD, swapped by rotations
+	uint8_t *entry_x{};
+	uint8_t *entry_y{};
+	FIBOOL motorola{};
+};
+
+static unsigned
+exifGet16(const uint8_t *p, FIBOOL motorola) {
+	return motorola ? ((p[0] << 8) | p[1]) : ((p[1] << 8) | p[0]);
+}
+
+static uint32_t
+exifGet32(const uint8_t *p, FIBOOL motorola) {
+	return motorola
+		? (((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3])
+		: (((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0]);
+}
+
+/**
+Walks the entries of an IFD, calls visit(tag, type, count, entry) for each of them.
+@return Returns FALSE if the IFD lies outside the TIFF block
+*/
+template <typename Visit>
 static FIBOOL
-JPEGTransformFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO* dst_io, fi_handle dst_handle, FREE_IMAGE_JPEG_OPERATION operation, int* left, int* top, int* right, int* bottom, FIBOOL perfect) {
+exifWalkIFD(uint8_t *tiff, size_t size, uint32_t offset, FIBOOL motorola, Visit visit) {
+	if ((offset < 8) || (offset > size - 2)) {
+		return FALSE;
+	}
+	const unsigned count = exifGet16(tiff + offset, motorola);
+	if (count > (size - offset - 2) / 12) {
+		return FALSE;
+	}
+	for (unsigned i = 0; i < count; i++) {
+		uint8_t *entry = tiff + offset + 2 + 12 * i;
+		visit(exifGet16(entry, motorola), exifGet16(entry + 2, motorola), exifGet32(entry + 4, motorola), entry);
+	}
+	return TRUE;
+}
+
+/**
+Finds the Orientation tag in the EXIF markers saved by jcopy_markers_setup
+@return Returns TRUE if the orientation is found
+*/
+static FIBOOL
+findExifOrientation(j_decompress_ptr cinfo, ExifOrientation *exif) {
+	for (jpeg_saved_marker_ptr marker = cinfo->marker_list; marker; marker = marker->next) {
+		if ((marker->marker != JPEG_APP0 + 1) || (marker->data_length < 14) || (memcmp(marker->data, "Exif\0\0", 6) != 0)) {
+			continue;
+		}
+		uint8_t *tiff = marker->data + 6;
+		const size_t size = marker->data_length - 6;
+		if ((tiff[0] == 'M') && (tiff[1] == 'M')) {
+			exif->motorola = TRUE;
+		} else if ((tiff[0] == 'I') && (tiff[1] == 'I')) {
+			exif->motorola = FALSE;
+		} else {
+			continue;
+		}
+
+		uint32_t exif_ifd = 0;
+		exifWalkIFD(tiff, size, exifGet32(tiff + 4, exif->motorola), exif->motorola, [&](unsigned tag, unsigned type, uint32_t count, uint8_t *entry) {
+			if ((tag == 0x0112) && (type == 3) && (count == 1)) {
+				exif->value = entry + 8;
+			} else if ((tag == 0x8769) && (count == 1)) {
+				exif_ifd = exifGet32(entry + 8, exif->motorola);
+			}
+		});
+		if (!exif->value) {
+			continue;
+		}
+		if (exif_ifd) {
+			exifWalkIFD(tiff, size, exif_ifd, exif->motorola, [&](unsigned tag, unsigned, uint32_t count, uint8_t *entry) {
+				if ((tag == 0xA002) && (count == 1)) {
+					exif->entry_x = entry;
+				} else if ((tag == 0xA003) && (count == 1)) {
+					exif->entry_y = entry;
+				}
+			});
+		}
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+Rewrites the EXIF of the source so that the copied markers describe the transformed image:
+orientation reset to 1 (top-left), pixel dimensions swapped when the transformation swaps them.
+The EXIF thumbnail is left as it is.
+*/
+static void
+resetExifOrientation(ExifOrientation *exif, FIBOOL swappedDim) {
+	exif->value[0] = exif->motorola ? 0 : 1;
+	exif->value[1] = exif->motorola ? 1 : 0;
+	if (swappedDim && exif->entry_x && exif->entry_y) {
+		// swap type, count and value, the tags keep their place
+		uint8_t tmp[10];
+		memcpy(tmp, exif->entry_x + 2, 10);
+		memcpy(exif->entry_x + 2, exif->entry_y + 2, 10);
+		memcpy(exif->entry_y + 2, tmp, 10);
+	}
+}
+
+/**
+Transformation which brings an image with the given EXIF orientation to the top-left orientation
+*/
+static FREE_IMAGE_JPEG_OPERATION
+operationFromExifOrientation(unsigned orientation) {
+	switch (orientation) {
+		case 2:
+			return FIJPEG_OP_FLIP_H;
+		case 3:
+			return FIJPEG_OP_ROTATE_180;
+		case 4:
+			return FIJPEG_OP_FLIP_V;
+		case 5:
+			return FIJPEG_OP_TRANSPOSE;
+		case 6:
+			return FIJPEG_OP_ROTATE_90;
+		case 7:
+			return FIJPEG_OP_TRANSVERSE;
+		case 8:
+			return FIJPEG_OP_ROTATE_270;
+		default:
+			return FIJPEG_OP_NONE;
+	}
+}
+
+// ----------------------------------------------------------
+//   Transformer
+// ----------------------------------------------------------
+
+/**
+Pair of libjpeg objects reused by successive transformations.
+The error handler throws, each call aborts the objects on failure so that the next one starts clean.
+*/
+class JPEGTransformer {
+public:
+	JPEGTransformer() {
+		memset(&srcinfo, 0, sizeof(srcinfo));
+		memset(&jsrcerr, 0, sizeof(jsrcerr));
+		memset(&jdsterr, 0, sizeof(jdsterr));
+		memset(&dstinfo, 0, sizeof(dstinfo));
+	}
+
+	~JPEGTransformer() {
+		jpeg_destroy_compress(&dstinfo);
+		jpeg_destroy_decompress(&srcinfo);
+	}
+
+	JPEGTransformer(const JPEGTransformer&) = delete;
+	JPEGTransformer& operator=(const JPEGTransformer&) = delete;
+
+	/**
+	Creates the libjpeg objects
+	@return Returns FALSE if they cannot be allocated
+	*/
+	FIBOOL Init() {
+		try {
+			// Initialize the JPEG decompression object with default error handling
+			srcinfo.err = jpeg_std_error(&jsrcerr);
+			srcinfo.err->error_exit = ls_jpeg_error_exit;
+			srcinfo.err->output_message = ls_jpeg_output_message;
+			jpeg_create_decompress(&srcinfo);
+
+			// Initialize the JPEG compression object with default error handling
+			dstinfo.err = jpeg_std_error(&jdsterr);
+			dstinfo.err->error_exit = ls_jpeg_error_exit;
+			dstinfo.err->output_message = ls_jpeg_output_message;
+			jpeg_create_compress(&dstinfo);
+		}
+		catch(...) {
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	FIBOOL Transform(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO* dst_io, fi_handle dst_handle, FREE_IMAGE_JPEG_OPERATION operation, int* left, int* top, int* right, int* bottom, FIBOOL perfect);
+
+	FIBITMAP* LoadDC(FreeImageIO* io, fi_handle handle);
+
+	FIBOOL Thumbnail(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO* dst_io, fi_handle dst_handle, int max_pixel_size);
+
+private:
+	jpeg_decompress_struct srcinfo;
+	jpeg_compress_struct dstinfo;
+	jpeg_error_mgr jsrcerr, jdsterr;
+};
+
+FIBOOL JPEGTransformer::Transform(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO* dst_io, fi_handle dst_handle, FREE_IMAGE_JPEG_OPERATION operation, int* left, int* top, int* right, int* bottom, FIBOOL perfect) {
 	const FIBOOL onlyReturnCropRect = (!dst_io || !dst_handle);
 	const long stream_start = onlyReturnCropRect ? 0 : dst_io->tell_proc(dst_handle);
 	FIBOOL swappedDim = FALSE;
 	FIBOOL trimH = FALSE;
 	FIBOOL trimV = FALSE;
 
-	// Set up the jpeglib structures
-	jpeg_decompress_struct srcinfo;
-	jpeg_compress_struct dstinfo;
-	jpeg_error_mgr jsrcerr, jdsterr;
 	jvirt_barray_ptr *src_coef_arrays{};
 	jvirt_barray_ptr *dst_coef_arrays{};
 	// Support for copying optional markers from source to destination file
@@ -173,11 +368,6 @@ JPEGTransformFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO*
 	// Image transformation options
 	jpeg_transform_info transfoptions;
 
-	// Initialize structures
-	memset(&srcinfo, 0, sizeof(srcinfo));
-	memset(&jsrcerr, 0, sizeof(jsrcerr));
-	memset(&jdsterr, 0, sizeof(jdsterr));
-	memset(&dstinfo, 0, sizeof(dstinfo));
 	memset(&transfoptions, 0, sizeof(transfoptions));
 
 	// Copy all extra markers from source file
@@ -187,46 +377,6 @@ JPEGTransformFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO*
 	transfoptions.force_grayscale = FALSE;
 	transfoptions.crop = FALSE;
 
-	// Select the transform option
-	switch (operation) {
-		case FIJPEG_OP_FLIP_H:		// horizontal flip
-			transfoptions.transform = JXFORM_FLIP_H;
-			trimH = TRUE;
-			break;
-		case FIJPEG_OP_FLIP_V:		// vertical flip
-			transfoptions.transform = JXFORM_FLIP_V;
-			trimV = TRUE;
-			break;
-		case FIJPEG_OP_TRANSPOSE:	// transpose across UL-to-LR axis
-			transfoptions.transform = JXFORM_TRANSPOSE;
-			swappedDim = TRUE;
-			break;
-		case FIJPEG_OP_TRANSVERSE:	// transpose across UR-to-LL axis
-			transfoptions.transform = JXFORM_TRANSVERSE;
-			trimH = TRUE;
-			trimV = TRUE;
-			swappedDim = TRUE;
-			break;
-		case FIJPEG_OP_ROTATE_90:	// 90-degree clockwise rotation
-			transfoptions.transform = JXFORM_ROT_90;
-			trimH = TRUE;
-			swappedDim = TRUE;
-			break;
-		case FIJPEG_OP_ROTATE_180:	// 180-degree rotation
-			trimH = TRUE;
-			trimV = TRUE;
-			transfoptions.transform = JXFORM_ROT_180;
-			break;
-		case FIJPEG_OP_ROTATE_270:	// 270-degree clockwise (or 90 ccw)
-			transfoptions.transform = JXFORM_ROT_270;
-			trimV = TRUE;
-			swappedDim = TRUE;
-			break;
-		default:
-		case FIJPEG_OP_NONE:		// no transformation
-			transfoptions.transform = JXFORM_NONE;
-			break;
-	}
 	// (perfect == TRUE) ==> fail if there is non-transformable edge blocks
 	transfoptions.perfect = (perfect == TRUE) ? TRUE : FALSE;
 	// Drop non-transformable edge blocks: trim off any partial edge MCUs that the transform can't handle.
@@ -234,18 +384,6 @@ JPEGTransformFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO*
 
 	try {
 
-		// Initialize the JPEG decompression object with default error handling
-		srcinfo.err = jpeg_std_error(&jsrcerr);
-		srcinfo.err->error_exit = ls_jpeg_error_exit;
-		srcinfo.err->output_message = ls_jpeg_output_message;
-		jpeg_create_decompress(&srcinfo);
-
-		// Initialize the JPEG compression object with default error handling
-		dstinfo.err = jpeg_std_error(&jdsterr);
-		dstinfo.err->error_exit = ls_jpeg_error_exit;
-		dstinfo.err->output_message = ls_jpeg_output_message;
-		jpeg_create_compress(&dstinfo);
-
 		// Specify data source for decompression
 		jpeg_freeimage_src(&srcinfo, src_handle, src_io);
 
@@ -255,6 +393,54 @@ JPEGTransformFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO*
 		// Read the file header
 		jpeg_read_header(&srcinfo, TRUE);
 
+		// The EXIF orientation selects the transformation, the markers are patched before they are copied
+		ExifOrientation exif;
+		const FIBOOL autoOrient = (operation == FIJPEG_OP_EXIF_ORIENT) && findExifOrientation(&srcinfo, &exif);
+		if (operation == FIJPEG_OP_EXIF_ORIENT) {
+			operation = autoOrient ? operationFromExifOrientation(exifGet16(exif.value, exif.motorola)) : FIJPEG_OP_NONE;
+		}
+
+		// Select the transform option
+		switch (operation) {
+			case FIJPEG_OP_FLIP_H:		// horizontal flip
+				transfoptions.transform = JXFORM_FLIP_H;
+				trimH = TRUE;
+				break;
+			case FIJPEG_OP_FLIP_V:		// vertical flip
+				transfoptions.transform = JXFORM_FLIP_V;
+				trimV = TRUE;
+				break;
+			case FIJPEG_OP_TRANSPOSE:	// transpose across UL-to-LR axis
+				transfoptions.transform = JXFORM_TRANSPOSE;
+				swappedDim = TRUE;
+				break;
+			case FIJPEG_OP_TRANSVERSE:	// transpose across UR-to-LL axis
+				transfoptions.transform = JXFORM_TRANSVERSE;
+				trimH = TRUE;
+				trimV = TRUE;
+				swappedDim = TRUE;
+				break;
+			case FIJPEG_OP_ROTATE_90:	// 90-degree clockwise rotation
+				transfoptions.transform = JXFORM_ROT_90;
+				trimH = TRUE;
+				swappedDim = TRUE;
+				break;
+			case FIJPEG_OP_ROTATE_180:	// 180-degree rotation
+				trimH = TRUE;
+				trimV = TRUE;
+				transfoptions.transform = JXFORM_ROT_180;
+				break;
+			case FIJPEG_OP_ROTATE_270:	// 270-degree clockwise (or 90 ccw)
+				transfoptions.transform = JXFORM_ROT_270;
+				trimV = TRUE;
+				swappedDim = TRUE;
+				break;
+			default:
+			case FIJPEG_OP_NONE:		// no transformation
+				transfoptions.transform = JXFORM_NONE;
+				break;
+		}
+
 		// crop option
 		char crop[64];
 		const FIBOOL hasCrop = getCropString(crop, std::size(crop), left, top, right, bottom, swappedDim ? srcinfo.image_height : srcinfo.image_width, swappedDim ? srcinfo.image_width : srcinfo.image_height);
@@ -315,11 +501,14 @@ JPEGTransformFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO*
 		// if only the crop rect is requested, we are done
 
 		if (onlyReturnCropRect) {
-			jpeg_destroy_compress(&dstinfo);
-			jpeg_destroy_decompress(&srcinfo);
+			jpeg_abort_decompress(&srcinfo);
 			return TRUE;
 		}
 
+		if (autoOrient) {
+			resetExifOrientation(&exif, swappedDim);
+		}
+
 		// Read source file as DCT coefficients
 		src_coef_arrays = jpeg_read_coefficients(&srcinfo);
 
@@ -352,29 +541,321 @@ JPEGTransformFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO*
 		// Execute image transformation, if any
 		jtransform_execute_transformation(&srcinfo, &dstinfo, src_coef_arrays, &transfoptions);
 
-		// Finish compression and release memory
+		// Finish compression, the objects are ready for the next image
 		jpeg_finish_compress(&dstinfo);
-		jpeg_destroy_compress(&dstinfo);
 		jpeg_finish_decompress(&srcinfo);
-		jpeg_destroy_decompress(&srcinfo);
 
 	}
 	catch(...) {
-		jpeg_destroy_compress(&dstinfo);
-		jpeg_destroy_decompress(&srcinfo);
+		jpeg_abort_compress(&dstinfo);
+		jpeg_abort_decompress(&srcinfo);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+Builds a 1/8 scale image from the DC coefficients: the DC of a block is 8 times the mean of its samples,
+so that each pixel is the exact average of the 8x8 samples it stands for, without any inverse DCT.
+Subsampled chroma components contribute the DC of the block covering the pixel.
+*/
+FIBITMAP* JPEGTransformer::LoadDC(FreeImageIO* io, fi_handle handle) {
+	FIBITMAP *dib{};
+
+	try {
+		jpeg_freeimage_src(&srcinfo, handle, io);
+
+		// markers are not needed
+		for (int m = 0; m < 16; m++) {
+			jpeg_save_markers(&srcinfo, JPEG_APP0 + m, 0);
+		}
+		jpeg_save_markers(&srcinfo, JPEG_COM, 0);
+
+		jpeg_read_header(&srcinfo, TRUE);
+
+		const int components = srcinfo.num_components;
+		const FIBOOL isGrey = (components == 1) && (srcinfo.jpeg_color_space == JCS_GRAYSCALE);
+		const FIBOOL isYCbCr = (components == 3) && (srcinfo.jpeg_color_space == JCS_YCbCr);
+		const FIBOOL isRGB = (components == 3) && (srcinfo.jpeg_color_space == JCS_RGB);
+		if (!isGrey && !isYCbCr && !isRGB) {
+			FreeImage_OutputMessageProc(FIF_JPEG, "DC preview of a %d components JPEG image is not supported", components);
+			throw(1);
+		}
+
+		jvirt_barray_ptr *coef_arrays = jpeg_read_coefficients(&srcinfo);
+
+		const unsigned width = (srcinfo.image_width + DCTSIZE - 1) / DCTSIZE;
+		const unsigned height = (srcinfo.image_height + DCTSIZE - 1) / DCTSIZE;
+
+		dib = FreeImage_Allocate(width, height, isGrey ? 8 : 24);
+		if (!dib) {
+			FreeImage_OutputMessageProcEx(FIF_JPEG, FIMSG_DIB_MEMORY, FI_MSG_ERROR_DIB_MEMORY);
+			throw(1);
+		}
+
+		std::vector<uint8_t> samples(width * components);
+
+		for (unsigned y = 0; y < height; y++) {
+			for (int c = 0; c < components; c++) {
+				const jpeg_component_info *comp = &srcinfo.comp_info[c];
+				const JDIMENSION by = std::min<JDIMENSION>(y * comp->v_samp_factor / srcinfo.max_v_samp_factor, comp->height_in_blocks - 1);
+				JBLOCKARRAY blocks = (*srcinfo.mem->access_virt_barray)((j_common_ptr)&srcinfo, coef_arrays[c], by, 1, FALSE);
+				const int quant = comp->quant_table ? comp->quant_table->quantval[0] : 1;
+
+				for (unsigned x = 0; x < width; x++) {
+					const JDIMENSION bx = std::min<JDIMENSION>(x * comp->h_samp_factor / srcinfo.max_h_samp_factor, comp->width_in_blocks - 1);
+					const int dc = blocks[0][bx][0] * quant;
+					const int value = (dc >= 0 ? (dc + 4) / 8 : -((4 - dc) / 8)) + CENTERJSAMPLE;
+					samples[x * components + c] = (uint8_t)CLAMP(value, 0, MAXJSAMPLE);
+				}
+			}
+
+			uint8_t *bits = FreeImage_GetScanLine(dib, height - 1 - y);
+			if (isGrey) {
+				memcpy(bits, samples.data(), width);
+			} else {
+				const uint8_t *src = samples.data();
+				for (unsigned x = 0; x < width; x++, src += 3, bits += 3) {
+					if (isYCbCr) {
+						// JFIF (BT.601 full range) conversion
+						const double Y = src[0];
+						const double Cb = src[1] - 128.0;
+						const double Cr = src[2] - 128.0;
+						bits[FI_RGBA_RED] = (uint8_t)CLAMP((int)lround(Y + 1.402 * Cr), 0, 255);
+						bits[FI_RGBA_GREEN] = (uint8_t)CLAMP((int)lround(Y - 0.344136 * Cb - 0.714136 * Cr), 0, 255);
+						bits[FI_RGBA_BLUE] = (uint8_t)CLAMP((int)lround(Y + 1.772 * Cb), 0, 255);
+					} else {
+						bits[FI_RGBA_RED] = src[0];
+						bits[FI_RGBA_GREEN] = src[1];
+						bits[FI_RGBA_BLUE] = src[2];
+					}
+				}
+			}
+		}
+
+		jpeg_finish_decompress(&srcinfo);
+	}
+	catch(...) {
+		jpeg_abort_decompress(&srcinfo);
+		FreeImage_Unload(dib);
+		return nullptr;
+	}
+
+	return dib;
+}
+
+/**
+Matrices bringing the k x k low frequency coefficients of the blocks of a N x N group (k = 8 / N) to the
+coefficients of the 8x8 block covering the group: k-point inverse DCT then 8-point forward DCT,
+both orthonormal like the JPEG DCT. matrices[i][u][v] applies to the block at position i in the group.
+*/
+static void
+getDCTScaleMatrices(int N, double matrices[DCTSIZE][DCTSIZE][DCTSIZE]) {
+	constexpr double kPi = 3.14159265358979323846;
+	const int k = DCTSIZE / N;
+	// the DC of an orthonormal n x n DCT is n times the mean
+	const double norm = sqrt((double)k / DCTSIZE);
+	for (int i = 0; i < N; i++) {
+		for (int u = 0; u < DCTSIZE; u++) {
+			const double cu = sqrt((u ? 2.0 : 1.0) / DCTSIZE);
+			for (int v = 0; v < k; v++) {
+				const double cv = sqrt((v ? 2.0 : 1.0) / k);
+				double sum = 0;
+				for (int x = 0; x < k; x++) {
+					sum += cu * cos((2 * (i * k + x) + 1) * u * kPi / (2 * DCTSIZE)) * cv * cos((2 * x + 1) * v * kPi / (2 * k));
+				}
+				matrices[i][u][v] = norm * sum;
+			}
+		}
+	}
+}
+
+/**
+Scales a JPEG by 1/N in the DCT domain: the low frequency coefficients of each group of N x N blocks
+make one block of the output, requantised with the tables of the source. No sample is decoded.
+ICC profiles are kept, other markers are dropped.
+*/
+FIBOOL JPEGTransformer::Thumbnail(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO* dst_io, fi_handle dst_handle, int max_pixel_size) {
+	try {
+		jpeg_freeimage_src(&srcinfo, src_handle, src_io);
+
+		for (int m = 0; m < 16; m++) {
+			jpeg_save_markers(&srcinfo, JPEG_APP0 + m, (m == 2) ? 0xFFFF : 0);
+		}
+		jpeg_save_markers(&srcinfo, JPEG_COM, 0);
+
+		jpeg_read_header(&srcinfo, TRUE);
+
+		// smallest reduction fitting max_pixel_size, 1/8 at most
+		const JDIMENSION size = MAX(srcinfo.image_width, srcinfo.image_height);
+		int N = 1;
+		while ((N < DCTSIZE) && (size > (JDIMENSION)max_pixel_size * N)) {
+			N *= 2;
+		}
+		const JDIMENSION width = (srcinfo.image_width + N - 1) / N;
+		const JDIMENSION height = (srcinfo.image_height + N - 1) / N;
+
+		// output arrays padded to whole iMCUs, requested before the source arrays are realized
+		const int components = srcinfo.num_components;
+		const JDIMENSION width_in_iMCUs = (width + srcinfo.max_h_samp_factor * DCTSIZE - 1) / (srcinfo.max_h_samp_factor * DCTSIZE);
+		const JDIMENSION height_in_iMCUs = (height + srcinfo.max_v_samp_factor * DCTSIZE - 1) / (srcinfo.max_v_samp_factor * DCTSIZE);
+		jvirt_barray_ptr dst_coef_arrays[MAX_COMPONENTS];
+		for (int c = 0; c < components; c++) {
+			const jpeg_component_info *comp = &srcinfo.comp_info[c];
+			dst_coef_arrays[c] = (*srcinfo.mem->request_virt_barray)((j_common_ptr)&srcinfo, JPOOL_IMAGE, TRUE,
+				width_in_iMCUs * comp->h_samp_factor, height_in_iMCUs * comp->v_samp_factor, comp->v_samp_factor);
+		}
+
+		jvirt_barray_ptr *src_coef_arrays = jpeg_read_coefficients(&srcinfo);
+
+		double matrices[DCTSIZE][DCTSIZE][DCTSIZE];
+		getDCTScaleMatrices(N, matrices);
+		const int k = DCTSIZE / N;
+
+		for (int c = 0; c < components; c++) {
+			const jpeg_component_info *comp = &srcinfo.comp_info[c];
+			if (!comp->quant_table) {
+				throw(1);
+			}
+			const UINT16 *quant = comp->quant_table->quantval;
+			const JDIMENSION out_width = width_in_iMCUs * comp->h_samp_factor;
+			const JDIMENSION out_height = height_in_iMCUs * comp->v_samp_factor;
+
+			std::vector<double> accum(out_width * DCTSIZE2);
+
+			for (JDIMENSION by = 0; by < out_height; by++) {
+				std::fill(accum.begin(), accum.end(), 0.0);
+
+				for (int j = 0; j < N; j++) {
+					const JDIMENSION sy = std::min<JDIMENSION>(by * N + j, comp->height_in_blocks - 1);
+					JBLOCKARRAY src_row = (*srcinfo.mem->access_virt_barray)((j_common_ptr)&srcinfo, src_coef_arrays[c], sy, 1, FALSE);
+
+					for (JDIMENSION bx = 0; bx < out_width; bx++) {
+						double *out = &accum[bx * DCTSIZE2];
+
+						for (int i = 0; i < N; i++) {
+							const JDIMENSION sx = std::min<JDIMENSION>(bx * N + i, comp->width_in_blocks - 1);
+							const JCOEF *coef = src_row[0][sx];
+
+							// tmp = C * M[i]^T, the dequantised k x k low frequencies
+							double tmp[DCTSIZE][DCTSIZE];
+							for (int v = 0; v < k; v++) {
+								for (int w = 0; w < DCTSIZE; w++) {
+									double sum = 0;
+									for (int z = 0; z < k; z++) {
+										sum += coef[v * DCTSIZE + z] * quant[v * DCTSIZE + z] * matrices[i][w][z];
+									}
+									tmp[v][w] = sum;
+								}
+							}
+							// out += M[j] * tmp
+							for (int u = 0; u < DCTSIZE; u++) {
+								for (int w = 0; w < DCTSIZE; w++) {
+									double sum = 0;
+									for (int v = 0; v < k; v++) {
+										sum += matrices[j][u][v] * tmp[v][w];
+									}
+									out[u * DCTSIZE + w] += sum;
+								}
+							}
+						}
+					}
+				}
+
+				JBLOCKARRAY dst_row = (*srcinfo.mem->access_virt_barray)((j_common_ptr)&srcinfo, dst_coef_arrays[c], by, 1, TRUE);
+				for (JDIMENSION bx = 0; bx < out_width; bx++) {
+					const double *out = &accum[bx * DCTSIZE2];
+					JCOEF *coef = dst_row[0][bx];
+					for (int n = 0; n < DCTSIZE2; n++) {
+						const long value = lround(out[n] / quant[n]);
+						coef[n] = (JCOEF)CLAMP(value, -32767L, 32767L);
+					}
+				}
+			}
+		}
+
+		jpeg_copy_critical_parameters(&srcinfo, &dstinfo);
+		dstinfo.image_width = width;
+		dstinfo.image_height = height;
+		dstinfo.optimize_coding = TRUE;
+
+		jpeg_freeimage_dst(&dstinfo, dst_handle, dst_io);
+		jpeg_write_coefficients(&dstinfo, dst_coef_arrays);
+
+		for (jpeg_saved_marker_ptr marker = srcinfo.marker_list; marker; marker = marker->next) {
+			if ((marker->marker == JPEG_APP0 + 2) && (marker->data_length >= 12) && (memcmp(marker->data, "ICC_PROFILE", 12) == 0)) {
+				jpeg_write_marker(&dstinfo, marker->marker, marker->data, marker->data_length);
+			}
+		}
+
+		jpeg_finish_compress(&dstinfo);
+		jpeg_finish_decompress(&srcinfo);
+	}
+	catch(...) {
+		jpeg_abort_compress(&dstinfo);
+		jpeg_abort_decompress(&srcinfo);
 		return FALSE;
 	}
 
 	return TRUE;
 }
 
+static FIBOOL
+JPEGTransformFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO* dst_io, fi_handle dst_handle, FREE_IMAGE_JPEG_OPERATION operation, int* left, int* top, int* right, int* bottom, FIBOOL perfect) {
+	JPEGTransformer transformer;
+	if (!transformer.Init()) {
+		return FALSE;
+	}
+	return transformer.Transform(src_io, src_handle, dst_io, dst_handle, operation, left, top, right, bottom, perfect);
+}
+
+static FIBITMAP*
+JPEGLoadDCFromHandle(FreeImageIO* io, fi_handle handle) {
+	JPEGTransformer transformer;
+	if (!transformer.Init()) {
+		return nullptr;
+	}
+	return transformer.LoadDC(io, handle);
+}
+
+static FIBOOL
+JPEGThumbnailFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO* dst_io, fi_handle dst_handle, int max_pixel_size) {
+	JPEGTransformer transformer;
+	if (!transformer.Init()) {
+		return FALSE;
+	}
+	return transformer.Thumbnail(src_io, src_handle, dst_io, dst_handle, max_pixel_size);
+}
+
 #else // FREEIMAGE_WITH_LIBJPEG
 
+class JPEGTransformer {
+public:
+	FIBOOL Init() {
+		return FALSE;
+	}
+
+	FIBOOL Transform(FreeImageIO*, fi_handle, FreeImageIO*, fi_handle, FREE_IMAGE_JPEG_OPERATION, int*, int*, int*, int*, FIBOOL) {
+		return FALSE;
+	}
+};
+
 static FIBOOL
 JPEGTransformFromHandle(FreeImageIO*, fi_handle, FreeImageIO*, fi_handle, FREE_IMAGE_JPEG_OPERATION, int*, int*, int*, int*, FIBOOL) {
 	return FALSE;
 }
 
+static FIBITMAP*
+JPEGLoadDCFromHandle(FreeImageIO*, fi_handle) {
+	return nullptr;
+}
+
+static FIBOOL
+JPEGThumbnailFromHandle(FreeImageIO*, fi_handle, FreeImageIO*, fi_handle, int) {
+	return FALSE;
+}
+
 #endif // FREEIMAGE_WITH_LIBJPEG
 
 // ----------------------------------------------------------
@@ -609,8 +1090,8 @@ getMemIO(FIMEMORY* src_stream, FIMEMORY* dst_stream, FreeImageIO* dst_io, fi_han
 
 	if (dst_stream) {
 		FIMEMORYHEADER *mem_header = (FIMEMORYHEADER*)(dst_stream->data);
-		if (mem_header->delete_me != TRUE) {
-			// do not save in a user buffer
+		if (!IsMemoryWritable(mem_header)) {
+			// do not save in a read-only user buffer
 			FreeImage_OutputMessageProc(FIF_JPEG, "Destination memory buffer is read only");
 			return FALSE;
 		}
@@ -636,3 +1117,117 @@ FreeImage_JPEGTransformCombinedFromMemory(FIMEMORY* src_stream, FIMEMORY* dst_st
 	return FreeImage_JPEGTransformFromHandle(&io, src, &io, dst, operation, left, top, right, bottom, perfect);
 }
 
+unsigned DLL_CALLCONV
+FreeImage_JPEGTransformBatch(FIMEMORY** src_streams, FIMEMORY** dst_streams, unsigned count, FREE_IMAGE_JPEG_OPERATION operation, FIBOOL perfect, FIBOOL* results) {
+	if (results) {
+		std::fill(results, results + count, FALSE);
+	}
+	if (!src_streams || !dst_streams || !count) {
+		return 0;
+	}
+
+	// one pair of libjpeg objects for all the streams
+	JPEGTransformer transformer;
+	if (!transformer.Init()) {
+		return 0;
+	}
+
+	unsigned transformed = 0;
+	for (unsigned i = 0; i < count; i++) {
+		FreeImageIO io;
+		fi_handle src;
+		fi_handle dst;
+
+		if (!src_streams[i] || !dst_streams[i] || !getMemIO(src_streams[i], dst_streams[i], &io, &src, &dst)) {
+			continue;
+		}
+		if (transformer.Transform(&io, src, &io, dst, operation, nullptr, nullptr, nullptr, nullptr, perfect)) {
+			if (results) {
+				results[i] = TRUE;
+			}
+			transformed++;
+		}
+	}
+
+	return transformed;
+}
+
+// --------------------------------------------------------------------------
+
+FIBITMAP* DLL_CALLCONV
+FreeImage_JPEGLoadDCFromHandle(FreeImageIO* io, fi_handle handle) {
+	if (!io || !handle) {
+		return nullptr;
+	}
+	return JPEGLoadDCFromHandle(io, handle);
+}
+
+FIBITMAP* DLL_CALLCONV
+FreeImage_JPEGLoadDC(const char* filename) {
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	FILE* handle = fopen(filename, "rb");
+	if (!handle) {
+		FreeImage_OutputMessageProc(FIF_JPEG, "Cannot open \"%s\" for reading", filename);
+		return nullptr;
+	}
+
+	FIBITMAP* dib = JPEGLoadDCFromHandle(&io, handle);
+
+	fclose(handle);
+
+	return dib;
+}
+
+FIBITMAP* DLL_CALLCONV
+FreeImage_JPEGLoadDCFromMemory(FIMEMORY* stream) {
+	FreeImageIO io;
+	SetMemoryIO(&io);
+
+	return FreeImage_JPEGLoadDCFromHandle(&io, stream);
+}
+
+// --------------------------------------------------------------------------
+
+FIBOOL DLL_CALLCONV
+FreeImage_JPEGFastThumbnailFromHandle(FreeImageIO* src_io, fi_handle src_handle, FreeImageIO* dst_io, fi_handle dst_handle, int max_pixel_size) {
+	if (!src_io || !src_handle || !dst_io || !dst_handle || (max_pixel_size <= 0)) {
+		return FALSE;
+	}
+	return JPEGThumbnailFromHandle(src_io, src_handle, dst_io, dst_handle, max_pixel_size);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_JPEGFastThumbnail(const char *src_file, const char *dst_file, int max_pixel_size) {
+	FreeImageIO io;
+	fi_handle src;
+	fi_handle dst;
+
+	if (!dst_file || (strcmp(src_file, dst_file) == 0)) {
+		FreeImage_OutputMessageProc(FIF_JPEG, "The thumbnail cannot replace its source");
+		return FALSE;
+	}
+	if (!openStdIO(src_file, dst_file, &io, &src, &dst)) {
+		return FALSE;
+	}
+
+	FIBOOL ret = FreeImage_JPEGFastThumbnailFromHandle(&io, src, &io, dst, max_pixel_size);
+
+	closeStdIO(src, dst);
+
+	return ret;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_JPEGFastThumbnailFromMemory(FIMEMORY* src_stream, FIMEMORY* dst_stream, int max_pixel_size) {
+	FreeImageIO io;
+	fi_handle src;
+	fi_handle dst;
+
+	if (!getMemIO(src_stream, dst_stream, &io, &src, &dst)) {
+		return FALSE;
+	}
+
+	return FreeImage_JPEGFastThumbnailFromHandle(&io, src, &io, dst, max_pixel_size);
+}
@@ -0,0 +1,513 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "../FreeImage/CPUDispatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// --------------------------------------------------------------------------
+// Image comparison metrics
+// Images are compared channel by channel. Samples of a channel are converted to a float plane normalised to [0, 1]
+// (integer samples are divided by the range of their type, float samples are taken as is).
+// SSIM windows are 11 x 11 Gaussians of deviation 1.5 (Wang et al. 2004) computed by separable passes, image edges
+// are replicated. Planes are processed by parallel bands of rows with SIMD kernels; sums are accumulated per row
+// and reduced in row order, so results do not depend on the number of threads.
+// --------------------------------------------------------------------------
+
+namespace {
+
+	const unsigned kWindowRadius = 5;
+	const unsigned kWindowSize = 2 * kWindowRadius + 1;
+	const float kC1 = 0.01f * 0.01f;
+	const float kC2 = 0.03f * 0.03f;
+
+	/// MS-SSIM weights of the scales, finest first (Wang et al. 2003)
+	const double kScaleWeights[5] = { 0.0448, 0.2856, 0.3001, 0.2363, 0.1333 };
+
+	/// Samples of a channel, normalised
+	struct Plane {
+		unsigned width = 0;
+		unsigned height = 0;
+		std::vector<float> samples;
+
+		const float *Row(unsigned y) const {
+			return samples.data() + (size_t)width * y;
+		}
+	};
+
+	// ----------------------------------------------------------
+	//  Kernels
+	// ----------------------------------------------------------
+
+	/// dst[i] += weight * src[i] for i < count
+	using MultiplyAddKernel = void (*)(float *dst, const float *src, float weight, unsigned count);
+
+	/// Returns the sum of (a[i] - b[i])^2 for i < count
+	using SquaredErrorKernel = double (*)(const float *a, const float *b, unsigned count);
+
+	/// Adds the SSIM and contrast-structure values of count pixels from the window means, variances and covariance
+	using SSIMKernel = void (*)(const float *mu_a, const float *mu_b, const float *s_aa, const float *s_bb, const float *s_ab, unsigned count, double *ssim, double *cs);
+
+	void MultiplyAddScalar(float *dst, const float *src, float weight, unsigned count) {
+		for (unsigned i = 0; i < count; i++) {
+			dst[i] += weight * src[i];
+		}
+	}
+
+	double SquaredErrorScalar(const float *a, const float *b, unsigned count) {
+		double sum = 0;
+		for (unsigned i = 0; i < count; i++) {
+			const double d = (double)a[i] - b[i];
+			sum += d * d;
+		}
+		return sum;
+	}
+
+	inline void SSIMPixel(float mu_a, float mu_b, float s_aa, float s_bb, float s_ab, float& ssim, float& cs) {
+		const float mu_aa = mu_a * mu_a, mu_bb = mu_b * mu_b, mu_ab = mu_a * mu_b;
+		const float luminance = (2 * mu_ab + kC1) / (mu_aa + mu_bb + kC1);
+		cs = (2 * (s_ab - mu_ab) + kC2) / ((s_aa - mu_aa) + (s_bb - mu_bb) + kC2);
+		ssim = luminance * cs;
+	}
+
+	void SSIMScalar(const float *mu_a, const float *mu_b, const float *s_aa, const float *s_bb, const float *s_ab, unsigned count, double *ssim, double *cs) {
+		double ssim_sum = 0, cs_sum = 0;
+		for (unsigned i = 0; i < count; i++) {
+			float s, c;
+			SSIMPixel(mu_a[i], mu_b[i], s_aa[i], s_bb[i], s_ab[i], s, c);
+			ssim_sum += s;
+			cs_sum += c;
+		}
+		*ssim += ssim_sum;
+		*cs += cs_sum;
+	}
+
+#if FREEIMAGE_SIMD_X86
+	void MultiplyAdd_SSE2(float *dst, const float *src, float weight, unsigned count) {
+		const __m128 w = _mm_set1_ps(weight);
+		unsigned i = 0;
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+		}
+		MultiplyAddScalar(dst + i, src + i, weight, count - i);
+	}
+
+	/// Differences are squared in float and accumulated in double lanes
+	double SquaredError_SSE2(const float *a, const float *b, unsigned count) {
+		__m128d lo = _mm_setzero_pd(), hi = _mm_setzero_pd();
+		unsigned i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+			const __m128 d2 = _mm_mul_ps(d, d);
+			lo = _mm_add_pd(lo, _mm_cvtps_pd(d2));
+			hi = _mm_add_pd(hi, _mm_cvtps_pd(_mm_movehl_ps(d2, d2)));
+		}
+		double lanes[2];
+		_mm_storeu_pd(lanes, _mm_add_pd(lo, hi));
+		return lanes[0] + lanes[1] + SquaredErrorScalar(a + i, b + i, count - i);
+	}
+
+	void SSIM_SSE2(const float *mu_a, const float *mu_b, const float *s_aa, const float *s_bb, const float *s_ab, unsigned count, double *ssim, double *cs) {
+		const __m128 c1 = _mm_set1_ps(kC1), c2 = _mm_set1_ps(kC2), two = _mm_set1_ps(2.0f);
+		__m128d ssim_lo = _mm_setzero_pd(), ssim_hi = _mm_setzero_pd(), cs_lo = _mm_setzero_pd(), cs_hi = _mm_setzero_pd();
+		unsigned i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const __m128 ma = _mm_loadu_ps(mu_a + i), mb = _mm_loadu_ps(mu_b + i);
+			const __m128 mu_aa = _mm_mul_ps(ma, ma), mu_bb = _mm_mul_ps(mb, mb), mu_ab = _mm_mul_ps(ma, mb);
+			const __m128 luminance = _mm_div_ps(_mm_add_ps(_mm_mul_ps(two, mu_ab), c1), _mm_add_ps(_mm_add_ps(mu_aa, mu_bb), c1));
+			const __m128 var_a = _mm_sub_ps(_mm_loadu_ps(s_aa + i), mu_aa), var_b = _mm_sub_ps(_mm_loadu_ps(s_bb + i), mu_bb);
+			const __m128 covar = _mm_sub_ps(_mm_loadu_ps(s_ab + i), mu_ab);
+			const __m128 c = _mm_div_ps(_mm_add_ps(_mm_mul_ps(two, covar), c2), _mm_add_ps(_mm_add_ps(var_a, var_b), c2));
+			const __m128 s = _mm_mul_ps(luminance, c);
+			ssim_lo = _mm_add_pd(ssim_lo, _mm_cvtps_pd(s));
+			ssim_hi = _mm_add_pd(ssim_hi, _mm_cvtps_pd(_mm_movehl_ps(s, s)));
+			cs_lo = _mm_add_pd(cs_lo, _mm_cvtps_pd(c));
+			cs_hi = _mm_add_pd(cs_hi, _mm_cvtps_pd(_mm_movehl_ps(c, c)));
+		}
+		double lanes[2];
+		_mm_storeu_pd(lanes, _mm_add_pd(ssim_lo, ssim_hi));
+		*ssim += lanes[0] + lanes[1];
+		_mm_storeu_pd(lanes, _mm_add_pd(cs_lo, cs_hi));
+		*cs += lanes[0] + lanes[1];
+		SSIMScalar(mu_a + i, mu_b + i, s_aa + i, s_bb + i, s_ab + i, count - i, ssim, cs);
+	}
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+	void MultiplyAdd_NEON(float *dst, const float *src, float weight, unsigned count) {
+		const float32x4_t w = vdupq_n_f32(weight);
+		unsigned i = 0;
+		for (; i + 4 <= count; i += 4) {
+			vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_f32(w, vld1q_f32(src + i))));
+		}
+		MultiplyAddScalar(dst + i, src + i, weight, count - i);
+	}
+
+	/// See SquaredError_SSE2, 4 float lanes are flushed to double every 4 pixels
+	double SquaredError_NEON(const float *a, const float *b, unsigned count) {
+		double sum = 0;
+		unsigned i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const float32x4_t d = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+			const float32x4_t d2 = vmulq_f32(d, d);
+			sum += (double)vgetq_lane_f32(d2, 0) + (double)vgetq_lane_f32(d2, 1) + (double)vgetq_lane_f32(d2, 2) + (double)vgetq_lane_f32(d2, 3);
+		}
+		return sum + SquaredErrorScalar(a + i, b + i, count - i);
+	}
+#endif // FREEIMAGE_SIMD_NEON
+
+	std::atomic<MultiplyAddKernel> gMultiplyAdd{ MultiplyAddScalar };
+	std::atomic<SquaredErrorKernel> gSquaredError{ SquaredErrorScalar };
+	std::atomic<SSIMKernel> gSSIM{ SSIMScalar };
+
+	void SelectMetricKernels(uint32_t features) {
+		MultiplyAddKernel multiply_add = MultiplyAddScalar;
+		SquaredErrorKernel squared_error = SquaredErrorScalar;
+		SSIMKernel ssim = SSIMScalar;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			multiply_add = MultiplyAdd_SSE2;
+			squared_error = SquaredError_SSE2;
+			ssim = SSIM_SSE2;
+		}
+#elif FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			multiply_add = MultiplyAdd_NEON;
+			squared_error = SquaredError_NEON;
+		}
+#endif
+		gMultiplyAdd.store(multiply_add, std::memory_order_relaxed);
+		gSquaredError.store(squared_error, std::memory_order_relaxed);
+		gSSIM.store(ssim, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectMetricKernels);
+
+	// ----------------------------------------------------------
+	//  Channel planes
+	// ----------------------------------------------------------
+
+	/**
+	Describes the channels of an image type: number of channels, and the conversion of channel c of a row to floats
+	*/
+	struct Layout {
+		unsigned channels = 0;
+		void (*convert)(float *dst, const uint8_t *row, unsigned width, unsigned channel) = nullptr;
+	};
+
+	/// Channel c of pixels of n samples of type T, v * scale + offset
+	template <typename T, unsigned n>
+	void ConvertSamples(float *dst, const uint8_t *row, unsigned width, unsigned channel, double scale, double offset) {
+		const T *p = (const T *)row + channel;
+		for (unsigned x = 0; x < width; x++, p += n) {
+			dst[x] = (float)(*p * scale + offset);
+		}
+	}
+
+	template <typename T, unsigned n>
+	void ConvertUnsigned(float *dst, const uint8_t *row, unsigned width, unsigned channel) {
+		ConvertSamples<T, n>(dst, row, width, channel, 1.0 / std::numeric_limits<T>::max(), 0);
+	}
+
+	template <typename T, unsigned n>
+	void ConvertSigned(float *dst, const uint8_t *row, unsigned width, unsigned channel) {
+		const double range = (double)std::numeric_limits<T>::max() - std::numeric_limits<T>::min();
+		ConvertSamples<T, n>(dst, row, width, channel, 1.0 / range, -(double)std::numeric_limits<T>::min() / range);
+	}
+
+	template <typename T, unsigned n>
+	void ConvertFloat(float *dst, const uint8_t *row, unsigned width, unsigned channel) {
+		ConvertSamples<T, n>(dst, row, width, channel, 1.0, 0);
+	}
+
+	/// 24 and 32-bit bitmaps, channels in RGB(A) order
+	template <unsigned n>
+	void ConvertBitmap(float *dst, const uint8_t *row, unsigned width, unsigned channel) {
+		static const unsigned kOffsets[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+		const uint8_t *p = row + kOffsets[channel];
+		for (unsigned x = 0; x < width; x++, p += n) {
+			dst[x] = *p * (1.0f / 255);
+		}
+	}
+
+	void ConvertHalf(float *dst, const uint8_t *row, unsigned width, unsigned channel) {
+		const uint16_t *p = (const uint16_t *)row + channel;
+		for (unsigned x = 0; x < width; x++, p += 4) {
+			dst[x] = HalfToFloat(*p);
+		}
+	}
+
+	Layout GetLayout(FIBITMAP *dib) {
+		switch (FreeImage_GetImageType(dib)) {
+			case FIT_BITMAP:
+				switch (FreeImage_GetBPP(dib)) {
+					case 8:
+						// indices of a palette can't be compared
+						if (FreeImage_GetColorType(dib) == FIC_MINISBLACK) {
+							return { 1, ConvertUnsigned<uint8_t, 1> };
+						}
+						return {};
+					case 24:
+						return { 3, ConvertBitmap<3> };
+					case 32:
+						return { 4, ConvertBitmap<4> };
+					default:
+						return {};
+				}
+			case FIT_UINT16:
+				return { 1, ConvertUnsigned<uint16_t, 1> };
+			case FIT_INT16:
+				return { 1, ConvertSigned<int16_t, 1> };
+			case FIT_UINT32:
+				return { 1, ConvertUnsigned<uint32_t, 1> };
+			case FIT_INT32:
+				return { 1, ConvertSigned<int32_t, 1> };
+			case FIT_FLOAT:
+				return { 1, ConvertFloat<float, 1> };
+			case FIT_DOUBLE:
+				return { 1, ConvertFloat<double, 1> };
+			case FIT_COMPLEX:
+				return { 2, ConvertFloat<double, 2> };
+			case FIT_COMPLEXF:
+				return { 2, ConvertFloat<float, 2> };
+			case FIT_RGB16:
+				return { 3, ConvertUnsigned<uint16_t, 3> };
+			case FIT_RGBA16:
+				return { 4, ConvertUnsigned<uint16_t, 4> };
+			case FIT_RGB32:
+				return { 3, ConvertUnsigned<uint32_t, 3> };
+			case FIT_RGBA32:
+				return { 4, ConvertUnsigned<uint32_t, 4> };
+			case FIT_RGBF:
+				return { 3, ConvertFloat<float, 3> };
+			case FIT_RGBAF:
+				return { 4, ConvertFloat<float, 4> };
+			case FIT_RGBAH:
+				return { 4, ConvertHalf };
+			default:
+				return {};
+		}
+	}
+
+	void ExtractPlane(FIBITMAP *dib, const Layout& layout, unsigned channel, Plane& plane) {
+		plane.width = FreeImage_GetWidth(dib);
+		plane.height = FreeImage_GetHeight(dib);
+		plane.samples.resize((size_t)plane.width * plane.height);
+		const uint8_t *bits = FreeImage_GetConstBits(dib);
+		const unsigned pitch = FreeImage_GetPitch(dib);
+		ParallelFor(0, plane.height, CalculateBandRows((size_t)plane.width * sizeof(float)), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				layout.convert(plane.samples.data() + (size_t)plane.width * y, bits + (size_t)pitch * y, plane.width, channel);
+			}
+		});
+	}
+
+	/// Halves a plane by averaging 2 x 2 blocks, a last odd row or column is dropped
+	void Downsample(const Plane& src, Plane& dst) {
+		dst.width = src.width / 2;
+		dst.height = src.height / 2;
+		dst.samples.resize((size_t)dst.width * dst.height);
+		ParallelFor(0, dst.height, CalculateBandRows((size_t)src.width * 2 * sizeof(float)), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				const float *top = src.Row(2 * y), *bottom = src.Row(2 * y + 1);
+				float *out = dst.samples.data() + (size_t)dst.width * y;
+				for (unsigned x = 0; x < dst.width; x++) {
+					out[x] = ((top[2 * x] + top[2 * x + 1]) + (bottom[2 * x] + bottom[2 * x + 1])) * 0.25f;
+				}
+			}
+		});
+	}
+
+	// ----------------------------------------------------------
+	//  Metrics of a plane
+	// ----------------------------------------------------------
+
+	double MeanSquaredError(const Plane& a, const Plane& b) {
+		std::vector<double> rows(a.height);
+		const SquaredErrorKernel squared_error = gSquaredError.load(std::memory_order_relaxed);
+		ParallelFor(0, a.height, CalculateBandRows((size_t)a.width * 2 * sizeof(float)), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				rows[y] = squared_error(a.Row(y), b.Row(y), a.width);
+			}
+		});
+		double sum = 0;
+		for (double row : rows) {
+			sum += row;
+		}
+		return sum / ((double)a.width * a.height);
+	}
+
+	/**
+	Computes the means of the SSIM and contrast-structure maps of two planes.
+	A band filters its rows and the rows of its vertical halo horizontally (the 5 window quantities a, b, a^2, b^2, ab),
+	then filters the columns and accumulates the maps row by row.
+	*/
+	void StructuralSimilarity(const Plane& a, const Plane& b, double& ssim, double& cs) {
+		const unsigned width = a.width, height = a.height;
+		float weights[kWindowSize];
+		double total = 0;
+		for (unsigned i = 0; i < kWindowSize; i++) {
+			const double d = (double)i - kWindowRadius;
+			total += weights[i] = (float)std::exp(-d * d / (2 * 1.5 * 1.5));
+		}
+		for (float &w : weights) {
+			w = (float)(w / total);
+		}
+
+		const MultiplyAddKernel multiply_add = gMultiplyAdd.load(std::memory_order_relaxed);
+		const SSIMKernel ssim_row = gSSIM.load(std::memory_order_relaxed);
+		std::vector<double> ssim_rows(height), cs_rows(height);
+		const unsigned band_rows = std::max(16U, CalculateBandRows((size_t)width * 5 * sizeof(float)));
+
+		ParallelFor(0, height, band_rows, [&](unsigned first, unsigned last) {
+			const unsigned rows = last - first + 2 * kWindowRadius;
+			const size_t padded = (size_t)width + 2 * kWindowRadius;
+			// horizontally filtered quantities of the band and halo rows, quantity q of row r at (q * rows + r) * width
+			std::vector<float> filtered((size_t)5 * rows * width, 0.0f);
+			std::vector<float> line((size_t)5 * padded);
+			for (unsigned r = 0; r < rows; r++) {
+				const int y = std::clamp((int)(first + r) - (int)kWindowRadius, 0, (int)height - 1);
+				const float *pa = a.Row(y), *pb = b.Row(y);
+				float *qa = line.data(), *qb = qa + padded, *qaa = qb + padded, *qbb = qaa + padded, *qab = qbb + padded;
+				for (size_t x = 0; x < padded; x++) {
+					const unsigned sx = (unsigned)std::clamp((int)x - (int)kWindowRadius, 0, (int)width - 1);
+					const float va = pa[sx], vb = pb[sx];
+					qa[x] = va;
+					qb[x] = vb;
+					qaa[x] = va * va;
+					qbb[x] = vb * vb;
+					qab[x] = va * vb;
+				}
+				for (unsigned q = 0; q < 5; q++) {
+					float *out = filtered.data() + ((size_t)q * rows + r) * width;
+					for (unsigned k = 0; k < kWindowSize; k++) {
+						multiply_add(out, line.data() + q * padded + k, weights[k], width);
+					}
+				}
+			}
+			std::vector<float> window((size_t)5 * width);
+			for (unsigned y = first; y < last; y++) {
+				std::fill(window.begin(), window.end(), 0.0f);
+				for (unsigned q = 0; q < 5; q++) {
+					for (unsigned k = 0; k < kWindowSize; k++) {
+						multiply_add(window.data() + (size_t)q * width, filtered.data() + ((size_t)q * rows + (y - first) + k) * width, weights[k], width);
+					}
+				}
+				const float *w = window.data();
+				ssim_rows[y] = cs_rows[y] = 0;
+				ssim_row(w, w + width, w + 2 * width, w + 3 * width, w + 4 * width, width, &ssim_rows[y], &cs_rows[y]);
+			}
+		});
+
+		ssim = cs = 0;
+		for (unsigned y = 0; y < height; y++) {
+			ssim += ssim_rows[y];
+			cs += cs_rows[y];
+		}
+		ssim /= (double)width * height;
+		cs /= (double)width * height;
+	}
+
+	double MultiScaleSSIM(Plane a, Plane b) {
+		// scales whose window still fits, at least one
+		unsigned scales = 1;
+		while ((scales < 5) && (std::min(a.width, a.height) >> scales) >= kWindowSize) {
+			scales++;
+		}
+		double weight_sum = 0;
+		for (unsigned s = 0; s < scales; s++) {
+			weight_sum += kScaleWeights[s];
+		}
+
+		double result = 1;
+		for (unsigned s = 0; s < scales; s++) {
+			double ssim, cs;
+			StructuralSimilarity(a, b, ssim, cs);
+			const double weight = kScaleWeights[s] / weight_sum;
+			// the last scale contributes its luminance too
+			result *= std::pow(std::max(0.0, (s + 1 == scales) ? ssim : cs), weight);
+			if (s + 1 < scales) {
+				Plane half_a, half_b;
+				Downsample(a, half_a);
+				Downsample(b, half_b);
+				a = std::move(half_a);
+				b = std::move(half_b);
+			}
+		}
+		return result;
+	}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+/**
+Compares two images of the same type and size.
+@param a Reference image
+@param b Compared image
+@param metric FIMETRIC_PSNR, FIMETRIC_SSIM or FIMETRIC_MSSSIM
+@param channels When not NULL, receives the metric of every channel (at most 4)
+@return Returns the metric over all channels, -1 if the images can't be compared
+*/
+double DLL_CALLCONV
+FreeImage_ComputeMetric(FIBITMAP *a, FIBITMAP *b, FREE_IMAGE_METRIC metric, double *channels) {
+	if (!FreeImage_HasPixels(a) || !FreeImage_HasPixels(b)) {
+		return -1;
+	}
+	if ((FreeImage_GetImageType(a) != FreeImage_GetImageType(b)) || (FreeImage_GetBPP(a) != FreeImage_GetBPP(b))
+		|| (FreeImage_GetWidth(a) != FreeImage_GetWidth(b)) || (FreeImage_GetHeight(a) != FreeImage_GetHeight(b))) {
+		return -1;
+	}
+	if ((metric < FIMETRIC_PSNR) || (metric > FIMETRIC_MSSSIM)) {
+		return -1;
+	}
+	const Layout layout = GetLayout(a);
+	if (!layout.channels || (GetLayout(b).convert != layout.convert)) {
+		return -1;
+	}
+
+	double values[4] = {};
+	double mse_sum = 0, value_sum = 0;
+	Plane plane_a, plane_b;
+	for (unsigned c = 0; c < layout.channels; c++) {
+		ExtractPlane(a, layout, c, plane_a);
+		ExtractPlane(b, layout, c, plane_b);
+		switch (metric) {
+			case FIMETRIC_PSNR:
+			{
+				const double mse = MeanSquaredError(plane_a, plane_b);
+				mse_sum += mse;
+				values[c] = (mse > 0) ? 10 * std::log10(1 / mse) : std::numeric_limits<double>::infinity();
+				break;
+			}
+			case FIMETRIC_SSIM:
+			{
+				double cs;
+				StructuralSimilarity(plane_a, plane_b, values[c], cs);
+				break;
+			}
+			default:
+				values[c] = MultiScaleSSIM(plane_a, plane_b);
+				break;
+		}
+		value_sum += values[c];
+	}
+
+	if (channels) {
+		std::copy(values, values + layout.channels, channels);
+	}
+	if (metric == FIMETRIC_PSNR) {
+		const double mse = mse_sum / layout.channels;
+		return (mse > 0) ? 10 * std::log10(1 / mse) : std::numeric_limits<double>::infinity();
+	}
+	return value_sum / layout.channels;
+}
@@ -25,11 +25,190 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "../FreeImage/CPUDispatch.h"
+#include <atomic>
 
 static const int NPRE	= 1;		// Number of relaxation sweeps before ...
 static const int NPOST	= 1;		// ... and after the coarse-grid correction is computed
 static const int NGMAX	= 15;		// Maximum number of grids
 
+// --------------------------------------------------------------------------
+// Row stencils
+// Grid operators process rows by parallel bands, a row is computed by a SIMD kernel
+// then the remaining columns by the scalar code. A red or black sweep only reads cells of the other color,
+// so its rows are independent and results do not depend on the number of threads.
+// --------------------------------------------------------------------------
+
+namespace {
+
+	/**
+	Gauss-Seidel update of the columns col, col + 2, ... < end of a row u, next and prev are the rows above and below.
+	Returns the first column not processed.
+	*/
+	using RelaxRowKernel = int (*)(float *u, const float *next, const float *prev, const float *rhs, int col, int end, float h2);
+
+	/**
+	Minus the residual of the columns 1 ... < end of a row. Returns the first column not processed.
+	*/
+	using ResidualRowKernel = int (*)(float *res, const float *u, const float *next, const float *prev, const float *rhs, int end, float h2i);
+
+	/**
+	Half-weighting of the fine row uf into the coarse columns 1 ... < end of uc. Returns the first column not processed.
+	*/
+	using RestrictRowKernel = int (*)(float *uc, const float *uf, const float *next, const float *prev, int end);
+
+	void RelaxRow(float *u, const float *next, const float *prev, const float *rhs, int col, int end, float h2) {
+		for (; col < end; col += 2) {
+			float value = next[col] + prev[col] + u[col + 1] + u[col - 1];
+			value -= h2 * rhs[col];
+			u[col] = value * 0.25F;
+		}
+	}
+
+	void ResidualRow(float *res, const float *u, const float *next, const float *prev, const float *rhs, int col, int end, float h2i) {
+		for (; col < end; col++) {
+			float value = next[col] + prev[col] + u[col + 1] + u[col - 1] - 4 * u[col];
+			value *= -h2i;
+			res[col] = value + rhs[col];
+		}
+	}
+
+	void RestrictRow(float *uc, const float *uf, const float *next, const float *prev, int col, int end) {
+		for (; col < end; col++) {
+			const int col_uf = 2 * col;
+			uc[col] = 0.5F * uf[col_uf] + 0.125F * (next[col_uf] + prev[col_uf] + uf[col_uf + 1] + uf[col_uf - 1]);
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+
+	int RelaxRow_SSE2(float *u, const float *next, const float *prev, const float *rhs, int col, int end, float h2) {
+		const __m128 vh2 = _mm_set1_ps(h2);
+		const __m128 quarter = _mm_set1_ps(0.25F);
+		for (; col + 4 <= end; col += 4) {
+			__m128 value = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_loadu_ps(next + col), _mm_loadu_ps(prev + col)), _mm_loadu_ps(u + col + 1)), _mm_loadu_ps(u + col - 1));
+			value = _mm_mul_ps(_mm_sub_ps(value, _mm_mul_ps(vh2, _mm_loadu_ps(rhs + col))), quarter);
+			// lanes 0 and 2 are the cells of the sweep, cells of the other color may be read by the neighbour bands
+			_mm_store_ss(u + col, value);
+			_mm_store_ss(u + col + 2, _mm_movehl_ps(value, value));
+		}
+		return col;
+	}
+
+	int ResidualRow_SSE2(float *res, const float *u, const float *next, const float *prev, const float *rhs, int end, float h2i) {
+		const __m128 four = _mm_set1_ps(4.0F);
+		const __m128 minus_h2i = _mm_set1_ps(-h2i);
+		int col = 1;
+		for (; col + 4 <= end; col += 4) {
+			__m128 value = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_loadu_ps(next + col), _mm_loadu_ps(prev + col)), _mm_loadu_ps(u + col + 1)), _mm_loadu_ps(u + col - 1));
+			value = _mm_sub_ps(value, _mm_mul_ps(four, _mm_loadu_ps(u + col)));
+			_mm_storeu_ps(res + col, _mm_add_ps(_mm_mul_ps(value, minus_h2i), _mm_loadu_ps(rhs + col)));
+		}
+		return col;
+	}
+
+	int RestrictRow_SSE2(float *uc, const float *uf, const float *next, const float *prev, int end) {
+		const __m128 half = _mm_set1_ps(0.5F);
+		const __m128 eighth = _mm_set1_ps(0.125F);
+		int col = 1;
+		// the last fine column read is 2 * col + 7 <= 2 * end - 1
+		for (; col + 4 <= end; col += 4) {
+			const int col_uf = 2 * col;
+			const __m128 lo = _mm_loadu_ps(uf + col_uf);
+			const __m128 hi = _mm_loadu_ps(uf + col_uf + 4);
+			const __m128 center = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 right = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+			const __m128 left = _mm_shuffle_ps(_mm_loadu_ps(uf + col_uf - 2), _mm_loadu_ps(uf + col_uf + 2), _MM_SHUFFLE(3, 1, 3, 1));
+			const __m128 up = _mm_shuffle_ps(_mm_loadu_ps(next + col_uf), _mm_loadu_ps(next + col_uf + 4), _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 down = _mm_shuffle_ps(_mm_loadu_ps(prev + col_uf), _mm_loadu_ps(prev + col_uf + 4), _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(up, down), right), left);
+			_mm_storeu_ps(uc + col, _mm_add_ps(_mm_mul_ps(half, center), _mm_mul_ps(eighth, sum)));
+		}
+		return col;
+	}
+
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+
+	int RelaxRow_NEON(float *u, const float *next, const float *prev, const float *rhs, int col, int end, float h2) {
+		const float32x4_t vh2 = vdupq_n_f32(h2);
+		const float32x4_t quarter = vdupq_n_f32(0.25F);
+		for (; col + 4 <= end; col += 4) {
+			float32x4_t value = vaddq_f32(vaddq_f32(vaddq_f32(vld1q_f32(next + col), vld1q_f32(prev + col)), vld1q_f32(u + col + 1)), vld1q_f32(u + col - 1));
+			value = vmulq_f32(vsubq_f32(value, vmulq_f32(vh2, vld1q_f32(rhs + col))), quarter);
+			vst1q_lane_f32(u + col, value, 0);
+			vst1q_lane_f32(u + col + 2, value, 2);
+		}
+		return col;
+	}
+
+	int ResidualRow_NEON(float *res, const float *u, const float *next, const float *prev, const float *rhs, int end, float h2i) {
+		const float32x4_t four = vdupq_n_f32(4.0F);
+		const float32x4_t minus_h2i = vdupq_n_f32(-h2i);
+		int col = 1;
+		for (; col + 4 <= end; col += 4) {
+			float32x4_t value = vaddq_f32(vaddq_f32(vaddq_f32(vld1q_f32(next + col), vld1q_f32(prev + col)), vld1q_f32(u + col + 1)), vld1q_f32(u + col - 1));
+			value = vsubq_f32(value, vmulq_f32(four, vld1q_f32(u + col)));
+			vst1q_f32(res + col, vaddq_f32(vmulq_f32(value, minus_h2i), vld1q_f32(rhs + col)));
+		}
+		return col;
+	}
+
+	int RestrictRow_NEON(float *uc, const float *uf, const float *next, const float *prev, int end) {
+		const float32x4_t half = vdupq_n_f32(0.5F);
+		const float32x4_t eighth = vdupq_n_f32(0.125F);
+		int col = 1;
+		for (; col + 4 <= end; col += 4) {
+			const int col_uf = 2 * col;
+			const float32x4x2_t row = vld2q_f32(uf + col_uf);
+			const float32x4x2_t row_left = vld2q_f32(uf + col_uf - 2);
+			const float32x4_t up = vld2q_f32(next + col_uf).val[0];
+			const float32x4_t down = vld2q_f32(prev + col_uf).val[0];
+			const float32x4_t sum = vaddq_f32(vaddq_f32(vaddq_f32(up, down), row.val[1]), row_left.val[1]);
+			vst1q_f32(uc + col, vaddq_f32(vmulq_f32(half, row.val[0]), vmulq_f32(eighth, sum)));
+		}
+		return col;
+	}
+
+#endif // FREEIMAGE_SIMD_NEON
+
+	std::atomic<RelaxRowKernel> gRelaxRow{ nullptr };
+	std::atomic<ResidualRowKernel> gResidualRow{ nullptr };
+	std::atomic<RestrictRowKernel> gRestrictRow{ nullptr };
+
+	void SelectMultigridKernels(uint32_t features) {
+		RelaxRowKernel relax = nullptr;
+		ResidualRowKernel residual = nullptr;
+		RestrictRowKernel restrict_row = nullptr;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			relax = RelaxRow_SSE2;
+			residual = ResidualRow_SSE2;
+			restrict_row = RestrictRow_SSE2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			relax = RelaxRow_NEON;
+			residual = ResidualRow_NEON;
+			restrict_row = RestrictRow_NEON;
+		}
+#endif
+		gRelaxRow.store(relax, std::memory_order_relaxed);
+		gResidualRow.store(residual, std::memory_order_relaxed);
+		gRestrictRow.store(restrict_row, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectMultigridKernels);
+
+	/// Rows of n floats per parallel band, coarse grids are processed by a single band
+	unsigned GridBandRows(int n) {
+		return CalculateBandRows((size_t)n * sizeof(float));
+	}
+
+} // namespace
+
 /**
 Copy src into dst
 */
@@ -59,19 +238,18 @@ static void fmg_restrict(FIBITMAP *UC, FIBITMAP *UF, int nc) {
 
 	// interior points
 	{
-		float *uc_scan = uc_bits + uc_pitch;
-		for (row_uc = 1, row_uf = 2; row_uc < nc-1; row_uc++, row_uf += 2) {
-			const float *uf_scan = uf_bits + row_uf * uf_pitch;
-			for (col_uc = 1, col_uf = 2; col_uc < nc-1; col_uc++, col_uf += 2) { 
-				// calculate 
-				// UC(row_uc, col_uc) = 
-				// 0.5 * UF(row_uf, col_uf) + 0.125 * [ UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) + UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) ]
-				float *uc_pixel = uc_scan + col_uc;
-				const float *uf_center = uf_scan + col_uf;
-				*uc_pixel = 0.5F * *uf_center + 0.125F * ( *(uf_center + uf_pitch) + *(uf_center - uf_pitch) + *(uf_center + 1) + *(uf_center - 1) );
+		// calculate 
+		// UC(row_uc, col_uc) = 
+		// 0.5 * UF(row_uf, col_uf) + 0.125 * [ UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) + UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) ]
+		const RestrictRowKernel kernel = gRestrictRow.load(std::memory_order_relaxed);
+		ParallelFor(1, MAX(nc-1, 1), GridBandRows(2*nc), [=](unsigned first, unsigned last) {
+			for (int row = (int)first; row < (int)last; row++) {
+				float *uc_scan = uc_bits + (size_t)row * uc_pitch;
+				const float *uf_scan = uf_bits + (size_t)(2 * row) * uf_pitch;
+				const int col = kernel ? kernel(uc_scan, uf_scan, uf_scan + uf_pitch, uf_scan - uf_pitch, nc-1) : 1;
+				RestrictRow(uc_scan, uf_scan, uf_scan + uf_pitch, uf_scan - uf_pitch, col, nc-1);
 			}
-			uc_scan += uc_pitch;
-		}
+		});
 	}
 	// boundary points
 	const int ncc = 2*nc-1;
@@ -130,50 +308,46 @@ solution is input as uc[0..nc-1][0..nc-1], where nc = nf/2 + 1. The fine-grid so
 returned in uf[0..nf-1][0..nf-1].
 */
 static void fmg_prolongate(FIBITMAP *UF, FIBITMAP *UC, int nf) {
-	int row_uc, row_uf, col_uc, col_uf;
-
 	const int uf_pitch  = FreeImage_GetPitch(UF) / sizeof(float);
 	const int uc_pitch  = FreeImage_GetPitch(UC) / sizeof(float);
 	
 	float *uf_bits = (float*)FreeImage_GetBits(UF);
 	const float *uc_bits = (float*)FreeImage_GetBits(UC);
 	
-	// do elements that are copies
-	{
-		const int nc = nf/2 + 1;
+	const int nc = nf/2 + 1;
+	const unsigned band_rows = GridBandRows(nf);
 
-		float *uf_scan = uf_bits;
-		const float *uc_scan = uc_bits;		
-		for (row_uc = 0; row_uc < nc; row_uc++) {
-			for (col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
+	// do elements that are copies
+	ParallelFor(0, nc, band_rows, [=](unsigned first, unsigned last) {
+		for (int row_uc = (int)first; row_uc < (int)last; row_uc++) {
+			float *uf_scan = uf_bits + (size_t)(2 * row_uc) * uf_pitch;
+			const float *uc_scan = uc_bits + (size_t)row_uc * uc_pitch;
+			for (int col_uc = 0, col_uf = 0; col_uc < nc; col_uc++, col_uf += 2) {
 				// calculate UF(2*row_uc, col_uf) = UC(row_uc, col_uc);
 				uf_scan[col_uf] = uc_scan[col_uc];
 			}
-			uc_scan += uc_pitch;
-			uf_scan += 2 * uf_pitch;
 		}
-	}
-	// do odd-numbered columns, interpolating vertically
-	{		
-		for (row_uf = 1; row_uf < nf-1; row_uf += 2) {
-			float *uf_scan = uf_bits + row_uf * uf_pitch;
-			for (col_uf = 0; col_uf < nf; col_uf += 2) {
+	});
+	// do odd-numbered rows, interpolating vertically the even-numbered columns,
+	// then all rows, interpolating horizontally the odd-numbered columns
+	ParallelFor(0, nc - 1, band_rows, [=](unsigned first, unsigned last) {
+		for (int k = (int)first; k < (int)last; k++) {
+			float *uf_scan = uf_bits + (size_t)(2 * k + 1) * uf_pitch;
+			for (int col_uf = 0; col_uf < nf; col_uf += 2) {
 				// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf+1, col_uf) + UF(row_uf-1, col_uf) )
 				uf_scan[col_uf] = 0.5F * ( *(uf_scan + uf_pitch + col_uf) + *(uf_scan - uf_pitch + col_uf) );
 			}
 		}
-	}
-	// do even-numbered columns, interpolating horizontally
-	{
-		float *uf_scan = uf_bits;
-		for (row_uf = 0; row_uf < nf; row_uf++) {
-			for (col_uf = 1; col_uf < nf-1; col_uf += 2) {
+	});
+	ParallelFor(0, nf, band_rows, [=](unsigned first, unsigned last) {
+		for (int row_uf = (int)first; row_uf < (int)last; row_uf++) {
+			float *uf_scan = uf_bits + (size_t)row_uf * uf_pitch;
+			for (int col_uf = 1; col_uf < nf-1; col_uf += 2) {
 				// calculate UF(row_uf, col_uf) = 0.5 * ( UF(row_uf, col_uf+1) + UF(row_uf, col_uf-1) )
 				uf_scan[col_uf] = 0.5F * ( uf_scan[col_uf + 1] + uf_scan[col_uf - 1] );
 			}
-			uf_scan += uf_pitch;
 		}
-	}
+	});
 }
 
 /**
@@ -181,7 +355,6 @@ Red-black Gauss-Seidel relaxation for model problem. Updates the current value o
 u[0..n-1][0..n-1], using the right-hand side function rhs[0..n-1][0..n-1].
 */
 static void fmg_relaxation(FIBITMAP *U, FIBITMAP *RHS, int n) {
-	int row, col, ipass, isw, jsw;
 	const float h = 1.0F / (n - 1);
 	const float h2 = h*h;
 
@@ -191,23 +364,22 @@ static void fmg_relaxation(FIBITMAP *U, FIBITMAP *RHS, int n) {
 	float *u_bits = (float*)FreeImage_GetBits(U);
 	const float *rhs_bits = (float*)FreeImage_GetBits(RHS);
 
-	for (ipass = 0, jsw = 1; ipass < 2; ipass++, jsw = 3-jsw) { // Red and black sweeps
-		float *u_scan = u_bits + u_pitch;
-		const float *rhs_scan = rhs_bits + rhs_pitch;
-		for (row = 1, isw = jsw; row < n-1; row++, isw = 3-isw) {
-			for (col = isw; col < n-1; col += 2) { 
-				// Gauss-Seidel formula
-				// calculate U(row, col) = 
-				// 0.25 * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - h2 * RHS(row, col) ]		 
-				float *u_center = u_scan + col;
-				const float *rhs_center = rhs_scan + col;
-				*u_center = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1);
-				*u_center -= h2 * *rhs_center;
-				*u_center *= 0.25F;
+	const RelaxRowKernel kernel = gRelaxRow.load(std::memory_order_relaxed);
+
+	for (int ipass = 0, jsw = 1; ipass < 2; ipass++, jsw = 3-jsw) { // Red and black sweeps
+		// Gauss-Seidel formula
+		// calculate U(row, col) = 
+		// 0.25 * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - h2 * RHS(row, col) ]
+		ParallelFor(1, MAX(n-1, 1), GridBandRows(n), [=](unsigned first, unsigned last) {
+			for (int row = (int)first; row < (int)last; row++) {
+				// first column of the sweep is jsw on odd rows, 3-jsw on even rows
+				const int isw = (row & 1) ? jsw : 3-jsw;
+				float *u_scan = u_bits + (size_t)row * u_pitch;
+				const float *rhs_scan = rhs_bits + (size_t)row * rhs_pitch;
+				const int col = kernel ? kernel(u_scan, u_scan + u_pitch, u_scan - u_pitch, rhs_scan, isw, n-1, h2) : isw;
+				RelaxRow(u_scan, u_scan + u_pitch, u_scan - u_pitch, rhs_scan, col, n-1, h2);
 			}
-			u_scan += u_pitch;
-			rhs_scan += rhs_pitch;
-		}
+		});
 	}
 }
 
@@ -216,8 +388,6 @@ Returns minus the residual for the model problem. Input quantities are u[0..n-1]
 rhs[0..n-1][0..n-1], while res[0..n-1][0..n-1] is returned.
 */
 static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
-	int row, col;
-
 	const float h = 1.0F / (n-1);	
 	const float h2i = 1.0F / (h*h);
 
@@ -231,24 +401,18 @@ static void fmg_residual(FIBITMAP *RES, FIBITMAP *U, FIBITMAP *RHS, int n) {
 
 	// interior points
 	{
-		float *res_scan = res_bits + res_pitch;
-		const float *u_scan = u_bits + u_pitch;
-		const float *rhs_scan = rhs_bits + rhs_pitch;
-		for (row = 1; row < n-1; row++) {
-			for (col = 1; col < n-1; col++) {
-				// calculate RES(row, col) = 
-				// -h2i * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - 4 * U(row, col) ] + RHS(row, col);
-				float *res_center = res_scan + col;
-				const float *u_center = u_scan + col;
-				const float *rhs_center = rhs_scan + col;
-				*res_center = *(u_center + u_pitch) + *(u_center - u_pitch) + *(u_center + 1) + *(u_center - 1) - 4 * *u_center;
-				*res_center *= -h2i;
-				*res_center += *rhs_center;
+		// calculate RES(row, col) = 
+		// -h2i * [ U(row+1, col) + U(row-1, col) + U(row, col+1) + U(row, col-1) - 4 * U(row, col) ] + RHS(row, col);
+		const ResidualRowKernel kernel = gResidualRow.load(std::memory_order_relaxed);
+		ParallelFor(1, MAX(n-1, 1), GridBandRows(n), [=](unsigned first, unsigned last) {
+			for (int row = (int)first; row < (int)last; row++) {
+				float *res_scan = res_bits + (size_t)row * res_pitch;
+				const float *u_scan = u_bits + (size_t)row * u_pitch;
+				const float *rhs_scan = rhs_bits + (size_t)row * rhs_pitch;
+				const int col = kernel ? kernel(res_scan, u_scan, u_scan + u_pitch, u_scan - u_pitch, rhs_scan, n-1, h2i) : 1;
+				ResidualRow(res_scan, u_scan, u_scan + u_pitch, u_scan - u_pitch, rhs_scan, col, n-1, h2i);
 			}
-			res_scan += res_pitch;
-			u_scan += u_pitch;
-			rhs_scan += rhs_pitch;
-		}
+		});
 	}
 
 	// boundary points
@@ -280,14 +444,16 @@ static void fmg_addint(FIBITMAP *UF, FIBITMAP *UC, FIBITMAP *RES, int nf) {
 	float *uf_bits = (float*)FreeImage_GetBits(UF);
 	const float *res_bits = (float*)FreeImage_GetBits(RES);
 
-	for (int row = 0; row < nf; row++) {
-		for (int col = 0; col < nf; col++) {
-			// calculate UF(row, col) = UF(row, col) + RES(row, col);
-			uf_bits[col] += res_bits[col];
+	ParallelFor(0, nf, GridBandRows(nf), [=](unsigned first, unsigned last) {
+		for (int row = (int)first; row < (int)last; row++) {
+			float *uf_scan = uf_bits + (size_t)row * uf_pitch;
+			const float *res_scan = res_bits + (size_t)row * res_pitch;
+			for (int col = 0; col < nf; col++) {
+				// calculate UF(row, col) = UF(row, col) + RES(row, col);
+				uf_scan[col] += res_scan[col];
+			}
 		}
-		uf_bits += uf_pitch;
-		res_bits += res_pitch;
-	}
+	});
 }
 
 /**
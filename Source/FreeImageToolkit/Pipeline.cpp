@@ -0,0 +1,493 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <vector>
+
+
+namespace {
+
+	enum class OperationKind
+	{
+		ConvertTo24Bits,
+		ConvertTo32Bits,
+		Rescale,
+		Curve,
+		Invert,
+		PreMultiplyWithAlpha,
+		UnsharpMask
+	};
+
+	/**
+	One recorded operation
+	*/
+	struct Operation
+	{
+		OperationKind kind;
+		int width{ 0 };
+		int height{ 0 };
+		FREE_IMAGE_FILTER filter{ FILTER_BOX };
+		FREE_IMAGE_COLOR_CHANNEL channel{ FICC_RGB };
+		std::array<uint8_t, 256> lut{};
+		double sigma{ 0 };
+		double amount{ 0 };
+	};
+
+	struct Pipeline
+	{
+		std::vector<Operation> operations;
+	};
+
+	/**
+	Point operation applied to every pixel of a scanline.
+	Consecutive curves and inversions are composed into one table per byte of the pixel.
+	*/
+	struct PointKernel
+	{
+		bool premultiply{ false };
+		std::array<std::array<uint8_t, 256>, 4> luts;
+
+		PointKernel() {
+			for (auto &lut : luts) {
+				for (unsigned i = 0; i < 256; i++) {
+					lut[i] = (uint8_t)i;
+				}
+			}
+		}
+
+		void Compose(unsigned byte, const std::array<uint8_t, 256> &lut) {
+			for (auto &value : luts[byte]) {
+				value = lut[value];
+			}
+		}
+
+		void Apply(uint8_t *bits, unsigned width, unsigned bytespp) const {
+			if (premultiply) {
+				for (unsigned x = 0; x < width; x++, bits += 4) {
+					const uint8_t alpha = bits[FI_RGBA_ALPHA];
+					if (alpha == 0x00) {
+						bits[FI_RGBA_BLUE] = 0x00;
+						bits[FI_RGBA_GREEN] = 0x00;
+						bits[FI_RGBA_RED] = 0x00;
+					} else if (alpha != 0xFF) {
+						bits[FI_RGBA_BLUE] = (uint8_t)((alpha * (uint16_t)bits[FI_RGBA_BLUE] + 127) / 255);
+						bits[FI_RGBA_GREEN] = (uint8_t)((alpha * (uint16_t)bits[FI_RGBA_GREEN] + 127) / 255);
+						bits[FI_RGBA_RED] = (uint8_t)((alpha * (uint16_t)bits[FI_RGBA_RED] + 127) / 255);
+					}
+				}
+			} else if (bytespp == 4) {
+				for (unsigned x = 0; x < width; x++, bits += 4) {
+					bits[0] = luts[0][bits[0]];
+					bits[1] = luts[1][bits[1]];
+					bits[2] = luts[2][bits[2]];
+					bits[3] = luts[3][bits[3]];
+				}
+			} else {
+				for (unsigned x = 0; x < width; x++, bits += 3) {
+					bits[0] = luts[0][bits[0]];
+					bits[1] = luts[1][bits[1]];
+					bits[2] = luts[2][bits[2]];
+				}
+			}
+		}
+	};
+
+	/**
+	Step of an executed pipeline: either a rescale, an unsharp mask or a streaming pass of point operations.
+	A point pass converts its input into the output bit depth if needed, then runs its kernels
+	on the same rows while they are still in the cache.
+	*/
+	struct Pass
+	{
+		bool rescale{ false };
+		bool sharpen{ false };
+		double sigma{ 0 };
+		double amount{ 0 };
+		int width{ 0 };
+		int height{ 0 };
+		FREE_IMAGE_FILTER filter{ FILTER_BOX };
+		unsigned bpp{ 0 };
+		bool convert{ false };
+		std::vector<PointKernel> kernels;
+	};
+
+	Pipeline* ToPipeline(FIPIPELINE *pipeline) {
+		return pipeline ? static_cast<Pipeline*>(pipeline->data) : nullptr;
+	}
+
+	FIBOOL Record(FIPIPELINE *handle, const Operation &operation) {
+		Pipeline *pipeline = ToPipeline(handle);
+		if (!pipeline) {
+			return FALSE;
+		}
+		try {
+			pipeline->operations.push_back(operation);
+			return TRUE;
+		}
+		catch (const std::bad_alloc &) {
+			FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+			return FALSE;
+		}
+	}
+
+	PointKernel& LastLutKernel(Pass &pass) {
+		if (pass.kernels.empty() || pass.kernels.back().premultiply) {
+			pass.kernels.emplace_back();
+		}
+		return pass.kernels.back();
+	}
+
+	/**
+	Turns the recorded operations into passes for a source of the given bit depth.
+	Returns false with a message if an operation does not apply to the image it receives.
+	*/
+	bool Compile(const Pipeline &pipeline, unsigned src_bpp, std::vector<Pass> &passes) {
+		unsigned bpp = src_bpp;
+
+		auto require = [&bpp](bool alpha) {
+			if ((bpp == 32) || (!alpha && (bpp == 24))) {
+				return true;
+			}
+			FreeImage_OutputMessageProc(FIF_UNKNOWN, alpha
+				? "FreeImage_ExecutePipeline: operation requires a 32-bit image"
+				: "FreeImage_ExecutePipeline: operation requires a 24 or 32-bit image");
+			return false;
+		};
+
+		// point pass receiving the next point operation, starts a new pass after a rescale or an unsharp mask
+		auto point_pass = [&]() -> Pass& {
+			if (passes.empty() || passes.back().rescale || passes.back().sharpen) {
+				Pass pass;
+				pass.bpp = bpp;
+				passes.push_back(std::move(pass));
+			}
+			return passes.back();
+		};
+
+		for (const Operation &operation : pipeline.operations) {
+			switch (operation.kind) {
+				case OperationKind::ConvertTo24Bits:
+				case OperationKind::ConvertTo32Bits:
+				{
+					// a conversion reads the whole pixel, it can only start a pass
+					Pass pass;
+					pass.bpp = (operation.kind == OperationKind::ConvertTo24Bits) ? 24 : 32;
+					pass.convert = true;
+					bpp = pass.bpp;
+					passes.push_back(std::move(pass));
+					break;
+				}
+				case OperationKind::Rescale:
+				{
+					if (!require(false)) {
+						return false;
+					}
+					Pass pass;
+					pass.rescale = true;
+					pass.width = operation.width;
+					pass.height = operation.height;
+					pass.filter = operation.filter;
+					pass.bpp = bpp;
+					passes.push_back(std::move(pass));
+					break;
+				}
+				case OperationKind::UnsharpMask:
+				{
+					if (!require(false)) {
+						return false;
+					}
+					Pass pass;
+					pass.sharpen = true;
+					pass.sigma = operation.sigma;
+					pass.amount = operation.amount;
+					pass.bpp = bpp;
+					passes.push_back(std::move(pass));
+					break;
+				}
+				case OperationKind::Curve:
+				{
+					if (!require(false)) {
+						return false;
+					}
+					PointKernel &kernel = LastLutKernel(point_pass());
+					switch (operation.channel) {
+						case FICC_RGB:
+							kernel.Compose(FI_RGBA_BLUE, operation.lut);
+							kernel.Compose(FI_RGBA_GREEN, operation.lut);
+							kernel.Compose(FI_RGBA_RED, operation.lut);
+							break;
+						case FICC_RED:
+							kernel.Compose(FI_RGBA_RED, operation.lut);
+							break;
+						case FICC_GREEN:
+							kernel.Compose(FI_RGBA_GREEN, operation.lut);
+							break;
+						case FICC_BLUE:
+							kernel.Compose(FI_RGBA_BLUE, operation.lut);
+							break;
+						case FICC_ALPHA:
+							// like FreeImage_AdjustCurve, ignored for 24-bit images
+							if (bpp == 32) {
+								kernel.Compose(FI_RGBA_ALPHA, operation.lut);
+							}
+							break;
+						default:
+							break;
+					}
+					break;
+				}
+				case OperationKind::Invert:
+				{
+					if (!require(false)) {
+						return false;
+					}
+					PointKernel &kernel = LastLutKernel(point_pass());
+					for (unsigned byte = 0; byte < bpp / 8; byte++) {
+						kernel.Compose(byte, operation.lut);
+					}
+					break;
+				}
+				case OperationKind::PreMultiplyWithAlpha:
+				{
+					if (!require(true)) {
+						return false;
+					}
+					PointKernel kernel;
+					kernel.premultiply = true;
+					point_pass().kernels.push_back(kernel);
+					break;
+				}
+			}
+		}
+		return true;
+	}
+
+	/**
+	Header sharing the scanlines [first, first + rows) of dib, with the palette and transparency needed by conversions
+	*/
+	FIBITMAP* CreateBand(FIBITMAP *dib, uint8_t *bits, unsigned first, unsigned rows) {
+		const unsigned pitch = FreeImage_GetPitch(dib);
+		FIBITMAP *band = FreeImage_AllocateHeaderForBits(bits + (size_t)pitch * first, pitch, FreeImage_GetImageType(dib),
+			FreeImage_GetWidth(dib), rows, FreeImage_GetBPP(dib),
+			FreeImage_GetRedMask(dib), FreeImage_GetGreenMask(dib), FreeImage_GetBlueMask(dib));
+		if (band && FreeImage_GetColorsUsed(dib)) {
+			memcpy(FreeImage_GetPalette(band), FreeImage_GetPalette(dib), FreeImage_GetColorsUsed(dib) * sizeof(FIRGBA8));
+			FreeImage_SetTransparencyTable(band, FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
+		}
+		return band;
+	}
+
+	/**
+	Runs a point pass from src into dst, dst may be src. Bands of about 64 KB are converted
+	and processed by all kernels before the next band is read.
+	*/
+	bool RunPointPass(FIBITMAP *dst, FIBITMAP *src, const Pass &pass) {
+		const unsigned width = FreeImage_GetWidth(dst);
+		const unsigned height = FreeImage_GetHeight(dst);
+		const unsigned bytespp = pass.bpp / 8;
+		const unsigned dst_pitch = FreeImage_GetPitch(dst);
+		const unsigned band_rows = CalculateBandRows(FreeImage_GetLine(dst));
+
+		uint8_t *dst_bits = FreeImage_GetBits(dst);
+		// the source is only read, a source sharing its pixels with clones is not copied
+		auto *src_bits = const_cast<uint8_t *>(FreeImage_GetConstBits(src));
+		if (!dst_bits || !src_bits) {
+			return false;
+		}
+
+		std::atomic<bool> success{ true };
+		ParallelFor(0, height, band_rows, [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y += band_rows) {
+				const unsigned rows = std::min(band_rows, last - y);
+
+				if (dst != src) {
+					FIBITMAP *src_band = CreateBand(src, src_bits, y, rows);
+					FIBITMAP *dst_band = CreateBand(dst, dst_bits, y, rows);
+					bool converted = false;
+					if (src_band && dst_band) {
+						converted = (pass.bpp == 24) ? ConvertTo24BitsInto(dst_band, src_band) : ConvertTo32BitsInto(dst_band, src_band);
+					}
+					FreeImage_Unload(dst_band);
+					FreeImage_Unload(src_band);
+					if (!converted) {
+						success = false;
+						return;
+					}
+				}
+
+				for (unsigned row = y; row < y + rows; row++) {
+					uint8_t *bits = dst_bits + (size_t)dst_pitch * row;
+					for (const PointKernel &kernel : pass.kernels) {
+						kernel.Apply(bits, width, bytespp);
+					}
+				}
+			}
+		});
+		return success;
+	}
+
+	FIBITMAP* Allocate(int width, int height, unsigned bpp) {
+		return FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	}
+
+	FIBITMAP* Execute(const Pipeline &pipeline, FIBITMAP *dib) {
+		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+		const unsigned bpp = (image_type == FIT_BITMAP) ? FreeImage_GetBPP(dib) : 0;
+
+		std::vector<Pass> passes;
+		if (!Compile(pipeline, bpp, passes)) {
+			return nullptr;
+		}
+		if (passes.empty()) {
+			return FreeImage_Clone(dib);
+		}
+
+		// image is owned by the pipeline from the first pass on
+		FIBITMAP *image = dib;
+		for (const Pass &pass : passes) {
+			FIBITMAP *result = nullptr;
+			if (pass.rescale) {
+				result = Allocate(pass.width, pass.height, pass.bpp);
+				if (result && !FreeImage_RescaleInto(result, image, pass.filter, FI_RESCALE_OMIT_METADATA)) {
+					FreeImage_Unload(result);
+					result = nullptr;
+				}
+			} else if (pass.sharpen) {
+				result = FreeImage_UnsharpMask(image, pass.sigma, pass.amount);
+			} else {
+				// point operations run in place on an image owned by the pipeline
+				const bool in_place = (image != dib) && !pass.convert;
+				result = in_place ? image : Allocate(FreeImage_GetWidth(image), FreeImage_GetHeight(image), pass.bpp);
+				if (result && !RunPointPass(result, image, pass)) {
+					if (result != image) {
+						FreeImage_Unload(result);
+					}
+					result = nullptr;
+				}
+			}
+
+			if ((image != dib) && (image != result)) {
+				FreeImage_Unload(image);
+			}
+			if (!result) {
+				return nullptr;
+			}
+			image = result;
+		}
+
+		FreeImage_CloneMetadata(image, dib);
+		return image;
+	}
+
+} // namespace
+
+
+FIPIPELINE * DLL_CALLCONV
+FreeImage_CreatePipeline() {
+	try {
+		return new FIPIPELINE{ new Pipeline };
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+		return nullptr;
+	}
+}
+
+void DLL_CALLCONV
+FreeImage_DeletePipeline(FIPIPELINE *pipeline) {
+	if (pipeline) {
+		delete ToPipeline(pipeline);
+		delete pipeline;
+	}
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PipelineConvertTo24Bits(FIPIPELINE *pipeline) {
+	return Record(pipeline, Operation{ OperationKind::ConvertTo24Bits });
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PipelineConvertTo32Bits(FIPIPELINE *pipeline) {
+	return Record(pipeline, Operation{ OperationKind::ConvertTo32Bits });
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PipelineRescale(FIPIPELINE *pipeline, int dst_width, int dst_height, FREE_IMAGE_FILTER filter) {
+	if ((dst_width <= 0) || (dst_height <= 0)) {
+		return FALSE;
+	}
+	Operation operation{ OperationKind::Rescale };
+	operation.width = dst_width;
+	operation.height = dst_height;
+	operation.filter = filter;
+	return Record(pipeline, operation);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PipelineAdjustCurve(FIPIPELINE *pipeline, const uint8_t *LUT, FREE_IMAGE_COLOR_CHANNEL channel) {
+	if (!LUT) {
+		return FALSE;
+	}
+	Operation operation{ OperationKind::Curve };
+	operation.channel = channel;
+	std::copy(LUT, LUT + 256, operation.lut.begin());
+	return Record(pipeline, operation);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PipelineAdjustColors(FIPIPELINE *pipeline, double brightness, double contrast, double gamma, FIBOOL invert) {
+	Operation operation{ OperationKind::Curve };
+	if (FreeImage_GetAdjustColorsLookupTable(operation.lut.data(), brightness, contrast, gamma, invert) == 0) {
+		// nothing to adjust, like FreeImage_AdjustColors
+		return ToPipeline(pipeline) ? TRUE : FALSE;
+	}
+	return Record(pipeline, operation);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PipelineInvert(FIPIPELINE *pipeline) {
+	Operation operation{ OperationKind::Invert };
+	for (unsigned i = 0; i < 256; i++) {
+		operation.lut[i] = (uint8_t)~i;
+	}
+	return Record(pipeline, operation);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PipelinePreMultiplyWithAlpha(FIPIPELINE *pipeline) {
+	return Record(pipeline, Operation{ OperationKind::PreMultiplyWithAlpha });
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PipelineUnsharpMask(FIPIPELINE *pipeline, double sigma, double amount) {
+	if (!(sigma > 0)) {
+		return FALSE;
+	}
+	Operation operation{ OperationKind::UnsharpMask };
+	operation.sigma = sigma;
+	operation.amount = amount;
+	return Record(pipeline, operation);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_ExecutePipeline(FIPIPELINE *pipeline, FIBITMAP *dib) {
+	const Pipeline *recorded = ToPipeline(pipeline);
+	if (!recorded || !FreeImage_HasPixels(dib)) {
+		return nullptr;
+	}
+	try {
+		return Execute(*recorded, dib);
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+		return nullptr;
+	}
+}
@@ -21,6 +21,75 @@
 // ==========================================================
 
 #include "Resize.h"
+#include "../FreeImage/ComputeBackend.h"
+
+static CGenericFilter*
+CreateFilter(FREE_IMAGE_FILTER filter) {
+	switch (filter) {
+		case FILTER_BOX:
+			return new(std::nothrow) CBoxFilter();
+		case FILTER_BICUBIC:
+			return new(std::nothrow) CBicubicFilter();
+		case FILTER_BILINEAR:
+			return new(std::nothrow) CBilinearFilter();
+		case FILTER_BSPLINE:
+			return new(std::nothrow) CBSplineFilter();
+		case FILTER_CATMULLROM:
+			return new(std::nothrow) CCatmullRomFilter();
+		case FILTER_LANCZOS3:
+			return new(std::nothrow) CLanczos3Filter();
+	}
+
+	return nullptr;
+}
+
+/**
+Rescales a float image on the compute device selected by FreeImage_SetComputeBackend (or the first available one
+with FI_RESCALE_COMPUTE_DEVICE), returns nullptr if the CPU has to do it.
+*/
+static FIBITMAP*
+RescaleOnDevice(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, CGenericFilter *pFilter, unsigned flags) {
+	switch (FreeImage_GetImageType(src)) {
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			break;
+		default:
+			return nullptr;
+	}
+	ComputeDevice *device = GetComputeDevice((flags & FI_RESCALE_COMPUTE_DEVICE) == FI_RESCALE_COMPUTE_DEVICE);
+	if (!device) {
+		return nullptr;
+	}
+	try {
+		const auto x_weights = CWeightsTable::Acquire(pFilter, dst_width, src_width);
+		const auto y_weights = CWeightsTable::Acquire(pFilter, dst_height, src_height);
+		// scanlines are measured from the bottom of the image
+		const unsigned src_offset_y = FreeImage_GetHeight(src) - src_height - src_top;
+		return device->Rescale(src, src_left, src_offset_y, src_width, src_height, *x_weights, dst_width, *y_weights, dst_height);
+	}
+	catch (const std::bad_alloc &) {
+		return nullptr;
+	}
+}
+
+/**
+Returns true if FI_RESCALE_PREMULTIPLY_ALPHA applies to src through a premultiplied copy.
+32-bit images are premultiplied within the filter passes by CResizeEngine.
+*/
+static bool
+PreMultipliesAlpha(FIBITMAP *src, unsigned flags) {
+	if ((flags & FI_RESCALE_PREMULTIPLY_ALPHA) != FI_RESCALE_PREMULTIPLY_ALPHA) {
+		return false;
+	}
+	switch (FreeImage_GetImageType(src)) {
+		case FIT_RGBA16:
+		case FIT_RGBAF:
+			return true;
+		default:
+			return false;
+	}
+}
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_RescaleRect(FIBITMAP *src, int dst_width, int dst_height, int src_left, int src_top, int src_right, int src_bottom, FREE_IMAGE_FILTER filter, unsigned flags) {
@@ -46,37 +115,48 @@ FreeImage_RescaleRect(FIBITMAP *src, int dst_width, int dst_height, int src_left
 		return nullptr;
 	}
 
-	// select the filter
-	CGenericFilter *pFilter{};
-	switch (filter) {
-		case FILTER_BOX:
-			pFilter = new(std::nothrow) CBoxFilter();
-			break;
-		case FILTER_BICUBIC:
-			pFilter = new(std::nothrow) CBicubicFilter();
-			break;
-		case FILTER_BILINEAR:
-			pFilter = new(std::nothrow) CBilinearFilter();
-			break;
-		case FILTER_BSPLINE:
-			pFilter = new(std::nothrow) CBSplineFilter();
-			break;
-		case FILTER_CATMULLROM:
-			pFilter = new(std::nothrow) CCatmullRomFilter();
-			break;
-		case FILTER_LANCZOS3:
-			pFilter = new(std::nothrow) CLanczos3Filter();
-			break;
+	if (FreeImage_GetImageType(src) == FIT_RGBAH) {
+		// half floats are filtered as RGBAF, the result is rounded back to half floats
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> wide(FreeImage_ConvertToRGBAF(src), &FreeImage_Unload);
+		if (!wide) {
+			return nullptr;
+		}
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> scaled(FreeImage_RescaleRect(wide.get(), dst_width, dst_height,
+			src_left, src_top, src_right, src_bottom, filter, flags), &FreeImage_Unload);
+		return scaled ? FreeImage_ConvertToRGBAH(scaled.get()) : nullptr;
 	}
 
+	// select the filter
+	CGenericFilter *pFilter = CreateFilter(filter);
+
 	if (!pFilter) {
 		return nullptr;
 	}
 
 	CResizeEngine Engine(pFilter);
 
-	dst = Engine.scale(src, dst_width, dst_height, src_left, src_top,
-			src_right - src_left, src_bottom - src_top, flags);
+	if (PreMultipliesAlpha(src, flags)) {
+		// filter premultiplied colors of the rectangle, transparent pixels no longer bleed into their neighbours
+		FIBITMAP *premultiplied = FreeImage_Copy(src, src_left, src_top, src_right, src_bottom);
+		if (premultiplied && FreeImage_PreMultiplyWithAlpha(premultiplied)) {
+			dst = Engine.scale(premultiplied, dst_width, dst_height, 0, 0,
+					src_right - src_left, src_bottom - src_top, flags);
+			if (dst && !FreeImage_UnPreMultiplyWithAlpha(dst)) {
+				FreeImage_Unload(dst);
+				dst = nullptr;
+			}
+		}
+		FreeImage_Unload(premultiplied);
+	} else {
+		if ((flags & FI_RESCALE_SHARPEN) != FI_RESCALE_SHARPEN) {
+			dst = RescaleOnDevice(src, dst_width, dst_height, src_left, src_top,
+					src_right - src_left, src_bottom - src_top, pFilter, flags);
+		}
+		if (!dst) {
+			dst = Engine.scale(src, dst_width, dst_height, src_left, src_top,
+					src_right - src_left, src_bottom - src_top, flags);
+		}
+	}
 
 	delete pFilter;
 
@@ -93,21 +173,58 @@ FreeImage_Rescale(FIBITMAP *src, int dst_width, int dst_height, FREE_IMAGE_FILTE
 	return FreeImage_RescaleRect(src, dst_width, dst_height, 0, 0, FreeImage_GetWidth(src), FreeImage_GetHeight(src), filter, FI_RESCALE_DEFAULT);
 }
 
-FIBITMAP * DLL_CALLCONV
-FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, FIBOOL convert) {
-	FIBITMAP *thumbnail{};
-	int new_width, new_height;
+FIBOOL DLL_CALLCONV
+FreeImage_RescaleInto(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_FILTER filter, unsigned flags) {
+	if (!FreeImage_HasPixels(src) || !FreeImage_HasPixels(dst) || (dst == src)) {
+		return FALSE;
+	}
 
-	if (!FreeImage_HasPixels(dib) || (max_pixel_size <= 0)) return nullptr;
+	const unsigned src_width = FreeImage_GetWidth(src);
+	const unsigned src_height = FreeImage_GetHeight(src);
 
-	const int width	= FreeImage_GetWidth(dib);
-	const int height = FreeImage_GetHeight(dib);
+	if ((FreeImage_GetWidth(dst) == src_width) && (FreeImage_GetHeight(dst) == src_height)) {
+		// nothing to filter, write the converted source
+		return (FreeImage_ConvertInto(dst, src) && CResizeEngine::sharpen(dst, flags)) ? TRUE : FALSE;
+	}
 
-	if (max_pixel_size == 0) max_pixel_size = 1;
+	// select the filter
+	CGenericFilter *pFilter = CreateFilter(filter);
+
+	if (!pFilter) {
+		return FALSE;
+	}
+
+	CResizeEngine Engine(pFilter);
+
+	bool result = false;
+	if (PreMultipliesAlpha(src, flags) && (FreeImage_GetImageType(dst) == FreeImage_GetImageType(src)) && (FreeImage_GetBPP(dst) == FreeImage_GetBPP(src))) {
+		FIBITMAP *premultiplied = FreeImage_Clone(src);
+		if (premultiplied && FreeImage_PreMultiplyWithAlpha(premultiplied)) {
+			result = Engine.scaleInto(premultiplied, dst, 0, 0, src_width, src_height, flags) && FreeImage_UnPreMultiplyWithAlpha(dst);
+		}
+		FreeImage_Unload(premultiplied);
+	} else {
+		result = Engine.scaleInto(src, dst, 0, 0, src_width, src_height, flags);
+	}
 
+	delete pFilter;
+
+	if (result && ((flags & FI_RESCALE_OMIT_METADATA) != FI_RESCALE_OMIT_METADATA)) {
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(dst, src);
+	}
+
+	return result ? TRUE : FALSE;
+}
+
+/**
+Computes the size of a thumbnail fitting in max_pixel_size x max_pixel_size,
+returns false if the image is smaller than the thumbnail
+*/
+static bool
+ThumbnailSize(int width, int height, int max_pixel_size, int& new_width, int& new_height) {
 	if ((width < max_pixel_size) && (height < max_pixel_size)) {
-		// image is smaller than the requested thumbnail
-		return FreeImage_Clone(dib);
+		return false;
 	}
 
 	if (width > height) {
@@ -123,19 +240,47 @@ FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, FIBOOL convert) {
 		new_width = (int)(width * ratio + 0.5);
 		if (new_width == 0) new_width = 1;
 	}
+	return true;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, FIBOOL convert) {
+	FIBITMAP *thumbnail{};
+	int new_width, new_height;
+
+	if (!FreeImage_HasPixels(dib) || (max_pixel_size <= 0)) return nullptr;
+
+	const int width	= FreeImage_GetWidth(dib);
+	const int height = FreeImage_GetHeight(dib);
+
+	if (!ThumbnailSize(width, height, max_pixel_size, new_width, new_height)) {
+		// image is smaller than the requested thumbnail
+		return FreeImage_Clone(dib);
+	}
 
 	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
 
 	// perform downsampling using a bilinear interpolation
 
 	switch (image_type) {
-		case FIT_BITMAP:
 		case FIT_UINT16:
 		case FIT_RGB16:
 		case FIT_RGBA16:
+			if (convert && ((new_width != width) || (new_height != height))) {
+				// filter straight into the standard bitmap, rows are converted as they are filtered
+				thumbnail = FreeImage_Allocate(new_width, new_height, FreeImage_GetBPP(dib) / 2);
+				if (thumbnail && !FreeImage_RescaleInto(thumbnail, dib, FILTER_BILINEAR, FI_RESCALE_OMIT_METADATA)) {
+					FreeImage_Unload(thumbnail);
+					thumbnail = nullptr;
+				}
+				break;
+			}
+			[[fallthrough]];
+		case FIT_BITMAP:
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
+		case FIT_RGBAH:
 		{
 			FREE_IMAGE_FILTER filter = FILTER_BILINEAR;
 			thumbnail = FreeImage_Rescale(dib, new_width, new_height, filter);
@@ -153,7 +298,7 @@ FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, FIBOOL convert) {
 			break;
 	}
 
-	if (thumbnail && (image_type != FIT_BITMAP) && convert) {
+	if (thumbnail && (FreeImage_GetImageType(thumbnail) != FIT_BITMAP) && convert) {
 		// convert to a standard bitmap
 		FIBITMAP *bitmap{};
 		switch (image_type) {
@@ -173,6 +318,7 @@ FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, FIBOOL convert) {
 				bitmap = FreeImage_ToneMapping(thumbnail, FITMO_DRAGO03);
 				break;
 			case FIT_RGBAF:
+			case FIT_RGBAH:
 				// no way to keep the transparency yet ...
 				auto *rgbf = FreeImage_ConvertToRGBF(thumbnail);
 				bitmap = FreeImage_ToneMapping(rgbf, FITMO_DRAGO03);
@@ -190,3 +336,217 @@ FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, FIBOOL convert) {
 
 	return thumbnail;
 }
+
+FIBOOL DLL_CALLCONV
+FreeImage_MakeThumbnailSet(FIBITMAP *dib, const int *sizes, unsigned count, FREE_IMAGE_FILTER filter, FIBITMAP **thumbnails) {
+	// a level is filtered from a larger one only if that one is at least twice as large,
+	// otherwise from the image: aliasing does not accumulate through the cascade
+	static const int kMinCascadeRatio = 2;
+
+	if (!thumbnails) return FALSE;
+	for (unsigned i = 0; i < count; i++) {
+		thumbnails[i] = nullptr;
+	}
+	if (!FreeImage_HasPixels(dib) || !sizes) return FALSE;
+	for (unsigned i = 0; i < count; i++) {
+		if (sizes[i] <= 0) return FALSE;
+	}
+
+	const int width = FreeImage_GetWidth(dib);
+	const int height = FreeImage_GetHeight(dib);
+
+	struct Level {
+		unsigned index;		// position in sizes
+		int width, height;
+		int source;			// level filtered into this one, -1 for the image
+		unsigned depth;		// number of levels from the image
+	};
+
+	try {
+		// largest levels first, each one taking the smallest suitable source
+		std::vector<Level> levels(count);
+		for (unsigned i = 0; i < count; i++) {
+			levels[i].index = i;
+			if (!ThumbnailSize(width, height, sizes[i], levels[i].width, levels[i].height)) {
+				levels[i].width = width;
+				levels[i].height = height;
+			}
+		}
+		std::stable_sort(levels.begin(), levels.end(), [](const Level& a, const Level& b) {
+			return a.width * (int64_t)a.height > b.width * (int64_t)b.height;
+		});
+		unsigned depth = 0;
+		for (unsigned i = 0; i < count; i++) {
+			Level& level = levels[i];
+			level.source = -1;
+			level.depth = 0;
+			for (int j = (int)i - 1; j >= 0; j--) {
+				const Level& larger = levels[j];
+				const bool same = (larger.width == level.width) && (larger.height == level.height);
+				if (same || ((larger.width >= kMinCascadeRatio * level.width) && (larger.height >= kMinCascadeRatio * level.height))) {
+					level.source = j;
+					level.depth = larger.depth + 1;
+					break;
+				}
+			}
+			depth = std::max(depth, level.depth);
+		}
+
+		auto make = [&](const Level& level) {
+			FIBITMAP *src = (level.source < 0) ? dib : thumbnails[levels[level.source].index];
+			FIBITMAP *thumbnail{};
+			if (!src) {
+				// its source failed
+			} else if ((FreeImage_GetWidth(src) == (unsigned)level.width) && (FreeImage_GetHeight(src) == (unsigned)level.height)) {
+				thumbnail = FreeImage_Clone(src);
+			} else {
+				thumbnail = FreeImage_RescaleRect(src, level.width, level.height, 0, 0, FreeImage_GetWidth(src), FreeImage_GetHeight(src), filter, FI_RESCALE_OMIT_METADATA);
+				FreeImage_CloneMetadata(thumbnail, dib);
+			}
+			thumbnails[level.index] = thumbnail;
+		};
+
+		// the levels of a generation only depend on the previous ones
+		std::vector<const Level *> generation;
+		for (unsigned d = 0; d <= depth; d++) {
+			generation.clear();
+			for (const Level& level : levels) {
+				if (level.depth == d) {
+					generation.push_back(&level);
+				}
+			}
+			if (generation.size() == 1) {
+				// a single level rescales by parallel bands
+				make(*generation.front());
+			} else {
+				ParallelFor(0, (unsigned)generation.size(), 1, [&](unsigned first, unsigned last) {
+					for (unsigned i = first; i < last; i++) {
+						make(*generation[i]);
+					}
+				});
+			}
+		}
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+
+	bool result = true;
+	for (unsigned i = 0; i < count; i++) {
+		result = result && thumbnails[i];
+	}
+	if (!result) {
+		for (unsigned i = 0; i < count; i++) {
+			FreeImage_Unload(thumbnails[i]);
+			thumbnails[i] = nullptr;
+		}
+	}
+	return result ? TRUE : FALSE;
+}
+
+// --------------------------------------------------------------------------
+// Streaming resize
+
+FIRESIZER * DLL_CALLCONV
+FreeImage_CreateResizer(FIBITMAP *info, int dst_width, int dst_height, FREE_IMAGE_FILTER filter, FI_RowsResizedProc callback, void *user_data) {
+	if (!info || !callback || (dst_width <= 0) || (dst_height <= 0) || (FreeImage_GetWidth(info) == 0) || (FreeImage_GetHeight(info) == 0)) {
+		return nullptr;
+	}
+	if (!CStreamingResizer::isSupported(info)) {
+		return nullptr;
+	}
+
+	// the filter is only needed by the weights, computed by the constructor
+	std::unique_ptr<CGenericFilter> pFilter(CreateFilter(filter));
+	if (!pFilter) {
+		return nullptr;
+	}
+
+	try {
+		std::unique_ptr<CStreamingResizer> engine(new CStreamingResizer(pFilter.get(), info, dst_width, dst_height, callback, user_data));
+		auto *resizer = new FIRESIZER;
+		resizer->data = engine.release();
+		return resizer;
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return nullptr;
+}
+
+unsigned DLL_CALLCONV
+FreeImage_ResizerPushRows(FIRESIZER *resizer, const uint8_t *bits, unsigned count, unsigned pitch) {
+	if (!resizer || !bits) {
+		return 0;
+	}
+	return static_cast<CStreamingResizer *>(resizer->data)->push(bits, count, pitch);
+}
+
+void DLL_CALLCONV
+FreeImage_DeleteResizer(FIRESIZER *resizer) {
+	if (resizer) {
+		delete static_cast<CStreamingResizer *>(resizer->data);
+		delete resizer;
+	}
+}
+
+/// Copies a destination row of FreeImage_RescaleScanlines into its bitmap
+static void DLL_CALLCONV
+StoreResizedRow(const uint8_t *bits, unsigned row, void *user_data) {
+	FIBITMAP *dst = static_cast<FIBITMAP *>(user_data);
+	memcpy(FreeImage_GetScanLine(dst, FreeImage_GetHeight(dst) - 1 - row), bits, FreeImage_GetLine(dst));
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_RescaleScanlines(FISCANLINEREADER *reader, int dst_width, int dst_height, FREE_IMAGE_FILTER filter) {
+	FIBITMAP *info = FreeImage_GetScanlineReaderInfo(reader);
+	if (!info || (dst_width <= 0) || (dst_height <= 0)) {
+		return nullptr;
+	}
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(info);
+	const unsigned bpp = FreeImage_GetBPP(info);
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dst(FreeImage_AllocateT(image_type, dst_width, dst_height, bpp,
+			FreeImage_GetRedMask(info), FreeImage_GetGreenMask(info), FreeImage_GetBlueMask(info)), &FreeImage_Unload);
+	if (!dst) {
+		return nullptr;
+	}
+	if ((image_type == FIT_BITMAP) && (bpp == 8) && FreeImage_GetPalette(info)) {
+		// keep a min-is-white palette
+		memcpy(FreeImage_GetPalette(dst.get()), FreeImage_GetPalette(info), 256 * sizeof(FIRGBA8));
+	}
+
+	FIRESIZER *resizer = FreeImage_CreateResizer(info, dst_width, dst_height, filter, StoreResizedRow, dst.get());
+	if (!resizer) {
+		return nullptr;
+	}
+
+	// decode chunks of about 64 KB, each one is filtered while it is in cache
+	const unsigned src_height = FreeImage_GetHeight(info);
+	const unsigned line = FreeImage_GetLine(info);
+	const unsigned chunk = std::min(src_height, CalculateBandRows(line));
+	unsigned rows = 0;
+	try {
+		std::vector<uint8_t> buffer(static_cast<size_t>(chunk) * line);
+		while (rows < src_height) {
+			const unsigned count = FreeImage_ReadScanlines(reader, buffer.data(), std::min(chunk, src_height - rows), line);
+			if (count == 0) {
+				break;
+			}
+			FreeImage_ResizerPushRows(resizer, buffer.data(), count, line);
+			rows += count;
+		}
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	FreeImage_DeleteResizer(resizer);
+
+	if (rows < src_height) {
+		// truncated image, or the reader was already read from
+		return nullptr;
+	}
+
+	FreeImage_CloneMetadata(dst.get(), info);
+	return dst.release();
+}
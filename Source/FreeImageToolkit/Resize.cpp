@@ -22,6 +22,12 @@
 // ==========================================================
 
 #include "Resize.h"
+#include "../FreeImage/CPUDispatch.h"
+#include "../FreeImage/Trace.h"
+#include <mutex>
+#include <tuple>
+#include <typeindex>
+#include <typeinfo>
 
 /**
 Returns the color type of a bitmap. In contrast to FreeImage_GetColorType,
@@ -160,14 +166,23 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 	//
 	// window size is the number of sampled pixels
 	m_WindowSize = 2 * (int)ceil(dWidth) + 1; 
+	// windows are padded with null weights, so that each one is aligned and has a whole number of vectors
+	m_WindowStride = (m_WindowSize + 7) & ~7U;
 	// length of dst line (no. of rows / cols) 
 	m_LineLength = uDstSize; 
 
-	 // allocate list of contributions 
-	m_WeightTable = (Contribution*)malloc(m_LineLength * sizeof(Contribution));
-	for (unsigned u = 0; u < m_LineLength; u++) {
-		// allocate contributions for every pixel
-		m_WeightTable[u].Weights = (double*)malloc(m_WindowSize * sizeof(double));
+	// allocate all contributions at once
+	const size_t uWeights = static_cast<size_t>(m_LineLength) * m_WindowStride;
+	m_Bounds = (unsigned*)malloc(2 * static_cast<size_t>(m_LineLength) * sizeof(unsigned));
+	m_Weights = (double*)FreeImage_Aligned_Calloc(uWeights * sizeof(double), FIBITMAP_ALIGNMENT);
+	m_FloatWeights = (float*)FreeImage_Aligned_Calloc(uWeights * sizeof(float), FIBITMAP_ALIGNMENT);
+	m_FixedWeights = (int16_t*)FreeImage_Aligned_Calloc(uWeights * sizeof(int16_t), FIBITMAP_ALIGNMENT);
+	if (!m_Bounds || !m_Weights || !m_FloatWeights || !m_FixedWeights) {
+		free(m_Bounds);
+		FreeImage_Aligned_Free(m_Weights);
+		FreeImage_Aligned_Free(m_FloatWeights);
+		FreeImage_Aligned_Free(m_FixedWeights);
+		throw std::bad_alloc();
 	}
 
 	// offset for discrete to continuous coordinate conversion
@@ -175,6 +190,7 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 
 	for (unsigned u = 0; u < m_LineLength; u++) {
 		// scan through line of contributions
+		double *weights = m_Weights + static_cast<size_t>(u) * m_WindowStride;
 
 		// inverse mapping (discrete dst 'u' to continous src 'dCenter')
 		const double dCenter = (double)u / dScale + dOffset;
@@ -183,60 +199,1358 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 		const int iLeft = MAX(0, (int)(dCenter - dWidth + 0.5));
 		const int iRight = MIN((int)(dCenter + dWidth + 0.5), int(uSrcSize));
 
-		m_WeightTable[u].Left = iLeft; 
-		m_WeightTable[u].Right = iRight;
+		unsigned& uLeft = m_Bounds[2 * u];
+		unsigned& uRight = m_Bounds[2 * u + 1];
+		uLeft = iLeft; 
+		uRight = iRight;
 
 		double dTotalWeight = 0;  // sum of weights (initialized to zero)
 		for (int iSrc = iLeft; iSrc < iRight; iSrc++) {
 			// calculate weights
 			const double weight = dFScale * pFilter->Filter(dFScale * ((double)iSrc + 0.5 - dCenter));
 			// assert((iSrc-iLeft) < m_WindowSize);
-			m_WeightTable[u].Weights[iSrc-iLeft] = weight;
+			weights[iSrc-iLeft] = weight;
 			dTotalWeight += weight;
 		}
 		if ((dTotalWeight > 0) && (dTotalWeight != 1)) {
 			// normalize weight of neighbouring points
 			for (int iSrc = iLeft; iSrc < iRight; iSrc++) {
 				// normalize point
-				m_WeightTable[u].Weights[iSrc-iLeft] /= dTotalWeight; 
+				weights[iSrc-iLeft] /= dTotalWeight; 
+			}
+		}
+
+		// simplify the filter, discarding null weights at the right
+		{			
+			int iTrailing = iRight - iLeft - 1;
+			while ((iTrailing >= 0) && (weights[iTrailing] == 0)) {
+				uRight--;
+				iTrailing--;
+				if (uRight == uLeft) {
+					break;
+				}
+			}
+			
+		}
+
+		const unsigned uLimit = uRight - uLeft;
+
+		// single precision weights
+		{
+			float *single = m_FloatWeights + static_cast<size_t>(u) * m_WindowStride;
+			for (unsigned i = 0; i < uLimit; i++) {
+				single[i] = (float)weights[i];
+			}
+		}
+
+		// convert weights to fixed point, keeping their sum exactly equal to one
+		{
+			const int iOne = 1 << FixedPointBits;
+			int16_t *fixed = m_FixedWeights + static_cast<size_t>(u) * m_WindowStride;
+			int iSum = 0;
+			unsigned uLargest = 0;
+			for (unsigned i = 0; i < uLimit; i++) {
+				const double weight = weights[i];
+				fixed[i] = (int16_t)CLAMP<int>((int)floor(weight * iOne + 0.5), SHRT_MIN, SHRT_MAX);
+				iSum += fixed[i];
+				if (fabs(weight) > fabs(weights[uLargest])) {
+					uLargest = i;
+				}
 			}
+			if (uLimit > 0 && dTotalWeight > 0) {
+				fixed[uLargest] = (int16_t)CLAMP<int>(fixed[uLargest] + iOne - iSum, SHRT_MIN, SHRT_MAX);
+			}
+		}
+
+	} // next dst pixel
+}
+
+CWeightsTable::~CWeightsTable() {
+	free(m_Bounds);
+	FreeImage_Aligned_Free(m_Weights);
+	FreeImage_Aligned_Free(m_FloatWeights);
+	FreeImage_Aligned_Free(m_FixedWeights);
+}
+
+namespace {
+
+	/**
+	Cache of recently used weights tables.<br>
+	Batch jobs usually rescale many images of the same size, so the tables are reused instead of being recomputed for each call.
+	*/
+	class CWeightsTableCache
+	{
+	public:
+		static CWeightsTableCache& Instance() {
+			static CWeightsTableCache instance;
+			return instance;
 		}
 
-		// simplify the filter, discarding null weights at the right
-		{			
-			int iTrailing = iRight - iLeft - 1;
-			while (m_WeightTable[u].Weights[iTrailing] == 0) {
-				m_WeightTable[u].Right--;
-				iTrailing--;
-				if (m_WeightTable[u].Right == m_WeightTable[u].Left) {
-					break;
+		std::shared_ptr<const CWeightsTable> Acquire(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize) {
+			const Key key{ std::type_index(typeid(*pFilter)), pFilter->GetWidth(), uDstSize, uSrcSize };
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				for (auto it = m_Entries.begin(); it != m_Entries.end(); ++it) {
+					if (it->first == key) {
+						// move to front as most recently used
+						m_Entries.splice(m_Entries.begin(), m_Entries, it);
+						return m_Entries.front().second;
+					}
+				}
+			}
+			// compute outside of the lock, concurrent callers may compute the same table twice, that's harmless
+			auto table = std::make_shared<const CWeightsTable>(pFilter, uDstSize, uSrcSize);
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Entries.emplace_front(key, table);
+				if (m_Entries.size() > kCapacity) {
+					m_Entries.pop_back();
+				}
+			}
+			return table;
+		}
+
+	private:
+		/// Max number of cached tables
+		static constexpr size_t kCapacity = 16;
+
+		using Key = std::tuple<std::type_index, double, unsigned, unsigned>;
+
+		std::mutex m_Mutex;
+		std::list<std::pair<Key, std::shared_ptr<const CWeightsTable>>> m_Entries;
+	};
+
+} // namespace
+
+std::shared_ptr<const CWeightsTable> CWeightsTable::Acquire(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize) {
+	return CWeightsTableCache::Instance().Acquire(pFilter, uDstSize, uSrcSize);
+}
+
+// --------------------------------------------------------------------------
+// Fixed point filtering of 8-bit per channel RGB(A) images
+
+namespace {
+
+	/// Rounding constant and clamping of a fixed point accumulator
+	inline uint8_t FixedToByte(int32_t value) {
+		return (uint8_t)CLAMP<int32_t>((value + (1 << (CWeightsTable::FixedPointBits - 1))) >> CWeightsTable::FixedPointBits, 0, 0xFF);
+	}
+
+	/// Horizontal filtering of one row, bytespp is 3 or 4
+	template <unsigned bytespp>
+	void HorizontalFixedRow(const CWeightsTable& weightsTable, const uint8_t *src_bits, uint8_t *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const int16_t *weights = weightsTable.getFixedWeights(x);
+			const uint8_t *pixel = src_bits + iLeft * bytespp;
+			int32_t acc[bytespp] = {};
+			for (unsigned i = 0; i < iLimit; i++) {
+				const int32_t weight = weights[i];
+				for (unsigned c = 0; c < bytespp; c++) {
+					acc[c] += weight * pixel[c];
+				}
+				pixel += bytespp;
+			}
+			for (unsigned c = 0; c < bytespp; c++) {
+				dst_bits[c] = FixedToByte(acc[c]);
+			}
+			dst_bits += bytespp;
+		}
+	}
+
+	/// Vertical filtering of one destination row; channels do not matter, so a row is processed as plain bytes
+	void VerticalFixedRow(const int16_t *weights, unsigned iLimit, const uint8_t *src_bits, unsigned src_pitch, uint8_t *dst_bits, unsigned line_bytes) {
+		for (unsigned j = 0; j < line_bytes; j++) {
+			const uint8_t *row = src_bits + j;
+			int32_t acc = 0;
+			for (unsigned i = 0; i < iLimit; i++) {
+				acc += weights[i] * (*row);
+				row += src_pitch;
+			}
+			dst_bits[j] = FixedToByte(acc);
+		}
+	}
+
+	/// Adds a row of samples to a row of sums, used by the box pre-reduction
+	template <typename Sample>
+	void AccumulateRow(uint32_t *sums, const Sample *src_bits, unsigned count) {
+		for (unsigned i = 0; i < count; i++) {
+			sums[i] += src_bits[i];
+		}
+	}
+
+	/// Horizontal filtering of one row of float pixels, channels is 3 or 4
+	template <unsigned channels>
+	void HorizontalFloatRow(const CWeightsTable& weightsTable, const float *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const float *pixel = src_bits + iLeft * channels;
+			float acc[channels] = {};
+			for (unsigned i = 0; i < iLimit; i++) {
+				const float weight = weights[i];
+				for (unsigned c = 0; c < channels; c++) {
+					acc[c] += weight * pixel[c];
+				}
+				pixel += channels;
+			}
+			for (unsigned c = 0; c < channels; c++) {
+				dst_bits[c] = acc[c];
+			}
+			dst_bits += channels;
+		}
+	}
+
+	/// Horizontal filtering of one row of FIT_FLOAT pixels; the window is summed in 4 lanes, like the SIMD kernels
+	template <>
+	void HorizontalFloatRow<1>(const CWeightsTable& weightsTable, const float *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const float *pixel = src_bits + iLeft;
+			float lanes[4] = {};
+			unsigned i = 0;
+			for (; i + 4 <= iLimit; i += 4) {
+				for (unsigned k = 0; k < 4; k++) {
+					lanes[k] += weights[i + k] * pixel[i + k];
+				}
+			}
+			for (unsigned k = 0; i + k < iLimit; k++) {
+				lanes[k] += weights[i + k] * pixel[i + k];
+			}
+			dst_bits[x] = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+		}
+	}
+
+	/// Vertical filtering of one destination row of count floats
+	void VerticalFloatRow(const float *weights, unsigned iLimit, const float *src_bits, size_t src_pitch, float *dst_bits, unsigned count) {
+		for (unsigned j = 0; j < count; j++) {
+			const float *row = src_bits + j;
+			float acc = 0;
+			for (unsigned i = 0; i < iLimit; i++) {
+				acc += weights[i] * (*row);
+				row += src_pitch;
+			}
+			dst_bits[j] = acc;
+		}
+	}
+
+	/**
+	Horizontal filtering of one row of 16-bit pixels into float sums, wordspp is 1, 3 or 4.
+	Each sum adds its taps in window order, like the vertical filtering, so that both passes give the same results.
+	*/
+	template <unsigned wordspp>
+	void HorizontalWordRow(const CWeightsTable& weightsTable, const uint16_t *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const uint16_t *pixel = src_bits + iLeft * wordspp;
+			float acc[wordspp] = {};
+			for (unsigned i = 0; i < iLimit; i++) {
+				const float weight = weights[i];
+				for (unsigned c = 0; c < wordspp; c++) {
+					acc[c] += weight * (float)pixel[c];
+				}
+				pixel += wordspp;
+			}
+			for (unsigned c = 0; c < wordspp; c++) {
+				dst_bits[c] = acc[c];
+			}
+			dst_bits += wordspp;
+		}
+	}
+
+	/// Vertical filtering of one destination row of count 16-bit samples into float sums
+	void VerticalWordRow(const float *weights, unsigned iLimit, const uint16_t *src_bits, size_t src_pitch, float *dst_bits, unsigned count) {
+		for (unsigned j = 0; j < count; j++) {
+			const uint16_t *row = src_bits + j;
+			float acc = 0;
+			for (unsigned i = 0; i < iLimit; i++) {
+				acc += weights[i] * (float)(*row);
+				row += src_pitch;
+			}
+			dst_bits[j] = acc;
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86
+
+	/// Loads one pixel into the low bytes of a register
+	template <unsigned bytespp>
+	inline __m128i LoadPixel(const uint8_t *pixel) {
+		int32_t value;
+		if (bytespp == 4) {
+			memcpy(&value, pixel, 4);
+		} else {
+			value = pixel[0] | (pixel[1] << 8) | (pixel[2] << 16);
+		}
+		return _mm_cvtsi32_si128(value);
+	}
+
+	/// Returns pair of weights broadcasted for _mm_madd_epi16
+	inline __m128i WeightsPair(int16_t w0, int16_t w1) {
+		return _mm_set1_epi32((int32_t)((uint32_t)(uint16_t)w0 | ((uint32_t)(uint16_t)w1 << 16)));
+	}
+
+	/// Rounds, shifts and packs 4 fixed point accumulators to bytes
+	inline __m128i PackFixed(__m128i acc) {
+		const __m128i half = _mm_set1_epi32(1 << (CWeightsTable::FixedPointBits - 1));
+		acc = _mm_srai_epi32(_mm_add_epi32(acc, half), CWeightsTable::FixedPointBits);
+		acc = _mm_packs_epi32(acc, acc);
+		return _mm_packus_epi16(acc, acc);
+	}
+
+	template <unsigned bytespp>
+	void HorizontalFixedRowSSE2(const CWeightsTable& weightsTable, const uint8_t *src_bits, uint8_t *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const int16_t *weights = weightsTable.getFixedWeights(x);
+			const uint8_t *pixel = src_bits + iLeft * bytespp;
+			// pixels are processed by pairs, channels of both pixels are interleaved for _mm_madd_epi16
+			const __m128i zero = _mm_setzero_si128();
+			__m128i acc = zero;
+			unsigned i = 0;
+			for (; i + 1 < iLimit; i += 2) {
+				const __m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(LoadPixel<bytespp>(pixel), LoadPixel<bytespp>(pixel + bytespp)), zero);
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(p, WeightsPair(weights[i], weights[i + 1])));
+				pixel += 2 * bytespp;
+			}
+			if (i < iLimit) {
+				const __m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(LoadPixel<bytespp>(pixel), zero), zero);
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(p, WeightsPair(weights[i], 0)));
+			}
+			const int32_t packed = _mm_cvtsi128_si32(PackFixed(acc));
+			memcpy(dst_bits, &packed, bytespp);
+			dst_bits += bytespp;
+		}
+	}
+
+	void VerticalFixedRowSSE2(const int16_t *weights, unsigned iLimit, const uint8_t *src_bits, unsigned src_pitch, uint8_t *dst_bits, unsigned line_bytes) {
+		unsigned j = 0;
+		// process 16 bytes at once, rows are processed by pairs and interleaved for _mm_madd_epi16
+		const __m128i zero = _mm_setzero_si128();
+		for (; j + 16 <= line_bytes; j += 16) {
+			__m128i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+			const uint8_t *row = src_bits + j;
+			unsigned i = 0;
+			for (; i + 1 < iLimit; i += 2) {
+				const __m128i r0 = _mm_loadu_si128((const __m128i*)row);
+				const __m128i r1 = _mm_loadu_si128((const __m128i*)(row + src_pitch));
+				const __m128i w = WeightsPair(weights[i], weights[i + 1]);
+				const __m128i lo = _mm_unpacklo_epi8(r0, r1);
+				const __m128i hi = _mm_unpackhi_epi8(r0, r1);
+				acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+				acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+				acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+				acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+				row += 2 * src_pitch;
+			}
+			if (i < iLimit) {
+				const __m128i r0 = _mm_loadu_si128((const __m128i*)row);
+				const __m128i w = WeightsPair(weights[i], 0);
+				const __m128i lo = _mm_unpacklo_epi8(r0, zero);
+				const __m128i hi = _mm_unpackhi_epi8(r0, zero);
+				acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(lo, zero), w));
+				acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(lo, zero), w));
+				acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(hi, zero), w));
+				acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(hi, zero), w));
+			}
+			const __m128i half = _mm_set1_epi32(1 << (CWeightsTable::FixedPointBits - 1));
+			acc0 = _mm_srai_epi32(_mm_add_epi32(acc0, half), CWeightsTable::FixedPointBits);
+			acc1 = _mm_srai_epi32(_mm_add_epi32(acc1, half), CWeightsTable::FixedPointBits);
+			acc2 = _mm_srai_epi32(_mm_add_epi32(acc2, half), CWeightsTable::FixedPointBits);
+			acc3 = _mm_srai_epi32(_mm_add_epi32(acc3, half), CWeightsTable::FixedPointBits);
+			_mm_storeu_si128((__m128i*)(dst_bits + j), _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_packs_epi32(acc2, acc3)));
+		}
+		VerticalFixedRow(weights, iLimit, src_bits + j, src_pitch, dst_bits + j, line_bytes - j);
+	}
+
+	void AccumulateRowSSE2(uint32_t *sums, const uint8_t *src_bits, unsigned count) {
+		const __m128i zero = _mm_setzero_si128();
+		unsigned i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src_bits + i));
+			const __m128i lo = _mm_unpacklo_epi8(v, zero);
+			const __m128i hi = _mm_unpackhi_epi8(v, zero);
+			__m128i *s = reinterpret_cast<__m128i *>(sums + i);
+			_mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(lo, zero)));
+			_mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo, zero)));
+			_mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi, zero)));
+			_mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi, zero)));
+		}
+		AccumulateRow(sums + i, src_bits + i, count - i);
+	}
+
+	void AccumulateRow16SSE2(uint32_t *sums, const uint16_t *src_bits, unsigned count) {
+		const __m128i zero = _mm_setzero_si128();
+		unsigned i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src_bits + i));
+			__m128i *s = reinterpret_cast<__m128i *>(sums + i);
+			_mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(v, zero)));
+			_mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(v, zero)));
+		}
+		AccumulateRow(sums + i, src_bits + i, count - i);
+	}
+
+	void HorizontalFloatRow1SSE2(const CWeightsTable& weightsTable, const float *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const float *pixel = src_bits + iLeft;
+			__m128 acc = _mm_setzero_ps();
+			unsigned i = 0;
+			for (; i + 4 <= iLimit; i += 4) {
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(weights + i), _mm_loadu_ps(pixel + i)));
+			}
+			float lanes[4];
+			_mm_storeu_ps(lanes, acc);
+			for (unsigned k = 0; i + k < iLimit; k++) {
+				lanes[k] += weights[i + k] * pixel[i + k];
+			}
+			dst_bits[x] = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+		}
+	}
+
+	void HorizontalFloatRow4SSE2(const CWeightsTable& weightsTable, const float *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const float *pixel = src_bits + iLeft * 4;
+			__m128 acc = _mm_setzero_ps();
+			for (unsigned i = 0; i < iLimit; i++) {
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[i]), _mm_loadu_ps(pixel)));
+				pixel += 4;
+			}
+			_mm_storeu_ps(dst_bits, acc);
+			dst_bits += 4;
+		}
+	}
+
+	void VerticalFloatRowSSE2(const float *weights, unsigned iLimit, const float *src_bits, size_t src_pitch, float *dst_bits, unsigned count) {
+		unsigned j = 0;
+		for (; j + 8 <= count; j += 8) {
+			__m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+			const float *row = src_bits + j;
+			for (unsigned i = 0; i < iLimit; i++) {
+				const __m128 w = _mm_set1_ps(weights[i]);
+				acc0 = _mm_add_ps(acc0, _mm_mul_ps(w, _mm_loadu_ps(row)));
+				acc1 = _mm_add_ps(acc1, _mm_mul_ps(w, _mm_loadu_ps(row + 4)));
+				row += src_pitch;
+			}
+			_mm_storeu_ps(dst_bits + j, acc0);
+			_mm_storeu_ps(dst_bits + j + 4, acc1);
+		}
+		VerticalFloatRow(weights, iLimit, src_bits + j, src_pitch, dst_bits + j, count - j);
+	}
+
+	/// Converts the 4 low words of a register to floats
+	inline __m128 WordsToFloats(__m128i words) {
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, _mm_setzero_si128()));
+	}
+
+	/// 3 words per pixel: the last one is not read past, as the last pixel may end the bitmap
+	void HorizontalWordRow3SSE2(const CWeightsTable& weightsTable, const uint16_t *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const uint16_t *pixel = src_bits + iLeft * 3;
+			__m128 acc = _mm_setzero_ps();
+			for (unsigned i = 0; i < iLimit; i++) {
+				const __m128i words = _mm_insert_epi16(_mm_cvtsi32_si128((int)((uint32_t)pixel[0] | ((uint32_t)pixel[1] << 16))), pixel[2], 2);
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[i]), WordsToFloats(words)));
+				pixel += 3;
+			}
+			float lanes[4];
+			_mm_storeu_ps(lanes, acc);
+			dst_bits[0] = lanes[0];
+			dst_bits[1] = lanes[1];
+			dst_bits[2] = lanes[2];
+			dst_bits += 3;
+		}
+	}
+
+	void HorizontalWordRow4SSE2(const CWeightsTable& weightsTable, const uint16_t *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const uint16_t *pixel = src_bits + iLeft * 4;
+			__m128 acc = _mm_setzero_ps();
+			for (unsigned i = 0; i < iLimit; i++) {
+				const __m128i words = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixel));
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[i]), WordsToFloats(words)));
+				pixel += 4;
+			}
+			_mm_storeu_ps(dst_bits, acc);
+			dst_bits += 4;
+		}
+	}
+
+	void VerticalWordRowSSE2(const float *weights, unsigned iLimit, const uint16_t *src_bits, size_t src_pitch, float *dst_bits, unsigned count) {
+		unsigned j = 0;
+		for (; j + 8 <= count; j += 8) {
+			__m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+			const uint16_t *row = src_bits + j;
+			for (unsigned i = 0; i < iLimit; i++) {
+				const __m128 w = _mm_set1_ps(weights[i]);
+				const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row));
+				acc0 = _mm_add_ps(acc0, _mm_mul_ps(w, WordsToFloats(words)));
+				acc1 = _mm_add_ps(acc1, _mm_mul_ps(w, WordsToFloats(_mm_srli_si128(words, 8))));
+				row += src_pitch;
+			}
+			_mm_storeu_ps(dst_bits + j, acc0);
+			_mm_storeu_ps(dst_bits + j + 4, acc1);
+		}
+		VerticalWordRow(weights, iLimit, src_bits + j, src_pitch, dst_bits + j, count - j);
+	}
+
+	/// Adds the taps of one RGBA16 pixel from the first one, the tail of HorizontalWordRow4AVX2
+	inline __m128 AccumulateWordPixel4(__m128 acc, const float *weights, unsigned i, unsigned iLimit, const uint16_t *pixel) {
+		for (; i < iLimit; i++) {
+			const __m128i words = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixel + i * 4));
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[i]), WordsToFloats(words)));
+		}
+		return acc;
+	}
+
+	FI_TARGET("avx2")
+	void HorizontalWordRow4AVX2(const CWeightsTable& weightsTable, const uint16_t *src_bits, float *dst_bits, unsigned dst_width) {
+		// 2 destination pixels per register, each lane adds its own taps in window order like the scalar code
+		unsigned x = 0;
+		for (; x + 2 <= dst_width; x += 2) {
+			const unsigned iLeft0 = weightsTable.getLeftBoundary(x);
+			const unsigned iLeft1 = weightsTable.getLeftBoundary(x + 1);
+			const unsigned iLimit0 = weightsTable.getRightBoundary(x) - iLeft0;
+			const unsigned iLimit1 = weightsTable.getRightBoundary(x + 1) - iLeft1;
+			const float *weights0 = weightsTable.getFloatWeights(x);
+			const float *weights1 = weightsTable.getFloatWeights(x + 1);
+			const uint16_t *pixel0 = src_bits + iLeft0 * 4;
+			const uint16_t *pixel1 = src_bits + iLeft1 * 4;
+			const unsigned iCommon = MIN(iLimit0, iLimit1);
+			__m256 acc = _mm256_setzero_ps();
+			for (unsigned i = 0; i < iCommon; i++) {
+				const __m128i words = _mm_unpacklo_epi64(
+					_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixel0 + i * 4)),
+					_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixel1 + i * 4)));
+				const __m256 w = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weights0[i])), _mm_set1_ps(weights1[i]), 1);
+				// multiply then add like the scalar code, a fused multiply-add would round differently
+				acc = _mm256_add_ps(acc, _mm256_mul_ps(w, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(words))));
+			}
+			_mm_storeu_ps(dst_bits, AccumulateWordPixel4(_mm256_castps256_ps128(acc), weights0, iCommon, iLimit0, pixel0));
+			_mm_storeu_ps(dst_bits + 4, AccumulateWordPixel4(_mm256_extractf128_ps(acc, 1), weights1, iCommon, iLimit1, pixel1));
+			dst_bits += 8;
+		}
+		if (x < dst_width) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			_mm_storeu_ps(dst_bits, AccumulateWordPixel4(_mm_setzero_ps(), weightsTable.getFloatWeights(x), 0, iLimit, src_bits + iLeft * 4));
+		}
+	}
+
+	FI_TARGET("avx2")
+	void VerticalWordRowAVX2(const float *weights, unsigned iLimit, const uint16_t *src_bits, size_t src_pitch, float *dst_bits, unsigned count) {
+		unsigned j = 0;
+		for (; j + 16 <= count; j += 16) {
+			__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+			const uint16_t *row = src_bits + j;
+			for (unsigned i = 0; i < iLimit; i++) {
+				const __m256 w = _mm256_set1_ps(weights[i]);
+				const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row));
+				const __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(words)));
+				const __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(words, 1)));
+				acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(w, lo));
+				acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(w, hi));
+				row += src_pitch;
+			}
+			_mm256_storeu_ps(dst_bits + j, acc0);
+			_mm256_storeu_ps(dst_bits + j + 8, acc1);
+		}
+		VerticalWordRowSSE2(weights, iLimit, src_bits + j, src_pitch, dst_bits + j, count - j);
+	}
+
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_SIMD_NEON
+
+	void HorizontalFloatRow1NEON(const CWeightsTable& weightsTable, const float *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const float *pixel = src_bits + iLeft;
+			float32x4_t acc = vdupq_n_f32(0);
+			unsigned i = 0;
+			for (; i + 4 <= iLimit; i += 4) {
+				acc = vaddq_f32(acc, vmulq_f32(vld1q_f32(weights + i), vld1q_f32(pixel + i)));
+			}
+			float lanes[4];
+			vst1q_f32(lanes, acc);
+			for (unsigned k = 0; i + k < iLimit; k++) {
+				lanes[k] += weights[i + k] * pixel[i + k];
+			}
+			dst_bits[x] = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+		}
+	}
+
+	void HorizontalFloatRow4NEON(const CWeightsTable& weightsTable, const float *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const float *pixel = src_bits + iLeft * 4;
+			float32x4_t acc = vdupq_n_f32(0);
+			for (unsigned i = 0; i < iLimit; i++) {
+				acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(pixel), weights[i]));
+				pixel += 4;
+			}
+			vst1q_f32(dst_bits, acc);
+			dst_bits += 4;
+		}
+	}
+
+	void VerticalFloatRowNEON(const float *weights, unsigned iLimit, const float *src_bits, size_t src_pitch, float *dst_bits, unsigned count) {
+		unsigned j = 0;
+		for (; j + 8 <= count; j += 8) {
+			float32x4_t acc0 = vdupq_n_f32(0), acc1 = vdupq_n_f32(0);
+			const float *row = src_bits + j;
+			for (unsigned i = 0; i < iLimit; i++) {
+				acc0 = vaddq_f32(acc0, vmulq_n_f32(vld1q_f32(row), weights[i]));
+				acc1 = vaddq_f32(acc1, vmulq_n_f32(vld1q_f32(row + 4), weights[i]));
+				row += src_pitch;
+			}
+			vst1q_f32(dst_bits + j, acc0);
+			vst1q_f32(dst_bits + j + 4, acc1);
+		}
+		VerticalFloatRow(weights, iLimit, src_bits + j, src_pitch, dst_bits + j, count - j);
+	}
+
+	/// 3 words per pixel: the last one is not read past, as the last pixel may end the bitmap
+	void HorizontalWordRow3NEON(const CWeightsTable& weightsTable, const uint16_t *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const uint16_t *pixel = src_bits + iLeft * 3;
+			float32x4_t acc = vdupq_n_f32(0);
+			for (unsigned i = 0; i < iLimit; i++) {
+				uint16x4_t words = vdup_n_u16(0);
+				words = vset_lane_u16(pixel[0], words, 0);
+				words = vset_lane_u16(pixel[1], words, 1);
+				words = vset_lane_u16(pixel[2], words, 2);
+				acc = vaddq_f32(acc, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(words)), weights[i]));
+				pixel += 3;
+			}
+			float lanes[4];
+			vst1q_f32(lanes, acc);
+			dst_bits[0] = lanes[0];
+			dst_bits[1] = lanes[1];
+			dst_bits[2] = lanes[2];
+			dst_bits += 3;
+		}
+	}
+
+	void HorizontalWordRow4NEON(const CWeightsTable& weightsTable, const uint16_t *src_bits, float *dst_bits, unsigned dst_width) {
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const uint16_t *pixel = src_bits + iLeft * 4;
+			float32x4_t acc = vdupq_n_f32(0);
+			for (unsigned i = 0; i < iLimit; i++) {
+				acc = vaddq_f32(acc, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(pixel))), weights[i]));
+				pixel += 4;
+			}
+			vst1q_f32(dst_bits, acc);
+			dst_bits += 4;
+		}
+	}
+
+	void VerticalWordRowNEON(const float *weights, unsigned iLimit, const uint16_t *src_bits, size_t src_pitch, float *dst_bits, unsigned count) {
+		unsigned j = 0;
+		for (; j + 8 <= count; j += 8) {
+			float32x4_t acc0 = vdupq_n_f32(0), acc1 = vdupq_n_f32(0);
+			const uint16_t *row = src_bits + j;
+			for (unsigned i = 0; i < iLimit; i++) {
+				const uint16x8_t words = vld1q_u16(row);
+				acc0 = vaddq_f32(acc0, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(words))), weights[i]));
+				acc1 = vaddq_f32(acc1, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(words))), weights[i]));
+				row += src_pitch;
+			}
+			vst1q_f32(dst_bits + j, acc0);
+			vst1q_f32(dst_bits + j + 4, acc1);
+		}
+		VerticalWordRow(weights, iLimit, src_bits + j, src_pitch, dst_bits + j, count - j);
+	}
+
+	void AccumulateRowNEON(uint32_t *sums, const uint8_t *src_bits, unsigned count) {
+		unsigned i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const uint8x16_t v = vld1q_u8(src_bits + i);
+			const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+			const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+			vst1q_u32(sums + i, vaddw_u16(vld1q_u32(sums + i), vget_low_u16(lo)));
+			vst1q_u32(sums + i + 4, vaddw_u16(vld1q_u32(sums + i + 4), vget_high_u16(lo)));
+			vst1q_u32(sums + i + 8, vaddw_u16(vld1q_u32(sums + i + 8), vget_low_u16(hi)));
+			vst1q_u32(sums + i + 12, vaddw_u16(vld1q_u32(sums + i + 12), vget_high_u16(hi)));
+		}
+		AccumulateRow(sums + i, src_bits + i, count - i);
+	}
+
+	void AccumulateRow16NEON(uint32_t *sums, const uint16_t *src_bits, unsigned count) {
+		unsigned i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const uint16x8_t v = vld1q_u16(src_bits + i);
+			vst1q_u32(sums + i, vaddw_u16(vld1q_u32(sums + i), vget_low_u16(v)));
+			vst1q_u32(sums + i + 4, vaddw_u16(vld1q_u32(sums + i + 4), vget_high_u16(v)));
+		}
+		AccumulateRow(sums + i, src_bits + i, count - i);
+	}
+
+#endif // FREEIMAGE_SIMD_NEON
+
+	using HorizontalRowKernel = void (*)(const CWeightsTable& weightsTable, const uint8_t *src_bits, uint8_t *dst_bits, unsigned dst_width);
+	using VerticalRowKernel = void (*)(const int16_t *weights, unsigned iLimit, const uint8_t *src_bits, unsigned src_pitch, uint8_t *dst_bits, unsigned line_bytes);
+	using HorizontalFloatRowKernel = void (*)(const CWeightsTable& weightsTable, const float *src_bits, float *dst_bits, unsigned dst_width);
+	using VerticalFloatRowKernel = void (*)(const float *weights, unsigned iLimit, const float *src_bits, size_t src_pitch, float *dst_bits, unsigned count);
+	using HorizontalWordRowKernel = void (*)(const CWeightsTable& weightsTable, const uint16_t *src_bits, float *dst_bits, unsigned dst_width);
+	using VerticalWordRowKernel = void (*)(const float *weights, unsigned iLimit, const uint16_t *src_bits, size_t src_pitch, float *dst_bits, unsigned count);
+	using AccumulateRowKernel = void (*)(uint32_t *sums, const uint8_t *src_bits, unsigned count);
+	using AccumulateRow16Kernel = void (*)(uint32_t *sums, const uint16_t *src_bits, unsigned count);
+
+	/// Row kernels for the enabled CPU features
+	struct ResizeKernels {
+		std::atomic<HorizontalRowKernel> horizontal3{ HorizontalFixedRow<3> };
+		std::atomic<HorizontalRowKernel> horizontal4{ HorizontalFixedRow<4> };
+		std::atomic<VerticalRowKernel> vertical{ VerticalFixedRow };
+		std::atomic<HorizontalFloatRowKernel> horizontalFloat1{ HorizontalFloatRow<1> };
+		std::atomic<HorizontalFloatRowKernel> horizontalFloat4{ HorizontalFloatRow<4> };
+		std::atomic<VerticalFloatRowKernel> verticalFloat{ VerticalFloatRow };
+		std::atomic<HorizontalWordRowKernel> horizontalWord3{ HorizontalWordRow<3> };
+		std::atomic<HorizontalWordRowKernel> horizontalWord4{ HorizontalWordRow<4> };
+		std::atomic<VerticalWordRowKernel> verticalWord{ VerticalWordRow };
+		std::atomic<AccumulateRowKernel> accumulate{ AccumulateRow<uint8_t> };
+		std::atomic<AccumulateRow16Kernel> accumulate16{ AccumulateRow<uint16_t> };
+	};
+
+	ResizeKernels gKernels;
+
+	void SelectResizeKernels(uint32_t features) {
+		HorizontalRowKernel horizontal3 = HorizontalFixedRow<3>;
+		HorizontalRowKernel horizontal4 = HorizontalFixedRow<4>;
+		VerticalRowKernel vertical = VerticalFixedRow;
+		HorizontalFloatRowKernel horizontalFloat1 = HorizontalFloatRow<1>;
+		HorizontalFloatRowKernel horizontalFloat4 = HorizontalFloatRow<4>;
+		VerticalFloatRowKernel verticalFloat = VerticalFloatRow;
+		HorizontalWordRowKernel horizontalWord3 = HorizontalWordRow<3>;
+		HorizontalWordRowKernel horizontalWord4 = HorizontalWordRow<4>;
+		VerticalWordRowKernel verticalWord = VerticalWordRow;
+		AccumulateRowKernel accumulate = AccumulateRow<uint8_t>;
+		AccumulateRow16Kernel accumulate16 = AccumulateRow<uint16_t>;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			horizontal3 = HorizontalFixedRowSSE2<3>;
+			horizontal4 = HorizontalFixedRowSSE2<4>;
+			vertical = VerticalFixedRowSSE2;
+			horizontalFloat1 = HorizontalFloatRow1SSE2;
+			horizontalFloat4 = HorizontalFloatRow4SSE2;
+			verticalFloat = VerticalFloatRowSSE2;
+			horizontalWord3 = HorizontalWordRow3SSE2;
+			horizontalWord4 = HorizontalWordRow4SSE2;
+			verticalWord = VerticalWordRowSSE2;
+			accumulate = AccumulateRowSSE2;
+			accumulate16 = AccumulateRow16SSE2;
+		}
+		if (features & FI_CPU_AVX2) {
+			horizontalWord4 = HorizontalWordRow4AVX2;
+			verticalWord = VerticalWordRowAVX2;
+		}
+#endif
+#if FREEIMAGE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			horizontalFloat1 = HorizontalFloatRow1NEON;
+			horizontalFloat4 = HorizontalFloatRow4NEON;
+			verticalFloat = VerticalFloatRowNEON;
+			horizontalWord3 = HorizontalWordRow3NEON;
+			horizontalWord4 = HorizontalWordRow4NEON;
+			verticalWord = VerticalWordRowNEON;
+			accumulate = AccumulateRowNEON;
+			accumulate16 = AccumulateRow16NEON;
+		}
+#endif
+		gKernels.horizontal3.store(horizontal3, std::memory_order_relaxed);
+		gKernels.horizontal4.store(horizontal4, std::memory_order_relaxed);
+		gKernels.vertical.store(vertical, std::memory_order_relaxed);
+		gKernels.horizontalFloat1.store(horizontalFloat1, std::memory_order_relaxed);
+		gKernels.horizontalFloat4.store(horizontalFloat4, std::memory_order_relaxed);
+		gKernels.verticalFloat.store(verticalFloat, std::memory_order_relaxed);
+		gKernels.horizontalWord3.store(horizontalWord3, std::memory_order_relaxed);
+		gKernels.horizontalWord4.store(horizontalWord4, std::memory_order_relaxed);
+		gKernels.verticalWord.store(verticalWord, std::memory_order_relaxed);
+		gKernels.accumulate.store(accumulate, std::memory_order_relaxed);
+		gKernels.accumulate16.store(accumulate16, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectResizeKernels);
+
+} // namespace
+
+// --------------------------------------------------------------------------
+// Box pre-reduction of large downscales
+// The weights of a large downscale span many source pixels. The image is first reduced by integer factors,
+// each pixel being the mean of a block of source pixels, leaving a ratio of at least kMinFilterRatio to the filter.
+
+/// Ratio left to the filter after a box pre-reduction
+static const unsigned kMinFilterRatio = 2;
+/// Largest reduction factor, 32-bit sums of 16-bit samples cannot overflow
+static const unsigned kMaxReduction = 256;
+
+/// Returns the integer reduction factor of a dimension, 1 if the dimension is not reduced
+static inline unsigned
+ReductionFactor(unsigned src_size, unsigned dst_size) {
+	return MAX(1U, MIN(src_size / (kMinFilterRatio * dst_size), kMaxReduction));
+}
+
+/// Box reduces rows of samples, a reduced pixel is the rounded mean of its block; the last blocks may be partial
+template <typename Sample, typename Kernel>
+static void
+BoxReduceRows(FIBITMAP *src, unsigned src_left, unsigned src_offset_y, unsigned src_width, unsigned src_height, unsigned channels,
+	unsigned factor_x, unsigned factor_y, FIBITMAP *dst, Kernel accumulate) {
+	const unsigned dst_width = FreeImage_GetWidth(dst);
+	const unsigned dst_height = FreeImage_GetHeight(dst);
+	const unsigned count = src_width * channels;
+
+	ParallelFor(0, dst_height, CalculateBandRows((size_t)count * sizeof(uint32_t) * factor_y), [&](unsigned first, unsigned last) {
+		std::vector<uint32_t> sums(count);
+		for (unsigned t = first; t < last; t++) {
+			// blocks are counted from the top of the rectangle, scanlines from the bottom of the image
+			const unsigned row_begin = t * factor_y;
+			const unsigned row_end = MIN(row_begin + factor_y, src_height);
+			std::fill(sums.begin(), sums.end(), 0);
+			for (unsigned row = row_begin; row < row_end; row++) {
+				const Sample *src_bits = reinterpret_cast<const Sample *>(FreeImage_GetConstScanLine(src, src_offset_y + src_height - 1 - row));
+				accumulate(sums.data(), src_bits + (size_t)src_left * channels, count);
+			}
+			Sample *dst_bits = reinterpret_cast<Sample *>(FreeImage_GetScanLine(dst, dst_height - 1 - t));
+			for (unsigned x = 0; x < dst_width; x++) {
+				const unsigned col_begin = x * factor_x;
+				const unsigned col_end = MIN(col_begin + factor_x, src_width);
+				const uint64_t area = (uint64_t)(col_end - col_begin) * (row_end - row_begin);
+				for (unsigned c = 0; c < channels; c++) {
+					uint64_t sum = 0;
+					for (unsigned i = col_begin; i < col_end; i++) {
+						sum += sums[(size_t)i * channels + c];
+					}
+					dst_bits[(size_t)x * channels + c] = (Sample)((sum + area / 2) / area);
+				}
+			}
+		}
+	});
+}
+
+/**
+Box reduces the rectangle of an 8, 24 or 32-bit bitmap (greyscale if 8-bit) or of a 16-bit per sample image.
+Returns nullptr if the image cannot be reduced.
+*/
+static FIBITMAP*
+BoxReduce(FIBITMAP *src, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, FREE_IMAGE_COLOR_TYPE color_type, unsigned factor_x, unsigned factor_y) {
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	const unsigned bpp = FreeImage_GetBPP(src);
+	switch (image_type) {
+		case FIT_BITMAP:
+			if (!((bpp == 8 && color_type != FIC_PALETTE) || bpp == 24 || bpp == 32)) {
+				return nullptr;
+			}
+			break;
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+			break;
+		default:
+			return nullptr;
+	}
+
+	FIBITMAP *dst = FreeImage_AllocateT(image_type, (src_width + factor_x - 1) / factor_x, (src_height + factor_y - 1) / factor_y, bpp);
+	if (!dst) {
+		return nullptr;
+	}
+	if (bpp == 8) {
+		memcpy(FreeImage_GetPalette(dst), FreeImage_GetPalette(src), 256 * sizeof(FIRGBA8));
+	}
+
+	const unsigned src_offset_y = FreeImage_GetHeight(src) - src_height - src_top;
+	try {
+		if (image_type == FIT_BITMAP) {
+			BoxReduceRows<uint8_t>(src, src_left, src_offset_y, src_width, src_height, bpp / 8, factor_x, factor_y, dst,
+				gKernels.accumulate.load(std::memory_order_relaxed));
+		} else {
+			BoxReduceRows<uint16_t>(src, src_left, src_offset_y, src_width, src_height, bpp / 16, factor_x, factor_y, dst,
+				gKernels.accumulate16.load(std::memory_order_relaxed));
+		}
+	}
+	catch (const std::bad_alloc &) {
+		// filter the whole rectangle
+		FreeImage_Unload(dst);
+		return nullptr;
+	}
+	return dst;
+}
+
+/// Returns true if the fixed point filtering is applicable
+static inline bool
+UseFixedFilter(FIBITMAP *src, FIBITMAP *dst) {
+	const unsigned bpp = FreeImage_GetBPP(src);
+	return FreeImage_GetImageType(src) == FIT_BITMAP && (bpp == 24 || bpp == 32) && FreeImage_GetBPP(dst) == bpp;
+}
+
+/// Performs horizontal filtering of 24- or 32-bit rows [row_begin, row_end) in fixed point
+static void
+HorizontalFilterFixedBand(const CWeightsTable& weightsTable, unsigned row_begin, unsigned row_end, FIBITMAP *const src, unsigned src_offset_x, unsigned src_offset_y, FIBITMAP *const dst, unsigned dst_width) {
+	const unsigned bytespp = FreeImage_GetBPP(src) / 8;
+	const HorizontalRowKernel filterRow = (bytespp == 4 ? gKernels.horizontal4 : gKernels.horizontal3).load(std::memory_order_relaxed);
+	for (unsigned y = row_begin; y < row_end; y++) {
+		const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x * bytespp;
+		filterRow(weightsTable, src_bits, FreeImage_GetScanLine(dst, y), dst_width);
+	}
+}
+
+/// Performs vertical filtering of 24- or 32-bit columns [col_begin, col_end) in fixed point
+static void
+VerticalFilterFixedBand(const CWeightsTable& weightsTable, unsigned col_begin, unsigned col_end, FIBITMAP *const src, unsigned src_offset_x, unsigned src_offset_y, FIBITMAP *const dst, unsigned dst_height) {
+	const unsigned bytespp = FreeImage_GetBPP(src) / 8;
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	const uint8_t * const src_base = FreeImage_GetConstBits(src) + src_offset_y * src_pitch + (src_offset_x + col_begin) * bytespp;
+	const unsigned line_bytes = (col_end - col_begin) * bytespp;
+	const VerticalRowKernel filterRow = gKernels.vertical.load(std::memory_order_relaxed);
+	for (unsigned y = 0; y < dst_height; y++) {
+		const unsigned iLeft = weightsTable.getLeftBoundary(y);
+		const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;
+		filterRow(weightsTable.getFixedWeights(y), iLimit, src_base + iLeft * src_pitch, src_pitch, FreeImage_GetScanLine(dst, y) + col_begin * bytespp, line_bytes);
+	}
+}
+
+/// Performs horizontal filtering of FIT_FLOAT, FIT_RGBF or FIT_RGBAF rows [row_begin, row_end) in single precision
+static void
+HorizontalFilterFloatBand(const CWeightsTable& weightsTable, unsigned row_begin, unsigned row_end, FIBITMAP *const src, unsigned src_offset_x, unsigned src_offset_y, FIBITMAP *const dst, unsigned dst_width) {
+	// number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
+	const unsigned floatspp = FreeImage_GetBPP(src) / 32;
+	HorizontalFloatRowKernel filterRow = HorizontalFloatRow<3>;
+	if (floatspp == 1) {
+		filterRow = gKernels.horizontalFloat1.load(std::memory_order_relaxed);
+	} else if (floatspp == 4) {
+		filterRow = gKernels.horizontalFloat4.load(std::memory_order_relaxed);
+	}
+	for (unsigned y = row_begin; y < row_end; y++) {
+		const float * const src_bits = (const float *)FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x * floatspp;
+		filterRow(weightsTable, src_bits, (float *)FreeImage_GetScanLine(dst, y), dst_width);
+	}
+}
+
+/// Performs vertical filtering of FIT_FLOAT, FIT_RGBF or FIT_RGBAF columns [col_begin, col_end) in single precision
+static void
+VerticalFilterFloatBand(const CWeightsTable& weightsTable, unsigned col_begin, unsigned col_end, FIBITMAP *const src, unsigned src_offset_x, unsigned src_offset_y, FIBITMAP *const dst, unsigned dst_height) {
+	const unsigned floatspp = FreeImage_GetBPP(src) / 32;
+	const size_t src_pitch = FreeImage_GetPitch(src) / sizeof(float);
+	const float * const src_base = (const float *)FreeImage_GetConstBits(src) + src_offset_y * src_pitch + (src_offset_x + col_begin) * floatspp;
+	const unsigned count = (col_end - col_begin) * floatspp;
+	const VerticalFloatRowKernel filterRow = gKernels.verticalFloat.load(std::memory_order_relaxed);
+	for (unsigned y = 0; y < dst_height; y++) {
+		const unsigned iLeft = weightsTable.getLeftBoundary(y);
+		const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;
+		filterRow(weightsTable.getFloatWeights(y), iLimit, src_base + iLeft * src_pitch, src_pitch, (float *)FreeImage_GetScanLine(dst, y) + col_begin * floatspp, count);
+	}
+}
+
+/**
+Returns the offsets of the samples in a destination pixel of 16-bit (FIRGB16 / FIRGBA16 order)
+or 8-bit (FI_RGBA_* order) samples
+*/
+template <typename OutT>
+static inline void
+GetWordChannelOffsets(unsigned wordspp, unsigned offsets[4]) {
+	for (unsigned j = 0; j < 4; j++) {
+		offsets[j] = j;
+	}
+	if constexpr (sizeof(OutT) == 1) {
+		if (wordspp > 1) {
+			offsets[0] = FI_RGBA_RED;
+			offsets[1] = FI_RGBA_GREEN;
+			offsets[2] = FI_RGBA_BLUE;
+			offsets[3] = FI_RGBA_ALPHA;
+		}
+	}
+}
+
+/**
+Clamps and rounds a filtered 16-bit sample. 8-bit destinations keep the high byte of the 
+rounded sample, like FreeImage_ConvertTo8Bits, FreeImage_ConvertTo24Bits and FreeImage_ConvertTo32Bits.
+*/
+template <typename OutT>
+static inline OutT
+StoreWord(float value) {
+	const int word = CLAMP<int>((int)(value + 0.5f), 0, 0xFFFF);
+	if constexpr (sizeof(OutT) == 1) {
+		return (uint8_t)(word >> 8);
+	} else {
+		return (uint16_t)word;
+	}
+}
+
+/// Clamps, rounds and places count filtered pixels of wordspp samples
+template <typename OutT>
+static inline void
+StoreWords(const float *sums, unsigned count, unsigned wordspp, const unsigned offsets[4], OutT *dst_bits) {
+	for (unsigned k = 0; k < count; k++) {
+		for (unsigned j = 0; j < wordspp; j++) {
+			dst_bits[offsets[j]] = StoreWord<OutT>(sums[j]);
+		}
+		dst_bits += wordspp;
+		sums += wordspp;
+	}
+}
+
+/// Performs horizontal filtering of FIT_UINT16, FIT_RGB16 or FIT_RGBA16 rows [row_begin, row_end) into the same type or its standard bitmap
+template <typename OutT>
+static void
+HorizontalFilterWordsBand(const CWeightsTable& weightsTable, unsigned row_begin, unsigned row_end, FIBITMAP *const src, unsigned src_offset_x, unsigned src_offset_y, FIBITMAP *const dst, unsigned dst_width) {
+	// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
+	const unsigned wordspp = FreeImage_GetBPP(src) / 16;
+	unsigned offsets[4];
+	GetWordChannelOffsets<OutT>(wordspp, offsets);
+
+	HorizontalWordRowKernel filterRow = HorizontalWordRow<1>;
+	if (wordspp == 3) {
+		filterRow = gKernels.horizontalWord3.load(std::memory_order_relaxed);
+	} else if (wordspp == 4) {
+		filterRow = gKernels.horizontalWord4.load(std::memory_order_relaxed);
+	}
+
+	// rows are filtered in single precision, then clamped and rounded
+	std::vector<float> sums((size_t)dst_width * wordspp);
+	for (unsigned y = row_begin; y < row_end; y++) {
+		const uint16_t *src_bits = (const uint16_t *)FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x * wordspp;
+		filterRow(weightsTable, src_bits, sums.data(), dst_width);
+		StoreWords(sums.data(), dst_width, wordspp, offsets, (OutT *)FreeImage_GetScanLine(dst, y));
+	}
+}
+
+/// Number of samples accumulated at once by the row major vertical filters
+static const unsigned kVerticalChunk = 512;
+
+/**
+Accumulates the weighted source rows of destination row y into count sums. The rows are read
+one after the other rather than down the columns; each sum still adds its taps in window order,
+so the result is the same as the one of a column walk.
+*/
+template <typename Sample>
+static inline void
+AccumulateWeightedRows(const CWeightsTable& weightsTable, unsigned y, const Sample *src_bits, size_t src_pitch, double *sums, unsigned count) {
+	const unsigned iLeft = weightsTable.getLeftBoundary(y);
+	const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;
+	std::fill(sums, sums + count, 0.0);
+	src_bits += iLeft * src_pitch;
+	for (unsigned i = 0; i < iLimit; i++) {
+		const double weight = weightsTable.getWeight(y, i);
+		for (unsigned j = 0; j < count; j++) {
+			sums[j] += (weight * (double)src_bits[j]);
+		}
+		src_bits += src_pitch;
+	}
+}
+
+/// Performs vertical filtering of FIT_UINT16, FIT_RGB16 or FIT_RGBA16 columns [col_begin, col_end) into the same type or its standard bitmap
+template <typename OutT>
+static void
+VerticalFilterWordsBand(const CWeightsTable& weightsTable, unsigned col_begin, unsigned col_end, FIBITMAP *const src, unsigned src_offset_x, unsigned src_offset_y, FIBITMAP *const dst, unsigned dst_height) {
+	// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
+	const unsigned wordspp = FreeImage_GetBPP(src) / 16;
+	unsigned offsets[4];
+	GetWordChannelOffsets<OutT>(wordspp, offsets);
+
+	const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(OutT);
+	OutT *const dst_base = (OutT *)FreeImage_GetBits(dst);
+
+	const size_t src_pitch = FreeImage_GetPitch(src) / sizeof(uint16_t);
+	const uint16_t *const src_base = (const uint16_t *)FreeImage_GetConstBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
+	const VerticalWordRowKernel filterRow = gKernels.verticalWord.load(std::memory_order_relaxed);
+
+	// columns are processed by chunks of whole pixels, each destination row of a chunk is
+	// filtered in single precision, then clamped and rounded
+	const unsigned chunk_columns = kVerticalChunk / wordspp;
+	float sums[kVerticalChunk];
+
+	for (unsigned x = col_begin; x < col_end; x += chunk_columns) {
+		const unsigned columns = std::min(col_end - x, chunk_columns);
+		const unsigned index = x * wordspp;	// pixel index
+
+		for (unsigned y = 0; y < dst_height; y++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(y);
+			const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;
+			filterRow(weightsTable.getFloatWeights(y), iLimit, src_base + iLeft * src_pitch + index, src_pitch, sums, columns * wordspp);
+			StoreWords(sums, columns, wordspp, offsets, dst_base + (size_t)y * dst_pitch + index);
+		}
+	}
+}
+
+/**
+Lookup tables of the passes filtering 8-bit samples in float (FI_RESCALE_LINEAR_LIGHT or
+FI_RESCALE_PREMULTIPLY_ALPHA). 8-bit samples are decoded to values in [0, 65535], filtered values
+are encoded back to 8-bit samples from their 16-bit rounding; for sRGB samples, the values are linear light.
+*/
+struct LightTables {
+	float decode[256];
+	uint8_t encode[65536];
+
+	explicit LightTables(bool linear) {
+		for (unsigned i = 0; i < 256; i++) {
+			const double v = i / 255.0;
+			decode[i] = (float)(65535 * (linear ? ((v <= 0.04045) ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4)) : v));
+		}
+		for (unsigned i = 0; i < 65536; i++) {
+			const double v = i / 65535.0;
+			encode[i] = (uint8_t)(255 * (linear ? ((v <= 0.0031308) ? v * 12.92 : 1.055 * pow(v, 1 / 2.4) - 0.055) : v) + 0.5);
+		}
+	}
+};
+
+static const LightTables&
+GetLightTables(bool linear) {
+	static const LightTables identity(false);
+	static const LightTables srgb(true);
+	return linear ? srgb : identity;
+}
+
+/// Reads the 1, 3 or 4 samples of a pixel as values in [0, 65535], decoding and premultiplying 8-bit samples
+template <typename Sample>
+static inline void
+DecodeLight(const Sample *pixel, unsigned channels, bool premultiply, const float *decode, float value[4]) {
+	if constexpr (sizeof(Sample) == 1) {
+		float alpha = 1;
+		if (channels == 4) {
+			// alpha is linear
+			value[FI_RGBA_ALPHA] = pixel[FI_RGBA_ALPHA] * 257.0F;
+			if (premultiply) {
+				alpha = pixel[FI_RGBA_ALPHA] * (1.0F / 255);
+			}
+		}
+		for (unsigned c = 0; c < channels; c++) {
+			if ((channels != 4) || (c != FI_RGBA_ALPHA)) {
+				value[c] = decode[pixel[c]] * alpha;
+			}
+		}
+	} else {
+		for (unsigned c = 0; c < channels; c++) {
+			value[c] = pixel[c];
+		}
+	}
+}
+
+/// Writes filtered values, unpremultiplied and encoded to 8-bit samples or as they are to the float intermediate image
+template <typename Sample>
+static inline void
+EncodeLight(const float value[4], unsigned channels, bool premultiply, const uint8_t *encode, Sample *pixel) {
+	if constexpr (sizeof(Sample) == 1) {
+		float scale = 1;
+		if (channels == 4) {
+			const float alpha = CLAMP(value[FI_RGBA_ALPHA], 0.0F, 65535.0F);
+			pixel[FI_RGBA_ALPHA] = (uint8_t)(alpha * (1.0F / 257) + 0.5F);
+			if (premultiply) {
+				scale = (alpha > 0) ? 65535 / alpha : 0;
+			}
+		}
+		for (unsigned c = 0; c < channels; c++) {
+			if ((channels != 4) || (c != FI_RGBA_ALPHA)) {
+				pixel[c] = encode[(unsigned)(CLAMP(value[c] * scale, 0.0F, 65535.0F) + 0.5F)];
+			}
+		}
+	} else {
+		for (unsigned c = 0; c < channels; c++) {
+			pixel[c] = value[c];
+		}
+	}
+}
+
+/**
+Performs horizontal filtering of rows [row_begin, row_end) of 8-bit samples, or of the float intermediate
+image of the other pass, into float values or 8-bit samples
+*/
+template <typename InT, typename OutT>
+static void
+HorizontalFilterLightBand(const CWeightsTable& weightsTable, unsigned row_begin, unsigned row_end, FIBITMAP *const src, unsigned src_offset_x, unsigned src_offset_y, FIBITMAP *const dst, unsigned dst_width, unsigned channels, bool premultiply, const LightTables& tables) {
+	for (unsigned y = row_begin; y < row_end; y++) {
+		const InT *src_bits = (const InT *)FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x * channels;
+		OutT *dst_bits = (OutT *)FreeImage_GetScanLine(dst, y);
+
+		for (unsigned x = 0; x < dst_width; x++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(x);
+			const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(x);
+			const InT *pixel = src_bits + iLeft * channels;
+			float acc[4] = {}, value[4];
+
+			for (unsigned i = 0; i < iLimit; i++) {
+				DecodeLight(pixel, channels, premultiply, tables.decode, value);
+				for (unsigned c = 0; c < channels; c++) {
+					acc[c] += weights[i] * value[c];
+				}
+				pixel += channels;
+			}
+			EncodeLight(acc, channels, premultiply, tables.encode, dst_bits);
+			dst_bits += channels;
+		}
+	}
+}
+
+/**
+Performs vertical filtering of columns [col_begin, col_end) of 8-bit samples, or of the float intermediate
+image of the other pass, into float values or 8-bit samples. Source rows are accumulated by chunks of columns.
+*/
+template <typename InT, typename OutT>
+static void
+VerticalFilterLightBand(const CWeightsTable& weightsTable, unsigned col_begin, unsigned col_end, FIBITMAP *const src, unsigned src_offset_x, unsigned src_offset_y, FIBITMAP *const dst, unsigned dst_height, unsigned channels, bool premultiply, const LightTables& tables) {
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	const uint8_t *const src_base = FreeImage_GetConstBits(src) + src_offset_y * src_pitch + src_offset_x * channels * sizeof(InT);
+
+	const unsigned chunk_columns = kVerticalChunk / 4;
+	float sums[kVerticalChunk];
+
+	for (unsigned x = col_begin; x < col_end; x += chunk_columns) {
+		const unsigned columns = std::min(col_end - x, chunk_columns);
+
+		for (unsigned y = 0; y < dst_height; y++) {
+			const unsigned iLeft = weightsTable.getLeftBoundary(y);
+			const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;
+			const float *weights = weightsTable.getFloatWeights(y);
+			std::fill(sums, sums + columns * channels, 0.0F);
+
+			for (unsigned i = 0; i < iLimit; i++) {
+				const InT *pixel = (const InT *)(src_base + static_cast<size_t>(iLeft + i) * src_pitch) + x * channels;
+				float *acc = sums;
+				float value[4];
+				for (unsigned k = 0; k < columns; k++) {
+					DecodeLight(pixel, channels, premultiply, tables.decode, value);
+					for (unsigned c = 0; c < channels; c++) {
+						acc[c] += weights[i] * value[c];
+					}
+					pixel += channels;
+					acc += channels;
+				}
+			}
+
+			OutT *dst_bits = (OutT *)FreeImage_GetScanLine(dst, y) + x * channels;
+			for (unsigned k = 0; k < columns; k++) {
+				EncodeLight(sums + k * channels, channels, premultiply, tables.encode, dst_bits + k * channels);
+			}
+		}
+	}
+}
+
+bool CResizeEngine::usesLight(FIBITMAP *src, FIBITMAP *dst, FREE_IMAGE_COLOR_TYPE color_type, unsigned flags) {
+	const bool linear = (flags & FI_RESCALE_LINEAR_LIGHT) == FI_RESCALE_LINEAR_LIGHT;
+	const bool premultiply = (flags & FI_RESCALE_PREMULTIPLY_ALPHA) == FI_RESCALE_PREMULTIPLY_ALPHA;
+	if ((FreeImage_GetImageType(src) != FIT_BITMAP) || (FreeImage_GetImageType(dst) != FIT_BITMAP) || (FreeImage_GetBPP(dst) != FreeImage_GetBPP(src))) {
+		return false;
+	}
+	switch (FreeImage_GetBPP(src)) {
+		case 8:
+			// indices of an inverted or a color palette are not light values
+			return linear && (color_type == FIC_MINISBLACK);
+		case 24:
+			return linear;
+		case 32:
+			return linear || premultiply;
+		default:
+			return false;
+	}
+}
+
+bool CResizeEngine::filterLight(FIBITMAP *src, FIBITMAP *dst, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags) {
+	const unsigned channels = FreeImage_GetBPP(src) / 8;
+	const bool premultiply = (channels == 4) && ((flags & FI_RESCALE_PREMULTIPLY_ALPHA) == FI_RESCALE_PREMULTIPLY_ALPHA);
+	const LightTables& tables = GetLightTables((flags & FI_RESCALE_LINEAR_LIGHT) == FI_RESCALE_LINEAR_LIGHT);
+
+	const unsigned dst_width = FreeImage_GetWidth(dst);
+	const unsigned dst_height = FreeImage_GetHeight(dst);
+	// scanlines are measured from the bottom of the image
+	const unsigned src_offset_x = src_left;
+	const unsigned src_offset_y = FreeImage_GetHeight(src) - src_height - src_top;
+
+	// passes reading the source decode its samples, passes writing the destination encode them, the
+	// intermediate image of two passes holds float values
+	auto horizontal = [&](FIBITMAP *in, unsigned height, unsigned offset_x, unsigned offset_y, FIBITMAP *out) {
+		const auto weightsTable = CWeightsTable::Acquire(m_pFilter, dst_width, src_width);
+		ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(in) + FreeImage_GetLine(out)), [&](unsigned row_begin, unsigned row_end) {
+			if (in == src) {
+				if (out == dst) {
+					HorizontalFilterLightBand<uint8_t, uint8_t>(*weightsTable, row_begin, row_end, in, offset_x, offset_y, out, dst_width, channels, premultiply, tables);
+				} else {
+					HorizontalFilterLightBand<uint8_t, float>(*weightsTable, row_begin, row_end, in, offset_x, offset_y, out, dst_width, channels, premultiply, tables);
 				}
+			} else {
+				HorizontalFilterLightBand<float, uint8_t>(*weightsTable, row_begin, row_end, in, offset_x, offset_y, out, dst_width, channels, premultiply, tables);
 			}
-			
-		}
+		});
+	};
+	auto vertical = [&](FIBITMAP *in, unsigned width, unsigned offset_x, unsigned offset_y, FIBITMAP *out) {
+		const auto weightsTable = CWeightsTable::Acquire(m_pFilter, dst_height, src_height);
+		const unsigned bytespp = FreeImage_GetBPP(out) / 8;
+		const unsigned min_columns = std::max(64 / bytespp, CalculateBandRows(static_cast<size_t>(dst_height + src_height) * bytespp));
+		ParallelFor(0, width, min_columns, [&](unsigned col_begin, unsigned col_end) {
+			if (in == src) {
+				if (out == dst) {
+					VerticalFilterLightBand<uint8_t, uint8_t>(*weightsTable, col_begin, col_end, in, offset_x, offset_y, out, dst_height, channels, premultiply, tables);
+				} else {
+					VerticalFilterLightBand<uint8_t, float>(*weightsTable, col_begin, col_end, in, offset_x, offset_y, out, dst_height, channels, premultiply, tables);
+				}
+			} else {
+				VerticalFilterLightBand<float, uint8_t>(*weightsTable, col_begin, col_end, in, offset_x, offset_y, out, dst_height, channels, premultiply, tables);
+			}
+		});
+	};
 
-	} // next dst pixel
-}
+	if (src_width == dst_width) {
+		vertical(src, dst_width, src_offset_x, src_offset_y, dst);
+		return true;
+	}
+	if (src_height == dst_height) {
+		horizontal(src, dst_height, src_offset_x, src_offset_y, dst);
+		return true;
+	}
 
-CWeightsTable::~CWeightsTable() {
-	for (unsigned u = 0; u < m_LineLength; u++) {
-		// free contributions for every pixel
-		free(m_WeightTable[u].Weights);
+	// same filtering order as method filter
+	const FREE_IMAGE_TYPE tmp_type = (channels == 1) ? FIT_FLOAT : ((channels == 3) ? FIT_RGBF : FIT_RGBAF);
+	const bool xy = (dst_width <= src_width);
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> tmp(FreeImage_AllocateT(tmp_type, xy ? dst_width : src_width, xy ? src_height : dst_height), &FreeImage_Unload);
+	if (!tmp) {
+		return false;
+	}
+	if (xy) {
+		horizontal(src, src_height, src_offset_x, src_offset_y, tmp.get());
+		vertical(tmp.get(), dst_width, 0, 0, dst);
+	} else {
+		vertical(src, src_width, src_offset_x, src_offset_y, tmp.get());
+		horizontal(tmp.get(), dst_height, 0, 0, dst);
 	}
-	// free list of pixels contributions
-	free(m_WeightTable);
+	return true;
 }
 
 // --------------------------------------------------------------------------
 
-FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags) {
+void CResizeEngine::getFormat(FIBITMAP *src, unsigned flags, FREE_IMAGE_COLOR_TYPE& color_type, unsigned& dst_bpp, unsigned& dst_bpp_s1) {
 
 	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 	const unsigned src_bpp = FreeImage_GetBPP(src);
 
 	// determine the image's color type
 	FIBOOL bIsGreyscale = FALSE;
-	FREE_IMAGE_COLOR_TYPE color_type;
 	if (src_bpp <= 8) {
 		color_type = GetExtendedColorType(src, &bIsGreyscale);
 	} else {
@@ -244,8 +1558,7 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	}
 
 	// determine the required bit depth of the destination image
-	unsigned dst_bpp;
-	unsigned dst_bpp_s1 = 0;
+	dst_bpp_s1 = 0;
 	if (color_type == FIC_PALETTE && !bIsGreyscale) {
 		// non greyscale FIC_PALETTE images require a high-color destination
 		// image (24- or 32-bits depending on the image's transparent state)
@@ -285,6 +1598,18 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	if (dst_bpp_s1 == 0) {
 		dst_bpp_s1 = dst_bpp;
 	}
+}
+
+FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags) {
+	TraceScope trace(TraceCategory::eRescale, "CResizeEngine::scale");
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	const unsigned src_bpp = FreeImage_GetBPP(src);
+
+	// determine the image's color type and the required bit depth of the destination image
+	FREE_IMAGE_COLOR_TYPE color_type;
+	unsigned dst_bpp, dst_bpp_s1;
+	getFormat(src, flags, color_type, dst_bpp, dst_bpp_s1);
 
 	// early exit if destination size is equal to source size
 	if ((src_width == dst_width) && (src_height == dst_height)) {
@@ -314,23 +1639,14 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			}
 		}
 
-		return (out != src) ? out : FreeImage_Clone(src);
-	}
-
-	FIRGBA8 pal_buffer[256];
-	const FIRGBA8 *src_pal{};
-
-	// provide the source image's palette to the rescaler for
-	// FIC_PALETTE type images (this includes palletized greyscale
-	// images with an unordered palette as well as transparent images)
-	if (color_type == FIC_PALETTE) {
-		if (dst_bpp == 32) {
-			// a 32-bit destination image signals transparency, so
-			// create an RGBA palette from the source palette
-			src_pal = GetRGBAPalette(src, pal_buffer);
-		} else {
-			src_pal = FreeImage_GetPalette(src);
+		if (out == src) {
+			out = FreeImage_Clone(src);
 		}
+		if (out && !sharpen(out, flags)) {
+			FreeImage_Unload(out);
+			return nullptr;
+		}
+		return out;
 	}
 
 	// allocate the dst image
@@ -355,6 +1671,110 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 		*/
 	}
 
+	const bool filtered = usesLight(src, dst, color_type, flags) ?
+		filterLight(src, dst, src_left, src_top, src_width, src_height, flags) :
+		filter(src, dst, src_left, src_top, src_width, src_height, color_type, dst_bpp_s1);
+	if (!filtered || !sharpen(dst, flags)) {
+		FreeImage_Unload(dst);
+		return nullptr;
+	}
+
+	return dst;
+}
+
+bool CResizeEngine::scaleInto(FIBITMAP *src, FIBITMAP *dst, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags) {
+	TraceScope trace(TraceCategory::eRescale, "CResizeEngine::scaleInto");
+
+	// a 24-bit destination requests a true color result for greyscale images
+	if (FreeImage_GetBPP(dst) == 24) {
+		flags |= FI_RESCALE_TRUE_COLOR;
+	}
+
+	FREE_IMAGE_COLOR_TYPE color_type;
+	unsigned dst_bpp, dst_bpp_s1;
+	getFormat(src, flags, color_type, dst_bpp, dst_bpp_s1);
+
+	// 16-bit images may also be filtered into their standard bitmap (8, 24 or 32-bit), keeping the high byte of each sample
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	if (image_type == FIT_RGBAH) {
+		// no half float filters, see FreeImage_RescaleRect
+		return false;
+	}
+	const bool words_to_bytes = ((image_type == FIT_UINT16) || (image_type == FIT_RGB16) || (image_type == FIT_RGBA16)) &&
+		(FreeImage_GetImageType(dst) == FIT_BITMAP) && (FreeImage_GetBPP(dst) == dst_bpp / 2);
+	if (!words_to_bytes && ((FreeImage_GetImageType(dst) != image_type) || (FreeImage_GetBPP(dst) != dst_bpp))) {
+		return false;
+	}
+	// equal sizes are a copy or a conversion, not a rescale
+	if ((FreeImage_GetWidth(dst) == src_width) && (FreeImage_GetHeight(dst) == src_height)) {
+		return false;
+	}
+
+	if (FreeImage_GetBPP(dst) == 8) {
+		// the destination may wrap user memory, so always write its palette
+		FIRGBA8 * const dst_pal = FreeImage_GetPalette(dst);
+		if (color_type == FIC_MINISWHITE) {
+			CREATE_GREYSCALE_PALETTE_REVERSE(dst_pal, 256);
+		} else {
+			CREATE_GREYSCALE_PALETTE(dst_pal, 256);
+		}
+	}
+
+	if (usesLight(src, dst, color_type, flags)) {
+		return filterLight(src, dst, src_left, src_top, src_width, src_height, flags) && sharpen(dst, flags);
+	}
+	return filter(src, dst, src_left, src_top, src_width, src_height, color_type, dst_bpp_s1) && sharpen(dst, flags);
+}
+
+bool CResizeEngine::sharpen(FIBITMAP *dst, unsigned flags) {
+	if ((flags & FI_RESCALE_SHARPEN) != FI_RESCALE_SHARPEN) {
+		return true;
+	}
+	const unsigned percent = (flags >> 16) & 0xFF;
+	const unsigned tenths = (flags >> 24) & 0xFF;
+	const double amount = percent ? percent / 100.0 : 0.5;
+	const double sigma = tenths ? tenths / 10.0 : 0.8;
+	return UnsharpMaskInPlace(dst, sigma, amount);
+}
+
+bool CResizeEngine::filter(FIBITMAP *src, FIBITMAP *dst, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, FREE_IMAGE_COLOR_TYPE color_type, unsigned dst_bpp_s1) {
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	const unsigned dst_bpp = FreeImage_GetBPP(dst);
+	const unsigned dst_width = FreeImage_GetWidth(dst);
+	const unsigned dst_height = FreeImage_GetHeight(dst);
+
+	// large downscales first average blocks of pixels, the filter is left with a small ratio
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> reduced(nullptr, &FreeImage_Unload);
+	const unsigned factor_x = ReductionFactor(src_width, dst_width);
+	const unsigned factor_y = ReductionFactor(src_height, dst_height);
+	if ((factor_x > 1) || (factor_y > 1)) {
+		reduced.reset(BoxReduce(src, src_left, src_top, src_width, src_height, color_type, factor_x, factor_y));
+		if (reduced) {
+			src = reduced.get();
+			src_left = 0;
+			src_top = 0;
+			src_width = FreeImage_GetWidth(src);
+			src_height = FreeImage_GetHeight(src);
+		}
+	}
+
+	FIRGBA8 pal_buffer[256];
+	const FIRGBA8 *src_pal{};
+
+	// provide the source image's palette to the rescaler for
+	// FIC_PALETTE type images (this includes palletized greyscale
+	// images with an unordered palette as well as transparent images)
+	if (color_type == FIC_PALETTE) {
+		if (dst_bpp == 32) {
+			// a 32-bit destination image signals transparency, so
+			// create an RGBA palette from the source palette
+			src_pal = GetRGBAPalette(src, pal_buffer);
+		} else {
+			src_pal = FreeImage_GetPalette(src);
+		}
+	}
+
 	// calculate x and y offsets; since FreeImage uses bottom-up bitmaps, the
 	// value of src_offset_y is measured from the bottom of the image
 	unsigned src_offset_x = src_left;
@@ -392,8 +1812,7 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 				// a temporary image
 				tmp = FreeImage_AllocateT(image_type, dst_width, src_height, dst_bpp_s1, 0, 0, 0);
 				if (!tmp) {
-					FreeImage_Unload(dst);
-					return nullptr;
+					return false;
 				}
 			} else {
 				// source and destination heights are equal so, we can directly
@@ -458,8 +1877,7 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 				// a temporary image
 				tmp = FreeImage_AllocateT(image_type, src_width, dst_height, dst_bpp_s1, 0, 0, 0);
 				if (!tmp) {
-					FreeImage_Unload(dst);
-					return nullptr;
+					return false;
 				}
 			} else {
 				// source and destination widths are equal so, we can directly
@@ -502,13 +1920,26 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 		}
 	}
 
-	return dst;
-} 
+	return true;
+}
 
 void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const FIRGBA8 *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
 
-	// allocate and calculate the contributions
-	CWeightsTable weightsTable(m_pFilter, dst_width, src_width);
+	// retrieve the contributions, tables are reused for repeated geometries
+	const auto weightsTable = CWeightsTable::Acquire(m_pFilter, dst_width, src_width);
+
+	// rows are independent, process them by bands in parallel
+	ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(src) + FreeImage_GetLine(dst)), [&](unsigned row_begin, unsigned row_end) {
+		if (UseFixedFilter(src, dst)) {
+			HorizontalFilterFixedBand(*weightsTable, row_begin, row_end, src, src_offset_x, src_offset_y, dst, dst_width);
+		} else {
+			horizontalFilterBand(*weightsTable, row_begin, row_end, src, src_offset_x, src_offset_y, src_pal, dst, dst_width);
+		}
+	});
+}
+
+/// Performs horizontal image filtering of rows [row_begin, row_end)
+void CResizeEngine::horizontalFilterBand(const CWeightsTable& weightsTable, unsigned row_begin, unsigned row_end, FIBITMAP *const src, unsigned src_offset_x, unsigned src_offset_y, const FIRGBA8 *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
 
 	// step through rows
 	switch (FreeImage_GetImageType(src)) {
@@ -524,9 +1955,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							src_offset_x >>= 3;
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = row_begin; y < row_end; y++) {
 									// scale each row
-									const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+									const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 									uint8_t * const dst_bits = FreeImage_GetScanLine(dst, y);
 
 									for (unsigned x = 0; x < dst_width; x++) {
@@ -548,9 +1979,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = row_begin; y < row_end; y++) {
 									// scale each row
-									const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+									const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 									uint8_t * const dst_bits = FreeImage_GetScanLine(dst, y);
 
 									for (unsigned x = 0; x < dst_width; x++) {
@@ -581,9 +2012,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							src_offset_x >>= 3;
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = row_begin; y < row_end; y++) {
 									// scale each row
-									const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+									const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 									uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 									for (unsigned x = 0; x < dst_width; x++) {
@@ -612,9 +2043,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = row_begin; y < row_end; y++) {
 									// scale each row
-									const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+									const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 									uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 									for (unsigned x = 0; x < dst_width; x++) {
@@ -649,9 +2080,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette here
 							src_offset_x >>= 3;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = row_begin; y < row_end; y++) {
 								// scale each row
-								const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+								const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 								uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 								for (unsigned x = 0; x < dst_width; x++) {
@@ -695,9 +2126,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = row_begin; y < row_end; y++) {
 								// scale each row
-								const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+								const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 								uint8_t * const dst_bits = FreeImage_GetScanLine(dst, y);
 
 								for (unsigned x = 0; x < dst_width; x++) {
@@ -726,9 +2157,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = row_begin; y < row_end; y++) {
 								// scale each row
-								const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+								const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 								uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 								for (unsigned x = 0; x < dst_width; x++) {
@@ -764,9 +2195,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = row_begin; y < row_end; y++) {
 								// scale each row
-								const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+								const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 								uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 								for (unsigned x = 0; x < dst_width; x++) {
@@ -810,9 +2241,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// into an 8 bpp destination image
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = row_begin; y < row_end; y++) {
 									// scale each row
-									const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+									const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 									uint8_t * const dst_bits = FreeImage_GetScanLine(dst, y);
 
 									for (unsigned x = 0; x < dst_width; x++) {
@@ -835,9 +2266,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = row_begin; y < row_end; y++) {
 									// scale each row
-									const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+									const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 									uint8_t * const dst_bits = FreeImage_GetScanLine(dst, y);
 
 									for (unsigned x = 0; x < dst_width; x++) {
@@ -867,9 +2298,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// transparently convert the non-transparent 8-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = row_begin; y < row_end; y++) {
 									// scale each row
-									const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+									const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 									uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 									for (unsigned x = 0; x < dst_width; x++) {
@@ -899,9 +2330,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = row_begin; y < row_end; y++) {
 									// scale each row
-									const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+									const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 									uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 									for (unsigned x = 0; x < dst_width; x++) {
@@ -935,9 +2366,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						{
 							// transparently convert the transparent 8-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = row_begin; y < row_end; y++) {
 								// scale each row
-								const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+								const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 								uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 								for (unsigned x = 0; x < dst_width; x++) {
@@ -978,9 +2409,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 					// transparently convert the 16-bit non-transparent image to 24 bpp
 					if (IS_FORMAT_RGB565(src)) {
 						// image has 565 format
-						for (unsigned y = 0; y < height; y++) {
+						for (unsigned y = row_begin; y < row_end; y++) {
 							// scale each row
-							const uint16_t * const src_bits = (uint16_t *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(uint16_t);
+							const uint16_t * const src_bits = (const uint16_t *)FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x / sizeof(uint16_t);
 							uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 							for (unsigned x = 0; x < dst_width; x++) {
@@ -1010,9 +2441,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						}
 					} else {
 						// image has 555 format
-						for (unsigned y = 0; y < height; y++) {
+						for (unsigned y = row_begin; y < row_end; y++) {
 							// scale each row
-							const uint16_t * const src_bits = (uint16_t *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
+							const uint16_t * const src_bits = (const uint16_t *)FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x;
 							uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 							for (unsigned x = 0; x < dst_width; x++) {
@@ -1047,9 +2478,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 				case 24:
 				{
 					// scale the 24-bit non-transparent image into a 24 bpp destination image
-					for (unsigned y = 0; y < height; y++) {
+					for (unsigned y = row_begin; y < row_end; y++) {
 						// scale each row
-						const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * 3;
+						const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x * 3;
 						uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 						for (unsigned x = 0; x < dst_width; x++) {
@@ -1083,9 +2514,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 				case 32:
 				{
 					// scale the 32-bit transparent image into a 32 bpp destination image
-					for (unsigned y = 0; y < height; y++) {
+					for (unsigned y = row_begin; y < row_end; y++) {
 						// scale each row
-						const uint8_t * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * 4;
+						const uint8_t * const src_bits = FreeImage_GetConstScanLine(src, y + src_offset_y) + src_offset_x * 4;
 						uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
 
 						for (unsigned x = 0; x < dst_width; x++) {
@@ -1122,164 +2553,57 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		break;
 
 		case FIT_UINT16:
-		{
-			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(uint16_t);
-
-			for (unsigned y = 0; y < height; y++) {
-				// scale each row
-				const uint16_t *src_bits = (uint16_t*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(uint16_t);
-				uint16_t *dst_bits = (uint16_t*)FreeImage_GetScanLine(dst, y);
-
-				for (unsigned x = 0; x < dst_width; x++) {
-					// loop through row
-					const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
-					const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
-					const uint16_t *pixel = src_bits + iLeft * wordspp;
-					double value = 0;
-
-					// for (i = iLeft to iRight)
-					for (unsigned i = 0; i < iLimit; i++) {
-						// scan between boundaries
-						// accumulate weighted effect of each neighboring pixel
-						const double weight = weightsTable.getWeight(x, i);						
-						value += (weight * (double)pixel[0]);
-						pixel++;
-					}
-
-					// clamp and place result in destination pixel
-					dst_bits[0] = (uint16_t)CLAMP<int>((int)(value + 0.5), 0, 0xFFFF);
-					dst_bits += wordspp;
-				}
-			}
-		}
-		break;
-
 		case FIT_RGB16:
-		{
-			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(uint16_t);
-
-			for (unsigned y = 0; y < height; y++) {
-				// scale each row
-				const uint16_t *src_bits = (uint16_t*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(uint16_t);
-				uint16_t *dst_bits = (uint16_t*)FreeImage_GetScanLine(dst, y);
-
-				for (unsigned x = 0; x < dst_width; x++) {
-					// loop through row
-					const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
-					const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
-					const uint16_t *pixel = src_bits + iLeft * wordspp;
-					double r = 0, g = 0, b = 0;
-
-					// for (i = iLeft to iRight)
-					for (unsigned i = 0; i < iLimit; i++) {
-						// scan between boundaries
-						// accumulate weighted effect of each neighboring pixel
-						const double weight = weightsTable.getWeight(x, i);						
-						r += (weight * (double)pixel[0]);
-						g += (weight * (double)pixel[1]);
-						b += (weight * (double)pixel[2]);
-						pixel += wordspp;
-					}
-
-					// clamp and place result in destination pixel
-					dst_bits[0] = (uint16_t)CLAMP<int>((int)(r + 0.5), 0, 0xFFFF);
-					dst_bits[1] = (uint16_t)CLAMP<int>((int)(g + 0.5), 0, 0xFFFF);
-					dst_bits[2] = (uint16_t)CLAMP<int>((int)(b + 0.5), 0, 0xFFFF);
-					dst_bits += wordspp;
-				}
-			}
-		}
-		break;
-
 		case FIT_RGBA16:
-		{
-			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(uint16_t);
-
-			for (unsigned y = 0; y < height; y++) {
-				// scale each row
-				const uint16_t *src_bits = (uint16_t*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(uint16_t);
-				uint16_t *dst_bits = (uint16_t*)FreeImage_GetScanLine(dst, y);
-
-				for (unsigned x = 0; x < dst_width; x++) {
-					// loop through row
-					const unsigned iLeft = weightsTable.getLeftBoundary(x);				// retrieve left boundary
-					const unsigned iLimit = weightsTable.getRightBoundary(x) - iLeft;	// retrieve right boundary
-					const uint16_t *pixel = src_bits + iLeft * wordspp;
-					double r = 0, g = 0, b = 0, a = 0;
-
-					// for (i = iLeft to iRight)
-					for (unsigned i = 0; i < iLimit; i++) {
-						// scan between boundaries
-						// accumulate weighted effect of each neighboring pixel
-						const double weight = weightsTable.getWeight(x, i);						
-						r += (weight * (double)pixel[0]);
-						g += (weight * (double)pixel[1]);
-						b += (weight * (double)pixel[2]);
-						a += (weight * (double)pixel[3]);
-						pixel += wordspp;
-					}
-
-					// clamp and place result in destination pixel
-					dst_bits[0] = (uint16_t)CLAMP<int>((int)(r + 0.5), 0, 0xFFFF);
-					dst_bits[1] = (uint16_t)CLAMP<int>((int)(g + 0.5), 0, 0xFFFF);
-					dst_bits[2] = (uint16_t)CLAMP<int>((int)(b + 0.5), 0, 0xFFFF);
-					dst_bits[3] = (uint16_t)CLAMP<int>((int)(a + 0.5), 0, 0xFFFF);
-					dst_bits += wordspp;
-				}
+			if (FreeImage_GetImageType(dst) == FIT_BITMAP) {
+				HorizontalFilterWordsBand<uint8_t>(weightsTable, row_begin, row_end, src, src_offset_x, src_offset_y, dst, dst_width);
+			} else {
+				HorizontalFilterWordsBand<uint16_t>(weightsTable, row_begin, row_end, src, src_offset_x, src_offset_y, dst, dst_width);
 			}
-		}
-		break;
+			break;
 
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
-		{
-			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
-			const unsigned floatspp = (FreeImage_GetLine(src) / src_width) / sizeof(float);
-
-			for (unsigned y = 0; y < height; y++) {
-				// scale each row
-				auto *src_bits = (const float*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(float);
-				auto *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
-
-				for (unsigned x = 0; x < dst_width; x++) {
-					// loop through row
-					const unsigned iLeft = weightsTable.getLeftBoundary(x);    // retrieve left boundary
-					const unsigned iRight = weightsTable.getRightBoundary(x);  // retrieve right boundary
-					double value[4] = {0, 0, 0, 0};                            // 4 = 128 bpp max
-
-					for (unsigned i = iLeft; i < iRight; i++) {
-						// scan between boundaries
-						// accumulate weighted effect of each neighboring pixel
-						const double weight = weightsTable.getWeight(x, i-iLeft);
-
-						unsigned index = i * floatspp;	// pixel index
-						for (unsigned j = 0; j < floatspp; j++) {
-							value[j] += (weight * (double)src_bits[index++]);
-						}
-					}
-
-					// place result in destination pixel
-					for (unsigned j = 0; j < floatspp; j++) {
-						dst_bits[j] = (float)value[j];
-					}
+			HorizontalFilterFloatBand(weightsTable, row_begin, row_end, src, src_offset_x, src_offset_y, dst, dst_width);
+			break;
 
-					dst_bits += floatspp;
-				}
-			}
-		}
-		break;
+		case FIT_RGBAH:
+			// filtered as FIT_RGBAF, see FreeImage_RescaleRect
+			break;
 	}
 }
 
 /// Performs vertical image filtering
 void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned src_height, unsigned src_offset_x, unsigned src_offset_y, const FIRGBA8 *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
 
-	// allocate and calculate the contributions
-	CWeightsTable weightsTable(m_pFilter, dst_height, src_height);
+	// retrieve the contributions, tables are reused for repeated geometries
+	const auto weightsTable = CWeightsTable::Acquire(m_pFilter, dst_height, src_height);
+
+	// columns are independent, process them by bands in parallel
+	// a band should cover at least one cache line of a destination row
+	const unsigned dst_bytespp = std::max(1u, FreeImage_GetBPP(dst) / 8);
+	const unsigned min_columns = std::max(64 / dst_bytespp, CalculateBandRows(static_cast<size_t>(dst_height + src_height) * dst_bytespp));
+
+	// a band is filtered by tiles of columns, narrow enough for the source rows of a
+	// filter window to stay in cache while the destination rows are produced one by one
+	const unsigned bytespp = std::max(dst_bytespp, FreeImage_GetBPP(src) / 8);
+	const unsigned tile_columns = std::max(64 / bytespp, CalculateBandRows(static_cast<size_t>(weightsTable->getWindowSize()) * bytespp));
+
+	ParallelFor(0, width, min_columns, [&](unsigned col_begin, unsigned col_end) {
+		for (unsigned tile_begin = col_begin; tile_begin < col_end; tile_begin += tile_columns) {
+			const unsigned tile_end = std::min(col_end, tile_begin + tile_columns);
+			if (UseFixedFilter(src, dst)) {
+				VerticalFilterFixedBand(*weightsTable, tile_begin, tile_end, src, src_offset_x, src_offset_y, dst, dst_height);
+			} else {
+				verticalFilterBand(*weightsTable, tile_begin, tile_end, src, src_offset_x, src_offset_y, src_pal, dst, dst_height);
+			}
+		}
+	});
+}
+
+/// Performs vertical image filtering of columns [col_begin, col_end)
+void CResizeEngine::verticalFilterBand(const CWeightsTable& weightsTable, unsigned col_begin, unsigned col_end, FIBITMAP *const src, unsigned src_offset_x, unsigned src_offset_y, const FIRGBA8 *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
 
 	// step through columns
 	switch (FreeImage_GetImageType(src)) {
@@ -1292,7 +2616,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 				case 1:
 				{
 					const unsigned src_pitch = FreeImage_GetPitch(src);
-					const uint8_t * const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + (src_offset_x >> 3);
+					const uint8_t * const src_base = FreeImage_GetConstBits(src) + src_offset_y * src_pitch + (src_offset_x >> 3);
 
 					switch (FreeImage_GetBPP(dst)) {
 						case 8:
@@ -1300,7 +2624,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the 1-bit non-transparent greyscale image to 8 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = col_begin; x < col_end; x++) {
 									// work on column x in dst
 									uint8_t *dst_bits = dst_base + x;
 									const unsigned index = x >> 3;
@@ -1330,7 +2654,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = col_begin; x < col_end; x++) {
 									// work on column x in dst
 									uint8_t *dst_bits = dst_base + x;
 									const unsigned index = x >> 3;
@@ -1366,7 +2690,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the non-transparent 1-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = col_begin; x < col_end; x++) {
 									// work on column x in dst
 									uint8_t *dst_bits = dst_base + x * 3;
 									const unsigned index = x >> 3;
@@ -1401,7 +2725,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = col_begin; x < col_end; x++) {
 									// work on column x in dst
 									uint8_t *dst_bits = dst_base + x * 3;
 									const unsigned index = x >> 3;
@@ -1439,7 +2763,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 1-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = col_begin; x < col_end; x++) {
 								// work on column x in dst
 								uint8_t *dst_bits = dst_base + x * 4;
 								const unsigned index = x >> 3;
@@ -1483,14 +2807,14 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 				case 4:
 				{
 					const unsigned src_pitch = FreeImage_GetPitch(src);
-					const uint8_t *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + (src_offset_x >> 1);
+					const uint8_t *const src_base = FreeImage_GetConstBits(src) + src_offset_y * src_pitch + (src_offset_x >> 1);
 
 					switch (FreeImage_GetBPP(dst)) {
 						case 8:
 						{
 							// transparently convert the non-transparent 4-bit greyscale image to 8 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = col_begin; x < col_end; x++) {
 								// work on column x in dst
 								uint8_t *dst_bits = dst_base + x;
 								const unsigned index = x >> 1;
@@ -1523,7 +2847,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the non-transparent 4-bit image to 24 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = col_begin; x < col_end; x++) {
 								// work on column x in dst
 								uint8_t *dst_bits = dst_base + x * 3;
 								const unsigned index = x >> 1;
@@ -1562,7 +2886,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 4-bit image to 32 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = col_begin; x < col_end; x++) {
 								// work on column x in dst
 								uint8_t *dst_bits = dst_base + x * 4;
 								const unsigned index = x >> 1;
@@ -1605,7 +2929,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 				case 8:
 				{
 					const unsigned src_pitch = FreeImage_GetPitch(src);
-					const uint8_t *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x;
+					const uint8_t *const src_base = FreeImage_GetConstBits(src) + src_offset_y * src_pitch + src_offset_x;
 
 					switch (FreeImage_GetBPP(dst)) {
 						case 8:
@@ -1613,7 +2937,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// scale the 8-bit non-transparent greyscale image into an 8 bpp destination image
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = col_begin; x < col_end; x++) {
 									// work on column x in dst
 									uint8_t *dst_bits = dst_base + x;
 
@@ -1638,29 +2962,19 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 									}
 								}
 							} else {
-								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
-									// work on column x in dst
-									uint8_t *dst_bits = dst_base + x;
+								// we do not have a palette, accumulate chunks of source rows
+								double sums[kVerticalChunk];
+								for (unsigned x = col_begin; x < col_end; x += kVerticalChunk) {
+									const unsigned columns = std::min(col_end - x, kVerticalChunk);
 
-									// scale each column
 									for (unsigned y = 0; y < dst_height; y++) {
-										// loop through column
-										const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
-										const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
-										const uint8_t *src_bits = src_base + iLeft * src_pitch + x;
-										double value = 0;
+										AccumulateWeightedRows(weightsTable, y, src_base + x, src_pitch, sums, columns);
 
-										for (unsigned i = 0; i < iLimit; i++) {
-											// scan between boundaries
-											// accumulate weighted effect of each neighboring pixel
-											value += (weightsTable.getWeight(y, i) * (double)*src_bits);
-											src_bits += src_pitch;
+										// clamp and place results in destination pixels
+										uint8_t *dst_bits = dst_base + (size_t)y * dst_pitch + x;
+										for (unsigned j = 0; j < columns; j++) {
+											dst_bits[j] = (uint8_t)CLAMP<int>((int)(sums[j] + 0.5), 0, 0xFF);
 										}
-
-										// clamp and place result in destination pixel
-										*dst_bits = (uint8_t)CLAMP<int>((int)(value + 0.5), 0, 0xFF);
-										dst_bits += dst_pitch;
 									}
 								}
 							}
@@ -1672,7 +2986,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the non-transparent 8-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = col_begin; x < col_end; x++) {
 									// work on column x in dst
 									uint8_t *dst_bits = dst_base + x * 3;
 
@@ -1704,7 +3018,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = col_begin; x < col_end; x++) {
 									// work on column x in dst
 									uint8_t *dst_bits = dst_base + x * 3;
 
@@ -1739,7 +3053,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 8-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = col_begin; x < col_end; x++) {
 								// work on column x in dst
 								uint8_t *dst_bits = dst_base + x * 4;
 
@@ -1781,11 +3095,11 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 				{
 					// transparently convert the 16-bit non-transparent image to 24 bpp
 					const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(uint16_t);
-					const uint16_t *const src_base = (uint16_t *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x;
+					const uint16_t *const src_base = (const uint16_t *)FreeImage_GetConstBits(src) + src_offset_y * src_pitch + src_offset_x;
 
 					if (IS_FORMAT_RGB565(src)) {
 						// image has 565 format
-						for (unsigned x = 0; x < width; x++) {
+						for (unsigned x = col_begin; x < col_end; x++) {
 							// work on column x in dst
 							uint8_t *dst_bits = dst_base + x * 3;
 
@@ -1816,7 +3130,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						}
 					} else {
 						// image has 555 format
-						for (unsigned x = 0; x < width; x++) {
+						for (unsigned x = col_begin; x < col_end; x++) {
 							// work on column x in dst
 							uint8_t *dst_bits = dst_base + x * 3;
 
@@ -1853,9 +3167,9 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 				{
 					// scale the 24-bit transparent image into a 24 bpp destination image
 					const unsigned src_pitch = FreeImage_GetPitch(src);
-					const uint8_t *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * 3;
+					const uint8_t *const src_base = FreeImage_GetConstBits(src) + src_offset_y * src_pitch + src_offset_x * 3;
 
-					for (unsigned x = 0; x < width; x++) {
+					for (unsigned x = col_begin; x < col_end; x++) {
 						// work on column x in dst
 						const unsigned index = x * 3;
 						uint8_t *dst_bits = dst_base + index;
@@ -1892,9 +3206,9 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 				{
 					// scale the 32-bit transparent image into a 32 bpp destination image
 					const unsigned src_pitch = FreeImage_GetPitch(src);
-					const uint8_t *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * 4;
+					const uint8_t *const src_base = FreeImage_GetConstBits(src) + src_offset_y * src_pitch + src_offset_x * 4;
 
-					for (unsigned x = 0; x < width; x++) {
+					for (unsigned x = col_begin; x < col_end; x++) {
 						// work on column x in dst
 						const unsigned index = x * 4;
 						uint8_t *dst_bits = dst_base + index;
@@ -1933,184 +3247,188 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		break;
 
 		case FIT_UINT16:
-		{
-			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(uint16_t);
-
-			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(uint16_t);
-			uint16_t *const dst_base = (uint16_t *)FreeImage_GetBits(dst);
-
-			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(uint16_t);
-			const uint16_t *const src_base = (uint16_t *)FreeImage_GetBits(src)	+ src_offset_y * src_pitch + src_offset_x * wordspp;
-
-			for (unsigned x = 0; x < width; x++) {
-				// work on column x in dst
-				const unsigned index = x * wordspp;	// pixel index
-				uint16_t *dst_bits = dst_base + index;
-
-				// scale each column
-				for (unsigned y = 0; y < dst_height; y++) {
-					// loop through column
-					const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
-					const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
-					const uint16_t *src_bits = src_base + iLeft * src_pitch + index;
-					double value = 0;
-
-					for (unsigned i = 0; i < iLimit; i++) {
-						// scan between boundaries
-						// accumulate weighted effect of each neighboring pixel
-						const double weight = weightsTable.getWeight(y, i);
-						value += (weight * (double)src_bits[0]);
-						src_bits += src_pitch;
-					}
+		case FIT_RGB16:
+		case FIT_RGBA16:
+			if (FreeImage_GetImageType(dst) == FIT_BITMAP) {
+				VerticalFilterWordsBand<uint8_t>(weightsTable, col_begin, col_end, src, src_offset_x, src_offset_y, dst, dst_height);
+			} else {
+				VerticalFilterWordsBand<uint16_t>(weightsTable, col_begin, col_end, src, src_offset_x, src_offset_y, dst, dst_height);
+			}
+			break;
 
-					// clamp and place result in destination pixel
-					dst_bits[0] = (uint16_t)CLAMP<int>((int)(value + 0.5), 0, 0xFFFF);
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			VerticalFilterFloatBand(weightsTable, col_begin, col_end, src, src_offset_x, src_offset_y, dst, dst_height);
+			break;
 
-					dst_bits += dst_pitch;
-				}
+		case FIT_RGBAH:
+			// filtered as FIT_RGBAF, see FreeImage_RescaleRect
+			break;
+	}
+}
+
+// --------------------------------------------------------------------------
+// Streaming resizer
+
+bool CStreamingResizer::isSupported(FIBITMAP *info) {
+	switch (FreeImage_GetImageType(info)) {
+		case FIT_BITMAP:
+			switch (FreeImage_GetBPP(info)) {
+				case 8:
+					// palette indices can't be filtered
+					return FreeImage_GetColorType(info) != FIC_PALETTE;
+				case 24:
+				case 32:
+					return true;
+				default:
+					return false;
 			}
-		}
-		break;
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			return true;
+		default:
+			return false;
+	}
+}
 
+CStreamingResizer::CStreamingResizer(CGenericFilter *pFilter, FIBITMAP *info, unsigned dst_width, unsigned dst_height, FI_RowsResizedProc callback, void *user_data)
+	: m_Type(FreeImage_GetImageType(info))
+	, m_SrcWidth(FreeImage_GetWidth(info))
+	, m_SrcHeight(FreeImage_GetHeight(info))
+	, m_DstWidth(dst_width)
+	, m_DstHeight(dst_height)
+	, m_Callback(callback)
+	, m_UserData(user_data) {
+
+	switch (m_Type) {
+		case FIT_BITMAP:
+			m_SampleBytes = 1;
+			break;
+		case FIT_UINT16:
 		case FIT_RGB16:
-		{
-			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(uint16_t);
-
-			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(uint16_t);
-			uint16_t *const dst_base = (uint16_t *)FreeImage_GetBits(dst);
-
-			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(uint16_t);
-			const uint16_t *const src_base = (uint16_t *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
-
-			for (unsigned x = 0; x < width; x++) {
-				// work on column x in dst
-				const unsigned index = x * wordspp;	// pixel index
-				uint16_t *dst_bits = dst_base + index;
-
-				// scale each column
-				for (unsigned y = 0; y < dst_height; y++) {
-					// loop through column
-					const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
-					const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
-					const uint16_t *src_bits = src_base + iLeft * src_pitch + index;
-					double r = 0, g = 0, b = 0;
-
-					for (unsigned i = 0; i < iLimit; i++) {
-						// scan between boundaries
-						// accumulate weighted effect of each neighboring pixel
-						const double weight = weightsTable.getWeight(y, i);					
-						r += (weight * (double)src_bits[0]);
-						g += (weight * (double)src_bits[1]);
-						b += (weight * (double)src_bits[2]);
-
-						src_bits += src_pitch;
-					}
+		case FIT_RGBA16:
+			m_SampleBytes = 2;
+			break;
+		default:
+			m_SampleBytes = 4;
+			break;
+	}
+	m_Channels = FreeImage_GetBPP(info) / (8 * m_SampleBytes);
 
-					// clamp and place result in destination pixel
-					dst_bits[0] = (uint16_t)CLAMP<int>((int)(r + 0.5), 0, 0xFFFF);
-					dst_bits[1] = (uint16_t)CLAMP<int>((int)(g + 0.5), 0, 0xFFFF);
-					dst_bits[2] = (uint16_t)CLAMP<int>((int)(b + 0.5), 0, 0xFFFF);
+	// like CResizeEngine, a pass is skipped when its size does not change
+	if (m_SrcWidth != m_DstWidth) {
+		m_XWeights = CWeightsTable::Acquire(pFilter, m_DstWidth, m_SrcWidth);
+	}
+	if (m_SrcHeight != m_DstHeight) {
+		m_YWeights = CWeightsTable::Acquire(pFilter, m_DstHeight, m_SrcHeight);
+	}
 
-					dst_bits += dst_pitch;
-				}
+	// a window spans at most getWindowSize rows, the ring holds the last ones pushed
+	m_RingRows = m_YWeights ? m_YWeights->getWindowSize() : 1;
+	m_RowFloats = static_cast<size_t>(m_DstWidth) * m_Channels;
+
+	m_Line.resize(static_cast<size_t>(m_SrcWidth) * m_Channels);
+	m_Ring.resize(2 * m_RingRows * m_RowFloats);
+	m_Sums.resize(m_RowFloats);
+	m_Row.resize(m_RowFloats * m_SampleBytes);
+}
+
+void CStreamingResizer::pushRow(const uint8_t *bits) {
+	const unsigned row = m_SrcRow++;
+
+	// the windows only move down, rows above the window of the next destination row are not needed anymore
+	if ((m_DstRow == m_DstHeight) || (m_YWeights && (row < m_YWeights->getLeftBoundary(m_DstRow)))) {
+		return;
+	}
+
+	float *slot = &m_Ring[(row % m_RingRows) * m_RowFloats];
+	float *line = m_XWeights ? m_Line.data() : slot;
+	const size_t count = m_Line.size();
+
+	switch (m_SampleBytes) {
+		case 1:
+			for (size_t i = 0; i < count; i++) {
+				line[i] = bits[i];
+			}
+			break;
+		case 2:
+		{
+			const uint16_t *words = (const uint16_t *)bits;
+			for (size_t i = 0; i < count; i++) {
+				line[i] = words[i];
 			}
 		}
 		break;
+		default:
+			memcpy(line, bits, count * sizeof(float));
+			break;
+	}
 
-		case FIT_RGBA16:
-		{
-			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(uint16_t);
-
-			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(uint16_t);
-			uint16_t *const dst_base = (uint16_t *)FreeImage_GetBits(dst);
-
-			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(uint16_t);
-			const uint16_t *const src_base = (uint16_t *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
-
-			for (unsigned x = 0; x < width; x++) {
-				// work on column x in dst
-				const unsigned index = x * wordspp;	// pixel index
-				uint16_t *dst_bits = dst_base + index;
-
-				// scale each column
-				for (unsigned y = 0; y < dst_height; y++) {
-					// loop through column
-					const unsigned iLeft = weightsTable.getLeftBoundary(y);				// retrieve left boundary
-					const unsigned iLimit = weightsTable.getRightBoundary(y) - iLeft;	// retrieve right boundary
-					const uint16_t *src_bits = src_base + iLeft * src_pitch + index;
-					double r = 0, g = 0, b = 0, a = 0;
-
-					for (unsigned i = 0; i < iLimit; i++) {
-						// scan between boundaries
-						// accumulate weighted effect of each neighboring pixel
-						const double weight = weightsTable.getWeight(y, i);					
-						r += (weight * (double)src_bits[0]);
-						g += (weight * (double)src_bits[1]);
-						b += (weight * (double)src_bits[2]);
-						a += (weight * (double)src_bits[3]);
-
-						src_bits += src_pitch;
-					}
+	if (m_XWeights) {
+		HorizontalFloatRowKernel filterRow = HorizontalFloatRow<3>;
+		if (m_Channels == 1) {
+			filterRow = gKernels.horizontalFloat1.load(std::memory_order_relaxed);
+		} else if (m_Channels == 4) {
+			filterRow = gKernels.horizontalFloat4.load(std::memory_order_relaxed);
+		}
+		filterRow(*m_XWeights, line, slot, m_DstWidth);
+	}
+
+	// the second copy makes a window wrapping around the end of the ring contiguous
+	memcpy(slot + m_RingRows * m_RowFloats, slot, m_RowFloats * sizeof(float));
+}
 
-					// clamp and place result in destination pixel
-					dst_bits[0] = (uint16_t)CLAMP<int>((int)(r + 0.5), 0, 0xFFFF);
-					dst_bits[1] = (uint16_t)CLAMP<int>((int)(g + 0.5), 0, 0xFFFF);
-					dst_bits[2] = (uint16_t)CLAMP<int>((int)(b + 0.5), 0, 0xFFFF);
-					dst_bits[3] = (uint16_t)CLAMP<int>((int)(a + 0.5), 0, 0xFFFF);
+void CStreamingResizer::emitRow() {
+	const unsigned y = m_DstRow++;
 
-					dst_bits += dst_pitch;
-				}
+	const float *sums = m_Ring.data();
+	if (m_YWeights) {
+		const unsigned iLeft = m_YWeights->getLeftBoundary(y);
+		const unsigned iLimit = m_YWeights->getRightBoundary(y) - iLeft;
+		const VerticalFloatRowKernel filterRow = gKernels.verticalFloat.load(std::memory_order_relaxed);
+		filterRow(m_YWeights->getFloatWeights(y), iLimit, &m_Ring[(iLeft % m_RingRows) * m_RowFloats], m_RowFloats, m_Sums.data(), (unsigned)m_RowFloats);
+		sums = m_Sums.data();
+	}
+
+	// clamp and round integer samples
+	switch (m_SampleBytes) {
+		case 1:
+			for (size_t i = 0; i < m_RowFloats; i++) {
+				m_Row[i] = (uint8_t)(CLAMP(sums[i], 0.0F, 255.0F) + 0.5F);
+			}
+			break;
+		case 2:
+		{
+			uint16_t *words = (uint16_t *)m_Row.data();
+			for (size_t i = 0; i < m_RowFloats; i++) {
+				words[i] = (uint16_t)(CLAMP(sums[i], 0.0F, 65535.0F) + 0.5F);
 			}
 		}
 		break;
+		default:
+			memcpy(m_Row.data(), sums, m_RowFloats * sizeof(float));
+			break;
+	}
 
-		case FIT_FLOAT:
-		case FIT_RGBF:
-		case FIT_RGBAF:
-		{
-			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
-			const unsigned floatspp = (FreeImage_GetLine(src) / width) / sizeof(float);
-
-			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(float);
-			float *const dst_base = (float *)FreeImage_GetBits(dst);
-
-			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(float);
-			const float *const src_base = (float *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * floatspp;
-
-			for (unsigned x = 0; x < width; x++) {
-				// work on column x in dst
-				const unsigned index = x * floatspp;	// pixel index
-				float *dst_bits = (float *)dst_base + index;
-
-				// scale each column
-				for (unsigned y = 0; y < dst_height; y++) {
-					// loop through column
-					const unsigned iLeft = weightsTable.getLeftBoundary(y);    // retrieve left boundary
-					const unsigned iRight = weightsTable.getRightBoundary(y);  // retrieve right boundary
-					const float *src_bits = src_base + iLeft * src_pitch + index;
-					double value[4] = {0, 0, 0, 0};                            // 4 = 128 bpp max
-
-					for (unsigned i = iLeft; i < iRight; i++) {
-						// scan between boundaries
-						// accumulate weighted effect of each neighboring pixel
-						const double weight = weightsTable.getWeight(y, i - iLeft);
-						for (unsigned j = 0; j < floatspp; j++) {
-							value[j] += (weight * (double)src_bits[j]);
-						}
-						src_bits += src_pitch;
-					}
+	m_Callback(m_Row.data(), y, m_UserData);
+}
 
-					// place result in destination pixel
-					for (unsigned j = 0; j < floatspp; j++) {
-						dst_bits[j] = (float)value[j];
-					}
-					dst_bits += dst_pitch;
-				}
-			}
+unsigned CStreamingResizer::push(const uint8_t *bits, unsigned count, unsigned pitch) {
+	const unsigned first = m_DstRow;
+	count = std::min(count, m_SrcHeight - m_SrcRow);
+
+	for (unsigned i = 0; i < count; i++) {
+		pushRow(bits + static_cast<size_t>(i) * pitch);
+
+		// emit the destination rows whose window is complete
+		while ((m_DstRow < m_DstHeight) && (m_YWeights ? (m_YWeights->getRightBoundary(m_DstRow) <= m_SrcRow) : (m_DstRow < m_SrcRow))) {
+			emitRow();
 		}
-		break;
 	}
+	return m_DstRow - first;
 }
@@ -34,26 +34,26 @@
 */
 class CWeightsTable
 {
-/**
-  Sampled filter weight table.<br>
-  Contribution information for a single pixel
-*/
-typedef struct {
-	/// Normalized weights of neighboring pixels
-	double *Weights;
-	/// Bounds of source pixels window
-	unsigned Left, Right;
-} Contribution;
-
 private:
-	/// Row (or column) of contribution weights 
-	Contribution *m_WeightTable;
+	/// Bounds of the source pixels window of every destination pixel, Left then Right
+	unsigned *m_Bounds;
 	/// Filter window size (of affecting source pixels) 
 	unsigned m_WindowSize;
+	/// Distance between the weights of two destination pixels, the window size rounded up to a multiple of 8
+	unsigned m_WindowStride;
 	/// Length of line (no. of rows / cols) 
 	unsigned m_LineLength;
+	/// Normalized weights of neighboring pixels, m_WindowStride values per destination pixel, zero past the window
+	double *m_Weights;
+	/// Weights in single precision, same layout
+	float *m_FloatWeights;
+	/// Weights in fixed point format, same layout
+	int16_t *m_FixedWeights;
 
 public:
+	/// Number of fractional bits of fixed point weights
+	static constexpr int FixedPointBits = 14;
+
 	/** 
 	Constructor<br>
 	Allocate and compute the weights table
@@ -69,29 +69,64 @@ public:
 	*/
 	~CWeightsTable();
 
+	CWeightsTable(const CWeightsTable&) = delete;
+	CWeightsTable& operator=(const CWeightsTable&) = delete;
+
+	/**
+	Returns a weights table from the cache of recently used tables or computes a new one.<br>
+	Tables are shared, since they depend only on the filter and on the lines lengths.
+	@param pFilter Filter used for upsampling or downsampling
+	@param uDstSize Length (in pixels) of the destination line buffer
+	@param uSrcSize Length (in pixels) of the source line buffer
+	*/
+	static std::shared_ptr<const CWeightsTable> Acquire(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize);
+
 	/** Retrieve a filter weight, given source and destination positions
 	@param dst_pos Pixel position in destination line buffer
 	@param src_pos Pixel position in source line buffer
 	@return Returns the filter weight
 	*/
-	double getWeight(unsigned dst_pos, unsigned src_pos) {
-		return m_WeightTable[dst_pos].Weights[src_pos];
+	double getWeight(unsigned dst_pos, unsigned src_pos) const {
+		return m_Weights[static_cast<size_t>(dst_pos) * m_WindowStride + src_pos];
+	}
+
+	/** Retrieve the filter window size
+	@return Returns the largest number of source pixels affecting a destination pixel
+	*/
+	unsigned getWindowSize() const {
+		return m_WindowSize;
 	}
 
 	/** Retrieve left boundary of source line buffer
 	@param dst_pos Pixel position in destination line buffer
 	@return Returns the left boundary of source line buffer
 	*/
-	unsigned getLeftBoundary(unsigned dst_pos) {
-		return m_WeightTable[dst_pos].Left;
+	unsigned getLeftBoundary(unsigned dst_pos) const {
+		return m_Bounds[2 * dst_pos];
 	}
 
 	/** Retrieve right boundary of source line buffer
 	@param dst_pos Pixel position in destination line buffer
 	@return Returns the right boundary of source line buffer
 	*/
-	unsigned getRightBoundary(unsigned dst_pos) {
-		return m_WeightTable[dst_pos].Right;
+	unsigned getRightBoundary(unsigned dst_pos) const {
+		return m_Bounds[2 * dst_pos + 1];
+	}
+
+	/** Retrieve filter weights in fixed point format (see FixedPointBits)
+	@param dst_pos Pixel position in destination line buffer
+	@return Returns weights of source pixels starting from the left boundary. The weights sum is exactly 1 << FixedPointBits.
+	*/
+	const int16_t* getFixedWeights(unsigned dst_pos) const {
+		return m_FixedWeights + static_cast<size_t>(dst_pos) * m_WindowStride;
+	}
+
+	/** Retrieve filter weights in single precision
+	@param dst_pos Pixel position in destination line buffer
+	@return Returns weights of source pixels starting from the left boundary, 32-byte aligned
+	*/
+	const float* getFloatWeights(unsigned dst_pos) const {
+		return m_FloatWeights + static_cast<size_t>(dst_pos) * m_WindowStride;
 	}
 };
 
@@ -159,8 +194,64 @@ public:
 	*/
 	FIBITMAP* scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags);
 
+	/** Scale an image into an already allocated destination image.
+
+	The destination size gives the scaled size. Its type and bit depth must be
+	the ones method scale would allocate; a 24-bit destination implies flag
+	FI_RESCALE_TRUE_COLOR for greyscale images. FIT_UINT16, FIT_RGB16 and
+	FIT_RGBA16 images may also be scaled into an 8, 24 or 32-bit FIT_BITMAP
+	destination, converted as they are filtered. The palette of an 8-bit
+	destination is always written.
+
+	@param src Pointer to the source image
+	@param dst Pointer to the destination image
+	@param src_left Left boundary of the source rectangle to be scaled
+	@param src_top Top boundary of the source rectangle to be scaled
+	@param src_width Width of the source rectangle to be scaled
+	@param src_height Height of the source rectangle to be scaled
+	@return Returns true if successful, returns false if dst does not match or has the size of the source rectangle
+	*/
+	bool scaleInto(FIBITMAP *src, FIBITMAP *dst, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags);
+
+	/** Sharpen a scaled image as requested by flag FI_RESCALE_SHARPEN.
+
+	The unsharp mask runs in place on the destination, right after its last filter pass,
+	so the scaled image is not copied. Methods scale and scaleInto call it.
+
+	@param dst Pointer to the scaled image
+	@param flags Rescale flags, with the amount and radius of FI_RESCALE_SHARPEN_AMOUNT and FI_RESCALE_SHARPEN_RADIUS
+	@return Returns true if successful or if no sharpening is requested
+	*/
+	static bool sharpen(FIBITMAP *dst, unsigned flags);
+
 private:
 
+	/**
+	Determines the color type of the source image as well as the bit depth
+	of the destination image and of the temporary image used by the first
+	filter stage
+	*/
+	static void getFormat(FIBITMAP *src, unsigned flags, FREE_IMAGE_COLOR_TYPE& color_type, unsigned& dst_bpp, unsigned& dst_bpp_s1);
+
+	/**
+	Scales the source rectangle into the whole destination image,
+	through a temporary image if both dimensions change
+	*/
+	bool filter(FIBITMAP *src, FIBITMAP *dst, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, FREE_IMAGE_COLOR_TYPE color_type, unsigned dst_bpp_s1);
+
+	/**
+	Returns true if flags FI_RESCALE_LINEAR_LIGHT or FI_RESCALE_PREMULTIPLY_ALPHA apply to the 8, 24 or 32-bit
+	source image, which is then scaled by method filterLight
+	*/
+	static bool usesLight(FIBITMAP *src, FIBITMAP *dst, FREE_IMAGE_COLOR_TYPE color_type, unsigned flags);
+
+	/**
+	Scales the source rectangle into the whole destination image like method filter, in float.
+	The first pass decodes sRGB samples to linear light and premultiplies colors with alpha as it reads them,
+	the last pass unpremultiplies and encodes the values as it writes them.
+	*/
+	bool filterLight(FIBITMAP *src, FIBITMAP *dst, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height, unsigned flags);
+
 	/**
 	Performs horizontal image filtering
 
@@ -191,6 +282,93 @@ private:
 	void verticalFilter(FIBITMAP * const src, const unsigned width, const unsigned src_height,
 			const unsigned src_offset_x, const unsigned src_offset_y, const FIRGBA8 * const src_pal,
 			FIBITMAP * const dst, const unsigned dst_height);
+
+	/**
+	Performs horizontal image filtering of a band of rows
+	@param weightsTable Contributions of source pixels
+	@param row_begin First row of the band
+	@param row_end Row after the last row of the band
+	@see horizontalFilter
+	*/
+	void horizontalFilterBand(const CWeightsTable& weightsTable, unsigned row_begin, unsigned row_end,
+			FIBITMAP * const src, const unsigned src_offset_x, const unsigned src_offset_y, const FIRGBA8 * const src_pal,
+			FIBITMAP * const dst, const unsigned dst_width);
+
+	/**
+	Performs vertical image filtering of a band of columns
+	@param weightsTable Contributions of source pixels
+	@param col_begin First column of the band
+	@param col_end Column after the last column of the band
+	@see verticalFilter
+	*/
+	void verticalFilterBand(const CWeightsTable& weightsTable, unsigned col_begin, unsigned col_end,
+			FIBITMAP * const src, const unsigned src_offset_x, const unsigned src_offset_y, const FIRGBA8 * const src_pal,
+			FIBITMAP * const dst, const unsigned dst_height);
+};
+
+// ---------------------------------------------
+
+/**
+ CStreamingResizer<br>
+ Scales the rows of an image as they are pushed, from the top. Each source row is 
+ filtered horizontally into a ring of float rows as large as the vertical filter window, 
+ a destination row is filtered vertically from the ring as soon as its window is complete. 
+ Rows are interleaved samples of 8-bit, 16-bit or float type, 1, 3 or 4 per pixel.
+*/
+class CStreamingResizer
+{
+public:
+	/**
+	Constructor, throws std::bad_alloc
+	@param pFilter Filter used to compute the weights, it is not kept
+	@param info Bitmap giving the type and size of the source rows, see isSupported
+	@param dst_width Destination image width
+	@param dst_height Destination image height
+	@param callback Receiver of the destination rows
+	@param user_data Parameter of the callback
+	*/
+	CStreamingResizer(CGenericFilter *pFilter, FIBITMAP *info, unsigned dst_width, unsigned dst_height, FI_RowsResizedProc callback, void *user_data);
+
+	/// Returns true if the rows of info can be resized
+	static bool isSupported(FIBITMAP *info);
+
+	/**
+	Filters the next source rows
+	@param bits First row, the top most not pushed yet
+	@param count Number of rows, rows past the source height are ignored
+	@param pitch Distance in bytes between two rows
+	@return Returns the number of destination rows passed to the callback
+	*/
+	unsigned push(const uint8_t *bits, unsigned count, unsigned pitch);
+
+private:
+	/// Converts a source row to floats, filters it horizontally and stores it in the ring
+	void pushRow(const uint8_t *bits);
+
+	/// Filters destination row m_DstRow and passes it to the callback
+	void emitRow();
+
+	FREE_IMAGE_TYPE m_Type;
+	/// Bytes per sample (1, 2 or 4) and samples per pixel (1, 3 or 4)
+	unsigned m_SampleBytes, m_Channels;
+	unsigned m_SrcWidth, m_SrcHeight, m_DstWidth, m_DstHeight;
+	/// Weights of each pass, null when the size does not change
+	std::shared_ptr<const CWeightsTable> m_XWeights, m_YWeights;
+	/// Number of rows of the ring
+	unsigned m_RingRows;
+	/// Floats per ring row
+	size_t m_RowFloats;
+	/// Source row converted to floats
+	std::vector<float> m_Line;
+	/// Ring of horizontally filtered rows, stored twice so that any window is contiguous
+	std::vector<float> m_Ring;
+	/// Destination row, as floats then in the destination type
+	std::vector<float> m_Sums;
+	std::vector<uint8_t> m_Row;
+	/// Number of source rows pushed and of destination rows emitted
+	unsigned m_SrcRow{}, m_DstRow{};
+	FI_RowsResizedProc m_Callback;
+	void *m_UserData;
 };
 
 #endif //   _RESIZE_H_
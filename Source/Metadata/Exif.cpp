@@ -34,6 +34,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "FreeImageTag.h"
+#include "FreeImage/Trace.h"
 
 // ==========================================================
 // Exif JPEG routines
@@ -513,6 +514,37 @@ processExifTag(FIBITMAP *dib, FITAG *tag, char *pval, FIBOOL msb_order, TagLib::
 
 }
 
+/**
+Returns TRUE if a parse restricted to only_model stores the tags of a directory of model md_model.
+The 0th IFD is always stored : maker notes are decoded according to its Make and Model tags.
+*/
+static inline FIBOOL
+exif_stores_model(TagLib::MDMODEL md_model, FREE_IMAGE_MDMODEL only_model) {
+	if (only_model == FIMD_NODATA) {
+		return TRUE;
+	}
+	const FREE_IMAGE_MDMODEL model = TagLib::instance().getFreeImageModel(md_model);
+	return ((model == only_model) || (model == FIMD_EXIF_MAIN)) ? TRUE : FALSE;
+}
+
+static FIBOOL jpeg_read_exif_thumbnail(FIBITMAP *dib, const uint8_t *tiffp, uint32_t dwOffsetIfd0, uint32_t dwLength, FIBOOL msb_order);
+
+/// Metadata models of an Exif profile
+static const FREE_IMAGE_MDMODEL exif_models[] = { FIMD_EXIF_MAIN, FIMD_EXIF_EXIF, FIMD_EXIF_GPS, FIMD_EXIF_MAKERNOTE, FIMD_EXIF_INTEROP };
+
+/**
+Returns TRUE if the load running on this thread keeps one of the models of an Exif profile (see FreeImage_LoadEx)
+*/
+static FIBOOL
+exif_loads_any_model() {
+	for (FREE_IMAGE_MDMODEL model : exif_models) {
+		if (FreeImage_LoadsMetadataModel(model)) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 /**
 Process Exif directory
 
@@ -523,10 +555,12 @@ Process Exif directory
 @param dwProfileOffset File offset to be used when reading 'offset/value' tags
 @param msb_order Endianness order of the Exif file (TRUE if big-endian, FALSE if little-endian)
 @param starting_md_model Metadata model of the IFD (should be TagLib::EXIF_MAIN for a jpeg)
+@param only_model FIMD_NODATA to store all tags and the thumbnail, otherwise the model whose tags are stored (see exif_stores_model)
 @return Returns TRUE if sucessful, returns FALSE otherwise
 */
 static FIBOOL 
-jpeg_read_exif_dir(FIBITMAP *dib, const uint8_t *tiffp, uint32_t dwOffsetIfd0, uint32_t dwLength, uint32_t dwProfileOffset, FIBOOL msb_order, TagLib::MDMODEL starting_md_model) {
+jpeg_read_exif_dir(FIBITMAP *dib, const uint8_t *tiffp, uint32_t dwOffsetIfd0, uint32_t dwLength, uint32_t dwProfileOffset, FIBOOL msb_order, TagLib::MDMODEL starting_md_model, FREE_IMAGE_MDMODEL only_model = FIMD_NODATA) {
+	TraceScope trace(TraceCategory::eMetadata, "Exif");
 	uint16_t de, nde;
 
 	std::stack<uint16_t>			destack;	// directory entries stack
@@ -582,19 +616,27 @@ jpeg_read_exif_dir(FIBITMAP *dib, const uint8_t *tiffp, uint32_t dwOffsetIfd0, u
 			continue;
 		}
 
+		const FIBOOL stores_model = exif_stores_model(md_model, only_model);
+
 		for (; de < nde; de++) {
 			char *pde{};	// pointer to the directory entry
 			char *pval{};	// pointer to the tag value
-			
-			// create a tag
-			FITAG *tag = FreeImage_CreateTag();
-			if (!tag) return FALSE;
 
 			// point to the directory entry
 			pde = (char*) DIR_ENTRY_ADDR(ifdp, de);
 
 			// get the tag ID
 			uint16_t tag_id = ReadUint16(msb_order, pde);
+
+			// skip the tags of other models, but follow the IFD offsets
+			if (!stores_model && (tag_id != TAG_EXIF_OFFSET) && (tag_id != TAG_GPS_OFFSET) && (tag_id != TAG_INTEROP_OFFSET) && (tag_id != TAG_MAKER_NOTE)) {
+				continue;
+			}
+			
+			// create a tag
+			FITAG *tag = FreeImage_CreateTag();
+			if (!tag) return FALSE;
+
 			FreeImage_SetTagID(tag, tag_id);
 
 			// get the tag type
@@ -664,6 +706,11 @@ jpeg_read_exif_dir(FIBITMAP *dib, const uint8_t *tiffp, uint32_t dwOffsetIfd0, u
 				
 				// get offset and metadata model
 				if (FreeImage_GetTagID(tag) == TAG_MAKER_NOTE) {
+					if (!FreeImage_LoadsMetadataModel(FIMD_EXIF_MAKERNOTE)) {
+						// maker notes aren't kept by this load, don't decode them
+						FreeImage_DeleteTag(tag);
+						continue;
+					}
 					processMakerNote(dib, pval, msb_order, &sub_offset, &next_mdmodel);
 					next_ifd = (uint8_t*)pval + sub_offset;
 				} else {
@@ -693,7 +740,7 @@ jpeg_read_exif_dir(FIBITMAP *dib, const uint8_t *tiffp, uint32_t dwOffsetIfd0, u
 					
 					break; // break out of the for loop
 				}
-				else {
+				else if (stores_model) {
 					// unsupported camera model, canon maker tag or something unknown
 					// process as a standard tag
 					processExifTag(dib, tag, pval, msb_order, md_model);
@@ -713,6 +760,27 @@ jpeg_read_exif_dir(FIBITMAP *dib, const uint8_t *tiffp, uint32_t dwOffsetIfd0, u
 
     } while (!destack.empty()); 
 
+	if (only_model != FIMD_NODATA) {
+		return TRUE;
+	}
+
+	return jpeg_read_exif_thumbnail(dib, tiffp, dwOffsetIfd0, dwLength, msb_order);
+}
+
+/**
+Load the thumbnail of the 1st IFD of an Exif profile
+
+@param dib Input FIBITMAP
+@param tiffp Pointer to the TIFF header
+@param dwOffsetIfd0 Offset to the 0th IFD (first IFD)
+@param dwLength Length of the Exif file
+@param msb_order Endianness order of the Exif file (TRUE if big-endian, FALSE if little-endian)
+@return Returns TRUE if sucessful or if there is no thumbnail, returns FALSE otherwise
+*/
+static FIBOOL 
+jpeg_read_exif_thumbnail(FIBITMAP *dib, const uint8_t *tiffp, uint32_t dwOffsetIfd0, uint32_t dwLength, FIBOOL msb_order) {
+	const uint8_t *ifd0th = tiffp + (size_t)dwOffsetIfd0;
+
 	//
 	// --- handle thumbnail data ---
 	//
@@ -810,6 +878,23 @@ jpeg_read_exif_dir(FIBITMAP *dib, const uint8_t *tiffp, uint32_t dwOffsetIfd0, u
 
 // --------------------------------------------------------------------------
 
+/**
+Parse the tags of one metadata model out of an Exif profile attached with FreeImage_DeferMetadata
+@param dib Bitmap receiving the tags
+@param model Exif metadata model to parse
+@param profile Exif profile, starting with the TIFF header
+@param length Exif profile length
+@return Returns TRUE if successful, FALSE otherwise
+*/
+static FIBOOL
+jpeg_parse_exif_model(FIBITMAP *dib, FREE_IMAGE_MDMODEL model, const uint8_t *profile, unsigned length) {
+	// the TIFF header was checked by jpeg_read_exif_profile
+	const FIBOOL bBigEndian = (profile[0] == 0x4D) ? TRUE : FALSE;
+	const uint32_t dwFirstOffset = ReadUint32(bBigEndian, profile + 4);
+
+	return jpeg_read_exif_dir(dib, profile, dwFirstOffset, length, 0, bBigEndian, TagLib::EXIF_MAIN, model);
+}
+
 /**
 Read and decode JPEG_APP1 marker (Exif profile)
 @param dib Input FIBITMAP
@@ -828,6 +913,10 @@ jpeg_read_exif_profile(FIBITMAP *dib, const uint8_t *data, unsigned length, bool
 	uint32_t dwProfileLength = (uint32_t)length;
 	uint8_t *pbProfile = (uint8_t*)data;
 
+	if (!exif_loads_any_model()) {
+		return FALSE;
+	}
+
 	// verify the identifying string
 	const bool found_signature = (memcmp(exif_signature, pbProfile, sizeof(exif_signature)) == 0);
 	if (optional_signature || found_signature) {
@@ -876,6 +965,19 @@ jpeg_read_exif_profile(FIBITMAP *dib, const uint8_t *data, unsigned length, bool
 		}
 		*/
 
+		// parse the tags of each Exif model kept by the load on first access, only load the thumbnail now
+		FREE_IMAGE_MDMODEL models[sizeof(exif_models) / sizeof(exif_models[0])];
+		unsigned count = 0;
+		for (FREE_IMAGE_MDMODEL model : exif_models) {
+			if (FreeImage_LoadsMetadataModel(model)) {
+				models[count++] = model;
+			}
+		}
+		if (FreeImage_DeferMetadata(dib, models, count, pbProfile, dwProfileLength, jpeg_parse_exif_model)) {
+			// the thumbnail is described by the 1st IFD, next to the Exif-TIFF tags
+			return FreeImage_LoadsMetadataModel(FIMD_EXIF_MAIN) ? jpeg_read_exif_thumbnail(dib, pbProfile, dwFirstOffset, dwProfileLength, bBigEndian) : TRUE;
+		}
+
 		// process Exif directories, starting with Exif-TIFF IFD
 		return jpeg_read_exif_dir(dib, pbProfile, dwFirstOffset, dwProfileLength, 0, bBigEndian, TagLib::EXIF_MAIN);
 	}
@@ -883,6 +985,57 @@ jpeg_read_exif_profile(FIBITMAP *dib, const uint8_t *data, unsigned length, bool
 	return FALSE;
 }
 
+/**
+Get the Orientation tag of the 0th IFD of an Exif profile, without creating any tag.
+Used to probe images (see FreeImage_GetImageInfo), the profile may be truncated after the 0th IFD.
+@param data Pointer to the Exif profile (starting with "Exif\0\0" or with the TIFF header when optional_signature is true)
+@param length Exif profile size, in bytes
+@return Returns the orientation (1 to 8), returns 0 if it isn't found
+*/
+unsigned
+exif_read_orientation(const uint8_t *data, unsigned length, bool optional_signature) {
+	const uint8_t exif_signature[6] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
+	const uint8_t lsb_first[4] = { 0x49, 0x49, 0x2A, 0x00 };
+	const uint8_t msb_first[4] = { 0x4D, 0x4D, 0x00, 0x2A };
+
+	if ((length >= sizeof(exif_signature)) && (memcmp(exif_signature, data, sizeof(exif_signature)) == 0)) {
+		data += sizeof(exif_signature);
+		length -= sizeof(exif_signature);
+	} else if (!optional_signature) {
+		return 0;
+	}
+	if (length < 8) {
+		return 0;
+	}
+
+	FIBOOL bBigEndian = TRUE;
+	if (memcmp(data, lsb_first, sizeof(lsb_first)) == 0) {
+		bBigEndian = FALSE;
+	} else if (memcmp(data, msb_first, sizeof(msb_first)) != 0) {
+		return 0;
+	}
+
+	// scan the entries of the 0th IFD (12 bytes each)
+	const uint32_t ifd = ReadUint32(bBigEndian, data + 4);
+	if ((ifd > length) || (length - ifd < 2)) {
+		return 0;
+	}
+	const unsigned count = ReadUint16(bBigEndian, data + ifd);
+	for (unsigned i = 0; i < count; i++) {
+		const uint32_t entry = ifd + 2 + 12 * i;
+		if ((entry > length) || (length - entry < 12)) {
+			break;
+		}
+		if (ReadUint16(bBigEndian, data + entry) == TAG_ORIENTATION) {
+			// SHORT value, stored in the first 2 bytes of the value field
+			const unsigned orientation = ReadUint16(bBigEndian, data + entry + 8);
+			return ((orientation >= 1) && (orientation <= 8)) ? orientation : 0;
+		}
+	}
+
+	return 0;
+}
+
 // ==========================================================
 // Exif JPEG helper routines
 // ==========================================================
@@ -899,6 +1052,10 @@ jpeg_read_exif_profile_raw(FIBITMAP *dib, const uint8_t *profile, unsigned lengt
     // marker identifying string for Exif = "Exif\0\0"
     uint8_t exif_signature[6] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
 
+	if (!FreeImage_LoadsMetadataModel(FIMD_EXIF_RAW)) {
+		return FALSE;
+	}
+
 	// verify the identifying string
 	if (!optional_signature && (memcmp(exif_signature, profile, sizeof(exif_signature)) != 0)) {
 		// not an Exif profile
@@ -940,6 +1097,10 @@ Read and decode JPEG-XR Exif IFD
 */
 FIBOOL  
 jpegxr_read_exif_profile(FIBITMAP *dib, const uint8_t *profile, unsigned length, unsigned file_offset) {
+	if (!FreeImage_LoadsMetadataModel(FIMD_EXIF_EXIF)) {
+		return FALSE;
+	}
+
 	// assume Little Endian order
 	FIBOOL bBigEndian = FALSE;
 	
@@ -957,6 +1118,10 @@ Read and decode JPEG-XR Exif-GPS IFD
 */
 FIBOOL  
 jpegxr_read_exif_gps_profile(FIBITMAP *dib, const uint8_t *profile, unsigned length, unsigned file_offset) {
+	if (!FreeImage_LoadsMetadataModel(FIMD_EXIF_GPS)) {
+		return FALSE;
+	}
+
 	// assume Little Endian order
 	FIBOOL bBigEndian = FALSE;
 	
@@ -968,6 +1133,40 @@ jpegxr_read_exif_gps_profile(FIBITMAP *dib, const uint8_t *profile, unsigned len
 // Exif common helper routines
 // ==========================================================
 
+/**
+Convert the Exif orientation of a dib into FIO_xxx flags
+@param dib Input dib
+@return Returns the orientation displaying the dib upright
+@see FreeImage_CreateView
+*/
+unsigned DLL_CALLCONV
+FreeImage_GetExifOrientation(FIBITMAP *dib) {
+	FITAG *tag{};
+	if (FreeImage_GetMetadataCount(FIMD_EXIF_MAIN, dib) && FreeImage_GetMetadata(FIMD_EXIF_MAIN, dib, "Orientation", &tag)) {
+		if (tag && (FreeImage_GetTagID(tag) == TAG_ORIENTATION)) {
+			switch (*((uint16_t *)FreeImage_GetTagValue(tag))) {
+				case 2:		// "top, right side" => flip left-right
+					return FIO_FLIP_HORIZONTAL;
+				case 3:		// "bottom, right side" => -180
+					return FIO_FLIP_HORIZONTAL | FIO_FLIP_VERTICAL;
+				case 4:		// "bottom, left side" => flip up-down
+					return FIO_FLIP_VERTICAL;
+				case 5:		// "left side, top" => transpose
+					return FIO_TRANSPOSE;
+				case 6:		// "right side, top" => -90
+					return FIO_TRANSPOSE | FIO_FLIP_HORIZONTAL;
+				case 7:		// "right side, bottom" => transverse
+					return FIO_TRANSPOSE | FIO_FLIP_HORIZONTAL | FIO_FLIP_VERTICAL;
+				case 8:		// "left side, bottom" => +90
+					return FIO_TRANSPOSE | FIO_FLIP_VERTICAL;
+				default:
+					break;
+			}
+		}
+	}
+	return FIO_NORMAL;
+}
+
 /**
 Rotate a dib according to Exif info
 @param dib Input / Output dib to rotate
@@ -1282,6 +1481,10 @@ psd_read_exif_profile(FIBITMAP *dib, const uint8_t *data, unsigned length) {
 	uint32_t dwProfileLength = (uint32_t)length;
 	auto *pbProfile = (const uint8_t*)data;
 
+	if (!exif_loads_any_model()) {
+		return FALSE;
+	}
+
 	// This is an Exif profile
 	// should contain a TIFF header with up to 2 IFDs (IFD stands for 'Image File Directory')
 	// 0th IFD : the image attributes, 1st IFD : may be used for thumbnail
@@ -1329,7 +1532,7 @@ psd_read_exif_profile_raw(FIBITMAP *dib, const uint8_t *profile, unsigned length
 	// used by JPEG not PSD
     uint8_t exif_signature[6] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
 
-	if (!profile || length == 0) {
+	if (!profile || length == 0 || !FreeImage_LoadsMetadataModel(FIMD_EXIF_RAW)) {
 		return FALSE;
 	}
 
@@ -38,9 +38,34 @@ FI_STRUCT (FITAGHEADER) {
 	uint16_t type;			// tag data type (see FREE_IMAGE_MDTYPE)
 	uint32_t count;		// number of components (in 'tag data types' units)
 	uint32_t length;		// value length in bytes
+	uint32_t packed;	// members stored in the block of a packed tag (see FreeImage_PackTag)
 	void *value;		// tag value
 };
 
+/// flags of FITAGHEADER::packed
+enum {
+	PACKED_BLOCK		= 1,	// the FITAG and its header belong to a caller provided block
+	PACKED_KEY			= 2,	// key stored in the block
+	PACKED_DESCRIPTION	= 4,	// description stored in the block
+	PACKED_VALUE		= 8		// value stored in the block
+};
+
+/// rounds a size of a packed tag block up to 8 bytes, the alignment of values
+static inline size_t 
+PackedAlign(size_t size) {
+	return (size + 7) & ~(size_t)7;
+}
+
+/// releases a member of a tag, unless it is stored in the block of a packed tag
+template <class T> static inline void
+ReleaseTagMember(FITAGHEADER *tag_header, T *&member, uint32_t packed_flag) {
+	if (!(tag_header->packed & packed_flag)) {
+		free(member);
+	}
+	tag_header->packed &= ~packed_flag;
+	member = nullptr;
+}
+
 // --------------------------------------------------------------------------
 // FITAG creation / destruction
 // --------------------------------------------------------------------------
@@ -64,17 +89,23 @@ FreeImage_CreateTag() {
 void DLL_CALLCONV 
 FreeImage_DeleteTag(FITAG *tag) {
 	if (tag) {	
+		FIBOOL packed = FALSE;
 		if (tag->data) {
 			FITAGHEADER *tag_header = (FITAGHEADER *)tag->data;
+			packed = (tag_header->packed & PACKED_BLOCK) ? TRUE : FALSE;
 			// delete tag members
-			free(tag_header->key); 
-			free(tag_header->description); 
-			free(tag_header->value);
-			// delete the tag
-			free(tag->data);
+			ReleaseTagMember(tag_header, tag_header->key, PACKED_KEY);
+			ReleaseTagMember(tag_header, tag_header->description, PACKED_DESCRIPTION);
+			ReleaseTagMember(tag_header, tag_header->value, PACKED_VALUE);
+			// delete the tag, a packed tag belongs to its block
+			if (!packed) {
+				free(tag->data);
+			}
 		}
 		// and the wrapper
-		free(tag);
+		if (!packed) {
+			free(tag);
+		}
 	}
 }
 
@@ -138,7 +169,7 @@ FreeImage_CloneTag(FITAG *tag) {
 
 	} catch(const char *message) {
 		FreeImage_DeleteTag(clone);
-		FreeImage_OutputMessageProc(FIF_UNKNOWN, message);
+		FreeImage_OutputMessageProcEx(FIF_UNKNOWN, GetThrownMessageCode(message), message);
 		return nullptr;
 	}
 }
@@ -186,7 +217,7 @@ FIBOOL DLL_CALLCONV
 FreeImage_SetTagKey(FITAG *tag, const char *key) {
 	if (tag && key) {
 		FITAGHEADER *tag_header = (FITAGHEADER *)tag->data;
-		if (tag_header->key) free(tag_header->key);
+		ReleaseTagMember(tag_header, tag_header->key, PACKED_KEY);
 		tag_header->key = (char*)malloc(strlen(key) + 1);
 		strcpy(tag_header->key, key);
 		return TRUE;
@@ -198,7 +229,7 @@ FIBOOL DLL_CALLCONV
 FreeImage_SetTagDescription(FITAG *tag, const char *description) {
 	if (tag && description) {
 		FITAGHEADER *tag_header = (FITAGHEADER *)tag->data;
-		if (tag_header->description) free(tag_header->description);
+		ReleaseTagMember(tag_header, tag_header->description, PACKED_DESCRIPTION);
 		tag_header->description = (char*)malloc(strlen(description) + 1);
 		strcpy(tag_header->description, description);
 		return TRUE;
@@ -256,9 +287,7 @@ FreeImage_SetTagValue(FITAG *tag, const void *value) {
 			return FALSE;
 		}
 
-		if (tag_header->value) {
-			free(tag_header->value);
-		}
+		ReleaseTagMember(tag_header, tag_header->value, PACKED_VALUE);
 
 		switch (tag_header->type) {
 			case FIDT_ASCII:
@@ -350,3 +379,97 @@ FreeImage_GetTagMemorySize(FITAG *tag) {
 	}
 	return size;
 }
+
+size_t 
+FreeImage_GetPackedTagSize(FITAG *tag) {
+	auto *tag_header = (const FITAGHEADER *)tag->data;
+	size_t size = PackedAlign(sizeof(FITAG)) + PackedAlign(sizeof(FITAGHEADER));
+	if (tag_header->value) {
+		// ASCII values get a terminating '\0', as in FreeImage_SetTagValue
+		size += PackedAlign((size_t)tag_header->length + ((tag_header->type == FIDT_ASCII) ? 1 : 0));
+	}
+	if (tag_header->key) {
+		size += strlen(tag_header->key) + 1;
+	}
+	if (tag_header->description) {
+		size += strlen(tag_header->description) + 1;
+	}
+	return PackedAlign(size);
+}
+
+FITAG* 
+FreeImage_PackTag(FITAG *tag, void *block) {
+	auto *src_tag = (const FITAGHEADER *)tag->data;
+	auto *p = static_cast<uint8_t*>(block);
+
+	auto *packed = (FITAG *)p;
+	p += PackedAlign(sizeof(FITAG));
+	auto *dst_tag = (FITAGHEADER *)p;
+	p += PackedAlign(sizeof(FITAGHEADER));
+	packed->data = dst_tag;
+
+	*dst_tag = *src_tag;
+	dst_tag->packed = PACKED_BLOCK;
+
+	// the value first, it keeps the alignment of the block
+	if (src_tag->value) {
+		memcpy(p, src_tag->value, src_tag->length);
+		if (src_tag->type == FIDT_ASCII) {
+			p[src_tag->length] = 0;
+		}
+		dst_tag->value = p;
+		dst_tag->packed |= PACKED_VALUE;
+		p += PackedAlign((size_t)src_tag->length + ((src_tag->type == FIDT_ASCII) ? 1 : 0));
+	}
+	if (src_tag->key) {
+		const size_t length = strlen(src_tag->key) + 1;
+		memcpy(p, src_tag->key, length);
+		dst_tag->key = (char *)p;
+		dst_tag->packed |= PACKED_KEY;
+		p += length;
+	}
+	if (src_tag->description) {
+		const size_t length = strlen(src_tag->description) + 1;
+		memcpy(p, src_tag->description, length);
+		dst_tag->description = (char *)p;
+		dst_tag->packed |= PACKED_DESCRIPTION;
+	}
+
+	return packed;
+}
+
+// --------------------------------------------------------------------------
+
+FIBOOL 
+FreeImage_SetMetadataEx(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, uint16_t id, FREE_IMAGE_MDTYPE type, uint32_t count, uint32_t length, const void *value)
+{
+	bool bSuccess{};
+	if (std::unique_ptr<FITAG, decltype(&FreeImage_DeleteTag)> tag(FreeImage_CreateTag(), &FreeImage_DeleteTag); tag) {
+		bSuccess = FreeImage_SetTagKey(tag.get(), key);
+		bSuccess = bSuccess && FreeImage_SetTagID(tag.get(), id);
+		bSuccess = bSuccess && FreeImage_SetTagType(tag.get(), type);
+		bSuccess = bSuccess && FreeImage_SetTagCount(tag.get(), count);
+		bSuccess = bSuccess && FreeImage_SetTagLength(tag.get(), length);
+		bSuccess = bSuccess && FreeImage_SetTagValue(tag.get(), value);
+		if (model == FIMD_ANIMATION) {
+			const TagLib& s = TagLib::instance();
+			// get the tag description
+			const char *description = s.getTagDescription(TagLib::ANIMATION, id);
+			bSuccess = bSuccess && FreeImage_SetTagDescription(tag.get(), description);
+		}
+		// store the tag
+		bSuccess = bSuccess && FreeImage_SetMetadata(model, dib, key, tag.get());
+	}
+	return bSuccess ? TRUE : FALSE;
+}
+
+FIBOOL 
+FreeImage_GetMetadataEx(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, FREE_IMAGE_MDTYPE type, FITAG **tag)
+{
+	if (FreeImage_GetMetadata(model, dib, key, tag)) {
+		if (FreeImage_GetTagType(*tag) == type) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
@@ -307,6 +307,36 @@ Calculate the memory size required by a tag, including the size of the structure
 */
 size_t FreeImage_GetTagMemorySize(FITAG *tag);
 
+/**
+Calculate the size of the block holding a packed copy of a tag (see FreeImage_PackTag)
+@param tag The tag to examine
+@return Returns the block size in bytes, a multiple of 8
+*/
+size_t FreeImage_GetPackedTagSize(FITAG *tag);
+
+/**
+Copy a tag into a single block : the FITAG, its header, value, key and description.
+The block belongs to the caller (e.g. an arena) and must outlive the packed tag. 
+Members later modified with FreeImage_SetTagXXX are reallocated on the heap, 
+FreeImage_DeleteTag only releases these members.
+@param tag The tag to copy
+@param block Memory of FreeImage_GetPackedTagSize(tag) bytes, aligned on 8 bytes
+@return Returns the packed tag, located at the start of the block
+*/
+FITAG* FreeImage_PackTag(FITAG *tag, void *block);
+
+/**
+Create a tag and store it in the metadata model of a dib (animation tags get their description)
+@return Returns TRUE if successful
+*/
+FIBOOL FreeImage_SetMetadataEx(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, uint16_t id, FREE_IMAGE_MDTYPE type, uint32_t count, uint32_t length, const void *value);
+
+/**
+Get a tag of the metadata model of a dib, checking its data type
+@return Returns TRUE if the tag exists with this type
+*/
+FIBOOL FreeImage_GetMetadataEx(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, FREE_IMAGE_MDTYPE type, FITAG **tag);
+
 // --------------------------------------------------------------------------
 
 /**
@@ -375,11 +405,20 @@ public:
 
 private:
 
-	typedef std::map<uint16_t, TagInfo*> TAGINFO;
-	typedef std::map<int, TAGINFO>  TABLEMAP;
+	/**
+	Lookup tables of a metadata model : the tag descriptors sorted by tag ID 
+	and the same descriptors sorted by field name, both searched by bisection
+	*/
+	typedef struct tagTagTable {
+		std::vector<const TagInfo*> by_tag;
+		std::vector<const TagInfo*> by_name;
+	} TAGTABLE;
+
+	/// store lookup tables for all known tag info tables, indexed by metadata model
+	TAGTABLE _tables[ANIMATION + 1];
 
-	/// store hash tables for all known tag info tables
-	TABLEMAP _table_map;
+	/// returns the lookup tables of a metadata model, or NULL for an unknown model
+	const TAGTABLE* getTable(MDMODEL md_model) const;
 
 private:
 	/**
@@ -479,12 +518,62 @@ extern "C" {
 // --------------------------------------------------------------------------
 FIBOOL jpeg_read_exif_profile(FIBITMAP *dib, const uint8_t *dataptr, unsigned datalen, bool optional_signature = false);
 FIBOOL jpeg_read_exif_profile_raw(FIBITMAP *dib, const uint8_t *profile, unsigned length, bool optional_signature = false);
+unsigned exif_read_orientation(const uint8_t *profile, unsigned length, bool optional_signature = false);
 FIBOOL jpegxr_read_exif_profile(FIBITMAP *dib, const uint8_t *profile, unsigned length, unsigned file_offset);
 FIBOOL jpegxr_read_exif_gps_profile(FIBITMAP *dib, const uint8_t *profile, unsigned length, unsigned file_offset);
 
 FIBOOL tiff_get_ifd_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, uint8_t **ppbProfile, unsigned *uProfileLength);
 
 
+// Deferred metadata profiles (see BitmapAccess.cpp)
+// --------------------------------------------------------------------------
+
+/**
+Parses the tags of a metadata model out of a profile and stores them in dib with FreeImage_SetMetadata
+*/
+typedef FIBOOL (*FI_ParseMetadataProc)(FIBITMAP *dib, FREE_IMAGE_MDMODEL model, const uint8_t *profile, unsigned length);
+
+/**
+Attaches a copy of a profile to a bitmap, the tags of each model are parsed with the parse callback the first time the model is accessed.
+Models sharing the profile and the tags parsed so far are shared by clones and by FreeImage_CloneMetadata.
+@param dib Bitmap the models are attached to
+@param models Metadata models found in the profile
+@param count Number of models
+@param profile Profile data, copied
+@param length Profile length, in bytes
+@param parse Callback parsing the tags of one model
+@return Returns FALSE when one of the models already exists or on allocation failure, the caller should then parse the profile at once
+*/
+FIBOOL FreeImage_DeferMetadata(FIBITMAP *dib, const FREE_IMAGE_MDMODEL *models, unsigned count, const uint8_t *profile, unsigned length, FI_ParseMetadataProc parse);
+
+
+// Source profiles of metadata models (see BitmapAccess.cpp)
+// --------------------------------------------------------------------------
+
+/**
+Attaches a copy of the profile the tags of a model were read from, so that savers can write it back verbatim.
+The profile follows the model in clones and is dropped as soon as a tag of the model is set or removed.
+Its format is defined by the model : the IPTC source is the payload of a JPEG APP13 marker (Photoshop image resources).
+@return Returns FALSE if the model has no tags, is already shared or on allocation failure
+*/
+FIBOOL FreeImage_SetMetadataSource(FIBITMAP *dib, FREE_IMAGE_MDMODEL model, const uint8_t *profile, unsigned length);
+
+/**
+Gets the profile attached by FreeImage_SetMetadataSource, if the tags of the model weren't modified since.
+The profile is owned by the model.
+*/
+FIBOOL FreeImage_GetMetadataSource(FIBITMAP *dib, FREE_IMAGE_MDMODEL model, const uint8_t **profile, unsigned *length);
+
+
+// Selective metadata loading (see Plugin.cpp)
+// --------------------------------------------------------------------------
+
+/**
+Returns FALSE when the FreeImage_LoadEx running on this thread doesn't keep a metadata model, its parsers should skip it
+*/
+FIBOOL FreeImage_LoadsMetadataModel(FREE_IMAGE_MDMODEL model);
+
+
 // PSD Exif profile (see Exif.cpp)
 // --------------------------------------------------------------------------
 FIBOOL psd_read_exif_profile(FIBITMAP *dib, const uint8_t *dataptr, unsigned datalen);
@@ -26,6 +26,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "FreeImageTag.h"
+#include "FreeImage/Trace.h"
 
 // ----------------------------------------------------------
 //   IPTC JPEG / TIFF markers routines
@@ -37,6 +38,7 @@ static const char* IPTC_DELIMITER = ";";	// keywords/supplemental category delim
 */
 FIBOOL 
 read_iptc_profile(FIBITMAP *dib, const uint8_t *dataptr, unsigned int datalen) {
+	TraceScope trace(TraceCategory::eMetadata, "IPTC");
 	char defaultKey[16];
 	size_t length = datalen;
 	auto *profile = (const uint8_t*)dataptr;
@@ -48,7 +50,7 @@ read_iptc_profile(FIBITMAP *dib, const uint8_t *dataptr, unsigned int datalen) {
 
 	uint16_t tag_id;
 
-	if (!dataptr || (datalen == 0)) {
+	if (!dataptr || (datalen == 0) || !FreeImage_LoadsMetadataModel(FIMD_IPTC)) {
 		return FALSE;
 	}
 
@@ -28,169 +28,198 @@
 #include "FreeImageTag.h"
 #include "FIRational.h"
 
+#include <charconv>
+#include <string>
+
 #define MAX_TEXT_EXTENT	512
 
+namespace {
+
+/**
+Writes a tag string into a caller buffer, truncated to its size, and counts the length of the whole string
+*/
+class TagStringWriter
+{
+public:
+	TagStringWriter(char *buffer, size_t size) : mBuffer(buffer), mSize(size) {
+	}
+
+	bool put(const char *text, size_t length) {
+		if (mLength + 1 < mSize) {
+			memcpy(mBuffer + mLength, text, MIN(length, mSize - 1 - mLength));
+		}
+		mLength += length;
+		return true;
+	}
+
+	bool put(const char *text) {
+		return put(text, strlen(text));
+	}
+
+	/// integer in base 10, or 16 with upper case digits
+	template <class T>
+	bool putInt(T value, int base = 10) {
+		char digits[24];
+		char *last = std::to_chars(digits, digits + sizeof(digits), value, base).ptr;
+		if (base == 16) {
+			for (char *c = digits; c < last; c++) {
+				*c = (char)toupper(*c);
+			}
+		}
+		return put(digits, (size_t)(last - digits));
+	}
+
+	/// fraction as numerator/denominator
+	template <class T>
+	bool putFraction(T numerator, T denominator) {
+		putInt(numerator);
+		put("/", 1);
+		return putInt(denominator);
+	}
+
+	/**
+	Terminates the string and returns its length, the buffer holds its first size - 1 characters
+	*/
+	size_t finish() {
+		if (mSize) {
+			mBuffer[MIN(mLength, mSize - 1)] = '\0';
+		}
+		return mLength;
+	}
+
+private:
+	char *mBuffer;
+	size_t mSize;
+	size_t mLength{};
+};
+
+} // namespace
+
 /**
 Convert a tag to a C string
 */
-static const char* 
-ConvertAnyTag(FITAG *tag) {
+static void
+ConvertAnyTag(TagStringWriter &out, FITAG *tag) {
 	char format[MAX_TEXT_EXTENT];
-	static std::string buffer;
-	uint32_t i;
 
-	if (!tag)
-		return nullptr;
-
-	buffer.erase();
-	
 	// convert the tag value to a string buffer
 
 	const FREE_IMAGE_MDTYPE tag_type = FreeImage_GetTagType(tag);
-	uint32_t tag_count = FreeImage_GetTagCount(tag);
+	const uint32_t tag_count = FreeImage_GetTagValue(tag) ? FreeImage_GetTagCount(tag) : 0;
 
 	switch (tag_type) {
 		case FIDT_BYTE:		// N x 8-bit unsigned integer 
 		{
 			auto *pvalue = (const uint8_t*)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%d",	(int32_t) pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), " %d",	(int32_t) pvalue[i]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				if (i) out.put(" ", 1);
+				out.putInt((int32_t)pvalue[i]);
 			}
 			break;
 		}
 		case FIDT_SHORT:	// N x 16-bit unsigned integer 
 		{
 			auto *pvalue = (const unsigned short *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%hu", pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), " %hu",	pvalue[i]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				if (i) out.put(" ", 1);
+				out.putInt(pvalue[i]);
 			}
 			break;
 		}
 		case FIDT_LONG:		// N x 32-bit unsigned integer 
 		{
 			auto *pvalue = (const uint32_t *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%u", pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), " %u",	pvalue[i]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				if (i) out.put(" ", 1);
+				out.putInt(pvalue[i]);
 			}
 			break;
 		}
 		case FIDT_RATIONAL: // N x 64-bit unsigned fraction 
 		{
 			auto *pvalue = (const uint32_t*)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%u/%u", pvalue[0], pvalue[1]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), " %u/%u", pvalue[2*i], pvalue[2*i+1]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				if (i) out.put(" ", 1);
+				out.putFraction(pvalue[2*i], pvalue[2*i+1]);
 			}
 			break;
 		}
 		case FIDT_SBYTE:	// N x 8-bit signed integer 
 		{
 			auto *pvalue = (const char*)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%d",	(int32_t) pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), " %d",	(int32_t) pvalue[i]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				if (i) out.put(" ", 1);
+				out.putInt((int32_t)pvalue[i]);
 			}
 			break;
 		}
 		case FIDT_SSHORT:	// N x 16-bit signed integer 
 		{
 			auto *pvalue = (const short *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%hd", pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), " %hd",	pvalue[i]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				if (i) out.put(" ", 1);
+				out.putInt(pvalue[i]);
 			}
 			break;
 		}
 		case FIDT_SLONG:	// N x 32-bit signed integer 
 		{
 			auto *pvalue = (const int32_t *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%d", pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), " %d",	pvalue[i]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				if (i) out.put(" ", 1);
+				out.putInt(pvalue[i]);
 			}
 			break;
 		}
 		case FIDT_SRATIONAL:// N x 64-bit signed fraction 
 		{
 			auto *pvalue = (const int32_t*)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%d/%d", pvalue[0], pvalue[1]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), " %d/%d", pvalue[2*i], pvalue[2*i+1]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				if (i) out.put(" ", 1);
+				out.putFraction(pvalue[2*i], pvalue[2*i+1]);
 			}
 			break;
 		}
 		case FIDT_FLOAT:	// N x 32-bit IEEE floating point 
 		{
 			auto *pvalue = (const float *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%f", (double) pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
+			for (uint32_t i = 0; i < tag_count; i++) {
 				snprintf(format, std::size(format), "%f", (double) pvalue[i]);
-				buffer += format;
+				out.put(format);
 			}
 			break;
 		}
 		case FIDT_DOUBLE:	// N x 64-bit IEEE floating point 
 		{
 			auto *pvalue = (const double *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%lf", pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
+			for (uint32_t i = 0; i < tag_count; i++) {
 				snprintf(format, std::size(format), "%lf", pvalue[i]);
-				buffer += format;
+				out.put(format);
 			}
 			break;
 		}
 		case FIDT_IFD:		// N x 32-bit unsigned integer (offset) 
 		{
 			auto *pvalue = (const uint32_t *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%X", pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), " %X",	pvalue[i]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				if (i) out.put(" ", 1);
+				out.putInt(pvalue[i], 16);
 			}
 			break;
 		}
 		case FIDT_PALETTE:	// N x 32-bit FIRGBA8 
 		{
 			auto *pvalue = (const FIRGBA8 *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "(%d,%d,%d,%d)", pvalue[0].red, pvalue[0].green, pvalue[0].blue, pvalue[0].alpha);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), " (%d,%d,%d,%d)", pvalue[i].red, pvalue[i].green, pvalue[i].blue, pvalue[i].alpha);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				out.put(i ? " (" : "(");
+				out.putInt((int32_t)pvalue[i].red);
+				out.put(",", 1);
+				out.putInt((int32_t)pvalue[i].green);
+				out.put(",", 1);
+				out.putInt((int32_t)pvalue[i].blue);
+				out.put(",", 1);
+				out.putInt((int32_t)pvalue[i].alpha);
+				out.put(")", 1);
 			}
 			break;
 		}
@@ -198,12 +227,8 @@ ConvertAnyTag(FITAG *tag) {
 		case FIDT_LONG8:	// N x 64-bit unsigned integer 
 		{
 			auto *pvalue = (const uint64_t *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%llu", pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), "%llu", pvalue[i]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				out.putInt(pvalue[i]);
 			}
 			break;
 		}
@@ -211,12 +236,8 @@ ConvertAnyTag(FITAG *tag) {
 		case FIDT_IFD8:		// N x 64-bit unsigned integer (offset)
 		{
 			auto *pvalue = (const uint64_t *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%llX", pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), "%llX", pvalue[i]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				out.putInt(pvalue[i], 16);
 			}
 			break;
 		}
@@ -224,12 +245,8 @@ ConvertAnyTag(FITAG *tag) {
 		case FIDT_SLONG8:	// N x 64-bit signed integer
 		{
 			auto *pvalue = (const int64_t *)FreeImage_GetTagValue(tag);
-
-			snprintf(format, std::size(format), "%lld", pvalue[0]);
-			buffer += format;
-			for (i = 1; i < tag_count; i++) {
-				snprintf(format, std::size(format), "%lld", pvalue[i]);
-				buffer += format;
+			for (uint32_t i = 0; i < tag_count; i++) {
+				out.putInt(pvalue[i]);
 			}
 			break;
 		}
@@ -238,31 +255,23 @@ ConvertAnyTag(FITAG *tag) {
 		case FIDT_UNDEFINED:// 8-bit untyped data 
 		default:
 		{
-			int max_size = MIN((int)FreeImage_GetTagLength(tag), (int)MAX_TEXT_EXTENT);
-			if (max_size == MAX_TEXT_EXTENT)
-				max_size--;
-			memcpy(format, (char*)FreeImage_GetTagValue(tag), max_size);
-			format[max_size] = '\0';
-			buffer += format;
+			// up to the first null byte
+			if (auto *pvalue = (const char*)FreeImage_GetTagValue(tag)) {
+				const size_t max_size = MIN((size_t)FreeImage_GetTagLength(tag), (size_t)MAX_TEXT_EXTENT - 1);
+				const auto *end = (const char*)memchr(pvalue, 0, max_size);
+				out.put(pvalue, end ? (size_t)(end - pvalue) : max_size);
+			}
 			break;
 		}
 	}
-
-	return buffer.c_str();
 }
 
 /**
-Convert a Exif tag to a C string
+Convert a Exif tag to a C string, returns false for tags left to ConvertAnyTag
 */
-static const char* 
-ConvertExifTag(FITAG *tag) {
+static bool
+ConvertExifTag(TagStringWriter &out, FITAG *tag) {
 	char format[MAX_TEXT_EXTENT];
-	static std::string buffer;
-
-	if (!tag)
-		return nullptr;
-
-	buffer.erase();
 
 	// convert the tag value to a string buffer
 
@@ -272,21 +281,21 @@ ConvertExifTag(FITAG *tag) {
 			unsigned short orientation = *((unsigned short *)FreeImage_GetTagValue(tag));
 			switch (orientation) {
 				case 1:
-					return "top, left side";
+					return out.put("top, left side");
 				case 2:
-					return "top, right side";
+					return out.put("top, right side");
 				case 3:
-					return "bottom, right side";
+					return out.put("bottom, right side");
 				case 4:
-					return "bottom, left side";
+					return out.put("bottom, left side");
 				case 5:
-					return "left side, top";
+					return out.put("left side, top");
 				case 6:
-					return "right side, top";
+					return out.put("right side, top");
 				case 7:
-					return "right side, bottom";
+					return out.put("right side, bottom");
 				case 8:
-					return "left side, bottom";
+					return out.put("left side, bottom");
 				default:
 					break;
 			}
@@ -313,8 +322,7 @@ ConvertExifTag(FITAG *tag) {
 					whiteB = (int)(pvalue[10] / pvalue[11]);
 
 				snprintf(format, std::size(format), "[%d,%d,%d] [%d,%d,%d]", blackR, blackG, blackB, whiteR, whiteG, whiteB);
-				buffer += format;
-				return buffer.c_str();
+				return out.put(format);
 			}
 
 		}
@@ -324,11 +332,11 @@ ConvertExifTag(FITAG *tag) {
 		{
 			const auto colorSpace = *((unsigned short *)FreeImage_GetTagValue(tag));
 			if (colorSpace == 1) {
-				return "sRGB";
+				return out.put("sRGB");
 			} else if (colorSpace == 65535) {
-				return "Undefined";
+				return out.put("Undefined");
 			} else {
-				return "Unknown";
+				return out.put("Unknown");
 			}
 		}
 		break;
@@ -340,21 +348,18 @@ ConvertExifTag(FITAG *tag) {
 			for (uint32_t i = 0; i < MIN((uint32_t)4, FreeImage_GetTagCount(tag)); i++) {
 				int j = pvalue[i];
 				if (j > 0 && j < 7)
-					buffer += componentStrings[j];
+					out.put(componentStrings[j]);
 			}
-			return buffer.c_str();
+			return true;
 		}
 		break;
 
 		case TAG_COMPRESSED_BITS_PER_PIXEL:
 		{
 			FIRational r(tag);
-			buffer = r.toString();
-			if (buffer == "1")
-				buffer += " bit/pixel";
-			else 
-				buffer += " bits/pixel";
-			return buffer.c_str();
+			const std::string bits = r.toString();
+			out.put(bits.c_str(), bits.size());
+			return out.put((bits == "1") ? " bit/pixel" : " bits/pixel");
 		}
 		break;
 
@@ -366,8 +371,8 @@ ConvertExifTag(FITAG *tag) {
 		case TAG_EXPOSURE_BIAS_VALUE:
 		{
 			FIRational r(tag);
-			buffer = r.toString();
-			return buffer.c_str();
+			const std::string value = r.toString();
+			return out.put(value.c_str(), value.size());
 		}
 		break;
 
@@ -377,11 +382,11 @@ ConvertExifTag(FITAG *tag) {
 			const auto resolutionUnit = *((unsigned short *)FreeImage_GetTagValue(tag));
 			switch (resolutionUnit) {
 				case 1:
-					return "(No unit)";
+					return out.put("(No unit)");
 				case 2:
-					return "inches";
+					return out.put("inches");
 				case 3:
-					return "cm";
+					return out.put("cm");
 				default:
 					break;
 			}
@@ -393,9 +398,9 @@ ConvertExifTag(FITAG *tag) {
 			const auto yCbCrPosition = *((unsigned short *)FreeImage_GetTagValue(tag));
 			switch (yCbCrPosition) {
 				case 1:
-					return "Center of pixel array";
+					return out.put("Center of pixel array");
 				case 2:
-					return "Datum point";
+					return out.put("Datum point");
 				default:
 					break;
 			}
@@ -405,9 +410,9 @@ ConvertExifTag(FITAG *tag) {
 		case TAG_EXPOSURE_TIME:
 		{
 			FIRational r(tag);
-			buffer = r.toString();
-			buffer += " sec";
-			return buffer.c_str();
+			const std::string time = r.toString();
+			out.put(time.c_str(), time.size());
+			return out.put(" sec");
 		}
 		break;
 
@@ -417,8 +422,7 @@ ConvertExifTag(FITAG *tag) {
 			int32_t apexValue = r.longValue();
 			int32_t apexPower = 1 << apexValue;
 			snprintf(format, std::size(format), "1/%d sec", (int)apexPower);
-			buffer += format;
-			return buffer.c_str();
+			return out.put(format);
 		}
 		break;
 
@@ -430,8 +434,7 @@ ConvertExifTag(FITAG *tag) {
 	        double rootTwo = sqrt((double)2);
 			double fStop = pow(rootTwo, apertureApex);
 			snprintf(format, std::size(format), "F%.1f", fStop);
-			buffer += format;
-			return buffer.c_str();
+			return out.put(format);
 		}
 		break;
 
@@ -440,8 +443,7 @@ ConvertExifTag(FITAG *tag) {
 			FIRational r(tag);
 			double fnumber = r.doubleValue();
 			snprintf(format, std::size(format), "F%.1f", fnumber);
-			buffer += format;
-			return buffer.c_str();
+			return out.put(format);
 		}
 		break;
 
@@ -450,8 +452,7 @@ ConvertExifTag(FITAG *tag) {
 			FIRational r(tag);
 			double focalLength = r.doubleValue();
 			snprintf(format, std::size(format), "%.1f mm", focalLength);
-			buffer += format;
-			return buffer.c_str();
+			return out.put(format);
 		}
 		break;
 
@@ -459,8 +460,7 @@ ConvertExifTag(FITAG *tag) {
 		{
 			const auto focalLength = *((unsigned short *)FreeImage_GetTagValue(tag));
 			snprintf(format, std::size(format), "%hu mm", focalLength);
-			buffer += format;
-			return buffer.c_str();
+			return out.put(format);
 		}
 		break;
 
@@ -469,53 +469,52 @@ ConvertExifTag(FITAG *tag) {
 			const auto flash = *((unsigned short *)FreeImage_GetTagValue(tag));
 			switch (flash) {
 				case 0x0000:
-					return "Flash did not fire";
+					return out.put("Flash did not fire");
 				case 0x0001:
-					return "Flash fired";
+					return out.put("Flash fired");
 				case 0x0005:
-					return "Strobe return light not detected";
+					return out.put("Strobe return light not detected");
 				case 0x0007:
-					return "Strobe return light detected";
+					return out.put("Strobe return light detected");
 				case 0x0009:
-					return "Flash fired, compulsory flash mode";
+					return out.put("Flash fired, compulsory flash mode");
 				case 0x000D:
-					return "Flash fired, compulsory flash mode, return light not detected";
+					return out.put("Flash fired, compulsory flash mode, return light not detected");
 				case 0x000F:
-					return "Flash fired, compulsory flash mode, return light detected";
+					return out.put("Flash fired, compulsory flash mode, return light detected");
 				case 0x0010:
-					return "Flash did not fire, compulsory flash mode";
+					return out.put("Flash did not fire, compulsory flash mode");
 				case 0x0018:
-					return "Flash did not fire, auto mode";
+					return out.put("Flash did not fire, auto mode");
 				case 0x0019:
-					return "Flash fired, auto mode";
+					return out.put("Flash fired, auto mode");
 				case 0x001D:
-					return "Flash fired, auto mode, return light not detected";
+					return out.put("Flash fired, auto mode, return light not detected");
 				case 0x001F:
-					return "Flash fired, auto mode, return light detected";
+					return out.put("Flash fired, auto mode, return light detected");
 				case 0x0020:
-					return "No flash function";
+					return out.put("No flash function");
 				case 0x0041:
-					return "Flash fired, red-eye reduction mode";
+					return out.put("Flash fired, red-eye reduction mode");
 				case 0x0045:
-					return "Flash fired, red-eye reduction mode, return light not detected";
+					return out.put("Flash fired, red-eye reduction mode, return light not detected");
 				case 0x0047:
-					return "Flash fired, red-eye reduction mode, return light detected";
+					return out.put("Flash fired, red-eye reduction mode, return light detected");
 				case 0x0049:
-					return "Flash fired, compulsory flash mode, red-eye reduction mode";
+					return out.put("Flash fired, compulsory flash mode, red-eye reduction mode");
 				case 0x004D:
-					return "Flash fired, compulsory flash mode, red-eye reduction mode, return light not detected";
+					return out.put("Flash fired, compulsory flash mode, red-eye reduction mode, return light not detected");
 				case 0x004F:
-					return "Flash fired, compulsory flash mode, red-eye reduction mode, return light detected";
+					return out.put("Flash fired, compulsory flash mode, red-eye reduction mode, return light detected");
 				case 0x0059:
-					return "Flash fired, auto mode, red-eye reduction mode";
+					return out.put("Flash fired, auto mode, red-eye reduction mode");
 				case 0x005D:
-					return "Flash fired, auto mode, return light not detected, red-eye reduction mode";
+					return out.put("Flash fired, auto mode, return light not detected, red-eye reduction mode");
 				case 0x005F:
-					return "Flash fired, auto mode, return light detected, red-eye reduction mode";
+					return out.put("Flash fired, auto mode, return light detected, red-eye reduction mode");
 				default:
 					snprintf(format, std::size(format), "Unknown (%d)", flash);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -524,11 +523,10 @@ ConvertExifTag(FITAG *tag) {
 		{
 			const auto sceneType = *((uint8_t*)FreeImage_GetTagValue(tag));
 			if (sceneType == 1) {
-				return "Directly photographed image";
+				return out.put("Directly photographed image");
 			} else {
 				snprintf(format, std::size(format), "Unknown (%d)", sceneType);
-				buffer += format;
-				return buffer.c_str();
+				return out.put(format);
 			}
 		}
 		break;
@@ -537,14 +535,13 @@ ConvertExifTag(FITAG *tag) {
 		{
 			FIRational r(tag);
 			if (r.getNumerator() == 0xFFFFFFFF) {
-				return "Infinity";
+				return out.put("Infinity");
 			} else if (r.getNumerator() == 0) {
-				return "Distance unknown";
+				return out.put("Distance unknown");
 			} else {
 				double distance = r.doubleValue();
 				snprintf(format, std::size(format), "%.3f meters", distance);
-				buffer += format;
-				return buffer.c_str();
+				return out.put(format);
 			}
 		}
 		break;
@@ -554,23 +551,23 @@ ConvertExifTag(FITAG *tag) {
 			const auto meteringMode = *((unsigned short *)FreeImage_GetTagValue(tag));
 			switch (meteringMode) {
 				case 0:
-					return "Unknown";
+					return out.put("Unknown");
 				case 1:
-					return "Average";
+					return out.put("Average");
 				case 2:
-					return "Center weighted average";
+					return out.put("Center weighted average");
 				case 3:
-					return "Spot";
+					return out.put("Spot");
 				case 4:
-					return "Multi-spot";
+					return out.put("Multi-spot");
 				case 5:
-					return "Multi-segment";
+					return out.put("Multi-segment");
 				case 6:
-					return "Partial";
+					return out.put("Partial");
 				case 255:
-					return "(Other)";
+					return out.put("(Other)");
 				default:
-					return "";
+					return out.put("");
 			}
 		}
 		break;
@@ -580,49 +577,49 @@ ConvertExifTag(FITAG *tag) {
 			const auto lightSource = *((unsigned short *)FreeImage_GetTagValue(tag));
 			switch (lightSource) {
 				case 0:
-					return "Unknown";
+					return out.put("Unknown");
 				case 1:
-					return "Daylight";
+					return out.put("Daylight");
 				case 2:
-					return "Fluorescent";
+					return out.put("Fluorescent");
 				case 3:
-					return "Tungsten (incandescent light)";
+					return out.put("Tungsten (incandescent light)");
 				case 4:
-					return "Flash";
+					return out.put("Flash");
 				case 9:
-					return "Fine weather";
+					return out.put("Fine weather");
 				case 10:
-					return "Cloudy weather";
+					return out.put("Cloudy weather");
 				case 11:
-					return "Shade";
+					return out.put("Shade");
 				case 12:
-					return "Daylight fluorescent (D 5700 - 7100K)";
+					return out.put("Daylight fluorescent (D 5700 - 7100K)");
 				case 13:
-					return "Day white fluorescent (N 4600 - 5400K)";
+					return out.put("Day white fluorescent (N 4600 - 5400K)");
 				case 14:
-					return "Cool white fluorescent (W 3900 - 4500K)";
+					return out.put("Cool white fluorescent (W 3900 - 4500K)");
 				case 15:
-					return "White fluorescent (WW 3200 - 3700K)";
+					return out.put("White fluorescent (WW 3200 - 3700K)");
 				case 17:
-					return "Standard light A";
+					return out.put("Standard light A");
 				case 18:
-					return "Standard light B";
+					return out.put("Standard light B");
 				case 19:
-					return "Standard light C";
+					return out.put("Standard light C");
 				case 20:
-					return "D55";
+					return out.put("D55");
 				case 21:
-					return "D65";
+					return out.put("D65");
 				case 22:
-					return "D75";
+					return out.put("D75");
 				case 23:
-					return "D50";
+					return out.put("D50");
 				case 24:
-					return "ISO studio tungsten";
+					return out.put("ISO studio tungsten");
 				case 255:
-					return "(Other)";
+					return out.put("(Other)");
 				default:
-					return "";
+					return out.put("");
 			}
 		}
 		break;
@@ -633,21 +630,21 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (sensingMethod) {
 				case 1:
-					return "(Not defined)";
+					return out.put("(Not defined)");
 				case 2:
-					return "One-chip color area sensor";
+					return out.put("One-chip color area sensor");
 				case 3:
-					return "Two-chip color area sensor";
+					return out.put("Two-chip color area sensor");
 				case 4:
-					return "Three-chip color area sensor";
+					return out.put("Three-chip color area sensor");
 				case 5:
-					return "Color sequential area sensor";
+					return out.put("Color sequential area sensor");
 				case 7:
-					return "Trilinear sensor";
+					return out.put("Trilinear sensor");
 				case 8:
-					return "Color sequential linear sensor";
+					return out.put("Color sequential linear sensor");
 				default:
-					return "";
+					return out.put("");
 			}
 		}
 		break;
@@ -656,11 +653,10 @@ ConvertExifTag(FITAG *tag) {
 		{
 			const auto fileSource = *((uint8_t*)FreeImage_GetTagValue(tag));
 			if (fileSource == 3) {
-				return "Digital Still Camera (DSC)";
+				return out.put("Digital Still Camera (DSC)");
 			} else {
 				snprintf(format, std::size(format), "Unknown (%d)", fileSource);
-				buffer += format;
-				return buffer.c_str();
+				return out.put(format);
 			}
         }
 		break;
@@ -671,25 +667,24 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (exposureProgram) {
 				case 1:
-					return "Manual control";
+					return out.put("Manual control");
 				case 2:
-					return "Program normal";
+					return out.put("Program normal");
 				case 3:
-					return "Aperture priority";
+					return out.put("Aperture priority");
 				case 4:
-					return "Shutter priority";
+					return out.put("Shutter priority");
 				case 5:
-					return "Program creative (slow program)";
+					return out.put("Program creative (slow program)");
 				case 6:
-					return "Program action (high-speed program)";
+					return out.put("Program action (high-speed program)");
 				case 7:
-					return "Portrait mode";
+					return out.put("Portrait mode");
 				case 8:
-					return "Landscape mode";
+					return out.put("Landscape mode");
 				default:
 					snprintf(format, std::size(format), "Unknown program (%d)", exposureProgram);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -700,13 +695,12 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (customRendered) {
 				case 0:
-					return "Normal process";
+					return out.put("Normal process");
 				case 1:
-					return "Custom process";
+					return out.put("Custom process");
 				default:
 					snprintf(format, std::size(format), "Unknown rendering (%d)", customRendered);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -717,15 +711,14 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (exposureMode) {
 				case 0:
-					return "Auto exposure";
+					return out.put("Auto exposure");
 				case 1:
-					return "Manual exposure";
+					return out.put("Manual exposure");
 				case 2:
-					return "Auto bracket";
+					return out.put("Auto bracket");
 				default:
 					snprintf(format, std::size(format), "Unknown mode (%d)", exposureMode);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -736,13 +729,12 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (whiteBalance) {
 				case 0:
-					return "Auto white balance";
+					return out.put("Auto white balance");
 				case 1:
-					return "Manual white balance";
+					return out.put("Manual white balance");
 				default:
 					snprintf(format, std::size(format), "Unknown (%d)", whiteBalance);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -753,17 +745,16 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (sceneType) {
 				case 0:
-					return "Standard";
+					return out.put("Standard");
 				case 1:
-					return "Landscape";
+					return out.put("Landscape");
 				case 2:
-					return "Portrait";
+					return out.put("Portrait");
 				case 3:
-					return "Night scene";
+					return out.put("Night scene");
 				default:
 					snprintf(format, std::size(format), "Unknown (%d)", sceneType);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -774,19 +765,18 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (gainControl) {
 				case 0:
-					return "None";
+					return out.put("None");
 				case 1:
-					return "Low gain up";
+					return out.put("Low gain up");
 				case 2:
-					return "High gain up";
+					return out.put("High gain up");
 				case 3:
-					return "Low gain down";
+					return out.put("Low gain down");
 				case 4:
-					return "High gain down";
+					return out.put("High gain down");
 				default:
 					snprintf(format, std::size(format), "Unknown (%d)", gainControl);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -797,15 +787,14 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (contrast) {
 				case 0:
-					return "Normal";
+					return out.put("Normal");
 				case 1:
-					return "Soft";
+					return out.put("Soft");
 				case 2:
-					return "Hard";
+					return out.put("Hard");
 				default:
 					snprintf(format, std::size(format), "Unknown (%d)", contrast);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -816,15 +805,14 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (saturation) {
 				case 0:
-					return "Normal";
+					return out.put("Normal");
 				case 1:
-					return "Low saturation";
+					return out.put("Low saturation");
 				case 2:
-					return "High saturation";
+					return out.put("High saturation");
 				default:
 					snprintf(format, std::size(format), "Unknown (%d)", saturation);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -835,15 +823,14 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (sharpness) {
 				case 0:
-					return "Normal";
+					return out.put("Normal");
 				case 1:
-					return "Soft";
+					return out.put("Soft");
 				case 2:
-					return "Hard";
+					return out.put("Hard");
 				default:
 					snprintf(format, std::size(format), "Unknown (%d)", sharpness);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -854,17 +841,16 @@ ConvertExifTag(FITAG *tag) {
 
 			switch (distanceRange) {
 				case 0:
-					return "unknown";
+					return out.put("unknown");
 				case 1:
-					return "Macro";
+					return out.put("Macro");
 				case 2:
-					return "Close view";
+					return out.put("Close view");
 				case 3:
-					return "Distant view";
+					return out.put("Distant view");
 				default:
 					snprintf(format, std::size(format), "Unknown (%d)", distanceRange);
-					buffer += format;
-					return buffer.c_str();
+					return out.put(format);
 			}
 		}
 		break;
@@ -875,9 +861,7 @@ ConvertExifTag(FITAG *tag) {
 			if (isoEquiv < 50) {
 				isoEquiv *= 200;
 			}
-			snprintf(format, std::size(format), "%d", isoEquiv);
-			buffer += format;
-			return buffer.c_str();
+			return out.putInt((int)isoEquiv);
 		}
 		break;
 
@@ -885,12 +869,13 @@ ConvertExifTag(FITAG *tag) {
 		{
 			// first 8 bytes are used to define an ID code
 			// we assume this is an ASCII string
-			auto *userComment = (const uint8_t*)FreeImage_GetTagValue(tag);
-			for (uint32_t i = 8; i < FreeImage_GetTagLength(tag); i++) {
-				buffer += userComment[i];
+			// up to the first null byte
+			auto *userComment = (const char*)FreeImage_GetTagValue(tag);
+			uint32_t i = 8;
+			while ((i < FreeImage_GetTagLength(tag)) && userComment[i]) {
+				i++;
 			}
-			buffer += '\0';
-			return buffer.c_str();
+			return (i > 8) ? out.put(userComment + 8, i - 8) : true;
 		}
 		break;
 
@@ -976,27 +961,20 @@ ConvertExifTag(FITAG *tag) {
 					break;
 			}
 
-			buffer += format;
-			return buffer.c_str();
+			return out.put(format);
 		}
 		break;
 	}
 
-	return ConvertAnyTag(tag);
+	return false;
 }
 
 /**
-Convert a Exif GPS tag to a C string
+Convert a Exif GPS tag to a C string, returns false for tags left to ConvertAnyTag
 */
-static const char* 
-ConvertExifGPSTag(FITAG *tag) {
+static bool
+ConvertExifGPSTag(TagStringWriter &out, FITAG *tag) {
 	char format[MAX_TEXT_EXTENT];
-	static std::string buffer;
-
-	if (!tag)
-		return nullptr;
-
-	buffer.erase();
 
 	// convert the tag value to a string buffer
 
@@ -1025,8 +1003,7 @@ ConvertExifGPSTag(FITAG *tag) {
 				ss = ss - dd * 3600 - mm * 60;
 
 				snprintf(format, std::size(format), "%d:%d:%.2f", dd, mm, ss);
-				buffer += format;
-				return buffer.c_str();
+				return out.put(format);
 			}
 		}
 		break;
@@ -1062,22 +1039,30 @@ ConvertExifGPSTag(FITAG *tag) {
 			break;
 	}
 
-	return ConvertAnyTag(tag);
+	return false;
 }
 
 // ==========================================================
 // Tag to string conversion function
 //
 
-const char* DLL_CALLCONV 
-FreeImage_TagToString(FREE_IMAGE_MDMODEL model, FITAG *tag, char *Make) {
+/**
+Convert a tag of a metadata model into a caller buffer, returns the length of the whole string
+*/
+static size_t
+ConvertTag(FREE_IMAGE_MDMODEL model, FITAG *tag, char *buffer, size_t size) {
+	TagStringWriter out(buffer, size);
+
+	bool converted = false;
 	switch (model) {
 		case FIMD_EXIF_MAIN:
 		case FIMD_EXIF_EXIF:
-			return ConvertExifTag(tag);
+			converted = ConvertExifTag(out, tag);
+			break;
 
 		case FIMD_EXIF_GPS:
-			return ConvertExifGPSTag(tag);
+			converted = ConvertExifGPSTag(out, tag);
+			break;
 
 		case FIMD_EXIF_MAKERNOTE:
 			// We should use the Make string to select an appropriate conversion function
@@ -1088,7 +1073,36 @@ FreeImage_TagToString(FREE_IMAGE_MDMODEL model, FITAG *tag, char *Make) {
 		default:
 			break;
 	}
+	if (!converted) {
+		ConvertAnyTag(out, tag);
+	}
 
-	return ConvertAnyTag(tag);
+	return out.finish();
 }
 
+const char* DLL_CALLCONV 
+FreeImage_TagToString(FREE_IMAGE_MDMODEL model, FITAG *tag, char *Make) {
+	if (!tag) {
+		return nullptr;
+	}
+
+	// one string per thread, valid until the next call
+	thread_local std::string buffer(MAX_TEXT_EXTENT, '\0');
+	const size_t length = ConvertTag(model, tag, buffer.data(), buffer.size());
+	if (length >= buffer.size()) {
+		buffer.resize(length + 1);
+		ConvertTag(model, tag, buffer.data(), buffer.size());
+	}
+	return buffer.c_str();
+}
+
+unsigned DLL_CALLCONV
+FreeImage_TagToStringBuf(FREE_IMAGE_MDMODEL model, FITAG *tag, char *buffer, unsigned size) {
+	if (!tag || !buffer) {
+		if (buffer && size) {
+			buffer[0] = '\0';
+		}
+		return 0;
+	}
+	return (unsigned)ConvertTag(model, tag, buffer, size);
+}
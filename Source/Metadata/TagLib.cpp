@@ -1478,21 +1478,40 @@ TagLib::TagLib() {
 }
 
 FIBOOL TagLib::addMetadataModel(MDMODEL md_model, TagInfo *tag_table) {
-	// check that the model doesn't already exist
-	if ((_table_map.find(md_model) == _table_map.end()) && tag_table) {
-
-		// add the metadata model
-		TAGINFO& info_map = _table_map[md_model];
+	// check that the model is known and doesn't already exist
+	if ((md_model <= UNKNOWN) || (md_model > ANIMATION) || !tag_table) {
+		return FALSE;
+	}
+	TAGTABLE& table = _tables[md_model];
+	if (!table.by_tag.empty()) {
+		return FALSE;
+	}
 
-		// add the tag description table
-		for (int i = 0; tag_table[i].tag || tag_table[i].fieldname; ++i) {
-			info_map[tag_table[i].tag] = &tag_table[i];
+	// add the tag description table, sorted by tag ID
+	for (int i = 0; tag_table[i].tag || tag_table[i].fieldname; ++i) {
+		table.by_tag.push_back(&tag_table[i]);
+	}
+	std::stable_sort(table.by_tag.begin(), table.by_tag.end(), [](const TagInfo *a, const TagInfo *b) {
+		return a->tag < b->tag;
+	});
+
+	// a tag ID listed twice resolves to its last definition
+	auto last = std::unique(table.by_tag.rbegin(), table.by_tag.rend(), [](const TagInfo *a, const TagInfo *b) {
+		return a->tag == b->tag;
+	});
+	table.by_tag.erase(table.by_tag.begin(), last.base());
+
+	// field names, sorted by name then by tag ID so that a name listed twice resolves to its lowest tag ID
+	for (const TagInfo *info : table.by_tag) {
+		if (info->fieldname) {
+			table.by_name.push_back(info);
 		}
-
-		return TRUE;
 	}
+	std::stable_sort(table.by_name.begin(), table.by_name.end(), [](const TagInfo *a, const TagInfo *b) {
+		return strcmp(a->fieldname, b->fieldname) < 0;
+	});
 
-	return FALSE;
+	return TRUE;
 }
 
 TagLib::~TagLib() = default;
@@ -1504,14 +1523,24 @@ TagLib::instance() {
 	return s;
 }
 
+const TagLib::TAGTABLE* 
+TagLib::getTable(MDMODEL md_model) const {
+	if ((md_model > UNKNOWN) && (md_model <= ANIMATION)) {
+		return &_tables[md_model];
+	}
+	return nullptr;
+}
+
 const TagInfo* 
 TagLib::getTagInfo(MDMODEL md_model, uint16_t tagID) const {
 
-	if (auto it = _table_map.find(md_model); it != _table_map.end()) {
+	if (const TAGTABLE *table = getTable(md_model)) {
 
-		const TAGINFO &info_map = it->second;
-		if (auto i = info_map.find(tagID); i != info_map.end()) {
-			return i->second;
+		auto i = std::lower_bound(table->by_tag.begin(), table->by_tag.end(), tagID, [](const TagInfo *info, uint16_t tag) {
+			return info->tag < tag;
+		});
+		if ((i != table->by_tag.end()) && ((*i)->tag == tagID)) {
+			return *i;
 		}
 	}
 	return nullptr;
@@ -1546,14 +1575,14 @@ TagLib::getTagDescription(MDMODEL md_model, uint16_t tagID) const {
 
 int TagLib::getTagID(MDMODEL md_model, const char *key) const {
 
-	if (auto it = _table_map.find(md_model); it != _table_map.end()) {
+	const TAGTABLE *table = getTable(md_model);
+	if (table && key) {
 
-		const TAGINFO &info_map = it->second;
-		for (auto i = info_map.begin(); i != info_map.end(); ++i) {
-			const TagInfo *info = i->second;
-			if (info && (strcmp(info->fieldname, key) == 0)) {
-				return (int)info->tag;
-			}
+		auto i = std::lower_bound(table->by_name.begin(), table->by_name.end(), key, [](const TagInfo *info, const char *name) {
+			return strcmp(info->fieldname, name) < 0;
+		});
+		if ((i != table->by_name.end()) && (strcmp((*i)->fieldname, key) == 0)) {
+			return (int)(*i)->tag;
 		}
 	}
 	return -1;
@@ -0,0 +1,1054 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "DDSBlockDecoder.h"
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "FreeImage/CPUDispatch.h"
+#include "FreeImage/ConversionSIMD.h"
+
+#if FREEIMAGE_SIMD_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+// table lookups of 16 bytes (vqtbl1q_u8) are AArch64 only
+#define FREEIMAGE_BC_SIMD_NEON 1
+#else
+#define FREEIMAGE_BC_SIMD_NEON 0
+#endif
+
+namespace {
+
+	// ----------------------------------------------------------
+	//   BC1, BC2, BC3, BC4 and BC5 (DXT1 to DXT5, ATI1 and ATI2)
+	// ----------------------------------------------------------
+
+	/**
+	32-bit pixel with the bytes in the FreeImage channel order
+	*/
+	inline uint32_t PackPixel(unsigned r, unsigned g, unsigned b, unsigned a) {
+		uint8_t pixel[4];
+		pixel[FI_RGBA_RED] = (uint8_t)r;
+		pixel[FI_RGBA_GREEN] = (uint8_t)g;
+		pixel[FI_RGBA_BLUE] = (uint8_t)b;
+		pixel[FI_RGBA_ALPHA] = (uint8_t)a;
+		uint32_t value;
+		memcpy(&value, pixel, sizeof(value));
+		return value;
+	}
+
+	inline unsigned Expand5(unsigned x) {
+		return (x << 3) | (x >> 2);
+	}
+
+	inline unsigned Expand6(unsigned x) {
+		return (x << 2) | (x >> 4);
+	}
+
+	/**
+	Get the 4 possible colors of a color block.
+	BC1 blocks with color0 <= color1 have 3 colors and a transparent black, BC2 and BC3 blocks always have 4 colors.
+	*/
+	void GetBlockColors(const uint8_t *block, uint32_t colors[4], bool bc1) {
+		const unsigned c0 = block[0] | ((unsigned)block[1] << 8);
+		const unsigned c1 = block[2] | ((unsigned)block[3] << 8);
+
+		// expand from 565 to 888
+		unsigned r[4], g[4], b[4];
+		r[0] = Expand5(c0 >> 11);
+		g[0] = Expand6((c0 >> 5) & 0x3F);
+		b[0] = Expand5(c0 & 0x1F);
+		r[1] = Expand5(c1 >> 11);
+		g[1] = Expand6((c1 >> 5) & 0x3F);
+		b[1] = Expand5(c1 & 0x1F);
+
+		if ((c0 > c1) || !bc1) {
+			// 4 color block
+			for (unsigned i = 0; i < 2; i++) {
+				r[i + 2] = (r[0] * (2 - i) + r[1] * (1 + i)) / 3;
+				g[i + 2] = (g[0] * (2 - i) + g[1] * (1 + i)) / 3;
+				b[i + 2] = (b[0] * (2 - i) + b[1] * (1 + i)) / 3;
+			}
+			for (unsigned i = 0; i < 4; i++) {
+				colors[i] = PackPixel(r[i], g[i], b[i], 0xFF);
+			}
+		}
+		else {
+			// 3 color block, number 4 is transparent
+			for (unsigned i = 0; i < 2; i++) {
+				colors[i] = PackPixel(r[i], g[i], b[i], 0xFF);
+			}
+			colors[2] = PackPixel((r[0] + r[1]) / 2, (g[0] + g[1]) / 2, (b[0] + b[1]) / 2, 0xFF);
+			colors[3] = PackPixel(0, 0, 0, 0);
+		}
+	}
+
+	/**
+	Get the 8 possible values of a BC3 alpha block, also used by the BC4 and BC5 channels
+	*/
+	void GetChannelPalette(const uint8_t *block, uint8_t palette[8]) {
+		const unsigned a0 = block[0];
+		const unsigned a1 = block[1];
+		palette[0] = (uint8_t)a0;
+		palette[1] = (uint8_t)a1;
+		if (a0 > a1) {
+			// 8 alpha block
+			for (unsigned i = 0; i < 6; i++) {
+				palette[i + 2] = (uint8_t)(((6 - i) * a0 + (1 + i) * a1 + 3) / 7);
+			}
+		}
+		else {
+			// 6 alpha block
+			for (unsigned i = 0; i < 4; i++) {
+				palette[i + 2] = (uint8_t)(((4 - i) * a0 + (1 + i) * a1 + 2) / 5);
+			}
+			palette[6] = 0;
+			palette[7] = 0xFF;
+		}
+	}
+
+	/**
+	Get the 8 possible values of a signed BC4 or BC5 channel block, mapped from [-1..1] to [0..255]
+	*/
+	void GetSignedChannelPalette(const uint8_t *block, uint8_t palette[8]) {
+		// interpolate e + 127 in [0..254], -128 is the same as -127
+		const unsigned e0 = (unsigned)(std::max<int>((int8_t)block[0], -127) + 127);
+		const unsigned e1 = (unsigned)(std::max<int>((int8_t)block[1], -127) + 127);
+		unsigned values[8] = { e0, e1 };
+		if (e0 > e1) {
+			for (unsigned i = 0; i < 6; i++) {
+				values[i + 2] = ((6 - i) * e0 + (1 + i) * e1 + 3) / 7;
+			}
+		}
+		else {
+			for (unsigned i = 0; i < 4; i++) {
+				values[i + 2] = ((4 - i) * e0 + (1 + i) * e1 + 2) / 5;
+			}
+			values[6] = 0;
+			values[7] = 254;
+		}
+		for (unsigned i = 0; i < 8; i++) {
+			palette[i] = (uint8_t)((values[i] * 255 + 127) / 254);
+		}
+	}
+
+	/**
+	Get the 16 3-bit indices of a channel block
+	*/
+	inline uint64_t GetChannelIndices(const uint8_t *block) {
+		uint64_t bits = 0;
+		for (int i = 7; i >= 2; i--) {
+			bits = (bits << 8) | block[i];
+		}
+		return bits;
+	}
+
+	void DecodeChannelBlock(const uint8_t *block, bool is_signed, uint8_t values[16]) {
+		uint8_t palette[8];
+		if (is_signed) {
+			GetSignedChannelPalette(block, palette);
+		} else {
+			GetChannelPalette(block, palette);
+		}
+		const uint64_t bits = GetChannelIndices(block);
+		for (unsigned i = 0; i < 16; i++) {
+			values[i] = palette[(bits >> (3 * i)) & 7];
+		}
+	}
+
+	/**
+	Decode the 16 4-bit values of a BC2 alpha block
+	*/
+	void DecodeExplicitAlpha(const uint8_t *block, uint8_t values[16]) {
+		for (unsigned i = 0; i < 8; i++) {
+			values[2 * i] = (uint8_t)((block[i] & 0xF) * 0x11);
+			values[2 * i + 1] = (uint8_t)((block[i] >> 4) * 0x11);
+		}
+	}
+
+	template <BCFormat format>
+	void ColorBlockRow(const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch) {
+		constexpr bool bc1 = (format == BCFormat::BC1);
+		constexpr unsigned block_size = bc1 ? 8 : 16;
+
+		for (unsigned i = 0; i < count; i++, blocks += block_size, dst += 16) {
+			const uint8_t *color = bc1 ? blocks : blocks + 8;
+			uint32_t colors[4];
+			GetBlockColors(color, colors, bc1);
+			for (unsigned y = 0; y < 4; y++) {
+				uint32_t row[4];
+				for (unsigned x = 0; x < 4; x++) {
+					row[x] = colors[(color[4 + y] >> (2 * x)) & 3];
+				}
+				memcpy(dst + y * dst_pitch, row, sizeof(row));
+			}
+			if (!bc1) {
+				uint8_t alphas[16];
+				if (format == BCFormat::BC2) {
+					DecodeExplicitAlpha(blocks, alphas);
+				} else {
+					DecodeChannelBlock(blocks, false, alphas);
+				}
+				for (unsigned y = 0; y < 4; y++) {
+					for (unsigned x = 0; x < 4; x++) {
+						dst[y * dst_pitch + 4 * x + FI_RGBA_ALPHA] = alphas[4 * y + x];
+					}
+				}
+			}
+		}
+	}
+
+	template <bool is_signed>
+	void BC4BlockRow(const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch) {
+		for (unsigned i = 0; i < count; i++, blocks += 8, dst += 4) {
+			uint8_t values[16];
+			DecodeChannelBlock(blocks, is_signed, values);
+			for (unsigned y = 0; y < 4; y++) {
+				memcpy(dst + y * dst_pitch, values + 4 * y, 4);
+			}
+		}
+	}
+
+	template <bool is_signed>
+	void BC5BlockRow(const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch) {
+		for (unsigned i = 0; i < count; i++, blocks += 16, dst += 12) {
+			uint8_t red[16], green[16];
+			DecodeChannelBlock(blocks, is_signed, red);
+			DecodeChannelBlock(blocks + 8, is_signed, green);
+			for (unsigned y = 0; y < 4; y++) {
+				uint8_t *pixel = dst + y * dst_pitch;
+				for (unsigned x = 0; x < 4; x++, pixel += 3) {
+					pixel[FI_RGBA_RED] = red[4 * y + x];
+					pixel[FI_RGBA_GREEN] = green[4 * y + x];
+					pixel[FI_RGBA_BLUE] = 0;
+				}
+			}
+		}
+	}
+
+#if FREEIMAGE_SIMD_X86 || FREEIMAGE_BC_SIMD_NEON
+
+	/**
+	Byte shuffles of the SIMD kernels, an index of 0x80 clears the byte
+	*/
+	struct ShuffleTables {
+		/// the 4 2-bit color indices of a block row byte to the bytes of 4 pixels
+		alignas(16) uint8_t colorRows[256][16];
+		/// the 4 alpha values of row y of a block to the alpha bytes of 4 pixels
+		alignas(16) uint8_t alphaRows[4][16];
+
+		ShuffleTables() {
+			for (unsigned bits = 0; bits < 256; bits++) {
+				for (unsigned x = 0; x < 4; x++) {
+					const unsigned index = (bits >> (2 * x)) & 3;
+					for (unsigned c = 0; c < 4; c++) {
+						colorRows[bits][4 * x + c] = (uint8_t)(4 * index + c);
+					}
+				}
+			}
+			memset(alphaRows, 0x80, sizeof(alphaRows));
+			for (unsigned y = 0; y < 4; y++) {
+				for (unsigned x = 0; x < 4; x++) {
+					alphaRows[y][4 * x + FI_RGBA_ALPHA] = (uint8_t)(4 * y + x);
+				}
+			}
+		}
+	};
+
+	const ShuffleTables& GetShuffleTables() {
+		static const ShuffleTables tables;
+		return tables;
+	}
+
+	/**
+	Get the 8 values and the 16 indices of a channel block
+	*/
+	inline void GetChannelBlock(const uint8_t *block, bool is_signed, uint8_t palette[16], uint8_t indices[16]) {
+		if (is_signed) {
+			GetSignedChannelPalette(block, palette);
+		} else {
+			GetChannelPalette(block, palette);
+		}
+		memset(palette + 8, 0, 8);
+		const uint64_t bits = GetChannelIndices(block);
+		for (unsigned i = 0; i < 16; i++) {
+			indices[i] = (uint8_t)((bits >> (3 * i)) & 7);
+		}
+	}
+
+#endif // FREEIMAGE_SIMD_X86 || FREEIMAGE_BC_SIMD_NEON
+
+#if FREEIMAGE_SIMD_X86
+
+	// ----------------------------------------------------------
+	//  SSSE3 kernels
+	// ----------------------------------------------------------
+
+	FI_TARGET("ssse3")
+	inline __m128i ChannelBlock_SSSE3(const uint8_t *block, bool is_signed) {
+		alignas(16) uint8_t palette[16];
+		alignas(16) uint8_t indices[16];
+		GetChannelBlock(block, is_signed, palette, indices);
+		return _mm_shuffle_epi8(_mm_load_si128((const __m128i *)palette), _mm_load_si128((const __m128i *)indices));
+	}
+
+	FI_TARGET("ssse3")
+	inline __m128i ExplicitAlpha_SSSE3(const uint8_t *block) {
+		const __m128i nibble = _mm_set1_epi8(0x0F);
+		const __m128i packed = _mm_loadl_epi64((const __m128i *)block);
+		const __m128i low = _mm_and_si128(packed, nibble);
+		const __m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), nibble);
+		// 4-bit to 8-bit: x * 0x11
+		const __m128i alpha = _mm_unpacklo_epi8(low, high);
+		return _mm_or_si128(alpha, _mm_slli_epi16(alpha, 4));
+	}
+
+	template <BCFormat format>
+	FI_TARGET("ssse3")
+	void ColorBlockRow_SSSE3(const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch) {
+		constexpr bool bc1 = (format == BCFormat::BC1);
+		constexpr unsigned block_size = bc1 ? 8 : 16;
+		const ShuffleTables &tables = GetShuffleTables();
+		const __m128i alpha_mask = _mm_set1_epi32((int)(0xFFU << (8 * FI_RGBA_ALPHA)));
+
+		for (unsigned i = 0; i < count; i++, blocks += block_size, dst += 16) {
+			const uint8_t *color = bc1 ? blocks : blocks + 8;
+			alignas(16) uint32_t colors[4];
+			GetBlockColors(color, colors, bc1);
+			const __m128i palette = _mm_load_si128((const __m128i *)colors);
+
+			__m128i alpha = _mm_setzero_si128();
+			if (format == BCFormat::BC2) {
+				alpha = ExplicitAlpha_SSSE3(blocks);
+			} else if (format == BCFormat::BC3) {
+				alpha = ChannelBlock_SSSE3(blocks, false);
+			}
+
+			for (unsigned y = 0; y < 4; y++) {
+				__m128i row = _mm_shuffle_epi8(palette, _mm_load_si128((const __m128i *)tables.colorRows[color[4 + y]]));
+				if (!bc1) {
+					const __m128i row_alpha = _mm_shuffle_epi8(alpha, _mm_load_si128((const __m128i *)tables.alphaRows[y]));
+					row = _mm_or_si128(_mm_andnot_si128(alpha_mask, row), row_alpha);
+				}
+				_mm_storeu_si128((__m128i *)(dst + y * dst_pitch), row);
+			}
+		}
+	}
+
+	template <bool is_signed>
+	FI_TARGET("ssse3")
+	void BC4BlockRow_SSSE3(const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch) {
+		for (unsigned i = 0; i < count; i++, blocks += 8, dst += 4) {
+			alignas(16) uint8_t values[16];
+			_mm_store_si128((__m128i *)values, ChannelBlock_SSSE3(blocks, is_signed));
+			for (unsigned y = 0; y < 4; y++) {
+				memcpy(dst + y * dst_pitch, values + 4 * y, 4);
+			}
+		}
+	}
+
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_BC_SIMD_NEON
+
+	// ----------------------------------------------------------
+	//  NEON kernels
+	// ----------------------------------------------------------
+
+	inline uint8x16_t ChannelBlock_NEON(const uint8_t *block, bool is_signed) {
+		uint8_t palette[16];
+		uint8_t indices[16];
+		GetChannelBlock(block, is_signed, palette, indices);
+		return vqtbl1q_u8(vld1q_u8(palette), vld1q_u8(indices));
+	}
+
+	inline uint8x16_t ExplicitAlpha_NEON(const uint8_t *block) {
+		const uint8x8_t packed = vld1_u8(block);
+		const uint8x8x2_t alpha = vzip_u8(vand_u8(packed, vdup_n_u8(0x0F)), vshr_n_u8(packed, 4));
+		// 4-bit to 8-bit: x * 0x11
+		const uint8x16_t values = vcombine_u8(alpha.val[0], alpha.val[1]);
+		return vorrq_u8(values, vshlq_n_u8(values, 4));
+	}
+
+	template <BCFormat format>
+	void ColorBlockRow_NEON(const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch) {
+		constexpr bool bc1 = (format == BCFormat::BC1);
+		constexpr unsigned block_size = bc1 ? 8 : 16;
+		const ShuffleTables &tables = GetShuffleTables();
+		const uint8x16_t alpha_mask = vreinterpretq_u8_u32(vdupq_n_u32(0xFFU << (8 * FI_RGBA_ALPHA)));
+
+		for (unsigned i = 0; i < count; i++, blocks += block_size, dst += 16) {
+			const uint8_t *color = bc1 ? blocks : blocks + 8;
+			uint32_t colors[4];
+			GetBlockColors(color, colors, bc1);
+			const uint8x16_t palette = vreinterpretq_u8_u32(vld1q_u32(colors));
+
+			uint8x16_t alpha = vdupq_n_u8(0);
+			if (format == BCFormat::BC2) {
+				alpha = ExplicitAlpha_NEON(blocks);
+			} else if (format == BCFormat::BC3) {
+				alpha = ChannelBlock_NEON(blocks, false);
+			}
+
+			for (unsigned y = 0; y < 4; y++) {
+				uint8x16_t row = vqtbl1q_u8(palette, vld1q_u8(tables.colorRows[color[4 + y]]));
+				if (!bc1) {
+					row = vbslq_u8(alpha_mask, vqtbl1q_u8(alpha, vld1q_u8(tables.alphaRows[y])), row);
+				}
+				vst1q_u8(dst + y * dst_pitch, row);
+			}
+		}
+	}
+
+	template <bool is_signed>
+	void BC4BlockRow_NEON(const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch) {
+		for (unsigned i = 0; i < count; i++, blocks += 8, dst += 4) {
+			uint8_t values[16];
+			vst1q_u8(values, ChannelBlock_NEON(blocks, is_signed));
+			for (unsigned y = 0; y < 4; y++) {
+				memcpy(dst + y * dst_pitch, values + 4 * y, 4);
+			}
+		}
+	}
+
+#endif // FREEIMAGE_BC_SIMD_NEON
+
+	// ----------------------------------------------------------
+	//   BC6H and BC7 (BPTC)
+	// ----------------------------------------------------------
+
+	/**
+	Little endian bit stream of a 128-bit block
+	*/
+	class BlockBits {
+	public:
+		explicit BlockBits(const uint8_t *block) {
+			for (int i = 7; i >= 0; i--) {
+				mLow = (mLow << 8) | block[i];
+				mHigh = (mHigh << 8) | block[i + 8];
+			}
+		}
+
+		/**
+		Read count bits (at most 32)
+		*/
+		unsigned Read(unsigned count) {
+			if (count == 0) {
+				return 0;
+			}
+			uint64_t value;
+			if (mPosition >= 64) {
+				value = mHigh >> (mPosition - 64);
+			} else if (mPosition + count <= 64) {
+				value = mLow >> mPosition;
+			} else {
+				value = (mLow >> mPosition) | (mHigh << (64 - mPosition));
+			}
+			mPosition += count;
+			return (unsigned)(value & ((1ULL << count) - 1));
+		}
+
+	private:
+		uint64_t mLow{};
+		uint64_t mHigh{};
+		unsigned mPosition{};
+	};
+
+	/**
+	Subsets of the pixels of the 64 2-subset partitions, one bit per pixel (the first 32 are also the BC6H partitions)
+	*/
+	const uint16_t kPartitions2[64] = {
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+		0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+		0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+		0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+		0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+	};
+
+	/**
+	Subsets of the pixels of the 64 3-subset partitions
+	*/
+	const uint8_t kPartitions3[64][16] = {
+		{ 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+		{ 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+		{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+		{ 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+		{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 }, { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+		{ 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+		{ 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 }, { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+		{ 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+		{ 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 }, { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+		{ 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+		{ 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+		{ 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 }, { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+		{ 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 }, { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+		{ 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 }, { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+		{ 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 }, { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+		{ 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 }, { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+		{ 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+		{ 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 }, { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+		{ 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 }, { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+		{ 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 }, { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+		{ 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 }, { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+		{ 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 }, { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+		{ 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 }, { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+		{ 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 }, { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+		{ 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 }, { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+		{ 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 }, { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+		{ 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 }, { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+		{ 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+		{ 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+		{ 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+		{ 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 }, { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+		{ 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 }
+	};
+
+	/**
+	Anchor pixel of the second subset of the 2-subset partitions
+	*/
+	const uint8_t kAnchors2[64] = {
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+		15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+		 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+	};
+
+	/**
+	Anchor pixels of the second and third subsets of the 3-subset partitions
+	*/
+	const uint8_t kAnchors3[2][64] = {
+		{
+			 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+			 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+			 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+			 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+		},
+		{
+			15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+			15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+			15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+			15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+		}
+	};
+
+	/**
+	Interpolation weights of 2-, 3- and 4-bit indices
+	*/
+	const uint8_t kWeights2[4] = { 0, 21, 43, 64 };
+	const uint8_t kWeights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const uint8_t kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	inline int GetWeight(unsigned index, unsigned bits) {
+		return (bits == 2) ? kWeights2[index] : (bits == 3) ? kWeights3[index] : kWeights4[index];
+	}
+
+	inline int Interpolate(int e0, int e1, unsigned index, unsigned bits) {
+		const int w = GetWeight(index, bits);
+		return ((64 - w) * e0 + w * e1 + 32) >> 6;
+	}
+
+	/**
+	Subset of pixel p in a partition of 1, 2 or 3 subsets
+	*/
+	inline unsigned GetSubset(unsigned subsets, unsigned partition, unsigned p) {
+		return (subsets == 1) ? 0 : (subsets == 2) ? ((kPartitions2[partition] >> p) & 1) : kPartitions3[partition][p];
+	}
+
+	/**
+	True if pixel p is an anchor pixel (its index has one bit less)
+	*/
+	inline bool IsAnchor(unsigned subsets, unsigned partition, unsigned p) {
+		if (p == 0) {
+			return true;
+		}
+		if (subsets == 2) {
+			return p == kAnchors2[partition];
+		}
+		if (subsets == 3) {
+			return (p == kAnchors3[0][partition]) || (p == kAnchors3[1][partition]);
+		}
+		return false;
+	}
+
+	/**
+	BC7 mode parameters
+	*/
+	struct BC7Mode {
+		uint8_t subsets;
+		uint8_t partitionBits;
+		uint8_t rotationBits;
+		uint8_t indexSelectionBits;
+		uint8_t colorBits;
+		uint8_t alphaBits;
+		uint8_t endpointPBits;	//! one p-bit per endpoint
+		uint8_t sharedPBits;	//! one p-bit per subset
+		uint8_t indexBits;
+		uint8_t indexBits2;		//! separate alpha (or color, see the index selection bit) indices
+	};
+
+	const BC7Mode kBC7Modes[8] = {
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+	};
+
+	inline unsigned ExpandBits(unsigned x, unsigned bits) {
+		x <<= (8 - bits);
+		return x | (x >> bits);
+	}
+
+	void DecodeBC7Block(const uint8_t *block, uint8_t *dst, size_t dst_pitch) {
+		// the mode is the number of 0 bits before the first 1 bit
+		unsigned mode = 0;
+		while ((mode < 8) && !(block[0] & (1 << mode))) {
+			mode++;
+		}
+		if (mode == 8) {
+			// reserved mode: transparent black
+			for (unsigned y = 0; y < 4; y++) {
+				memset(dst + y * dst_pitch, 0, 16);
+			}
+			return;
+		}
+		const BC7Mode &m = kBC7Modes[mode];
+
+		BlockBits bits(block);
+		bits.Read(mode + 1);
+		const unsigned partition = bits.Read(m.partitionBits);
+		const unsigned rotation = bits.Read(m.rotationBits);
+		const unsigned indexSelection = bits.Read(m.indexSelectionBits);
+
+		// endpoints of subset s are 2 * s and 2 * s + 1
+		const unsigned count = 2 * m.subsets;
+		unsigned endpoints[6][4];
+		for (unsigned c = 0; c < 3; c++) {
+			for (unsigned i = 0; i < count; i++) {
+				endpoints[i][c] = bits.Read(m.colorBits);
+			}
+		}
+		for (unsigned i = 0; i < count; i++) {
+			endpoints[i][3] = bits.Read(m.alphaBits);
+		}
+
+		unsigned colorBits = m.colorBits;
+		unsigned alphaBits = m.alphaBits;
+		if (m.endpointPBits || m.sharedPBits) {
+			unsigned pbits[6];
+			if (m.endpointPBits) {
+				for (unsigned i = 0; i < count; i++) {
+					pbits[i] = bits.Read(1);
+				}
+			} else {
+				for (unsigned s = 0; s < m.subsets; s++) {
+					pbits[2 * s] = pbits[2 * s + 1] = bits.Read(1);
+				}
+			}
+			for (unsigned i = 0; i < count; i++) {
+				for (unsigned c = 0; c < (alphaBits ? 4U : 3U); c++) {
+					endpoints[i][c] = (endpoints[i][c] << 1) | pbits[i];
+				}
+			}
+			colorBits++;
+			if (alphaBits) {
+				alphaBits++;
+			}
+		}
+
+		// expand the endpoints to 8 bits, opaque when there is no alpha
+		for (unsigned i = 0; i < count; i++) {
+			for (unsigned c = 0; c < 3; c++) {
+				endpoints[i][c] = ExpandBits(endpoints[i][c], colorBits);
+			}
+			endpoints[i][3] = alphaBits ? ExpandBits(endpoints[i][3], alphaBits) : 0xFF;
+		}
+
+		unsigned indices[16];
+		unsigned indices2[16] = {};
+		for (unsigned p = 0; p < 16; p++) {
+			indices[p] = bits.Read(m.indexBits - (IsAnchor(m.subsets, partition, p) ? 1 : 0));
+		}
+		if (m.indexBits2) {
+			for (unsigned p = 0; p < 16; p++) {
+				indices2[p] = bits.Read(m.indexBits2 - ((p == 0) ? 1 : 0));
+			}
+		}
+
+		for (unsigned p = 0; p < 16; p++) {
+			const unsigned s = GetSubset(m.subsets, partition, p);
+			const unsigned *e0 = endpoints[2 * s];
+			const unsigned *e1 = endpoints[2 * s + 1];
+
+			unsigned colorIndex = indices[p], colorIndexBits = m.indexBits;
+			unsigned alphaIndex = indices[p], alphaIndexBits = m.indexBits;
+			if (m.indexBits2) {
+				if (indexSelection) {
+					colorIndex = indices2[p];
+					colorIndexBits = m.indexBits2;
+				} else {
+					alphaIndex = indices2[p];
+					alphaIndexBits = m.indexBits2;
+				}
+			}
+
+			int rgba[4];
+			for (unsigned c = 0; c < 3; c++) {
+				rgba[c] = Interpolate((int)e0[c], (int)e1[c], colorIndex, colorIndexBits);
+			}
+			rgba[3] = Interpolate((int)e0[3], (int)e1[3], alphaIndex, alphaIndexBits);
+
+			// rotation swaps the alpha with one of the color channels
+			if (rotation) {
+				std::swap(rgba[3], rgba[rotation - 1]);
+			}
+
+			const uint32_t pixel = PackPixel((unsigned)rgba[0], (unsigned)rgba[1], (unsigned)rgba[2], (unsigned)rgba[3]);
+			memcpy(dst + (p / 4) * dst_pitch + 4 * (p % 4), &pixel, sizeof(pixel));
+		}
+	}
+
+	void BC7BlockRow(const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch) {
+		for (unsigned i = 0; i < count; i++, blocks += 16, dst += 16) {
+			DecodeBC7Block(blocks, dst, dst_pitch);
+		}
+	}
+
+	/**
+	Endpoint components of the BC6H bit fields: endpoint * 3 + channel
+	*/
+	enum {
+		R0, G0, B0, R1, G1, B1, R2, G2, B2, R3, G3, B3
+	};
+
+	/**
+	count bits of the block, stored from bit shift of an endpoint component
+	*/
+	struct BC6HField {
+		uint8_t component;
+		uint8_t shift;
+		uint8_t count;
+	};
+
+	/**
+	BC6H mode parameters, fields are listed in the order of the block bits and end with a zero count
+	*/
+	struct BC6HMode {
+		bool transformed;		//! endpoints after the first one are deltas
+		uint8_t endpointBits;
+		uint8_t deltaBits[3];
+		BC6HField fields[32];
+	};
+
+	const BC6HMode kBC6HModes[14] = {
+		// mode 1 (00): 10.5.5.5
+		{ true, 10, { 5, 5, 5 }, {
+			{ G2, 4, 1 }, { B2, 4, 1 }, { B3, 4, 1 }, { R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 5 }, { G3, 4, 1 },
+			{ G2, 0, 4 }, { G1, 0, 5 }, { B3, 0, 1 }, { G3, 0, 4 }, { B1, 0, 5 }, { B3, 1, 1 }, { B2, 0, 4 }, { R2, 0, 5 },
+			{ B3, 2, 1 }, { R3, 0, 5 }, { B3, 3, 1 } } },
+		// mode 2 (01): 7.6.6.6
+		{ true, 7, { 6, 6, 6 }, {
+			{ G2, 5, 1 }, { G3, 4, 1 }, { G3, 5, 1 }, { R0, 0, 7 }, { B3, 0, 1 }, { B3, 1, 1 }, { B2, 4, 1 }, { G0, 0, 7 },
+			{ B2, 5, 1 }, { B3, 2, 1 }, { G2, 4, 1 }, { B0, 0, 7 }, { B3, 3, 1 }, { B3, 5, 1 }, { B3, 4, 1 }, { R1, 0, 6 },
+			{ G2, 0, 4 }, { G1, 0, 6 }, { G3, 0, 4 }, { B1, 0, 6 }, { B2, 0, 4 }, { R2, 0, 6 }, { R3, 0, 6 } } },
+		// mode 3 (00010): 11.5.4.4
+		{ true, 11, { 5, 4, 4 }, {
+			{ R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 5 }, { R0, 10, 1 }, { G2, 0, 4 }, { G1, 0, 4 }, { G0, 10, 1 },
+			{ B3, 0, 1 }, { G3, 0, 4 }, { B1, 0, 4 }, { B0, 10, 1 }, { B3, 1, 1 }, { B2, 0, 4 }, { R2, 0, 5 }, { B3, 2, 1 },
+			{ R3, 0, 5 }, { B3, 3, 1 } } },
+		// mode 4 (00110): 11.4.5.4
+		{ true, 11, { 4, 5, 4 }, {
+			{ R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 4 }, { R0, 10, 1 }, { G3, 4, 1 }, { G2, 0, 4 }, { G1, 0, 5 },
+			{ G0, 10, 1 }, { G3, 0, 4 }, { B1, 0, 4 }, { B0, 10, 1 }, { B3, 1, 1 }, { B2, 0, 4 }, { R2, 0, 4 }, { B3, 0, 1 },
+			{ B3, 2, 1 }, { R3, 0, 4 }, { G2, 4, 1 }, { B3, 3, 1 } } },
+		// mode 5 (01010): 11.4.4.5
+		{ true, 11, { 4, 4, 5 }, {
+			{ R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 4 }, { R0, 10, 1 }, { B2, 4, 1 }, { G2, 0, 4 }, { G1, 0, 4 },
+			{ G0, 10, 1 }, { B3, 0, 1 }, { G3, 0, 4 }, { B1, 0, 5 }, { B0, 10, 1 }, { B2, 0, 4 }, { R2, 0, 4 }, { B3, 1, 1 },
+			{ B3, 2, 1 }, { R3, 0, 4 }, { B3, 4, 1 }, { B3, 3, 1 } } },
+		// mode 6 (01110): 9.5.5.5
+		{ true, 9, { 5, 5, 5 }, {
+			{ R0, 0, 9 }, { B2, 4, 1 }, { G0, 0, 9 }, { G2, 4, 1 }, { B0, 0, 9 }, { B3, 4, 1 }, { R1, 0, 5 }, { G3, 4, 1 },
+			{ G2, 0, 4 }, { G1, 0, 5 }, { B3, 0, 1 }, { G3, 0, 4 }, { B1, 0, 5 }, { B3, 1, 1 }, { B2, 0, 4 }, { R2, 0, 5 },
+			{ B3, 2, 1 }, { R3, 0, 5 }, { B3, 3, 1 } } },
+		// mode 7 (10010): 8.6.5.5
+		{ true, 8, { 6, 5, 5 }, {
+			{ R0, 0, 8 }, { G3, 4, 1 }, { B2, 4, 1 }, { G0, 0, 8 }, { B3, 2, 1 }, { G2, 4, 1 }, { B0, 0, 8 }, { B3, 3, 1 },
+			{ B3, 4, 1 }, { R1, 0, 6 }, { G2, 0, 4 }, { G1, 0, 5 }, { B3, 0, 1 }, { G3, 0, 4 }, { B1, 0, 5 }, { B3, 1, 1 },
+			{ B2, 0, 4 }, { R2, 0, 6 }, { R3, 0, 6 } } },
+		// mode 8 (10110): 8.5.6.5
+		{ true, 8, { 5, 6, 5 }, {
+			{ R0, 0, 8 }, { B3, 0, 1 }, { B2, 4, 1 }, { G0, 0, 8 }, { G2, 5, 1 }, { G2, 4, 1 }, { B0, 0, 8 }, { G3, 5, 1 },
+			{ B3, 4, 1 }, { R1, 0, 5 }, { G3, 4, 1 }, { G2, 0, 4 }, { G1, 0, 6 }, { G3, 0, 4 }, { B1, 0, 5 }, { B3, 1, 1 },
+			{ B2, 0, 4 }, { R2, 0, 5 }, { B3, 2, 1 }, { R3, 0, 5 }, { B3, 3, 1 } } },
+		// mode 9 (11010): 8.5.5.6
+		{ true, 8, { 5, 5, 6 }, {
+			{ R0, 0, 8 }, { B3, 1, 1 }, { B2, 4, 1 }, { G0, 0, 8 }, { B2, 5, 1 }, { G2, 4, 1 }, { B0, 0, 8 }, { B3, 5, 1 },
+			{ B3, 4, 1 }, { R1, 0, 5 }, { G3, 4, 1 }, { G2, 0, 4 }, { G1, 0, 5 }, { B3, 0, 1 }, { G3, 0, 4 }, { B1, 0, 6 },
+			{ B2, 0, 4 }, { R2, 0, 5 }, { B3, 2, 1 }, { R3, 0, 5 }, { B3, 3, 1 } } },
+		// mode 10 (11110): 6.6.6.6, explicit endpoints
+		{ false, 6, { 6, 6, 6 }, {
+			{ R0, 0, 6 }, { G3, 4, 1 }, { B3, 0, 1 }, { B3, 1, 1 }, { B2, 4, 1 }, { G0, 0, 6 }, { G2, 5, 1 }, { B2, 5, 1 },
+			{ B3, 2, 1 }, { G2, 4, 1 }, { B0, 0, 6 }, { G3, 5, 1 }, { B3, 3, 1 }, { B3, 5, 1 }, { B3, 4, 1 }, { R1, 0, 6 },
+			{ G2, 0, 4 }, { G1, 0, 6 }, { G3, 0, 4 }, { B1, 0, 6 }, { B2, 0, 4 }, { R2, 0, 6 }, { R3, 0, 6 } } },
+		// mode 11 (00011): 10.10, one region, explicit endpoints
+		{ false, 10, { 10, 10, 10 }, {
+			{ R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 10 }, { G1, 0, 10 }, { B1, 0, 10 } } },
+		// mode 12 (00111): 11.9, one region
+		{ true, 11, { 9, 9, 9 }, {
+			{ R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 9 }, { R0, 10, 1 }, { G1, 0, 9 }, { G0, 10, 1 }, { B1, 0, 9 },
+			{ B0, 10, 1 } } },
+		// mode 13 (01011): 12.8, one region, the high bits of the first endpoint are reversed
+		{ true, 12, { 8, 8, 8 }, {
+			{ R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 8 }, { R0, 11, 1 }, { R0, 10, 1 }, { G1, 0, 8 }, { G0, 11, 1 },
+			{ G0, 10, 1 }, { B1, 0, 8 }, { B0, 11, 1 }, { B0, 10, 1 } } },
+		// mode 14 (01111): 16.4, one region, the high bits of the first endpoint are reversed
+		{ true, 16, { 4, 4, 4 }, {
+			{ R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 4 }, { R0, 15, 1 }, { R0, 14, 1 }, { R0, 13, 1 }, { R0, 12, 1 },
+			{ R0, 11, 1 }, { R0, 10, 1 }, { G1, 0, 4 }, { G0, 15, 1 }, { G0, 14, 1 }, { G0, 13, 1 }, { G0, 12, 1 }, { G0, 11, 1 },
+			{ G0, 10, 1 }, { B1, 0, 4 }, { B0, 15, 1 }, { B0, 14, 1 }, { B0, 13, 1 }, { B0, 12, 1 }, { B0, 11, 1 }, { B0, 10, 1 } } }
+	};
+
+	inline int SignExtend(unsigned value, unsigned bits) {
+		const unsigned sign = 1U << (bits - 1);
+		value &= (sign << 1) - 1;
+		return (int)(value ^ sign) - (int)sign;
+	}
+
+	/**
+	Scale an endpoint to the 16-bit interpolation range
+	*/
+	int Unquantize(int value, unsigned bits, bool is_signed) {
+		if (!is_signed) {
+			if (bits >= 15) {
+				return value;
+			}
+			if (value == 0) {
+				return 0;
+			}
+			if (value == (1 << bits) - 1) {
+				return 0xFFFF;
+			}
+			return ((value << 16) + 0x8000) >> bits;
+		}
+		if (bits >= 16) {
+			return value;
+		}
+		const bool negative = value < 0;
+		if (negative) {
+			value = -value;
+		}
+		int result;
+		if (value == 0) {
+			result = 0;
+		} else if (value >= (1 << (bits - 1)) - 1) {
+			result = 0x7FFF;
+		} else {
+			result = ((value << 15) + 0x4000) >> (bits - 1);
+		}
+		return negative ? -result : result;
+	}
+
+	/**
+	Scale an interpolated value to the half float bits
+	*/
+	uint16_t FinishUnquantize(int value, bool is_signed) {
+		if (!is_signed) {
+			return (uint16_t)((value * 31) >> 6);
+		}
+		if (value < 0) {
+			return (uint16_t)(0x8000 | (((-value) * 31) >> 5));
+		}
+		return (uint16_t)((value * 31) >> 5);
+	}
+
+	/**
+	Decode a BC6H block to 16 RGB half floats
+	*/
+	void DecodeBC6HBlock(const uint8_t *block, bool is_signed, uint16_t halves[16 * 3]) {
+		BlockBits bits(block);
+
+		// 2-bit modes 0 and 1, then 5-bit modes
+		unsigned mode = bits.Read(2);
+		if (mode > 1) {
+			const unsigned value = mode | (bits.Read(3) << 2);
+			mode = ((value & 3) == 2) ? (value >> 2) + 2 : (value >> 2) + 10;
+			if (mode >= 14) {
+				// reserved mode: black
+				memset(halves, 0, 16 * 3 * sizeof(uint16_t));
+				return;
+			}
+		}
+		const BC6HMode &m = kBC6HModes[mode];
+		const unsigned regions = (mode < 10) ? 2 : 1;
+
+		unsigned values[12] = {};
+		for (const BC6HField *field = m.fields; field->count; field++) {
+			values[field->component] |= bits.Read(field->count) << field->shift;
+		}
+		const unsigned partition = (regions == 2) ? bits.Read(5) : 0;
+
+		// sign extension and deltas
+		const unsigned count = 2 * regions;
+		int endpoints[4][3];
+		for (unsigned c = 0; c < 3; c++) {
+			endpoints[0][c] = is_signed ? SignExtend(values[c], m.endpointBits) : (int)values[c];
+			for (unsigned i = 1; i < count; i++) {
+				const unsigned value = values[3 * i + c];
+				if (m.transformed) {
+					const unsigned sum = (unsigned)(endpoints[0][c] + SignExtend(value, m.deltaBits[c])) & ((1U << m.endpointBits) - 1);
+					endpoints[i][c] = is_signed ? SignExtend(sum, m.endpointBits) : (int)sum;
+				} else {
+					endpoints[i][c] = is_signed ? SignExtend(value, m.endpointBits) : (int)value;
+				}
+			}
+		}
+		for (unsigned i = 0; i < count; i++) {
+			for (unsigned c = 0; c < 3; c++) {
+				endpoints[i][c] = Unquantize(endpoints[i][c], m.endpointBits, is_signed);
+			}
+		}
+
+		const unsigned indexBits = (regions == 2) ? 3 : 4;
+		for (unsigned p = 0; p < 16; p++) {
+			const unsigned index = bits.Read(indexBits - (IsAnchor(regions, partition, p) ? 1 : 0));
+			const unsigned s = GetSubset(regions, partition, p);
+			for (unsigned c = 0; c < 3; c++) {
+				halves[3 * p + c] = FinishUnquantize(Interpolate(endpoints[2 * s][c], endpoints[2 * s + 1][c], index, indexBits), is_signed);
+			}
+		}
+	}
+
+	template <bool is_signed>
+	void BC6HBlockRow(const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch) {
+		for (unsigned i = 0; i < count; i++, blocks += 16, dst += 4 * sizeof(FIRGBF)) {
+			uint16_t halves[16 * 3];
+			float values[16 * 3];
+			DecodeBC6HBlock(blocks, is_signed, halves);
+			ConvertHalfToFloat(values, halves, 16 * 3);
+			for (unsigned y = 0; y < 4; y++) {
+				memcpy(dst + y * dst_pitch, values + 4 * 3 * y, 4 * sizeof(FIRGBF));
+			}
+		}
+	}
+
+	// ----------------------------------------------------------
+	//   Kernels selection
+	// ----------------------------------------------------------
+
+	using BlockRowKernel = void (*)(const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch);
+
+	/// Kernels for the enabled CPU features, blocks are decoded by the scalar code until selection
+	struct BlockKernels {
+		std::atomic<BlockRowKernel> bc1{ ColorBlockRow<BCFormat::BC1> };
+		std::atomic<BlockRowKernel> bc2{ ColorBlockRow<BCFormat::BC2> };
+		std::atomic<BlockRowKernel> bc3{ ColorBlockRow<BCFormat::BC3> };
+		std::atomic<BlockRowKernel> bc4u{ BC4BlockRow<false> };
+		std::atomic<BlockRowKernel> bc4s{ BC4BlockRow<true> };
+	};
+
+	BlockKernels gKernels;
+
+	void SelectBlockKernels(uint32_t features) {
+		BlockRowKernel bc1 = ColorBlockRow<BCFormat::BC1>;
+		BlockRowKernel bc2 = ColorBlockRow<BCFormat::BC2>;
+		BlockRowKernel bc3 = ColorBlockRow<BCFormat::BC3>;
+		BlockRowKernel bc4u = BC4BlockRow<false>;
+		BlockRowKernel bc4s = BC4BlockRow<true>;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSSE3) {
+			bc1 = ColorBlockRow_SSSE3<BCFormat::BC1>;
+			bc2 = ColorBlockRow_SSSE3<BCFormat::BC2>;
+			bc3 = ColorBlockRow_SSSE3<BCFormat::BC3>;
+			bc4u = BC4BlockRow_SSSE3<false>;
+			bc4s = BC4BlockRow_SSSE3<true>;
+		}
+#elif FREEIMAGE_BC_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			bc1 = ColorBlockRow_NEON<BCFormat::BC1>;
+			bc2 = ColorBlockRow_NEON<BCFormat::BC2>;
+			bc3 = ColorBlockRow_NEON<BCFormat::BC3>;
+			bc4u = BC4BlockRow_NEON<false>;
+			bc4s = BC4BlockRow_NEON<true>;
+		}
+#endif
+		gKernels.bc1.store(bc1, std::memory_order_relaxed);
+		gKernels.bc2.store(bc2, std::memory_order_relaxed);
+		gKernels.bc3.store(bc3, std::memory_order_relaxed);
+		gKernels.bc4u.store(bc4u, std::memory_order_relaxed);
+		gKernels.bc4s.store(bc4s, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectBlockKernels);
+
+} // namespace
+
+// ----------------------------------------------------------
+
+unsigned GetBCBlockSize(BCFormat format) {
+	switch (format) {
+		case BCFormat::BC1:
+		case BCFormat::BC4U:
+		case BCFormat::BC4S:
+			return 8;
+		default:
+			return 16;
+	}
+}
+
+unsigned GetBCPixelSize(BCFormat format) {
+	switch (format) {
+		case BCFormat::BC4U:
+		case BCFormat::BC4S:
+			return 1;
+		case BCFormat::BC5U:
+		case BCFormat::BC5S:
+			return 3;
+		case BCFormat::BC6HU:
+		case BCFormat::BC6HS:
+			return sizeof(FIRGBF);
+		default:
+			return 4;
+	}
+}
+
+void DecodeBCBlockRow(BCFormat format, const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch) {
+	switch (format) {
+		case BCFormat::BC1:
+			gKernels.bc1.load(std::memory_order_relaxed)(blocks, count, dst, dst_pitch);
+			break;
+		case BCFormat::BC2:
+			gKernels.bc2.load(std::memory_order_relaxed)(blocks, count, dst, dst_pitch);
+			break;
+		case BCFormat::BC3:
+			gKernels.bc3.load(std::memory_order_relaxed)(blocks, count, dst, dst_pitch);
+			break;
+		case BCFormat::BC4U:
+			gKernels.bc4u.load(std::memory_order_relaxed)(blocks, count, dst, dst_pitch);
+			break;
+		case BCFormat::BC4S:
+			gKernels.bc4s.load(std::memory_order_relaxed)(blocks, count, dst, dst_pitch);
+			break;
+		case BCFormat::BC5U:
+			BC5BlockRow<false>(blocks, count, dst, dst_pitch);
+			break;
+		case BCFormat::BC5S:
+			BC5BlockRow<true>(blocks, count, dst, dst_pitch);
+			break;
+		case BCFormat::BC6HU:
+			BC6HBlockRow<false>(blocks, count, dst, dst_pitch);
+			break;
+		case BCFormat::BC6HS:
+			BC6HBlockRow<true>(blocks, count, dst, dst_pitch);
+			break;
+		case BCFormat::BC7:
+			BC7BlockRow(blocks, count, dst, dst_pitch);
+			break;
+	}
+}
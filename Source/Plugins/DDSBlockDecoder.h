@@ -0,0 +1,52 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_DDSBLOCKDECODER_H
+#define FREEIMAGE_DDSBLOCKDECODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+Block compressed formats of DDS textures, each 4x4 block of pixels is stored in 8 or 16 bytes
+*/
+enum class BCFormat {
+	BC1,	//! DXT1: RGB with an optional 1-bit alpha
+	BC2,	//! DXT2, DXT3: RGB with an explicit 4-bit alpha
+	BC3,	//! DXT4, DXT5: RGB with an interpolated alpha
+	BC4U,	//! ATI1: one unsigned channel
+	BC4S,	//! one signed channel
+	BC5U,	//! ATI2: two unsigned channels
+	BC5S,	//! two signed channels
+	BC6HU,	//! RGB unsigned half floats
+	BC6HS,	//! RGB signed half floats
+	BC7		//! RGBA with up to 3 partitions per block
+};
+
+/**
+Size of a 4x4 block in bytes
+*/
+unsigned GetBCBlockSize(BCFormat format);
+
+/**
+Size of a decoded pixel in bytes:
+4 (FIRGBA8) for BC1, BC2, BC3 and BC7, 1 (greyscale) for BC4, 3 (FIRGB8 with a zero blue) for BC5 and 12 (FIRGBF) for BC6H.
+Signed channels are mapped from [-1..1] to [0..255].
+*/
+unsigned GetBCPixelSize(BCFormat format);
+
+/**
+Decodes a row of blocks into 4 rows of pixels, with the SIMD kernels supported by the running CPU when there are some.
+Bytes of 8-bit pixels are in the FreeImage channel order (see FI_RGBA_RED).
+@param format Blocks format
+@param blocks Compressed blocks
+@param count Number of blocks
+@param dst First row of 4 * count pixels
+@param dst_pitch Distance between two rows in bytes
+*/
+void DecodeBCBlockRow(BCFormat format, const uint8_t *blocks, unsigned count, uint8_t *dst, size_t dst_pitch);
+
+#endif // FREEIMAGE_DDSBLOCKDECODER_H
@@ -0,0 +1,590 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "DDSBlockEncoder.h"
+#include "FreeImage.h"
+#include "Utilities.h"
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+	/**
+	RGBA pixels of a block, values in [0..255]
+	*/
+	typedef float BlockPixels[16][4];
+
+	void LoadBlock(const uint8_t *src, size_t src_pitch, BlockPixels pixels) {
+		for (unsigned y = 0; y < 4; y++) {
+			const uint8_t *pixel = src + y * src_pitch;
+			for (unsigned x = 0; x < 4; x++, pixel += 4) {
+				float *value = pixels[4 * y + x];
+				value[0] = pixel[FI_RGBA_RED];
+				value[1] = pixel[FI_RGBA_GREEN];
+				value[2] = pixel[FI_RGBA_BLUE];
+				value[3] = pixel[FI_RGBA_ALPHA];
+			}
+		}
+	}
+
+	inline float Clamp255(float value) {
+		return std::min(255.0f, std::max(0.0f, value));
+	}
+
+	/**
+	Iterations of the endpoints refinement
+	*/
+	inline unsigned GetIterations(BCQuality quality) {
+		switch (quality) {
+			case BCQuality::Fast:
+				return 1;
+			case BCQuality::Normal:
+				return 2;
+			default:
+				return 8;
+		}
+	}
+
+	/**
+	Endpoints of count pixels of N channels, along their principal axis or on the diagonal of their bounding box
+	*/
+	template <unsigned N>
+	void FitEndpoints(const float (*pixels)[4], unsigned count, bool principal, float e0[4], float e1[4]) {
+		float mean[N] = {}, lo[N], hi[N];
+		for (unsigned c = 0; c < N; c++) {
+			lo[c] = hi[c] = pixels[0][c];
+		}
+		for (unsigned i = 0; i < count; i++) {
+			for (unsigned c = 0; c < N; c++) {
+				mean[c] += pixels[i][c];
+				lo[c] = std::min(lo[c], pixels[i][c]);
+				hi[c] = std::max(hi[c], pixels[i][c]);
+			}
+		}
+		for (unsigned c = N; c < 4; c++) {
+			e0[c] = e1[c] = 255;
+		}
+		for (unsigned c = 0; c < N; c++) {
+			mean[c] /= count;
+			e0[c] = lo[c];
+			e1[c] = hi[c];
+		}
+		if (!principal) {
+			return;
+		}
+
+		// covariance matrix
+		float covariance[N][N] = {};
+		for (unsigned i = 0; i < count; i++) {
+			for (unsigned r = 0; r < N; r++) {
+				for (unsigned c = 0; c < N; c++) {
+					covariance[r][c] += (pixels[i][r] - mean[r]) * (pixels[i][c] - mean[c]);
+				}
+			}
+		}
+
+		// principal axis by power iterations, starting from the bounding box diagonal
+		float axis[N];
+		float length = 0;
+		for (unsigned c = 0; c < N; c++) {
+			axis[c] = hi[c] - lo[c];
+			length += axis[c] * axis[c];
+		}
+		if (length == 0) {
+			// single color
+			return;
+		}
+		for (unsigned iteration = 0; iteration < 8; iteration++) {
+			float next[N] = {};
+			float largest = 0;
+			for (unsigned r = 0; r < N; r++) {
+				for (unsigned c = 0; c < N; c++) {
+					next[r] += covariance[r][c] * axis[c];
+				}
+				largest = std::max(largest, std::fabs(next[r]));
+			}
+			if (largest == 0) {
+				break;
+			}
+			for (unsigned c = 0; c < N; c++) {
+				axis[c] = next[c] / largest;
+			}
+		}
+		length = 0;
+		for (unsigned c = 0; c < N; c++) {
+			length += axis[c] * axis[c];
+		}
+		length = std::sqrt(length);
+		for (unsigned c = 0; c < N; c++) {
+			axis[c] /= length;
+		}
+
+		// extreme projections on the axis
+		float tmin = FLT_MAX, tmax = -FLT_MAX;
+		for (unsigned i = 0; i < count; i++) {
+			float t = 0;
+			for (unsigned c = 0; c < N; c++) {
+				t += (pixels[i][c] - mean[c]) * axis[c];
+			}
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+		}
+		for (unsigned c = 0; c < N; c++) {
+			e0[c] = Clamp255(mean[c] + tmin * axis[c]);
+			e1[c] = Clamp255(mean[c] + tmax * axis[c]);
+		}
+	}
+
+	/**
+	Least squares endpoints of count pixels interpolated with weights (0 at e0, 1 at e1)
+	@return Returns false if all the weights are the same
+	*/
+	template <unsigned N>
+	bool LeastSquaresEndpoints(const float (*pixels)[4], const float *weights, unsigned count, float e0[4], float e1[4]) {
+		double a = 0, b = 0, c = 0;
+		double r0[N] = {}, r1[N] = {};
+		for (unsigned i = 0; i < count; i++) {
+			const double t = weights[i];
+			a += (1 - t) * (1 - t);
+			b += t * (1 - t);
+			c += t * t;
+			for (unsigned ch = 0; ch < N; ch++) {
+				r0[ch] += (1 - t) * pixels[i][ch];
+				r1[ch] += t * pixels[i][ch];
+			}
+		}
+		const double det = a * c - b * b;
+		if (std::fabs(det) < 1e-6) {
+			return false;
+		}
+		for (unsigned ch = 0; ch < N; ch++) {
+			e0[ch] = Clamp255((float)((c * r0[ch] - b * r1[ch]) / det));
+			e1[ch] = Clamp255((float)((a * r1[ch] - b * r0[ch]) / det));
+		}
+		return true;
+	}
+
+	// ----------------------------------------------------------
+	//   BC1 and BC3 color blocks
+	// ----------------------------------------------------------
+
+	inline unsigned Quantize565(const float color[4]) {
+		const unsigned r = (unsigned)(color[0] * 31 / 255 + 0.5f);
+		const unsigned g = (unsigned)(color[1] * 63 / 255 + 0.5f);
+		const unsigned b = (unsigned)(color[2] * 31 / 255 + 0.5f);
+		return (r << 11) | (g << 5) | b;
+	}
+
+	/**
+	Colors of two 565 endpoints, computed as the decoder does
+	*/
+	void GetColorPalette(unsigned c0, unsigned c1, bool four_colors, int palette[4][3]) {
+		const unsigned endpoints[2] = { c0, c1 };
+		for (unsigned i = 0; i < 2; i++) {
+			const unsigned r = endpoints[i] >> 11, g = (endpoints[i] >> 5) & 0x3F, b = endpoints[i] & 0x1F;
+			palette[i][0] = (int)((r << 3) | (r >> 2));
+			palette[i][1] = (int)((g << 2) | (g >> 4));
+			palette[i][2] = (int)((b << 3) | (b >> 2));
+		}
+		for (unsigned c = 0; c < 3; c++) {
+			if (four_colors) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			} else {
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+	}
+
+	struct ColorCandidate {
+		unsigned c0, c1;
+		bool fourColors;
+		unsigned indices[16];
+		float error;
+	};
+
+	/**
+	Order two 565 endpoints for the block mode, then pick the nearest color of each pixel
+	*/
+	void EvaluateColorEndpoints(const BlockPixels pixels, const bool transparent[16], bool bc1, bool three_colors, unsigned c0, unsigned c1, ColorCandidate *candidate) {
+		// BC1 blocks have 4 colors when c0 > c1, BC3 blocks always have 4 colors
+		if (bc1 && (three_colors == (c0 > c1))) {
+			std::swap(c0, c1);
+		}
+		candidate->c0 = c0;
+		candidate->c1 = c1;
+		candidate->fourColors = !bc1 || (c0 > c1);
+
+		int palette[4][3];
+		GetColorPalette(c0, c1, candidate->fourColors, palette);
+		const unsigned colors = candidate->fourColors ? 4 : 3;
+
+		candidate->error = 0;
+		for (unsigned i = 0; i < 16; i++) {
+			if (transparent[i]) {
+				candidate->indices[i] = 3;
+				continue;
+			}
+			float best = FLT_MAX;
+			for (unsigned index = 0; index < colors; index++) {
+				float error = 0;
+				for (unsigned c = 0; c < 3; c++) {
+					const float d = pixels[i][c] - (float)palette[index][c];
+					error += d * d;
+				}
+				if (error < best) {
+					best = error;
+					candidate->indices[i] = index;
+				}
+			}
+			candidate->error += best;
+		}
+	}
+
+	void EncodeColorBlock(const BlockPixels pixels, bool bc1, BCQuality quality, uint8_t *block) {
+		// BC1 pixels with alpha < 128 are transparent black
+		bool transparent[16];
+		float opaque[16][4];
+		unsigned opaque_index[16];
+		unsigned count = 0;
+		for (unsigned i = 0; i < 16; i++) {
+			transparent[i] = bc1 && (pixels[i][3] < 128);
+			if (!transparent[i]) {
+				memcpy(opaque[count], pixels[i], sizeof(opaque[count]));
+				opaque_index[count++] = i;
+			}
+		}
+		if (count == 0) {
+			// 3 color mode (c0 <= c1), all pixels at index 3
+			memset(block, 0, 4);
+			memset(block + 4, 0xFF, 4);
+			return;
+		}
+
+		float e0[4], e1[4];
+		FitEndpoints<3>(opaque, count, quality != BCQuality::Fast, e0, e1);
+
+		// transparent pixels need the 3 color mode, which sometimes fits opaque blocks better
+		bool modes[2] = { count == 16, (count < 16) || (bc1 && (quality == BCQuality::Best)) };
+
+		ColorCandidate best;
+		best.error = FLT_MAX;
+		const unsigned iterations = GetIterations(quality);
+		for (unsigned mode = 0; mode < 2; mode++) {
+			if (!modes[mode]) {
+				continue;
+			}
+			const bool three_colors = (mode == 1);
+			float a[4], b[4];
+			memcpy(a, e0, sizeof(a));
+			memcpy(b, e1, sizeof(b));
+			float previous = FLT_MAX;
+			for (unsigned iteration = 0; iteration < iterations; iteration++) {
+				ColorCandidate candidate;
+				EvaluateColorEndpoints(pixels, transparent, bc1, three_colors, Quantize565(a), Quantize565(b), &candidate);
+				if (candidate.error < best.error) {
+					best = candidate;
+				}
+				if ((candidate.error >= previous) || (iteration + 1 == iterations)) {
+					break;
+				}
+				previous = candidate.error;
+
+				// refine the endpoints (in the candidate order) for the chosen indices
+				static const float weights4[4] = { 0.0f, 1.0f, 1.0f / 3, 2.0f / 3 };
+				static const float weights3[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+				float weights[16];
+				for (unsigned i = 0; i < count; i++) {
+					const unsigned index = candidate.indices[opaque_index[i]];
+					weights[i] = candidate.fourColors ? weights4[index] : weights3[index];
+				}
+				if (!LeastSquaresEndpoints<3>(opaque, weights, count, a, b)) {
+					break;
+				}
+			}
+		}
+
+		block[0] = (uint8_t)(best.c0 & 0xFF);
+		block[1] = (uint8_t)(best.c0 >> 8);
+		block[2] = (uint8_t)(best.c1 & 0xFF);
+		block[3] = (uint8_t)(best.c1 >> 8);
+		for (unsigned y = 0; y < 4; y++) {
+			unsigned row = 0;
+			for (unsigned x = 0; x < 4; x++) {
+				row |= best.indices[4 * y + x] << (2 * x);
+			}
+			block[4 + y] = (uint8_t)row;
+		}
+	}
+
+	// ----------------------------------------------------------
+	//   BC3 alpha blocks
+	// ----------------------------------------------------------
+
+	/**
+	Alpha values of two endpoints, computed as the decoder does
+	*/
+	void GetAlphaPalette(unsigned a0, unsigned a1, int palette[8]) {
+		palette[0] = (int)a0;
+		palette[1] = (int)a1;
+		if (a0 > a1) {
+			for (unsigned i = 0; i < 6; i++) {
+				palette[i + 2] = (int)(((6 - i) * a0 + (1 + i) * a1 + 3) / 7);
+			}
+		} else {
+			for (unsigned i = 0; i < 4; i++) {
+				palette[i + 2] = (int)(((4 - i) * a0 + (1 + i) * a1 + 2) / 5);
+			}
+			palette[6] = 0;
+			palette[7] = 0xFF;
+		}
+	}
+
+	float AssignAlphaIndices(const BlockPixels pixels, unsigned a0, unsigned a1, uint64_t *bits) {
+		int palette[8];
+		GetAlphaPalette(a0, a1, palette);
+		float total = 0;
+		*bits = 0;
+		for (unsigned i = 0; i < 16; i++) {
+			const int alpha = (int)pixels[i][3];
+			unsigned nearest = 0;
+			int best = INT_MAX;
+			for (unsigned index = 0; index < 8; index++) {
+				const int error = std::abs(alpha - palette[index]);
+				if (error < best) {
+					best = error;
+					nearest = index;
+				}
+			}
+			total += (float)(best * best);
+			*bits |= (uint64_t)nearest << (3 * i);
+		}
+		return total;
+	}
+
+	void EncodeAlphaBlock(const BlockPixels pixels, BCQuality quality, uint8_t *block) {
+		unsigned lo = 255, hi = 0;
+		unsigned inner_lo = 255, inner_hi = 0;
+		for (unsigned i = 0; i < 16; i++) {
+			const unsigned alpha = (unsigned)pixels[i][3];
+			lo = std::min(lo, alpha);
+			hi = std::max(hi, alpha);
+			if ((alpha != 0) && (alpha != 255)) {
+				inner_lo = std::min(inner_lo, alpha);
+				inner_hi = std::max(inner_hi, alpha);
+			}
+		}
+
+		// 8 values between the extremes
+		unsigned a0 = hi, a1 = lo;
+		uint64_t bits;
+		float error = AssignAlphaIndices(pixels, a0, a1, &bits);
+
+		// 6 values between the extremes other than 0 and 255, which are exact
+		if ((quality == BCQuality::Best) && (inner_lo <= inner_hi) && ((lo == 0) || (hi == 255))) {
+			uint64_t inner_bits;
+			const float inner_error = AssignAlphaIndices(pixels, inner_lo, inner_hi, &inner_bits);
+			if (inner_error < error) {
+				a0 = inner_lo;
+				a1 = inner_hi;
+				bits = inner_bits;
+			}
+		}
+
+		block[0] = (uint8_t)a0;
+		block[1] = (uint8_t)a1;
+		for (unsigned i = 0; i < 6; i++) {
+			block[2 + i] = (uint8_t)(bits >> (8 * i));
+		}
+	}
+
+	// ----------------------------------------------------------
+	//   BC7 mode 6 blocks
+	// ----------------------------------------------------------
+
+	const int kBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	/**
+	Little endian bit stream writer of a 128-bit block
+	*/
+	class BlockBitsWriter {
+	public:
+		explicit BlockBitsWriter(uint8_t *block) : mBlock(block) {
+			memset(mBlock, 0, 16);
+		}
+
+		void Write(unsigned value, unsigned count) {
+			for (unsigned i = 0; i < count; i++, mPosition++) {
+				mBlock[mPosition / 8] |= (uint8_t)(((value >> i) & 1) << (mPosition % 8));
+			}
+		}
+
+	private:
+		uint8_t *mBlock;
+		unsigned mPosition{};
+	};
+
+	struct BC7Candidate {
+		unsigned q[2][4];	//! 7-bit endpoints
+		unsigned p[2];		//! p-bits
+		unsigned indices[16];
+		float error;
+	};
+
+	/**
+	7-bit endpoint closest to e with the p-bit p
+	*/
+	void QuantizeBC7Endpoint(const float e[4], unsigned p, unsigned q[4]) {
+		for (unsigned c = 0; c < 4; c++) {
+			q[c] = (unsigned)std::min(127.0f, std::max(0.0f, std::floor((e[c] - (float)p) / 2 + 0.5f)));
+		}
+	}
+
+	float BC7EndpointError(const float e[4], unsigned p) {
+		unsigned q[4];
+		QuantizeBC7Endpoint(e, p, q);
+		float error = 0;
+		for (unsigned c = 0; c < 4; c++) {
+			const float d = e[c] - (float)((q[c] << 1) | p);
+			error += d * d;
+		}
+		return error;
+	}
+
+	void EvaluateBC7Endpoints(const BlockPixels pixels, const float e0[4], unsigned p0, const float e1[4], unsigned p1, BC7Candidate *candidate) {
+		QuantizeBC7Endpoint(e0, p0, candidate->q[0]);
+		QuantizeBC7Endpoint(e1, p1, candidate->q[1]);
+		candidate->p[0] = p0;
+		candidate->p[1] = p1;
+
+		int palette[16][4];
+		for (unsigned c = 0; c < 4; c++) {
+			const int v0 = (int)((candidate->q[0][c] << 1) | p0);
+			const int v1 = (int)((candidate->q[1][c] << 1) | p1);
+			for (unsigned index = 0; index < 16; index++) {
+				palette[index][c] = ((64 - kBC7Weights[index]) * v0 + kBC7Weights[index] * v1 + 32) >> 6;
+			}
+		}
+
+		candidate->error = 0;
+		for (unsigned i = 0; i < 16; i++) {
+			float best = FLT_MAX;
+			for (unsigned index = 0; index < 16; index++) {
+				float error = 0;
+				for (unsigned c = 0; c < 4; c++) {
+					const float d = pixels[i][c] - (float)palette[index][c];
+					error += d * d;
+				}
+				if (error < best) {
+					best = error;
+					candidate->indices[i] = index;
+				}
+			}
+			candidate->error += best;
+		}
+	}
+
+	void EncodeBC7Block(const BlockPixels pixels, BCQuality quality, uint8_t *block) {
+		float e0[4], e1[4];
+		FitEndpoints<4>(pixels, 16, quality != BCQuality::Fast, e0, e1);
+
+		BC7Candidate best;
+		best.error = FLT_MAX;
+		const unsigned iterations = GetIterations(quality);
+		float previous = FLT_MAX;
+		for (unsigned iteration = 0; iteration < iterations; iteration++) {
+			BC7Candidate candidate;
+			if (quality == BCQuality::Best) {
+				// all the p-bits combinations
+				candidate.error = FLT_MAX;
+				for (unsigned p = 0; p < 4; p++) {
+					BC7Candidate pbits;
+					EvaluateBC7Endpoints(pixels, e0, p & 1, e1, p >> 1, &pbits);
+					if (pbits.error < candidate.error) {
+						candidate = pbits;
+					}
+				}
+			} else {
+				// p-bits closest to each endpoint
+				const unsigned p0 = (BC7EndpointError(e0, 1) < BC7EndpointError(e0, 0)) ? 1 : 0;
+				const unsigned p1 = (BC7EndpointError(e1, 1) < BC7EndpointError(e1, 0)) ? 1 : 0;
+				EvaluateBC7Endpoints(pixels, e0, p0, e1, p1, &candidate);
+			}
+			if (candidate.error < best.error) {
+				best = candidate;
+			}
+			if ((candidate.error >= previous) || (iteration + 1 == iterations)) {
+				break;
+			}
+			previous = candidate.error;
+
+			float weights[16];
+			for (unsigned i = 0; i < 16; i++) {
+				weights[i] = (float)kBC7Weights[candidate.indices[i]] / 64;
+			}
+			if (!LeastSquaresEndpoints<4>(pixels, weights, 16, e0, e1)) {
+				break;
+			}
+		}
+
+		// the anchor (first) index has an implicit 0 most significant bit: swap the endpoints if needed
+		if (best.indices[0] & 8) {
+			for (unsigned c = 0; c < 4; c++) {
+				std::swap(best.q[0][c], best.q[1][c]);
+			}
+			std::swap(best.p[0], best.p[1]);
+			for (unsigned i = 0; i < 16; i++) {
+				best.indices[i] = 15 - best.indices[i];
+			}
+		}
+
+		BlockBitsWriter bits(block);
+		bits.Write(1 << 6, 7);
+		for (unsigned c = 0; c < 4; c++) {
+			bits.Write(best.q[0][c], 7);
+			bits.Write(best.q[1][c], 7);
+		}
+		bits.Write(best.p[0], 1);
+		bits.Write(best.p[1], 1);
+		bits.Write(best.indices[0], 3);
+		for (unsigned i = 1; i < 16; i++) {
+			bits.Write(best.indices[i], 4);
+		}
+	}
+
+} // namespace
+
+// ----------------------------------------------------------
+
+bool IsBCEncodable(BCFormat format) {
+	return (format == BCFormat::BC1) || (format == BCFormat::BC3) || (format == BCFormat::BC7);
+}
+
+void EncodeBCBlockRow(BCFormat format, BCQuality quality, const uint8_t *src, size_t src_pitch, unsigned count, uint8_t *blocks) {
+	const unsigned block_size = GetBCBlockSize(format);
+	for (unsigned i = 0; i < count; i++, src += 16, blocks += block_size) {
+		BlockPixels pixels;
+		LoadBlock(src, src_pitch, pixels);
+		switch (format) {
+			case BCFormat::BC1:
+				EncodeColorBlock(pixels, true, quality, blocks);
+				break;
+			case BCFormat::BC3:
+				EncodeAlphaBlock(pixels, quality, blocks);
+				EncodeColorBlock(pixels, false, quality, blocks + 8);
+				break;
+			case BCFormat::BC7:
+				EncodeBC7Block(pixels, quality, blocks);
+				break;
+			default:
+				memset(blocks, 0, block_size);
+				break;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_DDSBLOCKENCODER_H
+#define FREEIMAGE_DDSBLOCKENCODER_H
+
+#include "DDSBlockDecoder.h"
+
+/**
+Speed / quality trade-off of the block encoders
+*/
+enum class BCQuality {
+	Fast,	//! bounding box endpoints
+	Normal,	//! principal axis endpoints, refined once by least squares
+	Best	//! principal axis endpoints, refined until the error stops decreasing, more modes tried
+};
+
+/**
+True if the format can be encoded (BC1, BC3 and BC7)
+*/
+bool IsBCEncodable(BCFormat format);
+
+/**
+Encodes 4 rows of pixels into a row of blocks.
+Pixels are 32-bit, bytes in the FreeImage channel order (see FI_RGBA_RED). BC1 blocks with transparent pixels
+(alpha < 128) use the 3 colors + transparent black mode, BC7 blocks use mode 6 (one subset, RGBA endpoints).
+@param format Blocks format, see IsBCEncodable
+@param quality Speed / quality trade-off
+@param src First row of 4 * count pixels
+@param src_pitch Distance between two rows in bytes
+@param count Number of blocks
+@param blocks Compressed blocks (count * GetBCBlockSize(format) bytes)
+*/
+void EncodeBCBlockRow(BCFormat format, BCQuality quality, const uint8_t *src, size_t src_pitch, unsigned count, uint8_t *blocks);
+
+#endif // FREEIMAGE_DDSBLOCKENCODER_H
@@ -0,0 +1,493 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "FaxDecoder.h"
+#include "FreeImage.h"
+#include "Utilities.h"
+
+namespace {
+
+	// ----------------------------------------------------------
+	//   Codes of T.4 (ITU-T Recommendation T.4, tables 1 to 4)
+	// ----------------------------------------------------------
+
+	struct FaxCodeDef {
+		uint16_t value;		// run length or 2D mode
+		uint8_t length;		// in bits
+		uint16_t code;
+	};
+
+	const FaxCodeDef kWhiteCodes[] = {
+		// terminating codes
+		{ 0, 8, 0b00110101 }, { 1, 6, 0b000111 }, { 2, 4, 0b0111 }, { 3, 4, 0b1000 },
+		{ 4, 4, 0b1011 }, { 5, 4, 0b1100 }, { 6, 4, 0b1110 }, { 7, 4, 0b1111 },
+		{ 8, 5, 0b10011 }, { 9, 5, 0b10100 }, { 10, 5, 0b00111 }, { 11, 5, 0b01000 },
+		{ 12, 6, 0b001000 }, { 13, 6, 0b000011 }, { 14, 6, 0b110100 }, { 15, 6, 0b110101 },
+		{ 16, 6, 0b101010 }, { 17, 6, 0b101011 }, { 18, 7, 0b0100111 }, { 19, 7, 0b0001100 },
+		{ 20, 7, 0b0001000 }, { 21, 7, 0b0010111 }, { 22, 7, 0b0000011 }, { 23, 7, 0b0000100 },
+		{ 24, 7, 0b0101000 }, { 25, 7, 0b0101011 }, { 26, 7, 0b0010011 }, { 27, 7, 0b0100100 },
+		{ 28, 7, 0b0011000 }, { 29, 8, 0b00000010 }, { 30, 8, 0b00000011 }, { 31, 8, 0b00011010 },
+		{ 32, 8, 0b00011011 }, { 33, 8, 0b00010010 }, { 34, 8, 0b00010011 }, { 35, 8, 0b00010100 },
+		{ 36, 8, 0b00010101 }, { 37, 8, 0b00010110 }, { 38, 8, 0b00010111 }, { 39, 8, 0b00101000 },
+		{ 40, 8, 0b00101001 }, { 41, 8, 0b00101010 }, { 42, 8, 0b00101011 }, { 43, 8, 0b00101100 },
+		{ 44, 8, 0b00101101 }, { 45, 8, 0b00000100 }, { 46, 8, 0b00000101 }, { 47, 8, 0b00001010 },
+		{ 48, 8, 0b00001011 }, { 49, 8, 0b01010010 }, { 50, 8, 0b01010011 }, { 51, 8, 0b01010100 },
+		{ 52, 8, 0b01010101 }, { 53, 8, 0b00100100 }, { 54, 8, 0b00100101 }, { 55, 8, 0b01011000 },
+		{ 56, 8, 0b01011001 }, { 57, 8, 0b01011010 }, { 58, 8, 0b01011011 }, { 59, 8, 0b01001010 },
+		{ 60, 8, 0b01001011 }, { 61, 8, 0b00110010 }, { 62, 8, 0b00110011 }, { 63, 8, 0b00110100 },
+		// make-up codes
+		{ 64, 5, 0b11011 }, { 128, 5, 0b10010 }, { 192, 6, 0b010111 }, { 256, 7, 0b0110111 },
+		{ 320, 8, 0b00110110 }, { 384, 8, 0b00110111 }, { 448, 8, 0b01100100 }, { 512, 8, 0b01100101 },
+		{ 576, 8, 0b01101000 }, { 640, 8, 0b01100111 }, { 704, 9, 0b011001100 }, { 768, 9, 0b011001101 },
+		{ 832, 9, 0b011010010 }, { 896, 9, 0b011010011 }, { 960, 9, 0b011010100 }, { 1024, 9, 0b011010101 },
+		{ 1088, 9, 0b011010110 }, { 1152, 9, 0b011010111 }, { 1216, 9, 0b011011000 }, { 1280, 9, 0b011011001 },
+		{ 1344, 9, 0b011011010 }, { 1408, 9, 0b011011011 }, { 1472, 9, 0b010011000 }, { 1536, 9, 0b010011001 },
+		{ 1600, 9, 0b010011010 }, { 1664, 6, 0b011000 }, { 1728, 9, 0b010011011 }
+	};
+
+	const FaxCodeDef kBlackCodes[] = {
+		// terminating codes
+		{ 0, 10, 0b0000110111 }, { 1, 3, 0b010 }, { 2, 2, 0b11 }, { 3, 2, 0b10 },
+		{ 4, 3, 0b011 }, { 5, 4, 0b0011 }, { 6, 4, 0b0010 }, { 7, 5, 0b00011 },
+		{ 8, 6, 0b000101 }, { 9, 6, 0b000100 }, { 10, 7, 0b0000100 }, { 11, 7, 0b0000101 },
+		{ 12, 7, 0b0000111 }, { 13, 8, 0b00000100 }, { 14, 8, 0b00000111 }, { 15, 9, 0b000011000 },
+		{ 16, 10, 0b0000010111 }, { 17, 10, 0b0000011000 }, { 18, 10, 0b0000001000 }, { 19, 11, 0b00001100111 },
+		{ 20, 11, 0b00001101000 }, { 21, 11, 0b00001101100 }, { 22, 11, 0b00000110111 }, { 23, 11, 0b00000101000 },
+		{ 24, 11, 0b00000010111 }, { 25, 11, 0b00000011000 }, { 26, 12, 0b000011001010 }, { 27, 12, 0b000011001011 },
+		{ 28, 12, 0b000011001100 }, { 29, 12, 0b000011001101 }, { 30, 12, 0b000001101000 }, { 31, 12, 0b000001101001 },
+		{ 32, 12, 0b000001101010 }, { 33, 12, 0b000001101011 }, { 34, 12, 0b000011010010 }, { 35, 12, 0b000011010011 },
+		{ 36, 12, 0b000011010100 }, { 37, 12, 0b000011010101 }, { 38, 12, 0b000011010110 }, { 39, 12, 0b000011010111 },
+		{ 40, 12, 0b000001101100 }, { 41, 12, 0b000001101101 }, { 42, 12, 0b000011011010 }, { 43, 12, 0b000011011011 },
+		{ 44, 12, 0b000001010100 }, { 45, 12, 0b000001010101 }, { 46, 12, 0b000001010110 }, { 47, 12, 0b000001010111 },
+		{ 48, 12, 0b000001100100 }, { 49, 12, 0b000001100101 }, { 50, 12, 0b000001010010 }, { 51, 12, 0b000001010011 },
+		{ 52, 12, 0b000000100100 }, { 53, 12, 0b000000110111 }, { 54, 12, 0b000000111000 }, { 55, 12, 0b000000100111 },
+		{ 56, 12, 0b000000101000 }, { 57, 12, 0b000001011000 }, { 58, 12, 0b000001011001 }, { 59, 12, 0b000000101011 },
+		{ 60, 12, 0b000000101100 }, { 61, 12, 0b000001011010 }, { 62, 12, 0b000001100110 }, { 63, 12, 0b000001100111 },
+		// make-up codes
+		{ 64, 10, 0b0000001111 }, { 128, 12, 0b000011001000 }, { 192, 12, 0b000011001001 }, { 256, 12, 0b000001011011 },
+		{ 320, 12, 0b000000110011 }, { 384, 12, 0b000000110100 }, { 448, 12, 0b000000110101 }, { 512, 13, 0b0000001101100 },
+		{ 576, 13, 0b0000001101101 }, { 640, 13, 0b0000001001010 }, { 704, 13, 0b0000001001011 }, { 768, 13, 0b0000001001100 },
+		{ 832, 13, 0b0000001001101 }, { 896, 13, 0b0000001110010 }, { 960, 13, 0b0000001110011 }, { 1024, 13, 0b0000001110100 },
+		{ 1088, 13, 0b0000001110101 }, { 1152, 13, 0b0000001110110 }, { 1216, 13, 0b0000001110111 }, { 1280, 13, 0b0000001010010 },
+		{ 1344, 13, 0b0000001010011 }, { 1408, 13, 0b0000001010100 }, { 1472, 13, 0b0000001010101 }, { 1536, 13, 0b0000001011010 },
+		{ 1600, 13, 0b0000001011011 }, { 1664, 13, 0b0000001100100 }, { 1728, 13, 0b0000001100101 }
+	};
+
+	// make-up codes shared by white and black runs
+	const FaxCodeDef kExtendedCodes[] = {
+		{ 1792, 11, 0b00000001000 }, { 1856, 11, 0b00000001100 }, { 1920, 11, 0b00000001101 }, { 1984, 12, 0b000000010010 },
+		{ 2048, 12, 0b000000010011 }, { 2112, 12, 0b000000010100 }, { 2176, 12, 0b000000010101 }, { 2240, 12, 0b000000010110 },
+		{ 2304, 12, 0b000000010111 }, { 2368, 12, 0b000000011100 }, { 2432, 12, 0b000000011101 }, { 2496, 12, 0b000000011110 },
+		{ 2560, 12, 0b000000011111 }
+	};
+
+	enum FaxMode : uint16_t {
+		MODE_PASS, MODE_HORIZONTAL, MODE_V0, MODE_VR1, MODE_VR2, MODE_VR3, MODE_VL1, MODE_VL2, MODE_VL3
+	};
+
+	const FaxCodeDef kModeCodes[] = {
+		{ MODE_PASS, 4, 0b0001 }, { MODE_HORIZONTAL, 3, 0b001 }, { MODE_V0, 1, 0b1 },
+		{ MODE_VR1, 3, 0b011 }, { MODE_VR2, 6, 0b000011 }, { MODE_VR3, 7, 0b0000011 },
+		{ MODE_VL1, 3, 0b010 }, { MODE_VL2, 6, 0b000010 }, { MODE_VL3, 7, 0b0000010 }
+	};
+
+	// longest codes in bits, the lookup tables are indexed by as many next bits
+	const unsigned kWhiteBits = 12;
+	const unsigned kBlackBits = 13;
+	const unsigned kModeBits = 7;
+
+	/**
+	Entry of a lookup table, a zero length marks an invalid code (including EOL and the 2D extensions)
+	*/
+	struct FaxCode {
+		uint16_t value;
+		uint8_t length;
+	};
+
+	struct FaxTables {
+		FaxCode white[1 << kWhiteBits]{};
+		FaxCode black[1 << kBlackBits]{};
+		FaxCode mode[1 << kModeBits]{};
+
+		FaxTables() {
+			for (const auto& def : kWhiteCodes) {
+				Add(white, kWhiteBits, def);
+			}
+			for (const auto& def : kBlackCodes) {
+				Add(black, kBlackBits, def);
+			}
+			for (const auto& def : kExtendedCodes) {
+				Add(white, kWhiteBits, def);
+				Add(black, kBlackBits, def);
+			}
+			for (const auto& def : kModeCodes) {
+				Add(mode, kModeBits, def);
+			}
+		}
+
+		/**
+		Fills the entries of all the indices starting with the code
+		*/
+		static void Add(FaxCode *table, unsigned bits, const FaxCodeDef& def) {
+			const unsigned first = (unsigned)def.code << (bits - def.length);
+			const unsigned last = first + (1U << (bits - def.length));
+			for (unsigned i = first; i < last; i++) {
+				table[i] = { def.value, def.length };
+			}
+		}
+	};
+
+	const FaxTables kFaxTables;
+
+	/**
+	Sets the bits [first, last) of a row to 1
+	*/
+	inline void FillBlack(uint8_t *row, unsigned first, unsigned last) {
+		if (first >= last) {
+			return;
+		}
+		const unsigned i = first >> 3;
+		const unsigned j = last >> 3;
+		const uint8_t head = (uint8_t)(0xFF >> (first & 7));
+		const uint8_t tail = (uint8_t)(0xFF00 >> (last & 7));
+		if (i == j) {
+			row[i] |= head & tail;
+			return;
+		}
+		row[i] |= head;
+		memset(row + i + 1, 0xFF, j - i - 1);
+		if (last & 7) {
+			row[j] |= tail;
+		}
+	}
+
+} // namespace
+
+// ----------------------------------------------------------
+
+FaxDecoder::FaxDecoder(const uint8_t *data, size_t size, unsigned width, FaxCoding coding, bool lsb_first)
+	: m_in{ data, data + size, 0, 0, 0, (uint64_t)size * 8, lsb_first }
+	, m_width(width)
+	, m_coding(coding)
+	, m_ref(width + 4)
+	, m_cur(width + 4) {
+	// the reference row of the first row is white
+	m_ref[0] = m_ref[1] = m_width;
+}
+
+inline void FaxDecoder::BitReader::Refill() {
+	if (count > 56) {
+		return;
+	}
+	if (end - next >= 8) {
+		// load 8 bytes at once, the bits past the whole bytes added are loaded again by the next refill
+		uint64_t word;
+		memcpy(&word, next, sizeof(word));
+#ifndef FREEIMAGE_BIGENDIAN
+		SwapInt64(&word);
+#endif
+		if (lsb_first) {
+			// reverse the bits of each byte
+			word = ((word >> 1) & 0x5555555555555555ULL) | ((word & 0x5555555555555555ULL) << 1);
+			word = ((word >> 2) & 0x3333333333333333ULL) | ((word & 0x3333333333333333ULL) << 2);
+			word = ((word >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((word & 0x0F0F0F0F0F0F0F0FULL) << 4);
+		}
+		bits |= word >> count;
+		const unsigned bytes = (63 - count) >> 3;
+		next += bytes;
+		count += bytes * 8;
+		return;
+	}
+	RefillTail();
+}
+
+/**
+Refills the bits from the last bytes, then with zeros
+*/
+void FaxDecoder::BitReader::RefillTail() {
+	while (count <= 56) {
+		unsigned byte = 0;
+		if (next < end) {
+			byte = *next++;
+			if (lsb_first) {
+				byte = ((byte * 0x0802U & 0x22110U) | (byte * 0x8020U & 0x88440U)) * 0x10101U >> 16;
+			}
+		}
+		// past the end, zeros are loaded
+		bits |= (uint64_t)(byte & 0xFF) << (56 - count);
+		count += 8;
+	}
+}
+
+inline void FaxDecoder::BitReader::Skip(unsigned n) {
+	bits <<= n;
+	count -= n;
+	consumed += n;
+}
+
+inline bool FaxDecoder::BitReader::Exhausted() const {
+	return consumed >= total;
+}
+
+/**
+Skips the bits up to the next EOL (at least 11 zeros followed by a 1) included
+@return Returns false if there is no EOL before the end of the data
+*/
+bool FaxDecoder::BitReader::SkipToEOL() {
+	unsigned zeros = 0;
+	for (;;) {
+		Refill();
+		if (Exhausted()) {
+			return false;
+		}
+		if (!bits) {
+			zeros += 32;
+			Skip(32);
+			continue;
+		}
+		unsigned n = 0;
+		while (!(bits >> 63)) {
+			Skip(1);
+			n++;
+		}
+		Skip(1);
+		if (zeros + n >= 11) {
+			return consumed <= total;
+		}
+		zeros = 0;
+	}
+}
+
+/**
+Decodes the make-up and terminating codes of a run
+@return Returns the run length, or -1 on an invalid code
+*/
+inline int FaxDecoder::BitReader::DecodeRun(bool black) {
+	const FaxTables& tables = kFaxTables;
+	int run = 0;
+	for (;;) {
+		Refill();
+		const FaxCode code = black ? tables.black[bits >> (64 - kBlackBits)] : tables.white[bits >> (64 - kWhiteBits)];
+		if (!code.length) {
+			return -1;
+		}
+		Skip(code.length);
+		run += code.value;
+		if (code.value < 64) {
+			return run;
+		}
+	}
+}
+
+/**
+Decodes a row of alternate white and black runs into m_cur
+*/
+bool FaxDecoder::Decode1D() {
+	BitReader in = m_in;
+	const unsigned width = m_width;
+	unsigned *cur = m_cur.data();
+	unsigned count = 0;
+	unsigned a0 = 0;
+	bool black = false;
+	while (a0 < width) {
+		const int run = in.DecodeRun(black);
+		if ((run < 0) || (count > width)) {
+			m_in = in;
+			return false;
+		}
+		// a row too long is clamped, as libtiff does
+		a0 = std::min(a0 + (unsigned)run, width);
+		cur[count++] = a0;
+		black = !black;
+	}
+	m_in = in;
+	m_cur_count = count;
+	return true;
+}
+
+/**
+Decodes a row coded relatively to m_ref into m_cur
+*/
+bool FaxDecoder::Decode2D() {
+	const FaxTables& tables = kFaxTables;
+	BitReader in = m_in;
+	const unsigned width = m_width;
+	const unsigned *ref = m_ref.data();
+	unsigned *cur = m_cur.data();
+	unsigned count = 0;
+
+	// adds a changing element, two changes at the same position cancel each other
+	auto addChange = [&](unsigned a) {
+		a = std::min(a, width);
+		if (count && (cur[count - 1] == a)) {
+			count--;
+		} else {
+			cur[count++] = a;
+		}
+	};
+
+	int a0 = -1;		// the imaginary changing element before the row
+	unsigned color = 0;	// color of the pixels from a0: 0 white, 1 black
+	unsigned bi = 0;	// index of b1 in ref
+	bool valid = true;
+
+	while (valid && (a0 < (int)width)) {
+		// b1 is the first changing element of ref right of a0 to the color opposite to the one of a0,
+		// even elements of ref change to black, odd ones to white
+		if (bi) {
+			bi--;
+		}
+		bi += (bi & 1) ^ color;
+		while ((int)ref[bi] <= a0) {
+			bi += 2;
+		}
+		const unsigned b1 = ref[bi];
+		const unsigned b2 = ref[bi + 1];
+
+		in.Refill();
+		const FaxCode code = tables.mode[in.bits >> (64 - kModeBits)];
+		if (!code.length) {
+			valid = false;
+			break;
+		}
+		in.Skip(code.length);
+
+		switch (code.value) {
+			case MODE_PASS:
+				a0 = (int)b2;
+				break;
+
+			case MODE_HORIZONTAL:
+			{
+				const int run1 = in.DecodeRun(color != 0);
+				const int run2 = (run1 < 0) ? -1 : in.DecodeRun(color == 0);
+				if (run2 < 0) {
+					valid = false;
+					break;
+				}
+				const unsigned a1 = (unsigned)std::max(a0, 0) + (unsigned)run1;
+				addChange(a1);
+				addChange(a1 + (unsigned)run2);
+				a0 = (int)std::min(a1 + (unsigned)run2, width);
+				break;
+			}
+
+			default:
+			{
+				// vertical modes, a1 is b1 + (-3..3)
+				static const int kOffsets[] = { 0, 1, 2, 3, -1, -2, -3 };
+				const int a1 = (int)b1 + kOffsets[code.value - MODE_V0];
+				if ((a1 < 0) || (a1 < a0) || (a1 > (int)width)) {
+					valid = false;
+					break;
+				}
+				addChange((unsigned)a1);
+				a0 = a1;
+				color ^= 1;
+				break;
+			}
+		}
+	}
+	m_in = in;
+	m_cur_count = count;
+	return valid;
+}
+
+FaxDecoder::Status FaxDecoder::DecodeRow(uint8_t *row) {
+	if (m_done) {
+		return Status::eEnd;
+	}
+
+	bool two_d = (m_coding == FaxCoding::G4);
+
+	switch (m_coding) {
+		case FaxCoding::RLE:
+			if (m_in.consumed & 7) {
+				m_in.Refill();
+				m_in.Skip(8 - (unsigned)(m_in.consumed & 7));
+			}
+			if (m_in.Exhausted()) {
+				m_done = true;
+				return Status::eEnd;
+			}
+			break;
+
+		case FaxCoding::G4:
+			m_in.Refill();
+			// EOFB is two EOL
+			if (m_in.Exhausted() || ((m_in.bits >> (64 - 12)) == 1)) {
+				m_done = true;
+				return Status::eEnd;
+			}
+			break;
+
+		case FaxCoding::G3_1D:
+		case FaxCoding::G3_2D:
+		{
+			if (m_resync) {
+				if (!m_in.SkipToEOL()) {
+					m_done = true;
+					return Status::eEnd;
+				}
+				m_resync = false;
+				if (m_coding == FaxCoding::G3_2D) {
+					m_in.Refill();
+					two_d = !(m_in.bits >> 63);
+					m_in.Skip(1);
+				}
+			}
+			// skip the fill bits and EOL, RTC is 6 EOL
+			unsigned eols = 0;
+			for (;;) {
+				m_in.Refill();
+				if (m_in.Exhausted()) {
+					m_done = true;
+					return Status::eEnd;
+				}
+				if (m_in.bits >> (64 - 11)) {
+					break;
+				}
+				if (!m_in.SkipToEOL()) {
+					m_done = true;
+					return Status::eEnd;
+				}
+				eols++;
+				if (m_coding == FaxCoding::G3_2D) {
+					m_in.Refill();
+					two_d = !(m_in.bits >> 63);
+					m_in.Skip(1);
+				}
+			}
+			if (eols > 1) {
+				m_done = true;
+				return Status::eEnd;
+			}
+			break;
+		}
+	}
+
+	if (!(two_d ? Decode2D() : Decode1D())) {
+		if ((m_coding == FaxCoding::G3_1D) || (m_coding == FaxCoding::G3_2D)) {
+			m_resync = true;
+		} else {
+			m_done = true;
+		}
+		return Status::eError;
+	}
+
+	// render the runs, even elements start black runs and odd ones end them
+	const unsigned *cur = m_cur.data();
+	const unsigned count = m_cur_count;
+	memset(row, 0, (m_width + 7) / 8);
+	for (unsigned i = 0; i < count; i += 2) {
+		FillBlack(row, cur[i], (i + 1 < count) ? cur[i + 1] : m_width);
+	}
+
+	// the row is the reference of the next one
+	m_ref.swap(m_cur);
+	m_ref[count] = m_ref[count + 1] = m_width;
+	return Status::eRow;
+}
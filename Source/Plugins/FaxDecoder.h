@@ -0,0 +1,88 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_FAXDECODER_H
+#define FREEIMAGE_FAXDECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+CCITT codings of bilevel fax images
+*/
+enum class FaxCoding {
+	RLE,	//! TIFF CCITT RLE (compression 2): 1D rows without EOL, each starting on a byte boundary
+	G3_1D,	//! T.4 Modified Huffman: 1D rows, each starting with an EOL
+	G3_2D,	//! T.4 Modified READ: 1D or 2D rows, each starting with an EOL followed by a 1D/2D tag bit
+	G4		//! T.6 Modified Modified READ: 2D rows without EOL
+};
+
+/**
+Decoder of CCITT Group 3 and Group 4 data into packed 1-bit rows, most significant bit first,
+with black pixels as 1 bits (as libtiff and the MINISWHITE photometric do).
+Codes are looked up in tables indexed by the next bits of a 64-bit bit buffer refilled a word at a time,
+rows are kept as lists of changing elements and filled a byte at a time.
+*/
+class FaxDecoder {
+public:
+	enum class Status {
+		eRow,	//! a row was decoded
+		eError,	//! the row is corrupted and was not written
+		eEnd	//! no more rows (end of data, RTC or EOFB)
+	};
+
+	/**
+	@param data Coded data, must outlive the decoder
+	@param size Size of data in bytes
+	@param width Number of pixels of a row
+	@param coding Coding of the rows
+	@param lsb_first True when the bits of a byte are stored from the least significant one (TIFF FillOrder 2)
+	*/
+	FaxDecoder(const uint8_t *data, size_t size, unsigned width, FaxCoding coding, bool lsb_first);
+
+	/**
+	Decodes the next row into row, (width + 7) / 8 bytes.
+	After an error, G3 data resume at the next EOL, RLE and G4 data can't be resynchronized and end.
+	*/
+	Status DecodeRow(uint8_t *row);
+
+private:
+	/**
+	Reader of the bits of the data, most significant bit first. 
+	Decoding functions work on a local copy, so that the row writes can't alias it.
+	*/
+	struct BitReader {
+		const uint8_t *next;
+		const uint8_t *end;
+		uint64_t bits;			// next bits of the data, from the most significant one
+		unsigned count;			// number of valid bits in bits
+		uint64_t consumed;		// bits consumed
+		uint64_t total;			// bits of the data
+		bool lsb_first;
+
+		void Refill();
+		void RefillTail();
+		void Skip(unsigned n);
+		bool Exhausted() const;
+		bool SkipToEOL();
+		int DecodeRun(bool black);
+	};
+
+	bool Decode1D();
+	bool Decode2D();
+
+	BitReader m_in;
+	unsigned m_width;
+	FaxCoding m_coding;
+	bool m_resync{};			// an error occured, skip to the next EOL
+	bool m_done{};
+	std::vector<unsigned> m_ref;	// changing elements of the reference row, followed by width, width
+	std::vector<unsigned> m_cur;	// changing elements of the decoded row
+	unsigned m_cur_count{};
+};
+
+#endif // FREEIMAGE_FAXDECODER_H
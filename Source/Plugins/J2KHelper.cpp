@@ -23,6 +23,7 @@
 #include "Utilities.h"
 #include "openjp2/openjpeg.h"
 #include "J2KHelper.h"
+#include "FreeImage/ThreadPool.h"
 
 // --------------------------------------------------------------------------
 
@@ -109,14 +110,56 @@ opj_freeimage_stream_destroy(J2KFIO_t* fio) {
 
 // --------------------------------------------------------------------------
 
-/**
-Divide an integer by a power of 2 and round upwards
-@return Returns a divided by 2^b
-*/
-static int int_ceildivpow2(int a, int b) {
-	return (a + (1 << b) - 1) >> b;
+void
+J2KSetDecoderThreads(opj_codec_t *codec) {
+	// nested in a parallel loop, the calling thread decodes alone
+	const uint32_t thread_count = ThreadPool::IsWorkerThread() ? 1 : FreeImage_GetThreadCount();
+	if ((thread_count > 1) && opj_has_thread_support()) {
+		opj_codec_set_threads(codec, (int)thread_count);
+	}
 }
 
+FIBOOL
+J2KSetDecodeArea(opj_codec_t *codec, opj_image_t *image, unsigned requested_size, const unsigned *area) {
+	if (requested_size > 0) {
+		// each resolution level halves the size, down to the number of decomposition levels of the codestream
+		OPJ_UINT32 max_reduce = 0;
+		if (opj_codestream_info_v2_t *info = opj_get_cstr_info(codec)) {
+			if (info->m_default_tile_info.tccp_info) {
+				max_reduce = OPJ_J2K_MAXRLVLS;
+				for (OPJ_UINT32 c = 0; c < info->nbcomps; c++) {
+					max_reduce = MIN(max_reduce, info->m_default_tile_info.tccp_info[c].numresolutions - 1);
+				}
+			}
+			opj_destroy_cstr_info(&info);
+		}
+		const OPJ_UINT32 longest = MAX(image->x1 - image->x0, image->y1 - image->y0);
+		OPJ_UINT32 reduce = 0;
+		while ((reduce < max_reduce) && (((longest + (2U << reduce) - 1) >> (reduce + 1)) >= requested_size)) {
+			reduce++;
+		}
+		if ((reduce > 0) && !opj_set_decoded_resolution_factor(codec, reduce)) {
+			return FALSE;
+		}
+	}
+
+	if (area) {
+		const OPJ_UINT32 width = image->x1 - image->x0;
+		const OPJ_UINT32 height = image->y1 - image->y0;
+		if ((area[0] >= area[2]) || (area[1] >= area[3]) || (area[2] > width) || (area[3] > height)) {
+			return FALSE;
+		}
+		// the area is given in the reference grid
+		if (!opj_set_decode_area(codec, image, (OPJ_INT32)(image->x0 + area[0]), (OPJ_INT32)(image->y0 + area[1]), (OPJ_INT32)(image->x0 + area[2]), (OPJ_INT32)(image->y0 + area[3]))) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+// --------------------------------------------------------------------------
+
 /**
 Convert a OpenJPEG image to a FIBITMAP
 @param format_id Plugin ID
@@ -128,13 +171,11 @@ FIBITMAP* J2KImageToFIBITMAP(int format_id, const opj_image_t *image, FIBOOL hea
 	try {
 		// compute image width and height
 
-		//int w = int_ceildiv(image->x1 - image->x0, image->comps[0].dx);
+		// OpenJPEG 2 reports the component size of the decoded resolution level and area
+		// (the resolution factor is already applied, unlike with OpenJPEG 1)
 		int wr = image->comps[0].w;
-		int wrr = int_ceildivpow2(image->comps[0].w, image->comps[0].factor);
-		
-		//int h = int_ceildiv(image->y1 - image->y0, image->comps[0].dy);
-		//int hr = image->comps[0].h;
-		int hrr = int_ceildivpow2(image->comps[0].h, image->comps[0].factor);
+		int wrr = image->comps[0].w;
+		int hrr = image->comps[0].h;
 
 		// check the number of components
 
@@ -401,7 +442,7 @@ FIBITMAP* J2KImageToFIBITMAP(int format_id, const opj_image_t *image, FIBOOL hea
 		return dib.release();
 
 	} catch(const char *text) {
-		FreeImage_OutputMessageProc(format_id, text);
+		FreeImage_OutputMessageProcEx(format_id, GetThrownMessageCode(text), text);
 	}
 	return nullptr;
 }
@@ -582,7 +623,7 @@ opj_image_t* FIBITMAPToJ2KImage(int format_id, FIBITMAP *dib, const opj_cparamet
 
 	} catch (const char *text) {
 		if (image) opj_image_destroy(image);
-		FreeImage_OutputMessageProc(format_id, text);
+		FreeImage_OutputMessageProcEx(format_id, GetThrownMessageCode(text), text);
 		return nullptr;
 	}
 }
@@ -24,6 +24,18 @@ Stream destructor
 */
 void opj_freeimage_stream_destroy(J2KFIO_t* fio);
 
+/**
+Decodes with the library threads, to be called between opj_setup_decoder and opj_read_header
+*/
+void J2KSetDecoderThreads(opj_codec_t *codec);
+
+/**
+Selects what opj_decode decodes, to be called after opj_read_header:
+the lowest resolution level whose longest side is at least requested_size (0 for the full resolution),
+and if area isn't NULL, only the left, top, right, bottom rectangle of the full resolution image (right and bottom excluded)
+*/
+FIBOOL J2KSetDecodeArea(opj_codec_t *codec, opj_image_t *image, unsigned requested_size, const unsigned *area);
+
 /**
 Conversion opj_image_t => FIBITMAP
 */
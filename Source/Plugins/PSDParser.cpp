@@ -28,6 +28,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "PSDParser.h"
+#include "RLEEncoder.h"
 
 #include "../Metadata/FreeImageTag.h"
 
@@ -37,6 +38,8 @@
 #define PSD_SIGNATURE	0x38425053
 // Image resource block signature (= '8BIM')
 #define PSD_RESOURCE	0x3842494D
+// Additional layer information signature of some PSB blocks (= '8B64')
+#define PSD_RESOURCE_64	0x38423634
 
 // PSD color modes
 #define PSDP_BITMAP			0
@@ -160,6 +163,40 @@ psdReadSize(FreeImageIO *io, fi_handle handle, const psdHeaderInfo& header) {
 	}
 }
 
+/**
+Skip nBytes from the current position.
+Large PSB sections are skipped by steps that fit in a long, without using fseeko().
+*/
+static bool
+psdSkip(FreeImageIO *io, fi_handle handle, uint64_t nBytes) {
+	if (sizeof(long) < sizeof(uint64_t)) {
+		const long offset = 0x10000000;
+		while (nBytes > offset) {
+			if (io->seek_proc(handle, offset, SEEK_CUR) != 0) {
+				return false;
+			}
+			nBytes -= offset;
+		}
+	}
+	if (nBytes > 0) {
+		if (io->seek_proc(handle, (long)nBytes, SEEK_CUR) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+Seek to an absolute position, see psdSkip
+*/
+static bool
+psdSeek(FreeImageIO *io, fi_handle handle, uint64_t position) {
+	if (position <= (uint64_t)LONG_MAX) {
+		return (io->seek_proc(handle, (long)position, SEEK_SET) == 0);
+	}
+	return (io->seek_proc(handle, 0, SEEK_SET) == 0) && psdSkip(io, handle, position);
+}
+
 // --------------------------------------------------------------------------
 
 template <int N>
@@ -989,6 +1026,91 @@ bool psdData::Write(FreeImageIO *io, fi_handle handle, int ID) {
 
 //---------------------------------------------------------------------------
 
+psdLayerInfo::psdLayerInfo() : _Top(0), _Left(0), _Bottom(0), _Right(0), _BlendMode{}, _Opacity(255), _Flags(0) {
+}
+
+uint64_t psdLayerInfo::Read(FreeImageIO *io, fi_handle handle, const psdHeaderInfo& header) {
+	uint8_t Rect[16];
+	uint8_t Channels[2];
+
+	if ((io->read_proc(Rect, sizeof(Rect), 1, handle) != 1) || (io->read_proc(Channels, sizeof(Channels), 1, handle) != 1)) {
+		return 0;
+	}
+	_Top = (int)psdGetValue(Rect, 4);
+	_Left = (int)psdGetValue(Rect + 4, 4);
+	_Bottom = (int)psdGetValue(Rect + 8, 4);
+	_Right = (int)psdGetValue(Rect + 12, 4);
+
+	uint64_t nBytes = sizeof(Rect) + sizeof(Channels);
+
+	// channel lengths are 8 bytes in PSB files
+	const unsigned nLengthSize = (header._Version == 1) ? 4 : 8;
+	_ChannelInfo.resize(psdGetValue(Channels, sizeof(Channels)));
+	for (auto& channel : _ChannelInfo) {
+		uint8_t Info[2 + 8];
+		if (io->read_proc(Info, 2 + nLengthSize, 1, handle) != 1) {
+			return 0;
+		}
+		channel._ID = (short)psdGetValue(Info, 2);
+		channel._Length = (nLengthSize == 4) ? psdGetLongValue(Info + 2, 4) : psdGetLongValue(Info + 2, 8);
+		channel._Offset = 0;
+		nBytes += 2 + nLengthSize;
+	}
+
+	// blend mode signature and key, opacity, clipping, flags, filler and extra data length
+	uint8_t Blending[16];
+	if (io->read_proc(Blending, sizeof(Blending), 1, handle) != 1) {
+		return 0;
+	}
+	if (psdGetValue(Blending, 4) != PSD_RESOURCE) {
+		return 0;
+	}
+	memcpy(_BlendMode, Blending + 4, 4);
+	_BlendMode[4] = 0;
+	_Opacity = Blending[8];
+	_Flags = Blending[10];
+	const uint32_t nExtraBytes = psdGetValue(Blending + 12, 4);
+	nBytes += sizeof(Blending) + nExtraBytes;
+
+	// skip the layer mask data and the blending ranges
+	uint32_t nRead = 0;
+	for (int i = 0; i < 2; i++) {
+		uint8_t Length[4];
+		if (io->read_proc(Length, sizeof(Length), 1, handle) != 1) {
+			return 0;
+		}
+		const uint32_t nLength = psdGetValue(Length, sizeof(Length));
+		if (io->seek_proc(handle, (long)nLength, SEEK_CUR) != 0) {
+			return 0;
+		}
+		nRead += sizeof(Length) + nLength;
+	}
+
+	// Pascal string name, padded to a multiple of 4 bytes
+	uint8_t nNameLength = 0;
+	if (io->read_proc(&nNameLength, 1, 1, handle) != 1) {
+		return 0;
+	}
+	_Name.resize(nNameLength);
+	if (nNameLength && (io->read_proc(&_Name[0], nNameLength, 1, handle) != 1)) {
+		return 0;
+	}
+	const uint32_t nNameBytes = (1 + nNameLength + 3) & ~3u;
+	nRead += nNameBytes;
+	if (nRead > nExtraBytes) {
+		return 0;
+	}
+
+	// skip the name padding and the additional layer information
+	if (io->seek_proc(handle, (long)(nExtraBytes - nRead + nNameBytes - 1 - nNameLength), SEEK_CUR) != 0) {
+		return 0;
+	}
+
+	return nBytes;
+}
+
+//---------------------------------------------------------------------------
+
 /**
 Invert only color components, skipping Alpha/Black
 (Can be useful as public/utility function)
@@ -1057,27 +1179,10 @@ unsigned psdParser::GetChannelOffset(FIBITMAP* bitmap, unsigned c) const {
 }
 
 bool psdParser::ReadLayerAndMaskInfoSection(FreeImageIO *io, fi_handle handle)	{
-	bool bSuccess = true;
-
-	uint64_t nTotalBytes = psdReadSize(io, handle, _headerInfo);
-
-	// Hack to handle large PSB files without using fseeko().
-	if (sizeof(long) < sizeof(uint64_t)) {
-		const long offset = 0x10000000;
-		while (nTotalBytes > offset) {
-			if (io->seek_proc(handle, offset, SEEK_CUR) != 0) {
-				bSuccess = false;
-				break;
-			}
-			nTotalBytes -= offset;
-		}
-	}
-	if (bSuccess && nTotalBytes > 0) {
-		if (io->seek_proc(handle, (long)nTotalBytes, SEEK_CUR) != 0)
-			bSuccess = false;
-	}
+	// the composite image data follows the section, layer records are not read
+	const uint64_t nTotalBytes = psdReadSize(io, handle, _headerInfo);
 
-	return bSuccess;
+	return psdSkip(io, handle, nTotalBytes);
 }
 
 bool psdParser::ReadImageResources(FreeImageIO *io, fi_handle handle, int32_t length) {
@@ -1304,7 +1409,7 @@ void psdParser::ReadImageLine(uint8_t* dst, const uint8_t* src, unsigned lineSiz
 }
 
 void psdParser::UnpackRLE(uint8_t* line, const uint8_t* rle_line, const uint8_t* line_end, unsigned srcSize) {
-	while (srcSize > 0) {
+	while ((srcSize > 0) && (line < line_end)) {
 
 		int len = *rle_line++;
 		srcSize--;
@@ -1317,6 +1422,11 @@ void psdParser::UnpackRLE(uint8_t* line, const uint8_t* rle_line, const uint8_t*
 			// (len + 1) bytes of data are copied
 			++len;
 
+			// stop on truncated packets
+			if ((unsigned)len > srcSize) {
+				break;
+			}
+
 			// assert we don't write beyound eol
 			memcpy(line, rle_line, line + len > line_end ? line_end - line : len);
 			line += len;
@@ -1331,6 +1441,10 @@ void psdParser::UnpackRLE(uint8_t* line, const uint8_t* rle_line, const uint8_t*
 			len ^= 0xFF; // same as (-len + 1) & 0xFF
 			len += 2;    //
 
+			if (srcSize == 0) {
+				break;
+			}
+
 			// assert we don't write beyound eol
 			memset(line, *rle_line++, line + len > line_end ? line_end - line : len);
 			line += len;
@@ -1510,45 +1624,54 @@ FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
 #endif
 			}
 
-			uint32_t largestRLELine = 0;
-			for (unsigned ch = 0; ch < nChannels; ++ch) {
-				for (unsigned h = 0; h < nHeight; ++h) {
-					const unsigned index = ch * nHeight + h;
-
-					if (largestRLELine < rleLineSizeList[index]) {
-						largestRLELine = rleLineSizeList[index];
-					}
-				}
+			// offsets of the rows in the RLE data, rows of all channels are stored one after the other
+			// so that any group of rows can be unpacked on its own
+			const unsigned nRows = MIN(nChannels, dstChannels) * nHeight;
+			std::vector<uint64_t> rleOffsets(nRows + 1);
+			for (unsigned index = 0; index < nRows; ++index) {
+				rleOffsets[index + 1] = rleOffsets[index] + rleLineSizeList[index];
 			}
 
-			auto rle_line_start = std::make_unique<uint8_t[]>(largestRLELine);
+			// RLE data are read by chunks of rows of about 16 MB, rows of a chunk are unpacked in parallel
+			constexpr uint64_t chunk_bytes = 16 * 1024 * 1024;
+			std::vector<uint8_t> chunk;
 
-			// Read the RLE data
-			for (unsigned ch = 0; ch < nChannels; ch++) {
-				if (ch >= dstChannels) {
-					// @todo write to extra channels
-					break;
+			for (unsigned first_row = 0; first_row < nRows; ) {
+				unsigned last_row = first_row + 1;
+				while ((last_row < nRows) && (rleOffsets[last_row + 1] - rleOffsets[first_row] <= chunk_bytes)) {
+					++last_row;
 				}
-				const uint8_t* const line_end = line_start.get() + lineSize;
-
-				const unsigned channelOffset = GetChannelOffset(bitmap, ch) * bytes;
-
-				uint8_t* dst_line_start = dst_first_line + channelOffset;
-				for (unsigned h = 0; h < nHeight; ++h, dst_line_start -= dstLineSize) {//<*** flipped
-					const unsigned index = ch * nHeight + h;
-
-					// - read and uncompress line -
+				const uint64_t nChunkBytes = rleOffsets[last_row] - rleOffsets[first_row];
 
-					const uint32_t rleLineSize = rleLineSizeList[index];
+				// memory streams are unpacked in place
+				uint64_t available = 0;
+				const uint8_t *rle_data = FreeImage_PeekMemoryIO(io, handle, &available);
+				if (rle_data && (available >= nChunkBytes)) {
+					io->seek_proc(handle, (long)nChunkBytes, SEEK_CUR);
+				} else {
+					// missing data of truncated files are left as zeros
+					chunk.assign((size_t)nChunkBytes, 0);
+					if (nChunkBytes) {
+						io->read_proc(chunk.data(), 1, (unsigned)nChunkBytes, handle);
+					}
+					rle_data = chunk.data();
+				}
 
-					io->read_proc(rle_line_start.get(), rleLineSize, 1, handle);
+				ParallelFor(first_row, last_row, CalculateBandRows(lineSize), [&](unsigned first, unsigned last) {
+					std::vector<uint8_t> line(lineSize);
+					for (unsigned index = first; index < last; ++index) {
+						const unsigned ch = index / nHeight;
+						const unsigned h = index % nHeight;
+						uint8_t* dst_line_start = dst_first_line - (size_t)h * dstLineSize + GetChannelOffset(bitmap, ch) * bytes;//<*** flipped
 
-					// - write line to destination -
+						memset(line.data(), 0, lineSize);
+						UnpackRLE(line.data(), rle_data + (rleOffsets[index] - rleOffsets[first_row]), line.data() + lineSize, rleLineSizeList[index]);
+						ReadImageLine(dst_line_start, line.data(), lineSize, dstBpp, bytes);
+					}
+				});
 
-					UnpackRLE(line_start.get(), rle_line_start.get(), line_end, rleLineSize);
-					ReadImageLine(dst_line_start, line_start.get(), lineSize, dstBpp, bytes);
-				}//< h
-			}//< ch
+				first_row = last_row;
+			}
 		}
 		break;
 
@@ -1716,37 +1839,6 @@ void psdParser::WriteImageLine(uint8_t* dst, const uint8_t* src, unsigned lineSi
 	}
 }
 
-unsigned psdParser::PackRLE(uint8_t* line_start, const uint8_t* src_line, unsigned srcSize) {
-	uint8_t* line = line_start;
-	while (srcSize > 0) {
-		if (srcSize >= 2 && src_line[0] == src_line[1]) {
-			int len = 2;
-			while (len < 127 && len < (int)srcSize && src_line[0] == src_line[len])
-				len++;
-			*line++ = (uint8_t)((-len + 1) & 0xFF);
-			*line++ = src_line[0];
-			src_line += len;
-			srcSize -= len;
-		} else {
-			// uncompressed packet
-			// (len + 1) bytes of data are copied
-			int len = 1;
-			while (len < 127 && len < (int)srcSize &&
-				  (len+2 >= (int)srcSize || // check to switch to a run instead
-				   src_line[len] != src_line[len+1] ||
-				   src_line[len] != src_line[len+2]))
-				len++;
-			*line++ = (uint8_t)(len - 1);
-			for (int i=0; i < len; i++) {
-				*line++ = *src_line;
-				src_line++;
-			}
-			srcSize -= len;
-		}
-	}
-	return (unsigned)(line - line_start);
-}
-
 bool psdParser::WriteImageData(FreeImageIO *io, fi_handle handle, FIBITMAP* dib) {
 	if (!handle) {
 		return false;
@@ -1825,8 +1917,6 @@ bool psdParser::WriteImageData(FreeImageIO *io, fi_handle handle, FIBITMAP* dib)
 			// Version 2 has 4-byte line sizes.
 
 			// later use this array as uint16_t rleLineSizeList[nChannels][nHeight];
-			// Every 127 bytes needs a length byte.
-			auto rle_line_start = std::make_unique<uint8_t[]>(lineSize + ((nWidth + 126) / 127)); //< RLE buffer
 			auto rleLineSizeList = std::make_unique<uint32_t[]>(nChannels*nHeight);
 
 			const long offsets_pos = io->tell_proc(handle);
@@ -1839,15 +1929,33 @@ bool psdParser::WriteImageData(FreeImageIO *io, fi_handle handle, FIBITMAP* dib)
 					return false;
 				}
 			}
-			for (unsigned c = 0; c < nChannels; c++) {
-				const unsigned channelOffset = GetChannelOffset(dib, c) * bytes;
 
-				uint8_t* src_line_start = src_first_line + channelOffset;
-				for (unsigned h = 0; h < nHeight; ++h, src_line_start -= srcLineSize) {//<*** flipped
-					WriteImageLine(line_start.get(), src_line_start, lineSize, srcBpp, bytes);
-					unsigned len = PackRLE(rle_line_start.get(), line_start.get(), lineSize);
-					rleLineSizeList[c * nHeight + h] = len;
-					if (io->write_proc(rle_line_start.get(), len, 1, handle) != 1) {
+			// Every 127 bytes needs a length byte.
+			const size_t rleLineCapacity = lineSize + ((lineSize + 126) / 127);
+
+			// rows of all channels are packed in parallel by chunks of about 16 MB, each row into its own slot
+			// of the chunk buffer, then written in file order
+			const unsigned nRows = nChannels * nHeight;
+			const unsigned chunkRows = (unsigned)MIN<size_t>(nRows, MAX<size_t>(1, (16 * 1024 * 1024) / rleLineCapacity));
+			std::vector<uint8_t> chunk(chunkRows * rleLineCapacity);
+
+			for (unsigned first_row = 0; first_row < nRows; first_row += chunkRows) {
+				const unsigned last_row = MIN(nRows, first_row + chunkRows);
+
+				ParallelFor(first_row, last_row, CalculateBandRows(lineSize), [&](unsigned first, unsigned last) {
+					std::vector<uint8_t> line(lineSize);
+					for (unsigned index = first; index < last; ++index) {
+						const unsigned c = index / nHeight;
+						const unsigned h = index % nHeight;
+						const uint8_t* src_line_start = src_first_line - (size_t)h * srcLineSize + GetChannelOffset(dib, c) * bytes;//<*** flipped
+
+						WriteImageLine(line.data(), src_line_start, lineSize, srcBpp, bytes);
+						rleLineSizeList[index] = PackBitsEncodeLine(chunk.data() + (index - first_row) * rleLineCapacity, line.data(), lineSize);
+					}
+				});
+
+				for (unsigned index = first_row; index < last_row; ++index) {
+					if (io->write_proc(chunk.data() + (index - first_row) * rleLineCapacity, rleLineSizeList[index], 1, handle) != 1) {
 						return false;
 					}
 				}
@@ -1972,7 +2080,330 @@ FIBITMAP* psdParser::Load(FreeImageIO *io, fi_handle handle, int s_format_id, in
 		}
 
 	} catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
+	}
+	catch(const std::exception& e) {
+		FreeImage_OutputMessageProc(s_format_id, "%s", e.what());
+	}
+
+	return Bitmap;
+}
+
+bool psdParser::ReadLayerInfo(FreeImageIO *io, fi_handle handle, uint64_t length) {
+	const long start = io->tell_proc(handle);
+
+	uint8_t Count[2];
+	if (io->read_proc(Count, sizeof(Count), 1, handle) != 1) {
+		return false;
+	}
+	// a negative count means that the first alpha channel of the composite image is its transparency
+	const short nCount = (short)psdGetValue(Count, sizeof(Count));
+	_layers.resize(abs(nCount));
+
+	uint64_t nBytes = sizeof(Count);
+	for (auto& layer : _layers) {
+		const uint64_t n = layer.Read(io, handle, _headerInfo);
+		if (!n) {
+			_layers.clear();
+			return false;
+		}
+		nBytes += n;
+	}
+
+	// the channel image data follows the records, layer after layer and channel after channel
+	uint64_t position = (uint64_t)start + nBytes;
+	for (auto& layer : _layers) {
+		for (auto& channel : layer._ChannelInfo) {
+			channel._Offset = position;
+			position += channel._Length;
+		}
+	}
+	if (position - (uint64_t)start > length) {
+		_layers.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool psdParser::ReadLayers(FreeImageIO *io, fi_handle handle) {
+	_layers.clear();
+
+	if (!_headerInfo.Read(io, handle)) {
+		return false;
+	}
+	if (!_colourModeData.Read(io, handle)) {
+		return false;
+	}
+
+	// skip the image resources
+	uint8_t Length[4];
+	if ((io->read_proc(Length, sizeof(Length), 1, handle) != 1) || !psdSkip(io, handle, psdGetValue(Length, sizeof(Length)))) {
+		return false;
+	}
+
+	const unsigned nLengthSize = (_headerInfo._Version == 1) ? 4 : 8;
+	const uint64_t nSectionBytes = psdReadSize(io, handle, _headerInfo);
+	if (nSectionBytes < nLengthSize) {
+		// no layers
+		return true;
+	}
+
+	const uint64_t nLayerInfoBytes = psdReadSize(io, handle, _headerInfo);
+	uint64_t nBytes = nLengthSize + nLayerInfoBytes;
+	if (nLayerInfoBytes > 0) {
+		const long start = io->tell_proc(handle);
+		if (!ReadLayerInfo(io, handle, nLayerInfoBytes)) {
+			return false;
+		}
+		if (!_layers.empty()) {
+			return true;
+		}
+		if (!psdSeek(io, handle, (uint64_t)start + nLayerInfoBytes)) {
+			return false;
+		}
+	}
+
+	// 16- and 32-bit documents store their layers in the additional layer information (Lr16 and Lr32 keys)
+	// after the global layer mask info
+	if ((nBytes + sizeof(Length) > nSectionBytes) || (io->read_proc(Length, sizeof(Length), 1, handle) != 1)) {
+		return true;
+	}
+	const uint32_t nMaskBytes = psdGetValue(Length, sizeof(Length));
+	if (!psdSkip(io, handle, nMaskBytes)) {
+		return false;
+	}
+	nBytes += sizeof(Length) + nMaskBytes;
+
+	while (nBytes + 12 <= nSectionBytes) {
+		uint8_t Block[8];
+		if (io->read_proc(Block, sizeof(Block), 1, handle) != 1) {
+			break;
+		}
+		const uint32_t nSignature = psdGetValue(Block, 4);
+		if ((nSignature != PSD_RESOURCE) && (nSignature != PSD_RESOURCE_64)) {
+			break;
+		}
+		const char *key = (const char*)Block + 4;
+		const bool bLayers = (memcmp(key, "Lr16", 4) == 0) || (memcmp(key, "Lr32", 4) == 0) || (memcmp(key, "Layr", 4) == 0);
+
+		// PSB files use 8 bytes lengths for some of the keys
+		bool bLarge = false;
+		if (_headerInfo._Version == 2) {
+			static const char *large_keys[] = { "LMsk", "Lr16", "Lr32", "Layr", "Mt16", "Mt32", "Mtrn", "Alph", "FMsk", "lnk2", "FEid", "FXid", "PxSD" };
+			for (const char *large_key : large_keys) {
+				bLarge = bLarge || (memcmp(key, large_key, 4) == 0);
+			}
+		}
+		uint64_t nBlockBytes = 0;
+		if (bLarge) {
+			uint8_t Length8[8];
+			if (io->read_proc(Length8, sizeof(Length8), 1, handle) != 1) {
+				break;
+			}
+			nBlockBytes = psdGetLongValue(Length8, sizeof(Length8));
+		}
+		else {
+			if (io->read_proc(Length, sizeof(Length), 1, handle) != 1) {
+				break;
+			}
+			nBlockBytes = psdGetValue(Length, sizeof(Length));
+		}
+
+		if (bLayers) {
+			return ReadLayerInfo(io, handle, nBlockBytes);
+		}
+		if (!psdSkip(io, handle, nBlockBytes)) {
+			return false;
+		}
+		nBytes += sizeof(Block) + (bLarge ? 8 : 4) + nBlockBytes;
+	}
+
+	return true;
+}
+
+void psdParser::ReadLayerChannel(FreeImageIO *io, fi_handle handle, const psdLayerInfo::Channel& channel, uint8_t *plane, unsigned lineSize, unsigned nHeight) {
+	if ((channel._Length < 2) || (channel._Length > 0xFFFFFFFF) || !psdSeek(io, handle, channel._Offset)) {
+		throw "Invalid layer channel";
+	}
+
+	// the compressed data of the channel is read at once
+	std::vector<uint8_t> data((size_t)channel._Length);
+	if (io->read_proc(data.data(), (unsigned)data.size(), 1, handle) != 1) {
+		throw "Error in layer channel image data";
+	}
+
+	const uint16_t nCompression = (uint16_t)psdGetValue(data.data(), 2);
+	const uint8_t *src = data.data() + 2;
+	const size_t srcSize = data.size() - 2;
+	const size_t planeSize = (size_t)lineSize * nHeight;
+
+	switch (nCompression) {
+		case PSDP_COMPRESSION_NONE:
+			if (srcSize < planeSize) {
+				throw "Error in layer channel image data";
+			}
+			memcpy(plane, src, planeSize);
+			break;
+
+		case PSDP_COMPRESSION_RLE:
+		{
+			// the rows are preceded by their byte counts, 4-byte counts in PSB files
+			const unsigned nCountSize = (_headerInfo._Version == 1) ? 2 : 4;
+			size_t offset = (size_t)nCountSize * nHeight;
+			if (offset > srcSize) {
+				throw "Error in layer channel image data";
+			}
+			memset(plane, 0, planeSize);
+			for (unsigned h = 0; h < nHeight; h++) {
+				const uint32_t rleLineSize = (nCountSize == 2) ? psdGetValue(src + 2 * h, 2) : psdGetValue(src + 4 * h, 4);
+				if (rleLineSize > srcSize - offset) {
+					throw "Error in layer channel image data";
+				}
+				uint8_t *line = plane + (size_t)h * lineSize;
+				UnpackRLE(line, src + offset, line + lineSize, rleLineSize);
+				offset += rleLineSize;
+			}
+		}
+		break;
+
+		case PSDP_COMPRESSION_ZIP:
+		case PSDP_COMPRESSION_ZIP_PREDICTION:
+		{
+			if ((planeSize > 0xFFFFFFFF) || (FreeImage_ZLibUncompress(plane, (uint32_t)planeSize, const_cast<uint8_t*>(src), (uint32_t)srcSize) != planeSize)) {
+				throw "Error in layer channel image data";
+			}
+			if (nCompression == PSDP_COMPRESSION_ZIP_PREDICTION) {
+				// each row stores the differences between successive big endian samples
+				for (unsigned h = 0; h < nHeight; h++) {
+					uint8_t *line = plane + (size_t)h * lineSize;
+					if (_headerInfo._BitsPerChannel == 16) {
+						uint16_t previous = 0;
+						for (unsigned x = 0; x < lineSize; x += 2) {
+							previous = (uint16_t)(previous + ((line[x] << 8) | line[x + 1]));
+							line[x] = (uint8_t)(previous >> 8);
+							line[x + 1] = (uint8_t)previous;
+						}
+					} else {
+						for (unsigned x = 1; x < lineSize; x++) {
+							line[x] = (uint8_t)(line[x] + line[x - 1]);
+						}
+					}
+				}
+			}
+		}
+		break;
+
+		default:
+			throw "Unsupported layer compression";
+	}
+}
+
+FIBITMAP* psdParser::ReadLayerData(FreeImageIO *io, fi_handle handle, const psdLayerInfo& layer) {
+	const bool header_only = (_fi_flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
+	const int64_t nLayerWidth = (int64_t)layer._Right - layer._Left;
+	const int64_t nLayerHeight = (int64_t)layer._Bottom - layer._Top;
+	if ((nLayerWidth <= 0) || (nLayerHeight <= 0)) {
+		throw "Empty layer";
+	}
+	if ((nLayerWidth > 300000) || (nLayerHeight > 300000)) {
+		throw "Invalid layer size";
+	}
+	const unsigned nWidth = (unsigned)nLayerWidth;
+	const unsigned nHeight = (unsigned)nLayerHeight;
+
+	const short mode = _headerInfo._ColourMode;
+	const unsigned depth = _headerInfo._BitsPerChannel;
+	if ((mode != PSDP_RGB) && (mode != PSDP_GRAYSCALE)) {
+		throw "Unsupported color mode for layers";
+	}
+	if ((depth != 8) && (depth != 16)) {
+		throw "Unsupported layer depth";
+	}
+	const unsigned bytes = depth / 8;
+
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> safeBitmap(nullptr, &FreeImage_Unload);
+	if (depth == 8) {
+		safeBitmap.reset(FreeImage_AllocateHeader(header_only, nWidth, nHeight, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+	} else {
+		safeBitmap.reset(FreeImage_AllocateHeaderT(header_only, FIT_RGBA16, nWidth, nHeight));
+	}
+	if (!safeBitmap) {
+		throw FI_MSG_ERROR_DIB_MEMORY;
+	}
+	FIBITMAP* bitmap = safeBitmap.get();
+
+	// position and blending of the layer in the document
+	char value[32];
+	FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, bitmap, "Psd.Layer.Name", layer._Name.c_str());
+	snprintf(value, std::size(value), "%d", layer._Left);
+	FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, bitmap, "Psd.Layer.Left", value);
+	snprintf(value, std::size(value), "%d", layer._Top);
+	FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, bitmap, "Psd.Layer.Top", value);
+	snprintf(value, std::size(value), "%u", layer._Opacity);
+	FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, bitmap, "Psd.Layer.Opacity", value);
+	FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, bitmap, "Psd.Layer.BlendMode", layer._BlendMode);
+	FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, bitmap, "Psd.Layer.Visible", (layer._Flags & 0x02) ? "0" : "1");
+
+	if (header_only) {
+		return safeBitmap.release();
+	}
+
+	// layers without transparency mask are opaque
+	memset(FreeImage_GetBits(bitmap), 0xFF, (size_t)FreeImage_GetPitch(bitmap) * nHeight);
+
+	const unsigned lineSize = nWidth * bytes;
+	const unsigned dstBpp = FreeImage_GetBPP(bitmap) / 8;
+	const unsigned dstLineSize = FreeImage_GetPitch(bitmap);
+	uint8_t* const dst_first_line = FreeImage_GetScanLine(bitmap, nHeight - 1);//<*** flipped
+
+	auto plane = std::make_unique<uint8_t[]>((size_t)lineSize * nHeight);
+
+	for (const auto& channel : layer._ChannelInfo) {
+		// color channels (grey is copied to R, G and B) and transparency, layer masks are ignored
+		unsigned targets[3];
+		unsigned nTargets = 0;
+		if (channel._ID == -1) {
+			targets[nTargets++] = 3;
+		} else if ((mode == PSDP_GRAYSCALE) && (channel._ID == 0)) {
+			targets[nTargets++] = 0;
+			targets[nTargets++] = 1;
+			targets[nTargets++] = 2;
+		} else if ((mode == PSDP_RGB) && (channel._ID >= 0) && (channel._ID < 3)) {
+			targets[nTargets++] = GetChannelOffset(bitmap, channel._ID);
+		}
+		if (!nTargets) {
+			continue;
+		}
+
+		ReadLayerChannel(io, handle, channel, plane.get(), lineSize, nHeight);
+
+		for (unsigned t = 0; t < nTargets; t++) {
+			uint8_t* dst_line_start = dst_first_line + targets[t] * bytes;
+			for (unsigned h = 0; h < nHeight; ++h, dst_line_start -= dstLineSize) {//<*** flipped
+				ReadImageLine(dst_line_start, plane.get() + (size_t)h * lineSize, lineSize, dstBpp, bytes);
+			}
+		}
+	}
+
+	return safeBitmap.release();
+}
+
+FIBITMAP* psdParser::LoadLayer(FreeImageIO *io, fi_handle handle, int layer, int s_format_id, int flags) {
+	FIBITMAP *Bitmap{};
+
+	_fi_flags = flags;
+	_fi_format_id = s_format_id;
+
+	try {
+		if ((layer < 0) || (layer >= GetLayerCount())) {
+			throw "Invalid layer index";
+		}
+		Bitmap = ReadLayerData(io, handle, _layers[layer]);
+
+	} catch(const char *text) {
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 	}
 	catch(const std::exception& e) {
 		FreeImage_OutputMessageProc(s_format_id, "%s", e.what());
@@ -282,6 +282,38 @@ public:
 	bool Write(FreeImageIO *io, fi_handle handle, int ID);
 };
 
+/**
+Table 1.15 Layer records.
+Position, channels and blending of a layer. The channel image data is located but not read.
+*/
+class psdLayerInfo {
+public:
+	/** Table 1.15 Channel information */
+	struct Channel {
+		short _ID;			//! 0 = red, 1 = green, etc. -1 = transparency mask, -2 = user supplied layer mask, -3 = real user supplied layer mask
+		uint64_t _Length;	//! Length of the channel image data, compression field included
+		uint64_t _Offset;	//! Position of the channel image data in the file
+	};
+
+	int _Top;			//! Rectangle containing the contents of the layer
+	int _Left;
+	int _Bottom;
+	int _Right;
+	std::vector<Channel> _ChannelInfo;
+	char _BlendMode[5];	//! Blend mode key, e.g. "norm"
+	uint8_t _Opacity;	//! 0 = transparent ... 255 = opaque
+	uint8_t _Flags;		//! bit 0 = transparency protected, bit 1 = hidden
+	std::string _Name;	//! Layer name (Pascal string)
+
+public:
+	psdLayerInfo();
+	/**
+	Read a layer record, the additional layer information is skipped
+	@return Returns the number of bytes read, 0 on error
+	*/
+	uint64_t Read(FreeImageIO *io, fi_handle handle, const psdHeaderInfo& header);
+};
+
 /**
 PSD loader
 */
@@ -298,6 +330,7 @@ private:
 	psdData					_exif1;
 	psdData					_exif3;
 	psdData					_xmp;
+	std::vector<psdLayerInfo> _layers;
 
 	short _ColourCount;
 	short _TransparentIndex;
@@ -318,15 +351,34 @@ private:
 	void ReadImageLine(uint8_t* dst, const uint8_t* src, unsigned lineSize, unsigned dstBpp, unsigned bytes);
 	void UnpackRLE(uint8_t* dst, const uint8_t* src, const uint8_t* dst_end, unsigned srcSize);
 	FIBITMAP* ReadImageData(FreeImageIO *io, fi_handle handle);
+	/** Read the layer records of a layer info structure and locate the channel image data */
+	bool ReadLayerInfo(FreeImageIO *io, fi_handle handle, uint64_t length);
+	/** Decode the planar channel image data of a layer channel */
+	void ReadLayerChannel(FreeImageIO *io, fi_handle handle, const psdLayerInfo::Channel& channel, uint8_t *plane, unsigned lineSize, unsigned nHeight);
+	FIBITMAP* ReadLayerData(FreeImageIO *io, fi_handle handle, const psdLayerInfo& layer);
 	bool WriteLayerAndMaskInfoSection(FreeImageIO *io, fi_handle handle);
 	void WriteImageLine(uint8_t* dst, const uint8_t* src, unsigned lineSize, unsigned srcBpp, unsigned bytes);
-	unsigned PackRLE(uint8_t* line_start, const uint8_t* src_line, unsigned srcSize);
 	bool WriteImageData(FreeImageIO *io, fi_handle handle, FIBITMAP* dib);
 
 public:
 	psdParser();
 	~psdParser();
 	FIBITMAP* Load(FreeImageIO *io, fi_handle handle, int s_format_id, int flags=0);
+	/**
+	Read the file header and the layer records, skipping the image resources and all pixel data.
+	The stream must be positioned at the file header.
+	@return Returns true if successful, false otherwise
+	*/
+	bool ReadLayers(FreeImageIO *io, fi_handle handle);
+	/** Number of layers found by ReadLayers */
+	int GetLayerCount() const {
+		return (int)_layers.size();
+	}
+	/**
+	Decode the pixels of a single layer (RGB and greyscale documents, 8- or 16-bit) as a 32-bit or FIT_RGBA16 image.
+	Only the channel image data of this layer is read.
+	*/
+	FIBITMAP* LoadLayer(FreeImageIO *io, fi_handle handle, int layer, int s_format_id, int flags=0);
 	bool Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data);
 	/** Also used by the TIFF plugin */
 	bool ReadImageResources(FreeImageIO *io, fi_handle handle, int32_t length=0);
@@ -26,6 +26,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "RLEEncoder.h"
+#include "FreeImage/Plugin.h"
 
 // ----------------------------------------------------------
 //   Constants + headers
@@ -196,6 +198,103 @@ LoadPixelData(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, int height, unsi
 	return TRUE;
 }
 
+#define BMP_READ_CHUNK	(64 * 1024)
+
+/**
+Buffered reader of RLE data. Memory streams are read in place, other streams by chunks of BMP_READ_CHUNK bytes.
+The stream is positioned after the last byte used when the reader is destroyed.
+*/
+class RLEReader {
+public:
+	RLEReader(FreeImageIO *io, fi_handle handle) : m_io(io), m_handle(handle) {
+		uint64_t available = 0;
+		if (const uint8_t *bytes = FreeImage_PeekMemoryIO(io, handle, &available)) {
+			m_start = m_pos = bytes;
+			m_end = bytes + available;
+			m_in_place = true;
+		}
+	}
+
+	~RLEReader() {
+		if (m_in_place) {
+			m_io->seek_proc(m_handle, (long)(m_pos - m_start), SEEK_CUR);
+		}
+		else if (m_end != m_pos) {
+			m_io->seek_proc(m_handle, -(long)(m_end - m_pos), SEEK_CUR);
+		}
+	}
+
+	/**
+	Reads the next byte, returns false at the end of the stream
+	*/
+	bool getByte(uint8_t *value) {
+		if ((m_pos == m_end) && !Fill()) {
+			return false;
+		}
+		*value = *m_pos++;
+		return true;
+	}
+
+	/**
+	Returns the number of bytes used since the reader was created
+	*/
+	uint64_t Tell() const {
+		return m_in_place ? (uint64_t)(m_pos - m_start) : m_read - (uint64_t)(m_end - m_pos);
+	}
+
+	/**
+	Copies the next count bytes, returns false when the stream is too short
+	*/
+	bool getBytes(uint8_t *dst, size_t count) {
+		while (count) {
+			if ((m_pos == m_end) && !Fill()) {
+				return false;
+			}
+			const size_t n = MIN(count, (size_t)(m_end - m_pos));
+			memcpy(dst, m_pos, n);
+			m_pos += n;
+			dst += n;
+			count -= n;
+		}
+		return true;
+	}
+
+private:
+	bool Fill() {
+		if (m_in_place) {
+			return false;
+		}
+		m_chunk.resize(BMP_READ_CHUNK);
+		const unsigned count = m_io->read_proc(m_chunk.data(), 1, BMP_READ_CHUNK, m_handle);
+		m_pos = m_chunk.data();
+		m_end = m_pos + count;
+		m_read += count;
+		return count > 0;
+	}
+
+	FreeImageIO *m_io;
+	fi_handle m_handle;
+	std::vector<uint8_t> m_chunk;
+	const uint8_t *m_start{};
+	const uint8_t *m_pos{};
+	const uint8_t *m_end{};
+	uint64_t m_read{};
+	bool m_in_place{};
+};
+
+/**
+Fills count bytes with a pattern of pattern_size bytes already stored at the start of dst, by doubling copies
+*/
+static inline void
+FillPattern(uint8_t *dst, size_t pattern_size, size_t count) {
+	size_t filled = MIN(pattern_size, count);
+	while (filled < count) {
+		const size_t n = MIN(filled, count - filled);
+		memcpy(dst + filled, dst, n);
+		filled += n;
+	}
+}
+
 /**
 Load image pixels for 4-bit RLE compressed dib
 @param io FreeImage IO
@@ -207,7 +306,7 @@ Load image pixels for 4-bit RLE compressed dib
 */
 static FIBOOL 
 LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBITMAP *dib) {
-	int status_byte = 0;
+	uint8_t status_byte = 0;
 	uint8_t second_byte = 0;
 	int bits = 0;
 
@@ -221,27 +320,34 @@ LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 		uint8_t *q = pixels;
 		uint8_t *end = pixels + static_cast<size_t>(height) * width;
 
+		RLEReader reader(io, handle);
+		uint8_t absolute[128];
+
 		for (size_t scanline = 0; scanline < height; ) {
 			if (q < pixels || q  >= end) {
 				break;
 			}
-			if (io->read_proc(&status_byte, sizeof(uint8_t), 1, handle) != 1) {
+			if (!reader.getByte(&status_byte)) {
 				throw(1);
 			}
 			if (status_byte != 0)	{
-				status_byte = (int)MIN((size_t)status_byte, (size_t)(end - q));
+				status_byte = (uint8_t)MIN((size_t)status_byte, (size_t)(end - q));
 				// Encoded mode
-				if (io->read_proc(&second_byte, sizeof(uint8_t), 1, handle) != 1) {
+				if (!reader.getByte(&second_byte)) {
 					throw(1);
 				}
-				for (int i = 0; i < status_byte; i++)	{
-					*q++=(uint8_t)((i & 0x01) ? (second_byte & 0x0f) : ((second_byte >> 4) & 0x0f));
+				// the two nibbles alternate
+				q[0] = (uint8_t)((second_byte >> 4) & 0x0f);
+				if (status_byte > 1) {
+					q[1] = (uint8_t)(second_byte & 0x0f);
 				}
+				FillPattern(q, 2, status_byte);
+				q += status_byte;
 				bits += status_byte;
 			}
 			else {
 				// Escape mode
-				if (io->read_proc(&status_byte, sizeof(uint8_t), 1, handle) != 1) {
+				if (!reader.getByte(&status_byte)) {
 					throw(1);
 				}
 				switch (status_byte) {
@@ -266,10 +372,7 @@ LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 						uint8_t delta_x = 0;
 						uint8_t delta_y = 0;
 
-						if (io->read_proc(&delta_x, sizeof(uint8_t), 1, handle) != 1) {
-							throw(1);
-						}
-						if (io->read_proc(&delta_y, sizeof(uint8_t), 1, handle) != 1) {
+						if (!reader.getByte(&delta_x) || !reader.getByte(&delta_y)) {
 							throw(1);
 						}
 
@@ -284,20 +387,19 @@ LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 					default:
 					{
 						// Absolute mode
-						status_byte = (int)MIN((size_t)status_byte, (size_t)(end - q));
+						status_byte = (uint8_t)MIN((size_t)status_byte, (size_t)(end - q));
+						if (!reader.getBytes(absolute, (status_byte + 1) / 2)) {
+							throw(1);
+						}
 						for (int i = 0; i < status_byte; i++) {
-							if ((i & 0x01) == 0) {
-								if (io->read_proc(&second_byte, sizeof(uint8_t), 1, handle) != 1) {
-									throw(1);
-								}
-							}
-							*q++=(uint8_t)((i & 0x01) ? (second_byte & 0x0f) : ((second_byte >> 4) & 0x0f));
+							const uint8_t value = absolute[i >> 1];
+							*q++=(uint8_t)((i & 0x01) ? (value & 0x0f) : ((value >> 4) & 0x0f));
 						}
 						bits += status_byte;
 						// Read pad byte
 						if (((status_byte & 0x03) == 1) || ((status_byte & 0x03) == 2)) {
 							uint8_t padding = 0;
-							if (io->read_proc(&padding, sizeof(uint8_t), 1, handle) != 1) {
+							if (!reader.getByte(&padding)) {
 								throw(1);
 							}
 						}
@@ -351,14 +453,16 @@ LoadPixelDataRLE8(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 	int scanline = 0;
 	int bits = 0;
 
+	RLEReader reader(io, handle);
+
 	for (;;) {
-		if ( io->read_proc(&status_byte, sizeof(uint8_t), 1, handle) != 1) {
+		if (!reader.getByte(&status_byte)) {
 			return FALSE;
 		}
 
 		switch (status_byte) {
 			case RLE_COMMAND :
-				if (io->read_proc(&status_byte, sizeof(uint8_t), 1, handle) != 1) {
+				if (!reader.getByte(&status_byte)) {
 					return FALSE;
 				}
 
@@ -378,10 +482,7 @@ LoadPixelDataRLE8(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 						uint8_t delta_x = 0;
 						uint8_t delta_y = 0;
 
-						if (io->read_proc(&delta_x, sizeof(uint8_t), 1, handle) != 1) {
-							return FALSE;
-						}
-						if (io->read_proc(&delta_y, sizeof(uint8_t), 1, handle) != 1) {
+						if (!reader.getByte(&delta_x) || !reader.getByte(&delta_y)) {
 							return FALSE;
 						}
 
@@ -400,17 +501,20 @@ LoadPixelDataRLE8(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 						}
 
 						int count = MIN((int)status_byte, width - bits);
+						if (count <= 0) {
+							return FALSE;
+						}
 
 						uint8_t *sline = FreeImage_GetScanLine(dib, scanline);
 
-						if (io->read_proc((void *)(sline + bits), sizeof(uint8_t) * count, 1, handle) != 1) {
+						if (!reader.getBytes(sline + bits, count)) {
 							return FALSE;
 						}
 						
 						// align run length to even number of bytes 
 
 						if ((status_byte & 1) == 1) {
-							if (io->read_proc(&second_byte, sizeof(uint8_t), 1, handle) != 1) {
+							if (!reader.getByte(&second_byte)) {
 								return FALSE;
 							}
 						}
@@ -433,14 +537,13 @@ LoadPixelDataRLE8(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 
 				uint8_t *sline = FreeImage_GetScanLine(dib, scanline);
 
-				if (io->read_proc(&second_byte, sizeof(uint8_t), 1, handle) != 1) {
+				if (!reader.getByte(&second_byte)) {
 					return FALSE;
 				}
 
-				for (int i = 0; i < count; i++) {
-					*(sline + bits) = second_byte;
-
-					bits++;					
+				if (count > 0) {
+					memset(sline + bits, second_byte, count);
+					bits += count;
 				}
 
 				break;
@@ -658,7 +761,7 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 		}
 	} catch(const char *message) {
 		if (message) {
-			FreeImage_OutputMessageProc(s_format_id, message);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(message), message);
 		}
 	}
 
@@ -858,7 +961,7 @@ LoadOS22XBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bits_
 			}
 		}
 	} catch(const char *message) {
-		FreeImage_OutputMessageProc(s_format_id, message);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(message), message);
 	}
 
 	return nullptr;
@@ -996,7 +1099,7 @@ LoadOS21XBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bits_
 			}
 		}
 	} catch(const char *message) {	
-		FreeImage_OutputMessageProc(s_format_id, message);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(message), message);
 	}
 
 	return nullptr;
@@ -1070,6 +1173,11 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -1092,7 +1200,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		// check the signature
 
 		if ((bitmapfileheader.bfType != 0x4D42) && (bitmapfileheader.bfType != 0x4142)) {
-			FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MAGIC_NUMBER);
+			FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MAGIC_NUMBER, FI_MSG_ERROR_MAGIC_NUMBER);
 			return nullptr;
 		}
 
@@ -1149,20 +1257,40 @@ RLEEncodeLine(uint8_t *target, const uint8_t *source, int size) {
 	int buffer_size = 0;
 	int target_pos = 0;
 
-	for (int i = 0; i < size; ++i) {
+	// add bytes to the pool, writing it when it's full
+	auto bufferBytes = [&](const uint8_t *bytes, int count) {
+		while (count > 0) {
+			const int n = MIN(count, 254 - buffer_size);
+			memcpy(buffer + buffer_size, bytes, n);
+			buffer_size += n;
+			bytes += n;
+			count -= n;
+
+			if (buffer_size == 254) {
+				// write what we have
+
+				target[target_pos++] = RLE_COMMAND;
+				target[target_pos++] = (uint8_t)buffer_size;
+				memcpy(target + target_pos, buffer, buffer_size);
+
+				// prepare for next run
+
+				target_pos += buffer_size;
+				buffer_size = 0;
+			}
+		}
+	};
+
+	for (int i = 0; i < size; ) {
 		if ((i < size - 1) && (source[i] == source[i + 1])) {
 			// find a solid block of same bytes
 
-			int j = i + 1;
-			int jmax = 254 + i;
-
-			while ((j < size - 1) && (j < jmax) && (source[j] == source[j + 1]))
-				++j;
+			const int run = (int)RLERunLength(source + i, (unsigned)MIN(size - i, 255), 1);
 
 			// if the block is larger than 3 bytes, use it
 			// else put the data into the larger pool
 
-			if (((j - i) + 1) > 3) {
+			if (run > 3) {
 				// don't forget to write what we already have in the buffer
 
 				switch (buffer_size) {
@@ -1198,45 +1326,23 @@ RLEEncodeLine(uint8_t *target, const uint8_t *source, int size) {
 
 				// write the continuous data
 
-				target[target_pos++] = (uint8_t)((j - i) + 1);
+				target[target_pos++] = (uint8_t)run;
 				target[target_pos++] = source[i];
 
 				buffer_size = 0;
 			} else {
-				for (int k = 0; k < (j - i) + 1; ++k) {
-					buffer[buffer_size++] = source[i + k];
-
-					if (buffer_size == 254) {
-						// write what we have
-
-						target[target_pos++] = RLE_COMMAND;
-						target[target_pos++] = (uint8_t)buffer_size;
-						memcpy(target + target_pos, buffer, buffer_size);
-
-						// prepare for next run
-
-						target_pos += buffer_size;
-						buffer_size = 0;
-					}
-				}
+				bufferBytes(source + i, run);
 			}
 
-			i = j;
+			i += run;
 		} else {
-			buffer[buffer_size++] = source[i];
-		}
+			// bytes up to the next pair of same bytes go to the pool
 
-		// write the buffer if it's full
+			const int count = (int)RLELiteralLength(source + i, (unsigned)(size - i), 1, 2);
 
-		if (buffer_size == 254) {
-			target[target_pos++] = RLE_COMMAND;
-			target[target_pos++] = (uint8_t)buffer_size;
-			memcpy(target + target_pos, buffer, buffer_size);
+			bufferBytes(source + i, count);
 
-			// prepare for next run
-
-			target_pos += buffer_size;
-			buffer_size = 0;
+			i += count;
 		}
 	}
 
@@ -1389,7 +1495,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			auto buffer(std::make_unique<uint8_t[]>(dst_pitch * 2));
 
 			for (unsigned i = 0; i < dst_height; ++i) {
-				int size = RLEEncodeLine(buffer.get(), FreeImage_GetScanLine(dib, i), FreeImage_GetLine(dib));
+				int size = RLEEncodeLine(buffer.get(), FreeImage_GetConstScanLine(dib, i), FreeImage_GetLine(dib));
 
 				if (io->write_proc(buffer.get(), size, 1, handle) != 1) {
 					return FALSE;
@@ -1408,9 +1514,9 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			uint16_t pad = 0;
 			uint16_t pixel;
 			for (unsigned y = 0; y < dst_height; y++) {
-				uint8_t *line = FreeImage_GetScanLine(dib, y);
+				const uint8_t *line = FreeImage_GetConstScanLine(dib, y);
 				for (unsigned x = 0; x < dst_width; x++) {
-					pixel = ((uint16_t *)line)[x];
+					pixel = ((const uint16_t *)line)[x];
 					SwapShort(&pixel);
 					if (io->write_proc(&pixel, sizeof(uint16_t), 1, handle) != 1) {
 						return FALSE;
@@ -1429,9 +1535,9 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			uint32_t pad = 0;
 			FILE_BGR bgr;
 			for (unsigned y = 0; y < dst_height; y++) {
-				uint8_t *line = FreeImage_GetScanLine(dib, y);
+				const uint8_t *line = FreeImage_GetConstScanLine(dib, y);
 				for (unsigned x = 0; x < dst_width; x++) {
-					const FIRGB8 *triple = ((FIRGB8 *)line)+x;
+					const FIRGB8 *triple = ((const FIRGB8 *)line)+x;
 					bgr.b = triple->blue;
 					bgr.g = triple->green;
 					bgr.r = triple->red;
@@ -1448,9 +1554,9 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		} else if (dst_bpp == 32) {
 			FILE_BGRA bgra;
 			for (unsigned y = 0; y < dst_height; y++) {
-				uint8_t *line = FreeImage_GetScanLine(dib, y);
+				const uint8_t *line = FreeImage_GetConstScanLine(dib, y);
 				for (unsigned x = 0; x < dst_width; x++) {
-					const FIRGBA8 *quad = ((FIRGBA8 *)line)+x;
+					const FIRGBA8 *quad = ((const FIRGBA8 *)line)+x;
 					bgra.b = quad->blue;
 					bgra.g = quad->green;
 					bgra.r = quad->red;
@@ -1463,13 +1569,13 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 #endif
 		} 
 		else if (FreeImage_GetPitch(dib) == dst_pitch) {
-			return (io->write_proc(FreeImage_GetBits(dib), dst_height * dst_pitch, 1, handle) != 1) ? FALSE : TRUE;
+			return (io->write_proc(const_cast<uint8_t *>(FreeImage_GetConstBits(dib)), dst_height * dst_pitch, 1, handle) != 1) ? FALSE : TRUE;
 		}
 		else {
 			for (unsigned y = 0; y < dst_height; y++) {
-				uint8_t *line = (uint8_t*)FreeImage_GetScanLine(dib, y);
+				const uint8_t *line = FreeImage_GetConstScanLine(dib, y);
 				
-				if (io->write_proc(line, dst_pitch, 1, handle) != 1) {
+				if (io->write_proc(const_cast<uint8_t *>(line), dst_pitch, 1, handle) != 1) {
 					return FALSE;
 				}
 			}
@@ -1482,6 +1588,363 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	}
 }
 
+// --------------------------------------------------------------------------
+
+/**
+Probe the file and info headers (see FreeImage_GetImageInfo)
+*/
+static FIBOOL DLL_CALLCONV
+GetImageInfo(FreeImageIO *io, fi_handle handle, FIIMAGEINFO *info, void *data) {
+	BITMAPFILEHEADER bitmapfileheader;
+	if (io->read_proc(&bitmapfileheader, sizeof(BITMAPFILEHEADER), 1, handle) != 1) {
+		return FALSE;
+	}
+#ifdef FREEIMAGE_BIGENDIAN
+	SwapFileHeader(&bitmapfileheader);
+#endif
+	if ((bitmapfileheader.bfType != 0x4D42) && (bitmapfileheader.bfType != 0x4142)) {
+		return FALSE;
+	}
+
+	unsigned width = 0, height = 0, bit_count = 0;
+
+	FIBITMAPINFOHEADER bih;
+	if (io->read_proc(&bih, sizeof(BITMAPINFOOS2_1X_HEADER), 1, handle) != 1) {
+		return FALSE;
+	}
+#ifdef FREEIMAGE_BIGENDIAN
+	SwapLong(&bih.biSize);
+#endif
+	if (bih.biSize == 12) {
+		// OS/2 1.x
+		BITMAPINFOOS2_1X_HEADER bios2_1x;
+		memcpy(&bios2_1x, &bih, sizeof(BITMAPINFOOS2_1X_HEADER));
+#ifdef FREEIMAGE_BIGENDIAN
+		SwapShort(&bios2_1x.biWidth);
+		SwapShort(&bios2_1x.biHeight);
+		SwapShort(&bios2_1x.biBitCount);
+#endif
+		width = bios2_1x.biWidth;
+		height = bios2_1x.biHeight;
+		bit_count = bios2_1x.biBitCount;
+	} else if ((bih.biSize == 40) || (bih.biSize == 52) || (bih.biSize == 56) || (bih.biSize == 64) || (bih.biSize == 108) || (bih.biSize == 124)) {
+		// Windows and OS/2 2.x headers start with a BITMAPINFOHEADER
+		const uint32_t size = bih.biSize;
+		if (io->read_proc((uint8_t*)&bih + sizeof(BITMAPINFOOS2_1X_HEADER), sizeof(FIBITMAPINFOHEADER) - sizeof(BITMAPINFOOS2_1X_HEADER), 1, handle) != 1) {
+			return FALSE;
+		}
+#ifdef FREEIMAGE_BIGENDIAN
+		SwapInfoHeader(&bih);
+#endif
+		bih.biSize = size;
+		if ((bih.biWidth < 0) || (bih.biCompression == BI_JPEG) || (bih.biCompression == BI_PNG)) {
+			return FALSE;
+		}
+		width = bih.biWidth;
+		height = abs(bih.biHeight);
+		bit_count = bih.biBitCount;
+	} else {
+		return FALSE;
+	}
+
+	info->width = width;
+	info->height = height;
+	info->bpp = bit_count;
+	info->image_type = FIT_BITMAP;
+	switch (bit_count) {
+		case 1:
+		case 4:
+		case 8:
+			info->color_type = FIC_PALETTE;
+			break;
+		case 16:
+		case 24:
+			info->color_type = FIC_RGB;
+			break;
+		case 32:
+			info->color_type = FIC_RGBALPHA;
+			info->has_alpha = TRUE;
+			break;
+		default:
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+// ==========================================================
+//   Scanline decoder
+// ==========================================================
+
+/**
+Decodes the RLE4 or RLE8 commands of one scanline from column x into indices (one byte per pixel, nullptr to skip them).
+On return, rows is the number of scanlines to move up (0 at the end of the bitmap) and next_x the column the next one starts from.
+@return Returns FALSE when the stream is too short
+*/
+static FIBOOL
+DecodeRLERow(RLEReader &reader, unsigned bit_count, int width, int x, uint8_t *indices, int *rows, int *next_x) {
+	uint8_t absolute[256];
+
+	for (;;) {
+		uint8_t status_byte = 0;
+		if (!reader.getByte(&status_byte)) {
+			return FALSE;
+		}
+		if (status_byte != RLE_COMMAND) {
+			// Encoded mode, the two nibbles alternate in RLE4 runs
+			uint8_t value = 0;
+			if (!reader.getByte(&value)) {
+				return FALSE;
+			}
+			if (indices) {
+				for (int i = 0; (i < status_byte) && (x + i < width); i++) {
+					indices[x + i] = (bit_count == 4) ? (uint8_t)((i & 0x01) ? (value & 0x0f) : (value >> 4)) : value;
+				}
+			}
+			x += status_byte;
+			continue;
+		}
+
+		if (!reader.getByte(&status_byte)) {
+			return FALSE;
+		}
+		switch (status_byte) {
+			case RLE_ENDOFLINE:
+				*rows = 1;
+				*next_x = 0;
+				return TRUE;
+
+			case RLE_ENDOFBITMAP:
+				*rows = 0;
+				*next_x = 0;
+				return TRUE;
+
+			case RLE_DELTA:
+			{
+				uint8_t delta_x = 0;
+				uint8_t delta_y = 0;
+				if (!reader.getByte(&delta_x) || !reader.getByte(&delta_y)) {
+					return FALSE;
+				}
+				x += delta_x;
+				if (delta_y > 0) {
+					*rows = delta_y;
+					*next_x = x;
+					return TRUE;
+				}
+				break;
+			}
+
+			default:
+			{
+				// Absolute mode, runs are padded to a 16-bit boundary
+				const size_t size = (bit_count == 4) ? (status_byte + 1) / 2 : status_byte;
+				if (!reader.getBytes(absolute, size + (size & 1))) {
+					return FALSE;
+				}
+				if (indices) {
+					for (int i = 0; (i < status_byte) && (x + i < width); i++) {
+						indices[x + i] = (bit_count == 4) ? (uint8_t)((i & 0x01) ? (absolute[i >> 1] & 0x0f) : (absolute[i >> 1] >> 4)) : absolute[i];
+					}
+				}
+				x += status_byte;
+				break;
+			}
+		}
+	}
+}
+
+namespace {
+
+	/**
+	Rows of uncompressed and RLE bitmaps with a Windows info header, read from the top of the image.
+	Uncompressed rows are read where they are stored, RLE rows from the commands indexed when the decoder is created.
+	*/
+	class BMPScanlineDecoder : public ScanlineDecoder
+	{
+	public:
+		struct RLERow {
+			uint64_t offset;	// position of the first command of the scanline, from the pixel data
+			int x;				// column of the first command
+		};
+
+		BMPScanlineDecoder(FIBITMAP *info, FreeImageIO *io, fi_handle handle, long bits_offset, unsigned compression, bool bottom_up, std::vector<RLERow> rle_rows)
+			: ScanlineDecoder(info), mIO(io), mHandle(handle), mBitsOffset(bits_offset), mCompression(compression), mBottomUp(bottom_up), mRLERows(std::move(rle_rows))
+		{ }
+
+		unsigned Read(uint8_t *buffer, unsigned count, unsigned pitch) override {
+			FIBITMAP *info = GetInfo();
+			const unsigned height = FreeImage_GetHeight(info);
+
+			unsigned n = 0;
+			for (; !mFailed && (mRow < height) && (n < count); n++, mRow++) {
+				const unsigned scanline = mBottomUp ? height - 1 - mRow : mRow;
+				const bool decoded = ((mCompression == BI_RLE4) || (mCompression == BI_RLE8)) ? ReadRLE(scanline, buffer + (size_t)n * pitch) : ReadRaw(scanline, buffer + (size_t)n * pitch);
+				if (!decoded) {
+					FreeImage_OutputMessageProc(s_format_id, "Error encountered while decoding BMP data");
+					mFailed = true;
+					break;
+				}
+			}
+			return n;
+		}
+
+	private:
+		bool ReadRaw(unsigned scanline, uint8_t *bits) {
+			FIBITMAP *info = GetInfo();
+			const unsigned line = FreeImage_GetLine(info);
+
+			mIO->seek_proc(mHandle, mBitsOffset + (long)scanline * (long)CalculatePitch(line), SEEK_SET);
+			if (mIO->read_proc(bits, line, 1, mHandle) != 1) {
+				return false;
+			}
+
+			// swap as needed
+#ifdef FREEIMAGE_BIGENDIAN
+			if (FreeImage_GetBPP(info) == 16) {
+				auto *pixel = (uint16_t *)bits;
+				for (unsigned x = 0; x < FreeImage_GetWidth(info); x++) {
+					SwapShort(pixel++);
+				}
+			}
+#endif
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
+			const unsigned bit_count = FreeImage_GetBPP(info);
+			if ((bit_count == 24) || (bit_count == 32)) {
+				for (unsigned x = 0; x < FreeImage_GetWidth(info); x++) {
+					INPLACESWAP(bits[0], bits[2]);
+					bits += (bit_count >> 3);
+				}
+			}
+#endif
+			return true;
+		}
+
+		bool ReadRLE(unsigned scanline, uint8_t *bits) {
+			FIBITMAP *info = GetInfo();
+			const int width = (int)FreeImage_GetWidth(info);
+			const unsigned bit_count = FreeImage_GetBPP(info);
+
+			// pixels which no command reaches are left to 0
+			mIndices.assign(width, 0);
+			const RLERow &row = mRLERows[scanline];
+			if (row.offset != UINT64_MAX) {
+				mIO->seek_proc(mHandle, mBitsOffset + (long)row.offset, SEEK_SET);
+				RLEReader reader(mIO, mHandle);
+				int rows = 0, next_x = 0;
+				if (!DecodeRLERow(reader, bit_count, width, row.x, mIndices.data(), &rows, &next_x)) {
+					return false;
+				}
+			}
+
+			if (bit_count == 4) {
+				memset(bits, 0, FreeImage_GetLine(info));
+				for (int x = 0; x < width; x++) {
+					bits[x >> 1] |= (x & 0x01) ? mIndices[x] : (uint8_t)(mIndices[x] << 4);
+				}
+			} else {
+				memcpy(bits, mIndices.data(), width);
+			}
+			return true;
+		}
+
+		FreeImageIO *mIO;
+		fi_handle mHandle;
+		long mBitsOffset;
+		unsigned mCompression;
+		bool mBottomUp;
+		std::vector<RLERow> mRLERows;
+		std::vector<uint8_t> mIndices;
+		unsigned mRow{ 0 };
+		bool mFailed{ false };
+	};
+
+} // namespace
+
+std::unique_ptr<ScanlineDecoder>
+CreateScanlineDecoderBMP(FreeImageIO *io, fi_handle handle, int flags) {
+	const long start = io->tell_proc(handle);
+
+	BITMAPFILEHEADER bitmapfileheader;
+	FIBITMAPINFOHEADER bih;
+	if ((io->read_proc(&bitmapfileheader, sizeof(BITMAPFILEHEADER), 1, handle) != 1) || (io->read_proc(&bih, sizeof(FIBITMAPINFOHEADER), 1, handle) != 1)) {
+		return nullptr;
+	}
+#ifdef FREEIMAGE_BIGENDIAN
+	SwapFileHeader(&bitmapfileheader);
+	SwapInfoHeader(&bih);
+#endif
+
+	// OS/2 bitmaps and the compressions other than RLE are loaded whole
+	switch (bih.biSize) {
+		case 40:
+		case 52:
+		case 56:
+		case 108:
+		case 124:
+			break;
+		default:
+			return nullptr;
+	}
+	const unsigned bit_count = bih.biBitCount;
+	const unsigned compression = bih.biCompression;
+	switch (compression) {
+		case BI_RGB:
+			break;
+		case BI_RLE4:
+		case BI_RLE8:
+			if ((bih.biHeight < 0) || (bit_count != ((compression == BI_RLE4) ? 4U : 8U))) {
+				return nullptr;
+			}
+			break;
+		case BI_BITFIELDS:
+		case BI_ALPHABITFIELDS:
+			if (bit_count < 16) {
+				return nullptr;
+			}
+			break;
+		default:
+			return nullptr;
+	}
+
+	io->seek_proc(handle, start, SEEK_SET);
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> info(Load(io, handle, -1, flags | FIF_LOAD_NOPIXELS, nullptr), &FreeImage_Unload);
+	if (!info) {
+		return nullptr;
+	}
+	if (bit_count == 32) {
+		FreeImage_SetTransparent(info.get(), FreeImage_GetColorType(info.get()) == FIC_RGBALPHA);
+	}
+	const long bits_offset = start + (long)bitmapfileheader.bfOffBits;
+
+	std::vector<BMPScanlineDecoder::RLERow> rle_rows;
+	if ((compression == BI_RLE4) || (compression == BI_RLE8)) {
+		// index the first command of each scanline, this checks the whole stream
+		const int width = (int)FreeImage_GetWidth(info.get());
+		const int height = (int)FreeImage_GetHeight(info.get());
+		rle_rows.assign(height, { UINT64_MAX, 0 });
+
+		io->seek_proc(handle, bits_offset, SEEK_SET);
+		RLEReader reader(io, handle);
+		int scanline = 0, x = 0;
+		while (scanline < height) {
+			rle_rows[scanline] = { reader.Tell(), x };
+			int rows = 0;
+			if (!DecodeRLERow(reader, bit_count, width, x, nullptr, &rows, &x)) {
+				return nullptr;
+			}
+			if (rows == 0) {
+				break;
+			}
+			scanline += rows;
+		}
+	}
+
+	auto decoder = std::make_unique<BMPScanlineDecoder>(info.get(), io, handle, bits_offset, compression, bih.biHeight > 0, std::move(rle_rows));
+	info.release();
+	return decoder;
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
@@ -1506,4 +1969,6 @@ InitBMP(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;	// not implemented yet;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
+	plugin->get_image_info_proc = GetImageInfo;
 }
@@ -99,6 +99,11 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD;
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -204,7 +209,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		return dib.release();
 
 	} catch(const char* text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 	}
 	return nullptr;
 }
@@ -233,4 +238,5 @@ InitCUT(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
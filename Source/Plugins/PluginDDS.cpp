@@ -23,6 +23,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "DDSBlockDecoder.h"
+#include "DDSBlockEncoder.h"
 
 // ----------------------------------------------------------
 //   Definitions for the RGB 444 format
@@ -287,51 +289,60 @@ typedef struct tagDDSHEADER {
 #define FOURCC_DXT3	MAKEFOURCC('D','X','T','3')
 #define FOURCC_DXT4	MAKEFOURCC('D','X','T','4')
 #define FOURCC_DXT5	MAKEFOURCC('D','X','T','5')
+#define FOURCC_ATI1	MAKEFOURCC('A','T','I','1')
+#define FOURCC_ATI2	MAKEFOURCC('A','T','I','2')
+#define FOURCC_BC4U	MAKEFOURCC('B','C','4','U')
+#define FOURCC_BC4S	MAKEFOURCC('B','C','4','S')
+#define FOURCC_BC5U	MAKEFOURCC('B','C','5','U')
+#define FOURCC_BC5S	MAKEFOURCC('B','C','5','S')
+#define FOURCC_DX10	MAKEFOURCC('D','X','1','0')
 
-// ----------------------------------------------------------
-//   Structures used by DXT textures
-// ----------------------------------------------------------
+/**
+DDS_HEADER_DXT10 structure, follows DDS_HEADER when the FourCC is DX10
+*/
+typedef struct tagDDSHEADERDXT10 {
+	uint32_t dxgiFormat;		//! DXGI_FORMAT of the surface
+	uint32_t resourceDimension;	//! D3D10_RESOURCE_DIMENSION (texture 1D, 2D or 3D)
+	uint32_t miscFlag;			//! D3D10_RESOURCE_MISC_TEXTURECUBE for a cube map
+	uint32_t arraySize;			//! Number of elements of a texture array
+	uint32_t miscFlags2;		//! Alpha mode (straight, premultiplied, opaque or custom)
+} DDSHEADERDXT10;
 
-typedef struct tagColor8888 {
-	uint8_t b;
-	uint8_t g;
-	uint8_t r;
-	uint8_t a;
-} Color8888;
-
-typedef struct tagColor565 {
-	uint16_t b : 5;
-	uint16_t g : 6;
-	uint16_t r : 5;
-} Color565;
-
-typedef struct tagDXTColBlock {
-	Color565 colors[2];
-	uint8_t row[4];
-} DXTColBlock;
-
-typedef struct tagDXTAlphaBlockExplicit {
-	uint16_t row[4];
-} DXTAlphaBlockExplicit;
-
-typedef struct tagDXTAlphaBlock3BitLinear {
-	uint8_t alpha[2];
-	uint8_t data[6];
-} DXTAlphaBlock3BitLinear;
-
-typedef struct tagDXT1Block {
-	DXTColBlock color;
-} DXT1Block;
-
-typedef struct tagDXT3Block {		// also used by dxt2
-	DXTAlphaBlockExplicit alpha;
-	DXTColBlock color;
-} DXT3Block;
-
-typedef struct tagDXT5Block {		// also used by dxt4
-	DXTAlphaBlock3BitLinear alpha;
-	DXTColBlock color;
-} DXT5Block;
+/**
+DXGI formats loaded by the plugin
+*/
+enum {
+	DXGI_FORMAT_R8G8B8A8_TYPELESS = 27,
+	DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+	DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+	DXGI_FORMAT_BC1_TYPELESS = 70,
+	DXGI_FORMAT_BC1_UNORM = 71,
+	DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+	DXGI_FORMAT_BC2_TYPELESS = 73,
+	DXGI_FORMAT_BC2_UNORM = 74,
+	DXGI_FORMAT_BC2_UNORM_SRGB = 75,
+	DXGI_FORMAT_BC3_TYPELESS = 76,
+	DXGI_FORMAT_BC3_UNORM = 77,
+	DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+	DXGI_FORMAT_BC4_TYPELESS = 79,
+	DXGI_FORMAT_BC4_UNORM = 80,
+	DXGI_FORMAT_BC4_SNORM = 81,
+	DXGI_FORMAT_BC5_TYPELESS = 82,
+	DXGI_FORMAT_BC5_UNORM = 83,
+	DXGI_FORMAT_BC5_SNORM = 84,
+	DXGI_FORMAT_B8G8R8A8_UNORM = 87,
+	DXGI_FORMAT_B8G8R8X8_UNORM = 88,
+	DXGI_FORMAT_B8G8R8A8_TYPELESS = 90,
+	DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91,
+	DXGI_FORMAT_B8G8R8X8_TYPELESS = 92,
+	DXGI_FORMAT_B8G8R8X8_UNORM_SRGB = 93,
+	DXGI_FORMAT_BC6H_TYPELESS = 94,
+	DXGI_FORMAT_BC6H_UF16 = 95,
+	DXGI_FORMAT_BC6H_SF16 = 96,
+	DXGI_FORMAT_BC7_TYPELESS = 97,
+	DXGI_FORMAT_BC7_UNORM = 98,
+	DXGI_FORMAT_BC7_UNORM_SRGB = 99
+};
 
 #ifdef _WIN32
 #	pragma pack(pop)
@@ -356,258 +367,225 @@ SwapHeader(DDSHEADER *header) {
 	for (int i=0; i<11; i++) {
 		SwapLong(&header->surfaceDesc.dwReserved1[i]);
 	}
-	SwapLong(&header->surfaceDesc.ddpfPixelFormat.dwSize);
-	SwapLong(&header->surfaceDesc.ddpfPixelFormat.dwFlags);
-	SwapLong(&header->surfaceDesc.ddpfPixelFormat.dwFourCC);
-	SwapLong(&header->surfaceDesc.ddpfPixelFormat.dwRGBBitCount);
-	SwapLong(&header->surfaceDesc.ddpfPixelFormat.dwRBitMask);
-	SwapLong(&header->surfaceDesc.ddpfPixelFormat.dwGBitMask);
-	SwapLong(&header->surfaceDesc.ddpfPixelFormat.dwBBitMask);
-	SwapLong(&header->surfaceDesc.ddpfPixelFormat.dwRGBAlphaBitMask);
+	SwapLong(&header->surfaceDesc.ddspf.dwSize);
+	SwapLong(&header->surfaceDesc.ddspf.dwFlags);
+	SwapLong(&header->surfaceDesc.ddspf.dwFourCC);
+	SwapLong(&header->surfaceDesc.ddspf.dwRGBBitCount);
+	SwapLong(&header->surfaceDesc.ddspf.dwRBitMask);
+	SwapLong(&header->surfaceDesc.ddspf.dwGBitMask);
+	SwapLong(&header->surfaceDesc.ddspf.dwBBitMask);
+	SwapLong(&header->surfaceDesc.ddspf.dwRGBAlphaBitMask);
 	SwapLong(&header->surfaceDesc.ddsCaps.dwCaps1);
 	SwapLong(&header->surfaceDesc.ddsCaps.dwCaps2);
 	SwapLong(&header->surfaceDesc.ddsCaps.dwReserved[0]);
 	SwapLong(&header->surfaceDesc.ddsCaps.dwReserved[1]);
 	SwapLong(&header->surfaceDesc.dwReserved2);
 }
+
+static void
+SwapHeaderDXT10(DDSHEADERDXT10 *header) {
+	SwapLong(&header->dxgiFormat);
+	SwapLong(&header->resourceDimension);
+	SwapLong(&header->miscFlag);
+	SwapLong(&header->arraySize);
+	SwapLong(&header->miscFlags2);
+}
 #endif
 
+// ==========================================================
+// Plugin Interface
 // ==========================================================
 
-/**
-Get the 4 possible colors for a block
-*/
-static void 
-GetBlockColors(const DXTColBlock *block, Color8888 colors[4], bool isDXT1) {
-
-	// expand from 565 to 888
-	for (int i = 0; i < 2; i++)	{
-		colors[i].a = 0xFF;
-		/*
-		colors[i].r = (uint8_t)(unsigned(block->colors[i].r) * 0xFF / 0x1F);
-		colors[i].g = (uint8_t)(unsigned(block->colors[i].g) * 0xFF / 0x3F);
-		colors[i].b = (uint8_t)(unsigned(block->colors[i].b) * 0xFF / 0x1F);
-		*/
-		colors[i].r = (uint8_t)((unsigned(block->colors[i].r) << 3U) | (unsigned(block->colors[i].r) >> 2U));
-		colors[i].g = (uint8_t)((unsigned(block->colors[i].g) << 2U) | (unsigned(block->colors[i].g) >> 4U));
-		colors[i].b = (uint8_t)((unsigned(block->colors[i].b) << 3U) | (unsigned(block->colors[i].b) >> 2U));
-	}
-
-	const uint16_t *wCol = (uint16_t *)block->colors;
-	if ((wCol[0] > wCol[1]) || !isDXT1) {
-		// 4 color block
-		for (unsigned i = 0; i < 2; i++)	{
-			colors[i + 2].a = 0xFF;
-			colors[i + 2].r = (uint8_t)((unsigned(colors[0].r) * (2 - i) + unsigned(colors[1].r) * (1 + i)) / 3);
-			colors[i + 2].g = (uint8_t)((unsigned(colors[0].g) * (2 - i) + unsigned(colors[1].g) * (1 + i)) / 3);
-			colors[i + 2].b = (uint8_t)((unsigned(colors[0].b) * (2 - i) + unsigned(colors[1].b) * (1 + i)) / 3);
-		}
-	}
-	else {
-		// 3 color block, number 4 is transparent
-		colors[2].a = 0xFF;
-		colors[2].r = (uint8_t)((unsigned(colors[0].r) + unsigned(colors[1].r)) / 2);
-		colors[2].g = (uint8_t)((unsigned(colors[0].g) + unsigned(colors[1].g)) / 2);
-		colors[2].b = (uint8_t)((unsigned(colors[0].b) + unsigned(colors[1].b)) / 2);
-
-		colors[3].a = 0x00;
-		colors[3].g = 0x00;
-		colors[3].b = 0x00;
-		colors[3].r = 0x00;
-	}
-}
+static int s_format_id;
 
-typedef struct DXT_INFO_1 {
-	typedef DXT1Block Block;
-	enum {
-		isDXT1 = 1,
-		bytesPerBlock = 8
-	};
-} DXT_INFO_1;
-
-typedef struct DXT_INFO_3 {
-	typedef DXT3Block Block;
-	enum {
-		isDXT1 = 1,
-		bytesPerBlock = 16
-	};
-} DXT_INFO_3;
-
-typedef struct DXT_INFO_5 {
-	typedef DXT5Block Block;
-	enum {
-		isDXT1 = 1,
-		bytesPerBlock = 16
-	};
-} DXT_INFO_5;
+// ==========================================================
+// Internal functions
+// ==========================================================
 
 /**
-Base decoder
+Surface format of a DDS file
 */
-template <class DXT_INFO> class DXT_BLOCKDECODER_BASE {
-protected:
-	Color8888 m_colors[4];
-	const typename DXT_INFO::Block *m_pBlock;
-	unsigned m_colorRow;
-
-public:
-	void Setup(const uint8_t *pBlock) {
-		// get a pointer to the block
-		m_pBlock = (const typename DXT_INFO::Block *)pBlock;
+typedef struct tagDDSFormat {
+	bool compressed;		//! true for block compressed data
+	BCFormat bc;			//! blocks format of compressed data
+	DDPIXELFORMAT ddspf;	//! pixel format of uncompressed data
+} DDSFormat;
 
-		// get the 4 possible colors for a block
-		GetBlockColors(&m_pBlock->color, m_colors, DXT_INFO::isDXT1);
-	}
+/**
+Get the surface format from the pixel format, or from the DX10 header which follows the DDS header
+@return Returns false if the format isn't supported
+*/
+static bool
+GetSurfaceFormat(const DDSURFACEDESC2 *desc, FreeImageIO *io, fi_handle handle, DDSFormat *format) {
+	const DDPIXELFORMAT *ddspf = &(desc->ddspf);
+	format->compressed = false;
+	format->ddspf = *ddspf;
 
-	/**
-	Update y scanline
-	*/
-	void SetY(const int y) {
-		m_colorRow = m_pBlock->color.row[y];
+	if ((ddspf->dwFlags & DDPF_RGB) == DDPF_RGB) {
+		// uncompressed data
+		return true;
 	}
-
-	/**
-	Get Color at (x, y) where y is set by SetY
-	@see SetY
-	*/
-	void GetColor(const int x, Color8888 *color) {
-		unsigned bits = (m_colorRow >> (x * 2)) & 3;
-		memcpy(color, &m_colors[bits], sizeof(Color8888));
+	if ((ddspf->dwFlags & DDPF_FOURCC) != DDPF_FOURCC) {
+		return false;
 	}
 
-};
-
-class DXT_BLOCKDECODER_1 : public DXT_BLOCKDECODER_BASE<DXT_INFO_1> {
-public:
-	typedef DXT_INFO_1 INFO;
-};
-
-class DXT_BLOCKDECODER_3 : public DXT_BLOCKDECODER_BASE<DXT_INFO_3> {
-public:
-	typedef DXT_BLOCKDECODER_BASE<DXT_INFO_3> base;
-	typedef DXT_INFO_3 INFO;
-
-protected:
-	unsigned m_alphaRow;
-
-public:
-	void SetY(int y) {
-		base::SetY(y);
-		m_alphaRow = m_pBlock->alpha.row[y];
+	// compressed data
+	format->compressed = true;
+	switch (ddspf->dwFourCC) {
+		case FOURCC_DXT1:
+			format->bc = BCFormat::BC1;
+			return true;
+		case FOURCC_DXT2:
+		case FOURCC_DXT3:
+			format->bc = BCFormat::BC2;
+			return true;
+		case FOURCC_DXT4:
+		case FOURCC_DXT5:
+			format->bc = BCFormat::BC3;
+			return true;
+		case FOURCC_ATI1:
+		case FOURCC_BC4U:
+			format->bc = BCFormat::BC4U;
+			return true;
+		case FOURCC_BC4S:
+			format->bc = BCFormat::BC4S;
+			return true;
+		case FOURCC_ATI2:
+		case FOURCC_BC5U:
+			format->bc = BCFormat::BC5U;
+			return true;
+		case FOURCC_BC5S:
+			format->bc = BCFormat::BC5S;
+			return true;
+		case FOURCC_DX10:
+			break;
+		default:
+			return false;
 	}
 
-	/**
-	Get the color at (x, y) where y is set by SetY
-	@see SetY
-	*/
-	void GetColor(int x, Color8888 *color) {
-		base::GetColor(x, color);
-		const unsigned bits = (m_alphaRow >> (x * 4)) & 0xF;
-		color->a = (uint8_t)((bits * 0xFF) / 0xF);
+	// DX10 extended header
+	DDSHEADERDXT10 header10;
+	memset(&header10, 0, sizeof(header10));
+	if (io->read_proc(&header10, sizeof(header10), 1, handle) != 1) {
+		return false;
 	}
-};
+#ifdef FREEIMAGE_BIGENDIAN
+	SwapHeaderDXT10(&header10);
+#endif
 
-class DXT_BLOCKDECODER_5 : public DXT_BLOCKDECODER_BASE<DXT_INFO_5> {
-public:
-	typedef DXT_BLOCKDECODER_BASE<DXT_INFO_5> base;
-	typedef DXT_INFO_5 INFO;
-
-protected:
-	unsigned m_alphas[8];
-	unsigned m_alphaBits;
-	int m_offset;
-
-public:
-	void Setup (const uint8_t *pBlock) {
-		base::Setup (pBlock);
-
-		const DXTAlphaBlock3BitLinear &block = m_pBlock->alpha;
-		m_alphas[0] = block.alpha[0];
-		m_alphas[1] = block.alpha[1];
-		if (m_alphas[0] > m_alphas[1]) {
-			// 8 alpha block
-			for (int i = 0; i < 6; i++) {
-				m_alphas[i + 2] = ((6 - i) * m_alphas[0] + (1 + i) * m_alphas[1] + 3) / 7;
-			}
-		}
-		else {
-			// 6 alpha block
-			for (int i = 0; i < 4; i++) {
-				m_alphas[i + 2] = ((4 - i) * m_alphas[0] + (1 + i) * m_alphas[1] + 2) / 5;
-			}
-			m_alphas[6] = 0;
-			m_alphas[7] = 0xFF;
-		}
+	switch (header10.dxgiFormat) {
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			format->bc = BCFormat::BC1;
+			return true;
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+			format->bc = BCFormat::BC2;
+			return true;
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			format->bc = BCFormat::BC3;
+			return true;
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+			format->bc = BCFormat::BC4U;
+			return true;
+		case DXGI_FORMAT_BC4_SNORM:
+			format->bc = BCFormat::BC4S;
+			return true;
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+			format->bc = BCFormat::BC5U;
+			return true;
+		case DXGI_FORMAT_BC5_SNORM:
+			format->bc = BCFormat::BC5S;
+			return true;
+		case DXGI_FORMAT_BC6H_TYPELESS:
+		case DXGI_FORMAT_BC6H_UF16:
+			format->bc = BCFormat::BC6HU;
+			return true;
+		case DXGI_FORMAT_BC6H_SF16:
+			format->bc = BCFormat::BC6HS;
+			return true;
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			format->bc = BCFormat::BC7;
+			return true;
+		default:
+			break;
 	}
 
-	void SetY(const int y) {
-		base::SetY(y);
-		const int i = y / 2;
-		const DXTAlphaBlock3BitLinear &block = m_pBlock->alpha;
-		const uint8_t *data = &block.data[i * 3];
-		m_alphaBits = unsigned(data[0]) | (unsigned(data[1]) << 8) | (unsigned(data[2]) << 16);
-		m_offset = (y & 1) * 12;
+	// uncompressed DXGI formats, described with the equivalent pixel format
+	format->compressed = false;
+	DDPIXELFORMAT *pf = &(format->ddspf);
+	pf->dwFlags = DDPF_RGB | DDPF_ALPHAPIXELS;
+	pf->dwRGBBitCount = 32;
+	pf->dwGBitMask = 0x0000FF00;
+	pf->dwRGBAlphaBitMask = 0xFF000000;
+	switch (header10.dxgiFormat) {
+		case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+			pf->dwRBitMask = 0x000000FF;
+			pf->dwBBitMask = 0x00FF0000;
+			return true;
+		case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+		case DXGI_FORMAT_B8G8R8X8_UNORM:
+		case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+			pf->dwFlags = DDPF_RGB;
+			pf->dwRGBAlphaBitMask = 0;
+			// fall through
+		case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+			pf->dwRBitMask = 0x00FF0000;
+			pf->dwBBitMask = 0x000000FF;
+			return true;
+		default:
+			return false;
 	}
+}
 
-	/**
-	Get the color at (x, y) where y is set by SetY
-	@see SetY
-	*/
-	void GetColor(int x, Color8888 *color) {
-		base::GetColor(x, color);
-		unsigned bits = (m_alphaBits >> (x * 3 + m_offset)) & 7;
-		color->a = (uint8_t)m_alphas[bits];
+/**
+Get the size of a mipmap level in the file
+@param desc DDS_HEADER structure
+@param format Surface format
+@param level Mipmap level
+*/
+static uint64_t
+GetLevelSize(const DDSURFACEDESC2 *desc, const DDSFormat *format, unsigned level) {
+	const unsigned width = std::max(1U, desc->dwWidth >> level);
+	const unsigned height = std::max(1U, desc->dwHeight >> level);
+	if (format->compressed) {
+		return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * GetBCBlockSize(format->bc);
 	}
-};
-
-template <class DECODER> void DecodeDXTBlock (uint8_t *dstData, const uint8_t *srcBlock, long dstPitch, int bw, int bh) {
-	DECODER decoder;
-	decoder.Setup(srcBlock);
-	uint8_t *dstRow = dstData;
-	for (int y = 0; y < bh; y++) {
-		uint8_t *dst = dstRow;
-		// update scanline
-		decoder.SetY(y);
-		for (int x = 0; x < bw; x++) {
-			// GetColor(x, y, dst)
-			Color8888 *color = (Color8888*)dst;
-			decoder.GetColor(x, color);
-
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB 
-			INPLACESWAP(dst[FI_RGBA_RED], dst[FI_RGBA_BLUE]);
-#endif 
-			dst += 4;
-		}
-		dstRow -= dstPitch;
+	uint64_t pitch = CalculateLine(width, format->ddspf.dwRGBBitCount);
+	if ((level == 0) && ((desc->dwFlags & DDSD_PITCH) == DDSD_PITCH)) {
+		pitch = desc->dwPitchOrLinearSize;
 	}
+	return pitch * height;
 }
 
-// ==========================================================
-// Plugin Interface
-// ==========================================================
-
-static int s_format_id;
-
-// ==========================================================
-// Internal functions
-// ==========================================================
-
 /**
-@param desc DDS_HEADER structure
+@param ddspf Pixel format
+@param width Image width
+@param height Image height
+@param filePitch Size of a line in the file
 @param io FreeImage IO
 @param handle FreeImage handle
+@param header_only Allocate the dib header only
 */
 static FIBITMAP *
-LoadRGB(const DDSURFACEDESC2 *desc, FreeImageIO *io, fi_handle handle) {
+LoadRGB(const DDPIXELFORMAT *ddspf, int width, int height, int filePitch, FreeImageIO *io, fi_handle handle, FIBOOL header_only) {
 	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
 	DDSFormat16 format16 = RGB_UNKNOWN;	// for 16-bit formats
 
-	const DDPIXELFORMAT *ddspf = &(desc->ddspf);
-
 	// it is perfectly valid for an uncompressed DDS file to have a width or height which is not a multiple of 4
 	// (only the packed image formats need to be a multiple of 4)
-	const int width = (int)desc->dwWidth;
-	const int height = (int)desc->dwHeight;
 
 	// check the bitdepth, then allocate a new dib
 	const int bpp = (int)ddspf->dwRGBBitCount;
@@ -615,20 +593,31 @@ LoadRGB(const DDSURFACEDESC2 *desc, FreeImageIO *io, fi_handle handle) {
 		// get the 16-bit format
 		format16 = GetRGB16Format(ddspf->dwRBitMask, ddspf->dwGBitMask, ddspf->dwBBitMask);
 		// allocate a 24-bit dib, conversion from 16- to 24-bit will be done later
-		dib.reset(FreeImage_Allocate(width, height, 24));
+		dib.reset(FreeImage_AllocateHeader(header_only, width, height, 24));
+	}
+	else if ((bpp == 24) || (bpp == 32)) {
+		// red and blue are swapped to the dib order after reading
+		dib.reset(FreeImage_AllocateHeader(header_only, width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 	}
 	else {
-		dib.reset(FreeImage_Allocate(width, height, bpp, ddspf->dwRBitMask, ddspf->dwGBitMask, ddspf->dwBBitMask));
+		dib.reset(FreeImage_AllocateHeader(header_only, width, height, bpp, ddspf->dwRBitMask, ddspf->dwGBitMask, ddspf->dwBBitMask));
 	}
 	if (!dib) {
 		return nullptr;
 	}
 
+	// enable transparency
+	FIBOOL bIsTransparent = (bpp != 16) && ((ddspf->dwFlags & DDPF_ALPHAPIXELS) == DDPF_ALPHAPIXELS) ? TRUE : FALSE;
+	FreeImage_SetTransparent(dib.get(), bIsTransparent);
+
+	if (header_only) {
+		return dib.release();
+	}
+
 	// read the file
 	// -------------------------------------------------------------------------
 
 	const int line = CalculateLine(width, bpp);
-	const int filePitch = ((desc->dwFlags & DDSD_PITCH) == DDSD_PITCH) ? (int)desc->dwPitchOrLinearSize : line;
 	const long delta = (long)filePitch - (long)line;
 
 	if (bpp == 16) {
@@ -651,24 +640,20 @@ LoadRGB(const DDSURFACEDESC2 *desc, FreeImageIO *io, fi_handle handle) {
 			io->read_proc(pixels, 1, line, handle);
 			io->seek_proc(handle, delta, SEEK_CUR);
 		}
-	}
-
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
-	// Calculate the number of bytes per pixel (3 for 24-bit or 4 for 32-bit)
-	const int bytespp = FreeImage_GetLine(dib.get()) / width;
 
-	for (int y = 0; y < height; y++) {
-		uint8_t *pixels = FreeImage_GetScanLine(dib.get(), y);
-		for (int x = 0; x < width; x++) {
-			INPLACESWAP(pixels[FI_RGBA_RED], pixels[FI_RGBA_BLUE]);
-			pixels += bytespp;
+		// swap red and blue when the file order (BGR unless the red mask is the low byte) isn't the dib order
+		const bool fileIsRGB = (ddspf->dwRBitMask == 0xFF);
+		if (((bpp == 24) || (bpp == 32)) && (fileIsRGB != (FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB))) {
+			const int bytespp = bpp / 8;
+			for (int y = 0; y < height; y++) {
+				uint8_t *pixels = FreeImage_GetScanLine(dib.get(), y);
+				for (int x = 0; x < width; x++) {
+					INPLACESWAP(pixels[FI_RGBA_RED], pixels[FI_RGBA_BLUE]);
+					pixels += bytespp;
+				}
+			}
 		}
 	}
-#endif
-	
-	// enable transparency
-	FIBOOL bIsTransparent = (bpp != 16) && ((ddspf->dwFlags & DDPF_ALPHAPIXELS) == DDPF_ALPHAPIXELS) ? TRUE : FALSE;
-	FreeImage_SetTransparent(dib.get(), bIsTransparent);
 
 	if (!bIsTransparent && bpp == 32) {
 		// no transparency: convert to 24-bit
@@ -680,106 +665,139 @@ LoadRGB(const DDSURFACEDESC2 *desc, FreeImageIO *io, fi_handle handle) {
 }
 
 /**
-@param io FreeImage IO
-@param handle FreeImage handle
-@param dib Returned dib (already allocated)
+Decode block compressed data, rows of blocks are decoded in parallel
+@param format Blocks format
 @param width Image width
 @param height Image height
-*/
-template <class DECODER> static void 
-LoadDXT_Helper(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, int width, int height) {
-	typedef typename DECODER::INFO INFO;
-	typedef typename INFO::Block Block;
-
-	// get the size of a line in bytes
-	int line = CalculateLine(width, FreeImage_GetBPP(dib));
-
-	Block *input_buffer = new(std::nothrow) Block[(width + 3) / 4];
-	if (!input_buffer) {
-		return;
-	}
-
-	const int widthRest = (int) width & 3;
-	const int heightRest = (int) height & 3;
-	const int inputLine = (width + 3) / 4;
-	int y = 0;
-
-	if (height >= 4) {
-		for (; y < height; y += 4) {
-			io->read_proc (input_buffer, sizeof(typename INFO::Block), inputLine, handle);
-			// TODO: probably need some endian work here
-			const uint8_t *pbSrc = (uint8_t *)input_buffer;
-			uint8_t *pbDst = FreeImage_GetScanLine (dib, height - y - 1);
-
-			if (width >= 4) {
-				for (int x = 0; x < width; x += 4) {
-					DecodeDXTBlock<DECODER>(pbDst, pbSrc, line, 4, 4);
-					pbSrc += INFO::bytesPerBlock;
-					pbDst += 16;	// 4 * 4;
-				}
-			}
-			if (widthRest) {
-				DecodeDXTBlock<DECODER>(pbDst, pbSrc, line, widthRest, 4);
-			}
-		}
-	}
-	if (heightRest)	{
-		io->read_proc (input_buffer, sizeof (typename INFO::Block), inputLine, handle);
-		// TODO: probably need some endian work here
-		const uint8_t *pbSrc = (uint8_t *)input_buffer;
-		uint8_t *pbDst = FreeImage_GetScanLine (dib, height - y - 1);
-
-		if (width >= 4) {
-			for (int x = 0; x < width; x += 4) {
-				DecodeDXTBlock<DECODER>(pbDst, pbSrc, line, 4, heightRest);
-				pbSrc += INFO::bytesPerBlock;
-				pbDst += 16;	// 4 * 4;
-			}
-		}
-		if (widthRest) {
-			DecodeDXTBlock<DECODER>(pbDst, pbSrc, line, widthRest, heightRest);
-		}
-
-	}
-
-	delete [] input_buffer;
-}
-
-/**
-@param decoder_type Decoder to be used, either 1 (DXT1), 3 (DXT3) or 5 (DXT5)
-@param desc DDS_HEADER structure
 @param io FreeImage IO
 @param handle FreeImage handle
+@param header_only Allocate the dib header only
 */
 static FIBITMAP *
-LoadDXT(int decoder_type, const DDSURFACEDESC2 *desc, FreeImageIO *io, fi_handle handle) {
-	// get image size, rounded to 32-bit
-	int width = (int)desc->dwWidth & ~3;
-	int height = (int)desc->dwHeight & ~3;
-
-	// allocate a 32-bit dib
-	FIBITMAP *dib = FreeImage_Allocate(width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-	if (!dib) {
-		return nullptr;
-	}
+LoadBC(BCFormat format, unsigned width, unsigned height, FreeImageIO *io, fi_handle handle, FIBOOL header_only) {
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
 
-	// select the right decoder, then decode the image
-	switch (decoder_type) {
+	// allocate a dib matching the decoded pixels
+	const unsigned pixel_size = GetBCPixelSize(format);
+	switch (pixel_size) {
 		case 1:
-			LoadDXT_Helper<DXT_BLOCKDECODER_1>(io, handle, dib, width, height);
+			// greyscale palette
+			dib.reset(FreeImage_AllocateHeader(header_only, width, height, 8));
 			break;
 		case 3:
-			LoadDXT_Helper<DXT_BLOCKDECODER_3>(io, handle, dib, width, height);
+			dib.reset(FreeImage_AllocateHeader(header_only, width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 			break;
-		case 5:
-			LoadDXT_Helper<DXT_BLOCKDECODER_5>(io, handle, dib, width, height);
+		case 4:
+			dib.reset(FreeImage_AllocateHeader(header_only, width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 			break;
 		default:
+			dib.reset(FreeImage_AllocateHeaderT(header_only, FIT_RGBF, width, height));
 			break;
 	}
-	
-	return dib;
+	if (!dib || header_only) {
+		return dib.release();
+	}
+
+	// the image is stored as rows of 4x4 blocks, the last row and column may be partially used
+	const unsigned blocks_per_row = (width + 3) / 4;
+	const unsigned block_rows = (height + 3) / 4;
+	const size_t row_size = (size_t)blocks_per_row * GetBCBlockSize(format);
+	const size_t data_size = row_size * block_rows;
+
+	// read the blocks in place from memory streams, missing data of truncated files is decoded as zeros
+	std::vector<uint8_t> buffer;
+	uint64_t available = 0;
+	const uint8_t *data = FreeImage_PeekMemoryIO(io, handle, &available);
+	if (data && (available >= data_size)) {
+		io->seek_proc(handle, (long)data_size, SEEK_CUR);
+	}
+	else {
+		buffer.resize(data_size);
+		io->read_proc(buffer.data(), 1, (unsigned)data_size, handle);
+		data = buffer.data();
+	}
+
+	const size_t line = (size_t)width * pixel_size;
+	const size_t decoded_pitch = (size_t)blocks_per_row * 4 * pixel_size;
+
+	ParallelFor(0, block_rows, CalculateBandRows(4 * decoded_pitch), [&](unsigned first, unsigned last) {
+		std::vector<uint8_t> decoded(4 * decoded_pitch);
+		for (unsigned row = first; row < last; row++) {
+			DecodeBCBlockRow(format, data + row * row_size, blocks_per_row, decoded.data(), decoded_pitch);
+			for (unsigned y = 4 * row, i = 0; (i < 4) && (y < height); y++, i++) {
+				memcpy(FreeImage_GetScanLine(dib.get(), height - y - 1), decoded.data() + i * decoded_pitch, line);
+			}
+		}
+	});
+
+	return dib.release();
 }
+
+/**
+Write the pixels of a 24- or 32-bit dib, in BGR(A) order
+*/
+static FIBOOL
+SaveRGB(FIBITMAP *dib, FreeImageIO *io, fi_handle handle) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned bytespp = FreeImage_GetLine(dib) / width;
+	const unsigned line = width * bytespp;
+
+	std::vector<uint8_t> buffer(line);
+	for (unsigned y = 0; y < height; y++) {
+		memcpy(buffer.data(), FreeImage_GetConstScanLine(dib, height - y - 1), line);
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
+		uint8_t *pixels = buffer.data();
+		for (unsigned x = 0; x < width; x++) {
+			INPLACESWAP(pixels[FI_RGBA_RED], pixels[FI_RGBA_BLUE]);
+			pixels += bytespp;
+		}
+#endif
+		if (io->write_proc(buffer.data(), 1, line, handle) != line) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+Encode a 32-bit dib, rows of blocks are encoded in parallel
+@param format Blocks format
+@param quality Speed / quality trade-off
+@param dib 32-bit dib
+@param io FreeImage IO
+@param handle FreeImage handle
+*/
+static FIBOOL
+SaveBC(BCFormat format, BCQuality quality, FIBITMAP *dib, FreeImageIO *io, fi_handle handle) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned blocks_per_row = (width + 3) / 4;
+	const unsigned block_rows = (height + 3) / 4;
+	const size_t row_size = (size_t)blocks_per_row * GetBCBlockSize(format);
+
+	std::vector<uint8_t> blocks(row_size * block_rows);
+	const size_t pixels_pitch = (size_t)blocks_per_row * 4 * 4;
+
+	ParallelFor(0, block_rows, CalculateBandRows(4 * pixels_pitch), [&](unsigned first, unsigned last) {
+		std::vector<uint8_t> pixels(4 * pixels_pitch);
+		for (unsigned row = first; row < last; row++) {
+			// the last row and column of pixels fill the partially used blocks
+			for (unsigned i = 0; i < 4; i++) {
+				const unsigned y = std::min(4 * row + i, height - 1);
+				uint8_t *dst = pixels.data() + i * pixels_pitch;
+				memcpy(dst, FreeImage_GetConstScanLine(dib, height - y - 1), (size_t)width * 4);
+				for (unsigned x = width; x < 4 * blocks_per_row; x++) {
+					memcpy(dst + 4 * x, dst + 4 * (width - 1), 4);
+				}
+			}
+			EncodeBCBlockRow(format, quality, pixels.data(), pixels_pitch, blocks_per_row, blocks.data() + row * row_size);
+		}
+	});
+
+	return (io->write_proc(blocks.data(), 1, (unsigned)blocks.size(), handle) == blocks.size()) ? TRUE : FALSE;
+}
+
 // ==========================================================
 // Plugin Implementation
 // ==========================================================
@@ -828,12 +846,22 @@ Validate(FreeImageIO *io, fi_handle handle) {
 
 static FIBOOL DLL_CALLCONV
 SupportsExportDepth(int depth) {
-	return FALSE;
+	return ((depth == 24) || (depth == 32)) ? TRUE : FALSE;
 }
 
 static FIBOOL DLL_CALLCONV 
 SupportsExportType(FREE_IMAGE_TYPE type) {
-	return FALSE;
+	return (type == FIT_BITMAP) ? TRUE : FALSE;
+}
+
+static FIBOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
 }
 
 // ----------------------------------------------------------
@@ -852,47 +880,175 @@ Close(FreeImageIO *io, fi_handle handle, void *data) {
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	DDSHEADER header;
-	FIBITMAP *dib{};
+
+	const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
 	memset(&header, 0, sizeof(header));
 	io->read_proc(&header, 1, sizeof(header), handle);
 #ifdef FREEIMAGE_BIGENDIAN
 	SwapHeader(&header);
 #endif
-	
-	// values which indicate what type of data is in the surface, see DDPF_*
-	const uint32_t dwFlags = header.surfaceDesc.ddspf.dwFlags;
 
 	const DDSURFACEDESC2 *surfaceDesc = &(header.surfaceDesc);
+	if ((surfaceDesc->dwWidth == 0) || (surfaceDesc->dwHeight == 0)) {
+		return nullptr;
+	}
 
-	if ((dwFlags & DDPF_RGB) == DDPF_RGB) {
-		// uncompressed data
-		dib = LoadRGB(surfaceDesc, io, handle);
-	}
-	else if ((dwFlags & DDPF_FOURCC) == DDPF_FOURCC) {
-		// compressed data
-		switch (surfaceDesc->ddspf.dwFourCC) {
-			case FOURCC_DXT1:
-				dib = LoadDXT(1, surfaceDesc, io, handle);
-				break;
-			case FOURCC_DXT3:
-				dib = LoadDXT(3, surfaceDesc, io, handle);
-				break;
-			case FOURCC_DXT5:
-				dib = LoadDXT(5, surfaceDesc, io, handle);
-				break;
+	// values which indicate what type of data is in the surface, see DDPF_*
+	DDSFormat format;
+	if (!GetSurfaceFormat(surfaceDesc, io, handle, &format)) {
+		return nullptr;
+	}
+
+	// mipmap level to load, clamped to the levels of the file (each level halves the size down to 1x1)
+	unsigned levels = 1;
+	if (((surfaceDesc->dwFlags & DDSD_MIPMAPCOUNT) == DDSD_MIPMAPCOUNT) && (surfaceDesc->dwMipMapCount > 1)) {
+		levels = surfaceDesc->dwMipMapCount;
+	}
+	unsigned max_levels = 1;
+	while ((surfaceDesc->dwWidth >> max_levels) || (surfaceDesc->dwHeight >> max_levels)) {
+		max_levels++;
+	}
+	levels = std::min(levels, max_levels);
+	const unsigned level = std::min((unsigned)((flags >> 24) & 0x1F), levels - 1);
+
+	const unsigned width = std::max(1U, surfaceDesc->dwWidth >> level);
+	const unsigned height = std::max(1U, surfaceDesc->dwHeight >> level);
+
+	if (!header_only) {
+		// skip the larger levels
+		for (unsigned n = 0; n < level; n++) {
+			io->seek_proc(handle, (long)GetLevelSize(surfaceDesc, &format, n), SEEK_CUR);
 		}
 	}
 
-	return dib;
+	if (format.compressed) {
+		return LoadBC(format.bc, width, height, io, handle, header_only);
+	}
+
+	// uncompressed data
+	const int filePitch = (int)(GetLevelSize(surfaceDesc, &format, level) / height);
+	return LoadRGB(&format.ddspf, (int)width, (int)height, filePitch, io, handle, header_only);
 }
 
-/*
 static FIBOOL DLL_CALLCONV
 Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
-	return FALSE;
+	if (!dib || !handle || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
+		return FALSE;
+	}
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	if ((bpp != 24) && (bpp != 32)) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_UNSUPPORTED_FORMAT, FI_MSG_ERROR_UNSUPPORTED_FORMAT);
+		return FALSE;
+	}
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	// surface format
+	bool compressed = true;
+	BCFormat format = BCFormat::BC1;
+	if (flags & DDS_SAVE_BC7) {
+		format = BCFormat::BC7;
+	} else if (flags & DDS_SAVE_BC3) {
+		format = BCFormat::BC3;
+	} else if (!(flags & DDS_SAVE_BC1)) {
+		compressed = false;
+	}
+	BCQuality quality = BCQuality::Normal;
+	if (flags & DDS_SAVE_FAST) {
+		quality = BCQuality::Fast;
+	} else if (flags & DDS_SAVE_BEST) {
+		quality = BCQuality::Best;
+	}
+
+	// mipmap levels down to 1x1
+	unsigned levels = 1;
+	if (flags & DDS_SAVE_MIPMAPS) {
+		while ((width >> levels) || (height >> levels)) {
+			levels++;
+		}
+	}
+
+	// the block encoders read 32-bit pixels
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> level(nullptr, &FreeImage_Unload);
+	FIBITMAP *src = dib;
+	if (compressed && (bpp == 24)) {
+		level.reset(FreeImage_ConvertTo32Bits(dib));
+		if (!level) {
+			return FALSE;
+		}
+		src = level.get();
+	}
+
+	DDSHEADER header;
+	memset(&header, 0, sizeof(header));
+	header.dwMagic = MAKEFOURCC('D', 'D', 'S', ' ');
+	DDSURFACEDESC2 *desc = &(header.surfaceDesc);
+	desc->dwSize = sizeof(DDSURFACEDESC2);
+	desc->dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+	desc->dwHeight = height;
+	desc->dwWidth = width;
+	desc->ddspf.dwSize = sizeof(DDPIXELFORMAT);
+	desc->ddsCaps.dwCaps1 = DDSCAPS_TEXTURE;
+	if (levels > 1) {
+		desc->dwFlags |= DDSD_MIPMAPCOUNT;
+		desc->dwMipMapCount = levels;
+		desc->ddsCaps.dwCaps1 |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	}
+	if (compressed) {
+		desc->dwFlags |= DDSD_LINEARSIZE;
+		desc->dwPitchOrLinearSize = ((width + 3) / 4) * ((height + 3) / 4) * GetBCBlockSize(format);
+		desc->ddspf.dwFlags = DDPF_FOURCC;
+		desc->ddspf.dwFourCC = (format == BCFormat::BC7) ? FOURCC_DX10 : (format == BCFormat::BC3) ? FOURCC_DXT5 : FOURCC_DXT1;
+	} else {
+		desc->dwFlags |= DDSD_PITCH;
+		desc->dwPitchOrLinearSize = width * (bpp / 8);
+		desc->ddspf.dwFlags = DDPF_RGB | ((bpp == 32) ? DDPF_ALPHAPIXELS : 0);
+		desc->ddspf.dwRGBBitCount = bpp;
+		desc->ddspf.dwRBitMask = 0x00FF0000;
+		desc->ddspf.dwGBitMask = 0x0000FF00;
+		desc->ddspf.dwBBitMask = 0x000000FF;
+		desc->ddspf.dwRGBAlphaBitMask = (bpp == 32) ? 0xFF000000 : 0;
+	}
+#ifdef FREEIMAGE_BIGENDIAN
+	SwapHeader(&header);
+#endif
+	if (io->write_proc(&header, sizeof(header), 1, handle) != 1) {
+		return FALSE;
+	}
+
+	if (compressed && (format == BCFormat::BC7)) {
+		DDSHEADERDXT10 header10;
+		memset(&header10, 0, sizeof(header10));
+		header10.dxgiFormat = DXGI_FORMAT_BC7_UNORM;
+		header10.resourceDimension = 3;	// D3D10_RESOURCE_DIMENSION_TEXTURE2D
+		header10.arraySize = 1;
+#ifdef FREEIMAGE_BIGENDIAN
+		SwapHeaderDXT10(&header10);
+#endif
+		if (io->write_proc(&header10, sizeof(header10), 1, handle) != 1) {
+			return FALSE;
+		}
+	}
+
+	for (unsigned n = 0; n < levels; n++) {
+		if (n > 0) {
+			// each level is box filtered from the previous one
+			FIBITMAP *next = FreeImage_Rescale(src, (int)std::max(1U, width >> n), (int)std::max(1U, height >> n), FILTER_BOX);
+			if (!next) {
+				return FALSE;
+			}
+			level.reset(next);
+			src = next;
+		}
+		const FIBOOL bResult = compressed ? SaveBC(format, quality, src, io, handle) : SaveRGB(src, io, handle);
+		if (!bResult) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
 }
-*/
 
 // ==========================================================
 //   Init
@@ -911,10 +1067,12 @@ InitDDS(Plugin *plugin, int format_id) {
 	plugin->pagecount_proc = nullptr;
 	plugin->pagecapability_proc = nullptr;
 	plugin->load_proc = Load;
-	plugin->save_proc = nullptr;	//Save;	// not implemented (yet?)
+	plugin->save_proc = Save;
 	plugin->validate_proc = Validate;
 	plugin->mime_proc = MimeType;
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -32,13 +32,18 @@
 #include "OpenEXR/Iex.h"
 #include "OpenEXR/ImfOutputFile.h"
 #include "OpenEXR/ImfInputFile.h"
+#include "OpenEXR/ImfTiledInputFile.h"
 #include "OpenEXR/ImfRgbaFile.h"
 #include "OpenEXR/ImfChannelList.h"
 #include "OpenEXR/ImfRgba.h"
 #include "OpenEXR/ImfArray.h"
 #include "OpenEXR/ImfPreviewImage.h"
+#include "OpenEXR/ImfThreading.h"
 //#include "OpenEXR/Half/half.h"
 
+#include <algorithm>
+#include <mutex>
+
 
 // ==========================================================
 // Plugin Interface
@@ -48,6 +53,36 @@ static int s_format_id;
 
 // ----------------------------------------------------------
 
+/**
+Initializes the OpenEXR library on the first load or save, so that applications which never touch
+an EXR file don't pay for it in FreeImage_Initialise.
+Note that this OpenEXR function produce so called "false memory leaks"
+see http://lists.nongnu.org/archive/html/openexr-devel/2013-11/msg00000.html
+*/
+static void
+InitializeEXR() {
+	static std::once_flag s_initialized;
+	std::call_once(s_initialized, [] { Imf::staticInitialize(); });
+}
+
+/**
+Returns the number of threads OpenEXR decodes and encodes line blocks with.
+The OpenEXR global thread pool is sized after FreeImage_GetThreadCount, 0 means serial.
+*/
+static int
+GetEXRThreadCount() {
+	const int count = (int)FreeImage_GetThreadCount();
+	if (count < 2) {
+		return 0;
+	}
+	if (Imf::globalThreadCount() != count) {
+		Imf::setGlobalThreadCount(count);
+	}
+	return count;
+}
+
+// ----------------------------------------------------------
+
 /**
 FreeImage input stream wrapper
 @see Imf_2_2::IStream
@@ -160,7 +195,8 @@ SupportsExportType(FREE_IMAGE_TYPE type) {
 	return (
 		(type == FIT_FLOAT) ||
 		(type == FIT_RGBF)  ||
-		(type == FIT_RGBAF)
+		(type == FIT_RGBAF) ||
+		(type == FIT_RGBAH)
 	);
 }
 
@@ -169,16 +205,35 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // --------------------------------------------------------------------------
 
-static FIBITMAP * DLL_CALLCONV
-Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+/**
+Rectangle of the image to load (in pixels from the top left corner of the data window, right and bottom excluded), see FreeImage_LoadRegion
+*/
+struct EXRRegion {
+	unsigned left, top, right, bottom;
+};
+
+/**
+Loads an EXR image, the EXR_LEVEL of tiled mipmapped or ripmapped files, or the region of it when region isn't nullptr.
+Tiled files only decode the tiles intersecting the region, scanline files the line blocks of its rows,
+luminance / chroma files are decoded then cropped.
+*/
+static FIBITMAP *
+LoadEXR(FreeImageIO *io, fi_handle handle, int flags, const EXRRegion *region) {
 	bool bUseRgbaInterface = false;
 
 	if (!handle) {
 		return nullptr;
 	}
 
+	InitializeEXR();
+
 	try {
 		FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
@@ -188,17 +243,16 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		// wrap the FreeImage IO stream
 		C_IStream istream(io, handle);
 
-		// open the file
-		Imf::InputFile file(istream);
+		// open the file, the tiled and RGBA interfaces reopen the stream after this one is closed
+		auto file = std::make_unique<Imf::InputFile>(istream, GetEXRThreadCount());
+		const Imf::Header header = file->header();
 
 		// get file info
-		const Imath::Box2i &dataWindow = file.header().dataWindow();
-		int width  = dataWindow.max.x - dataWindow.min.x + 1;
-		int height = dataWindow.max.y - dataWindow.min.y + 1;
+		const Imath::Box2i &dataWindow = header.dataWindow();
 
-		//const Imf::Compression &compression = file.header().compression();
+		//const Imf::Compression &compression = header.compression();
 
-		const Imf::ChannelList &channels = file.header().channels();
+		const Imf::ChannelList &channels = header.channels();
 
 		// check the number of components and check for a coherent format
 
@@ -302,15 +356,73 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			THROW (Iex::InputExc, "Unsupported color model: " << exr_color_model);
 		}
 
+		// keep HALF color data as-is when asked to, a missing alpha is filled with 1
+		const bool bKeepHalf = ((flags & EXR_HALF) == EXR_HALF) && (pixel_type == Imf::HALF) && !bMixedComponents && (image_type != FIT_FLOAT);
+		if (bKeepHalf) {
+			image_type = FIT_RGBAH;
+		}
+
+		// select the level and the area to decode
+		// --------------------------------------------------------------
+
+		// levels and regions of tiled files are read tile by tile
+		std::unique_ptr<Imf::TiledInputFile> tiledFile;
+		int lx = 0, ly = 0;
+		Imath::Box2i window = dataWindow;
+		const int level = (flags >> 24) & 0x1F;
+		if (header.hasTileDescription() && !bUseRgbaInterface && (level || region)) {
+			// one file object at a time reads the stream
+			file.reset();
+			io->seek_proc(handle, stream_start, SEEK_SET);
+			tiledFile = std::make_unique<Imf::TiledInputFile>(istream, GetEXRThreadCount());
+			switch (tiledFile->levelMode()) {
+				case Imf::MIPMAP_LEVELS:
+					lx = ly = std::min(level, tiledFile->numLevels() - 1);
+					break;
+				case Imf::RIPMAP_LEVELS:
+					lx = std::min(level, tiledFile->numXLevels() - 1);
+					ly = std::min(level, tiledFile->numYLevels() - 1);
+					break;
+				default:
+					break;
+			}
+			window = tiledFile->dataWindowForLevel(lx, ly);
+		}
+		int width  = window.max.x - window.min.x + 1;
+		int height = window.max.y - window.min.y + 1;
+
+		// area decoded into the dib, the rectangle rounded to tiles (to rows for scanline files)
+		Imath::Box2i area = window;
+		Imath::Box2i rect = window;
+		if (region) {
+			if ((region->right > (unsigned)width) || (region->bottom > (unsigned)height)) {
+				THROW (Iex::ArgExc, "The region isn't inside the image");
+			}
+			rect = Imath::Box2i(Imath::V2i(window.min.x + (int)region->left, window.min.y + (int)region->top),
+				Imath::V2i(window.min.x + (int)region->right - 1, window.min.y + (int)region->bottom - 1));
+			if (tiledFile) {
+				const int tile_width = (int)tiledFile->tileXSize();
+				const int tile_height = (int)tiledFile->tileYSize();
+				area.min.x = window.min.x + (rect.min.x - window.min.x) / tile_width * tile_width;
+				area.min.y = window.min.y + (rect.min.y - window.min.y) / tile_height * tile_height;
+				area.max.x = std::min(window.min.x + ((rect.max.x - window.min.x) / tile_width + 1) * tile_width - 1, window.max.x);
+				area.max.y = std::min(window.min.y + ((rect.max.y - window.min.y) / tile_height + 1) * tile_height - 1, window.max.y);
+			} else if (!bUseRgbaInterface) {
+				area.min.y = rect.min.y;
+				area.max.y = rect.max.y;
+			}
+		}
+
 		// allocate a new dib
-		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeaderT(header_only, image_type, width, height, 0), &FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeaderT(header_only, image_type,
+			area.max.x - area.min.x + 1, area.max.y - area.min.y + 1, 0), &FreeImage_Unload);
 		if (!dib) THROW (Iex::NullExc, FI_MSG_ERROR_MEMORY);
 
 		// try to load the preview image
 		// --------------------------------------------------------------
 
-		if (file.header().hasPreviewImage()) {
-			const Imf::PreviewImage& preview = file.header().previewImage();
+		if (!region && header.hasPreviewImage()) {
+			const Imf::PreviewImage& preview = header.previewImage();
 			const unsigned thWidth = preview.width();
 			const unsigned thHeight = preview.height();
 
@@ -347,10 +459,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		// --------------------------------------------------------------
 
 		uint8_t *bits = FreeImage_GetBits(dib.get());			// pointer to our pixel buffer
-		const size_t bytespp = sizeof(float) * components;	// size of our pixel in bytes
+		const size_t bytespc = bKeepHalf ? sizeof(half) : sizeof(float);	// size of our pixel component in bytes
+		const size_t bytespp = bKeepHalf ? sizeof(FIRGBAH) : sizeof(float) * components;	// size of our pixel in bytes
 		const unsigned pitch = FreeImage_GetPitch(dib.get());		// size of our yStride in bytes
 
-		Imf::PixelType pixelType = Imf::FLOAT;	// load as float data type;
+		const Imf::PixelType pixelType = bKeepHalf ? Imf::HALF : Imf::FLOAT;	// load as half or float data type
 
 		if (bUseRgbaInterface) {
 			// use the RGBA interface (used when loading RY BY Y images )
@@ -360,8 +473,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			uint8_t *scanline = bits;
 
 			// re-open using the RGBA interface
+			file.reset();
 			io->seek_proc(handle, stream_start, SEEK_SET);
-			Imf::RgbaInputFile rgbaFile(istream);
+			Imf::RgbaInputFile rgbaFile(istream, GetEXRThreadCount());
 
 			// read the file in chunks
 			Imath::Box2i dw = dataWindow;
@@ -373,13 +487,19 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				// fill the dib
 				const int y_max = ((dw.max.y - dw.min.y) <= chunk_size) ? (dw.max.y - dw.min.y) : chunk_size;
 				for ( int y = 0; y < y_max; y++) {
-					FIRGBF *pixel = (FIRGBF*)scanline;
 					const Imf::Rgba *half_rgba = chunk[y];
-					for (int x = 0; x < width; x++) {
-						// convert from half to float
-						pixel[x].red = half_rgba[x].r;
-						pixel[x].green = half_rgba[x].g;
-						pixel[x].blue = half_rgba[x].b;
+					if (bKeepHalf) {
+						// Imf::Rgba has the FIRGBAH layout
+						static_assert(sizeof(Imf::Rgba) == sizeof(FIRGBAH), "Imf::Rgba layout mismatch");
+						memcpy(scanline, half_rgba, width * sizeof(FIRGBAH));
+					} else {
+						FIRGBF *pixel = (FIRGBF*)scanline;
+						for (int x = 0; x < width; x++) {
+							// convert from half to float
+							pixel[x].red = half_rgba[x].r;
+							pixel[x].green = half_rgba[x].g;
+							pixel[x].blue = half_rgba[x].b;
+						}
 					}
 					// next line
 					scanline += pitch;
@@ -394,8 +514,8 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			// build a frame buffer (i.e. what we want on output)
 			Imf::FrameBuffer frameBuffer;
 
-			// allow dataWindow with minimal bounds different form zero
-			size_t offset = - dataWindow.min.x * bytespp - dataWindow.min.y * pitch;
+			// allow an area with minimal bounds different form zero
+			size_t offset = - area.min.x * bytespp - area.min.y * pitch;
 
 			if (components == 1) {
 				frameBuffer.insert ("Y",	// name
@@ -408,26 +528,42 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			} else if ((components == 3) || (components == 4)) {
 				const char *channel_name[4] = { "R", "G", "B", "A" };
 
-				for (int c = 0; c < components; c++) {
+				// a FIT_RGBAH dib always gets 4 slices, the fill value is used for a missing alpha
+				const int slices = bKeepHalf ? 4 : components;
+				for (int c = 0; c < slices; c++) {
 					frameBuffer.insert (
 						channel_name[c],					// name
 						Imf::Slice (pixelType,				// type
-						(char*)(bits + c * sizeof(float) + offset), // base
+						(char*)(bits + c * bytespc + offset), // base
 						bytespp,							// xStride
 						pitch,								// yStride
 						1, 1,								// x/y sampling
-						0.0));								// fillValue
+						(c == 3) ? 1.0 : 0.0));				// fillValue
 				}
 			}
 
 			// read the file
-			file.setFrameBuffer(frameBuffer);
-			file.readPixels(dataWindow.min.y, dataWindow.max.y);
+			if (tiledFile) {
+				const int tile_width = (int)tiledFile->tileXSize();
+				const int tile_height = (int)tiledFile->tileYSize();
+				tiledFile->setFrameBuffer(frameBuffer);
+				tiledFile->readTiles((area.min.x - window.min.x) / tile_width, (area.max.x - window.min.x) / tile_width,
+					(area.min.y - window.min.y) / tile_height, (area.max.y - window.min.y) / tile_height, lx, ly);
+			} else {
+				file->setFrameBuffer(frameBuffer);
+				file->readPixels(area.min.y, area.max.y);
+			}
 		}
 
 		// lastly, flip dib lines
 		FreeImage_FlipVertical(dib.get());
 
+		// crop the decoded area to the rectangle
+		if ((area.min != rect.min) || (area.max != rect.max)) {
+			dib.reset(FreeImage_Copy(dib.get(), rect.min.x - area.min.x, rect.min.y - area.min.y, rect.max.x - area.min.x + 1, rect.max.y - area.min.y + 1));
+			if (!dib) THROW (Iex::NullExc, FI_MSG_ERROR_MEMORY);
+		}
+
 		return dib.release();
 	}
 	catch(Iex::BaseExc & e) {
@@ -436,6 +572,17 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	return nullptr;
 }
 
+static FIBITMAP * DLL_CALLCONV
+Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+	return LoadEXR(io, handle, flags, nullptr);
+}
+
+FIBITMAP*
+LoadRegionEXR(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags) {
+	const EXRRegion region = { left, top, right, bottom };
+	return LoadEXR(io, handle, flags & ~FIF_LOAD_NOPIXELS, &region);
+}
+
 /**
 Set the preview image using the dib embedded thumbnail
 */
@@ -531,7 +678,7 @@ SaveAsEXR_LC(C_OStream& ostream, FIBITMAP *dib, Imf::Header& header, int width,
 		}
 
 		// write the data
-		Imf::RgbaOutputFile file(ostream, header, rgbaChannels);
+		Imf::RgbaOutputFile file(ostream, header, rgbaChannels, GetEXRThreadCount());
 		file.setFrameBuffer (&pixels[0][0], 1, width);
 		file.writePixels (height);
 
@@ -553,6 +700,14 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 	if (!dib || !handle) return FALSE;
 
+	InitializeEXR();
+
+	if ((FreeImage_GetImageType(dib) == FIT_RGBAH) && (flags & (EXR_FLOAT | EXR_LC))) {
+		// these options need float data
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> rgbaf(FreeImage_ConvertToRGBAF(dib), &FreeImage_Unload);
+		return rgbaf ? Save(io, rgbaf.get(), handle, page, flags, data) : FALSE;
+	}
+
 	try {
 		// check for EXR_LC compression and verify that the format is RGB
 		if ((flags & EXR_LC) == EXR_LC) {
@@ -585,6 +740,15 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		} else if ((flags & EXR_B44) == EXR_B44) {
 			// lossy 44% float compression
 			compress = Imf::B44_COMPRESSION;
+		} else if ((flags & EXR_ZIPS) == EXR_ZIPS) {
+			// zlib compression, one scan line at a time
+			compress = Imf::ZIPS_COMPRESSION;
+		} else if ((flags & EXR_DWAA) == EXR_DWAA) {
+			// lossy DCT based compression, in blocks of 32 scan lines
+			compress = Imf::DWAA_COMPRESSION;
+		} else if ((flags & EXR_DWAB) == EXR_DWAB) {
+			// lossy DCT based compression, in blocks of 256 scan lines
+			compress = Imf::DWAB_COMPRESSION;
 		} else {
 			// default value
 			compress = Imf::PIZ_COMPRESSION;
@@ -636,6 +800,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 				}
 				break;
 			case FIT_RGBAF:
+			case FIT_RGBAH:
 				components = 4;
 				for (int c = 0; c < components; c++) {
 					// insert R, G, B and A channels
@@ -655,7 +820,15 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		unsigned pitch = 0;	// size of our yStride in bytes
 
 
-		if (pixelType == Imf::HALF) {
+		if (image_type == FIT_RGBAH) {
+			// already half data, invert dib scanlines
+			bIsFlipped = FreeImage_FlipVertical(dib);
+
+			bits = FreeImage_GetBits(dib);
+			bytespc = sizeof(half);
+			bytespp = sizeof(FIRGBAH);
+			pitch = FreeImage_GetPitch(dib);
+		} else if (pixelType == Imf::HALF) {
 			// convert from float to half
 			halfData = new(std::nothrow) half[width * static_cast<size_t>(components) * height];
 			if (!halfData) {
@@ -693,7 +866,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 				(char*)(bits),			// base
 				bytespp,				// xStride
 				pitch));				// yStride
-		} else if ((image_type == FIT_RGBF) || (image_type == FIT_RGBAF)) {			
+		} else if ((image_type == FIT_RGBF) || (image_type == FIT_RGBAF) || (image_type == FIT_RGBAH)) {
 			for (int c = 0; c < components; c++) {
 				char *channel_base = (char*)(bits) + c*bytespc;
 				frameBuffer.insert (channel_name[c],// name
@@ -705,7 +878,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		}
 
 		// write the data
-		Imf::OutputFile file (ostream, header);
+		Imf::OutputFile file (ostream, header, GetEXRThreadCount());
 		file.setFrameBuffer (frameBuffer);
 		file.writePixels (height);
 
@@ -742,11 +915,6 @@ void DLL_CALLCONV
 InitEXR(Plugin *plugin, int format_id) {
 	s_format_id = format_id;
 
-	// initialize the OpenEXR library
-	// note that this OpenEXR function produce so called "false memory leaks"
-	// see http://lists.nongnu.org/archive/html/openexr-devel/2013-11/msg00000.html
-	Imf::staticInitialize();
-
 	plugin->format_proc = Format;
 	plugin->description_proc = Description;
 	plugin->extension_proc = Extension;
@@ -763,6 +931,7 @@ InitEXR(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
 
 
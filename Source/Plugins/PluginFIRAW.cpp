@@ -0,0 +1,362 @@
+// ==========================================================
+// FIRAW Loader and Writer
+//
+// FreeImage raw bitmaps: the header, palette, ICC profile and metadata of a bitmap
+// followed by its pixel rows as they are in memory, for intermediate files reloaded
+// without decoding. Memory mapped files are used in place (see FreeImage_LoadMapped).
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "FreeImage/Plugin.h"
+
+// ==========================================================
+// Internal functions
+// ==========================================================
+
+static const char FIRAW_MAGIC[8] = { 'F', 'I', 'R', 'A', 'W', '\r', '\n', '\x1a' };
+
+static const uint32_t FIRAW_VERSION = 1;
+static const uint32_t FIRAW_BYTE_ORDER = 0x01020304;
+
+/** largest descriptor accepted (palette, ICC profile, metadata and thumbnail) */
+static const uint64_t FIRAW_MAX_DESCRIPTOR = 1u << 30;
+
+/**
+File header, in the byte order of the machine which wrote the file.
+Offsets are counted from the start of the header, pixels are aligned on FIBITMAP_ALIGNMENT bytes.
+*/
+struct FIRAWHEADER {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t descriptor_offset;		//! raw bitmap without pixels, see FreeImage_EncodeRawBitmap
+	uint64_t descriptor_size;
+	uint64_t pixels_offset;			//! rows from the bottom one, 0 for a header only bitmap
+	uint64_t pixels_size;
+	uint32_t pitch;					//! bytes between two rows
+	uint32_t reserved[3];
+};
+
+static_assert(sizeof(FIRAWHEADER) == 64, "FIRAW header layout");
+
+/**
+Checks the header of a file, file_size is 0 if unknown
+*/
+static bool
+CheckHeader(const FIRAWHEADER &header, uint64_t file_size) {
+	if ((memcmp(header.magic, FIRAW_MAGIC, sizeof(FIRAW_MAGIC)) != 0) || (header.version != FIRAW_VERSION) || (header.byte_order != FIRAW_BYTE_ORDER)) {
+		return false;
+	}
+	if ((header.descriptor_offset < sizeof(FIRAWHEADER)) || (header.descriptor_size > FIRAW_MAX_DESCRIPTOR)) {
+		return false;
+	}
+	if (header.pixels_offset && ((header.pixels_offset % FIBITMAP_ALIGNMENT) || (header.pitch == 0))) {
+		return false;
+	}
+	if (file_size) {
+		if ((header.descriptor_offset > file_size) || (header.descriptor_size > file_size - header.descriptor_offset)) {
+			return false;
+		}
+		if ((header.pixels_offset > file_size) || (header.pixels_size > file_size - header.pixels_offset)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+Checks that the pixels described by the header hold the rows of dib
+*/
+static bool
+CheckPixels(const FIRAWHEADER &header, FIBITMAP *dib) {
+	const uint64_t height = FreeImage_GetHeight(dib);
+	return (FreeImage_GetLine(dib) <= header.pitch) && (height * header.pitch <= header.pixels_size);
+}
+
+// ==========================================================
+// Plugin Interface
+// ==========================================================
+
+static int s_format_id;
+
+// ==========================================================
+// Plugin Implementation
+// ==========================================================
+
+static const char * DLL_CALLCONV
+Format() {
+	return "FIRAW";
+}
+
+static const char * DLL_CALLCONV
+Description() {
+	return "FreeImage raw bitmap";
+}
+
+static const char * DLL_CALLCONV
+Extension() {
+	return "firaw";
+}
+
+static const char * DLL_CALLCONV
+RegExpr() {
+	return nullptr;
+}
+
+static const char * DLL_CALLCONV
+MimeType() {
+	return "image/x-freeimage-raw";
+}
+
+static FIBOOL DLL_CALLCONV
+Validate(FreeImageIO *io, fi_handle handle) {
+	char signature[sizeof(FIRAW_MAGIC)] = { 0 };
+
+	io->read_proc(signature, 1, sizeof(signature), handle);
+
+	return (memcmp(FIRAW_MAGIC, signature, sizeof(FIRAW_MAGIC)) == 0) ? TRUE : FALSE;
+}
+
+static FIBOOL DLL_CALLCONV
+SupportsExportDepth(int /*depth*/) {
+	return TRUE;
+}
+
+static FIBOOL DLL_CALLCONV
+SupportsExportType(FREE_IMAGE_TYPE /*type*/) {
+	return TRUE;
+}
+
+static FIBOOL DLL_CALLCONV
+SupportsICCProfiles() {
+	return TRUE;
+}
+
+static FIBOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
+// ----------------------------------------------------------
+
+static FIBITMAP * DLL_CALLCONV
+Load(FreeImageIO *io, fi_handle handle, int /*page*/, int flags, void * /*data*/) {
+	if (!handle) {
+		return nullptr;
+	}
+
+	const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
+	try {
+		const long start = io->tell_proc(handle);
+
+		FIRAWHEADER header;
+		if ((io->read_proc(&header, sizeof(header), 1, handle) != 1) || !CheckHeader(header, 0)) {
+			throw FI_MSG_ERROR_MAGIC_NUMBER;
+		}
+
+		std::vector<uint8_t> descriptor((size_t)header.descriptor_size);
+		if ((io->seek_proc(handle, start + (long)header.descriptor_offset, SEEK_SET) != 0)
+			|| (io->read_proc(descriptor.data(), 1, (unsigned)descriptor.size(), handle) != descriptor.size())) {
+			throw FI_MSG_ERROR_PARSING;
+		}
+
+		if (header_only || !header.pixels_offset) {
+			FIBITMAP *dib = FreeImage_DecodeRawBitmap(descriptor.data(), descriptor.size());
+			if (!dib) {
+				throw FI_MSG_ERROR_PARSING;
+			}
+			return dib;
+		}
+
+		// pixels are allocated and read below
+		const RawBitmapPixels pixels;
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_DecodeRawBitmap(descriptor.data(), descriptor.size(), &pixels), &FreeImage_Unload);
+		if (!dib) {
+			throw FI_MSG_ERROR_DIB_MEMORY;
+		}
+		if (!CheckPixels(header, dib.get())) {
+			throw FI_MSG_ERROR_PARSING;
+		}
+
+		if (io->seek_proc(handle, start + (long)header.pixels_offset, SEEK_SET) != 0) {
+			throw FI_MSG_ERROR_PARSING;
+		}
+
+		const unsigned height = FreeImage_GetHeight(dib.get());
+		const unsigned line = FreeImage_GetLine(dib.get());
+		const uint64_t total = (uint64_t)header.pitch * height;
+
+		if ((header.pitch == FreeImage_GetPitch(dib.get())) && (total <= UINT_MAX)) {
+			// same layout, a single read
+			if (io->read_proc(FreeImage_GetBits(dib.get()), 1, (unsigned)total, handle) != total) {
+				throw FI_MSG_ERROR_PARSING;
+			}
+		} else {
+			for (unsigned y = 0; y < height; y++) {
+				if (io->read_proc(FreeImage_GetScanLine(dib.get(), y), 1, line, handle) != line) {
+					throw FI_MSG_ERROR_PARSING;
+				}
+				io->seek_proc(handle, (long)(header.pitch - line), SEEK_CUR);
+			}
+		}
+
+		return dib.release();
+	}
+	catch (const char *text) {
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return nullptr;
+}
+
+static FIBOOL DLL_CALLCONV
+Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int /*page*/, int /*flags*/, void * /*data*/) {
+	if (!dib || !handle) {
+		return FALSE;
+	}
+
+	try {
+		std::vector<uint8_t> descriptor;
+		FreeImage_EncodeRawBitmap(dib, descriptor, false);
+
+		const FIBOOL has_pixels = FreeImage_HasPixels(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+		const unsigned line = FreeImage_GetLine(dib);
+
+		FIRAWHEADER header{};
+		memcpy(header.magic, FIRAW_MAGIC, sizeof(FIRAW_MAGIC));
+		header.version = FIRAW_VERSION;
+		header.byte_order = FIRAW_BYTE_ORDER;
+		header.descriptor_offset = sizeof(header);
+		header.descriptor_size = descriptor.size();
+		if (has_pixels) {
+			const uint64_t end = header.descriptor_offset + header.descriptor_size;
+			header.pixels_offset = (end + FIBITMAP_ALIGNMENT - 1) / FIBITMAP_ALIGNMENT * FIBITMAP_ALIGNMENT;
+			header.pitch = CalculatePitch(line);
+			header.pixels_size = (uint64_t)header.pitch * height;
+		}
+
+		if ((io->write_proc(&header, sizeof(header), 1, handle) != 1)
+			|| (io->write_proc(descriptor.data(), 1, (unsigned)descriptor.size(), handle) != descriptor.size())) {
+			throw "Write error";
+		}
+
+		if (has_pixels) {
+			// padding up to the aligned pixels, then rows padded to the pitch
+			std::vector<uint8_t> padding(std::max<size_t>(FIBITMAP_ALIGNMENT, header.pitch - line), 0);
+			const unsigned gap = (unsigned)(header.pixels_offset - header.descriptor_offset - header.descriptor_size);
+			if (gap && (io->write_proc(padding.data(), 1, gap, handle) != gap)) {
+				throw "Write error";
+			}
+			const unsigned row_padding = header.pitch - line;
+			for (unsigned y = 0; y < height; y++) {
+				if ((io->write_proc(const_cast<uint8_t *>(FreeImage_GetConstScanLine(dib, y)), 1, line, handle) != line)
+					|| (row_padding && (io->write_proc(padding.data(), 1, row_padding, handle) != row_padding))) {
+					throw "Write error";
+				}
+			}
+		}
+
+		return TRUE;
+	}
+	catch (const char *text) {
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
+	}
+	catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
+	return FALSE;
+}
+
+// ==========================================================
+//   Memory mapped files
+// ==========================================================
+
+FIBITMAP*
+LoadMappedFIRAW(const uint8_t *data, size_t size, std::shared_ptr<const void> owner, int flags) {
+	TraceScope trace(TraceCategory::eLoad, Format());
+
+	FIRAWHEADER header;
+	if (size < sizeof(header)) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MAGIC_NUMBER, FI_MSG_ERROR_MAGIC_NUMBER);
+		return nullptr;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (!CheckHeader(header, size)) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MAGIC_NUMBER, FI_MSG_ERROR_MAGIC_NUMBER);
+		return nullptr;
+	}
+	trace.SetBytes(header.descriptor_offset + header.descriptor_size);
+
+	const uint8_t *descriptor = data + header.descriptor_offset;
+	const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
+	FIBITMAP *dib = nullptr;
+	if (header_only || !header.pixels_offset) {
+		dib = FreeImage_DecodeRawBitmap(descriptor, (size_t)header.descriptor_size);
+	} else {
+		// the rows are used in place, the bitmap keeps the mapping until it is unloaded
+		RawBitmapPixels pixels;
+		pixels.bits = data + header.pixels_offset;
+		pixels.pitch = header.pitch;
+		pixels.owner = std::move(owner);
+		dib = FreeImage_DecodeRawBitmap(descriptor, (size_t)header.descriptor_size, &pixels);
+		if (dib && !CheckPixels(header, dib)) {
+			FreeImage_Unload(dib);
+			dib = nullptr;
+		}
+	}
+	if (!dib) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_PARSING, FI_MSG_ERROR_PARSING);
+		return nullptr;
+	}
+	return PluginNodeBase::DropMetadata(dib, flags);
+}
+
+// ==========================================================
+//   Init
+// ==========================================================
+
+void DLL_CALLCONV
+InitFIRAW(Plugin *plugin, int format_id) {
+	s_format_id = format_id;
+
+	plugin->format_proc = Format;
+	plugin->description_proc = Description;
+	plugin->extension_proc = Extension;
+	plugin->regexpr_proc = RegExpr;
+	plugin->open_proc = nullptr;
+	plugin->close_proc = nullptr;
+	plugin->pagecount_proc = nullptr;
+	plugin->pagecapability_proc = nullptr;
+	plugin->load_proc = Load;
+	plugin->save_proc = Save;
+	plugin->validate_proc = Validate;
+	plugin->mime_proc = MimeType;
+	plugin->supports_export_bpp_proc = SupportsExportDepth;
+	plugin->supports_export_type_proc = SupportsExportType;
+	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
+}
@@ -32,6 +32,14 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "../Metadata/FreeImageTag.h"
+#include "FreeImage/Plugin.h"
+#include "FreeImage/ThreadPool.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 // ==========================================================
 //   Metadata declarations
@@ -46,6 +54,14 @@
 //   Constant/Typedef declarations
 // ==========================================================
 
+//encoded bytes of a frame, compressed on the thread pool while the previous frames are written
+struct GIFFrame {
+	std::vector<uint8_t> data;
+	FIBOOL success{ FALSE };
+	bool done{ false };
+	std::mutex mutex;
+	std::condition_variable finished;
+};
 
 struct GIFinfo {
 	FIBOOL read;
@@ -57,10 +73,27 @@ struct GIFinfo {
 	std::vector<size_t> comment_extension_offsets;
 	std::vector<size_t> graphic_control_extension_offsets;
 	std::vector<size_t> image_descriptor_offsets;
-
-	GIFinfo() : read(0), global_color_table_offset(0), global_color_table_size(0), background_color(0)
+	//GIF_PLAYBACK canvases after the disposal of a frame, the next pages are replayed from them
+	//(a checkpoint every few frames and the last page loaded)
+	std::map<int, FIBITMAP*> playback_canvases;
+	int playback_last;
+	//only used when writing
+	//global palette chosen with the first page, padded to 256 entries
+	std::vector<FIRGBA8> global_palette;
+	int global_palette_size;
+	//frames still being encoded, written in page order
+	std::deque<std::shared_ptr<GIFFrame>> pending_frames;
+	FIBOOL write_success;
+
+	GIFinfo() : read(0), global_color_table_offset(0), global_color_table_size(0), background_color(0), playback_last(-1), global_palette_size(0), write_success(TRUE)
 	{
 	}
+
+	~GIFinfo() {
+		for (auto &canvas : playback_canvases) {
+			FreeImage_Unload(canvas.second);
+		}
+	}
 };
 
 struct PageInfo {
@@ -102,8 +135,17 @@ protected:
 	int firstPixelPassed; // A specific flag that indicates if the first pixel
 	                      // of the whole image had already been read
 
-	std::string m_strings[MAX_LZW_CODE]; //This is what is really the "string table" data for the Decompressor
-	int* m_strmap;
+	//This is what is really the "string table" data for the Decompressor:
+	//each code is the string of its prefix code followed by its suffix byte
+	uint16_t m_prefixes[MAX_LZW_CODE];
+	uint8_t m_suffixes[MAX_LZW_CODE];
+	uint8_t m_firsts[MAX_LZW_CODE]; //first byte of each string
+	uint16_t m_lengths[MAX_LZW_CODE];
+	//string that didn't fit in the output buffer, flushed by the next Decompress call
+	uint8_t m_pending[MAX_LZW_CODE];
+	int m_pendingPos, m_pendingSize;
+
+	int* m_strmap; //Compressor table, allocated by CompressStart
 
 	//input buffer
 	uint8_t *m_buffer;
@@ -140,52 +182,11 @@ protected:
 static int g_GifInterlaceOffset[GIF_INTERLACE_PASSES] = {0, 4, 2, 1};
 static int g_GifInterlaceIncrement[GIF_INTERLACE_PASSES] = {8, 8, 4, 2};
 
-// ==========================================================
-// Helpers Functions
-// ==========================================================
-
-static FIBOOL 
-FreeImage_SetMetadataEx(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, uint16_t id, FREE_IMAGE_MDTYPE type, uint32_t count, uint32_t length, const void *value)
-{
-	bool bSuccess{};
-	if (std::unique_ptr<FITAG, decltype(&FreeImage_DeleteTag)> tag(FreeImage_CreateTag(), &FreeImage_DeleteTag); tag) {
-		bSuccess = FreeImage_SetTagKey(tag.get(), key);
-		bSuccess = bSuccess && FreeImage_SetTagID(tag.get(), id);
-		bSuccess = bSuccess && FreeImage_SetTagType(tag.get(), type);
-		bSuccess = bSuccess && FreeImage_SetTagCount(tag.get(), count);
-		bSuccess = bSuccess && FreeImage_SetTagLength(tag.get(), length);
-		bSuccess = bSuccess && FreeImage_SetTagValue(tag.get(), value);
-		if (model == FIMD_ANIMATION) {
-			const TagLib& s = TagLib::instance();
-			// get the tag description
-			const char *description = s.getTagDescription(TagLib::ANIMATION, id);
-			bSuccess = bSuccess && FreeImage_SetTagDescription(tag.get(), description);
-		}
-		// store the tag
-		bSuccess = bSuccess && FreeImage_SetMetadata(model, dib, key, tag.get());
-	}
-	return bSuccess ? TRUE : FALSE;
-}
-
-static FIBOOL 
-FreeImage_GetMetadataEx(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, FREE_IMAGE_MDTYPE type, FITAG **tag)
-{
-	if (FreeImage_GetMetadata(model, dib, key, tag)) {
-		if (FreeImage_GetTagType(*tag) == type) {
-			return TRUE;
-		}
-	}
-	return FALSE;
-}
-
 StringTable::StringTable()
 {
 	m_buffer = nullptr;
+	m_strmap = nullptr;
 	firstPixelPassed = 0; // Still no pixel read
-	// Maximum number of entries in the map is MAX_LZW_CODE * 256 
-	// (aka 2**12 * 2**8 => a 20 bits key)
-	// This Map could be optmized to only handle MAX_LZW_CODE * 2**(m_bpp)
-	m_strmap = new(std::nothrow) int[1<<20];
 }
 
 StringTable::~StringTable()
@@ -215,7 +216,7 @@ void StringTable::Initialize(int minCodeSize)
 	m_partialSize = 0;
 
 	m_bufferSize = 0;
-	ClearCompressorTable();
+	m_pendingPos = m_pendingSize = 0;
 	ClearDecompressorTable();
 }
 
@@ -240,6 +241,13 @@ void StringTable::CompressStart(int bpp, int width)
 	m_bpp = bpp;
 	m_slack = (8 - ((width * bpp) % 8)) % 8;
 
+	if (!m_strmap) {
+		// Maximum number of entries in the map is MAX_LZW_CODE * 256 
+		// (aka 2**12 * 2**8 => a 20 bits key)
+		// This Map could be optmized to only handle MAX_LZW_CODE * 2**(m_bpp)
+		m_strmap = new(std::nothrow) int[1<<20];
+	}
+
 	m_partial |= m_clearCode << m_partialSize;
 	m_partialSize += m_codeSize;
 	ClearCompressorTable();
@@ -366,66 +374,94 @@ bool StringTable::Compress(uint8_t *buf, int *len)
 
 bool StringTable::Decompress(uint8_t *buf, int *len)
 {
-	if (m_bufferSize == 0 || m_done) {
+	if (m_done) {
 		return false;
 	}
 
 	uint8_t *bufpos = buf;
-	for ( ; m_bufferPos < m_bufferSize; m_bufferPos++ ) {
-		m_partial |= (int)m_buffer[m_bufferPos] << m_partialSize;
-		m_partialSize += 8;
-		while (m_partialSize >= m_codeSize) {
-			int code = m_partial & m_codeMask;
-			m_partial >>= m_codeSize;
-			m_partialSize -= m_codeSize;
-
-			if (code > m_nextCode || /*(m_nextCode == MAX_LZW_CODE && code != m_clearCode) || */code == m_endCode) {
-				m_done = true;
-				*len = (int)(bufpos - buf);
-				return true;
-			}
-			if (code == m_clearCode) {
-				ClearDecompressorTable();
-				continue;
-			}
+	uint8_t *bufend = buf + *len;
+
+	//flush the end of a string that didn't fit last time
+	if (m_pendingSize > 0) {
+		const int count = std::min(m_pendingSize - m_pendingPos, (int)(bufend - bufpos));
+		memcpy(bufpos, m_pending + m_pendingPos, count);
+		bufpos += count;
+		m_pendingPos += count;
+		if (m_pendingPos < m_pendingSize) {
+			*len = (int)(bufpos - buf);
+			return true;
+		}
+		m_pendingPos = m_pendingSize = 0;
+	}
 
-			//add new string to string table, if not the first pass since a clear code
-			if (m_oldCode != MAX_LZW_CODE && m_nextCode < MAX_LZW_CODE) {
-				m_strings[m_nextCode] = m_strings[m_oldCode] + m_strings[code == m_nextCode ? m_oldCode : code][0];
-			}
+	if (m_bufferSize == 0) {
+		*len = (int)(bufpos - buf);
+		return bufpos > buf;
+	}
 
-			if ((int)m_strings[code].size() > *len - (bufpos - buf)) {
-				//out of space, stuff the code back in for next time
-				m_partial <<= m_codeSize;
-				m_partialSize += m_codeSize;
-				m_partial |= code;
-				m_bufferPos++;
+	for (;;) {
+		//grab input bytes until there is a full code, codes left in m_partial are decoded first
+		while (m_partialSize < m_codeSize) {
+			if (m_bufferPos >= m_bufferSize) {
+				m_bufferSize = 0;
 				*len = (int)(bufpos - buf);
 				return true;
 			}
+			m_partial |= (int)m_buffer[m_bufferPos++] << m_partialSize;
+			m_partialSize += 8;
+		}
+		const int code = m_partial & m_codeMask;
+		m_partial >>= m_codeSize;
+		m_partialSize -= m_codeSize;
+
+		if (code > m_nextCode || (code == m_nextCode && m_oldCode == MAX_LZW_CODE) || code == m_endCode) {
+			m_done = true;
+			*len = (int)(bufpos - buf);
+			return true;
+		}
+		if (code == m_clearCode) {
+			ClearDecompressorTable();
+			continue;
+		}
 
-			//output the string into the buffer
-			memcpy(bufpos, m_strings[code].data(), m_strings[code].size());
-			bufpos += m_strings[code].size();
+		//add new string to string table, if not the first pass since a clear code
+		if (m_oldCode != MAX_LZW_CODE && m_nextCode < MAX_LZW_CODE) {
+			m_prefixes[m_nextCode] = (uint16_t)m_oldCode;
+			m_suffixes[m_nextCode] = m_firsts[code == m_nextCode ? m_oldCode : code];
+			m_firsts[m_nextCode] = m_firsts[m_oldCode];
+			m_lengths[m_nextCode] = (uint16_t)(m_lengths[m_oldCode] + 1);
+		}
 
-			//increment the next highest valid code, add a bit to the mask if we need to increase the code size
-			if (m_oldCode != MAX_LZW_CODE && m_nextCode < MAX_LZW_CODE) {
-				if (++m_nextCode < MAX_LZW_CODE) {
-					if ((m_nextCode & m_codeMask) == 0) {
-						m_codeSize++;
-						m_codeMask |= m_nextCode;
-					}
+		//output the string into the buffer, walking the prefixes from its last byte
+		const int length = m_lengths[code];
+		const int space = (int)(bufend - bufpos);
+		uint8_t *dst = (length <= space) ? bufpos : m_pending;
+		for (int i = length, c = code; i > 0; i--) {
+			dst[i - 1] = m_suffixes[c];
+			c = m_prefixes[c];
+		}
+
+		//increment the next highest valid code, add a bit to the mask if we need to increase the code size
+		if (m_oldCode != MAX_LZW_CODE && m_nextCode < MAX_LZW_CODE) {
+			if (++m_nextCode < MAX_LZW_CODE) {
+				if ((m_nextCode & m_codeMask) == 0) {
+					m_codeSize++;
+					m_codeMask |= m_nextCode;
 				}
 			}
-
-			m_oldCode = code;
 		}
-	}
 
-	m_bufferSize = 0;
-	*len = (int)(bufpos - buf);
+		m_oldCode = code;
 
-	return true;
+		if (length > space) {
+			//out of space, keep the rest of the string for next time
+			memcpy(bufpos, m_pending, space);
+			m_pendingPos = space;
+			m_pendingSize = length;
+			return true;
+		}
+		bufpos += length;
+	}
 }
 
 void StringTable::Done(void)
@@ -447,8 +483,9 @@ void StringTable::ClearCompressorTable(void)
 void StringTable::ClearDecompressorTable(void)
 {
 	for (int i = 0; i < m_clearCode; i++) {
-		m_strings[i].resize(1);
-		m_strings[i][0] = (char)i;
+		m_suffixes[i] = m_firsts[i] = (uint8_t)i;
+		m_prefixes[i] = 0;
+		m_lengths[i] = 1;
 	}
 	m_nextCode = m_endCode + 1;
 
@@ -512,7 +549,9 @@ static FIBOOL DLL_CALLCONV
 SupportsExportDepth(int depth) {
 	return	(depth == 1) ||
 			(depth == 4) ||
-			(depth == 8);
+			(depth == 8) ||
+			(depth == 24) ||
+			(depth == 32);
 }
 
 static FIBOOL DLL_CALLCONV 
@@ -520,6 +559,16 @@ SupportsExportType(FREE_IMAGE_TYPE type) {
 	return (type == FIT_BITMAP) ? TRUE : FALSE;
 }
 
+static FIBOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
 static void *DLL_CALLCONV 
@@ -615,7 +664,7 @@ Open(FreeImageIO *io, fi_handle handle, FIBOOL read) {
 				}
 			}
 		} catch (const char *msg) {
-			FreeImage_OutputMessageProc(s_format_id, msg);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(msg), msg);
 			delete info;
 			return nullptr;
 		}
@@ -627,6 +676,9 @@ Open(FreeImageIO *io, fi_handle handle, FIBOOL read) {
 	return info;
 }
 
+static FIBOOL
+WritePendingFrames(FreeImageIO *io, fi_handle handle, GIFinfo *info, size_t keep);
+
 static void DLL_CALLCONV 
 Close(FreeImageIO *io, fi_handle handle, void *data) {
 	if (!data) {
@@ -635,6 +687,9 @@ Close(FreeImageIO *io, fi_handle handle, void *data) {
 	GIFinfo *info = (GIFinfo *)data;
 
 	if (!info->read) {
+		//the frames still encoding, failures have already been reported by their encoder
+		WritePendingFrames(io, handle, info, 0);
+
 		//Trailer
 		uint8_t b = GIF_BLOCK_TRAILER;
 		io->write_proc(&b, 1, 1, handle);
@@ -653,8 +708,145 @@ PageCount(FreeImageIO *io, fi_handle handle, void *data) {
 	return (int) info->image_descriptor_offsets.size();
 }
 
-static FIBITMAP * DLL_CALLCONV 
-Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+static FIBITMAP *
+LoadGIF(FreeImageIO *io, fi_handle handle, int page, int flags, void *data, bool report_passes);
+
+//reads the disposal method, transparency flag and rectangle of a frame
+static PageInfo
+ReadPageInfo(FreeImageIO *io, fi_handle handle, const GIFinfo *info, int page, bool *have_transparent) {
+	uint8_t packed = 0;
+	uint16_t left, top, width, height;
+
+	//Graphic Control Extension, if any
+	if (info->graphic_control_extension_offsets[page] != 0) {
+		io->seek_proc(handle, (long)(info->graphic_control_extension_offsets[page] + 1), SEEK_SET);
+		io->read_proc(&packed, 1, 1, handle);
+	}
+	*have_transparent = (packed & GIF_PACKED_GCE_HAVETRANS) ? true : false;
+
+	//Image Descriptor
+	io->seek_proc(handle, (long)(info->image_descriptor_offsets[page]), SEEK_SET);
+	io->read_proc(&left, 2, 1, handle);
+	io->read_proc(&top, 2, 1, handle);
+	io->read_proc(&width, 2, 1, handle);
+	io->read_proc(&height, 2, 1, handle);
+#ifdef FREEIMAGE_BIGENDIAN
+	SwapShort(&left);
+	SwapShort(&top);
+	SwapShort(&width);
+	SwapShort(&height);
+#endif
+
+	return PageInfo((packed & GIF_PACKED_GCE_DISPOSAL) >> 2, left, top, width, height);
+}
+
+//fills the rectangle of a frame with the background color
+static void
+ClearPlaybackRect(FIBITMAP *canvas, const PageInfo &info, const FIRGBA8 &background) {
+	const int logicalwidth = (int)FreeImage_GetWidth(canvas);
+	const int logicalheight = (int)FreeImage_GetHeight(canvas);
+	const int width = std::min<int>(info.width, logicalwidth - info.left);
+	for (int y = 0; y < info.height; y++) {
+		const int scanidx = logicalheight - (y + info.top) - 1;
+		if (scanidx < 0) {
+			break;  // If data is corrupt, don't calculate in invalid scanline
+		}
+		FIRGBA8 *scanline = (FIRGBA8 *)FreeImage_GetScanLine(canvas, scanidx) + info.left;
+		for (int x = 0; x < width; x++) {
+			*scanline++ = background;
+		}
+	}
+}
+
+//draws a frame over the canvas with full alpha opaqueness, returns its frame time
+static int
+DrawPlaybackFrame(FreeImageIO *io, fi_handle handle, int page, void *data, FIBITMAP *canvas, const PageInfo &info) {
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> pagedib(LoadGIF(io, handle, page, GIF_LOAD256, data, false), &FreeImage_Unload);
+	if (!pagedib) {
+		return 0;
+	}
+	const FIRGBA8 *pal = FreeImage_GetPalette(pagedib.get());
+	bool have_transparent = false;
+	int transparent_color = 0;
+	if (FreeImage_IsTransparent(pagedib.get())) {
+		int count = FreeImage_GetTransparencyCount(pagedib.get());
+		const uint8_t *table = FreeImage_GetTransparencyTable(pagedib.get());
+		for (int i = 0; i < count; i++) {
+			if (table[i] == 0) {
+				have_transparent = true;
+				transparent_color = i;
+				break;
+			}
+		}
+	}
+	const int logicalwidth = (int)FreeImage_GetWidth(canvas);
+	const int logicalheight = (int)FreeImage_GetHeight(canvas);
+	const int width = std::min<int>(info.width, logicalwidth - info.left);
+	for (int y = 0; y < info.height; y++) {
+		const int scanidx = logicalheight - (y + info.top) - 1;
+		if (scanidx < 0) {
+			break;  // If data is corrupt, don't calculate in invalid scanline
+		}
+		FIRGBA8 *scanline = (FIRGBA8 *)FreeImage_GetScanLine(canvas, scanidx) + info.left;
+		const uint8_t *pageline = FreeImage_GetScanLine(pagedib.get(), info.height - y - 1);
+		for (int x = 0; x < width; x++) {
+			if (!have_transparent || *pageline != transparent_color) {
+				*scanline = pal[*pageline];
+				scanline->alpha = 255;
+			}
+			scanline++;
+			pageline++;
+		}
+	}
+	FITAG *tag;
+	if (FreeImage_GetMetadataEx(FIMD_ANIMATION, pagedib.get(), "FrameTime", FIDT_LONG, &tag)) {
+		return *(int32_t *)FreeImage_GetTagValue(tag);
+	}
+	return 0;
+}
+
+//frames between two playback checkpoints, at most 32 checkpoints are kept per file
+static int
+PlaybackInterval(const GIFinfo *info) {
+	return std::max<int>(16, ((int)info->image_descriptor_offsets.size() + 31) / 32);
+}
+
+//keeps the canvas after the disposal of the last page loaded, the previous one is dropped unless it's a checkpoint
+static void
+StorePlaybackCanvas(GIFinfo *info, int page, FIBITMAP *canvas) {
+	const int interval = PlaybackInterval(info);
+	if (info->playback_last >= 0 && info->playback_last != page && (info->playback_last + 1) % interval != 0) {
+		auto last = info->playback_canvases.find(info->playback_last);
+		if (last != info->playback_canvases.end()) {
+			FreeImage_Unload(last->second);
+			info->playback_canvases.erase(last);
+		}
+	}
+	FIBITMAP *&slot = info->playback_canvases[page];
+	if (slot) {
+		FreeImage_Unload(slot);
+	}
+	slot = canvas;
+	info->playback_last = page;
+}
+
+//reports an interlace pass to FreeImage_LoadProgressive, the rows decoded so far repeated down over the missing ones
+static void
+NotifyInterlacePass(FIBITMAP *dib, int pass) {
+	const unsigned step = 8 >> pass;	//rows decoded after pass 0, 1 and 2 are multiples of 8, 4 and 2
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned line = FreeImage_GetLine(dib);
+	for (unsigned y = 0; y < height; y++) {
+		if (y % step) {
+			memcpy(FreeImage_GetScanLine(dib, height - 1 - y), FreeImage_GetScanLine(dib, height - 1 - (y - y % step)), line);
+		}
+	}
+	NotifyPassDecoded(dib, pass, GIF_INTERLACE_PASSES);
+}
+
+//loads a page, reporting the passes of an interlaced frame when report_passes is set (not for the frames of playback canvases)
+static FIBITMAP *
+LoadGIF(FreeImageIO *io, fi_handle handle, int page, int flags, void *data, bool report_passes) {
 	if (!data) {
 		return nullptr;
 	}
@@ -667,6 +859,8 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		return nullptr;
 	}
 
+	const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
 	try {
 		bool have_transparent = false, no_local_palette = false, interlaced = false;
 		int disposal_method = GIF_DISPOSAL_LEAVE, delay_time = 0, transparent_color = 0;
@@ -685,6 +879,24 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			SwapShort(&logicalwidth);
 			SwapShort(&logicalheight);
 #endif
+			if (header_only) {
+				//the canvas size and the frame time are known without replaying the frames
+				std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeader(TRUE, logicalwidth, logicalheight, 32), &FreeImage_Unload);
+				if (!dib) {
+					throw FI_MSG_ERROR_DIB_MEMORY;
+				}
+				if (info->graphic_control_extension_offsets[page] != 0) {
+					io->seek_proc(handle, (long)(info->graphic_control_extension_offsets[page] + 2), SEEK_SET);
+					io->read_proc(&w, 2, 1, handle);
+#ifdef FREEIMAGE_BIGENDIAN
+					SwapShort(&w);
+#endif
+					delay_time = w * 10; //convert cs to ms
+				}
+				FreeImage_SetMetadataEx(FIMD_ANIMATION, dib.get(), "FrameTime", ANIMTAG_FRAMETIME, FIDT_LONG, 1, 4, &delay_time);
+				return dib.release();
+			}
+
 			//set the background color with 0 alpha
 			FIRGBA8 background;
 			if (info->global_color_table_offset != 0 && info->background_color < info->global_color_table_size) {
@@ -699,131 +911,74 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			}
 			background.alpha = 0;
 
-			//allocate entire logical area
-			std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_Allocate(logicalwidth, logicalheight, 32), &FreeImage_Unload);
-			if (!dib) {
-				throw FI_MSG_ERROR_DIB_MEMORY;
-			}
-
-			//fill with background color to start
-			int x, y;
-			FIRGBA8 *scanline;
-			for (y = 0; y < logicalheight; y++) {
-				scanline = (FIRGBA8 *)FreeImage_GetScanLine(dib.get(), y);
-				for (x = 0; x < logicalwidth; x++) {
-					*scanline++ = background;
+			const int interval = PlaybackInterval(info);
+			const int end = page;
+
+			//start from the closest canvas cached before the page, or after a frame covering the whole logical area
+			auto cached = info->playback_canvases.lower_bound(end);
+			int start = (cached != info->playback_canvases.begin()) ? std::prev(cached)->first + 1 : 0;
+			bool from_background = (start == 0);
+			for (int k = end - 1; k >= start; k--) {
+				const PageInfo pageinfo = ReadPageInfo(io, handle, info, k, &have_transparent);
+				if (pageinfo.left == 0 && pageinfo.top == 0 && pageinfo.width == logicalwidth && pageinfo.height == logicalheight) {
+					if (pageinfo.disposal_method == GIF_DISPOSAL_BACKGROUND) {
+						start = k + 1;
+						from_background = true;
+						break;
+					} else if (pageinfo.disposal_method != GIF_DISPOSAL_PREVIOUS && !have_transparent) {
+						start = k;
+						from_background = true;
+						break;
+					}
 				}
 			}
 
-			//cache some info about each of the pages so we can avoid decoding as many of them as possible
-			std::vector<PageInfo> pageinfo;
-			int start = page, end = page;
-			while (start >= 0) {
-				//Graphic Control Extension
-				io->seek_proc(handle, (long)(info->graphic_control_extension_offsets[start] + 1), SEEK_SET);
-				io->read_proc(&packed, 1, 1, handle);
-				have_transparent = (packed & GIF_PACKED_GCE_HAVETRANS) ? true : false;
-				disposal_method = (packed & GIF_PACKED_GCE_DISPOSAL) >> 2;
-				//Image Descriptor
-				io->seek_proc(handle, (long)(info->image_descriptor_offsets[start]), SEEK_SET);
-				io->read_proc(&left, 2, 1, handle);
-				io->read_proc(&top, 2, 1, handle);
-				io->read_proc(&width, 2, 1, handle);
-				io->read_proc(&height, 2, 1, handle);
-#ifdef FREEIMAGE_BIGENDIAN
-				SwapShort(&left);
-				SwapShort(&top);
-				SwapShort(&width);
-				SwapShort(&height);
-#endif
-
-				pageinfo.push_back(PageInfo(disposal_method, left, top, width, height));
-
-				if (start != end) {
-					if (left == 0 && top == 0 && width == logicalwidth && height == logicalheight) {
-						if (disposal_method == GIF_DISPOSAL_BACKGROUND) {
-							pageinfo.pop_back();
-							start++;
-							break;
-						} else if (disposal_method != GIF_DISPOSAL_PREVIOUS) {
-							if (!have_transparent) {
-								break;
-							}
+			std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
+			if (from_background) {
+				//allocate entire logical area, filled with the background color to start
+				dib.reset(FreeImage_Allocate(logicalwidth, logicalheight, 32));
+				if (dib) {
+					for (int y = 0; y < logicalheight; y++) {
+						FIRGBA8 *scanline = (FIRGBA8 *)FreeImage_GetScanLine(dib.get(), y);
+						for (int x = 0; x < logicalwidth; x++) {
+							*scanline++ = background;
 						}
 					}
 				}
-				start--;
+			} else {
+				dib.reset(FreeImage_Clone(std::prev(cached)->second));
 			}
-			if (start < 0) {
-				start = 0;
+			if (!dib) {
+				throw FI_MSG_ERROR_DIB_MEMORY;
 			}
 
-			//draw each page into the logical area
-			delay_time = 0;
-			for (page = start; page <= end; page++) {
-				const PageInfo &info = pageinfo[end - page];
-				//things we can skip having to decode
-				if (page != end) {
-					if (info.disposal_method == GIF_DISPOSAL_PREVIOUS) {
-						continue;
-					}
-					if (info.disposal_method == GIF_DISPOSAL_BACKGROUND) {
-						for (y = 0; y < info.height; y++) {
-							const int scanidx = logicalheight - (y + info.top) - 1;
-							if (scanidx < 0) {
-								break;  // If data is corrupt, don't calculate in invalid scanline
-							}
-							scanline = (FIRGBA8 *)FreeImage_GetScanLine(dib.get(), scanidx) + info.left;
-							for (x = 0; x < info.width; x++) {
-								*scanline++ = background;
-							}
-						}
-						continue;
+			//replay the frames before the page, with their disposal
+			for (int k = start; k < end; k++) {
+				const PageInfo pageinfo = ReadPageInfo(io, handle, info, k, &have_transparent);
+				if (pageinfo.disposal_method == GIF_DISPOSAL_BACKGROUND) {
+					ClearPlaybackRect(dib.get(), pageinfo, background);
+				} else if (pageinfo.disposal_method != GIF_DISPOSAL_PREVIOUS) {
+					DrawPlaybackFrame(io, handle, k, data, dib.get(), pageinfo);
+				}
+				if ((k + 1) % interval == 0 && info->playback_canvases.find(k) == info->playback_canvases.end()) {
+					if (FIBITMAP *checkpoint = FreeImage_Clone(dib.get())) {
+						info->playback_canvases[k] = checkpoint;
 					}
 				}
+			}
 
-				//decode page
-				FIBITMAP *pagedib = Load(io, handle, page, GIF_LOAD256, data);
-				if (pagedib) {
-					std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> safePagedib(pagedib, &FreeImage_Unload);
-					const FIRGBA8 *pal = FreeImage_GetPalette(pagedib);
-					have_transparent = false;
-					if (FreeImage_IsTransparent(pagedib)) {
-						int count = FreeImage_GetTransparencyCount(pagedib);
-						const uint8_t *table = FreeImage_GetTransparencyTable(pagedib);
-						for (int i = 0; i < count; i++) {
-							if (table[i] == 0) {
-								have_transparent = true;
-								transparent_color = i;
-								break;
-							}
-						}
-					}
-					//copy page data into logical buffer, with full alpha opaqueness
-					for (y = 0; y < info.height; y++) {
-						const int scanidx = logicalheight - (y + info.top) - 1;
-						if (scanidx < 0) {
-							break;  // If data is corrupt, don't calculate in invalid scanline
-						}
-						scanline = (FIRGBA8 *)FreeImage_GetScanLine(dib.get(), scanidx) + info.left;
-						uint8_t *pageline = FreeImage_GetScanLine(pagedib, info.height - y - 1);
-						for (x = 0; x < info.width; x++) {
-							if (!have_transparent || *pageline != transparent_color) {
-								*scanline = pal[*pageline];
-								scanline->alpha = 255;
-							}
-							scanline++;
-							pageline++;
-						}
-					}
-					//copy frame time
-					if (page == end) {
-						FITAG *tag;
-						if (FreeImage_GetMetadataEx(FIMD_ANIMATION, pagedib, "FrameTime", FIDT_LONG, &tag)) {
-							delay_time = *(int32_t *)FreeImage_GetTagValue(tag);
-						}
-					}
+			//draw the page itself
+			const PageInfo pageinfo = ReadPageInfo(io, handle, info, end, &have_transparent);
+			std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> previous(pageinfo.disposal_method == GIF_DISPOSAL_PREVIOUS ? FreeImage_Clone(dib.get()) : nullptr, &FreeImage_Unload);
+			delay_time = DrawPlaybackFrame(io, handle, end, data, dib.get(), pageinfo);
+
+			//keep the canvas after the disposal of the page, for the next one
+			FIBITMAP *next = previous ? previous.release() : FreeImage_Clone(dib.get());
+			if (next) {
+				if (pageinfo.disposal_method == GIF_DISPOSAL_BACKGROUND) {
+					ClearPlaybackRect(next, pageinfo, background);
 				}
+				StorePlaybackCanvas(info, end, next);
 			}
 
 			//setup frame time
@@ -860,7 +1015,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				else if (info->global_color_table_size <= 16) bpp = 4;
 			}
 		}
-		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_Allocate(width, height, bpp), &FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeader(header_only, width, height, bpp), &FreeImage_Unload);
 		if (!dib) {
 			throw FI_MSG_ERROR_DIB_MEMORY;
 		}
@@ -906,49 +1061,80 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			}
 		}
 
-		//LZW Minimum Code Size
-		io->read_proc(&b, 1, 1, handle);
-		StringTable *stringtable = new(std::nothrow) StringTable;
-		stringtable->Initialize(b);
-
-		//Image Data Sub-blocks
-		int x = 0, xpos = 0, y = 0, shift = 8 - bpp, mask = (1 << bpp) - 1, interlacepass = 0;
-		uint8_t *scanline = FreeImage_GetScanLine(dib.get(), height - 1);
-		uint8_t buf[4096];
-		io->read_proc(&b, 1, 1, handle);
-		while (b) {
-			io->read_proc(stringtable->FillInputBuffer(b), b, 1, handle);
-			int size = sizeof(buf);
-			while (stringtable->Decompress(buf, &size)) {
-				for ( int i = 0; i < size; i++ ) {
-					scanline[xpos] |= (buf[i] & mask) << shift;
-					if (shift > 0) {
-						shift -= bpp;
-					} else {
-						xpos++;
-						shift = 8 - bpp;
-					}
-					if (++x >= width) {
-						if (interlaced) {
-							y += g_GifInterlaceIncrement[interlacepass];
-							if (y >= height && ++interlacepass < GIF_INTERLACE_PASSES) {
-								y = g_GifInterlaceOffset[interlacepass];
-							}
-						} else {
-							y++;
+		//skip the image data in header only mode, the extensions below are read from their offsets
+		if (!header_only) {
+			//LZW Minimum Code Size
+			io->read_proc(&b, 1, 1, handle);
+			StringTable *stringtable = new(std::nothrow) StringTable;
+			stringtable->Initialize(b);
+
+			//Image Data Sub-blocks
+			int x = 0, xpos = 0, y = 0, shift = 8 - bpp, mask = (1 << bpp) - 1, interlacepass = 0;
+			uint8_t *scanline = FreeImage_GetScanLine(dib.get(), height - 1);
+			//interlace passes for FreeImage_LoadProgressive
+			const bool passes = interlaced && report_passes && ReportsPasses();
+			//move to the next row, returns false once the last one is decoded
+			auto nextRow = [&]() -> bool {
+				if (interlaced) {
+					y += g_GifInterlaceIncrement[interlacepass];
+					if (y >= height && ++interlacepass < GIF_INTERLACE_PASSES) {
+						if (passes) {
+							NotifyInterlacePass(dib.get(), interlacepass - 1);
 						}
-						if (y >= height) {
-							stringtable->Done();
+						y = g_GifInterlaceOffset[interlacepass];
+					}
+				} else {
+					y++;
+				}
+				if (y >= height) {
+					stringtable->Done();
+					return false;
+				}
+				x = xpos = 0;
+				shift = 8 - bpp;
+				scanline = FreeImage_GetScanLine(dib.get(), height - y - 1);
+				if (passes) {
+					//the row holds a copy of a previous pass, packed pixels are or-ed in
+					memset(scanline, 0, FreeImage_GetLine(dib.get()));
+				}
+				return true;
+			};
+			uint8_t buf[4096];
+			io->read_proc(&b, 1, 1, handle);
+			while (b) {
+				io->read_proc(stringtable->FillInputBuffer(b), b, 1, handle);
+				if (bpp == 8) {
+					//8-bit indices are decoded straight into the rows
+					int size = width - x;
+					while (stringtable->Decompress(scanline + x, &size)) {
+						x += size;
+						if (x >= width && !nextRow()) {
 							break;
 						}
-						x = xpos = 0;
-						shift = 8 - bpp;
-						scanline = FreeImage_GetScanLine(dib.get(), height - y - 1);
+						size = width - x;
+					}
+				} else {
+					int size = sizeof(buf);
+					while (stringtable->Decompress(buf, &size)) {
+						for ( int i = 0; i < size; i++ ) {
+							scanline[xpos] |= (buf[i] & mask) << shift;
+							if (shift > 0) {
+								shift -= bpp;
+							} else {
+								xpos++;
+								shift = 8 - bpp;
+							}
+							if (++x >= width && !nextRow()) {
+								break;
+							}
+						}
+						size = sizeof(buf);
 					}
 				}
-				size = sizeof(buf);
+				io->read_proc(&b, 1, 1, handle);
 			}
-			io->read_proc(&b, 1, 1, handle);
+
+			delete stringtable;
 		}
 
 		if (page == 0) {
@@ -1055,36 +1241,209 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		b = (uint8_t)disposal_method;
 		FreeImage_SetMetadataEx(FIMD_ANIMATION, dib.get(), "DisposalMethod", ANIMTAG_DISPOSALMETHOD, FIDT_BYTE, 1, 1, &b);
 
-		delete stringtable;
-
 		return dib.release();
 
 	} catch (const char *msg) {
-		FreeImage_OutputMessageProc(s_format_id, msg);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(msg), msg);
 	}
 
 	return nullptr;
 }
 
-static FIBOOL DLL_CALLCONV 
-Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
-	if (!data) {
-		return FALSE;
+static FIBITMAP * DLL_CALLCONV 
+Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+	return LoadGIF(io, handle, page, flags, data, true);
+}
+
+static void
+SetGlobalPalette(GIFinfo *info, const FIRGBA8 *palette, int size) {
+	info->global_palette.assign(256, FIRGBA8{});
+	info->global_palette_size = MIN(size, 256);
+	std::copy(palette, palette + info->global_palette_size, info->global_palette.begin());
+}
+
+static inline uint32_t
+PackRGB(const FIRGBA8 &color) {
+	return ((uint32_t)color.red << 16) | ((uint32_t)color.green << 8) | color.blue;
+}
+
+/**
+Maps the pixels of dib onto the global palette.
+Returns an 8-bit bitmap without local palette, or nullptr if a color of dib is missing from the global palette.
+*/
+static FIBITMAP *
+MapToGlobalPalette(FIBITMAP *dib, const GIFinfo *info) {
+	std::unordered_map<uint32_t, uint8_t> indices;
+	for (int i = info->global_palette_size - 1; i >= 0; i--) {
+		indices[PackRGB(info->global_palette[i])] = (uint8_t)i;
 	}
-	//GIFinfo *info = (GIFinfo *)data;
 
-	if (page == -1) {
-		page = 0;
+	const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib), bpp = FreeImage_GetBPP(dib);
+
+	//palettized bitmaps are mapped through their palette, -1 for the entries not in the global palette
+	int table[256];
+	if (bpp <= 8) {
+		const FIRGBA8 *pal = FreeImage_GetPalette(dib);
+		const unsigned colors = FreeImage_GetColorsUsed(dib);
+		for (unsigned i = 0; i < colors; i++) {
+			auto found = indices.find(PackRGB(pal[i]));
+			table[i] = (found != indices.end()) ? found->second : -1;
+		}
+	}
+
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dst(FreeImage_Allocate(width, height, 8), &FreeImage_Unload);
+	if (!dst) {
+		throw FI_MSG_ERROR_DIB_MEMORY;
+	}
+	const unsigned bytespp = bpp / 8;
+	uint32_t last_color = 0xFFFFFFFF;
+	int last_index = 0;
+	for (unsigned y = 0; y < height; y++) {
+		const uint8_t *src_bits = FreeImage_GetScanLine(dib, y);
+		uint8_t *dst_bits = FreeImage_GetScanLine(dst.get(), y);
+		for (unsigned x = 0; x < width; x++) {
+			int index;
+			if (bpp == 1) {
+				index = table[(src_bits[x >> 3] >> (7 - (x & 7))) & 0x01];
+			} else if (bpp == 4) {
+				index = table[(src_bits[x >> 1] >> ((x & 1) ? 0 : 4)) & 0x0F];
+			} else if (bpp == 8) {
+				index = table[src_bits[x]];
+			} else {
+				const uint8_t *pixel = src_bits + x * bytespp;
+				const uint32_t color = ((uint32_t)pixel[FI_RGBA_RED] << 16) | ((uint32_t)pixel[FI_RGBA_GREEN] << 8) | pixel[FI_RGBA_BLUE];
+				if (color != last_color) {
+					auto found = indices.find(color);
+					last_index = (found != indices.end()) ? found->second : -1;
+					last_color = color;
+				}
+				index = last_index;
+			}
+			if (index < 0) {
+				return nullptr;
+			}
+			dst_bits[x] = (uint8_t)index;
+		}
 	}
 
+	std::copy(info->global_palette.begin(), info->global_palette.end(), FreeImage_GetPalette(dst.get()));
+	FreeImage_CloneMetadata(dst.get(), dib);
+
+	return dst.release();
+}
+
+/**
+Returns dib as a bitmap the encoder can write, or nullptr if dib can be written as it is.
+24- and 32-bit frames are quantized, with a transparent index for the pixels of alpha < 128.
+With GIF_GLOBALPALETTE, frames whose colors all appear in the global palette are mapped onto it
+and *global is set to tell they need no local palette.
+*/
+static FIBITMAP *
+PrepareFrame(FIBITMAP *dib, int flags, const GIFinfo *info, bool *global) {
+	*global = false;
+
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	const bool reuse = ((flags & GIF_GLOBALPALETTE) == GIF_GLOBALPALETTE) && (info->global_palette_size > 0);
+
+	if (bpp <= 8) {
+		if (reuse) {
+			//a palette starting like the global one keeps its indices, including a transparent one
+			const FIRGBA8 *pal = FreeImage_GetPalette(dib);
+			const int colors = (int)FreeImage_GetColorsUsed(dib);
+			bool same = (colors <= info->global_palette_size);
+			for (int i = 0; same && i < colors; i++) {
+				same = (PackRGB(pal[i]) == PackRGB(info->global_palette[i]));
+			}
+			if (same) {
+				*global = true;
+				return nullptr;
+			}
+			//otherwise the transparent index could collide with an opaque color of the global palette
+			if (!FreeImage_IsTransparent(dib)) {
+				FIBITMAP *mapped = MapToGlobalPalette(dib, info);
+				*global = (mapped != nullptr);
+				return mapped;
+			}
+		}
+		return nullptr;
+	}
+	if (bpp != 24 && bpp != 32) {
+		throw "Only 1, 4, 8, 24 or 32 bpp images supported";
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+	bool transparent = false;
+	if (bpp == 32) {
+		for (unsigned y = 0; !transparent && y < height; y++) {
+			const uint8_t *bits = FreeImage_GetScanLine(dib, y);
+			for (unsigned x = 0; x < width; x++, bits += 4) {
+				if (bits[FI_RGBA_ALPHA] < 128) {
+					transparent = true;
+					break;
+				}
+			}
+		}
+	}
+
+	if (reuse && !transparent) {
+		if (FIBITMAP *mapped = MapToGlobalPalette(dib, info)) {
+			*global = true;
+			return mapped;
+		}
+	}
+
+	//exact colors when they fit, Wu's quantizer otherwise
+	const int palette_size = transparent ? 255 : 256;
+	FIBITMAP *dst = FreeImage_ColorQuantizeEx(dib, FIQ_LFPQUANT, palette_size);
+	if (!dst) {
+		dst = FreeImage_ColorQuantizeEx(dib, FIQ_WUQUANT, palette_size);
+	}
+	if (!dst) {
+		throw FI_MSG_ERROR_DIB_MEMORY;
+	}
+
+	if (transparent) {
+		FIRGBA8 *pal = FreeImage_GetPalette(dst);
+		pal[255].red = pal[255].green = pal[255].blue = 0;
+		for (unsigned y = 0; y < height; y++) {
+			const uint8_t *src_bits = FreeImage_GetScanLine(dib, y);
+			uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
+			for (unsigned x = 0; x < width; x++) {
+				if (src_bits[x * 4 + FI_RGBA_ALPHA] < 128) {
+					dst_bits[x] = 255;
+				}
+			}
+		}
+		uint8_t table[256];
+		memset(table, 0xFF, sizeof(table));
+		table[255] = 0;
+		FreeImage_SetTransparencyTable(dst, table, 256);
+	}
+
+	return dst;
+}
+
+/**
+Writes one frame, with the file level blocks before the first one.
+The first page runs on the calling thread and may choose the global palette, the next ones only read info.
+*/
+static FIBOOL
+EncodeFrame(FreeImageIO *io, fi_handle handle, FIBITMAP *input, int page, int flags, GIFinfo *info) {
 	try {
 		uint8_t packed, b;
 		uint16_t w;
 		FITAG *tag;
 
+		bool global = false;
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> prepared(PrepareFrame(input, flags, info, &global), &FreeImage_Unload);
+		FIBITMAP *dib = prepared ? prepared.get() : input;
+
 		int bpp = FreeImage_GetBPP(dib);
-		if (bpp != 1 && bpp != 4 && bpp != 8) {
-			throw "Only 1, 4, or 8 bpp images supported";
+
+		if (page == 0 && ((flags & GIF_GLOBALPALETTE) == GIF_GLOBALPALETTE) && info->global_palette_size == 0) {
+			//the first frame's palette becomes the global one
+			SetGlobalPalette(info, FreeImage_GetPalette(dib), 1 << bpp);
+			global = true;
 		}
 
 		bool have_transparent = false, no_local_palette = false, interlaced = false;
@@ -1097,7 +1456,9 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		if (FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "FrameTop", FIDT_SHORT, &tag)) {
 			top = *(uint16_t *)FreeImage_GetTagValue(tag);
 		}
-		if (FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "NoLocalPalette", FIDT_BYTE, &tag)) {
+		if (global) {
+			no_local_palette = true;
+		} else if (!prepared && FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "NoLocalPalette", FIDT_BYTE, &tag)) {
 			no_local_palette = *(uint8_t *)FreeImage_GetTagValue(tag) ? true : false;
 		}
 		if (FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "Interlaced", FIDT_BYTE, &tag)) {
@@ -1136,7 +1497,10 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			}
 			FIRGBA8 *globalpalette{};
 			int globalpalette_size = 0;
-			if (FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "GlobalPalette", FIDT_PALETTE, &tag)) {
+			if (info->global_palette_size > 0) {
+				globalpalette = info->global_palette.data();
+				globalpalette_size = info->global_palette_size;
+			} else if (FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "GlobalPalette", FIDT_PALETTE, &tag)) {
 				globalpalette_size = FreeImage_GetTagCount(tag);
 				if (globalpalette_size >= 2) {
 					globalpalette = (FIRGBA8 *)FreeImage_GetTagValue(tag);
@@ -1366,13 +1730,115 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		delete stringtable;
 
 	} catch (const char *msg) {
-		FreeImage_OutputMessageProc(s_format_id, msg);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(msg), msg);
 		return FALSE;
 	}
 
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+_FrameWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	auto *data = (std::vector<uint8_t> *)handle;
+	const auto *bytes = (const uint8_t *)buffer;
+	data->insert(data->end(), bytes, bytes + (size_t)size * count);
+	return count;
+}
+
+/**
+Writes the encoded frames in page order, until only keep of them are left encoding.
+Returns FALSE once a frame failed, the next ones are dropped.
+*/
+static FIBOOL
+WritePendingFrames(FreeImageIO *io, fi_handle handle, GIFinfo *info, size_t keep) {
+	while (info->pending_frames.size() > keep) {
+		std::shared_ptr<GIFFrame> frame = info->pending_frames.front();
+		info->pending_frames.pop_front();
+		{
+			std::unique_lock<std::mutex> lock(frame->mutex);
+			frame->finished.wait(lock, [&frame] { return frame->done; });
+		}
+		if (!frame->success) {
+			info->write_success = FALSE;
+		} else if (info->write_success && !frame->data.empty()) {
+			io->write_proc(frame->data.data(), (unsigned)frame->data.size(), 1, handle);
+		}
+	}
+	return info->write_success;
+}
+
+static FIBOOL DLL_CALLCONV 
+Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
+	if (!data) {
+		return FALSE;
+	}
+	GIFinfo *info = (GIFinfo *)data;
+
+	if (page == -1) {
+		page = 0;
+	}
+
+	if (page == 0) {
+		info->global_palette_size = 0;
+		FITAG *tag{};
+		if (((flags & GIF_GLOBALPALETTE) == GIF_GLOBALPALETTE) && FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "GlobalPalette", FIDT_PALETTE, &tag) && FreeImage_GetTagCount(tag) >= 2) {
+			SetGlobalPalette(info, (const FIRGBA8 *)FreeImage_GetTagValue(tag), (int)FreeImage_GetTagCount(tag));
+		}
+	}
+
+	//the first page chooses the global palette for the next ones, so it is encoded in place
+	if (page == 0 || FreeImage_GetThreadCount() < 2 || ThreadPool::IsWorkerThread()) {
+		const FIBOOL written = WritePendingFrames(io, handle, info, 0);
+		return (EncodeFrame(io, handle, dib, page, flags, info) && written) ? TRUE : FALSE;
+	}
+
+	//quantize and compress this frame on the thread pool while the previous ones are written,
+	//the caller keeps the ownership of dib so the frame works on a (copy-on-write) clone
+	FIBITMAP *clone = FreeImage_Clone(dib);
+	if (!clone) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_DIB_MEMORY, FI_MSG_ERROR_DIB_MEMORY);
+		return FALSE;
+	}
+	bool started = false;
+	try {
+		auto frame = std::make_shared<GIFFrame>();
+		std::function<void()> task = [frame, clone, page, flags, info]() {
+			FreeImageIO frame_io{};
+			frame_io.write_proc = _FrameWriteProc;
+			FIBOOL success = FALSE;
+			try {
+				success = EncodeFrame(&frame_io, (fi_handle)&frame->data, clone, page, flags, info);
+			} catch (...) {
+				FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+			}
+			FreeImage_Unload(clone);
+			std::lock_guard<std::mutex> lock(frame->mutex);
+			frame->success = success;
+			frame->done = true;
+			frame->finished.notify_all();
+		};
+		info->pending_frames.push_back(frame);
+		try {
+			if (!ThreadPool::Instance().Submit(task)) {
+				task();
+			}
+			started = true;
+		} catch (...) {
+			info->pending_frames.pop_back();
+			throw;
+		}
+	} catch (...) {
+		if (!started) {
+			FreeImage_Unload(clone);
+		}
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+		return FALSE;
+	}
+
+	//one frame per worker keeps encoding
+	return WritePendingFrames(io, handle, info, FreeImage_GetThreadCount() - 1);
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
@@ -1396,4 +1862,6 @@ InitGIF(Plugin *plugin, int format_id) {
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -21,6 +21,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImage/ConversionSIMD.h"
+#include "FreeImage/Plugin.h"
 
 // ==========================================================
 // Plugin Interface
@@ -37,6 +39,9 @@ static int s_format_id;
 // maximum size of a line in the header
 #define HDR_MAXLINE	256
 
+// size of the chunks read from streams which are not in memory
+#define HDR_READ_CHUNK	(64 * 1024)
+
 // flags indicating which fields in an rgbeHeaderInfo are valid
 #define RGBE_VALID_PROGRAMTYPE	0x01
 #define RGBE_VALID_COMMENT		0x02
@@ -76,21 +81,80 @@ typedef enum {
 	rgbe_memory_error
 } rgbe_error_code;
 
+/**
+Bulk reader of the pixel data. Memory streams are read in place, other streams by chunks of HDR_READ_CHUNK bytes.
+The stream is positioned after the last byte used when the reader is destroyed.
+*/
+class rgbeReader {
+public:
+	rgbeReader(FreeImageIO *io, fi_handle handle) : m_io(io), m_handle(handle) {
+		uint64_t available = 0;
+		if (const uint8_t *bytes = FreeImage_PeekMemoryIO(io, handle, &available)) {
+			m_start = m_pos = bytes;
+			m_end = bytes + available;
+			m_in_place = true;
+		}
+	}
+
+	~rgbeReader() {
+		if (m_in_place) {
+			m_io->seek_proc(m_handle, (long)(m_pos - m_start), SEEK_CUR);
+		}
+		else if (m_end != m_pos) {
+			m_io->seek_proc(m_handle, -(long)(m_end - m_pos), SEEK_CUR);
+		}
+	}
+
+	/**
+	Returns the next size bytes, or nullptr when the stream is too short
+	*/
+	const uint8_t* Read(size_t size) {
+		if ((size_t)(m_end - m_pos) < size) {
+			if (m_in_place || !Fill(size)) {
+				return nullptr;
+			}
+		}
+		const uint8_t *bytes = m_pos;
+		m_pos += size;
+		return bytes;
+	}
+
+private:
+	bool Fill(size_t size) {
+		// keep the unused bytes, then read a new chunk after them
+		const size_t remaining = m_end - m_pos;
+		if (remaining && (m_pos != m_chunk.data())) {
+			memmove(m_chunk.data(), m_pos, remaining);
+		}
+		m_chunk.resize(std::max<size_t>(size, HDR_READ_CHUNK));
+		const unsigned count = m_io->read_proc(m_chunk.data() + remaining, 1, (unsigned)(m_chunk.size() - remaining), m_handle);
+		m_pos = m_chunk.data();
+		m_end = m_pos + remaining + count;
+		return (remaining + count) >= size;
+	}
+
+	FreeImageIO *m_io;
+	fi_handle m_handle;
+	std::vector<uint8_t> m_chunk;
+	const uint8_t *m_start{};
+	const uint8_t *m_pos{};
+	const uint8_t *m_end{};
+	bool m_in_place{};
+};
+
 // ----------------------------------------------------------
 // Prototypes
 // ----------------------------------------------------------
 
 static FIBOOL rgbe_Error(rgbe_error_code error_code, const char *msg);
 static FIBOOL rgbe_GetLine(FreeImageIO *io, fi_handle handle, char *buffer, int length);
-static inline void rgbe_FloatToRGBE(uint8_t rgbe[4], FIRGBF *rgbf);
-static inline void rgbe_RGBEToFloat(FIRGBF *rgbf, uint8_t rgbe[4]);
 static FIBOOL rgbe_ReadHeader(FreeImageIO *io, fi_handle handle, unsigned *width, unsigned *height, rgbeHeaderInfo *header_info);
 static FIBOOL rgbe_WriteHeader(FreeImageIO *io, fi_handle handle, unsigned width, unsigned height, rgbeHeaderInfo *info);
-static FIBOOL rgbe_ReadPixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels);
-static FIBOOL rgbe_WritePixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels);
-static FIBOOL rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, int scanline_width, unsigned num_scanlines);
-static FIBOOL rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, uint8_t *data, int numbytes);
-static FIBOOL rgbe_WritePixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned scanline_width, unsigned num_scanlines);
+static FIBOOL rgbe_ReadPixels(rgbeReader &reader, uint8_t *data, size_t numpixels);
+static void rgbe_WritePixels(std::vector<uint8_t> &output, const FIRGBF *data, unsigned numpixels);
+static FIBOOL rgbe_ReadPixels_RLE(rgbeReader &reader, uint8_t *data, int scanline_width, unsigned num_scanlines);
+static void rgbe_WriteBytes_RLE(std::vector<uint8_t> &output, const uint8_t *data, int numbytes);
+static void rgbe_WritePixels_RLE(std::vector<uint8_t> &output, std::vector<uint8_t> &buffer, const FIRGBF *data, unsigned scanline_width);
 static FIBOOL rgbe_ReadMetadata(FIBITMAP *dib, rgbeHeaderInfo *header_info);
 static FIBOOL rgbe_WriteMetadata(FIBITMAP *dib, rgbeHeaderInfo *header_info);
 
@@ -138,50 +202,6 @@ rgbe_GetLine(FreeImageIO *io, fi_handle handle, char *buffer, int length) {
 	return (i < length) ? TRUE : FALSE;
 }
 
-/**
-Standard conversion from float pixels to rgbe pixels. 
-Note: you can remove the "inline"s if your compiler complains about it 
-*/
-static inline void 
-rgbe_FloatToRGBE(uint8_t rgbe[4], FIRGBF *rgbf) {
-	float v = rgbf->red;
-	if (rgbf->green > v) {
-		v = rgbf->green;
-	}
-	if (rgbf->blue > v) {
-		v = rgbf->blue;
-	}
-	if (v < 1e-32) {
-		rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
-	}
-	else {
-		int e;
-		v = (float)(frexp(v, &e) * 256.0 / v);
-		rgbe[0] = (uint8_t) (rgbf->red * v);
-		rgbe[1] = (uint8_t) (rgbf->green * v);
-		rgbe[2] = (uint8_t) (rgbf->blue * v);
-		rgbe[3] = (uint8_t) (e + 128);
-	}
-}
-
-/**
-Standard conversion from rgbe to float pixels. 
-Note: Ward uses ldexp(col+0.5,exp-(128+8)). 
-However we wanted pixels in the range [0,1] to map back into the range [0,1].
-*/
-static inline void 
-rgbe_RGBEToFloat(FIRGBF *rgbf, uint8_t rgbe[4]) {
-	if (rgbe[3]) {   // nonzero pixel
-		const float f = (float)(ldexp(1.0, rgbe[3] - (int)(128+8)));
-		rgbf->red   = rgbe[0] * f;
-		rgbf->green = rgbe[1] * f;
-		rgbf->blue  = rgbe[2] * f;
-	}
-	else {
-		rgbf->red = rgbf->green = rgbf->blue = 0;
-	}
-}
-
 /**
 Minimal header reading. Modify if you want to parse more information 
 */
@@ -326,118 +346,95 @@ rgbe_WriteMetadata(FIBITMAP *dib, rgbeHeaderInfo *header_info) {
 }
 
 /** 
-Simple read routine. Will not correctly handle run length encoding 
+Simple read routine, for the files which are not run length encoded
 */
 static FIBOOL 
-rgbe_ReadPixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels) {
-  uint8_t rgbe[4];
-
-  for (unsigned x = 0; x < numpixels; x++) {
-	if (io->read_proc(rgbe, 1, sizeof(rgbe), handle) < 1) {
+rgbe_ReadPixels(rgbeReader &reader, uint8_t *data, size_t numpixels) {
+	const uint8_t *rgbe = reader.Read(4 * numpixels);
+	if (!rgbe) {
 		return rgbe_Error(rgbe_read_error, nullptr);
 	}
-	rgbe_RGBEToFloat(&data[x], rgbe);
-  }
+	memcpy(data, rgbe, 4 * numpixels);
 
-  return TRUE;
+	return TRUE;
 }
 
 /**
  Simple write routine that does not use run length encoding. 
- These routines can be made faster by allocating a larger buffer and
- fread-ing and fwrite-ing the data in larger chunks.
 */
-static FIBOOL 
-rgbe_WritePixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels) {
-  uint8_t rgbe[4];
-
-  for (unsigned x = 0; x < numpixels; x++) {
-	  rgbe_FloatToRGBE(rgbe, &data[x]);
-	  if (io->write_proc(rgbe, sizeof(rgbe), 1, handle) < 1) {
-		  return rgbe_Error(rgbe_write_error, nullptr);
-	  }
-  }
-
-  return TRUE;
+static void 
+rgbe_WritePixels(std::vector<uint8_t> &output, const FIRGBF *data, unsigned numpixels) {
+	const size_t size = output.size();
+	output.resize(size + 4 * (size_t)numpixels);
+	ConvertFloatToRGBE(output.data() + size, data, numpixels);
 }
 
+/**
+Reads num_scanlines of RGBE pixels, each channel of a run length encoded scanline is stored interleaved in data
+*/
 static FIBOOL 
-rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, int scanline_width, unsigned num_scanlines) {
-	uint8_t rgbe[4], *scanline_buffer{}, *ptr, *ptr_end;
-	int i, count;
-	uint8_t buf[2];
-	
+rgbe_ReadPixels_RLE(rgbeReader &reader, uint8_t *data, int scanline_width, unsigned num_scanlines) {
 	if ((scanline_width < 8)||(scanline_width > 0x7fff)) {
 		// run length encoding is not allowed so read flat
-		return rgbe_ReadPixels(io, handle, data, scanline_width * num_scanlines);
+		return rgbe_ReadPixels(reader, data, (size_t)scanline_width * num_scanlines);
 	}
-	std::unique_ptr<void, decltype(&free)> safeScanlineBuffer(nullptr, &free);
 	// read in each successive scanline 
 	while (num_scanlines > 0) {
-		if (io->read_proc(rgbe, 1, sizeof(rgbe), handle) < 1) {
+		const uint8_t *rgbe = reader.Read(4);
+		if (!rgbe) {
 			return rgbe_Error(rgbe_read_error, nullptr);
 		}
 		if ((rgbe[0] != 2) || (rgbe[1] != 2) || (rgbe[2] & 0x80)) {
-			// this file is not run length encoded
-			rgbe_RGBEToFloat(data, rgbe);
-			data ++;
-			return rgbe_ReadPixels(io, handle, data, scanline_width * num_scanlines - 1);
-		}
-		if ((((int)rgbe[2]) << 8 | rgbe[3]) != scanline_width) {
-			return rgbe_Error(rgbe_format_error,"wrong scanline width");
-		}
-		if (!scanline_buffer) {
-			safeScanlineBuffer.reset(malloc(sizeof(uint8_t) * 4 * scanline_width));
-			if (!safeScanlineBuffer) {
-				return rgbe_Error(rgbe_memory_error, "unable to allocate buffer space");
+			// this scanline is not run length encoded
+			memcpy(data, rgbe, 4);
+			if (!rgbe_ReadPixels(reader, data + 4, scanline_width - 1)) {
+				return FALSE;
 			}
-			scanline_buffer = static_cast<uint8_t*>(safeScanlineBuffer.get());
-		}
-		
-		ptr = &scanline_buffer[0];
-		// read each of the four channels for the scanline into the buffer
-		for (i = 0; i < 4; i++) {
-			ptr_end = &scanline_buffer[(i+1)*scanline_width];
-			while (ptr < ptr_end) {
-				if (io->read_proc(buf, 1, 2 * sizeof(uint8_t), handle) < 1) {
-					return rgbe_Error(rgbe_read_error, nullptr);
-				}
-				if (buf[0] > 128) {
-					// a run of the same value
-					count = buf[0] - 128;
-					if ((count == 0) || (count > ptr_end - ptr)) {
-						return rgbe_Error(rgbe_format_error, "bad scanline data");
-					}
-					while (count-- > 0) {
-						*ptr++ = buf[1];
+		}
+		else {
+			if ((((int)rgbe[2]) << 8 | rgbe[3]) != scanline_width) {
+				return rgbe_Error(rgbe_format_error,"wrong scanline width");
+			}
+			// read each of the four channels for the scanline
+			for (int i = 0; i < 4; i++) {
+				uint8_t *ptr = data + i;
+				int x = 0;
+				while (x < scanline_width) {
+					const uint8_t *buf = reader.Read(2);
+					if (!buf) {
+						return rgbe_Error(rgbe_read_error, nullptr);
 					}
-				}
-				else {
-					// a non-run
-					count = buf[0];
-					if ((count == 0) || (count > ptr_end - ptr)) {
+					int count = (buf[0] > 128) ? buf[0] - 128 : buf[0];
+					if ((count == 0) || (count > scanline_width - x)) {
 						return rgbe_Error(rgbe_format_error, "bad scanline data");
 					}
-					*ptr++ = buf[1];
-					if (--count > 0) {
-						if (io->read_proc(ptr, 1, sizeof(uint8_t) * count, handle) < 1) {
-							return rgbe_Error(rgbe_read_error, nullptr);
+					x += count;
+					if (buf[0] > 128) {
+						// a run of the same value
+						while (count-- > 0) {
+							*ptr = buf[1];
+							ptr += 4;
+						}
+					}
+					else {
+						// a non-run
+						*ptr = buf[1];
+						ptr += 4;
+						if (--count > 0) {
+							const uint8_t *bytes = reader.Read(count);
+							if (!bytes) {
+								return rgbe_Error(rgbe_read_error, nullptr);
+							}
+							for (int k = 0; k < count; k++) {
+								*ptr = bytes[k];
+								ptr += 4;
+							}
 						}
-						ptr += count;
 					}
 				}
 			}
 		}
-		// now convert data from buffer into floats
-		for (i = 0; i < scanline_width; i++) {
-			rgbe[0] = scanline_buffer[i];
-			rgbe[1] = scanline_buffer[i+scanline_width];
-			rgbe[2] = scanline_buffer[i+2*scanline_width];
-			rgbe[3] = scanline_buffer[i+3*scanline_width];
-			rgbe_RGBEToFloat(data, rgbe);
-			data ++;
-		}
-
+		data += 4 * (size_t)scanline_width;
 		num_scanlines--;
 	}
 
@@ -449,13 +446,11 @@ rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, int scanlin
  Run length encoding adds considerable complexity but does 
  save some space.  For each scanline, each channel (r,g,b,e) is 
  encoded separately for better compression. 
- @return Returns TRUE if successful, returns FALSE otherwise
 */
-static FIBOOL 
-rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, uint8_t *data, int numbytes) {
+static void 
+rgbe_WriteBytes_RLE(std::vector<uint8_t> &output, const uint8_t *data, int numbytes) {
 	static const int MINRUNLENGTH = 4;
 	int cur, beg_run, run_count, old_run_count, nonrun_count;
-	uint8_t buf[2];
 	
 	cur = 0;
 	while (cur < numbytes) {
@@ -472,11 +467,8 @@ rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, uint8_t *data, int numbyt
 		}
 		// if data before next big run is a short run then write it as such 
 		if ((old_run_count > 1)&&(old_run_count == beg_run - cur)) {
-			buf[0] = (uint8_t)(128 + old_run_count);   // write short run
-			buf[1] = data[cur];
-			if (io->write_proc(buf, 2 * sizeof(uint8_t), 1, handle) < 1) {
-				return rgbe_Error(rgbe_write_error, nullptr);
-			}
+			output.push_back((uint8_t)(128 + old_run_count));   // write short run
+			output.push_back(data[cur]);
 			cur = beg_run;
 		}
 		// write out bytes until we reach the start of the next run 
@@ -485,74 +477,52 @@ rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, uint8_t *data, int numbyt
 			if (nonrun_count > 128) {
 				nonrun_count = 128;
 			}
-			buf[0] = (uint8_t)nonrun_count;
-			if (io->write_proc(buf, sizeof(buf[0]), 1, handle) < 1) {
-				return rgbe_Error(rgbe_write_error, nullptr);
-			}
-			if (io->write_proc(&data[cur], sizeof(data[0]) * nonrun_count, 1, handle) < 1) {
-				return rgbe_Error(rgbe_write_error, nullptr);
-			}
+			output.push_back((uint8_t)nonrun_count);
+			output.insert(output.end(), data + cur, data + cur + nonrun_count);
 			cur += nonrun_count;
 		}
 		// write out next run if one was found 
 		if (run_count >= MINRUNLENGTH) {
-			buf[0] = (uint8_t)(128 + run_count);
-			buf[1] = data[beg_run];
-			if (io->write_proc(buf, sizeof(buf[0]) * 2, 1, handle) < 1) {
-				return rgbe_Error(rgbe_write_error, nullptr);
-			}
+			output.push_back((uint8_t)(128 + run_count));
+			output.push_back(data[beg_run]);
 			cur += run_count;
 		}
 	}
-	
-	return TRUE;
 }
 
-static FIBOOL 
-rgbe_WritePixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned scanline_width, unsigned num_scanlines) {
-	uint8_t rgbe[4];
-
+/**
+Encodes a scanline into output, buffer is a scratch area reused between scanlines
+*/
+static void 
+rgbe_WritePixels_RLE(std::vector<uint8_t> &output, std::vector<uint8_t> &buffer, const FIRGBF *data, unsigned scanline_width) {
 	if ((scanline_width < 8)||(scanline_width > 0x7fff)) {
 		// run length encoding is not allowed so write flat
-		return rgbe_WritePixels(io, handle, data, scanline_width * num_scanlines);
-	}
-	std::unique_ptr<void, decltype(&free)> safeBuffer(malloc(sizeof(uint8_t) * 4 * scanline_width), &free);;
-	if (!safeBuffer) {
-		// no buffer space so write flat 
-		return rgbe_WritePixels(io, handle, data, scanline_width * num_scanlines);
+		rgbe_WritePixels(output, data, scanline_width);
+		return;
+	}
+	buffer.resize(8 * (size_t)scanline_width);
+	uint8_t *rgbe = buffer.data();
+	uint8_t *planes = rgbe + 4 * (size_t)scanline_width;
+
+	output.push_back((uint8_t)2);
+	output.push_back((uint8_t)2);
+	output.push_back((uint8_t)(scanline_width >> 8));
+	output.push_back((uint8_t)(scanline_width & 0xFF));
+
+	ConvertFloatToRGBE(rgbe, data, scanline_width);
+	for (unsigned x = 0; x < scanline_width; x++) {
+		planes[x] = rgbe[4*x];
+		planes[x+scanline_width] = rgbe[4*x+1];
+		planes[x+2*scanline_width] = rgbe[4*x+2];
+		planes[x+3*scanline_width] = rgbe[4*x+3];
+	}
+	// write out each of the four channels separately run length encoded
+	// first red, then green, then blue, then exponent
+	for (int i = 0; i < 4; i++) {
+		rgbe_WriteBytes_RLE(output, &planes[i*scanline_width], scanline_width);
 	}
-	auto *buffer = static_cast<uint8_t*>(safeBuffer.get());
-
-	while (num_scanlines-- > 0) {
-		rgbe[0] = (uint8_t)2;
-		rgbe[1] = (uint8_t)2;
-		rgbe[2] = (uint8_t)(scanline_width >> 8);
-		rgbe[3] = (uint8_t)(scanline_width & 0xFF);
-		if (io->write_proc(rgbe, sizeof(rgbe), 1, handle) < 1) {
-			return rgbe_Error(rgbe_write_error, nullptr);
-		}
-		for (unsigned x = 0; x < scanline_width; x++) {
-			rgbe_FloatToRGBE(rgbe, data);
-			buffer[x] = rgbe[0];
-			buffer[x+scanline_width] = rgbe[1];
-			buffer[x+2*scanline_width] = rgbe[2];
-			buffer[x+3*scanline_width] = rgbe[3];
-			data ++;
-		}
-		// write out each of the four channels separately run length encoded
-		// first red, then green, then blue, then exponent
-		for (int i = 0; i < 4; i++) {
-			FIBOOL bOK = rgbe_WriteBytes_RLE(io, handle, &buffer[i*scanline_width], scanline_width);
-			if (!bOK) {
-				return bOK;
-			}
-		}
-	}
-
-	return TRUE;
 }
 
-
 // ----------------------------------------------------------
 
 
@@ -611,6 +581,11 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // --------------------------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -645,24 +620,101 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			return dib.release();
 		}
 
-		// read the image pixels and fill the dib
-		
-		for (unsigned y = 0; y < height; y++) {
-			FIRGBF *scanline = (FIRGBF*)FreeImage_GetScanLine(dib.get(), height - 1 - y);
-			if (!rgbe_ReadPixels_RLE(io, handle, scanline, width, 1)) {
+		// read the image pixels in bulk, then convert them to floats by parallel bands
+
+		const size_t line_size = 4 * (size_t)width;
+		std::unique_ptr<void, decltype(&free)> safePixels(malloc(line_size * height), &free);
+		if (!safePixels) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+		auto *pixels = static_cast<uint8_t*>(safePixels.get());
+		{
+			rgbeReader reader(io, handle);
+			if (!rgbe_ReadPixels_RLE(reader, pixels, width, height)) {
 				return nullptr;
 			}
 		}
 
+		ParallelFor(0, height, CalculateBandRows(width * sizeof(FIRGBF)), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				auto *scanline = (FIRGBF*)FreeImage_GetScanLine(dib.get(), height - 1 - y);
+				ConvertRGBEToFloat(scanline, pixels + line_size * y, width);
+			}
+		});
+
 		return dib.release();
 	}
 	catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 	}
 
 	return nullptr;
 }
 
+// ==========================================================
+//   Scanline decoder
+// ==========================================================
+
+namespace {
+
+	class HDRScanlineDecoder : public ScanlineDecoder
+	{
+	public:
+		HDRScanlineDecoder(FIBITMAP *info, FreeImageIO *io, fi_handle handle)
+			: ScanlineDecoder(info), mReader(io, handle), mLine(4 * (size_t)FreeImage_GetWidth(info))
+		{ }
+
+		unsigned Read(uint8_t *buffer, unsigned count, unsigned pitch) override {
+			const unsigned width = FreeImage_GetWidth(GetInfo());
+			const unsigned height = FreeImage_GetHeight(GetInfo());
+
+			unsigned n = 0;
+			for (; !mFailed && (mRow < height) && (n < count); n++, mRow++) {
+				// flat and run length encoded scanlines are decoded one at a time
+				if (!rgbe_ReadPixels_RLE(mReader, mLine.data(), width, 1)) {
+					mFailed = true;
+					break;
+				}
+				ConvertRGBEToFloat((FIRGBF*)(buffer + (size_t)n * pitch), mLine.data(), width);
+			}
+			return n;
+		}
+
+	private:
+		rgbeReader mReader;
+		std::vector<uint8_t> mLine;
+		unsigned mRow{ 0 };
+		bool mFailed{ false };
+	};
+
+} // namespace
+
+std::unique_ptr<ScanlineDecoder>
+CreateScanlineDecoderHDR(FreeImageIO *io, fi_handle handle, int flags) {
+	try {
+		rgbeHeaderInfo header_info;
+		unsigned width, height;
+
+		if (!rgbe_ReadHeader(io, handle, &width, &height, &header_info)) {
+			return nullptr;
+		}
+
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> info(FreeImage_AllocateHeaderT(TRUE, FIT_RGBF, width, height), &FreeImage_Unload);
+		if (!info) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+		rgbe_ReadMetadata(info.get(), &header_info);
+
+		auto decoder = std::make_unique<HDRScanlineDecoder>(info.get(), io, handle);
+		info.release();
+		return decoder;
+	}
+	catch (const char *text) {
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
+	}
+	return nullptr;
+}
+
 static FIBOOL DLL_CALLCONV
 Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
 	if (!dib) return FALSE;
@@ -688,12 +740,20 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		return FALSE;
 	}
 
-	// write each scanline
+	// encode the scanlines by parallel bands, then write them in order
 
-	for (unsigned y = 0; y < height; y++) {
-		auto *scanline = (FIRGBF*)FreeImage_GetScanLine(dib, height - 1 - y);
-		if (!rgbe_WritePixels_RLE(io, handle, scanline, width, 1)) {
-			return FALSE;
+	std::vector<std::vector<uint8_t>> encoded(height);
+	ParallelFor(0, height, CalculateBandRows(width * sizeof(FIRGBF)), [&](unsigned first, unsigned last) {
+		std::vector<uint8_t> buffer;
+		for (unsigned y = first; y < last; y++) {
+			const auto *scanline = (const FIRGBF*)FreeImage_GetConstScanLine(dib, height - 1 - y);
+			rgbe_WritePixels_RLE(encoded[y], buffer, scanline, width);
+		}
+	});
+
+	for (const auto& line : encoded) {
+		if (!line.empty() && (io->write_proc((void*)line.data(), (unsigned)line.size(), 1, handle) < 1)) {
+			return rgbe_Error(rgbe_write_error, nullptr);
 		}
 	}
 
@@ -724,4 +784,5 @@ InitHDR(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -18,9 +18,12 @@
 #include "Utilities.h"
 #include "Metadata/FreeImageTag.h"
 #include "FreeImage/SimpleTools.h"
+#include "FreeImage/Plugin.h"
 
+#include <algorithm>
 #include <array>
 #include <cstring>
+#include <string>
 #include "yato/types.h"
 #include "yato/finally.h"
 #include <libheif/heif.h>
@@ -120,6 +123,7 @@ public:
     decltype(&::heif_context_alloc) heif_context_alloc_f{ nullptr };
     decltype(&::heif_context_free) heif_context_free_f{ nullptr };
     decltype(&::heif_context_read_from_reader) heif_context_read_from_reader_f{ nullptr };
+    decltype(&::heif_context_set_max_decoding_threads) heif_context_set_max_decoding_threads_f{ nullptr };
     decltype(&::heif_context_write) heif_context_write_f{ nullptr };
     decltype(&::heif_context_get_primary_image_handle) heif_context_get_primary_image_handle_f{ nullptr };
     decltype(&::heif_context_get_encoder_for_format) heif_context_get_encoder_for_format_f{ nullptr };
@@ -138,14 +142,20 @@ public:
     decltype(&::heif_image_create) heif_image_create_f{ nullptr };
     decltype(&::heif_image_release) heif_image_release_f{ nullptr };
     decltype(&::heif_image_add_plane) heif_image_add_plane_f{ nullptr };
+    decltype(&::heif_image_get_width) heif_image_get_width_f{ nullptr };
+    decltype(&::heif_image_get_height) heif_image_get_height_f{ nullptr };
     decltype(&::heif_image_get_bits_per_pixel) heif_image_get_bits_per_pixel_f{ nullptr };
     decltype(&::heif_image_get_plane_readonly) heif_image_get_plane_readonly_f{ nullptr };
     decltype(&::heif_image_get_plane) heif_image_get_plane_f{ nullptr };
     decltype(&::heif_encoder_release) heif_encoder_release_f{ nullptr };
     decltype(&::heif_encoder_set_lossy_quality) heif_encoder_set_lossy_quality_f{ nullptr };
+    decltype(&::heif_encoder_set_lossless) heif_encoder_set_lossless_f{ nullptr };
+    decltype(&::heif_encoder_set_parameter) heif_encoder_set_parameter_f{ nullptr };
     decltype(&::heif_image_handle_get_number_of_thumbnails) heif_image_handle_get_number_of_thumbnails_f{ nullptr };
     decltype(&::heif_image_handle_get_list_of_thumbnail_IDs) heif_image_handle_get_list_of_thumbnail_IDs_f{ nullptr };
     decltype(&::heif_image_handle_get_thumbnail) heif_image_handle_get_thumbnail_f{ nullptr };
+    decltype(&::heif_image_handle_get_image_tiling) heif_image_handle_get_image_tiling_f{ nullptr };
+    decltype(&::heif_image_handle_decode_image_tile) heif_image_handle_decode_image_tile_f{ nullptr };
 
 private:
     LibHeif()
@@ -169,6 +179,7 @@ private:
         heif_context_alloc_f = LoadSymbol<decltype(&::heif_context_alloc)>("heif_context_alloc");
         heif_context_free_f = LoadSymbol<decltype(&::heif_context_free)>("heif_context_free");
         heif_context_read_from_reader_f = LoadSymbol<decltype(&::heif_context_read_from_reader)>("heif_context_read_from_reader");
+        heif_context_set_max_decoding_threads_f = LoadSymbol<decltype(&::heif_context_set_max_decoding_threads)>("heif_context_set_max_decoding_threads", /*required=*/false);
         heif_context_write_f = LoadSymbol<decltype(&::heif_context_write)>("heif_context_write");
         heif_context_get_primary_image_handle_f = LoadSymbol<decltype(&::heif_context_get_primary_image_handle)>("heif_context_get_primary_image_handle");
         heif_context_get_encoder_for_format_f = LoadSymbol<decltype(&::heif_context_get_encoder_for_format)>("heif_context_get_encoder_for_format");
@@ -186,15 +197,22 @@ private:
         heif_image_release_f = LoadSymbol<decltype(&::heif_image_release)>("heif_image_release");
         heif_image_add_plane_f = LoadSymbol<decltype(&::heif_image_add_plane)>("heif_image_add_plane");
         heif_image_handle_has_alpha_channel_f = LoadSymbol<decltype(&::heif_image_handle_has_alpha_channel)>("heif_image_handle_has_alpha_channel");
+        heif_image_get_width_f = LoadSymbol<decltype(&::heif_image_get_width)>("heif_image_get_width");
+        heif_image_get_height_f = LoadSymbol<decltype(&::heif_image_get_height)>("heif_image_get_height");
         heif_image_get_bits_per_pixel_f = LoadSymbol<decltype(&::heif_image_get_bits_per_pixel)>("heif_image_get_bits_per_pixel");
         heif_image_get_plane_readonly_f = LoadSymbol<decltype(&::heif_image_get_plane_readonly)>("heif_image_get_plane_readonly");
         heif_image_get_plane_f = LoadSymbol<decltype(&::heif_image_get_plane)>("heif_image_get_plane");
         heif_encoder_release_f = LoadSymbol<decltype(&::heif_encoder_release)>("heif_encoder_release");
         heif_encoder_set_lossy_quality_f = LoadSymbol<decltype(&::heif_encoder_set_lossy_quality)>("heif_encoder_set_lossy_quality");
+        heif_encoder_set_lossless_f = LoadSymbol<decltype(&::heif_encoder_set_lossless)>("heif_encoder_set_lossless");
+        heif_encoder_set_parameter_f = LoadSymbol<decltype(&::heif_encoder_set_parameter)>("heif_encoder_set_parameter");
         heif_context_encode_image_f = LoadSymbol<decltype(&::heif_context_encode_image)>("heif_context_encode_image");
         heif_image_handle_get_number_of_thumbnails_f = LoadSymbol<decltype(&::heif_image_handle_get_number_of_thumbnails)>("heif_image_handle_get_number_of_thumbnails", /*required=*/false);
         heif_image_handle_get_list_of_thumbnail_IDs_f = LoadSymbol<decltype(&::heif_image_handle_get_list_of_thumbnail_IDs)>("heif_image_handle_get_list_of_thumbnail_IDs", /*required=*/false);
         heif_image_handle_get_thumbnail_f = LoadSymbol<decltype(&::heif_image_handle_get_thumbnail)>("heif_image_handle_get_thumbnail", /*required=*/false);
+        // libheif 1.19+
+        heif_image_handle_get_image_tiling_f = LoadSymbol<decltype(&::heif_image_handle_get_image_tiling)>("heif_image_handle_get_image_tiling", /*required=*/false);
+        heif_image_handle_decode_image_tile_f = LoadSymbol<decltype(&::heif_image_handle_decode_image_tile)>("heif_image_handle_decode_image_tile", /*required=*/false);
 
         if (heif_init_f) {
             heif_init_f(nullptr);
@@ -203,6 +221,185 @@ private:
 };
 
 
+/**
+ * heif_context reading from a FreeImageIO stream.
+ * libheif reads the image data lazily, so the reader has to live as long as the context.
+ */
+class HeifInput
+{
+public:
+    HeifInput(LibHeif& libHeif, FreeImageIO* io, fi_handle handle)
+        : mLibHeif(libHeif), mIO(io), mHandle(handle)
+    {
+        mContext = mLibHeif.heif_context_alloc_f();
+        if (!mContext) {
+            throw std::runtime_error("PluginHeif[Load]: Failed to allocate heif_context.");
+        }
+
+        // grid tiles are decoded in parallel by libheif
+        if (mLibHeif.heif_context_set_max_decoding_threads_f) {
+            mLibHeif.heif_context_set_max_decoding_threads_f(mContext, yato::narrow_cast<int>(FreeImage_GetThreadCount()));
+        }
+
+        mIO->seek_proc(mHandle, 0, SEEK_END);
+        mFileSize = mIO->tell_proc(mHandle);
+        mIO->seek_proc(mHandle, 0, SEEK_SET);
+
+        mReader.reader_api_version = 1;
+        mReader.get_position = [](void* userdata) -> int64_t {
+            const auto* self = yato::pointer_cast<HeifInput*>(userdata);
+            return self->mIO->tell_proc(self->mHandle);
+        };
+        mReader.read = [](void* data, size_t size, void* userdata) -> int {
+            const auto* self = yato::pointer_cast<HeifInput*>(userdata);
+            if (size == self->mIO->read_proc(data, 1U, yato::narrow_cast<unsigned>(size), self->mHandle)) {
+                return 0; // success
+            }
+            return 1; // error
+        };
+        mReader.seek = [](int64_t position, void* userdata) -> int {
+            const auto* self = yato::pointer_cast<HeifInput*>(userdata);
+            return self->mIO->seek_proc(self->mHandle, yato::narrow_cast<long>(position), SEEK_SET);
+        };
+        mReader.wait_for_file_size = [](int64_t target_size, void* userdata) -> heif_reader_grow_status {
+            const auto* self = yato::pointer_cast<HeifInput*>(userdata);
+            if (target_size >= 0 && yato::narrow_cast<size_t>(target_size) <= self->mFileSize) {
+                return heif_reader_grow_status::heif_reader_grow_status_size_reached;
+            }
+            return heif_reader_grow_status::heif_reader_grow_status_size_beyond_eof;
+        };
+
+        const auto heifError = mLibHeif.heif_context_read_from_reader_f(mContext, &mReader, this, nullptr);
+        if (heifError.code != heif_error_Ok) {
+            mLibHeif.heif_context_free_f(mContext);
+            throw std::runtime_error(std::string("PluginHeif[Load]: Error in heif_context_read_from_reader(). ") + heifError.message);
+        }
+    }
+
+    HeifInput(const HeifInput&) = delete;
+    HeifInput(HeifInput&&) = delete;
+
+    ~HeifInput() {
+        mLibHeif.heif_context_free_f(mContext);
+    }
+
+    HeifInput& operator=(const HeifInput&) = delete;
+    HeifInput& operator=(HeifInput&&) = delete;
+
+    /**
+     * Returns the primary image handle, to be released with heif_image_handle_release
+     */
+    heif_image_handle* GetPrimaryImageHandle() const {
+        heif_image_handle* heifImageHandle{};
+        const auto heifError = mLibHeif.heif_context_get_primary_image_handle_f(mContext, &heifImageHandle);
+        if (heifError.code != heif_error_Ok) {
+            throw std::runtime_error(std::string("PluginHeif[Load]: Error in heif_context_get_primary_image_handle(). ") + heifError.message);
+        }
+        return heifImageHandle;
+    }
+
+private:
+    LibHeif& mLibHeif;
+    FreeImageIO* mIO{};
+    fi_handle mHandle{};
+    size_t mFileSize{};
+    heif_reader mReader{};
+    heif_context* mContext{};
+};
+
+
+/**
+ * Returns the handle of the first thumbnail of an image, or nullptr when there is none.
+ * The handle is released with heif_image_handle_release.
+ */
+static heif_image_handle* GetThumbnailHandle(LibHeif& libHeif, const heif_image_handle* heifImageHandle)
+{
+    if (!libHeif.heif_image_handle_get_number_of_thumbnails_f || !libHeif.heif_image_handle_get_list_of_thumbnail_IDs_f || !libHeif.heif_image_handle_get_thumbnail_f) {
+        return nullptr;
+    }
+    const int thumbnailsCount = libHeif.heif_image_handle_get_number_of_thumbnails_f(heifImageHandle);
+    if (thumbnailsCount <= 0) {
+        return nullptr;
+    }
+    std::vector<heif_item_id> heifThumbnailIds(yato::narrow_cast<size_t>(thumbnailsCount));
+    if (thumbnailsCount != libHeif.heif_image_handle_get_list_of_thumbnail_IDs_f(heifImageHandle, heifThumbnailIds.data(), thumbnailsCount)) {
+        return nullptr;
+    }
+    heif_image_handle* heifThumbnailHandle{};
+    const auto heifError = libHeif.heif_image_handle_get_thumbnail_f(heifImageHandle, heifThumbnailIds.at(0), &heifThumbnailHandle);
+    if (heifError.code != heif_error_Ok) {
+        throw std::runtime_error(std::string("PluginHeif[Load]: Error in heif_image_handle_get_thumbnail(). ") + heifError.message);
+    }
+    return heifThumbnailHandle;
+}
+
+
+/**
+ * Decodes an image as interleaved RGB(A) into a new bitmap
+ */
+static UniqueBitmap DecodeImage(LibHeif& libHeif, const heif_image_handle* heifImageHandle, bool headerOnly = false)
+{
+    if (!heifImageHandle) {
+        return UniqueBitmap{ nullptr, &::FreeImage_Unload };
+    }
+
+    const int heifWidth  = libHeif.heif_image_handle_get_width_f(heifImageHandle);
+    const int heifHeight = libHeif.heif_image_handle_get_height_f(heifImageHandle);
+    if (heifWidth <= 0 || heifHeight <= 0) {
+        throw std::runtime_error("PluginHeif[Load]: Invalid image size.");
+    }
+
+    // ToDo: no way to differ 420 from greyscale?
+    //heif_colorspace heifPreferredColorspace{ heif_colorspace_undefined };
+    //heif_chroma heifPreferredChroma{ heif_chroma_undefined };
+    //if (mLibHeif->heif_image_handle_get_preferred_decoding_colorspace_f) {
+    //    mLibHeif->heif_image_handle_get_preferred_decoding_colorspace_f(heifImageHandle, &heifPreferredColorspace, &heifPreferredChroma);
+    //}
+
+    const heif_chroma targetHefChroma = libHeif.heif_image_handle_has_alpha_channel_f(heifImageHandle) ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB;
+
+    if (headerOnly) {
+        // the size and the alpha channel are known from the image handle, nothing is decoded
+        return UniqueBitmap(FreeImage_AllocateHeader(TRUE, heifWidth, heifHeight, targetHefChroma == heif_chroma_interleaved_RGBA ? 32 : 24), &::FreeImage_Unload);
+    }
+
+    heif_image* heifImage{};
+    heif_error heifError = libHeif.heif_decode_image_f(heifImageHandle, &heifImage, heif_colorspace_RGB, targetHefChroma, nullptr);
+    if (heifError.code != heif_error_Ok) {
+        throw std::runtime_error(std::string("PluginHeif[Load]: Error in heif_decode_image(). ") + heifError.message);
+    }
+    yato_finally(([&]() { libHeif.heif_image_release_f(heifImage); }));
+
+    const int heifBpp = libHeif.heif_image_get_bits_per_pixel_f(heifImage, heif_channel_interleaved);
+    if (heifBpp != 8 && heifBpp != 24 && heifBpp != 32) {
+        // ToDo: Add support for other bpp
+        throw std::runtime_error("PluginHeif[Load]: Unsupported BPPs.");
+    }
+
+    UniqueBitmap bmp(FreeImage_Allocate(heifWidth, heifHeight, heifBpp), &::FreeImage_Unload);
+
+    // Copy pixels
+    {
+        int heifStride{};
+        const uint8_t* heifData = libHeif.heif_image_get_plane_readonly_f(heifImage, heif_channel_interleaved, &heifStride);
+        if (!heifData) {
+            throw std::runtime_error("PluginHeif[Load]: Error in heif_image_get_plane_readonly()");
+        }
+
+        uint8_t* bmpData = yato::pointer_cast<uint8_t*>(FreeImage_GetBits(bmp.get()));
+        const auto bmpStride = FreeImage_GetPitch(bmp.get());
+        bmpData += (heifHeight - 1) * bmpStride;
+        for (int y = 0; y < heifHeight; ++y) {
+            std::memcpy(bmpData, heifData, heifWidth * heifBpp / 8);
+            bmpData -= bmpStride;
+            heifData += heifStride;
+        }
+    }
+
+    return bmp;
+}
+
+
 class PluginHeif
     : public fi::Plugin2
 {
@@ -269,69 +466,34 @@ public:
     //virtual uint32_t PageCapabilityProc(FreeImageIO* /*io*/, fi_handle /*handle*/, void* /*data*/) { return 1U; };
 
 
-    FIBITMAP* LoadProc(FreeImageIO* io, fi_handle handle, uint32_t /*page*/, uint32_t /*flags*/, void* /*data*/) override {
+    FIBITMAP* LoadProc(FreeImageIO* io, fi_handle handle, uint32_t /*page*/, uint32_t flags, void* /*data*/) override {
 
         if (!io || !handle) {
             return nullptr;
         }
         auto& libHeif = LibHeif::GetInstance();
 
-        heif_context* heifContext = libHeif.heif_context_alloc_f();
-        if (!heifContext) {
-            throw std::runtime_error("PluginHeif[Load]: Failed to allocate heif_context.");
-        }
-        yato_finally(([&, this]() { libHeif.heif_context_free_f(heifContext); }));
-
-        io->seek_proc(handle, 0, SEEK_END);
-        const size_t fileSize = io->tell_proc(handle);
-        io->seek_proc(handle, 0, SEEK_SET);
-
-        auto ioContext = std::make_tuple(io, handle, fileSize);
+        HeifInput heifInput(libHeif, io, handle);
 
-        heif_reader heifReader{};
-        heifReader.reader_api_version = 1;
-        heifReader.get_position = [](void* userdata) -> int64_t {
-            const auto& [io_, handle_, _] = *yato::pointer_cast<decltype(&ioContext)>(userdata);
-            return io_->tell_proc(handle_);
-        };
-        heifReader.read = [](void* data, size_t size, void* userdata) -> int {
-            const auto& [io_, handle_, _] = *yato::pointer_cast<decltype(&ioContext)>(userdata);
-            if (size == io_->read_proc(data, 1U, yato::narrow_cast<unsigned>(size), handle_)) {
-                return 0; // success
-            }
-            return 1; // error
-        };
-        heifReader.seek = [](int64_t position, void* userdata) -> int {
-            const auto& [io_, handle_, _] = *yato::pointer_cast<decltype(&ioContext)>(userdata);
-            return io_->seek_proc(handle_, yato::narrow_cast<long>(position), SEEK_SET);
-        };
-        heifReader.wait_for_file_size = [](int64_t target_size, void* userdata) -> heif_reader_grow_status {
-            const size_t fileSize = std::get<size_t>(*yato::pointer_cast<decltype(&ioContext)>(userdata));
-            if (target_size >= 0 && yato::narrow_cast<size_t>(target_size) <= fileSize) {
-                return heif_reader_grow_status::heif_reader_grow_status_size_reached;
-            }
-            return heif_reader_grow_status::heif_reader_grow_status_size_beyond_eof;
-        };
+        heif_image_handle* heifImageHandle = heifInput.GetPrimaryImageHandle();
+        yato_finally(([&, this]() { libHeif.heif_image_handle_release_f(heifImageHandle); }));
 
-        auto heifError = libHeif.heif_context_read_from_reader_f(heifContext, &heifReader, &ioContext, nullptr);
-        if (heifError.code != heif_error_Ok) {
-            throw std::runtime_error(std::string("PluginHeif[Load]: Error in heif_context_read_from_reader(). ") + heifError.message);
-        }
+        heif_image_handle* heifThumbnailHandle = GetThumbnailHandle(libHeif, heifImageHandle);
+        yato_finally(([&, this]() { if (heifThumbnailHandle) { libHeif.heif_image_handle_release_f(heifThumbnailHandle); } }));
 
-        heif_image_handle* heifImageHandle{};
-        heifError = libHeif.heif_context_get_primary_image_handle_f(heifContext, &heifImageHandle);
-        if (heifError.code != heif_error_Ok) {
-            throw std::runtime_error(std::string("PluginHeif[Load]: Error in heif_context_get_primary_image_handle(). ") + heifError.message);
-        }
-        yato_finally(([&, this]() { libHeif.heif_image_handle_release_f(heifImageHandle); }));
+        // previews only decode the embedded thumbnail
+        const bool preview = ((flags & HEIF_PREVIEW) == HEIF_PREVIEW) && heifThumbnailHandle;
+        const bool headerOnly = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
-        UniqueBitmap bmp = DecodeImage(libHeif, heifImageHandle);
+        UniqueBitmap bmp = DecodeImage(libHeif, preview ? heifThumbnailHandle : heifImageHandle, headerOnly);
         if (!bmp) {
             return nullptr;
         }
 
+        heif_error heifError{};
+
         // EXIF
-        const int heifMetaCount = libHeif.heif_image_handle_get_number_of_metadata_blocks_f(heifImageHandle, nullptr);
+        const int heifMetaCount = ((flags & FIF_LOAD_NOMETADATA) != FIF_LOAD_NOMETADATA) ? libHeif.heif_image_handle_get_number_of_metadata_blocks_f(heifImageHandle, nullptr) : 0;
         if (heifMetaCount > 0) {
             std::vector<heif_item_id> heifMetaIds(yato::narrow_cast<size_t>(heifMetaCount));
             std::vector<uint8_t> heifMetaData;
@@ -366,23 +528,10 @@ public:
         }
 
         // Thumbnail
-        if (libHeif.heif_image_handle_get_number_of_thumbnails_f && libHeif.heif_image_handle_get_list_of_thumbnail_IDs_f && libHeif.heif_image_handle_get_thumbnail_f) {
-            const int thumbnailsCount = libHeif.heif_image_handle_get_number_of_thumbnails_f(heifImageHandle);
-            if (thumbnailsCount > 0) {
-                std::vector<heif_item_id> heifThumbnailIds(yato::narrow_cast<size_t>(thumbnailsCount));
-                if (thumbnailsCount == libHeif.heif_image_handle_get_list_of_thumbnail_IDs_f(heifImageHandle, heifThumbnailIds.data(), thumbnailsCount)) {
-                    heif_image_handle* heifThumbnailHandle{};
-                    heifError = libHeif.heif_image_handle_get_thumbnail_f(heifImageHandle, heifThumbnailIds.at(0), &heifThumbnailHandle);
-                    if (heifError.code != heif_error_Ok) {
-                        throw std::runtime_error(std::string("PluginHeif[Load]: Error in heif_image_handle_get_thumbnail(). ") + heifError.message);
-                    }
-                    yato_finally(([&, this]() { libHeif.heif_image_handle_release_f(heifThumbnailHandle); }));
-
-                    UniqueBitmap thumbnail = DecodeImage(libHeif, heifThumbnailHandle);
-                    if (thumbnail) {
-                        FreeImage_SetThumbnail(bmp.get(), thumbnail.get());
-                    }
-                }
+        if (!preview && !headerOnly && heifThumbnailHandle) {
+            UniqueBitmap thumbnail = DecodeImage(libHeif, heifThumbnailHandle);
+            if (thumbnail) {
+                FreeImage_SetThumbnail(bmp.get(), thumbnail.get());
             }
         }
 
@@ -390,7 +539,7 @@ public:
     };
 
 
-    bool SaveProc(FreeImageIO* io, FIBITMAP* dib, fi_handle handle, uint32_t /*page*/, uint32_t /*flags*/, void* /*data*/) override { 
+    bool SaveProc(FreeImageIO* io, FIBITMAP* dib, fi_handle handle, uint32_t /*page*/, uint32_t flags, void* /*data*/) override { 
 
         if (!io || !handle || !dib || !FreeImage_HasPixels(dib)) {
             return false;
@@ -425,7 +574,7 @@ public:
         }
         yato_finally(([&, this]() { libHeif.heif_encoder_release_f(heifEncoder); }));
 
-        libHeif.heif_encoder_set_lossy_quality_f(heifEncoder, 75);
+        SetEncoderOptions(libHeif, heifEncoder, flags);
 
         const FREE_IMAGE_TYPE imgType{ FreeImage_GetImageType(dib) };
         if (imgType != FIT_BITMAP) {
@@ -515,6 +664,13 @@ public:
 
     bool ValidateProc(FreeImageIO* io, fi_handle handle) override {
 
+        // files start with a 'ftyp' box, other files are rejected without loading libheif
+        std::array<uint8_t, 12> header = {};
+        const unsigned readCount = io->read_proc(header.data(), 1U, header.size(), handle);
+        if (readCount < 12 || std::memcmp(header.data() + 4, "ftyp", 4) != 0) {
+            return false;
+        }
+
         auto& libHeif = LibHeif::GetInstance();
         if (libHeif.heif_read_main_brand_f) {
 
@@ -529,12 +685,8 @@ public:
                 break;
             }
 
-            std::array<uint8_t, 12> header = {};
-            const unsigned readCount = io->read_proc(header.data(), 1U, header.size(), handle);
-            if (readCount >= 12) {
-                if (targetBrand == libHeif.heif_read_main_brand_f(header.data(), yato::narrow_cast<int>(readCount))) {
-                    return true;
-                }
+            if (targetBrand == libHeif.heif_read_main_brand_f(header.data(), yato::narrow_cast<int>(readCount))) {
+                return true;
             }
         }
         return false; 
@@ -543,68 +695,165 @@ public:
     //virtual bool SupportsExportBPPProc(uint32_t /*bpp*/) { return false; };
     //virtual bool SupportsExportTypeProc(FREE_IMAGE_TYPE /*type*/) { return false; };
     //virtual bool SupportsICCProfilesProc() { return false; };
-    //virtual bool SupportsNoPixelsProc() { return false; };
+    bool SupportsNoPixelsProc() override {
+        return true;
+    }
+
+    uint32_t ConcurrencyProc() override {
+        // every call works on its own heif_context, the library is loaded once by a thread-safe static
+        return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+    }
+
+    bool SupportsFeatureProc(FREE_IMAGE_FEATURE feature) override {
+        return feature == FIFEATURE_REGION_LOAD;
+    }
+
+    FIBITMAP* LoadRegionProc(FreeImageIO* io, fi_handle handle, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t flags, void* /*data*/) override {
+        return LoadRegionHEIF(io, handle, left, top, right, bottom, static_cast<int>(flags));
+    }
 
 private:
-    UniqueBitmap DecodeImage(LibHeif& libHeif, const heif_image_handle* heifImageHandle)
+    /**
+     * Applies the HEIF_xxx save flags to the encoder.
+     * Parameters are named after the libheif encoder plugins (x265, kvazaar, aom, svt, rav1e), the ones an encoder doesn't know are ignored.
+     */
+    void SetEncoderOptions(LibHeif& libHeif, heif_encoder* heifEncoder, uint32_t flags) const
     {
-        if (!heifImageHandle) {
-            return UniqueBitmap{ nullptr, &::FreeImage_Unload };
+        const bool lossless = (flags & HEIF_LOSSLESS) == HEIF_LOSSLESS;
+        if (lossless) {
+            libHeif.heif_encoder_set_lossless_f(heifEncoder, 1);
+        } else {
+            // quality is between 1 (smallest file) and 100 (biggest) - default to 75
+            const int quality = (flags & 0x7F) > 0 ? std::min<int>(flags & 0x7F, 100) : 75;
+            libHeif.heif_encoder_set_lossy_quality_f(heifEncoder, quality);
+        }
+
+        // speed 0 (slower-better) .. 9 (fastest), the encoder default when not specified
+        const unsigned speed = (flags >> 9) & 0xF;
+        if (speed > 0) {
+            switch (mMode) {
+            default:
+            case Mode::eHeif: {
+                static const char* presets[] = { "placebo", "veryslow", "slower", "slow", "medium", "fast", "faster", "veryfast", "superfast", "ultrafast" };
+                libHeif.heif_encoder_set_parameter_f(heifEncoder, "preset", presets[std::min(speed - 1, 9U)]);
+                break;
+            }
+            case Mode::eAvif:
+                libHeif.heif_encoder_set_parameter_f(heifEncoder, "speed", std::to_string(std::min(speed - 1, 9U)).c_str());
+                break;
+            }
         }
 
-        const int heifWidth  = libHeif.heif_image_handle_get_width_f(heifImageHandle);
-        const int heifHeight = libHeif.heif_image_handle_get_height_f(heifImageHandle);
-        if (heifWidth <= 0 || heifHeight <= 0) {
-            throw std::runtime_error("PluginHeif[Load]: Invalid image size.");
+        const unsigned threads = FreeImage_GetThreadCount();
+        if (threads > 1) {
+            libHeif.heif_encoder_set_parameter_f(heifEncoder, "threads", std::to_string(threads).c_str());
         }
 
-        // ToDo: no way to differ 420 from greyscale?
-        //heif_colorspace heifPreferredColorspace{ heif_colorspace_undefined };
-        //heif_chroma heifPreferredChroma{ heif_chroma_undefined };
-        //if (mLibHeif->heif_image_handle_get_preferred_decoding_colorspace_f) {
-        //    mLibHeif->heif_image_handle_get_preferred_decoding_colorspace_f(heifImageHandle, &heifPreferredColorspace, &heifPreferredChroma);
-        //}
+        // lossless images keep the full chroma resolution unless told otherwise
+        switch (flags & HEIF_CHROMA_444) {
+        case HEIF_CHROMA_420:
+            libHeif.heif_encoder_set_parameter_f(heifEncoder, "chroma", "420");
+            break;
+        case HEIF_CHROMA_422:
+            libHeif.heif_encoder_set_parameter_f(heifEncoder, "chroma", "422");
+            break;
+        case HEIF_CHROMA_444:
+            libHeif.heif_encoder_set_parameter_f(heifEncoder, "chroma", "444");
+            break;
+        default:
+            if (lossless) {
+                libHeif.heif_encoder_set_parameter_f(heifEncoder, "chroma", "444");
+            }
+            break;
+        }
+    }
 
-        const heif_chroma targetHefChroma = libHeif.heif_image_handle_has_alpha_channel_f(heifImageHandle) ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB;
+    Mode mMode{ Mode::eHeif };
+};
 
-        heif_image* heifImage{};
-        heif_error heifError = libHeif.heif_decode_image_f(heifImageHandle, &heifImage, heif_colorspace_RGB, targetHefChroma, nullptr);
-        if (heifError.code != heif_error_Ok) {
-            throw std::runtime_error(std::string("PluginHeif[Load]: Error in heif_decode_image(). ") + heifError.message);
-        }
-        yato_finally(([&, this]() { libHeif.heif_image_release_f(heifImage); }));
 
-        const int heifBpp = libHeif.heif_image_get_bits_per_pixel_f(heifImage, heif_channel_interleaved);
-        if (heifBpp != 8 && heifBpp != 24 && heifBpp != 32) {
-            // ToDo: Add support for other bpp
-            throw std::runtime_error("PluginHeif[Load]: Unsupported BPPs.");
-        }
 
-        UniqueBitmap bmp(FreeImage_Allocate(heifWidth, heifHeight, heifBpp), &::FreeImage_Unload);
+// ==========================================================
+//	 Region loading
+// ==========================================================
 
-        // Copy pixels
-        {
+
+FIBITMAP* LoadRegionHEIF(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int /*flags*/)
+try
+{
+    auto& libHeif = LibHeif::GetInstance();
+
+    HeifInput heifInput(libHeif, io, handle);
+
+    heif_image_handle* heifImageHandle = heifInput.GetPrimaryImageHandle();
+    yato_finally(([&]() { libHeif.heif_image_handle_release_f(heifImageHandle); }));
+
+    const int heifWidth  = libHeif.heif_image_handle_get_width_f(heifImageHandle);
+    const int heifHeight = libHeif.heif_image_handle_get_height_f(heifImageHandle);
+    if (heifWidth <= 0 || heifHeight <= 0 || right > yato::narrow_cast<unsigned>(heifWidth) || bottom > yato::narrow_cast<unsigned>(heifHeight)) {
+        return nullptr;
+    }
+
+    heif_image_tiling tiling{};
+    const bool tiled = libHeif.heif_image_handle_get_image_tiling_f && libHeif.heif_image_handle_decode_image_tile_f
+        && (libHeif.heif_image_handle_get_image_tiling_f(heifImageHandle, /*process_image_transformations=*/1, &tiling).code == heif_error_Ok)
+        && (tiling.num_columns * tiling.num_rows > 1) && (tiling.tile_width > 0) && (tiling.tile_height > 0);
+    if (!tiled) {
+        // single coded image (or libheif older than 1.19): decode it all then crop
+        UniqueBitmap bmp = DecodeImage(libHeif, heifImageHandle);
+        return bmp ? FreeImage_Copy(bmp.get(), left, top, right, bottom) : nullptr;
+    }
+
+    const bool hasAlpha = libHeif.heif_image_handle_has_alpha_channel_f(heifImageHandle);
+    const unsigned bytespp = hasAlpha ? 4 : 3;
+
+    UniqueBitmap region(FreeImage_Allocate(right - left, bottom - top, 8 * bytespp), &::FreeImage_Unload);
+    if (!region) {
+        throw std::runtime_error("PluginHeif[Load]: Failed to allocate the region bitmap.");
+    }
+    const unsigned regionHeight = bottom - top;
+
+    // only decode the grid tiles intersecting the rectangle
+    for (uint32_t tileY = top / tiling.tile_height; tileY <= (bottom - 1) / tiling.tile_height; ++tileY) {
+        for (uint32_t tileX = left / tiling.tile_width; tileX <= (right - 1) / tiling.tile_width; ++tileX) {
+            heif_image* heifTile{};
+            const heif_error heifError = libHeif.heif_image_handle_decode_image_tile_f(heifImageHandle, &heifTile, heif_colorspace_RGB,
+                hasAlpha ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB, nullptr, tileX, tileY);
+            if (heifError.code != heif_error_Ok) {
+                throw std::runtime_error(std::string("PluginHeif[Load]: Error in heif_image_handle_decode_image_tile(). ") + heifError.message);
+            }
+            yato_finally(([&]() { libHeif.heif_image_release_f(heifTile); }));
+
+            if (libHeif.heif_image_get_bits_per_pixel_f(heifTile, heif_channel_interleaved) != yato::narrow_cast<int>(8 * bytespp)) {
+                throw std::runtime_error("PluginHeif[Load]: Unsupported BPPs.");
+            }
             int heifStride{};
-            const uint8_t* heifData = libHeif.heif_image_get_plane_readonly_f(heifImage, heif_channel_interleaved, &heifStride);
+            const uint8_t* heifData = libHeif.heif_image_get_plane_readonly_f(heifTile, heif_channel_interleaved, &heifStride);
             if (!heifData) {
                 throw std::runtime_error("PluginHeif[Load]: Error in heif_image_get_plane_readonly()");
             }
 
-            uint8_t* bmpData = yato::pointer_cast<uint8_t*>(FreeImage_GetBits(bmp.get()));
-            const auto bmpStride = FreeImage_GetPitch(bmp.get());
-            bmpData += (heifHeight - 1) * bmpStride;
-            for (int y = 0; y < heifHeight; ++y) {
-                std::memcpy(bmpData, heifData, heifWidth * heifBpp / 8);
-                bmpData -= bmpStride;
-                heifData += heifStride;
+            // part of the tile inside the rectangle, edge tiles may be cut by the image size
+            const unsigned tileLeft = tileX * tiling.tile_width;
+            const unsigned tileTop  = tileY * tiling.tile_height;
+            const unsigned x0 = std::max(left, tileLeft);
+            const unsigned y0 = std::max(top, tileTop);
+            const unsigned x1 = std::min(right, tileLeft + yato::narrow_cast<unsigned>(std::max(0, libHeif.heif_image_get_width_f(heifTile, heif_channel_interleaved))));
+            const unsigned y1 = std::min(bottom, tileTop + yato::narrow_cast<unsigned>(std::max(0, libHeif.heif_image_get_height_f(heifTile, heif_channel_interleaved))));
+
+            for (unsigned y = y0; (y < y1) && (x0 < x1); ++y) {
+                const uint8_t* src = heifData + (y - tileTop) * heifStride + (x0 - tileLeft) * bytespp;
+                uint8_t* dst = FreeImage_GetScanLine(region.get(), regionHeight - 1 - (y - top)) + (x0 - left) * bytespp;
+                std::memcpy(dst, src, (x1 - x0) * bytespp);
             }
         }
-
-        return bmp;
     }
 
-    Mode mMode{ Mode::eHeif };
-};
+    return region.release();
+}
+catch (...) {
+    return nullptr;
+}
 
 
 
@@ -59,6 +59,15 @@ typedef struct tagICONDIRECTORYENTRY {
 #pragma pack()
 #endif
 
+/**
+Plugin data: the icon header, and the icon descriptions read on the first page load
+*/
+struct ICONFILE {
+	ICONHEADER header;
+	std::vector<ICONDIRENTRY> entries;
+	FIBOOL indexed = FALSE;
+};
+
 // ==========================================================
 // Static helpers
 // ==========================================================
@@ -125,6 +134,75 @@ IsPNG(FreeImageIO *io, fi_handle handle) {
 	return bIsPNG;
 }
 
+/**
+Reads the icon descriptions once, they are kept by the plugin data for the following pages
+@return Returns FALSE if the descriptions can't be read
+*/
+static FIBOOL
+ReadIconDirectory(FreeImageIO *io, fi_handle handle, ICONFILE *icon_file) {
+	if (!icon_file->indexed) {
+		icon_file->entries.resize(icon_file->header.idCount);
+		io->seek_proc(handle, sizeof(ICONHEADER), SEEK_SET);
+		if (icon_file->header.idCount && (io->read_proc(icon_file->entries.data(), icon_file->header.idCount * sizeof(ICONDIRENTRY), 1, handle) != 1)) {
+			icon_file->entries.clear();
+			return FALSE;
+		}
+#ifdef FREEIMAGE_BIGENDIAN
+		SwapIconDirEntries(icon_file->entries.data(), icon_file->header.idCount);
+#endif
+		icon_file->indexed = TRUE;
+	}
+	return TRUE;
+}
+
+/**
+Picks the icon best fitting a requested size from the descriptions only: the smallest icon at least that large,
+else the largest one, with the highest bit depth among icons of the same size
+@param size Requested size, 0 for the largest icon
+@return Returns the index of the icon
+*/
+static int
+BestFitIcon(const std::vector<ICONDIRENTRY> &entries, unsigned size) {
+	// a zero width or height stands for 256 (larger PNG icons are stored as 256 too)
+	auto iconSize = [](const ICONDIRENTRY &entry) {
+		return MAX(entry.bWidth ? (unsigned)entry.bWidth : 256U, entry.bHeight ? (unsigned)entry.bHeight : 256U);
+	};
+	auto iconDepth = [](const ICONDIRENTRY &entry) {
+		const unsigned depth = entry.wPlanes * entry.wBitCount;
+		if (depth) {
+			return depth;
+		}
+		// old icons only give a color count, PNG icons may leave both to zero
+		unsigned colors_depth = 0;
+		while ((1U << colors_depth) < entry.bColorCount) {
+			colors_depth++;
+		}
+		return entry.bColorCount ? colors_depth : 32U;
+	};
+
+	int best = 0;
+	for (int k = 1; k < (int)entries.size(); k++) {
+		const unsigned best_size = iconSize(entries[best]);
+		const unsigned entry_size = iconSize(entries[k]);
+		FIBOOL better = FALSE;
+		if (entry_size == best_size) {
+			better = iconDepth(entries[k]) > iconDepth(entries[best]);
+		}
+		else if ((best_size >= size) && size) {
+			// a smaller icon still large enough
+			better = (entry_size >= size) && (entry_size < best_size);
+		}
+		else {
+			// a larger icon
+			better = entry_size > best_size;
+		}
+		if (better) {
+			best = k;
+		}
+	}
+	return best;
+}
+
 #ifdef FREEIMAGE_BIGENDIAN
 static void
 SwapInfoHeader(FIBITMAPINFOHEADER *header) {
@@ -230,15 +308,21 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
 static void * DLL_CALLCONV
 Open(FreeImageIO *io, fi_handle handle, FIBOOL read) {
 	// Allocate memory for the header structure
-	auto *lpIH = (ICONHEADER*)malloc(sizeof(ICONHEADER));
-	if (!lpIH) {
+	auto *icon_file = new(std::nothrow) ICONFILE;
+	if (!icon_file) {
 		return nullptr;
 	}
+	ICONHEADER *lpIH = &icon_file->header;
 
 	if (read) {
 		// Read in the header
@@ -249,7 +333,7 @@ Open(FreeImageIO *io, fi_handle handle, FIBOOL read) {
 
 		if (!(lpIH->idReserved == 0) || !(lpIH->idType == 1)) {
 			// Not an ICO file
-			free(lpIH);
+			delete icon_file;
 			return nullptr;
 		}
 	}
@@ -260,24 +344,23 @@ Open(FreeImageIO *io, fi_handle handle, FIBOOL read) {
 		lpIH->idCount = 0;
 	}
 
-	return lpIH;
+	return icon_file;
 }
 
 static void DLL_CALLCONV
 Close(FreeImageIO *io, fi_handle handle, void *data) {
-	// free the header structure
-	ICONHEADER *lpIH = (ICONHEADER*)data;
-	free(lpIH);
+	// free the header structure and the icon descriptions
+	delete (ICONFILE*)data;
 }
 
 // ----------------------------------------------------------
 
 static int DLL_CALLCONV
 PageCount(FreeImageIO *io, fi_handle handle, void *data) {
-	ICONHEADER *lpIH = (ICONHEADER*)data;
+	auto *icon_file = (ICONFILE*)data;
 
-	if (lpIH) {
-		return lpIH->idCount;
+	if (icon_file) {
+		return icon_file->header.idCount;
 	}
 	return 1;
 }
@@ -397,20 +480,22 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 	if (handle) {
 		// get the icon header
-		ICONHEADER *icon_header = (ICONHEADER*)data;
+		auto *icon_file = (ICONFILE*)data;
+
+		if (icon_file) {
+			const ICONHEADER *icon_header = &icon_file->header;
 
-		if (icon_header) {
 			// load the icon descriptions
-			std::unique_ptr<void, decltype(&free)> safeList(malloc(icon_header->idCount * sizeof(ICONDIRENTRY)), &free);
-			if (!safeList) {
+			if (!ReadIconDirectory(io, handle, icon_file)) {
+				FreeImage_OutputMessageProcEx(s_format_id, FIMSG_PARSING, FI_MSG_ERROR_PARSING);
 				return nullptr;
 			}
-			auto *icon_list = static_cast<ICONDIRENTRY*>(safeList.get());
-			io->seek_proc(handle, sizeof(ICONHEADER), SEEK_SET);
-			io->read_proc(icon_list, icon_header->idCount * sizeof(ICONDIRENTRY), 1, handle);
-#ifdef FREEIMAGE_BIGENDIAN
-			SwapIconDirEntries(icon_list, icon_header->idCount);
-#endif
+			const ICONDIRENTRY *icon_list = icon_file->entries.data();
+
+			// only the icon best fitting the requested size is decoded
+			if (((flags & ICO_LOAD_BEST_FIT) == ICO_LOAD_BEST_FIT) && icon_header->idCount) {
+				page = BestFitIcon(icon_file->entries, (unsigned)flags >> 16);
+			}
 
 			// load the requested icon
 			if (page < icon_header->idCount) {
@@ -419,7 +504,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 				FIBITMAP *dib{};
 				if ( IsPNG(io, handle) ) {
-					// Vista icon support
+					// Vista icon support, the PNG plugin reads the stream in place
 					// see http://blogs.msdn.com/b/oldnewthing/archive/2010/10/22/10079192.aspx
 					dib = FreeImage_LoadFromHandle(FIF_PNG, io, handle, header_only ? FIF_LOAD_NOPIXELS : PNG_DEFAULT);
 				}
@@ -644,6 +729,7 @@ SaveStandardIcon(FreeImageIO *io, FIBITMAP *dib, fi_handle handle) {
 
 static FIBOOL DLL_CALLCONV
 Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
+	ICONFILE *icon_file{};
 	ICONHEADER *icon_header{};
 	std::vector<std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)>> vPages;
 	int k;
@@ -665,14 +751,15 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	}
 	
 	// get the icon header
-	icon_header = (ICONHEADER*)data;
+	icon_file = (ICONFILE*)data;
+	icon_header = &icon_file->header;
 
 	try {
 		FIBITMAP *icon_dib{};
 
 		// load all icons
 		for (k = 0; k < icon_header->idCount; k++) {
-			icon_dib = Load(io, handle, k, flags, data);
+			icon_dib = Load(io, handle, k, flags & ~ICO_LOAD_BEST_FIT, data);
 			if (!icon_dib) {
 				throw FI_MSG_ERROR_DIB_MEMORY;
 			}
@@ -761,12 +848,19 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		SwapIconDirEntries(icon_list, icon_header->idCount);
 #endif
 		io->write_proc(icon_list, sizeof(ICONDIRENTRY) * icon_header->idCount, 1, handle);
+#ifdef FREEIMAGE_BIGENDIAN
+		SwapIconDirEntries(icon_list, icon_header->idCount);
+#endif
 		io->seek_proc(handle, current_pos, SEEK_SET);
 
+		// the following pages see the new descriptions
+		icon_file->entries.assign(icon_list, icon_list + icon_header->idCount);
+		icon_file->indexed = TRUE;
+
 		return TRUE;
 
 	} catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		return FALSE;
 	}
 }
@@ -795,4 +889,5 @@ InitICO(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
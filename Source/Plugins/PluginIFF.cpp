@@ -193,6 +193,16 @@ SupportsExportType(FREE_IMAGE_TYPE type) {
 	return FALSE;
 }
 
+static FIBOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD;
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -200,6 +210,8 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	if (handle) {
 		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
 
+		const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
 		uint32_t type, size;
 
 		io->read_proc(&type, 4, 1, handle);
@@ -268,9 +280,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				depth = planes > 8 ? 24 : 8;
 
 				if ( depth == 24 ) {
-					dib.reset(FreeImage_Allocate(width, height, depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+					dib.reset(FreeImage_AllocateHeader(header_only, width, height, depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 				} else {
-					dib.reset(FreeImage_Allocate(width, height, depth));
+					dib.reset(FreeImage_AllocateHeader(header_only, width, height, depth));
 				}
 			} else if (ch_type == ID_CMAP) {	// Palette (Color Map)
 				if (!dib) {
@@ -291,6 +303,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					return nullptr;
 				}
 
+				if (header_only) {
+					// header only mode
+					return dib.release();
+				}
+
 				if (type == ID_PBM) {
 					// NON INTERLACED (LBM)
 
@@ -454,4 +471,6 @@ InitIFF(Plugin *plugin, int format_id) {
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -23,6 +23,7 @@
 #include "Utilities.h"
 #include "openjp2/openjpeg.h"
 #include "J2KHelper.h"
+#include "FreeImage/Plugin.h"
 
 // ==========================================================
 // Plugin Interface
@@ -107,6 +108,16 @@ SupportsExportType(FREE_IMAGE_TYPE type) {
 	);
 }
 
+static FIBOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
 static void * DLL_CALLCONV
@@ -125,9 +136,11 @@ Close(FreeImageIO *io, fi_handle handle, void *data) {
 
 // ----------------------------------------------------------
 
-static FIBITMAP * DLL_CALLCONV
-Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	J2KFIO_t *fio = (J2KFIO_t*)data;
+/**
+Decodes the image, or only the left, top, right, bottom rectangle given by area (see J2KSetDecodeArea)
+*/
+static FIBITMAP *
+Decode(FreeImageIO *io, fi_handle handle, J2KFIO_t *fio, int flags, const unsigned *area) {
 	if (handle && fio) {
 		opj_dparameters_t parameters;	// decompression parameters
 
@@ -160,6 +173,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			if (!opj_setup_decoder(d_codec.get(), &parameters)) {
 				throw "Failed to setup the decoder\n";
 			}
+			J2KSetDecoderThreads(d_codec.get());
 
 			// read the main header of the codestream and if necessary the JP2 boxes
 			opj_image_t *image{};		// decoded image 
@@ -180,6 +194,12 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				return dib.release();
 			}
 
+			// lowest resolution level at least the size requested by FreeImage_LoadScaled, in the upper 16 bits of flags
+			const unsigned requested_size = area ? 0 : (unsigned)flags >> 16;
+			if (!J2KSetDecodeArea(d_codec.get(), image, requested_size, area)) {
+				return nullptr;
+			}
+
 			// decode the stream and fill the image structure 
 			if (!(opj_decode(d_codec.get(), d_stream, image) && opj_end_decompress(d_codec.get(), d_stream))) {
 				throw "Failed to decode image!\n";
@@ -194,12 +214,17 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			return dib.release();
 
 		} catch (const char *text) {
-			FreeImage_OutputMessageProc(s_format_id, text);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		}
 	}
 	return nullptr;
 }
 
+static FIBITMAP * DLL_CALLCONV
+Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+	return Decode(io, handle, (J2KFIO_t*)data, flags, nullptr);
+}
+
 static FIBOOL DLL_CALLCONV
 Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
 	J2KFIO_t *fio = (J2KFIO_t*)data;
@@ -269,7 +294,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		} catch (const char *text) {
 			if (c_codec) opj_destroy_codec(c_codec);
 			if (image) opj_image_destroy(image);
-			FreeImage_OutputMessageProc(s_format_id, text);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 			return FALSE;
 		}
 	}
@@ -277,6 +302,22 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	return FALSE;
 }
 
+// ==========================================================
+//   Region loading
+// ==========================================================
+
+FIBITMAP*
+LoadRegionJ2K(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags) {
+	J2KFIO_t *fio = opj_freeimage_stream_create(io, handle, TRUE);
+	if (!fio) {
+		return nullptr;
+	}
+	const unsigned area[4] = { left, top, right, bottom };
+	FIBITMAP *dib = Decode(io, handle, fio, flags, area);
+	opj_freeimage_stream_destroy(fio);
+	return dib;
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
@@ -300,4 +341,6 @@ InitJ2K(Plugin *plugin, int format_id) {
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -46,6 +46,14 @@ extern "C" {
 #include "Utilities.h"
 
 #include "../Metadata/FreeImageTag.h"
+#include "FreeImageIO.h"
+#include "FreeImage/Plugin.h"
+#include "FreeImage/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 
 // ==========================================================
@@ -58,13 +66,16 @@ static int s_format_id;
 //   Constant declarations
 // ----------------------------------------------------------
 
-#define INPUT_BUF_SIZE  4096	// choose an efficiently fread'able size 
-#define OUTPUT_BUF_SIZE 4096    // choose an efficiently fwrite'able size
-
 #define EXIF_MARKER		(JPEG_APP0+1)	// EXIF marker / Adobe XMP marker
 #define ICC_MARKER		(JPEG_APP0+2)	// ICC profile marker
 #define IPTC_MARKER		(JPEG_APP0+13)	// IPTC marker / BIM marker 
 
+#define JPEG_SOF0		0xC0	// baseline DCT frame
+#define JPEG_SOF2		0xC2	// progressive DCT frame
+#define JPEG_DHT		0xC4	// Huffman tables marker
+#define JPEG_RST7		(JPEG_RST0+7)	// last restart marker
+#define JPEG_SOS		0xDA	// start of scan marker
+
 #define ICC_HEADER_SIZE 14				// size of non-profile data in APP2
 #define MAX_BYTES_IN_MARKER 65533L		// maximum data length of a JPEG marker
 #define MAX_DATA_BYTES_IN_MARKER 65519L	// maximum data length of a JPEG APP2 marker
@@ -92,8 +103,10 @@ typedef struct tagSourceManager {
 	/// source stream
 	fi_handle infile;
 	FreeImageIO *m_io;
-	/// start of buffer
+	/// start of buffer, nullptr when a memory stream is read in place
 	JOCTET * buffer;
+	/// size of buffer
+	size_t buffer_size;
 	/// have we gotten any data yet ?
 	boolean start_of_file;
 } SourceManager;
@@ -106,6 +119,8 @@ typedef struct tagDestinationManager {
 	FreeImageIO *m_io;
 	/// start of buffer
 	JOCTET * buffer;
+	/// size of buffer
+	size_t buffer_size;
 } DestinationManager;
 
 typedef SourceManager*		freeimage_src_ptr;
@@ -185,12 +200,13 @@ METHODDEF(void)
 init_destination (j_compress_ptr cinfo) {
 	freeimage_dst_ptr dest = (freeimage_dst_ptr) cinfo->dest;
 
+	dest->buffer_size = FreeImage_GetStreamBufferSize();
 	dest->buffer = (JOCTET *)
 	  (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
-				  OUTPUT_BUF_SIZE * sizeof(JOCTET));
+				  dest->buffer_size * sizeof(JOCTET));
 
 	dest->pub.next_output_byte = dest->buffer;
-	dest->pub.free_in_buffer = OUTPUT_BUF_SIZE;
+	dest->pub.free_in_buffer = dest->buffer_size;
 }
 
 /**
@@ -208,7 +224,7 @@ METHODDEF(boolean)
 empty_output_buffer (j_compress_ptr cinfo) {
 	freeimage_dst_ptr dest = (freeimage_dst_ptr) cinfo->dest;
 
-	if (dest->m_io->write_proc(dest->buffer, 1, OUTPUT_BUF_SIZE, dest->outfile) != OUTPUT_BUF_SIZE) {
+	if (dest->m_io->write_proc(dest->buffer, 1, (unsigned int)dest->buffer_size, dest->outfile) != dest->buffer_size) {
 		// let the memory manager delete any temp files before we die
 		jpeg_destroy((j_common_ptr)cinfo);
 
@@ -216,7 +232,7 @@ empty_output_buffer (j_compress_ptr cinfo) {
 	}
 
 	dest->pub.next_output_byte = dest->buffer;
-	dest->pub.free_in_buffer = OUTPUT_BUF_SIZE;
+	dest->pub.free_in_buffer = dest->buffer_size;
 
 	return TRUE;
 }
@@ -231,7 +247,7 @@ METHODDEF(void)
 term_destination (j_compress_ptr cinfo) {
 	freeimage_dst_ptr dest = (freeimage_dst_ptr) cinfo->dest;
 
-	size_t datacount = OUTPUT_BUF_SIZE - dest->pub.free_in_buffer;
+	size_t datacount = dest->buffer_size - dest->pub.free_in_buffer;
 
 	// write any data remaining in the buffer
 
@@ -264,7 +280,7 @@ init_source (j_decompress_ptr cinfo) {
 	 * This is correct behavior for reading a series of images from one source.
 	*/
 
-	src->start_of_file = TRUE;
+	src->start_of_file = (src->pub.bytes_in_buffer == 0);
 }
 
 /**
@@ -282,7 +298,7 @@ METHODDEF(boolean)
 fill_input_buffer (j_decompress_ptr cinfo) {
 	freeimage_src_ptr src = (freeimage_src_ptr) cinfo->src;
 
-	size_t nbytes = src->m_io->read_proc(src->buffer, 1, INPUT_BUF_SIZE, src->infile);
+	size_t nbytes = src->buffer ? src->m_io->read_proc(src->buffer, 1, (unsigned int)src->buffer_size, src->infile) : 0;
 
 	if (nbytes <= 0) {
 		if (src->start_of_file)	{
@@ -298,10 +314,13 @@ fill_input_buffer (j_decompress_ptr cinfo) {
 
 		/* Insert a fake EOI marker */
 
-		src->buffer[0] = (JOCTET) 0xFF;
-		src->buffer[1] = (JOCTET) JPEG_EOI;
+		static const JOCTET fake_eoi[2] = { (JOCTET) 0xFF, (JOCTET) JPEG_EOI };
 
-		nbytes = 2;
+		src->pub.next_input_byte = fake_eoi;
+		src->pub.bytes_in_buffer = 2;
+		src->start_of_file = FALSE;
+
+		return TRUE;
 	}
 
 	src->pub.next_input_byte = src->buffer;
@@ -372,21 +391,28 @@ GLOBAL(void)
 jpeg_freeimage_src (j_decompress_ptr cinfo, fi_handle infile, FreeImageIO *io) {
 	freeimage_src_ptr src;
 
-	// allocate memory for the buffer. is released automatically in the end
-
 	if (!cinfo->src) {
 		cinfo->src = (struct jpeg_source_mgr *) (*cinfo->mem->alloc_small)
 			((j_common_ptr) cinfo, JPOOL_PERMANENT, sizeof(SourceManager));
 
 		src = (freeimage_src_ptr) cinfo->src;
+		src->buffer = nullptr;
+		src->buffer_size = 0;
+	}
+
+	src = (freeimage_src_ptr) cinfo->src;
+
+	// allocate memory for the buffer. is released automatically in the end
 
+	const size_t buffer_size = FreeImage_GetStreamBufferSize();
+	if (!src->buffer || (src->buffer_size < buffer_size)) {
 		src->buffer = (JOCTET *) (*cinfo->mem->alloc_small)
-			((j_common_ptr) cinfo, JPOOL_PERMANENT, INPUT_BUF_SIZE * sizeof(JOCTET));
+			((j_common_ptr) cinfo, JPOOL_PERMANENT, buffer_size * sizeof(JOCTET));
+		src->buffer_size = buffer_size;
 	}
 
 	// initialize the jpeg pointer struct with pointers to functions
 
-	src = (freeimage_src_ptr) cinfo->src;
 	src->pub.init_source = init_source;
 	src->pub.fill_input_buffer = fill_input_buffer;
 	src->pub.skip_input_data = skip_input_data;
@@ -398,6 +424,41 @@ jpeg_freeimage_src (j_decompress_ptr cinfo, fi_handle infile, FreeImageIO *io) {
 	src->pub.next_input_byte = nullptr;	// until buffer loaded 
 }
 
+/**
+	Prepare for input from a memory stream, read in place as with jpeg_mem_src.
+	The stream is moved to its end. Returns FALSE, leaving cinfo unchanged,
+	if handle is not a memory stream.
+*/
+static boolean
+jpeg_freeimage_mem_src (j_decompress_ptr cinfo, fi_handle infile, FreeImageIO *io) {
+	uint64_t available = 0;
+	const uint8_t *bytes = FreeImage_PeekMemoryIO(io, infile, &available);
+	if (!bytes) {
+		return FALSE;
+	}
+	io->seek_proc(infile, 0, SEEK_END);
+
+	if (!cinfo->src) {
+		cinfo->src = (struct jpeg_source_mgr *) (*cinfo->mem->alloc_small)
+			((j_common_ptr) cinfo, JPOOL_PERMANENT, sizeof(SourceManager));
+	}
+
+	freeimage_src_ptr src = (freeimage_src_ptr) cinfo->src;
+	src->pub.init_source = init_source;
+	src->pub.fill_input_buffer = fill_input_buffer;
+	src->pub.skip_input_data = skip_input_data;
+	src->pub.resync_to_restart = jpeg_resync_to_restart; // use default method 
+	src->pub.term_source = term_source;
+	src->infile = infile;
+	src->m_io = io;
+	src->buffer = nullptr;				// fill_input_buffer only adds the fake EOI
+	src->buffer_size = 0;
+	src->pub.bytes_in_buffer = (size_t)available;
+	src->pub.next_input_byte = bytes;
+
+	return TRUE;
+}
+
 /**
 	Prepare for output to a stdio stream.
 	The caller must have already opened the stream, and is responsible
@@ -701,6 +762,10 @@ static FIBOOL
 read_markers(j_decompress_ptr cinfo, FIBITMAP *dib) {
 	jpeg_saved_marker_ptr marker;
 
+	// APP13 markers holding IPTC tags, a single one is written back verbatim when the tags aren't modified
+	jpeg_saved_marker_ptr iptc_marker{};
+	unsigned iptc_markers = 0;
+
 	for (marker = cinfo->marker_list; marker; marker = marker->next) {
 		switch (marker->marker) {
 			case JPEG_APP0:
@@ -723,16 +788,25 @@ read_markers(j_decompress_ptr cinfo, FIBITMAP *dib) {
 			case EXIF_MARKER:
 				// Exif or Adobe XMP profile
 				jpeg_read_exif_profile(dib, marker->data, marker->data_length);
-				jpeg_read_xmp_profile(dib, marker->data, marker->data_length);
+				if (FreeImage_LoadsMetadataModel(FIMD_XMP)) {
+					jpeg_read_xmp_profile(dib, marker->data, marker->data_length);
+				}
 				jpeg_read_exif_profile_raw(dib, marker->data, marker->data_length);
 				break;
 			case IPTC_MARKER:
 				// IPTC/NAA or Adobe Photoshop profile
-				jpeg_read_iptc_profile(dib, marker->data, marker->data_length);
+				if (jpeg_read_iptc_profile(dib, marker->data, marker->data_length)) {
+					iptc_marker = marker;
+					iptc_markers++;
+				}
 				break;
 		}
 	}
 
+	if (iptc_markers == 1) {
+		FreeImage_SetMetadataSource(dib, FIMD_IPTC, iptc_marker->data, iptc_marker->data_length);
+	}
+
 	// ICC profile
 	uint8_t *icc_profile{};
 	unsigned icc_length = 0;
@@ -819,6 +893,14 @@ jpeg_write_iptc_profile(j_compress_ptr cinfo, FIBITMAP *dib) {
 	const unsigned tag_length = 26;
 
 	if (FreeImage_GetMetadataCount(FIMD_IPTC, dib)) {
+		// the APP13 marker the tags were read from, if they weren't modified since
+		const uint8_t *source{};
+		unsigned source_size = 0;
+		if (FreeImage_GetMetadataSource(dib, FIMD_IPTC, &source, &source_size) && (source_size <= 65533)) {
+			jpeg_write_marker(cinfo, IPTC_MARKER, source, source_size);
+			return TRUE;
+		}
+
 		uint8_t *profile{};
 		unsigned profile_size = 0;
 
@@ -1137,10 +1219,165 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
-static FIBITMAP * DLL_CALLCONV
-Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+/**
+Rectangle of the image to decode, in pixels from the top left corner, right and bottom excluded
+*/
+struct JPEGRegion {
+	unsigned left, top, right, bottom;
+};
+
+/**
+Number of rows passed to each jpeg_read_scanlines or jpeg_write_scanlines call, the height of an iMCU row
+*/
+static unsigned
+RowBatch(int max_v_samp_factor) {
+	return (unsigned)std::clamp(max_v_samp_factor, 1, MAX_SAMP_FACTOR) * DCTSIZE;
+}
+
+/**
+Copies a decoded row to a dib scanline, converting CMYK pixels
+*/
+static void
+ConvertScanline(j_decompress_ptr cinfo, int flags, const uint8_t *src, uint8_t *dst, unsigned width) {
+	if ((cinfo->out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
+		// convert from CMYK to RGB
+		for (unsigned x = 0; x < width; x++) {
+			uint16_t K = (uint16_t)src[3];
+			dst[FI_RGBA_RED]   = (uint8_t)((K * src[0]) / 255);	// C -> R
+			dst[FI_RGBA_GREEN] = (uint8_t)((K * src[1]) / 255);	// M -> G
+			dst[FI_RGBA_BLUE]  = (uint8_t)((K * src[2]) / 255);	// Y -> B
+			src += 4;
+			dst += 3;
+		}
+	} else if (cinfo->out_color_space == JCS_CMYK) {
+		// convert from LibJPEG CMYK to standard CMYK
+		for (unsigned x = 0; x < width; x++) {
+			// CMYK pixels are inverted
+			dst[0] = ~src[0];	// C
+			dst[1] = ~src[1];	// M
+			dst[2] = ~src[2];	// Y
+			dst[3] = ~src[3];	// K
+			src += 4;
+			dst += 4;
+		}
+	} else {
+		memcpy(dst, src, width * cinfo->output_components);
+	}
+}
+
+/**
+Decodes the rows of dib from the current output scanline of cinfo to its bottom.
+skip_rows decoded rows are discarded first, and scanlines start x_skip pixels right of the decoded rows.
+*/
+static void
+ReadScanlines(j_decompress_ptr cinfo, FIBITMAP *dib, int flags, unsigned x_skip, unsigned skip_rows) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned components = cinfo->output_components;
+	const unsigned batch = RowBatch(cinfo->max_v_samp_factor);
+
+	// RGB or greyscale rows of the dib size are decoded in place
+	const bool in_place = (cinfo->out_color_space != JCS_CMYK) && (x_skip == 0) && (width == cinfo->output_width);
+
+	JSAMPARRAY buffer = nullptr;	// output rows buffer
+	if (!in_place || skip_rows) {
+		// make a sample array that will go away when done with image
+		buffer = (*cinfo->mem->alloc_sarray)((j_common_ptr) cinfo, JPOOL_IMAGE, cinfo->output_width * components, batch);
+	}
+	while (skip_rows > 0) {
+		const JDIMENSION n = jpeg_read_scanlines(cinfo, buffer, std::min(skip_rows, batch));
+		if (n == 0) {
+			return;
+		}
+		skip_rows -= n;
+	}
+
+	JSAMPROW rows[MAX_SAMP_FACTOR * DCTSIZE];
+	for (unsigned y = 0; y < height; ) {
+		const unsigned count = std::min(batch, height - y);
+		JDIMENSION n;
+
+		if (in_place) {
+			for (unsigned i = 0; i < count; i++) {
+				rows[i] = FreeImage_GetScanLine(dib, height - 1 - y - i);
+			}
+			n = jpeg_read_scanlines(cinfo, rows, count);
+		} else {
+			n = jpeg_read_scanlines(cinfo, buffer, count);
+			for (unsigned i = 0; i < n; i++) {
+				ConvertScanline(cinfo, flags, buffer[i] + x_skip * components, FreeImage_GetScanLine(dib, height - 1 - y - i), width);
+			}
+		}
+		if (n == 0) {
+			break;
+		}
+		y += n;
+	}
+}
+
+/**
+Sets the decompression parameters of the load flags: the scaling to requested_size pixels (none when 0),
+the DCT method and the output color space
+*/
+static void
+SetDecompressParameters(j_decompress_ptr cinfo, int flags, int requested_size) {
+	unsigned int scale_num = 1;			// fraction by which to scale image
+	unsigned int scale_denom = 1;
+	if (requested_size > 0) {
+#ifdef LIBJPEG_TURBO_VERSION
+		// libjpeg-turbo scales by any M/8 on loading
+		// take the smallest scaling keeping the longest side at or above the requested size
+		const unsigned longest = MAX(cinfo->image_width, cinfo->image_height);
+		scale_num = scale_denom = 8;
+		while ((scale_num > 1) && ((longest * (scale_num - 1) + 7) / 8 >= (unsigned)requested_size)) {
+			scale_num--;
+		}
+#else
+		// the JPEG codec can perform x2, x4 or x8 scaling on loading
+		// try to find the more appropriate scaling according to user's need
+		double scale = MAX((double)cinfo->image_width, (double)cinfo->image_height) / (double)requested_size;
+		if (scale >= 8) {
+			scale_denom = 8;
+		} else if (scale >= 4) {
+			scale_denom = 4;
+		} else if (scale >= 2) {
+			scale_denom = 2;
+		}
+#endif
+	}
+	cinfo->scale_num = scale_num;
+	cinfo->scale_denom = scale_denom;
+
+	if ((flags & JPEG_ACCURATE) != JPEG_ACCURATE) {
+		cinfo->dct_method          = JDCT_IFAST;
+		cinfo->do_fancy_upsampling = FALSE;
+	}
+
+	if ((flags & JPEG_GREYSCALE) == JPEG_GREYSCALE) {
+		// force loading as a 8-bit greyscale image
+		cinfo->out_color_space = JCS_GRAYSCALE;
+	}
+
+#if defined(JCS_EXTENSIONS) && (FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR)
+	if (cinfo->out_color_space == JCS_RGB) {
+		// decode straight into the BGR layout of the dib rows
+		cinfo->out_color_space = JCS_EXT_BGR;
+	}
+#endif
+}
+
+/**
+Loads the whole image, or only region when it is set
+*/
+static FIBITMAP *
+LoadJPEG(FreeImageIO *io, fi_handle handle, int flags, const JPEGRegion *region) {
 	if (handle) {
 		FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
@@ -1168,15 +1405,24 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			jpeg_create_decompress(&cinfo);
 
-			// step 2a: specify data source (eg, a handle)
+			// step 2a: specify data source (eg, a handle), memory streams are decoded in place
 
-			jpeg_freeimage_src(&cinfo, handle, io);
+			if (!jpeg_freeimage_mem_src(&cinfo, handle, io)) {
+				jpeg_freeimage_src(&cinfo, handle, io);
+			}
 
-			// step 2b: save special markers for later reading
+			// step 2b: save special markers for later reading, only the ICC profile (and the Exif orientation) without metadata
 			
-			jpeg_save_markers(&cinfo, JPEG_COM, 0xFFFF);
-			for (int m = 0; m < 16; m++) {
-				jpeg_save_markers(&cinfo, JPEG_APP0 + m, 0xFFFF);
+			if ((flags & FIF_LOAD_NOMETADATA) != FIF_LOAD_NOMETADATA) {
+				jpeg_save_markers(&cinfo, JPEG_COM, 0xFFFF);
+				for (int m = 0; m < 16; m++) {
+					jpeg_save_markers(&cinfo, JPEG_APP0 + m, 0xFFFF);
+				}
+			} else {
+				jpeg_save_markers(&cinfo, ICC_MARKER, 0xFFFF);
+				if ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE) {
+					jpeg_save_markers(&cinfo, EXIF_MARKER, 0xFFFF);
+				}
 			}
 
 			// step 3: read handle parameters with jpeg_read_header()
@@ -1189,54 +1435,60 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			// step 4: set parameters for decompression
 
-			unsigned int scale_denom = 1;		// fraction by which to scale image
-			int	requested_size = flags >> 16;	// requested user size in pixels
-			if (requested_size > 0) {
-				// the JPEG codec can perform x2, x4 or x8 scaling on loading
-				// try to find the more appropriate scaling according to user's need
-				double scale = MAX((double)cinfo.image_width, (double)cinfo.image_height) / (double)requested_size;
-				if (scale >= 8) {
-					scale_denom = 8;
-				} else if (scale >= 4) {
-					scale_denom = 4;
-				} else if (scale >= 2) {
-					scale_denom = 2;
-				}
-			}
-			cinfo.scale_num = 1;
-			cinfo.scale_denom = scale_denom;
+			SetDecompressParameters(&cinfo, flags, region ? 0 : flags >> 16);
 
-			if ((flags & JPEG_ACCURATE) != JPEG_ACCURATE) {
-				cinfo.dct_method          = JDCT_IFAST;
-				cinfo.do_fancy_upsampling = FALSE;
-			}
+			// progressive images are decoded scan by scan for FreeImage_LoadProgressive
 
-			if ((flags & JPEG_GREYSCALE) == JPEG_GREYSCALE) {
-				// force loading as a 8-bit greyscale image
-				cinfo.out_color_space = JCS_GRAYSCALE;
-			}
+			const bool passes = !region && !header_only && ReportsPasses() && jpeg_has_multiple_scans(&cinfo);
+			cinfo.buffered_image = passes ? TRUE : FALSE;
 
 			// step 5a: start decompressor and calculate output width and height
 
 			jpeg_start_decompress(&cinfo);
 
+			unsigned dst_width = cinfo.output_width;
+			unsigned dst_height = cinfo.output_height;
+			unsigned x_skip = 0;		// decoded pixels left of the region
+			unsigned skip_rows = 0;		// decoded rows above the region
+
+			if (region) {
+				if ((region->left >= region->right) || (region->right > cinfo.output_width) || (region->top >= region->bottom) || (region->bottom > cinfo.output_height)) {
+					throw "Invalid region";
+				}
+				dst_width = region->right - region->left;
+				dst_height = region->bottom - region->top;
+				x_skip = region->left;
+				skip_rows = region->top;
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && (LIBJPEG_TURBO_VERSION_NUMBER >= 1005000)
+				if (!header_only) {
+					// only decode the iMCU columns of the region, skip the rows above it without IDCT
+					JDIMENSION xoffset = region->left;
+					JDIMENSION crop_width = dst_width;
+					jpeg_crop_scanline(&cinfo, &xoffset, &crop_width);
+					x_skip = region->left - xoffset;
+					jpeg_skip_scanlines(&cinfo, region->top);
+					skip_rows = 0;
+				}
+#endif
+			}
+
 			// step 5b: allocate dib and init header
 			std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
 			if ((cinfo.output_components == 4) && (cinfo.out_color_space == JCS_CMYK)) {
 				// CMYK image
 				if ((flags & JPEG_CMYK) == JPEG_CMYK) {
 					// load as CMYK
-					dib.reset(FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+					dib.reset(FreeImage_AllocateHeader(header_only, dst_width, dst_height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 					if (!dib) throw FI_MSG_ERROR_DIB_MEMORY;
 					FreeImage_GetICCProfile(dib.get())->flags |= FIICC_COLOR_IS_CMYK;
 				} else {
 					// load as CMYK and convert to RGB
-					dib.reset(FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+					dib.reset(FreeImage_AllocateHeader(header_only, dst_width, dst_height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 					if (!dib) throw FI_MSG_ERROR_DIB_MEMORY;
 				}
 			} else {
 				// RGB or greyscale image
-				dib.reset(FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 8 * cinfo.output_components, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+				dib.reset(FreeImage_AllocateHeader(header_only, dst_width, dst_height, 8 * cinfo.output_components, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 				if (!dib) throw FI_MSG_ERROR_DIB_MEMORY;
 
 				if (cinfo.output_components == 1) {
@@ -1250,7 +1502,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					}
 				}
 			}
-			if (scale_denom != 1) {
+			if (cinfo.scale_num != cinfo.scale_denom) {
 				// store original size info if a scaling was requested
 				store_size_info(dib.get(), cinfo.image_width, cinfo.image_height);
 			}
@@ -1282,73 +1534,31 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			// step 7a: while (scan lines remain to be read) jpeg_read_scanlines(...);
 
-			if ((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
-				// convert from CMYK to RGB
-
-				JSAMPARRAY buffer;		// output row buffer
-				unsigned row_stride;	// physical row width in output buffer
-
-				// JSAMPLEs per row in output buffer
-				row_stride = cinfo.output_width * cinfo.output_components;
-				// make a one-row-high sample array that will go away when done with image
-				buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
-
-				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW src = buffer[0];
-					JSAMPROW dst = FreeImage_GetScanLine(dib.get(), cinfo.output_height - cinfo.output_scanline - 1);
-
-					jpeg_read_scanlines(&cinfo, buffer, 1);
-
-					for (unsigned x = 0; x < cinfo.output_width; x++) {
-						uint16_t K = (uint16_t)src[3];
-						dst[FI_RGBA_RED]   = (uint8_t)((K * src[0]) / 255);	// C -> R
-						dst[FI_RGBA_GREEN] = (uint8_t)((K * src[1]) / 255);	// M -> G
-						dst[FI_RGBA_BLUE]  = (uint8_t)((K * src[2]) / 255);	// Y -> B
-						src += 4;
-						dst += 3;
+			if (passes) {
+				// every scan refines the whole image, the last one gives the final image
+				for (unsigned pass = 0; ; pass++) {
+					jpeg_start_output(&cinfo, cinfo.input_scan_number);
+					ReadScanlines(&cinfo, dib.get(), flags, 0, 0);
+					jpeg_finish_output(&cinfo);
+					if (jpeg_input_complete(&cinfo)) {
+						break;
 					}
-				}
-				
-				// if original image is CMYK but is converted to RGB, remove ICC profile from Exif-TIFF metadata
-				FreeImage_SetMetadata(FIMD_EXIF_MAIN, dib.get(), "InterColorProfile", nullptr);
-
-			} else if ((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) == JPEG_CMYK)) {
-				// convert from LibJPEG CMYK to standard CMYK
-
-				JSAMPARRAY buffer;		// output row buffer
-				unsigned row_stride;	// physical row width in output buffer
-
-				// JSAMPLEs per row in output buffer
-				row_stride = cinfo.output_width * cinfo.output_components;
-				// make a one-row-high sample array that will go away when done with image
-				buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
-
-				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW src = buffer[0];
-					JSAMPROW dst = FreeImage_GetScanLine(dib.get(), cinfo.output_height - cinfo.output_scanline - 1);
-
-					jpeg_read_scanlines(&cinfo, buffer, 1);
-
-					for (unsigned x = 0; x < cinfo.output_width; x++) {
-						// CMYK pixels are inverted
-						dst[0] = ~src[0];	// C
-						dst[1] = ~src[1];	// M
-						dst[2] = ~src[2];	// Y
-						dst[3] = ~src[3];	// K
-						src += 4;
-						dst += 4;
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+					if (cinfo.out_color_space == JCS_RGB) {
+						SwapRedBlue32(dib.get());
 					}
+#endif
+					NotifyPassDecoded(dib.get(), pass, 0);
 				}
-
 			} else {
-				// normal case (RGB or greyscale image)
-
-				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW dst = FreeImage_GetScanLine(dib.get(), cinfo.output_height - cinfo.output_scanline - 1);
+				ReadScanlines(&cinfo, dib.get(), flags, x_skip, skip_rows);
+			}
 
-					jpeg_read_scanlines(&cinfo, &dst, 1);
-				}
+			if ((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
+				// if original image is CMYK but is converted to RGB, remove ICC profile from Exif-TIFF metadata
+				FreeImage_SetMetadata(FIMD_EXIF_MAIN, dib.get(), "InterColorProfile", nullptr);
 
+			} else if (cinfo.out_color_space == JCS_RGB) {
 				// step 7b: swap red and blue components (see LibJPEG/jmorecfg.h: #define RGB_RED, ...)
 				// The default behavior of the JPEG library is kept "as is" because LibTIFF uses 
 				// LibJPEG "as is".
@@ -1358,16 +1568,20 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 #endif
 			}
 
-			// step 8: finish decompression
+			// step 8: finish decompression, the rows below a region are not decoded
 
-			jpeg_finish_decompress(&cinfo);
+			if (region) {
+				jpeg_abort_decompress(&cinfo);
+			} else {
+				jpeg_finish_decompress(&cinfo);
+			}
 
 			// step 9: release JPEG decompression object
 
 			jpeg_destroy_decompress(&cinfo);
 
 			// check for automatic Exif rotation
-			if (!header_only && ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE)) {
+			if (!header_only && !region && ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE)) {
 				auto *tmp(dib.release());
 				RotateExif(&tmp);
 				dib.reset(tmp);
@@ -1380,7 +1594,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		} catch (const char *text) {
 			jpeg_destroy_decompress(&cinfo);
 			if (text) {
-				FreeImage_OutputMessageProc(s_format_id, text);
+				FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 			}
 		}
 	}
@@ -1388,301 +1602,931 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	return nullptr;
 }
 
-// ----------------------------------------------------------
+static FIBITMAP * DLL_CALLCONV
+Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+	return LoadJPEG(io, handle, flags, nullptr);
+}
 
-static FIBOOL DLL_CALLCONV
-Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
-	if ((dib) && (handle)) {
-		try {
-			// Check dib format
+FIBITMAP *
+LoadRegionJPEG(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags) {
+	const JPEGRegion region = { left, top, right, bottom };
+	return LoadJPEG(io, handle, flags, &region);
+}
 
-			const char *sError = "only 24-bit RGB, 8-bit greyscale/palette or 32-bit CMYK bitmaps can be saved as JPEG";
+// ----------------------------------------------------------
+//   Scanline decoder
+// ----------------------------------------------------------
 
-			FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
-			uint16_t bpp = (uint16_t)FreeImage_GetBPP(dib);
+namespace {
 
-			if ((bpp != 24) && (bpp != 8) && !(bpp == 32 && (color_type == FIC_CMYK))) {
-				throw sError;
+	/**
+	Rows decoded by jpeg_read_scanlines as they are requested.
+	The decompression object lives with the decoder, errors are caught by a setjmp in each Read.
+	*/
+	class JPEGScanlineDecoder : public ScanlineDecoder
+	{
+	public:
+		JPEGScanlineDecoder(FIBITMAP *info, int flags)
+			: ScanlineDecoder(info), mFlags(flags)
+		{ }
+
+		~JPEGScanlineDecoder() override {
+			if (mCreated) {
+				jpeg_destroy_decompress(&mInfo);
 			}
+		}
 
-			if (bpp == 8) {
-				// allow grey, reverse grey and palette 
-				if ((color_type != FIC_MINISBLACK) && (color_type != FIC_MINISWHITE) && (color_type != FIC_PALETTE)) {
-					throw sError;
-				}
+		/**
+		Reads the header and starts the decompression with the parameters of the load flags, returns false on error
+		*/
+		bool Start(FreeImageIO *io, fi_handle handle) {
+			mInfo.err = jpeg_std_error(&mError.pub);
+			mError.pub.error_exit     = jpeg_error_exit;
+			mError.pub.output_message = jpeg_output_message;
+
+			if (setjmp(mError.setjmp_buffer)) {
+				// jpeg_error_exit destroyed the decompression object
+				mCreated = false;
+				return false;
 			}
 
+			jpeg_create_decompress(&mInfo);
+			mCreated = true;
 
-			struct jpeg_compress_struct cinfo;
-			ErrorManager fi_error_mgr;
+			if (!jpeg_freeimage_mem_src(&mInfo, handle, io)) {
+				jpeg_freeimage_src(&mInfo, handle, io);
+			}
+			jpeg_read_header(&mInfo, TRUE);
+			SetDecompressParameters(&mInfo, mFlags, mFlags >> 16);
+			jpeg_start_decompress(&mInfo);
+
+			// the header bitmap was read by a load of the same stream
+			FIBITMAP *info = GetInfo();
+			if ((mInfo.output_width != FreeImage_GetWidth(info)) || (mInfo.output_height != FreeImage_GetHeight(info))) {
+				return false;
+			}
+			mBuffer = (*mInfo.mem->alloc_sarray)((j_common_ptr)&mInfo, JPOOL_IMAGE, mInfo.output_width * mInfo.output_components, 1);
+			return true;
+		}
 
-			// Step 1: allocate and initialize JPEG compression object
+		j_decompress_ptr GetDecompress() {
+			return &mInfo;
+		}
 
-			// we set up the normal JPEG error routines, then override error_exit & output_message
-			cinfo.err = jpeg_std_error(&fi_error_mgr.pub);
-			fi_error_mgr.pub.error_exit     = jpeg_error_exit;
-			fi_error_mgr.pub.output_message = jpeg_output_message;
-			
-			// establish the setjmp return context for jpeg_error_exit to use
-			if (setjmp(fi_error_mgr.setjmp_buffer)) {
-				// If we get here, the JPEG code has signaled an error.
-				// We need to clean up the JPEG object, close the input file, and return.
-				jpeg_destroy_compress(&cinfo);
-				throw (const char*)nullptr;
+		unsigned Read(uint8_t *buffer, unsigned count, unsigned pitch) override {
+			const unsigned first = mRow;
+			if (!mCreated) {
+				return 0;
+			}
+			if (setjmp(mError.setjmp_buffer)) {
+				// jpeg_error_exit destroyed the decompression object, the rows decoded so far are kept
+				mCreated = false;
+				return mRow - first;
 			}
 
-			// Now we can initialize the JPEG compression object
-
-			jpeg_create_compress(&cinfo);
+			const unsigned width = mInfo.output_width;
+			const bool in_place = (mInfo.out_color_space != JCS_CMYK);
+			while ((mRow - first < count) && (mInfo.output_scanline < mInfo.output_height)) {
+				uint8_t *row = buffer + (size_t)(mRow - first) * pitch;
+				if (in_place) {
+					JSAMPROW rows[1] = { row };
+					if (jpeg_read_scanlines(&mInfo, rows, 1) != 1) {
+						break;
+					}
+#if !defined(JCS_EXTENSIONS) && (FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR)
+					if (mInfo.out_color_space == JCS_RGB) {
+						for (unsigned x = 0; x < width; x++, row += 3) {
+							INPLACESWAP(row[0], row[2]);
+						}
+					}
+#endif
+				} else {
+					if (jpeg_read_scanlines(&mInfo, mBuffer, 1) != 1) {
+						break;
+					}
+					ConvertScanline(&mInfo, mFlags, mBuffer[0], row, width);
+				}
+				mRow++;
+			}
+			return mRow - first;
+		}
 
-			// Step 2: specify data destination (eg, a file)
+	private:
+		struct jpeg_decompress_struct mInfo{};
+		ErrorManager mError{};
+		JSAMPARRAY mBuffer{};
+		int mFlags;
+		unsigned mRow{ 0 };
+		bool mCreated{ false };
+	};
+
+} // namespace
+
+std::unique_ptr<ScanlineDecoder>
+CreateScanlineDecoderJPEG(FreeImageIO *io, fi_handle handle, int flags) {
+	if ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE) {
+		// rotated images are loaded whole
+		return nullptr;
+	}
 
-			jpeg_freeimage_dst(&cinfo, handle, io);
+	const long start = io->tell_proc(handle);
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> info(LoadJPEG(io, handle, flags | FIF_LOAD_NOPIXELS, nullptr), &FreeImage_Unload);
+	if (!info) {
+		return nullptr;
+	}
+	io->seek_proc(handle, start, SEEK_SET);
 
-			// Step 3: set parameters for compression 
+	auto decoder = std::make_unique<JPEGScanlineDecoder>(info.get(), flags);
+	info.release();
+	if (!decoder->Start(io, handle)) {
+		return nullptr;
+	}
+	j_decompress_ptr cinfo = decoder->GetDecompress();
+	if ((cinfo->out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
+		// the CMYK profile doesn't describe the converted rows
+		FreeImage_SetMetadata(FIMD_EXIF_MAIN, decoder->GetInfo(), "InterColorProfile", nullptr);
+	}
+	return decoder;
+}
 
-			cinfo.image_width = FreeImage_GetWidth(dib);
-			cinfo.image_height = FreeImage_GetHeight(dib);
+// ----------------------------------------------------------
 
-			switch (color_type) {
-				case FIC_MINISBLACK :
-				case FIC_MINISWHITE :
-					cinfo.in_color_space = JCS_GRAYSCALE;
-					cinfo.input_components = 1;
-					break;
-				case FIC_CMYK:
-					cinfo.in_color_space = JCS_CMYK;
-					cinfo.input_components = 4;
-					break;
-				default :
-					cinfo.in_color_space = JCS_RGB;
-					cinfo.input_components = 3;
-					break;
-			}
+/**
+Sets the progressive, Huffman optimization, subsampling and quality parameters of the save flags.
+Called after jpeg_set_defaults.
+*/
+static void
+SetCompressionParameters(j_compress_ptr cinfo, int flags) {
+	// progressive-JPEG support
+	if ((flags & JPEG_PROGRESSIVE) == JPEG_PROGRESSIVE) {
+		jpeg_simple_progression(cinfo);
+	}
+	
+	// compute optimal Huffman coding tables for the image
+	if ((flags & JPEG_OPTIMIZE) == JPEG_OPTIMIZE) {
+		cinfo->optimize_coding = TRUE;
+	}
 
-			jpeg_set_defaults(&cinfo);
+	// set subsampling options if required
+
+	if ((cinfo->in_color_space == JCS_RGB) || (cinfo->in_color_space == JCS_YCbCr)) {
+		if ((flags & JPEG_SUBSAMPLING_411) == JPEG_SUBSAMPLING_411) { 
+			// 4:1:1 (4x1 1x1 1x1) - CrH 25% - CbH 25% - CrV 100% - CbV 100%
+			// the horizontal color resolution is quartered
+			cinfo->comp_info[0].h_samp_factor = 4;	// Y 
+			cinfo->comp_info[0].v_samp_factor = 1; 
+			cinfo->comp_info[1].h_samp_factor = 1;	// Cb 
+			cinfo->comp_info[1].v_samp_factor = 1; 
+			cinfo->comp_info[2].h_samp_factor = 1;	// Cr 
+			cinfo->comp_info[2].v_samp_factor = 1; 
+		} else if ((flags & JPEG_SUBSAMPLING_420) == JPEG_SUBSAMPLING_420) {
+			// 4:2:0 (2x2 1x1 1x1) - CrH 50% - CbH 50% - CrV 50% - CbV 50%
+			// the chrominance resolution in both the horizontal and vertical directions is cut in half
+			cinfo->comp_info[0].h_samp_factor = 2;	// Y
+			cinfo->comp_info[0].v_samp_factor = 2; 
+			cinfo->comp_info[1].h_samp_factor = 1;	// Cb
+			cinfo->comp_info[1].v_samp_factor = 1; 
+			cinfo->comp_info[2].h_samp_factor = 1;	// Cr
+			cinfo->comp_info[2].v_samp_factor = 1; 
+		} else if ((flags & JPEG_SUBSAMPLING_422) == JPEG_SUBSAMPLING_422){ //2x1 (low) 
+			// 4:2:2 (2x1 1x1 1x1) - CrH 50% - CbH 50% - CrV 100% - CbV 100%
+			// half of the horizontal resolution in the chrominance is dropped (Cb & Cr), 
+			// while the full resolution is retained in the vertical direction, with respect to the luminance
+			cinfo->comp_info[0].h_samp_factor = 2;	// Y 
+			cinfo->comp_info[0].v_samp_factor = 1; 
+			cinfo->comp_info[1].h_samp_factor = 1;	// Cb 
+			cinfo->comp_info[1].v_samp_factor = 1; 
+			cinfo->comp_info[2].h_samp_factor = 1;	// Cr 
+			cinfo->comp_info[2].v_samp_factor = 1; 
+		} 
+		else if ((flags & JPEG_SUBSAMPLING_444) == JPEG_SUBSAMPLING_444){ //1x1 (no subsampling) 
+			// 4:4:4 (1x1 1x1 1x1) - CrH 100% - CbH 100% - CrV 100% - CbV 100%
+			// the resolution of chrominance information (Cb & Cr) is preserved 
+			// at the same rate as the luminance (Y) information
+			cinfo->comp_info[0].h_samp_factor = 1;	// Y 
+			cinfo->comp_info[0].v_samp_factor = 1; 
+			cinfo->comp_info[1].h_samp_factor = 1;	// Cb 
+			cinfo->comp_info[1].v_samp_factor = 1; 
+			cinfo->comp_info[2].h_samp_factor = 1;	// Cr 
+			cinfo->comp_info[2].v_samp_factor = 1;  
+		} 
+	}
 
-		    // progressive-JPEG support
-			if ((flags & JPEG_PROGRESSIVE) == JPEG_PROGRESSIVE) {
-				jpeg_simple_progression(&cinfo);
-			}
-			
-			// compute optimal Huffman coding tables for the image
-			if ((flags & JPEG_OPTIMIZE) == JPEG_OPTIMIZE) {
-				cinfo.optimize_coding = TRUE;
-			}
+	// set quality
+	// the first 7 bits are reserved for low level quality settings
+	// the other bits are high level (i.e. enum-ish)
+
+	int quality;
+
+	if ((flags & JPEG_QUALITYBAD) == JPEG_QUALITYBAD) {
+		quality = 10;
+	} else if ((flags & JPEG_QUALITYAVERAGE) == JPEG_QUALITYAVERAGE) {
+		quality = 25;
+	} else if ((flags & JPEG_QUALITYNORMAL) == JPEG_QUALITYNORMAL) {
+		quality = 50;
+	} else if ((flags & JPEG_QUALITYGOOD) == JPEG_QUALITYGOOD) {
+		quality = 75;
+	} else 	if ((flags & JPEG_QUALITYSUPERB) == JPEG_QUALITYSUPERB) {
+		quality = 100;
+	} else {
+		if ((flags & 0x7F) == 0) {
+			quality = 75;
+		} else {
+			quality = flags & 0x7F;
+		}
+	}
 
-			// Set JFIF density parameters from the DIB data
+	jpeg_set_quality(cinfo, quality, TRUE); /* limit to baseline-JPEG values */
+}
 
-			cinfo.X_density = (UINT16) (0.5 + 0.0254 * FreeImage_GetDotsPerMeterX(dib));
-			cinfo.Y_density = (UINT16) (0.5 + 0.0254 * FreeImage_GetDotsPerMeterY(dib));
-			cinfo.density_unit = 1;	// dots / inch
+/**
+Returns true when the dib rows are in BGR order and libjpeg expects RGB samples
+*/
+static bool
+SwapsRedBlue(j_compress_ptr cinfo) {
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	return cinfo->in_color_space == JCS_RGB;
+#else
+	return false;
+#endif
+}
 
-			// thumbnail support (JFIF 1.02 extension markers)
-			if (FreeImage_GetThumbnail(dib)) {
-				cinfo.write_JFIF_header = static_cast<boolean>(1); //<### force it, though when color is CMYK it will be incorrect
-				cinfo.JFIF_minor_version = 2;
+/**
+Converts a dib scanline to the samples of a JPEG row
+*/
+static void
+ConvertScanline(j_compress_ptr cinfo, FREE_IMAGE_COLOR_TYPE color_type, unsigned bytespp, const FIRGBA8 *palette, const uint8_t *source, uint8_t *target) {
+	const unsigned width = cinfo->image_width;
+
+	switch (color_type) {
+		case FIC_YUV:
+			// Y, U and V are stored in the red, green and blue members of the pixels
+			for (unsigned x = 0; x < width; x++) {
+				const auto *pixel = (const FIRGB8*)source;
+				target[0] = pixel->red;		// Y
+				target[1] = pixel->green;	// Cb
+				target[2] = pixel->blue;	// Cr
+				source += bytespp;
+				target += 3;
 			}
-
-			// baseline JPEG support
-			if ((flags & JPEG_BASELINE) == JPEG_BASELINE) {
-				cinfo.write_JFIF_header = static_cast<boolean>(0);	// No marker for non-JFIF colorspaces
-				cinfo.write_Adobe_marker = static_cast<boolean>(0);	// write no Adobe marker by default				
+			return;
+		case FIC_CMYK:
+			for (unsigned x = 0; x < width; x++) {
+				// CMYK pixels are inverted
+				target[0] = ~source[0];	// C
+				target[1] = ~source[1];	// M
+				target[2] = ~source[2];	// Y
+				target[3] = ~source[3];	// K
+				source += 4;
+				target += 4;
 			}
-
-			// set subsampling options if required
-
-			if (cinfo.in_color_space == JCS_RGB) {
-				if ((flags & JPEG_SUBSAMPLING_411) == JPEG_SUBSAMPLING_411) { 
-					// 4:1:1 (4x1 1x1 1x1) - CrH 25% - CbH 25% - CrV 100% - CbV 100%
-					// the horizontal color resolution is quartered
-					cinfo.comp_info[0].h_samp_factor = 4;	// Y 
-					cinfo.comp_info[0].v_samp_factor = 1; 
-					cinfo.comp_info[1].h_samp_factor = 1;	// Cb 
-					cinfo.comp_info[1].v_samp_factor = 1; 
-					cinfo.comp_info[2].h_samp_factor = 1;	// Cr 
-					cinfo.comp_info[2].v_samp_factor = 1; 
-				} else if ((flags & JPEG_SUBSAMPLING_420) == JPEG_SUBSAMPLING_420) {
-					// 4:2:0 (2x2 1x1 1x1) - CrH 50% - CbH 50% - CrV 50% - CbV 50%
-					// the chrominance resolution in both the horizontal and vertical directions is cut in half
-					cinfo.comp_info[0].h_samp_factor = 2;	// Y
-					cinfo.comp_info[0].v_samp_factor = 2; 
-					cinfo.comp_info[1].h_samp_factor = 1;	// Cb
-					cinfo.comp_info[1].v_samp_factor = 1; 
-					cinfo.comp_info[2].h_samp_factor = 1;	// Cr
-					cinfo.comp_info[2].v_samp_factor = 1; 
-				} else if ((flags & JPEG_SUBSAMPLING_422) == JPEG_SUBSAMPLING_422){ //2x1 (low) 
-					// 4:2:2 (2x1 1x1 1x1) - CrH 50% - CbH 50% - CrV 100% - CbV 100%
-					// half of the horizontal resolution in the chrominance is dropped (Cb & Cr), 
-					// while the full resolution is retained in the vertical direction, with respect to the luminance
-					cinfo.comp_info[0].h_samp_factor = 2;	// Y 
-					cinfo.comp_info[0].v_samp_factor = 1; 
-					cinfo.comp_info[1].h_samp_factor = 1;	// Cb 
-					cinfo.comp_info[1].v_samp_factor = 1; 
-					cinfo.comp_info[2].h_samp_factor = 1;	// Cr 
-					cinfo.comp_info[2].v_samp_factor = 1; 
-				} 
-				else if ((flags & JPEG_SUBSAMPLING_444) == JPEG_SUBSAMPLING_444){ //1x1 (no subsampling) 
-					// 4:4:4 (1x1 1x1 1x1) - CrH 100% - CbH 100% - CrV 100% - CbV 100%
-					// the resolution of chrominance information (Cb & Cr) is preserved 
-					// at the same rate as the luminance (Y) information
-					cinfo.comp_info[0].h_samp_factor = 1;	// Y 
-					cinfo.comp_info[0].v_samp_factor = 1; 
-					cinfo.comp_info[1].h_samp_factor = 1;	// Cb 
-					cinfo.comp_info[1].v_samp_factor = 1; 
-					cinfo.comp_info[2].h_samp_factor = 1;	// Cr 
-					cinfo.comp_info[2].v_samp_factor = 1;  
-				} 
+			return;
+		case FIC_MINISWHITE:
+			// reverse 8-bit greyscale image, so reverse grey value on the fly
+			for (unsigned x = 0; x < width; x++) {
+				target[x] = (uint8_t)(255 - source[x]);
 			}
+			return;
+		case FIC_PALETTE:
+			// 8-bit palettized images are converted to 24-bit images
+			FreeImage_ConvertLine8To24(target, const_cast<uint8_t*>(source), width, const_cast<FIRGBA8*>(palette));
+			break;
+		default:
+			memcpy(target, source, width * 3);
+			break;
+	}
+	if (SwapsRedBlue(cinfo)) {
+		// swap R and B channels
+		for (unsigned x = 0; x < width; x++) {
+			INPLACESWAP(target[0], target[2]);
+			target += 3;
+		}
+	}
+}
 
-			// Step 4: set quality
-			// the first 7 bits are reserved for low level quality settings
-			// the other bits are high level (i.e. enum-ish)
-
-			int quality;
-
-			if ((flags & JPEG_QUALITYBAD) == JPEG_QUALITYBAD) {
-				quality = 10;
-			} else if ((flags & JPEG_QUALITYAVERAGE) == JPEG_QUALITYAVERAGE) {
-				quality = 25;
-			} else if ((flags & JPEG_QUALITYNORMAL) == JPEG_QUALITYNORMAL) {
-				quality = 50;
-			} else if ((flags & JPEG_QUALITYGOOD) == JPEG_QUALITYGOOD) {
-				quality = 75;
-			} else 	if ((flags & JPEG_QUALITYSUPERB) == JPEG_QUALITYSUPERB) {
-				quality = 100;
-			} else {
-				if ((flags & 0x7F) == 0) {
-					quality = 75;
-				} else {
-					quality = flags & 0x7F;
-				}
-			}
+/**
+Sets up a compressor for dib: colour space, JFIF density and the compression parameters of the save flags
+*/
+static void
+SetupCompressor(j_compress_ptr cinfo, FIBITMAP *dib, FREE_IMAGE_COLOR_TYPE color_type, int flags) {
+	cinfo->image_width = FreeImage_GetWidth(dib);
+	cinfo->image_height = FreeImage_GetHeight(dib);
+
+	switch (color_type) {
+		case FIC_MINISBLACK :
+		case FIC_MINISWHITE :
+			cinfo->in_color_space = JCS_GRAYSCALE;
+			cinfo->input_components = 1;
+			break;
+		case FIC_CMYK:
+			cinfo->in_color_space = JCS_CMYK;
+			cinfo->input_components = 4;
+			break;
+		case FIC_YUV:
+			// YUV of FreeImage_ConvertToColor is the JPEG YCbCr, libjpeg doesn't convert it
+			cinfo->in_color_space = JCS_YCbCr;
+			cinfo->input_components = 3;
+			break;
+		default :
+			cinfo->in_color_space = JCS_RGB;
+			cinfo->input_components = 3;
+			break;
+	}
 
-			jpeg_set_quality(&cinfo, quality, TRUE); /* limit to baseline-JPEG values */
+	jpeg_set_defaults(cinfo);
 
-			// Step 5: Start compressor 
+	// Set JFIF density parameters from the DIB data
 
-			jpeg_start_compress(&cinfo, TRUE);
+	cinfo->X_density = (UINT16) (0.5 + 0.0254 * FreeImage_GetDotsPerMeterX(dib));
+	cinfo->Y_density = (UINT16) (0.5 + 0.0254 * FreeImage_GetDotsPerMeterY(dib));
+	cinfo->density_unit = 1;	// dots / inch
 
-			// Step 6: Write special markers
-			
-			if ((flags & JPEG_BASELINE) !=  JPEG_BASELINE) {
-				write_markers(&cinfo, dib);
-			}
+	// thumbnail support (JFIF 1.02 extension markers)
+	if (FreeImage_GetThumbnail(dib)) {
+		cinfo->write_JFIF_header = static_cast<boolean>(1); //<### force it, though when color is CMYK it will be incorrect
+		cinfo->JFIF_minor_version = 2;
+	}
 
-			// Step 7: while (scan lines remain to be written) 
+	// baseline JPEG support
+	if ((flags & JPEG_BASELINE) == JPEG_BASELINE) {
+		cinfo->write_JFIF_header = static_cast<boolean>(0);	// No marker for non-JFIF colorspaces
+		cinfo->write_Adobe_marker = static_cast<boolean>(0);	// write no Adobe marker by default				
+	}
 
-			if (color_type == FIC_RGB) {
-				// 24-bit RGB image : need to swap red and blue channels
-				unsigned pitch = FreeImage_GetPitch(dib);
-				auto *target = (uint8_t*)malloc(pitch * sizeof(uint8_t));
-				if (!target) {
-					throw FI_MSG_ERROR_MEMORY;
-				}
+	SetCompressionParameters(cinfo, flags);
 
-				while (cinfo.next_scanline < cinfo.image_height) {
-					// get a copy of the scanline
-					memcpy(target, FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - cinfo.next_scanline - 1), pitch);
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-					// swap R and B channels
-					uint8_t *target_p = target;
-					for (unsigned x = 0; x < cinfo.image_width; x++) {
-						INPLACESWAP(target_p[0], target_p[2]);
-						target_p += 3;
-					}
+#if defined(JCS_EXTENSIONS) && (FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR)
+	if (cinfo->in_color_space == JCS_RGB) {
+		// compress straight from the BGR layout of the dib rows
+		cinfo->in_color_space = JCS_EXT_BGR;
+	}
 #endif
-					// write the scanline
-					jpeg_write_scanlines(&cinfo, &target, 1);
-				}
-				free(target);
+}
+
+/**
+Writes the cinfo->image_height scanlines of dib starting at first_row (counted from the top)
+*/
+static void
+WriteScanlines(j_compress_ptr cinfo, FIBITMAP *dib, FREE_IMAGE_COLOR_TYPE color_type, unsigned first_row) {
+	const unsigned batch = RowBatch(cinfo->max_v_samp_factor);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	const FIRGBA8 *palette = FreeImage_GetPalette(dib);
+
+	// greyscale, RGB and YUV rows in the library channel order are written from the dib
+	const bool in_place = (color_type == FIC_MINISBLACK) || ((color_type == FIC_RGB) && !SwapsRedBlue(cinfo))
+		|| ((color_type == FIC_YUV) && (bpp == 24));
+
+	JSAMPARRAY buffer = nullptr;	// converted rows buffer
+	if (!in_place) {
+		buffer = (*cinfo->mem->alloc_sarray)((j_common_ptr) cinfo, JPOOL_IMAGE, cinfo->image_width * cinfo->input_components, batch);
+	}
+
+	JSAMPROW rows[MAX_SAMP_FACTOR * DCTSIZE];
+	while (cinfo->next_scanline < cinfo->image_height) {
+		const unsigned count = std::min(batch, cinfo->image_height - cinfo->next_scanline);
+
+		for (unsigned i = 0; i < count; i++) {
+			uint8_t *source = FreeImage_GetScanLine(dib, height - 1 - first_row - cinfo->next_scanline - i);
+			if (in_place) {
+				rows[i] = source;
+				continue;
+			}
+			rows[i] = buffer[i];
+			ConvertScanline(cinfo, color_type, bpp / 8, palette, source, buffer[i]);
+		}
+		jpeg_write_scanlines(cinfo, rows, count);
+	}
+}
+
+// ----------------------------------------------------------
+//   Shared Huffman tables
+// ----------------------------------------------------------
+
+/**
+Huffman tables of a save: DC and AC tables of the luminance (0) and chrominance (1) components
+*/
+struct JPEGTables {
+	JHUFF_TBL dc[NUM_HUFF_TBLS / 2];
+	JHUFF_TBL ac[NUM_HUFF_TBLS / 2];
+};
+
+/**
+Frequencies of the symbols of the four tables, estimated from code lengths
+*/
+struct JPEGSymbolStats {
+	uint64_t dc[NUM_HUFF_TBLS / 2][256];
+	uint64_t ac[NUM_HUFF_TBLS / 2][256];
+};
+
+/**
+Builds the optimal Huffman table of the symbols with a nonzero frequency, with codes limited to 16 bits
+(procedure of Annex K.2 of the JPEG specification, as in jpeg_gen_optimal_table).
+*/
+static void
+BuildHuffmanTable(const uint64_t symbol_freq[256], JHUFF_TBL *table) {
+	constexpr int kMaxCodeSize = 64;
+	uint64_t freq[257];
+	int codesize[257];
+	int others[257];
+
+	memset(table, 0, sizeof(JHUFF_TBL));
+	if (std::all_of(symbol_freq, symbol_freq + 256, [](uint64_t f) { return f == 0; })) {
+		// table of no component
+		return;
+	}
+
+	memcpy(freq, symbol_freq, 256 * sizeof(uint64_t));
+	// a reserved symbol keeps any code from being all ones
+	freq[256] = 1;
+	std::fill(codesize, codesize + 257, 0);
+	std::fill(others, others + 257, -1);
+
+	for (;;) {
+		// the two least frequent symbols, the largest symbol wins ties
+		int c1 = -1;
+		int c2 = -1;
+		uint64_t v1 = UINT64_MAX;
+		uint64_t v2 = UINT64_MAX;
+		for (int i = 0; i <= 256; i++) {
+			if (freq[i] && (freq[i] <= v1)) {
+				c2 = c1;
+				v2 = v1;
+				c1 = i;
+				v1 = freq[i];
+			} else if (freq[i] && (freq[i] <= v2)) {
+				c2 = i;
+				v2 = freq[i];
+			}
+		}
+		if (c2 < 0) {
+			break;
+		}
+
+		// merge the two branches of the tree
+		freq[c1] += freq[c2];
+		freq[c2] = 0;
+		codesize[c1]++;
+		while (others[c1] >= 0) {
+			c1 = others[c1];
+			codesize[c1]++;
+		}
+		others[c1] = c2;
+		codesize[c2]++;
+		while (others[c2] >= 0) {
+			c2 = others[c2];
+			codesize[c2]++;
+		}
+	}
+
+	int bits[kMaxCodeSize + 1] = {};
+	for (int i = 0; i <= 256; i++) {
+		if (codesize[i]) {
+			bits[std::min(codesize[i], kMaxCodeSize)]++;
+		}
+	}
+
+	// move the codes longer than 16 bits up the tree
+	for (int i = kMaxCodeSize; i > 16; i--) {
+		while (bits[i] > 0) {
+			int j = i - 2;
+			while (bits[j] == 0) {
+				j--;
+			}
+			bits[i] -= 2;
+			bits[i - 1]++;
+			bits[j + 1] += 2;
+			bits[j]--;
+		}
+	}
+	// drop the reserved code, one of the longest
+	int i = 16;
+	while (bits[i] == 0) {
+		i--;
+	}
+	bits[i]--;
+
+	for (i = 1; i <= 16; i++) {
+		table->bits[i] = (UINT8)bits[i];
+	}
+	int p = 0;
+	for (int size = 1; size <= kMaxCodeSize; size++) {
+		for (int j = 0; j < 256; j++) {
+			if (codesize[j] == size) {
+				table->huffval[p++] = (UINT8)j;
 			}
-			else if (color_type == FIC_CMYK) {
-				unsigned pitch = FreeImage_GetPitch(dib);
-				auto *target = (uint8_t*)malloc(pitch * sizeof(uint8_t));
-				if (!target) {
-					throw FI_MSG_ERROR_MEMORY;
+		}
+	}
+	table->sent_table = FALSE;
+}
+
+/**
+Adds the symbols of the DHT segments of a JPEG stream to stats: a symbol coded on n bits occurs about
+once every 2^n symbols, weighted by weight.
+*/
+static void
+AddHuffmanStats(const uint8_t *data, size_t size, uint64_t weight, JPEGSymbolStats *stats) {
+	size_t pos = 2;
+	while (pos + 4 <= size) {
+		if (data[pos] != 0xFF) {
+			return;
+		}
+		const uint8_t marker = data[pos + 1];
+		const size_t length = (data[pos + 2] << 8) | data[pos + 3];
+		if ((marker == JPEG_SOS) || (length < 2) || (pos + 2 + length > size)) {
+			return;
+		}
+		if (marker == JPEG_DHT) {
+			const uint8_t *table = data + pos + 4;
+			const uint8_t *end = data + pos + 2 + length;
+			while (table + 17 <= end) {
+				const int table_class = table[0] >> 4;
+				const int id = table[0] & 0x0F;
+				unsigned count = 0;
+				for (int n = 1; n <= 16; n++) {
+					count += table[n];
 				}
-				
-				while (cinfo.next_scanline < cinfo.image_height) {
-					// get a copy of the scanline
-					memcpy(target, FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - cinfo.next_scanline - 1), pitch);
-					
-					uint8_t *target_p = target;
-					for (unsigned x = 0; x < cinfo.image_width; x++) {
-						// CMYK pixels are inverted
-						target_p[0] = ~target_p[0];	// C
-						target_p[1] = ~target_p[1];	// M
-						target_p[2] = ~target_p[2];	// Y
-						target_p[3] = ~target_p[3];	// K
-
-						target_p += 4;
+				if ((id >= NUM_HUFF_TBLS / 2) || (table_class > 1) || (table + 17 + count > end)) {
+					return;
+				}
+				uint64_t *freq = table_class ? stats->ac[id] : stats->dc[id];
+				const uint8_t *symbol = table + 17;
+				for (int n = 1; n <= 16; n++) {
+					for (unsigned k = 0; k < table[n]; k++) {
+						freq[*symbol++] += weight << (16 - n);
 					}
-					
-					// write the scanline
-					jpeg_write_scanlines(&cinfo, &target, 1);
 				}
-				free(target);
+				table += 17 + count;
 			}
-			else if (color_type == FIC_MINISBLACK) {
-				// 8-bit standard greyscale images
-				while (cinfo.next_scanline < cinfo.image_height) {
-					JSAMPROW b = FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - cinfo.next_scanline - 1);
+		}
+		pos += 2 + length;
+	}
+}
 
-					jpeg_write_scanlines(&cinfo, &b, 1);
-				}
+/**
+Gives every symbol which a baseline scan can use a nonzero frequency, so that the tables code any image
+*/
+static void
+CompleteHuffmanStats(JPEGSymbolStats *stats) {
+	for (int id = 0; id < NUM_HUFF_TBLS / 2; id++) {
+		// DC: sizes of the differences
+		for (int s = 0; s <= 11; s++) {
+			stats->dc[id][s] = std::max<uint64_t>(stats->dc[id][s], 1);
+		}
+		// AC: EOB, ZRL and run / size pairs
+		stats->ac[id][0x00] = std::max<uint64_t>(stats->ac[id][0x00], 1);
+		stats->ac[id][0xF0] = std::max<uint64_t>(stats->ac[id][0xF0], 1);
+		for (int run = 0; run < 16; run++) {
+			for (int s = 1; s <= 10; s++) {
+				stats->ac[id][(run << 4) | s] = std::max<uint64_t>(stats->ac[id][(run << 4) | s], 1);
 			}
-			else if (color_type == FIC_PALETTE) {
-				// 8-bit palettized images are converted to 24-bit images
-				FIRGBA8 *palette = FreeImage_GetPalette(dib);
-				auto *target = (uint8_t*)malloc(cinfo.image_width * 3);
-				if (!target) {
-					throw FI_MSG_ERROR_MEMORY;
-				}
+		}
+	}
+}
 
-				while (cinfo.next_scanline < cinfo.image_height) {
-					uint8_t *source = FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - cinfo.next_scanline - 1);
-					FreeImage_ConvertLine8To24(target, source, cinfo.image_width, palette);
+static void
+BuildHuffmanTables(const JPEGSymbolStats *stats, JPEGTables *tables) {
+	for (int id = 0; id < NUM_HUFF_TBLS / 2; id++) {
+		BuildHuffmanTable(stats->dc[id], &tables->dc[id]);
+		BuildHuffmanTable(stats->ac[id], &tables->ac[id]);
+	}
+}
 
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-					// swap R and B channels
-					uint8_t *target_p = target;
-					for (unsigned x = 0; x < cinfo.image_width; x++) {
-						INPLACESWAP(target_p[0], target_p[2]);
-						target_p += 3;
-					}
-#endif
+/**
+Replaces the standard tables set by jpeg_set_defaults, in place of an optimisation pass
+*/
+static void
+ApplyHuffmanTables(j_compress_ptr cinfo, const JPEGTables *tables) {
+	for (int id = 0; id < NUM_HUFF_TBLS / 2; id++) {
+		if (std::all_of(tables->dc[id].bits, tables->dc[id].bits + 17, [](UINT8 n) { return n == 0; })) {
+			// unused by the sample, the standard tables stay
+			continue;
+		}
+		if (!cinfo->dc_huff_tbl_ptrs[id]) {
+			cinfo->dc_huff_tbl_ptrs[id] = jpeg_alloc_huff_table((j_common_ptr)cinfo);
+		}
+		if (!cinfo->ac_huff_tbl_ptrs[id]) {
+			cinfo->ac_huff_tbl_ptrs[id] = jpeg_alloc_huff_table((j_common_ptr)cinfo);
+		}
+		*cinfo->dc_huff_tbl_ptrs[id] = tables->dc[id];
+		*cinfo->ac_huff_tbl_ptrs[id] = tables->ac[id];
+	}
+	cinfo->optimize_coding = FALSE;
+}
+
+// ----------------------------------------------------------
+//   Parallel encoding
+// ----------------------------------------------------------
+
+/**
+Encodes the scanlines [first_row, last_row) of dib as a JPEG stream of their own, with a restart marker
+after every MCU row. The first band also writes the markers of the dib.
+*/
+static FIBOOL
+EncodeBand(FIBITMAP *dib, FREE_IMAGE_COLOR_TYPE color_type, int flags, const JPEGTables *tables, unsigned first_row, unsigned last_row, FIMEMORY *stream) {
+	struct jpeg_compress_struct cinfo;
+	ErrorManager fi_error_mgr;
+
+	cinfo.err = jpeg_std_error(&fi_error_mgr.pub);
+	fi_error_mgr.pub.error_exit     = jpeg_error_exit;
+	fi_error_mgr.pub.output_message = jpeg_output_message;
+
+	if (setjmp(fi_error_mgr.setjmp_buffer)) {
+		jpeg_destroy_compress(&cinfo);
+		return FALSE;
+	}
+
+	jpeg_create_compress(&cinfo);
+
+	FreeImageIO io;
+	SetMemoryIO(&io);
+	jpeg_freeimage_dst(&cinfo, stream, &io);
+
+	SetupCompressor(&cinfo, dib, color_type, flags);
+	cinfo.image_height = last_row - first_row;
+	cinfo.restart_in_rows = 1;
+	if (tables) {
+		ApplyHuffmanTables(&cinfo, tables);
+	}
+
+	jpeg_start_compress(&cinfo, TRUE);
+
+	if ((first_row == 0) && ((flags & JPEG_BASELINE) != JPEG_BASELINE)) {
+		write_markers(&cinfo, dib);
+	}
+
+	WriteScanlines(&cinfo, dib, color_type, first_row);
+
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+
+	return TRUE;
+}
+
+/**
+Offset of the entropy coded data of a JPEG stream, after its SOS segment. sof receives the offset of the SOFn marker.
+@return Returns 0 if the stream is malformed
+*/
+static size_t
+FindScanData(const uint8_t *data, size_t size, size_t *sof) {
+	size_t pos = 2;
+	while (pos + 4 <= size) {
+		if (data[pos] != 0xFF) {
+			return 0;
+		}
+		const uint8_t marker = data[pos + 1];
+		const size_t length = (data[pos + 2] << 8) | data[pos + 3];
+		if ((marker >= JPEG_SOF0) && (marker <= JPEG_SOF2)) {
+			*sof = pos;
+		}
+		if (marker == JPEG_SOS) {
+			return pos + 2 + length;
+		}
+		pos += 2 + length;
+	}
+	return 0;
+}
+
+/**
+Saves dib with bands of MCU rows encoded concurrently, each band is a restart interval sequence of its own.
+The bands are joined into one scan: headers of the first band with the full height, entropy coded data
+of all bands separated by restart markers, renumbered in sequence.
+JPEG_OPTIMIZE encodes the bands twice, the second time with the tables built from the first pass.
+@return Returns FALSE if the image isn't worth it or can't be split, the caller encodes it serially then
+*/
+static FIBOOL
+SaveParallel(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, FREE_IMAGE_COLOR_TYPE color_type, int flags, const JPEGTables *tables, FIBOOL *success) {
+	// MCU rows per band, below this a band costs more to set up than it saves
+	constexpr unsigned kMinBandMCURows = 16;
+
+	if (((flags & JPEG_PARALLEL) != JPEG_PARALLEL) || ((flags & JPEG_PROGRESSIVE) == JPEG_PROGRESSIVE)) {
+		return FALSE;
+	}
+	const unsigned threads = FreeImage_GetThreadCount();
+	if ((threads < 2) || ThreadPool::IsWorkerThread()) {
+		return FALSE;
+	}
+
+	// MCU size, as set up by the save flags
+	int max_h_samp = 1;
+	int max_v_samp = 1;
+	{
+		struct jpeg_compress_struct cinfo;
+		ErrorManager fi_error_mgr;
+		cinfo.err = jpeg_std_error(&fi_error_mgr.pub);
+		fi_error_mgr.pub.error_exit     = jpeg_error_exit;
+		fi_error_mgr.pub.output_message = jpeg_output_message;
+		if (setjmp(fi_error_mgr.setjmp_buffer)) {
+			jpeg_destroy_compress(&cinfo);
+			return FALSE;
+		}
+		jpeg_create_compress(&cinfo);
+		SetupCompressor(&cinfo, dib, color_type, flags);
+		for (int c = 0; c < cinfo.num_components; c++) {
+			max_h_samp = std::max(max_h_samp, cinfo.comp_info[c].h_samp_factor);
+			max_v_samp = std::max(max_v_samp, cinfo.comp_info[c].v_samp_factor);
+		}
+		jpeg_destroy_compress(&cinfo);
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned mcu_height = max_v_samp * DCTSIZE;
+	const unsigned mcu_rows = (height + mcu_height - 1) / mcu_height;
+	const unsigned mcus_per_row = (width + max_h_samp * DCTSIZE - 1) / (max_h_samp * DCTSIZE);
+
+	// the restart interval is one MCU row, the DRI segment holds 16 bits
+	if ((mcus_per_row > 0xFFFF) || (mcu_rows < 2 * kMinBandMCURows)) {
+		return FALSE;
+	}
 
+	const unsigned band_count = std::min(mcu_rows / kMinBandMCURows, threads * 4);
+	const unsigned band_mcu_rows = (mcu_rows + band_count - 1) / band_count;
+	const unsigned band_rows = band_mcu_rows * mcu_height;
+	const unsigned bands = (height + band_rows - 1) / band_rows;
 
-					jpeg_write_scanlines(&cinfo, &target, 1);
+	std::vector<FIMEMORY*> streams(bands, nullptr);
+	auto closeStreams = [&streams]() {
+		for (FIMEMORY *&stream : streams) {
+			FreeImage_CloseMemory(stream);
+			stream = nullptr;
+		}
+	};
+
+	auto encodeBands = [&](const JPEGTables *band_tables, int band_flags) -> bool {
+		std::atomic<bool> failed{ false };
+		closeStreams();
+		ParallelFor(0, bands, 1, [&](unsigned first, unsigned last) {
+			for (unsigned b = first; (b < last) && !failed; b++) {
+				streams[b] = FreeImage_OpenMemory();
+				const unsigned first_row = b * band_rows;
+				const unsigned last_row = std::min(height, first_row + band_rows);
+				if (!streams[b] || !EncodeBand(dib, color_type, band_flags, band_tables, first_row, last_row, streams[b])) {
+					failed = true;
 				}
+			}
+		});
+		return !failed;
+	};
 
-				free(target);
+	*success = FALSE;
+
+	JPEGTables optimized;
+	if (!tables && ((flags & JPEG_OPTIMIZE) == JPEG_OPTIMIZE)) {
+		// first pass: tables of every band, merged by code lengths
+		if (!encodeBands(nullptr, flags)) {
+			closeStreams();
+			return TRUE;
+		}
+		auto stats = std::make_unique<JPEGSymbolStats>();
+		memset(stats.get(), 0, sizeof(JPEGSymbolStats));
+		for (FIMEMORY *stream : streams) {
+			uint8_t *data = nullptr;
+			uint32_t size = 0;
+			FreeImage_AcquireMemory(stream, &data, &size);
+			AddHuffmanStats(data, size, 1 + size / 1024, stats.get());
+		}
+		BuildHuffmanTables(stats.get(), &optimized);
+		tables = &optimized;
+	}
+
+	if (!encodeBands(tables, flags & ~JPEG_OPTIMIZE)) {
+		closeStreams();
+		return TRUE;
+	}
+
+	// join the bands
+	uint8_t restart = 0;
+	auto writeScanData = [&](uint8_t *data, size_t size) -> bool {
+		for (size_t i = 0; i + 1 < size; i++) {
+			if ((data[i] == 0xFF) && (data[i + 1] >= JPEG_RST0) && (data[i + 1] <= JPEG_RST7)) {
+				data[++i] = (uint8_t)(JPEG_RST0 + restart);
+				restart = (restart + 1) & 7;
 			}
-			else if (color_type == FIC_MINISWHITE) {
-				// reverse 8-bit greyscale image, so reverse grey value on the fly
-				unsigned i;
-				uint8_t reverse[256];
-				auto *target = (uint8_t *)malloc(cinfo.image_width);
-				if (!target) {
-					throw FI_MSG_ERROR_MEMORY;
-				}
+		}
+		return io->write_proc(data, 1, (unsigned)size, handle) == size;
+	};
+
+	bool written = true;
+	for (unsigned b = 0; (b < bands) && written; b++) {
+		uint8_t *data = nullptr;
+		uint32_t size = 0;
+		FreeImage_AcquireMemory(streams[b], &data, &size);
+
+		size_t sof = 0;
+		const size_t scan = FindScanData(data, size, &sof);
+		if (!scan || !sof || (size < scan + 2) || (data[size - 2] != 0xFF) || (data[size - 1] != JPEG_EOI)) {
+			FreeImage_OutputMessageProc(s_format_id, "Invalid band stream");
+			written = false;
+			break;
+		}
+		if (b == 0) {
+			// headers with the height of the image
+			data[sof + 5] = (uint8_t)(height >> 8);
+			data[sof + 6] = (uint8_t)(height & 0xFF);
+			written = (io->write_proc(data, 1, (unsigned)scan, handle) == scan);
+		} else {
+			const uint8_t marker[2] = { 0xFF, (uint8_t)(JPEG_RST0 + restart) };
+			restart = (restart + 1) & 7;
+			written = (io->write_proc((void*)marker, 1, 2, handle) == 2);
+		}
+		written = written && writeScanData(data + scan, size - 2 - scan);
+	}
+	if (written) {
+		const uint8_t eoi[2] = { 0xFF, JPEG_EOI };
+		written = (io->write_proc((void*)eoi, 1, 2, handle) == 2);
+	}
 
-				for (i = 0; i < 256; i++) {
-					reverse[i] = (uint8_t)(255 - i);
-				}
+	closeStreams();
+	*success = written ? TRUE : FALSE;
+	return TRUE;
+}
 
-				while (cinfo.next_scanline < cinfo.image_height) {
-					uint8_t *source = FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - cinfo.next_scanline - 1);
-					for (i = 0; i < cinfo.image_width; i++) {
-						target[i] = reverse[ source[i] ];
-					}
-					jpeg_write_scanlines(&cinfo, &target, 1);
+// ----------------------------------------------------------
+
+/**
+Saves dib, with the Huffman tables given by tables if it isn't nullptr
+*/
+static FIBOOL
+SaveJPEG(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int flags, const JPEGTables *tables) {
+	if ((dib) && (handle)) {
+		try {
+			// Check dib format
+
+			const char *sError = "only 24-bit RGB, 8-bit greyscale/palette, 32-bit CMYK or 24/32-bit YUV bitmaps can be saved as JPEG";
+
+			FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
+			uint16_t bpp = (uint16_t)FreeImage_GetBPP(dib);
+
+			if ((bpp != 24) && (bpp != 8) && !(bpp == 32 && ((color_type == FIC_CMYK) || (color_type == FIC_YUV)))) {
+				throw sError;
+			}
+
+			if (bpp == 8) {
+				// allow grey, reverse grey and palette 
+				if ((color_type != FIC_MINISBLACK) && (color_type != FIC_MINISWHITE) && (color_type != FIC_PALETTE)) {
+					throw sError;
 				}
+			}
+
+			// progressive scans code other symbols, they keep their own tables
+			if ((flags & JPEG_PROGRESSIVE) == JPEG_PROGRESSIVE) {
+				tables = nullptr;
+			}
+
+			FIBOOL success = FALSE;
+			if (SaveParallel(io, handle, dib, color_type, flags, tables, &success)) {
+				return success;
+			}
+
+			struct jpeg_compress_struct cinfo;
+			ErrorManager fi_error_mgr;
+
+			// Step 1: allocate and initialize JPEG compression object
+
+			// we set up the normal JPEG error routines, then override error_exit & output_message
+			cinfo.err = jpeg_std_error(&fi_error_mgr.pub);
+			fi_error_mgr.pub.error_exit     = jpeg_error_exit;
+			fi_error_mgr.pub.output_message = jpeg_output_message;
+			
+			// establish the setjmp return context for jpeg_error_exit to use
+			if (setjmp(fi_error_mgr.setjmp_buffer)) {
+				// If we get here, the JPEG code has signaled an error.
+				// We need to clean up the JPEG object, close the input file, and return.
+				jpeg_destroy_compress(&cinfo);
+				throw (const char*)nullptr;
+			}
+
+			// Now we can initialize the JPEG compression object
+
+			jpeg_create_compress(&cinfo);
 
-				free(target);
+			// Step 2: specify data destination (eg, a file)
+
+			jpeg_freeimage_dst(&cinfo, handle, io);
+
+			// Step 3: set parameters for compression 
+
+			SetupCompressor(&cinfo, dib, color_type, flags);
+
+			if (tables) {
+				ApplyHuffmanTables(&cinfo, tables);
 			}
 
+			// Step 5: Start compressor 
+
+			jpeg_start_compress(&cinfo, TRUE);
+
+			// Step 6: Write special markers
+			
+			if ((flags & JPEG_BASELINE) !=  JPEG_BASELINE) {
+				write_markers(&cinfo, dib);
+			}
+
+			// Step 7: while (scan lines remain to be written) 
+
+			WriteScanlines(&cinfo, dib, color_type, 0);
+
 			// Step 8: Finish compression 
 
 			jpeg_finish_compress(&cinfo);
@@ -1695,7 +2539,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 		} catch (const char *text) {
 			if (text) {
-				FreeImage_OutputMessageProc(s_format_id, text);
+				FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 			}
 			return FALSE;
 		} 
@@ -1704,6 +2548,244 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	return FALSE;
 }
 
+static FIBOOL DLL_CALLCONV
+Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
+	return SaveJPEG(io, dib, handle, flags, nullptr);
+}
+
+JPEGTables*
+CreateJPEGTables(FIBITMAP *sample, int flags) {
+	// the optimal tables of the sample
+	FIMEMORY *stream = FreeImage_OpenMemory();
+	if (!stream) {
+		return nullptr;
+	}
+	FreeImageIO io;
+	SetMemoryIO(&io);
+	flags = (flags & ~(JPEG_PROGRESSIVE | JPEG_PARALLEL)) | JPEG_OPTIMIZE | JPEG_BASELINE;
+	if (!SaveJPEG(&io, sample, stream, flags, nullptr)) {
+		FreeImage_CloseMemory(stream);
+		return nullptr;
+	}
+
+	auto stats = std::make_unique<JPEGSymbolStats>();
+	memset(stats.get(), 0, sizeof(JPEGSymbolStats));
+	uint8_t *data = nullptr;
+	uint32_t size = 0;
+	FreeImage_AcquireMemory(stream, &data, &size);
+	AddHuffmanStats(data, size, 1, stats.get());
+	FreeImage_CloseMemory(stream);
+
+	// symbols missing from the sample get the longest codes
+	CompleteHuffmanStats(stats.get());
+
+	auto *tables = new(std::nothrow) JPEGTables;
+	if (!tables) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+		return nullptr;
+	}
+	BuildHuffmanTables(stats.get(), tables);
+	return tables;
+}
+
+void
+DeleteJPEGTables(JPEGTables *tables) {
+	delete tables;
+}
+
+FIBOOL
+SaveJPEGWithTables(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, const JPEGTables *tables, int flags) {
+	return SaveJPEG(io, dib, handle, flags & ~JPEG_OPTIMIZE, tables);
+}
+
+FIBOOL
+SaveJPEGPlanes(FreeImageIO *io, fi_handle handle, unsigned width, unsigned height, const uint8_t *const *planes, const unsigned *pitches, int flags) {
+	try {
+		struct jpeg_compress_struct cinfo;
+		ErrorManager fi_error_mgr;
+
+		// set up the error manager
+
+		cinfo.err = jpeg_std_error(&fi_error_mgr.pub);
+		fi_error_mgr.pub.error_exit     = jpeg_error_exit;
+		fi_error_mgr.pub.output_message = jpeg_output_message;
+
+		if (setjmp(fi_error_mgr.setjmp_buffer)) {
+			jpeg_destroy_compress(&cinfo);
+			throw (const char*)nullptr;
+		}
+
+		jpeg_create_compress(&cinfo);
+
+		cinfo.image_width = width;
+		cinfo.image_height = height;
+		cinfo.in_color_space = JCS_YCbCr;
+		cinfo.input_components = 3;
+
+		jpeg_set_defaults(&cinfo);
+		SetCompressionParameters(&cinfo, flags);
+
+		// the planes are already downsampled
+		cinfo.raw_data_in = TRUE;
+
+		int max_h_samp_factor = 1, max_v_samp_factor = 1;
+		for (int c = 0; c < 3; c++) {
+			max_h_samp_factor = std::max(max_h_samp_factor, cinfo.comp_info[c].h_samp_factor);
+			max_v_samp_factor = std::max(max_v_samp_factor, cinfo.comp_info[c].v_samp_factor);
+		}
+		unsigned plane_width[3], plane_height[3];
+		for (int c = 0; c < 3; c++) {
+			plane_width[c] = (width * cinfo.comp_info[c].h_samp_factor + max_h_samp_factor - 1) / max_h_samp_factor;
+			plane_height[c] = (height * cinfo.comp_info[c].v_samp_factor + max_v_samp_factor - 1) / max_v_samp_factor;
+			if (!planes[c] || (pitches[c] < plane_width[c])) {
+				jpeg_destroy_compress(&cinfo);
+				throw "Invalid YCbCr plane";
+			}
+		}
+
+		jpeg_freeimage_dst(&cinfo, handle, io);
+		jpeg_start_compress(&cinfo, TRUE);
+
+		// one iMCU row of each plane, padded to whole DCT blocks
+
+		JSAMPARRAY rows[3];
+		JDIMENSION row_count[3];
+		for (int c = 0; c < 3; c++) {
+			const jpeg_component_info *comp = &cinfo.comp_info[c];
+			row_count[c] = comp->v_samp_factor * DCTSIZE;
+			rows[c] = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, comp->width_in_blocks * DCTSIZE, row_count[c]);
+		}
+
+		const JDIMENSION imcu_height = max_v_samp_factor * DCTSIZE;
+		for (unsigned imcu_row = 0; cinfo.next_scanline < cinfo.image_height; imcu_row++) {
+			for (int c = 0; c < 3; c++) {
+				const unsigned padded_width = cinfo.comp_info[c].width_in_blocks * DCTSIZE;
+				for (JDIMENSION i = 0; i < row_count[c]; i++) {
+					// rows below the image repeat the last one
+					const unsigned y = std::min(imcu_row * row_count[c] + i, plane_height[c] - 1);
+					JSAMPROW dst = rows[c][i];
+					memcpy(dst, planes[c] + (size_t)y * pitches[c], plane_width[c]);
+					memset(dst + plane_width[c], dst[plane_width[c] - 1], padded_width - plane_width[c]);
+				}
+			}
+			jpeg_write_raw_data(&cinfo, rows, imcu_height);
+		}
+
+		jpeg_finish_compress(&cinfo);
+		jpeg_destroy_compress(&cinfo);
+
+		return TRUE;
+
+	} catch (const char *text) {
+		if (text) {
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
+		}
+	}
+	return FALSE;
+}
+
+// --------------------------------------------------------------------------
+
+/**
+Probe the markers preceding the frame header, without libjpeg nor heap allocations.
+Exif (APP1) and ICC (APP2) segments are expected before the SOFn marker.
+*/
+static FIBOOL DLL_CALLCONV
+GetImageInfo(FreeImageIO *io, fi_handle handle, FIIMAGEINFO *info, void *data) {
+	uint8_t marker[2];
+	if ((io->read_proc(marker, 2, 1, handle) != 1) || (marker[0] != 0xFF) || (marker[1] != 0xD8)) {
+		return FALSE;
+	}
+
+	for (;;) {
+		// markers may be preceded by fill bytes
+		uint8_t b = 0;
+		do {
+			if (io->read_proc(&b, 1, 1, handle) != 1) {
+				return FALSE;
+			}
+		} while (b != 0xFF);
+		do {
+			if (io->read_proc(&b, 1, 1, handle) != 1) {
+				return FALSE;
+			}
+		} while (b == 0xFF);
+
+		if ((b == 0x01) || ((b >= 0xD0) && (b <= 0xD7))) {
+			// standalone markers
+			continue;
+		}
+		if ((b == 0xD9) || (b == 0xDA)) {
+			// EOI or SOS before any frame header
+			return FALSE;
+		}
+
+		uint8_t length_bytes[2];
+		if (io->read_proc(length_bytes, 2, 1, handle) != 1) {
+			return FALSE;
+		}
+		const unsigned length = (length_bytes[0] << 8) | length_bytes[1];
+		if (length < 2) {
+			return FALSE;
+		}
+		unsigned skip = length - 2;
+
+		if ((b >= 0xC0) && (b <= 0xCF) && (b != 0xC4) && (b != 0xC8) && (b != 0xCC)) {
+			// SOFn : precision, height, width, number of components
+			uint8_t frame[6];
+			if ((skip < sizeof(frame)) || (io->read_proc(frame, sizeof(frame), 1, handle) != 1)) {
+				return FALSE;
+			}
+			info->height = (frame[1] << 8) | frame[2];
+			info->width = (frame[3] << 8) | frame[4];
+			info->image_type = FIT_BITMAP;
+			// SOF2, SOF6, SOF10 and SOF14 are progressive
+			info->interlaced = ((b & 0x03) == 0x02) ? TRUE : FALSE;
+			switch (frame[5]) {
+				case 1:
+					info->bpp = 8;
+					info->color_type = FIC_MINISBLACK;
+					break;
+				case 3:
+				case 4:
+					// CMYK images are converted to RGB unless JPEG_CMYK is set
+					info->bpp = 24;
+					info->color_type = FIC_RGB;
+					break;
+				default:
+					return FALSE;
+			}
+			return TRUE;
+		}
+
+		if ((b == 0xE1) && (skip >= 6)) {
+			// APP1, the 0th IFD of an Exif profile is at its beginning
+			uint8_t exif[1024];
+			const unsigned size = MIN(skip, (unsigned)sizeof(exif));
+			if (io->read_proc(exif, size, 1, handle) != 1) {
+				return FALSE;
+			}
+			if (const unsigned orientation = exif_read_orientation(exif, size)) {
+				info->orientation = orientation;
+			}
+			skip -= size;
+		} else if ((b == ICC_MARKER) && (skip >= ICC_HEADER_SIZE)) {
+			// APP2, ICC profile chunks
+			uint8_t icc[ICC_HEADER_SIZE];
+			if (io->read_proc(icc, ICC_HEADER_SIZE, 1, handle) != 1) {
+				return FALSE;
+			}
+			if (memcmp(icc, "ICC_PROFILE", 12) == 0) {
+				info->has_icc_profile = TRUE;
+			}
+			skip -= ICC_HEADER_SIZE;
+		}
+		if ((skip > 0) && (io->seek_proc(handle, (long)skip, SEEK_CUR) != 0)) {
+			return FALSE;
+		}
+	}
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
@@ -1728,6 +2810,8 @@ InitJPEG(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->get_image_info_proc = GetImageInfo;
+	plugin->concurrency_proc = Concurrency;
 }
 
 
@@ -22,6 +22,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "../Metadata/FreeImageTag.h"
+#include "FreeImage/Plugin.h"
 
 #include "jxrgluelib/JXRGlue.h"
 
@@ -934,6 +935,11 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ==========================================================
 //	Open & Close
 // ==========================================================
@@ -987,21 +993,23 @@ SetDecoderParameters(PKImageDecode *pDecoder, int flags) {
 }
 
 /**
-Copy or convert & copy decoded pixels into the dib
+Copy or convert & copy decoded pixels of a rectangle of the image
 @param pDecoder Decoder handle
 @param out_guid_format Target guid format
-@param dib Output dib
-@param width Image width
-@param height Image height
+@param dst_bits First line of the rectangle, lines are stored top-down
+@param dst_pitch Distance between two lines in bytes
+@param line_size Size of a line of the rectangle in bytes
+@param width Rectangle width
+@param height Rectangle height
 @return Returns 0 if successful, returns ERR otherwise
 */
 static ERR
-CopyPixels(PKImageDecode *pDecoder, PKPixelFormatGUID out_guid_format, FIBITMAP *dib, int width, int height) {
+CopyPixels(PKImageDecode *pDecoder, PKPixelFormatGUID out_guid_format, uint8_t *dst_bits, unsigned dst_pitch, size_t line_size, int width, int height) {
 	PKFormatConverter *pConverter{};	// pixel format converter
 	ERR error_code = 0;	// error code as returned by the interface
 	uint8_t *pb{};	// local buffer used for pixel format conversion
 	
-	// image dimensions
+	// rectangle dimensions, the region of interest of the decoder is already set
 	const PKRect rect = {0, 0, width, height};
 
 	try {
@@ -1015,14 +1023,8 @@ CopyPixels(PKImageDecode *pDecoder, PKPixelFormatGUID out_guid_format, FIBITMAP
 		if (IsEqualGUID(out_guid_format, in_guid_format)) {
 			// no conversion, load bytes "as is" ...
 
-			// get a pointer to dst pixel data
-			uint8_t *dib_bits = FreeImage_GetBits(dib);
-
-			// get dst pitch (count of uint8_t for stride)
-			const unsigned cbStride = FreeImage_GetPitch(dib);			
-
 			// decode and copy bits to dst array
-			error_code = pDecoder->Copy(pDecoder, &rect, dib_bits, cbStride);
+			error_code = pDecoder->Copy(pDecoder, &rect, dst_bits, dst_pitch);
 			JXR_CHECK(error_code);		
 		}
 		else {
@@ -1064,11 +1066,8 @@ CopyPixels(PKImageDecode *pDecoder, PKPixelFormatGUID out_guid_format, FIBITMAP
 			JXR_CHECK(error_code);
 
 			// now copy pixels into the dib
-			const size_t line_size = FreeImage_GetLine(dib);
 			for (int y = 0; y < height; y++) {
-				uint8_t *src_bits = (uint8_t*)(pb + y * cbStride);
-				uint8_t *dst_bits = (uint8_t*)FreeImage_GetScanLine(dib, y);
-				memcpy(dst_bits, src_bits, line_size);
+				memcpy(dst_bits + (size_t)y * dst_pitch, pb + (size_t)y * cbStride, line_size);
 			}
 			
 			// free the local buffer
@@ -1078,24 +1077,6 @@ CopyPixels(PKImageDecode *pDecoder, PKPixelFormatGUID out_guid_format, FIBITMAP
 			PKFormatConverter_Release(&pConverter);
 		}
 
-		// FreeImage DIB are upside-down relative to usual graphic conventions
-		FreeImage_FlipVertical(dib);
-
-		// post-processing ...
-		// -------------------
-
-		// swap RGB as needed
-
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-		if (IsEqualGUID(out_guid_format, GUID_PKPixelFormat24bppRGB) || IsEqualGUID(out_guid_format, GUID_PKPixelFormat32bppRGB)) {
-			SwapRedBlue32(dib);
-		}
-#elif FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
-		if (IsEqualGUID(out_guid_format, GUID_PKPixelFormat24bppBGR) || IsEqualGUID(out_guid_format, GUID_PKPixelFormat32bppBGR)) {
-			SwapRedBlue32(dib);
-		}
-#endif
-		
 		return WMP_errSuccess;
 
 	} catch(...) {
@@ -1108,10 +1089,172 @@ CopyPixels(PKImageDecode *pDecoder, PKPixelFormatGUID out_guid_format, FIBITMAP
 	}
 }
 
+/**
+Post-processing of the decoded pixels: rows are flipped and RGB swapped as needed
+@param dib Output dib, decoded top-down
+@param out_guid_format Decoded guid format
+*/
+static void
+FinishPixels(FIBITMAP *dib, PKPixelFormatGUID out_guid_format) {
+	// FreeImage DIB are upside-down relative to usual graphic conventions
+	FreeImage_FlipVertical(dib);
+
+	// swap RGB as needed
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	if (IsEqualGUID(out_guid_format, GUID_PKPixelFormat24bppRGB) || IsEqualGUID(out_guid_format, GUID_PKPixelFormat32bppRGB)) {
+		SwapRedBlue32(dib);
+	}
+#elif FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
+	if (IsEqualGUID(out_guid_format, GUID_PKPixelFormat24bppBGR) || IsEqualGUID(out_guid_format, GUID_PKPixelFormat32bppBGR)) {
+		SwapRedBlue32(dib);
+	}
+#endif
+}
+
+/**
+Size of a reduced resolution image, as computed by the decoder from the requested thumbnail size (see WMPhotoValidate)
+@param width Image width
+@param height Image height
+@param thumb_width Requested thumbnail width, returns the decoded width
+@param thumb_height Requested thumbnail height, returns the decoded height
+*/
+static void
+GetThumbnailSize(size_t width, size_t height, size_t *thumb_width, size_t *thumb_height) {
+	size_t cScale = 1;
+	if ((width + *thumb_width - 1) / *thumb_width != (height + *thumb_height - 1) / *thumb_height) {
+		while (((width + cScale - 1) / cScale > *thumb_width) && ((height + cScale - 1) / cScale > *thumb_height) && (cScale << 1)) {
+			cScale <<= 1;
+		}
+	} else {
+		cScale = MAX((size_t)1, (width + *thumb_width - 1) / *thumb_width);
+	}
+	*thumb_width = (width + cScale - 1) / cScale;
+	*thumb_height = (height + cScale - 1) / cScale;
+}
+
+/**
+Bytes of the whole stream, the band decoders read them through their own memory streams.
+Memory streams are read in place, other streams are copied into buffer.
+@return Returns the stream bytes or nullptr
+*/
+static const uint8_t*
+GetStreamBytes(FreeImageIO *io, fi_handle handle, std::vector<uint8_t>& buffer, size_t *size) {
+	// the decoder uses absolute positions
+	const long start = io->tell_proc(handle);
+	const uint8_t *bytes{};
+
+	io->seek_proc(handle, 0, SEEK_SET);
+	uint64_t available = 0;
+	if ((bytes = FreeImage_PeekMemoryIO(io, handle, &available)) != nullptr) {
+		*size = (size_t)available;
+	} else {
+		io->seek_proc(handle, 0, SEEK_END);
+		const long end = io->tell_proc(handle);
+		io->seek_proc(handle, 0, SEEK_SET);
+		if (end > 0) {
+			buffer.resize((size_t)end);
+			if (io->read_proc(buffer.data(), 1, (unsigned)end, handle) == (unsigned)end) {
+				bytes = buffer.data();
+				*size = buffer.size();
+			}
+		}
+	}
+
+	io->seek_proc(handle, start, SEEK_SET);
+	return bytes;
+}
+
+/**
+Decode the horizontal tiles of an image in parallel, each band of tiles with its own decoder
+and a region of interest. Without tiles, a region decode has to parse the image from the top.
+@return Returns FALSE if the stream bytes can't be accessed, throws on decoding errors
+*/
+static FIBOOL
+DecodeTileBands(FreeImageIO *io, fi_handle handle, PKImageDecode *pDecoder, PKPixelFormatGUID guid_format, FIBITMAP *dib, int flags) {
+	const CWMIStrCodecParam& wmiSCP = pDecoder->WMP.wmiSCP;
+	const unsigned tile_rows = (unsigned)wmiSCP.cNumOfSliceMinus1H + 1;
+
+	std::vector<uint8_t> buffer;
+	size_t size = 0;
+	const uint8_t *bytes = GetStreamBytes(io, handle, buffer, &size);
+	if (!bytes) {
+		return FALSE;
+	}
+
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned pitch = FreeImage_GetPitch(dib);
+	const size_t line_size = FreeImage_GetLine(dib);
+	uint8_t *bits = FreeImage_GetBits(dib);
+
+	// first row of a tile, in pixels
+	auto tileTop = [&](unsigned tile) {
+		return (tile < tile_rows) ? MIN(height, (unsigned)wmiSCP.uiTileY[tile] * 16) : height;
+	};
+
+	ParallelFor(0, tile_rows, 1, [&](unsigned first, unsigned last) {
+		const unsigned top = tileTop(first);
+		const unsigned bottom = tileTop(last);
+		if (top >= bottom) {
+			return;
+		}
+
+		WMPStream *pStream{};
+		PKImageDecode *pBandDecoder{};
+		ERR error_code = 0;
+
+		try {
+			error_code = CreateWS_Memory(&pStream, (void*)bytes, size);
+			JXR_CHECK(error_code);
+
+			error_code = PKImageDecode_Create_WMP(&pBandDecoder);
+			JXR_CHECK(error_code);
+
+			error_code = pBandDecoder->Initialize(pBandDecoder, pStream);
+			JXR_CHECK(error_code);
+
+			SetDecoderParameters(pBandDecoder, flags);
+
+			// the band of rows is the region of interest
+			pBandDecoder->WMP.wmiI.cROILeftX = 0;
+			pBandDecoder->WMP.wmiI.cROITopY = top;
+			pBandDecoder->WMP.wmiI.cROIWidth = width;
+			pBandDecoder->WMP.wmiI.cROIHeight = bottom - top;
+
+			error_code = CopyPixels(pBandDecoder, guid_format, bits + (size_t)top * pitch, pitch, line_size, (int)width, (int)(bottom - top));
+			JXR_CHECK(error_code);
+
+			pBandDecoder->Release(&pBandDecoder);
+			pStream->Close(&pStream);
+
+		} catch (const char *) {
+			if (pBandDecoder) {
+				pBandDecoder->Release(&pBandDecoder);
+			}
+			if (pStream) {
+				pStream->Close(&pStream);
+			}
+			throw;
+		}
+	});
+
+	return TRUE;
+}
+
 // --------------------------------------------------------------------------
 
-static FIBITMAP * DLL_CALLCONV
-Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+/**
+Decode an image, a rectangle of it or a reduced resolution
+@param io FreeImage IO
+@param handle FreeImage IO handle
+@param pDecodeStream I/O stream wrapper
+@param flags Load flags, the longest side requested by FreeImage_LoadScaled is in the upper 16 bits
+@param area Left, top, right, bottom rectangle (right and bottom excluded), nullptr for the whole image
+@return Returns the decoded dib if successful, returns nullptr otherwise
+*/
+static FIBITMAP *
+Decode(FreeImageIO *io, fi_handle handle, WMPStream *pDecodeStream, int flags, const unsigned *area) {
 	PKImageDecode *pDecoder{};	// decoder interface
 	ERR error_code = 0;				// error code as returned by the interface
 	PKPixelFormatGUID guid_format;	// loaded pixel format (== input file pixel format if no conversion needed)
@@ -1119,9 +1262,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	FREE_IMAGE_TYPE image_type = FIT_UNKNOWN;	// input image type
 	unsigned bpp = 0;							// input image bit depth
 
-	// get the I/O stream wrapper
-	WMPStream *pDecodeStream = (WMPStream*)data;
-
 	if (!handle || !pDecodeStream) {
 		return nullptr;
 	}
@@ -1151,8 +1291,50 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		// get image dimensions
 		pDecoder->GetSize(pDecoder, &width, &height);
 
+		// regions and reduced resolutions are given in the stored orientation
+		const FIBOOL oriented = pDecoder->WMP.wmiI.oOrientation != O_NONE;
+		if (area && oriented) {
+			pDecoder->Release(&pDecoder);
+			io->seek_proc(handle, 0, SEEK_SET);
+			std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> full(Decode(io, handle, pDecodeStream, flags, nullptr), &FreeImage_Unload);
+			return full ? FreeImage_Copy(full.get(), (int)area[0], (int)area[1], (int)area[2], (int)area[3]) : nullptr;
+		}
+
+		int dst_width = width, dst_height = height;
+		if (area) {
+			if ((area[0] >= area[2]) || (area[1] >= area[3]) || (area[2] > (unsigned)width) || (area[3] > (unsigned)height)) {
+				pDecoder->Release(&pDecoder);
+				return nullptr;
+			}
+			pDecoder->WMP.wmiI.cROILeftX = area[0];
+			pDecoder->WMP.wmiI.cROITopY = area[1];
+			pDecoder->WMP.wmiI.cROIWidth = area[2] - area[0];
+			pDecoder->WMP.wmiI.cROIHeight = area[3] - area[1];
+			dst_width = (int)(area[2] - area[0]);
+			dst_height = (int)(area[3] - area[1]);
+		}
+		else if (!header_only && !oriented && (((unsigned)flags >> 16) > 0)) {
+			// lowest resolution at least the size requested by FreeImage_LoadScaled,
+			// thumbnails are decoded down to 1/16 (one line per macroblock row)
+			const unsigned requested_size = (unsigned)flags >> 16;
+			const unsigned longest = (unsigned)MAX(width, height);
+			unsigned scale = 1;
+			while ((scale < 16) && ((longest + 2 * scale - 1) / (2 * scale) >= requested_size)) {
+				scale <<= 1;
+			}
+			if (scale > 1) {
+				size_t thumb_width = (width + scale - 1) / scale;
+				size_t thumb_height = (height + scale - 1) / scale;
+				GetThumbnailSize(width, height, &thumb_width, &thumb_height);
+				pDecoder->WMP.wmiI.cThumbnailWidth = thumb_width;
+				pDecoder->WMP.wmiI.cThumbnailHeight = thumb_height;
+				dst_width = (int)thumb_width;
+				dst_height = (int)thumb_height;
+			}
+		}
+
 		// allocate dst image
-		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeaderT(header_only, image_type, width, height, bpp, red_mask, green_mask, blue_mask), &FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeaderT(header_only, image_type, dst_width, dst_height, bpp, red_mask, green_mask, blue_mask), &FreeImage_Unload);
 		if (!dib) {
 			throw FI_MSG_ERROR_DIB_MEMORY;
 		}
@@ -1185,10 +1367,15 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			return dib.release();
 		}
-		
+
 		// copy pixels into the dib, perform pixel conversion if needed
-		error_code = CopyPixels(pDecoder, guid_format, dib.get(), width, height);
-		JXR_CHECK(error_code);
+		// images with several rows of tiles are decoded by bands of tiles in parallel
+		const FIBOOL tiled = !area && (dst_height == height) && !oriented && (pDecoder->WMP.wmiSCP.cNumOfSliceMinus1H > 0);
+		if (!tiled || !DecodeTileBands(io, handle, pDecoder, guid_format, dib.get(), flags)) {
+			error_code = CopyPixels(pDecoder, guid_format, FreeImage_GetBits(dib.get()), FreeImage_GetPitch(dib.get()), FreeImage_GetLine(dib.get()), dst_width, dst_height);
+			JXR_CHECK(error_code);
+		}
+		FinishPixels(dib.get(), guid_format);
 
 		// free the decoder
 		pDecoder->Release(&pDecoder);
@@ -1198,16 +1385,24 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 	} catch (const char *message) {
 		// free the decoder
-		pDecoder->Release(&pDecoder);
+		if (pDecoder) {
+			pDecoder->Release(&pDecoder);
+		}
 
 		if (message) {
-			FreeImage_OutputMessageProc(s_format_id, message);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(message), message);
 		}
 	}
 
 	return nullptr;
 }
 
+static FIBITMAP * DLL_CALLCONV
+Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+	// get the I/O stream wrapper
+	return Decode(io, handle, (WMPStream*)data, flags, nullptr);
+}
+
 // ==========================================================
 //	Save
 // ==========================================================
@@ -1428,13 +1623,29 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			assert(!pEncoder);
 		}
 		if (message) {
-			FreeImage_OutputMessageProc(s_format_id, message);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(message), message);
 		}
 	}
 
 	return FALSE;
 }
 
+// ==========================================================
+//	 Region loading
+// ==========================================================
+
+FIBITMAP*
+LoadRegionJXR(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags) {
+	auto *pStream = (WMPStream*)Open(io, handle, TRUE);
+	if (!pStream) {
+		return nullptr;
+	}
+	const unsigned area[4] = { left, top, right, bottom };
+	FIBITMAP *dib = Decode(io, handle, pStream, flags, area);
+	Close(io, handle, pStream);
+	return dib;
+}
+
 // ==========================================================
 //	 Init
 // ==========================================================
@@ -1459,6 +1670,7 @@ InitJXR(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
 
 
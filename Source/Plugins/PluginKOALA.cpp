@@ -132,6 +132,16 @@ SupportsExportType(FREE_IMAGE_TYPE type) {
 	return FALSE;
 }
 
+static FIBOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD;
+}
+
 // ----------------------------------------------------------
 
 FIBITMAP * DLL_CALLCONV
@@ -139,26 +149,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	if (handle) {
 		koala_t image;
 
-		// read the load address
-
-		unsigned char load_address[2];  // highbit, lowbit
-
-		io->read_proc(&load_address, 1, 2, handle);
-
-		// if the load address is correct, skip it. otherwise ignore the load address
-
-		if ((load_address[0] != 0x00) || (load_address[1] != 0x60)) {
-			((uint8_t *)&image)[0] = load_address[0];
-			((uint8_t *)&image)[1] = load_address[1];
-
-			io->read_proc((uint8_t *)&image + 2, 1, 10001 - 2, handle);
-		} else {
-			io->read_proc(&image, 1, 10001, handle);
-		}		
+		const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
-		// build DIB in memory
+		// build DIB in memory (the size and the palette are fixed)
 
-		FIBITMAP *dib = FreeImage_Allocate(CBM_WIDTH, CBM_HEIGHT, 4);
+		FIBITMAP *dib = FreeImage_AllocateHeader(header_only, CBM_WIDTH, CBM_HEIGHT, 4);
 
 		if (dib) {
 			// write out the commodore 64 color palette
@@ -171,6 +166,28 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				palette[i].red   = (uint8_t)c64colours[i].r;
 			}
 
+			if (header_only) {
+				// header only mode
+				return dib;
+			}
+
+			// read the load address
+
+			unsigned char load_address[2];  // highbit, lowbit
+
+			io->read_proc(&load_address, 1, 2, handle);
+
+			// if the load address is correct, skip it. otherwise ignore the load address
+
+			if ((load_address[0] != 0x00) || (load_address[1] != 0x60)) {
+				((uint8_t *)&image)[0] = load_address[0];
+				((uint8_t *)&image)[1] = load_address[1];
+
+				io->read_proc((uint8_t *)&image + 2, 1, 10001 - 2, handle);
+			} else {
+				io->read_proc(&image, 1, 10001, handle);
+			}
+
 			// write out bitmap data
 
 			uint8_t pixel_mask[4]         = { 0xc0, 0x30, 0x0c, 0x03 };
@@ -240,4 +257,6 @@ InitKOALA(Plugin *plugin, int format_id) {
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -100,6 +100,11 @@ SupportsNoPixels() {
 	return FALSE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD;
+}
+
 
 // ----------------------------------------------------------
 
@@ -150,4 +155,5 @@ InitMNG(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
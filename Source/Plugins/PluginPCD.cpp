@@ -111,6 +111,11 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD;
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -204,10 +209,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 	}
 	catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 	}
 	catch (const std::bad_alloc &) {
-		FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
 	}
 	return nullptr;
 }
@@ -236,4 +241,5 @@ InitPCD(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -21,6 +21,9 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
+#include "FreeImage/ConversionSIMD.h"
+#include "FreeImage/Plugin.h"
 
 // ==========================================================
 // Internal functions
@@ -29,16 +32,8 @@
 /** maximum size of a line in the header */
 #define PFM_MAXLINE	256
 
-/** Big endian / Little endian float conversion */
-#define REVERSEBYTES(source, dest)		\
-{										\
-	char *j = (char *) source;			\
-	char *dj = (char *) dest;			\
-	dj[0] = j[3];						\
-	dj[1] = j[2];						\
-	dj[2] = j[1];						\
-	dj[3] = j[0];						\
-}
+/** largest read of pixels, reads of bigger images are split */
+#define PFM_MAXREAD	(1U << 30)
 
 /**
 Get a line from a ASCII io stream
@@ -122,6 +117,68 @@ pfm_get_int(FreeImageIO *io, fi_handle handle) {
     return i;
 }
 
+/**
+PFM header
+*/
+struct PFMHeader {
+	FREE_IMAGE_TYPE image_type = FIT_UNKNOWN;	//! FIT_RGBF ("PF") or FIT_FLOAT ("Pf")
+	unsigned width = 0;
+	unsigned height = 0;
+	float scalefactor = 1;						//! positive for big endian pixels, negative for little endian pixels
+};
+
+/**
+Reads the header, the stream is left on the first pixel
+*/
+static void
+pfm_read_header(FreeImageIO *io, fi_handle handle, PFMHeader &header) {
+	char line_buffer[PFM_MAXLINE];
+	char id_one = 0, id_two = 0;
+
+	// Read the first two bytes of the file to determine the file format
+	// "PF" = color image
+	// "Pf" = greyscale image
+
+	io->read_proc(&id_one, 1, 1, handle);
+	io->read_proc(&id_two, 1, 1, handle);
+
+	if (id_one == 'P') {
+		if (id_two == 'F') {
+			header.image_type = FIT_RGBF;
+		} else if (id_two == 'f') {
+			header.image_type = FIT_FLOAT;
+		}
+	}
+	if (header.image_type == FIT_UNKNOWN) {
+		// signature error
+		throw FI_MSG_ERROR_MAGIC_NUMBER;
+	}
+
+	// Read the header information: width, height and the scale value
+	header.width  = (unsigned) pfm_get_int(io, handle);
+	header.height = (unsigned) pfm_get_int(io, handle);
+
+	FIBOOL bResult = pfm_get_line(io, handle, line_buffer, PFM_MAXLINE);
+	if (bResult) {
+		bResult = (sscanf(line_buffer, "%f", &header.scalefactor) == 1) ? TRUE : FALSE;
+	}
+	if (!bResult) {
+		throw "Read error: invalid PFM header";
+	}
+}
+
+/**
+True when the pixels of the file are in the byte order of the machine
+*/
+static bool
+pfm_native_order(const PFMHeader &header) {
+#ifdef FREEIMAGE_BIGENDIAN
+	return header.scalefactor > 0;
+#else
+	return header.scalefactor <= 0;
+#endif
+}
+
 // ==========================================================
 // Plugin Interface
 // ==========================================================
@@ -192,13 +249,15 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	char line_buffer[PFM_MAXLINE];
-	char id_one = 0, id_two = 0;
-
 	if (!handle) {
 		return nullptr;
 	}
@@ -206,42 +265,14 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
 	try {
-		FREE_IMAGE_TYPE image_type = FIT_UNKNOWN;
-
-		// Read the first two bytes of the file to determine the file format
-		// "PF" = color image
-		// "Pf" = greyscale image
-
-		io->read_proc(&id_one, 1, 1, handle);
-		io->read_proc(&id_two, 1, 1, handle);
-
-		if (id_one == 'P') {
-			if (id_two == 'F') {
-				image_type = FIT_RGBF;
-			} else if (id_two == 'f') {
-				image_type = FIT_FLOAT;
-			}
-		}
-		if (image_type == FIT_UNKNOWN) {
-			// signature error
-			throw FI_MSG_ERROR_MAGIC_NUMBER;
-		}
-
-		// Read the header information: width, height and the scale value
-		unsigned width  = (unsigned) pfm_get_int(io, handle);
-		unsigned height = (unsigned) pfm_get_int(io, handle);
-		float scalefactor = 1;
+		PFMHeader header;
+		pfm_read_header(io, handle, header);
 
-		FIBOOL bResult = pfm_get_line(io, handle, line_buffer, PFM_MAXLINE);
-		if (bResult) {
-			bResult = (sscanf(line_buffer, "%f", &scalefactor) == 1) ? TRUE : FALSE;
-		}
-		if (!bResult) {
-			throw "Read error: invalid PFM header";
-		}
+		const unsigned width = header.width;
+		const unsigned height = header.height;
 
 		// Create a new DIB
-		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeaderT(header_only, image_type, width, height), &FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeaderT(header_only, header.image_type, width, height), &FreeImage_Unload);
 		if (!dib) {
 			throw FI_MSG_ERROR_DIB_MEMORY;
 		}
@@ -251,58 +282,44 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			return dib.release();
 		}
 
-		// Read the image...
+		// Read the image at once, float lines need no padding so the file rows fill the pixels buffer
 
-		if (image_type == FIT_RGBF) {
-			const unsigned lineWidth = 3 * width;
-			auto lineBuffer(std::make_unique<float[]>(lineWidth));
+		const unsigned line = FreeImage_GetLine(dib.get());
+		const unsigned pitch = FreeImage_GetPitch(dib.get());
+		assert(line == pitch);
 
-			for (unsigned y = 0; y < height; y++) {	
-				FIRGBF *bits = (FIRGBF*)FreeImage_GetScanLine(dib.get(), height - 1 - y);
-
-				if (io->read_proc(lineBuffer.get(), sizeof(float), lineWidth, handle) != lineWidth) {
-					throw "Read error";
-				}
-				const auto *channel = lineBuffer.get();
-				if (scalefactor > 0) {
-					// MSB
-					for (unsigned x = 0; x < width; x++) {
-						REVERSEBYTES(channel++, &bits[x].red);
-						REVERSEBYTES(channel++, &bits[x].green);
-						REVERSEBYTES(channel++, &bits[x].blue);
-					}
-				} else {
-					// LSB					
-					for (unsigned x = 0; x < width; x++) {
-						bits[x].red		= *channel++;
-						bits[x].green	= *channel++;
-						bits[x].blue	= *channel++;
-					}
-				}
+		uint8_t *bits = FreeImage_GetBits(dib.get());
+		const size_t size = (size_t)pitch * height;
+		for (size_t offset = 0; offset < size; ) {
+			const unsigned count = (unsigned)std::min<size_t>(size - offset, PFM_MAXREAD);
+			if (io->read_proc(bits + offset, 1, count, handle) != count) {
+				throw "Read error";
 			}
-		} else if (image_type == FIT_FLOAT) {
-			const unsigned lineWidth = width;
-			auto lineBuffer(std::make_unique<float[]>(lineWidth));
+			offset += count;
+		}
 
-			for (unsigned y = 0; y < height; y++) {
-				float *bits = (float*)FreeImage_GetScanLine(dib.get(), height - 1 - y);
+		// The first file row is the top of the image: swap rows end for end, converting big endian floats on the way
 
-				if (io->read_proc(lineBuffer.get(), sizeof(float), lineWidth, handle) != lineWidth) {
-					throw "Read error";
-				}
-				auto *channel = static_cast<const float *>(lineBuffer.get());
-				if (scalefactor > 0) {
-					// MSB - File is Big endian
-					for (unsigned x = 0; x < width; x++) {
-						REVERSEBYTES(channel++, &bits[x]);
-					}
+		const bool swap_bytes = !pfm_native_order(header);
+		const unsigned words = line / sizeof(uint32_t);
+
+		ParallelFor(0, height / 2, CalculateBandRows(2 * (size_t)line), [&](unsigned first, unsigned last) {
+			std::vector<uint32_t> buffer(words);
+			for (unsigned y = first; y < last; y++) {
+				auto *top = (uint32_t *)(bits + (size_t)pitch * y);
+				auto *bottom = (uint32_t *)(bits + (size_t)pitch * (height - 1 - y));
+				if (swap_bytes) {
+					SwapBytes32(buffer.data(), top, words);
+					SwapBytes32(top, bottom, words);
+					std::copy(buffer.begin(), buffer.end(), bottom);
 				} else {
-					// LSB - File is Little Endian
-					for (unsigned x = 0; x < width; x++) {
-						bits[x] = *channel++;
-					}
+					std::swap_ranges(top, top + words, bottom);
 				}
 			}
+		});
+		if (swap_bytes && (height & 1)) {
+			auto *middle = (uint32_t *)(bits + (size_t)pitch * (height / 2));
+			SwapBytes32(middle, middle, words);
 		}
 		
 		return dib.release();
@@ -310,11 +327,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	}
 	catch (const char *text)  {
 		if (text) {
-			FreeImage_OutputMessageProc(s_format_id, text);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		}
 	}
 	catch (const std::bad_alloc &) {
-		FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
 	}
 	return nullptr;
 }
@@ -366,6 +383,49 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	return TRUE;
 }
 
+// ----------------------------------------------------------
+
+FIBITMAP*
+LoadMappedPFM(const uint8_t *data, size_t size, std::shared_ptr<const void> owner, int flags) {
+	if ((flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS) {
+		return nullptr;
+	}
+
+	PFMHeader header;
+	size_t offset = 0;
+	FIMEMORY *stream = FreeImage_OpenMemory(const_cast<uint8_t *>(data), (uint32_t)std::min<size_t>(size, UINT32_MAX));
+	if (!stream) {
+		return nullptr;
+	}
+	try {
+		FreeImageIO io;
+		SetMemoryIO(&io);
+		pfm_read_header(&io, (fi_handle)stream, header);
+		offset = (size_t)io.tell_proc((fi_handle)stream);
+	}
+	catch (const char *) {
+		header.image_type = FIT_UNKNOWN;
+	}
+	FreeImage_CloseMemory(stream);
+
+	// swapped, misaligned or truncated pixels are decoded as usual
+	if ((header.image_type == FIT_UNKNOWN) || !pfm_native_order(header) || ((uintptr_t)(data + offset) % sizeof(float))) {
+		return nullptr;
+	}
+	const unsigned bpp = (header.image_type == FIT_RGBF) ? 96 : 32;
+	const size_t pitch = (size_t)header.width * (bpp / 8);
+	if (!pitch || (pitch > INT_MAX) || !header.height || (size - offset) / pitch < header.height) {
+		return nullptr;
+	}
+
+	// file rows are stored from the top of the image, which becomes the first scanline
+	FIBITMAP *dib = FreeImage_AllocateHeaderForSharedBits(data + offset, (unsigned)pitch, std::move(owner), header.image_type, header.width, header.height, bpp);
+	if (dib) {
+		FreeImage_SetOrientation(dib, FIO_FLIP_VERTICAL);
+	}
+	return dib;
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
@@ -390,4 +450,5 @@ InitPFM(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
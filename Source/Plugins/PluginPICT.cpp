@@ -939,6 +939,16 @@ SupportsICCProfiles() {
 	return FALSE;
 }
 
+static FIBOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD;
+}
+
 /**
 This plugin decodes macintosh PICT files with 1,2,4,8,16 and 32 bits per pixel as well as PICT/JPEG. 
 If an alpha channel is present in a 32-bit-PICT, it is decoded as well. 
@@ -948,6 +958,7 @@ These elements are ignored.
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	char outputMessage[ outputMessageSize ] = "";
+	const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 	try {
 		// Skip empty 512 byte header.
 		if ( !io->seek_proc(handle, 512, SEEK_CUR) == 0 )
@@ -1218,9 +1229,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				int height = bounds.bottom - bounds.top;
 				
 				if ( pixMap.pixelSize > 8 ) {
-					dib.reset(FreeImage_Allocate( width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+					dib.reset(FreeImage_AllocateHeader(header_only, width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 				} else {
-					dib.reset(FreeImage_Allocate( width, height, 8));
+					dib.reset(FreeImage_AllocateHeader(header_only, width, height, 8));
 				}
 				hRes = pixMap.hRes << 16;
 				vRes = pixMap.vRes << 16;
@@ -1229,7 +1240,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			case jpeg:
 			{
-				dib.reset(FreeImage_LoadFromHandle( FIF_JPEG, io, handle ));
+				dib.reset(FreeImage_LoadFromHandle( FIF_JPEG, io, handle, header_only ? FIF_LOAD_NOPIXELS : 0 ));
 				break;
 			}
 
@@ -1244,9 +1255,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				int height = bounds.bottom - bounds.top;
 
 				if ( pixMap.pixelSize > 8 ) {
-					dib.reset(FreeImage_Allocate( width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+					dib.reset(FreeImage_AllocateHeader(header_only, width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 				} else {
-					dib.reset(FreeImage_Allocate( width, height, 8));
+					dib.reset(FreeImage_AllocateHeader(header_only, width, height, 8));
 				}
 				hRes = pixMap.hRes << 16;
 				vRes = pixMap.vRes << 16;
@@ -1268,7 +1279,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				width = bounds.right - bounds.left;
 				height = bounds.bottom - bounds.top;
 
-				dib.reset(FreeImage_Allocate(width, height, 8));
+				dib.reset(FreeImage_AllocateHeader(header_only, width, height, 8));
 				break;
 			}
 		}
@@ -1282,6 +1293,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			FreeImage_SetDotsPerMeterX( dib.get(), (int32_t)hres_ppm );
 			FreeImage_SetDotsPerMeterY( dib.get(), (int32_t)vres_ppm );
 
+			if ( header_only ) {
+				// header only mode
+				return dib.release();
+			}
+
 			switch (pictType) {
 				case op9a:
 					DecodeOp9a( io, handle, dib.get(), &pixMap );
@@ -1303,7 +1319,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		return dib.release();
 	}
 	catch(const char *message) {
-		FreeImage_OutputMessageProc(s_format_id, message);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(message), message);
 	}
 
 	return nullptr;
@@ -1332,4 +1348,6 @@ InitPICT(Plugin *plugin, int format_id) {
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -31,6 +31,7 @@
 #include "Utilities.h"
 
 #include "../Metadata/FreeImageTag.h"
+#include "FreeImage/Plugin.h"
 
 // ----------------------------------------------------------
 
@@ -304,8 +305,34 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // --------------------------------------------------------------------------
 
+/**
+Turn off the integrity checks of trusted input (PNG_FAST_TRUSTED): the CRC of all chunks, 
+the Adler-32 of the image data and the sRGB profile check. Unknown chunks are dropped. 
+@param png_ptr PNG handle
+@param flags Decoder flags
+*/
+static void 
+ConfigureTrustedInput(png_structp png_ptr, int flags) {
+	if ((flags & PNG_FAST_TRUSTED) != PNG_FAST_TRUSTED) {
+		return;
+	}
+	png_set_crc_action(png_ptr, PNG_CRC_QUIET_USE, PNG_CRC_QUIET_USE);
+#ifdef PNG_IGNORE_ADLER32
+	png_set_option(png_ptr, PNG_IGNORE_ADLER32, PNG_OPTION_ON);
+#endif
+	png_set_option(png_ptr, PNG_SKIP_sRGB_CHECK_PROFILE, PNG_OPTION_ON);
+#ifdef PNG_HANDLE_AS_UNKNOWN_SUPPORTED
+	png_set_keep_unknown_chunks(png_ptr, PNG_HANDLE_CHUNK_NEVER, nullptr, 0);
+#endif
+}
+
 /**
 Configure the decoder so that decoded pixels are compatible with a FREE_IMAGE_TYPE format. 
 Set conversion instructions as needed. 
@@ -485,6 +512,10 @@ ConfigureDecoder(png_structp png_ptr, png_infop info_ptr, int flags, FREE_IMAGE_
 		}
 	}
 
+	// interlaced images are expanded by libpng, row by row in each pass
+
+	png_set_interlace_handling(png_ptr);
+
 	// all transformations have been registered; now update info_ptr data		
 	png_read_update_info(png_ptr, info_ptr);
 
@@ -494,13 +525,185 @@ ConfigureDecoder(png_structp png_ptr, png_infop info_ptr, int flags, FREE_IMAGE_
 	return TRUE;
 }
 
-static FIBITMAP * DLL_CALLCONV
-Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+/**
+Reads the PNG header following the signature and configures the decoder.
+Must be called with the libpng error jump set.
+@return Returns the header bitmap, with pixels unless header_only is set
+*/
+static FIBITMAP *
+ReadHeader(png_structp png_ptr, png_infop info_ptr, int flags, FIBOOL header_only) {
 	png_uint_32 width, height;
 	int color_type;
 	int bit_depth;
 	int pixel_depth = 0;	// pixel_depth = bit_depth * channels
 
+	// read the IHDR chunk
+
+	png_read_info(png_ptr, info_ptr);
+	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, nullptr, nullptr, nullptr);
+
+	// configure the decoder
+
+	FREE_IMAGE_TYPE image_type = FIT_BITMAP;
+
+	if (!ConfigureDecoder(png_ptr, info_ptr, flags, &image_type)) {
+		throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
+	}
+
+	// update image info
+
+	color_type = png_get_color_type(png_ptr, info_ptr);
+	bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+	pixel_depth = bit_depth * png_get_channels(png_ptr, info_ptr);
+
+	// create a dib and write the bitmap header
+	// set up the dib palette, if needed
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
+	switch (color_type) {
+		case PNG_COLOR_TYPE_RGB:
+		case PNG_COLOR_TYPE_RGB_ALPHA:
+			dib.reset(FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+			break;
+
+		case PNG_COLOR_TYPE_PALETTE:
+			dib.reset(FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+			if (dib) {
+				png_colorp png_palette{};
+				int palette_entries = 0;
+
+				png_get_PLTE(png_ptr,info_ptr, &png_palette, &palette_entries);
+
+				palette_entries = MIN((unsigned)palette_entries, FreeImage_GetColorsUsed(dib.get()));
+
+				// store the palette
+
+				FIRGBA8 *palette = FreeImage_GetPalette(dib.get());
+				for (int i = 0; i < palette_entries; i++) {
+					palette[i].red   = png_palette[i].red;
+					palette[i].green = png_palette[i].green;
+					palette[i].blue  = png_palette[i].blue;
+				}
+			}
+			break;
+
+		case PNG_COLOR_TYPE_GRAY:
+			dib.reset(FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+
+			if (dib && (pixel_depth <= 8)) {
+				FIRGBA8 *palette = FreeImage_GetPalette(dib.get());
+				const int palette_entries = 1 << pixel_depth;
+
+				for (int i = 0; i < palette_entries; i++) {
+					palette[i].red   =
+					palette[i].green =
+					palette[i].blue  = (uint8_t)((i * 255) / (palette_entries - 1));
+				}
+			}
+			break;
+
+		default:
+			throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
+	}
+
+	if (!dib) {
+		throw FI_MSG_ERROR_DIB_MEMORY;
+	}
+
+	// store the transparency table
+
+	if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
+		// array of alpha (transparency) entries for palette
+		png_bytep trans_alpha = nullptr;
+		// number of transparent entries
+		int num_trans = 0;
+		// graylevel or color sample values of the single transparent color for non-paletted images
+		png_color_16p trans_color = nullptr;
+
+		png_get_tRNS(png_ptr, info_ptr, &trans_alpha, &num_trans, &trans_color);
+
+		if ((color_type == PNG_COLOR_TYPE_GRAY) && trans_color) {
+			// single transparent color
+			if (trans_color->gray < 256) { 
+				uint8_t table[256]; 
+				memset(table, 0xFF, 256); 
+				table[trans_color->gray] = 0; 
+				FreeImage_SetTransparencyTable(dib.get(), table, 256); 
+			}
+			// check for a full transparency table, too
+			else if ((trans_alpha) && (pixel_depth <= 8)) {
+				FreeImage_SetTransparencyTable(dib.get(), (uint8_t *)trans_alpha, num_trans);
+			}
+
+		} else if ((color_type == PNG_COLOR_TYPE_PALETTE) && trans_alpha) {
+			// transparency table
+			FreeImage_SetTransparencyTable(dib.get(), (uint8_t *)trans_alpha, num_trans);
+		}
+	}
+
+	// store the background color (only supported for FIT_BITMAP types)
+
+	if ((image_type == FIT_BITMAP) && png_get_valid(png_ptr, info_ptr, PNG_INFO_bKGD)) {
+		// Get the background color to draw transparent and alpha images over.
+		// Note that even if the PNG file supplies a background, you are not required to
+		// use it - you should use the (solid) application background if it has one.
+
+		png_color_16p image_background = nullptr;
+		FIRGBA8 rgbBkColor;
+
+		if (png_get_bKGD(png_ptr, info_ptr, &image_background)) {
+			rgbBkColor.red      = (uint8_t)image_background->red;
+			rgbBkColor.green    = (uint8_t)image_background->green;
+			rgbBkColor.blue     = (uint8_t)image_background->blue;
+			rgbBkColor.alpha = 0;
+
+			FreeImage_SetBackgroundColor(dib.get(), &rgbBkColor);
+		}
+	}
+
+	// get physical resolution
+
+	if (png_get_valid(png_ptr, info_ptr, PNG_INFO_pHYs)) {
+		png_uint_32 res_x, res_y;
+		
+		// we'll overload this var and use 0 to mean no phys data,
+		// since if it's not in meters we can't use it anyway
+
+		int res_unit_type = PNG_RESOLUTION_UNKNOWN;
+
+		png_get_pHYs(png_ptr,info_ptr, &res_x, &res_y, &res_unit_type);
+
+		if (res_unit_type == PNG_RESOLUTION_METER) {
+			FreeImage_SetDotsPerMeterX(dib.get(), res_x);
+			FreeImage_SetDotsPerMeterY(dib.get(), res_y);
+		}
+	}
+
+	// get possible ICC profile
+
+	if (png_get_valid(png_ptr, info_ptr, PNG_INFO_iCCP)) {
+		png_charp profile_name = nullptr;
+		png_bytep profile_data = nullptr;
+		png_uint_32 profile_length = 0;
+		int  compression_type;
+
+		png_get_iCCP(png_ptr, info_ptr, &profile_name, &compression_type, &profile_data, &profile_length);
+
+		// copy ICC profile data (must be done after FreeImage_AllocateHeader)
+
+		FreeImage_CreateICCProfile(dib.get(), profile_data, profile_length);
+	}
+
+	// check if the bitmap contains transparency, if so enable it in the header
+
+	if (FreeImage_GetBPP(dib.get()) == 32) {
+		FreeImage_SetTransparent(dib.get(), FIC_RGBALPHA == FreeImage_GetColorType(dib.get()));
+	}
+
+	return dib.release();
+}
+
+static FIBITMAP * DLL_CALLCONV
+Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
     fi_ioStructure fio;
     fio.s_handle = handle;
 	fio.s_io = io;
@@ -538,6 +741,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			// init the IO
 
 			png_set_read_fn(png_ptr.get(), &fio, _ReadProc);
+			ConfigureTrustedInput(png_ptr.get(), flags);
 			
 			// PNG errors will be redirected here
 
@@ -550,219 +754,380 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			png_set_sig_bytes(png_ptr.get(), PNG_BYTES_TO_CHECK);
 
-			// read the IHDR chunk
-
-			png_read_info(png_ptr.get(), info_ptr.get());
-			png_get_IHDR(png_ptr.get(), info_ptr.get(), &width, &height, &bit_depth, &color_type, nullptr, nullptr, nullptr);
+			// read the IHDR chunk and create the dib
 
-			// configure the decoder
+			std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(ReadHeader(png_ptr.get(), info_ptr.get(), flags, header_only), &FreeImage_Unload);
+			const unsigned height = FreeImage_GetHeight(dib.get());
 
-			FREE_IMAGE_TYPE image_type = FIT_BITMAP;
+			// --- header only mode => clean-up and return
 
-			if (!ConfigureDecoder(png_ptr.get(), info_ptr.get(), flags, &image_type)) {
-				throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
+			if (header_only) {
+				// get possible metadata (it can be located both before and after the image data)
+				if ((flags & FIF_LOAD_NOMETADATA) != FIF_LOAD_NOMETADATA) {
+					ReadMetadata(png_ptr.get(), info_ptr.get(), dib.get());
+				}
+				return dib.release();
 			}
 
-			// update image info
-
-			color_type = png_get_color_type(png_ptr.get(), info_ptr.get());
-			bit_depth = png_get_bit_depth(png_ptr.get(), info_ptr.get());
-			pixel_depth = bit_depth * png_get_channels(png_ptr.get(), info_ptr.get());
+			// allow loading of PNG with minor errors (such as images with several IDAT chunks)
 
-			// create a dib and write the bitmap header
-			// set up the dib palette, if needed
-			std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
-			switch (color_type) {
-				case PNG_COLOR_TYPE_RGB:
-				case PNG_COLOR_TYPE_RGB_ALPHA:
-					dib.reset(FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
-					break;
+			png_set_benign_errors(png_ptr.get(), 1);
 
-				case PNG_COLOR_TYPE_PALETTE:
-					dib.reset(FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
-					if (dib) {
-						png_colorp png_palette{};
-						int palette_entries = 0;
+			if (png_get_interlace_type(png_ptr.get(), info_ptr.get()) == PNG_INTERLACE_NONE) {
+				// decode row by row straight into the dib, reporting completed rows by groups
 
-						png_get_PLTE(png_ptr.get(),info_ptr.get(), &png_palette, &palette_entries);
+				const unsigned report_rows = 16;
+				for (png_uint_32 k = 0; k < height; k++) {
+					png_read_row(png_ptr.get(), FreeImage_GetScanLine(dib.get(), height - 1 - k), nullptr);
+					if (((k + 1) % report_rows == 0) || (k + 1 == height)) {
+						const unsigned first = k - k % report_rows;
+						NotifyRowsDecoded(dib.get(), first, k + 1 - first);
+					}
+				}
+			} else if (ReportsPasses()) {
+				// Adam7 passes reported as they complete, their pixels fill the blocks still missing ("rectangle" display)
+				// until the last pass gives the final image
 
-						palette_entries = MIN((unsigned)palette_entries, FreeImage_GetColorsUsed(dib.get()));
+				for (unsigned pass = 0; pass < PNG_INTERLACE_ADAM7_PASSES; pass++) {
+					for (png_uint_32 k = 0; k < height; k++) {
+						png_read_row(png_ptr.get(), nullptr, FreeImage_GetScanLine(dib.get(), height - 1 - k));
+					}
+					if (pass + 1 < PNG_INTERLACE_ADAM7_PASSES) {
+						NotifyPassDecoded(dib.get(), pass, PNG_INTERLACE_ADAM7_PASSES);
+					}
+				}
+			} else {
+				// interlaced rows are completed by the last pass: read in the bitmap bits via the pointer table
 
-						// store the palette
+				std::unique_ptr<void, decltype(&free)> safeRowPointers(malloc(height * sizeof(png_bytep)), &free);
+				if (!safeRowPointers) {
+					return nullptr;
+				}
+				auto **row_pointers = static_cast<png_bytepp>(safeRowPointers.get());
 
-						FIRGBA8 *palette = FreeImage_GetPalette(dib.get());
-						for (int i = 0; i < palette_entries; i++) {
-							palette[i].red   = png_palette[i].red;
-							palette[i].green = png_palette[i].green;
-							palette[i].blue  = png_palette[i].blue;
-						}
-					}
-					break;
+				for (png_uint_32 k = 0; k < height; k++) {
+					row_pointers[height - 1 - k] = FreeImage_GetScanLine(dib.get(), k);
+				}
 
-				case PNG_COLOR_TYPE_GRAY:
-					dib.reset(FreeImage_AllocateHeaderT(header_only, image_type, width, height, pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+				png_read_image(png_ptr.get(), row_pointers);
+			}
 
-					if (dib && (pixel_depth <= 8)) {
-						FIRGBA8 *palette = FreeImage_GetPalette(dib.get());
-						const int palette_entries = 1 << pixel_depth;
+			// read the rest of the file, getting any additional chunks in info_ptr
 
-						for (int i = 0; i < palette_entries; i++) {
-							palette[i].red   =
-							palette[i].green =
-							palette[i].blue  = (uint8_t)((i * 255) / (palette_entries - 1));
-						}
-					}
-					break;
+			png_read_end(png_ptr.get(), info_ptr.get());
 
-				default:
-					throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
-			}
+			// get possible metadata (it can be located both before and after the image data)
 
-			if (!dib) {
-				throw FI_MSG_ERROR_DIB_MEMORY;
+			if ((flags & FIF_LOAD_NOMETADATA) != FIF_LOAD_NOMETADATA) {
+				ReadMetadata(png_ptr.get(), info_ptr.get(), dib.get());
 			}
 
-			// store the transparency table
-
-			if (png_get_valid(png_ptr.get(), info_ptr.get(), PNG_INFO_tRNS)) {
-				// array of alpha (transparency) entries for palette
-				png_bytep trans_alpha = nullptr;
-				// number of transparent entries
-				int num_trans = 0;
-				// graylevel or color sample values of the single transparent color for non-paletted images
-				png_color_16p trans_color = nullptr;
-
-				png_get_tRNS(png_ptr.get(), info_ptr.get(), &trans_alpha, &num_trans, &trans_color);
-
-				if ((color_type == PNG_COLOR_TYPE_GRAY) && trans_color) {
-					// single transparent color
-					if (trans_color->gray < 256) { 
-						uint8_t table[256]; 
-						memset(table, 0xFF, 256); 
-						table[trans_color->gray] = 0; 
-						FreeImage_SetTransparencyTable(dib.get(), table, 256); 
-					}
-					// check for a full transparency table, too
-					else if ((trans_alpha) && (pixel_depth <= 8)) {
-						FreeImage_SetTransparencyTable(dib.get(), (uint8_t *)trans_alpha, num_trans);
-					}
+			return dib.release();
 
-				} else if ((color_type == PNG_COLOR_TYPE_PALETTE) && trans_alpha) {
-					// transparency table
-					FreeImage_SetTransparencyTable(dib.get(), (uint8_t *)trans_alpha, num_trans);
-				}
+		} catch (const char *text) {
+			if (text) {
+				FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 			}
+			
+			return nullptr;
+		}
+	}
 
-			// store the background color (only supported for FIT_BITMAP types)
+	return nullptr;
+}
 
-			if ((image_type == FIT_BITMAP) && png_get_valid(png_ptr.get(), info_ptr.get(), PNG_INFO_bKGD)) {
-				// Get the background color to draw transparent and alpha images over.
-				// Note that even if the PNG file supplies a background, you are not required to
-				// use it - you should use the (solid) application background if it has one.
+// ==========================================================
+//   Scanline decoder
+// ==========================================================
 
-				png_color_16p image_background = nullptr;
-				FIRGBA8 rgbBkColor;
+namespace {
+
+	class PNGScanlineDecoder : public ScanlineDecoder
+	{
+	public:
+		PNGScanlineDecoder(FIBITMAP *info, std::unique_ptr<fi_ioStructure> fio, png_structp png_ptr, png_infop info_ptr)
+			: ScanlineDecoder(info), mIO(std::move(fio)), mPng(png_ptr), mInfoPtr(info_ptr)
+		{ }
 
-				if (png_get_bKGD(png_ptr.get(), info_ptr.get(), &image_background)) {
-					rgbBkColor.red      = (uint8_t)image_background->red;
-					rgbBkColor.green    = (uint8_t)image_background->green;
-					rgbBkColor.blue     = (uint8_t)image_background->blue;
-					rgbBkColor.alpha = 0;
+		~PNGScanlineDecoder() override {
+			png_destroy_read_struct(&mPng, &mInfoPtr, nullptr);
+		}
 
-					FreeImage_SetBackgroundColor(dib.get(), &rgbBkColor);
+		unsigned Read(uint8_t *buffer, unsigned count, unsigned pitch) override {
+			const unsigned height = FreeImage_GetHeight(GetInfo());
+			const unsigned first = mRow;
+			try {
+				if (setjmp(png_jmpbuf(mPng))) {
+					throw((const char*)nullptr);
+				}
+				while (!mFailed && (mRow < height) && (mRow - first < count)) {
+					png_read_row(mPng, buffer + (size_t)(mRow - first) * pitch, nullptr);
+					++mRow;
 				}
 			}
-
-			// get physical resolution
-
-			if (png_get_valid(png_ptr.get(), info_ptr.get(), PNG_INFO_pHYs)) {
-				png_uint_32 res_x, res_y;
-				
-				// we'll overload this var and use 0 to mean no phys data,
-				// since if it's not in meters we can't use it anyway
-
-				int res_unit_type = PNG_RESOLUTION_UNKNOWN;
-
-				png_get_pHYs(png_ptr.get(),info_ptr.get(), &res_x, &res_y, &res_unit_type);
-
-				if (res_unit_type == PNG_RESOLUTION_METER) {
-					FreeImage_SetDotsPerMeterX(dib.get(), res_x);
-					FreeImage_SetDotsPerMeterY(dib.get(), res_y);
+			catch (const char *text) {
+				if (text) {
+					FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 				}
+				mFailed = true;
 			}
+			return mRow - first;
+		}
 
-			// get possible ICC profile
+	private:
+		std::unique_ptr<fi_ioStructure> mIO;
+		png_structp mPng;
+		png_infop mInfoPtr;
+		unsigned mRow{ 0 };
+		bool mFailed{ false };
+	};
 
-			if (png_get_valid(png_ptr.get(), info_ptr.get(), PNG_INFO_iCCP)) {
-				png_charp profile_name = nullptr;
-				png_bytep profile_data = nullptr;
-				png_uint_32 profile_length = 0;
-				int  compression_type;
+} // namespace
 
-				png_get_iCCP(png_ptr.get(), info_ptr.get(), &profile_name, &compression_type, &profile_data, &profile_length);
+std::unique_ptr<ScanlineDecoder>
+CreateScanlineDecoderPNG(FreeImageIO *io, fi_handle handle, int flags) {
+	auto fio = std::make_unique<fi_ioStructure>();
+	fio->s_io = io;
+	fio->s_handle = handle;
 
-				// copy ICC profile data (must be done after FreeImage_AllocateHeader)
+	try {
+		uint8_t png_check[PNG_BYTES_TO_CHECK];
 
-				FreeImage_CreateICCProfile(dib.get(), profile_data, profile_length);
-			}
+		io->read_proc(png_check, PNG_BYTES_TO_CHECK, 1, handle);
 
-			// --- header only mode => clean-up and return
+		if (png_sig_cmp(png_check, (png_size_t)0, PNG_BYTES_TO_CHECK) != 0) {
+			return nullptr;
+		}
 
-			if (header_only) {
-				// get possible metadata (it can be located both before and after the image data)
-				ReadMetadata(png_ptr.get(), info_ptr.get(), dib.get());
-				return dib.release();
-			}
+		std::unique_ptr<png_struct, std::function<void(png_structp)>> png_ptr(png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, error_handler, warning_handler), [](png_structp v){ png_destroy_read_struct(&v, nullptr, nullptr); });
+		if (!png_ptr) {
+			return nullptr;
+		}
+		std::unique_ptr<png_info, std::function<void(png_infop)>> info_ptr(png_create_info_struct(png_ptr.get()), [&png_ptr](png_infop v){ png_destroy_info_struct(png_ptr.get(), &v); });
+		if (!info_ptr) {
+			return nullptr;
+		}
 
-			// set the individual row_pointers to point at the correct offsets
+		png_set_read_fn(png_ptr.get(), fio.get(), _ReadProc);
+		ConfigureTrustedInput(png_ptr.get(), flags);
 
-			std::unique_ptr<void, decltype(&free)> safeRowPointers(malloc(height * sizeof(png_bytep)), &free);
-			if (!safeRowPointers) {
-				return nullptr;
-			}
-			auto **row_pointers = static_cast<png_bytepp>(safeRowPointers.get());
+		if (setjmp(png_jmpbuf(png_ptr.get()))) {
+			throw((const char*)nullptr);
+		}
 
-			// read in the bitmap bits via the pointer table
-			// allow loading of PNG with minor errors (such as images with several IDAT chunks)
+		png_set_sig_bytes(png_ptr.get(), PNG_BYTES_TO_CHECK);
 
-			for (png_uint_32 k = 0; k < height; k++) {
-				row_pointers[height - 1 - k] = FreeImage_GetScanLine(dib.get(), k);
-			}
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> info(ReadHeader(png_ptr.get(), info_ptr.get(), flags, TRUE), &FreeImage_Unload);
 
-			png_set_benign_errors(png_ptr.get(), 1);
-			png_read_image(png_ptr.get(), row_pointers);
+		// interlaced rows come in several passes
+		if (png_get_interlace_type(png_ptr.get(), info_ptr.get()) != PNG_INTERLACE_NONE) {
+			return nullptr;
+		}
 
-			// check if the bitmap contains transparency, if so enable it in the header
+		if ((flags & FIF_LOAD_NOMETADATA) != FIF_LOAD_NOMETADATA) {
+			ReadMetadata(png_ptr.get(), info_ptr.get(), info.get());
+		}
+		png_set_benign_errors(png_ptr.get(), 1);
 
-			if (FreeImage_GetBPP(dib.get()) == 32) {
-				FreeImage_SetTransparent(dib.get(), FIC_RGBALPHA == FreeImage_GetColorType(dib.get()));
-			}
+		auto decoder = std::make_unique<PNGScanlineDecoder>(info.get(), std::move(fio), png_ptr.get(), info_ptr.get());
+		info.release();
+		info_ptr.release();
+		png_ptr.release();
+		return decoder;
+	}
+	catch (const char *text) {
+		if (text) {
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
+		}
+	}
+	return nullptr;
+}
 
-			// cleanup
+// ==========================================================
+// Parallel IDAT compression
+// ==========================================================
 
-			safeRowPointers.reset();
-			row_pointers = nullptr;
+/**
+One band of rows, filtered and deflated independently of the others
+*/
+struct DeflatedBand {
+	std::vector<uint8_t> data;	// raw deflate blocks, ended by a sync flush (or the final block)
+	uLong adler;				// Adler-32 of the filtered rows
+	uLong length;				// size of the filtered rows
+};
+
+static inline unsigned
+FilterCost(const uint8_t *filtered, size_t length) {
+	// sum of the absolute values of the filtered bytes seen as signed (the libpng heuristic)
+	unsigned sum = 0;
+	for (size_t i = 0; i < length; i++) {
+		sum += (filtered[i] < 128) ? filtered[i] : 256 - filtered[i];
+	}
+	return sum;
+}
 
-			// read the rest of the file, getting any additional chunks in info_ptr
+static inline uint8_t
+PaethPredictor(int a, int b, int c) {
+	const int p = a + b - c;
+	const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if ((pa <= pb) && (pa <= pc)) {
+		return (uint8_t)a;
+	}
+	return (uint8_t)((pb <= pc) ? b : c);
+}
 
-			png_read_end(png_ptr.get(), info_ptr.get());
+/**
+Writes the filter type byte and the filtered row to out, choosing among the filters of the
+PNG_FILTER_xxx mask. prev is a row of zeros for the first row of the image.
+*/
+static void
+FilterRow(const uint8_t *row, const uint8_t *prev, size_t rowbytes, unsigned bytespp, int filters, uint8_t *out, uint8_t *candidate) {
+	unsigned best_cost = UINT_MAX;
 
-			// get possible metadata (it can be located both before and after the image data)
+	for (int type = PNG_FILTER_VALUE_NONE; type < PNG_FILTER_VALUE_LAST; type++) {
+		if (((filters >> (type + 3)) & 1) == 0) {
+			continue;
+		}
+		uint8_t *dst = candidate + 1;
+		const size_t left = std::min<size_t>(bytespp, rowbytes);
+		switch (type) {
+			case PNG_FILTER_VALUE_SUB:
+				memcpy(dst, row, left);
+				for (size_t i = left; i < rowbytes; i++) {
+					dst[i] = (uint8_t)(row[i] - row[i - bytespp]);
+				}
+				break;
+			case PNG_FILTER_VALUE_UP:
+				for (size_t i = 0; i < rowbytes; i++) {
+					dst[i] = (uint8_t)(row[i] - prev[i]);
+				}
+				break;
+			case PNG_FILTER_VALUE_AVG:
+				for (size_t i = 0; i < left; i++) {
+					dst[i] = (uint8_t)(row[i] - (prev[i] >> 1));
+				}
+				for (size_t i = left; i < rowbytes; i++) {
+					dst[i] = (uint8_t)(row[i] - ((row[i - bytespp] + prev[i]) >> 1));
+				}
+				break;
+			case PNG_FILTER_VALUE_PAETH:
+				for (size_t i = 0; i < left; i++) {
+					dst[i] = (uint8_t)(row[i] - prev[i]);
+				}
+				for (size_t i = left; i < rowbytes; i++) {
+					dst[i] = (uint8_t)(row[i] - PaethPredictor(row[i - bytespp], prev[i], prev[i - bytespp]));
+				}
+				break;
+			default:
+				memcpy(dst, row, rowbytes);
+				break;
+		}
+		const unsigned cost = FilterCost(dst, rowbytes);
+		if (cost < best_cost) {
+			best_cost = cost;
+			candidate[0] = (uint8_t)type;
+			std::swap_ranges(candidate, candidate + rowbytes + 1, out);
+		}
+	}
+}
 
-			ReadMetadata(png_ptr.get(), info_ptr.get(), dib.get());
+/**
+Filters and deflates the rows in bands on the library thread pool, in the style of pigz.
+Each band is a raw deflate stream primed with the last 32 KB of filtered data before it, so
+that behind a zlib header and up to a sync flush the bands join into one zlib stream.
+get_row(y, raw) writes the row y (from the top) as libpng would get it.
+*/
+static std::vector<DeflatedBand>
+DeflateBands(unsigned height, size_t rowbytes, unsigned bytespp, int filters, int level, int strategy, const std::function<void(unsigned, uint8_t*)>& get_row) {
+	constexpr size_t band_bytes = 256 * 1024;
+	constexpr size_t window_bytes = 32 * 1024;
+	const size_t line = rowbytes + 1;
+	const unsigned band_rows = (unsigned)std::max<size_t>(1, band_bytes / line);
+	const unsigned band_count = (height + band_rows - 1) / band_rows;
+
+	std::vector<DeflatedBand> bands(band_count);
+	ParallelFor(0, band_count, 1, [&](unsigned first_band, unsigned last_band) {
+		std::vector<uint8_t> raw(rowbytes), prev(rowbytes), candidate(line);
+		const std::vector<uint8_t> zeros(rowbytes, 0);
+
+		for (unsigned b = first_band; b < last_band; b++) {
+			const unsigned first = b * band_rows;
+			const unsigned last = std::min(height, first + band_rows);
+			// rows of the previous band primed in the dictionary are filtered again
+			const unsigned dict_rows = std::min<unsigned>(first, (unsigned)((window_bytes + line - 1) / line));
+			const unsigned start = first - dict_rows;
+
+			std::vector<uint8_t> filtered((size_t)(last - start) * line);
+			if (start > 0) {
+				get_row(start - 1, prev.data());
+			}
+			for (unsigned y = start; y < last; y++) {
+				get_row(y, raw.data());
+				FilterRow(raw.data(), (y > 0) ? prev.data() : zeros.data(), rowbytes, bytespp, filters, filtered.data() + (size_t)(y - start) * line, candidate.data());
+				std::swap(raw, prev);
+			}
+			const uint8_t *rows = filtered.data() + (size_t)dict_rows * line;
+			const size_t length = (size_t)(last - first) * line;
 
-			return dib.release();
+			z_stream zs = {};
+			if (deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8, strategy) != Z_OK) {
+				throw "Failed to initialize the PNG compressor";
+			}
+			if (dict_rows) {
+				const size_t dict_length = std::min(window_bytes, (size_t)dict_rows * line);
+				deflateSetDictionary(&zs, rows - dict_length, (uInt)dict_length);
+			}
 
-		} catch (const char *text) {
-			if (text) {
-				FreeImage_OutputMessageProc(s_format_id, text);
+			DeflatedBand& band = bands[b];
+			band.data.resize(deflateBound(&zs, (uLong)length) + 16);
+			zs.next_in = const_cast<Bytef*>(rows);
+			zs.avail_in = (uInt)length;
+			zs.next_out = band.data.data();
+			zs.avail_out = (uInt)band.data.size();
+			const int flush = (last == height) ? Z_FINISH : Z_SYNC_FLUSH;
+			const int result = deflate(&zs, flush);
+			const bool complete = (flush == Z_FINISH) ? (result == Z_STREAM_END) : ((result == Z_OK) && (zs.avail_in == 0) && (zs.avail_out > 0));
+			band.data.resize(zs.total_out);
+			deflateEnd(&zs);
+			if (!complete) {
+				throw "Failed to compress the PNG image data";
 			}
-			
-			return nullptr;
+			band.adler = adler32(1L, rows, (uInt)length);
+			band.length = (uLong)length;
 		}
-	}
+	});
+	return bands;
+}
 
-	return nullptr;
+/**
+Writes the bands as IDAT chunks, the first one starting with the zlib header and the last one ending with the Adler-32
+*/
+static void
+WriteBands(png_structp png_ptr, const std::vector<DeflatedBand>& bands, int level) {
+	const uint8_t cmf = 0x78;	// deflate, 32 KB window
+	const uint8_t flevel = (level < 2) ? 0 : (level < 6) ? 1 : (level == 6) ? 2 : 3;
+	uint8_t header[2] = { cmf, (uint8_t)(flevel << 6) };
+	header[1] = (uint8_t)(header[1] + 31 - ((cmf * 256 + header[1]) % 31));
+
+	uLong adler = adler32(0L, nullptr, 0);
+	for (const DeflatedBand& band : bands) {
+		adler = adler32_combine(adler, band.adler, (z_off_t)band.length);
+	}
+	const uint8_t trailer[4] = { (uint8_t)(adler >> 24), (uint8_t)(adler >> 16), (uint8_t)(adler >> 8), (uint8_t)adler };
+
+	for (size_t i = 0; i < bands.size(); i++) {
+		const bool first = (i == 0), last = (i + 1 == bands.size());
+		const size_t length = bands[i].data.size() + (first ? sizeof(header) : 0) + (last ? sizeof(trailer) : 0);
+		png_write_chunk_start(png_ptr, (png_const_bytep)"IDAT", (png_uint_32)length);
+		if (first) {
+			png_write_chunk_data(png_ptr, header, sizeof(header));
+		}
+		png_write_chunk_data(png_ptr, bands[i].data.data(), bands[i].data.size());
+		if (last) {
+			png_write_chunk_data(png_ptr, trailer, sizeof(trailer));
+		}
+		png_write_chunk_end(png_ptr);
+	}
 }
 
 // --------------------------------------------------------------------------
@@ -841,20 +1206,33 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 				interlace_type = PNG_INTERLACE_NONE;
 			}
 
-			// set the ZLIB compression level or default to PNG default compression level (ZLIB level = 6)
+			// set the ZLIB compression level or default to the level of FreeImage_SetZLibOptions,
+			// then to PNG default compression level (ZLIB level = 6)
+			int option_level = -1;
+			FREE_IMAGE_ZSTRATEGY option_strategy = FIZS_FORMAT_DEFAULT;
+			FreeImage_GetZLibOptions(FIF_PNG, &option_level, &option_strategy);
+
 			int zlib_level = flags & 0x0F;
 			if ((zlib_level >= 1) && (zlib_level <= 9)) {
 				png_set_compression_level(png_ptr.get(), zlib_level);
 			} else if ((flags & PNG_Z_NO_COMPRESSION) == PNG_Z_NO_COMPRESSION) {
+				zlib_level = Z_NO_COMPRESSION;
 				png_set_compression_level(png_ptr.get(), Z_NO_COMPRESSION);
+			} else if (option_level >= 0) {
+				zlib_level = option_level;
+				png_set_compression_level(png_ptr.get(), option_level);
+			} else {
+				zlib_level = 6;
 			}
 
 			// filtered strategy works better for high color images
-			if (pixel_depth >= 16){
-				png_set_compression_strategy(png_ptr.get(), Z_FILTERED);
+			int zlib_strategy = (pixel_depth >= 16) ? Z_FILTERED : Z_DEFAULT_STRATEGY;
+			if (option_strategy != FIZS_FORMAT_DEFAULT) {
+				zlib_strategy = option_strategy;
+			}
+			png_set_compression_strategy(png_ptr.get(), zlib_strategy);
+			if (pixel_depth >= 16) {
 				png_set_filter(png_ptr.get(), 0, PNG_FILTER_NONE|PNG_FILTER_SUB|PNG_FILTER_PAETH);
-			} else {
-				png_set_compression_strategy(png_ptr.get(), Z_DEFAULT_STRATEGY);
 			}
 
 			FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
@@ -925,7 +1303,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 #if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
 					// flip BGR pixels to RGB
 					if (image_type == FIT_BITMAP) {
-						png_set_bgr(png_ptr);
+						png_set_bgr(png_ptr.get());
 					}
 #endif
 					break;
@@ -992,42 +1370,91 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 			// write out the image data
 
+			if (((flags & PNG_PARALLEL) == PNG_PARALLEL) && !bInterlaced) {
+				// the rows libpng would get after its transformations
+				const int png_pixel_depth = ((pixel_depth == 32) && !has_alpha_channel) ? 24 : pixel_depth;
+				const size_t rowbytes = ((size_t)width * png_pixel_depth + 7) / 8;
+				const unsigned bytespp = std::max(1, png_pixel_depth / 8);
+				const bool invert = (FreeImage_GetColorType(dib) == FIC_MINISWHITE) && !bIsTransparent;
+
+				auto get_row = [&](unsigned y, uint8_t *raw) {
+					const uint8_t *src = FreeImage_GetConstScanLine(dib, height - y - 1);
+					if (png_pixel_depth != pixel_depth) {
+						FreeImage_ConvertLine32To24(raw, const_cast<uint8_t *>(src), width);
+					} else {
+						memcpy(raw, src, rowbytes);
+					}
+					if (invert) {
+						for (size_t i = 0; i < rowbytes; i++) {
+							raw[i] = (uint8_t)~raw[i];
+						}
+					}
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+					if ((image_type == FIT_BITMAP) && (png_pixel_depth >= 24)) {
+						for (size_t i = 0; i < rowbytes; i += bytespp) {
+							std::swap(raw[i], raw[i + 2]);
+						}
+					}
+#endif
 #ifndef FREEIMAGE_BIGENDIAN
-			if (bit_depth == 16) {
-				// turn on 16 bit byte swapping
-				png_set_swap(png_ptr.get());
-			}
+					if (bit_depth == 16) {
+						for (size_t i = 0; i + 1 < rowbytes; i += 2) {
+							std::swap(raw[i], raw[i + 1]);
+						}
+					}
 #endif
+				};
+
+				// same filters and deflate settings as libpng
+				int filters = PNG_ALL_FILTERS;
+				if (pixel_depth >= 16) {
+					filters = PNG_FILTER_NONE | PNG_FILTER_SUB | PNG_FILTER_PAETH;
+				} else if ((png_get_color_type(png_ptr.get(), info_ptr.get()) == PNG_COLOR_TYPE_PALETTE) || (bit_depth < 8)) {
+					filters = PNG_FILTER_NONE;
+				}
 
-			int number_passes = 1;
-			if (bInterlaced) {
-				number_passes = png_set_interlace_handling(png_ptr.get());
-			}
+				WriteBands(png_ptr.get(), DeflateBands(height, rowbytes, bytespp, filters, zlib_level, zlib_strategy, get_row), zlib_level);
 
-			if ((pixel_depth == 32) && (!has_alpha_channel)) {
-				auto buffer = std::make_unique<uint8_t[]>(width * 3);
+				// png_write_end refuses IDAT chunks written around libpng
+				png_write_chunk(png_ptr.get(), (png_const_bytep)"IEND", nullptr, 0);
+			} else {
+#ifndef FREEIMAGE_BIGENDIAN
+				if (bit_depth == 16) {
+					// turn on 16 bit byte swapping
+					png_set_swap(png_ptr.get());
+				}
+#endif
 
-				// transparent conversion to 24-bit
-				// the number of passes is either 1 for non-interlaced images, or 7 for interlaced images
-				for (int pass = 0; pass < number_passes; pass++) {
-					for (png_uint_32 k = 0; k < height; k++) {
-						FreeImage_ConvertLine32To24(buffer.get(), FreeImage_GetScanLine(dib, height - k - 1), width);
-						png_write_row(png_ptr.get(), buffer.get());
-					}
+				int number_passes = 1;
+				if (bInterlaced) {
+					number_passes = png_set_interlace_handling(png_ptr.get());
 				}
-			} else {
-				// the number of passes is either 1 for non-interlaced images, or 7 for interlaced images
-				for (int pass = 0; pass < number_passes; pass++) {
-					for (png_uint_32 k = 0; k < height; k++) {
-						png_write_row(png_ptr.get(), FreeImage_GetScanLine(dib, height - k - 1));
+
+				if ((pixel_depth == 32) && (!has_alpha_channel)) {
+					auto buffer = std::make_unique<uint8_t[]>(width * 3);
+
+					// transparent conversion to 24-bit
+					// the number of passes is either 1 for non-interlaced images, or 7 for interlaced images
+					for (int pass = 0; pass < number_passes; pass++) {
+						for (png_uint_32 k = 0; k < height; k++) {
+							FreeImage_ConvertLine32To24(buffer.get(), const_cast<uint8_t *>(FreeImage_GetConstScanLine(dib, height - k - 1)), width);
+							png_write_row(png_ptr.get(), buffer.get());
+						}
+					}
+				} else {
+					// the number of passes is either 1 for non-interlaced images, or 7 for interlaced images
+					for (int pass = 0; pass < number_passes; pass++) {
+						for (png_uint_32 k = 0; k < height; k++) {
+							png_write_row(png_ptr.get(), FreeImage_GetConstScanLine(dib, height - k - 1));
+						}
 					}
 				}
-			}
 
-			// It is REQUIRED to call this to finish writing the rest of the file
-			// Bug with png_flush
+				// It is REQUIRED to call this to finish writing the rest of the file
+				// Bug with png_flush
 
-			png_write_end(png_ptr.get(), info_ptr.get());
+				png_write_end(png_ptr.get(), info_ptr.get());
+			}
 
 			// clean up after the write, and free any memory allocated
 			if (palette) {
@@ -1037,13 +1464,122 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			return TRUE;
 
 		} catch (const char *text) {
-			FreeImage_OutputMessageProc(s_format_id, text);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		}
 	}
 
 	return FALSE;
 }
 
+// --------------------------------------------------------------------------
+
+/**
+Probe the IHDR chunk and the chunks preceding the image data, without libpng nor heap allocations.
+The bitmap properties follow the conversions of ConfigureDecoder.
+*/
+static FIBOOL DLL_CALLCONV
+GetImageInfo(FreeImageIO *io, fi_handle handle, FIIMAGEINFO *info, void *data) {
+	const uint8_t png_signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	auto ReadUint32BE = [](const uint8_t *p) -> uint32_t {
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+	};
+
+	// signature, IHDR chunk header and data, IHDR CRC
+	uint8_t header[8 + 8 + 13 + 4];
+	if (io->read_proc(header, sizeof(header), 1, handle) != 1) {
+		return FALSE;
+	}
+	if ((memcmp(header, png_signature, sizeof(png_signature)) != 0) || (memcmp(header + 12, "IHDR", 4) != 0)) {
+		return FALSE;
+	}
+	const uint32_t width = ReadUint32BE(header + 16);
+	const uint32_t height = ReadUint32BE(header + 20);
+	const int bit_depth = header[24];
+	const int color_type = header[25];
+	info->interlaced = (header[28] == PNG_INTERLACE_ADAM7) ? TRUE : FALSE;
+
+	// look for tRNS, iCCP and eXIf up to the image data
+	bool has_trns = false;
+	uint8_t chunk[8];
+	while (io->read_proc(chunk, sizeof(chunk), 1, handle) == 1) {
+		const uint32_t length = ReadUint32BE(chunk);
+		if ((length > PNG_UINT_31_MAX) || !memcmp(chunk + 4, "IDAT", 4) || !memcmp(chunk + 4, "IEND", 4)) {
+			break;
+		}
+		uint32_t skip = length;
+		if (!memcmp(chunk + 4, "tRNS", 4)) {
+			has_trns = true;
+		} else if (!memcmp(chunk + 4, "iCCP", 4)) {
+			info->has_icc_profile = TRUE;
+		} else if (!memcmp(chunk + 4, "eXIf", 4)) {
+			// the 0th IFD is at the beginning of the profile
+			uint8_t exif[1024];
+			const uint32_t size = MIN(length, (uint32_t)sizeof(exif));
+			if (io->read_proc(exif, size, 1, handle) != 1) {
+				break;
+			}
+			info->orientation = exif_read_orientation(exif, size, true);
+			skip -= size;
+		}
+		if (io->seek_proc(handle, (long)skip + 4, SEEK_CUR) != 0) {
+			break;
+		}
+	}
+
+	info->width = width;
+	info->height = height;
+	info->image_type = FIT_BITMAP;
+	info->has_alpha = has_trns || (color_type == PNG_COLOR_TYPE_GRAY_ALPHA) || (color_type == PNG_COLOR_TYPE_RGB_ALPHA);
+
+	switch (color_type) {
+		case PNG_COLOR_TYPE_GRAY:
+		case PNG_COLOR_TYPE_PALETTE:
+			if (bit_depth == 16 && color_type == PNG_COLOR_TYPE_GRAY) {
+				info->image_type = has_trns ? FIT_RGBA16 : FIT_UINT16;
+				info->bpp = has_trns ? 64 : 16;
+				info->color_type = has_trns ? FIC_RGBALPHA : FIC_MINISBLACK;
+			} else if (bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8) {
+				// 2-bit and transparent 1- or 4-bit images are expanded to 8-bit
+				info->bpp = ((bit_depth == 2) || (has_trns && (bit_depth < 8))) ? 8 : bit_depth;
+				info->color_type = (color_type == PNG_COLOR_TYPE_GRAY) ? FIC_MINISBLACK : FIC_PALETTE;
+			} else {
+				return FALSE;
+			}
+			break;
+
+		case PNG_COLOR_TYPE_RGB:
+			if (bit_depth == 8) {
+				info->bpp = has_trns ? 32 : 24;
+			} else if (bit_depth == 16) {
+				info->image_type = has_trns ? FIT_RGBA16 : FIT_RGB16;
+				info->bpp = has_trns ? 64 : 48;
+			} else {
+				return FALSE;
+			}
+			info->color_type = has_trns ? FIC_RGBALPHA : FIC_RGB;
+			break;
+
+		case PNG_COLOR_TYPE_GRAY_ALPHA:
+		case PNG_COLOR_TYPE_RGB_ALPHA:
+			if (bit_depth == 8) {
+				info->bpp = 32;
+			} else if (bit_depth == 16) {
+				info->image_type = FIT_RGBA16;
+				info->bpp = 64;
+			} else {
+				return FALSE;
+			}
+			info->color_type = FIC_RGBALPHA;
+			break;
+
+		default:
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
@@ -1068,6 +1604,8 @@ InitPNG(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->get_image_info_proc = GetImageInfo;
+	plugin->concurrency_proc = Concurrency;
 }
 
 
@@ -22,22 +22,125 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImage/Plugin.h"
 
 // ==========================================================
 // Internal functions
 // ==========================================================
 
+#define PNM_READ_CHUNK	(64 * 1024)
+
 /**
-Get an integer value from the actual position pointed by handle
+Buffered reader of the file. Memory streams are read in place, other streams by chunks of PNM_READ_CHUNK bytes.
+The stream is positioned after the last byte used when the reader is destroyed.
+*/
+class pnmReader {
+public:
+	pnmReader(FreeImageIO *io, fi_handle handle) : m_io(io), m_handle(handle) {
+		uint64_t available = 0;
+		if (const uint8_t *bytes = FreeImage_PeekMemoryIO(io, handle, &available)) {
+			m_start = m_pos = bytes;
+			m_end = bytes + available;
+			m_in_place = true;
+		}
+	}
+
+	~pnmReader() {
+		if (m_in_place) {
+			m_io->seek_proc(m_handle, (long)(m_pos - m_start), SEEK_CUR);
+		}
+		else if (m_end != m_pos) {
+			m_io->seek_proc(m_handle, -(long)(m_end - m_pos), SEEK_CUR);
+		}
+	}
+
+	/**
+	Reads the next byte, returns false at the end of the stream
+	*/
+	bool GetChar(char *c) {
+		if ((m_pos == m_end) && (m_in_place || !Fill())) {
+			return false;
+		}
+		*c = (char)*m_pos++;
+		return true;
+	}
+
+	/**
+	Copies the next size bytes (less at the end of the stream), returns the number of bytes copied
+	*/
+	size_t Read(void *buffer, size_t size) {
+		size_t count = 0;
+		while (count < size) {
+			if ((m_pos == m_end) && (m_in_place || !Fill())) {
+				break;
+			}
+			const size_t n = std::min<size_t>(size - count, m_end - m_pos);
+			memcpy((uint8_t*)buffer + count, m_pos, n);
+			m_pos += n;
+			count += n;
+		}
+		return count;
+	}
+
+	/**
+	Returns the remaining bytes of the stream at once, read in full for streams other than memory streams.
+	The bytes used are then consumed with Skip.
+	*/
+	const uint8_t* PeekAll(size_t *size) {
+		if (!m_in_place) {
+			const size_t remaining = m_end - m_pos;
+			if (remaining && (m_pos != m_chunk.data())) {
+				memmove(m_chunk.data(), m_pos, remaining);
+			}
+			size_t used = remaining;
+			for (;;) {
+				m_chunk.resize(used + PNM_READ_CHUNK);
+				const unsigned count = m_io->read_proc(m_chunk.data() + used, 1, PNM_READ_CHUNK, m_handle);
+				used += count;
+				if (count < PNM_READ_CHUNK) {
+					break;
+				}
+			}
+			m_pos = m_chunk.data();
+			m_end = m_pos + used;
+		}
+		*size = m_end - m_pos;
+		return m_pos;
+	}
+
+	void Skip(size_t size) {
+		m_pos += std::min<size_t>(size, m_end - m_pos);
+	}
+
+private:
+	bool Fill() {
+		m_chunk.resize(PNM_READ_CHUNK);
+		const unsigned count = m_io->read_proc(m_chunk.data(), 1, PNM_READ_CHUNK, m_handle);
+		m_pos = m_chunk.data();
+		m_end = m_pos + count;
+		return count > 0;
+	}
+
+	FreeImageIO *m_io;
+	fi_handle m_handle;
+	std::vector<uint8_t> m_chunk;
+	const uint8_t *m_start{};
+	const uint8_t *m_pos{};
+	const uint8_t *m_end{};
+	bool m_in_place{};
+};
+
+/**
+Get an integer value from the actual position of the reader
 */
 static int
-GetInt(FreeImageIO *io, fi_handle handle) {
+GetInt(pnmReader &reader) {
     char c = 0;
 	FIBOOL bFirstChar;
 
     // skip forward to start of next number
 
-	if (!io->read_proc(&c, 1, 1, handle)) {
+	if (!reader.GetChar(&c)) {
 		throw FI_MSG_ERROR_PARSING;
 	}
 
@@ -50,7 +153,7 @@ GetInt(FreeImageIO *io, fi_handle handle) {
             bFirstChar = TRUE;
 
             while (1) {
-				if (!io->read_proc(&c, 1, 1, handle)) {
+				if (!reader.GetChar(&c)) {
 					throw FI_MSG_ERROR_PARSING;
 				}
 
@@ -68,7 +171,7 @@ GetInt(FreeImageIO *io, fi_handle handle) {
             break;
 		}
 
-		if (!io->read_proc(&c, 1, 1, handle)) {
+		if (!reader.GetChar(&c)) {
 			throw FI_MSG_ERROR_PARSING;
 		}
     }
@@ -80,7 +183,7 @@ GetInt(FreeImageIO *io, fi_handle handle) {
     while (1) {
         i = (i * 10) + (c - '0');
 
-		if (!io->read_proc(&c, 1, 1, handle)) {
+		if (!reader.GetChar(&c)) {
 			throw FI_MSG_ERROR_PARSING;
 		}
 
@@ -93,16 +196,161 @@ GetInt(FreeImageIO *io, fi_handle handle) {
 }
 
 /**
-Read a uint16_t value taking into account the endianess issue
+Stores an ASCII sample into a scanline of the dib format
+@param sample Index of the sample in the row (pixel * samples per pixel + channel)
 */
-static inline uint16_t 
-ReadWord(FreeImageIO *io, fi_handle handle) {
-	uint16_t level = 0;
-	io->read_proc(&level, 2, 1, handle); 
-#ifndef FREEIMAGE_BIGENDIAN
-	SwapShort(&level);	// PNM uses the big endian convention
-#endif
-	return level;
+static inline void
+StoreLevel(uint8_t *bits, char id_two, FREE_IMAGE_TYPE image_type, int maxval, unsigned sample, int level) {
+	switch (id_two) {
+		case '1':	// ASCII bitmap
+			if (level == 0) {
+				bits[sample >> 3] |= (0x80 >> (sample & 0x7));
+			} else {
+				bits[sample >> 3] &= (0xFF7F >> (sample & 0x7));
+			}
+			break;
+
+		case '2':	// ASCII greymap
+			if (image_type == FIT_BITMAP) {
+				bits[sample] = (uint8_t)((255 * level) / maxval);
+			} else {
+				((uint16_t*)bits)[sample] = (uint16_t)((65535 * (double)level) / maxval);
+			}
+			break;
+
+		case '3':	// ASCII pixmap
+			if (image_type == FIT_BITMAP) {
+				static const unsigned channel[3] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE };
+				bits[3 * (sample / 3) + channel[sample % 3]] = (uint8_t)((255 * level) / maxval);
+			} else {
+				// FIRGB16 components are stored in the R, G, B file order
+				((uint16_t*)bits)[sample] = (uint16_t)((65535 * (double)level) / maxval);
+			}
+			break;
+	}
+}
+
+/**
+Parses at most count decimal numbers of [p, end), skipping comments, and calls store(value) for each of them.
+Returns the position after the last number parsed.
+*/
+template <class Store>
+static const char*
+ParseLevels(const char *p, const char *end, uint64_t count, Store store) {
+	while ((p < end) && count) {
+		if ((*p >= '0') && (*p <= '9')) {
+			unsigned value = 0;
+			do {
+				value = value * 10 + (unsigned)(*p++ - '0');
+			} while ((p < end) && (*p >= '0') && (*p <= '9'));
+			store((int)value);
+			--count;
+		}
+		else if (*p == '#') {
+			const void *eol = memchr(p, '\n', end - p);
+			p = eol ? (const char*)eol + 1 : end;
+		}
+		else {
+			++p;
+		}
+	}
+	return p;
+}
+
+/**
+Reads the samples of an ASCII file (P1, P2, P3) at once.
+The data is split into segments at number boundaries: the numbers of each segment are counted in parallel,
+then each segment is parsed in parallel from its first sample index.
+*/
+static void
+ReadASCIIData(pnmReader &reader, FIBITMAP *dib, char id_two, int maxval) {
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned pitch = FreeImage_GetPitch(dib);
+	const unsigned row_samples = width * ((id_two == '3') ? 3 : 1);
+	const uint64_t nSamples = (uint64_t)row_samples * height;
+	uint8_t *const first_line = FreeImage_GetScanLine(dib, height - 1);
+
+	size_t size = 0;
+	const char *data = (const char*)reader.PeekAll(&size);
+
+	// comments may hold anything, files having some are parsed as a single segment
+	constexpr size_t segment_bytes = 1024 * 1024;
+	const bool bComments = memchr(data, '#', size) != nullptr;
+	const unsigned nSegments = bComments ? 1 : (unsigned)std::clamp<size_t>(size / segment_bytes, 1, 1024);
+
+	std::vector<size_t> bounds(nSegments + 1);
+	bounds[nSegments] = size;
+	for (unsigned i = 1; i < nSegments; i++) {
+		size_t b = std::max(bounds[i - 1], (size_t)((uint64_t)size * i / nSegments));
+		while ((b < size) && (data[b - 1] >= '0') && (data[b - 1] <= '9') && (data[b] >= '0') && (data[b] <= '9')) {
+			++b;
+		}
+		bounds[i] = b;
+	}
+
+	std::vector<uint64_t> first_sample(nSegments + 1);
+	ParallelFor(0, nSegments, 1, [&](unsigned first, unsigned last) {
+		for (unsigned i = first; i < last; i++) {
+			uint64_t count = 0;
+			ParseLevels(data + bounds[i], data + bounds[i + 1], UINT64_MAX, [&count](int) { ++count; });
+			first_sample[i + 1] = count;
+		}
+	});
+	for (unsigned i = 0; i < nSegments; i++) {
+		first_sample[i + 1] += first_sample[i];
+	}
+	if (first_sample[nSegments] < nSamples) {
+		throw FI_MSG_ERROR_PARSING;
+	}
+
+	// bits of a 1-bit row may be shared by two segments, they are set once all the samples are known
+	std::vector<uint8_t> levels((id_two == '1') ? (size_t)nSamples : 0);
+
+	// end of the last sample, the stream is left after its separator
+	const char *data_end = data;
+
+	ParallelFor(0, nSegments, 1, [&](unsigned first, unsigned last) {
+		for (unsigned i = first; i < last; i++) {
+			uint64_t k = first_sample[i];
+			if (k >= nSamples) {
+				break;
+			}
+			unsigned y = (unsigned)(k / row_samples);
+			unsigned sample = (unsigned)(k % row_samples);
+			uint8_t *bits = first_line - (size_t)y * pitch;
+
+			const char *p = ParseLevels(data + bounds[i], data + bounds[i + 1], nSamples - k, [&](int level) {
+				if (id_two == '1') {
+					levels[k++] = (level == 0);
+				} else {
+					StoreLevel(bits, id_two, image_type, maxval, sample, level);
+				}
+				if (++sample == row_samples) {
+					sample = 0;
+					bits -= pitch;
+				}
+			});
+			if (first_sample[i + 1] >= nSamples) {
+				data_end = p;
+			}
+		}
+	});
+
+	reader.Skip((data_end - data) + 1);
+
+	if (id_two == '1') {
+		ParallelFor(0, height, CalculateBandRows(width), [&](unsigned first, unsigned last) {
+			for (unsigned y = first; y < last; y++) {
+				uint8_t *bits = first_line - (size_t)y * pitch;
+				const uint8_t *row = levels.data() + (size_t)y * row_samples;
+				for (unsigned x = 0; x < width; x++) {
+					StoreLevel(bits, id_two, image_type, maxval, x, row[x] ? 0 : 1);
+				}
+			}
+		});
+	}
 }
 
 /**
@@ -209,315 +457,299 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
-static FIBITMAP * DLL_CALLCONV
-Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	char id_one = 0, id_two = 0;
-	int x, y;
+/**
+Reads the PNM header and creates the dib, with its greyscale palette if needed
+@param id_two Returned format digit, '1' to '6'
+@param maxval Returned maximum sample value
+*/
+static FIBITMAP *
+ReadHeader(pnmReader &reader, FIBOOL header_only, char *id_two, int *maxval) {
+	char id_one = 0;
 	FIRGBA8 *pal;	// pointer to dib palette
-	int i;
 
-	if (!handle) {
-		return nullptr;
-	}
+	// Read the first two bytes of the file to determine the file format
+	// "P1" = ascii bitmap, "P2" = ascii greymap, "P3" = ascii pixmap,
+	// "P4" = raw bitmap, "P5" = raw greymap, "P6" = raw pixmap
 
-	FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+	reader.GetChar(&id_one);
+	reader.GetChar(id_two);
 
-	try {
-		FREE_IMAGE_TYPE image_type = FIT_BITMAP;	// standard image: 1-, 8-, 24-bit
+	if ((id_one != 'P') || (*id_two < '1') || (*id_two > '6')) {			
+		// signature error
+		throw FI_MSG_ERROR_MAGIC_NUMBER;
+	}
 
-		// Read the first two bytes of the file to determine the file format
-		// "P1" = ascii bitmap, "P2" = ascii greymap, "P3" = ascii pixmap,
-		// "P4" = raw bitmap, "P5" = raw greymap, "P6" = raw pixmap
+	// Read the header information: width, height and the 'max' value if any
 
-		io->read_proc(&id_one, 1, 1, handle);
-		io->read_proc(&id_two, 1, 1, handle);
+	int width  = GetInt(reader);
+	int height = GetInt(reader);
+	*maxval = 1;
 
-		if ((id_one != 'P') || (id_two < '1') || (id_two > '6')) {			
-			// signature error
-			throw FI_MSG_ERROR_MAGIC_NUMBER;
+	if ((*id_two == '2') || (*id_two == '5') || (*id_two == '3') || (*id_two == '6')) {
+		*maxval = GetInt(reader);
+		if ((*maxval <= 0) || (*maxval > 65535)) {
+			FreeImage_OutputMessageProc(s_format_id, "Invalid max value : %d", *maxval);
+			throw (const char*)nullptr;
 		}
+	}
 
-		// Read the header information: width, height and the 'max' value if any
+	// Create a new DIB
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
+	switch (*id_two) {
+		case '1':
+		case '4':
+			// 1-bit
+			dib.reset(FreeImage_AllocateHeader(header_only, width, height, 1));
+			break;
 
-		int width  = GetInt(io, handle);
-		int height = GetInt(io, handle);
-		int maxval = 1;
+		case '2':
+		case '5':
+			if (*maxval > 255) {
+				// 16-bit greyscale
+				dib.reset(FreeImage_AllocateHeaderT(header_only, FIT_UINT16, width, height));
+			} else {
+				// 8-bit greyscale
+				dib.reset(FreeImage_AllocateHeader(header_only, width, height, 8));
+			}
+			break;
 
-		if ((id_two == '2') || (id_two == '5') || (id_two == '3') || (id_two == '6')) {
-			maxval = GetInt(io, handle);
-			if ((maxval <= 0) || (maxval > 65535)) {
-				FreeImage_OutputMessageProc(s_format_id, "Invalid max value : %d", maxval);
-				throw (const char*)nullptr;
+		case '3':
+		case '6':
+			if (*maxval > 255) {
+				// 48-bit RGB
+				dib.reset(FreeImage_AllocateHeaderT(header_only, FIT_RGB16, width, height));
+			} else {
+				// 24-bit RGB
+				dib.reset(FreeImage_AllocateHeader(header_only, width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 			}
-		}
+			break;
+	}
+
+	if (!dib) {
+		throw FI_MSG_ERROR_DIB_MEMORY;
+	}
 
-		// Create a new DIB
-		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
-		switch (id_two) {
+	// Build a greyscale palette if needed
+
+	if (FreeImage_GetImageType(dib.get()) == FIT_BITMAP) {
+		switch (*id_two)  {
 			case '1':
 			case '4':
-				// 1-bit
-				dib.reset(FreeImage_AllocateHeader(header_only, width, height, 1));
+				pal = FreeImage_GetPalette(dib.get());
+				pal[0].red = pal[0].green = pal[0].blue = 0;
+				pal[1].red = pal[1].green = pal[1].blue = 255;
 				break;
 
 			case '2':
 			case '5':
-				if (maxval > 255) {
-					// 16-bit greyscale
-					image_type = FIT_UINT16;
-					dib.reset(FreeImage_AllocateHeaderT(header_only, image_type, width, height));
-				} else {
-					// 8-bit greyscale
-					dib.reset(FreeImage_AllocateHeader(header_only, width, height, 8));
+				pal = FreeImage_GetPalette(dib.get());
+				for (int i = 0; i < 256; i++) {
+					pal[i].red	=
+					pal[i].green =
+					pal[i].blue	= (uint8_t)i;
 				}
 				break;
 
-			case '3':
-			case '6':
-				if (maxval > 255) {
-					// 48-bit RGB
-					image_type = FIT_RGB16;
-					dib.reset(FreeImage_AllocateHeaderT(header_only, image_type, width, height));
-				} else {
-					// 24-bit RGB
-					dib.reset(FreeImage_AllocateHeader(header_only, width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
-				}
+			default:
 				break;
 		}
+	}
 
-		if (!dib) {
-			throw FI_MSG_ERROR_DIB_MEMORY;
-		}
-
-		// Build a greyscale palette if needed
-
-		if (image_type == FIT_BITMAP) {
-			switch (id_two)  {
-				case '1':
-				case '4':
-					pal = FreeImage_GetPalette(dib.get());
-					pal[0].red = pal[0].green = pal[0].blue = 0;
-					pal[1].red = pal[1].green = pal[1].blue = 255;
-					break;
-
-				case '2':
-				case '5':
-					pal = FreeImage_GetPalette(dib.get());
-					for (i = 0; i < 256; i++) {
-						pal[i].red	=
-						pal[i].green =
-						pal[i].blue	= (uint8_t)i;
-					}
-					break;
+	return dib.release();
+}
 
-				default:
-					break;
+/**
+Reads the next row of the image into a scanline of the dib format
+*/
+static void
+ReadRow(pnmReader &reader, char id_two, FREE_IMAGE_TYPE image_type, int maxval, int width, uint8_t *bits) {
+	int x;
+
+	switch (id_two)  {
+		case '1':	// ASCII bitmap
+		case '2':	// ASCII greymap
+		case '3':	// ASCII pixmap
+		{
+			const unsigned samples = (unsigned)width * ((id_two == '3') ? 3 : 1);
+			for (unsigned sample = 0; sample < samples; sample++) {
+				StoreLevel(bits, id_two, image_type, maxval, sample, GetInt(reader));
 			}
+			break;
 		}
 
-		if (header_only) {
-			// header only mode
-			return dib.release();
+		case '4': {	// Raw bitmap
+			const int line = CalculateLine(width, 1);
+
+			reader.Read(bits, line);
+			for (x = 0; x < line; x++) {
+				bits[x] = ~bits[x];
+			}
+			break;
 		}
 
-		// Read the image...
+		case '5':	// Raw greymap
+		case '6':	// Raw pixmap
+			if (image_type == FIT_BITMAP) {
+				const int samples = (id_two == '6') ? 3 * width : width;
 
-		switch (id_two)  {
-			case '1':
-			case '4':
-				// write the bitmap data
-
-				if (id_two == '1') {	// ASCII bitmap
-					for (y = 0; y < height; y++) {		
-						uint8_t *bits = FreeImage_GetScanLine(dib.get(), height - 1 - y);
+				// the whole row at once, then scaled and reordered in place
+				reader.Read(bits, samples);
 
+				if (id_two == '5') {
+					if (maxval != 255) {
 						for (x = 0; x < width; x++) {
-							if (GetInt(io, handle) == 0)
-								bits[x >> 3] |= (0x80 >> (x & 0x7));
-							else
-								bits[x >> 3] &= (0xFF7F >> (x & 0x7));
+							bits[x] = (uint8_t)((255 * (int)bits[x]) / maxval);
 						}
 					}
-				}  else {		// Raw bitmap
-					int line = CalculateLine(width, 1);
-
-					for (y = 0; y < height; y++) {	
-						uint8_t *bits = FreeImage_GetScanLine(dib.get(), height - 1 - y);
-
-						for (x = 0; x < line; x++) {
-							io->read_proc(&bits[x], 1, 1, handle);
+				} else {
+					for (x = 0; x < width; x++) {
+						const int r = bits[0], g = bits[1], b = bits[2];
+						bits[FI_RGBA_RED] = (uint8_t)((255 * r) / maxval);		// R
+						bits[FI_RGBA_GREEN] = (uint8_t)((255 * g) / maxval);	// G
+						bits[FI_RGBA_BLUE] = (uint8_t)((255 * b) / maxval);	// B
 
-							bits[x] = ~bits[x];
-						}
+						bits += 3;
 					}
 				}
+			}
+			else {
+				// FIT_UINT16 and FIT_RGB16 rows are read at once, words are swapped (PNM uses the big endian convention)
+				// then scaled in place
+				auto *words = (uint16_t*)bits;
+				const int samples = (id_two == '6') ? 3 * width : width;
 
-				return dib.release();
-
-			case '2':
-			case '5':
-				if (image_type == FIT_BITMAP) {
-					// write the bitmap data
-
-					if (id_two == '2') {		// ASCII greymap
-						int level = 0;
-
-						for (y = 0; y < height; y++) {	
-							uint8_t *bits = FreeImage_GetScanLine(dib.get(), height - 1 - y);
-
-							for (x = 0; x < width; x++) {
-								level = GetInt(io, handle);
-								bits[x] = (uint8_t)((255 * level) / maxval);
-							}
-						}
-					} else {		// Raw greymap
-						uint8_t level = 0;
-
-						for (y = 0; y < height; y++) {		
-							uint8_t *bits = FreeImage_GetScanLine(dib.get(), height - 1 - y);
+				reader.Read(words, 2 * (size_t)samples);
 
-							for (x = 0; x < width; x++) {
-								io->read_proc(&level, 1, 1, handle);
-								bits[x] = (uint8_t)((255 * (int)level) / maxval);
-							}
-						}
+#ifndef FREEIMAGE_BIGENDIAN
+				for (x = 0; x < samples; x++) {
+					words[x] = (uint16_t)((words[x] >> 8) | (words[x] << 8));
+				}
+#endif
+				if (maxval != 65535) {
+					for (x = 0; x < samples; x++) {
+						words[x] = (uint16_t)((65535 * (double)words[x]) / maxval);
 					}
 				}
-				else if (image_type == FIT_UINT16) {
-					// write the bitmap data
-
-					if (id_two == '2') {		// ASCII greymap
-						int level = 0;
-
-						for (y = 0; y < height; y++) {	
-							auto *bits = (uint16_t*)FreeImage_GetScanLine(dib.get(), height - 1 - y);
-
-							for (x = 0; x < width; x++) {
-								level = GetInt(io, handle);
-								bits[x] = (uint16_t)((65535 * (double)level) / maxval);
-							}
-						}
-					} else {		// Raw greymap
-						uint16_t level = 0;
+			}
+			break;
+	}
+}
 
-						for (y = 0; y < height; y++) {		
-							auto *bits = (uint16_t*)FreeImage_GetScanLine(dib.get(), height - 1 - y);
+static FIBITMAP * DLL_CALLCONV
+Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+	if (!handle) {
+		return nullptr;
+	}
 
-							for (x = 0; x < width; x++) {
-								level = ReadWord(io, handle);
-								bits[x] = (uint16_t)((65535 * (double)level) / maxval);
-							}
-						}
-					}
-				}
+	FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
-				return dib.release();
+	try {
+		char id_two = 0;
+		int maxval = 1;
 
-			case '3':
-			case '6':
-				if (image_type == FIT_BITMAP) {
-					// write the bitmap data
+		pnmReader reader(io, handle);
 
-					if (id_two == '3') {		// ASCII pixmap
-						int level = 0;
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(ReadHeader(reader, header_only, &id_two, &maxval), &FreeImage_Unload);
 
-						for (y = 0; y < height; y++) {	
-							uint8_t *bits = FreeImage_GetScanLine(dib.get(), height - 1 - y);
+		if (header_only) {
+			// header only mode
+			return dib.release();
+		}
 
-							for (x = 0; x < width; x++) {
-								level = GetInt(io, handle);
-								bits[FI_RGBA_RED] = (uint8_t)((255 * level) / maxval);		// R
-								level = GetInt(io, handle);
-								bits[FI_RGBA_GREEN] = (uint8_t)((255 * level) / maxval);	// G
-								level = GetInt(io, handle);
-								bits[FI_RGBA_BLUE] = (uint8_t)((255 * level) / maxval);	// B
+		// Read the image...
 
-								bits += 3;
-							}
-						}
-					}  else {			// Raw pixmap
-						uint8_t level = 0;
+		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib.get());
+		const int width = (int)FreeImage_GetWidth(dib.get());
+		const int height = (int)FreeImage_GetHeight(dib.get());
 
-						for (y = 0; y < height; y++) {	
-							uint8_t *bits = FreeImage_GetScanLine(dib.get(), height - 1 - y);
+		if ((id_two >= '1') && (id_two <= '3')) {
+			ReadASCIIData(reader, dib.get(), id_two, maxval);
+		} else {
+			for (int y = 0; y < height; y++) {
+				ReadRow(reader, id_two, image_type, maxval, width, FreeImage_GetScanLine(dib.get(), height - 1 - y));
+			}
+		}
 
-							for (x = 0; x < width; x++) {
-								io->read_proc(&level, 1, 1, handle); 
-								bits[FI_RGBA_RED] = (uint8_t)((255 * (int)level) / maxval);	// R
+		return dib.release();
 
-								io->read_proc(&level, 1, 1, handle);
-								bits[FI_RGBA_GREEN] = (uint8_t)((255 * (int)level) / maxval);	// G
+	} catch (const char *text)  {
+		if (text) {
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
+		}
+	}
+		
+	return nullptr;
+}
 
-								io->read_proc(&level, 1, 1, handle);
-								bits[FI_RGBA_BLUE] = (uint8_t)((255 * (int)level) / maxval);	// B
+// ==========================================================
+//   Scanline decoder
+// ==========================================================
 
-								bits += 3;
-							}
-						}
-					}
+namespace {
+
+	class PNMScanlineDecoder : public ScanlineDecoder
+	{
+	public:
+		PNMScanlineDecoder(FIBITMAP *info, std::unique_ptr<pnmReader> reader, char id_two, int maxval)
+			: ScanlineDecoder(info), mReader(std::move(reader)), mIdTwo(id_two), mMaxval(maxval)
+		{ }
+
+		unsigned Read(uint8_t *buffer, unsigned count, unsigned pitch) override {
+			FIBITMAP *info = GetInfo();
+			const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(info);
+			const unsigned width = FreeImage_GetWidth(info);
+			const unsigned height = FreeImage_GetHeight(info);
+
+			unsigned n = 0;
+			try {
+				for (; !mFailed && (mRow < height) && (n < count); n++, mRow++) {
+					ReadRow(*mReader, mIdTwo, image_type, mMaxval, (int)width, buffer + (size_t)n * pitch);
 				}
-				else if (image_type == FIT_RGB16) {
-					// write the bitmap data
-
-					if (id_two == '3') {		// ASCII pixmap
-						int level = 0;
-
-						for (y = 0; y < height; y++) {	
-							auto *bits = (FIRGB16*)FreeImage_GetScanLine(dib.get(), height - 1 - y);
-
-							for (x = 0; x < width; x++) {
-								level = GetInt(io, handle);
-								bits[x].red = (uint16_t)((65535 * (double)level) / maxval);		// R
-								level = GetInt(io, handle);
-								bits[x].green = (uint16_t)((65535 * (double)level) / maxval);	// G
-								level = GetInt(io, handle);
-								bits[x].blue = (uint16_t)((65535 * (double)level) / maxval);	// B
-							}
-						}
-					}  else {			// Raw pixmap
-						uint16_t level = 0;
-
-						for (y = 0; y < height; y++) {	
-							auto *bits = (FIRGB16*)FreeImage_GetScanLine(dib.get(), height - 1 - y);
-
-							for (x = 0; x < width; x++) {
-								level = ReadWord(io, handle);
-								bits[x].red = (uint16_t)((65535 * (double)level) / maxval);		// R
-								level = ReadWord(io, handle);
-								bits[x].green = (uint16_t)((65535 * (double)level) / maxval);	// G
-								level = ReadWord(io, handle);
-								bits[x].blue = (uint16_t)((65535 * (double)level) / maxval);	// B
-							}
-						}
-					}
+			}
+			catch (const char *text) {
+				if (text) {
+					FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 				}
-
-				return dib.release();
+				mFailed = true;
+			}
+			return n;
 		}
 
-	} catch (const char *text)  {
-		if (text) {
-			switch (id_two)  {
-				case '1':
-				case '4':
-					FreeImage_OutputMessageProc(s_format_id, text);
-					break;
+	private:
+		std::unique_ptr<pnmReader> mReader;
+		char mIdTwo;
+		int mMaxval;
+		unsigned mRow{ 0 };
+		bool mFailed{ false };
+	};
 
-				case '2':
-				case '5':
-					FreeImage_OutputMessageProc(s_format_id, text);
-					break;
+} // namespace
 
-				case '3':
-				case '6':
-					FreeImage_OutputMessageProc(s_format_id, text);
-					break;
-			}
+std::unique_ptr<ScanlineDecoder>
+CreateScanlineDecoderPNM(FreeImageIO *io, fi_handle handle, int flags) {
+	try {
+		char id_two = 0;
+		int maxval = 1;
+
+		auto reader = std::make_unique<pnmReader>(io, handle);
+
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> info(ReadHeader(*reader, TRUE, &id_two, &maxval), &FreeImage_Unload);
+		auto decoder = std::make_unique<PNMScanlineDecoder>(info.get(), std::move(reader), id_two, maxval);
+		info.release();
+		return decoder;
+	}
+	catch (const char *text) {
+		if (text) {
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		}
 	}
-		
 	return nullptr;
 }
 
@@ -832,4 +1064,5 @@ InitPNM(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -33,6 +33,16 @@
 
 static int s_format_id;
 
+/**
+Multipage state: page 0 is the composite image, pages 1..n are the layers.
+Layer records are only parsed when the page count or a layer is requested.
+*/
+struct PSDMultipage {
+	long start{};
+	bool layers_read{};
+	psdParser parser;
+};
+
 // ==========================================================
 // Plugin Implementation
 // ==========================================================
@@ -104,6 +114,51 @@ SupportsNoPixels() {
 	return TRUE;
 } 
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
+// ----------------------------------------------------------
+
+static void * DLL_CALLCONV
+Open(FreeImageIO *io, fi_handle handle, FIBOOL read) {
+	if (!read) {
+		return nullptr;
+	}
+	auto *multipage = new(std::nothrow) PSDMultipage;
+	if (multipage) {
+		multipage->start = io->tell_proc(handle);
+	}
+	return multipage;
+}
+
+static void DLL_CALLCONV
+Close(FreeImageIO *io, fi_handle handle, void *data) {
+	delete static_cast<PSDMultipage*>(data);
+}
+
+static bool
+ReadLayers(FreeImageIO *io, fi_handle handle, PSDMultipage *multipage) {
+	if (!multipage->layers_read) {
+		multipage->layers_read = true;
+		if ((io->seek_proc(handle, multipage->start, SEEK_SET) != 0) || !multipage->parser.ReadLayers(io, handle)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int DLL_CALLCONV
+PageCount(FreeImageIO *io, fi_handle handle, void *data) {
+	auto *multipage = static_cast<PSDMultipage*>(data);
+	if (!multipage) {
+		return 1;
+	}
+	ReadLayers(io, handle, multipage);
+	return 1 + multipage->parser.GetLayerCount();
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -111,6 +166,15 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	if (!handle) {
 		return nullptr;
 	}
+	auto *multipage = static_cast<PSDMultipage*>(data);
+	if (multipage && (page > 0)) {
+		// layers are decoded on demand, one at a time
+		ReadLayers(io, handle, multipage);
+		return multipage->parser.LoadLayer(io, handle, page - 1, s_format_id, flags);
+	}
+	if (multipage) {
+		io->seek_proc(handle, multipage->start, SEEK_SET);
+	}
 	try {
 		psdParser parser;
 
@@ -119,7 +183,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		return dib;
 
 	} catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		return nullptr;
 	}
 }
@@ -137,7 +201,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		return b;
 
 	} catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		return FALSE;
 	}
 }
@@ -154,9 +218,9 @@ InitPSD(Plugin *plugin, int format_id) {
 	plugin->description_proc = Description;
 	plugin->extension_proc = Extension;
 	plugin->regexpr_proc = nullptr;
-	plugin->open_proc = nullptr;
-	plugin->close_proc = nullptr;
-	plugin->pagecount_proc = nullptr;
+	plugin->open_proc = Open;
+	plugin->close_proc = Close;
+	plugin->pagecount_proc = PageCount;
 	plugin->pagecapability_proc = nullptr;
 	plugin->load_proc = Load;
 	plugin->save_proc = Save;
@@ -166,4 +230,5 @@ InitPSD(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels; 
+	plugin->concurrency_proc = Concurrency;
 }
@@ -90,11 +90,21 @@ typedef struct tagSUNHEADER {
 // Internal functions
 // ==========================================================
 
+/**
+Run-length decoder state, carried over from one ReadData call to the next.
+Owned by the Load call so that several images may be decoded at the same time.
+*/
+typedef struct tagRLESTATE {
+	uint8_t repchar;
+	uint8_t remaining;
+} RLESTATE;
+
 static void
-ReadData(FreeImageIO *io, fi_handle handle, uint8_t *buf, uint32_t length, FIBOOL rle) {
+ReadData(FreeImageIO *io, fi_handle handle, uint8_t *buf, uint32_t length, FIBOOL rle, RLESTATE *state) {
 	// Read either Run-Length Encoded or normal image data
 
-	static uint8_t repchar, remaining= 0;
+	uint8_t &repchar = state->repchar;
+	uint8_t &remaining = state->remaining;
 
 	if (rle) {
 		// Run-length encoded read
@@ -188,6 +198,11 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD;
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -196,6 +211,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	uint16_t linelength;	// Length of raster line in bytes
 	uint16_t fill;			// Number of fill bytes per raster line
 	FIBOOL rle;			// TRUE if RLE file
+	RLESTATE rle_state = { 0, 0 };	// RLE decoder state
 	FIBOOL isRGB;			// TRUE if file type is RT_FORMAT_RGB
 	uint8_t fillchar;
 
@@ -369,10 +385,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				for (y = 0; y < header.height; y++) {
 					bits = FreeImage_GetScanLine(dib.get(), header.height - 1 - y);
 
-					ReadData(io, handle, bits, linelength, rle);
+					ReadData(io, handle, bits, linelength, rle, &rle_state);
 
 					if (fill) {
-						ReadData(io, handle, &fillchar, fill, rle);
+						ReadData(io, handle, &fillchar, fill, rle, &rle_state);
 					}
 				}
 
@@ -386,7 +402,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				for (y = 0; y < header.height; y++) {
 					bits = FreeImage_GetScanLine(dib.get(), header.height - 1 - y);
 
-					ReadData(io, handle, buf.get(), header.width * 3, rle);
+					ReadData(io, handle, buf.get(), header.width * 3, rle, &rle_state);
 
 					const auto *bp = buf.get();
 
@@ -409,7 +425,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					}
 
 					if (fill) {
-						ReadData(io, handle, &fillchar, fill, rle);
+						ReadData(io, handle, &fillchar, fill, rle, &rle_state);
 					}
 				}
 
@@ -423,7 +439,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				for (y = 0; y < header.height; y++) {
 					bits = FreeImage_GetScanLine(dib.get(), header.height - 1 - y);
 
-					ReadData(io, handle, buf.get(), header.width * 4, rle);
+					ReadData(io, handle, buf.get(), header.width * 4, rle, &rle_state);
 
 					const auto *bp = buf.get();
 
@@ -450,7 +466,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					}
 
 					if (fill) {
-						ReadData(io, handle, &fillchar, fill, rle);
+						ReadData(io, handle, &fillchar, fill, rle, &rle_state);
 					}
 				}
 
@@ -461,7 +477,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		return dib.release();
 
 	} catch (const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 	}
 
 	return nullptr;
@@ -491,4 +507,5 @@ InitRAS(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -24,6 +24,11 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "../Metadata/FreeImageTag.h"
+#include "FreeImage/ThreadPool.h"
+
+#ifdef LIBRAW_USE_OPENMP
+#include <omp.h>
+#endif
 
 // ==========================================================
 // Plugin Interface
@@ -137,6 +142,24 @@ public:
 #endif
 };
 
+/**
+Wrap the input stream into a LibRaw datastream.
+Memory streams (including mapped files) are read in place through a LibRaw_buffer_datastream,
+avoiding the many small io calls LibRaw makes while parsing; the stream is then moved to its end.
+@param io FreeImage IO
+@param handle FreeImage handle
+@return Returns the datastream
+*/
+static std::unique_ptr<LibRaw_abstract_datastream>
+libraw_CreateDatastream(FreeImageIO *io, fi_handle handle) {
+	uint64_t available = 0;
+	if (const uint8_t *bytes = FreeImage_PeekMemoryIO(io, handle, &available)) {
+		io->seek_proc(handle, 0, SEEK_END);
+		return std::make_unique<LibRaw_buffer_datastream>(bytes, (size_t)available);
+	}
+	return std::make_unique<LibRaw_freeimage_datastream>(io, handle);
+}
+
 // ----------------------------------------------------------
 
 /**
@@ -190,7 +213,7 @@ libraw_ConvertProcessedRawToDib(LibRaw *RawProcessor) {
 		return dib.release();
 
 	} catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 	}
 	return nullptr;
 }
@@ -248,25 +271,58 @@ libraw_ConvertProcessedImageToDib(libraw_processed_image_t *image) {
 		return dib.release();
 
 	} catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		return nullptr;
 	}
 }
 
+/**
+Get the smallest embedded preview whose longest side is at least requested_size
+@param RawProcessor Libraw handle
+@param requested_size Requested size of the longest side in pixels
+@return Returns the index of the preview in the thumbnails list, returns -1 if none is large enough
+*/
+static int
+libraw_SelectPreview(LibRaw *RawProcessor, unsigned requested_size) {
+	const libraw_thumbnail_list_t &thumbs = RawProcessor->imgdata.thumbs_list;
+	int index = -1;
+	unsigned index_size = 0;
+	for (int i = 0; i < thumbs.thumbcount && i < LIBRAW_THUMBNAIL_MAXCOUNT; i++) {
+		const unsigned size = MAX(thumbs.thumblist[i].twidth, thumbs.thumblist[i].theight);
+		if ((size >= requested_size) && ((index < 0) || (size < index_size))) {
+			index = i;
+			index_size = size;
+		}
+	}
+	return index;
+}
+
 /** 
 Get the embedded JPEG preview image from RAW picture with included Exif Data. 
 @param RawProcessor Libraw handle
 @param flags JPEG load flags
+@param requested_size If not 0, get the smallest preview whose longest side is at least that size (see libraw_SelectPreview)
 @return Returns the loaded dib if successfull, returns NULL otherwise
 */
 static FIBITMAP * 
-libraw_LoadEmbeddedPreview(LibRaw *RawProcessor, int flags) {
+libraw_LoadEmbeddedPreview(LibRaw *RawProcessor, int flags, unsigned requested_size = 0) {
 	FIBITMAP *dib{};
 	libraw_processed_image_t *thumb_image{};
 	
 	try {
 		// unpack data
-		if (RawProcessor->unpack_thumb() != LIBRAW_SUCCESS) {
+		int status = LIBRAW_SUCCESS;
+		if (requested_size > 0) {
+			const int index = libraw_SelectPreview(RawProcessor, requested_size);
+			if (index < 0) {
+				// no preview large enough
+				return nullptr;
+			}
+			status = RawProcessor->unpack_thumb_ex(index);
+		} else {
+			status = RawProcessor->unpack_thumb();
+		}
+		if (status != LIBRAW_SUCCESS) {
 			// run silently "LibRaw : failed to run unpack_thumb"
 			return nullptr;
 		}
@@ -307,7 +363,7 @@ libraw_LoadEmbeddedPreview(LibRaw *RawProcessor, int flags) {
 			RawProcessor->dcraw_clear_mem(thumb_image);
 		}
 		if (text) {
-			FreeImage_OutputMessageProc(s_format_id, text);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		}
 	}
 
@@ -317,10 +373,11 @@ libraw_LoadEmbeddedPreview(LibRaw *RawProcessor, int flags) {
 Load raw data and convert to FIBITMAP
 @param RawProcessor Libraw handle
 @param bitspersample Output bitdepth (8- or 16-bit)
+@param flags Load flags (RAW_FASTDEMOSAIC)
 @return Returns the loaded dib if successfull, returns NULL otherwise
 */
 static FIBITMAP * 
-libraw_LoadRawData(LibRaw *RawProcessor, int bitspersample) {
+libraw_LoadRawData(LibRaw *RawProcessor, int bitspersample, int flags) {
 	FIBITMAP *dib{};
 
 	try {
@@ -344,7 +401,8 @@ libraw_LoadRawData(LibRaw *RawProcessor, int bitspersample) {
 		// (-a) Use automatic white balance obtained after averaging over the entire image
 		RawProcessor->imgdata.params.use_auto_wb = 1;
 		// (-q 3) Adaptive homogeneity-directed demosaicing algorithm (AHD)
-		RawProcessor->imgdata.params.user_qual = 3;
+		// or (-q 0) bilinear interpolation, several times faster
+		RawProcessor->imgdata.params.user_qual = ((flags & RAW_FASTDEMOSAIC) == RAW_FASTDEMOSAIC) ? 0 : 3;
 
 		// -----------------------
 
@@ -354,7 +412,16 @@ libraw_LoadRawData(LibRaw *RawProcessor, int bitspersample) {
 		}
 
 		// process data (... most consuming task ...)
-		if (RawProcessor->dcraw_process() != LIBRAW_SUCCESS) {
+#ifdef LIBRAW_USE_OPENMP
+		// LibRaw's parallel loops run with the OpenMP thread count of the calling thread
+		const int omp_threads = omp_get_max_threads();
+		omp_set_num_threads(ThreadPool::IsWorkerThread() ? 1 : (int)FreeImage_GetThreadCount());
+		const int status = RawProcessor->dcraw_process();
+		omp_set_num_threads(omp_threads);
+#else
+		const int status = RawProcessor->dcraw_process();
+#endif
+		if (status != LIBRAW_SUCCESS) {
 			throw "LibRaw : failed to process data";
 		}
 
@@ -364,7 +431,7 @@ libraw_LoadRawData(LibRaw *RawProcessor, int bitspersample) {
 		return dib;
 
 	} catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		return nullptr;
 	}
 }
@@ -467,7 +534,7 @@ libraw_LoadUnprocessedData(LibRaw *RawProcessor) {
 		return dib.release();
 
 	} catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		return nullptr;
 	}
 }
@@ -628,10 +695,10 @@ Validate(FreeImageIO *io, fi_handle handle) {
 			FIBOOL bSuccess = TRUE;
 
 			// wrap the input datastream
-			LibRaw_freeimage_datastream datastream(io, handle);
+			auto datastream = libraw_CreateDatastream(io, handle);
 
 			// open the datastream
-			if (RawProcessor->open_datastream(&datastream) != LIBRAW_SUCCESS) {
+			if (RawProcessor->open_datastream(datastream.get()) != LIBRAW_SUCCESS) {
 				bSuccess = FALSE;	// LibRaw : failed to open input stream (unknown format)
 			}
 
@@ -666,6 +733,11 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD;
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -682,7 +754,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		}
 
 		// wrap the input datastream
-		LibRaw_freeimage_datastream datastream(io, handle);
+		auto datastream = libraw_CreateDatastream(io, handle);
 
 		// set decoding parameters
 		// the following parameters affect data reading
@@ -698,7 +770,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		RawProcessor->imgdata.params.half_size = ((flags & RAW_HALFSIZE) == RAW_HALFSIZE) ? 1 : 0;
 
 		// open the datastream
-		if (RawProcessor->open_datastream(&datastream) != LIBRAW_SUCCESS) {
+		if (RawProcessor->open_datastream(datastream.get()) != LIBRAW_SUCCESS) {
 			throw "LibRaw : failed to open input stream (unknown format)";
 		}
 
@@ -712,20 +784,25 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			dib.reset(libraw_LoadUnprocessedData(RawProcessor));
 		}
 		else if ((flags & RAW_PREVIEW) == RAW_PREVIEW) {
-			// try to get the embedded JPEG
-			dib.reset(libraw_LoadEmbeddedPreview(RawProcessor, 0));
+			// try to get the embedded JPEG, the smallest one covering the size requested in the upper 16 bits of flags if any
+			const unsigned requested_size = (unsigned)flags >> 16;
+			dib.reset(libraw_LoadEmbeddedPreview(RawProcessor, 0, requested_size));
 			if (!dib) {
-				// no JPEG preview: try to load as 8-bit/sample (i.e. RGB 24-bit)
-				dib.reset(libraw_LoadRawData(RawProcessor, 8));
+				// no (large enough) JPEG preview: try to load as 8-bit/sample (i.e. RGB 24-bit), at half size if it is enough
+				const libraw_image_sizes_t &sizes = RawProcessor->imgdata.sizes;
+				if ((requested_size > 0) && (MAX(sizes.width, sizes.height) / 2U >= requested_size)) {
+					RawProcessor->imgdata.params.half_size = 1;
+				}
+				dib.reset(libraw_LoadRawData(RawProcessor, 8, flags));
 			}
 		} 
 		else if ((flags & RAW_DISPLAY) == RAW_DISPLAY) {
 			// load raw data as 8-bit/sample (i.e. RGB 24-bit)
-			dib.reset(libraw_LoadRawData(RawProcessor, 8));
+			dib.reset(libraw_LoadRawData(RawProcessor, 8, flags));
 		} 
 		else {
 			// default: load raw data as linear 16-bit/sample (i.e. RGB 48-bit)
-			dib.reset(libraw_LoadRawData(RawProcessor, 16));
+			dib.reset(libraw_LoadRawData(RawProcessor, 16, flags));
 		}
 
 		// save ICC profile if present
@@ -752,7 +829,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			RawProcessor->recycle();
 			delete RawProcessor;
 		}
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 	}
 
 	return nullptr;
@@ -782,6 +859,7 @@ InitRAW(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
 
 
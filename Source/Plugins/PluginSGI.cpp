@@ -30,6 +30,9 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImage/ConversionSIMD.h"
+
+#include <algorithm>
 
 // ----------------------------------------------------------
 //   Constants + headers
@@ -86,11 +89,6 @@ typedef struct tagSGIHeader {
 	char reserved[404];
 } SGIHeader;
 
-typedef struct tagRLEStatus {
-  int cnt;
-  int val;
-} RLEStatus;
-
 #ifdef _WIN32
 #pragma pack(pop)
 #else
@@ -128,42 +126,54 @@ SwapHeader(SGIHeader *header) {
 }
 #endif
 
-static int 
-get_rlechar(FreeImageIO *io, fi_handle handle, RLEStatus *pstatus) {
-	if (!pstatus->cnt) {
-		int cnt = 0;
-		while (0 == cnt) {
-			uint8_t packed = 0;
-			if (io->read_proc(&packed, sizeof(uint8_t), 1, handle) < 1) {
-				return EOF;
-			}
-			cnt = packed;
+/**
+Decodes a RLE row of width bytes from data[0, size).
+Each run starts with a count byte: count & 0x7F bytes follow it when bit 7 is set, otherwise the byte to repeat.
+Zero counts are skipped, the run crossing the end of the row is cut.
+@return Returns false if the data end before the row
+*/
+static bool 
+DecodeRLERow(const uint8_t *data, size_t size, uint8_t *row, unsigned width) {
+	const uint8_t *const end = data + size;
+	unsigned x = 0;
+	while (x < width) {
+		if (data == end) {
+			return false;
 		}
-		if (cnt == EOF) {
-			return EOF;
+		const unsigned packed = *data++;
+		const unsigned count = std::min(packed & 0x7F, width - x);
+		if (packed & 0x80) {
+			if ((size_t)(end - data) < count) {
+				return false;
+			}
+			memcpy(row + x, data, count);
+			data += count;
 		}
-		pstatus->cnt = cnt & 0x7F;
-		if (cnt & 0x80) {
-			pstatus->val = -1;
-		} else {
-			uint8_t packed = 0;
-			if (io->read_proc(&packed, sizeof(uint8_t), 1, handle) < 1) {
-				return EOF;
+		else if (count) {
+			if (data == end) {
+				return false;
 			}
-			pstatus->val = packed;
+			memset(row + x, *data++, count);
 		}
+		x += count;
 	}
-	pstatus->cnt--;
-	if (pstatus->val == -1) {
-		uint8_t packed = 0;
-		if (io->read_proc(&packed, sizeof(uint8_t), 1, handle) < 1) {
-			return EOF;
+	return true;
+}
+
+/**
+Reads size bytes, in chunks the size of which fits the unsigned count of read_proc
+*/
+static bool 
+ReadData(FreeImageIO *io, fi_handle handle, uint8_t *data, size_t size) {
+	const size_t chunk_size = 1U << 30;
+	for (size_t done = 0; done < size; ) {
+		const size_t chunk = std::min(size - done, chunk_size);
+		if (io->read_proc(data + done, 1, (unsigned)chunk, handle) != chunk) {
+			return false;
 		}
-		return packed;
-	}
-	else {
-		return pstatus->val;
+		done += chunk;
 	}
+	return true;
 }
 
 static const char * DLL_CALLCONV
@@ -211,13 +221,24 @@ SupportsExportType(FREE_IMAGE_TYPE type) {
   return FALSE;
 }
 
+static FIBOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD;
+}
+
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	int width = 0, height = 0, zsize = 0;
 	int i, dim;
 	int bitcount;
 	SGIHeader sgiHeader;
-	RLEStatus my_rle_status;
+
+	const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
 	try {
 		// read the header
@@ -259,29 +280,23 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			height = sgiHeader.ysize;
 		}
 
-		std::unique_ptr<int32_t[]> pRowIndex;
+		std::unique_ptr<uint32_t[]> pRowIndex;
+		const size_t index_len = (size_t)height * zsize;
 		if (bIsRLE) {
-			// read the Offset Tables 
-			int index_len = height * zsize;
-			pRowIndex.reset(new int32_t[index_len]);
+			// read the offset table (rows of the first channel, then of the next ones)
+			// the table of the row lengths isn't needed, rows are decoded up to their width
+			pRowIndex.reset(new uint32_t[index_len]);
 			
-			if ((unsigned)index_len != io->read_proc(pRowIndex.get(), sizeof(int32_t), index_len, handle)) {
+			if (index_len != io->read_proc(pRowIndex.get(), sizeof(uint32_t), (unsigned)index_len, handle)) {
 				throw SGI_EOF_IN_RLE_INDEX;
 			}
 			
 #ifndef FREEIMAGE_BIGENDIAN
 			// Fix byte order in index
-			for (i = 0; i < index_len; i++) {
-				SwapLong(static_cast<uint32_t*>(static_cast<void*>(pRowIndex.get())) + i);
+			for (size_t k = 0; k < index_len; k++) {
+				SwapLong(pRowIndex.get() + k);
 			}
 #endif
-			// Discard row size index
-			for (i = 0; i < (int)(index_len * sizeof(int32_t)); i++) {
-				uint8_t packed = 0;
-				if (io->read_proc(&packed, sizeof(uint8_t), 1, handle) < 1) {
-					throw SGI_EOF_IN_RLE_INDEX;
-				}
-			}
 		}
 		
 		switch (zsize) {
@@ -302,7 +317,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				throw SGI_INVALID_CHANNEL_COUNT;
 		}
 		
-		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_Allocate(width, height, bitcount), &FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeader(header_only, width, height, bitcount), &FreeImage_Unload);
 		if (!dib) {
 			throw FI_MSG_ERROR_DIB_MEMORY;
 		}
@@ -319,77 +334,84 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			}
 		}
 
-		// decode the image
+		if (header_only) {
+			// header only mode
+			return dib.release();
+		}
 
-		memset(&my_rle_status, 0, sizeof(RLEStatus));
-		
-		int ns = FreeImage_GetPitch(dib.get());
-		uint8_t *pStartRow = FreeImage_GetScanLine(dib.get(), 0);
-		int offset_table[] = { 2, 1, 0, 3 };
-		int numChannels = zsize;
-		if (zsize < 3) {
-			offset_table[0] = 0;
+		// read the image data in a single pass: 
+		// RLE rows from the first one to the end of the file, uncompressed planes one after the other
+
+		size_t data_offset = 0;
+		size_t data_size = (size_t)width * height * zsize;
+		if (bIsRLE) {
+			data_offset = *std::min_element(pRowIndex.get(), pRowIndex.get() + index_len);
+			io->seek_proc(handle, 0, SEEK_END);
+			const long eof = io->tell_proc(handle);
+			if ((eof < 0) || (data_offset > (size_t)eof)) {
+				throw SGI_EOF_IN_IMAGE_DATA;
+			}
+			data_size = (size_t)eof - data_offset;
+			io->seek_proc(handle, (long)data_offset, SEEK_SET);
 		}
-		if (zsize == 2)
-		{
-			//This is how faked grayscale+alpha works.
-			//First channel goes into first 
-			//second channel goes into alpha (4th channel)
-			//Two channels are left empty and will be copied later
-			offset_table[1] = 3;
-			numChannels = 4;
+		std::unique_ptr<uint8_t[]> data(new uint8_t[data_size]);
+		if (!ReadData(io, handle, data.get(), data_size)) {
+			throw SGI_EOF_IN_IMAGE_DATA;
 		}
 
-		auto *pri = pRowIndex.get();
-		for (i = 0; i < zsize; i++) {
-			uint8_t *pRow = pStartRow + offset_table[i];
-			for (int j = 0; j < height; j++, pRow += ns, pri++) {
-				uint8_t *p = pRow;
-				if (bIsRLE) {
-					my_rle_status.cnt = 0;
-					io->seek_proc(handle, *pri, SEEK_SET);
-				}
-				for (int k = 0; k < width; k++, p += numChannels) {
-					int ch;
-					uint8_t packed = 0;
+		// decode the image
+		// rows of all channels are independent, they are decoded by parallel bands and interleaved into the pixels,
+		// greyscale + alpha is expanded to RGBA
+
+		const unsigned channel_byte[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+		const unsigned bytespp = bitcount / 8;
+		const unsigned pitch = FreeImage_GetPitch(dib.get());
+		uint8_t *bits = FreeImage_GetBits(dib.get());
+
+		ParallelFor(0, height, CalculateBandRows(FreeImage_GetLine(dib.get())), [&](unsigned first, unsigned last) {
+			std::unique_ptr<uint8_t[]> rows((bIsRLE && zsize > 1) ? new uint8_t[(size_t)zsize * width] : nullptr);
+			for (unsigned y = first; y < last; y++) {
+				uint8_t *scanline = bits + (size_t)y * pitch;
+				const uint8_t *plane[4] = {};
+				for (int c = 0; c < zsize; c++) {
 					if (bIsRLE) {
-						ch = get_rlechar(io, handle, &my_rle_status);
-						packed = (uint8_t)ch;
+						uint8_t *row = (zsize == 1) ? scanline : rows.get() + (size_t)c * width;
+						const size_t offset = pRowIndex[(size_t)c * height + y] - data_offset;
+						if ((offset > data_size) || !DecodeRLERow(data.get() + offset, data_size - offset, row, width)) {
+							throw SGI_EOF_IN_IMAGE_DATA;
+						}
+						plane[c] = row;
+					} else {
+						plane[c] = data.get() + ((size_t)c * height + y) * width;
 					}
-					else {
-						ch = io->read_proc(&packed, sizeof(uint8_t), 1, handle);
-					}
-					if (ch == EOF) {
-						throw SGI_EOF_IN_IMAGE_DATA;
+				}
+				if (zsize == 1) {
+					if (!bIsRLE) {
+						memcpy(scanline, plane[0], width);
 					}
-					*p = packed;
+					continue;
 				}
-			}
-		}
-		
-		if (zsize == 2)
-		{
-			uint8_t *pRow = pStartRow;
-			//If faking RGBA from grayscale + alpha, copy first channel to second and third
-			for (int i=0; i<height; i++, pRow += ns)
-			{
-				uint8_t *pPixel = pRow;
-				for (int j=0; j<width; j++)
-				{
-					pPixel[2] = pPixel[1] = pPixel[0];
-					pPixel += 4;
+				const uint8_t *pixel_planes[4] = {};
+				if (zsize == 2) {
+					pixel_planes[FI_RGBA_RED] = pixel_planes[FI_RGBA_GREEN] = pixel_planes[FI_RGBA_BLUE] = plane[0];
+					pixel_planes[FI_RGBA_ALPHA] = plane[1];
+				} else {
+					for (int c = 0; c < zsize; c++) {
+						pixel_planes[channel_byte[c]] = plane[c];
+					}
 				}
+				InterleavePlanes(scanline, pixel_planes, width, bytespp);
 			}
-		}
+		});
 
 		return dib.release();
 
 	}
 	catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 	}
 	catch (const std::bad_alloc &) {
-		FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
 	}
 	return nullptr;
 }
@@ -417,5 +439,7 @@ InitSGI(Plugin *plugin, int format_id) {
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
 
@@ -27,6 +27,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "RLEEncoder.h"
 
 // ----------------------------------------------------------
 //   Constants + headers
@@ -196,52 +197,53 @@ FIBITMAP* TargaThumbnail::toFIBITMAP() {
 // Internal functions
 // ==========================================================
 
-/** This class is used when loading RLE compressed images, it implements io cache of fixed size.
+#define TGA_READ_CHUNK	(64 * 1024)
+
+/** This class is used when loading RLE compressed images, it implements an io cache.
 	In general RLE compressed images *should* be compressed line by line with line sizes stored in Scan Line Table section.
 	In reality, however there are images not obeying the specification, compressing image data continuously across lines,
 	making it impossible to load the file cached at every line.
+	Memory streams are read in place, other streams by chunks of at least TGA_READ_CHUNK bytes.
+	Bytes beyond the end of the stream are read as zeros. The stream is positioned after the last byte used
+	when the cache is destroyed.
 */
 class IOCache
 {
 public:
 	IOCache(FreeImageIO *io, fi_handle handle, size_t size) :
-		_safeBuffer(new uint8_t[size]), _begin{_safeBuffer.get()}, _end{_begin + size}, _ptr{_end}, _size(size), _io(io), _handle(handle)	{
+		_size(MAX(size, (size_t)TGA_READ_CHUNK)), _io(io), _handle(handle) {
+		uint64_t available = 0;
+		if (const uint8_t *bytes = FreeImage_PeekMemoryIO(io, handle, &available)) {
+			_begin = _ptr = bytes;
+			_end = _valid_end = bytes + available;
+			_in_place = true;
+		}
+	}
+
+	~IOCache() {
+		if (_in_place) {
+			_io->seek_proc(_handle, (long)(_ptr - _begin), SEEK_CUR);
+		}
+		else if (_valid_end > _ptr) {
+			_io->seek_proc(_handle, -(long)(_valid_end - _ptr), SEEK_CUR);
+		}
 	}
 
 	inline
 	uint8_t getByte() {
 		if (_ptr >= _end) {
-			// need refill
-			_ptr = _begin;
-			_io->read_proc(_ptr, sizeof(uint8_t), (unsigned)_size, _handle);	//### EOF - no problem?
+			refill(1);
 		}
-
-		uint8_t result = *_ptr;
-
-		_ptr++;
-
-		return result;
+		return *_ptr++;
 	}
 	
 	inline
-	uint8_t* getBytes(size_t count /*must be < _size!*/) {
-		if (_ptr + count >= _end) {
-
-			// need refill
-
-			// 'count' bytes might span two cache bounds,
-			// SEEK back to add the remains of the current cache again into the new one
-
-			long read = long(_ptr - _begin);
-			long remaining = long(_size - read);
-
-			_io->seek_proc(_handle, -remaining, SEEK_CUR);
-
-			_ptr = _begin;
-			_io->read_proc(_ptr, sizeof(uint8_t), (unsigned)_size, _handle);	//### EOF - no problem?
+	const uint8_t* getBytes(size_t count) {
+		if ((size_t)(_end - _ptr) < count) {
+			refill(count);
 		}
 
-		uint8_t *result = _ptr;
+		const uint8_t *result = _ptr;
 
 		_ptr += count;
 
@@ -249,17 +251,46 @@ public:
 	}
 
 private:
-	IOCache& operator=(const IOCache& src); // deleted
-	IOCache(const IOCache& other); // deleted
+	/**
+	Moves the unused bytes to the start of a new buffer of at least count bytes and reads the following ones
+	*/
+	void refill(size_t count) {
+		const size_t remaining = (size_t)(_end - _ptr);
+		const size_t size = MAX(_size, count);
+
+		std::vector<uint8_t> buffer(size);
+		if (remaining) {
+			memcpy(buffer.data(), _ptr, remaining);
+		}
+
+		size_t filled = remaining;
+		if (_in_place) {
+			// the stream is consumed, the remaining bytes are now read ahead
+			_io->seek_proc(_handle, (long)(_end - _begin), SEEK_CUR);
+			_in_place = false;
+		} else {
+			filled += _io->read_proc(buffer.data() + remaining, sizeof(uint8_t), (unsigned)(size - remaining), _handle);
+		}
+
+		_buffer.swap(buffer);
+		_begin = _ptr = _buffer.data();
+		_end = _begin + size;
+		_valid_end = _begin + filled;
+	}
+
+	IOCache& operator=(const IOCache& src) = delete;
+	IOCache(const IOCache& other) = delete;
 
 private:
-	std::unique_ptr<uint8_t[]> _safeBuffer;
-	uint8_t * const _begin{};
-	uint8_t * const _end{};
-	uint8_t *_ptr{};
+	std::vector<uint8_t> _buffer;
+	const uint8_t *_begin{};
+	const uint8_t *_end{};
+	const uint8_t *_valid_end{};
+	const uint8_t *_ptr{};
 	const size_t _size;
-	const FreeImageIO *_io;	
-	const fi_handle _handle;	
+	FreeImageIO *_io;
+	const fi_handle _handle;
+	bool _in_place{};
 };
 
 #ifdef FREEIMAGE_BIGENDIAN
@@ -445,6 +476,11 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
 /**
@@ -542,6 +578,20 @@ _assignPixel<32>(uint8_t* bits, const uint8_t* val, FIBOOL as24bit) {
 	}
 }
 
+/**
+Replicates the pixel stored at dst over count pixels, doubling the copied span at each step
+*/
+static inline void
+fillPixels(uint8_t *dst, int pixel_size, int count) {
+	const size_t size = (size_t)pixel_size * count;
+	size_t filled = pixel_size;
+	while (filled < size) {
+		const size_t n = MIN(filled, size - filled);
+		memcpy(dst + filled, dst, n);
+		filled += n;
+	}
+}
+
 /**
 Generic RLE loader
 */
@@ -565,7 +615,7 @@ loadRLE(FIBITMAP* dib, int width, int height, FreeImageIO* io, fi_handle handle,
 	long sz = ((eof - pixels_offset) / height);
 
 	// ...and allocate cache of this size (yields good results)
-	IOCache cache(io, handle, sz);
+	IOCache cache(io, handle, sz > 0 ? (size_t)sz : 0);
 
 	int x = 0, y = 0;
 
@@ -583,45 +633,47 @@ loadRLE(FIBITMAP* dib, int width, int height, FreeImageIO* io, fi_handle handle,
 		//packet_count might be corrupt, test if we are not about to write beyond the last image bit
 
 		if ((line_bits+x) + packet_count*pixel_size > dib_end) {
-			FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_CORRUPTED);
+			FreeImage_OutputMessageProcEx(s_format_id, FIMSG_PARSING, FI_MSG_ERROR_CORRUPTED);
 			// return what is left from the bitmap
 			return;
 		}
 
-		if (has_rle) {
-
-			// read a pixel value from file...
-			const uint8_t *val = cache.getBytes(file_pixel_size);
+		// read a pixel value or packet_count pixels from file
+		const uint8_t *val = cache.getBytes(has_rle ? file_pixel_size : packet_count * file_pixel_size);
 
-			//...and fill packet_count pixels with it
+		// packets may span several lines, fill them line segment by line segment
+		for (int remaining = packet_count; (remaining > 0) && (y < height); ) {
+			const int count = MIN(remaining, (line_size - x + pixel_size - 1) / pixel_size);
+			uint8_t *dst = line_bits + x;
 
-			for (int ix = 0; ix < packet_count; ix++) {
-				_assignPixel<bPP>((line_bits+x), val, as24bit);
-				x += pixel_size;
-
-				if (x >= line_size) {
-					x = 0;
-					y++;
-					line_bits = FreeImage_GetScanLine(dib, y);
+			if (has_rle) {
+				// assign the first pixel and replicate it
+				_assignPixel<bPP>(dst, val, as24bit);
+				if (pixel_size == 1) {
+					memset(dst + 1, *dst, count - 1);
+				} else {
+					fillPixels(dst, pixel_size, count);
+				}
+			} else if (bPP == 8) {
+				memcpy(dst, val, count);
+				val += count;
+			} else {
+				// no rle commpresion, copy pixels from file to dib
+				for (int ix = 0; ix < count; ix++) {
+					_assignPixel<bPP>(dst + ix * pixel_size, val, as24bit);
+					val += file_pixel_size;
 				}
 			}
 
-		} else {
-			// no rle commpresion
-
-			// copy packet_count pixels from file to dib
-			for (int ix = 0; ix < packet_count; ix++) {
-				const uint8_t *val = cache.getBytes(file_pixel_size);
-				_assignPixel<bPP>((line_bits+x), val, as24bit);
-				x += pixel_size;
-
-				if (x >= line_size) {
-					x = 0;
-					y++;
-					line_bits = FreeImage_GetScanLine(dib, y);
-				}
-			} //< packet_count
-		} //< has_rle
+			remaining -= count;
+			x += count * pixel_size;
+
+			if (x >= line_size) {
+				x = 0;
+				y++;
+				line_bits = FreeImage_GetScanLine(dib, y);
+			}
+		}
 	} //< while height
 }
 
@@ -1014,10 +1066,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 	}
 	catch (const char *message) {
-		FreeImage_OutputMessageProc(s_format_id, message);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(message), message);
 	}
 	catch (const std::bad_alloc &) {
-		FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
 	}
 	return nullptr;
 }
@@ -1038,36 +1090,6 @@ hasValidThumbnail(FIBITMAP* dib) {
 		&& FreeImage_GetHeight(thumbnail) <= 255;
 }
 
-/**
-Writes the ready RLE packet to buffer
-*/
-static inline void 
-flushPacket(uint8_t*& dest, unsigned pixel_size, uint8_t* packet_begin, uint8_t*& packet, uint8_t& packet_count, FIBOOL& has_rle) {
-	if (packet_count) {
-		const uint8_t type_bit = has_rle ? 0x80 : 0x0;
-		const uint8_t write_count = has_rle ? 1 : packet_count;
-
-		// build packet header: zero-based count + type bit
-		assert(packet_count >= 1);
-		uint8_t rle = packet_count - 1;
-		rle |= type_bit;
-
-		// write packet header
-		*dest = rle;
-		++dest;
-
-		// write packet data
-		memcpy(dest, packet_begin, write_count * pixel_size);
-		dest += write_count * pixel_size;
-
-		// reset state
-		packet_count = 0;
-		packet = packet_begin;
-		has_rle = FALSE;
-	}
-}
-
-
 static inline void 
 writeToPacket(uint8_t*& packet, const uint8_t* pixel, unsigned pixel_size) {
 	// Take care of channel and byte order here, because packet will be flushed straight to the file
@@ -1110,27 +1132,6 @@ writeToPacket(uint8_t*& packet, const uint8_t* pixel, unsigned pixel_size) {
 	packet += pixel_size;
 }
 
-static inline FIBOOL 
-isEqualPixel(uint8_t* lhs, uint8_t* rhs, unsigned pixel_size) {
-	switch (pixel_size) {
-		case 1:
-			return *lhs == *rhs;
-
-		case 2:
-			return *(uint16_t*)lhs == *(uint16_t*)rhs;
-
-		case 3:
-			return *(uint16_t*)lhs == *(uint16_t*)rhs && lhs[2] == rhs[2];
-
-		case 4:
-			return *(unsigned*)lhs == *(unsigned*)rhs;
-
-		default:
-			assert(FALSE);
-			return FALSE;
-	}
-}
-
 static void 
 saveRLE(FIBITMAP* dib, FreeImageIO* io, fi_handle handle) {
 	// Image is compressed line by line, packets don't span multiple lines (TGA2.0 recommendation)
@@ -1138,16 +1139,8 @@ saveRLE(FIBITMAP* dib, FreeImageIO* io, fi_handle handle) {
 	const unsigned width = FreeImage_GetWidth(dib);
 	const unsigned height = FreeImage_GetHeight(dib);
 	const unsigned pixel_size = FreeImage_GetBPP(dib)/8;
-	const unsigned line_size = FreeImage_GetLine(dib);
-
-	constexpr uint8_t max_packet_size = 128;
-	uint8_t packet_count = 0;
-	FIBOOL has_rle = FALSE;
 
-	// packet (compressed or not) to be written to line
-
-	auto packet_begin(std::make_unique<uint8_t[]>(max_packet_size * pixel_size));
-	auto *packet = packet_begin.get();
+	constexpr unsigned max_packet_size = 128;
 
 	// line to be written to disk
 	// Note: we need some extra bytes for anti-commpressed lines. The worst case is:
@@ -1160,90 +1153,33 @@ saveRLE(FIBITMAP* dib, FreeImageIO* io, fi_handle handle) {
 	const size_t extra_space = (size_t)ceil(width / 3.0);
 	auto line_begin(std::make_unique<uint8_t[]>(width * pixel_size + extra_space));
 
-	auto current(std::make_unique<uint8_t[]>(pixel_size));
-	auto next(std::make_unique<uint8_t[]>(pixel_size));
-
 	for (unsigned y = 0; y < height; y++) {
 		const uint8_t *bits = FreeImage_GetScanLine(dib, y);
 
 		// rewind line pointer
 		auto *line = line_begin.get();
 
-		for (unsigned x = 0; x < line_size; x += pixel_size) {
-
-			AssignPixel(current.get(), (bits + x), pixel_size);
+		for (unsigned x = 0; x < width; ) {
+			const uint8_t *pixel = bits + x * pixel_size;
+			const unsigned remaining = width - x;
 
-			// read next pixel from dib
+			// a packet starting with two equal pixels is a rle packet, other packets end before two equal pixels
+			const unsigned run = RLERunLength(pixel, MIN(remaining, max_packet_size), pixel_size);
 
-			if (x + pixel_size < line_size) {
-				AssignPixel(next.get(), (bits + x + pixel_size), pixel_size);
+			if (run > 1) {
+				// packet header: zero-based count + type bit
+				*line++ = (uint8_t)(0x80 | (run - 1));
+				writeToPacket(line, pixel, pixel_size);
+				x += run;
 
 			} else {
-				// last pixel in line
-
-				// include current pixel and flush
-				if (!has_rle) {
-
-					writeToPacket(packet, current.get(), pixel_size);
+				const unsigned count = MIN(max_packet_size, RLELiteralLength(pixel, MIN(remaining, max_packet_size + 1), pixel_size, 2));
 
+				*line++ = (uint8_t)(count - 1);
+				for (unsigned ix = 0; ix < count; ix++) {
+					writeToPacket(line, pixel + ix * pixel_size, pixel_size);
 				}
-
-				assert(packet_count < max_packet_size);
-
-				++packet_count;
-
-				flushPacket(line, pixel_size, packet_begin.get(), packet, packet_count, has_rle);
-
-				// start anew on next line
-				break;
-			}
-
-			if (isEqualPixel(current.get(), next.get(), pixel_size)) {
-
-				// has rle
-
-				if (!has_rle) {
-					// flush non rle packet
-
-					flushPacket(line, pixel_size, packet_begin.get(), packet, packet_count, has_rle);
-
-					// start a rle packet
-
-					has_rle = TRUE;
-
-					writeToPacket(packet, current.get(), pixel_size);
-				}
-
-				// otherwise do nothing. We will just increase the count at the end
-
-			} else {
-
-				// no rle
-
-				if (has_rle) {
-					// flush rle packet
-
-					// include current pixel first
-					assert(packet_count < max_packet_size);
-					++packet_count;
-
-					flushPacket(line, pixel_size, packet_begin.get(), packet, packet_count, has_rle);
-
-					// start anew on the next pixel
-					continue;
-
-				} else {
-
-					writeToPacket(packet, current.get(), pixel_size);
-				}
-			}
-
-			// increase counter on every pixel
-
-			++packet_count;
-
-			if (packet_count == max_packet_size) {
-				flushPacket(line, pixel_size, packet_begin.get(), packet, packet_count, has_rle);
+				x += count;
 			}
 		}//for width
 
@@ -1516,4 +1452,5 @@ InitTARGA(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -48,6 +48,15 @@
 
 #include "FreeImageIO.h"
 #include "PSDParser.h"
+#include "FaxDecoder.h"
+#include "FreeImage/ThreadPool.h"
+
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <vector>
 
 // --------------------------------------------------------------------------
 // GeoTIFF profile (see XTIFF.cpp)
@@ -66,7 +75,7 @@ FIBOOL tiff_write_exif_tags(TIFF *tif, TagLib::MDMODEL md_model, FIBITMAP *dib);
 //   LogLuv conversion functions interface (see TIFFLogLuv.cpp)
 // --------------------------------------------------------------------------
 void tiff_ConvertLineXYZToRGB(uint8_t *target, uint8_t *source, double stonits, int width_in_pixels);
-void tiff_ConvertLineRGBToXYZ(uint8_t *target, uint8_t *source, int width_in_pixels);
+void tiff_ConvertLineRGBToXYZ(uint8_t *target, const uint8_t *source, int width_in_pixels);
 
 // ----------------------------------------------------------
 
@@ -85,6 +94,8 @@ typedef enum {
 //   local prototypes
 // ----------------------------------------------------------
 
+static void InitializeTIFF();
+
 static tmsize_t _tiffReadProc(thandle_t handle, void* buf, tmsize_t size);
 static tmsize_t _tiffWriteProc(thandle_t handle, void* buf, tmsize_t size);
 static toff_t _tiffSeekProc(thandle_t handle, toff_t off, int whence);
@@ -126,11 +137,13 @@ static void ReadThumbnail(FreeImageIO *io, fi_handle handle, void *data, TIFF *t
 
 static int s_format_id;
 
-typedef struct {
-    FreeImageIO *io;
-	fi_handle handle;
-	TIFF *tif;
-} fi_TIFFIO;
+struct fi_TIFFIO {
+	FreeImageIO *io{};
+	fi_handle handle{};
+	TIFF *tif{};
+	std::vector<toff_t> dir_offsets;	// offsets of the IFDs walked so far, page i starts at dir_offsets[i]
+	bool dir_complete{ false };			// dir_offsets holds every IFD of the file
+};
 
 // ----------------------------------------------------------
 //   libtiff interface 
@@ -189,6 +202,8 @@ Open a TIFF file descriptor for reading or writing
 */
 TIFF *
 TIFFFdOpen(thandle_t handle, const char *name, const char *mode) {
+	InitializeTIFF();
+
 	// Open the file; the callback will set everything up
 	TIFF *tif = TIFFClientOpen(name, mode, handle,
 	    _tiffReadProc, _tiffWriteProc, _tiffSeekProc, _tiffCloseProc,
@@ -218,6 +233,20 @@ msdosErrorHandler(const char* module, const char* fmt, va_list ap) {
 	*/
 }
 
+/**
+Sets up libtiff before the first TIFF is opened: FreeImage handlers and the callback for extended TIFF directory tag support (see XTIFF.cpp).
+Done on first use rather than in InitTIFF, so that applications which never touch a TIFF file don't pay for it in FreeImage_Initialise.
+*/
+static void
+InitializeTIFF() {
+	static std::once_flag s_initialized;
+	std::call_once(s_initialized, [] {
+		_TIFFwarningHandler = msdosWarningHandler;
+		_TIFFerrorHandler = msdosErrorHandler;
+		XTIFFInitialize();
+	});
+}
+
 // ----------------------------------------------------------
 
 #define CVT(x)      (((x) * 255L) / ((1L<<16)-1))
@@ -631,12 +660,14 @@ WriteCompression(TIFF *tiff, uint16_t bitspersample, uint16_t samplesperpixel, u
 	} else if ((flags & TIFF_JPEG) == TIFF_JPEG) {
 		if (((bitsperpixel == 8) && (photometric != PHOTOMETRIC_PALETTE)) || (bitsperpixel == 24)) {
 			compression = COMPRESSION_JPEG;
-			// RowsPerStrip must be multiple of 8 for JPEG
-			uint32_t rowsperstrip = (uint32_t) -1;
-			rowsperstrip = TIFFDefaultStripSize(tiff, rowsperstrip);
-            rowsperstrip = rowsperstrip + (8 - (rowsperstrip % 8));
-			// overwrite previous RowsPerStrip
-			TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
+			if (!TIFFIsTiled(tiff)) {
+				// RowsPerStrip must be multiple of 8 for JPEG (tiles are multiple of 16)
+				uint32_t rowsperstrip = (uint32_t) -1;
+				rowsperstrip = TIFFDefaultStripSize(tiff, rowsperstrip);
+				rowsperstrip = rowsperstrip + (8 - (rowsperstrip % 8));
+				// overwrite previous RowsPerStrip
+				TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
+			}
 		} else {
 			// default to LZW
 			compression = COMPRESSION_LZW;
@@ -672,6 +703,14 @@ WriteCompression(TIFF *tiff, uint16_t bitspersample, uint16_t samplesperpixel, u
 
 	TIFFSetField(tiff, TIFFTAG_COMPRESSION, compression);
 
+	if ((compression == COMPRESSION_DEFLATE) || (compression == COMPRESSION_ADOBE_DEFLATE)) {
+		// level set by FreeImage_SetZLibOptions, LibTIFF has no strategy setting
+		int level = -1;
+		if (FreeImage_GetZLibOptions(FIF_TIFF, &level, nullptr) && (level >= 0)) {
+			TIFFSetField(tiff, TIFFTAG_ZIPQUALITY, level);
+		}
+	}
+
 	if (compression == COMPRESSION_LZW) {
 		// This option is only meaningful with LZW compression: a predictor value of 2 
 		// causes each scanline of the output image to undergo horizontal differencing 
@@ -693,10 +732,12 @@ WriteCompression(TIFF *tiff, uint16_t bitspersample, uint16_t samplesperpixel, u
 		}
 	}
 	else if ((compression == COMPRESSION_CCITTFAX3) || (compression == COMPRESSION_CCITTFAX4)) {
-		uint32_t imageLength = 0;
-		TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &imageLength);
-		// overwrite previous RowsPerStrip
-		TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, imageLength);
+		if (!TIFFIsTiled(tiff)) {
+			uint32_t imageLength = 0;
+			TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &imageLength);
+			// overwrite previous RowsPerStrip
+			TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, imageLength);
+		}
 
 		if (compression == COMPRESSION_CCITTFAX3) {
 			// try to be compliant with the TIFF Class F specification
@@ -774,13 +815,15 @@ tiff_read_exif_profile(FreeImageIO *io, fi_handle handle, TIFF *tiff, FIBITMAP *
 	toff_t exif_offset = 0;
 
 	// read EXIF-TIFF tags
-	bResult = tiff_read_exif_tags(tiff, TagLib::EXIF_MAIN, dib);
+	if (FreeImage_LoadsMetadataModel(FIMD_EXIF_MAIN)) {
+		bResult = tiff_read_exif_tags(tiff, TagLib::EXIF_MAIN, dib);
+	}
 
 	// get the IFD offset
-	if (TIFFGetField(tiff, TIFFTAG_EXIFIFD, &exif_offset)) {
+	if (FreeImage_LoadsMetadataModel(FIMD_EXIF_EXIF) && TIFFGetField(tiff, TIFFTAG_EXIFIFD, &exif_offset)) {
 
 		const long tell_pos = io->tell_proc(handle);
-		const uint16_t cur_dir = TIFFCurrentDirectory(tiff);
+		const toff_t cur_offset = TIFFCurrentDirOffset(tiff);
 
 		// read EXIF tags
 		if (TIFFReadEXIFDirectory(tiff, exif_offset)) {
@@ -789,7 +832,7 @@ tiff_read_exif_profile(FreeImageIO *io, fi_handle handle, TIFF *tiff, FIBITMAP *
 		}
 
 		io->seek_proc(handle, tell_pos, SEEK_SET);
-		TIFFSetDirectory(tiff, cur_dir);
+		TIFFSetSubDirectory(tiff, cur_offset);
 	}
 
 	return bResult;
@@ -805,10 +848,14 @@ ReadMetadata(FreeImageIO *io, fi_handle handle, TIFF *tiff, FIBITMAP *dib) {
 	tiff_read_iptc_profile(tiff, dib);
 
 	// Adobe XMP
-	tiff_read_xmp_profile(tiff, dib);
+	if (FreeImage_LoadsMetadataModel(FIMD_XMP)) {
+		tiff_read_xmp_profile(tiff, dib);
+	}
 
 	// GeoTIFF
-	tiff_read_geotiff_profile(tiff, dib);
+	if (FreeImage_LoadsMetadataModel(FIMD_GEOTIFF)) {
+		tiff_read_geotiff_profile(tiff, dib);
+	}
 
 	// Exif-TIFF
 	tiff_read_exif_profile(io, handle, tiff, dib);
@@ -995,12 +1042,17 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
 static void * DLL_CALLCONV
 Open(FreeImageIO *io, fi_handle handle, FIBOOL read) {
 	// wrapper for TIFF I/O
-	auto *fio = static_cast<fi_TIFFIO*>(malloc(sizeof(fi_TIFFIO)));
+	auto *fio = new(std::nothrow) fi_TIFFIO;
 	if (!fio) return nullptr;
 	fio->io = io;
 	fio->handle = handle;
@@ -1008,12 +1060,12 @@ Open(FreeImageIO *io, fi_handle handle, FIBOOL read) {
 	if (read) {
 		fio->tif = TIFFFdOpen((thandle_t)fio, "", "r");
 	} else {
-		// mode = "w"	: write Classic TIFF
-		// mode = "w8"	: write Big TIFF
-		fio->tif = TIFFFdOpen((thandle_t)fio, "", "w");
+		// the TIFF header is written by the first Save, once the save flags and the size are known
+		fio->tif = nullptr;
+		return fio;
 	}
 	if (!fio->tif) {
-		free(fio);
+		delete fio;
 		fio = nullptr;
 		FreeImage_OutputMessageProc(s_format_id, "Error while opening TIFF: data is invalid");
 	}
@@ -1024,25 +1076,74 @@ static void DLL_CALLCONV
 Close(FreeImageIO *io, fi_handle handle, void *data) {
 	if (data) {
 		fi_TIFFIO *fio = (fi_TIFFIO*)data;
-		TIFFClose(fio->tif);
-		free(fio);
+		if (fio->tif) {
+			TIFFClose(fio->tif);
+		}
+		delete fio;
 	}
 }
 
 // ----------------------------------------------------------
 
+/**
+Makes page the current directory of a file opened for reading.
+The offsets of the IFDs are recorded as the chain is walked, so that a page
+seen once is reached with a single TIFFSetSubDirectory instead of walking
+the chain from the first IFD as TIFFSetDirectory does.
+*/
+static FIBOOL
+SelectPage(fi_TIFFIO *fio, int page) {
+	TIFF *tif = fio->tif;
+	if (!tif || (page < 0)) {
+		return FALSE;
+	}
+	auto& offsets = fio->dir_offsets;
+	if ((size_t)page < offsets.size()) {
+		return TIFFSetSubDirectory(tif, offsets[page]) ? TRUE : FALSE;
+	}
+	if (fio->dir_complete) {
+		return FALSE;
+	}
+
+	// extend the table from the last known IFD
+	if (offsets.empty()) {
+		if (!TIFFSetDirectory(tif, 0)) {
+			return FALSE;
+		}
+		offsets.push_back(TIFFCurrentDirOffset(tif));
+	} else if (!TIFFSetSubDirectory(tif, offsets.back())) {
+		return FALSE;
+	}
+	while ((size_t)page >= offsets.size()) {
+		if (!TIFFReadDirectory(tif)) {
+			fio->dir_complete = true;
+			return FALSE;
+		}
+		offsets.push_back(TIFFCurrentDirOffset(tif));
+	}
+	return TRUE;
+}
+
 static int DLL_CALLCONV
 PageCount(FreeImageIO *io, fi_handle handle, void *data) {
 	if (data) {
 		fi_TIFFIO *fio = (fi_TIFFIO*)data;
-		TIFF *tif = (TIFF *)fio->tif;
-		int nr_ifd = 0;
-
-		do {
-			nr_ifd++;
-		} while (TIFFReadDirectory(tif));
-
-		return nr_ifd;
+		if (!fio->tif) {
+			return 0;
+		}
+		try {
+			if (!fio->dir_complete) {
+				SelectPage(fio, INT_MAX);
+			}
+			// leave the first page current, as after Open
+			if (!fio->dir_offsets.empty()) {
+				TIFFSetSubDirectory(fio->tif, fio->dir_offsets[0]);
+			}
+			return (int)fio->dir_offsets.size();
+		}
+		catch (const std::bad_alloc&) {
+			FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+		}
 	}
 
 	return 0;
@@ -1239,14 +1340,15 @@ ReadThumbnail(FreeImageIO *io, fi_handle handle, void *data, TIFF *tiff, FIBITMA
 
 		// This will also read the first (and only) subIFD from a Photoshop-created "pyramid" file.
 		// Subsequent, smaller images are 'nextIFD' in that subIFD. Currently we only load the first one. 
+		// Files saved with TIFF_PYRAMID store their levels first, the thumbnail or the smallest level is the last subIFD.
 		
 		if (TIFFGetField(tiff, TIFFTAG_SUBIFD, &subIFD_count, &subIFD_offsets)) {
 			if (subIFD_count > 0) {
 				// save current position
 				const long tell_pos = io->tell_proc(handle);
-				const uint16_t cur_dir = TIFFCurrentDirectory(tiff);
+				const toff_t cur_offset = TIFFCurrentDirOffset(tiff);
 				
-				if (TIFFSetSubDirectory(tiff, subIFD_offsets[0])) {
+				if (TIFFSetSubDirectory(tiff, subIFD_offsets[subIFD_count - 1])) {
 					// load the thumbnail
 					int page = -1; 
 					int flags = TIFF_DEFAULT;
@@ -1257,7 +1359,7 @@ ReadThumbnail(FreeImageIO *io, fi_handle handle, void *data, TIFF *tiff, FIBITMA
 
 				// restore current position
 				io->seek_proc(handle, tell_pos, SEEK_SET);
-				TIFFSetDirectory(tiff, cur_dir);
+				TIFFSetSubDirectory(tiff, cur_offset);
 			}
 		}
 	}
@@ -1308,10 +1410,250 @@ template <typename DT> static void DecodeStrip(const uint8_t *buf, const tmsize_
 	}
 }
 
+/**
+Bilevel CCITT strips are decoded with FaxDecoder rather than libtiff, straight from the raw data into the rows.
+@param coding Receives the coding of the strips
+@return Returns FALSE if the strips are left to libtiff (other compressions, uncompressed mode of the CCITT codings)
+*/
+static FIBOOL 
+GetFaxCoding(TIFF *tif, uint16_t compression, uint16_t bitspersample, uint16_t samplesperpixel, FaxCoding& coding) {
+	if ((bitspersample != 1) || (samplesperpixel != 1)) {
+		return FALSE;
+	}
+	uint32_t options = 0;
+	switch (compression) {
+		case COMPRESSION_CCITTRLE:
+			coding = FaxCoding::RLE;
+			return TRUE;
+		case COMPRESSION_CCITTFAX3:
+			TIFFGetField(tif, TIFFTAG_GROUP3OPTIONS, &options);
+			coding = (options & GROUP3OPT_2DENCODING) ? FaxCoding::G3_2D : FaxCoding::G3_1D;
+			return (options & GROUP3OPT_UNCOMPRESSED) ? FALSE : TRUE;
+		case COMPRESSION_CCITTFAX4:
+			TIFFGetField(tif, TIFFTAG_GROUP4OPTIONS, &options);
+			coding = FaxCoding::G4;
+			return (options & GROUP4OPT_UNCOMPRESSED) ? FALSE : TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/**
+Decodes the rows of a CCITT strip to bits, each next row dst_pitch bytes below (DIB order).
+A corrupted row is replaced with the previous good one, missing rows are left white.
+@param raw Buffer of the raw strip data
+@return Returns FALSE if the strip is corrupted
+*/
+static FIBOOL 
+DecodeFaxStrip(TIFF *tif, uint32_t strip, FaxCoding coding, uint32_t width, uint8_t *bits, unsigned dst_pitch, uint32_t rows, std::vector<uint8_t>& raw) {
+	const tmsize_t size = TIFFRawStripSize(tif, strip);
+	if (size <= 0) {
+		return FALSE;
+	}
+	raw.resize(size);
+	if (TIFFReadRawStrip(tif, strip, raw.data(), size) != size) {
+		return FALSE;
+	}
+	uint16_t fillorder = FILLORDER_MSB2LSB;
+	TIFFGetFieldDefaulted(tif, TIFFTAG_FILLORDER, &fillorder);
+
+	FaxDecoder decoder(raw.data(), raw.size(), width, coding, fillorder == FILLORDER_LSB2MSB);
+	const unsigned line = (width + 7) / 8;
+	const uint8_t *good = nullptr;
+	FIBOOL valid = TRUE;
+
+	for (uint32_t y = 0; y < rows; y++, bits -= dst_pitch) {
+		switch (decoder.DecodeRow(bits)) {
+			case FaxDecoder::Status::eRow:
+				good = bits;
+				break;
+			case FaxDecoder::Status::eError:
+				valid = FALSE;
+				if (good) {
+					memcpy(bits, good, line);
+				} else {
+					memset(bits, 0, line);
+				}
+				break;
+			case FaxDecoder::Status::eEnd:
+				valid = FALSE;
+				memset(bits, 0, line);
+				break;
+		}
+	}
+	return valid;
+}
+
+// --------------------------------------------------------------------------
+//   Parallel strip and tile decoding
 // --------------------------------------------------------------------------
 
-static FIBITMAP * DLL_CALLCONV
-Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+/**
+TIFF handles opened on the current directory of a file being loaded, one per decoding thread. 
+Each handle keeps its own file position and the reads of all handles are serialized, 
+so that the strips and tiles are read one at a time but decompressed concurrently.
+*/
+class TIFFHandlePool {
+public:
+	TIFFHandlePool(FreeImageIO *io, fi_handle handle, TIFF *tif)
+		: m_io(io), m_handle(handle), m_dir_offset(TIFFCurrentDirOffset(tif)) {
+		const long position = io->tell_proc(handle);
+		io->seek_proc(handle, 0, SEEK_END);
+		m_size = (toff_t)io->tell_proc(handle);
+		io->seek_proc(handle, position, SEEK_SET);
+		m_position = position;
+	}
+
+	~TIFFHandlePool() {
+		for (TIFF *tif : m_handles) {
+			TIFFClose(tif);
+		}
+		// the loading handle expects the file where it left it
+		m_io->seek_proc(m_handle, m_position, SEEK_SET);
+	}
+
+	/**
+	Returns an idle handle, or opens a new one. Returns nullptr on failure
+	*/
+	TIFF* Acquire() {
+		Reader *reader_ptr = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_idle.empty()) {
+				TIFF *tif = m_idle.back();
+				m_idle.pop_back();
+				return tif;
+			}
+			m_readers.push_back(std::make_unique<Reader>(Reader{ this, 0 }));
+			reader_ptr = m_readers.back().get();
+		}
+		InitializeTIFF();
+		TIFF *tif = TIFFClientOpen("", "r", (thandle_t)reader_ptr, ReadProc, WriteProc, SeekProc, CloseProc, SizeProc, _tiffMapProc, _tiffUnmapProc);
+		if (tif && !TIFFSetSubDirectory(tif, m_dir_offset)) {
+			TIFFClose(tif);
+			tif = nullptr;
+		}
+		if (tif) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_handles.push_back(tif);
+		}
+		return tif;
+	}
+
+	void Release(TIFF *tif) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_idle.push_back(tif);
+	}
+
+private:
+	struct Reader {
+		TIFFHandlePool *pool;
+		toff_t position;
+	};
+
+	static tmsize_t ReadProc(thandle_t handle, void *buf, tmsize_t size) {
+		Reader *reader = (Reader*)handle;
+		TIFFHandlePool *pool = reader->pool;
+		std::lock_guard<std::mutex> lock(pool->m_io_mutex);
+		if (pool->m_io->seek_proc(pool->m_handle, (long)reader->position, SEEK_SET) != 0) {
+			return 0;
+		}
+		const tmsize_t read = (tmsize_t)pool->m_io->read_proc(buf, 1, (unsigned)size, pool->m_handle);
+		reader->position += read;
+		return read;
+	}
+
+	static tmsize_t WriteProc(thandle_t, void*, tmsize_t) {
+		return 0;
+	}
+
+	static toff_t SeekProc(thandle_t handle, toff_t off, int whence) {
+		Reader *reader = (Reader*)handle;
+		switch (whence) {
+			case SEEK_SET:
+				reader->position = off;
+				break;
+			case SEEK_CUR:
+				reader->position += off;
+				break;
+			case SEEK_END:
+				reader->position = reader->pool->m_size + off;
+				break;
+		}
+		return reader->position;
+	}
+
+	static int CloseProc(thandle_t) {
+		return 0;
+	}
+
+	static toff_t SizeProc(thandle_t handle) {
+		return ((Reader*)handle)->pool->m_size;
+	}
+
+	FreeImageIO *m_io;
+	fi_handle m_handle;
+	toff_t m_dir_offset;
+	toff_t m_size{};
+	long m_position{};
+	std::mutex m_mutex;			// handles lists
+	std::mutex m_io_mutex;		// reads
+	std::vector<std::unique_ptr<Reader>> m_readers;
+	std::vector<TIFF*> m_handles;
+	std::vector<TIFF*> m_idle;
+};
+
+/**
+Calls decode(tif, buffer, first, last) for bands of the count strips (or rows of tiles) of the current directory 
+on the library thread pool, each band with its own TIFF handle and a buffer_size bytes buffer. 
+Uncompressed and small images are not worth it, they are left to the caller.
+@return Returns TRUE if the strips were decoded, FALSE if the caller has to decode them
+*/
+static FIBOOL 
+DecodeParallel(fi_TIFFIO *fio, uint32_t count, tmsize_t buffer_size, const std::function<void(TIFF*, uint8_t*, uint32_t, uint32_t)>& decode) {
+	// below this size of decoded data, opening handles costs more than it saves
+	const uint64_t min_parallel_size = 1024 * 1024;
+
+	TIFF *tif = fio->tif;
+	uint16_t compression = COMPRESSION_NONE;
+	TIFFGetFieldDefaulted(tif, TIFFTAG_COMPRESSION, &compression);
+
+	if ((compression == COMPRESSION_NONE) || (count < 2) || (buffer_size <= 0) || ((uint64_t)buffer_size * count < min_parallel_size)) {
+		return FALSE;
+	}
+	if ((FreeImage_GetThreadCount() < 2) || ThreadPool::IsWorkerThread()) {
+		return FALSE;
+	}
+
+	TIFFHandlePool pool(fio->io, fio->handle, tif);
+	ParallelFor(0, count, 1, [&](unsigned first, unsigned last) {
+		TIFF *band_tif = pool.Acquire();
+		if (!band_tif) {
+			throw FI_MSG_ERROR_PARSING;
+		}
+		auto buffer(std::make_unique<uint8_t[]>(buffer_size));
+		decode(band_tif, buffer.get(), first, last);
+		pool.Release(band_tif);
+	});
+	return TRUE;
+}
+
+// --------------------------------------------------------------------------
+
+/**
+Rectangle of the image to load (in pixels from the top left corner, right and bottom excluded), see FreeImage_LoadRegion
+*/
+struct TIFFRegion {
+	uint32_t left, top, right, bottom;
+};
+
+/**
+Loads a page of a TIFF file, or the region of it when region isn't nullptr.
+Contiguous strips and tiles only decode the strips or tiles intersecting the region, 
+other layouts are decoded then cropped.
+*/
+static FIBITMAP *
+LoadTIFF(FreeImageIO *io, fi_handle handle, int page, int flags, void *data, const TIFFRegion *region) {
 	if (!handle || !data ) {
 		return nullptr;
 	}
@@ -1336,11 +1678,22 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		tif = fio->tif;
 
 		if (page != -1) {
-			if (!tif || !TIFFSetDirectory(tif, (uint16_t)page)) {
+			if (!SelectPage(fio, page)) {
 				throw "Error encountered while opening TIFF file";
 			}
 		}
 
+		// select a reduced resolution level of a pyramid
+
+		const int level = (flags >> 24) & 0x3F;
+		if (level > 0) {
+			uint16_t subIFD_count = 0;
+			toff_t *subIFD_offsets{};
+			if (!TIFFGetField(tif, TIFFTAG_SUBIFD, &subIFD_count, &subIFD_offsets) || (level > subIFD_count) || !TIFFSetSubDirectory(tif, subIFD_offsets[level - 1])) {
+				throw "Pyramid level not found in TIFF file";
+			}
+		}
+
 		const FIBOOL asCMYK = (flags & TIFF_CMYK) == TIFF_CMYK;
 
 		// first, get the photometric, the compression and basic metadata
@@ -1371,6 +1724,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		TIFFGetField(tif, TIFFTAG_ICCPROFILE, &iccSize, &iccBuf);
 		TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planar_config);
 
+		if (region && ((region->right > width) || (region->bottom > height))) {
+			// the rectangle isn't inside the image
+			throw (char*)nullptr;
+		}
+
 		// check for unsupported formats
 		// ---------------------------------------------------------------------------------
 
@@ -1394,6 +1752,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		// ---------------------------------------------------------------------------------
 
 		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
+
+		// position of the dib in the image, when only the strips or tiles of a region are decoded
+		uint32_t dib_left = 0;
+		uint32_t dib_top = 0;
+
 		if (loadMethod == LoadAsRBGA) {
 			// ---------------------------------------------------------------------------------
 			// RGB[A] loading using the TIFFReadRGBAImage() API
@@ -1814,9 +2177,17 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			// Generic loading
 			// ---------------------------------------------------------------------------------
 
+			// decode the rows [y0, y1) of the strips [first_strip, last_strip), intersecting the region if any
+			const uint32_t strip_rows = std::min(rowsperstrip, height);
+			const uint32_t first_strip = region ? region->top / strip_rows : 0;
+			const uint32_t last_strip = (region ? region->bottom + strip_rows - 1 : height + strip_rows - 1) / strip_rows;
+			const uint32_t y0 = first_strip * strip_rows;
+			const uint32_t y1 = std::min(last_strip * strip_rows, height);
+			dib_top = y0;
+
 			// create a new DIB
 			const uint16_t chCount = std::min<uint16_t>(samplesperpixel, 4);
-			dib.reset(CreateImageType(header_only, image_type, width, height, bitspersample, chCount));
+			dib.reset(CreateImageType(header_only, image_type, width, y1 - y0, bitspersample, chCount));
 			if (!dib) {
 				throw FI_MSG_ERROR_DIB_MEMORY;
 			}
@@ -1840,67 +2211,89 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				const unsigned srcBits = bitspersample * samplesperpixel;
 
 				// In the tiff file the lines are save from up to down 
-				// In a DIB the lines must be saved from down to up
-
-				uint8_t *bits = FreeImage_GetScanLine(dib.get(), height - 1);
-
+				// In a DIB the lines must be saved from down to up,
 				// read the tiff lines and save them in the DIB
 
-				auto buf(std::make_unique<uint8_t[]>(TIFFStripSize(tif)));
-
-				FIBOOL bThrowMessage = FALSE;
+				std::atomic<bool> bThrowMessage{ false };
 
 				if (planar_config == PLANARCONFIG_CONTIG) {
 
-					for (uint32_t y = 0; y < height; y += rowsperstrip) {
-						const uint32_t rows = std::min(height - y, rowsperstrip);
+					FaxCoding fax_coding{};
+					const FIBOOL fax = GetFaxCoding(tif, compression, bitspersample, samplesperpixel, fax_coding) && (src_line == dst_line);
 
-						if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, y, 0), buf.get(), rows * src_line) == -1) {
-							// ignore errors as they can be frequent and not really valid errors, especially with fax images
-							bThrowMessage = TRUE;
-							/*
-							throw FI_MSG_ERROR_PARSING;
-							*/
-						}
-						if (src_line == dst_line) {
-							// channel count match
-							for (uint32_t l = 0; l < rows; l++) {
-								memcpy(bits, buf.get() + l * src_line, src_line);
-								bits -= dst_pitch;
+					// decode the strips of rows [first, last) with strip_tif into buf
+					auto decodeStrips = [&](TIFF *strip_tif, uint8_t *buf, uint32_t first, uint32_t last) {
+						uint8_t *bits = FreeImage_GetScanLine(dib.get(), y1 - 1 - first);
+						std::vector<uint8_t> raw;
+
+						for (uint32_t y = first; y < last; y += rowsperstrip) {
+							const uint32_t rows = std::min(last - y, rowsperstrip);
+
+							if (fax) {
+								if (!DecodeFaxStrip(strip_tif, TIFFComputeStrip(strip_tif, y, 0), fax_coding, width, bits, dst_pitch, rows, raw)) {
+									bThrowMessage = true;
+								}
+								bits -= rows * dst_pitch;
+								continue;
 							}
-						}
-						else {
-							if (srcBpp * 8 == srcBits) {
+							if (TIFFReadEncodedStrip(strip_tif, TIFFComputeStrip(strip_tif, y, 0), buf, rows * src_line) == -1) {
+								// ignore errors as they can be frequent and not really valid errors, especially with fax images
+								bThrowMessage = true;
+								/*
+								throw FI_MSG_ERROR_PARSING;
+								*/
+							}
+							if (src_line == dst_line) {
+								// channel count match
 								for (uint32_t l = 0; l < rows; l++) {
-									for (uint8_t* pixel = bits, *src_pixel = buf.get() + l * src_line; pixel < bits + dst_pitch; pixel += Bpp, src_pixel += srcBpp) {
-										AssignPixel(pixel, src_pixel, Bpp);
-									}
+									memcpy(bits, buf + l * src_line, src_line);
 									bits -= dst_pitch;
 								}
 							}
-							else { // not whole number of bytes
-								if (bitspersample <= 8) {
-									DecodeStrip<uint8_t>(buf.get(), src_line, bits, dst_pitch, rows, 0, 1, bitspersample);
-								}
-								else if (bitspersample <= 16) {
-									DecodeStrip<uint16_t>(buf.get(), src_line, bits, dst_pitch, rows, 0, 1, bitspersample);
+							else {
+								if (srcBpp * 8 == srcBits) {
+									for (uint32_t l = 0; l < rows; l++) {
+										for (uint8_t* pixel = bits, *src_pixel = buf + l * src_line; pixel < bits + dst_pitch; pixel += Bpp, src_pixel += srcBpp) {
+											AssignPixel(pixel, src_pixel, Bpp);
+										}
+										bits -= dst_pitch;
+									}
 								}
-								else {
-									throw "Unsupported number of bits per sample";
+								else { // not whole number of bytes
+									if (bitspersample <= 8) {
+										DecodeStrip<uint8_t>(buf, src_line, bits, dst_pitch, rows, 0, 1, bitspersample);
+									}
+									else if (bitspersample <= 16) {
+										DecodeStrip<uint16_t>(buf, src_line, bits, dst_pitch, rows, 0, 1, bitspersample);
+									}
+									else {
+										throw "Unsupported number of bits per sample";
+									}
+									bits -= rows * dst_pitch;
 								}
-								bits -= rows * dst_pitch;
 							}
 						}
+					};
+
+					// strips are compressed independently, decode bands of strips in parallel when worth it
+					const FIBOOL parallel = DecodeParallel(fio, last_strip - first_strip, TIFFStripSize(tif), [&](TIFF *strip_tif, uint8_t *buf, uint32_t first, uint32_t last) {
+						decodeStrips(strip_tif, buf, (first_strip + first) * strip_rows, std::min((first_strip + last) * strip_rows, y1));
+					});
+					if (!parallel) {
+						auto buf(std::make_unique<uint8_t[]>(TIFFStripSize(tif)));
+						decodeStrips(tif, buf.get(), y0, y1);
 					}
 				}
 				else if (planar_config == PLANARCONFIG_SEPARATE) {
 
+					auto buf(std::make_unique<uint8_t[]>(TIFFStripSize(tif)));
+
 					const unsigned Bpc = bitspersample / 8;
-					uint8_t* dib_strip = bits;
+					uint8_t* dib_strip = FreeImage_GetScanLine(dib.get(), y1 - y0 - 1);
 					// - loop for strip blocks -
 
-					for (uint32_t y = 0; y < height; y += rowsperstrip) {
-						const uint32_t strips = std::min(height - y, rowsperstrip);
+					for (uint32_t y = y0; y < y1; y += rowsperstrip) {
+						const uint32_t strips = std::min(y1 - y, rowsperstrip);
 
 						// - loop for channels (planes) -
 
@@ -1908,7 +2301,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 							if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, y, sample), buf.get(), strips * src_line) == -1) {
 								// ignore errors as they can be frequent and not really valid errors, especially with fax images
-								bThrowMessage = TRUE;
+								bThrowMessage = true;
 							}
 
 							if (sample >= chCount) {
@@ -1977,10 +2370,22 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			// ---------------------------------------------------------------------------------
 
 			uint32_t tileWidth, tileHeight;
-			uint32_t src_line = 0;
+
+			// get the tile geometry
+			if (!TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tileWidth) || !TIFFGetField(tif, TIFFTAG_TILELENGTH, &tileHeight)) {
+				throw "Invalid tiled TIFF image";
+			}
+
+			// decode the tiles of [x0, x1) x [y0, y1), intersecting the region if any
+			const uint32_t x0 = region ? (region->left / tileWidth) * tileWidth : 0;
+			const uint32_t y0 = region ? (region->top / tileHeight) * tileHeight : 0;
+			const uint32_t x1 = region ? std::min((region->right + tileWidth - 1) / tileWidth * tileWidth, width) : width;
+			const uint32_t y1 = region ? std::min((region->bottom + tileHeight - 1) / tileHeight * tileHeight, height) : height;
+			dib_left = x0;
+			dib_top = y0;
 
 			// create a new DIB
-			dib.reset(CreateImageType( header_only, image_type, width, height, bitspersample, samplesperpixel));
+			dib.reset(CreateImageType( header_only, image_type, x1 - x0, y1 - y0, bitspersample, samplesperpixel));
 			if (!dib) {
 				throw FI_MSG_ERROR_DIB_MEMORY;
 			}
@@ -1993,11 +2398,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			ReadPalette(tif, photometric, bitspersample, dib.get());
 
-			// get the tile geometry
-			if (!TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tileWidth) || !TIFFGetField(tif, TIFFTAG_TILELENGTH, &tileHeight)) {
-				throw "Invalid tiled TIFF image";
-			}
-
 			// read the tiff lines and save them in the DIB
 
 			if (planar_config == PLANARCONFIG_CONTIG && !header_only) {
@@ -2005,46 +2405,48 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				// get the maximum number of bytes required to contain a tile
 				const tmsize_t tileSize = TIFFTileSize(tif);
 
-				// allocate tile buffer
-				auto tileBuffer(std::make_unique<uint8_t[]>(tileSize));
-
 				// calculate src line and dst pitch
 				const int dst_pitch = FreeImage_GetPitch(dib.get());
 				const uint32_t tileRowSize = (uint32_t)TIFFTileRowSize(tif);
 				const uint32_t imageRowSize = (uint32_t)TIFFScanlineSize(tif);
 
+				// decode the rows of tiles [first, last) with tile_tif into tileBuffer
+				auto decodeTileRows = [&](TIFF *tile_tif, uint8_t *tileBuffer, uint32_t first, uint32_t last) {
+					// In the tiff file the lines are saved from up to down 
+					// In a DIB the lines must be saved from down to up
 
-				// In the tiff file the lines are saved from up to down 
-				// In a DIB the lines must be saved from down to up
+					uint8_t *bits = FreeImage_GetScanLine(dib.get(), y1 - y0 - 1 - first * tileHeight);
 
-				uint8_t *bits = FreeImage_GetScanLine(dib.get(), height - 1);
-				
-				for (uint32_t y = 0; y < height; y += tileHeight) {
-					const uint32_t nrows = std::min(height - y, tileHeight);
+					for (uint32_t y = y0 + first * tileHeight; y < std::min(y0 + last * tileHeight, y1); y += tileHeight) {
+						const uint32_t nrows = std::min(y1 - y, tileHeight);
 
-					for (uint32_t x = 0, rowSize = 0; x < width; x += tileWidth, rowSize += tileRowSize) {
-						memset(tileBuffer.get(), 0, tileSize);
+						for (uint32_t x = x0, rowSize = 0; x < x1; x += tileWidth, rowSize += tileRowSize) {
+							memset(tileBuffer, 0, tileSize);
 
-						// read one tile
-						if (TIFFReadTile(tif, tileBuffer.get(), x, y, 0, 0) < 0) {
-							throw "Corrupted tiled TIFF file";
-						}
-						// convert to strip
-						if (x + tileWidth > width) {
-							src_line = imageRowSize - rowSize;
-						} else {
-							src_line = tileRowSize;
-						}
-						const uint8_t *src_bits = tileBuffer.get();
-						uint8_t *dst_bits = bits + rowSize;
-						for (uint32_t k = 0; k < nrows; k++) {
-							memcpy(dst_bits, src_bits, src_line);
-							src_bits += tileRowSize;
-							dst_bits -= dst_pitch;
+							// read one tile
+							if (TIFFReadTile(tile_tif, tileBuffer, x, y, 0, 0) < 0) {
+								throw "Corrupted tiled TIFF file";
+							}
+							// convert to strip
+							const uint32_t src_line = (x + tileWidth > width) ? imageRowSize - (x / tileWidth) * tileRowSize : tileRowSize;
+							const uint8_t *src_bits = tileBuffer;
+							uint8_t *dst_bits = bits + rowSize;
+							for (uint32_t k = 0; k < nrows; k++) {
+								memcpy(dst_bits, src_bits, src_line);
+								src_bits += tileRowSize;
+								dst_bits -= dst_pitch;
+							}
 						}
+
+						bits -= nrows * dst_pitch;
 					}
+				};
 
-					bits -= nrows * dst_pitch;
+				// tiles are compressed independently, decode bands of tile rows in parallel when worth it
+				const uint32_t tileRows = (y1 - y0 + tileHeight - 1) / tileHeight;
+				if (!DecodeParallel(fio, tileRows, tileSize, decodeTileRows)) {
+					auto tileBuffer(std::make_unique<uint8_t[]>(tileSize));
+					decodeTileRows(tif, tileBuffer.get(), 0, tileRows);
 				}
 
 #if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
@@ -2082,26 +2484,38 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				const tmsize_t src_line = TIFFScanlineSize(tif);
 				const int dst_pitch = FreeImage_GetPitch(dib.get());
 
+				const uint32_t strip_rows = std::min(rowsperstrip, height);
+				const uint32_t strip_count = (height + strip_rows - 1) / strip_rows;
+
 				// In the tiff file the lines are save from up to down 
 				// In a DIB the lines must be saved from down to up
 
-				uint8_t *bits = FreeImage_GetScanLine(dib.get(), height - 1);
-
-				// read the tiff lines and save them in the DIB
-
-				auto buf(std::make_unique<uint8_t[]>(TIFFStripSize(tif)));
+				// read the tiff strips [first, last) and convert each one from XYZ to RGB while it is in the cache
 
-				for (uint32_t y = 0; y < height; y += rowsperstrip) {
-					const uint32_t nrow = std::min(height - y, rowsperstrip);
+				auto decodeStrips = [&](TIFF *strip_tif, uint8_t *buf, uint32_t first, uint32_t last) {
+					for (uint32_t strip = first; strip < last; strip++) {
+						const uint32_t y = strip * strip_rows;
+						const uint32_t nrow = std::min(height - y, strip_rows);
 
-					if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, y, 0), buf.get(), nrow * src_line) == -1) {
-						throw FI_MSG_ERROR_PARSING;
-					}
-					// convert from XYZ to RGB
-					for (uint32_t l = 0; l < nrow; l++) {
-						tiff_ConvertLineXYZToRGB(bits, buf.get() + l * src_line, stonits, width);
-						bits -= dst_pitch;
+						if (TIFFReadEncodedStrip(strip_tif, strip, buf, nrow * src_line) == -1) {
+							throw FI_MSG_ERROR_PARSING;
+						}
+						uint8_t *bits = FreeImage_GetScanLine(dib.get(), height - 1 - y);
+						for (uint32_t l = 0; l < nrow; l++) {
+							tiff_ConvertLineXYZToRGB(bits, buf + l * src_line, stonits, width);
+							bits -= dst_pitch;
+						}
 					}
+				};
+
+				const FIBOOL parallel = DecodeParallel(fio, strip_count, TIFFStripSize(tif), [&](TIFF *strip_tif, uint8_t *buf, uint32_t first, uint32_t last) {
+					// the data format is a pseudo tag of the codec, it isn't read from the file with the directory
+					TIFFSetField(strip_tif, TIFFTAG_SGILOGDATAFMT, SGILOGDATAFMT_FLOAT);
+					decodeStrips(strip_tif, buf, first, last);
+				});
+				if (!parallel) {
+					auto buf(std::make_unique<uint8_t[]>(TIFFStripSize(tif)));
+					decodeStrips(tif, buf.get(), 0, strip_count);
 				}
 			}
 			else if (planar_config == PLANARCONFIG_SEPARATE) {
@@ -2181,10 +2595,22 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
 		}
+
+		// crop the decoded strips, tiles or image to the region
+
+		if (region && ((dib_left != region->left) || (dib_top != region->top) || 
+			(FreeImage_GetWidth(dib.get()) != region->right - region->left) || (FreeImage_GetHeight(dib.get()) != region->bottom - region->top))) {
+			dib.reset(FreeImage_Copy(dib.get(), region->left - dib_left, region->top - dib_top, region->right - dib_left, region->bottom - dib_top));
+			if (!dib) {
+				throw FI_MSG_ERROR_DIB_MEMORY;
+			}
+		}
 		
 		// copy TIFF metadata (must be done after FreeImage_Allocate)
 
-		ReadMetadata(io, handle, tif, dib.get());
+		if ((flags & FIF_LOAD_NOMETADATA) != FIF_LOAD_NOMETADATA) {
+			ReadMetadata(io, handle, tif, dib.get());
+		}
 
 		// copy ICC profile data (must be done after FreeImage_Allocate)
 		
@@ -2202,22 +2628,166 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 		// copy TIFF thumbnail (must be done after FreeImage_Allocate)
 		
-		ReadThumbnail(io, handle, data, tif, dib.get());
+		if (!region) {
+			ReadThumbnail(io, handle, data, tif, dib.get());
+		}
 
 		return dib.release();
 
 	}
 	catch (const char *message) {
 		if (message) {
-			FreeImage_OutputMessageProc(s_format_id, message);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(message), message);
 		}
 	}
 	catch (const std::bad_alloc &) {
-		FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
 	}
 	return nullptr;
 }
 
+static FIBITMAP * DLL_CALLCONV
+Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+	return LoadTIFF(io, handle, page, flags, data, nullptr);
+}
+
+FIBITMAP *
+LoadRegionTIFF(FreeImageIO *io, fi_handle handle, unsigned left, unsigned top, unsigned right, unsigned bottom, int flags) {
+	void *data = Open(io, handle, TRUE);
+	if (!data) {
+		return nullptr;
+	}
+	const TIFFRegion region = { left, top, right, bottom };
+	FIBITMAP *dib = LoadTIFF(io, handle, -1, flags, data, &region);
+	Close(io, handle, data);
+	return dib;
+}
+
+/**
+Probe the first directory with a header only load (see FreeImage_GetImageInfo), plus the tile size
+*/
+static FIBOOL DLL_CALLCONV
+GetImageInfo(FreeImageIO *io, fi_handle handle, FIIMAGEINFO *info, void *data) {
+	fi_TIFFIO *fio = static_cast<fi_TIFFIO*>(data);
+	if (!fio || !fio->tif) {
+		return FALSE;
+	}
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(LoadTIFF(io, handle, -1, FIF_LOAD_NOPIXELS, data, nullptr), &FreeImage_Unload);
+	if (!dib) {
+		return FALSE;
+	}
+	FreeImage_FillImageInfo(dib.get(), info);
+
+	if (TIFFIsTiled(fio->tif)) {
+		uint32_t tile_width = 0, tile_height = 0;
+		TIFFGetField(fio->tif, TIFFTAG_TILEWIDTH, &tile_width);
+		TIFFGetField(fio->tif, TIFFTAG_TILELENGTH, &tile_height);
+		info->tile_width = tile_width;
+		info->tile_height = tile_height;
+	}
+
+	const int page_count = PageCount(io, handle, data);
+	info->page_count = (page_count > 0) ? (uint32_t)page_count : 1;
+	return TRUE;
+}
+
+// --------------------------------------------------------------------------
+
+// --------------------------------------------------------------------------
+//   Tiled writing
+// --------------------------------------------------------------------------
+
+/// Width and height of the tiles written with TIFF_TILED and TIFF_PYRAMID
+static const uint32_t TIFF_TILE_SIZE = 256;
+
+/**
+Writes the rows of an image from top to bottom, as strips with TIFFWriteScanline 
+or, for tiled images, gathered into bands of one tile height and cut into tiles
+*/
+class TIFFRowWriter {
+public:
+	explicit TIFFRowWriter(TIFF *tif) : m_tif(tif) {
+		if (TIFFIsTiled(tif)) {
+			TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &m_width);
+			TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &m_height);
+			TIFFGetField(tif, TIFFTAG_TILEWIDTH, &m_tile_width);
+			TIFFGetField(tif, TIFFTAG_TILELENGTH, &m_tile_height);
+			m_line = TIFFScanlineSize(tif);
+			m_band.reset(new uint8_t[m_line * m_tile_height]);
+			m_tile.reset(new uint8_t[TIFFTileSize(tif)]);
+		}
+	}
+
+	/**
+	Writes row y of the image, rows must be written in order
+	*/
+	void Write(uint8_t *row, uint32_t y) {
+		if (!m_band) {
+			TIFFWriteScanline(m_tif, row, y, 0);
+			return;
+		}
+		const uint32_t band_row = y % m_tile_height;
+		memcpy(m_band.get() + band_row * m_line, row, m_line);
+		if ((band_row + 1 == m_tile_height) || (y + 1 == m_height)) {
+			WriteBand(y - band_row, band_row + 1);
+		}
+	}
+
+private:
+	void WriteBand(uint32_t y, uint32_t rows) {
+		const tmsize_t tile_line = TIFFTileRowSize(m_tif);
+		const tmsize_t tile_size = TIFFTileSize(m_tif);
+
+		tmsize_t offset = 0;
+		for (uint32_t x = 0; x < m_width; x += m_tile_width, offset += tile_line) {
+			// tiles across the right and bottom edges are padded with zeros
+			const tmsize_t copy = std::min(tile_line, m_line - offset);
+			memset(m_tile.get(), 0, tile_size);
+			for (uint32_t k = 0; k < rows; k++) {
+				memcpy(m_tile.get() + k * tile_line, m_band.get() + k * m_line + offset, copy);
+			}
+			TIFFWriteEncodedTile(m_tif, TIFFComputeTile(m_tif, x, y, 0, 0), m_tile.get(), tile_size);
+		}
+	}
+
+	TIFF *m_tif;
+	uint32_t m_width{};
+	uint32_t m_height{};
+	uint32_t m_tile_width{};
+	uint32_t m_tile_height{};
+	tmsize_t m_line{};
+	std::unique_ptr<uint8_t[]> m_band;
+	std::unique_ptr<uint8_t[]> m_tile;
+};
+
+/**
+Returns TRUE if the pyramid levels of dib can be computed by FreeImage_RescaleRect without changing its pixel format
+*/
+static FIBOOL 
+CanReduce(FIBITMAP *dib) {
+	switch (FreeImage_GetImageType(dib)) {
+		case FIT_BITMAP:
+			switch (FreeImage_GetBPP(dib)) {
+				case 8:
+					return (FreeImage_GetColorType(dib) == FIC_MINISBLACK) && !FreeImage_IsTransparent(dib);
+				case 24:
+				case 32:
+					return TRUE;
+				default:
+					return FALSE;
+			}
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
 // --------------------------------------------------------------------------
 
 /**
@@ -2229,8 +2799,8 @@ Save a single image into a TIF
 @param page Page number
 @param flags FreeImage TIFF save flag
 @param data TIFF plugin context
-@param ifd TIFF Image File Directory (0 means save image, > 0 && (page == -1) means save thumbnail)
-@param ifdCount 1 if no thumbnail to save, 2 if image + thumbnail to save
+@param ifd TIFF Image File Directory (0 means save image, > 0 means save a SubIFD: pyramid level or thumbnail)
+@param ifdCount 1 + number of SubIFDs to save after the image
 @return Returns TRUE if successful, returns FALSE otherwise
 */
 static FIBOOL 
@@ -2361,7 +2931,12 @@ SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flag
 		TIFFSetField(out, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);	// single image plane 
 		TIFFSetField(out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
 		TIFFSetField(out, TIFFTAG_FILLORDER, FILLORDER_MSB2LSB);
-		TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(out, (uint32_t) -1)); 
+		if ((flags & (TIFF_TILED | TIFF_PYRAMID)) != 0) {
+			TIFFSetField(out, TIFFTAG_TILEWIDTH, TIFF_TILE_SIZE);
+			TIFFSetField(out, TIFFTAG_TILELENGTH, TIFF_TILE_SIZE);
+		} else {
+			TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(out, (uint32_t) -1)); 
+		}
 
 		// handle metrics
 
@@ -2369,7 +2944,11 @@ SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flag
 
 		// multi-paging
 
-		if (page >= 0) {
+		if (ifd > 0) {
+			// pyramid level or thumbnail
+			TIFFSetField(out, TIFFTAG_SUBFILETYPE, (uint32_t)FILETYPE_REDUCEDIMAGE);
+
+		} else if (page >= 0) {
 			char page_number[20];
 			snprintf(page_number, std::size(page_number), "Page %d", page);
 
@@ -2378,8 +2957,7 @@ SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flag
 			TIFFSetField(out, TIFFTAG_PAGENAME, page_number);
 
 		} else {
-			// is it a thumbnail ? 
-			TIFFSetField(out, TIFFTAG_SUBFILETYPE, (ifd == 0) ? (uint32_t)0 : (uint32_t)FILETYPE_REDUCEDIMAGE);
+			TIFFSetField(out, TIFFTAG_SUBFILETYPE, (uint32_t)0);
 		}
 
 		// palettes (image colormaps are automatically scaled to 16-bits)
@@ -2410,15 +2988,16 @@ SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flag
 
 		WriteMetadata(out, dib);
 
-		// thumbnail tag
+		// pyramid levels and thumbnail tag
 
 		if ((ifd == 0) && (ifdCount > 1)) {
-			uint16_t nsubifd = 1;
-			uint64_t subifd[1];
-			subifd[0] = 0;
-			TIFFSetField(out, TIFFTAG_SUBIFD, nsubifd, subifd);
+			const uint16_t nsubifd = (uint16_t)(ifdCount - 1);
+			std::vector<uint64_t> subifd(nsubifd, 0);
+			TIFFSetField(out, TIFFTAG_SUBIFD, nsubifd, subifd.data());
 		}
 
+		TIFFRowWriter writer(out);
+
 		// read the DIB lines from bottom to top
 		// and save them in the TIF
 		// -------------------------------------
@@ -2458,7 +3037,7 @@ SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flag
 
 							// write the scanline to disc
 
-							TIFFWriteScanline(out, buffer.get(), height - y - 1, 0);
+							writer.Write(buffer.get(), height - y - 1);
 						}
 					}
 					else {
@@ -2469,7 +3048,7 @@ SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flag
 							// get a copy of the scanline
 							memcpy(buffer.get(), FreeImage_GetScanLine(dib, height - y - 1), pitch);
 							// write the scanline to disc
-							TIFFWriteScanline(out, buffer.get(), y, 0);
+							writer.Write(buffer.get(), y);
 						}
 					}
 
@@ -2500,7 +3079,7 @@ SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flag
 #endif
 						// write the scanline to disc
 
-						TIFFWriteScanline(out, buffer.get(), y, 0);
+						writer.Write(buffer.get(), y);
 					}
 
 					break;
@@ -2510,13 +3089,22 @@ SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flag
 		} else if (image_type == FIT_RGBF && (flags & TIFF_LOGLUV) == TIFF_LOGLUV) {
 			// RGBF image => store as XYZ using a LogLuv encoding
 
-			auto buffer(std::make_unique<uint8_t[]>(pitch));
+			// convert bands of about 1 MB of scanlines from RGB to XYZ in parallel, then encode them in order
+			// (the LogLuv encoder itself is serial)
+			const uint32_t band_rows = std::min<uint32_t>(height, std::max<uint32_t>(1, (1024 * 1024) / pitch));
+			auto band(std::make_unique<uint8_t[]>((size_t)pitch * band_rows));
 
-			for (uint32_t y = 0; y < height; y++) {
-				// get a copy of the scanline and convert from RGB to XYZ
-				tiff_ConvertLineRGBToXYZ(static_cast<uint8_t*>(buffer.get()), FreeImage_GetScanLine(dib, height - y - 1), width);
-				// write the scanline to disc
-				TIFFWriteScanline(out, buffer.get(), y, 0);
+			for (uint32_t y0 = 0; y0 < height; y0 += band_rows) {
+				const uint32_t rows = std::min<uint32_t>(height - y0, band_rows);
+				ParallelFor(0, rows, CalculateBandRows(pitch), [&](unsigned first, unsigned last) {
+					for (unsigned k = first; k < last; k++) {
+						tiff_ConvertLineRGBToXYZ(band.get() + (size_t)k * pitch, FreeImage_GetConstScanLine(dib, height - (y0 + k) - 1), width);
+					}
+				});
+				// write the scanlines to disc
+				for (uint32_t k = 0; k < rows; k++) {
+					writer.Write(band.get() + (size_t)k * pitch, y0 + k);
+				}
 			}
 		} else {
 			// just dump the dib (tiff supports all dib types)
@@ -2525,15 +3113,15 @@ SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flag
 
 			for (uint32_t y = 0; y < height; y++) {
 				// get a copy of the scanline
-				memcpy(buffer.get(), FreeImage_GetScanLine(dib, height - y - 1), pitch);
+				memcpy(buffer.get(), FreeImage_GetConstScanLine(dib, height - y - 1), pitch);
 				// write the scanline to disc
-				TIFFWriteScanline(out, buffer.get(), y, 0);
+				writer.Write(buffer.get(), y);
 			}
 		}
 
-		// write out the directory tag if we wrote a page other than -1 or if we have a thumbnail to write later
+		// write out the directory tag if we wrote a page other than -1 or if we have SubIFDs to write later
 
-		if ((page >= 0) || ((ifd == 0) && (ifdCount > 1))) {
+		if ((page >= 0) || (ifd + 1 < ifdCount)) {
 			TIFFWriteDirectory(out);
 			// else: TIFFClose will WriteDirectory
 		}
@@ -2542,31 +3130,88 @@ SaveOneTIFF(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flag
 
 	}
 	catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 	}
 	catch (const std::bad_alloc &) {
-		FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
 	}
 	return FALSE;
 }
 
+/**
+Returns the size of the uncompressed pixels of dib, with the pyramid levels and the thumbnail saved along
+*/
+static uint64_t
+EstimateSaveSize(FIBITMAP *dib, int flags) {
+	uint64_t size = (uint64_t)FreeImage_GetPitch(dib) * FreeImage_GetHeight(dib);
+	if ((flags & TIFF_PYRAMID) == TIFF_PYRAMID) {
+		// each level is a quarter of the previous one
+		size += size / 3;
+	}
+	if (FIBITMAP *thumbnail = FreeImage_GetThumbnail(dib)) {
+		size += (uint64_t)FreeImage_GetPitch(thumbnail) * FreeImage_GetHeight(thumbnail);
+	}
+	return size;
+}
+
 static FIBOOL DLL_CALLCONV
 Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
 	FIBOOL bResult = FALSE;
 
-	// handle thumbnail as SubIFD
+	if (!dib || !data) {
+		return FALSE;
+	}
+
+	fi_TIFFIO *fio = (fi_TIFFIO*)data;
+	if (!fio->tif) {
+		// mode = "w"	: write Classic TIFF, limited to 4 GB by its 32-bit offsets
+		// mode = "w8"	: write Big TIFF, chosen when the first image may not fit (with a margin for the tags)
+		const uint64_t TIFF_CLASSIC_MAX_SIZE = 0xF0000000;
+		const FIBOOL bBigTIFF = ((flags & TIFF_BIGTIFF) == TIFF_BIGTIFF) || (EstimateSaveSize(dib, flags) > TIFF_CLASSIC_MAX_SIZE);
+		fio->tif = TIFFFdOpen((thandle_t)fio, "", bBigTIFF ? "w8" : "w");
+		if (!fio->tif) {
+			FreeImage_OutputMessageProc(s_format_id, "Error while opening TIFF: data is invalid");
+			return FALSE;
+		}
+	}
+
+	// reduced resolution levels as SubIFDs, halving the size until it fits in one tile
+
+	unsigned levelCount = 0;
+	if (((flags & TIFF_PYRAMID) == TIFF_PYRAMID) && CanReduce(dib)) {
+		for (unsigned w = FreeImage_GetWidth(dib), h = FreeImage_GetHeight(dib); (w > TIFF_TILE_SIZE) || (h > TIFF_TILE_SIZE); levelCount++) {
+			w = (w + 1) / 2;
+			h = (h + 1) / 2;
+		}
+	}
+
+	// handle thumbnail as the last SubIFD
 	const FIBOOL bHasThumbnail = (FreeImage_GetThumbnail(dib) != nullptr);
-	const unsigned ifdCount = bHasThumbnail ? 2 : 1;
+	const unsigned ifdCount = 1 + levelCount + (bHasThumbnail ? 1 : 0);
 
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> level(nullptr, &FreeImage_Unload);
 	FIBITMAP *bitmap = dib;
+	int ifdFlags = flags;
 
 	for (unsigned ifd = 0; ifd < ifdCount; ifd++) {
-		// redirect dib to thumbnail for the second pass
-		if (ifd == 1) {
+		if ((ifd > 0) && (ifd <= levelCount)) {
+			// each level is reduced from the previous one
+			FIBITMAP *previous = level ? level.get() : dib;
+			const unsigned width = FreeImage_GetWidth(previous);
+			const unsigned height = FreeImage_GetHeight(previous);
+			level.reset(FreeImage_RescaleRect(previous, (width + 1) / 2, (height + 1) / 2, 0, 0, width, height, FILTER_BOX, FI_RESCALE_OMIT_METADATA));
+			if (!level) {
+				return FALSE;
+			}
+			bitmap = level.get();
+		} else if (ifd > levelCount) {
+			// redirect dib to thumbnail for the last pass, saved as strips
+			level.reset();
 			bitmap = FreeImage_GetThumbnail(dib);
+			ifdFlags = flags & ~(TIFF_TILED | TIFF_PYRAMID);
 		}
 
-		bResult = SaveOneTIFF(io, bitmap, handle, page, flags, data, ifd, ifdCount);
+		bResult = SaveOneTIFF(io, bitmap, handle, page, ifdFlags, data, ifd, ifdCount);
 		if (!bResult) {
 			return FALSE;
 		}
@@ -2581,14 +3226,8 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 void DLL_CALLCONV
 InitTIFF(Plugin *plugin, int format_id) {
-	_TIFFwarningHandler = msdosWarningHandler;
-	_TIFFerrorHandler = msdosErrorHandler;
 	s_format_id = format_id;
 
-    // Set up the callback for extended TIFF directory tag support (see XTIFF.cpp)
-	// Must be called before using libtiff
-    XTIFFInitialize();	
-
 	plugin->format_proc = Format;
 	plugin->description_proc = Description;
 	plugin->extension_proc = Extension;
@@ -2605,6 +3244,8 @@ InitTIFF(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
+	plugin->get_image_info_proc = GetImageInfo;
 }
 
 
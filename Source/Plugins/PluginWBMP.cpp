@@ -216,6 +216,16 @@ SupportsExportType(FREE_IMAGE_TYPE type) {
 	return (type == FIT_BITMAP) ? TRUE : FALSE;
 }
 
+static FIBOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -227,6 +237,8 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 	WBMPHEADER header;
 
+	const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
 	if (handle) {
 		try {
 			// Read header information
@@ -264,7 +276,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			// Allocate a new dib
 
-			dib = FreeImage_Allocate(width, height, 1);
+			dib = FreeImage_AllocateHeader(header_only, width, height, 1);
 			if (!dib) {
 				throw FI_MSG_ERROR_DIB_MEMORY;
 			}
@@ -275,6 +287,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			pal[0].red = pal[0].green = pal[0].blue = 0;
 			pal[1].red = pal[1].green = pal[1].blue = 255;
 
+			if (header_only) {
+				// header only mode
+				return dib;
+			}
+
 			// read the bitmap data
 			
 			const int line = FreeImage_GetLine(dib);
@@ -290,7 +307,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			return dib;
 
 		} catch(const char *text)  {
-			FreeImage_OutputMessageProc(s_format_id, text);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		}
 	}
 	return nullptr;
@@ -333,7 +350,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			return TRUE;
 
 		} catch (const char* text) {
-			FreeImage_OutputMessageProc(s_format_id, text);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		}
 	}
 
@@ -363,4 +380,6 @@ InitWBMP(Plugin *plugin, int format_id) {
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
@@ -23,10 +23,12 @@
 #include "Utilities.h"
 
 #include "../Metadata/FreeImageTag.h"
+#include "FreeImage/Plugin.h"
 
 #include "webp/decode.h"
 #include "webp/encode.h"
 #include "webp/mux.h"
+#include "webp/demux.h"
 #include "dec/vp8i_dec.h"
 
 // ==========================================================
@@ -40,38 +42,108 @@ static int s_format_id;
 // ----------------------------------------------------------
 
 /**
-Read the whole file into memory
+WebP input read from a FreeImage IO stream.
+Memory streams are used in place, other streams are read by chunks as the decoder needs them,
+so that decoding overlaps with the reading of network or disk streams.
 */
-static FIBOOL
-ReadFileToWebPData(FreeImageIO *io, fi_handle handle, WebPData * const bitstream) {
-  try {
-	  // Read the input file and put it in memory
-	  long start_pos = io->tell_proc(handle);
-	  io->seek_proc(handle, 0, SEEK_END);
-	  size_t file_length = (size_t)(io->tell_proc(handle) - start_pos);
-	  io->seek_proc(handle, start_pos, SEEK_SET);
-	  auto raw_data(std::make_unique<uint8_t[]>(file_length));
-	  if (io->read_proc(raw_data.get(), 1, (unsigned)file_length, handle) != file_length) {
-		  throw "Error while reading input stream";
-	  }
-
-	  // copy pointers (must be released later using free)
-	  bitstream->bytes = raw_data.release();
-	  bitstream->size = file_length;
-
-	  return TRUE;
-
-  }
-  catch(const char *text) {
-	  memset(bitstream, 0, sizeof(WebPData));
-	  if (text) {
-		  FreeImage_OutputMessageProc(s_format_id, text);
-	  }
-  }
-  catch (const std::bad_alloc &) {
-	  FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
-  }
-  return FALSE;
+class WebPStreamInput {
+public:
+	WebPStreamInput(FreeImageIO *io, fi_handle handle) : m_io(io), m_handle(handle) {
+		// memory streams don't need a copy
+		uint64_t available = 0;
+		if (const uint8_t *bytes = FreeImage_PeekMemoryIO(io, handle, &available)) {
+			io->seek_proc(handle, (long)available, SEEK_CUR);
+			m_bytes = bytes;
+			m_size = (size_t)available;
+			m_eof = true;
+		}
+	}
+
+	const uint8_t* bytes() const {
+		return m_bytes;
+	}
+
+	size_t size() const {
+		return m_size;
+	}
+
+	/**
+	Read the next chunk of the stream, the bytes pointer may change.
+	@return Returns false at the end of the stream
+	*/
+	bool ReadMore() {
+		if (m_eof) {
+			return false;
+		}
+		const size_t chunk_size = 64 * 1024;
+		m_buffer.resize(m_size + chunk_size);
+		const unsigned count = m_io->read_proc(m_buffer.data() + m_size, 1, (unsigned)chunk_size, m_handle);
+		m_size += count;
+		m_buffer.resize(m_size);
+		m_bytes = m_buffer.data();
+		m_eof = (count < chunk_size);
+		return count > 0;
+	}
+
+	/// Read the remaining bytes of the stream
+	void ReadAll() {
+		while (ReadMore()) {
+		}
+	}
+
+private:
+	FreeImageIO *m_io;
+	fi_handle m_handle;
+	std::vector<uint8_t> m_buffer;
+	const uint8_t *m_bytes{};
+	size_t m_size{};
+	bool m_eof{};
+};
+
+/**
+Plugin data of a file opened for reading or writing
+*/
+struct WebPContext {
+	// reading: start of the file in the stream, the whole file is read when pages are accessed
+	long start_pos{};
+	std::unique_ptr<WebPStreamInput> input;
+	// reading: animation decoder, next_frame and last_timestamp follow its position
+	std::unique_ptr<WebPAnimDecoder, decltype(&WebPAnimDecoderDelete)> anim_decoder{ nullptr, &WebPAnimDecoderDelete };
+	WebPAnimInfo anim_info{};
+	int next_frame{};
+	int last_timestamp{};
+
+	// writing: single image mux, also holding the metadata chunks of an animation
+	std::unique_ptr<WebPMux, decltype(&WebPMuxDelete)> mux{ nullptr, &WebPMuxDelete };
+	// writing: animation encoder of a multipage save
+	std::unique_ptr<WebPAnimEncoder, decltype(&WebPAnimEncoderDelete)> anim_encoder{ nullptr, &WebPAnimEncoderDelete };
+	unsigned canvas_width{};
+	unsigned canvas_height{};
+	int timestamp{};
+};
+
+/**
+Let the decoder write into the dib: bottom-up rows in the FreeImage color order.
+*/
+static void
+SetDecoderOutput(WebPDecoderConfig *decoder_config, FIBITMAP *dib) {
+	WebPDecBuffer* const output_buffer = &decoder_config->output;
+	const bool has_alpha = (FreeImage_GetBPP(dib) == 32);
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	output_buffer->colorspace = has_alpha ? MODE_BGRA : MODE_BGR;
+#else
+	output_buffer->colorspace = has_alpha ? MODE_RGBA : MODE_RGB;
+#endif
+	output_buffer->is_external_memory = 1;
+	output_buffer->u.RGBA.rgba = FreeImage_GetBits(dib);
+	output_buffer->u.RGBA.stride = (int)FreeImage_GetPitch(dib);
+	output_buffer->u.RGBA.size = (size_t)FreeImage_GetPitch(dib) * FreeImage_GetHeight(dib);
+
+	// the first decoded row is the last dib scanline
+	decoder_config->options.flip = 1;
+	// use multi-threaded decoding
+	decoder_config->options.use_threads = 1;
 }
 
 // ----------------------------------------------------------
@@ -158,255 +230,568 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
 static void * DLL_CALLCONV
 Open(FreeImageIO *io, fi_handle handle, FIBOOL read) {
-	WebPMux *mux{};
-	int copy_data = 1;	// 1 : copy data into the mux, 0 : keep a link to local data
+	auto *context = new(std::nothrow) WebPContext;
+	if (!context) {
+		return nullptr;
+	}
 
 	if (read) {
-		// create the MUX object from the input stream
-		WebPData bitstream;
-		// read the input file and put it in memory
-		if (!ReadFileToWebPData(io, handle, &bitstream)) {
-			return nullptr;
+		// the input stream is read by Load, as the decoder needs it
+		context->start_pos = io->tell_proc(handle);
+		return context;
+	}
+
+	// creates an empty mux object
+	context->mux.reset(WebPMuxNew());
+	if (!context->mux) {
+		FreeImage_OutputMessageProc(s_format_id, "Failed to create empty mux object");
+		delete context;
+		return nullptr;
+	}
+
+	return context;
+}
+
+static FIBOOL WriteAnimation(FreeImageIO *io, fi_handle handle, WebPContext *context);
+
+static void DLL_CALLCONV
+Close(FreeImageIO *io, fi_handle handle, void *data) {
+	auto *context = (WebPContext*)data;
+	if (context) {
+		if (context->anim_encoder) {
+			// write the frames of a multipage save
+			WriteAnimation(io, handle, context);
 		}
-		// create the MUX object
-		mux = WebPMuxCreate(&bitstream, copy_data);
-		// no longer needed since copy_data == 1
-		free((void*)bitstream.bytes);
-		if (!mux) {
-			FreeImage_OutputMessageProc(s_format_id, "Failed to create mux object from file");
+		delete context;
+	}
+}
+
+/**
+Read the whole file and create the animation decoder of animated files
+@return Returns false if the file can't be parsed
+*/
+static bool
+ReadPages(FreeImageIO *io, fi_handle handle, WebPContext *context) {
+	if (context->input) {
+		return true;
+	}
+
+	io->seek_proc(handle, context->start_pos, SEEK_SET);
+	context->input = std::make_unique<WebPStreamInput>(io, handle);
+	context->input->ReadAll();
+
+	WebPBitstreamFeatures features;
+	if (WebPGetFeatures(context->input->bytes(), context->input->size(), &features) != VP8_STATUS_OK) {
+		return false;
+	}
+
+	if (features.has_animation) {
+		WebPAnimDecoderOptions dec_options;
+		if (!WebPAnimDecoderOptionsInit(&dec_options)) {
+			return false;
 		}
-	} else {
-		// creates an empty mux object
-		mux = WebPMuxNew();
-		if (!mux) {
-			FreeImage_OutputMessageProc(s_format_id, "Failed to create empty mux object");
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		dec_options.color_mode = MODE_BGRA;
+#else
+		dec_options.color_mode = MODE_RGBA;
+#endif
+		dec_options.use_threads = 1;
+
+		// the decoder keeps a link to the input data
+		const WebPData webp_data = { context->input->bytes(), context->input->size() };
+		context->anim_decoder.reset(WebPAnimDecoderNew(&webp_data, &dec_options));
+		if (!context->anim_decoder || !WebPAnimDecoderGetInfo(context->anim_decoder.get(), &context->anim_info)) {
+			context->anim_decoder.reset();
+			return false;
 		}
 	}
 
-	return mux;
+	return true;
 }
 
-static void DLL_CALLCONV
-Close(FreeImageIO *io, fi_handle handle, void *data) {
-	WebPMux *mux = (WebPMux*)data;
-	if (mux) {
-		// free the MUX object
-		WebPMuxDelete(mux);
+static int DLL_CALLCONV
+PageCount(FreeImageIO *io, fi_handle handle, void *data) {
+	auto *context = (WebPContext*)data;
+	if (!context) {
+		return 0;
 	}
+
+	try {
+		if (!ReadPages(io, handle, context)) {
+			return 0;
+		}
+	} catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+		return 0;
+	}
+
+	// still images have a single page
+	return context->anim_decoder ? (int)context->anim_info.frame_count : 1;
 }
 
 // ----------------------------------------------------------
 
 /**
-Decode a WebP image and returns a FIBITMAP image
-@param webp_image Raw WebP image
+Allocate the dib of a WebP image, the decoder scales to the size requested by the load flags
+@param features Features gathered from the bitstream
+@param decoder_config Decoder configuration, receives the scaling options
 @param flags FreeImage load flags
-@return Returns a dib if successfull, returns NULL otherwise
+@return Returns the dib, throws on failure
 */
 static FIBITMAP *
-DecodeImage(WebPData *webp_image, int flags) {
-	const uint8_t* data = webp_image->bytes;	// raw image data
-	const size_t data_size = webp_image->size;	// raw image size
-
-    VP8StatusCode webp_status = VP8_STATUS_OK;
+AllocateImage(const WebPBitstreamFeatures *features, WebPDecoderConfig *decoder_config, int flags) {
+	const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
+	const unsigned bpp = features->has_alpha ? 32 : 24;
+	unsigned width = (unsigned)features->width;
+	unsigned height = (unsigned)features->height;
+
+	// requested size of the longest side, the decoder scales while decoding
+	const unsigned requested_size = (unsigned)flags >> 16;
+	if (!header_only && (requested_size > 0) && (requested_size < MAX(width, height))) {
+		const double scale = (double)requested_size / MAX(width, height);
+		width = MAX(1u, (unsigned)(width * scale + 0.5));
+		height = MAX(1u, (unsigned)(height * scale + 0.5));
+		decoder_config->options.use_scaling = 1;
+		decoder_config->options.scaled_width = (int)width;
+		decoder_config->options.scaled_height = (int)height;
+	}
 
-	FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+	FIBITMAP *dib = FreeImage_AllocateHeader(header_only, width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if (!dib) {
+		throw FI_MSG_ERROR_DIB_MEMORY;
+	}
+	return dib;
+}
 
-	// Main object storing the configuration for advanced decoding
+/**
+Decode a still WebP image incrementally, as the input stream is read.
+Rows are reported to FreeImage_LoadWithRowCallback while they are decoded.
+@param input WebP input stream, the bitstream features are already available
+@param features Features gathered from the bitstream
+@param flags FreeImage load flags
+@return Returns a dib if successfull, throws otherwise
+*/
+static FIBITMAP *
+DecodeIncremental(WebPStreamInput& input, const WebPBitstreamFeatures *features, int flags) {
 	WebPDecoderConfig decoder_config;
-	// Output buffer
-	WebPDecBuffer* const output_buffer = &decoder_config.output;
-	// Features gathered from the bitstream
-	WebPBitstreamFeatures* const bitstream = &decoder_config.input;
+	if (!WebPInitDecoderConfig(&decoder_config)) {
+		throw "Library version mismatch";
+	}
 
-	try {
-		// Initialize the configuration as empty
-		// This function must always be called first, unless WebPGetFeatures() is to be called
-		if (!WebPInitDecoderConfig(&decoder_config)) {
-			throw "Library version mismatch";
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(AllocateImage(features, &decoder_config, flags), &FreeImage_Unload);
+	if ((flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS) {
+		return dib.release();
+	}
+
+	SetDecoderOutput(&decoder_config, dib.get());
+
+	std::unique_ptr<WebPIDecoder, decltype(&WebPIDelete)> idec(WebPIDecode(nullptr, 0, &decoder_config), &WebPIDelete);
+	if (!idec) {
+		throw FI_MSG_ERROR_MEMORY;
+	}
+
+	// the input buffer only grows, it isn't copied by the decoder
+	int reported = 0;
+	for (;;) {
+		const VP8StatusCode webp_status = WebPIUpdate(idec.get(), input.bytes(), input.size());
+		if ((webp_status != VP8_STATUS_OK) && (webp_status != VP8_STATUS_SUSPENDED)) {
+			throw FI_MSG_ERROR_PARSING;
 		}
 
-		// Retrieve features from the bitstream
-		// The bitstream structure is filled with information gathered from the bitstream
-		webp_status = WebPGetFeatures(data, data_size, bitstream);
-		if (webp_status != VP8_STATUS_OK) {
+		int last_y = 0;
+		if (WebPIDecGetRGB(idec.get(), &last_y, nullptr, nullptr, nullptr) && (last_y > reported)) {
+			NotifyRowsDecoded(dib.get(), (unsigned)reported, (unsigned)(last_y - reported));
+			reported = last_y;
+		}
+
+		if (webp_status == VP8_STATUS_OK) {
+			break;
+		}
+		if (!input.ReadMore()) {
+			// truncated stream
 			throw FI_MSG_ERROR_PARSING;
 		}
+	}
 
-		// Allocate output dib
+	return dib.release();
+}
 
-		unsigned bpp = bitstream->has_alpha ? 32 : 24;	
-		unsigned width = (unsigned)bitstream->width;
-		unsigned height = (unsigned)bitstream->height;
+/**
+Decode a WebP image and returns a FIBITMAP image
+@param webp_image Raw WebP image
+@param flags FreeImage load flags
+@return Returns a dib if successfull, throws otherwise
+*/
+static FIBITMAP *
+DecodeImage(const WebPData *webp_image, int flags) {
+	WebPDecoderConfig decoder_config;
+	if (!WebPInitDecoderConfig(&decoder_config)) {
+		throw "Library version mismatch";
+	}
 
-		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeader(header_only, width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK), &FreeImage_Unload);
-		if (!dib) {
-			throw FI_MSG_ERROR_DIB_MEMORY;
+	// Retrieve features from the bitstream
+	if (WebPGetFeatures(webp_image->bytes, webp_image->size, &decoder_config.input) != VP8_STATUS_OK) {
+		throw FI_MSG_ERROR_PARSING;
+	}
+
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(AllocateImage(&decoder_config.input, &decoder_config, flags), &FreeImage_Unload);
+	if ((flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS) {
+		return dib.release();
+	}
+
+	SetDecoderOutput(&decoder_config, dib.get());
+
+	if (WebPDecode(webp_image->bytes, webp_image->size, &decoder_config) != VP8_STATUS_OK) {
+		throw FI_MSG_ERROR_PARSING;
+	}
+
+	return dib.release();
+}
+
+/**
+Read the ICC profile, XMP and Exif metadata of a WebP file
+*/
+static void
+ReadMetadata(WebPMux *mux, FIBITMAP *dib) {
+	WebPData color_profile;	// ICC raw data
+	WebPData xmp_metadata;	// XMP raw data
+	WebPData exif_metadata;	// EXIF raw data
+
+	// gets the feature flags from the mux object
+	uint32_t webp_flags = 0;
+	if (WebPMuxGetFeatures(mux, &webp_flags) != WEBP_MUX_OK) {
+		return;
+	}
+
+	// get ICC profile
+	if (webp_flags & ICCP_FLAG) {
+		if (WebPMuxGetChunk(mux, "ICCP", &color_profile) == WEBP_MUX_OK) {
+			FreeImage_CreateICCProfile(dib, (void*)color_profile.bytes, (long)color_profile.size);
 		}
+	}
 
-		if (header_only) {
-			WebPFreeDecBuffer(output_buffer);
-			return dib.release();
+	// get XMP metadata
+	if ((webp_flags & XMP_FLAG) && FreeImage_LoadsMetadataModel(FIMD_XMP)) {
+		if (WebPMuxGetChunk(mux, "XMP ", &xmp_metadata) == WEBP_MUX_OK) {
+			// create a tag
+			if (std::unique_ptr<FITAG, decltype(&FreeImage_DeleteTag)> tag(FreeImage_CreateTag(), &FreeImage_DeleteTag); tag) {
+				FreeImage_SetTagKey(tag.get(), g_TagLib_XMPFieldName);
+				FreeImage_SetTagLength(tag.get(), (uint32_t)xmp_metadata.size);
+				FreeImage_SetTagCount(tag.get(), (uint32_t)xmp_metadata.size);
+				FreeImage_SetTagType(tag.get(), FIDT_ASCII);
+				FreeImage_SetTagValue(tag.get(), xmp_metadata.bytes);
+
+				// store the tag
+				FreeImage_SetMetadata(FIMD_XMP, dib, FreeImage_GetTagKey(tag.get()), tag.get());
+			}
 		}
+	}
 
-		// --- Set decoding options ---
+	// get Exif metadata
+	if (webp_flags & EXIF_FLAG) {
+		if (WebPMuxGetChunk(mux, "EXIF", &exif_metadata) == WEBP_MUX_OK) {
+			// read the Exif raw data as a blob
+			jpeg_read_exif_profile_raw(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
+			// read and decode the Exif data
+			jpeg_read_exif_profile(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
+		}
+	}
+}
 
-		// use multi-threaded decoding
-		decoder_config.options.use_threads = 1;
-		// set output color space
-		output_buffer->colorspace = bitstream->has_alpha ? MODE_BGRA : MODE_BGR;
+/**
+Returns true when the file has an extended header (VP8X chunk) announcing an ICC profile, XMP or Exif metadata
+*/
+static bool
+HasMetadata(const uint8_t *data, size_t size) {
+	// RIFF header (12 bytes), then the VP8X chunk header (8 bytes) and its flags
+	if ((size < 21) || (memcmp(data + 12, "VP8X", 4) != 0)) {
+		return false;
+	}
+	return (data[20] & (ICCP_FLAG | XMP_FLAG | EXIF_FLAG)) != 0;
+}
 
-		// ---
+/**
+Decode a page of a file opened with FreeImage_OpenMultiBitmap.
+Animation frames are decoded on demand, the decoder is only rewound when going back to an earlier frame.
+*/
+static FIBITMAP *
+LoadPage(FreeImageIO *io, fi_handle handle, int page, int flags, WebPContext *context) {
+	if (!ReadPages(io, handle, context)) {
+		throw FI_MSG_ERROR_PARSING;
+	}
 
-		// decode the input stream, taking 'config' into account. 
-		
-		webp_status = WebPDecode(data, data_size, &decoder_config);
-		if (webp_status != VP8_STATUS_OK) {
-			throw FI_MSG_ERROR_PARSING;
-		}
+	const WebPData bitstream = { context->input->bytes(), context->input->size() };
 
-		// fill the dib with the decoded data
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
 
-		const uint8_t *src_bitmap = output_buffer->u.RGBA.rgba;
-		const auto src_pitch = (unsigned)output_buffer->u.RGBA.stride;
+	if (!context->anim_decoder) {
+		// still image
+		if (page > 0) {
+			return nullptr;
+		}
+		dib.reset(DecodeImage(&bitstream, flags));
+	} else {
+		// animation frame, composed on the canvas
+		const WebPAnimInfo& info = context->anim_info;
+		if ((unsigned)page >= info.frame_count) {
+			return nullptr;
+		}
 
-		switch (bpp) {
-			case 24:
-				for (unsigned y = 0; y < height; y++) {
-					const uint8_t *src_bits = src_bitmap + y * src_pitch;
-					auto *dst_bits = (uint8_t*)FreeImage_GetScanLine(dib.get(), height-1-y);
-					for (unsigned x = 0; x < width; x++) {
-						dst_bits[FI_RGBA_BLUE]	= src_bits[0];	// B
-						dst_bits[FI_RGBA_GREEN]	= src_bits[1];	// G
-						dst_bits[FI_RGBA_RED]	= src_bits[2];	// R
-						src_bits += 3;
-						dst_bits += 3;
-					}
-				}
-				break;
-			case 32:
-				for (unsigned y = 0; y < height; y++) {
-					const uint8_t *src_bits = src_bitmap + y * src_pitch;
-					auto *dst_bits = (uint8_t*)FreeImage_GetScanLine(dib.get(), height-1-y);
-					for (unsigned x = 0; x < width; x++) {
-						dst_bits[FI_RGBA_BLUE]	= src_bits[0];	// B
-						dst_bits[FI_RGBA_GREEN]	= src_bits[1];	// G
-						dst_bits[FI_RGBA_RED]	= src_bits[2];	// R
-						dst_bits[FI_RGBA_ALPHA]	= src_bits[3];	// A
-						src_bits += 4;
-						dst_bits += 4;
-					}
-				}
-				break;
+		const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+		dib.reset(FreeImage_AllocateHeader(header_only, info.canvas_width, info.canvas_height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+		if (!dib) {
+			throw FI_MSG_ERROR_DIB_MEMORY;
 		}
 
-		// Free the decoder
-		WebPFreeDecBuffer(output_buffer);
+		if (page < context->next_frame) {
+			WebPAnimDecoderReset(context->anim_decoder.get());
+			context->next_frame = 0;
+			context->last_timestamp = 0;
+		}
 
-		return dib.release();
+		// frames are built on the previous ones
+		uint8_t *canvas{};
+		int timestamp = 0;
+		int previous_timestamp = context->last_timestamp;
+		while (context->next_frame <= page) {
+			previous_timestamp = context->last_timestamp;
+			if (!WebPAnimDecoderGetNext(context->anim_decoder.get(), &canvas, &timestamp)) {
+				throw FI_MSG_ERROR_PARSING;
+			}
+			context->last_timestamp = timestamp;
+			context->next_frame++;
+		}
 
-	} catch (const char *text) {
-		WebPFreeDecBuffer(output_buffer);
+		if (!header_only) {
+			const unsigned line = info.canvas_width * 4;
+			for (unsigned y = 0; y < info.canvas_height; y++) {
+				memcpy(FreeImage_GetScanLine(dib.get(), info.canvas_height - 1 - y), canvas + y * line, line);
+			}
+		}
 
-		if (text) {
-			FreeImage_OutputMessageProc(s_format_id, text);
+		// frame duration, and the animation parameters on the first page
+		const uint32_t frame_time = (uint32_t)(timestamp - previous_timestamp);
+		FreeImage_SetMetadataEx(FIMD_ANIMATION, dib.get(), "FrameTime", ANIMTAG_FRAMETIME, FIDT_LONG, 1, 4, &frame_time);
+		if (page == 0) {
+			const uint32_t loop = info.loop_count;
+			FreeImage_SetMetadataEx(FIMD_ANIMATION, dib.get(), "Loop", ANIMTAG_LOOP, FIDT_LONG, 1, 4, &loop);
 		}
 	}
-	return nullptr;
+
+	if ((page == 0) && ((flags & FIF_LOAD_NOMETADATA) != FIF_LOAD_NOMETADATA) && HasMetadata(bitstream.bytes, bitstream.size)) {
+		// keep a link to the input data, it outlives the mux object
+		std::unique_ptr<WebPMux, decltype(&WebPMuxDelete)> mux(WebPMuxCreate(&bitstream, 0), &WebPMuxDelete);
+		if (mux) {
+			ReadMetadata(mux.get(), dib.get());
+		}
+	}
+
+	return dib.release();
 }
 
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	WebPMux *mux{};
-	WebPMuxFrameInfo webp_frame = { 0 };	// raw image
-	WebPData color_profile;	// ICC raw data
-	WebPData xmp_metadata;	// XMP raw data
-	WebPData exif_metadata;	// EXIF raw data
-	FIBITMAP *dib{};
-	WebPMuxError error_status;
-
 	if (!handle) {
 		return nullptr;
 	}
 
 	try {
-		// get the MUX object
-		mux = (WebPMux*)data;
-		if (!mux) {
-			throw (1);
-		}
-		
-		// gets the feature flags from the mux object
-		uint32_t webp_flags = 0;
-		error_status = WebPMuxGetFeatures(mux, &webp_flags);
-		if (error_status != WEBP_MUX_OK) {
-			throw (1);
+		if ((page >= 0) && data) {
+			// page of a multipage bitmap
+			return LoadPage(io, handle, page, flags, (WebPContext*)data);
 		}
 
-		// get image data
-		error_status = WebPMuxGetFrame(mux, 1, &webp_frame);
+		WebPStreamInput input(io, handle);
 
-		if (error_status == WEBP_MUX_OK) {
-			// decode the data (can be limited to the header if flags uses FIF_LOAD_NOPIXELS)
-			dib = DecodeImage(&webp_frame.bitstream, flags);
-			if (!dib) {
-				throw (1);
-			}
-			
-			// get ICC profile
-			if (webp_flags & ICCP_FLAG) {
-				error_status = WebPMuxGetChunk(mux, "ICCP", &color_profile);
-				if (error_status == WEBP_MUX_OK) {
-					FreeImage_CreateICCProfile(dib, (void*)color_profile.bytes, (long)color_profile.size);
-				}
+		// read until the bitstream features are known
+		WebPBitstreamFeatures features;
+		VP8StatusCode webp_status;
+		while ((webp_status = WebPGetFeatures(input.bytes(), input.size(), &features)) == VP8_STATUS_NOT_ENOUGH_DATA) {
+			if (!input.ReadMore()) {
+				break;
 			}
+		}
+		if (webp_status != VP8_STATUS_OK) {
+			throw FI_MSG_ERROR_PARSING;
+		}
 
-			// get XMP metadata
-			if (webp_flags & XMP_FLAG) {
-				error_status = WebPMuxGetChunk(mux, "XMP ", &xmp_metadata);
-				if (error_status == WEBP_MUX_OK) {
-					// create a tag
-					if (std::unique_ptr<FITAG, decltype(&FreeImage_DeleteTag)> tag(FreeImage_CreateTag(), &FreeImage_DeleteTag); tag) {
-						FreeImage_SetTagKey(tag.get(), g_TagLib_XMPFieldName);
-						FreeImage_SetTagLength(tag.get(), (uint32_t)xmp_metadata.size);
-						FreeImage_SetTagCount(tag.get(), (uint32_t)xmp_metadata.size);
-						FreeImage_SetTagType(tag.get(), FIDT_ASCII);
-						FreeImage_SetTagValue(tag.get(), xmp_metadata.bytes);
-						
-						// store the tag
-						FreeImage_SetMetadata(FIMD_XMP, dib, FreeImage_GetTagKey(tag.get()), tag.get());
-					}
-				}
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
+		std::unique_ptr<WebPMux, decltype(&WebPMuxDelete)> mux(nullptr, &WebPMuxDelete);
+
+		if (!features.has_animation) {
+			// still image, decoded while the stream is read
+			dib.reset(DecodeIncremental(input, &features, flags));
+		}
+
+		// metadata chunks usually follow the image data
+		input.ReadAll();
+
+		WebPData bitstream = { input.bytes(), input.size() };
+		if (features.has_animation || HasMetadata(bitstream.bytes, bitstream.size)) {
+			// keep a link to the input data, it outlives the mux object
+			mux.reset(WebPMuxCreate(&bitstream, 0));
+			if (!mux) {
+				throw "Failed to create mux object from file";
 			}
+		}
 
-			// get Exif metadata
-			if (webp_flags & EXIF_FLAG) {
-				error_status = WebPMuxGetChunk(mux, "EXIF", &exif_metadata);
-				if (error_status == WEBP_MUX_OK) {
-					// read the Exif raw data as a blob
-					jpeg_read_exif_profile_raw(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
-					// read and decode the Exif data
-					jpeg_read_exif_profile(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
-				}
+		if (features.has_animation) {
+			// decode the first frame
+			WebPMuxFrameInfo webp_frame = { 0 };
+			if (WebPMuxGetFrame(mux.get(), 1, &webp_frame) != WEBP_MUX_OK) {
+				throw FI_MSG_ERROR_PARSING;
 			}
+			std::unique_ptr<WebPData, decltype(&WebPDataClear)> frame_data(&webp_frame.bitstream, &WebPDataClear);
+			dib.reset(DecodeImage(&webp_frame.bitstream, flags));
 		}
 
-		WebPDataClear(&webp_frame.bitstream);
+		if (mux && ((flags & FIF_LOAD_NOMETADATA) != FIF_LOAD_NOMETADATA)) {
+			ReadMetadata(mux.get(), dib.get());
+		}
 
-		return dib;
+		return dib.release();
 
-	} catch(int) {
-		WebPDataClear(&webp_frame.bitstream);
-		return nullptr;
+	} catch (const char *text) {
+		if (text) {
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
+		}
+	} catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
 	}
+	return nullptr;
 }
 
 // --------------------------------------------------------------------------
 
+/**
+Set the encoding parameters from the FreeImage save flags
+@param config Coding parameters
+@param flags FreeImage save flags
+*/
+static void
+InitEncoderConfig(WebPConfig *config, int flags) {
+	// Initialize encoding parameters to default values
+	WebPConfigInit(config);
+
+	// quality/speed trade-off (0=fast, 6=slower-better)
+	config->method = 6;
+	if (const int method = (flags >> 9) & 7; method > 0) {
+		config->method = method - 1;
+	}
+
+	// number of token partitions (lossy only)
+	config->partitions = (flags >> 13) & 3;
+
+	// use a second thread for the analysis and lossless entropy coding
+	if ((flags & WEBP_MULTITHREAD) == WEBP_MULTITHREAD) {
+		config->thread_level = 1;
+	}
+
+	if ((flags & WEBP_FAST) == WEBP_FAST) {
+		config->method = 0;
+		config->thread_level = 1;
+		if ((flags & WEBP_LOSSLESS) == WEBP_LOSSLESS) {
+			// lossless quality is the compression effort
+			config->quality = 0;
+		}
+	}
+
+	if ((flags & WEBP_LOSSLESS) == WEBP_LOSSLESS) {
+		// lossless encoding
+		config->lossless = 1;
+	} else if ((flags & 0x7F) > 0) {
+		// lossy encoding
+		config->lossless = 0;
+		// quality is between 1 (smallest file) and 100 (biggest) - default to 75
+		config->quality = (float)(flags & 0x7F);
+		if (config->quality > 100) {
+			config->quality = 100;
+		}
+	}
+
+	// validate encoding parameters
+	if (WebPValidateConfig(config) == 0) {
+		throw "Failed to initialize encoder";
+	}
+}
+
+/**
+Check that a dib can be encoded and copy its pixels into a WebP picture
+@param picture Initialized WebP picture, receives the dib size and pixels
+@param dib The FIBITMAP to encode
+*/
+static void
+ImportPicture(WebPPicture *picture, FIBITMAP *dib) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	const unsigned pitch = FreeImage_GetPitch(dib);
+
+	// check image type
+	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+
+	if (!((image_type == FIT_BITMAP) && ((bpp == 24) || (bpp == 32))))  {
+		throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
+	}
+
+	// check format limits
+	if (MAX(width, height) > WEBP_MAX_DIMENSION) {
+		FreeImage_OutputMessageProc(s_format_id, "Unsupported image size: width x height = %d x %d", width, height);
+		throw (const char*)nullptr;
+	}
+
+	picture->width = (int)width;
+	picture->height = (int)height;
+
+	// Invert dib scanlines
+	const FIBOOL bIsFlipped = FreeImage_FlipVertical(dib);
+
+	// convert dib buffer to the picture
+
+	const uint8_t *bits = FreeImage_GetBits(dib);
+	int imported = 0;
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	switch (bpp) {
+		case 24:
+			imported = WebPPictureImportBGR(picture, bits, pitch);
+			break;
+		case 32:
+			imported = WebPPictureImportBGRA(picture, bits, pitch);
+			break;
+	}
+#else
+	switch (bpp) {
+		case 24:
+			imported = WebPPictureImportRGB(picture, bits, pitch);
+			break;
+		case 32:
+			imported = WebPPictureImportRGBA(picture, bits, pitch);
+			break;
+	}
+
+#endif // FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+
+	if (bIsFlipped) {
+		// invert dib scanlines
+		FreeImage_FlipVertical(dib);
+	}
+
+	if (!imported) {
+		throw FI_MSG_ERROR_MEMORY;
+	}
+}
+
 /**
 Encode a FIBITMAP to a WebP image
 @param hmem Memory output stream, containing on return the encoded image
@@ -419,122 +804,219 @@ EncodeImage(FIMEMORY *hmem, FIBITMAP *dib, int flags) {
 	WebPPicture picture;	// Input buffer
 	WebPConfig config;		// Coding parameters
 
-	FIBOOL bIsFlipped = FALSE;
+	// Initialize output I/O
+	if (WebPPictureInit(&picture) == 1) {
+		picture.writer = WebP_MemoryWriter;
+		picture.custom_ptr = hmem;
+	} else {
+		FreeImage_OutputMessageProc(s_format_id, "Couldn't initialize WebPPicture");
+		return FALSE;
+	}
 
 	try {
-		const unsigned width = FreeImage_GetWidth(dib);
-		const unsigned height = FreeImage_GetHeight(dib);
-		const unsigned bpp = FreeImage_GetBPP(dib);
-		const unsigned pitch = FreeImage_GetPitch(dib);
+		// --- Set encoding parameters ---
 
-		// check image type
-		FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+		InitEncoderConfig(&config, flags);
+		picture.use_argb = config.lossless;
 
-		if (!((image_type == FIT_BITMAP) && ((bpp == 24) || (bpp == 32))))  {
-			throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
-		}
+		// --- Perform encoding ---
 
-		// check format limits
-		if (MAX(width, height) > WEBP_MAX_DIMENSION) {
-			FreeImage_OutputMessageProc(s_format_id, "Unsupported image size: width x height = %d x %d", width, height);
-			return FALSE;
-		}
+		ImportPicture(&picture, dib);
 
-		// Initialize output I/O
-		if (WebPPictureInit(&picture) == 1) {
-			picture.writer = WebP_MemoryWriter;
-			picture.custom_ptr = hmem;
-			picture.width = (int)width;
-			picture.height = (int)height;
-		} else {
-			throw "Couldn't initialize WebPPicture";
+		if (!WebPEncode(&config, &picture)) {
+			throw "Failed to encode image";
 		}
 
-		// --- Set encoding parameters ---
+		WebPPictureFree(&picture);
 
-		// Initialize encoding parameters to default values
-		WebPConfigInit(&config);
+		return TRUE;
 
-		// quality/speed trade-off (0=fast, 6=slower-better)
-		config.method = 6;
+	} catch (const char* text) {
 
-		if ((flags & WEBP_LOSSLESS) == WEBP_LOSSLESS) {
-			// lossless encoding
-			config.lossless = 1;
-			picture.use_argb = 1;
-		} else if ((flags & 0x7F) > 0) {
-			// lossy encoding
-			config.lossless = 0;
-			// quality is between 1 (smallest file) and 100 (biggest) - default to 75
-			config.quality = (float)(flags & 0x7F);
-			if (config.quality > 100) {
-				config.quality = 100;
-			}
+		WebPPictureFree(&picture);
+
+		if (text) {
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		}
+	}
+
+	return FALSE;
+}
 
-		// validate encoding parameters
-		if (WebPValidateConfig(&config) == 0) {
-			throw "Failed to initialize encoder";
+/**
+Set the ICC profile, XMP and Exif metadata chunks of a dib into a mux object
+*/
+static void
+WriteMetadata(WebPMux *mux, FIBITMAP *dib) {
+	const int copy_data = 1;	// 1 : copy data into the mux, 0 : keep a link to local data
+
+	// set ICC color profile
+	{
+		FIICCPROFILE *iccProfile = FreeImage_GetICCProfile(dib);
+		if (iccProfile->size && iccProfile->data) {
+			WebPData icc_profile;
+			icc_profile.bytes = (uint8_t*)iccProfile->data;
+			icc_profile.size = (size_t)iccProfile->size;
+			if (WebPMuxSetChunk(mux, "ICCP", &icc_profile, copy_data) != WEBP_MUX_OK) {
+				throw (1);
+			}
 		}
+	}
 
-		// --- Perform encoding ---
-		
-		// Invert dib scanlines
-		bIsFlipped = FreeImage_FlipVertical(dib);
+	// set XMP metadata
+	{
+		FITAG *tag{};
+		if (FreeImage_GetMetadata(FIMD_XMP, dib, g_TagLib_XMPFieldName, &tag)) {
+			WebPData xmp_profile;
+			xmp_profile.bytes = (uint8_t*)FreeImage_GetTagValue(tag);
+			xmp_profile.size = (size_t)FreeImage_GetTagLength(tag);
+			if (WebPMuxSetChunk(mux, "XMP ", &xmp_profile, copy_data) != WEBP_MUX_OK) {
+				throw (1);
+			}
+		}
+	}
 
+	// set Exif metadata
+	{
+		FITAG *tag{};
+		if (FreeImage_GetMetadata(FIMD_EXIF_RAW, dib, g_TagLib_ExifRawFieldName, &tag)) {
+			WebPData exif_profile;
+			exif_profile.bytes = (uint8_t*)FreeImage_GetTagValue(tag);
+			exif_profile.size = (size_t)FreeImage_GetTagLength(tag);
+			if (WebPMuxSetChunk(mux, "EXIF", &exif_profile, copy_data) != WEBP_MUX_OK) {
+				throw (1);
+			}
+		}
+	}
+}
 
-		// convert dib buffer to output stream
+/**
+Write an assembled WebP file to the output stream
+*/
+static FIBOOL
+WriteOutput(FreeImageIO *io, fi_handle handle, const WebPData *output_data) {
+	if (io->write_proc((void*)output_data->bytes, 1, (unsigned)output_data->size, handle) != output_data->size) {
+		FreeImage_OutputMessageProc(s_format_id, "Failed to write webp output file");
+		return FALSE;
+	}
+	return TRUE;
+}
 
-		const uint8_t *bits = FreeImage_GetBits(dib);
+/**
+Add a page of a multipage save as an animation frame.
+The canvas has the size of the first page, frames are shown during their FrameTime metadata (100 ms by default).
+*/
+static FIBOOL
+SaveFrame(WebPContext *context, FIBITMAP *dib, int page, int flags) {
+	WebPPicture picture;
+	if (!WebPPictureInit(&picture)) {
+		return FALSE;
+	}
 
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-		switch (bpp) {
-			case 24:
-				WebPPictureImportBGR(&picture, bits, pitch);
-				break;
-			case 32:
-				WebPPictureImportBGRA(&picture, bits, pitch);
-				break;
-		}
-#else
-		switch (bpp) {
-			case 24:
-				WebPPictureImportRGB(&picture, bits, pitch);
-				break;
-			case 32:
-				WebPPictureImportRGBA(&picture, bits, pitch);
-				break;
+	try {
+		if (page == 0) {
+			WebPAnimEncoderOptions enc_options;
+			if (!WebPAnimEncoderOptionsInit(&enc_options)) {
+				throw "Library version mismatch";
+			}
+			FITAG *tag{};
+			if (FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "Loop", FIDT_LONG, &tag)) {
+				enc_options.anim_params.loop_count = (int)*(const uint32_t*)FreeImage_GetTagValue(tag);
+			}
+			context->anim_encoder.reset(WebPAnimEncoderNew((int)FreeImage_GetWidth(dib), (int)FreeImage_GetHeight(dib), &enc_options));
+			if (!context->anim_encoder) {
+				throw "Failed to create the animation encoder";
+			}
+			context->canvas_width = FreeImage_GetWidth(dib);
+			context->canvas_height = FreeImage_GetHeight(dib);
+			context->timestamp = 0;
+			// the metadata of the first page is kept until the animation is assembled
+			WriteMetadata(context->mux.get(), dib);
+		} else if (!context->anim_encoder) {
+			// a previous frame failed
+			return FALSE;
+		} else if ((FreeImage_GetWidth(dib) != context->canvas_width) || (FreeImage_GetHeight(dib) != context->canvas_height)) {
+			throw "All the frames of an animation must have the size of the first one";
 		}
 
-#endif // FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		WebPConfig config;
+		InitEncoderConfig(&config, flags);
+		picture.use_argb = 1;
+		ImportPicture(&picture, dib);
 
-		if (!WebPEncode(&config, &picture)) {
-			throw "Failed to encode image";
+		if (!WebPAnimEncoderAdd(context->anim_encoder.get(), &picture, context->timestamp, &config)) {
+			throw WebPAnimEncoderGetError(context->anim_encoder.get());
 		}
-
 		WebPPictureFree(&picture);
 
-		if (bIsFlipped) {
-			// invert dib scanlines
-			FreeImage_FlipVertical(dib);
+		uint32_t frame_time = 100;
+		FITAG *tag{};
+		if (FreeImage_GetMetadataEx(FIMD_ANIMATION, dib, "FrameTime", FIDT_LONG, &tag)) {
+			frame_time = *(const uint32_t*)FreeImage_GetTagValue(tag);
 		}
+		context->timestamp += (int)frame_time;
 
 		return TRUE;
 
-	} catch (const char* text) {
-
+	} catch (const char *text) {
 		WebPPictureFree(&picture);
+		if (text) {
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
+		}
+	} catch (int) {
+	}
+	context->anim_encoder.reset();
+	return FALSE;
+}
+
+/**
+Assemble the frames added by SaveFrame and write the animation
+*/
+static FIBOOL
+WriteAnimation(FreeImageIO *io, fi_handle handle, WebPContext *context) {
+	WebPData anim_data = { 0 };
+	WebPData output_data = { 0 };
 
-		if (bIsFlipped) {
-			// invert dib scanlines
-			FreeImage_FlipVertical(dib);
+	try {
+		WebPAnimEncoder *encoder = context->anim_encoder.get();
+
+		// the last frame ends at the final timestamp
+		if (!WebPAnimEncoderAdd(encoder, nullptr, context->timestamp, nullptr) || !WebPAnimEncoderAssemble(encoder, &anim_data)) {
+			throw WebPAnimEncoderGetError(encoder);
 		}
 
+		// add the metadata chunks of the first page
+		std::unique_ptr<WebPMux, decltype(&WebPMuxDelete)> mux(WebPMuxCreate(&anim_data, 0), &WebPMuxDelete);
+		if (!mux) {
+			throw "Failed to create webp output file";
+		}
+		const char *chunk_ids[] = { "ICCP", "XMP ", "EXIF" };
+		for (const char *id : chunk_ids) {
+			WebPData chunk;
+			if (WebPMuxGetChunk(context->mux.get(), id, &chunk) == WEBP_MUX_OK) {
+				if (WebPMuxSetChunk(mux.get(), id, &chunk, 1) != WEBP_MUX_OK) {
+					throw "Failed to create webp output file";
+				}
+			}
+		}
+		if (WebPMuxAssemble(mux.get(), &output_data) != WEBP_MUX_OK) {
+			throw "Failed to create webp output file";
+		}
+
+		const FIBOOL bResult = WriteOutput(io, handle, &output_data);
+
+		WebPDataClear(&output_data);
+		WebPDataClear(&anim_data);
+
+		return bResult;
+
+	} catch (const char *text) {
+		WebPDataClear(&output_data);
+		WebPDataClear(&anim_data);
 		if (text) {
-			FreeImage_OutputMessageProc(s_format_id, text);
+			FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 		}
 	}
-
 	return FALSE;
 }
 
@@ -552,10 +1034,17 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		return FALSE;
 	}
 
+	auto *context = (WebPContext*)data;
+
+	if (page >= 0) {
+		// pages of a multipage bitmap are the frames of an animation
+		return SaveFrame(context, dib, page, flags);
+	}
+
 	try {
 
 		// get the MUX object
-		mux = (WebPMux*)data;
+		mux = context->mux.get();
 		if (!mux) {
 			return FALSE;
 		}
@@ -582,49 +1071,9 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		}
 
 		// --- set metadata ---
-		
-		// set ICC color profile
-		{
-			FIICCPROFILE *iccProfile = FreeImage_GetICCProfile(dib);
-			if (iccProfile->size && iccProfile->data) {
-				WebPData icc_profile;
-				icc_profile.bytes = (uint8_t*)iccProfile->data;
-				icc_profile.size = (size_t)iccProfile->size;
-				error_status = WebPMuxSetChunk(mux, "ICCP", &icc_profile, copy_data);
-				if (error_status != WEBP_MUX_OK) {
-					throw (1);
-				}
-			}
-		}
 
-		// set XMP metadata
-		{
-			FITAG *tag{};
-			if (FreeImage_GetMetadata(FIMD_XMP, dib, g_TagLib_XMPFieldName, &tag)) {
-				WebPData xmp_profile;
-				xmp_profile.bytes = (uint8_t*)FreeImage_GetTagValue(tag);
-				xmp_profile.size = (size_t)FreeImage_GetTagLength(tag);
-				error_status = WebPMuxSetChunk(mux, "XMP ", &xmp_profile, copy_data);
-				if (error_status != WEBP_MUX_OK) {
-					throw (1);
-				}
-			}
-		}
+		WriteMetadata(mux, dib);
 
-		// set Exif metadata
-		{
-			FITAG *tag{};
-			if (FreeImage_GetMetadata(FIMD_EXIF_RAW, dib, g_TagLib_ExifRawFieldName, &tag)) {
-				WebPData exif_profile;
-				exif_profile.bytes = (uint8_t*)FreeImage_GetTagValue(tag);
-				exif_profile.size = (size_t)FreeImage_GetTagLength(tag);
-				error_status = WebPMuxSetChunk(mux, "EXIF", &exif_profile, copy_data);
-				if (error_status != WEBP_MUX_OK) {
-					throw (1);
-				}
-			}
-		}
-		
 		// get data from mux in WebP RIFF format
 		error_status = WebPMuxAssemble(mux, &output_data);
 		if (error_status != WEBP_MUX_OK) {
@@ -633,8 +1082,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		}
 
 		// write the file to the output stream
-		if (io->write_proc((void*)output_data.bytes, 1, (unsigned)output_data.size, handle) != output_data.size) {
-			FreeImage_OutputMessageProc(s_format_id, "Failed to write webp output file");
+		if (!WriteOutput(io, handle, &output_data)) {
 			throw (1);
 		}
 
@@ -667,7 +1115,7 @@ InitWEBP(Plugin *plugin, int format_id) {
 	plugin->regexpr_proc = RegExpr;
 	plugin->open_proc = Open;
 	plugin->close_proc = Close;
-	plugin->pagecount_proc = nullptr;
+	plugin->pagecount_proc = PageCount;
 	plugin->pagecapability_proc = nullptr;
 	plugin->load_proc = Load;
 	plugin->save_proc = Save;
@@ -677,6 +1125,7 @@ InitWEBP(Plugin *plugin, int format_id) {
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = SupportsICCProfiles;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
 
 
@@ -83,10 +83,11 @@ Read an XBM file into a buffer
 @param widthP (return value) Pointer to the bitmap width
 @param heightP (return value) Pointer to the bitmap height
 @param dataP (return value) Pointer to the bitmap buffer
+@param header_only If TRUE, stop after the width and height, the bitmap buffer is not read
 @return Returns NULL if OK, returns an error message otherwise
 */
 static const char* 
-readXBMFile(FreeImageIO *io, fi_handle handle, int *widthP, int *heightP, std::unique_ptr<void, decltype(&free)> &dataP) {
+readXBMFile(FreeImageIO *io, fi_handle handle, int *widthP, int *heightP, std::unique_ptr<void, decltype(&free)> &dataP, FIBOOL header_only) {
 	char line[MAX_LINE], name_and_type[MAX_LINE];
 	char* ptr;
 	char* t;
@@ -150,6 +151,9 @@ readXBMFile(FreeImageIO *io, fi_handle handle, int *widthP, int *heightP, std::u
 	if (*heightP == -1)
 		return( ERR_XBM_HEIGHT );
 
+	if (header_only)
+		return nullptr;
+
 	padding = 0;
 	if ( ((*widthP % 16) >= 1) && ((*widthP % 16) <= 8) && (version == 10) )
 		padding = 1;
@@ -309,22 +313,34 @@ SupportsExportType(FREE_IMAGE_TYPE type) {
 	return FALSE;
 }
 
+static FIBOOL DLL_CALLCONV
+SupportsNoPixels() {
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD;
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	int width, height;
 
+	const FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
 	try {
 		std::unique_ptr<void, decltype(&free)> buffer(nullptr, &free);
 		// load the bitmap data
-		const char* error = readXBMFile(io, handle, &width, &height, buffer);
+		const char* error = readXBMFile(io, handle, &width, &height, buffer, header_only);
 		// Microsoft doesn't implement throw between functions :(
 		if (error) throw (char*)error;
 
 
 		// allocate a new dib
-		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_Allocate(width, height, 1), &FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeader(header_only, width, height, 1), &FreeImage_Unload);
 		if (!dib) throw (char*)ERR_XBM_MEMORY;
 
 		// write the palette data
@@ -332,6 +348,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		pal[0].red = pal[0].green = pal[0].blue = 0;
 		pal[1].red = pal[1].green = pal[1].blue = 255;
 
+		if (header_only) {
+			// header only mode
+			return dib.release();
+		}
+
 		// copy the bitmap
 		auto *bP = static_cast<uint8_t *>(buffer.get());
 		for (int y = 0; y < height; y++) {
@@ -361,7 +382,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		return dib.release();
 
 	} catch(const char *text) {
-		FreeImage_OutputMessageProc(s_format_id, text);
+		FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
 	}
 	return nullptr;
 }
@@ -390,5 +411,7 @@ InitXBM(Plugin *plugin, int format_id) {
 	plugin->supports_export_bpp_proc = SupportsExportDepth;
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
+	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
 
@@ -38,6 +38,9 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#include <string_view>
+#include <vector>
+
 // ==========================================================
 // Plugin Interface
 // ==========================================================
@@ -47,47 +50,150 @@ static int s_format_id;
 // Internal Functions
 // ==========================================================
 
-// read in and skip all junk until we find a certain char
-static FIBOOL
-FindChar(FreeImageIO *io, fi_handle handle, uint8_t look_for) {
-	uint8_t c;
-	io->read_proc(&c, sizeof(uint8_t), 1, handle);
-	while (c != look_for) {
-		if ( io->read_proc(&c, sizeof(uint8_t), 1, handle) != 1 )
-			return FALSE;
+/**
+Parser of the whole file, read in a single buffer
+*/
+class XPMReader {
+public:
+	XPMReader(FreeImageIO *io, fi_handle handle) {
+		const size_t chunk_size = 64 * 1024;
+		size_t size = 0;
+		for (;;) {
+			m_data.resize(size + chunk_size);
+			const unsigned read = io->read_proc(m_data.data() + size, 1, (unsigned)chunk_size, handle);
+			size += read;
+			if (read < chunk_size) {
+				break;
+			}
+		}
+		m_data.resize(size);
 	}
-	return TRUE;
-}
 
-// find start of string, read data until ending quote found, allocate memory and return a string
-static char *
-ReadString(FreeImageIO *io, fi_handle handle) {
-	if (!FindChar(io, handle,'"'))
-		return nullptr;
-	uint8_t c;
-	std::string s;
-	io->read_proc(&c, sizeof(uint8_t), 1, handle);
-	while (c != '"') {
-		s += c;
-		if ( io->read_proc(&c, sizeof(uint8_t), 1, handle) != 1 )
-			return nullptr;
+	/// Bytes left to parse
+	size_t Remaining() const {
+		return m_data.size() - m_pos;
+	}
+
+	/// skip all junk until we find a certain char, the char is consumed
+	bool FindChar(char look_for) {
+		const void *found = memchr(m_data.data() + m_pos, look_for, Remaining());
+		if (!found) {
+			m_pos = m_data.size();
+			return false;
+		}
+		m_pos = static_cast<const char *>(found) - m_data.data() + 1;
+		return true;
+	}
+
+	/// find start of string, return the data until the ending quote
+	bool ReadString(std::string_view& str) {
+		if (!FindChar('"')) {
+			return false;
+		}
+		const size_t start = m_pos;
+		if (!FindChar('"')) {
+			return false;
+		}
+		str = std::string_view(m_data.data() + start, m_pos - 1 - start);
+		return true;
+	}
+
+private:
+	std::vector<char> m_data;
+	size_t m_pos{};
+};
+
+/**
+Colors of the pixel codes of cpp chars: a table indexed by the code for 1 or 2 chars per pixel,
+an open addressing hash table of the codes for longer ones.
+As with a map, the last definition of a code wins, unknown codes give a zero color (index 0 if 8bpp).
+*/
+class XPMColorTable {
+public:
+	XPMColorTable(unsigned cpp, unsigned colors) : m_cpp(cpp) {
+		if (cpp <= 2) {
+			m_direct.resize(cpp == 1 ? 0x100 : 0x10000, FILE_RGBA{});
+		} else {
+			// load factor of 1/2 at most
+			size_t capacity = 16;
+			while (capacity < 2 * (size_t)colors) {
+				capacity *= 2;
+			}
+			m_slots.resize(capacity, -1);
+			m_mask = capacity - 1;
+			m_codes.reserve((size_t)colors * cpp);
+			m_colors.reserve(colors);
+		}
+	}
+
+	void Insert(const char *code, const FILE_RGBA& color) {
+		if (m_cpp <= 2) {
+			m_direct[DirectIndex(code)] = color;
+			return;
+		}
+		for (size_t slot = Hash(code) & m_mask; ; slot = (slot + 1) & m_mask) {
+			const int entry = m_slots[slot];
+			if (entry < 0) {
+				m_slots[slot] = (int)m_colors.size();
+				m_codes.append(code, m_cpp);
+				m_colors.push_back(color);
+				return;
+			}
+			if (memcmp(m_codes.data() + (size_t)entry * m_cpp, code, m_cpp) == 0) {
+				m_colors[entry] = color;
+				return;
+			}
+		}
 	}
-	auto *cstr = (char *)malloc(s.length()+1);
-	strcpy(cstr,s.c_str());
-	return cstr;
-}
 
-static char *
+	FILE_RGBA Find(const char *code) const {
+		if (m_cpp <= 2) {
+			return m_direct[DirectIndex(code)];
+		}
+		for (size_t slot = Hash(code) & m_mask; ; slot = (slot + 1) & m_mask) {
+			const int entry = m_slots[slot];
+			if (entry < 0) {
+				return FILE_RGBA{};
+			}
+			if (memcmp(m_codes.data() + (size_t)entry * m_cpp, code, m_cpp) == 0) {
+				return m_colors[entry];
+			}
+		}
+	}
+
+private:
+	unsigned DirectIndex(const char *code) const {
+		return (m_cpp == 1) ? (uint8_t)code[0] : ((uint8_t)code[0] | ((unsigned)(uint8_t)code[1] << 8));
+	}
+
+	/// FNV-1a
+	uint32_t Hash(const char *code) const {
+		uint32_t hash = 2166136261U;
+		for (unsigned k = 0; k < m_cpp; k++) {
+			hash = (hash ^ (uint8_t)code[k]) * 16777619U;
+		}
+		return hash;
+	}
+
+	unsigned m_cpp;
+	std::vector<FILE_RGBA> m_direct;	// cpp <= 2
+	std::vector<int> m_slots;			// index of the entry in m_codes / m_colors or -1, cpp > 2
+	std::string m_codes;				// cpp chars per entry
+	std::vector<FILE_RGBA> m_colors;
+	size_t m_mask{};
+};
+
+static std::string
 Base92(unsigned int num) {
-	static char b92[16]; //enough for more then 64 bits
-	static char digit[] = " .XoO+@#$%&*=-;:>,<1234567890qwertyuipasdfghjklzxcvbnmMNBVCZASDFGHJKLPIUYTREWQ!~^/()_`'][{}|";
+	static const char digit[] = " .XoO+@#$%&*=-;:>,<1234567890qwertyuipasdfghjklzxcvbnmMNBVCZASDFGHJKLPIUYTREWQ!~^/()_`'][{}|";
+	char b92[16]; //enough for more then 64 bits
 	b92[15] = '\0';
 	int i = 14;
 	do {
 		b92[i--] = digit[num % 92];
 		num /= 92;
 	} while (num && i >= 0);
-	return b92+i+1;
+	return std::string(b92+i+1);
 }
 
 // ==========================================================
@@ -151,6 +257,11 @@ SupportsNoPixels() {
 	return TRUE;
 }
 
+static unsigned DLL_CALLCONV
+Concurrency() {
+	return FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE;
+}
+
 // ----------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -160,30 +271,33 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
     if (!handle) return nullptr;
 
     try {
-		char *str;
+		std::string_view view;
 
 		FIBOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
+		//parse the file from a single buffer
+		XPMReader reader(io, handle);
+
 		//find the starting brace
-		if (!FindChar(io, handle,'{'))
+		if (!reader.FindChar('{'))
 			throw "Could not find starting brace";
 
 		//read info string
-		str = ReadString(io, handle);
-		if (!str)
+		if (!reader.ReadString(view))
 			throw "Error reading info string";
 
 		int width, height, colors, cpp;
-		if (sscanf(str, "%d %d %d %d", &width, &height, &colors, &cpp) != 4) {
-			free(str);
+		if (sscanf(std::string(view).c_str(), "%d %d %d %d", &width, &height, &colors, &cpp) != 4) {
 			throw "Improperly formed info string";
 		}
-		free(str);
 
-		// check info string
+		// check info string, each color needs a string of cpp chars at least
 		if ((width <= 0) || (height <= 0) || (colors <= 0) || (cpp <= 0)) {
 			throw "Improperly formed info string";
 		}
+		if ((size_t)colors * (cpp + 2) > reader.Remaining()) {
+			throw "Error reading color strings";
+		}
 
 		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
         if (colors > 256) {
@@ -192,16 +306,16 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			dib.reset(FreeImage_AllocateHeader(header_only, width, height, 8));
 		}
 
-		//build a map of color chars to rgb values
-		std::map<std::string,FILE_RGBA> rawpal; //will store index in Alpha if 8bpp
+		//build a table of color chars to rgb values
+		XPMColorTable rawpal(cpp, colors); //will store index in Alpha if 8bpp
 		for (int i = 0; i < colors; i++ ) {
 			FILE_RGBA rgba;
 
-			str = ReadString(io, handle);
-			if (!str || (strlen(str) < (size_t)cpp))
+			if (!reader.ReadString(view) || (view.size() < (size_t)cpp))
 				throw "Error reading color strings";
 
-			std::string chrs(str,cpp); //create a string for the color chars using the first cpp chars
+			std::string color_string(view); //copy of the string, parsed in place
+			char *str = color_string.data();
 			char *keys = str + cpp; //the color keys for these chars start after the first cpp chars
 
 			//translate all the tabs to spaces
@@ -245,7 +359,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 							break;
 					}
 					if (n != 3) {
-						free(str);
 						throw "Improperly formed hex color value";
 					}
 					rgba.r = (uint8_t)red;
@@ -279,18 +392,16 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 					if (!FreeImage_LookupX11Color(clr,  &rgba.r, &rgba.g, &rgba.b)) {
 						snprintf(msg, std::size(msg), "Unknown color name '%s'", str);
-						free(str);
 						throw msg;
 					}
 				}
 			} else {
-				free(str);
 				throw "Only color visuals are supported";
 			}
 
-			//add color to map
+			//add color to table, the color chars are the first cpp chars
 			rgba.a = (uint8_t)((colors > 256) ? 0 : i);
-			rawpal[chrs] = rgba;
+			rawpal.Insert(str, rgba);
 
 			//build palette if needed
 			if (colors <= 256) {
@@ -299,8 +410,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				pal[i].green = rgba.g;
 				pal[i].red = rgba.r;
 			}
-
-			free(str);
 		}
 		//done parsing color map
 
@@ -309,40 +418,37 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			return dib.release();
 		}
 
-		//read in pixel data
+		//read in pixel data, the pixels missing from short strings are left to 0
 		for (int y = 0; y < height; y++) {
 			uint8_t *line = FreeImage_GetScanLine(dib.get(), height - y - 1);
-			str = ReadString(io, handle);
-			if (!str)
+			if (!reader.ReadString(view))
 				throw "Error reading pixel strings";
-			char *pixel_ptr = str;
-
-			for (int x = 0; x < width; x++ ) {
-				//locate the chars in the color map
-				std::string chrs(pixel_ptr,cpp);
-				FILE_RGBA rgba = rawpal[chrs];
+			const char *pixel_ptr = view.data();
+			const int row_width = (int)std::min<size_t>(width, view.size() / cpp);
 
-				if (colors > 256) {
+			if (colors > 256) {
+				for (int x = 0; x < row_width; x++, pixel_ptr += cpp) {
+					//locate the chars in the color table
+					const FILE_RGBA rgba = rawpal.Find(pixel_ptr);
 					line[FI_RGBA_BLUE] = rgba.b;
 					line[FI_RGBA_GREEN] = rgba.g;
 					line[FI_RGBA_RED] = rgba.r;
 					line += 3;
-				} else {
-					*line = rgba.a;
-					line++;
 				}
-
-				pixel_ptr += cpp;
+			} else {
+				for (int x = 0; x < row_width; x++, pixel_ptr += cpp) {
+					*line++ = rawpal.Find(pixel_ptr).a;
+				}
 			}
-
-			free(str);
 		}
 		//done reading pixel data
 
 		return dib.release();
 	} catch(const char *text) {
-       FreeImage_OutputMessageProc(s_format_id, text);
-    }
+       FreeImage_OutputMessageProcEx(s_format_id, GetThrownMessageCode(text), text);
+    } catch (const std::bad_alloc &) {
+		FreeImage_OutputMessageProcEx(s_format_id, FIMSG_MEMORY, FI_MSG_ERROR_MEMORY);
+	}
     return nullptr;
 }
 
@@ -414,7 +520,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 		//write colors, using map of chrs->rgb
 		for (x = 0; x < num_colors; x++) {
-			snprintf(buf, std::size(buf), "%*s c #%02x%02x%02x", cpp, Base92(x), chrs2color[x].r, chrs2color[x].g, chrs2color[x].b );
+			snprintf(buf, std::size(buf), "%*s c #%02x%02x%02x", cpp, Base92(x).c_str(), chrs2color[x].r, chrs2color[x].g, chrs2color[x].b );
 			if (io->write_proc(buf, (unsigned int)strlen(buf), 1, handle) != 1)
 				return FALSE;
 			if (x == num_colors - 1) {
@@ -486,5 +592,6 @@ InitXPM(Plugin *plugin, int format_id)
 	plugin->supports_export_type_proc = SupportsExportType;
 	plugin->supports_icc_profiles_proc = nullptr;
 	plugin->supports_no_pixels_proc = SupportsNoPixels;
+	plugin->concurrency_proc = Concurrency;
 }
 
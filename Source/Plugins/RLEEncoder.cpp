@@ -0,0 +1,229 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#include "RLEEncoder.h"
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "FreeImage/CPUDispatch.h"
+
+#if FREEIMAGE_SIMD_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+// narrowing shifts to a 64-bit mask (vshrn_n_u16) and reductions are AArch64 only
+#define FREEIMAGE_RLE_SIMD_NEON 1
+#else
+#define FREEIMAGE_RLE_SIMD_NEON 0
+#endif
+
+namespace {
+
+	/**
+	Index of the lowest set bit, mask must not be 0
+	*/
+	inline unsigned LowestBit(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+		return (unsigned)__builtin_ctzll(mask);
+#else
+		unsigned index = 0;
+		while (!(mask & 1)) {
+			mask >>= 1;
+			index++;
+		}
+		return index;
+#endif
+	}
+
+	/**
+	Compares a and b by vectors of bytes.
+	Kernels return the index of the first equal (Match) or different (Mismatch) byte of the compared vectors,
+	or the number of bytes of the compared vectors when there is none. The remaining bytes are left to the caller.
+	*/
+	using CompareKernel = size_t (*)(const uint8_t *a, const uint8_t *b, size_t count);
+
+	size_t NoCompareKernel(const uint8_t *, const uint8_t *, size_t) {
+		return 0;
+	}
+
+#if FREEIMAGE_SIMD_X86
+
+	// ----------------------------------------------------------
+	//  SSE2 / AVX2 kernels
+	// ----------------------------------------------------------
+
+	template <bool kMatch>
+	size_t Compare_SSE2(const uint8_t *a, const uint8_t *b, size_t count) {
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+			unsigned mask = (unsigned)_mm_movemask_epi8(eq);
+			if (!kMatch) {
+				mask ^= 0xFFFF;
+			}
+			if (mask) {
+				return i + LowestBit(mask);
+			}
+		}
+		return i;
+	}
+
+	template <bool kMatch>
+	FI_TARGET("avx2")
+	size_t Compare_AVX2(const uint8_t *a, const uint8_t *b, size_t count) {
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32) {
+			const __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+			uint32_t mask = (uint32_t)_mm256_movemask_epi8(eq);
+			if (!kMatch) {
+				mask = ~mask;
+			}
+			if (mask) {
+				return i + LowestBit(mask);
+			}
+		}
+		return i;
+	}
+
+#endif // FREEIMAGE_SIMD_X86
+
+#if FREEIMAGE_RLE_SIMD_NEON
+
+	// ----------------------------------------------------------
+	//  NEON kernels
+	// ----------------------------------------------------------
+
+	template <bool kMatch>
+	size_t Compare_NEON(const uint8_t *a, const uint8_t *b, size_t count) {
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			uint8x16_t eq = vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+			if (!kMatch) {
+				eq = vmvnq_u8(eq);
+			}
+			// 4 bits per byte
+			const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+			if (mask) {
+				return i + (LowestBit(mask) >> 2);
+			}
+		}
+		return i;
+	}
+
+#endif // FREEIMAGE_RLE_SIMD_NEON
+
+	// ----------------------------------------------------------
+	//  Kernels selection
+	// ----------------------------------------------------------
+
+	struct CompareKernels {
+		std::atomic<CompareKernel> match{ NoCompareKernel };
+		std::atomic<CompareKernel> mismatch{ NoCompareKernel };
+	};
+
+	CompareKernels gKernels;
+
+	void SelectCompareKernels(uint32_t features) {
+		CompareKernel match = NoCompareKernel;
+		CompareKernel mismatch = NoCompareKernel;
+#if FREEIMAGE_SIMD_X86
+		if (features & FI_CPU_SSE2) {
+			match = Compare_SSE2<true>;
+			mismatch = Compare_SSE2<false>;
+		}
+		if (features & FI_CPU_AVX2) {
+			match = Compare_AVX2<true>;
+			mismatch = Compare_AVX2<false>;
+		}
+#elif FREEIMAGE_RLE_SIMD_NEON
+		if (features & FI_CPU_NEON) {
+			match = Compare_NEON<true>;
+			mismatch = Compare_NEON<false>;
+		}
+#endif
+		gKernels.match.store(match, std::memory_order_relaxed);
+		gKernels.mismatch.store(mismatch, std::memory_order_relaxed);
+	}
+
+	const CPUDispatchRegistrar gRegistrar(SelectCompareKernels);
+
+	/**
+	Index of the first byte equal in a and b, count if there is none
+	*/
+	size_t FindMatch(const uint8_t *a, const uint8_t *b, size_t count) {
+		size_t i = gKernels.match.load(std::memory_order_relaxed)(a, b, count);
+		while ((i < count) && (a[i] != b[i])) {
+			i++;
+		}
+		return i;
+	}
+
+	/**
+	Index of the first byte different in a and b, count if there is none
+	*/
+	size_t FindMismatch(const uint8_t *a, const uint8_t *b, size_t count) {
+		size_t i = gKernels.mismatch.load(std::memory_order_relaxed)(a, b, count);
+		while ((i < count) && (a[i] == b[i])) {
+			i++;
+		}
+		return i;
+	}
+
+} // namespace
+
+// ----------------------------------------------------------
+
+unsigned RLERunLength(const uint8_t *pixels, unsigned count, unsigned pixel_size) {
+	if (count <= 1) {
+		return count;
+	}
+	// pixels [0..n] are equal when every byte of [0..n-1] is equal to the byte of the following pixel
+	const size_t equal = FindMismatch(pixels, pixels + pixel_size, (size_t)(count - 1) * pixel_size);
+	return 1 + (unsigned)(equal / pixel_size);
+}
+
+unsigned RLELiteralLength(const uint8_t *pixels, unsigned count, unsigned pixel_size, unsigned min_run) {
+	const size_t size = (count > 1) ? (size_t)(count - 1) * pixel_size : 0;
+	unsigned pos = 0;
+	while (pos + min_run <= count) {
+		// a byte equal to the byte of the following pixel is a candidate
+		const size_t start = (size_t)pos * pixel_size;
+		const size_t match = start + FindMatch(pixels + start, pixels + start + pixel_size, size - start);
+		if (match == size) {
+			break;
+		}
+		const unsigned candidate = (unsigned)(match / pixel_size);
+		if (candidate + min_run > count) {
+			break;
+		}
+		const unsigned run = RLERunLength(pixels + (size_t)candidate * pixel_size, count - candidate, pixel_size);
+		if (run >= min_run) {
+			return candidate;
+		}
+		// a shorter run can't contain the start of a longer one
+		pos = candidate + run;
+	}
+	return count;
+}
+
+unsigned PackBitsEncodeLine(uint8_t *target, const uint8_t *source, unsigned size) {
+	uint8_t *dst = target;
+	while (size > 0) {
+		if ((size >= 2) && (source[0] == source[1])) {
+			// run of 2 to 127 bytes
+			const unsigned len = RLERunLength(source, MIN(size, 127U), 1);
+			*dst++ = (uint8_t)((-(int)len + 1) & 0xFF);
+			*dst++ = source[0];
+			source += len;
+			size -= len;
+		} else {
+			// literal packet of 1 to 127 bytes, ended by a run of 3 bytes
+			const unsigned len = MIN(127U, RLELiteralLength(source, MIN(size, 129U), 1, 3));
+			*dst++ = (uint8_t)(len - 1);
+			memcpy(dst, source, len);
+			dst += len;
+			source += len;
+			size -= len;
+		}
+	}
+	return (unsigned)(dst - target);
+}
@@ -0,0 +1,50 @@
+//===========================================================
+// FreeImage Re(surrected)
+// Modified fork from the original FreeImage 3.18
+// with updated dependencies and extended features.
+//===========================================================
+
+#ifndef FREEIMAGE_RLEENCODER_H
+#define FREEIMAGE_RLEENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// ----------------------------------------------------------
+//  Run detection shared by the RLE encoders (BMP, PSD, Targa)
+// ----------------------------------------------------------
+
+// Pixels are compared byte by byte, with the SSE2 / AVX2 or NEON kernels supported by the running CPU
+// (16 or 32 bytes at a time), the remaining bytes with scalar code.
+
+/**
+Number of pixels equal to the first one at the start of a run of pixels
+@param pixels First pixel
+@param count Number of pixels to check
+@param pixel_size Size of a pixel in bytes
+@return Returns a value in [1..count], 0 if count is 0
+*/
+unsigned RLERunLength(const uint8_t *pixels, unsigned count, unsigned pixel_size);
+
+/**
+Number of pixels before the first run of at least min_run equal pixels
+@param pixels First pixel
+@param count Number of pixels to check, runs must be complete in these pixels
+@param pixel_size Size of a pixel in bytes
+@param min_run Shortest run ending the literal pixels (2 or more)
+@return Returns the position of the run, count if there is none
+*/
+unsigned RLELiteralLength(const uint8_t *pixels, unsigned count, unsigned pixel_size, unsigned min_run);
+
+/**
+PackBits encoding of a line (Macintosh / PSD RLE): runs of 2 to 127 bytes are written as a 1 - length count
+followed by the byte, other bytes as packets of 1 to 127 bytes preceded by their length - 1.
+Literal packets are ended by runs of at least 3 bytes.
+@param target Encoded bytes, at least size + (size + 126) / 127 bytes
+@param source Bytes to encode
+@param size Number of bytes to encode
+@return Returns the number of encoded bytes
+*/
+unsigned PackBitsEncodeLine(uint8_t *target, const uint8_t *source, unsigned size);
+
+#endif // FREEIMAGE_RLEENCODER_H
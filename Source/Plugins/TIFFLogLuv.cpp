@@ -21,45 +21,32 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImage/ConversionSIMD.h"
 
-void tiff_ConvertLineXYZToRGB(uint8_t *target, uint8_t *source, double stonits, int width_in_pixels) {
-	FIRGBF *rgbf = (FIRGBF*)target;
-	float *xyz = (float*)source;
-	
-	for (int cols = 0; cols < width_in_pixels; cols++) {
-		// assume CCIR-709 primaries (matrix from tif_luv.c)
-		// LOG Luv XYZ (D65) -> sRGB (CIE Illuminant E)
-		rgbf->red	= (float)( 2.690*xyz[0] + -1.276*xyz[1] + -0.414*xyz[2]);
-		rgbf->green	= (float)(-1.022*xyz[0] +  1.978*xyz[1] +  0.044*xyz[2]);
-		rgbf->blue	= (float)( 0.061*xyz[0] + -0.224*xyz[1] +  1.163*xyz[2]);
-		
-		/*
-		if (stonits != 0.0) {
-			rgbf->red	= (float)(rgbf->red   * stonits);
-			rgbf->green	= (float)(rgbf->green * stonits);
-			rgbf->blue	= (float)(rgbf->blue  * stonits);
-		} 
-		*/
+// assume CCIR-709 primaries (matrix from tif_luv.c)
+// LOG Luv XYZ (D65) -> sRGB (CIE Illuminant E)
+static const float XYZToRGB[3][3] = {
+	{  2.690F, -1.276F, -0.414F },
+	{ -1.022F,  1.978F,  0.044F },
+	{  0.061F, -0.224F,  1.163F }
+};
 
-		rgbf++;
-		xyz += 3;
-	}
-}
+// assume CCIR-709 primaries, whitepoint x = 1/3 y = 1/3 (D_E)
+// "The LogLuv Encoding for Full Gamut, High Dynamic Range Images" <G.Ward>
+// sRGB ( CIE Illuminant E ) -> LOG Luv XYZ (D65)
+static const float RGBToXYZ[3][3] = {
+	{ 0.497F, 0.339F, 0.164F },
+	{ 0.256F, 0.678F, 0.066F },
+	{ 0.023F, 0.113F, 0.864F }
+};
 
-void tiff_ConvertLineRGBToXYZ(uint8_t *target, uint8_t *source, int width_in_pixels) {
-	FIRGBF *rgbf = (FIRGBF*)source;
-	float *xyz = (float*)target;
-	
-	for (int cols = 0; cols < width_in_pixels; cols++) {
-		// assume CCIR-709 primaries, whitepoint x = 1/3 y = 1/3 (D_E)
-		// "The LogLuv Encoding for Full Gamut, High Dynamic Range Images" <G.Ward>
-		// sRGB ( CIE Illuminant E ) -> LOG Luv XYZ (D65)
-		xyz[0] =  (float)(0.497*rgbf->red +  0.339*rgbf->green +  0.164*rgbf->blue);
-		xyz[1] =  (float)(0.256*rgbf->red +  0.678*rgbf->green +  0.066*rgbf->blue);
-		xyz[2] =  (float)(0.023*rgbf->red +  0.113*rgbf->green +  0.864*rgbf->blue);
+// both functions convert width_in_pixels pixels of 3 floats with the SSE2 / NEON kernels (see TransformFloat3)
 
-		rgbf++;
-		xyz += 3;
-	}
+void tiff_ConvertLineXYZToRGB(uint8_t *target, uint8_t *source, double stonits, int width_in_pixels) {
+	// stonits (input conversion to nits) is not applied, RGBF pixels keep the relative luminance of the file
+	TransformFloat3(reinterpret_cast<float*>(target), reinterpret_cast<const float*>(source), (unsigned)width_in_pixels, XYZToRGB);
 }
 
+void tiff_ConvertLineRGBToXYZ(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	TransformFloat3(reinterpret_cast<float*>(target), reinterpret_cast<const float*>(source), (unsigned)width_in_pixels, RGBToXYZ);
+}
@@ -36,6 +36,7 @@
 #include "Utilities.h"
 #include "FreeImageTag.h"
 #include "FIRational.h"
+#include "FreeImage/Trace.h"
 
 // ----------------------------------------------------------
 //   Extended TIFF Directory GEO Tag Support
@@ -90,7 +91,7 @@ _XTIFFDefaultDirectory(TIFF *tif) {
 
 /**
 XTIFF Initializer -- sets up the callback procedure for the TIFF module.
-@see PluginTIFF::InitTIFF
+@see PluginTIFF::InitializeTIFF
 */
 void
 XTIFFInitialize(void) {
@@ -550,6 +551,7 @@ Read all known exif tags
 */
 FIBOOL 
 tiff_read_exif_tags(TIFF *tif, TagLib::MDMODEL md_model, FIBITMAP *dib) {
+	TraceScope trace(TraceCategory::eMetadata, "TIFF Exif");
 
 	const TagLib& tagLib = TagLib::instance();
 
@@ -28,6 +28,8 @@
 
 #include "FreeImage.h"
 
+#include <vector>
+
 ////////////////////////////////////////////////////////////////
 
 /**
@@ -50,7 +52,6 @@ typedef struct tagBox {
 protected:
     float *gm2;
 	int32_t *wt, *mr, *mg, *mb;
-	uint16_t *Qadd;
 
 	// DIB data
 	unsigned width, height;
@@ -58,8 +59,8 @@ protected:
 	FIBITMAP *m_dib;
 
 protected:
-    void Hist3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, float *m2, int ReserveSize, FIRGBA8 *ReservePalette);
-	void M3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, float *m2);
+    void Hist3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, double *m2, int ReserveSize, FIRGBA8 *ReservePalette);
+	void M3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, double *m2);
 	int32_t Vol(Box *cube, int32_t *mmt);
 	int32_t Bottom(Box *cube, uint8_t dir, int32_t *mmt);
 	int32_t Top(Box *cube, uint8_t dir, int pos, int32_t *mmt);
@@ -253,6 +254,11 @@ public:
 	/** Constructor */
 	LFPQuantizer(unsigned PaletteSize);
 
+	/** Copy constructor, copies the hash table and the palette state */
+	LFPQuantizer(const LFPQuantizer &other);
+
+	LFPQuantizer& operator=(const LFPQuantizer &) = delete;
+
 	/** Destructor */
 	~LFPQuantizer();
 
@@ -345,6 +351,25 @@ protected:
 	 */
 	void AddReservePalette(const void *palette, unsigned size);
 
+	/**
+	 * Returns the number of pixels following a pixel, up to count, that
+	 * have the specified color.
+	 */
+	typedef unsigned (*MatchRunKernel)(const uint8_t *bits, unsigned count, unsigned color);
+
+	/**
+	 * Converts a scanline into palette indices, runs of identical pixels
+	 * are found by match_run and use a single lookup.
+	 * @return false, if there is no space left in the palette
+	 */
+	bool QuantizeLine(uint8_t *dst_line, const uint8_t *src_line, unsigned width, unsigned bytespp, MatchRunKernel match_run);
+
+	/**
+	 * Returns the colors added since the palette index first, in the
+	 * order of their indices.
+	 */
+	std::vector<unsigned> GetColorsFrom(unsigned first) const;
+
 	/**
 	 * Copies the newly created palette into the specified destination
 	 * palettte. Although unused palette entries are not overwritten in
@@ -37,6 +37,14 @@ void NormalizeY(FIBITMAP *Y, float minPrct, float maxPrct);
 
 FIBITMAP* ClampConvertRGBFTo24(FIBITMAP *src);
 
+// row versions of the conversions above, for the tone mapping operators fusing them into a single pass
+void ConvertRowRGBFToYxy(FIRGBF *target, const FIRGBF *source, unsigned width);
+void ConvertRowYxyToRGBF(FIRGBF *pixel, unsigned width);
+void ConvertRowRGBFToY(float *target, const FIRGBF *source, unsigned width);
+void ClampConvertRowRGBFTo24(uint8_t *target, const FIRGBF *source, unsigned width);
+// matrices of the Yxy conversions, for the compute devices
+void GetYxyMatrices(float rgb_to_xyz[3][3], float xyz_to_rgb[3][3]);
+
 #ifdef __cplusplus
 }
 #endif
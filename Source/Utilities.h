@@ -51,6 +51,7 @@
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <functional>
 
 
 #define FI_QUOTE_(T) #T
@@ -61,14 +62,121 @@
 //   Bitmap palette and pixels alignment
 // ==========================================================
 
-#define FIBITMAP_ALIGNMENT	16	// We will use a 16 bytes alignment boundary
+#define FIBITMAP_ALIGNMENT	64	// We will use a 64 bytes alignment boundary (cache line)
 
 // Memory allocation on a specified alignment boundary
+// through the allocator set by FreeImage_SetAllocator
 // defined in BitmapAccess.cpp
 
 void* FreeImage_Aligned_Malloc(size_t amount, size_t alignment);
+// Same as FreeImage_Aligned_Malloc, returns zeroed memory. With the default allocator, large blocks
+// are taken from fresh system pages which are only committed when written.
+void* FreeImage_Aligned_Calloc(size_t amount, size_t alignment);
 void FreeImage_Aligned_Free(void* mem);
 
+// Changes the type and bit depth of a bitmap in its own memory block, see FreeImage_ConvertInPlace.
+// convert_line(dst, src) is called from the first to the last scanline, dst never being after src.
+// Returns false, leaving the bitmap untouched, if the new format does not fit in the block.
+// defined in BitmapAccess.cpp
+
+bool FreeImage_ReformatInPlace(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp, const std::function<void(uint8_t*, const uint8_t*)>& convert_line);
+
+// Wraps read-only pixels kept alive by owner, released with the last bitmap using them (clones included).
+// Writing to the bitmap or to its clones makes a private copy first, as with copy-on-write clones.
+// defined in BitmapAccess.cpp
+
+FIBITMAP *FreeImage_AllocateHeaderForSharedBits(const uint8_t *bits, unsigned pitch, std::shared_ptr<const void> owner, FREE_IMAGE_TYPE type, int width, int height, int bpp,
+	unsigned red_mask = 0, unsigned green_mask = 0, unsigned blue_mask = 0);
+
+// Convert the pixels of src into dst, an already allocated FIT_BITMAP of the same size with 24 or 32 bits.
+// Metadata are not copied. Returns false if the conversion is not supported.
+// defined in Conversion24.cpp and Conversion32.cpp
+
+bool ConvertTo24BitsInto(FIBITMAP *dst, FIBITMAP *src);
+bool ConvertTo32BitsInto(FIBITMAP *dst, FIBITMAP *src);
+
+// Sharpens an 8, 24 or 32-bit FIT_BITMAP, a 16-bit per sample or a floating point image in its own pixels with an unsharp mask
+// of Gaussian deviation sigma (at most 8), like FreeImage_UnsharpMask. Returns false if the image is not supported.
+// defined in Convolve.cpp
+
+bool UnsharpMaskInPlace(FIBITMAP *dib, double sigma, double amount);
+
+// Fills the size, type and properties of an image info (see FreeImage_GetImageInfo) from a header only bitmap.
+// The page count and the properties only known to the plugin (interlacing, tiles) are left untouched.
+// defined in Plugin.cpp
+
+void FreeImage_FillImageInfo(FIBITMAP *dib, FIIMAGEINFO *info);
+
+// Raw format of the pages of the multipage cache: header, palette, ICC profile, metadata, pixels and thumbnail
+// of a bitmap copied as they are. Decoding returns NULL for a truncated or invalid buffer.
+// Pixels may be stored apart (FIRAW files): they are left out of the encoding, and decoding is given
+// RawBitmapPixels to wrap them or to allocate them uninitialised.
+// defined in MultiPage.cpp
+
+struct RawBitmapPixels {
+	const uint8_t *bits = nullptr;			//! pixels to wrap (see FreeImage_AllocateHeaderForSharedBits), NULL to allocate them
+	unsigned pitch = 0;
+	std::shared_ptr<const void> owner;
+};
+
+void FreeImage_EncodeRawBitmap(FIBITMAP *dib, std::vector<uint8_t> &buffer, bool with_pixels = true);
+FIBITMAP *FreeImage_DecodeRawBitmap(const uint8_t *data, size_t size, const RawBitmapPixels *pixels = nullptr);
+
+// ==========================================================
+//   Parallel execution helpers
+// ==========================================================
+
+// Splits [begin, end) into bands of at least min_grain items and runs body(band_begin, band_end)
+// on the library thread pool. Runs serially if multithreading is disabled or called from a pool worker.
+// Returns when all bands are processed; the first exception thrown by body is rethrown.
+// defined in ThreadPool.cpp
+
+void ParallelFor(unsigned begin, unsigned end, unsigned min_grain, const std::function<void(unsigned, unsigned)>& body);
+
+// Returns number of scanlines per band so that one band processes about 64 KB of data
+
+inline unsigned CalculateBandRows(size_t line_bytes) {
+	constexpr size_t band_bytes = 64 * 1024;
+	return static_cast<unsigned>(std::max<size_t>(1, band_bytes / std::max<size_t>(1, line_bytes)));
+}
+
+// Calls convert(dst_scanline, src_scanline) for every scanline of two bitmaps of the same height,
+// scanlines are processed by parallel bands. Source pixels are read with FreeImage_GetConstBits,
+// so a source sharing its pixels with clones is not copied.
+
+template <typename LineConverter_>
+inline void ConvertScanLines(FIBITMAP *dst, FIBITMAP *src, LineConverter_ convert) {
+	const unsigned height = std::min(FreeImage_GetHeight(dst), FreeImage_GetHeight(src));
+	const unsigned dst_pitch = FreeImage_GetPitch(dst);
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	uint8_t *dst_bits = FreeImage_GetBits(dst);
+	// line converters take a mutable source for historical reasons, but never write to it
+	auto *src_bits = const_cast<uint8_t *>(FreeImage_GetConstBits(src));
+	if (!dst_bits || !src_bits) {
+		return;
+	}
+	const size_t line_bytes = std::max(FreeImage_GetLine(dst), FreeImage_GetLine(src));
+	ParallelFor(0, height, CalculateBandRows(line_bytes), [&](unsigned first, unsigned last) {
+		for (unsigned y = first; y < last; ++y) {
+			convert(dst_bits + (size_t)dst_pitch * y, src_bits + (size_t)src_pitch * y);
+		}
+	});
+}
+
+// Copies the line_bytes first bytes of row into height scanlines starting at bits, by parallel bands.
+// Large fills use non-temporal stores when the CPU supports them, so that the filled image does not
+// evict the caches. Defined in SimpleTools.cpp.
+
+void FillScanLines(uint8_t *bits, unsigned pitch, unsigned height, const uint8_t *row, unsigned line_bytes);
+
+// Repeats the value_size bytes at the beginning of row until line_bytes are filled.
+
+inline void RepeatPattern(uint8_t *row, size_t value_size, size_t line_bytes) {
+	for (size_t filled = value_size; filled < line_bytes; filled *= 2) {
+		memcpy(row + filled, row, std::min(filled, line_bytes - filled));
+	}
+}
+
 
 
 // ==========================================================
@@ -244,6 +352,11 @@ CalculateScanLine(uint8_t *bits, const unsigned pitch, const int scanline) {
 	return bits ? (bits + ((size_t)pitch * scanline)) : nullptr;
 }
 
+inline const uint8_t*
+CalculateScanLine(const uint8_t *bits, const unsigned pitch, const int scanline) {
+	return bits ? (bits + ((size_t)pitch * scanline)) : nullptr;
+}
+
 // ----------------------------------------------------------
 
 /**
@@ -373,6 +486,128 @@ SwapInt64(uint64_t *arg) {
 #endif
 }
 
+// ==========================================================
+//   Half float conversion
+// ==========================================================
+
+/**
+Converts an IEEE 754 binary16 value to float (exact, including denormals and infinities)
+*/
+inline float
+HalfToFloat(uint16_t h) {
+	const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1F;
+	uint32_t mantissa = h & 0x3FF;
+	uint32_t bits;
+	if (exponent == 0x1F) {
+		// infinity or NaN (quieted)
+		bits = sign | 0x7F800000 | (mantissa ? (0x400000 | (mantissa << 13)) : 0);
+	} else if (exponent != 0) {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	} else if (mantissa != 0) {
+		// denormal, normalized as a float
+		exponent = 113;
+		while (!(mantissa & 0x400)) {
+			mantissa <<= 1;
+			exponent--;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+	} else {
+		bits = sign;
+	}
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+/**
+Converts a float to the nearest IEEE 754 binary16 value (ties to even, as F16C and NEON do)
+*/
+inline uint16_t
+FloatToHalf(float f) {
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	const uint32_t abs = bits & 0x7FFFFFFF;
+	if (abs >= 0x7F800000) {
+		// infinity or NaN (kept quiet)
+		return sign | 0x7C00 | ((abs > 0x7F800000) ? (0x200 | ((abs >> 13) & 0x3FF)) : 0);
+	}
+	if (abs >= 0x477FF000) {
+		// rounds above 65504
+		return sign | 0x7C00;
+	}
+	if (abs < 0x38800000) {
+		// denormal or zero
+		if (abs < 0x33000000) {
+			return sign;
+		}
+		const uint32_t shift = 126 - (abs >> 23);
+		const uint32_t mantissa = (abs & 0x7FFFFF) | 0x800000;
+		uint32_t h = mantissa >> shift;
+		const uint32_t rest = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		if ((rest > halfway) || ((rest == halfway) && (h & 1))) {
+			h++;
+		}
+		return sign | (uint16_t)h;
+	}
+	uint32_t h = (abs - 0x38000000) >> 13;
+	const uint32_t rest = abs & 0x1FFF;
+	if ((rest > 0x1000) || ((rest == 0x1000) && (h & 1))) {
+		h++;
+	}
+	return sign | (uint16_t)h;
+}
+
+// ==========================================================
+//   RGBE (Radiance HDR) conversion
+// ==========================================================
+
+/**
+Converts a RGBE pixel to float: each channel is c * 2^(e - 136), a zero exponent gives black.
+Note: Ward uses ldexp(c + 0.5, e - 136), however we want pixels in the range [0,1] to map back into the range [0,1].
+*/
+inline void
+RGBEToFloat(FIRGBF *rgbf, const uint8_t rgbe[4]) {
+	if (rgbe[3]) {
+		const float f = (float)ldexp(1.0, rgbe[3] - (int)(128 + 8));
+		rgbf->red   = rgbe[0] * f;
+		rgbf->green = rgbe[1] * f;
+		rgbf->blue  = rgbe[2] * f;
+	}
+	else {
+		rgbf->red = rgbf->green = rgbf->blue = 0;
+	}
+}
+
+/**
+Converts a float pixel to RGBE: the exponent is the one of the largest channel, mantissas are truncated.
+Pixels whose largest channel is below 1e-32 (including negative ones) are stored as black.
+*/
+inline void
+FloatToRGBE(uint8_t rgbe[4], const FIRGBF *rgbf) {
+	float v = rgbf->red;
+	if (rgbf->green > v) {
+		v = rgbf->green;
+	}
+	if (rgbf->blue > v) {
+		v = rgbf->blue;
+	}
+	if (v < 1e-32) {
+		rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+	}
+	else {
+		int e;
+		v = (float)(frexp(v, &e) * 256.0 / v);
+		// truncated through int so that negative channels wrap the same way as the SIMD kernels
+		rgbe[0] = (uint8_t)(int)(rgbf->red * v);
+		rgbe[1] = (uint8_t)(int)(rgbf->green * v);
+		rgbe[2] = (uint8_t)(int)(rgbf->blue * v);
+		rgbe[3] = (uint8_t)(e + 128);
+	}
+}
+
 // ==========================================================
 //   Greyscale and color conversion
 // ==========================================================
@@ -435,12 +670,27 @@ Create a reverse greyscale palette
 //   Generic error messages
 // ==========================================================
 
-static const char *FI_MSG_ERROR_MEMORY = "Memory allocation failed";
-static const char *FI_MSG_ERROR_DIB_MEMORY = "DIB allocation failed, maybe caused by an invalid image size or by a lack of memory";
-static const char *FI_MSG_ERROR_PARSING = "Parsing error";
-static const char *FI_MSG_ERROR_MAGIC_NUMBER = "Invalid magic number";
-static const char *FI_MSG_ERROR_UNSUPPORTED_FORMAT = "Unsupported format";
-static const char *FI_MSG_ERROR_UNSUPPORTED_COMPRESSION = "Unsupported compression type";
+// one object each, so that thrown messages are recognized by address (see GetThrownMessageCode)
+inline constexpr char FI_MSG_ERROR_MEMORY[] = "Memory allocation failed";
+inline constexpr char FI_MSG_ERROR_DIB_MEMORY[] = "DIB allocation failed, maybe caused by an invalid image size or by a lack of memory";
+inline constexpr char FI_MSG_ERROR_PARSING[] = "Parsing error";
+inline constexpr char FI_MSG_ERROR_MAGIC_NUMBER[] = "Invalid magic number";
+inline constexpr char FI_MSG_ERROR_UNSUPPORTED_FORMAT[] = "Unsupported format";
+inline constexpr char FI_MSG_ERROR_UNSUPPORTED_COMPRESSION[] = "Unsupported compression type";
 static const char *FI_MSG_WARNING_INVALID_THUMBNAIL = "Warning: attached thumbnail cannot be written to output file (invalid format) - Thumbnail saving aborted";
 
+/**
+Returns the code of a message thrown as text, FIMSG_NONE to derive it from the text unless it is one of the messages above
+*/
+inline FREE_IMAGE_MESSAGE
+GetThrownMessageCode(const char *text) {
+	if (text == FI_MSG_ERROR_MEMORY) return FIMSG_MEMORY;
+	if (text == FI_MSG_ERROR_DIB_MEMORY) return FIMSG_DIB_MEMORY;
+	if (text == FI_MSG_ERROR_PARSING) return FIMSG_PARSING;
+	if (text == FI_MSG_ERROR_MAGIC_NUMBER) return FIMSG_MAGIC_NUMBER;
+	if (text == FI_MSG_ERROR_UNSUPPORTED_FORMAT) return FIMSG_UNSUPPORTED_FORMAT;
+	if (text == FI_MSG_ERROR_UNSUPPORTED_COMPRESSION) return FIMSG_UNSUPPORTED_COMPRESSION;
+	return FIMSG_NONE;
+}
+
 #endif // FREEIMAGE_UTILITIES_H
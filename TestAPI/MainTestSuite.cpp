@@ -65,10 +65,144 @@ int main(int argc, char *argv[]) {
 
 	// test plugins capabilities
 	showPlugins();
+	testPluginFeatures();
+
+	// test thread pool settings
+	testThreadCount();
+	testRescaleParallel();
+	testRescaleRectFloat();
+	testConvertParallel();
+	testConvertLineKernels();
+	testCPUFeatures();
+	testConvertTypeKernels();
+	testYuvKernels();
+	testFloatKernels();
+	testTransferKernels();
+	testICCTransform();
+	testComputeMetric();
+	testCMYKLabKernels();
+	testRawBitsKernels();
+	testRotateKernels();
+	testFlipKernels();
+	testAffineTransform();
+	testRotateExParallel();
+	testRescaleFixedPoint();
+	testPasteKernels();
+	testBlendKernels();
+	testPreMultiplyKernels();
+	testFillKernels();
+	testEnlargeCanvas();
+	testColorMapping();
+	testLUTKernels();
+	testHistogramParallel();
+	testMinMaxParallel();
+	testChannelsSplitMerge();
+	testExportTensor();
+	testMultigridParallel();
+	testPoissonDCT();
+	testFFT2D();
+	testFattalPyramid();
+	testToneMapParallel();
+	testToneMapColorKernels();
+	testComputeBackend();
+	testWuQuantizer();
+	testNNQuantizer();
+	testLFPQuantizer();
+	testPaletteMapper();
+	testDitherParallel();
+	testBinarize();
+	testConvolve();
+	testRescaleSharpen();
+	testThumbnailSet();
+	testRescaleBoxReduction();
+	testRescaleFloatKernels();
+	testRescaleWordKernels();
+	testRescaleVerticalTiles();
+	testStreamingResize();
+	testRescaleLinearLight();
+
+	// test orientation of views
+	testOrientedView();
+	testImageView();
+
+	// test custom allocator
+	testAllocator();
+
+	// test bitmap pools
+	testBitmapPool();
+
+	// test copy-on-write clones
+	testCloneCopyOnWrite();
+	testMetadataCopyOnWrite();
+	testMetadataArena();
+
+	// test tag to string conversions
+	testTagToStringBuf();
+
+	// test statistics and trace callbacks
+	testStats();
+
+	// test memory accounting and budgets
+	testMemoryBudget();
+
+	// test the decoded image cache
+	testImageCache();
 
 	// test internal image types
 	testImageType(width, height);
 
+	// test GIF LZW coding
+	testGIFLZW();
+
+	// test GIF playback of multipage bitmaps
+	testGIFPlayback();
+
+	// test GIF encoding of 32-bit frames on the thread pool
+	testGIFEncoding();
+
+	// test DDS block decoders and mipmap levels
+	testDDS();
+
+	// test DDS block encoders and mipmap chains
+	testDDSSave();
+
+	// test HDR conversions and parallel scanlines
+	testHDR();
+
+	// test PSD layers as pages
+	testPSDLayers();
+
+	// test PNM buffered and parallel parsing
+	testPNM();
+
+	// test FreeImage raw bitmaps, loaded in place when mapped
+	testFIRAW();
+
+	// test Targa and BMP RLE decoders
+	testRLE();
+
+	// test SGI RLE and uncompressed planes
+	testSGI();
+
+	// test XPM color tables and parsing
+	testXPM();
+
+	// test PFM loading, in place when mapped
+	testPFM();
+
+	// test ICO best fitting icon loading
+	testICOBestFit();
+
+#if FREEIMAGE_WITH_LIBJPEG && FREEIMAGE_WITH_LIBPNG
+	// test JNG chunks decoding
+	testJNG();
+#endif
+
+#if FREEIMAGE_WITH_LIBJPEG && FREEIMAGE_WITH_LIBPNG
+	// test image info probes
+	testImageInfo();
+#endif
+
 #if FREEIMAGE_WITH_LIBJPEG
 	// test the clone function
 	testAllocateCloneUnload("exif.jpg");
@@ -79,8 +213,24 @@ int main(int argc, char *argv[]) {
 	// test Exif raw metadata loading & saving
 	testExifRaw();
 
+	// test Exif tags parsed on first access
+	testExifDeferred();
+
+	// test metadata models selected by load options
+	testLoadOptions();
+
+	// test IPTC markers saved as read
+	testIPTCPassthrough();
+
 	// test thumbnail functions
 	testThumbnail("exif.jpg", 0);
+	testLoadScaled("exif.jpg");
+
+	// test region loading
+	testLoadRegion("exif.jpg");
+
+	// test JPEG stream buffers
+	testStreamBufferSize("exif.jpg");
 
 	// test wrapped user buffer
 	testWrappedBuffer("exif.jpg", 0);
@@ -93,6 +243,27 @@ int main(int argc, char *argv[]) {
 	// test loading / saving / converting image types using the TIFF plugin
 	testImageTypeTIFF(width, height);
 
+	// test parallel strip and tile decoding
+	testTIFFParallel();
+
+	// test tiled and pyramid saving
+	testTIFFTiled();
+
+	// test region and pyramid level loading
+	testTIFFRegion();
+
+	// test BigTIFF saving
+	testTIFFBigTIFF();
+
+	// test random access to the pages of large files
+	testTIFFPageAccess();
+
+	// test CCITT Group 3 and Group 4 decoding
+	testTIFFFax();
+
+	// test LogLuv encoding and parallel decoding
+	testTIFFLogLuv();
+
 	// test multipage streaming
 	testStreamMultiPage("sample.tif");
 
@@ -104,6 +275,33 @@ int main(int argc, char *argv[]) {
 	// test memory IO
 	testMemIO("sample.png");
 
+	// test asynchronous load / save
+	testAsyncIO("sample.png");
+
+	// test non-throwing loads and saves
+	testTryLoad("sample.png");
+
+	// test per-thread message handlers
+	testThreadMessages();
+
+	// test loading fitted into a box
+	testLoadScaled("sample.png");
+
+	// test parallel PNG compression
+	testPNGParallel("sample.png");
+
+	// test deflate level and strategy options
+	testZLibOptions("sample.png");
+
+	// test row callbacks of progressive loads
+	testRowCallback("sample.png");
+
+	// test pass callbacks of interlaced images
+	testPassCallback("sample.png");
+
+	// test loading trusted PNG without integrity checks
+	testPNGTrusted("sample.png");
+
 	// test multipage functions
 	testMultiPage("sample.png");
 
@@ -111,20 +309,85 @@ int main(int argc, char *argv[]) {
 	testImageChannels(width, height);
 #endif
 
+#if FREEIMAGE_WITH_LIBOPENEXR
+	// test EXR compressions and multithreading
+	testEXRCompression();
+
+	// test half float images
+	testEXRHalf();
+
+	// test EXR region loading
+	testEXRRegion();
+
+	// test EXR mipmap / ripmap levels and tiled regions
+	testEXRLevels();
+	testEXRTiledRegion();
+#endif
+
+#if FREEIMAGE_WITH_LIBWEBP
+	// test WebP encoder options
+	testWebPOptions();
+
+	// test incremental WebP decoding
+	testWebPStreaming();
+#endif
+
+#if FREEIMAGE_WITH_LIBWEBP && FREEIMAGE_WITH_LIBTIFF
+	// test animated WebP pages
+	testWebPAnimation();
+#endif
+
+#if FREEIMAGE_WITH_LIBRAW
+	// test RAW loading from memory streams and mapped files
+	testRAWMemory();
+#endif
+
 #if FREEIMAGE_WITH_LIBJXR
 	// test memory IO
 	testMemIO("exif.jxr");
 #endif
 
+#if FREEIMAGE_WITH_LIBOPENJPEG && FREEIMAGE_WITH_LIBPNG
+	// test reduced resolution and region decoding
+	testJ2K(FIF_J2K, "sample.png");
+	testJ2K(FIF_JP2, "sample.png");
+#endif
+
+#if FREEIMAGE_WITH_LIBJXR && FREEIMAGE_WITH_LIBPNG
+	// test JPEG XR reduced resolution and region decoding
+	testJXR("sample.png");
+#endif
+
 #if FREEIMAGE_WITH_LIBHEIF
 	testHeif(FIF_HEIF, "exif.heic", "heif_out.heic");
 	testHeif(FIF_AVIF, "exif.avif", "avif_out.avif");
+
+	// test region loading and previews
+	testHeifRegion(FIF_HEIF, "exif.heic");
+	testHeifPreview(FIF_HEIF, "exif.heic");
+	testHeifPreview(FIF_AVIF, "exif.avif");
+
+	// test encoder options
+	testHeifOptions(FIF_HEIF, "exif.heic");
+	testHeifOptions(FIF_AVIF, "exif.avif");
 #endif
 
 #if FREEIMAGE_WITH_LIBPNG && FREEIMAGE_WITH_LIBJPEG
 	// test loading header only
 	testHeaderOnly();
 #endif
+
+	// test concurrent loading and registry access
+	testConcurrency();
+
+	// test in-place conversions
+	testConvertInPlace();
+
+	// test conversions into caller provided bitmaps
+	testConvertInto();
+
+	// test fused pipelines of operations
+	testPipeline();
 	
 
 #if defined(FREEIMAGE_LIB) || !defined(WIN32)
@@ -134,6 +397,7 @@ int main(int argc, char *argv[]) {
 	// other tests
 	testConvertToFloat();
 	testConvertToColor();
+	testConvertToYUVPlanes();
 	testFindMinMax();
 	testTmoClamp();
 	testTmoLinear();
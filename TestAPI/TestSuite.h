@@ -29,6 +29,7 @@
 #include <assert.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <functional>
 
 #if (defined(WIN32) || defined(__WIN32__))
 #if (defined(_DEBUG))
@@ -40,10 +41,14 @@
 // Some useful tools
 // ==========================================================
 FIBITMAP* createZonePlateImage(unsigned width, unsigned height, int scale);
+bool isSameBitmap(FIBITMAP* lhs, FIBITMAP* rhs);
+void runScalarAndSIMD(const std::function<void(bool vector)> &run);
+bool isSameScalarAndSIMD(const std::function<FIBITMAP*()> &make);
 
 // Test plugins capabilities
 // ==========================================================
 void showPlugins();
+void testPluginFeatures();
 
 // Image types test suite
 // ==========================================================
@@ -59,11 +64,22 @@ void testHeaderOnly();
 // Exif raw metadata loading & saving test suite
 // ==========================================================
 void testExifRaw();
+void testExifDeferred();
+void testLoadOptions();
+void testIPTCPassthrough();
 
 // IO test suite
 // ==========================================================
 
 void testMemIO(const char *lpszPathName);
+void testLoadRegion(const char *lpszPathName);
+void testStreamBufferSize(const char *lpszPathName);
+void testAsyncIO(const char *lpszPathName);
+void testTryLoad(const char *lpszPathName);
+void testThreadMessages();
+void testStats();
+void testMemoryBudget();
+void testImageCache();
 
 // Multipage test suite
 // ==========================================================
@@ -81,11 +97,15 @@ void testJPEG();
 // ==========================================================
 
 void testImageChannels(unsigned width, unsigned height);
+void testChannelsSplitMerge();
+void testExportTensor();
 
 
 // Thumbnails test suite
 // ==========================================================
 void testThumbnail(const char *lpszPathName, int flags);
+void testLoadScaled(const char *lpszPathName);
+void testThumbnailSet();
 
 // Wrapped buffer test suite
 // ==========================================================
@@ -93,17 +113,157 @@ void testThumbnail(const char *lpszPathName, int flags);
 void testWrappedBuffer(const char *lpszPathName, int flags);
 
 void testCreateView(const char *lpszPathName, int flags);
+void testOrientedView();
+void testImageView();
+
+// Conversion test suite
+// ==========================================================
+
+void testConvertParallel();
+void testConvertLineKernels();
+void testYuvKernels();
+void testCMYKLabKernels();
+void testRawBitsKernels();
+void testFloatKernels();
+void testTransferKernels();
+void testConvertTypeKernels();
+
+// Color management test suite
+// ==========================================================
+
+void testICCTransform();
+
+// Image metrics test suite
+// ==========================================================
+
+void testComputeMetric();
+
+// Color functions test suite
+// ==========================================================
+
+void testColorMapping();
+void testLUTKernels();
+void testHistogramParallel();
+
+// Tone mapping test suite
+// ==========================================================
+
+void testMultigridParallel();
+void testPoissonDCT();
+void testFattalPyramid();
+void testToneMapParallel();
+void testToneMapColorKernels();
+
+// FFT test suite
+// ==========================================================
+
+void testFFT2D();
+
+// Quantization test suite
+// ==========================================================
+
+void testWuQuantizer();
+void testNNQuantizer();
+void testLFPQuantizer();
+void testPaletteMapper();
+void testDitherParallel();
+void testBinarize();
+
+// Allocator test suite
+// ==========================================================
+
+void testAllocator();
+void testBitmapPool();
+void testCloneCopyOnWrite();
+
+// Metadata test suite
+// ==========================================================
+
+void testMetadataCopyOnWrite();
+void testMetadataArena();
+void testTagToStringBuf();
 
 // Other tests
 // ==========================================================
 
 void testConvertToFloat();
 void testConvertToColor();
+void testConvertToYUVPlanes();
 void testFindMinMax();
 void testTmoClamp();
 void testTmoLinear();
 void testHistogram();
+void testRescaleParallel();
+void testRescaleRectFloat();
+void testRotateKernels();
+void testFlipKernels();
+void testAffineTransform();
+void testRotateExParallel();
+void testRescaleFixedPoint();
+void testPasteKernels();
+void testBlendKernels();
+void testPreMultiplyKernels();
+void testFillKernels();
+void testEnlargeCanvas();
+void testMinMaxParallel();
+void testComputeBackend();
+void testConvolve();
+void testRescaleSharpen();
+void testRescaleBoxReduction();
+void testRescaleFloatKernels();
+void testRescaleWordKernels();
+void testRescaleVerticalTiles();
+void testStreamingResize();
+void testRescaleLinearLight();
 void testHeif(FREE_IMAGE_FORMAT fif, const char* src_path, const char* dst_path);
+void testHeifRegion(FREE_IMAGE_FORMAT fif, const char* src_path);
+void testHeifPreview(FREE_IMAGE_FORMAT fif, const char* src_path);
+void testHeifOptions(FREE_IMAGE_FORMAT fif, const char* src_path);
+void testPNGParallel(const char *lpszPathName);
+void testZLibOptions(const char *lpszPathName);
+void testRowCallback(const char *lpszPathName);
+void testPassCallback(const char *lpszPathName);
+void testPNGTrusted(const char *lpszPathName);
+void testTIFFParallel();
+void testTIFFTiled();
+void testTIFFRegion();
+void testTIFFBigTIFF();
+void testTIFFPageAccess();
+void testTIFFFax();
+void testTIFFLogLuv();
+void testEXRCompression();
+void testEXRHalf();
+void testEXRRegion();
+void testEXRLevels();
+void testEXRTiledRegion();
+void testGIFLZW();
+void testGIFPlayback();
+void testGIFEncoding();
+void testJ2K(FREE_IMAGE_FORMAT fif, const char *lpszPathName);
+void testJXR(const char *lpszPathName);
+void testDDS();
+void testDDSSave();
+void testHDR();
+void testPSDLayers();
+void testPNM();
+void testFIRAW();
+void testRAWMemory();
+void testRLE();
+void testSGI();
+void testXPM();
+void testPFM();
+void testICOBestFit();
+void testJNG();
+void testImageInfo();
+void testConcurrency();
+void testThreadCount();
+void testCPUFeatures();
+void testConvertInPlace();
+void testConvertInto();
+void testPipeline();
+void testWebPOptions();
+void testWebPStreaming();
+void testWebPAnimation();
 
 #endif // TEST_FREEIMAGE_API_H
 
@@ -0,0 +1,176 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <memory>
+
+namespace {
+
+	struct AllocatorStats
+	{
+		int allocations = 0;
+		int releases = 0;
+	};
+
+	void* DLL_CALLCONV countingMalloc(size_t size, size_t alignment, void* user_ctx)
+	{
+		static_cast<AllocatorStats*>(user_ctx)->allocations++;
+#ifdef _WIN32
+		return _aligned_malloc(size, alignment);
+#else
+		return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+	}
+
+	void DLL_CALLCONV countingFree(void* ptr, void* user_ctx)
+	{
+		static_cast<AllocatorStats*>(user_ctx)->releases++;
+#ifdef _WIN32
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+
+} // namespace
+
+void testAllocator()
+{
+	AllocatorStats stats;
+	assert(!FreeImage_SetAllocator(&countingMalloc, nullptr, &stats));
+	assert(FreeImage_SetAllocator(&countingMalloc, &countingFree, &stats));
+
+	FIBITMAP* custom = FreeImage_Allocate(33, 17, 24);
+	assert(custom != nullptr);
+	assert(stats.allocations == 1);
+	// pixels are aligned on cache lines
+	assert(reinterpret_cast<uintptr_t>(FreeImage_GetBits(custom)) % 64 == 0);
+
+	FIBITMAP* clone = FreeImage_Clone(custom);
+	assert(clone != nullptr);
+	assert(stats.allocations == 2);
+	FreeImage_Unload(clone);
+	assert(stats.releases == 1);
+
+	// restore default allocator, the custom bitmap is still released by its own allocator
+	assert(FreeImage_SetAllocator(nullptr, nullptr, nullptr));
+	FIBITMAP* standard = FreeImage_Allocate(33, 17, 24);
+	assert(standard != nullptr);
+	assert(reinterpret_cast<uintptr_t>(FreeImage_GetBits(standard)) % 64 == 0);
+	FreeImage_Unload(standard);
+	FreeImage_Unload(custom);
+	assert(stats.allocations == 2);
+	assert(stats.releases == 2);
+}
+
+void testBitmapPool()
+{
+	FIBITMAPPOOL* pool = FreeImage_CreateBitmapPool(FIT_BITMAP, 32, 16, 8, 2);
+	assert(pool != nullptr);
+
+	FIBITMAP* first = FreeImage_AllocateFromPool(pool);
+	assert(first != nullptr);
+	assert(FreeImage_GetWidth(first) == 32 && FreeImage_GetHeight(first) == 16 && FreeImage_GetBPP(first) == 8);
+
+	// attach some data and modify the header
+	char profile[16] = {};
+	assert(FreeImage_CreateICCProfile(first, profile, sizeof(profile)) != nullptr);
+	assert(FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, first, "Comment", "pooled"));
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> thumbnail(FreeImage_Allocate(4, 4, 24), &::FreeImage_Unload);
+	assert(FreeImage_SetThumbnail(first, thumbnail.get()));
+	FreeImage_SetDotsPerMeterX(first, 1000);
+	FreeImage_GetPalette(first)[10].red = 0;
+	FreeImage_Unload(first);
+
+	// the same bitmap comes back reset
+	FIBITMAP* second = FreeImage_AllocateFromPool(pool);
+	assert(second == first);
+	assert(FreeImage_GetICCProfile(second)->data == nullptr);
+	assert(FreeImage_GetMetadataCount(FIMD_COMMENTS, second) == 0);
+	assert(FreeImage_GetThumbnail(second) == nullptr);
+	assert(FreeImage_GetDotsPerMeterX(second) == 2835);
+	assert(FreeImage_GetPalette(second)[10].red == 10);
+
+	// clones are not pooled
+	FIBITMAP* clone = FreeImage_Clone(second);
+	assert(clone != nullptr);
+	FreeImage_Unload(clone);
+
+	// pool keeps at most 'capacity' bitmaps
+	FIBITMAP* third = FreeImage_AllocateFromPool(pool);
+	FIBITMAP* fourth = FreeImage_AllocateFromPool(pool);
+	assert(third && fourth && third != second && fourth != second);
+	FreeImage_Unload(third);
+	FreeImage_Unload(fourth);
+
+	// bitmaps in use survive the pool
+	FreeImage_DeleteBitmapPool(pool);
+	assert(FreeImage_GetWidth(second) == 32);
+	FreeImage_Unload(second);
+}
+
+void testCloneCopyOnWrite()
+{
+	FIBITMAP* src = FreeImage_Allocate(16, 8, 8);
+	assert(src != nullptr);
+	FreeImage_GetScanLine(src, 3)[5] = 42;
+
+	// clones share pixels until written
+	FIBITMAP* clone = FreeImage_Clone(src);
+	FIBITMAP* snapshot = FreeImage_Clone(clone);
+	assert(clone && snapshot);
+	assert(FreeImage_GetConstBits(clone) == FreeImage_GetConstBits(src));
+	assert(FreeImage_GetConstBits(snapshot) == FreeImage_GetConstBits(src));
+	assert(FreeImage_GetConstScanLine(snapshot, 3)[5] == 42);
+
+	// writing to the clone makes its private copy
+	const FIBITMAPINFOHEADER* info = FreeImage_GetInfoHeader(clone);
+	uint8_t* line = FreeImage_GetScanLine(clone, 3);
+	assert(FreeImage_GetConstBits(clone) != FreeImage_GetConstBits(src));
+	assert(line[5] == 42);
+	// the replaced header stays readable until the clone is unloaded
+	assert(info->biWidth == 16);
+	line[5] = 7;
+	assert(FreeImage_GetConstScanLine(src, 3)[5] == 42);
+	assert(FreeImage_GetConstScanLine(snapshot, 3)[5] == 42);
+
+	// the snapshot outlives the original bitmap
+	const uint8_t* shared_bits = FreeImage_GetConstBits(snapshot);
+	FreeImage_Unload(src);
+	assert(FreeImage_GetConstScanLine(snapshot, 3)[5] == 42);
+	// the last user writes in place
+	assert(FreeImage_GetBits(snapshot) == shared_bits);
+
+	FreeImage_Unload(snapshot);
+	FreeImage_Unload(clone);
+
+	// user provided buffers are always copied
+	uint8_t buffer[16 * 8] = {};
+	FIBITMAP* wrapper = FreeImage_ConvertFromRawBitsEx(FALSE, buffer, FIT_BITMAP, 16, 8, 16, 8, 0, 0, 0, FALSE);
+	assert(wrapper != nullptr);
+	FIBITMAP* copy = FreeImage_Clone(wrapper);
+	assert(copy != nullptr);
+	assert(FreeImage_GetConstBits(copy) != buffer);
+	FreeImage_Unload(copy);
+	FreeImage_Unload(wrapper);
+}
@@ -0,0 +1,319 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+#include "FreeImage.hpp"
+#include <atomic>
+#include <string>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+struct AsyncResult {
+	std::atomic<int> calls{ 0 };
+	FIBITMAP *dib = nullptr;
+	FIBOOL success = FALSE;
+};
+
+static void DLL_CALLCONV
+onLoaded(FIBITMAP *dib, void *user_data) {
+	auto *result = (AsyncResult*)user_data;
+	result->dib = dib;
+	result->calls++;
+}
+
+static void DLL_CALLCONV
+onSaved(FIBOOL success, void *user_data) {
+	auto *result = (AsyncResult*)user_data;
+	result->success = success;
+	result->calls++;
+}
+
+struct BatchResult {
+	std::vector<unsigned> indices;
+	std::vector<FREE_IMAGE_FORMAT> formats;
+	std::vector<FIBITMAP*> bitmaps;
+};
+
+static void DLL_CALLCONV
+onBatchLoaded(unsigned index, FREE_IMAGE_FORMAT fif, FIBITMAP *dib, void *user_data) {
+	auto *result = (BatchResult*)user_data;
+	result->indices.push_back(index);
+	result->formats.push_back(fif);
+	result->bitmaps.push_back(dib);
+}
+
+static bool
+hasSamePixels(FIBITMAP *lhs, FIBITMAP *rhs) {
+	if (FreeImage_GetWidth(lhs) != FreeImage_GetWidth(rhs) || FreeImage_GetHeight(lhs) != FreeImage_GetHeight(rhs) || FreeImage_GetLine(lhs) != FreeImage_GetLine(rhs)) {
+		return false;
+	}
+	for (unsigned y = 0; y < FreeImage_GetHeight(lhs); y++) {
+		if (memcmp(FreeImage_GetScanLine(lhs, y), FreeImage_GetScanLine(rhs, y), FreeImage_GetLine(lhs)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void testAsyncIO(const char *lpszPathName) {
+	printf("testAsyncIO ...\n");
+
+	const FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	for (const uint32_t threads : { 4u, 1u }) {
+		FreeImage_SetThreadCount(threads);
+
+		// load
+		AsyncResult loaded;
+		FIASYNCJOB *job = FreeImage_LoadAsync(fif, lpszPathName, 0, onLoaded, &loaded);
+		assert(job != NULL);
+		FIBOOL bResult = FreeImage_WaitAsync(job);
+		assert(bResult && FreeImage_IsAsyncCompleted(job));
+		assert(loaded.calls == 1 && loaded.dib != NULL);
+		assert(hasSamePixels(dib, loaded.dib));
+		FreeImage_CloseAsync(job);
+
+		// save, the source bitmap can be released right away
+		AsyncResult saved;
+		FIBITMAP *copy = FreeImage_Clone(loaded.dib);
+		FreeImage_Unload(loaded.dib);
+		job = FreeImage_SaveAsync(fif, copy, "async.png", 0, onSaved, &saved);
+		FreeImage_Unload(copy);
+		assert(job != NULL);
+		bResult = FreeImage_WaitAsync(job);
+		assert(bResult && saved.calls == 1 && saved.success);
+		FreeImage_CloseAsync(job);
+
+		FIBITMAP *check = FreeImage_Load(fif, "async.png", 0);
+		assert(check != NULL && hasSamePixels(dib, check));
+		FreeImage_Unload(check);
+
+		// missing files complete with a NULL bitmap
+		AsyncResult missing;
+		job = FreeImage_LoadAsync(fif, "missing-file.png", 0, onLoaded, &missing);
+		bResult = FreeImage_WaitAsync(job);
+		assert(!bResult && missing.calls == 1 && missing.dib == NULL);
+		FreeImage_CloseAsync(job);
+	}
+
+	// cancelled jobs still call the callback once
+	FreeImage_SetThreadCount(4);
+	AsyncResult results[8];
+	FIASYNCJOB *jobs[8];
+	for (int i = 0; i < 8; i++) {
+		jobs[i] = FreeImage_LoadAsync(fif, lpszPathName, 0, onLoaded, &results[i]);
+		assert(jobs[i] != NULL);
+		FreeImage_CancelAsync(jobs[i]);
+	}
+	for (int i = 0; i < 8; i++) {
+		const FIBOOL bResult = FreeImage_WaitAsync(jobs[i]);
+		assert(results[i].calls == 1 && (bResult != FALSE) == (results[i].dib != NULL));
+		if (results[i].dib) {
+			FreeImage_Unload(results[i].dib);
+		}
+		FreeImage_CloseAsync(jobs[i]);
+	}
+
+	// futures of the C++ wrapper
+	{
+		fi::AsyncJob handle;
+		std::future<fi::Bitmap> pending = fi::Bitmap::LoadAsync(static_cast<fi::ImageFormat>(fif), lpszPathName, 0, &handle);
+		fi::Bitmap bitmap = pending.get();
+		// the future is set by the callback, before the job completes
+		const bool bLoaded = handle.Wait();
+		assert(bLoaded && handle.IsCompleted());
+		assert(hasSamePixels(dib, static_cast<FIBITMAP*>(bitmap)));
+		std::future<bool> written = bitmap.SaveAsync(static_cast<fi::ImageFormat>(fif), "async.png");
+		assert(written.get());
+
+		bool failed = false;
+		try {
+			fi::Bitmap::LoadAsync(static_cast<fi::ImageFormat>(fif), "missing-file.png").get();
+		}
+		catch (const fi::ImageError&) {
+			failed = true;
+		}
+		assert(failed);
+	}
+
+	// pool jobs are charged to the budget of the submitting thread
+	{
+		FreeImage_SetThreadCount(4);
+		const uint64_t bytes = (uint64_t)FreeImage_GetPitch(dib) * FreeImage_GetHeight(dib);
+		assert(FreeImage_SetThreadMemoryBudget(bytes / 2));
+		AsyncResult denied;
+		FIASYNCJOB *job = FreeImage_LoadAsync(fif, lpszPathName, 0, onLoaded, &denied);
+		assert(!FreeImage_WaitAsync(job) && denied.dib == NULL);
+		FreeImage_CloseAsync(job);
+
+		assert(FreeImage_SetThreadMemoryBudget(bytes * 4));
+		AsyncResult charged;
+		job = FreeImage_LoadAsync(fif, lpszPathName, 0, onLoaded, &charged);
+		assert(FreeImage_WaitAsync(job) && charged.dib != NULL);
+		FreeImage_CloseAsync(job);
+		FIMEMORYUSAGE usage;
+		FreeImage_GetMemoryUsage(&usage);
+		assert(usage.thread_used_bytes >= bytes);
+		FreeImage_Unload(charged.dib);
+		FreeImage_GetMemoryUsage(&usage);
+		assert(usage.thread_used_bytes == 0);
+		assert(FreeImage_SetThreadMemoryBudget(0));
+	}
+
+	// batches, files are reported in order
+	const char *files[] = { lpszPathName, "missing-file.png", lpszPathName, lpszPathName, NULL, lpszPathName };
+	const unsigned count = sizeof(files) / sizeof(files[0]);
+	for (const uint32_t threads : { 4u, 1u }) {
+		FreeImage_SetThreadCount(threads);
+		BatchResult batch;
+		const unsigned loadedCount = FreeImage_LoadBatch(files, count, 0, onBatchLoaded, &batch);
+		assert(loadedCount == 4 && batch.indices.size() == count);
+		for (unsigned i = 0; i < count; i++) {
+			assert(batch.indices[i] == i);
+			const bool valid = (files[i] == lpszPathName);
+			assert((batch.bitmaps[i] != NULL) == valid);
+			assert(batch.formats[i] == (valid ? fif : FIF_UNKNOWN));
+			if (batch.bitmaps[i]) {
+				assert(hasSamePixels(dib, batch.bitmaps[i]));
+				FreeImage_Unload(batch.bitmaps[i]);
+			}
+		}
+	}
+
+	FreeImage_SetThreadCount(defaultCount);
+	FreeImage_Unload(dib);
+}
+
+void testTryLoad(const char *lpszPathName) {
+	printf("testTryLoad ...\n");
+
+	// messages are kept per thread, formatted without allocation
+	FreeImage_ClearLastMessage();
+	FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
+	assert(strcmp(FreeImage_GetLastMessage(&fif), "") == 0 && fif == FIF_UNKNOWN);
+	FreeImage_OutputMessageProc(FIF_PNG, "test %d %s", 42, "message");
+	assert(strcmp(FreeImage_GetLastMessage(&fif), "test 42 message") == 0 && fif == FIF_PNG);
+	std::string long_text(2000, 'x');
+	FreeImage_OutputMessageProc(FIF_PNG, "%s", long_text.c_str());
+	assert(strlen(FreeImage_GetLastMessage()) == 511);
+
+	// a loaded file
+	fi::Result<fi::Bitmap> loaded = fi::Bitmap::TryLoad(fi::ImageFormat::ePng, lpszPathName);
+	assert(loaded && loaded->GetWidth() > 0);
+	fi::Bitmap bitmap = std::move(loaded).Value();
+
+	// missing or corrupt files fail without throwing
+	fi::Result<fi::Bitmap> missing = fi::Bitmap::TryLoad(fi::ImageFormat::ePng, "missing-file.png");
+	assert(!missing);
+	assert(strcmp(missing.GetError().function, "FreeImage_Load") == 0);
+	assert(strstr(missing.GetError().message, "missing-file.png") != NULL);
+
+	FILE *file = fopen("corrupt.png", "wb");
+	assert(file != NULL);
+	fputs("\x89PNG but not really", file);
+	fclose(file);
+	fi::Result<fi::Bitmap> corrupt = fi::Bitmap::TryLoad(fi::ImageFormat::ePng, "corrupt.png");
+	assert(!corrupt.HasValue());
+
+	bool thrown = false;
+	try {
+		corrupt.Value();
+	}
+	catch (const fi::ImageError &) {
+		thrown = true;
+	}
+	assert(thrown);
+
+	// saves
+	assert(bitmap.TrySave(fi::ImageFormat::ePng, "tryload.png"));
+	fi::Result<void> saved = bitmap.TrySave(fi::ImageFormat::ePng, "missing-dir/tryload.png");
+	assert(!saved && strlen(saved.GetError().message) > 0);
+}
+
+/// Records the messages of a thread handler
+struct ThreadMessages {
+	unsigned count;
+	FREE_IMAGE_FORMAT fif;
+	FREE_IMAGE_MESSAGE code;
+	std::string text;
+};
+
+static void DLL_CALLCONV
+recordThreadMessage(FREE_IMAGE_FORMAT fif, FREE_IMAGE_MESSAGE code, const char *msg, void *user_data) {
+	ThreadMessages *messages = static_cast<ThreadMessages *>(user_data);
+	messages->count++;
+	messages->fif = fif;
+	messages->code = code;
+	messages->text = msg;
+}
+
+void testThreadMessages() {
+	printf("testThreadMessages ...\n");
+
+	// codes of the last message, given by the caller or derived from the "Warning" prefix
+	FreeImage_ClearLastMessage();
+	assert(FreeImage_GetLastMessageCode() == FIMSG_NONE);
+	FreeImage_OutputMessageProcEx(FIF_PNG, FIMSG_MEMORY, "Memory allocation failed");
+	assert(FreeImage_GetLastMessageCode() == FIMSG_MEMORY);
+	FreeImage_OutputMessageProc(FIF_PNG, "Memory allocation failed");
+	assert(FreeImage_GetLastMessageCode() == FIMSG_GENERIC);
+	FreeImage_OutputMessageProc(FIF_PNG, "Warning: %d components", 3);
+	assert(FreeImage_GetLastMessageCode() == FIMSG_WARNING);
+
+	// generic errors of the plugins, output directly or thrown
+	const char garbage[] = "P9 not an image";
+	FIMEMORY *hmem = FreeImage_OpenMemory((uint8_t*)garbage, (uint32_t)sizeof(garbage));
+	assert(FreeImage_LoadFromMemory(FIF_BMP, hmem, 0) == NULL);
+	assert(FreeImage_GetLastMessageCode() == FIMSG_MAGIC_NUMBER);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	assert(FreeImage_LoadFromMemory(FIF_PGM, hmem, 0) == NULL);
+	assert(FreeImage_GetLastMessageCode() == FIMSG_MAGIC_NUMBER);
+	FreeImage_CloseMemory(hmem);
+
+	// the handler of a thread replaces the process-wide ones on this thread only
+	ThreadMessages messages = { 0, FIF_UNKNOWN, FIMSG_NONE, "" };
+	FreeImage_SetThreadOutputMessage(recordThreadMessage, &messages);
+	FreeImage_OutputMessageProcEx(FIF_TIFF, FIMSG_PARSING, "Parsing error");
+	assert(messages.count == 1 && messages.fif == FIF_TIFF && messages.code == FIMSG_PARSING);
+	FreeImage_OutputMessageProc(FIF_TIFF, "tag %d: %s", 42, "invalid");
+	assert(messages.count == 2 && messages.code == FIMSG_GENERIC && messages.text == "tag 42: invalid");
+
+	std::thread other([] {
+		FreeImage_OutputMessageProcEx(FIF_JPEG, FIMSG_MAGIC_NUMBER, "Invalid magic number");
+		assert(FreeImage_GetLastMessageCode() == FIMSG_MAGIC_NUMBER);
+	});
+	other.join();
+	assert(messages.count == 2);
+	assert(strcmp(FreeImage_GetLastMessage(), "tag 42: invalid") == 0);
+
+	FreeImage_SetThreadOutputMessage(NULL);
+	FreeImage_OutputMessageProc(FIF_TIFF, "Parsing error");
+	assert(messages.count == 2);
+	FreeImage_ClearLastMessage();
+}
@@ -21,6 +21,11 @@
 
 
 #include "TestSuite.h"
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <memory>
+#include <vector>
 
 // Local test functions
 // ----------------------------------------------------------
@@ -125,3 +130,169 @@ void testImageChannels(unsigned width, unsigned height) {
 	testRGBAChannels(FIT_RGBF, width, height, FALSE);
 	testRGBAChannels(FIT_RGBAF, width, height, TRUE);
 }
+
+void testChannelsSplitMerge()
+{
+	// odd width for the scalar tails of the SIMD kernels
+	const unsigned width = 67, height = 29;
+
+	struct Layout { FREE_IMAGE_TYPE type; unsigned bpp; FREE_IMAGE_TYPE plane_type; };
+	for (const Layout &layout : { Layout{ FIT_BITMAP, 24, FIT_BITMAP }, Layout{ FIT_BITMAP, 32, FIT_BITMAP },
+			Layout{ FIT_RGB16, 48, FIT_UINT16 }, Layout{ FIT_RGBA16, 64, FIT_UINT16 },
+			Layout{ FIT_RGBF, 96, FIT_FLOAT }, Layout{ FIT_RGBAF, 128, FIT_FLOAT } }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(layout.type, width, height, layout.bpp), &::FreeImage_Unload);
+		assert(src != nullptr);
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t *line = FreeImage_GetScanLine(src.get(), y);
+			for (unsigned x = 0; x < FreeImage_GetLine(src.get()); ++x) {
+				// no NaN floats, their copies might not be bit exact
+				line[x] = static_cast<uint8_t>((x * 7 + y * 13) & 0xBF);
+			}
+		}
+		const unsigned channels = FreeImage_GetChannelsNumber(src.get());
+
+		runScalarAndSIMD([&](bool) {
+			FIBITMAP *planes[4] = {};
+			assert(FreeImage_SplitChannels(src.get(), planes));
+			const FREE_IMAGE_COLOR_CHANNEL names[4] = { FICC_RED, FICC_GREEN, FICC_BLUE, FICC_ALPHA };
+			for (unsigned c = 0; c < channels; ++c) {
+				assert(planes[c] != nullptr);
+				assert(FreeImage_GetImageType(planes[c]) == layout.plane_type);
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> channel(FreeImage_GetChannel(src.get(), names[c]), &::FreeImage_Unload);
+				assert(channel != nullptr);
+				assert(isSameBitmap(planes[c], channel.get()));
+			}
+
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> merged(FreeImage_MergeChannels(planes, channels), &::FreeImage_Unload);
+			assert(merged != nullptr);
+			assert(FreeImage_GetImageType(merged.get()) == layout.type && FreeImage_GetBPP(merged.get()) == layout.bpp);
+			assert(isSameBitmap(merged.get(), src.get()));
+
+			for (unsigned c = 0; c < channels; ++c) {
+				FreeImage_Unload(planes[c]);
+			}
+		});
+	}
+
+	// planes of different types or sizes are rejected
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey(FreeImage_AllocateT(FIT_UINT16, width, height), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> flt(FreeImage_AllocateT(FIT_FLOAT, width, height), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> small(FreeImage_AllocateT(FIT_UINT16, width, height - 1), &::FreeImage_Unload);
+	FIBITMAP *mixed[3] = { grey.get(), flt.get(), grey.get() };
+	assert(FreeImage_MergeChannels(mixed, 3) == nullptr);
+	FIBITMAP *sizes[3] = { grey.get(), grey.get(), small.get() };
+	assert(FreeImage_MergeChannels(sizes, 3) == nullptr);
+	FIBITMAP *two[2] = { grey.get(), grey.get() };
+	assert(FreeImage_MergeChannels(two, 2) == nullptr);
+}
+
+void testExportTensor()
+{
+	const unsigned width = 37, height = 23;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgb(FreeImage_Allocate(width, height, 24), &::FreeImage_Unload);
+	assert(rgb != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *line = FreeImage_GetScanLine(rgb.get(), y);
+		for (unsigned x = 0; x < FreeImage_GetLine(rgb.get()); ++x) {
+			line[x] = static_cast<uint8_t>(x * 11 + y * 29);
+		}
+	}
+
+	// CHW floats normalized with the usual mean and std, rows top-down
+	FITENSORDESC desc = {};
+	desc.layout = FITL_CHW;
+	desc.type = FITT_FLOAT;
+	desc.channels = 3;
+	const float mean[3] = { 0.485f, 0.456f, 0.406f };
+	const float std[3] = { 0.229f, 0.224f, 0.225f };
+	for (unsigned c = 0; c < 3; ++c) {
+		desc.order[c] = c;
+		desc.mean[c] = mean[c];
+		desc.scale[c] = 1.0f / std[c];
+	}
+	std::vector<float> chw(3 * width * height);
+	assert(FreeImage_ExportTensor(rgb.get(), &desc, chw.data()));
+	const unsigned offsets[3] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE };
+	for (unsigned c = 0; c < 3; ++c) {
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t *line = FreeImage_GetScanLine(rgb.get(), height - 1 - y);
+			for (unsigned x = 0; x < width; ++x) {
+				const float expected = (line[3 * x + offsets[c]] / 255.0f - mean[c]) / std[c];
+				assert(std::abs(chw[(c * height + y) * width + x] - expected) < 1e-5f);
+			}
+		}
+	}
+
+	// HWC bytes in BGR order are the pixels flipped
+	FITENSORDESC bgr = {};
+	bgr.layout = FITL_HWC;
+	bgr.type = FITT_UINT8;
+	bgr.channels = 3;
+	for (unsigned c = 0; c < 3; ++c) {
+		bgr.order[c] = 2 - c;
+		bgr.scale[c] = 1.0f;
+	}
+	std::vector<uint8_t> hwc(3 * width * height);
+	assert(FreeImage_ExportTensor(rgb.get(), &bgr, hwc.data()));
+	for (unsigned y = 0; y < height; ++y) {
+		const uint8_t *line = FreeImage_GetScanLine(rgb.get(), height - 1 - y);
+		for (unsigned x = 0; x < width; ++x) {
+			assert(hwc[(y * width + x) * 3 + 0] == line[3 * x + FI_RGBA_BLUE]);
+			assert(hwc[(y * width + x) * 3 + 1] == line[3 * x + FI_RGBA_GREEN]);
+			assert(hwc[(y * width + x) * 3 + 2] == line[3 * x + FI_RGBA_RED]);
+		}
+	}
+
+	// a missing alpha reads 1, 0x3C00 as a half float
+	FITENSORDESC alpha = {};
+	alpha.layout = FITL_CHW;
+	alpha.type = FITT_HALF;
+	alpha.channels = 1;
+	alpha.order[0] = 3;
+	alpha.scale[0] = 1.0f;
+	std::vector<uint16_t> ones(width * height);
+	assert(FreeImage_ExportTensor(rgb.get(), &alpha, ones.data()));
+	assert(std::all_of(ones.begin(), ones.end(), [](uint16_t h) { return h == 0x3C00; }));
+
+	// rescaling to the tensor size matches FreeImage_Rescale
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> small(FreeImage_Rescale(rgb.get(), 16, 9, FILTER_BILINEAR), &::FreeImage_Unload);
+	assert(small != nullptr);
+	FITENSORDESC resized = desc;
+	resized.width = 16;
+	resized.height = 9;
+	resized.filter = FILTER_BILINEAR;
+	std::vector<float> fromResized(3 * 16 * 9), fromSmall(3 * 16 * 9);
+	assert(FreeImage_ExportTensor(rgb.get(), &resized, fromResized.data()));
+	assert(FreeImage_ExportTensor(small.get(), &desc, fromSmall.data()));
+	assert(fromResized == fromSmall);
+
+	// kernels and bands give the scalar results
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgba16(FreeImage_ConvertToRGBA16(rgb.get()), &::FreeImage_Unload);
+	assert(rgba16 != nullptr);
+	for (const FREE_IMAGE_TENSOR_LAYOUT layout : { FITL_CHW, FITL_HWC }) {
+		for (const FREE_IMAGE_TENSOR_TYPE type : { FITT_UINT8, FITT_HALF, FITT_FLOAT }) {
+			FITENSORDESC any = desc;
+			any.layout = layout;
+			any.type = type;
+			any.channels = 4;
+			any.order[3] = 3;
+			any.mean[3] = 0.5f;
+			any.scale[3] = 2.0f;
+			std::vector<uint8_t> results[2];
+			runScalarAndSIMD([&](bool vector) {
+				results[vector].resize(4 * 4 * width * height);
+				assert(FreeImage_ExportTensor(rgba16.get(), &any, results[vector].data()));
+			});
+			assert(results[0] == results[1]);
+		}
+	}
+
+	// unsupported descriptions
+	FITENSORDESC wrong = desc;
+	wrong.channels = 5;
+	assert(!FreeImage_ExportTensor(rgb.get(), &wrong, chw.data()));
+	wrong = desc;
+	wrong.order[1] = 4;
+	assert(!FreeImage_ExportTensor(rgb.get(), &wrong, chw.data()));
+}
@@ -24,6 +24,8 @@
 #include <memory>
 #include <limits>
 #include <vector>
+#include <cstring>
+#include <initializer_list>
 
 /**
 Test FreeImage_GetHistogram
@@ -161,3 +163,274 @@ void testHistogram()
 	assert(hist[31] == 0);
 }
 
+void testColorMapping()
+{
+	// colors picked from a few values so that pixels, sources and destinations overlap
+	auto channel = [](unsigned i) { return static_cast<uint8_t>((i * 2654435761u >> 13) % 6 * 51); };
+
+	std::vector<FIRGBA8> colors(400);
+	for (unsigned i = 0; i < colors.size(); ++i) {
+		colors[i].red = channel(3 * i);
+		colors[i].green = channel(3 * i + 1);
+		colors[i].blue = channel(3 * i + 2);
+		colors[i].alpha = channel(i) ? 0xFF : 0x80;
+	}
+
+	for (const unsigned bpp : { 8u, 24u, 32u }) {
+		for (const unsigned count : { 1u, 5u, 200u }) {
+			for (int options = 0; options < 4; ++options) {
+				const FIBOOL ignore_alpha = (options & 1) ? TRUE : FALSE;
+				const FIBOOL swap = (options & 2) ? TRUE : FALSE;
+				FIRGBA8 *srccolors = &colors[0];
+				FIRGBA8 *dstcolors = &colors[200];
+
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_Allocate(257, 131, bpp), &::FreeImage_Unload);
+				assert(src != nullptr);
+				if (bpp == 8) {
+					FIRGBA8 *pal = FreeImage_GetPalette(src.get());
+					for (unsigned i = 0; i < 256; ++i) {
+						pal[i] = colors[(i * 7) % colors.size()];
+					}
+				} else {
+					for (unsigned y = 0; y < 131; ++y) {
+						uint8_t *bits = FreeImage_GetScanLine(src.get(), y);
+						for (unsigned x = 0; x < 257; ++x, bits += bpp / 8) {
+							const FIRGBA8 &c = colors[(x * 31 + y * 17) % colors.size()];
+							bits[FI_RGBA_RED] = c.red;
+							bits[FI_RGBA_GREEN] = c.green;
+							bits[FI_RGBA_BLUE] = c.blue;
+							if (bpp == 32) {
+								bits[FI_RGBA_ALPHA] = c.alpha;
+							}
+						}
+					}
+				}
+
+				// reference: first matching entry, sources before destinations of the same entry
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> ref(FreeImage_Clone(src.get()), &::FreeImage_Unload);
+				const bool alpha = (bpp == 32) && !ignore_alpha;
+				unsigned expected = 0;
+				auto mapColor = [&](uint8_t *r, uint8_t *g, uint8_t *b, uint8_t *a) {
+					for (unsigned j = 0; j < count; ++j) {
+						for (int i = (swap ? 0 : 1); i < 2; ++i) {
+							const FIRGBA8 &from = i ? srccolors[j] : dstcolors[j];
+							const FIRGBA8 &to = i ? dstcolors[j] : srccolors[j];
+							if (*r == from.red && *g == from.green && *b == from.blue && (!alpha || *a == from.alpha)) {
+								*r = to.red;
+								*g = to.green;
+								*b = to.blue;
+								if (alpha) {
+									*a = to.alpha;
+								}
+								++expected;
+								return;
+							}
+						}
+					}
+				};
+				if (bpp == 8) {
+					FIRGBA8 *pal = FreeImage_GetPalette(ref.get());
+					for (unsigned i = 0; i < 256; ++i) {
+						mapColor(&pal[i].red, &pal[i].green, &pal[i].blue, &pal[i].alpha);
+					}
+				} else {
+					for (unsigned y = 0; y < 131; ++y) {
+						uint8_t *bits = FreeImage_GetScanLine(ref.get(), y);
+						for (unsigned x = 0; x < 257; ++x, bits += bpp / 8) {
+							mapColor(&bits[FI_RGBA_RED], &bits[FI_RGBA_GREEN], &bits[FI_RGBA_BLUE], &bits[FI_RGBA_ALPHA]);
+						}
+					}
+				}
+				assert(expected > 0);
+
+				runScalarAndSIMD([&](bool) {
+					std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_Clone(src.get()), &::FreeImage_Unload);
+					assert(FreeImage_ApplyColorMapping(dib.get(), srccolors, dstcolors, count, ignore_alpha, swap) == expected);
+					assert(isSameBitmap(dib.get(), ref.get()));
+					if (bpp == 8) {
+						assert(memcmp(FreeImage_GetPalette(dib.get()), FreeImage_GetPalette(ref.get()), 256 * sizeof(FIRGBA8)) == 0);
+					}
+				});
+			}
+		}
+	}
+
+	// 16-bit colors are compared in their 565 representation
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_Allocate(64, 64, 16, FI16_565_RED_MASK, FI16_565_GREEN_MASK, FI16_565_BLUE_MASK), &::FreeImage_Unload);
+	assert(dib != nullptr);
+	FIRGBA8 white = { 0xFF, 0xFF, 0xFF, 0xFF };
+	FIRGBA8 black = { 0, 0, 0, 0 };
+	uint16_t *first = reinterpret_cast<uint16_t *>(FreeImage_GetScanLine(dib.get(), 0));
+	first[0] = 0xFFFF;
+	assert(FreeImage_SwapColors(dib.get(), &white, &black, FALSE) == 64 * 64);
+	assert(first[0] == 0 && first[1] == 0xFFFF);
+}
+
+void testLUTKernels()
+{
+	uint8_t luts[4][256];
+	for (unsigned c = 0; c < 4; ++c) {
+		for (unsigned v = 0; v < 256; ++v) {
+			luts[c][v] = static_cast<uint8_t>(v * (2 * c + 3) + 17 * c);
+		}
+	}
+
+	// odd widths leave pixels after the last vector
+	for (const unsigned bpp : { 8u, 24u, 32u }) {
+		for (const unsigned width : { 5u, 333u }) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_Allocate(width, 67, bpp), &::FreeImage_Unload);
+			assert(src != nullptr);
+			if (bpp == 8) {
+				FIRGBA8 *pal = FreeImage_GetPalette(src.get());
+				for (unsigned i = 0; i < 256; ++i) {
+					pal[i].red = pal[i].green = pal[i].blue = static_cast<uint8_t>(i);
+				}
+			}
+			for (unsigned y = 0; y < 67; ++y) {
+				uint8_t *line = FreeImage_GetScanLine(src.get(), y);
+				for (unsigned x = 0; x < FreeImage_GetLine(src.get()); ++x) {
+					line[x] = static_cast<uint8_t>(x * 29 + y * 11);
+				}
+			}
+
+			const unsigned channels = bpp / 8;
+			for (int alpha = 0; alpha < 2; ++alpha) {
+				const uint8_t *tables[4];
+				tables[FI_RGBA_RED] = luts[0];
+				tables[FI_RGBA_GREEN] = (bpp == 8) ? nullptr : luts[1];
+				tables[FI_RGBA_BLUE] = (bpp == 8) ? nullptr : luts[2];
+				tables[FI_RGBA_ALPHA] = alpha ? luts[3] : nullptr;
+
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> ref(FreeImage_Clone(src.get()), &::FreeImage_Unload);
+				for (unsigned y = 0; y < 67; ++y) {
+					uint8_t *line = FreeImage_GetScanLine(ref.get(), y);
+					for (unsigned x = 0; x < width * channels; ++x) {
+						const uint8_t *lut = (bpp == 8) ? luts[0] : tables[x % channels];
+						if (lut) {
+							line[x] = lut[line[x]];
+						}
+					}
+				}
+
+				runScalarAndSIMD([&](bool) {
+					std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_Clone(src.get()), &::FreeImage_Unload);
+					assert(FreeImage_ApplyLUTs(dib.get(), luts[0], luts[1], luts[2], alpha ? luts[3] : nullptr));
+					assert(isSameBitmap(dib.get(), ref.get()));
+				});
+			}
+		}
+	}
+
+	// 16-bit tables, alpha is kept without its table
+	std::vector<uint16_t> lut16(65536);
+	for (unsigned v = 0; v < 65536; ++v) {
+		lut16[v] = static_cast<uint16_t>(65535 - v / 3);
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgba16(FreeImage_AllocateT(FIT_RGBA16, 31, 7), &::FreeImage_Unload);
+	assert(rgba16 != nullptr);
+	FIRGBA16 *pixel = reinterpret_cast<FIRGBA16 *>(FreeImage_GetScanLine(rgba16.get(), 3));
+	pixel[5].red = 3000;
+	pixel[5].green = 6;
+	pixel[5].blue = 65535;
+	pixel[5].alpha = 1234;
+	assert(FreeImage_ApplyLUTs(rgba16.get(), lut16.data(), nullptr, lut16.data()));
+	assert(pixel[5].red == 64535 && pixel[5].green == 6 && pixel[5].blue == 43690 && pixel[5].alpha == 1234);
+
+	// palettes are transformed instead of the indices
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> pal4(FreeImage_Allocate(9, 9, 4), &::FreeImage_Unload);
+	assert(pal4 != nullptr);
+	FreeImage_GetPalette(pal4.get())[2].green = 10;
+	assert(FreeImage_ApplyLUTs(pal4.get(), nullptr, luts[1], nullptr));
+	assert(FreeImage_GetPalette(pal4.get())[2].green == luts[1][10] && FreeImage_GetPalette(pal4.get())[2].red == 0);
+
+	// the adjust functions are applied through the tables
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_Allocate(40, 3, 32), &::FreeImage_Unload);
+	assert(dib != nullptr);
+	uint8_t *bits = FreeImage_GetScanLine(dib.get(), 1);
+	bits[FI_RGBA_RED] = 10;
+	bits[FI_RGBA_GREEN] = 20;
+	bits[FI_RGBA_BLUE] = 30;
+	bits[FI_RGBA_ALPHA] = 40;
+	assert(FreeImage_AdjustCurve(dib.get(), luts[2], FICC_GREEN));
+	assert(bits[FI_RGBA_RED] == 10 && bits[FI_RGBA_GREEN] == luts[2][20] && bits[FI_RGBA_BLUE] == 30 && bits[FI_RGBA_ALPHA] == 40);
+	assert(FreeImage_Invert(dib.get()));
+	assert(bits[FI_RGBA_RED] == 245 && bits[FI_RGBA_GREEN] == 255 - luts[2][20] && bits[FI_RGBA_BLUE] == 225 && bits[FI_RGBA_ALPHA] == 215);
+}
+
+void testHistogramParallel()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	const unsigned width = 1001, height = 523;
+
+	// runs of equal pixels hit the same bins back to back
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_Allocate(width, height, 32), &::FreeImage_Unload);
+	assert(dib != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *line = FreeImage_GetScanLine(dib.get(), y);
+		for (unsigned x = 0; x < FreeImage_GetLine(dib.get()); ++x) {
+			line[x] = static_cast<uint8_t>(((x / 37) * 97 + y * 5) ^ (x & 3));
+		}
+	}
+
+	uint32_t expected[3][256] = {};
+	for (unsigned y = 0; y < height; ++y) {
+		const uint8_t *pixel = FreeImage_GetScanLine(dib.get(), y);
+		for (unsigned x = 0; x < width; ++x, pixel += 4) {
+			++expected[0][pixel[FI_RGBA_RED]];
+			++expected[1][pixel[FI_RGBA_GREEN]];
+			++expected[2][pixel[FI_RGBA_BLUE]];
+		}
+	}
+	for (const uint32_t threads : { 1u, 4u }) {
+		FreeImage_SetThreadCount(threads);
+		uint32_t histo[3][256];
+		assert(FreeImage_MakeHistogram(dib.get(), 256, nullptr, nullptr, histo[0], 1, histo[1], 1, histo[2], 1));
+		assert(memcmp(histo, expected, sizeof(histo)) == 0);
+	}
+
+	// MakeHistogram with few bins (sub-histograms per band) and many bins
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgba16(FreeImage_ConvertToRGBA16(dib.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey16(FreeImage_ConvertToUINT16(dib.get()), &::FreeImage_Unload);
+	assert(rgba16 != nullptr && grey16 != nullptr);
+	for (const uint32_t bins : { 100u, 65536u }) {
+		std::vector<uint32_t> serial(4 * bins), parallel(4 * bins);
+		FreeImage_SetThreadCount(1);
+		assert(FreeImage_MakeHistogram(rgba16.get(), bins, nullptr, nullptr, &serial[0], 4, &serial[1], 4, &serial[2], 4, &serial[3], 4));
+		FreeImage_SetThreadCount(4);
+		assert(FreeImage_MakeHistogram(rgba16.get(), bins, nullptr, nullptr, &parallel[0], 4, &parallel[1], 4, &parallel[2], 4, &parallel[3], 4));
+		assert(serial == parallel);
+		uint64_t total = 0;
+		for (uint32_t i = 0; i < bins; ++i) {
+			total += parallel[4 * i];
+		}
+		assert(total == width * height);
+
+		std::vector<uint32_t> grey(bins);
+		assert(FreeImage_MakeHistogram(grey16.get(), bins, nullptr, nullptr, grey.data()));
+		FreeImage_SetThreadCount(1);
+		std::vector<uint32_t> greySerial(bins);
+		assert(FreeImage_MakeHistogram(grey16.get(), bins, nullptr, nullptr, greySerial.data()));
+		assert(grey == greySerial);
+	}
+
+	// half floats are binned like floats, 16-bit bitmaps like their 24-bit colors
+	FreeImage_SetThreadCount(4);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbaf(FreeImage_ConvertToRGBAF(dib.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbah(FreeImage_ConvertToType(rgbaf.get(), FIT_RGBAH), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> back(FreeImage_ConvertToRGBAF(rgbah.get()), &::FreeImage_Unload);
+	assert(rgbah != nullptr && back != nullptr);
+	std::vector<uint32_t> half(64), full(64);
+	float minHalf = 0, maxHalf = 0, minFull = 0, maxFull = 0;
+	assert(FreeImage_MakeHistogram(rgbah.get(), 64, &minHalf, &maxHalf, nullptr, 1, half.data()));
+	assert(FreeImage_MakeHistogram(back.get(), 64, &minFull, &maxFull, nullptr, 1, full.data()));
+	assert(half == full && minHalf == minFull && maxHalf == maxFull);
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgb565(FreeImage_ConvertTo16Bits565(dib.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgb24(FreeImage_ConvertTo24Bits(rgb565.get()), &::FreeImage_Unload);
+	std::vector<uint32_t> hist565(256), hist24(256);
+	assert(FreeImage_MakeHistogram(rgb565.get(), 256, nullptr, nullptr, nullptr, 1, nullptr, 1, nullptr, 1, hist565.data()));
+	assert(FreeImage_MakeHistogram(rgb24.get(), 256, nullptr, nullptr, nullptr, 1, nullptr, 1, nullptr, 1, hist24.data()));
+	assert(hist565 == hist24);
+
+	FreeImage_SetThreadCount(defaultCount);
+}
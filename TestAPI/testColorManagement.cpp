@@ -0,0 +1,237 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// Matrix/TRC RGB profile with the IEC 61966-2-1 curve shared by the 3 channels, columns are rXYZ, gXYZ and bXYZ (D50)
+static std::vector<uint8_t> makeMatrixProfile(const double (&columns)[3][3])
+{
+	std::vector<uint8_t> profile(296, 0);
+	auto put32 = [&](size_t offset, uint32_t value) {
+		for (int i = 0; i < 4; ++i) {
+			profile[offset + i] = static_cast<uint8_t>(value >> (24 - 8 * i));
+		}
+	};
+	auto fixed = [](double value) {
+		return static_cast<uint32_t>(static_cast<int32_t>(std::lround(value * 65536.0)));
+	};
+	auto sig = [](const char *s) {
+		return (uint32_t(uint8_t(s[0])) << 24) | (uint32_t(uint8_t(s[1])) << 16) | (uint32_t(uint8_t(s[2])) << 8) | uint32_t(uint8_t(s[3]));
+	};
+	put32(0, 296);
+	put32(12, sig("mntr"));
+	put32(16, sig("RGB "));
+	put32(20, sig("XYZ "));
+	put32(36, sig("acsp"));
+	put32(128, 6);
+	const char *columnTags[3] = { "rXYZ", "gXYZ", "bXYZ" };
+	for (unsigned c = 0; c < 3; ++c) {
+		const size_t data = 204 + 20 * c;
+		put32(132 + 12 * c, sig(columnTags[c]));
+		put32(136 + 12 * c, static_cast<uint32_t>(data));
+		put32(140 + 12 * c, 20);
+		put32(data, sig("XYZ "));
+		for (unsigned row = 0; row < 3; ++row) {
+			put32(data + 8 + 4 * row, fixed(columns[row][c]));
+		}
+	}
+	const char *curveTags[3] = { "rTRC", "gTRC", "bTRC" };
+	for (unsigned c = 0; c < 3; ++c) {
+		put32(168 + 12 * c, sig(curveTags[c]));
+		put32(172 + 12 * c, 264);
+		put32(176 + 12 * c, 32);
+	}
+	put32(264, sig("para"));
+	profile[273] = 3;
+	const double params[5] = { 2.4, 1 / 1.055, 0.055 / 1.055, 1 / 12.92, 0.04045 };
+	for (unsigned i = 0; i < 5; ++i) {
+		put32(276 + 4 * i, fixed(params[i]));
+	}
+	return profile;
+}
+
+static double srgbToLinear(double v)
+{
+	return (v <= 0.04045) ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+}
+
+static double linearToSrgb(double v)
+{
+	v = std::min(1.0, std::max(0.0, v));
+	return (v <= 0.0031308) ? v * 12.92 : 1.055 * std::pow(v, 1 / 2.4) - 0.055;
+}
+
+void testICCTransform()
+{
+	const double srgbColumns[3][3] = {
+		{ 0.4360747, 0.3850649, 0.1430804 },
+		{ 0.2225045, 0.7168786, 0.0606169 },
+		{ 0.0139322, 0.0971045, 0.7141733 }
+	};
+	const double p3Columns[3][3] = {
+		{ 0.5151215, 0.2919769, 0.1571045 },
+		{ 0.2411957, 0.6922455, 0.0665741 },
+		{ -0.0010500, 0.0418854, 0.7840729 }
+	};
+	std::vector<uint8_t> srgbProfile = makeMatrixProfile(srgbColumns);
+	std::vector<uint8_t> p3Profile = makeMatrixProfile(p3Columns);
+
+	const unsigned width = 257, height = 19;
+	auto fill = [&](FIBITMAP *dib) {
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t *bits = FreeImage_GetScanLine(dib, y);
+			for (unsigned x = 0; x < width; ++x, bits += 4) {
+				bits[FI_RGBA_RED] = static_cast<uint8_t>(x);
+				bits[FI_RGBA_GREEN] = static_cast<uint8_t>(x * 7 + y * 13);
+				bits[FI_RGBA_BLUE] = static_cast<uint8_t>(y * 11 + x / 3);
+				bits[FI_RGBA_ALPHA] = static_cast<uint8_t>(x ^ y);
+			}
+		}
+	};
+	auto maxDifference = [&](FIBITMAP *a, FIBITMAP *b) {
+		int worst = 0;
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t *p = FreeImage_GetScanLine(a, y), *q = FreeImage_GetScanLine(b, y);
+			for (unsigned i = 0; i < FreeImage_GetLine(a); ++i) {
+				worst = std::max(worst, std::abs(p[i] - q[i]));
+			}
+		}
+		return worst;
+	};
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> reference(FreeImage_Allocate(width, height, 32), &::FreeImage_Unload);
+	fill(reference.get());
+
+	// untagged images are sRGB
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_Clone(reference.get()), &::FreeImage_Unload);
+	assert(FreeImage_ConvertToSRGB(dib.get()));
+	assert(maxDifference(dib.get(), reference.get()) == 0);
+
+	// an sRGB profile is almost the identity, the profile is removed
+	FreeImage_CreateICCProfile(dib.get(), srgbProfile.data(), static_cast<long>(srgbProfile.size()));
+	assert(FreeImage_ConvertToSRGB(dib.get()));
+	assert(maxDifference(dib.get(), reference.get()) <= 1);
+	assert(FreeImage_GetICCProfile(dib.get())->size == 0);
+
+	// Display P3 to sRGB: greys are kept, saturated colours are clipped, others match the D65 matrix
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = {
+		{ FreeImage_Clone(reference.get()), &::FreeImage_Unload }, { FreeImage_Clone(reference.get()), &::FreeImage_Unload }
+	};
+	runScalarAndSIMD([&](bool vector) {
+		FreeImage_CreateICCProfile(results[vector].get(), p3Profile.data(), static_cast<long>(p3Profile.size()));
+		assert(FreeImage_ConvertToSRGB(results[vector].get()));
+	});
+	assert(maxDifference(results[0].get(), results[1].get()) == 0);
+
+	const double p3ToSrgb[3][3] = {
+		{ 1.2249401, -0.2249404, 0.0 },
+		{ -0.0420569, 1.0420571, 0.0 },
+		{ -0.0196376, -0.0786361, 1.0982735 }
+	};
+	for (unsigned y = 0; y < height; ++y) {
+		const uint8_t *src = FreeImage_GetScanLine(reference.get(), y);
+		const uint8_t *dst = FreeImage_GetScanLine(results[1].get(), y);
+		for (unsigned x = 0; x < width; ++x, src += 4, dst += 4) {
+			const double linear[3] = { srgbToLinear(src[FI_RGBA_RED] / 255.0), srgbToLinear(src[FI_RGBA_GREEN] / 255.0), srgbToLinear(src[FI_RGBA_BLUE] / 255.0) };
+			const unsigned channels[3] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE };
+			for (unsigned c = 0; c < 3; ++c) {
+				const double expected = 255 * linearToSrgb(p3ToSrgb[c][0] * linear[0] + p3ToSrgb[c][1] * linear[1] + p3ToSrgb[c][2] * linear[2]);
+				assert(std::abs(dst[channels[c]] - expected) <= 2.0);
+			}
+			assert(dst[FI_RGBA_ALPHA] == src[FI_RGBA_ALPHA]);
+		}
+	}
+
+	// 16-bit and float images agree with 8-bit images
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> words(FreeImage_AllocateT(FIT_RGBA16, width, height), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> floats(FreeImage_AllocateT(FIT_RGBAF, width, height), &::FreeImage_Unload);
+	assert(words && floats);
+	for (unsigned y = 0; y < height; ++y) {
+		const uint8_t *b = FreeImage_GetScanLine(reference.get(), y);
+		auto *w = reinterpret_cast<FIRGBA16*>(FreeImage_GetScanLine(words.get(), y));
+		auto *f = reinterpret_cast<FIRGBAF*>(FreeImage_GetScanLine(floats.get(), y));
+		for (unsigned x = 0; x < width; ++x, b += 4) {
+			w[x].red = b[FI_RGBA_RED] * 257;
+			w[x].green = b[FI_RGBA_GREEN] * 257;
+			w[x].blue = b[FI_RGBA_BLUE] * 257;
+			w[x].alpha = b[FI_RGBA_ALPHA] * 257;
+			f[x].red = b[FI_RGBA_RED] / 255.0F;
+			f[x].green = b[FI_RGBA_GREEN] / 255.0F;
+			f[x].blue = b[FI_RGBA_BLUE] / 255.0F;
+			f[x].alpha = b[FI_RGBA_ALPHA] / 255.0F;
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> wordsReference(FreeImage_Clone(words.get()), &::FreeImage_Unload);
+	FreeImage_CreateICCProfile(words.get(), p3Profile.data(), static_cast<long>(p3Profile.size()));
+	FreeImage_CreateICCProfile(floats.get(), p3Profile.data(), static_cast<long>(p3Profile.size()));
+	assert(FreeImage_ConvertToSRGB(words.get()) && FreeImage_ConvertToSRGB(floats.get()));
+	for (unsigned y = 0; y < height; ++y) {
+		const uint8_t *b = FreeImage_GetScanLine(results[1].get(), y);
+		const auto *w = reinterpret_cast<const FIRGBA16*>(FreeImage_GetScanLine(words.get(), y));
+		const auto *f = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(floats.get(), y));
+		for (unsigned x = 0; x < width; ++x, b += 4) {
+			assert(std::abs(w[x].green / 257.0 - b[FI_RGBA_GREEN]) <= 1.0);
+			assert(std::abs(f[x].blue * 255.0 - b[FI_RGBA_BLUE]) <= 1.0);
+			assert(w[x].alpha == b[FI_RGBA_ALPHA] * 257 && f[x].alpha == b[FI_RGBA_ALPHA] / 255.0F);
+		}
+	}
+
+	// sRGB to Display P3 and back, the destination profile is embedded
+	FIICCPROFILE p3 = { 0, static_cast<uint32_t>(p3Profile.size()), p3Profile.data() };
+	words.reset(FreeImage_Clone(wordsReference.get()));
+	assert(FreeImage_ApplyICCTransform(words.get(), &p3));
+	assert(FreeImage_GetICCProfile(words.get())->size == p3Profile.size());
+	assert(FreeImage_ConvertToSRGB(words.get()));
+	for (unsigned y = 0; y < height; ++y) {
+		const auto *w = reinterpret_cast<const FIRGBA16*>(FreeImage_GetScanLine(words.get(), y));
+		const auto *r = reinterpret_cast<const FIRGBA16*>(FreeImage_GetScanLine(wordsReference.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			assert(std::abs(w[x].red - r[x].red) <= 128 && std::abs(w[x].green - r[x].green) <= 128 && std::abs(w[x].blue - r[x].blue) <= 128);
+		}
+	}
+
+	// unsupported images and profiles leave the image unchanged
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> palettized(FreeImage_Allocate(4, 4, 8), &::FreeImage_Unload);
+	assert(FreeImage_ConvertToSRGB(palettized.get()));
+	FreeImage_CreateICCProfile(palettized.get(), p3Profile.data(), static_cast<long>(p3Profile.size()));
+	assert(!FreeImage_ConvertToSRGB(palettized.get()));
+	std::vector<uint8_t> garbage(p3Profile.begin(), p3Profile.begin() + 200);
+	dib.reset(FreeImage_Clone(reference.get()));
+	FreeImage_CreateICCProfile(dib.get(), garbage.data(), static_cast<long>(garbage.size()));
+	assert(!FreeImage_ConvertToSRGB(dib.get()));
+	assert(maxDifference(dib.get(), reference.get()) == 0);
+	assert(FreeImage_GetICCProfile(dib.get())->size == garbage.size());
+	// a valid RGB header without the matrix/TRC tags stands for a LUT based profile
+	std::vector<uint8_t> lutProfile(p3Profile.begin(), p3Profile.begin() + 132);
+	lutProfile[0] = lutProfile[1] = lutProfile[2] = 0;
+	lutProfile[3] = 132;
+	lutProfile[128] = lutProfile[129] = lutProfile[130] = lutProfile[131] = 0;
+	dib.reset(FreeImage_Clone(reference.get()));
+	FreeImage_CreateICCProfile(dib.get(), lutProfile.data(), static_cast<long>(lutProfile.size()));
+	assert(!FreeImage_ConvertToSRGB(dib.get()));
+	assert(maxDifference(dib.get(), reference.get()) == 0);
+}
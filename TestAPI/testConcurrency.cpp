@@ -0,0 +1,152 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <memory>
+
+// Local test functions
+// ----------------------------------------------------------
+
+/**
+Load the same BMP stream from several threads while the registry is being read and modified
+*/
+void testConcurrency() {
+	const unsigned width = 97;
+	const unsigned height = 33;
+
+	printf("testConcurrency ...\n");
+
+	assert(FreeImage_GetFIFConcurrency(FIF_BMP) == (FIF_CONCURRENT_LOAD | FIF_CONCURRENT_SAVE));
+	assert(FreeImage_GetFIFConcurrency(FIF_RAS) == FIF_CONCURRENT_LOAD);
+	assert(FreeImage_GetFIFConcurrency(FIF_UNKNOWN) == FIF_CONCURRENT_NONE);
+
+	// encode a reference image
+	FIBITMAP *src = FreeImage_Allocate(width, height, 24);
+	assert(src != NULL);
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(src, y);
+		for (unsigned x = 0; x < width * 3; x++) {
+			bits[x] = (uint8_t)(x * 7 + y * 13);
+		}
+	}
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_BMP, src, hmem, 0);
+	assert(bResult);
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	FreeImage_AcquireMemory(hmem, &data, &size);
+
+	const unsigned nThreads = 4;
+	std::atomic<unsigned> failures{ 0 };
+	std::atomic<bool> done{ false };
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < nThreads; t++) {
+		workers.emplace_back([&]() {
+			for (int i = 0; i < 50; i++) {
+				if (FreeImage_GetFIFFromFilename("image.bmp") != FIF_BMP) {
+					failures++;
+				}
+				FIMEMORY *stream = FreeImage_OpenMemory(data, size);
+				FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_BMP, stream, 0);
+				if (!dib || (FreeImage_GetWidth(dib) != width) || (FreeImage_GetHeight(dib) != height)) {
+					failures++;
+				}
+				else if (memcmp(FreeImage_GetScanLine(dib, height - 1), FreeImage_GetScanLine(src, height - 1), width * 3) != 0) {
+					failures++;
+				}
+				FreeImage_Unload(dib);
+				FreeImage_CloseMemory(stream);
+			}
+		});
+	}
+
+	// toggling an unrelated plugin must not disturb the readers
+	std::thread toggler([&]() {
+		const int enabled = FreeImage_IsPluginEnabled(FIF_PCX);
+		while (!done) {
+			FreeImage_SetPluginEnabled(FIF_PCX, FALSE);
+			FreeImage_SetPluginEnabled(FIF_PCX, TRUE);
+		}
+		FreeImage_SetPluginEnabled(FIF_PCX, enabled);
+	});
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	done = true;
+	toggler.join();
+
+	assert(failures == 0);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(src);
+}
+
+void testThreadCount()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	assert(defaultCount >= 1);
+
+	FreeImage_SetThreadCount(1);
+	assert(FreeImage_GetThreadCount() == 1);
+
+	FreeImage_SetThreadCount(4);
+	assert(FreeImage_GetThreadCount() == 4);
+
+	FreeImage_SetThreadCount(0);
+	assert(FreeImage_GetThreadCount() == defaultCount);
+}
+
+void testCPUFeatures()
+{
+	const uint32_t detected = FreeImage_GetCPUFeatures();
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> plate(createZonePlateImage(640, 480, 64), &::FreeImage_Unload);
+	assert(plate != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo32Bits(plate.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> vectorRescale(FreeImage_Rescale(color.get(), 333, 211, FILTER_CATMULLROM), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> vectorConvert(FreeImage_ConvertTo24Bits(color.get()), &::FreeImage_Unload);
+	assert(color && vectorRescale && vectorConvert);
+
+	// scalar code only
+	FreeImage_SetCPUFeatures(FI_CPU_NONE);
+	assert(FreeImage_GetCPUFeatures() == FI_CPU_NONE);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scalarColor(FreeImage_ConvertTo32Bits(plate.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scalarRescale(FreeImage_Rescale(color.get(), 333, 211, FILTER_CATMULLROM), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scalarConvert(FreeImage_ConvertTo24Bits(color.get()), &::FreeImage_Unload);
+	assert(scalarColor && scalarRescale && scalarConvert);
+	assert(isSameBitmap(color.get(), scalarColor.get()));
+	assert(isSameBitmap(vectorRescale.get(), scalarRescale.get()));
+	assert(isSameBitmap(vectorConvert.get(), scalarConvert.get()));
+
+	// the mask can't enable features missing on the CPU
+	FreeImage_SetCPUFeatures(FI_CPU_ALL);
+	assert(FreeImage_GetCPUFeatures() == detected);
+	FreeImage_SetCPUFeatures(FI_CPU_SSE2 | FI_CPU_NEON);
+	assert((FreeImage_GetCPUFeatures() & ~(FI_CPU_SSE2 | FI_CPU_NEON)) == 0);
+	FreeImage_SetCPUFeatures(FI_CPU_ALL);
+}
@@ -21,8 +21,13 @@
 
 
 #include "TestSuite.h"
+#include <cstring>
 #include <memory>
 #include <limits>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
 
 /**
 Test FreeImage_ConvertToColor
@@ -112,3 +117,362 @@ void testConvertToColor()
 	}
 }
 
+/**
+Test FreeImage_ConvertToYUVPlanes
+*/
+void testConvertToYUVPlanes()
+{
+	// odd sizes, the last chroma row and column average less pixels
+	const unsigned width = 37, height = 23;
+	const unsigned cw = (width + 1) / 2, ch = (height + 1) / 2;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp(FreeImage_Allocate(width, height, 24), &::FreeImage_Unload);
+	assert(bmp != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		const auto line = reinterpret_cast<FIRGB8*>(FreeImage_GetScanLine(bmp.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			line[x].red   = static_cast<uint8_t>(x * 7);
+			line[x].green = static_cast<uint8_t>(y * 11);
+			line[x].blue  = static_cast<uint8_t>(255 - x * y);
+		}
+	}
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> yuv(FreeImage_ConvertToColor(bmp.get(), FIC_YUV, FICPARAM_YUV_STANDARD_BT709), &::FreeImage_Unload);
+	assert(yuv != nullptr);
+
+	// I420 with padded strides
+	std::vector<uint8_t> y_plane(40 * height), u_plane(20 * ch), v_plane(21 * ch);
+	uint8_t* planes[3] = { y_plane.data(), u_plane.data(), v_plane.data() };
+	const unsigned strides[3] = { 40, 20, 21 };
+	assert(FreeImage_ConvertToYUVPlanes(bmp.get(), FIYUV_I420, planes, strides, FICPARAM_YUV_STANDARD_BT709));
+
+	// NV12
+	std::vector<uint8_t> nv_y(width * height), nv_uv(2 * cw * ch);
+	uint8_t* nv_planes[3] = { nv_y.data(), nv_uv.data(), nullptr };
+	const unsigned nv_strides[3] = { width, 2 * cw, 0 };
+	assert(FreeImage_ConvertToYUVPlanes(bmp.get(), FIYUV_NV12, nv_planes, nv_strides, FICPARAM_YUV_STANDARD_BT709));
+
+	// planes are top-down and match FreeImage_ConvertToColor
+	for (unsigned row = 0; row < height; ++row) {
+		const auto line = reinterpret_cast<const FIRGB8*>(FreeImage_GetScanLine(yuv.get(), height - 1 - row));
+		for (unsigned x = 0; x < width; ++x) {
+			assert(y_plane[row * 40 + x] == line[x].red);
+			assert(nv_y[row * width + x] == line[x].red);
+		}
+	}
+	for (unsigned cy = 0; cy < ch; ++cy) {
+		for (unsigned cx = 0; cx < cw; ++cx) {
+			unsigned u = 0, v = 0, count = 0;
+			for (unsigned row = 2 * cy; row < std::min(2 * cy + 2, height); ++row) {
+				const auto line = reinterpret_cast<const FIRGB8*>(FreeImage_GetScanLine(yuv.get(), height - 1 - row));
+				for (unsigned x = 2 * cx; x < std::min(2 * cx + 2, width); ++x) {
+					u += line[x].green;
+					v += line[x].blue;
+					++count;
+				}
+			}
+			assert(u_plane[cy * 20 + cx] == (u + count / 2) / count);
+			assert(v_plane[cy * 21 + cx] == (v + count / 2) / count);
+			assert(nv_uv[cy * 2 * cw + 2 * cx] == u_plane[cy * 20 + cx]);
+			assert(nv_uv[cy * 2 * cw + 2 * cx + 1] == v_plane[cy * 21 + cx]);
+		}
+	}
+
+	// limited range of BT.709
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> white(FreeImage_Allocate(2, 2, 32), &::FreeImage_Unload);
+	assert(white != nullptr);
+	for (unsigned y = 0; y < 2; ++y) {
+		memset(FreeImage_GetScanLine(white.get(), y), 0xFF, FreeImage_GetLine(white.get()));
+	}
+	uint8_t white_y[4], white_u, white_v;
+	uint8_t* white_planes[3] = { white_y, &white_u, &white_v };
+	const unsigned white_strides[3] = { 2, 1, 1 };
+	assert(FreeImage_ConvertToYUVPlanes(white.get(), FIYUV_I420, white_planes, white_strides, FICPARAM_YUV_STANDARD_BT709));
+	assert(white_y[0] == 235 && white_y[3] == 235);
+	assert(white_u == 128 && white_v == 128);
+
+	// strides too small, unsupported images and parameters
+	const unsigned small_strides[3] = { width - 1, 20, 21 };
+	assert(!FreeImage_ConvertToYUVPlanes(bmp.get(), FIYUV_I420, planes, small_strides));
+	assert(!FreeImage_ConvertToYUVPlanes(bmp.get(), FIYUV_I420, planes, strides, static_cast<FREE_IMAGE_CVT_COLOR_PARAM>(42)));
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey(FreeImage_Allocate(width, height, 8), &::FreeImage_Unload);
+	assert(!FreeImage_ConvertToYUVPlanes(grey.get(), FIYUV_I420, planes, strides));
+}
+
+void testConvertParallel()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> plate(createZonePlateImage(640, 480, 64), &::FreeImage_Unload);
+	assert(plate != nullptr);
+
+	using Converter = FIBITMAP* (DLL_CALLCONV *)(FIBITMAP*);
+	const Converter converters[] = { FreeImage_ConvertTo24Bits, FreeImage_ConvertTo32Bits, FreeImage_ConvertTo16Bits565,
+		FreeImage_ConvertTo16Bits555, FreeImage_ConvertTo8Bits, FreeImage_ConvertToGreyscale, FreeImage_ConvertTo4Bits };
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serial(FreeImage_Clone(plate.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> parallel(FreeImage_Clone(plate.get()), &::FreeImage_Unload);
+	for (const auto convert : converters) {
+		FreeImage_SetThreadCount(1);
+		serial.reset(convert(serial.get()));
+		FreeImage_SetThreadCount(4);
+		parallel.reset(convert(parallel.get()));
+		assert(serial && parallel);
+		assert(isSameBitmap(serial.get(), parallel.get()));
+	}
+
+	// greyscale survives the round trip, the source pixels stay shared with its clone
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> clone(FreeImage_Clone(plate.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo32Bits(clone.get()), &::FreeImage_Unload);
+	assert(FreeImage_GetConstBits(clone.get()) == FreeImage_GetConstBits(plate.get()));
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey(FreeImage_ConvertToGreyscale(color.get()), &::FreeImage_Unload);
+	assert(isSameBitmap(plate.get(), grey.get()));
+
+	FreeImage_SetThreadCount(defaultCount);
+}
+
+void testConvertLineKernels()
+{
+	// widths cover vector blocks and scalar tails
+	for (const int width : { 1, 7, 15, 16, 17, 33, 100, 257 }) {
+		std::vector<uint8_t> src(width * 4 + 64);
+		for (size_t i = 0; i < src.size(); ++i) {
+			src[i] = static_cast<uint8_t>(i * 97 + 13);
+		}
+		std::vector<uint8_t> dst(width * 4 + 64, 0x5A);
+
+		FreeImage_ConvertLine24To32(dst.data(), src.data(), width);
+		for (int x = 0; x < width; ++x) {
+			assert(dst[4 * x + 0] == src[3 * x + 0] && dst[4 * x + 1] == src[3 * x + 1] && dst[4 * x + 2] == src[3 * x + 2]);
+			assert(dst[4 * x + FI_RGBA_ALPHA] == 0xFF);
+		}
+		assert(dst[4 * width] == 0x5A);
+
+		std::fill(dst.begin(), dst.end(), 0x5A);
+		FreeImage_ConvertLine32To24(dst.data(), src.data(), width);
+		for (int x = 0; x < width; ++x) {
+			assert(dst[3 * x + 0] == src[4 * x + 0] && dst[3 * x + 1] == src[4 * x + 1] && dst[3 * x + 2] == src[4 * x + 2]);
+		}
+		assert(dst[3 * width] == 0x5A);
+
+		std::fill(dst.begin(), dst.end(), 0x5A);
+		FreeImage_ConvertLine1To8(dst.data(), src.data(), width);
+		for (int x = 0; x < width; ++x) {
+			assert(dst[x] == (((src[x >> 3] >> (7 - (x & 7))) & 1) ? 255 : 0));
+		}
+		assert(dst[width] == 0x5A);
+
+		FIRGBA8 palette[256];
+		for (unsigned i = 0; i < 256; ++i) {
+			palette[i].red = (uint8_t)i;
+			palette[i].green = (uint8_t)(i * 3);
+			palette[i].blue = (uint8_t)(255 - i);
+			palette[i].alpha = 0;
+		}
+		std::fill(dst.begin(), dst.end(), 0x5A);
+		FreeImage_ConvertLine8To32(dst.data(), src.data(), width, palette);
+		for (int x = 0; x < width; ++x) {
+			const FIRGBA8& entry = palette[src[x]];
+			assert(dst[4 * x + FI_RGBA_RED] == entry.red && dst[4 * x + FI_RGBA_GREEN] == entry.green && dst[4 * x + FI_RGBA_BLUE] == entry.blue);
+			assert(dst[4 * x + FI_RGBA_ALPHA] == 0xFF);
+		}
+		assert(dst[4 * width] == 0x5A);
+	}
+
+	// all 16-bit pixel values
+	std::vector<uint16_t> words(65536);
+	for (unsigned i = 0; i < words.size(); ++i) {
+		words[i] = (uint16_t)i;
+	}
+	std::vector<uint8_t> dst(words.size() * 4);
+	FreeImage_ConvertLine16To32_565(dst.data(), (uint8_t*)words.data(), (int)words.size());
+	for (unsigned i = 0; i < words.size(); ++i) {
+		assert(dst[4 * i + FI_RGBA_RED] == ((i >> 11) & 0x1F) * 0xFF / 0x1F);
+		assert(dst[4 * i + FI_RGBA_GREEN] == ((i >> 5) & 0x3F) * 0xFF / 0x3F);
+		assert(dst[4 * i + FI_RGBA_BLUE] == (i & 0x1F) * 0xFF / 0x1F);
+		assert(dst[4 * i + FI_RGBA_ALPHA] == 0xFF);
+	}
+	FreeImage_ConvertLine16To32_555(dst.data(), (uint8_t*)words.data(), (int)words.size());
+	for (unsigned i = 0; i < words.size(); ++i) {
+		assert(dst[4 * i + FI_RGBA_RED] == ((i >> 10) & 0x1F) * 0xFF / 0x1F);
+		assert(dst[4 * i + FI_RGBA_GREEN] == ((i >> 5) & 0x1F) * 0xFF / 0x1F);
+		assert(dst[4 * i + FI_RGBA_BLUE] == (i & 0x1F) * 0xFF / 0x1F);
+		assert(dst[4 * i + FI_RGBA_ALPHA] == 0xFF);
+	}
+}
+
+void testYuvKernels()
+{
+	// widths leave scalar tails after the vector blocks
+	const unsigned width = 333, height = 97;
+	for (const auto format : { std::make_pair(FIT_BITMAP, 24u), std::make_pair(FIT_BITMAP, 32u), std::make_pair(FIT_RGB16, 48u), std::make_pair(FIT_RGBA16, 64u) }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(format.first, width, height, format.second), &::FreeImage_Unload);
+		assert(src != nullptr);
+		const bool wide = format.first != FIT_BITMAP;
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t *bits = FreeImage_GetScanLine(src.get(), y);
+			for (unsigned x = 0; x < FreeImage_GetLine(src.get()); ++x) {
+				bits[x] = static_cast<uint8_t>(x * 37 + y * 11 + (x * y) / 7);
+			}
+		}
+		const FREE_IMAGE_COLOR_TYPE rgb = FreeImage_GetColorType2(src.get());
+
+		for (const auto standard : { FICPARAM_YUV_STANDARD_JPEG, FICPARAM_YUV_STANDARD_BT601, FICPARAM_YUV_STANDARD_BT709, FICPARAM_YUV_STANDARD_BT2020 }) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2][2] = {
+				{ { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } },
+				{ { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } }
+			};
+			runScalarAndSIMD([&](bool vector) {
+				results[vector][0].reset(FreeImage_ConvertToColor(src.get(), FIC_YUV, standard));
+				assert(results[vector][0] && (FreeImage_GetColorType2(results[vector][0].get()) == FIC_YUV));
+				results[vector][1].reset(FreeImage_ConvertToColor(results[vector][0].get(), rgb, standard));
+				assert(results[vector][1]);
+			});
+			assert(isSameBitmap(results[0][0].get(), results[1][0].get()));
+			assert(isSameBitmap(results[0][1].get(), results[1][1].get()));
+
+			// round trip stays close to the source (coefficients have 12 fractional bits), alpha is copied
+			const unsigned channels = format.second / (wide ? 16 : 8);
+			const int tolerance = wide ? 64 : 2;
+			for (unsigned y = 0; y < height; ++y) {
+				const uint8_t *a = FreeImage_GetScanLine(src.get(), y);
+				const uint8_t *b = FreeImage_GetScanLine(results[1][1].get(), y);
+				for (unsigned i = 0; i < width * channels; ++i) {
+					const int va = wide ? reinterpret_cast<const uint16_t*>(a)[i] : a[i];
+					const int vb = wide ? reinterpret_cast<const uint16_t*>(b)[i] : b[i];
+					assert(std::abs(va - vb) <= ((i % channels == 3) ? 0 : tolerance));
+				}
+			}
+		}
+	}
+}
+
+void testCMYKLabKernels()
+{
+	// widths leave scalar tails after the vector blocks
+	const unsigned width = 333, height = 17;
+	for (const auto type : { FIT_BITMAP, FIT_RGBA16, FIT_RGB16 }) {
+		const unsigned bpp = (type == FIT_BITMAP) ? 32 : 0;
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(type, width, height, bpp), &::FreeImage_Unload);
+		assert(src != nullptr);
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t *bits = FreeImage_GetScanLine(src.get(), y);
+			for (unsigned x = 0; x < FreeImage_GetLine(src.get()); ++x) {
+				bits[x] = static_cast<uint8_t>(x * 37 + y * 101 + (x >> 3));
+			}
+		}
+
+		for (int lab = 0; lab < 2; ++lab) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+			runScalarAndSIMD([&](bool vector) {
+				results[vector].reset(FreeImage_Clone(src.get()));
+				assert(lab ? ConvertLABtoRGB(results[vector].get()) : ConvertCMYKtoRGBA(results[vector].get()));
+			});
+			if (!lab) {
+				// CMYK kernels are bit exact
+				assert(isSameBitmap(results[0].get(), results[1].get()));
+				if (type == FIT_BITMAP) {
+					const uint8_t *s = FreeImage_GetScanLine(src.get(), 3);
+					const uint8_t *d = FreeImage_GetScanLine(results[1].get(), 3);
+					for (unsigned x = 0; x < width; ++x, s += 4, d += 4) {
+						assert(d[FI_RGBA_RED] == (255 - s[0]) * (255 - s[3]) / 255);
+						assert(d[FI_RGBA_BLUE] == (255 - s[2]) * (255 - s[3]) / 255);
+						assert(d[FI_RGBA_ALPHA] == 255);
+					}
+				}
+				continue;
+			}
+			// Lab is compared with a double precision reference
+			const unsigned samples = FreeImage_GetLine(src.get()) / width / (type == FIT_BITMAP ? 1 : 2);
+			const double max_val = (type == FIT_BITMAP) ? 255 : 65535;
+			for (unsigned y = 0; y < height; ++y) {
+				for (unsigned x = 0; x < width; ++x) {
+					double in[3], out[2][3];
+					for (unsigned c = 0; c < 3; ++c) {
+						if (type == FIT_BITMAP) {
+							in[c] = FreeImage_GetScanLine(src.get(), y)[x * samples + c];
+							for (int vector = 0; vector < 2; ++vector) {
+								static const unsigned order[3] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE };
+								out[vector][c] = FreeImage_GetScanLine(results[vector].get(), y)[x * samples + order[c]];
+							}
+						} else {
+							in[c] = reinterpret_cast<const uint16_t*>(FreeImage_GetScanLine(src.get(), y))[x * samples + c];
+							for (int vector = 0; vector < 2; ++vector) {
+								out[vector][c] = reinterpret_cast<const uint16_t*>(FreeImage_GetScanLine(results[vector].get(), y))[x * samples + c];
+							}
+						}
+					}
+					auto expand = [](double t) { return (t * t * t > 0.008856) ? t * t * t : (t - 16.0 / 116.0) / 7.787; };
+					const double fy = (in[0] * 100 / max_val + 16) / 116;
+					const double X = 0.95047 * expand((in[1] * 256 / max_val - 128) / 500 + fy);
+					const double Y = expand(fy);
+					const double Z = 1.08883 * expand(fy - (in[2] * 256 / max_val - 128) / 200);
+					const double rgb[3] = {
+						X *  3.2406 + Y * -1.5372 + Z * -0.4986,
+						X * -0.9689 + Y *  1.8758 + Z *  0.0415,
+						X *  0.0557 + Y * -0.2040 + Z *  1.0570 };
+					for (unsigned c = 0; c < 3; ++c) {
+						const double v = (rgb[c] > 0.0031308) ? 1.055 * pow(rgb[c], 1 / 2.4) - 0.055 : 12.92 * rgb[c];
+						const double expected = std::floor(std::min(std::max(v * max_val, 0.0), max_val));
+						assert(std::abs(out[0][c] - expected) <= 1 && std::abs(out[1][c] - expected) <= 1);
+					}
+				}
+			}
+		}
+	}
+}
+
+void testRawBitsKernels()
+{
+	// every 16-bit value, converted between 555 and 565 with and without the kernels
+	for (const bool to565 : { false, true }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(to565
+			? FreeImage_Allocate(256, 256, 16, FI16_555_RED_MASK, FI16_555_GREEN_MASK, FI16_555_BLUE_MASK)
+			: FreeImage_Allocate(256, 256, 16, FI16_565_RED_MASK, FI16_565_GREEN_MASK, FI16_565_BLUE_MASK), &::FreeImage_Unload);
+		assert(src != nullptr);
+		for (unsigned y = 0; y < 256; ++y) {
+			uint16_t *bits = reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(src.get(), y));
+			for (unsigned x = 0; x < 256; ++x) {
+				bits[x] = static_cast<uint16_t>((y << 8) | x);
+			}
+		}
+		assert(isSameScalarAndSIMD([&] { return to565 ? FreeImage_ConvertTo16Bits565(src.get()) : FreeImage_ConvertTo16Bits555(src.get()); }));
+	}
+
+	// BGR(A) <-> RGB(A) swaps through raw buffers, widths leave scalar tails after the vector blocks
+	const unsigned width = 333, height = 64;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_Allocate(width, height, 32), &::FreeImage_Unload);
+	assert(src != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *bits = FreeImage_GetScanLine(src.get(), y);
+		for (unsigned x = 0; x < FreeImage_GetLine(src.get()); ++x) {
+			bits[x] = static_cast<uint8_t>(x * 37 + y * 101 + (x >> 3));
+		}
+	}
+	for (const unsigned bpp : { 24u, 32u }) {
+		const unsigned bytespp = bpp / 8;
+		const int pitch = static_cast<int>(width * bytespp + 7);
+		std::vector<uint8_t> raw[2];
+		runScalarAndSIMD([&](bool vector) {
+			raw[vector].assign(static_cast<size_t>(pitch) * height, 0);
+			FreeImage_ConvertToRawBits(raw[vector].data(), src.get(), pitch, bpp, FI_RGBA_BLUE_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_RED_MASK, TRUE);
+		});
+		assert(raw[0] == raw[1]);
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t *s = FreeImage_GetScanLine(src.get(), height - y - 1);
+			const uint8_t *d = raw[1].data() + static_cast<size_t>(y) * pitch;
+			for (unsigned x = 0; x < width; ++x, s += 4, d += bytespp) {
+				assert(d[FI_RGBA_BLUE] == s[FI_RGBA_RED] && d[FI_RGBA_GREEN] == s[FI_RGBA_GREEN] && d[FI_RGBA_RED] == s[FI_RGBA_BLUE]);
+				assert(bpp == 24 || d[FI_RGBA_ALPHA] == s[FI_RGBA_ALPHA]);
+			}
+		}
+
+		// the swapped raw buffer comes back in the FI_RGBA order
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(bpp == 24 ? FreeImage_ConvertTo24Bits(src.get()) : FreeImage_Clone(src.get()), &::FreeImage_Unload);
+		runScalarAndSIMD([&](bool vector) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> back(FreeImage_ConvertFromRawBits(raw[vector].data(), width, height, pitch, bpp, FI_RGBA_BLUE_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_RED_MASK, TRUE), &::FreeImage_Unload);
+			assert(back != nullptr);
+			assert(FreeImage_GetRedMask(back.get()) == FI_RGBA_RED_MASK);
+			assert(isSameBitmap(back.get(), expected.get()));
+		});
+	}
+}
@@ -23,6 +23,9 @@
 #include "TestSuite.h"
 #include <memory>
 #include <limits>
+#include <string.h>
+#include <cmath>
+#include <initializer_list>
 
 /**
 Test FreeImage_ConvertToFloat
@@ -98,5 +101,190 @@ void testConvertToFloat()
 		assert(res_ptr[2] == 10000.0f);
 		assert(res_ptr[3] == 65535.0f);
 	}
+
+	{
+		// rows converted by parallel bands
+		const unsigned width = 333, height = 777;
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp_int32(FreeImage_AllocateT(FIT_INT32, width, height, 16), &::FreeImage_Unload);
+		assert(bmp_int32 != nullptr);
+		for (unsigned y = 0; y < height; y++) {
+			int32_t* line = reinterpret_cast<int32_t*>(FreeImage_GetScanLine(bmp_int32.get(), y));
+			for (unsigned x = 0; x < width; x++) {
+				line[x] = (int32_t)(y * width + x) - 1000;
+			}
+		}
+
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_ConvertToFloat(bmp_int32.get(), FALSE), &::FreeImage_Unload);
+		assert(res != nullptr);
+		for (unsigned y = 0; y < height; y++) {
+			const float* line = reinterpret_cast<const float*>(FreeImage_GetScanLine(res.get(), y));
+			for (unsigned x = 0; x < width; x++) {
+				assert(line[x] == (float)((int32_t)(y * width + x) - 1000));
+			}
+		}
+	}
+
+	{
+		// half floats are expanded as RGBAF first
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbaf(FreeImage_AllocateT(FIT_RGBAF, 5, 3), &::FreeImage_Unload);
+		assert(rgbaf != nullptr);
+		for (unsigned y = 0; y < 3; y++) {
+			FIRGBAF* line = reinterpret_cast<FIRGBAF*>(FreeImage_GetScanLine(rgbaf.get(), y));
+			for (unsigned x = 0; x < 5; x++) {
+				line[x] = { 0.25f * x, 0.5f, 0.125f * y, 1.0f };
+			}
+		}
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbah(FreeImage_ConvertToType(rgbaf.get(), FIT_RGBAH), &::FreeImage_Unload);
+		assert(rgbah != nullptr);
+
+		for (FIBOOL scale_linear = FALSE; scale_linear <= TRUE; scale_linear++) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_ConvertToFloat(rgbaf.get(), scale_linear), &::FreeImage_Unload);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_ConvertToFloat(rgbah.get(), scale_linear), &::FreeImage_Unload);
+			assert(expected != nullptr && res != nullptr);
+			for (unsigned y = 0; y < 3; y++) {
+				assert(memcmp(FreeImage_GetScanLine(res.get(), y), FreeImage_GetScanLine(expected.get(), y), 5 * sizeof(float)) == 0);
+			}
+		}
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_ConvertToType(rgbah.get(), FIT_FLOAT), &::FreeImage_Unload);
+		assert(res != nullptr && FreeImage_GetImageType(res.get()) == FIT_FLOAT);
+
+		// types without a conversion are rejected
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rejected(FreeImage_ConvertToType(rgbah.get(), FIT_INT16), &::FreeImage_Unload);
+		assert(rejected == nullptr);
+	}
+}
+
+void testFloatKernels()
+{
+	// widths leave scalar tails after the vector blocks
+	const unsigned width = 333, height = 97;
+	for (const auto format : { std::make_pair(FIT_BITMAP, 8u), std::make_pair(FIT_BITMAP, 24u), std::make_pair(FIT_BITMAP, 32u),
+		std::make_pair(FIT_UINT16, 16u), std::make_pair(FIT_RGB16, 48u), std::make_pair(FIT_RGBA16, 64u) }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(format.first, width, height, format.second), &::FreeImage_Unload);
+		assert(src != nullptr);
+		if (format.second == 8) {
+			FIRGBA8 *pal = FreeImage_GetPalette(src.get());
+			for (unsigned i = 0; i < 256; ++i) {
+				pal[i].red = pal[i].green = pal[i].blue = static_cast<uint8_t>(i);
+			}
+		}
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t *bits = FreeImage_GetScanLine(src.get(), y);
+			for (unsigned x = 0; x < FreeImage_GetLine(src.get()); ++x) {
+				bits[x] = static_cast<uint8_t>(x * 37 + y * 11 + (x * y) / 7);
+			}
+		}
+
+		FIBITMAP *(DLL_CALLCONV *const converters[])(FIBITMAP *) = {
+			FreeImage_ConvertToRGBF, FreeImage_ConvertToRGBAF, FreeImage_ConvertToLinearRGBF, FreeImage_ConvertToLinearRGBAF
+		};
+		for (auto convert : converters) {
+			assert(isSameScalarAndSIMD([&] { return convert(src.get()); }));
+		}
+		if (format.first == FIT_BITMAP) {
+			assert(isSameScalarAndSIMD([&] { return FreeImage_ConvertToFloat(src.get()); }));
+		}
+	}
+
+	// 8-bit values are scaled exactly, sRGB values are decoded and alpha stays linear
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgba(FreeImage_Allocate(256, 1, 32), &::FreeImage_Unload);
+	uint8_t *bits = FreeImage_GetScanLine(rgba.get(), 0);
+	for (unsigned x = 0; x < 256; ++x) {
+		bits[4 * x + FI_RGBA_RED] = bits[4 * x + FI_RGBA_GREEN] = bits[4 * x + FI_RGBA_BLUE] = bits[4 * x + FI_RGBA_ALPHA] = static_cast<uint8_t>(x);
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> linear(FreeImage_ConvertToRGBAF(rgba.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> decoded(FreeImage_ConvertToLinearRGBAF(rgba.get()), &::FreeImage_Unload);
+	assert(linear && decoded);
+	const auto *lp = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(linear.get(), 0));
+	const auto *dp = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(decoded.get(), 0));
+	for (unsigned x = 0; x < 256; ++x) {
+		assert(lp[x].red == static_cast<float>(x) / 255.0F);
+		assert(dp[x].alpha == lp[x].alpha);
+	}
+	assert(dp[0].red == 0.0F && dp[255].red == 1.0F);
+	assert(std::abs(dp[128].red - 0.2158605F) < 1e-6F);
 }
 
+void testTransferKernels()
+{
+	const FREE_IMAGE_TRANSFER transfers[] = { FITF_SRGB_TO_LINEAR, FITF_LINEAR_TO_SRGB, FITF_PQ_TO_LINEAR, FITF_LINEAR_TO_PQ, FITF_HLG_TO_LINEAR, FITF_LINEAR_TO_HLG };
+
+	// widths leave scalar tails after the vector blocks
+	const unsigned width = 333, height = 17;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(FIT_RGBAF, width, height), &::FreeImage_Unload);
+	assert(src != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		auto *pixel = reinterpret_cast<FIRGBAF*>(FreeImage_GetScanLine(src.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			pixel[x].red = (x + y * width) / float(width * height - 1);
+			pixel[x].green = x / float(width - 1);
+			pixel[x].blue = 1.0F - pixel[x].red;
+			pixel[x].alpha = 0.5F + x * 0.001F;
+		}
+	}
+
+	for (const auto transfer : transfers) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+		runScalarAndSIMD([&](bool vector) {
+			results[vector].reset(FreeImage_ConvertTransfer(src.get(), transfer));
+			assert(results[vector] && (FreeImage_GetImageType(results[vector].get()) == FIT_RGBAF));
+		});
+		// kernels and scalar code agree, alpha is kept
+		for (unsigned y = 0; y < height; ++y) {
+			const auto *s = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(src.get(), y));
+			const auto *a = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(results[0].get(), y));
+			const auto *b = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(results[1].get(), y));
+			for (unsigned x = 0; x < width; ++x) {
+				assert(std::abs(a[x].red - b[x].red) <= 1e-6F + 1e-6F * std::abs(a[x].red));
+				assert(std::abs(a[x].blue - b[x].blue) <= 1e-6F + 1e-6F * std::abs(a[x].blue));
+				assert((a[x].alpha == s[x].alpha) && (b[x].alpha == s[x].alpha));
+			}
+		}
+	}
+
+	// float and 16-bit images agree, decoding undoes encoding
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> words(FreeImage_AllocateT(FIT_RGBA16, width, height), &::FreeImage_Unload);
+	assert(words != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		auto *s = reinterpret_cast<FIRGBAF*>(FreeImage_GetScanLine(src.get(), y));
+		auto *w = reinterpret_cast<FIRGBA16*>(FreeImage_GetScanLine(words.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			// same sample values in both images
+			w[x].green = static_cast<uint16_t>(s[x].green * 65535.0F + 0.5F);
+			s[x].green = w[x].green / 65535.0F;
+		}
+	}
+	for (unsigned i = 0; i < 6; i += 2) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> encoded(FreeImage_ConvertTransfer(src.get(), transfers[i + 1]), &::FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> decoded(FreeImage_ConvertTransfer(encoded.get(), transfers[i]), &::FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> encodedWords(FreeImage_ConvertTransfer(words.get(), transfers[i + 1]), &::FreeImage_Unload);
+		assert(decoded && encodedWords);
+		for (unsigned y = 0; y < height; ++y) {
+			const auto *s = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(src.get(), y));
+			const auto *e = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(encoded.get(), y));
+			const auto *d = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(decoded.get(), y));
+			const auto *w = reinterpret_cast<const FIRGBA16*>(FreeImage_GetScanLine(encodedWords.get(), y));
+			for (unsigned x = 0; x < width; ++x) {
+				assert(std::abs(d[x].green - s[x].green) < 1e-4F);
+				assert(std::abs(w[x].green / 65535.0F - e[x].green) < 1e-4F);
+			}
+		}
+	}
+
+	// 8-bit images use the exact curve, alpha is kept
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgba(FreeImage_Allocate(256, 1, 32), &::FreeImage_Unload);
+	uint8_t *bits = FreeImage_GetScanLine(rgba.get(), 0);
+	for (unsigned x = 0; x < 256; ++x) {
+		bits[4 * x + FI_RGBA_RED] = bits[4 * x + FI_RGBA_GREEN] = bits[4 * x + FI_RGBA_BLUE] = bits[4 * x + FI_RGBA_ALPHA] = static_cast<uint8_t>(x);
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> linear(FreeImage_ConvertTransfer(rgba.get(), FITF_SRGB_TO_LINEAR), &::FreeImage_Unload);
+	assert(linear != nullptr);
+	bits = FreeImage_GetScanLine(linear.get(), 0);
+	assert(bits[4 * 128 + FI_RGBA_RED] == 55);
+	assert(bits[4 * 255 + FI_RGBA_GREEN] == 255 && bits[FI_RGBA_BLUE] == 0);
+	assert(bits[4 * 128 + FI_RGBA_ALPHA] == 128);
+
+	// unsupported types
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> doubles(FreeImage_AllocateT(FIT_DOUBLE, 4, 4), &::FreeImage_Unload);
+	assert(FreeImage_ConvertTransfer(doubles.get(), FITF_SRGB_TO_LINEAR) == nullptr);
+}
@@ -0,0 +1,145 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <cstring>
+
+// Local test functions
+// ----------------------------------------------------------
+
+/**
+Fill an image with a deterministic pattern
+*/
+static void fillPattern(FIBITMAP *dib) {
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned line = FreeImage_GetLine(dib);
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < line; x++) {
+			bits[x] = (uint8_t)(x * 31 + y * 7);
+		}
+	}
+	if (FreeImage_GetImageType(dib) == FIT_RGBAF) {
+		// keep float values finite
+		for (unsigned y = 0; y < height; y++) {
+			FIRGBAF *pixel = (FIRGBAF*)FreeImage_GetScanLine(dib, y);
+			for (unsigned x = 0; x < FreeImage_GetWidth(dib); x++) {
+				pixel[x].red = x * 0.01F;
+				pixel[x].green = y * 0.02F;
+				pixel[x].blue = 1.5F - x * 0.01F;
+				pixel[x].alpha = 0.5F;
+			}
+		}
+	}
+}
+
+/**
+Convert an image in place and check it against the allocating conversion
+*/
+static void checkInPlace(FREE_IMAGE_TYPE src_type, unsigned src_bpp, FREE_IMAGE_TYPE dst_type, unsigned dst_bpp, FIBITMAP *(DLL_CALLCONV *convert)(FIBITMAP*)) {
+	FIBITMAP *dib = FreeImage_AllocateT(src_type, 173, 41, src_bpp);
+	assert(dib != NULL);
+	fillPattern(dib);
+	FreeImage_SetDotsPerMeterX(dib, 3937);
+
+	FIBITMAP *expected = convert(dib);
+	assert(expected != NULL);
+
+	// a clone shares the pixels and must not be affected
+	FIBITMAP *clone = FreeImage_Clone(dib);
+	assert(clone != NULL);
+
+	FIBOOL bResult = FreeImage_ConvertInPlace(dib, dst_type, dst_bpp);
+	assert(bResult);
+	assert(FreeImage_GetImageType(dib) == FreeImage_GetImageType(expected));
+	assert(FreeImage_GetBPP(dib) == FreeImage_GetBPP(expected));
+	assert(FreeImage_GetPitch(dib) == FreeImage_GetPitch(expected));
+	assert(FreeImage_GetColorsUsed(dib) == FreeImage_GetColorsUsed(expected));
+	assert(FreeImage_GetDotsPerMeterX(dib) == 3937);
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		assert(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(expected, y), FreeImage_GetLine(dib)) == 0);
+	}
+	if (FreeImage_GetColorsUsed(dib)) {
+		assert(memcmp(FreeImage_GetPalette(dib), FreeImage_GetPalette(expected), FreeImage_GetColorsUsed(dib) * sizeof(FIRGBA8)) == 0);
+	}
+
+	assert(FreeImage_GetImageType(clone) == src_type);
+	assert(FreeImage_GetBPP(clone) == src_bpp);
+	FIBITMAP *reference = FreeImage_AllocateT(src_type, 173, 41, src_bpp);
+	fillPattern(reference);
+	for (unsigned y = 0; y < FreeImage_GetHeight(clone); y++) {
+		assert(memcmp(FreeImage_GetScanLine(clone, y), FreeImage_GetScanLine(reference, y), FreeImage_GetLine(clone)) == 0);
+	}
+
+	FreeImage_Unload(reference);
+	FreeImage_Unload(clone);
+	FreeImage_Unload(expected);
+	FreeImage_Unload(dib);
+}
+
+static FIBITMAP* DLL_CALLCONV convertToRGB16(FIBITMAP *dib) {
+	return FreeImage_ConvertToRGB16(dib);
+}
+
+static FIBITMAP* DLL_CALLCONV convertToRGBF(FIBITMAP *dib) {
+	return FreeImage_ConvertToRGBF(dib);
+}
+
+static FIBITMAP* DLL_CALLCONV convertToFloat(FIBITMAP *dib) {
+	return FreeImage_ConvertToFloat(dib);
+}
+
+void testConvertInPlace() {
+	printf("testConvertInPlace ...\n");
+
+	checkInPlace(FIT_BITMAP, 32, FIT_BITMAP, 24, FreeImage_ConvertTo24Bits);
+	checkInPlace(FIT_BITMAP, 32, FIT_BITMAP, 8, FreeImage_ConvertTo8Bits);
+	checkInPlace(FIT_BITMAP, 24, FIT_BITMAP, 8, FreeImage_ConvertTo8Bits);
+	checkInPlace(FIT_UINT16, 16, FIT_BITMAP, 8, FreeImage_ConvertTo8Bits);
+	checkInPlace(FIT_RGB16, 48, FIT_BITMAP, 24, FreeImage_ConvertTo24Bits);
+	checkInPlace(FIT_RGBA16, 64, FIT_BITMAP, 24, FreeImage_ConvertTo24Bits);
+	checkInPlace(FIT_RGBA16, 64, FIT_BITMAP, 32, FreeImage_ConvertTo32Bits);
+	checkInPlace(FIT_RGBA16, 64, FIT_RGB16, 0, convertToRGB16);
+	checkInPlace(FIT_RGBAF, 128, FIT_RGBF, 0, convertToRGBF);
+	checkInPlace(FIT_RGBAF, 128, FIT_FLOAT, 0, convertToFloat);
+
+	// expanding conversions are refused and leave the image untouched
+	FIBITMAP *dib = FreeImage_Allocate(16, 16, 24);
+	assert(!FreeImage_ConvertInPlace(dib, FIT_BITMAP, 32));
+	assert(!FreeImage_ConvertInPlace(dib, FIT_RGBF, 0));
+	assert(FreeImage_GetBPP(dib) == 24);
+	assert(FreeImage_ConvertInPlace(dib, FIT_BITMAP, 24));
+	FreeImage_Unload(dib);
+
+	// a tiny image leaves no room for the 8-bit palette
+	dib = FreeImage_Allocate(1, 1, 32);
+	assert(!FreeImage_ConvertInPlace(dib, FIT_BITMAP, 8));
+	assert(FreeImage_GetBPP(dib) == 32);
+	FreeImage_Unload(dib);
+
+	// header only images
+	dib = FreeImage_AllocateHeaderT(TRUE, FIT_RGBAF, 100, 50);
+	assert(FreeImage_ConvertInPlace(dib, FIT_RGBF, 0));
+	assert((FreeImage_GetImageType(dib) == FIT_RGBF) && (FreeImage_GetBPP(dib) == 96));
+	FreeImage_Unload(dib);
+}
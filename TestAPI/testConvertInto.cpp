@@ -0,0 +1,265 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <cstring>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static const unsigned PADDING = 16;
+static const uint8_t GUARD = 0xCD;
+
+/**
+Fill an image with a deterministic pattern
+*/
+static void fillPattern(FIBITMAP *dib) {
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned line = FreeImage_GetLine(dib);
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < line; x++) {
+			bits[x] = (uint8_t)(x * 31 + y * 7);
+		}
+	}
+	if (FreeImage_GetImageType(dib) == FIT_RGBF) {
+		// keep float values finite
+		for (unsigned y = 0; y < height; y++) {
+			FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+			for (unsigned x = 0; x < FreeImage_GetWidth(dib); x++) {
+				pixel[x].red = x * 0.01F;
+				pixel[x].green = y * 0.02F;
+				pixel[x].blue = 1.5F - x * 0.01F;
+			}
+		}
+	}
+}
+
+/**
+Wrap a caller buffer, with PADDING guard bytes after each scanline, into a header only bitmap
+*/
+static FIBITMAP* allocateExternal(std::vector<uint8_t>& buffer, FREE_IMAGE_TYPE type, unsigned width, unsigned height, unsigned bpp) {
+	const unsigned pitch = (width * bpp + 7) / 8 + PADDING;
+	buffer.assign((size_t)pitch * height, GUARD);
+	return FreeImage_AllocateHeaderForBits(buffer.data(), pitch, type, width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+}
+
+/**
+Check that dst has the pixels of expected and that the guard bytes of the caller buffer are untouched
+*/
+static void checkSame(FIBITMAP *dst, FIBITMAP *expected) {
+	assert(FreeImage_GetWidth(dst) == FreeImage_GetWidth(expected));
+	assert(FreeImage_GetHeight(dst) == FreeImage_GetHeight(expected));
+	assert(FreeImage_GetLine(dst) == FreeImage_GetLine(expected));
+	const unsigned line = FreeImage_GetLine(dst);
+	for (unsigned y = 0; y < FreeImage_GetHeight(dst); y++) {
+		const uint8_t *bits = FreeImage_GetScanLine(dst, y);
+		assert(memcmp(bits, FreeImage_GetScanLine(expected, y), line) == 0);
+		for (unsigned x = line; x < FreeImage_GetPitch(dst); x++) {
+			assert(bits[x] == GUARD);
+		}
+	}
+	if (FreeImage_GetBPP(dst) <= 8) {
+		assert(memcmp(FreeImage_GetPalette(dst), FreeImage_GetPalette(expected), FreeImage_GetColorsUsed(dst) * sizeof(FIRGBA8)) == 0);
+	}
+}
+
+/**
+Convert into a caller buffer and check it against the allocating conversion
+*/
+static void checkConvertInto(FREE_IMAGE_TYPE src_type, unsigned src_bpp, FREE_IMAGE_TYPE dst_type, unsigned dst_bpp, FIBITMAP *(DLL_CALLCONV *convert)(FIBITMAP*)) {
+	FIBITMAP *src = FreeImage_AllocateT(src_type, 173, 41, src_bpp);
+	assert(src != NULL);
+	fillPattern(src);
+	FreeImage_SetDotsPerMeterX(src, 3937);
+
+	FIBITMAP *expected = convert(src);
+	assert(expected != NULL);
+	assert((FreeImage_GetImageType(expected) == dst_type) && (FreeImage_GetBPP(expected) == dst_bpp));
+
+	std::vector<uint8_t> buffer;
+	FIBITMAP *dst = allocateExternal(buffer, dst_type, 173, 41, dst_bpp);
+	assert(dst != NULL);
+	FIBOOL bResult = FreeImage_ConvertInto(dst, src);
+	assert(bResult);
+	checkSame(dst, expected);
+	assert(FreeImage_GetDotsPerMeterX(dst) == 3937);
+
+	FreeImage_Unload(dst);
+	FreeImage_Unload(expected);
+	FreeImage_Unload(src);
+}
+
+static FIBITMAP* DLL_CALLCONV convertToFloat(FIBITMAP *dib) {
+	return FreeImage_ConvertToFloat(dib);
+}
+
+static void testConvertIntoBuffer() {
+	checkConvertInto(FIT_BITMAP, 8, FIT_BITMAP, 24, FreeImage_ConvertTo24Bits);
+	checkConvertInto(FIT_BITMAP, 8, FIT_BITMAP, 32, FreeImage_ConvertTo32Bits);
+	checkConvertInto(FIT_BITMAP, 24, FIT_BITMAP, 32, FreeImage_ConvertTo32Bits);
+	checkConvertInto(FIT_BITMAP, 32, FIT_BITMAP, 24, FreeImage_ConvertTo24Bits);
+	checkConvertInto(FIT_BITMAP, 32, FIT_BITMAP, 32, FreeImage_ConvertTo32Bits);
+	checkConvertInto(FIT_RGB16, 48, FIT_BITMAP, 32, FreeImage_ConvertTo32Bits);
+	checkConvertInto(FIT_RGBA16, 64, FIT_BITMAP, 24, FreeImage_ConvertTo24Bits);
+	// conversions going through a temporary image
+	checkConvertInto(FIT_BITMAP, 24, FIT_BITMAP, 8, FreeImage_ConvertTo8Bits);
+	checkConvertInto(FIT_BITMAP, 32, FIT_FLOAT, 32, convertToFloat);
+
+	// sizes must match
+	FIBITMAP *src = FreeImage_Allocate(16, 16, 24);
+	FIBITMAP *dst = FreeImage_Allocate(16, 15, 32);
+	assert(!FreeImage_ConvertInto(dst, src));
+	FreeImage_Unload(dst);
+	FreeImage_Unload(src);
+}
+
+static void testRescaleIntoBuffer() {
+	std::vector<uint8_t> buffer;
+
+	// true color
+	FIBITMAP *src = FreeImage_Allocate(173, 41, 24);
+	fillPattern(src);
+	FIBITMAP *expected = FreeImage_Rescale(src, 64, 97, FILTER_BILINEAR);
+	FIBITMAP *dst = allocateExternal(buffer, FIT_BITMAP, 64, 97, 24);
+	assert(FreeImage_RescaleInto(dst, src, FILTER_BILINEAR));
+	checkSame(dst, expected);
+	FreeImage_Unload(dst);
+	FreeImage_Unload(expected);
+
+	// a destination of another bit depth is refused
+	dst = allocateExternal(buffer, FIT_BITMAP, 64, 97, 32);
+	assert(!FreeImage_RescaleInto(dst, src, FILTER_BILINEAR));
+	FreeImage_Unload(dst);
+
+	// same size, converts into the destination
+	expected = FreeImage_ConvertTo32Bits(src);
+	dst = allocateExternal(buffer, FIT_BITMAP, 173, 41, 32);
+	assert(FreeImage_RescaleInto(dst, src));
+	checkSame(dst, expected);
+	FreeImage_Unload(dst);
+	FreeImage_Unload(expected);
+	FreeImage_Unload(src);
+
+	// greyscale into an 8-bit and a 24-bit destination
+	src = FreeImage_Allocate(173, 41, 8);
+	fillPattern(src);
+	expected = FreeImage_Rescale(src, 200, 20, FILTER_CATMULLROM);
+	dst = allocateExternal(buffer, FIT_BITMAP, 200, 20, 8);
+	assert(FreeImage_RescaleInto(dst, src));
+	checkSame(dst, expected);
+	FreeImage_Unload(dst);
+	FreeImage_Unload(expected);
+
+	expected = FreeImage_RescaleRect(src, 200, 20, 0, 0, 173, 41, FILTER_CATMULLROM, FI_RESCALE_TRUE_COLOR);
+	dst = allocateExternal(buffer, FIT_BITMAP, 200, 20, 24);
+	assert(FreeImage_RescaleInto(dst, src));
+	checkSame(dst, expected);
+	FreeImage_Unload(dst);
+	FreeImage_Unload(expected);
+	FreeImage_Unload(src);
+
+	// high dynamic range
+	src = FreeImage_AllocateT(FIT_RGBF, 50, 50);
+	fillPattern(src);
+	expected = FreeImage_Rescale(src, 25, 30, FILTER_BOX);
+	dst = allocateExternal(buffer, FIT_RGBF, 25, 30, 96);
+	assert(FreeImage_RescaleInto(dst, src, FILTER_BOX));
+	checkSame(dst, expected);
+	FreeImage_Unload(dst);
+	FreeImage_Unload(expected);
+	FreeImage_Unload(src);
+}
+
+static void testRescaleWordsIntoBytes() {
+	FIBITMAP *(DLL_CALLCONV *const converters[])(FIBITMAP *) = { FreeImage_ConvertTo8Bits, FreeImage_ConvertTo24Bits, FreeImage_ConvertTo32Bits };
+	const FREE_IMAGE_TYPE types[] = { FIT_UINT16, FIT_RGB16, FIT_RGBA16 };
+	for (unsigned i = 0; i < 3; i++) {
+		FIBITMAP *src = FreeImage_AllocateT(types[i], 173, 41);
+		fillPattern(src);
+
+		// filtered and converted rows match a conversion of the rescaled image, in both filtering orders
+		for (const unsigned size : { 64u, 300u }) {
+			FIBITMAP *scaled = FreeImage_Rescale(src, size, 97, FILTER_BILINEAR);
+			FIBITMAP *expected = converters[i](scaled);
+			std::vector<uint8_t> buffer;
+			FIBITMAP *dst = allocateExternal(buffer, FIT_BITMAP, size, 97, FreeImage_GetBPP(expected));
+			assert(FreeImage_RescaleInto(dst, src, FILTER_BILINEAR));
+			checkSame(dst, expected);
+			FreeImage_Unload(dst);
+			FreeImage_Unload(expected);
+			FreeImage_Unload(scaled);
+		}
+
+		// thumbnails are filtered straight into the standard bitmap
+		FIBITMAP *thumbnail = FreeImage_MakeThumbnail(src, 100);
+		FIBITMAP *scaled = FreeImage_Rescale(src, 100, 24, FILTER_BILINEAR);
+		FIBITMAP *expected = converters[i](scaled);
+		assert(thumbnail && (FreeImage_GetImageType(thumbnail) == FIT_BITMAP));
+		checkSame(thumbnail, expected);
+		FreeImage_Unload(expected);
+		FreeImage_Unload(scaled);
+		FreeImage_Unload(thumbnail);
+
+		// a rectangle is filtered like a copy of it
+		FIBITMAP *rect = FreeImage_RescaleRect(src, 30, 10, 13, 5, 113, 36, FILTER_BILINEAR);
+		FIBITMAP *copy = FreeImage_Copy(src, 13, 5, 113, 36);
+		expected = FreeImage_Rescale(copy, 30, 10, FILTER_BILINEAR);
+		checkSame(rect, expected);
+		FreeImage_Unload(expected);
+		FreeImage_Unload(copy);
+		FreeImage_Unload(rect);
+
+		FreeImage_Unload(src);
+	}
+}
+
+static void checkCopyInto(unsigned bpp) {
+	std::vector<uint8_t> buffer;
+
+	FIBITMAP *src = FreeImage_Allocate(173, 41, bpp);
+	fillPattern(src);
+	// a width multiple of 8 leaves no unused bits at the end of 1 and 4-bit scanlines
+	FIBITMAP *expected = FreeImage_Copy(src, 13, 5, 109, 36);
+	FIBITMAP *dst = allocateExternal(buffer, FIT_BITMAP, 96, 31, bpp);
+	assert(FreeImage_CopyInto(dst, src, 13, 5, 109, 36));
+	checkSame(dst, expected);
+	// the rectangle must have the size of dst
+	assert(!FreeImage_CopyInto(dst, src, 13, 5, 108, 36));
+	FreeImage_Unload(dst);
+	FreeImage_Unload(expected);
+	FreeImage_Unload(src);
+}
+
+void testConvertInto() {
+	printf("testConvertInto ...\n");
+
+	testConvertIntoBuffer();
+	testRescaleIntoBuffer();
+	testRescaleWordsIntoBytes();
+	checkCopyInto(1);
+	checkCopyInto(4);
+	checkCopyInto(8);
+	checkCopyInto(32);
+}
@@ -0,0 +1,459 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+#include <string.h>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+#define DDS_FOURCC(ch0, ch1, ch2, ch3) \
+	((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) | ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24))
+
+static void writeLong(FIMEMORY *hmem, uint32_t value) {
+	FreeImage_WriteMemory(&value, sizeof(value), 1, hmem);
+}
+
+// a little endian DDS file of the given FourCC (and DXGI format when the FourCC is DX10)
+static FIMEMORY* makeDDS(unsigned width, unsigned height, unsigned mipmaps, uint32_t fourcc, uint32_t dxgi, const std::vector<uint8_t>& data) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	writeLong(hmem, DDS_FOURCC('D', 'D', 'S', ' '));
+	writeLong(hmem, 124);
+	writeLong(hmem, 0x1007 | (mipmaps > 1 ? 0x20000 : 0));	// caps, height, width, pixel format, mipmap count
+	writeLong(hmem, height);
+	writeLong(hmem, width);
+	writeLong(hmem, 0);
+	writeLong(hmem, 0);
+	writeLong(hmem, mipmaps);
+	for (int i = 0; i < 11; i++) {
+		writeLong(hmem, 0);
+	}
+	// pixel format
+	writeLong(hmem, 32);
+	writeLong(hmem, 0x4);	// DDPF_FOURCC
+	writeLong(hmem, fourcc);
+	for (int i = 0; i < 5; i++) {
+		writeLong(hmem, 0);
+	}
+	// caps
+	writeLong(hmem, 0x1000);
+	for (int i = 0; i < 4; i++) {
+		writeLong(hmem, 0);
+	}
+	if (fourcc == DDS_FOURCC('D', 'X', '1', '0')) {
+		writeLong(hmem, dxgi);
+		writeLong(hmem, 3);		// texture 2D
+		writeLong(hmem, 0);
+		writeLong(hmem, 1);
+		writeLong(hmem, 0);
+	}
+	FreeImage_WriteMemory(data.data(), 1, (unsigned)data.size(), hmem);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	return hmem;
+}
+
+// a BC1 block of a single 565 color
+static void addSolidBC1(std::vector<uint8_t>& data, uint16_t color) {
+	const uint8_t block[8] = { (uint8_t)(color & 0xFF), (uint8_t)(color >> 8), 0, 0, 0, 0, 0, 0 };
+	data.insert(data.end(), block, block + 8);
+}
+
+// top-left pixel is the first pixel of the file
+static void checkColor(FIBITMAP *dib, unsigned x, unsigned y, uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha) {
+	const uint8_t *pixel = FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - 1 - y) + 4 * x;
+	assert(pixel[FI_RGBA_RED] == red && pixel[FI_RGBA_GREEN] == green && pixel[FI_RGBA_BLUE] == blue && pixel[FI_RGBA_ALPHA] == alpha);
+}
+
+static FIBOOL isSameImage(FIBITMAP *dib1, FIBITMAP *dib2) {
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if (memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), FreeImage_GetLine(dib1)) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+// memory IO over a FIMEMORY, not recognized as a memory stream by the plugins
+static unsigned DLL_CALLCONV ddsReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_ReadMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static unsigned DLL_CALLCONV ddsWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return 0;
+}
+
+static int DLL_CALLCONV ddsSeekProc(fi_handle handle, long offset, int origin) {
+	return FreeImage_SeekMemory((FIMEMORY*)handle, offset, origin) ? 0 : -1;
+}
+
+static long DLL_CALLCONV ddsTellProc(fi_handle handle) {
+	return FreeImage_TellMemory((FIMEMORY*)handle);
+}
+
+// LSB first bit writer of 128-bit blocks
+struct BlockWriter {
+	uint8_t block[16] = {};
+	unsigned position = 0;
+
+	void write(unsigned value, unsigned count) {
+		for (unsigned i = 0; i < count; i++, position++) {
+			block[position / 8] |= (uint8_t)(((value >> i) & 1) << (position % 8));
+		}
+	}
+};
+
+// Main test function
+// ----------------------------------------------------------
+
+void testDDS() {
+	printf("testDDS ...\n");
+
+	const uint32_t DX10 = DDS_FOURCC('D', 'X', '1', '0');
+
+	// BC1 texture which size isn't a multiple of 4: red (0xF800) top-left block, blue (0x001F) other blocks
+	{
+		std::vector<uint8_t> data;
+		addSolidBC1(data, 0xF800);
+		addSolidBC1(data, 0x001F);
+		addSolidBC1(data, 0x001F);
+		addSolidBC1(data, 0x001F);
+		FIMEMORY *hmem = makeDDS(6, 5, 1, DDS_FOURCC('D', 'X', 'T', '1'), 0, data);
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_DDS, hmem, 0);
+		assert(dib != NULL);
+		assert(FreeImage_GetWidth(dib) == 6 && FreeImage_GetHeight(dib) == 5 && FreeImage_GetBPP(dib) == 32);
+		checkColor(dib, 0, 0, 255, 0, 0, 255);
+		checkColor(dib, 3, 3, 255, 0, 0, 255);
+		checkColor(dib, 4, 0, 0, 0, 255, 255);
+		checkColor(dib, 5, 4, 0, 0, 255, 255);
+		FreeImage_Unload(dib);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	// mipmap levels of a 16x8 BC1 texture: red, green (0x07E0) then blue
+	{
+		std::vector<uint8_t> data;
+		for (int i = 0; i < 8; i++) {
+			addSolidBC1(data, 0xF800);
+		}
+		for (int i = 0; i < 2; i++) {
+			addSolidBC1(data, 0x07E0);
+		}
+		addSolidBC1(data, 0x001F);
+		FIMEMORY *hmem = makeDDS(16, 8, 3, DDS_FOURCC('D', 'X', 'T', '1'), 0, data);
+
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_DDS, hmem, DDS_MIPMAP(1));
+		assert(dib != NULL);
+		assert(FreeImage_GetWidth(dib) == 8 && FreeImage_GetHeight(dib) == 4);
+		checkColor(dib, 7, 3, 0, 255, 0, 255);
+		FreeImage_Unload(dib);
+
+		// levels beyond the last one load the last one
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		dib = FreeImage_LoadFromMemory(FIF_DDS, hmem, DDS_MIPMAP(7));
+		assert(dib != NULL);
+		assert(FreeImage_GetWidth(dib) == 4 && FreeImage_GetHeight(dib) == 2);
+		checkColor(dib, 0, 0, 0, 0, 255, 255);
+		FreeImage_Unload(dib);
+
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		dib = FreeImage_LoadFromMemory(FIF_DDS, hmem, DDS_MIPMAP(1) | FIF_LOAD_NOPIXELS);
+		assert(dib != NULL && !FreeImage_HasPixels(dib));
+		assert(FreeImage_GetWidth(dib) == 8 && FreeImage_GetHeight(dib) == 4);
+		FreeImage_Unload(dib);
+
+		// scaled loading picks the smallest level large enough
+		FreeImageIO io;
+		io.read_proc = ddsReadProc;
+		io.write_proc = ddsWriteProc;
+		io.seek_proc = ddsSeekProc;
+		io.tell_proc = ddsTellProc;
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		dib = FreeImage_LoadScaledFromHandle(FIF_DDS, &io, (fi_handle)hmem, 4, 4, 0);
+		assert(dib != NULL);
+		assert(FreeImage_GetWidth(dib) == 4 && FreeImage_GetHeight(dib) == 2);
+		checkColor(dib, 3, 1, 0, 0, 255, 255);
+		FreeImage_Unload(dib);
+
+		FreeImage_CloseMemory(hmem);
+	}
+
+	// random blocks decode the same with the scalar or the SIMD kernels, serially or on the thread pool
+	{
+		const unsigned width = 509, height = 263;
+		const struct {
+			uint32_t fourcc;
+			uint32_t dxgi;
+			unsigned block_size;
+		} formats[] = {
+			{ DDS_FOURCC('D', 'X', 'T', '1'), 0, 8 },
+			{ DDS_FOURCC('D', 'X', 'T', '3'), 0, 16 },
+			{ DDS_FOURCC('D', 'X', 'T', '5'), 0, 16 },
+			{ DDS_FOURCC('A', 'T', 'I', '1'), 0, 8 },
+			{ DDS_FOURCC('B', 'C', '4', 'S'), 0, 8 },
+			{ DDS_FOURCC('A', 'T', 'I', '2'), 0, 16 },
+			{ DX10, 95, 16 },	// BC6H_UF16
+			{ DX10, 96, 16 },	// BC6H_SF16
+			{ DX10, 98, 16 }	// BC7_UNORM
+		};
+		for (const auto& format : formats) {
+			std::vector<uint8_t> data((size_t)((width + 3) / 4) * ((height + 3) / 4) * format.block_size);
+			uint32_t seed = 12345;
+			for (uint8_t& value : data) {
+				seed = seed * 1103515245 + 12345;
+				value = (uint8_t)(seed >> 16);
+			}
+			FIMEMORY *hmem = makeDDS(width, height, 1, format.fourcc, format.dxgi, data);
+
+			FIBITMAP *results[2] = { NULL, NULL };
+			runScalarAndSIMD([&](bool vector) {
+				FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+				results[vector] = FreeImage_LoadFromMemory(FIF_DDS, hmem, 0);
+				assert(results[vector] != NULL);
+			});
+			assert(FreeImage_GetWidth(results[0]) == width && FreeImage_GetHeight(results[0]) == height);
+			assert(isSameImage(results[0], results[1]));
+
+			FreeImage_Unload(results[1]);
+			FreeImage_Unload(results[0]);
+			FreeImage_CloseMemory(hmem);
+		}
+	}
+
+	// BC7 mode 6 block: endpoints (255, 1, 129, 255) and (1, 255, 129, 255), first pixel at the first endpoint
+	{
+		BlockWriter bw;
+		bw.write(1 << 6, 7);
+		bw.write(127, 7); bw.write(0, 7);		// red
+		bw.write(0, 7); bw.write(127, 7);		// green
+		bw.write(64, 7); bw.write(64, 7);		// blue
+		bw.write(127, 7); bw.write(127, 7);		// alpha
+		bw.write(1, 1); bw.write(1, 1);			// p-bits
+		bw.write(0, 3);
+		for (int i = 1; i < 16; i++) {
+			bw.write(15, 4);
+		}
+		assert(bw.position == 128);
+		FIMEMORY *hmem = makeDDS(4, 4, 1, DX10, 98, std::vector<uint8_t>(bw.block, bw.block + 16));
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_DDS, hmem, 0);
+		assert(dib != NULL && FreeImage_GetBPP(dib) == 32);
+		checkColor(dib, 0, 0, 255, 1, 129, 255);
+		checkColor(dib, 1, 0, 1, 255, 129, 255);
+		checkColor(dib, 3, 3, 1, 255, 129, 255);
+		FreeImage_Unload(dib);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	// BC6H mode 11 block (one region, 10-bit endpoints): first pixel at the largest half, others at zero
+	{
+		BlockWriter bw;
+		bw.write(3, 5);
+		for (int c = 0; c < 3; c++) {
+			bw.write(0x3FF, 10);
+		}
+		for (int c = 0; c < 3; c++) {
+			bw.write(0, 10);
+		}
+		bw.write(0, 3);
+		for (int i = 1; i < 16; i++) {
+			bw.write(15, 4);
+		}
+		assert(bw.position == 128);
+		FIMEMORY *hmem = makeDDS(4, 4, 1, DX10, 95, std::vector<uint8_t>(bw.block, bw.block + 16));
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_DDS, hmem, 0);
+		assert(dib != NULL && FreeImage_GetImageType(dib) == FIT_RGBF);
+		const FIRGBF *top = (const FIRGBF*)FreeImage_GetScanLine(dib, 3);
+		assert(top[0].red == 65504.0f && top[0].green == 65504.0f && top[0].blue == 65504.0f);
+		assert(top[1].red == 0.0f && top[1].green == 0.0f && top[1].blue == 0.0f);
+		FreeImage_Unload(dib);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	// BC4 block: greyscale 200 for the first pixel, 100 for the others
+	{
+		// indices: 0 for the first pixel, 1 for the others
+		std::vector<uint8_t> data = { 200, 100, 0, 0, 0, 0, 0, 0 };
+		uint64_t bits = 0;
+		for (int i = 1; i < 16; i++) {
+			bits |= (uint64_t)1 << (3 * i);
+		}
+		for (int i = 0; i < 6; i++) {
+			data[2 + i] = (uint8_t)(bits >> (8 * i));
+		}
+		FIMEMORY *hmem = makeDDS(4, 4, 1, DDS_FOURCC('A', 'T', 'I', '1'), 0, data);
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_DDS, hmem, 0);
+		assert(dib != NULL && FreeImage_GetBPP(dib) == 8 && FreeImage_GetColorType(dib) == FIC_MINISBLACK);
+		const uint8_t *top = FreeImage_GetScanLine(dib, 3);
+		assert(top[0] == 200 && top[1] == 100 && FreeImage_GetScanLine(dib, 0)[3] == 100);
+		FreeImage_Unload(dib);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	// DX10 R8G8B8A8 pixels are stored in RGBA order
+	{
+		const uint8_t pixels[8] = { 10, 20, 30, 40, 50, 60, 70, 80 };
+		FIMEMORY *hmem = makeDDS(2, 1, 1, DX10, 28, std::vector<uint8_t>(pixels, pixels + 8));
+		FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_DDS, hmem, 0);
+		assert(dib != NULL && FreeImage_GetBPP(dib) == 32);
+		checkColor(dib, 0, 0, 10, 20, 30, 40);
+		checkColor(dib, 1, 0, 50, 60, 70, 80);
+		FreeImage_Unload(dib);
+		FreeImage_CloseMemory(hmem);
+	}
+}
+
+// a smooth 32-bit test image with a horizontal alpha ramp, opaque for BC1
+static FIBITMAP* makeTexture(unsigned width, unsigned height) {
+	FIBITMAP *dib = FreeImage_Allocate(width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	assert(dib != NULL);
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *pixel = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < width; x++, pixel += 4) {
+			pixel[FI_RGBA_RED] = (uint8_t)(x * 255 / width);
+			pixel[FI_RGBA_GREEN] = (uint8_t)(y * 255 / height);
+			pixel[FI_RGBA_BLUE] = (uint8_t)((x + y) * 127 / (width + height));
+			pixel[FI_RGBA_ALPHA] = (uint8_t)(255 - x * 127 / width);
+		}
+	}
+	return dib;
+}
+
+// mean absolute difference of the channels of two 32-bit images
+static double meanError(FIBITMAP *dib1, FIBITMAP *dib2, unsigned channels) {
+	double total = 0;
+	const unsigned width = FreeImage_GetWidth(dib1), height = FreeImage_GetHeight(dib1);
+	for (unsigned y = 0; y < height; y++) {
+		const uint8_t *p1 = FreeImage_GetScanLine(dib1, y);
+		const uint8_t *p2 = FreeImage_GetScanLine(dib2, y);
+		for (unsigned x = 0; x < width * 4; x++) {
+			if ((x % 4) < channels) {
+				total += abs((int)p1[x] - (int)p2[x]);
+			}
+		}
+	}
+	return total / (width * height * channels);
+}
+
+void testDDSSave() {
+	printf("testDDSSave ...\n");
+
+	const unsigned width = 70, height = 45;
+	FIBITMAP *src = makeTexture(width, height);
+
+	// uncompressed 24- and 32-bit textures are lossless
+	{
+		FIBITMAP *rgb = FreeImage_ConvertTo24Bits(src);
+		FIBITMAP *images[] = { src, rgb };
+		for (FIBITMAP *dib : images) {
+			FIMEMORY *hmem = FreeImage_OpenMemory();
+			FIBOOL bResult = FreeImage_SaveToMemory(FIF_DDS, dib, hmem, DDS_DEFAULT);
+			assert(bResult);
+			FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+			FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_DDS, hmem, 0);
+			assert(loaded != NULL && FreeImage_GetBPP(loaded) == FreeImage_GetBPP(dib));
+			assert(isSameImage(dib, loaded));
+			FreeImage_Unload(loaded);
+			FreeImage_CloseMemory(hmem);
+		}
+		FreeImage_Unload(rgb);
+	}
+
+	// block compressed textures are close to the source, the same whether encoded serially or on the thread pool
+	{
+		const unsigned thread_count = FreeImage_GetThreadCount();
+		const int formats[] = { DDS_SAVE_BC1, DDS_SAVE_BC3, DDS_SAVE_BC7 };
+		const int qualities[] = { DDS_SAVE_FAST, 0, DDS_SAVE_BEST };
+		for (int format : formats) {
+			for (int quality : qualities) {
+				FreeImage_SetThreadCount(1);
+				FIMEMORY *serial = FreeImage_OpenMemory();
+				FIBOOL bResult = FreeImage_SaveToMemory(FIF_DDS, src, serial, format | quality);
+				assert(bResult);
+				FreeImage_SetThreadCount(4);
+				FIMEMORY *parallel = FreeImage_OpenMemory();
+				bResult = FreeImage_SaveToMemory(FIF_DDS, src, parallel, format | quality);
+				assert(bResult);
+
+				uint8_t *serial_data = NULL, *parallel_data = NULL;
+				uint32_t serial_size = 0, parallel_size = 0;
+				FreeImage_AcquireMemory(serial, &serial_data, &serial_size);
+				FreeImage_AcquireMemory(parallel, &parallel_data, &parallel_size);
+				assert(serial_size == parallel_size && memcmp(serial_data, parallel_data, serial_size) == 0);
+
+				FreeImage_SeekMemory(parallel, 0, SEEK_SET);
+				FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_DDS, parallel, 0);
+				assert(loaded != NULL);
+				assert(FreeImage_GetWidth(loaded) == width && FreeImage_GetHeight(loaded) == height && FreeImage_GetBPP(loaded) == 32);
+				assert(meanError(src, loaded, 3) < 4);
+				if (format != DDS_SAVE_BC1) {
+					assert(meanError(src, loaded, 4) < 4);
+				}
+				FreeImage_Unload(loaded);
+				FreeImage_CloseMemory(parallel);
+				FreeImage_CloseMemory(serial);
+			}
+		}
+		FreeImage_SetThreadCount(thread_count);
+	}
+
+	// BC1 pixels with alpha < 128 are transparent
+	{
+		FIBITMAP *dib = FreeImage_Clone(src);
+		uint8_t *pixel = FreeImage_GetScanLine(dib, height - 1);
+		pixel[FI_RGBA_ALPHA] = 0;
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		FIBOOL bResult = FreeImage_SaveToMemory(FIF_DDS, dib, hmem, DDS_SAVE_BC1);
+		assert(bResult);
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_DDS, hmem, 0);
+		assert(loaded != NULL);
+		assert(FreeImage_GetScanLine(loaded, height - 1)[FI_RGBA_ALPHA] == 0);
+		assert(FreeImage_GetScanLine(loaded, height - 1)[4 + FI_RGBA_ALPHA] == 255);
+		FreeImage_Unload(loaded);
+		FreeImage_CloseMemory(hmem);
+		FreeImage_Unload(dib);
+	}
+
+	// the mipmap chain goes down to 1x1
+	{
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		FIBOOL bResult = FreeImage_SaveToMemory(FIF_DDS, src, hmem, DDS_SAVE_BC7 | DDS_SAVE_MIPMAPS);
+		assert(bResult);
+		const unsigned sizes[][2] = { { 35, 22 }, { 8, 5 }, { 2, 1 }, { 1, 1 } };
+		const int levels[] = { 1, 3, 5, 6 };
+		for (int i = 0; i < 4; i++) {
+			FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+			FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_DDS, hmem, DDS_MIPMAP(levels[i]));
+			assert(loaded != NULL);
+			assert(FreeImage_GetWidth(loaded) == sizes[i][0] && FreeImage_GetHeight(loaded) == sizes[i][1]);
+			FreeImage_Unload(loaded);
+		}
+		// the last level is 1x1, larger levels are clamped
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_DDS, hmem, DDS_MIPMAP(20));
+		assert(loaded != NULL && FreeImage_GetWidth(loaded) == 1 && FreeImage_GetHeight(loaded) == 1);
+		FreeImage_Unload(loaded);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	FreeImage_Unload(src);
+}
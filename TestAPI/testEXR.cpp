@@ -0,0 +1,336 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static FIBITMAP* makeRGBF(unsigned width, unsigned height) {
+	FIBITMAP *dib = FreeImage_AllocateT(FIT_RGBF, width, height);
+	assert(dib != NULL);
+	for (unsigned y = 0; y < height; y++) {
+		FIRGBF *bits = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < width; x++) {
+			// values exactly representable as half
+			bits[x].red = (float)(x % 256) / 64;
+			bits[x].green = (float)(y % 128) / 32;
+			bits[x].blue = (float)((x + y) % 64);
+		}
+	}
+	return dib;
+}
+
+static FIBITMAP* reloadEXR(FIBITMAP *dib, int save_flags) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_EXR, dib, hmem, save_flags);
+	assert(bResult);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_EXR, hmem, 0);
+	assert(loaded != NULL);
+	FreeImage_CloseMemory(hmem);
+	assert(FreeImage_GetImageType(loaded) == FIT_RGBF);
+	assert(FreeImage_GetWidth(loaded) == FreeImage_GetWidth(dib) && FreeImage_GetHeight(loaded) == FreeImage_GetHeight(dib));
+	return loaded;
+}
+
+static FIBOOL isSameImage(FIBITMAP *dib1, FIBITMAP *dib2) {
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if (memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), FreeImage_GetLine(dib1)) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static unsigned DLL_CALLCONV
+memReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_ReadMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static unsigned DLL_CALLCONV
+memWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return 0;
+}
+
+static int DLL_CALLCONV
+memSeekProc(fi_handle handle, long offset, int origin) {
+	return FreeImage_SeekMemory((FIMEMORY*)handle, offset, origin) ? 0 : -1;
+}
+
+static long DLL_CALLCONV
+memTellProc(fi_handle handle) {
+	return FreeImage_TellMemory((FIMEMORY*)handle);
+}
+
+static FIMEMORY* loadFileToMemory(const char *filename) {
+	FILE *file = fopen(filename, "rb");
+	assert(file != NULL);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	uint8_t buffer[4096];
+	size_t count;
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		FreeImage_WriteMemory(buffer, 1, (unsigned)count, hmem);
+	}
+	fclose(file);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	return hmem;
+}
+
+/**
+Check the pixels of mipmap.exr and ripmap.exr, uncompressed tiled HALF RGB files.
+The pixel (x, y) of the level (lx, ly) is R = x / 64, G = y / 64, B = lx * 8 + ly,
+with y counted from the top of the data window.
+*/
+static FIBOOL isLevelImage(FIBITMAP *dib, unsigned left, unsigned top, int lx, int ly) {
+	if (FreeImage_GetImageType(dib) != FIT_RGBF) {
+		return FALSE;
+	}
+	const unsigned height = FreeImage_GetHeight(dib);
+	for (unsigned y = 0; y < height; y++) {
+		const FIRGBF *bits = (FIRGBF*)FreeImage_GetScanLine(dib, height - 1 - y);
+		for (unsigned x = 0; x < FreeImage_GetWidth(dib); x++) {
+			if ((bits[x].red != (float)(left + x) / 64) || (bits[x].green != (float)(top + y) / 64) || (bits[x].blue != (float)(lx * 8 + ly))) {
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+// Main test function
+// ----------------------------------------------------------
+
+void testEXRCompression() {
+	printf("testEXRCompression ...\n");
+
+	const unsigned thread_count = FreeImage_GetThreadCount();
+
+	FIBITMAP *dib = makeRGBF(1024, 777);
+
+	// lossless compressions, line blocks encoded and decoded serially or on the OpenEXR thread pool
+	const int lossless[] = { EXR_NONE, EXR_ZIP, EXR_ZIPS, EXR_PIZ, EXR_FLOAT | EXR_ZIPS };
+	for (int save_flags : lossless) {
+		FreeImage_SetThreadCount(1);
+		FIBITMAP *serial = reloadEXR(dib, save_flags);
+		FreeImage_SetThreadCount(4);
+		FIBITMAP *parallel = reloadEXR(dib, save_flags);
+		assert(isSameImage(dib, serial));
+		assert(isSameImage(dib, parallel));
+		FreeImage_Unload(serial);
+		FreeImage_Unload(parallel);
+	}
+
+	// lossy compressions
+	const int lossy[] = { EXR_DWAA, EXR_DWAB, EXR_B44 };
+	for (int save_flags : lossy) {
+		FIBITMAP *loaded = reloadEXR(dib, save_flags);
+		FreeImage_Unload(loaded);
+	}
+
+	FreeImage_Unload(dib);
+	FreeImage_SetThreadCount(thread_count);
+}
+
+void testEXRHalf() {
+	printf("testEXRHalf ...\n");
+
+	FIBITMAP *dib = makeRGBF(333, 211);
+
+	// float <-> half round trip, the test values are exact in half precision
+	FIBITMAP *rgbah = FreeImage_ConvertToRGBAH(dib);
+	assert(rgbah != NULL && FreeImage_GetImageType(rgbah) == FIT_RGBAH);
+	assert(FreeImage_GetBPP(rgbah) == 64);
+	FIBITMAP *rgbf = FreeImage_ConvertToRGBF(rgbah);
+	assert(rgbf != NULL && isSameImage(dib, rgbf));
+	FreeImage_Unload(rgbf);
+
+	// scalar and SIMD kernels agree
+	FIBITMAP *halfs[2] = { NULL, NULL };
+	FIBITMAP *floats[2] = { NULL, NULL };
+	runScalarAndSIMD([&](bool vector) {
+		halfs[vector] = FreeImage_ConvertToRGBAH(dib);
+		floats[vector] = FreeImage_ConvertToRGBAF(rgbah);
+	});
+	assert(isSameImage(halfs[0], halfs[1]) && isSameImage(halfs[0], rgbah));
+	assert(isSameImage(floats[0], floats[1]));
+	for (int i = 0; i < 2; i++) {
+		FreeImage_Unload(halfs[i]);
+		FreeImage_Unload(floats[i]);
+	}
+
+	// HALF channels loaded without float expansion
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_EXR, dib, hmem, EXR_ZIP);
+	assert(bResult);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_EXR, hmem, EXR_HALF);
+	assert(loaded != NULL && FreeImage_GetImageType(loaded) == FIT_RGBAH);
+	assert(isSameImage(rgbah, loaded));
+	FreeImage_CloseMemory(hmem);
+
+	// FIT_RGBAH is saved as is
+	hmem = FreeImage_OpenMemory();
+	bResult = FreeImage_SaveToMemory(FIF_EXR, loaded, hmem, EXR_PIZ);
+	assert(bResult);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *reloaded = FreeImage_LoadFromMemory(FIF_EXR, hmem, EXR_HALF);
+	assert(reloaded != NULL && isSameImage(rgbah, reloaded));
+	FreeImage_Unload(reloaded);
+	FreeImage_CloseMemory(hmem);
+
+	// tone mapping
+	const FREE_IMAGE_TMO tmos[] = { FITMO_DRAGO03, FITMO_REINHARD05, FITMO_FATTAL02 };
+	for (FREE_IMAGE_TMO tmo : tmos) {
+		FIBITMAP *ldr = FreeImage_ToneMapping(loaded, tmo);
+		assert(ldr != NULL && FreeImage_GetBPP(ldr) == 24);
+		FreeImage_Unload(ldr);
+	}
+	FIBITMAP *clamped = FreeImage_TmoClamp(loaded);
+	assert(clamped != NULL && FreeImage_GetBPP(clamped) == 32);
+	FreeImage_Unload(clamped);
+
+	FreeImage_Unload(loaded);
+	FreeImage_Unload(rgbah);
+	FreeImage_Unload(dib);
+}
+
+void testEXRRegion() {
+	printf("testEXRRegion ...\n");
+
+	FIBITMAP *dib = makeRGBF(301, 257);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	// ZIP compresses blocks of 16 lines, the region doesn't start or end on a block
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_EXR, dib, hmem, EXR_ZIP);
+	assert(bResult);
+	assert(FreeImage_FIFSupportsFeature(FIF_EXR, FIFEATURE_REGION_LOAD));
+
+	FreeImageIO io;
+	io.read_proc = memReadProc;
+	io.write_proc = memWriteProc;
+	io.seek_proc = memSeekProc;
+	io.tell_proc = memTellProc;
+
+	const int left = 37, top = 21, right = 250, bottom = 99;
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *region = FreeImage_LoadRegion(FIF_EXR, &io, (fi_handle)hmem, left, top, right, bottom, 0);
+	assert(region != NULL && FreeImage_GetImageType(region) == FIT_RGBF);
+	FIBITMAP *crop = FreeImage_Copy(dib, left, top, right, bottom);
+	assert(FreeImage_GetWidth(region) == FreeImage_GetWidth(crop) && FreeImage_GetHeight(region) == FreeImage_GetHeight(crop));
+	assert(isSameImage(region, crop));
+	FreeImage_Unload(crop);
+	FreeImage_Unload(region);
+
+	// rectangles outside of the image
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	region = FreeImage_LoadRegion(FIF_EXR, &io, (fi_handle)hmem, 0, 0, 302, 10, 0);
+	assert(region == NULL);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+}
+
+void testEXRLevels() {
+	printf("testEXRLevels ...\n");
+
+	// 75x43 mipmap, levels rounded down
+	const unsigned mipmap_sizes[][2] = { { 75, 43 }, { 37, 21 }, { 18, 10 }, { 9, 5 }, { 4, 2 }, { 2, 1 }, { 1, 1 } };
+	for (int level = 0; level < 7; level++) {
+		FIBITMAP *dib = FreeImage_Load(FIF_EXR, "mipmap.exr", EXR_LEVEL(level));
+		assert(dib != NULL);
+		assert(FreeImage_GetWidth(dib) == mipmap_sizes[level][0] && FreeImage_GetHeight(dib) == mipmap_sizes[level][1]);
+		assert(isLevelImage(dib, 0, 0, level, level));
+		FreeImage_Unload(dib);
+	}
+
+	// levels past the last one are clamped
+	FIBITMAP *dib = FreeImage_Load(FIF_EXR, "mipmap.exr", EXR_LEVEL(20));
+	assert(dib != NULL && FreeImage_GetWidth(dib) == 1 && FreeImage_GetHeight(dib) == 1);
+	assert(isLevelImage(dib, 0, 0, 6, 6));
+	FreeImage_Unload(dib);
+
+	// 75x43 ripmap with 7 x 6 levels, EXR_LEVEL(n) loads the level (n, n), clamped per axis
+	dib = FreeImage_Load(FIF_EXR, "ripmap.exr", 0);
+	assert(dib != NULL && FreeImage_GetWidth(dib) == 75 && FreeImage_GetHeight(dib) == 43);
+	assert(isLevelImage(dib, 0, 0, 0, 0));
+	FreeImage_Unload(dib);
+	dib = FreeImage_Load(FIF_EXR, "ripmap.exr", EXR_LEVEL(2));
+	assert(dib != NULL && FreeImage_GetWidth(dib) == 18 && FreeImage_GetHeight(dib) == 10);
+	assert(isLevelImage(dib, 0, 0, 2, 2));
+	FreeImage_Unload(dib);
+	dib = FreeImage_Load(FIF_EXR, "ripmap.exr", EXR_LEVEL(6));
+	assert(dib != NULL && FreeImage_GetWidth(dib) == 1 && FreeImage_GetHeight(dib) == 1);
+	assert(isLevelImage(dib, 0, 0, 6, 5));
+	FreeImage_Unload(dib);
+
+	// scanline files have a single level
+	FIBITMAP *rgbf = makeRGBF(64, 32);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_EXR, rgbf, hmem, EXR_ZIP);
+	assert(bResult);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	dib = FreeImage_LoadFromMemory(FIF_EXR, hmem, EXR_LEVEL(2));
+	assert(dib != NULL && isSameImage(dib, rgbf));
+	FreeImage_Unload(dib);
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(rgbf);
+}
+
+void testEXRTiledRegion() {
+	printf("testEXRTiledRegion ...\n");
+
+	FreeImageIO io;
+	io.read_proc = memReadProc;
+	io.write_proc = memWriteProc;
+	io.seek_proc = memSeekProc;
+	io.tell_proc = memTellProc;
+
+	// 16x16 tiles, the rectangle doesn't start or end on a tile
+	FIMEMORY *hmem = loadFileToMemory("mipmap.exr");
+	FIBITMAP *region = FreeImage_LoadRegion(FIF_EXR, &io, (fi_handle)hmem, 5, 3, 60, 40, 0);
+	assert(region != NULL && FreeImage_GetWidth(region) == 55 && FreeImage_GetHeight(region) == 37);
+	assert(isLevelImage(region, 5, 3, 0, 0));
+	FreeImage_Unload(region);
+
+	// rectangle of a 37x21 level
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	region = FreeImage_LoadRegion(FIF_EXR, &io, (fi_handle)hmem, 3, 2, 30, 19, EXR_LEVEL(1));
+	assert(region != NULL && FreeImage_GetWidth(region) == 27 && FreeImage_GetHeight(region) == 17);
+	assert(isLevelImage(region, 3, 2, 1, 1));
+	FreeImage_Unload(region);
+
+	// rectangles outside of the level
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	region = FreeImage_LoadRegion(FIF_EXR, &io, (fi_handle)hmem, 0, 0, 38, 5, EXR_LEVEL(1));
+	assert(region == NULL);
+	FreeImage_CloseMemory(hmem);
+
+	// 16x8 tiles, coordinates relative to a data window starting at (-3, 5)
+	hmem = loadFileToMemory("ripmap.exr");
+	region = FreeImage_LoadRegion(FIF_EXR, &io, (fi_handle)hmem, 10, 4, 70, 40, 0);
+	assert(region != NULL && FreeImage_GetWidth(region) == 60 && FreeImage_GetHeight(region) == 36);
+	assert(isLevelImage(region, 10, 4, 0, 0));
+	FreeImage_Unload(region);
+	FreeImage_CloseMemory(hmem);
+}
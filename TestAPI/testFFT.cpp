@@ -0,0 +1,123 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <cmath>
+#include <complex>
+#include <memory>
+
+void testFFT2D()
+{
+	const double pi = 3.14159265358979323846;
+
+	// direct transform of a small image, width not a power of two
+	const unsigned width = 12, height = 8;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> samples(FreeImage_AllocateT(FIT_FLOAT, width, height), &::FreeImage_Unload);
+	assert(samples != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		auto line = reinterpret_cast<float*>(FreeImage_GetScanLine(samples.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			line[x] = (float)(std::sin(x * 0.7 + y * 0.3) + ((x * 5 + y * 3) % 7) * 0.1);
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> spectrum(FreeImage_FFT2D(samples.get()), &::FreeImage_Unload);
+	assert(spectrum != nullptr && FreeImage_GetImageType(spectrum.get()) == FIT_COMPLEXF);
+	for (unsigned l = 0; l < height; ++l) {
+		auto bin = reinterpret_cast<const FICOMPLEXF*>(FreeImage_GetScanLine(spectrum.get(), l));
+		for (unsigned k = 0; k < width; ++k) {
+			std::complex<double> expected;
+			for (unsigned y = 0; y < height; ++y) {
+				auto line = reinterpret_cast<const float*>(FreeImage_GetScanLine(samples.get(), y));
+				for (unsigned x = 0; x < width; ++x) {
+					expected += std::polar((double)line[x], -2 * pi * ((double)k * x / width + (double)l * y / height));
+				}
+			}
+			assert(std::abs(std::complex<double>(bin[k].r, bin[k].i) - expected) < 1e-4);
+		}
+	}
+
+	// round trip, scalar and vector butterflies, serial and parallel passes give the same bits
+	const unsigned size = 64;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> field(FreeImage_AllocateT(FIT_DOUBLE, size, size / 2), &::FreeImage_Unload);
+	for (unsigned y = 0; y < size / 2; ++y) {
+		auto line = reinterpret_cast<double*>(FreeImage_GetScanLine(field.get(), y));
+		for (unsigned x = 0; x < size; ++x) {
+			line[x] = std::cos(x * 0.11) * std::sin(y * 0.23) + ((x ^ y) & 3);
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> transforms[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+	runScalarAndSIMD([&](bool vector) {
+		transforms[vector].reset(FreeImage_FFT2D(field.get()));
+		assert(transforms[vector] != nullptr && FreeImage_GetImageType(transforms[vector].get()) == FIT_COMPLEX);
+	});
+	assert(isSameBitmap(transforms[0].get(), transforms[1].get()));
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> restored(FreeImage_IFFT2D(transforms[1].get()), &::FreeImage_Unload);
+	assert(restored != nullptr && FreeImage_GetImageType(restored.get()) == FIT_COMPLEX);
+	for (unsigned y = 0; y < size / 2; ++y) {
+		auto line = reinterpret_cast<const double*>(FreeImage_GetScanLine(field.get(), y));
+		auto value = reinterpret_cast<const FICOMPLEX*>(FreeImage_GetScanLine(restored.get(), y));
+		for (unsigned x = 0; x < size; ++x) {
+			assert(std::fabs(value[x].r - line[x]) < 1e-12 && std::fabs(value[x].i) < 1e-12);
+		}
+	}
+
+	// products of spectra are circular convolutions: a 3x3 box sums the neighbours of every pixel
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> box(FreeImage_AllocateT(FIT_DOUBLE, size, size / 2), &::FreeImage_Unload);
+	for (int dy = -1; dy <= 1; ++dy) {
+		for (int dx = -1; dx <= 1; ++dx) {
+			reinterpret_cast<double*>(FreeImage_GetScanLine(box.get(), (dy + size / 2) % (size / 2)))[(dx + size) % size] = 1;
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> boxSpectrum(FreeImage_FFT2D(box.get()), &::FreeImage_Unload);
+	for (unsigned y = 0; y < size / 2; ++y) {
+		auto a = reinterpret_cast<FICOMPLEX*>(FreeImage_GetScanLine(transforms[1].get(), y));
+		auto b = reinterpret_cast<const FICOMPLEX*>(FreeImage_GetScanLine(boxSpectrum.get(), y));
+		for (unsigned x = 0; x < size; ++x) {
+			const std::complex<double> product = std::complex<double>(a[x].r, a[x].i) * std::complex<double>(b[x].r, b[x].i);
+			a[x].r = product.real();
+			a[x].i = product.imag();
+		}
+	}
+	restored.reset(FreeImage_IFFT2D(transforms[1].get()));
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> real(FreeImage_GetComplexChannel(restored.get(), FICC_REAL), &::FreeImage_Unload);
+	assert(real != nullptr);
+	for (unsigned y = 0; y < size / 2; ++y) {
+		auto line = reinterpret_cast<const double*>(FreeImage_GetScanLine(real.get(), y));
+		for (unsigned x = 0; x < size; ++x) {
+			double expected = 0;
+			for (int dy = -1; dy <= 1; ++dy) {
+				auto source = reinterpret_cast<const double*>(FreeImage_GetScanLine(field.get(), (y + dy + size / 2) % (size / 2)));
+				for (int dx = -1; dx <= 1; ++dx) {
+					expected += source[(x + dx + size) % size];
+				}
+			}
+			assert(std::fabs(line[x] - expected) < 1e-9);
+		}
+	}
+
+	// unsupported images
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgb(FreeImage_Allocate(4, 4, 24), &::FreeImage_Unload);
+	assert(FreeImage_FFT2D(rgb.get()) == nullptr);
+	assert(FreeImage_IFFT2D(samples.get()) == nullptr);
+}
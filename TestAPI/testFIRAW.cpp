@@ -0,0 +1,118 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static bool isSameRaw(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if ((FreeImage_GetImageType(dib1) != FreeImage_GetImageType(dib2)) || (FreeImage_GetBPP(dib1) != FreeImage_GetBPP(dib2))) {
+		return false;
+	}
+	if ((FreeImage_GetWidth(dib1) != FreeImage_GetWidth(dib2)) || (FreeImage_GetHeight(dib1) != FreeImage_GetHeight(dib2))) {
+		return false;
+	}
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if (memcmp(FreeImage_GetConstScanLine(dib1, y), FreeImage_GetConstScanLine(dib2, y), FreeImage_GetLine(dib1)) != 0) {
+			return false;
+		}
+	}
+	if (FreeImage_GetColorsUsed(dib1) != FreeImage_GetColorsUsed(dib2)) {
+		return false;
+	}
+	if (FreeImage_GetPalette(dib1) && memcmp(FreeImage_GetPalette(dib1), FreeImage_GetPalette(dib2), FreeImage_GetColorsUsed(dib1) * sizeof(FIRGBA8)) != 0) {
+		return false;
+	}
+	return FreeImage_GetTransparencyCount(dib1) == FreeImage_GetTransparencyCount(dib2);
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testFIRAW() {
+	printf("testFIRAW ...\n");
+
+	// palette, transparency, ICC profile and metadata through a memory stream
+	FIBITMAP *dib = createZonePlateImage(301, 203, 64);
+	assert(dib != NULL && FreeImage_GetBPP(dib) == 8);
+	uint8_t table[4] = { 0, 64, 128, 255 };
+	FreeImage_SetTransparencyTable(dib, table, 4);
+	uint8_t profile[40] = { 1, 2, 3 };
+	assert(FreeImage_CreateICCProfile(dib, profile, sizeof(profile)) != NULL);
+	assert(FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, dib, "Comment", "raw"));
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(FIF_FIRAW, dib, hmem, 0));
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	assert(FreeImage_GetFileTypeFromMemory(hmem) == FIF_FIRAW);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_FIRAW, hmem, 0);
+	assert(loaded != NULL && isSameRaw(dib, loaded));
+	assert(FreeImage_GetICCProfile(loaded)->size == sizeof(profile));
+	FITAG *tag = NULL;
+	assert(FreeImage_GetMetadata(FIMD_COMMENTS, loaded, "Comment", &tag));
+	FreeImage_Unload(loaded);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *header = FreeImage_LoadFromMemory(FIF_FIRAW, hmem, FIF_LOAD_NOPIXELS);
+	assert(header != NULL && !FreeImage_HasPixels(header) && FreeImage_GetWidth(header) == 301);
+	FreeImage_Unload(header);
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+
+	// mapped files are used in place, written pixels are copied first
+	FIBITMAP *src = createZonePlateImage(257, 129, 64);
+	dib = FreeImage_ConvertTo24Bits(src);
+	FreeImage_Unload(src);
+	assert(dib != NULL);
+	assert(FreeImage_Save(FIF_FIRAW, dib, "raw.firaw", 0));
+	FIBITMAP *mapped = FreeImage_LoadMapped(FIF_FIRAW, "raw.firaw", 0);
+	assert(mapped != NULL && isSameRaw(dib, mapped));
+	FIBITMAP *clone = FreeImage_Clone(mapped);
+	assert(FreeImage_GetConstBits(clone) == FreeImage_GetConstBits(mapped));
+	memset(FreeImage_GetScanLine(mapped, 0), 0, FreeImage_GetLine(mapped));
+	assert(FreeImage_GetConstBits(clone) != FreeImage_GetConstBits(mapped));
+	FreeImage_Unload(mapped);
+	assert(isSameRaw(dib, clone));
+	FreeImage_Unload(clone);
+
+	FIBITMAP *reloaded = FreeImage_Load(FIF_FIRAW, "raw.firaw", 0);
+	assert(reloaded != NULL && isSameRaw(dib, reloaded));
+	FreeImage_Unload(reloaded);
+	FreeImage_Unload(dib);
+
+	// other image types
+	src = createZonePlateImage(33, 17, 64);
+	dib = FreeImage_ConvertToType(src, FIT_RGBAF);
+	FreeImage_Unload(src);
+	assert(dib != NULL);
+	hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(FIF_FIRAW, dib, hmem, 0));
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	loaded = FreeImage_LoadFromMemory(FIF_FIRAW, hmem, 0);
+	assert(loaded != NULL && isSameRaw(dib, loaded));
+	FreeImage_Unload(loaded);
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+}
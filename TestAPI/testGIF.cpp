@@ -0,0 +1,266 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+// palettized image with noise, long runs and repeated patterns
+static FIBITMAP* makePalettized(unsigned width, unsigned height, unsigned bpp) {
+	FIBITMAP *dib = FreeImage_Allocate(width, height, bpp);
+	assert(dib != NULL);
+	const unsigned colors = 1 << bpp;
+	unsigned seed = 1;
+	for (unsigned y = 0; y < height; y++) {
+		for (unsigned x = 0; x < width; x++) {
+			seed = seed * 1103515245 + 12345;
+			unsigned index;
+			if (y < height / 3) {
+				index = (seed >> 16) % colors;
+			} else if (y < 2 * height / 3) {
+				index = (x / 7) % colors;
+			} else {
+				index = 1;
+			}
+			FreeImage_SetPixelIndex(dib, x, y, (uint8_t*)&index);
+		}
+	}
+	return dib;
+}
+
+static void checkGIFRoundTrip(unsigned width, unsigned height, unsigned bpp) {
+	FIBITMAP *src = makePalettized(width, height, bpp);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_GIF, src, hmem, 0);
+	assert(bResult);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *dst = FreeImage_LoadFromMemory(FIF_GIF, hmem, 0);
+	assert(dst != NULL);
+	assert(FreeImage_GetWidth(dst) == width && FreeImage_GetHeight(dst) == height);
+
+	for (unsigned y = 0; y < height; y++) {
+		for (unsigned x = 0; x < width; x++) {
+			uint8_t a = 0, b = 0;
+			FreeImage_GetPixelIndex(src, x, y, &a);
+			FreeImage_GetPixelIndex(dst, x, y, &b);
+			assert(a == b);
+		}
+	}
+
+	FreeImage_Unload(dst);
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(src);
+}
+
+static void setAnimationTag(FIBITMAP *dib, const char *key, FREE_IMAGE_MDTYPE type, uint32_t length, const void *value) {
+	FITAG *tag = FreeImage_CreateTag();
+	FreeImage_SetTagKey(tag, key);
+	FreeImage_SetTagType(tag, type);
+	FreeImage_SetTagCount(tag, 1);
+	FreeImage_SetTagLength(tag, length);
+	FreeImage_SetTagValue(tag, value);
+	FreeImage_SetMetadata(FIMD_ANIMATION, dib, key, tag);
+	FreeImage_DeleteTag(tag);
+}
+
+// animation of small frames moving over the logical screen, using every disposal method
+static void makeAnimation(const char *lpszPathName, int frames) {
+	FIMULTIBITMAP *mbmp = FreeImage_OpenMultiBitmap(FIF_GIF, lpszPathName, TRUE, FALSE);
+	assert(mbmp != NULL);
+	for (int i = 0; i < frames; i++) {
+		const unsigned width = 16 + (i % 3) * 4, height = 12;
+		FIBITMAP *dib = FreeImage_Allocate(width, height, 8);
+		for (unsigned y = 0; y < height; y++) {
+			uint8_t *bits = FreeImage_GetScanLine(dib, y);
+			for (unsigned x = 0; x < width; x++) {
+				bits[x] = (uint8_t)((x + y + i) % 5 == 0 ? 0 : 1 + (x * 3 + y + i * 11) % 200);
+			}
+		}
+		if (i % 2) {
+			// index 0 is transparent
+			uint8_t table[256];
+			memset(table, 0xFF, sizeof(table));
+			table[0] = 0;
+			FreeImage_SetTransparencyTable(dib, table, 256);
+		}
+		if (i == 0) {
+			const uint16_t logicalwidth = 64, logicalheight = 48;
+			setAnimationTag(dib, "LogicalWidth", FIDT_SHORT, 2, &logicalwidth);
+			setAnimationTag(dib, "LogicalHeight", FIDT_SHORT, 2, &logicalheight);
+		}
+		const uint16_t left = (uint16_t)((i * 7) % 40), top = (uint16_t)((i * 5) % 30);
+		const uint8_t disposal = (uint8_t)((i + 1) % 4);
+		const int32_t frametime = 10 * (i + 1);
+		setAnimationTag(dib, "FrameLeft", FIDT_SHORT, 2, &left);
+		setAnimationTag(dib, "FrameTop", FIDT_SHORT, 2, &top);
+		setAnimationTag(dib, "DisposalMethod", FIDT_BYTE, 1, &disposal);
+		setAnimationTag(dib, "FrameTime", FIDT_LONG, 4, &frametime);
+		FreeImage_AppendPage(mbmp, dib);
+		FreeImage_Unload(dib);
+	}
+	FIBOOL bResult = FreeImage_CloseMultiBitmap(mbmp);
+	assert(bResult);
+}
+
+static void checkSameFrame(FIBITMAP *a, FIBITMAP *b) {
+	assert(FreeImage_GetWidth(a) == FreeImage_GetWidth(b) && FreeImage_GetHeight(a) == FreeImage_GetHeight(b));
+	for (unsigned y = 0; y < FreeImage_GetHeight(a); y++) {
+		assert(memcmp(FreeImage_GetScanLine(a, y), FreeImage_GetScanLine(b, y), FreeImage_GetLine(a)) == 0);
+	}
+	FITAG *ta = NULL, *tb = NULL;
+	FreeImage_GetMetadata(FIMD_ANIMATION, a, "FrameTime", &ta);
+	FreeImage_GetMetadata(FIMD_ANIMATION, b, "FrameTime", &tb);
+	assert(ta && tb && *(const int32_t*)FreeImage_GetTagValue(ta) == *(const int32_t*)FreeImage_GetTagValue(tb));
+}
+
+// Main test function
+// ----------------------------------------------------------
+
+void testGIFLZW() {
+	printf("testGIFLZW ...\n");
+
+	checkGIFRoundTrip(640, 480, 8);
+	checkGIFRoundTrip(301, 97, 4);
+	checkGIFRoundTrip(129, 33, 1);
+	// LZW strings much longer than a row
+	checkGIFRoundTrip(1, 4000, 8);
+	checkGIFRoundTrip(3, 2000, 4);
+}
+
+void testGIFPlayback() {
+	printf("testGIFPlayback ...\n");
+
+	const char *lpszPathName = "playback.gif";
+	const int frames = 70;
+	makeAnimation(lpszPathName, frames);
+
+	// reference frames, each played back from the first one with a new multipage bitmap
+	std::vector<FIBITMAP*> reference(frames);
+	for (int page = 0; page < frames; page++) {
+		FIMULTIBITMAP *mbmp = FreeImage_OpenMultiBitmap(FIF_GIF, lpszPathName, FALSE, TRUE, FALSE, GIF_PLAYBACK);
+		assert(mbmp != NULL);
+		FIBITMAP *dib = FreeImage_LockPage(mbmp, page);
+		assert(dib != NULL && FreeImage_GetBPP(dib) == 32);
+		reference[page] = FreeImage_Clone(dib);
+		FreeImage_UnlockPage(mbmp, dib, FALSE);
+		FreeImage_CloseMultiBitmap(mbmp);
+	}
+
+	// the same frames from the canvases cached by one multipage bitmap, in order, backwards and skipping around
+	FIMULTIBITMAP *mbmp = FreeImage_OpenMultiBitmap(FIF_GIF, lpszPathName, FALSE, TRUE, FALSE, GIF_PLAYBACK);
+	assert(mbmp != NULL);
+	assert(FreeImage_GetPageCount(mbmp) == frames);
+	std::vector<int> order;
+	for (int page = 0; page < frames; page++) {
+		order.push_back(page);
+	}
+	for (int page = frames - 1; page >= 0; page--) {
+		order.push_back(page);
+	}
+	for (int page = 0; page < frames; page++) {
+		order.push_back((page * 37) % frames);
+	}
+	for (int page : order) {
+		FIBITMAP *dib = FreeImage_LockPage(mbmp, page);
+		assert(dib != NULL);
+		checkSameFrame(reference[page], dib);
+		FreeImage_UnlockPage(mbmp, dib, FALSE);
+	}
+	FreeImage_CloseMultiBitmap(mbmp);
+
+	for (FIBITMAP *dib : reference) {
+		FreeImage_Unload(dib);
+	}
+}
+
+void testGIFEncoding() {
+	printf("testGIFEncoding ...\n");
+
+	const char *lpszPathName = "encoding.gif";
+	const int frames = 12;
+	makeAnimation(lpszPathName, frames);
+
+	// the played back frames are 32-bit canvases, quantized by the GIF encoder
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(FIF_GIF, lpszPathName, FALSE, TRUE, FALSE, GIF_PLAYBACK);
+	assert(src != NULL);
+
+	// the same file whether the frames are encoded in place or on the thread pool
+	const uint32_t thread_count = FreeImage_GetThreadCount();
+	FreeImage_SetThreadCount(1);
+	FIMEMORY *serial = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveMultiBitmapToMemory(FIF_GIF, src, serial, GIF_GLOBALPALETTE);
+	assert(bResult);
+	FreeImage_SetThreadCount(4);
+	FIMEMORY *parallel = FreeImage_OpenMemory();
+	bResult = FreeImage_SaveMultiBitmapToMemory(FIF_GIF, src, parallel, GIF_GLOBALPALETTE);
+	assert(bResult);
+	FreeImage_SetThreadCount(thread_count);
+
+	uint8_t *serial_data = NULL, *parallel_data = NULL;
+	uint32_t serial_size = 0, parallel_size = 0;
+	FreeImage_AcquireMemory(serial, &serial_data, &serial_size);
+	FreeImage_AcquireMemory(parallel, &parallel_data, &parallel_size);
+	assert(serial_size == parallel_size && memcmp(serial_data, parallel_data, serial_size) == 0);
+
+	// few colors are kept exactly, pixels of alpha < 128 become transparent
+	FreeImage_SeekMemory(parallel, 0, SEEK_SET);
+	FIMULTIBITMAP *dst = FreeImage_LoadMultiBitmapFromMemory(FIF_GIF, parallel, 0);
+	assert(dst != NULL);
+	assert(FreeImage_GetPageCount(dst) == frames);
+	for (int page = 0; page < frames; page++) {
+		FIBITMAP *canvas = FreeImage_LockPage(src, page);
+		FIBITMAP *frame = FreeImage_LockPage(dst, page);
+		assert(canvas != NULL && frame != NULL && FreeImage_GetBPP(frame) == 8);
+		if (page == 0) {
+			// the first frame's palette is the global one
+			FITAG *tag = NULL;
+			FreeImage_GetMetadata(FIMD_ANIMATION, frame, "NoLocalPalette", &tag);
+			assert(tag && *(const uint8_t*)FreeImage_GetTagValue(tag) == 1);
+		}
+		FIBITMAP *converted = FreeImage_ConvertTo32Bits(frame);
+		assert(FreeImage_GetWidth(converted) == FreeImage_GetWidth(canvas) && FreeImage_GetHeight(converted) == FreeImage_GetHeight(canvas));
+		for (unsigned y = 0; y < FreeImage_GetHeight(canvas); y++) {
+			const uint8_t *a = FreeImage_GetScanLine(canvas, y);
+			const uint8_t *b = FreeImage_GetScanLine(converted, y);
+			for (unsigned x = 0; x < FreeImage_GetWidth(canvas); x++, a += 4, b += 4) {
+				if (a[FI_RGBA_ALPHA] < 128) {
+					assert(b[FI_RGBA_ALPHA] == 0);
+				} else {
+					assert(b[FI_RGBA_ALPHA] == 0xFF && memcmp(a, b, 3) == 0);
+				}
+			}
+		}
+		FreeImage_Unload(converted);
+		FreeImage_UnlockPage(dst, frame, FALSE);
+		FreeImage_UnlockPage(src, canvas, FALSE);
+	}
+	FreeImage_CloseMultiBitmap(dst);
+	FreeImage_CloseMultiBitmap(src);
+
+	FreeImage_CloseMemory(parallel);
+	FreeImage_CloseMemory(serial);
+}
@@ -0,0 +1,131 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+#include <math.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static FIBITMAP* makeRGBF(unsigned width, unsigned height) {
+	FIBITMAP *dib = FreeImage_AllocateT(FIT_RGBF, width, height);
+	assert(dib != NULL);
+	for (unsigned y = 0; y < height; y++) {
+		FIRGBF *bits = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < width; x++) {
+			// runs, ramps over a wide dynamic range and black pixels
+			bits[x].red = (x / 16 % 2) ? 1.0F : (float)x / 8;
+			bits[x].green = (float)ldexp(1.0 + (y % 7) / 8.0, (int)(x % 40) - 20);
+			bits[x].blue = (x % 13 == 0) ? 0.0F : (float)(x + y) / 1024;
+		}
+	}
+	return dib;
+}
+
+static FIMEMORY* saveHDR(FIBITMAP *dib) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_HDR, dib, hmem, HDR_DEFAULT);
+	assert(bResult);
+	return hmem;
+}
+
+static FIBITMAP* loadHDR(FIMEMORY *hmem) {
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_HDR, hmem, HDR_DEFAULT);
+	assert(dib != NULL && FreeImage_GetImageType(dib) == FIT_RGBF);
+	return dib;
+}
+
+static FIBOOL isSameMemory(FIMEMORY *hmem1, FIMEMORY *hmem2) {
+	uint8_t *data1 = NULL, *data2 = NULL;
+	uint32_t size1 = 0, size2 = 0;
+	FreeImage_AcquireMemory(hmem1, &data1, &size1);
+	FreeImage_AcquireMemory(hmem2, &data2, &size2);
+	return (size1 == size2) && (memcmp(data1, data2, size1) == 0);
+}
+
+static FIBOOL isSameImage(FIBITMAP *dib1, FIBITMAP *dib2) {
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if (memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), FreeImage_GetLine(dib1)) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+Each channel is stored with 8 bits of mantissa relative to the largest channel of its pixel
+*/
+static FIBOOL isCloseImage(FIBITMAP *dib1, FIBITMAP *dib2) {
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		const FIRGBF *bits1 = (FIRGBF*)FreeImage_GetScanLine(dib1, y);
+		const FIRGBF *bits2 = (FIRGBF*)FreeImage_GetScanLine(dib2, y);
+		for (unsigned x = 0; x < FreeImage_GetWidth(dib1); x++) {
+			const float max = std::max(bits1[x].red, std::max(bits1[x].green, bits1[x].blue));
+			if ((fabs(bits1[x].red - bits2[x].red) > max / 128) || (fabs(bits1[x].green - bits2[x].green) > max / 128) || (fabs(bits1[x].blue - bits2[x].blue) > max / 128)) {
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+// Main test function
+// ----------------------------------------------------------
+
+void testHDR() {
+	printf("testHDR ...\n");
+
+	// run length encoded scanlines, scanlines too short or too long to be run length encoded
+	const unsigned sizes[][2] = { { 1027, 333 }, { 5, 9 }, { 40000, 3 } };
+	for (const auto& size : sizes) {
+		FIBITMAP *dib = makeRGBF(size[0], size[1]);
+
+		// serial and parallel scanlines, scalar and SIMD conversions give the same files and images
+		FIMEMORY *streams[2] = { NULL, NULL };
+		FIBITMAP *dibs[2] = { NULL, NULL };
+		runScalarAndSIMD([&](bool vector) {
+			streams[vector] = saveHDR(dib);
+			dibs[vector] = loadHDR(streams[vector]);
+		});
+		FIMEMORY *serial = streams[0], *parallel = streams[1];
+		FIBITMAP *serial_dib = dibs[0], *parallel_dib = dibs[1];
+		assert(isSameMemory(serial, parallel));
+		assert(isSameImage(serial_dib, parallel_dib));
+		assert(isCloseImage(dib, parallel_dib));
+
+		// streams which are not in memory are read by chunks
+		FIBOOL bResult = FreeImage_Save(FIF_HDR, dib, "test.hdr", HDR_DEFAULT);
+		assert(bResult);
+		FIBITMAP *file_dib = FreeImage_Load(FIF_HDR, "test.hdr", HDR_DEFAULT);
+		assert(file_dib != NULL && isSameImage(serial_dib, file_dib));
+
+		FreeImage_Unload(file_dib);
+		FreeImage_Unload(serial_dib);
+		FreeImage_Unload(parallel_dib);
+		FreeImage_CloseMemory(serial);
+		FreeImage_CloseMemory(parallel);
+		FreeImage_Unload(dib);
+	}
+}
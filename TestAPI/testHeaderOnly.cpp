@@ -21,6 +21,7 @@
 
 
 #include "TestSuite.h"
+#include <string.h>
 
 // Local test functions
 // ----------------------------------------------------------
@@ -66,6 +67,30 @@ FIBOOL testHeader(const char *lpszPathName) {
 	return FALSE; 
 }
 
+/**
+Save a bitmap to memory and load it back without pixels
+*/
+static FIBOOL testHeaderMemory(FREE_IMAGE_FORMAT fif, unsigned width, unsigned height, unsigned bpp) {
+	FIBOOL bResult = FALSE;
+
+	FIBITMAP *src = FreeImage_Allocate(width, height, bpp);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	if (src && hmem && FreeImage_SaveToMemory(fif, src, hmem, 0)) {
+		assert(FreeImage_FIFSupportsNoPixels(fif) == TRUE);
+
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *dib = FreeImage_LoadFromMemory(fif, hmem, FIF_LOAD_NOPIXELS);
+		if (dib) {
+			bResult = !FreeImage_HasPixels(dib) && (FreeImage_GetWidth(dib) == width) && (FreeImage_GetHeight(dib) == height) && (FreeImage_GetBPP(dib) == bpp);
+			FreeImage_Unload(dib);
+		}
+	}
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(src);
+
+	return bResult;
+}
+
 /**
 Parse metadata attached to a dib
 */
@@ -236,6 +261,13 @@ void testHeaderOnly() {
 	bResult = testHeaderData(src_file_png);
 	assert(bResult);
 
+	// GIF and WBMP plugins
+	bResult = testHeaderMemory(FIF_GIF, 37, 21, 8);
+	assert(bResult);
+
+	bResult = testHeaderMemory(FIF_WBMP, 37, 21, 1);
+	assert(bResult);
+
 	// you cannot save 'header only' FIBITMAP
 	bResult = testExifRawFile(src_file_jpg, FIF_LOAD_NOPIXELS, 0);
 	assert(bResult == FALSE);
@@ -255,3 +287,221 @@ void testExifRaw() {
 	assert(bResult);
 
 }
+
+// ----------------------------------------------------------
+
+/**
+Returns TRUE if a metadata model holds the same tags in two bitmaps
+*/
+static FIBOOL 
+sameMetadataModel(FREE_IMAGE_MDMODEL model, FIBITMAP *dib1, FIBITMAP *dib2) {
+	if (FreeImage_GetMetadataCount(model, dib1) != FreeImage_GetMetadataCount(model, dib2)) {
+		return FALSE;
+	}
+	FITAG *tag = NULL;
+	FIMETADATA *mdhandle = FreeImage_FindFirstMetadata(model, dib1, &tag);
+	if (mdhandle) {
+		do {
+			FITAG *other = NULL;
+			if (!FreeImage_GetMetadata(model, dib2, FreeImage_GetTagKey(tag), &other)) {
+				FreeImage_FindCloseMetadata(mdhandle);
+				return FALSE;
+			}
+			if ((FreeImage_GetTagLength(tag) != FreeImage_GetTagLength(other)) || (memcmp(FreeImage_GetTagValue(tag), FreeImage_GetTagValue(other), FreeImage_GetTagLength(tag)) != 0)) {
+				FreeImage_FindCloseMetadata(mdhandle);
+				return FALSE;
+			}
+		} while (FreeImage_FindNextMetadata(mdhandle, &tag));
+		FreeImage_FindCloseMetadata(mdhandle);
+	}
+	return TRUE;
+}
+
+/**
+Exif tags are parsed model by model on first access, 
+loading with FIF_LOAD_NOMETADATA skips them
+*/
+void testExifDeferred() {
+	const char *src_file_jpg = "exif.jpg";
+	const FREE_IMAGE_MDMODEL models[] = { FIMD_EXIF_MAIN, FIMD_EXIF_EXIF, FIMD_EXIF_GPS, FIMD_EXIF_MAKERNOTE, FIMD_EXIF_INTEROP };
+	const unsigned model_count = sizeof(models) / sizeof(models[0]);
+
+	printf("testExifDeferred ...\n");
+
+	// the models are accessed in opposite orders
+	FIBITMAP *dib1 = FreeImage_Load(FIF_JPEG, src_file_jpg, 0);
+	FIBITMAP *dib2 = FreeImage_Load(FIF_JPEG, src_file_jpg, 0);
+	assert(dib1 && dib2);
+
+	unsigned counts[model_count] = { 0 };
+	for (unsigned i = 0; i < model_count; i++) {
+		counts[i] = FreeImage_GetMetadataCount(models[i], dib1);
+	}
+	assert(counts[0] > 0);
+	assert(counts[2] > 0);
+
+	// a clone shares the models not parsed yet
+	FIBITMAP *clone = FreeImage_Clone(dib2);
+	assert(clone);
+	for (unsigned i = model_count; i > 0; i--) {
+		assert(FreeImage_GetMetadataCount(models[i - 1], dib2) == counts[i - 1]);
+		assert(sameMetadataModel(models[i - 1], dib1, dib2));
+	}
+
+	// a modification stays private to the clone
+	FreeImage_SetMetadataKeyValue(FIMD_EXIF_MAIN, clone, "Software", "testExifDeferred");
+	FreeImage_SetMetadata(FIMD_EXIF_GPS, clone, NULL, NULL);
+	assert(FreeImage_GetMetadataCount(FIMD_EXIF_GPS, clone) == 0);
+	assert(FreeImage_GetMetadataCount(FIMD_EXIF_GPS, dib2) == counts[2]);
+	assert(sameMetadataModel(FIMD_EXIF_EXIF, dib1, clone));
+	FITAG *tag = NULL;
+	FreeImage_GetMetadata(FIMD_EXIF_MAIN, dib2, "Software", &tag);
+	assert(!tag || (strcmp((const char*)FreeImage_GetTagValue(tag), "testExifDeferred") != 0));
+
+	FreeImage_Unload(clone);
+	FreeImage_Unload(dib2);
+	FreeImage_Unload(dib1);
+
+	// skip metadata, keep the pixels
+	FIBITMAP *dib = FreeImage_Load(FIF_JPEG, src_file_jpg, FIF_LOAD_NOMETADATA);
+	assert(dib && FreeImage_HasPixels(dib));
+	for (unsigned i = 0; i < model_count; i++) {
+		assert(FreeImage_GetMetadataCount(models[i], dib) == 0);
+	}
+	assert(FreeImage_GetMetadataCount(FIMD_EXIF_RAW, dib) == 0);
+	assert(FreeImage_GetMetadataCount(FIMD_COMMENTS, dib) == 0);
+	FreeImage_Unload(dib);
+}
+
+void testLoadOptions() {
+	const char *src_file_jpg = "exif.jpg";
+
+	printf("testLoadOptions ...\n");
+
+	FIBITMAP *full = FreeImage_Load(FIF_JPEG, src_file_jpg, 0);
+	assert(full);
+	assert(FreeImage_GetMetadataCount(FIMD_EXIF_EXIF, full) > 0);
+	assert(FreeImage_GetMetadataCount(FIMD_EXIF_GPS, full) > 0);
+
+	// orientation and ICC profile only
+	FILOADOPTIONS options = { 0, FIMD_MASK(FIMD_EXIF_MAIN) | FIMD_MASK_ICC };
+	FIBITMAP *dib = FreeImage_LoadEx(FIF_JPEG, src_file_jpg, &options);
+	assert(dib && FreeImage_HasPixels(dib));
+	assert(sameMetadataModel(FIMD_EXIF_MAIN, full, dib));
+	assert(FreeImage_GetExifOrientation(dib) == FreeImage_GetExifOrientation(full));
+	assert(FreeImage_GetICCProfile(dib)->size == FreeImage_GetICCProfile(full)->size);
+	for (int model = FIMD_COMMENTS; model <= FIMD_EXIF_RAW; model++) {
+		if (model != FIMD_EXIF_MAIN) {
+			assert(FreeImage_GetMetadataCount((FREE_IMAGE_MDMODEL)model, dib) == 0);
+		}
+	}
+	FreeImage_Unload(dib);
+
+	// a header only load without GPS tags
+	options.flags = FIF_LOAD_NOPIXELS;
+	options.metadata_models = FIMD_MASK_ALL & ~FIMD_MASK(FIMD_EXIF_GPS);
+	dib = FreeImage_LoadEx(FIF_JPEG, src_file_jpg, &options);
+	assert(dib && !FreeImage_HasPixels(dib));
+	assert(FreeImage_GetMetadataCount(FIMD_EXIF_GPS, dib) == 0);
+	assert(sameMetadataModel(FIMD_EXIF_EXIF, full, dib));
+	FreeImage_Unload(dib);
+
+	// no options, everything is loaded
+	dib = FreeImage_LoadEx(FIF_JPEG, src_file_jpg, NULL);
+	assert(dib && sameMetadataModel(FIMD_EXIF_GPS, full, dib));
+	FreeImage_Unload(dib);
+
+	FreeImage_Unload(full);
+}
+
+/**
+Returns the payload of the first APP13 marker of a JPEG stream, NULL if there is none
+*/
+static const uint8_t*
+findAPP13(FIMEMORY *stream, unsigned *length) {
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	FreeImage_AcquireMemory(stream, &data, &size);
+	for (uint32_t pos = 2; (pos + 4 <= size) && (data[pos] == 0xFF); ) {
+		const unsigned segment = (data[pos + 2] << 8) | data[pos + 3];
+		if (data[pos + 1] == 0xED) {
+			*length = segment - 2;
+			return data + pos + 4;
+		}
+		if (data[pos + 1] == 0xDA) {
+			break;
+		}
+		pos += 2 + segment;
+	}
+	return NULL;
+}
+
+void testIPTCPassthrough() {
+	printf("testIPTCPassthrough ...\n");
+
+	// Photoshop image resources : a resolution info resource the IPTC reader ignores, then the IPTC block
+	static const uint8_t iptc[] = {
+		0x1C, 0x02, 0x00, 0x00, 0x02, 0x00, 0x04,							// ApplicationRecordVersion
+		0x1C, 0x02, 0x78, 0x00, 0x07, 'c', 'a', 'p', 't', 'i', 'o', 'n'		// Caption-Abstract
+	};
+	uint8_t app13[128];
+	unsigned app13_length = 0;
+	memcpy(app13, "Photoshop 3.0\0" "8BIM\x03\xED\0\0\0\0\0\x10", 26);
+	memset(app13 + 26, 0x11, 16);
+	memcpy(app13 + 42, "8BIM\x04\x04\0\0\0\0\0", 11);
+	app13[53] = sizeof(iptc);
+	memcpy(app13 + 54, iptc, sizeof(iptc));
+	app13_length = 54 + sizeof(iptc);
+	app13[app13_length++] = 0;
+
+	// insert the marker after the SOI marker of a saved image
+	FIBITMAP *src = FreeImage_Allocate(16, 16, 24);
+	FIMEMORY *plain = FreeImage_OpenMemory();
+	assert(src && FreeImage_SaveToMemory(FIF_JPEG, src, plain, 0));
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	FreeImage_AcquireMemory(plain, &data, &size);
+	FIMEMORY *tagged = FreeImage_OpenMemory();
+	const uint8_t header[4] = { 0xFF, 0xED, (uint8_t)((app13_length + 2) >> 8), (uint8_t)(app13_length + 2) };
+	FreeImage_WriteMemory(data, 2, 1, tagged);
+	FreeImage_WriteMemory(header, 4, 1, tagged);
+	FreeImage_WriteMemory(app13, app13_length, 1, tagged);
+	FreeImage_WriteMemory(data + 2, size - 2, 1, tagged);
+	FreeImage_CloseMemory(plain);
+	FreeImage_Unload(src);
+
+	FreeImage_SeekMemory(tagged, 0, SEEK_SET);
+	FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_JPEG, tagged, 0);
+	assert(dib && (FreeImage_GetMetadataCount(FIMD_IPTC, dib) == 2));
+	FreeImage_CloseMemory(tagged);
+
+	// unmodified tags are saved as read, by the bitmap and its clones
+	FIBITMAP *clone = FreeImage_Clone(dib);
+	FIBITMAP *sources[] = { dib, clone };
+	for (FIBITMAP *source : sources) {
+		FIMEMORY *saved = FreeImage_OpenMemory();
+		assert(FreeImage_SaveToMemory(FIF_JPEG, source, saved, 0));
+		unsigned length = 0;
+		const uint8_t *marker = findAPP13(saved, &length);
+		assert(marker && (length == app13_length) && (memcmp(marker, app13, app13_length) == 0));
+		FreeImage_CloseMemory(saved);
+	}
+
+	// modified tags are encoded again
+	assert(FreeImage_SetMetadataKeyValue(FIMD_IPTC, clone, "Caption-Abstract", "modified"));
+	FIMEMORY *saved = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(FIF_JPEG, clone, saved, 0));
+	unsigned length = 0;
+	const uint8_t *marker = findAPP13(saved, &length);
+	assert(marker && ((length != app13_length) || (memcmp(marker, app13, app13_length) != 0)));
+	FreeImage_SeekMemory(saved, 0, SEEK_SET);
+	FIBITMAP *reloaded = FreeImage_LoadFromMemory(FIF_JPEG, saved, 0);
+	FITAG *tag = NULL;
+	assert(reloaded && FreeImage_GetMetadata(FIMD_IPTC, reloaded, "Caption-Abstract", &tag));
+	assert(strcmp((const char*)FreeImage_GetTagValue(tag), "modified") == 0);
+	FreeImage_Unload(reloaded);
+	FreeImage_CloseMemory(saved);
+
+	FreeImage_Unload(clone);
+	FreeImage_Unload(dib);
+}
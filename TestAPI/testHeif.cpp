@@ -23,6 +23,7 @@
 #include "TestSuite.h"
 #include <memory>
 #include <iostream>
+#include <cstring>
 
 // Local test functions
 // ----------------------------------------------------------
@@ -42,3 +43,105 @@ void testHeif(FREE_IMAGE_FORMAT fif, const char* src_path, const char* dst_path)
 	const bool success = FreeImage_Save(fif, img_heic.get(), dst_path);
 	assert(success);
 }
+
+// memory IO over a FIMEMORY
+static unsigned DLL_CALLCONV memReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_ReadMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static unsigned DLL_CALLCONV memWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return 0;
+}
+
+static int DLL_CALLCONV memSeekProc(fi_handle handle, long offset, int origin) {
+	return FreeImage_SeekMemory((FIMEMORY*)handle, offset, origin) ? 0 : -1;
+}
+
+static long DLL_CALLCONV memTellProc(fi_handle handle) {
+	return FreeImage_TellMemory((FIMEMORY*)handle);
+}
+
+void testHeifRegion(FREE_IMAGE_FORMAT fif, const char* src_path)
+{
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> full{ FreeImage_Load(fif, src_path, 0), &::FreeImage_Unload };
+	assert(full != nullptr);
+	const int width = (int)FreeImage_GetWidth(full.get());
+	const int height = (int)FreeImage_GetHeight(full.get());
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FILE *file = fopen(src_path, "rb");
+	assert(file != nullptr);
+	uint8_t buffer[4096];
+	for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0; ) {
+		FreeImage_WriteMemory(buffer, 1, (unsigned)n, hmem);
+	}
+	fclose(file);
+
+	FreeImageIO io;
+	io.read_proc = memReadProc;
+	io.write_proc = memWriteProc;
+	io.seek_proc = memSeekProc;
+	io.tell_proc = memTellProc;
+
+	// tiles decoded on their own give the same pixels as the whole image
+	const int left = width / 3 + 1, top = height / 4 + 1, right = width - 2, bottom = height / 2 + 3;
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> region{ FreeImage_LoadRegion(fif, &io, (fi_handle)hmem, left, top, right, bottom, 0), &::FreeImage_Unload };
+	assert(region != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> crop{ FreeImage_Copy(full.get(), left, top, right, bottom), &::FreeImage_Unload };
+	assert(crop != nullptr);
+	assert(FreeImage_GetWidth(region.get()) == FreeImage_GetWidth(crop.get()) && FreeImage_GetHeight(region.get()) == FreeImage_GetHeight(crop.get()));
+	assert(FreeImage_GetBPP(region.get()) == FreeImage_GetBPP(crop.get()));
+	for (unsigned y = 0; y < FreeImage_GetHeight(crop.get()); y++) {
+		assert(memcmp(FreeImage_GetScanLine(region.get(), y), FreeImage_GetScanLine(crop.get(), y), FreeImage_GetLine(crop.get())) == 0);
+	}
+
+	// rectangles outside of the image
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	region.reset(FreeImage_LoadRegion(fif, &io, (fi_handle)hmem, 0, 0, width + 1, height, 0));
+	assert(region == nullptr);
+
+	FreeImage_CloseMemory(hmem);
+}
+
+void testHeifPreview(FREE_IMAGE_FORMAT fif, const char* src_path)
+{
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> full{ FreeImage_Load(fif, src_path, 0), &::FreeImage_Unload };
+	assert(full != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> preview{ FreeImage_Load(fif, src_path, HEIF_PREVIEW), &::FreeImage_Unload };
+	assert(preview != nullptr);
+
+	// the preview is the embedded thumbnail, or the image itself when there is none
+	FIBITMAP *thumbnail = FreeImage_GetThumbnail(full.get());
+	FIBITMAP *expected = thumbnail ? thumbnail : full.get();
+	assert(FreeImage_GetWidth(preview.get()) == FreeImage_GetWidth(expected));
+	assert(FreeImage_GetHeight(preview.get()) == FreeImage_GetHeight(expected));
+	assert(FreeImage_GetThumbnail(preview.get()) == nullptr || !thumbnail);
+	std::cout << "Test HEIF preview " << fif << ", size = " << FreeImage_GetWidth(preview.get()) << "x" << FreeImage_GetHeight(preview.get()) << std::endl;
+}
+
+void testHeifOptions(FREE_IMAGE_FORMAT fif, const char* src_path)
+{
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src{ FreeImage_Load(fif, src_path, 0), &::FreeImage_Unload };
+	assert(src != nullptr);
+
+	const int options[] = {
+		HEIF_DEFAULT,
+		50 | HEIF_SPEED(9),
+		90 | HEIF_SPEED(0) | HEIF_CHROMA_444,
+		HEIF_SPEED(9) | HEIF_CHROMA_422,
+		HEIF_LOSSLESS | HEIF_SPEED(9)
+	};
+	for (int flags : options) {
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		const FIBOOL success = FreeImage_SaveToMemory(fif, src.get(), hmem, flags);
+		assert(success);
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst{ FreeImage_LoadFromMemory(fif, hmem, 0), &::FreeImage_Unload };
+		assert(dst != nullptr);
+		assert(FreeImage_GetWidth(dst.get()) == FreeImage_GetWidth(src.get()) && FreeImage_GetHeight(dst.get()) == FreeImage_GetHeight(src.get()));
+		FreeImage_SeekMemory(hmem, 0, SEEK_END);
+		std::cout << "Test HEIF options " << fif << ", flags = 0x" << std::hex << flags << std::dec << ", size = " << FreeImage_TellMemory(hmem) << std::endl;
+		FreeImage_CloseMemory(hmem);
+	}
+}
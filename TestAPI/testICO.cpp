@@ -0,0 +1,83 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+
+// Local test functions
+// ----------------------------------------------------------
+
+static void appendIcon(FIMULTIBITMAP *mbitmap, unsigned size, unsigned bpp) {
+	FIBITMAP *dib = FreeImage_Allocate(size, size, bpp);
+	assert(dib != NULL);
+	if (bpp == 8) {
+		FIRGBA8 *pal = FreeImage_GetPalette(dib);
+		for (unsigned i = 0; i < 256; i++) {
+			pal[i].red = pal[i].green = pal[i].blue = (uint8_t)i;
+		}
+	}
+	FreeImage_AppendPage(mbitmap, dib);
+	FreeImage_Unload(dib);
+}
+
+static void checkBestFit(const char *lpszPathName, int flags, unsigned size, unsigned bpp) {
+	FIBITMAP *dib = FreeImage_Load(FIF_ICO, lpszPathName, flags);
+	assert(dib != NULL);
+	assert(FreeImage_GetWidth(dib) == size && FreeImage_GetHeight(dib) == size && FreeImage_GetBPP(dib) == bpp);
+	FreeImage_Unload(dib);
+}
+
+// Main test function
+// ----------------------------------------------------------
+
+void testICOBestFit() {
+	const char *lpszPathName = "best_fit.ico";
+
+	printf("testICOBestFit ...\n");
+
+	FIMULTIBITMAP *mbitmap = FreeImage_OpenMultiBitmap(FIF_ICO, lpszPathName, TRUE, FALSE, FALSE);
+	assert(mbitmap != NULL);
+	appendIcon(mbitmap, 16, 8);
+	appendIcon(mbitmap, 32, 8);
+	appendIcon(mbitmap, 32, 32);
+	appendIcon(mbitmap, 48, 24);
+	FreeImage_CloseMultiBitmap(mbitmap, 0);
+
+	// the smallest icon at least as large as the requested size, with the highest bit depth
+	checkBestFit(lpszPathName, ICO_LOAD_BEST_FIT | ICO_SIZE(16), 16, 8);
+	checkBestFit(lpszPathName, ICO_LOAD_BEST_FIT | ICO_SIZE(20), 32, 32);
+	checkBestFit(lpszPathName, ICO_LOAD_BEST_FIT | ICO_SIZE(40), 48, 24);
+	checkBestFit(lpszPathName, ICO_LOAD_BEST_FIT | ICO_SIZE(16) | FIF_LOAD_NOPIXELS, 16, 8);
+
+	// else the largest icon
+	checkBestFit(lpszPathName, ICO_LOAD_BEST_FIT | ICO_SIZE(100), 48, 24);
+	checkBestFit(lpszPathName, ICO_LOAD_BEST_FIT, 48, 24);
+
+	// the first page without the flag
+	checkBestFit(lpszPathName, ICO_DEFAULT, 16, 8);
+
+	// FreeImage_LoadScaled rescales the best fitting icon
+	FIBITMAP *scaled = FreeImage_LoadScaled(FIF_ICO, lpszPathName, 24, 24, 0);
+	assert(scaled != NULL);
+	assert(FreeImage_GetWidth(scaled) == 24 && FreeImage_GetHeight(scaled) == 24 && FreeImage_GetBPP(scaled) == 32);
+	FreeImage_Unload(scaled);
+}
@@ -0,0 +1,224 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+
+// Local test functions
+// ----------------------------------------------------------
+
+static unsigned DLL_CALLCONV
+memReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_ReadMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static unsigned DLL_CALLCONV
+memWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_WriteMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static int DLL_CALLCONV
+memSeekProc(fi_handle handle, long offset, int origin) {
+	return FreeImage_SeekMemory((FIMEMORY*)handle, offset, origin) ? 0 : -1;
+}
+
+static long DLL_CALLCONV
+memTellProc(fi_handle handle) {
+	return FreeImage_TellMemory((FIMEMORY*)handle);
+}
+
+/**
+Probe an image stored in memory, then check the info against a header only load
+*/
+static void checkImageInfo(FREE_IMAGE_FORMAT fif, FIMEMORY *hmem) {
+	FreeImageIO io;
+	io.read_proc = memReadProc;
+	io.write_proc = memWriteProc;
+	io.seek_proc = memSeekProc;
+	io.tell_proc = memTellProc;
+
+	FIIMAGEINFO info;
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBOOL bResult = FreeImage_GetImageInfo(fif, &io, (fi_handle)hmem, &info);
+	assert(bResult);
+	// the stream position is restored
+	assert(FreeImage_TellMemory(hmem) == 0);
+
+	FIBITMAP *dib = FreeImage_LoadFromMemory(fif, hmem, FIF_LOAD_NOPIXELS);
+	assert(dib != NULL);
+	assert(info.width == FreeImage_GetWidth(dib));
+	assert(info.height == FreeImage_GetHeight(dib));
+	assert(info.bpp == FreeImage_GetBPP(dib));
+	assert(info.image_type == FreeImage_GetImageType(dib));
+	assert(info.page_count == 1);
+	assert(info.has_icc_profile == (FreeImage_GetICCProfile(dib)->size != 0));
+	assert(!info.has_alpha || (info.bpp == 32) || FreeImage_IsTransparent(dib));
+
+	FITAG *tag = NULL;
+	if (FreeImage_GetMetadata(FIMD_EXIF_MAIN, dib, "Orientation", &tag)) {
+		assert(info.orientation == *(uint16_t*)FreeImage_GetTagValue(tag));
+	}
+	FreeImage_Unload(dib);
+}
+
+static void testImageInfoFile(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFilename(lpszPathName);
+
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+
+	// probe the file itself
+	FILE *file = fopen(lpszPathName, "rb");
+	assert(file != NULL);
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	uint8_t *buffer = (uint8_t*)malloc(size);
+	assert(buffer != NULL);
+	fread(buffer, size, 1, file);
+	fclose(file);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory(buffer, size);
+	checkImageInfo(fif, hmem);
+	FreeImage_CloseMemory(hmem);
+	free(buffer);
+
+	// probe the image saved as BMP and as GIF (header only load fallback)
+	hmem = FreeImage_OpenMemory();
+	FreeImage_SaveToMemory(FIF_BMP, dib, hmem, 0);
+	checkImageInfo(FIF_BMP, hmem);
+	FreeImage_CloseMemory(hmem);
+
+	FIBITMAP *dib8 = FreeImage_ConvertTo8Bits(dib);
+	hmem = FreeImage_OpenMemory();
+	FreeImage_SaveToMemory(FIF_GIF, dib8, hmem, 0);
+	checkImageInfo(FIF_GIF, hmem);
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib8);
+
+	FIBITMAP *dib32 = FreeImage_ConvertTo32Bits(dib);
+	hmem = FreeImage_OpenMemory();
+	FreeImage_SaveToMemory(FIF_BMP, dib32, hmem, 0);
+	checkImageInfo(FIF_BMP, hmem);
+	FreeImage_CloseMemory(hmem);
+
+	hmem = FreeImage_OpenMemory();
+	FreeImage_SaveToMemory(FIF_PNG, dib32, hmem, 0);
+	checkImageInfo(FIF_PNG, hmem);
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib32);
+
+	FreeImage_Unload(dib);
+}
+
+/**
+Estimate the cost of loading an image saved with save_flags
+*/
+static FIDECODECOST estimateSavedImage(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, int save_flags, int load_flags) {
+	FreeImageIO io;
+	io.read_proc = memReadProc;
+	io.write_proc = memWriteProc;
+	io.seek_proc = memSeekProc;
+	io.tell_proc = memTellProc;
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(fif, dib, hmem, save_flags));
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+
+	FIDECODECOST cost;
+	FIBOOL bResult = FreeImage_EstimateDecodeCost(fif, &io, (fi_handle)hmem, load_flags, &cost);
+	assert(bResult);
+	// the stream position is restored
+	assert(FreeImage_TellMemory(hmem) == 0);
+	FreeImage_CloseMemory(hmem);
+	return cost;
+}
+
+static void testDecodeCost() {
+	FIBITMAP *dib = createZonePlateImage(512, 384, 64);
+	assert(dib != NULL);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib);
+	assert(dib24 != NULL);
+	const uint64_t bitmap_bytes = (uint64_t)FreeImage_GetPitch(dib24) * FreeImage_GetHeight(dib24);
+
+	// uncompressed formats cost about their size
+	FIDECODECOST bmp = estimateSavedImage(FIF_BMP, dib24, 0, 0);
+	assert(bmp.pixels == 512 * 384);
+	assert(bmp.bitmap_bytes == bitmap_bytes);
+	assert(bmp.memory_bytes == bitmap_bytes);
+	assert(bmp.cpu_cost >= bitmap_bytes);
+
+	// interlaced images cost more than sequential ones
+	FIDECODECOST png = estimateSavedImage(FIF_PNG, dib24, 0, 0);
+	FIDECODECOST png_interlaced = estimateSavedImage(FIF_PNG, dib24, PNG_INTERLACED, 0);
+	assert(!png.info.interlaced && png_interlaced.info.interlaced);
+	assert(png_interlaced.cpu_cost > png.cpu_cost);
+	assert(png.cpu_cost > bmp.cpu_cost);
+
+	// progressive JPEG keeps the coefficients of the whole image
+	FIDECODECOST jpeg = estimateSavedImage(FIF_JPEG, dib24, 0, 0);
+	FIDECODECOST jpeg_progressive = estimateSavedImage(FIF_JPEG, dib24, JPEG_PROGRESSIVE, 0);
+	assert(!jpeg.info.interlaced && jpeg_progressive.info.interlaced);
+	assert(jpeg.memory_bytes == bitmap_bytes);
+	assert(jpeg_progressive.memory_bytes > jpeg.memory_bytes);
+
+#if FREEIMAGE_WITH_LIBTIFF
+	// tiles are reported
+	FIDECODECOST tiff = estimateSavedImage(FIF_TIFF, dib24, 0, 0);
+	FIDECODECOST tiff_tiled = estimateSavedImage(FIF_TIFF, dib24, TIFF_TILED, 0);
+	assert((tiff.info.tile_width == 0) && (tiff.info.tile_height == 0));
+	assert((tiff_tiled.info.tile_width == 256) && (tiff_tiled.info.tile_height == 256));
+	assert(tiff_tiled.info.width == 512 && tiff_tiled.info.page_count == 1);
+#endif
+
+	// a header only load decodes nothing
+	FIDECODECOST header = estimateSavedImage(FIF_PNG, dib24, 0, FIF_LOAD_NOPIXELS);
+	assert(header.pixels == 0 && header.memory_bytes == 0);
+
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib);
+}
+
+// Main test function
+// ----------------------------------------------------------
+
+void testImageInfo() {
+	printf("testImageInfo ...\n");
+
+	testImageInfoFile("exif.jpg");
+	testImageInfoFile("sample.png");
+
+	// unknown or invalid data can't be probed
+	uint8_t garbage[64] = { 0 };
+	FIMEMORY *hmem = FreeImage_OpenMemory(garbage, sizeof(garbage));
+	FreeImageIO io;
+	io.read_proc = memReadProc;
+	io.write_proc = memWriteProc;
+	io.seek_proc = memSeekProc;
+	io.tell_proc = memTellProc;
+	FIIMAGEINFO info;
+	assert(!FreeImage_GetImageInfo(FIF_PNG, &io, (fi_handle)hmem, &info));
+	assert(!FreeImage_GetImageInfo(FIF_JPEG, &io, (fi_handle)hmem, &info));
+	FreeImage_CloseMemory(hmem);
+
+	testDecodeCost();
+}
@@ -21,6 +21,10 @@
 
 
 #include "TestSuite.h"
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <memory>
 
 // Local test functions
 // ----------------------------------------------------------
@@ -496,3 +500,49 @@ void testImageTypeTIFF(unsigned width, unsigned height) {
 	FreeImage_Unload(src);
 
 }
+
+void testConvertTypeKernels()
+{
+	// widths leave scalar tails after the vector blocks
+	const unsigned width = 333, height = 97;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> ushorts(FreeImage_AllocateT(FIT_UINT16, width, height), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> shorts(FreeImage_AllocateT(FIT_INT16, width, height), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> floats(FreeImage_AllocateT(FIT_FLOAT, width, height), &::FreeImage_Unload);
+	assert(ushorts && shorts && floats);
+	for (unsigned y = 0; y < height; ++y) {
+		auto u = reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(ushorts.get(), y));
+		auto s = reinterpret_cast<int16_t*>(FreeImage_GetScanLine(shorts.get(), y));
+		auto f = reinterpret_cast<float*>(FreeImage_GetScanLine(floats.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			u[x] = static_cast<uint16_t>(1000 + (x * 977 + y * 131) % 40000);
+			s[x] = static_cast<int16_t>(static_cast<int>((x * 977 + y * 131) % 50000) - 25000);
+			f[x] = 300.0f * std::sin(0.01f * x * y) - 0.25f * x;
+		}
+	}
+
+	for (FIBITMAP *src : { ushorts.get(), shorts.get(), floats.get() }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2][3] = {
+			{ { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } },
+			{ { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } }
+		};
+		runScalarAndSIMD([&](bool vector) {
+			results[vector][0].reset(FreeImage_ConvertToStandardType(src, TRUE));
+			results[vector][1].reset(FreeImage_ConvertToStandardType(src, FALSE));
+			results[vector][2].reset(FreeImage_ConvertToType(src, FIT_FLOAT));
+		});
+		for (int i = 0; i < 3; ++i) {
+			assert(results[0][i] && results[1][i]);
+			assert(isSameBitmap(results[0][i].get(), results[1][i].get()));
+		}
+	}
+
+	// linear scaling reaches both ends of the byte range
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scaled(FreeImage_ConvertToStandardType(floats.get(), TRUE), &::FreeImage_Unload);
+	uint8_t lo = 255, hi = 0;
+	for (unsigned y = 0; y < height; ++y) {
+		const uint8_t *bits = FreeImage_GetScanLine(scaled.get(), y);
+		lo = std::min(lo, *std::min_element(bits, bits + width));
+		hi = std::max(hi, *std::max_element(bits, bits + width));
+	}
+	assert(lo == 0 && hi == 255);
+}
@@ -0,0 +1,73 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+
+// Main test function
+// ----------------------------------------------------------
+
+void testJNG() {
+	printf("testJNG ...\n");
+
+	// JPEG color with a PNG alpha layer, stored as several JDAT and IDAT chunks
+	const unsigned width = 613, height = 411;
+	FIBITMAP *dib = FreeImage_Allocate(width, height, 32);
+	assert(dib != NULL);
+	for (unsigned y = 0; y < height; y++) {
+		FIRGBA8 *bits = (FIRGBA8*)FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < width; x++) {
+			bits[x].red = (uint8_t)(x + y);
+			bits[x].green = (uint8_t)(x * 3);
+			bits[x].blue = (uint8_t)(y * 5);
+			bits[x].alpha = (uint8_t)((x * 7) ^ (y * 13));
+		}
+	}
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_JNG, dib, hmem, JPEG_QUALITYSUPERB);
+	assert(bResult);
+
+	// the chunks are decoded from the stream, the lossless alpha layer is unchanged
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_JNG, hmem, 0);
+	assert(loaded != NULL);
+	assert(FreeImage_GetWidth(loaded) == width && FreeImage_GetHeight(loaded) == height && FreeImage_GetBPP(loaded) == 32);
+	for (unsigned y = 0; y < height; y++) {
+		const FIRGBA8 *src = (const FIRGBA8*)FreeImage_GetScanLine(dib, y);
+		const FIRGBA8 *dst = (const FIRGBA8*)FreeImage_GetScanLine(loaded, y);
+		for (unsigned x = 0; x < width; x++) {
+			assert(src[x].alpha == dst[x].alpha);
+		}
+	}
+	FreeImage_Unload(loaded);
+
+	// header only
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	loaded = FreeImage_LoadFromMemory(FIF_JNG, hmem, FIF_LOAD_NOPIXELS);
+	assert(loaded != NULL);
+	assert(FreeImage_GetWidth(loaded) == width && FreeImage_GetHeight(loaded) == height);
+	FreeImage_Unload(loaded);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+}
@@ -21,6 +21,7 @@
 
 
 #include "TestSuite.h"
+#include <cstring>
 
 // Local test functions
 // ----------------------------------------------------------
@@ -194,6 +195,466 @@ void testJPEGSameFile(const char *src_file) {
 	assert(bResult);
 }
 
+static double meanDiff(FIBITMAP *dib1, FIBITMAP *dib2) {
+	double sum = 0;
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		const uint8_t *a = FreeImage_GetScanLine(dib1, y);
+		const uint8_t *b = FreeImage_GetScanLine(dib2, y);
+		for (unsigned x = 0; x < FreeImage_GetWidth(dib1) * 3; x++) {
+			sum += abs((int)a[x] - (int)b[x]);
+		}
+	}
+	return sum / ((double)FreeImage_GetWidth(dib1) * FreeImage_GetHeight(dib1) * 3);
+}
+
+static unsigned DLL_CALLCONV
+memReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_ReadMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static unsigned DLL_CALLCONV
+memWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_WriteMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static int DLL_CALLCONV
+memSeekProc(fi_handle handle, long offset, int origin) {
+	return FreeImage_SeekMemory((FIMEMORY*)handle, offset, origin) ? 0 : -1;
+}
+
+static long DLL_CALLCONV
+memTellProc(fi_handle handle) {
+	return FreeImage_TellMemory((FIMEMORY*)handle);
+}
+
+static FIBITMAP* reloadJPEG(FIMEMORY *hmem) {
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_JPEG, hmem, 0);
+	assert(dib != NULL);
+	return dib;
+}
+
+void testJPEGSaveYUV(const char *src_file) {
+	FIBOOL bResult;
+
+	// odd sizes pad the last DCT blocks
+	FIBITMAP *image = FreeImage_Load(FIF_JPEG, src_file, 0);
+	assert(image != NULL);
+	FIBITMAP *rgb = FreeImage_Copy(image, 0, 0, FreeImage_GetWidth(image) / 2 + 1, FreeImage_GetHeight(image) / 2 + 1);
+	assert(rgb != NULL);
+	FreeImage_Unload(image);
+	const unsigned width = FreeImage_GetWidth(rgb);
+	const unsigned height = FreeImage_GetHeight(rgb);
+
+	// YUV bitmaps are compressed from the YCbCr samples
+	FIBITMAP *yuv = FreeImage_ConvertToColor(rgb, FIC_YUV);
+	assert(yuv != NULL && FreeImage_GetColorType(yuv) == FIC_YUV);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	bResult = FreeImage_SaveToMemory(FIF_JPEG, yuv, hmem, JPEG_QUALITYSUPERB | JPEG_SUBSAMPLING_444);
+	assert(bResult);
+	FIBITMAP *check = reloadJPEG(hmem);
+	assert(FreeImage_GetColorType(check) == FIC_RGB);
+	assert(meanDiff(rgb, check) < 2);
+	FreeImage_Unload(check);
+	FreeImage_CloseMemory(hmem);
+
+	// 4:2:0 planes, the chroma averaged over 2x2 pixels
+	const unsigned chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+	uint8_t *luma = (uint8_t*)malloc(width * height);
+	uint8_t *cb = (uint8_t*)malloc(chroma_width * chroma_height);
+	uint8_t *cr = (uint8_t*)malloc(chroma_width * chroma_height);
+	assert(luma && cb && cr);
+	for (unsigned y = 0; y < height; y++) {
+		const uint8_t *src = FreeImage_GetScanLine(yuv, height - 1 - y);
+		for (unsigned x = 0; x < width; x++) {
+			luma[y * width + x] = ((const FIRGB8*)src)[x].red;
+		}
+	}
+	for (unsigned y = 0; y < chroma_height; y++) {
+		for (unsigned x = 0; x < chroma_width; x++) {
+			unsigned sum_cb = 0, sum_cr = 0;
+			for (unsigned i = 0; i < 4; i++) {
+				const unsigned sx = (2 * x + (i & 1) < width) ? 2 * x + (i & 1) : width - 1;
+				const unsigned sy = (2 * y + (i >> 1) < height) ? 2 * y + (i >> 1) : height - 1;
+				const FIRGB8 *src = (const FIRGB8*)FreeImage_GetScanLine(yuv, height - 1 - sy) + sx;
+				sum_cb += src->green;
+				sum_cr += src->blue;
+			}
+			cb[y * chroma_width + x] = (uint8_t)((sum_cb + 2) / 4);
+			cr[y * chroma_width + x] = (uint8_t)((sum_cr + 2) / 4);
+		}
+	}
+	const uint8_t *planes[3] = { luma, cb, cr };
+	const unsigned pitches[3] = { width, chroma_width, chroma_width };
+
+	FreeImageIO io;
+	io.read_proc = memReadProc;
+	io.write_proc = memWriteProc;
+	io.seek_proc = memSeekProc;
+	io.tell_proc = memTellProc;
+	hmem = FreeImage_OpenMemory();
+	bResult = FreeImage_SaveJPEGPlanes(&io, (fi_handle)hmem, width, height, planes, pitches, JPEG_QUALITYSUPERB);
+	assert(bResult);
+	check = reloadJPEG(hmem);
+	assert(FreeImage_GetWidth(check) == width && FreeImage_GetHeight(check) == height);
+	assert(meanDiff(rgb, check) < 4);
+	FreeImage_Unload(check);
+	FreeImage_CloseMemory(hmem);
+
+	// too small pitches are rejected
+	const unsigned bad_pitches[3] = { width, chroma_width - 1, chroma_width };
+	hmem = FreeImage_OpenMemory();
+	bResult = FreeImage_SaveJPEGPlanes(&io, (fi_handle)hmem, width, height, planes, bad_pitches, 0);
+	assert(!bResult);
+	FreeImage_CloseMemory(hmem);
+
+	free(luma);
+	free(cb);
+	free(cr);
+	FreeImage_Unload(yuv);
+	FreeImage_Unload(rgb);
+}
+
+static FIMEMORY* loadFileToMemory(const char *filename) {
+	FILE *file = fopen(filename, "rb");
+	assert(file != NULL);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	uint8_t buffer[4096];
+	size_t count;
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		FreeImage_WriteMemory(buffer, 1, (unsigned)count, hmem);
+	}
+	fclose(file);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	return hmem;
+}
+
+/**
+Overwrites the Orientation tag of the Exif segment of a JPEG held in memory (Intel byte order)
+*/
+static FIBOOL setExifOrientation(FIMEMORY *hmem, unsigned orientation) {
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	FreeImage_AcquireMemory(hmem, &data, &size);
+	for (uint32_t i = 0; i + 14 < size; i++) {
+		if (memcmp(data + i, "Exif\0\0II", 8) != 0) {
+			continue;
+		}
+		uint8_t *tiff = data + i + 6;
+		const uint32_t ifd = tiff[4] | (tiff[5] << 8) | (tiff[6] << 16) | ((uint32_t)tiff[7] << 24);
+		const unsigned count = tiff[ifd] | (tiff[ifd + 1] << 8);
+		for (unsigned n = 0; n < count; n++) {
+			uint8_t *entry = tiff + ifd + 2 + 12 * n;
+			if ((entry[0] | (entry[1] << 8)) == 0x0112) {
+				entry[8] = (uint8_t)orientation;
+				entry[9] = 0;
+				return TRUE;
+			}
+		}
+	}
+	return FALSE;
+}
+
+void testJPEGBatch(const char *src_file) {
+	FIMEMORY *src = loadFileToMemory(src_file);
+	FIBITMAP *dib = reloadJPEG(src);
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	FreeImage_Unload(dib);
+
+	// the same operation on several streams, a broken one doesn't stop the others
+	uint8_t garbage[256];
+	memset(garbage, 0x55, sizeof(garbage));
+	FIMEMORY *src_streams[4] = { src, FreeImage_OpenMemory(garbage, sizeof(garbage)), loadFileToMemory(src_file), loadFileToMemory(src_file) };
+	FIMEMORY *dst_streams[4];
+	for (unsigned i = 0; i < 4; i++) {
+		FreeImage_SeekMemory(src_streams[i], 0, SEEK_SET);
+		dst_streams[i] = FreeImage_OpenMemory();
+	}
+	FIBOOL results[4];
+	const unsigned transformed = FreeImage_JPEGTransformBatch(src_streams, dst_streams, 4, FIJPEG_OP_ROTATE_90, FALSE, results);
+	assert(transformed == 3);
+	assert(results[0] && !results[1] && results[2] && results[3]);
+	for (unsigned i = 0; i < 4; i++) {
+		if (results[i]) {
+			FIBITMAP *check = reloadJPEG(dst_streams[i]);
+			assert(FreeImage_GetHeight(check) == width);
+			assert(FreeImage_GetWidth(check) <= height && FreeImage_GetWidth(check) + 16 > height);
+			FreeImage_Unload(check);
+		}
+		FreeImage_CloseMemory(src_streams[i]);
+		FreeImage_CloseMemory(dst_streams[i]);
+	}
+}
+
+void testJPEGExifOrient(const char *src_file) {
+	FIBOOL bResult;
+
+	// orientation 6: the image must be rotated 90 degrees clockwise
+	FIMEMORY *src = loadFileToMemory(src_file);
+	bResult = setExifOrientation(src, 6);
+	assert(bResult);
+	FIBITMAP *rotated = FreeImage_LoadFromMemory(FIF_JPEG, src, JPEG_EXIFROTATE);
+	assert(rotated != NULL);
+
+	FIMEMORY *dst = FreeImage_OpenMemory();
+	FreeImage_SeekMemory(src, 0, SEEK_SET);
+	bResult = FreeImage_JPEGTransformCombinedFromMemory(src, dst, FIJPEG_OP_EXIF_ORIENT, NULL, NULL, NULL, NULL, FALSE);
+	assert(bResult);
+	FIBITMAP *check = reloadJPEG(dst);
+	assert(FreeImage_GetHeight(check) == FreeImage_GetHeight(rotated));
+	assert(FreeImage_GetWidth(check) <= FreeImage_GetWidth(rotated) && FreeImage_GetWidth(check) + 16 > FreeImage_GetWidth(rotated));
+
+	// the orientation is reset, loading with JPEG_EXIFROTATE doesn't rotate again
+	FITAG *tag = NULL;
+	bResult = FreeImage_GetMetadata(FIMD_EXIF_MAIN, check, "Orientation", &tag);
+	assert(bResult && *(const uint16_t*)FreeImage_GetTagValue(tag) == 1);
+	FreeImage_Unload(check);
+	FreeImage_SeekMemory(dst, 0, SEEK_SET);
+	check = FreeImage_LoadFromMemory(FIF_JPEG, dst, JPEG_EXIFROTATE);
+	assert(check != NULL && FreeImage_GetHeight(check) == FreeImage_GetHeight(rotated));
+	FreeImage_Unload(check);
+	FreeImage_CloseMemory(dst);
+
+	// top-left images are copied as they are
+	setExifOrientation(src, 1);
+	FreeImage_SeekMemory(src, 0, SEEK_SET);
+	dst = FreeImage_OpenMemory();
+	bResult = FreeImage_JPEGTransformCombinedFromMemory(src, dst, FIJPEG_OP_EXIF_ORIENT, NULL, NULL, NULL, NULL, TRUE);
+	assert(bResult);
+	check = reloadJPEG(dst);
+	assert(FreeImage_GetWidth(check) == FreeImage_GetHeight(rotated) && FreeImage_GetHeight(check) == FreeImage_GetWidth(rotated));
+	FreeImage_Unload(check);
+	FreeImage_CloseMemory(dst);
+
+	FreeImage_Unload(rotated);
+	FreeImage_CloseMemory(src);
+}
+
+void testJPEGLoadDC(const char *src_file) {
+	FIBITMAP *full = FreeImage_Load(FIF_JPEG, src_file, JPEG_ACCURATE);
+	assert(full != NULL);
+	FIBITMAP *preview = FreeImage_JPEGLoadDC(src_file);
+	assert(preview != NULL && FreeImage_GetBPP(preview) == 24);
+	const unsigned width = FreeImage_GetWidth(full);
+	const unsigned height = FreeImage_GetHeight(full);
+	assert(FreeImage_GetWidth(preview) == (width + 7) / 8 && FreeImage_GetHeight(preview) == (height + 7) / 8);
+
+	// each preview pixel is close to the average of its 8x8 block
+	double sum = 0;
+	unsigned samples = 0;
+	for (unsigned by = 0; by < height / 8; by++) {
+		const uint8_t *p = FreeImage_GetScanLine(preview, FreeImage_GetHeight(preview) - 1 - by);
+		for (unsigned bx = 0; bx < width / 8; bx++) {
+			for (unsigned c = 0; c < 3; c++) {
+				unsigned block = 0;
+				for (unsigned y = 0; y < 8; y++) {
+					const uint8_t *bits = FreeImage_GetScanLine(full, height - 1 - (by * 8 + y));
+					for (unsigned x = 0; x < 8; x++) {
+						block += bits[(bx * 8 + x) * 3 + c];
+					}
+				}
+				sum += abs((int)p[bx * 3 + c] - (int)((block + 32) / 64));
+				samples++;
+			}
+		}
+	}
+	assert(sum / samples < 4);
+	FreeImage_Unload(preview);
+	FreeImage_Unload(full);
+
+	// from memory, garbage is rejected
+	FIMEMORY *hmem = loadFileToMemory(src_file);
+	preview = FreeImage_JPEGLoadDCFromMemory(hmem);
+	assert(preview != NULL);
+	FreeImage_Unload(preview);
+	FreeImage_CloseMemory(hmem);
+	uint8_t garbage[64] = { 0 };
+	hmem = FreeImage_OpenMemory(garbage, sizeof(garbage));
+	assert(FreeImage_JPEGLoadDCFromMemory(hmem) == NULL);
+	FreeImage_CloseMemory(hmem);
+}
+
+void testJPEGFastThumbnail(const char *src_file) {
+	FIBOOL bResult;
+
+	FIBITMAP *full = FreeImage_Load(FIF_JPEG, src_file, 0);
+	assert(full != NULL);
+	const unsigned width = FreeImage_GetWidth(full);
+	const unsigned height = FreeImage_GetHeight(full);
+	const unsigned size = (width > height) ? width : height;
+
+	// 1/2, 1/4 and 1/8 scales, close to a box filtered reduction
+	FIMEMORY *src = loadFileToMemory(src_file);
+	for (unsigned scale = 2; scale <= 8; scale *= 2) {
+		const int max_size = (int)(size / scale);
+		FIMEMORY *dst = FreeImage_OpenMemory();
+		FreeImage_SeekMemory(src, 0, SEEK_SET);
+		bResult = FreeImage_JPEGFastThumbnailFromMemory(src, dst, max_size);
+		assert(bResult);
+		FIBITMAP *thumbnail = reloadJPEG(dst);
+		assert(FreeImage_GetWidth(thumbnail) == (width + scale - 1) / scale);
+		assert(FreeImage_GetHeight(thumbnail) == (height + scale - 1) / scale);
+		FIBITMAP *reference = FreeImage_Rescale(full, FreeImage_GetWidth(thumbnail), FreeImage_GetHeight(thumbnail), FILTER_BOX);
+		// the thumbnail is encoded again, its quantization error grows as the image gets smaller
+		assert(meanDiff(reference, thumbnail) < ((scale < 8) ? 6 : 8));
+		FreeImage_Unload(reference);
+		FreeImage_Unload(thumbnail);
+		FreeImage_CloseMemory(dst);
+	}
+
+	// images fitting the size are copied
+	FIMEMORY *dst = FreeImage_OpenMemory();
+	FreeImage_SeekMemory(src, 0, SEEK_SET);
+	bResult = FreeImage_JPEGFastThumbnailFromMemory(src, dst, (int)size);
+	assert(bResult);
+	FIBITMAP *thumbnail = reloadJPEG(dst);
+	assert(FreeImage_GetWidth(thumbnail) == width && FreeImage_GetHeight(thumbnail) == height);
+	FreeImage_Unload(thumbnail);
+	FreeImage_CloseMemory(dst);
+
+	// files, the source cannot be overwritten
+	bResult = FreeImage_JPEGFastThumbnail(src_file, "test.jpg", 64);
+	assert(bResult);
+	bResult = FreeImage_JPEGFastThumbnail("test.jpg", "test.jpg", 64);
+	assert(!bResult);
+
+	FreeImage_CloseMemory(src);
+	FreeImage_Unload(full);
+}
+
+void testJPEGScaledLoad(const char *src_file) {
+	FIBITMAP *full = FreeImage_Load(FIF_JPEG, src_file, 0);
+	assert(full != NULL);
+	const unsigned width = FreeImage_GetWidth(full);
+	const unsigned height = FreeImage_GetHeight(full);
+	const unsigned size = (width > height) ? width : height;
+
+	// the requested size, in the upper 16 flag bits, selects the smallest M/8 scaling covering it
+	const unsigned requests[] = { size / 8, size / 5, size / 3, size / 2, (size * 3) / 4, size - 1 };
+	for (const unsigned requested : requests) {
+		unsigned num = 1;
+		while ((size * num + 7) / 8 < requested) {
+			num++;
+		}
+		FIBITMAP *scaled = FreeImage_Load(FIF_JPEG, src_file, (int)(requested << 16));
+		assert(scaled != NULL);
+		assert(FreeImage_GetWidth(scaled) == (width * num + 7) / 8);
+		assert(FreeImage_GetHeight(scaled) == (height * num + 7) / 8);
+
+		// the original size is kept in the comments
+		FITAG *tag = NULL;
+		assert(FreeImage_GetMetadata(FIMD_COMMENTS, scaled, "OriginalJPEGWidth", &tag) == (num != 8));
+
+		// scaled in the DCT domain, close to a box filtered reduction
+		FIBITMAP *reference = FreeImage_Rescale(full, FreeImage_GetWidth(scaled), FreeImage_GetHeight(scaled), FILTER_BOX);
+		assert(meanDiff(reference, scaled) < 6);
+		FreeImage_Unload(reference);
+		FreeImage_Unload(scaled);
+	}
+
+	FreeImage_Unload(full);
+}
+
+void testJPEGParallel(const char *src_file) {
+	FIBOOL bResult;
+
+	// large enough for several bands of MCU rows
+	FIBITMAP *full = FreeImage_Load(FIF_JPEG, src_file, 0);
+	assert(full != NULL);
+	FIBITMAP *dib = FreeImage_Rescale(full, FreeImage_GetWidth(full) * 2, FreeImage_GetHeight(full) * 2, FILTER_BILINEAR);
+	assert(dib != NULL);
+
+	const uint32_t threads = FreeImage_GetThreadCount();
+	FreeImage_SetThreadCount(4);
+
+	FreeImageIO io = { memReadProc, memWriteProc, memSeekProc, memTellProc };
+
+	// the bands decode to the pixels of a serial save
+	const int flags[] = { 0, JPEG_OPTIMIZE, JPEG_SUBSAMPLING_444 | JPEG_QUALITYSUPERB };
+	for (int f : flags) {
+		FIMEMORY *serial = FreeImage_OpenMemory();
+		bResult = FreeImage_SaveToMemory(FIF_JPEG, dib, serial, f);
+		assert(bResult);
+		FIMEMORY *parallel = FreeImage_OpenMemory();
+		bResult = FreeImage_SaveToMemory(FIF_JPEG, dib, parallel, f | JPEG_PARALLEL);
+		assert(bResult);
+
+		FIBITMAP *a = reloadJPEG(serial);
+		FIBITMAP *b = reloadJPEG(parallel);
+		assert(meanDiff(a, b) == 0);
+		FreeImage_Unload(a);
+		FreeImage_Unload(b);
+		FreeImage_CloseMemory(serial);
+		FreeImage_CloseMemory(parallel);
+	}
+
+	// tables of a sample code other images, serially or in bands
+	FIJPEGTABLES *tables = FreeImage_CreateJPEGTables(full, JPEG_QUALITYGOOD);
+	assert(tables != NULL);
+	const int table_flags[] = { JPEG_QUALITYGOOD, JPEG_QUALITYGOOD | JPEG_PARALLEL };
+	for (int f : table_flags) {
+		FIMEMORY *reference = FreeImage_OpenMemory();
+		bResult = FreeImage_SaveToMemory(FIF_JPEG, dib, reference, JPEG_QUALITYGOOD);
+		assert(bResult);
+		FIMEMORY *shared = FreeImage_OpenMemory();
+		bResult = FreeImage_SaveJPEGWithTables(dib, &io, (fi_handle)shared, tables, f);
+		assert(bResult);
+
+		FIBITMAP *a = reloadJPEG(reference);
+		FIBITMAP *b = reloadJPEG(shared);
+		assert(meanDiff(a, b) == 0);
+		FreeImage_Unload(a);
+		FreeImage_Unload(b);
+		FreeImage_CloseMemory(reference);
+		FreeImage_CloseMemory(shared);
+	}
+	FreeImage_DeleteJPEGTables(tables);
+
+	FreeImage_SetThreadCount(threads);
+	FreeImage_Unload(dib);
+	FreeImage_Unload(full);
+}
+
+static void DLL_CALLCONV
+scanDecoded(FIBITMAP *dib, unsigned pass, unsigned pass_count, void *user_data) {
+	unsigned *passes = (unsigned*)user_data;
+	assert(pass == *passes && pass_count == 0);
+	assert(FreeImage_HasPixels(dib));
+	(*passes)++;
+}
+
+void testJPEGProgressiveLoad(const char *src_file) {
+	FIBOOL bResult;
+
+	FIBITMAP *dib = FreeImage_Load(FIF_JPEG, src_file, 0);
+	assert(dib != NULL);
+
+	FreeImageIO io = { memReadProc, memWriteProc, memSeekProc, memTellProc };
+
+	const int flags[] = { JPEG_PROGRESSIVE, 0 };
+	for (int f : flags) {
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		bResult = FreeImage_SaveToMemory(FIF_JPEG, dib, hmem, f);
+		assert(bResult);
+
+		// every scan but the last is reported, the loaded bitmap is the final image
+		unsigned passes = 0;
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *progressive = FreeImage_LoadProgressive(FIF_JPEG, &io, (fi_handle)hmem, 0, scanDecoded, &passes);
+		assert(progressive != NULL);
+		assert((f == JPEG_PROGRESSIVE) ? (passes > 0) : (passes == 0));
+
+		FIBITMAP *reference = reloadJPEG(hmem);
+		assert(meanDiff(reference, progressive) == 0);
+		FreeImage_Unload(reference);
+		FreeImage_Unload(progressive);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	FreeImage_Unload(dib);
+}
+
 // Main test function
 // ----------------------------------------------------------
 
@@ -213,4 +674,28 @@ void testJPEG() {
 
 	// using the same file for src & dst is allowed
 	testJPEGSameFile(src_file);
+
+	// saving YCbCr samples without colour conversion
+	testJPEGSaveYUV(src_file);
+
+	// one operation on many streams
+	testJPEGBatch(src_file);
+
+	// lossless auto-orientation from the Exif orientation
+	testJPEGExifOrient(src_file);
+
+	// 1/8 previews from the DC coefficients
+	testJPEGLoadDC(src_file);
+
+	// thumbnails scaled in the DCT domain
+	testJPEGFastThumbnail(src_file);
+
+	// decoding at M/8 of the size
+	testJPEGScaledLoad(src_file);
+
+	// bands encoded concurrently, shared Huffman tables
+	testJPEGParallel(src_file);
+
+	// coarse scans of progressive images
+	testJPEGProgressiveLoad(src_file);
 }
@@ -0,0 +1,115 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+// memory IO over a FIMEMORY
+static unsigned DLL_CALLCONV jxrReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_ReadMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static unsigned DLL_CALLCONV jxrWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return 0;
+}
+
+static int DLL_CALLCONV jxrSeekProc(fi_handle handle, long offset, int origin) {
+	return FreeImage_SeekMemory((FIMEMORY*)handle, offset, origin) ? 0 : -1;
+}
+
+static long DLL_CALLCONV jxrTellProc(fi_handle handle) {
+	return FreeImage_TellMemory((FIMEMORY*)handle);
+}
+
+// Main test function
+// ----------------------------------------------------------
+
+void testJXR(const char *lpszPathName) {
+	printf("testJXR ...\n");
+
+	FIBITMAP *src = FreeImage_Load(FreeImage_GetFileType(lpszPathName), lpszPathName, 0);
+	assert(src != NULL);
+	FIBITMAP *rgb = FreeImage_ConvertTo24Bits(src);
+	assert(rgb != NULL);
+	FreeImage_Unload(src);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_JXR, rgb, hmem, JXR_LOSSLESS);
+	assert(bResult);
+	FreeImage_Unload(rgb);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_JXR, hmem, 0);
+	assert(dib != NULL);
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned longest = width > height ? width : height;
+
+	// a requested size in the upper 16 bits decodes a reduced resolution at least that large
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *reduced = FreeImage_LoadFromMemory(FIF_JXR, hmem, (int)((longest / 4) << 16));
+	assert(reduced != NULL);
+	assert(FreeImage_GetWidth(reduced) < width && FreeImage_GetHeight(reduced) < height);
+	assert(FreeImage_GetWidth(reduced) >= longest / 4 || FreeImage_GetHeight(reduced) >= longest / 4);
+	FreeImage_Unload(reduced);
+
+	FreeImageIO io;
+	io.read_proc = jxrReadProc;
+	io.write_proc = jxrWriteProc;
+	io.seek_proc = jxrSeekProc;
+	io.tell_proc = jxrTellProc;
+
+	// then refined to the exact size
+	const unsigned box = longest / 5;
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *scaled = FreeImage_LoadScaledFromHandle(FIF_JXR, &io, (fi_handle)hmem, box, box, 0);
+	assert(scaled != NULL);
+	assert(FreeImage_GetWidth(scaled) <= box && FreeImage_GetHeight(scaled) <= box);
+	assert(FreeImage_GetWidth(scaled) == box || FreeImage_GetHeight(scaled) == box);
+	FreeImage_Unload(scaled);
+
+	// a lossless region gives the same pixels as the whole image
+	const int left = width / 3 + 1, top = height / 4 + 1, right = width - 2, bottom = height / 2 + 3;
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *region = FreeImage_LoadRegion(FIF_JXR, &io, (fi_handle)hmem, left, top, right, bottom, 0);
+	assert(region != NULL);
+	FIBITMAP *crop = FreeImage_Copy(dib, left, top, right, bottom);
+	assert(crop != NULL);
+	assert(FreeImage_GetWidth(region) == FreeImage_GetWidth(crop) && FreeImage_GetHeight(region) == FreeImage_GetHeight(crop));
+	for (unsigned y = 0; y < FreeImage_GetHeight(crop); y++) {
+		assert(memcmp(FreeImage_GetScanLine(region, y), FreeImage_GetScanLine(crop, y), FreeImage_GetLine(crop)) == 0);
+	}
+	FreeImage_Unload(crop);
+	FreeImage_Unload(region);
+
+	// rectangles outside of the image
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	region = FreeImage_LoadRegion(FIF_JXR, &io, (fi_handle)hmem, 0, 0, width + 1, height, 0);
+	assert(region == NULL);
+
+	FreeImage_Unload(dib);
+	FreeImage_CloseMemory(hmem);
+}
@@ -22,6 +22,9 @@
 
 #include "TestSuite.h"
 
+#include <string.h>
+#include <vector>
+
 void  
 testBuildMPage(const char *src_filename, const char *dst_filename, FREE_IMAGE_FORMAT dst_fif, unsigned bpp) {
 	// get the file type
@@ -77,6 +80,10 @@ void testMPageCache(const char *src_filename, const char *dst_filename) {
 		src = tmp;
 	}
 
+	// a small memory budget swaps most of the pages out to the cache file
+	const unsigned cache_size = FreeImage_GetMultiBitmapCacheSize();
+	FreeImage_SetMultiBitmapCacheSize(256 * 1024);
+
 	FIMULTIBITMAP *out = FreeImage_OpenMultiBitmap(FIF_TIFF, dst_filename, TRUE, FALSE, keep_cache_in_memory); 
 
 	// attempt to create 16 480X360 images in a 24-bit TIFF multipage file
@@ -84,11 +91,53 @@ void testMPageCache(const char *src_filename, const char *dst_filename) {
 	for(int i = 0; i < 16; i++) { 		
 		FreeImage_AppendPage(out, rescaled); 
 	} 
+
+	// replaced pages reuse the blocks of the deleted ones
+	FreeImage_DeletePage(out, 3);
+	FreeImage_DeletePage(out, 7);
+	FreeImage_InsertPage(out, 0, rescaled);
+	FreeImage_AppendPage(out, rescaled);
+	assert(FreeImage_GetPageCount(out) == 16);
+
+	// pages added to the bitmap are locked from the cache, changes are kept with their metadata
+	const unsigned pitch = FreeImage_GetLine(rescaled);
+	FIBITMAP *page = FreeImage_LockPage(out, 0);
+	assert(page != NULL);
+	assert(memcmp(FreeImage_GetScanLine(page, 10), FreeImage_GetScanLine(rescaled, 10), pitch) == 0);
+	FreeImage_Invert(page);
+	assert(FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, page, "Comment", "inverted"));
+	FreeImage_UnlockPage(out, page, TRUE);
+
+	page = FreeImage_LockPage(out, 0);
+	assert(page != NULL);
+	assert(FreeImage_GetScanLine(page, 10)[0] == (uint8_t)~FreeImage_GetScanLine(rescaled, 10)[0]);
+	FITAG *tag = NULL;
+	assert(FreeImage_GetMetadata(FIMD_COMMENTS, page, "Comment", &tag));
+	assert(strcmp((const char*)FreeImage_GetTagValue(tag), "inverted") == 0);
+	FreeImage_Invert(page);
+	FreeImage_UnlockPage(out, page, TRUE);
+
+	FreeImage_CloseMultiBitmap(out, 0); 
+
+	FreeImage_SetMultiBitmapCacheSize(cache_size);
+
+	// pages saved from the cache
+	out = FreeImage_OpenMultiBitmap(FIF_TIFF, dst_filename, FALSE, TRUE, TRUE);
+	assert(out != NULL);
+	assert(FreeImage_GetPageCount(out) == 16);
+	for(int i = 0; i < 16; i++) {
+		page = FreeImage_LockPage(out, i);
+		assert(page != NULL);
+		for(unsigned y = 0; y < FreeImage_GetHeight(rescaled); y++) {
+			assert(memcmp(FreeImage_GetScanLine(page, y), FreeImage_GetScanLine(rescaled, y), pitch) == 0);
+		}
+		FreeImage_UnlockPage(out, page, FALSE);
+	}
+	FreeImage_CloseMultiBitmap(out, 0); 
+
 	FreeImage_Unload(rescaled); 
 	
 	FreeImage_Unload(src); 
-	
-	FreeImage_CloseMultiBitmap(out, 0); 
 }
 
 // --------------------------------------------------------------------------
@@ -174,6 +223,135 @@ void testLockDeleteMultiPage(const char *input) {
 
 // --------------------------------------------------------------------------
 
+static void checkLockPages(FIMULTIBITMAP *src) {
+	const int count = FreeImage_GetPageCount(src);
+	assert(count > 2);
+
+	// pages in any order, the last one twice
+	std::vector<int> pages;
+	for(int i = count - 1; i >= 0; i--) {
+		pages.push_back(i);
+	}
+	pages.push_back(0);
+
+	std::vector<FIBITMAP*> locked(pages.size());
+	assert(!FreeImage_LockPages(src, pages.data(), (int)pages.size(), locked.data()));
+	assert(locked.back() == NULL);
+
+	for(size_t i = 0; i + 1 < pages.size(); i++) {
+		assert(locked[i] != NULL);
+		assert(FreeImage_LockPage(src, pages[i]) == NULL);
+	}
+	int locked_count = 0;
+	assert(FreeImage_GetLockedPageNumbers(src, NULL, &locked_count) && (locked_count == count));
+
+	// same pages as locked one by one
+	for(size_t i = 0; i + 1 < pages.size(); i++) {
+		FIBITMAP *page = FreeImage_Clone(locked[i]);
+		assert(page != NULL);
+		FreeImage_UnlockPage(src, locked[i], FALSE);
+		FIBITMAP *single = FreeImage_LockPage(src, pages[i]);
+		assert(single != NULL);
+		assert(FreeImage_GetWidth(single) == FreeImage_GetWidth(page) && FreeImage_GetHeight(single) == FreeImage_GetHeight(page));
+		for(unsigned y = 0; y < FreeImage_GetHeight(page); y++) {
+			assert(memcmp(FreeImage_GetScanLine(single, y), FreeImage_GetScanLine(page, y), FreeImage_GetLine(page)) == 0);
+		}
+		FreeImage_UnlockPage(src, single, FALSE);
+		FreeImage_Unload(page);
+	}
+}
+
+static void testLockPages(const char *lpszPathName) {
+	const uint32_t thread_count = FreeImage_GetThreadCount();
+	FreeImage_SetThreadCount(4);
+
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(fif, lpszPathName, FALSE, TRUE, TRUE);
+	assert(src != NULL);
+	checkLockPages(src);
+	FreeImage_CloseMultiBitmap(src, 0);
+
+	// memory streams
+	FILE *file = fopen(lpszPathName, "rb");
+	assert(file != NULL);
+	std::vector<uint8_t> buffer;
+	uint8_t chunk[4096];
+	for(size_t n; (n = fread(chunk, 1, sizeof(chunk), file)) > 0; ) {
+		buffer.insert(buffer.end(), chunk, chunk + n);
+	}
+	fclose(file);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory(buffer.data(), (uint32_t)buffer.size());
+	src = FreeImage_LoadMultiBitmapFromMemory(fif, hmem, 0);
+	assert(src != NULL);
+	checkLockPages(src);
+	FreeImage_CloseMultiBitmap(src, 0);
+	FreeImage_CloseMemory(hmem);
+
+	FreeImage_SetThreadCount(thread_count);
+}
+
+// --------------------------------------------------------------------------
+
+static void testMultiPageEdits(const char *dst_filename) {
+	FIMULTIBITMAP *out = FreeImage_OpenMultiBitmap(FIF_TIFF, dst_filename, TRUE, FALSE, TRUE);
+	assert(out != NULL);
+
+	// pages are numbered by their pixel, edits are mirrored in a vector
+	FIBITMAP *dib = FreeImage_Allocate(1, 1, 24);
+	assert(dib != NULL);
+	std::vector<int> expected;
+	unsigned seed = 1;
+	for(int i = 0; i < 2000; i++) {
+		seed = seed * 1103515245 + 12345;
+		const int count = (int)expected.size();
+		const int position = count ? (int)((seed >> 8) % count) : 0;
+		switch(count < 8 ? 0 : (seed >> 4) % 4) {
+			case 0:
+			case 1:
+				FreeImage_GetBits(dib)[0] = (uint8_t)i;
+				FreeImage_GetBits(dib)[1] = (uint8_t)(i >> 8);
+				if(count && (i % 2)) {
+					FreeImage_InsertPage(out, position, dib);
+					expected.insert(expected.begin() + position, i);
+				} else {
+					FreeImage_AppendPage(out, dib);
+					expected.push_back(i);
+				}
+				break;
+			case 2:
+				FreeImage_DeletePage(out, position);
+				expected.erase(expected.begin() + position);
+				break;
+			case 3:
+			{
+				const int target = (int)((seed >> 16) % count);
+				if(target != position) {
+					assert(FreeImage_MovePage(out, target, position));
+					const int moved = expected[position];
+					expected.erase(expected.begin() + position);
+					expected.insert(expected.begin() + (target < position ? target : target - 1), moved);
+				}
+				break;
+			}
+		}
+		assert(FreeImage_GetPageCount(out) == (int)expected.size());
+	}
+	FreeImage_Unload(dib);
+
+	for(int i = 0; i < (int)expected.size(); i++) {
+		FIBITMAP *page = FreeImage_LockPage(out, i);
+		assert(page != NULL);
+		assert((FreeImage_GetBits(page)[0] | (FreeImage_GetBits(page)[1] << 8)) == expected[i]);
+		FreeImage_UnlockPage(out, page, FALSE);
+	}
+
+	FreeImage_CloseMultiBitmap(out, 0);
+}
+
+// --------------------------------------------------------------------------
+
 void testMultiPage(const char *lpszPathName) {
 	printf("testMultiPage ...\n");
 
@@ -190,4 +368,10 @@ void testMultiPage(const char *lpszPathName) {
 
 	// test multipage cache
 	testMPageCache(lpszPathName, "mpages.tif");
+
+	// test locking pages decoded in parallel
+	testLockPages("mpages.tif");
+
+	// test page edits of a large bitmap
+	testMultiPageEdits("edits.tif");
 }
@@ -21,6 +21,7 @@
 
 
 #include "TestSuite.h"
+#include <cstring>
 
 // --------------------------------------------------------------------------
 
@@ -194,6 +195,53 @@ FIBOOL testStreamMultiPageOpenSave(const char *input, const char *output, int in
 	return FALSE;
 }
 
+FIBOOL testStreamMultiPageWriter(const char *output, int output_flag) {
+	// initialize your own IO functions
+
+	FreeImageIO io;
+
+	io.read_proc  = myReadProc;
+	io.write_proc = myWriteProc;
+	io.seek_proc  = mySeekProc;
+	io.tell_proc  = myTellProc;
+
+	// write the pages as they are created
+	FILE *file = fopen(output, "w+b");
+	assert(file);
+	if (file == NULL) {
+		return FALSE;
+	}
+	FIMULTIWRITER *writer = FreeImage_OpenMultiBitmapWriter(FIF_TIFF, &io, (fi_handle)file, output_flag);
+	assert(writer);
+	for(int i = 0; i < 4; i++) {
+		FIBITMAP *page = createZonePlateImage(64, 64, 32 * (i + 1));
+		FIBOOL bSuccess = FreeImage_WritePage(writer, page);
+		assert(bSuccess);
+		FreeImage_Unload(page);
+	}
+	assert(FreeImage_GetWrittenPageCount(writer) == 4);
+	FIBOOL bSuccess = FreeImage_CloseMultiBitmapWriter(writer);
+	fclose(file);
+	assert(bSuccess);
+
+	// read them back
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(FIF_TIFF, output, FALSE, TRUE, TRUE);
+	assert(src);
+	assert(FreeImage_GetPageCount(src) == 4);
+	for(int i = 0; i < 4; i++) {
+		FIBITMAP *expected = createZonePlateImage(64, 64, 32 * (i + 1));
+		FIBITMAP *dib = FreeImage_LockPage(src, i);
+		assert(dib);
+		assert(FreeImage_GetWidth(dib) == 64 && FreeImage_GetHeight(dib) == 64);
+		assert(memcmp(FreeImage_GetBits(dib), FreeImage_GetBits(expected), FreeImage_GetPitch(dib) * 64) == 0);
+		FreeImage_UnlockPage(src, dib, FALSE);
+		FreeImage_Unload(expected);
+	}
+	FreeImage_CloseMultiBitmap(src, 0);
+
+	return bSuccess;
+}
+
 // --------------------------------------------------------------------------
 
 void testStreamMultiPage(const char *lpszPathName) {
@@ -213,4 +261,8 @@ void testStreamMultiPage(const char *lpszPathName) {
 	bSuccess = testStreamMultiPageOpenSave(lpszPathName, "redirect-stream.tif", 0, 0);
 	assert(bSuccess);
 
+	// test forward-only multipage writer
+	bSuccess = testStreamMultiPageWriter("writer-stream.tif", 0);
+	assert(bSuccess);
+
 }
@@ -21,6 +21,10 @@
 
 
 #include "TestSuite.h"
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
 
 void testSaveMemIO(const char *lpszPathName) {
 	FIMEMORY *hmem = NULL; 
@@ -139,10 +143,1114 @@ void testAcquireMemIO(const char *lpszPathName) {
 
 }
 
+void testLoadMappedIO(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+
+	// the mapped file decodes to the same pixels
+	FIBITMAP *mapped = FreeImage_LoadMapped(fif, lpszPathName, 0);
+	assert(mapped != NULL);
+	assert(FreeImage_GetWidth(mapped) == FreeImage_GetWidth(dib) && FreeImage_GetHeight(mapped) == FreeImage_GetHeight(dib));
+	assert(FreeImage_GetBPP(mapped) == FreeImage_GetBPP(dib));
+	const unsigned line = FreeImage_GetLine(dib);
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		assert(memcmp(FreeImage_GetScanLine(mapped, y), FreeImage_GetScanLine(dib, y), line) == 0);
+	}
+	FreeImage_Unload(mapped);
+	FreeImage_Unload(dib);
+
+	// missing files fail like FreeImage_Load
+	assert(FreeImage_LoadMapped(fif, "missing-file.png", 0) == NULL);
+}
+
+static unsigned DLL_CALLCONV
+readProc64(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_ReadMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static unsigned DLL_CALLCONV
+writeProc64(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_WriteMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static int DLL_CALLCONV
+seekProc64(fi_handle handle, int64_t offset, int origin) {
+	return FreeImage_SeekMemory64((FIMEMORY*)handle, offset, origin) ? 0 : -1;
+}
+
+static int64_t DLL_CALLCONV
+tellProc64(fi_handle handle) {
+	return FreeImage_TellMemory64((FIMEMORY*)handle);
+}
+
+void testMemIO64(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+
+	// save and load through 64-bit IO functions
+	FreeImageIO64 io;
+	io.read_proc = readProc64;
+	io.write_proc = writeProc64;
+	io.seek_proc = seekProc64;
+	io.tell_proc = tellProc64;
+
+	FIMEMORY *hmem = FreeImage_OpenMemory64();
+	FIBOOL bResult = FreeImage_SaveToHandle64(fif, dib, &io, (fi_handle)hmem, 0);
+	assert(bResult);
+
+	uint8_t *data = NULL;
+	uint64_t size64 = 0;
+	uint32_t size32 = 0;
+	bResult = FreeImage_AcquireMemory64(hmem, &data, &size64);
+	assert(bResult && size64 > 0);
+	bResult = FreeImage_AcquireMemory(hmem, &data, &size32);
+	assert(bResult && size32 == size64);
+	assert(FreeImage_TellMemory64(hmem) == (int64_t)size64);
+
+	FreeImage_SeekMemory64(hmem, 0, SEEK_SET);
+	FIBITMAP *check = FreeImage_LoadFromHandle64(fif, &io, (fi_handle)hmem, 0);
+	assert(check != NULL);
+	assert(FreeImage_GetWidth(check) == FreeImage_GetWidth(dib) && FreeImage_GetHeight(check) == FreeImage_GetHeight(dib));
+	FreeImage_Unload(check);
+	FreeImage_Unload(dib);
+
+	// positions beyond 4 GB, nothing is allocated until written
+	const int64_t far_position = INT64_C(5) << 30;
+	bResult = FreeImage_SeekMemory64(hmem, far_position, SEEK_SET);
+	assert(bResult);
+	assert(FreeImage_TellMemory64(hmem) == far_position);
+	if (sizeof(long) == 4) {
+		assert(FreeImage_TellMemory(hmem) == -1L);
+	}
+	uint8_t byte = 0;
+	const unsigned count = FreeImage_ReadMemory(&byte, 1, 1, hmem);
+	assert(count == 0);
+	bResult = FreeImage_SeekMemory64(hmem, -1, SEEK_SET);
+	assert(!bResult);
+	bResult = FreeImage_SeekMemory64(hmem, -(int64_t)size64, SEEK_END);
+	assert(bResult && FreeImage_TellMemory64(hmem) == 0);
+
+	FreeImage_CloseMemory(hmem);
+}
+
+void testReadMemIO() {
+	uint8_t data[1000];
+	for (unsigned i = 0; i < sizeof(data); i++) {
+		data[i] = (uint8_t)(i * 31);
+	}
+	uint8_t buffer[sizeof(data)] = { 0 };
+	FIMEMORY *hmem = FreeImage_OpenMemory(data, sizeof(data));
+
+	// byte reads with a large count
+	unsigned count = FreeImage_ReadMemory(buffer, 1, 300, hmem);
+	assert(count == 300 && memcmp(buffer, data, 300) == 0);
+
+	// a short count stops at the last full item and moves to the end
+	count = FreeImage_ReadMemory(buffer, 7, 200, hmem);
+	assert(count == 100 && memcmp(buffer, data + 300, 700) == 0);
+	assert(FreeImage_TellMemory(hmem) == (long)sizeof(data));
+
+	// the partial item is copied too
+	FreeImage_SeekMemory(hmem, 995, SEEK_SET);
+	memset(buffer, 0, sizeof(buffer));
+	count = FreeImage_ReadMemory(buffer, 4, 2, hmem);
+	assert(count == 1 && memcmp(buffer, data + 995, 5) == 0 && buffer[5] == 0);
+
+	// reading beyond the end
+	FreeImage_SeekMemory(hmem, 2000, SEEK_SET);
+	count = FreeImage_ReadMemory(buffer, 1, 1, hmem);
+	assert(count == 0 && FreeImage_TellMemory(hmem) == (long)sizeof(data));
+
+	FreeImage_CloseMemory(hmem);
+
+	// only memory streams can be peeked
+	FreeImageIO io;
+	io.read_proc = readProc64;
+	io.write_proc = writeProc64;
+	io.seek_proc = NULL;
+	io.tell_proc = NULL;
+	uint64_t available = 1;
+	assert(FreeImage_PeekMemoryIO(&io, (fi_handle)data, &available) == NULL && available == 0);
+}
+
+void testGrowthMemIO(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+
+	const unsigned length = 300000;
+	uint8_t *data = (uint8_t*)malloc(length);
+	uint8_t *check = (uint8_t*)malloc(length);
+	for (unsigned i = 0; i < length; i++) {
+		data[i] = (uint8_t)((i * 7) ^ (i >> 8));
+	}
+
+	assert(FreeImage_OpenMemoryEx(0, 42) == NULL);
+
+	const int policies[] = { FIMEMORY_GROW_DOUBLE, FIMEMORY_GROW_LINEAR, FIMEMORY_GROW_CHUNKED };
+	for (unsigned k = 0; k < 3; k++) {
+		FIMEMORY *hmem = FreeImage_OpenMemoryEx(1000, policies[k]);
+		assert(hmem != NULL);
+
+		// writes crossing chunks boundaries
+		unsigned written = 0;
+		for (unsigned n = 1; written < length; n = n * 3 + 1) {
+			const unsigned count = (n < length - written) ? n : (length - written);
+			const unsigned result = FreeImage_WriteMemory(data + written, 1, count, hmem);
+			assert(result == count);
+			written += count;
+		}
+		assert(FreeImage_TellMemory(hmem) == (long)length);
+
+		// overwrite in the middle, read across chunks
+		FreeImage_SeekMemory(hmem, 65530, SEEK_SET);
+		FreeImage_WriteMemory(data, 1, 100, hmem);
+		memcpy(data + 65530, data, 100);
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		const unsigned count = FreeImage_ReadMemory(check, 1, length, hmem);
+		assert(count == length && memcmp(check, data, length) == 0);
+
+		// acquired buffers are contiguous and the stream stays writable
+		uint8_t *buffer = NULL;
+		uint32_t size_in_bytes = 0;
+		FIBOOL bResult = FreeImage_AcquireMemory(hmem, &buffer, &size_in_bytes);
+		assert(bResult && size_in_bytes == length && memcmp(buffer, data, length) == 0);
+		const unsigned result = FreeImage_WriteMemory(data, 1, 10, hmem);
+		assert(result == 10);
+		FreeImage_CloseMemory(hmem);
+
+		// encode and decode with the policy
+		hmem = FreeImage_OpenMemoryEx(4096, policies[k]);
+		bResult = FreeImage_SaveToMemory(fif, dib, hmem, 0);
+		assert(bResult);
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *loaded = FreeImage_LoadFromMemory(fif, hmem, 0);
+		assert(loaded != NULL && FreeImage_GetWidth(loaded) == FreeImage_GetWidth(dib));
+		FreeImage_Unload(loaded);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	free(check);
+	free(data);
+	FreeImage_Unload(dib);
+}
+
+// overflow callback copying the stream into a buffer twice as large, the buffers are released by the test
+struct WritableBuffers {
+	std::vector<uint8_t*> buffers;
+	unsigned overflows;
+};
+
+static uint8_t* DLL_CALLCONV
+growWritable(uint8_t *data, uint64_t used, uint64_t required, uint64_t *capacity, void *user_data) {
+	auto *state = (WritableBuffers*)user_data;
+	const uint64_t size = (required > 2 * *capacity) ? required : 2 * *capacity;
+	uint8_t *buffer = (uint8_t*)malloc((size_t)size);
+	if (buffer) {
+		memcpy(buffer, data, (size_t)used);
+		state->buffers.push_back(buffer);
+		state->overflows++;
+		*capacity = size;
+	}
+	return buffer;
+}
+
+void testWritableMemIO(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+
+	// reference encoding
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(fif, dib, hmem, 0);
+	assert(bResult);
+	uint8_t *reference = NULL;
+	uint32_t reference_size = 0;
+	FreeImage_AcquireMemory(hmem, &reference, &reference_size);
+
+	// large enough buffer, the encoder writes straight into it
+	std::vector<uint8_t> buffer(reference_size + 100, 0xCD);
+	FIMEMORY *writable = FreeImage_OpenMemoryWritable(buffer.data(), buffer.size());
+	assert(writable != NULL);
+	bResult = FreeImage_SaveToMemory(fif, dib, writable, 0);
+	assert(bResult);
+	uint8_t *data = NULL;
+	uint32_t size_in_bytes = 0;
+	FreeImage_AcquireMemory(writable, &data, &size_in_bytes);
+	assert(data == buffer.data() && size_in_bytes == reference_size && memcmp(data, reference, reference_size) == 0);
+	assert(buffer[reference_size] == 0xCD);
+	FreeImage_SeekMemory(writable, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(fif, writable, 0);
+	assert(loaded != NULL && FreeImage_GetWidth(loaded) == FreeImage_GetWidth(dib));
+	FreeImage_Unload(loaded);
+	FreeImage_CloseMemory(writable);
+
+	// too small buffer without overflow callback
+	writable = FreeImage_OpenMemoryWritable(buffer.data(), reference_size / 2);
+	assert(FreeImage_WriteMemory(reference, 1, reference_size / 2, writable) == reference_size / 2);
+	assert(FreeImage_WriteMemory(reference, 1, 1, writable) == 0);
+	FreeImage_CloseMemory(writable);
+
+	// too small buffer, more space comes from the overflow callback
+	WritableBuffers state = {};
+	writable = FreeImage_OpenMemoryWritable(buffer.data(), 100, growWritable, &state);
+	bResult = FreeImage_SaveToMemory(fif, dib, writable, 0);
+	assert(bResult && state.overflows > 0);
+	FreeImage_AcquireMemory(writable, &data, &size_in_bytes);
+	assert(data == state.buffers.back() && size_in_bytes == reference_size && memcmp(data, reference, reference_size) == 0);
+	FreeImage_CloseMemory(writable);
+	for (uint8_t *b : state.buffers) {
+		free(b);
+	}
+
+	// wrapped buffers stay read-only
+	FIMEMORY *wrapped = FreeImage_OpenMemory(buffer.data(), (uint32_t)buffer.size());
+	assert(FreeImage_WriteMemory(reference, 1, 1, wrapped) == 0);
+	FreeImage_CloseMemory(wrapped);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+}
+
+void testFileHints(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+
+	// unknown bits are dropped, hints don't change the decoded pixels
+	assert(FreeImage_GetFileHints() == 0);
+	FreeImage_SetFileHints(FIFILE_HINT_SEQUENTIAL | FIFILE_HINT_WILLNEED | FIFILE_HINT_DONTNEED | 0x100);
+	assert(FreeImage_GetFileHints() == (FIFILE_HINT_SEQUENTIAL | FIFILE_HINT_WILLNEED | FIFILE_HINT_DONTNEED));
+	FIBITMAP *hinted = FreeImage_Load(fif, lpszPathName, 0);
+	assert(hinted != NULL && FreeImage_GetHeight(hinted) == FreeImage_GetHeight(dib));
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		assert(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(hinted, y), FreeImage_GetLine(dib)) == 0);
+	}
+	FreeImage_Unload(hinted);
+
+	FreeImage_SetFileHints(FIFILE_HINT_DONTNEED);
+	assert(FreeImage_Load(fif, "file_that_does_not_exist", 0) == NULL);
+	FreeImage_SetFileHints(0);
+
+	FreeImage_Unload(dib);
+}
+
+struct CountingHandle {
+	FIMEMORY *hmem;
+	unsigned reads;
+};
+
+static unsigned DLL_CALLCONV
+countingReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	auto *h = (CountingHandle*)handle;
+	h->reads++;
+	return FreeImage_ReadMemory(buffer, size, count, h->hmem);
+}
+
+static unsigned DLL_CALLCONV
+countingWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return 0;
+}
+
+static int DLL_CALLCONV
+countingSeekProc(fi_handle handle, long offset, int origin) {
+	return FreeImage_SeekMemory(((CountingHandle*)handle)->hmem, offset, origin) ? 0 : -1;
+}
+
+static long DLL_CALLCONV
+countingTellProc(fi_handle handle) {
+	return FreeImage_TellMemory(((CountingHandle*)handle)->hmem);
+}
+
+void testFileTypeMemIO(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	assert(fif != FIF_UNKNOWN);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FILE *file = fopen(lpszPathName, "rb");
+	assert(file != NULL);
+	uint8_t buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		FreeImage_WriteMemory(buffer, 1, (unsigned)n, hmem);
+	}
+	fclose(file);
+
+	// same format from memory, the stream position is restored
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FREE_IMAGE_FORMAT check = FreeImage_GetFileTypeFromMemory(hmem, 0);
+	assert(check == fif);
+	assert(FreeImage_TellMemory(hmem) == 0);
+
+	// the header is read once instead of once per plugin
+	FreeImageIO io;
+	io.read_proc = countingReadProc;
+	io.write_proc = countingWriteProc;
+	io.seek_proc = countingSeekProc;
+	io.tell_proc = countingTellProc;
+	CountingHandle handle = { hmem, 0 };
+	check = FreeImage_GetFileTypeFromHandle(&io, (fi_handle)&handle, 0);
+	assert(check == fif);
+	assert(FreeImage_TellMemory(hmem) == 0);
+	assert(handle.reads < (unsigned)FreeImage_GetFIFCount());
+
+	// streams shorter than the header
+	uint8_t tiny[2] = { 0, 0 };
+	FIMEMORY *hshort = FreeImage_OpenMemory(tiny, sizeof(tiny));
+	check = FreeImage_GetFileTypeFromMemory(hshort, 0);
+	assert(check == FIF_UNKNOWN);
+	FreeImage_CloseMemory(hshort);
+
+	FreeImage_CloseMemory(hmem);
+}
+
+void testBufferedMemIO(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(fif, dib, hmem, 0);
+	assert(bResult);
+
+	FreeImageIO io;
+	io.read_proc = countingReadProc;
+	io.write_proc = countingWriteProc;
+	io.seek_proc = countingSeekProc;
+	io.tell_proc = countingTellProc;
+
+	// unbuffered reads
+	CountingHandle handle = { hmem, 0 };
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *check = FreeImage_LoadFromHandle(fif, &io, (fi_handle)&handle, 0);
+	assert(check != NULL);
+	const unsigned unbuffered_reads = handle.reads;
+	FreeImage_Unload(check);
+
+	// same image through the buffer, with less reads
+	FreeImageIO buffered_io;
+	handle.reads = 0;
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBUFFEREDIO *buffered = FreeImage_CreateBufferedIO(&io, (fi_handle)&handle, 4096, &buffered_io);
+	assert(buffered != NULL);
+	check = FreeImage_LoadFromHandle(fif, &buffered_io, (fi_handle)buffered, 0);
+	assert(check != NULL);
+	assert(handle.reads <= unbuffered_reads);
+	assert(FreeImage_GetWidth(check) == FreeImage_GetWidth(dib) && FreeImage_GetHeight(check) == FreeImage_GetHeight(dib));
+	assert(memcmp(FreeImage_GetBits(check), FreeImage_GetBits(dib), FreeImage_GetPitch(dib) * FreeImage_GetHeight(dib)) == 0);
+	FreeImage_Unload(check);
+
+	// seeks within the window, the stream is left at the buffered position
+	uint8_t first[4], again[4];
+	buffered_io.seek_proc((fi_handle)buffered, 0, SEEK_SET);
+	unsigned count = buffered_io.read_proc(first, 1, sizeof(first), (fi_handle)buffered);
+	assert(count == sizeof(first));
+	handle.reads = 0;
+	buffered_io.seek_proc((fi_handle)buffered, -4, SEEK_CUR);
+	count = buffered_io.read_proc(again, 2, 2, (fi_handle)buffered);
+	assert(count == 2 && memcmp(first, again, sizeof(first)) == 0);
+	assert(handle.reads == 0);
+	assert(buffered_io.tell_proc((fi_handle)buffered) == 4);
+	buffered_io.seek_proc((fi_handle)buffered, 0, SEEK_END);
+	assert(buffered_io.tell_proc((fi_handle)buffered) == FreeImage_TellMemory(hmem));
+	buffered_io.seek_proc((fi_handle)buffered, 10, SEEK_SET);
+	FreeImage_CloseBufferedIO(buffered);
+	assert(FreeImage_TellMemory(hmem) == 10);
+
+	// automatic buffering of user IO
+	FreeImage_SetLoadBuffering(4096);
+	handle.reads = 0;
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	check = FreeImage_LoadFromHandle(fif, &io, (fi_handle)&handle, 0);
+	FreeImage_SetLoadBuffering(0);
+	assert(check != NULL);
+	assert(handle.reads <= unbuffered_reads);
+	FreeImage_Unload(check);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+}
+
+/**
+Reads the rows of a memory stream with a scanline reader and compares them with the loaded bitmap
+*/
+static void checkScanlineReader(FREE_IMAGE_FORMAT fif, FIMEMORY *hmem, int flags = 0) {
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *dib = FreeImage_LoadFromMemory(fif, hmem, flags);
+	assert(dib != NULL);
+
+	FreeImageIO io;
+	io.read_proc = countingReadProc;
+	io.write_proc = countingWriteProc;
+	io.seek_proc = countingSeekProc;
+	io.tell_proc = countingTellProc;
+	CountingHandle handle = { hmem, 0 };
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FISCANLINEREADER *reader = FreeImage_OpenScanlineReader(fif, &io, (fi_handle)&handle, flags);
+	assert(reader != NULL);
+
+	FIBITMAP *info = FreeImage_GetScanlineReaderInfo(reader);
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned line = FreeImage_GetLine(dib);
+	assert(FreeImage_GetWidth(info) == width && FreeImage_GetHeight(info) == height);
+	assert(FreeImage_GetBPP(info) == FreeImage_GetBPP(dib) && FreeImage_GetImageType(info) == FreeImage_GetImageType(dib));
+
+	// a few rows at a time, in a buffer with a larger pitch
+	const unsigned rows = 7;
+	const unsigned pitch = line + 5;
+	uint8_t *buffer = (uint8_t*)malloc(rows * pitch);
+	assert(buffer != NULL);
+	unsigned y = 0;
+	while (y < height) {
+		const unsigned n = FreeImage_ReadScanlines(reader, buffer, rows, pitch);
+		assert(n == ((height - y < rows) ? height - y : rows));
+		for (unsigned i = 0; i < n; i++, y++) {
+			assert(memcmp(buffer + i * pitch, FreeImage_GetScanLine(dib, height - 1 - y), line) == 0);
+		}
+	}
+	unsigned count = FreeImage_ReadScanlines(reader, buffer, rows, pitch);
+	assert(count == 0);
+	count = FreeImage_ReadScanlines(reader, buffer, rows, line - 1);
+	assert(count == 0);
+	free(buffer);
+
+	FreeImage_CloseScanlineReader(reader);
+	FreeImage_Unload(dib);
+}
+
+/**
+Rescales the rows of a memory stream as they are decoded and compares them with the rescaled bitmap
+*/
+static void checkRescaleScanlines(FREE_IMAGE_FORMAT fif, FIMEMORY *hmem, FIBITMAP *dib) {
+	FreeImageIO io;
+	io.read_proc = countingReadProc;
+	io.write_proc = countingWriteProc;
+	io.seek_proc = countingSeekProc;
+	io.tell_proc = countingTellProc;
+	CountingHandle handle = { hmem, 0 };
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FISCANLINEREADER *reader = FreeImage_OpenScanlineReader(fif, &io, (fi_handle)&handle, 0);
+	assert(reader != NULL);
+
+	const unsigned width = FreeImage_GetWidth(dib) / 3 + 1;
+	const unsigned height = FreeImage_GetHeight(dib) / 3 + 1;
+	FIBITMAP *streamed = FreeImage_RescaleScanlines(reader, width, height, FILTER_BILINEAR);
+	FIBITMAP *expected = FreeImage_Rescale(dib, width, height, FILTER_BILINEAR);
+	assert(streamed != NULL && expected != NULL);
+	assert(FreeImage_GetBPP(streamed) == FreeImage_GetBPP(expected));
+	assert(FreeImage_GetWidth(streamed) == width && FreeImage_GetHeight(streamed) == height);
+
+	// the streamed rows are filtered in float, the 8-bit rescale rounds its intermediate image
+	for (unsigned y = 0; y < height; y++) {
+		const uint8_t *a = FreeImage_GetScanLine(streamed, y);
+		const uint8_t *b = FreeImage_GetScanLine(expected, y);
+		for (unsigned x = 0; x < FreeImage_GetLine(streamed); x++) {
+			assert(abs(a[x] - b[x]) <= 2);
+		}
+	}
+	FreeImage_Unload(expected);
+	FreeImage_Unload(streamed);
+
+	// the reader is at the end of the image
+	assert(FreeImage_RescaleScanlines(reader, width, height, FILTER_BILINEAR) == NULL);
+	FreeImage_CloseScanlineReader(reader);
+}
+
+/**
+Writes a 13x5 4-bit BMP compressed with encoded runs, absolute runs (padded or not), deltas and end of line commands
+*/
+static FIMEMORY* makeRLE4Bitmap() {
+	const uint8_t rle[] = {
+		0x05, 0x12, 0x00, 0x06, 0x34, 0x56, 0x78, 0x00, 0x00, 0x00,	// run, padded absolute run, end of line
+		0x00, 0x02, 0x03, 0x01,										// empty row, next row from column 3
+		0x04, 0xAB, 0x00, 0x00,										// run, end of line
+		0x0D, 0x9C, 0x00, 0x00,										// whole row run, end of line
+		0x00, 0x03, 0xDE, 0xF0, 0x00, 0x02, 0x02, 0x00, 0x02, 0x11,	// absolute run, delta in the row, run
+		0x00, 0x01													// end of bitmap
+	};
+	const uint32_t offset = 14 + 40 + 16 * 4;
+	uint8_t header[offset] = { 0 };
+	auto put16 = [&](unsigned pos, uint32_t value) { header[pos] = (uint8_t)value; header[pos + 1] = (uint8_t)(value >> 8); };
+	auto put32 = [&](unsigned pos, uint32_t value) { put16(pos, value & 0xFFFF); put16(pos + 2, value >> 16); };
+	header[0] = 'B';
+	header[1] = 'M';
+	put32(2, offset + sizeof(rle));
+	put32(10, offset);
+	put32(14, 40);				// biSize
+	put32(18, 13);				// biWidth
+	put32(22, 5);				// biHeight
+	put16(26, 1);				// biPlanes
+	put16(28, 4);				// biBitCount
+	put32(30, 2);				// biCompression = BI_RLE4
+	put32(34, sizeof(rle));		// biSizeImage
+	put32(46, 16);				// biClrUsed
+	for (unsigned i = 0; i < 16; i++) {
+		header[54 + 4 * i] = header[55 + 4 * i] = header[56 + 4 * i] = (uint8_t)(i * 17);
+	}
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FreeImage_WriteMemory(header, sizeof(header), 1, hmem);
+	FreeImage_WriteMemory(rle, sizeof(rle), 1, hmem);
+	return hmem;
+}
+
+/**
+Rewrites an uncompressed BMP as a top-down bitmap (negative height, rows stored from the top)
+*/
+static FIMEMORY* makeTopDownBitmap(FIMEMORY *bottom_up) {
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	FreeImage_AcquireMemory(bottom_up, &data, &size);
+	const uint32_t offset = data[10] | (data[11] << 8) | (data[12] << 16) | ((uint32_t)data[13] << 24);
+	const int32_t height = (int32_t)(data[22] | (data[23] << 8) | (data[24] << 16) | ((uint32_t)data[25] << 24));
+	const unsigned pitch = (size - offset) / height;
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FreeImage_WriteMemory(data, offset, 1, hmem);
+	FreeImage_SeekMemory(hmem, 22, SEEK_SET);
+	const int32_t top_down = -height;
+	FreeImage_WriteMemory(&top_down, 4, 1, hmem);
+	FreeImage_SeekMemory(hmem, offset, SEEK_SET);
+	for (int32_t y = height - 1; y >= 0; y--) {
+		FreeImage_WriteMemory(data + offset + y * pitch, pitch, 1, hmem);
+	}
+	return hmem;
+}
+
+void testScanlineReader(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(fif, dib, hmem, 0);
+	assert(bResult);
+	checkScanlineReader(fif, hmem);
+	FreeImage_CloseMemory(hmem);
+
+	// PNM rows are decoded as they are read
+	FIBITMAP *rgb = FreeImage_ConvertTo24Bits(dib);
+	FIBITMAP *grey = FreeImage_ConvertToGreyscale(dib);
+	assert(rgb != NULL && grey != NULL);
+	const struct { FREE_IMAGE_FORMAT fif; FIBITMAP *dib; int flags; } pnm[] = {
+		{ FIF_PPMRAW, rgb, PNM_SAVE_RAW },
+		{ FIF_PPM, rgb, PNM_SAVE_ASCII },
+		{ FIF_PGMRAW, grey, PNM_SAVE_RAW },
+		{ FIF_PGM, grey, PNM_SAVE_ASCII },
+	};
+	for (const auto& format : pnm) {
+		hmem = FreeImage_OpenMemory();
+		bResult = FreeImage_SaveToMemory(format.fif, format.dib, hmem, format.flags);
+		assert(bResult);
+		checkScanlineReader(format.fif, hmem);
+		checkRescaleScanlines(format.fif, hmem, format.dib);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	// BMP rows are read where they are stored, RLE rows from an index of the first command of each row
+	assert(FreeImage_FIFSupportsFeature(FIF_BMP, FIFEATURE_SCANLINE_READER));
+	hmem = FreeImage_OpenMemory();
+	bResult = FreeImage_SaveToMemory(FIF_BMP, rgb, hmem, 0);
+	assert(bResult);
+	checkScanlineReader(FIF_BMP, hmem);
+	FIMEMORY *top_down = makeTopDownBitmap(hmem);
+	checkScanlineReader(FIF_BMP, top_down);
+	FreeImage_CloseMemory(top_down);
+	FreeImage_CloseMemory(hmem);
+	hmem = FreeImage_OpenMemory();
+	bResult = FreeImage_SaveToMemory(FIF_BMP, grey, hmem, BMP_SAVE_RLE);
+	assert(bResult);
+	checkScanlineReader(FIF_BMP, hmem);
+	FreeImage_CloseMemory(hmem);
+	hmem = makeRLE4Bitmap();
+	checkScanlineReader(FIF_BMP, hmem);
+	FreeImage_CloseMemory(hmem);
+
+	// HDR rows are decoded one at a time, run length encoded or flat when they are narrower than 8 pixels
+	assert(FreeImage_FIFSupportsFeature(FIF_HDR, FIFEATURE_SCANLINE_READER));
+	FIBITMAP *rgbf = FreeImage_ConvertToRGBF(rgb);
+	FIBITMAP *narrow = FreeImage_Copy(rgbf, 0, 0, 5, FreeImage_GetHeight(rgbf));
+	assert(rgbf != NULL && narrow != NULL);
+	for (FIBITMAP *src : { rgbf, narrow }) {
+		hmem = FreeImage_OpenMemory();
+		bResult = FreeImage_SaveToMemory(FIF_HDR, src, hmem, 0);
+		assert(bResult);
+		checkScanlineReader(FIF_HDR, hmem);
+		FreeImage_CloseMemory(hmem);
+	}
+	FreeImage_Unload(narrow);
+	FreeImage_Unload(rgbf);
+
+#if FREEIMAGE_WITH_LIBJPEG
+	// JPEG rows come from jpeg_read_scanlines, with the scaling of the load flags
+	assert(FreeImage_FIFSupportsFeature(FIF_JPEG, FIFEATURE_SCANLINE_READER));
+	for (FIBITMAP *src : { rgb, grey }) {
+		hmem = FreeImage_OpenMemory();
+		bResult = FreeImage_SaveToMemory(FIF_JPEG, src, hmem, 0);
+		assert(bResult);
+		checkScanlineReader(FIF_JPEG, hmem);
+		checkScanlineReader(FIF_JPEG, hmem, JPEG_ACCURATE);
+		checkScanlineReader(FIF_JPEG, hmem, (int)((FreeImage_GetWidth(src) / 3) << 16));
+		FreeImage_CloseMemory(hmem);
+	}
+#endif
+
+	FreeImage_Unload(grey);
+	FreeImage_Unload(rgb);
+	FreeImage_Unload(dib);
+}
+
+void testLoadRegion(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+	const int width = (int)FreeImage_GetWidth(dib);
+	const int height = (int)FreeImage_GetHeight(dib);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(fif, dib, hmem, 0);
+	assert(bResult);
+	FreeImage_Unload(dib);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	dib = FreeImage_LoadFromMemory(fif, hmem, 0);
+	assert(dib != NULL);
+
+	FreeImageIO io;
+	io.read_proc = countingReadProc;
+	io.write_proc = countingWriteProc;
+	io.seek_proc = countingSeekProc;
+	io.tell_proc = countingTellProc;
+	CountingHandle handle = { hmem, 0 };
+
+	// same pixels as a crop of the whole image (up to the decoder rounding of lossy formats)
+	const int left = width / 3 + 1, top = height / 4 + 1, right = width - 2, bottom = height / 2 + 3;
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *region = FreeImage_LoadRegion(fif, &io, (fi_handle)&handle, left, top, right, bottom, 0);
+	assert(region != NULL);
+	FIBITMAP *crop = FreeImage_Copy(dib, left, top, right, bottom);
+	assert(crop != NULL);
+	assert(FreeImage_GetWidth(region) == FreeImage_GetWidth(crop) && FreeImage_GetHeight(region) == FreeImage_GetHeight(crop));
+	assert(FreeImage_GetBPP(region) == FreeImage_GetBPP(crop));
+	int max_diff = 0;
+	for (unsigned y = 0; y < FreeImage_GetHeight(crop); y++) {
+		const uint8_t *a = FreeImage_GetScanLine(region, y);
+		const uint8_t *b = FreeImage_GetScanLine(crop, y);
+		for (unsigned x = 0; x < FreeImage_GetLine(crop); x++) {
+			const int diff = abs((int)a[x] - (int)b[x]);
+			max_diff = (diff > max_diff) ? diff : max_diff;
+		}
+	}
+	assert(fif == FIF_JPEG ? max_diff <= 8 : max_diff == 0);
+	FreeImage_Unload(crop);
+	FreeImage_Unload(region);
+
+	// rectangles outside of the image
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	region = FreeImage_LoadRegion(fif, &io, (fi_handle)&handle, 0, 0, width + 1, height, 0);
+	assert(region == NULL);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	region = FreeImage_LoadRegion(fif, &io, (fi_handle)&handle, 5, 5, 5, 10, 0);
+	assert(region == NULL);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+}
+
+void testStreamBufferSize(const char *lpszPathName) {
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(fif, dib, hmem, 0);
+	assert(bResult);
+	FreeImage_Unload(dib);
+
+	// memory streams are decoded in place and left at their end
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	dib = FreeImage_LoadFromMemory(fif, hmem, 0);
+	assert(dib != NULL);
+	const long end = FreeImage_TellMemory(hmem);
+	FreeImage_SeekMemory(hmem, 0, SEEK_END);
+	assert(FreeImage_TellMemory(hmem) == end);
+
+	FreeImageIO io;
+	io.read_proc = countingReadProc;
+	io.write_proc = countingWriteProc;
+	io.seek_proc = countingSeekProc;
+	io.tell_proc = countingTellProc;
+
+	// larger buffers need fewer io calls for the same pixels
+	const unsigned default_size = FreeImage_GetStreamBufferSize();
+	FreeImage_SetStreamBufferSize(1);
+	assert(FreeImage_GetStreamBufferSize() == 512);
+	unsigned reads[2] = { 0, 0 };
+	const unsigned sizes[2] = { 512, 1 << 16 };
+	for (int i = 0; i < 2; i++) {
+		FreeImage_SetStreamBufferSize(sizes[i]);
+		CountingHandle handle = { hmem, 0 };
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *check = FreeImage_LoadFromHandle(fif, &io, (fi_handle)&handle, 0);
+		assert(check != NULL);
+		for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+			assert(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(check, y), FreeImage_GetLine(dib)) == 0);
+		}
+		FreeImage_Unload(check);
+		reads[i] = handle.reads;
+	}
+	assert(reads[1] < reads[0]);
+	FreeImage_SetStreamBufferSize(default_size);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+}
+
+struct TraceCounts {
+	unsigned begins;
+	unsigned ends;
+	unsigned loads;
+	unsigned saves;
+	unsigned converts;
+	unsigned rescales;
+};
+
+static void DLL_CALLCONV
+traceBegin(const char *category, const char *name, void *user_data) {
+	TraceCounts *counts = (TraceCounts *)user_data;
+	assert(category && name);
+	counts->begins++;
+}
+
+static void DLL_CALLCONV
+traceEnd(const char *category, const char *name, uint64_t duration_ns, void *user_data) {
+	TraceCounts *counts = (TraceCounts *)user_data;
+	(void)duration_ns;
+	counts->ends++;
+	if (!strcmp(category, "load")) {
+		assert(!strcmp(name, "BMP"));
+		counts->loads++;
+	} else if (!strcmp(category, "save")) {
+		assert(!strcmp(name, "BMP"));
+		counts->saves++;
+	} else if (!strcmp(category, "convert")) {
+		counts->converts++;
+	} else if (!strcmp(category, "rescale")) {
+		counts->rescales++;
+	}
+}
+
+void testStats() {
+	printf("testStats ...\n");
+
+	FIBITMAP *dib = createZonePlateImage(320, 240, 64);
+	assert(dib != NULL);
+
+	TraceCounts counts = { 0, 0, 0, 0, 0, 0 };
+	FreeImage_ResetStats();
+	FreeImage_SetTraceCallback(traceBegin, traceEnd, &counts);
+
+	// save, load, convert and rescale once each
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(FIF_BMP, dib, hmem, 0));
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	assert(FreeImage_AcquireMemory(hmem, &data, &size));
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_BMP, hmem, 0);
+	assert(loaded != NULL);
+	FIBITMAP *color = FreeImage_ConvertTo24Bits(loaded);
+	assert(color != NULL);
+	FIBITMAP *small = FreeImage_Rescale(color, 160, 120, FILTER_BILINEAR);
+	assert(small != NULL);
+
+	FISTATS stats;
+	FreeImage_GetStats(&stats);
+	assert(stats.save_count == 1 && stats.bytes_written == size);
+	assert(stats.load_count == 1 && stats.bytes_read > 0 && stats.bytes_read <= size);
+	assert(stats.convert_count >= 1 && stats.rescale_count >= 1);
+	assert(stats.allocations >= 3);
+	assert(stats.peak_bitmap_bytes >= stats.bitmap_bytes);
+	assert(stats.bitmap_bytes >= (uint64_t)FreeImage_GetPitch(small) * 120);
+
+	// every span begins and ends
+	assert(counts.begins == counts.ends);
+	assert(counts.loads == 1 && counts.saves == 1);
+	assert(counts.converts >= 1 && counts.rescales >= 1);
+
+	// callbacks are removed, counters still run
+	FreeImage_SetTraceCallback(NULL, NULL);
+	const unsigned ends = counts.ends;
+	FIBITMAP *grey = FreeImage_ConvertToGreyscale(color);
+	assert(grey != NULL);
+	assert(counts.ends == ends);
+	FreeImage_GetStats(&stats);
+	assert(stats.convert_count >= 2);
+
+	// the live bytes go down as bitmaps are released
+	const uint64_t live = stats.bitmap_bytes;
+	FreeImage_Unload(grey);
+	FreeImage_Unload(small);
+	FreeImage_Unload(color);
+	FreeImage_Unload(loaded);
+	FreeImage_GetStats(&stats);
+	assert(stats.bitmap_bytes < live);
+
+	FreeImage_ResetStats();
+	FreeImage_GetStats(&stats);
+	assert(stats.load_count == 0 && stats.convert_count == 0 && stats.allocations == 0);
+	assert(stats.peak_bitmap_bytes == stats.bitmap_bytes);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+}
+
+void testMemoryBudget() {
+	printf("testMemoryBudget ...\n");
+
+	FIMEMORYUSAGE before, usage;
+	FreeImage_GetMemoryUsage(&before);
+	assert(before.total_bytes == before.bitmap_bytes + before.metadata_bytes + before.cache_bytes);
+
+	// bitmaps and metadata are counted while they live
+	FIBITMAP *dib = createZonePlateImage(256, 256, 64);
+	assert(dib != NULL);
+	assert(FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, dib, "Comment", "memory budget"));
+	FreeImage_GetMemoryUsage(&usage);
+	assert(usage.bitmap_bytes >= before.bitmap_bytes + FreeImage_GetPitch(dib) * 256);
+	assert(usage.metadata_bytes > before.metadata_bytes);
+	assert(usage.peak_bytes >= usage.total_bytes);
+
+	// a process limit fails large allocations up front
+	FreeImage_SetMemoryLimit(usage.total_bytes + (1 << 20));
+	FIBITMAP *huge = FreeImage_Allocate(60000, 60000, 24);
+	assert(huge == NULL);
+	FreeImage_SetMemoryLimit(0);
+
+	// a thread budget applies to the allocations of the thread from now on
+	assert(FreeImage_SetThreadMemoryBudget(1 << 20));
+	FIBITMAP *small = FreeImage_Allocate(256, 256, 24);
+	assert(small != NULL);
+	FreeImage_GetMemoryUsage(&usage);
+	assert(usage.thread_budget_bytes == (1 << 20));
+	assert(usage.thread_used_bytes >= (uint64_t)FreeImage_GetPitch(small) * 256);
+	FIBITMAP *large = FreeImage_Allocate(1024, 1024, 24);
+	assert(large == NULL);
+
+	// a file declaring huge dimensions fails to load instead of allocating them
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(FIF_BMP, small, hmem, 0));
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	assert(FreeImage_AcquireMemory(hmem, &data, &size));
+	std::vector<uint8_t> forged(data, data + size);
+	const int32_t dimension = 30000;
+	memcpy(&forged[18], &dimension, sizeof(dimension));	// biWidth
+	memcpy(&forged[22], &dimension, sizeof(dimension));	// biHeight
+	FIMEMORY *hforged = FreeImage_OpenMemory(forged.data(), (uint32_t)forged.size());
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_BMP, hforged, 0);
+	assert(loaded == NULL);
+	FreeImage_CloseMemory(hforged);
+	FreeImage_CloseMemory(hmem);
+
+	// released memory is credited back
+	FreeImage_Unload(small);
+	FreeImage_GetMemoryUsage(&usage);
+	assert(usage.thread_used_bytes == 0);
+	assert(FreeImage_SetThreadMemoryBudget(0));
+	FreeImage_GetMemoryUsage(&usage);
+	assert(usage.thread_budget_bytes == 0);
+
+	FreeImage_Unload(dib);
+	FreeImage_GetMemoryUsage(&usage);
+	assert(usage.bitmap_bytes == before.bitmap_bytes);
+	assert(usage.metadata_bytes == before.metadata_bytes);
+}
+
+static std::map<std::string, FIBITMAP*> s_cacheStorage;
+
+static FIBOOL DLL_CALLCONV storeCachedImage(const char *key, FIBITMAP *dib, void *user_data) {
+	FIBITMAP *&stored = s_cacheStorage[key];
+	FreeImage_Unload(stored);
+	stored = FreeImage_Clone(dib);
+	return stored != NULL;
+}
+
+static FIBITMAP* DLL_CALLCONV fetchCachedImage(const char *key, void *user_data) {
+	auto found = s_cacheStorage.find(key);
+	return found != s_cacheStorage.end() ? FreeImage_Clone(found->second) : NULL;
+}
+
+void testImageCache() {
+	printf("testImageCache ...\n");
+
+	FIBITMAP *dib = createZonePlateImage(128, 128, 64);
+	assert(dib != NULL);
+	const unsigned size = FreeImage_GetMemorySize(dib);
+
+	// room for two bitmaps
+	FIIMAGECACHE *cache = FreeImage_CreateImageCache(size * 2 + size / 2);
+	assert(cache != NULL);
+	assert(FreeImage_GetCachedImage(cache, "a") == NULL);
+	assert(FreeImage_PutCachedImage(cache, "a", dib));
+
+	// lookups share the cached pixels until written
+	FIBITMAP *a1 = FreeImage_GetCachedImage(cache, "a");
+	FIBITMAP *a2 = FreeImage_GetCachedImage(cache, "a");
+	assert(a1 != NULL && a2 != NULL);
+	assert(FreeImage_GetConstBits(a1) == FreeImage_GetConstBits(a2));
+	memset(FreeImage_GetScanLine(a1, 0), 0, FreeImage_GetLine(a1));
+	FIBITMAP *a3 = FreeImage_GetCachedImage(cache, "a");
+	assert(memcmp(FreeImage_GetConstScanLine(a3, 0), FreeImage_GetConstScanLine(dib, 0), FreeImage_GetLine(dib)) == 0);
+	FreeImage_Unload(a1);
+	FreeImage_Unload(a2);
+	FreeImage_Unload(a3);
+
+	// the least recently used bitmap is evicted
+	assert(FreeImage_PutCachedImage(cache, "b", dib));
+	FreeImage_Unload(FreeImage_GetCachedImage(cache, "a"));
+	assert(FreeImage_PutCachedImage(cache, "c", dib));
+	FIBITMAP *b = FreeImage_GetCachedImage(cache, "b");
+	assert(b == NULL);
+	FIIMAGECACHESTATS stats;
+	FreeImage_GetImageCacheStats(cache, &stats);
+	assert(stats.entries == 2 && stats.evictions == 1);
+	assert(stats.bytes <= size * 2 + size / 2);
+	assert(stats.hits == 4 && stats.misses == 2);
+
+	// evicted bitmaps go to the storage and come back from it
+	FreeImage_SetImageCacheStorage(cache, storeCachedImage, fetchCachedImage, NULL);
+	assert(FreeImage_PutCachedImage(cache, "d", dib));
+	assert(s_cacheStorage.count("a") == 1);
+	FIBITMAP *restored = FreeImage_GetCachedImage(cache, "a");
+	assert(restored != NULL);
+	FreeImage_GetImageCacheStats(cache, &stats);
+	assert(stats.storage_hits == 1);
+	FreeImage_Unload(restored);
+	FreeImage_SetImageCacheStorage(cache, NULL, NULL);
+	for (auto &stored : s_cacheStorage) {
+		FreeImage_Unload(stored.second);
+	}
+	s_cacheStorage.clear();
+
+	// raw files in a directory
+	FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, dib, "Comment", "cached");
+	assert(FreeImage_SetImageCacheDirectory(cache, "image_cache"));
+	assert(FreeImage_PutCachedImage(cache, "e", dib));
+	assert(FreeImage_PutCachedImage(cache, "f", dib));
+	assert(FreeImage_PutCachedImage(cache, "g", dib));
+	FIBITMAP *e = FreeImage_GetCachedImage(cache, "e");
+	assert(e != NULL);
+	assert(FreeImage_GetWidth(e) == 128 && FreeImage_GetBPP(e) == FreeImage_GetBPP(dib));
+	assert(memcmp(FreeImage_GetConstBits(e), FreeImage_GetConstBits(dib), FreeImage_GetPitch(dib) * 128) == 0);
+	FITAG *tag = NULL;
+	assert(FreeImage_GetMetadata(FIMD_COMMENTS, e, "Comment", &tag));
+	FreeImage_Unload(e);
+
+	// decoding goes through the cache, keyed by the content of the stream
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(FIF_BMP, dib, hmem, 0));
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *l1 = FreeImage_LoadFromMemoryCached(cache, FIF_UNKNOWN, hmem);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *l2 = FreeImage_LoadFromMemoryCached(cache, FIF_UNKNOWN, hmem);
+	assert(l1 != NULL && l2 != NULL);
+	assert(FreeImage_GetConstBits(l1) == FreeImage_GetConstBits(l2));
+	FreeImage_Unload(l1);
+	FreeImage_Unload(l2);
+	FreeImage_CloseMemory(hmem);
+
+	FreeImage_DeleteImageCache(cache);
+	FreeImage_Unload(dib);
+}
+
+static long jpegSize(FIBITMAP *dib, int quality) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(FIF_JPEG, dib, hmem, quality));
+	const long size = FreeImage_TellMemory(hmem);
+	FreeImage_CloseMemory(hmem);
+	return size;
+}
+
+static double jpegMetric(FIBITMAP *dib, FIMEMORY *hmem) {
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *decoded = FreeImage_LoadFromMemory(FIF_JPEG, hmem, 0);
+	assert(decoded != NULL);
+	const double ssim = FreeImage_ComputeMetric(dib, decoded, FIMETRIC_SSIM);
+	FreeImage_Unload(decoded);
+	return ssim;
+}
+
+void testSaveToMemoryTarget() {
+	// large enough for the proxy search
+	const unsigned width = 640, height = 520;
+	FIBITMAP *dib = FreeImage_Allocate(width, height, 24);
+	uint32_t seed = 7;
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < width * 3; x++) {
+			seed = seed * 1664525 + 1013904223;
+			bits[x] = (uint8_t)(((x / 3) + 2 * y) / 5 + (x % 3) * 30 + (((x / 3) ^ y) & 16) + (seed >> 30));
+		}
+	}
+	FIENCODETARGET target = {};
+	int quality = 0;
+
+	// highest quality fitting the size of the quality 50 encoding
+	target.max_bytes = (uint64_t)jpegSize(dib, 50);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemoryTarget(FIF_JPEG, dib, hmem, &target, JPEG_QUALITYBAD, &quality));
+	assert(quality >= 50 && quality < 100);
+	assert((uint64_t)FreeImage_TellMemory(hmem) <= target.max_bytes);
+	assert(FreeImage_TellMemory(hmem) == jpegSize(dib, quality));
+	assert((uint64_t)jpegSize(dib, quality + 1) > target.max_bytes);
+	FreeImage_CloseMemory(hmem);
+
+	// lowest quality reaching the metric
+	target.max_bytes = 0;
+	target.metric = FIMETRIC_SSIM;
+	target.min_metric = 0.95;
+	hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemoryTarget(FIF_JPEG, dib, hmem, &target, JPEG_SUBSAMPLING_444, &quality));
+	assert(quality > 1 && jpegMetric(dib, hmem) >= 0.95);
+	FreeImage_CloseMemory(hmem);
+	hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(FIF_JPEG, dib, hmem, JPEG_SUBSAMPLING_444 | (quality - 1)));
+	assert(jpegMetric(dib, hmem) < 0.95);
+	FreeImage_CloseMemory(hmem);
+
+	// targets that can't be met write nothing
+	target.max_bytes = 100;
+	hmem = FreeImage_OpenMemory();
+	assert(!FreeImage_SaveToMemoryTarget(FIF_JPEG, dib, hmem, &target, 0));
+	target.min_metric = 0;
+	assert(!FreeImage_SaveToMemoryTarget(FIF_JPEG, dib, hmem, &target, 0));
+	assert(FreeImage_TellMemory(hmem) == 0);
+
+	// lossless formats have no quality to search
+	target.max_bytes = 1 << 20;
+	assert(!FreeImage_SaveToMemoryTarget(FIF_PNG, dib, hmem, &target, 0));
+	FreeImage_CloseMemory(hmem);
+
+	FreeImage_Unload(dib);
+}
+
 void testMemIO(const char *lpszPathName) {
 	printf("testMemIO ...\n");
 	testSaveMemIO(lpszPathName);
 	testLoadMemIO(lpszPathName);
 	testAcquireMemIO(lpszPathName);
+	testLoadMappedIO(lpszPathName);
+	testMemIO64(lpszPathName);
+	testReadMemIO();
+	testGrowthMemIO(lpszPathName);
+	testWritableMemIO(lpszPathName);
+	testSaveToMemoryTarget();
+	testFileHints(lpszPathName);
+	testFileTypeMemIO(lpszPathName);
+	testBufferedMemIO(lpszPathName);
+	testScanlineReader(lpszPathName);
+	testLoadRegion(lpszPathName);
 }
 
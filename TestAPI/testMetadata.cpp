@@ -0,0 +1,182 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <cstring>
+#include <vector>
+
+void testMetadataCopyOnWrite()
+{
+	FIBITMAP* src = FreeImage_Allocate(8, 8, 24);
+	assert(src != nullptr);
+	assert(FreeImage_GetMetadataCount(FIMD_COMMENTS, src) == 0);
+	assert(FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, src, "Comment", "original"));
+	assert(FreeImage_SetMetadataKeyValue(FIMD_ANIMATION, src, "Loop", "0"));
+
+	// derived bitmaps share tags until modified
+	FIBITMAP* clone = FreeImage_Clone(src);
+	FIBITMAP* converted = FreeImage_Allocate(8, 8, 32);
+	assert(clone && converted);
+	assert(FreeImage_CloneMetadata(converted, src));
+	FITAG* src_tag = nullptr;
+	FITAG* clone_tag = nullptr;
+	FITAG* converted_tag = nullptr;
+	assert(FreeImage_GetMetadata(FIMD_COMMENTS, src, "Comment", &src_tag));
+	assert(FreeImage_GetMetadata(FIMD_COMMENTS, clone, "Comment", &clone_tag));
+	assert(FreeImage_GetMetadata(FIMD_COMMENTS, converted, "Comment", &converted_tag));
+	assert(src_tag == clone_tag && src_tag == converted_tag);
+	assert(FreeImage_GetMetadataCount(FIMD_ANIMATION, clone) == 1);
+	assert(FreeImage_GetMetadataCount(FIMD_ANIMATION, converted) == 0);
+
+	// modifying a derived bitmap leaves the others intact
+	assert(FreeImage_SetMetadataKeyValue(FIMD_COMMENTS, clone, "Comment", "edited"));
+	assert(FreeImage_SetMetadata(FIMD_COMMENTS, converted, "Comment", nullptr));
+	assert(FreeImage_GetMetadataCount(FIMD_COMMENTS, converted) == 0);
+	assert(FreeImage_GetMetadata(FIMD_COMMENTS, clone, "Comment", &clone_tag));
+	assert(strcmp((const char*)FreeImage_GetTagValue(clone_tag), "edited") == 0);
+	FreeImage_Unload(clone);
+
+	assert(FreeImage_GetMetadata(FIMD_COMMENTS, src, "Comment", &src_tag));
+	assert(strcmp((const char*)FreeImage_GetTagValue(src_tag), "original") == 0);
+
+	// tags outlive the bitmap they were created for
+	assert(FreeImage_CloneMetadata(converted, src));
+	FreeImage_Unload(src);
+	assert(FreeImage_GetMetadata(FIMD_COMMENTS, converted, "Comment", &converted_tag));
+	assert(strcmp((const char*)FreeImage_GetTagValue(converted_tag), "original") == 0);
+	FreeImage_Unload(converted);
+}
+
+void testMetadataArena()
+{
+	FIBITMAP* dib = FreeImage_Allocate(8, 8, 24);
+	assert(dib != nullptr);
+
+	// keys inserted out of order are iterated in key order
+	char key[32];
+	char value[64];
+	const unsigned count = 300;
+	for (unsigned i = 0; i < count; i++) {
+		const unsigned k = (i * 7919) % count;
+		snprintf(key, sizeof(key), "Key%03u", k);
+		snprintf(value, sizeof(value), "value of a tag with a rather long key number %u", k);
+		assert(FreeImage_SetMetadataKeyValue(FIMD_CUSTOM, dib, key, value));
+	}
+	assert(FreeImage_GetMetadataCount(FIMD_CUSTOM, dib) == count);
+
+	// replaced and removed tags
+	for (unsigned k = 0; k < count; k += 3) {
+		snprintf(key, sizeof(key), "Key%03u", k);
+		if (k % 2) {
+			assert(FreeImage_SetMetadata(FIMD_CUSTOM, dib, key, nullptr));
+		} else {
+			assert(FreeImage_SetMetadataKeyValue(FIMD_CUSTOM, dib, key, "replaced"));
+		}
+	}
+	const unsigned removed = count / 6;
+	assert(FreeImage_GetMetadataCount(FIMD_CUSTOM, dib) == count - removed);
+
+	// stored tags can be modified in place, their key in the model is unchanged
+	FITAG* tag = nullptr;
+	assert(FreeImage_GetMetadata(FIMD_CUSTOM, dib, "Key001", &tag));
+	assert(FreeImage_SetTagKey(tag, "Renamed"));
+	assert(FreeImage_SetTagDescription(tag, "described"));
+	assert(FreeImage_SetTagLength(tag, 4) && FreeImage_SetTagCount(tag, 4) && FreeImage_SetTagValue(tag, "new"));
+	tag = nullptr;
+	assert(FreeImage_GetMetadata(FIMD_CUSTOM, dib, "Key001", &tag));
+	assert(strcmp(FreeImage_GetTagKey(tag), "Renamed") == 0);
+	assert(strcmp((const char*)FreeImage_GetTagValue(tag), "new") == 0);
+
+	// a modified clone gets its own copy
+	FIBITMAP* clone = FreeImage_Clone(dib);
+	assert(clone != nullptr);
+	assert(FreeImage_SetMetadataKeyValue(FIMD_CUSTOM, clone, "Key002", "clone"));
+
+	FIMETADATA* handle = FreeImage_FindFirstMetadata(FIMD_CUSTOM, dib, &tag);
+	assert(handle != nullptr);
+	unsigned found = 0;
+	int previous = -1;
+	do {
+		FITAG* cloned = nullptr;
+		const char* tag_key = (strcmp(FreeImage_GetTagKey(tag), "Renamed") == 0) ? "Key001" : FreeImage_GetTagKey(tag);
+		const int k = atoi(tag_key + 3);
+		assert(k > previous);
+		previous = k;
+		assert(FreeImage_GetMetadata(FIMD_CUSTOM, clone, tag_key, &cloned));
+		if (k == 2) {
+			assert(strcmp((const char*)FreeImage_GetTagValue(cloned), "clone") == 0);
+			assert(strcmp((const char*)FreeImage_GetTagValue(tag), "clone") != 0);
+		} else {
+			assert(strcmp((const char*)FreeImage_GetTagValue(cloned), (const char*)FreeImage_GetTagValue(tag)) == 0);
+			if ((k % 3) == 0) {
+				assert(strcmp((const char*)FreeImage_GetTagValue(tag), "replaced") == 0);
+			}
+		}
+		found++;
+	} while (FreeImage_FindNextMetadata(handle, &tag));
+	FreeImage_FindCloseMetadata(handle);
+	assert(found == count - removed);
+
+	FreeImage_Unload(dib);
+	FreeImage_Unload(clone);
+}
+
+void testTagToStringBuf()
+{
+	FITAG* tag = FreeImage_CreateTag();
+	assert(tag != nullptr);
+
+	// rational Exif tag
+	const uint32_t exposure[] = { 1, 250 };
+	assert(FreeImage_SetTagKey(tag, "ExposureTime") && FreeImage_SetTagID(tag, 0x829A) && FreeImage_SetTagType(tag, FIDT_RATIONAL));
+	assert(FreeImage_SetTagCount(tag, 1) && FreeImage_SetTagLength(tag, sizeof(exposure)) && FreeImage_SetTagValue(tag, exposure));
+
+	char buffer[64];
+	assert(FreeImage_TagToStringBuf(FIMD_EXIF_EXIF, tag, buffer, sizeof(buffer)) == 9);
+	assert(strcmp(buffer, "1/250 sec") == 0);
+	assert(strcmp(FreeImage_TagToString(FIMD_EXIF_EXIF, tag), buffer) == 0);
+
+	// truncated, the whole length is returned
+	char small[4];
+	assert(FreeImage_TagToStringBuf(FIMD_EXIF_EXIF, tag, small, sizeof(small)) == 9);
+	assert(strcmp(small, "1/2") == 0);
+	assert(FreeImage_TagToStringBuf(FIMD_EXIF_EXIF, tag, nullptr, 0) == 0);
+
+	// integers of other models
+	const int16_t values[] = { -32768, 0, 32767 };
+	assert(FreeImage_SetTagType(tag, FIDT_SSHORT) && FreeImage_SetTagCount(tag, 3));
+	assert(FreeImage_SetTagLength(tag, sizeof(values)) && FreeImage_SetTagValue(tag, values));
+	assert(FreeImage_TagToStringBuf(FIMD_CUSTOM, tag, buffer, sizeof(buffer)) == 14);
+	assert(strcmp(buffer, "-32768 0 32767") == 0);
+
+	// strings longer than the default buffer
+	std::vector<int64_t> longs(100, INT64_MIN);
+	assert(FreeImage_SetTagType(tag, FIDT_SLONG8) && FreeImage_SetTagCount(tag, (uint32_t)longs.size()));
+	assert(FreeImage_SetTagLength(tag, (uint32_t)(longs.size() * sizeof(int64_t))) && FreeImage_SetTagValue(tag, longs.data()));
+	const char* text = FreeImage_TagToString(FIMD_CUSTOM, tag);
+	assert(strlen(text) == 2000);
+	assert(FreeImage_TagToStringBuf(FIMD_CUSTOM, tag, buffer, sizeof(buffer)) == 2000);
+	assert(strncmp(buffer, text, sizeof(buffer) - 1) == 0);
+
+	FreeImage_DeleteTag(tag);
+}
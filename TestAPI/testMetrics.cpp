@@ -0,0 +1,122 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <cmath>
+#include <memory>
+
+void testComputeMetric()
+{
+	const unsigned width = 131, height = 97;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> reference(FreeImage_Allocate(width, height, 24), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> noisy(FreeImage_Allocate(width, height, 24), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> noisier(FreeImage_Allocate(width, height, 24), &::FreeImage_Unload);
+	uint32_t seed = 12345;
+	double squaredErrors[3] = {};
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *r = FreeImage_GetScanLine(reference.get(), y);
+		uint8_t *n = FreeImage_GetScanLine(noisy.get(), y);
+		uint8_t *m = FreeImage_GetScanLine(noisier.get(), y);
+		for (unsigned x = 0; x < width * 3; ++x) {
+			seed = seed * 1664525 + 1013904223;
+			const int noise = static_cast<int>(seed >> 28) - 8;
+			r[x] = static_cast<uint8_t>(64 + (x * 3 + y * 2) % 128);
+			n[x] = static_cast<uint8_t>(r[x] + noise);
+			m[x] = static_cast<uint8_t>(r[x] + 4 * noise);
+			const double d = (r[x] - n[x]) / 255.0;
+			const unsigned channel = x % 3;
+			squaredErrors[channel == FI_RGBA_RED ? 0 : channel == FI_RGBA_GREEN ? 1 : 2] += d * d;
+		}
+	}
+
+	// identical images
+	double channels[4] = {};
+	assert(std::isinf(FreeImage_ComputeMetric(reference.get(), reference.get(), FIMETRIC_PSNR, channels)) && std::isinf(channels[2]));
+	assert(std::abs(FreeImage_ComputeMetric(reference.get(), reference.get(), FIMETRIC_SSIM) - 1) < 1e-6);
+	assert(std::abs(FreeImage_ComputeMetric(reference.get(), reference.get(), FIMETRIC_MSSSIM) - 1) < 1e-6);
+
+	// PSNR of every channel (red, green, blue order) and of the mean squared error
+	const double psnr = FreeImage_ComputeMetric(reference.get(), noisy.get(), FIMETRIC_PSNR, channels);
+	const double pixels = static_cast<double>(width) * height;
+	for (unsigned c = 0; c < 3; ++c) {
+		assert(std::abs(channels[c] - 10 * std::log10(pixels / squaredErrors[c])) < 1e-4);
+	}
+	assert(std::abs(psnr - 10 * std::log10(3 * pixels / (squaredErrors[0] + squaredErrors[1] + squaredErrors[2]))) < 1e-4);
+
+	// more noise, lower similarity
+	const double ssim = FreeImage_ComputeMetric(reference.get(), noisy.get(), FIMETRIC_SSIM);
+	const double msssim = FreeImage_ComputeMetric(reference.get(), noisy.get(), FIMETRIC_MSSSIM);
+	assert(ssim > 0 && ssim < 1 && msssim > 0 && msssim < 1);
+	assert(FreeImage_ComputeMetric(reference.get(), noisier.get(), FIMETRIC_SSIM) < ssim);
+	assert(FreeImage_ComputeMetric(reference.get(), noisier.get(), FIMETRIC_MSSSIM) < msssim);
+	assert(FreeImage_ComputeMetric(reference.get(), noisier.get(), FIMETRIC_PSNR) < psnr);
+
+	// scalar and vector kernels, serial and parallel bands agree
+	double results[2][3] = {};
+	runScalarAndSIMD([&](bool vector) {
+		for (int metric = FIMETRIC_PSNR; metric <= FIMETRIC_MSSSIM; ++metric) {
+			results[vector][metric] = FreeImage_ComputeMetric(reference.get(), noisy.get(), static_cast<FREE_IMAGE_METRIC>(metric));
+		}
+	});
+	for (int metric = FIMETRIC_PSNR; metric <= FIMETRIC_MSSSIM; ++metric) {
+		assert(std::abs(results[0][metric] - results[1][metric]) < 1e-6);
+	}
+
+	// 16-bit samples are normalized, the alpha channel is compared too
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> words[2] = {
+		{ FreeImage_AllocateT(FIT_RGBA16, width, height), &::FreeImage_Unload }, { FreeImage_AllocateT(FIT_RGBA16, width, height), &::FreeImage_Unload }
+	};
+	for (unsigned y = 0; y < height; ++y) {
+		for (int i = 0; i < 2; ++i) {
+			const uint8_t *b = FreeImage_GetScanLine(i ? noisy.get() : reference.get(), y);
+			auto *w = reinterpret_cast<FIRGBA16*>(FreeImage_GetScanLine(words[i].get(), y));
+			for (unsigned x = 0; x < width; ++x, b += 3) {
+				w[x].red = b[FI_RGBA_RED] * 257;
+				w[x].green = b[FI_RGBA_GREEN] * 257;
+				w[x].blue = b[FI_RGBA_BLUE] * 257;
+				w[x].alpha = 0xFFFF;
+			}
+		}
+	}
+	double wordChannels[4] = {};
+	FreeImage_ComputeMetric(words[0].get(), words[1].get(), FIMETRIC_SSIM, wordChannels);
+	FreeImage_ComputeMetric(reference.get(), noisy.get(), FIMETRIC_SSIM, channels);
+	for (unsigned c = 0; c < 3; ++c) {
+		assert(std::abs(wordChannels[c] - channels[c]) < 1e-4);
+	}
+	assert(std::abs(wordChannels[3] - 1) < 1e-6);
+
+	// a small image uses a single scale
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> small(FreeImage_Copy(reference.get(), 0, 0, 20, 20), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> smallNoisy(FreeImage_Copy(noisy.get(), 0, 0, 20, 20), &::FreeImage_Unload);
+	assert(std::abs(FreeImage_ComputeMetric(small.get(), smallNoisy.get(), FIMETRIC_MSSSIM) - FreeImage_ComputeMetric(small.get(), smallNoisy.get(), FIMETRIC_SSIM)) < 1e-9);
+
+	// images that can't be compared
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> palettized(FreeImage_Allocate(20, 20, 8), &::FreeImage_Unload);
+	FreeImage_GetPalette(palettized.get())[0].red = 255;
+	assert(FreeImage_ComputeMetric(small.get(), smallNoisy.get(), FIMETRIC_PSNR) > 0);
+	assert(FreeImage_ComputeMetric(reference.get(), small.get(), FIMETRIC_PSNR) == -1);
+	assert(FreeImage_ComputeMetric(words[0].get(), reference.get(), FIMETRIC_SSIM) == -1);
+	assert(FreeImage_ComputeMetric(palettized.get(), palettized.get(), FIMETRIC_SSIM) == -1);
+	assert(FreeImage_ComputeMetric(nullptr, reference.get(), FIMETRIC_SSIM) == -1);
+}
@@ -0,0 +1,140 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static float sampleValue(unsigned x, unsigned y) {
+	return (float)y * 1000.0F + (float)x * 0.25F - 3.0F;
+}
+
+// PFM file whose first row is the top of the image, the header is padded with spaces to a multiple of 4 bytes
+static std::string makePFM(unsigned width, unsigned height, unsigned channels, bool big_endian) {
+	std::string data = std::string(channels == 3 ? "PF" : "Pf") + "\n" + std::to_string(width) + " " + std::to_string(height) + "\n" + (big_endian ? "1.0" : "-1.0");
+	data.append((4 - (data.size() + 1) % 4) % 4, ' ');
+	data += '\n';
+	for (unsigned y = 0; y < height; y++) {
+		for (unsigned x = 0; x < width * channels; x++) {
+			const float value = sampleValue(x, y);
+			uint8_t bytes[4];
+			memcpy(bytes, &value, sizeof(value));
+#ifdef FREEIMAGE_BIGENDIAN
+			const bool swap = !big_endian;
+#else
+			const bool swap = big_endian;
+#endif
+			for (unsigned b = 0; b < 4; b++) {
+				data += (char)bytes[swap ? 3 - b : b];
+			}
+		}
+	}
+	return data;
+}
+
+// displayed rows are walked with FreeImage_GetOrientedLayout, honouring in place bitmaps stored upside down
+static void checkPFM(FIBITMAP *dib, unsigned width, unsigned height, unsigned channels) {
+	assert(dib != NULL);
+	assert(FreeImage_GetImageType(dib) == (channels == 3 ? FIT_RGBF : FIT_FLOAT));
+	unsigned w = 0, h = 0;
+	uint8_t *origin = NULL;
+	int row_step = 0, pixel_step = 0;
+	assert(FreeImage_GetOrientedLayout(dib, &w, &h, &origin, &row_step, &pixel_step));
+	assert(w == width && h == height);
+	for (unsigned y = 0; y < height; y++) {
+		const float *row = (const float *)(origin + (ptrdiff_t)row_step * y);
+		for (unsigned x = 0; x < width * channels; x++) {
+			assert(row[x] == sampleValue(x, y));
+		}
+	}
+}
+
+void testPFM() {
+	printf("testPFM ...\n");
+
+	const unsigned widths[] = { 1, 17, 1023 };
+	for (unsigned channels : { 1, 3 }) {
+		for (unsigned width : widths) {
+			for (bool big_endian : { false, true }) {
+				const unsigned height = 37;
+				std::string pfm = makePFM(width, height, channels, big_endian);
+
+				FIMEMORY *hmem = FreeImage_OpenMemory((uint8_t *)&pfm[0], (uint32_t)pfm.size());
+				FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_PFM, hmem, 0);
+				checkPFM(dib, width, height, channels);
+				assert(FreeImage_GetOrientation(dib) == FIO_NORMAL);
+				FreeImage_Unload(dib);
+				FreeImage_CloseMemory(hmem);
+
+				// truncated data are an error
+				hmem = FreeImage_OpenMemory((uint8_t *)&pfm[0], (uint32_t)pfm.size() - 2);
+				dib = FreeImage_LoadFromMemory(FIF_PFM, hmem, 0);
+				assert(dib == NULL);
+				FreeImage_CloseMemory(hmem);
+
+				// pixels in the machine byte order are used in place
+				FILE *file = fopen("pfm.pfm", "wb");
+				assert(file != NULL);
+				fwrite(pfm.data(), 1, pfm.size(), file);
+				fclose(file);
+				dib = FreeImage_LoadMapped(FIF_PFM, "pfm.pfm", PFM_INPLACE);
+				checkPFM(dib, width, height, channels);
+#ifdef FREEIMAGE_BIGENDIAN
+				const bool in_place = big_endian;
+#else
+				const bool in_place = !big_endian;
+#endif
+				assert(FreeImage_GetOrientation(dib) == (in_place ? FIO_FLIP_VERTICAL : FIO_NORMAL));
+				FIBITMAP *upright = FreeImage_ApplyOrientation(dib);
+				assert(upright != NULL && FreeImage_GetOrientation(upright) == FIO_NORMAL);
+				checkPFM(upright, width, height, channels);
+				FreeImage_Unload(upright);
+				FreeImage_Unload(dib);
+			}
+		}
+	}
+
+	// saved files are read back
+	FIBITMAP *src = FreeImage_AllocateT(FIT_RGBF, 19, 7);
+	for (unsigned y = 0; y < 7; y++) {
+		float *row = (float *)FreeImage_GetScanLine(src, y);
+		for (unsigned x = 0; x < 19 * 3; x++) {
+			row[x] = sampleValue(x, y);
+		}
+	}
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(FIF_PFM, src, hmem, 0));
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_PFM, hmem, 0);
+	assert(dib != NULL);
+	assert(memcmp(FreeImage_GetBits(dib), FreeImage_GetBits(src), FreeImage_GetPitch(src) * 7) == 0);
+	FreeImage_Unload(dib);
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(src);
+}
@@ -0,0 +1,329 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static unsigned savePNG(FIBITMAP *dib, int flags, FIBITMAP **loaded) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_PNG, dib, hmem, flags);
+	assert(bResult);
+	const unsigned size = (unsigned)FreeImage_TellMemory(hmem);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	*loaded = FreeImage_LoadFromMemory(FIF_PNG, hmem, 0);
+	assert(*loaded != NULL);
+	FreeImage_CloseMemory(hmem);
+	return size;
+}
+
+static void checkPNGParallel(FIBITMAP *dib) {
+	FIBITMAP *serial = NULL, *parallel = NULL;
+	const unsigned serial_size = savePNG(dib, PNG_DEFAULT, &serial);
+	const unsigned parallel_size = savePNG(dib, PNG_PARALLEL, &parallel);
+
+	// same pixels, about the same size
+	assert(FreeImage_GetImageType(serial) == FreeImage_GetImageType(parallel));
+	assert(FreeImage_GetBPP(serial) == FreeImage_GetBPP(parallel));
+	assert(FreeImage_GetWidth(serial) == FreeImage_GetWidth(parallel) && FreeImage_GetHeight(serial) == FreeImage_GetHeight(parallel));
+	for (unsigned y = 0; y < FreeImage_GetHeight(serial); y++) {
+		assert(memcmp(FreeImage_GetScanLine(serial, y), FreeImage_GetScanLine(parallel, y), FreeImage_GetLine(serial)) == 0);
+	}
+	assert(parallel_size <= serial_size + serial_size / 10);
+
+	FreeImage_Unload(serial);
+	FreeImage_Unload(parallel);
+}
+
+static void checkSamePixels(FIBITMAP *dib1, FIBITMAP *dib2) {
+	assert(FreeImage_GetBPP(dib1) == FreeImage_GetBPP(dib2));
+	assert(FreeImage_GetWidth(dib1) == FreeImage_GetWidth(dib2) && FreeImage_GetHeight(dib1) == FreeImage_GetHeight(dib2));
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		assert(memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), FreeImage_GetLine(dib1)) == 0);
+	}
+}
+
+// Main test function
+// ----------------------------------------------------------
+
+void testPNGParallel(const char *lpszPathName) {
+	printf("testPNGParallel ...\n");
+
+	const unsigned thread_count = FreeImage_GetThreadCount();
+	FreeImage_SetThreadCount(4);
+
+	FIBITMAP *src = FreeImage_Load(FIF_PNG, lpszPathName, 0);
+	assert(src != NULL);
+	FIBITMAP *rgb = FreeImage_ConvertTo24Bits(src);
+	FreeImage_Unload(src);
+	assert(rgb != NULL);
+	// large enough for many bands of rows, odd width
+	FIBITMAP *dib = FreeImage_Rescale(rgb, 1001, 733, FILTER_BILINEAR);
+	FreeImage_Unload(rgb);
+	assert(dib != NULL);
+
+	checkPNGParallel(dib);
+
+	FIBITMAP *converted = FreeImage_ConvertTo32Bits(dib);
+	checkPNGParallel(converted);
+	FreeImage_Unload(converted);
+
+	converted = FreeImage_ConvertToGreyscale(dib);
+	checkPNGParallel(converted);
+	FIBITMAP *mono = FreeImage_Threshold(converted, 128);
+	checkPNGParallel(mono);
+	FreeImage_Invert(mono);
+	FIRGBA8 *pal = FreeImage_GetPalette(mono);
+	pal[0].red = pal[0].green = pal[0].blue = 255;
+	pal[1].red = pal[1].green = pal[1].blue = 0;
+	assert(FreeImage_GetColorType(mono) == FIC_MINISWHITE);
+	checkPNGParallel(mono);
+	FreeImage_Unload(mono);
+	FreeImage_Unload(converted);
+
+	converted = FreeImage_ConvertToRGB16(dib);
+	checkPNGParallel(converted);
+	FreeImage_Unload(converted);
+
+	converted = FreeImage_ConvertToUINT16(dib);
+	checkPNGParallel(converted);
+	FreeImage_Unload(converted);
+
+	// interlaced images are compressed by libpng
+	FIBITMAP *check = NULL;
+	savePNG(dib, PNG_PARALLEL | PNG_INTERLACED, &check);
+	FreeImage_Unload(check);
+
+	FreeImage_Unload(dib);
+	FreeImage_SetThreadCount(thread_count);
+}
+
+void testZLibOptions(const char *lpszPathName) {
+	printf("testZLibOptions ...\n");
+
+	int level = 0;
+	FREE_IMAGE_ZSTRATEGY strategy = FIZS_DEFAULT;
+	assert(FreeImage_GetZLibOptions(FIF_PNG, &level, &strategy));
+	assert(level == -1 && strategy == FIZS_FORMAT_DEFAULT);
+	assert(!FreeImage_SetZLibOptions(FIF_JPEG, 6, FIZS_DEFAULT));
+	assert(!FreeImage_SetZLibOptions(FIF_PNG, 10, FIZS_DEFAULT));
+	assert(!FreeImage_GetZLibOptions(FIF_BMP, &level, &strategy));
+
+	FIBITMAP *dib = FreeImage_Load(FIF_PNG, lpszPathName, 0);
+	assert(dib != NULL);
+
+	// the option level applies when no PNG_Z_* flag is given
+	FIBITMAP *fast = NULL, *best = NULL, *stored = NULL, *rle = NULL;
+	assert(FreeImage_SetZLibOptions(FIF_PNG, 1, FIZS_FORMAT_DEFAULT));
+	const unsigned fast_size = savePNG(dib, PNG_DEFAULT, &fast);
+	assert(FreeImage_SetZLibOptions(FIF_PNG, 9, FIZS_FORMAT_DEFAULT));
+	const unsigned best_size = savePNG(dib, PNG_DEFAULT, &best);
+	assert(best_size <= fast_size);
+	const unsigned stored_size = savePNG(dib, PNG_Z_NO_COMPRESSION, &stored);
+	assert(stored_size > best_size);
+	assert(FreeImage_SetZLibOptions(FIF_PNG, -1, FIZS_RLE));
+	savePNG(dib, PNG_PARALLEL, &rle);
+	checkSamePixels(dib, fast);
+	checkSamePixels(dib, best);
+	checkSamePixels(dib, stored);
+	checkSamePixels(dib, rle);
+	FreeImage_Unload(fast);
+	FreeImage_Unload(best);
+	FreeImage_Unload(stored);
+	FreeImage_Unload(rle);
+	assert(FreeImage_SetZLibOptions(FIF_PNG, -1, FIZS_FORMAT_DEFAULT));
+
+	// whole-buffer functions round trip with any backend and strategy
+	const unsigned size = FreeImage_GetPitch(dib) * FreeImage_GetHeight(dib);
+	const unsigned packed_size = size + size / 1000 + 64;
+	uint8_t *packed = (uint8_t*)malloc(packed_size);
+	uint8_t *unpacked = (uint8_t*)malloc(size);
+	const FREE_IMAGE_ZSTRATEGY strategies[] = { FIZS_FORMAT_DEFAULT, FIZS_FILTERED, FIZS_HUFFMAN_ONLY, FIZS_RLE };
+	for (FREE_IMAGE_ZSTRATEGY s : strategies) {
+		assert(FreeImage_SetZLibOptions(FIF_UNKNOWN, 3, s));
+		unsigned packed_len = FreeImage_ZLibCompress(packed, packed_size, FreeImage_GetBits(dib), size);
+		assert(packed_len > 0);
+		assert(FreeImage_ZLibUncompress(unpacked, size, packed, packed_len) == size);
+		assert(memcmp(unpacked, FreeImage_GetBits(dib), size) == 0);
+		packed_len = FreeImage_ZLibGZip(packed, packed_size, FreeImage_GetBits(dib), size);
+		assert(packed_len > 0);
+		assert(FreeImage_ZLibGUnzip(unpacked, size, packed, packed_len) == size);
+		assert(memcmp(unpacked, FreeImage_GetBits(dib), size) == 0);
+	}
+	assert(FreeImage_SetZLibOptions(FIF_UNKNOWN, -1, FIZS_FORMAT_DEFAULT));
+	free(packed);
+	free(unpacked);
+
+	FreeImage_Unload(dib);
+}
+
+static unsigned DLL_CALLCONV
+fileReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return (unsigned)fread(buffer, size, count, (FILE *)handle);
+}
+
+static int DLL_CALLCONV
+fileSeekProc(fi_handle handle, long offset, int origin) {
+	return fseek((FILE *)handle, offset, origin);
+}
+
+static long DLL_CALLCONV
+fileTellProc(fi_handle handle) {
+	return ftell((FILE *)handle);
+}
+
+static void DLL_CALLCONV
+RowsDecoded(FIBITMAP *dib, unsigned first_row, unsigned count, void *user_data) {
+	unsigned *next_row = (unsigned*)user_data;
+	assert(first_row == *next_row);
+	assert(count > 0 && first_row + count <= FreeImage_GetHeight(dib));
+	*next_row = first_row + count;
+}
+
+static void checkRowCallback(FIBITMAP *dib, int flags) {
+	const char *path = "rows.png";
+	FIBOOL bResult = FreeImage_Save(FIF_PNG, dib, path, flags);
+	assert(bResult);
+
+	FreeImageIO io = { fileReadProc, NULL, fileSeekProc, fileTellProc };
+	FILE *file = fopen(path, "rb");
+	assert(file != NULL);
+
+	// rows are reported in order, each once
+	unsigned next_row = 0;
+	FIBITMAP *loaded = FreeImage_LoadWithRowCallback(FIF_PNG, &io, (fi_handle)file, 0, RowsDecoded, &next_row);
+	fclose(file);
+	assert(loaded != NULL);
+	assert(next_row == FreeImage_GetHeight(loaded));
+	checkSamePixels(dib, loaded);
+	FreeImage_Unload(loaded);
+	remove(path);
+}
+
+void testRowCallback(const char *lpszPathName) {
+	printf("testRowCallback ...\n");
+
+	FIBITMAP *dib = FreeImage_Load(FIF_PNG, lpszPathName, 0);
+	assert(dib != NULL);
+
+	checkRowCallback(dib, PNG_DEFAULT);
+	// interlaced images are reported at the end
+	checkRowCallback(dib, PNG_INTERLACED);
+
+	FreeImage_Unload(dib);
+}
+
+struct PassReport {
+	unsigned passes;
+	unsigned pass_count;
+};
+
+static void DLL_CALLCONV
+PassDecoded(FIBITMAP *dib, unsigned pass, unsigned pass_count, void *user_data) {
+	PassReport *report = (PassReport*)user_data;
+	assert(pass == report->passes);
+	assert(FreeImage_HasPixels(dib));
+	report->passes++;
+	report->pass_count = pass_count;
+}
+
+static void checkPassCallback(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, int flags, unsigned passes, unsigned pass_count) {
+	const char *path = (fif == FIF_GIF) ? "passes.gif" : "passes.png";
+	FIBOOL bResult = FreeImage_Save(fif, dib, path, flags);
+	assert(bResult);
+
+	FreeImageIO io = { fileReadProc, NULL, fileSeekProc, fileTellProc };
+	FILE *file = fopen(path, "rb");
+	assert(file != NULL);
+
+	// every pass but the last is reported, the loaded bitmap is the final image
+	PassReport report = { 0, 0 };
+	FIBITMAP *loaded = FreeImage_LoadProgressive(fif, &io, (fi_handle)file, 0, PassDecoded, &report);
+	fclose(file);
+	assert(loaded != NULL);
+	assert(report.passes == passes && report.pass_count == pass_count);
+	checkSamePixels(dib, loaded);
+	FreeImage_Unload(loaded);
+	remove(path);
+}
+
+void testPassCallback(const char *lpszPathName) {
+	printf("testPassCallback ...\n");
+
+	FIBITMAP *dib = FreeImage_Load(FIF_PNG, lpszPathName, 0);
+	assert(dib != NULL);
+
+	// Adam7 passes
+	checkPassCallback(FIF_PNG, dib, PNG_INTERLACED, 6, 7);
+	checkPassCallback(FIF_PNG, dib, PNG_DEFAULT, 0, 0);
+
+	// GIF interlace passes
+	assert(FreeImage_GetBPP(dib) == 8);
+	FIBITMAP *palettized = FreeImage_Clone(dib);
+	assert(palettized != NULL);
+	const uint8_t interlaced = 1;
+	FITAG *tag = FreeImage_CreateTag();
+	FreeImage_SetTagKey(tag, "Interlaced");
+	FreeImage_SetTagType(tag, FIDT_BYTE);
+	FreeImage_SetTagCount(tag, 1);
+	FreeImage_SetTagLength(tag, 1);
+	FreeImage_SetTagValue(tag, &interlaced);
+	FreeImage_SetMetadata(FIMD_ANIMATION, palettized, "Interlaced", tag);
+	FreeImage_DeleteTag(tag);
+	checkPassCallback(FIF_GIF, palettized, 0, 3, 4);
+
+	FreeImage_Unload(palettized);
+	FreeImage_Unload(dib);
+}
+
+void testPNGTrusted(const char *lpszPathName) {
+	printf("testPNGTrusted ...\n");
+
+	FIBITMAP *dib = FreeImage_Load(FIF_PNG, lpszPathName, 0);
+	assert(dib != NULL);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_PNG, dib, hmem, PNG_DEFAULT);
+	assert(bResult);
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	FreeImage_AcquireMemory(hmem, &data, &size);
+	assert(size > 33);
+
+	// damage the CRC of IHDR (signature, length, type and 13 bytes of data before it)
+	data[29] ^= 0xFF;
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_PNG, hmem, PNG_DEFAULT);
+	assert(loaded == NULL);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	loaded = FreeImage_LoadFromMemory(FIF_PNG, hmem, PNG_FAST_TRUSTED);
+	assert(loaded != NULL);
+	checkSamePixels(dib, loaded);
+	FreeImage_Unload(loaded);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+}
@@ -0,0 +1,109 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static FIBOOL isSameImage(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if ((FreeImage_GetImageType(dib1) != FreeImage_GetImageType(dib2)) || (FreeImage_GetBPP(dib1) != FreeImage_GetBPP(dib2))) {
+		return FALSE;
+	}
+	if ((FreeImage_GetWidth(dib1) != FreeImage_GetWidth(dib2)) || (FreeImage_GetHeight(dib1) != FreeImage_GetHeight(dib2))) {
+		return FALSE;
+	}
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if (memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), FreeImage_GetLine(dib1)) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+// samples with runs and all the byte values
+static FIBITMAP* makePNMImage(FREE_IMAGE_TYPE type, unsigned bpp, unsigned width, unsigned height) {
+	FIBITMAP *dib = FreeImage_AllocateT(type, width, height, bpp);
+	assert(dib != NULL);
+	if (bpp == 8) {
+		FIRGBA8 *pal = FreeImage_GetPalette(dib);
+		for (unsigned i = 0; i < 256; i++) {
+			pal[i].red = pal[i].green = pal[i].blue = (uint8_t)i;
+		}
+	}
+	const unsigned line = FreeImage_GetLine(dib);
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < line; x++) {
+			bits[x] = (uint8_t)((x / 7 % 2) ? (x * 131 + y * 7) : y);
+		}
+	}
+	return dib;
+}
+
+static void checkPNM(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, int flags) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(fif, dib, hmem, flags);
+	assert(bResult);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(fif, hmem, 0);
+	assert(loaded != NULL && isSameImage(dib, loaded));
+	FreeImage_Unload(loaded);
+
+	FreeImage_CloseMemory(hmem);
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testPNM() {
+	printf("testPNM ...\n");
+
+	// large enough for the ASCII samples to be parsed by several segments
+	const struct { FREE_IMAGE_FORMAT fif; FREE_IMAGE_TYPE type; unsigned bpp; } formats[] = {
+		{ FIF_PGM, FIT_BITMAP, 8 },
+		{ FIF_PGM, FIT_UINT16, 16 },
+		{ FIF_PPM, FIT_BITMAP, 24 },
+		{ FIF_PPM, FIT_RGB16, 48 },
+	};
+	for (const auto& format : formats) {
+		FIBITMAP *dib = makePNMImage(format.type, format.bpp, 1203, 701);
+		checkPNM(format.fif, dib, PNM_SAVE_ASCII);
+		checkPNM(format.fif, dib, PNM_SAVE_RAW);
+		FreeImage_Unload(dib);
+	}
+
+	// comments between the samples
+	const char pgm[] = "P2\n# comment 1 2\n3 2\n# 255\n100\n0 50 100\n# 7 8 9\n100 50 0\n";
+	FIMEMORY *hmem = FreeImage_OpenMemory((uint8_t*)pgm, (uint32_t)strlen(pgm));
+	FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_PGM, hmem, 0);
+	assert(dib != NULL && FreeImage_GetWidth(dib) == 3 && FreeImage_GetHeight(dib) == 2);
+	const uint8_t *top = FreeImage_GetScanLine(dib, 1);
+	const uint8_t *bottom = FreeImage_GetScanLine(dib, 0);
+	assert(top[0] == 0 && top[1] == 127 && top[2] == 255);
+	assert(bottom[0] == 255 && bottom[1] == 127 && bottom[2] == 0);
+	FreeImage_Unload(dib);
+	FreeImage_CloseMemory(hmem);
+}
@@ -0,0 +1,218 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static void put16(std::vector<uint8_t>& data, unsigned value) {
+	data.push_back((uint8_t)(value >> 8));
+	data.push_back((uint8_t)value);
+}
+
+static void put32(std::vector<uint8_t>& data, uint32_t value) {
+	put16(data, value >> 16);
+	put16(data, value & 0xFFFF);
+}
+
+static void putString(std::vector<uint8_t>& data, const char *text) {
+	data.insert(data.end(), text, text + strlen(text));
+}
+
+struct PSDTestChannel {
+	short id;
+	std::vector<uint8_t> data;	// compression and image data
+};
+
+// layer record with no mask and no blending ranges, the name is padded to a multiple of 4
+static void putLayerRecord(std::vector<uint8_t>& data, int top, int left, int bottom, int right, const std::vector<PSDTestChannel>& channels, uint8_t opacity, uint8_t flags, const char *name) {
+	put32(data, top);
+	put32(data, left);
+	put32(data, bottom);
+	put32(data, right);
+	put16(data, (unsigned)channels.size());
+	for (const PSDTestChannel& channel : channels) {
+		put16(data, (uint16_t)channel.id);
+		put32(data, (uint32_t)channel.data.size());
+	}
+	putString(data, "8BIMnorm");
+	data.push_back(opacity);
+	data.push_back(0);
+	data.push_back(flags);
+	data.push_back(0);
+	const unsigned nNameBytes = (1 + (unsigned)strlen(name) + 3) & ~3;
+	put32(data, 8 + nNameBytes);
+	put32(data, 0);
+	put32(data, 0);
+	data.push_back((uint8_t)strlen(name));
+	putString(data, name);
+	data.resize(data.size() + nNameBytes - 1 - strlen(name), 0);
+}
+
+// raw channel of width x height pixels
+static PSDTestChannel makeRawChannel(short id, unsigned width, unsigned height, unsigned base) {
+	PSDTestChannel channel = { id, {} };
+	put16(channel.data, 0);
+	for (unsigned y = 0; y < height; y++) {
+		for (unsigned x = 0; x < width; x++) {
+			channel.data.push_back((uint8_t)(base + x + width * y));
+		}
+	}
+	return channel;
+}
+
+// PackBits channel of 3 x 2 pixels, rows are literal packets or a repeated value
+static PSDTestChannel makeRLEChannel(short id, bool literal, uint8_t value) {
+	PSDTestChannel channel = { id, {} };
+	put16(channel.data, 1);
+	put16(channel.data, literal ? 4 : 2);
+	put16(channel.data, literal ? 4 : 2);
+	for (unsigned y = 0; y < 2; y++) {
+		if (literal) {
+			channel.data.push_back(2);
+			for (unsigned x = 0; x < 3; x++) {
+				channel.data.push_back((uint8_t)(value + x + 3 * y));
+			}
+		} else {
+			channel.data.push_back(0xFE);
+			channel.data.push_back(value);
+		}
+	}
+	return channel;
+}
+
+// 8 x 4 RGB document with a raw layer and a transparent, hidden RLE layer
+static std::vector<uint8_t> makePSD() {
+	std::vector<PSDTestChannel> raw_channels = { makeRawChannel(0, 4, 2, 10), makeRawChannel(1, 4, 2, 100), makeRawChannel(2, 4, 2, 200) };
+	std::vector<PSDTestChannel> rle_channels = { makeRLEChannel(-1, false, 0x80), makeRLEChannel(0, true, 1), makeRLEChannel(1, false, 50), makeRLEChannel(2, false, 60) };
+
+	std::vector<uint8_t> layers;
+	put16(layers, 2);
+	putLayerRecord(layers, 1, 2, 3, 6, raw_channels, 255, 0, "Raw");
+	putLayerRecord(layers, 0, 0, 2, 3, rle_channels, 128, 2, "Rle");
+	for (const PSDTestChannel& channel : raw_channels) {
+		layers.insert(layers.end(), channel.data.begin(), channel.data.end());
+	}
+	for (const PSDTestChannel& channel : rle_channels) {
+		layers.insert(layers.end(), channel.data.begin(), channel.data.end());
+	}
+	if (layers.size() % 2) {
+		layers.push_back(0);
+	}
+
+	std::vector<uint8_t> data;
+	putString(data, "8BPS");
+	put16(data, 1);
+	data.resize(data.size() + 6, 0);
+	put16(data, 3);
+	put32(data, 4);		// height
+	put32(data, 8);		// width
+	put16(data, 8);
+	put16(data, 3);		// RGB
+	put32(data, 0);		// color mode data
+	put32(data, 0);		// image resources
+	put32(data, 4 + (uint32_t)layers.size() + 4);
+	put32(data, (uint32_t)layers.size());
+	data.insert(data.end(), layers.begin(), layers.end());
+	put32(data, 0);		// global layer mask info
+	// raw composite image
+	put16(data, 0);
+	for (unsigned c = 0; c < 3; c++) {
+		for (unsigned y = 0; y < 4; y++) {
+			for (unsigned x = 0; x < 8; x++) {
+				data.push_back((uint8_t)(c == 0 ? x : (c == 1 ? y : x + y)));
+			}
+		}
+	}
+	return data;
+}
+
+static const char* getComment(FIBITMAP *dib, const char *key) {
+	FITAG *tag = NULL;
+	FreeImage_GetMetadata(FIMD_COMMENTS, dib, key, &tag);
+	return tag ? (const char*)FreeImage_GetTagValue(tag) : "";
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testPSDLayers() {
+	printf("testPSDLayers ...\n");
+
+	std::vector<uint8_t> psd = makePSD();
+	FIMEMORY *hmem = FreeImage_OpenMemory(psd.data(), (uint32_t)psd.size());
+
+	// single page loads return the composite image
+	FIBITMAP *composite = FreeImage_LoadFromMemory(FIF_PSD, hmem, 0);
+	assert(composite != NULL && FreeImage_GetWidth(composite) == 8 && FreeImage_GetHeight(composite) == 4);
+	for (unsigned y = 0; y < 4; y++) {
+		const uint8_t *bits = FreeImage_GetScanLine(composite, 3 - y);
+		const unsigned bpp = FreeImage_GetBPP(composite) / 8;
+		for (unsigned x = 0; x < 8; x++, bits += bpp) {
+			assert(bits[FI_RGBA_RED] == x && bits[FI_RGBA_GREEN] == y && bits[FI_RGBA_BLUE] == x + y);
+		}
+	}
+	FreeImage_Unload(composite);
+
+	// the composite is followed by the layers
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIMULTIBITMAP *mbmp = FreeImage_LoadMultiBitmapFromMemory(FIF_PSD, hmem, 0);
+	assert(mbmp != NULL);
+	assert(FreeImage_GetPageCount(mbmp) == 3);
+
+	FIBITMAP *layer = FreeImage_LockPage(mbmp, 1);
+	assert(layer != NULL && FreeImage_GetBPP(layer) == 32);
+	assert(FreeImage_GetWidth(layer) == 4 && FreeImage_GetHeight(layer) == 2);
+	assert(strcmp(getComment(layer, "Psd.Layer.Name"), "Raw") == 0);
+	assert(strcmp(getComment(layer, "Psd.Layer.Left"), "2") == 0 && strcmp(getComment(layer, "Psd.Layer.Top"), "1") == 0);
+	assert(strcmp(getComment(layer, "Psd.Layer.Visible"), "1") == 0);
+	for (unsigned y = 0; y < 2; y++) {
+		const uint8_t *bits = FreeImage_GetScanLine(layer, 1 - y);
+		for (unsigned x = 0; x < 4; x++, bits += 4) {
+			const unsigned i = x + 4 * y;
+			assert(bits[FI_RGBA_RED] == 10 + i && bits[FI_RGBA_GREEN] == 100 + i && bits[FI_RGBA_BLUE] == 200 + i);
+			assert(bits[FI_RGBA_ALPHA] == 0xFF);
+		}
+	}
+	FreeImage_UnlockPage(mbmp, layer, FALSE);
+
+	layer = FreeImage_LockPage(mbmp, 2);
+	assert(layer != NULL && FreeImage_GetWidth(layer) == 3 && FreeImage_GetHeight(layer) == 2);
+	assert(strcmp(getComment(layer, "Psd.Layer.Name"), "Rle") == 0);
+	assert(strcmp(getComment(layer, "Psd.Layer.Opacity"), "128") == 0 && strcmp(getComment(layer, "Psd.Layer.BlendMode"), "norm") == 0);
+	assert(strcmp(getComment(layer, "Psd.Layer.Visible"), "0") == 0);
+	for (unsigned y = 0; y < 2; y++) {
+		const uint8_t *bits = FreeImage_GetScanLine(layer, 1 - y);
+		for (unsigned x = 0; x < 3; x++, bits += 4) {
+			assert(bits[FI_RGBA_RED] == 1 + x + 3 * y && bits[FI_RGBA_GREEN] == 50 && bits[FI_RGBA_BLUE] == 60);
+			assert(bits[FI_RGBA_ALPHA] == 0x80);
+		}
+	}
+	FreeImage_UnlockPage(mbmp, layer, FALSE);
+
+	FreeImage_CloseMultiBitmap(mbmp, 0);
+	FreeImage_CloseMemory(hmem);
+}
@@ -0,0 +1,180 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <cstring>
+
+// Local test functions
+// ----------------------------------------------------------
+
+/**
+Fill an image with a deterministic pattern, palettes get a grey ramp
+*/
+static void fillPattern(FIBITMAP *dib) {
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned line = FreeImage_GetLine(dib);
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < line; x++) {
+			bits[x] = (uint8_t)(x * 31 + y * 7);
+		}
+	}
+	FIRGBA8 *pal = FreeImage_GetPalette(dib);
+	for (unsigned i = 0; i < FreeImage_GetColorsUsed(dib); i++) {
+		pal[i].red = (uint8_t)i;
+		pal[i].green = (uint8_t)(255 - i);
+		pal[i].blue = (uint8_t)(i * 3);
+	}
+}
+
+static void checkSame(FIBITMAP *dib, FIBITMAP *expected) {
+	assert(dib && expected);
+	assert(FreeImage_GetBPP(dib) == FreeImage_GetBPP(expected));
+	assert(FreeImage_GetWidth(dib) == FreeImage_GetWidth(expected));
+	assert(FreeImage_GetHeight(dib) == FreeImage_GetHeight(expected));
+	assert(FreeImage_GetDotsPerMeterX(dib) == FreeImage_GetDotsPerMeterX(expected));
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		assert(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(expected, y), FreeImage_GetLine(dib)) == 0);
+	}
+}
+
+/**
+Replaces dib by the result of an allocating operation
+*/
+static FIBITMAP* replace(FIBITMAP *dib, FIBITMAP *result) {
+	FreeImage_Unload(dib);
+	return result;
+}
+
+static void testPipelineChain(FREE_IMAGE_TYPE type, unsigned bpp) {
+	uint8_t curve[256];
+	for (unsigned i = 0; i < 256; i++) {
+		curve[i] = (uint8_t)((i * i) / 255);
+	}
+
+	FIBITMAP *src = FreeImage_AllocateT(type, 301, 157, bpp);
+	assert(src != NULL);
+	fillPattern(src);
+	FreeImage_SetDotsPerMeterX(src, 3937);
+
+	// convert, adjust, rescale, adjust again and premultiply
+	FIPIPELINE *pipeline = FreeImage_CreatePipeline();
+	assert(pipeline != NULL);
+	assert(FreeImage_PipelineConvertTo32Bits(pipeline));
+	assert(FreeImage_PipelineAdjustCurve(pipeline, curve, FICC_ALPHA));
+	assert(FreeImage_PipelineAdjustColors(pipeline, 10, -20, 1.2));
+	assert(FreeImage_PipelineRescale(pipeline, 120, 64, FILTER_BILINEAR));
+	assert(FreeImage_PipelineAdjustCurve(pipeline, curve, FICC_GREEN));
+	assert(FreeImage_PipelineInvert(pipeline));
+	assert(FreeImage_PipelinePreMultiplyWithAlpha(pipeline));
+	assert(FreeImage_PipelineAdjustColors(pipeline, 0, 0, 0.8));
+
+	FIBITMAP *expected = FreeImage_ConvertTo32Bits(src);
+	FreeImage_AdjustCurve(expected, curve, FICC_ALPHA);
+	FreeImage_AdjustColors(expected, 10, -20, 1.2);
+	expected = replace(expected, FreeImage_Rescale(expected, 120, 64, FILTER_BILINEAR));
+	FreeImage_AdjustCurve(expected, curve, FICC_GREEN);
+	FreeImage_Invert(expected);
+	FreeImage_PreMultiplyWithAlpha(expected);
+	FreeImage_AdjustColors(expected, 0, 0, 0.8);
+
+	FIBITMAP *dib = FreeImage_ExecutePipeline(pipeline, src);
+	checkSame(dib, expected);
+	FreeImage_Unload(dib);
+
+	// the same pipeline may be executed again, with any number of threads
+	FreeImage_SetThreadCount(1);
+	dib = FreeImage_ExecutePipeline(pipeline, src);
+	FreeImage_SetThreadCount(0);
+	checkSame(dib, expected);
+	FreeImage_Unload(dib);
+	FreeImage_Unload(expected);
+	FreeImage_DeletePipeline(pipeline);
+
+	// 24-bit point operations after a conversion, without rescale
+	pipeline = FreeImage_CreatePipeline();
+	FreeImage_PipelineConvertTo24Bits(pipeline);
+	FreeImage_PipelineInvert(pipeline);
+	FreeImage_PipelineAdjustCurve(pipeline, curve, FICC_RGB);
+
+	expected = FreeImage_ConvertTo24Bits(src);
+	FreeImage_Invert(expected);
+	FreeImage_AdjustCurve(expected, curve, FICC_RGB);
+
+	dib = FreeImage_ExecutePipeline(pipeline, src);
+	checkSame(dib, expected);
+	FreeImage_Unload(dib);
+	FreeImage_Unload(expected);
+	FreeImage_DeletePipeline(pipeline);
+
+	FreeImage_Unload(src);
+}
+
+void testPipeline() {
+	printf("testPipeline ...\n");
+
+	testPipelineChain(FIT_BITMAP, 8);
+	testPipelineChain(FIT_BITMAP, 24);
+	testPipelineChain(FIT_BITMAP, 32);
+	testPipelineChain(FIT_RGBA16, 64);
+
+	// point operations run directly on a 32-bit source, which is left untouched
+	FIBITMAP *src = FreeImage_Allocate(64, 33, 32);
+	fillPattern(src);
+	FIBITMAP *reference = FreeImage_Clone(src);
+	FIBITMAP *expected = FreeImage_Clone(src);
+	FreeImage_PreMultiplyWithAlpha(expected);
+
+	FIPIPELINE *pipeline = FreeImage_CreatePipeline();
+	FreeImage_PipelinePreMultiplyWithAlpha(pipeline);
+	FIBITMAP *dib = FreeImage_ExecutePipeline(pipeline, src);
+	checkSame(dib, expected);
+	checkSame(src, reference);
+	FreeImage_Unload(dib);
+	FreeImage_DeletePipeline(pipeline);
+
+	// an empty pipeline clones
+	pipeline = FreeImage_CreatePipeline();
+	dib = FreeImage_ExecutePipeline(pipeline, src);
+	checkSame(dib, reference);
+	FreeImage_Unload(dib);
+
+	// operations which don't apply are reported
+	FreeImage_PipelineConvertTo24Bits(pipeline);
+	FreeImage_PipelinePreMultiplyWithAlpha(pipeline);
+	assert(FreeImage_ExecutePipeline(pipeline, src) == NULL);
+	FreeImage_DeletePipeline(pipeline);
+
+	FIBITMAP *grey = FreeImage_Allocate(64, 33, 8);
+	pipeline = FreeImage_CreatePipeline();
+	FreeImage_PipelineInvert(pipeline);
+	assert(FreeImage_ExecutePipeline(pipeline, grey) == NULL);
+	assert(!FreeImage_PipelineRescale(pipeline, 0, 10));
+	assert(!FreeImage_PipelineAdjustCurve(pipeline, NULL, FICC_RGB));
+	FreeImage_DeletePipeline(pipeline);
+	FreeImage_Unload(grey);
+
+	FreeImage_Unload(expected);
+	FreeImage_Unload(reference);
+	FreeImage_Unload(src);
+}
@@ -21,6 +21,10 @@
 
 
 #include "TestSuite.h"
+#include "FreeImage.hpp"
+#include <string.h>
+#include <initializer_list>
+#include <memory>
 
 // Show plugins
 // ----------------------------------------------------------
@@ -38,3 +42,202 @@ void showPlugins() {
 	printf("\n");
 }
 
+
+// Plugin features
+// ----------------------------------------------------------
+
+// memory IO over a FIMEMORY
+static unsigned DLL_CALLCONV memReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_ReadMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static unsigned DLL_CALLCONV memWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_WriteMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static int DLL_CALLCONV memSeekProc(fi_handle handle, long offset, int origin) {
+	return FreeImage_SeekMemory((FIMEMORY*)handle, offset, origin) ? 0 : -1;
+}
+
+static long DLL_CALLCONV memTellProc(fi_handle handle) {
+	return FreeImage_TellMemory((FIMEMORY*)handle);
+}
+
+// "RAMP" followed by the 16-bit width and height, pixels are computed from their position
+static const unsigned RAMP_HEADER = 8;
+
+static uint8_t rampValue(unsigned x, unsigned y) {
+	return (uint8_t)(x * 3 + y * 7);
+}
+
+static bool readRampHeader(FreeImageIO *io, fi_handle handle, unsigned *width, unsigned *height) {
+	uint8_t header[RAMP_HEADER];
+	if (io->read_proc(header, 1, RAMP_HEADER, handle) != RAMP_HEADER || memcmp(header, "RAMP", 4) != 0) {
+		return false;
+	}
+	*width = header[4] | (header[5] << 8);
+	*height = header[6] | (header[7] << 8);
+	return true;
+}
+
+// greyscale bitmap of the left, top, right, bottom rectangle of the image
+static FIBITMAP* allocateRamp(unsigned left, unsigned top, unsigned right, unsigned bottom, bool header_only) {
+	FIBITMAP *dib = FreeImage_AllocateHeader(header_only, right - left, bottom - top, 8);
+	if (dib) {
+		FIRGBA8 *pal = FreeImage_GetPalette(dib);
+		for (unsigned i = 0; i < 256; i++) {
+			pal[i].red = pal[i].green = pal[i].blue = (uint8_t)i;
+		}
+		if (!header_only) {
+			for (unsigned y = top; y < bottom; y++) {
+				uint8_t *bits = FreeImage_GetScanLine(dib, bottom - 1 - y);
+				for (unsigned x = left; x < right; x++) {
+					bits[x - left] = rampValue(x, y);
+				}
+			}
+		}
+	}
+	return dib;
+}
+
+class RampPlugin : public fi::Plugin2
+{
+public:
+	RampPlugin(const char *format, bool fast)
+		: mFormat(format), mFast(fast)
+	{ }
+
+	const char* FormatProc() override { return mFormat; }
+	const char* DescriptionProc() override { return "Synthetic ramp"; }
+	const char* ExtensionListProc() override { return "ramp"; }
+
+	bool ValidateProc(FreeImageIO *io, fi_handle handle) override {
+		unsigned width, height;
+		return readRampHeader(io, handle, &width, &height);
+	}
+
+	FIBITMAP* LoadProc(FreeImageIO *io, fi_handle handle, uint32_t /*page*/, uint32_t flags, void* /*data*/) override {
+		unsigned width, height;
+		if (!readRampHeader(io, handle, &width, &height)) {
+			return nullptr;
+		}
+		fullLoads++;
+		return allocateRamp(0, 0, width, height, (flags & FIF_LOAD_NOPIXELS) != 0);
+	}
+
+	bool SupportsNoPixelsProc() override { return true; }
+
+	bool SupportsFeatureProc(FREE_IMAGE_FEATURE feature) override {
+		return mFast && (feature == FIFEATURE_REGION_LOAD || feature == FIFEATURE_SCANLINE_READER);
+	}
+
+	FIBITMAP* LoadRegionProc(FreeImageIO *io, fi_handle handle, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t /*flags*/, void* /*data*/) override {
+		unsigned width, height;
+		if (!readRampHeader(io, handle, &width, &height) || right > width || bottom > height) {
+			return nullptr;
+		}
+		regionLoads++;
+		return allocateRamp(left, top, right, bottom, false);
+	}
+
+	struct Reader {
+		unsigned width, height, next;
+	};
+
+	void* OpenScanlineReaderProc(FreeImageIO *io, fi_handle handle, uint32_t /*flags*/, FIBITMAP **info) override {
+		unsigned width, height;
+		if (!readRampHeader(io, handle, &width, &height)) {
+			return nullptr;
+		}
+		// the info bitmap is owned by FreeImage
+		*info = allocateRamp(0, 0, width, height, true);
+		return new Reader{ width, height, 0 };
+	}
+
+	uint32_t ReadScanlinesProc(void *reader, uint8_t *bits, uint32_t count, uint32_t pitch) override {
+		auto *r = static_cast<Reader*>(reader);
+		uint32_t rows = 0;
+		for (; rows < count && r->next < r->height; rows++, r->next++, bits += pitch) {
+			for (unsigned x = 0; x < r->width; x++) {
+				bits[x] = rampValue(x, r->next);
+			}
+			scanlineRows++;
+		}
+		return rows;
+	}
+
+	void CloseScanlineReaderProc(void *reader) override {
+		delete static_cast<Reader*>(reader);
+	}
+
+	unsigned fullLoads = 0;
+	unsigned regionLoads = 0;
+	unsigned scanlineRows = 0;
+
+private:
+	const char *mFormat;
+	bool mFast;
+};
+
+static void checkRamp(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom) {
+	assert(dib != NULL);
+	assert(FreeImage_GetWidth(dib) == right - left && FreeImage_GetHeight(dib) == bottom - top);
+	for (unsigned y = top; y < bottom; y++) {
+		const uint8_t *bits = FreeImage_GetScanLine(dib, bottom - 1 - y);
+		for (unsigned x = left; x < right; x++) {
+			assert(bits[x - left] == rampValue(x, y));
+		}
+	}
+}
+
+void testPluginFeatures() {
+	printf("testPluginFeatures ...\n");
+
+	const unsigned width = 301, height = 203;
+	uint8_t file[RAMP_HEADER] = { 'R', 'A', 'M', 'P', (uint8_t)width, (uint8_t)(width >> 8), (uint8_t)height, (uint8_t)(height >> 8) };
+
+	for (bool fast : { true, false }) {
+		auto plugin = std::make_shared<RampPlugin>(fast ? "RAMPFAST" : "RAMPSLOW", fast);
+		const FREE_IMAGE_FORMAT fif = (FREE_IMAGE_FORMAT)fi::Plugin2::RegisterLocal(plugin);
+		assert(fif != FIF_UNKNOWN);
+
+		assert(FreeImage_FIFSupportsFeature(fif, FIFEATURE_REGION_LOAD) == (fast ? TRUE : FALSE));
+		assert(FreeImage_FIFSupportsFeature(fif, FIFEATURE_SCANLINE_READER) == (fast ? TRUE : FALSE));
+		assert(!FreeImage_FIFSupportsFeature(fif, FIFEATURE_SCALED_LOAD));
+		assert(!FreeImage_FIFSupportsFeature(fif, FIFEATURE_IMAGE_INFO));
+
+		FreeImageIO io;
+		io.read_proc = memReadProc;
+		io.write_proc = memWriteProc;
+		io.seek_proc = memSeekProc;
+		io.tell_proc = memTellProc;
+
+		// regions are decoded by the plugin or cropped from the whole image
+		FIMEMORY *hmem = FreeImage_OpenMemory(file, sizeof(file));
+		FIBITMAP *dib = FreeImage_LoadRegion(fif, &io, (fi_handle)hmem, 17, 31, 250, 32);
+		checkRamp(dib, 17, 31, 250, 32);
+		FreeImage_Unload(dib);
+		FreeImage_CloseMemory(hmem);
+		assert(plugin->regionLoads == (fast ? 1U : 0U));
+		assert(plugin->fullLoads == (fast ? 0U : 1U));
+
+		// rows are decoded by the plugin or copied from the whole image
+		hmem = FreeImage_OpenMemory(file, sizeof(file));
+		FISCANLINEREADER *reader = FreeImage_OpenScanlineReader(fif, &io, (fi_handle)hmem);
+		assert(reader != NULL);
+		FIBITMAP *info = FreeImage_GetScanlineReaderInfo(reader);
+		assert(FreeImage_GetWidth(info) == width && FreeImage_GetHeight(info) == height);
+		dib = FreeImage_Allocate(width, height, 8);
+		const unsigned pitch = FreeImage_GetPitch(dib);
+		unsigned rows = 0;
+		while (rows < height && FreeImage_ReadScanlines(reader, FreeImage_GetScanLine(dib, height - 1 - rows), 1, pitch) == 1) {
+			rows++;
+		}
+		assert(rows == height);
+		FreeImage_CloseScanlineReader(reader);
+		FreeImage_CloseMemory(hmem);
+		checkRamp(dib, 0, 0, width, height);
+		FreeImage_Unload(dib);
+		assert(plugin->scanlineRows == (fast ? height : 0U));
+	}
+}
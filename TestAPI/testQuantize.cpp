@@ -0,0 +1,464 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+
+void testWuQuantizer()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	const unsigned width = 613, height = 401;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib32(FreeImage_ConvertTo32Bits(zone.get()), &::FreeImage_Unload);
+	assert(dib32 != nullptr);
+	// colour the grey zone plate so the three channels differ
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *pixel = FreeImage_GetScanLine(dib32.get(), y);
+		for (unsigned x = 0; x < width; ++x, pixel += 4) {
+			pixel[FI_RGBA_RED] = static_cast<uint8_t>(pixel[FI_RGBA_RED] ^ (x * 3));
+			pixel[FI_RGBA_GREEN] = static_cast<uint8_t>(pixel[FI_RGBA_GREEN] + y);
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib24(FreeImage_ConvertTo24Bits(dib32.get()), &::FreeImage_Unload);
+	assert(dib24 != nullptr);
+
+	FIRGBA8 reserve[4] = { { 255, 0, 0, 0 }, { 0, 255, 0, 0 }, { 0, 0, 255, 0 }, { 255, 255, 255, 0 } };
+
+	for (FIBITMAP *src : { dib24.get(), dib32.get() }) {
+		for (const int reserveSize : { 0, 4 }) {
+			FIRGBA8 *reservePalette = reserveSize ? reserve : nullptr;
+			FreeImage_SetThreadCount(1);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serial(FreeImage_ColorQuantizeEx(src, FIQ_WUQUANT, 256, reserveSize, reservePalette), &::FreeImage_Unload);
+			FreeImage_SetThreadCount(4);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> parallel(FreeImage_ColorQuantizeEx(src, FIQ_WUQUANT, 256, reserveSize, reservePalette), &::FreeImage_Unload);
+			assert(serial != nullptr && parallel != nullptr);
+			assert(FreeImage_GetBPP(serial.get()) == 8 && FreeImage_GetBPP(parallel.get()) == 8);
+			assert(memcmp(FreeImage_GetPalette(serial.get()), FreeImage_GetPalette(parallel.get()), 256 * sizeof(FIRGBA8)) == 0);
+			for (unsigned y = 0; y < height; ++y) {
+				assert(memcmp(FreeImage_GetScanLine(serial.get(), y), FreeImage_GetScanLine(parallel.get(), y), width) == 0);
+			}
+			// every pixel maps to a close palette entry
+			const FIRGBA8 *palette = FreeImage_GetPalette(serial.get());
+			const unsigned bytespp = FreeImage_GetLine(src) / width;
+			for (unsigned y = 0; y < height; y += 7) {
+				const uint8_t *pixel = FreeImage_GetScanLine(src, y);
+				const uint8_t *index = FreeImage_GetScanLine(serial.get(), y);
+				for (unsigned x = 0; x < width; ++x, pixel += bytespp) {
+					const FIRGBA8 &entry = palette[index[x]];
+					assert(std::abs(entry.red - pixel[FI_RGBA_RED]) < 64);
+					assert(std::abs(entry.green - pixel[FI_RGBA_GREEN]) < 64);
+					assert(std::abs(entry.blue - pixel[FI_RGBA_BLUE]) < 64);
+				}
+			}
+		}
+	}
+
+	FreeImage_SetThreadCount(defaultCount);
+}
+
+void testNNQuantizer()
+{
+	const unsigned width = 517, height = 389;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_ConvertTo24Bits(zone.get()), &::FreeImage_Unload);
+	assert(dib != nullptr);
+	// colour the grey zone plate so the three channels differ
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *pixel = FreeImage_GetScanLine(dib.get(), y);
+		for (unsigned x = 0; x < width; ++x, pixel += 3) {
+			pixel[FI_RGBA_RED] = static_cast<uint8_t>(pixel[FI_RGBA_RED] ^ (x * 3));
+			pixel[FI_RGBA_GREEN] = static_cast<uint8_t>(pixel[FI_RGBA_GREEN] + y);
+		}
+	}
+
+	FIRGBA8 reserve[3] = { { 255, 0, 0, 0 }, { 0, 0, 255, 0 }, { 255, 255, 255, 0 } };
+
+	// SIMD training and search give the scalar result, so does the remapping on any number of threads
+	for (const int paletteSize : { 256, 61 }) {
+		for (const int reserveSize : { 0, 3 }) {
+			FIRGBA8 *reservePalette = reserveSize ? reserve : nullptr;
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+			runScalarAndSIMD([&](bool vector) {
+				results[vector].reset(FreeImage_ColorQuantizeEx(dib.get(), FIQ_NNQUANT, paletteSize, reserveSize, reservePalette));
+				assert(results[vector] != nullptr);
+			});
+			FIBITMAP *simd = results[1].get();
+			assert(memcmp(FreeImage_GetPalette(results[0].get()), FreeImage_GetPalette(simd), paletteSize * sizeof(FIRGBA8)) == 0);
+			assert(isSameBitmap(results[0].get(), simd));
+			// reserved colours are the last palette entries
+			const FIRGBA8 *palette = FreeImage_GetPalette(simd);
+			for (int i = 0; i < reserveSize; ++i) {
+				const FIRGBA8 &entry = palette[paletteSize - reserveSize + i];
+				assert(entry.red == reserve[i].red && entry.green == reserve[i].green && entry.blue == reserve[i].blue);
+			}
+			// every pixel maps to a palette entry of the smallest L1 distance
+			for (unsigned y = 0; y < height; y += 5) {
+				const uint8_t *pixel = FreeImage_GetScanLine(dib.get(), y);
+				const uint8_t *index = FreeImage_GetScanLine(simd, y);
+				for (unsigned x = 0; x < width; ++x, pixel += 3) {
+					auto distance = [pixel](const FIRGBA8 &entry) {
+						return std::abs(entry.red - pixel[FI_RGBA_RED]) + std::abs(entry.green - pixel[FI_RGBA_GREEN]) + std::abs(entry.blue - pixel[FI_RGBA_BLUE]);
+					};
+					assert(index[x] < paletteSize);
+					for (int i = 0; i < paletteSize; ++i) {
+						assert(distance(palette[index[x]]) <= distance(palette[i]));
+					}
+				}
+			}
+		}
+	}
+}
+
+void testLFPQuantizer()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	const unsigned width = 803, height = 467;
+
+	// screenshot like image: runs of a few colours, each band of rows brings new colours
+	auto createImage = [=](unsigned bpp, unsigned colors) {
+		FIBITMAP *dib = FreeImage_Allocate(width, height, bpp);
+		assert(dib != nullptr);
+		const unsigned bytespp = bpp / 8;
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t *pixel = FreeImage_GetScanLine(dib, y);
+			for (unsigned x = 0; x < width; ++x, pixel += bytespp) {
+				const unsigned color = ((x / 50) + (y / 9) * 7) % colors;
+				pixel[FI_RGBA_RED] = static_cast<uint8_t>(color * 37);
+				pixel[FI_RGBA_GREEN] = static_cast<uint8_t>(color / 3);
+				pixel[FI_RGBA_BLUE] = static_cast<uint8_t>(color * 11 + (x % 3 == 0 && y % 97 == 5));
+				if (bytespp == 4) {
+					pixel[FI_RGBA_ALPHA] = static_cast<uint8_t>(x);
+				}
+			}
+		}
+		return dib;
+	};
+
+	FIRGBA8 reserve[2] = { { 1, 2, 3, 0 }, { 0, 0, 0, 0 } };
+
+	for (const unsigned bpp : { 24u, 32u }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(createImage(bpp, 120), &::FreeImage_Unload);
+		const unsigned bytespp = bpp / 8;
+		for (const int reserveSize : { 0, 2 }) {
+			FIRGBA8 *reservePalette = reserveSize ? reserve : nullptr;
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+			runScalarAndSIMD([&](bool vector) {
+				results[vector].reset(FreeImage_ColorQuantizeEx(dib.get(), FIQ_LFPQUANT, 256, reserveSize, reservePalette));
+				assert(results[vector] != nullptr);
+			});
+			FIBITMAP *parallel = results[1].get();
+			assert(memcmp(FreeImage_GetPalette(results[0].get()), FreeImage_GetPalette(parallel), 256 * sizeof(FIRGBA8)) == 0);
+			assert(isSameBitmap(results[0].get(), parallel));
+			// lossless, colours are indexed in scan order
+			const FIRGBA8 *palette = FreeImage_GetPalette(parallel);
+			unsigned next = 0;
+			for (unsigned y = 0; y < height; ++y) {
+				const uint8_t *pixel = FreeImage_GetScanLine(dib.get(), y);
+				const uint8_t *index = FreeImage_GetScanLine(parallel, y);
+				for (unsigned x = 0; x < width; ++x, pixel += bytespp) {
+					const FIRGBA8 &entry = palette[index[x]];
+					assert(entry.red == pixel[FI_RGBA_RED] && entry.green == pixel[FI_RGBA_GREEN] && entry.blue == pixel[FI_RGBA_BLUE]);
+					if (index[x] < 256 - reserveSize) {
+						assert(index[x] <= next);
+						next = std::max(next, index[x] + 1u);
+					}
+				}
+			}
+		}
+	}
+
+	// too many colours, though each band of rows has fewer than 256
+	for (const unsigned threads : { 1u, 4u }) {
+		FreeImage_SetThreadCount(threads);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(createImage(24, 300), &::FreeImage_Unload);
+		assert(FreeImage_ColorQuantizeEx(dib.get(), FIQ_LFPQUANT, 256) == nullptr);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> small(createImage(24, 100), &::FreeImage_Unload);
+		assert(FreeImage_ColorQuantizeEx(small.get(), FIQ_LFPQUANT, 64) == nullptr);
+	}
+
+	FreeImage_SetThreadCount(defaultCount);
+}
+
+void testPaletteMapper()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	const unsigned width = 431, height = 277;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> frame(FreeImage_ConvertTo24Bits(zone.get()), &::FreeImage_Unload);
+	assert(frame != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *pixel = FreeImage_GetScanLine(frame.get(), y);
+		for (unsigned x = 0; x < width; ++x, pixel += 3) {
+			pixel[FI_RGBA_RED] = static_cast<uint8_t>(pixel[FI_RGBA_RED] ^ (x * 3));
+			pixel[FI_RGBA_GREEN] = static_cast<uint8_t>(pixel[FI_RGBA_GREEN] + y);
+		}
+	}
+
+	// the palette of a first frame, shared by the following frames
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> first(FreeImage_ColorQuantizeEx(frame.get(), FIQ_WUQUANT, 64), &::FreeImage_Unload);
+	assert(first != nullptr);
+	const FIRGBA8 *palette = FreeImage_GetPalette(first.get());
+
+	assert(FreeImage_CreatePaletteMapper(nullptr, 16) == nullptr);
+	assert(FreeImage_CreatePaletteMapper(palette, 0) == nullptr);
+	assert(FreeImage_CreatePaletteMapper(palette, 257) == nullptr);
+
+	FIPALETTEMAPPER *mapper = FreeImage_CreatePaletteMapper(palette, 64);
+	FIPALETTEMAPPER *dither = FreeImage_CreatePaletteMapper(palette, 64, TRUE);
+	assert(mapper != nullptr && dither != nullptr);
+
+	// a next frame: nearest colours, whatever the number of threads
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> next(FreeImage_Clone(frame.get()), &::FreeImage_Unload);
+	FreeImage_Invert(next.get());
+	FreeImage_SetThreadCount(1);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serial(FreeImage_ApplyPaletteMapper(next.get(), mapper), &::FreeImage_Unload);
+	FreeImage_SetThreadCount(4);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> parallel(FreeImage_ApplyPaletteMapper(next.get(), mapper), &::FreeImage_Unload);
+	assert(serial != nullptr && parallel != nullptr);
+	assert(FreeImage_GetBPP(parallel.get()) == 8);
+	assert(memcmp(FreeImage_GetPalette(parallel.get()), palette, 64 * sizeof(FIRGBA8)) == 0);
+	for (unsigned y = 0; y < height; ++y) {
+		assert(memcmp(FreeImage_GetScanLine(serial.get(), y), FreeImage_GetScanLine(parallel.get(), y), width) == 0);
+		const uint8_t *pixel = FreeImage_GetScanLine(next.get(), y);
+		const uint8_t *index = FreeImage_GetScanLine(parallel.get(), y);
+		for (unsigned x = 0; x < width; ++x, pixel += 3) {
+			auto distance = [pixel](const FIRGBA8 &entry) {
+				const int dr = entry.red - pixel[FI_RGBA_RED], dg = entry.green - pixel[FI_RGBA_GREEN], db = entry.blue - pixel[FI_RGBA_BLUE];
+				return dr * dr + dg * dg + db * db;
+			};
+			unsigned best = 0;
+			for (unsigned i = 1; i < 64; ++i) {
+				if (distance(palette[i]) < distance(palette[best])) {
+					best = i;
+				}
+			}
+			assert(index[x] == best);
+		}
+	}
+
+	// error diffusion keeps the mean colour of a smooth gradient closer than the nearest colours
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> gradient(FreeImage_Allocate(256, 64, 32), &::FreeImage_Unload);
+	for (unsigned y = 0; y < 64; ++y) {
+		uint8_t *pixel = FreeImage_GetScanLine(gradient.get(), y);
+		for (unsigned x = 0; x < 256; ++x, pixel += 4) {
+			pixel[FI_RGBA_RED] = pixel[FI_RGBA_GREEN] = pixel[FI_RGBA_BLUE] = static_cast<uint8_t>(x);
+			pixel[FI_RGBA_ALPHA] = 0xFF;
+		}
+	}
+	const FIRGBA8 greys[4] = { { 0, 0, 0, 0 }, { 85, 85, 85, 0 }, { 170, 170, 170, 0 }, { 255, 255, 255, 0 } };
+	FIPALETTEMAPPER *grey_nearest = FreeImage_CreatePaletteMapper(greys, 4);
+	FIPALETTEMAPPER *grey_dither = FreeImage_CreatePaletteMapper(greys, 4, TRUE);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> nearest(FreeImage_ApplyPaletteMapper(gradient.get(), grey_nearest), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dithered(FreeImage_ApplyPaletteMapper(gradient.get(), grey_dither), &::FreeImage_Unload);
+	assert(nearest != nullptr && dithered != nullptr);
+	double nearest_error = 0, dithered_error = 0;
+	for (unsigned x = 0; x < 256; x += 16) {
+		double nearest_sum = 0, dithered_sum = 0;
+		for (unsigned y = 0; y < 64; ++y) {
+			for (unsigned i = x; i < x + 16; ++i) {
+				nearest_sum += greys[FreeImage_GetScanLine(nearest.get(), y)[i]].red;
+				dithered_sum += greys[FreeImage_GetScanLine(dithered.get(), y)[i]].red;
+			}
+		}
+		const double expected = (x + 7.5) * 16 * 64;
+		nearest_error += std::fabs(nearest_sum - expected);
+		dithered_error += std::fabs(dithered_sum - expected);
+	}
+	assert(dithered_error < nearest_error / 4);
+
+	// other bit depths are converted
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey8(FreeImage_ConvertToGreyscale(gradient.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> mapped8(FreeImage_ApplyPaletteMapper(grey8.get(), grey_nearest), &::FreeImage_Unload);
+	assert(mapped8 != nullptr);
+	for (unsigned y = 0; y < 64; ++y) {
+		assert(memcmp(FreeImage_GetScanLine(mapped8.get(), y), FreeImage_GetScanLine(nearest.get(), y), 256) == 0);
+	}
+	assert(FreeImage_ApplyPaletteMapper(nullptr, mapper) == nullptr);
+	assert(FreeImage_ApplyPaletteMapper(frame.get(), nullptr) == nullptr);
+
+	FreeImage_DeletePaletteMapper(grey_dither);
+	FreeImage_DeletePaletteMapper(grey_nearest);
+	FreeImage_DeletePaletteMapper(dither);
+	FreeImage_DeletePaletteMapper(mapper);
+	FreeImage_SetThreadCount(defaultCount);
+}
+
+void testDitherParallel()
+{
+	const unsigned width = 517, height = 263;
+	const FREE_IMAGE_DITHER algorithms[] = { FID_FS, FID_BAYER4x4, FID_BAYER8x8, FID_BAYER16x16, FID_CLUSTER6x6, FID_CLUSTER8x8, FID_CLUSTER16x16 };
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey(FreeImage_ConvertToGreyscale(zone.get()), &::FreeImage_Unload);
+	assert(grey != nullptr);
+
+	for (const FREE_IMAGE_DITHER algorithm : algorithms) {
+		for (const unsigned levels : { 2u, 5u, 16u, 40u }) {
+			// the wavefront and the SIMD comparisons give the serial scalar result
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+			runScalarAndSIMD([&](bool vector) {
+				results[vector].reset(FreeImage_DitherEx(grey.get(), algorithm, levels));
+				assert(results[vector] != nullptr);
+			});
+			FIBITMAP *parallel = results[1].get();
+
+			const unsigned bpp = (levels == 2) ? 1 : (levels <= 16) ? 4 : 8;
+			assert(FreeImage_GetBPP(parallel) == bpp);
+			assert(isSameBitmap(results[0].get(), parallel));
+
+			// levels are evenly spaced, the first is black and the last is white
+			const FIRGBA8 *pal = FreeImage_GetPalette(parallel);
+			assert(pal[0].red == 0 && pal[levels - 1].red == 255);
+
+			// the mean grey level is kept
+			if (levels > 2) {
+				double mean_src = 0, mean_dst = 0;
+				for (unsigned y = 0; y < height; ++y) {
+					const uint8_t *src = FreeImage_GetScanLine(grey.get(), y);
+					const uint8_t *dst = FreeImage_GetScanLine(parallel, y);
+					for (unsigned x = 0; x < width; ++x) {
+						const unsigned index = (bpp == 8) ? dst[x] : (x & 1) ? (dst[x >> 1] & 0x0F) : (dst[x >> 1] >> 4);
+						assert(index < levels);
+						mean_src += src[x];
+						mean_dst += pal[index].red;
+					}
+				}
+				assert(fabs(mean_src - mean_dst) / ((double)width * height) < 4.0);
+			}
+		}
+		// FreeImage_Dither is the bilevel case
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bilevel(FreeImage_Dither(zone.get(), algorithm), &::FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> two(FreeImage_DitherEx(zone.get(), algorithm, 2), &::FreeImage_Unload);
+		assert(bilevel != nullptr && two != nullptr && isSameBitmap(bilevel.get(), two.get()));
+	}
+
+	assert(FreeImage_DitherEx(grey.get(), FID_FS, 1) == nullptr);
+	assert(FreeImage_DitherEx(grey.get(), FID_FS, 257) == nullptr);
+}
+
+void testBinarize()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	const unsigned width = 301, height = 187;
+
+	// dark strokes on a background lit from the left to the right
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> page(FreeImage_Allocate(width, height, 8), &::FreeImage_Unload);
+	assert(page != nullptr);
+	FIRGBA8 *pal = FreeImage_GetPalette(page.get());
+	for (unsigned i = 0; i < 256; ++i) {
+		pal[i].red = pal[i].green = pal[i].blue = static_cast<uint8_t>(i);
+	}
+	auto stroke = [](unsigned x, unsigned y) { return ((x % 20) < 3) && ((y % 30) > 5); };
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *bits = FreeImage_GetScanLine(page.get(), y);
+		for (unsigned x = 0; x < width; ++x) {
+			const unsigned background = 90 + (160 * x) / width;
+			bits[x] = static_cast<uint8_t>(stroke(x, y) ? background - 70 : background);
+		}
+	}
+	auto bit = [](FIBITMAP *dib, unsigned x, unsigned y) {
+		return (FreeImage_GetScanLine(dib, y)[x >> 3] >> (7 - (x & 7))) & 1;
+	};
+
+	// global threshold: SIMD packing gives the scalar result
+	for (const uint8_t T : { 0, 1, 128, 200, 255 }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+		runScalarAndSIMD([&](bool vector) {
+			results[vector].reset(FreeImage_Threshold(page.get(), T));
+			assert(results[vector] != nullptr);
+		});
+		assert(FreeImage_GetBPP(results[1].get()) == 1);
+		assert(isSameBitmap(results[0].get(), results[1].get()));
+		for (unsigned y = 0; y < height; y += 7) {
+			const uint8_t *bits = FreeImage_GetScanLine(page.get(), y);
+			for (unsigned x = 0; x < width; ++x) {
+				assert(bit(results[1].get(), x, y) == (bits[x] >= T ? 1 : 0));
+			}
+		}
+	}
+
+	// Otsu separates the two classes of a bimodal image
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bimodal(FreeImage_Allocate(width, height, 8), &::FreeImage_Unload);
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *bits = FreeImage_GetScanLine(bimodal.get(), y);
+		for (unsigned x = 0; x < width; ++x) {
+			bits[x] = static_cast<uint8_t>(stroke(x, y) ? 40 + (x % 11) : 180 + (y % 13));
+		}
+	}
+	memcpy(FreeImage_GetPalette(bimodal.get()), pal, 256 * sizeof(FIRGBA8));
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> otsu(FreeImage_Binarize(bimodal.get(), FIB_OTSU), &::FreeImage_Unload);
+	assert(otsu != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		for (unsigned x = 0; x < width; ++x) {
+			assert(bit(otsu.get(), x, y) == (stroke(x, y) ? 0 : 1));
+		}
+	}
+
+	// local thresholds find the strokes under uneven lighting, whatever the number of threads
+	for (const FREE_IMAGE_BINARIZE method : { FIB_MEAN, FIB_SAUVOLA }) {
+		FreeImage_SetThreadCount(1);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serial(FreeImage_Binarize(page.get(), method, 25, 0.2), &::FreeImage_Unload);
+		FreeImage_SetThreadCount(4);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> parallel(FreeImage_Binarize(page.get(), method, 25, 0.2), &::FreeImage_Unload);
+		assert(serial != nullptr && parallel != nullptr);
+		assert(isSameBitmap(serial.get(), parallel.get()));
+		for (unsigned y = 0; y < height; ++y) {
+			for (unsigned x = 0; x < width; ++x) {
+				assert(bit(parallel.get(), x, y) == (stroke(x, y) ? 0 : 1));
+			}
+		}
+	}
+
+	// local mean thresholds match a direct computation over the clipped windows
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> mean(FreeImage_Binarize(page.get(), FIB_MEAN, 7, 0.05), &::FreeImage_Unload);
+	assert(mean != nullptr);
+	for (unsigned y = 0; y < height; y += 5) {
+		for (unsigned x = 0; x < width; x += 3) {
+			unsigned sum = 0, count = 0;
+			for (unsigned j = (y > 3 ? y - 3 : 0); j < std::min(height, y + 4); ++j) {
+				for (unsigned i = (x > 3 ? x - 3 : 0); i < std::min(width, x + 4); ++i) {
+					sum += FreeImage_GetScanLine(page.get(), j)[i];
+					++count;
+				}
+			}
+			const unsigned value = FreeImage_GetScanLine(page.get(), y)[x];
+			assert(bit(mean.get(), x, y) == (value > floor((double)sum / count * 0.95) ? 1 : 0));
+		}
+	}
+
+	assert(FreeImage_Binarize(page.get(), FIB_SAUVOLA, 1) == nullptr);
+	assert(FreeImage_Binarize(page.get(), FIB_SAUVOLA, 301) == nullptr);
+
+	FreeImage_SetThreadCount(defaultCount);
+}
@@ -0,0 +1,175 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static void putShort(std::vector<uint8_t>& buffer, size_t offset, uint16_t value) {
+	buffer[offset] = (uint8_t)value;
+	buffer[offset + 1] = (uint8_t)(value >> 8);
+}
+
+static void putLong(std::vector<uint8_t>& buffer, size_t offset, uint32_t value) {
+	putShort(buffer, offset, (uint16_t)value);
+	putShort(buffer, offset + 2, (uint16_t)(value >> 16));
+}
+
+/**
+Builds a little endian DNG holding an uncompressed linear RGB 48-bit image (LinearRaw photometric interpretation)
+*/
+static std::vector<uint8_t> createLinearDNG(unsigned width, unsigned height) {
+	struct Entry {
+		uint16_t tag, type;
+		uint32_t count, value;
+	};
+	const char model[] = "FreeImage Test";
+	const uint32_t entries = 19;
+	const uint32_t ifd = 8;
+	const uint32_t extra = ifd + 2 + entries * 12 + 4;
+	const uint32_t bps = extra;								// 3 SHORT
+	const uint32_t make = bps + 6;							// 10 ASCII
+	const uint32_t name = make + 10;						// 15 ASCII, 16 bytes
+	const uint32_t matrix = name + 16;						// 9 SRATIONAL
+	const uint32_t pixels = matrix + 9 * 8;
+	const uint32_t bytes = width * height * 6;
+
+	const Entry ifdEntries[entries] = {
+		{ 254, 4, 1, 0 },				// NewSubFileType: main image
+		{ 256, 4, 1, width },			// ImageWidth
+		{ 257, 4, 1, height },			// ImageLength
+		{ 258, 3, 3, bps },				// BitsPerSample
+		{ 259, 3, 1, 1 },				// Compression: none
+		{ 262, 3, 1, 34892 },			// PhotometricInterpretation: LinearRaw
+		{ 271, 2, 10, make },			// Make
+		{ 272, 2, 15, name },			// Model
+		{ 273, 4, 1, pixels },			// StripOffsets
+		{ 274, 3, 1, 1 },				// Orientation
+		{ 277, 3, 1, 3 },				// SamplesPerPixel
+		{ 278, 4, 1, height },			// RowsPerStrip
+		{ 279, 4, 1, bytes },			// StripByteCounts
+		{ 284, 3, 1, 1 },				// PlanarConfiguration: chunky
+		{ 50706, 1, 4, 0x00000401 },	// DNGVersion 1.4.0.0
+		{ 50708, 2, 15, name },			// UniqueCameraModel
+		{ 50717, 4, 1, 65535 },			// WhiteLevel
+		{ 50721, 10, 9, matrix },		// ColorMatrix1
+		{ 50778, 3, 1, 21 }				// CalibrationIlluminant1: D65
+	};
+
+	std::vector<uint8_t> buffer(pixels + bytes, 0);
+	buffer[0] = buffer[1] = 'I';
+	putShort(buffer, 2, 42);
+	putLong(buffer, 4, ifd);
+	putShort(buffer, ifd, (uint16_t)entries);
+	for (uint32_t i = 0; i < entries; i++) {
+		const size_t offset = ifd + 2 + i * 12;
+		const Entry& entry = ifdEntries[i];
+		putShort(buffer, offset, entry.tag);
+		putShort(buffer, offset + 2, entry.type);
+		putLong(buffer, offset + 4, entry.count);
+		if ((entry.type == 3) && (entry.count == 1)) {
+			putShort(buffer, offset + 8, (uint16_t)entry.value);
+		} else {
+			putLong(buffer, offset + 8, entry.value);
+		}
+	}
+	for (unsigned c = 0; c < 3; c++) {
+		putShort(buffer, bps + 2 * c, 16);
+	}
+	memcpy(&buffer[make], "FreeImage", 10);
+	memcpy(&buffer[name], model, sizeof(model));
+	// identity XYZ to camera matrix
+	for (unsigned i = 0; i < 9; i++) {
+		putLong(buffer, matrix + 8 * i, (i % 4 == 0) ? 1 : 0);
+		putLong(buffer, matrix + 8 * i + 4, 1);
+	}
+	for (unsigned y = 0; y < height; y++) {
+		for (unsigned x = 0; x < width; x++) {
+			const size_t offset = pixels + (y * width + x) * 6;
+			putShort(buffer, offset, (uint16_t)(x * 65535 / width));
+			putShort(buffer, offset + 2, (uint16_t)(y * 65535 / height));
+			putShort(buffer, offset + 4, (uint16_t)((x + y) * 65535 / (width + height)));
+		}
+	}
+	return buffer;
+}
+
+static bool isSameImage(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if ((FreeImage_GetImageType(dib1) != FreeImage_GetImageType(dib2)) || (FreeImage_GetBPP(dib1) != FreeImage_GetBPP(dib2))) {
+		return false;
+	}
+	if ((FreeImage_GetWidth(dib1) != FreeImage_GetWidth(dib2)) || (FreeImage_GetHeight(dib1) != FreeImage_GetHeight(dib2))) {
+		return false;
+	}
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if (memcmp(FreeImage_GetConstScanLine(dib1, y), FreeImage_GetConstScanLine(dib2, y), FreeImage_GetLine(dib1)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testRAWMemory() {
+	printf("testRAWMemory ...\n");
+
+	const unsigned width = 64, height = 48;
+	std::vector<uint8_t> dng = createLinearDNG(width, height);
+	FILE *file = fopen("raw.dng", "wb");
+	assert(file != NULL);
+	assert(fwrite(dng.data(), 1, dng.size(), file) == dng.size());
+	fclose(file);
+
+	// a file handle is read through the FreeImageIO datastream
+	FIBITMAP *reference = FreeImage_Load(FIF_RAW, "raw.dng", RAW_DEFAULT);
+	assert(reference != NULL);
+	assert(FreeImage_GetImageType(reference) == FIT_RGB16);
+	assert((FreeImage_GetWidth(reference) == width) && (FreeImage_GetHeight(reference) == height));
+
+	// memory streams are read in place through a buffer datastream, the stream is then at its end
+	FIMEMORY *hmem = FreeImage_OpenMemory(dng.data(), (uint32_t)dng.size());
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_RAW, hmem, RAW_DEFAULT);
+	assert(loaded != NULL && isSameImage(reference, loaded));
+	assert(FreeImage_TellMemory(hmem) == (long)dng.size());
+	FreeImage_Unload(loaded);
+
+	// the header only
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *header = FreeImage_LoadFromMemory(FIF_RAW, hmem, FIF_LOAD_NOPIXELS);
+	assert(header != NULL && !FreeImage_HasPixels(header));
+	assert((FreeImage_GetWidth(header) == width) && (FreeImage_GetHeight(header) == height));
+	FreeImage_Unload(header);
+	FreeImage_CloseMemory(hmem);
+
+	// mapped files go through the same buffer datastream
+	FIBITMAP *mapped = FreeImage_LoadMapped(FIF_RAW, "raw.dng", RAW_DEFAULT);
+	assert(mapped != NULL && isSameImage(reference, mapped));
+	FreeImage_Unload(mapped);
+
+	FreeImage_Unload(reference);
+}
@@ -0,0 +1,96 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static FIBOOL isSameImage(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if ((FreeImage_GetBPP(dib1) != FreeImage_GetBPP(dib2)) || (FreeImage_GetWidth(dib1) != FreeImage_GetWidth(dib2)) || (FreeImage_GetHeight(dib1) != FreeImage_GetHeight(dib2))) {
+		return FALSE;
+	}
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if (memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), FreeImage_GetLine(dib1)) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+// long runs, short runs and literal packets
+static FIBITMAP* makeRLEImage(unsigned bpp, unsigned width, unsigned height) {
+	FIBITMAP *dib = FreeImage_Allocate(width, height, bpp);
+	assert(dib != NULL);
+	if (bpp == 8) {
+		FIRGBA8 *pal = FreeImage_GetPalette(dib);
+		for (unsigned i = 0; i < 256; i++) {
+			pal[i].red = pal[i].green = pal[i].blue = (uint8_t)i;
+		}
+	}
+	const unsigned bytespp = bpp / 8;
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < width; x++) {
+			const unsigned run = (y % 3 == 0) ? 300 : (y % 3 == 1) ? 5 : 1;
+			for (unsigned c = 0; c < bytespp; c++) {
+				bits[x * bytespp + c] = (uint8_t)((x / run) * 37 + y + c * 91);
+			}
+		}
+	}
+	return dib;
+}
+
+static void checkRLE(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, int flags) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(fif, dib, hmem, flags);
+	assert(bResult);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(fif, hmem, 0);
+	assert(loaded != NULL && isSameImage(dib, loaded));
+	FreeImage_Unload(loaded);
+
+	FreeImage_CloseMemory(hmem);
+}
+
+// Main test functions
+// ----------------------------------------------------------
+
+void testRLE() {
+	printf("testRLE ...\n");
+
+	// Targa packets spanning several lines and cache refills
+	const unsigned bpps[] = { 8, 24, 32 };
+	for (unsigned bpp : bpps) {
+		FIBITMAP *dib = makeRLEImage(bpp, 1031, 397);
+		checkRLE(FIF_TARGA, dib, TARGA_SAVE_RLE);
+		FreeImage_Unload(dib);
+	}
+
+	// 8-bit BMP with encoded and absolute runs
+	FIBITMAP *dib = makeRLEImage(8, 1031, 397);
+	checkRLE(FIF_BMP, dib, BMP_SAVE_RLE);
+	FreeImage_Unload(dib);
+}
@@ -0,0 +1,166 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+#include <vector>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static void put16(std::vector<uint8_t>& data, unsigned value) {
+	data.push_back((uint8_t)(value >> 8));
+	data.push_back((uint8_t)value);
+}
+
+static void put32(std::vector<uint8_t>& data, uint32_t value) {
+	put16(data, value >> 16);
+	put16(data, value & 0xFFFF);
+}
+
+static uint8_t sampleValue(unsigned channel, unsigned x, unsigned y) {
+	return (uint8_t)((x / 5) * 7 + y * 3 + channel * 50 + ((x * y) % 3 ? 0 : x));
+}
+
+// repeat runs for 3 or more equal bytes, literal runs otherwise, terminated by a zero count
+static void putRLERow(std::vector<uint8_t>& data, const uint8_t *row, unsigned width) {
+	unsigned x = 0;
+	while (x < width) {
+		unsigned n = 1;
+		while ((x + n < width) && (n < 127) && (row[x + n] == row[x])) {
+			n++;
+		}
+		if (n >= 3) {
+			data.push_back((uint8_t)n);
+			data.push_back(row[x]);
+			x += n;
+			continue;
+		}
+		n = 0;
+		while ((x + n < width) && (n < 127) && !((x + n + 2 < width) && (row[x + n] == row[x + n + 1]) && (row[x + n] == row[x + n + 2]))) {
+			n++;
+		}
+		data.push_back((uint8_t)(0x80 | n));
+		data.insert(data.end(), row + x, row + x + n);
+		x += n;
+	}
+	data.push_back(0);
+}
+
+// SGI file of channels planes, rows of RLE files are stored from the last one
+static std::vector<uint8_t> makeSGI(unsigned width, unsigned height, unsigned channels, bool rle) {
+	std::vector<uint8_t> data;
+	put16(data, 474);
+	data.push_back(rle ? 1 : 0);
+	data.push_back(1);
+	put16(data, 3);
+	put16(data, width);
+	put16(data, height);
+	put16(data, channels);
+	put32(data, 0);
+	put32(data, 255);
+	data.resize(512, 0);
+
+	std::vector<uint8_t> row(width);
+	if (!rle) {
+		for (unsigned c = 0; c < channels; c++) {
+			for (unsigned y = 0; y < height; y++) {
+				for (unsigned x = 0; x < width; x++) {
+					data.push_back(sampleValue(c, x, y));
+				}
+			}
+		}
+		return data;
+	}
+
+	const size_t table = data.size();
+	const unsigned rows = height * channels;
+	data.resize(table + 8 * rows, 0);
+	for (unsigned k = rows; k-- > 0; ) {
+		const unsigned c = k / height, y = k % height;
+		for (unsigned x = 0; x < width; x++) {
+			row[x] = sampleValue(c, x, y);
+		}
+		const uint32_t offset = (uint32_t)data.size();
+		putRLERow(data, row.data(), width);
+		const uint32_t length = (uint32_t)data.size() - offset;
+		for (unsigned b = 0; b < 4; b++) {
+			data[table + 4 * k + b] = (uint8_t)(offset >> (24 - 8 * b));
+			data[table + 4 * (rows + k) + b] = (uint8_t)(length >> (24 - 8 * b));
+		}
+	}
+	return data;
+}
+
+static void checkSGI(FIBITMAP *dib, unsigned width, unsigned height, unsigned channels) {
+	assert(dib != NULL);
+	assert(FreeImage_GetWidth(dib) == width && FreeImage_GetHeight(dib) == height);
+	const unsigned bytespp = FreeImage_GetBPP(dib) / 8;
+	for (unsigned y = 0; y < height; y++) {
+		const uint8_t *pixel = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < width; x++, pixel += bytespp) {
+			switch (channels) {
+				case 1:
+					assert(pixel[0] == sampleValue(0, x, y));
+					break;
+				case 2:
+					// greyscale + alpha is loaded as RGBA
+					assert(pixel[FI_RGBA_RED] == sampleValue(0, x, y) && pixel[FI_RGBA_GREEN] == sampleValue(0, x, y) && pixel[FI_RGBA_BLUE] == sampleValue(0, x, y));
+					assert(pixel[FI_RGBA_ALPHA] == sampleValue(1, x, y));
+					break;
+				default:
+					assert(pixel[FI_RGBA_RED] == sampleValue(0, x, y) && pixel[FI_RGBA_GREEN] == sampleValue(1, x, y) && pixel[FI_RGBA_BLUE] == sampleValue(2, x, y));
+					if (channels == 4) {
+						assert(pixel[FI_RGBA_ALPHA] == sampleValue(3, x, y));
+					}
+					break;
+			}
+		}
+	}
+}
+
+void testSGI() {
+	printf("testSGI ...\n");
+
+	const unsigned widths[] = { 1, 17, 1023 };
+	for (unsigned channels = 1; channels <= 4; channels++) {
+		for (unsigned width : widths) {
+			for (bool rle : { false, true }) {
+				const unsigned height = 300;
+				std::vector<uint8_t> sgi = makeSGI(width, height, channels, rle);
+
+				FIMEMORY *hmem = FreeImage_OpenMemory(sgi.data(), (uint32_t)sgi.size());
+				FIBITMAP *dib = FreeImage_LoadFromMemory(FIF_SGI, hmem, 0);
+				checkSGI(dib, width, height, channels);
+				FreeImage_Unload(dib);
+				FreeImage_CloseMemory(hmem);
+
+				// truncated data are an error
+				hmem = FreeImage_OpenMemory(sgi.data(), (uint32_t)sgi.size() - 2);
+				dib = FreeImage_LoadFromMemory(FIF_SGI, hmem, 0);
+				assert(dib == NULL);
+				FreeImage_CloseMemory(hmem);
+			}
+		}
+	}
+}
@@ -0,0 +1,373 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+#include <algorithm>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static void checkSamePixels(FIBITMAP *dib1, FIBITMAP *dib2) {
+	assert(FreeImage_GetBPP(dib1) == FreeImage_GetBPP(dib2));
+	assert(FreeImage_GetWidth(dib1) == FreeImage_GetWidth(dib2) && FreeImage_GetHeight(dib1) == FreeImage_GetHeight(dib2));
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		assert(memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), FreeImage_GetLine(dib1)) == 0);
+	}
+}
+
+static FIBITMAP* reloadTIFF(FIBITMAP *dib, int save_flags, int load_flags) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_TIFF, dib, hmem, save_flags);
+	assert(bResult);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_TIFF, hmem, load_flags);
+	assert(loaded != NULL);
+	FreeImage_CloseMemory(hmem);
+	return loaded;
+}
+
+static FIBITMAP* makeGradient(unsigned width, unsigned height, unsigned bpp) {
+	FIBITMAP *dib = FreeImage_Allocate(width, height, bpp);
+	assert(dib != NULL);
+	const unsigned line = FreeImage_GetLine(dib);
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < line; x++) {
+			bits[x] = (uint8_t)((x * 7 + y * 3 + (x * y) / 17) & 0xFF);
+		}
+	}
+	return dib;
+}
+
+// memory IO counting the bytes read
+struct ReadCountHandle {
+	FIMEMORY *hmem;
+	unsigned read;
+};
+
+static unsigned DLL_CALLCONV readCountReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	ReadCountHandle *h = (ReadCountHandle*)handle;
+	const unsigned n = FreeImage_ReadMemory(buffer, size, count, h->hmem);
+	h->read += n * size;
+	return n;
+}
+
+static unsigned DLL_CALLCONV readCountWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return 0;
+}
+
+static int DLL_CALLCONV readCountSeekProc(fi_handle handle, long offset, int origin) {
+	return FreeImage_SeekMemory(((ReadCountHandle*)handle)->hmem, offset, origin) ? 0 : -1;
+}
+
+static long DLL_CALLCONV readCountTellProc(fi_handle handle) {
+	return FreeImage_TellMemory(((ReadCountHandle*)handle)->hmem);
+}
+
+static unsigned DLL_CALLCONV readCountWriteMemoryProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_WriteMemory(buffer, size, count, ((ReadCountHandle*)handle)->hmem);
+}
+
+static void checkRegion(FIMEMORY *hmem, FIBITMAP *full, int left, int top, int right, int bottom, int flags, unsigned max_read) {
+	FreeImageIO io;
+	io.read_proc = readCountReadProc;
+	io.write_proc = readCountWriteProc;
+	io.seek_proc = readCountSeekProc;
+	io.tell_proc = readCountTellProc;
+	ReadCountHandle handle = { hmem, 0 };
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *region = FreeImage_LoadRegion(FIF_TIFF, &io, (fi_handle)&handle, left, top, right, bottom, flags);
+	assert(region != NULL);
+	FIBITMAP *crop = FreeImage_Copy(full, left, top, right, bottom);
+	checkSamePixels(crop, region);
+	assert(handle.read <= max_read);
+	FreeImage_Unload(crop);
+	FreeImage_Unload(region);
+}
+
+// Main test function
+// ----------------------------------------------------------
+
+void testTIFFParallel() {
+	printf("testTIFFParallel ...\n");
+
+	const unsigned thread_count = FreeImage_GetThreadCount();
+
+	// large enough for the strips to be decoded in parallel
+	FIBITMAP *dib = makeGradient(1501, 1203, 24);
+	const int flags[] = { TIFF_DEFLATE, TIFF_ADOBE_DEFLATE, TIFF_LZW, TIFF_PACKBITS, TIFF_NONE };
+	for (int save_flags : flags) {
+		FreeImage_SetThreadCount(1);
+		FIBITMAP *serial = reloadTIFF(dib, save_flags, 0);
+		FreeImage_SetThreadCount(4);
+		FIBITMAP *parallel = reloadTIFF(dib, save_flags, 0);
+		checkSamePixels(dib, serial);
+		checkSamePixels(dib, parallel);
+		FreeImage_Unload(serial);
+		FreeImage_Unload(parallel);
+	}
+	FreeImage_Unload(dib);
+
+	// 8-bit greyscale
+	dib = makeGradient(2048, 1024, 8);
+	FIBITMAP *loaded = reloadTIFF(dib, TIFF_DEFLATE, 0);
+	checkSamePixels(dib, loaded);
+	FreeImage_Unload(loaded);
+	FreeImage_Unload(dib);
+
+	FreeImage_SetThreadCount(thread_count);
+}
+
+static unsigned savedSize(FIBITMAP *dib, int save_flags) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_TIFF, dib, hmem, save_flags);
+	assert(bResult);
+	const unsigned size = (unsigned)FreeImage_TellMemory(hmem);
+	FreeImage_CloseMemory(hmem);
+	return size;
+}
+
+void testTIFFTiled() {
+	printf("testTIFFTiled ...\n");
+
+	// sizes not multiple of the tile size, to check the padded edge tiles
+	const unsigned bpps[] = { 8, 24, 32 };
+	for (unsigned bpp : bpps) {
+		FIBITMAP *dib = makeGradient(601, 389, bpp);
+		const int flags[] = { TIFF_TILED, TIFF_TILED | TIFF_DEFLATE, TIFF_TILED | TIFF_LZW, TIFF_PYRAMID | TIFF_DEFLATE };
+		for (int save_flags : flags) {
+			FIBITMAP *loaded = reloadTIFF(dib, save_flags, 0);
+			checkSamePixels(dib, loaded);
+			FreeImage_Unload(loaded);
+		}
+		// the reduced levels are stored after the full resolution image
+		assert(savedSize(dib, TIFF_PYRAMID | TIFF_DEFLATE) > savedSize(dib, TIFF_TILED | TIFF_DEFLATE));
+		FreeImage_Unload(dib);
+	}
+
+	// a single tile needs no reduced level
+	FIBITMAP *dib = makeGradient(200, 100, 24);
+	assert(savedSize(dib, TIFF_PYRAMID) == savedSize(dib, TIFF_TILED));
+	FreeImage_Unload(dib);
+}
+
+void testTIFFRegion() {
+	printf("testTIFFRegion ...\n");
+
+	FIBITMAP *dib = makeGradient(2000, 1500, 24);
+
+	// tiles and strips intersecting the region only
+	const int flags[] = { TIFF_PYRAMID | TIFF_DEFLATE, TIFF_TILED, TIFF_DEFLATE, TIFF_NONE };
+	for (int save_flags : flags) {
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		FIBOOL bResult = FreeImage_SaveToMemory(FIF_TIFF, dib, hmem, save_flags);
+		assert(bResult);
+		const unsigned size = (unsigned)FreeImage_TellMemory(hmem);
+
+		checkRegion(hmem, dib, 300, 700, 556, 956, 0, size / 4);
+		checkRegion(hmem, dib, 1999, 1499, 2000, 1500, 0, size / 4);
+		checkRegion(hmem, dib, 0, 0, 2000, 1500, 0, size * 2);
+
+		FreeImage_CloseMemory(hmem);
+	}
+
+	// reduced resolution levels
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_TIFF, dib, hmem, TIFF_PYRAMID | TIFF_DEFLATE);
+	assert(bResult);
+	const unsigned size = (unsigned)FreeImage_TellMemory(hmem);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *level = FreeImage_LoadFromMemory(FIF_TIFF, hmem, TIFF_LEVEL(1));
+	assert(level != NULL);
+	assert(FreeImage_GetWidth(level) == 1000 && FreeImage_GetHeight(level) == 750);
+	checkRegion(hmem, level, 100, 200, 356, 456, TIFF_LEVEL(1), size / 4);
+	FreeImage_Unload(level);
+
+	// the smallest level fits in one tile, and is the thumbnail of the image
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	level = FreeImage_LoadFromMemory(FIF_TIFF, hmem, TIFF_LEVEL(3));
+	assert(level != NULL);
+	assert(FreeImage_GetWidth(level) == 250 && FreeImage_GetHeight(level) == 188);
+	FreeImage_Unload(level);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	level = FreeImage_LoadFromMemory(FIF_TIFF, hmem, TIFF_LEVEL(4));
+	assert(level == NULL);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_TIFF, hmem, 0);
+	assert(loaded != NULL && FreeImage_GetThumbnail(loaded) != NULL);
+	assert(FreeImage_GetWidth(FreeImage_GetThumbnail(loaded)) == 250);
+	FreeImage_Unload(loaded);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(dib);
+}
+
+void testTIFFBigTIFF() {
+	printf("testTIFFBigTIFF ...\n");
+
+	FIBITMAP *dib = makeGradient(601, 389, 24);
+	const int flags[] = { TIFF_DEFAULT, TIFF_BIGTIFF, TIFF_BIGTIFF | TIFF_PYRAMID | TIFF_DEFLATE };
+	for (int save_flags : flags) {
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		FIBOOL bResult = FreeImage_SaveToMemory(FIF_TIFF, dib, hmem, save_flags);
+		assert(bResult);
+
+		// version 42 is classic TIFF, 43 is BigTIFF
+		uint8_t *data = NULL;
+		uint32_t size = 0;
+		FreeImage_AcquireMemory(hmem, &data, &size);
+		assert(size > 4);
+		const unsigned version = (data[0] == 'I') ? (data[2] | (data[3] << 8)) : ((data[2] << 8) | data[3]);
+		assert(version == (((save_flags & TIFF_BIGTIFF) == TIFF_BIGTIFF) ? 43u : 42u));
+
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_TIFF, hmem, 0);
+		assert(loaded != NULL);
+		checkSamePixels(dib, loaded);
+		FreeImage_Unload(loaded);
+		FreeImage_CloseMemory(hmem);
+	}
+	FreeImage_Unload(dib);
+}
+
+void testTIFFPageAccess() {
+	printf("testTIFFPageAccess ...\n");
+
+	const int page_count = 200;
+
+	FreeImageIO io;
+	io.read_proc = readCountReadProc;
+	io.write_proc = readCountWriteMemoryProc;
+	io.seek_proc = readCountSeekProc;
+	io.tell_proc = readCountTellProc;
+	ReadCountHandle handle = { FreeImage_OpenMemory(), 0 };
+
+	// pages filled with their number
+	FIMULTIWRITER *writer = FreeImage_OpenMultiBitmapWriter(FIF_TIFF, &io, (fi_handle)&handle, TIFF_NONE);
+	assert(writer != NULL);
+	FIBITMAP *page = FreeImage_Allocate(16, 16, 8);
+	for (int i = 0; i < page_count; i++) {
+		memset(FreeImage_GetBits(page), i, FreeImage_GetPitch(page) * 16);
+		FIBOOL bResult = FreeImage_WritePage(writer, page);
+		assert(bResult);
+	}
+	FreeImage_Unload(page);
+	FIBOOL bResult = FreeImage_CloseMultiBitmapWriter(writer);
+	assert(bResult);
+
+	FreeImage_SeekMemory(handle.hmem, 0, SEEK_SET);
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmapFromHandle(FIF_TIFF, &io, (fi_handle)&handle, 0);
+	assert(src != NULL);
+	assert(FreeImage_GetPageCount(src) == page_count);
+
+	// the first access to the last page walks the IFD chain once
+	FIBITMAP *dib = FreeImage_LockPage(src, page_count - 1);
+	assert(dib != NULL && FreeImage_GetBits(dib)[0] == (uint8_t)(page_count - 1));
+	FreeImage_UnlockPage(src, dib, FALSE);
+
+	// then any page is reached without walking the chain again
+	for (int i = page_count - 2; i >= 0; i -= 7) {
+		handle.read = 0;
+		dib = FreeImage_LockPage(src, i);
+		assert(dib != NULL && FreeImage_GetBits(dib)[0] == (uint8_t)i);
+		FreeImage_UnlockPage(src, dib, FALSE);
+		assert(handle.read < 4096);
+	}
+
+	FreeImage_CloseMultiBitmap(src, 0);
+	FreeImage_CloseMemory(handle.hmem);
+}
+
+void testTIFFFax() {
+	printf("testTIFFFax ...\n");
+
+	// bilevel page with text-like runs, padding bits of the rows left white
+	const unsigned widths[] = { 1728, 1001 };
+	for (unsigned width : widths) {
+		FIBITMAP *dib = FreeImage_Allocate(width, 700, 1);
+		assert(dib != NULL);
+		for (unsigned y = 0; y < 700; y++) {
+			uint8_t *bits = FreeImage_GetScanLine(dib, y);
+			for (unsigned x = 0; x < width; x++) {
+				const unsigned line = y % 40, col = x % 14;
+				if ((line > 8 && line < 30 && (col < 2 || (x / 14 * 7 + line) % 11 == 0)) || (x == y)) {
+					bits[x >> 3] |= 0x80 >> (x & 7);
+				}
+			}
+		}
+		const int flags[] = { TIFF_CCITTFAX3, TIFF_CCITTFAX4 };
+		for (int save_flags : flags) {
+			FIBITMAP *loaded = reloadTIFF(dib, save_flags, 0);
+			checkSamePixels(dib, loaded);
+			FreeImage_Unload(loaded);
+		}
+		FreeImage_Unload(dib);
+	}
+}
+
+void testTIFFLogLuv() {
+	printf("testTIFFLogLuv ...\n");
+
+	const unsigned thread_count = FreeImage_GetThreadCount();
+
+	// HDR gradient, large enough for the strips to be decoded in parallel
+	const unsigned width = 1031, height = 517;
+	FIBITMAP *dib = FreeImage_AllocateT(FIT_RGBF, width, height);
+	assert(dib != NULL);
+	for (unsigned y = 0; y < height; y++) {
+		FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < width; x++) {
+			pixel[x].red = 0.2F + 4.0F * x / width;
+			pixel[x].green = 0.2F + 2.0F * y / height;
+			pixel[x].blue = 0.2F + (float)((x + y) % 64) / 32;
+		}
+	}
+
+	FreeImage_SetThreadCount(1);
+	FIBITMAP *serial = reloadTIFF(dib, TIFF_LOGLUV, 0);
+	FreeImage_SetThreadCount(4);
+	FIBITMAP *parallel = reloadTIFF(dib, TIFF_LOGLUV, 0);
+	assert(FreeImage_GetImageType(serial) == FIT_RGBF);
+	checkSamePixels(serial, parallel);
+
+	// LogLuv is lossy, the chroma quantization gives errors of about 2% of the brightest channel
+	for (unsigned y = 0; y < height; y++) {
+		const FIRGBF *src = (const FIRGBF*)FreeImage_GetScanLine(dib, y);
+		const FIRGBF *dst = (const FIRGBF*)FreeImage_GetScanLine(serial, y);
+		for (unsigned x = 0; x < width; x++) {
+			const float tolerance = 0.05F * std::max(src[x].red, std::max(src[x].green, src[x].blue));
+			assert(fabsf(src[x].red - dst[x].red) <= tolerance);
+			assert(fabsf(src[x].green - dst[x].green) <= tolerance);
+			assert(fabsf(src[x].blue - dst[x].blue) <= tolerance);
+		}
+	}
+
+	FreeImage_Unload(serial);
+	FreeImage_Unload(parallel);
+	FreeImage_Unload(dib);
+
+	FreeImage_SetThreadCount(thread_count);
+}
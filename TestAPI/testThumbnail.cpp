@@ -21,6 +21,8 @@
 
 
 #include "TestSuite.h"
+#include <cstring>
+#include <memory>
 
 /**
 Test thumbnail loading
@@ -119,6 +121,42 @@ static FIBOOL testSaveThumbnail(const char *lpszPathName, int flags) {
 	return FALSE; 
 }
 
+/**
+Test loading fitted into a bounding box
+*/
+void testLoadScaled(const char *lpszPathName) {
+	printf("testLoadScaled ...\n");
+
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(lpszPathName);
+	FIBITMAP *dib = FreeImage_Load(fif, lpszPathName, 0);
+	assert(dib != NULL);
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+
+	// the longest side fits the box, the aspect ratio is kept
+	const unsigned box = (width > height ? width : height) / 5;
+	FIBITMAP *scaled = FreeImage_LoadScaled(fif, lpszPathName, box, box, 0);
+	assert(scaled != NULL);
+	const unsigned scaled_width = FreeImage_GetWidth(scaled);
+	const unsigned scaled_height = FreeImage_GetHeight(scaled);
+	assert(scaled_width <= box && scaled_height <= box);
+	assert(scaled_width == box || scaled_height == box);
+	assert(abs((int)(scaled_width * height) - (int)(scaled_height * width)) <= (int)(width > height ? width : height));
+	assert(FreeImage_GetImageType(scaled) == FreeImage_GetImageType(dib));
+	FreeImage_Unload(scaled);
+
+	// never enlarged
+	scaled = FreeImage_LoadScaled(fif, lpszPathName, width * 2, height * 2, 0);
+	assert(scaled != NULL);
+	assert(FreeImage_GetWidth(scaled) == width && FreeImage_GetHeight(scaled) == height);
+	FreeImage_Unload(scaled);
+
+	scaled = FreeImage_LoadScaled(fif, lpszPathName, 0, box, 0);
+	assert(scaled == NULL);
+
+	FreeImage_Unload(dib);
+}
+
 /**
 Test thumbnail functions
 */
@@ -138,3 +176,54 @@ void testThumbnail(const char *lpszPathName, int flags) {
 #endif
 }
 
+void testThumbnailSet()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	const unsigned width = 1200, height = 700;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo24Bits(zone.get()), &::FreeImage_Unload);
+	assert(color != nullptr);
+
+	auto same_pixels = [](FIBITMAP *a, FIBITMAP *b) {
+		if ((FreeImage_GetBPP(a) != FreeImage_GetBPP(b)) || (FreeImage_GetWidth(a) != FreeImage_GetWidth(b)) || (FreeImage_GetHeight(a) != FreeImage_GetHeight(b))) return false;
+		for (unsigned y = 0; y < FreeImage_GetHeight(a); ++y) {
+			if (memcmp(FreeImage_GetScanLine(a, y), FreeImage_GetScanLine(b, y), FreeImage_GetLine(a)) != 0) return false;
+		}
+		return true;
+	};
+
+	// thumbnails have the size of FreeImage_MakeThumbnail, whatever the order of sizes and the number of threads
+	const int sizes[] = { 256, 64, 1024, 512, 256, 2048 };
+	const unsigned count = sizeof(sizes) / sizeof(sizes[0]);
+	FIBITMAP *serial[count], *parallel[count];
+	FreeImage_SetThreadCount(1);
+	assert(FreeImage_MakeThumbnailSet(color.get(), sizes, count, FILTER_BILINEAR, serial));
+	FreeImage_SetThreadCount(4);
+	assert(FreeImage_MakeThumbnailSet(color.get(), sizes, count, FILTER_BILINEAR, parallel));
+	FreeImage_SetThreadCount(defaultCount);
+	for (unsigned i = 0; i < count; ++i) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> single(FreeImage_MakeThumbnail(color.get(), sizes[i]), &::FreeImage_Unload);
+		assert(single != nullptr && serial[i] != nullptr && parallel[i] != nullptr);
+		assert(FreeImage_GetWidth(serial[i]) == FreeImage_GetWidth(single.get()));
+		assert(FreeImage_GetHeight(serial[i]) == FreeImage_GetHeight(single.get()));
+		assert(FreeImage_GetBPP(serial[i]) == 24);
+		assert(same_pixels(serial[i], parallel[i]));
+	}
+	// the largest level is filtered from the image, an image smaller than the thumbnail is copied
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> direct(FreeImage_Rescale(color.get(), 1024, 597, FILTER_BILINEAR), &::FreeImage_Unload);
+	assert(same_pixels(serial[2], direct.get()));
+	assert(same_pixels(serial[5], color.get()));
+	assert(same_pixels(serial[0], serial[4]));
+	for (unsigned i = 0; i < count; ++i) {
+		FreeImage_Unload(serial[i]);
+		FreeImage_Unload(parallel[i]);
+	}
+
+	// invalid sizes make no thumbnail
+	const int invalid[] = { 128, 0 };
+	FIBITMAP *none[2] = { color.get(), color.get() };
+	assert(!FreeImage_MakeThumbnailSet(color.get(), invalid, 2, FILTER_BILINEAR, none));
+	assert(none[0] == nullptr && none[1] == nullptr);
+}
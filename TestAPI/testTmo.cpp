@@ -23,6 +23,10 @@
 #include "TestSuite.h"
 #include <cmath>
 #include <memory>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <vector>
 
 
 void testTmoClamp()
@@ -298,5 +302,237 @@ void testTmoLinear()
 	}
 }
 
+void testMultigridParallel()
+{
+	const unsigned width = 300, height = 200;
+
+	// Laplacian of a smooth field with a few sharp edges
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> laplacian(FreeImage_AllocateT(FIT_FLOAT, width, height), &::FreeImage_Unload);
+	assert(laplacian != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		auto line = reinterpret_cast<float*>(FreeImage_GetScanLine(laplacian.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			line[x] = 0.01f * std::sin(x * 0.05f) * std::cos(y * 0.07f) + (((x / 37 + y / 23) % 5 == 0) ? 0.2f : 0.0f);
+		}
+	}
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2][2] = {
+		{ { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } },
+		{ { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } }
+	};
+	runScalarAndSIMD([&](bool vector) {
+		for (const bool parallel : { false, true }) {
+			FreeImage_SetThreadCount(parallel ? 4 : 1);
+			results[vector][parallel].reset(FreeImage_MultigridPoissonSolver(laplacian.get(), 2));
+			assert(results[vector][parallel] != nullptr);
+			assert(FreeImage_GetImageType(results[vector][parallel].get()) == FIT_FLOAT);
+			assert(FreeImage_GetWidth(results[vector][parallel].get()) == width);
+			assert(FreeImage_GetHeight(results[vector][parallel].get()) == height);
+		}
+		// red-black sweeps by bands give the serial solution
+		assert(isSameBitmap(results[vector][false].get(), results[vector][true].get()));
+	});
+
+	// stencil kernels only differ from the scalar code by a possible fused rounding
+	for (unsigned y = 0; y < height; ++y) {
+		auto scalar = reinterpret_cast<const float*>(FreeImage_GetScanLine(results[0][1].get(), y));
+		auto vector = reinterpret_cast<const float*>(FreeImage_GetScanLine(results[1][1].get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			assert(std::fabs(scalar[x] - vector[x]) < 1e-3f);
+		}
+	}
+}
+
+void testPoissonDCT()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	const unsigned width = 301, height = 197;	// not powers of two
+
+	// random field and its 5-point Laplacian with mirrored boundaries
+	std::vector<double> field((size_t)width * height);
+	for (unsigned y = 0; y < height; ++y) {
+		for (unsigned x = 0; x < width; ++x) {
+			field[(size_t)y * width + x] = std::sin(x * 0.031) * std::cos(y * 0.047) + ((x * 7 + y * 13) % 17) * 0.01;
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> laplacian(FreeImage_AllocateT(FIT_FLOAT, width, height), &::FreeImage_Unload);
+	assert(laplacian != nullptr);
+	auto at = [&](int x, int y) {
+		x = std::min(std::max(x, 0), (int)width - 1);
+		y = std::min(std::max(y, 0), (int)height - 1);
+		return field[(size_t)y * width + x];
+	};
+	double fieldMin = at(0, 0), fieldMax = at(0, 0);
+	for (unsigned y = 0; y < height; ++y) {
+		auto line = reinterpret_cast<float*>(FreeImage_GetScanLine(laplacian.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			line[x] = (float)(at(x + 1, y) + at(x - 1, y) + at(x, y + 1) + at(x, y - 1) - 4 * at(x, y));
+			fieldMin = std::min(fieldMin, at(x, y));
+			fieldMax = std::max(fieldMax, at(x, y));
+		}
+	}
+
+	FreeImage_SetThreadCount(1);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serial(FreeImage_DCTPoissonSolver(laplacian.get()), &::FreeImage_Unload);
+	FreeImage_SetThreadCount(4);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> parallel(FreeImage_DCTPoissonSolver(laplacian.get()), &::FreeImage_Unload);
+	assert(serial != nullptr && parallel != nullptr);
+	assert(FreeImage_GetWidth(serial.get()) == width && FreeImage_GetHeight(serial.get()) == height);
+	assert(isSameBitmap(serial.get(), parallel.get()));
+
+	// the solution is the field up to a constant, both remapped to [0..1]
+	for (unsigned y = 0; y < height; ++y) {
+		auto line = reinterpret_cast<const float*>(FreeImage_GetScanLine(parallel.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			const double expected = (at(x, y) - fieldMin) / (fieldMax - fieldMin);
+			assert(std::fabs(line[x] - expected) < 1e-3);
+		}
+	}
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey16(FreeImage_AllocateT(FIT_UINT16, 1, 1), &::FreeImage_Unload);
+	assert(FreeImage_DCTPoissonSolver(grey16.get()) == nullptr);
+
+	// tone mapping with either solver
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> hdr(FreeImage_AllocateT(FIT_RGBF, 150, 100), &::FreeImage_Unload);
+	assert(hdr != nullptr);
+	for (unsigned y = 0; y < 100; ++y) {
+		auto pixel = reinterpret_cast<FIRGBF*>(FreeImage_GetScanLine(hdr.get(), y));
+		for (unsigned x = 0; x < 150; ++x) {
+			const float value = (x < 75 ? 0.01f : 100.0f) * (1.0f + 0.5f * std::sin(x * 0.2f + y * 0.1f));
+			pixel[x] = { value, value * 0.8f, value * 0.6f };
+		}
+	}
+	for (const auto solver : { FIPS_MULTIGRID, FIPS_DCT }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> ldr(FreeImage_TmoFattal02Ex(hdr.get(), 0.5, 0.85, solver), &::FreeImage_Unload);
+		assert(ldr != nullptr);
+		assert(FreeImage_GetBPP(ldr.get()) == 24);
+		assert(FreeImage_GetWidth(ldr.get()) == 150 && FreeImage_GetHeight(ldr.get()) == 100);
+	}
 
+	FreeImage_SetThreadCount(defaultCount);
+}
 
+void testFattalPyramid()
+{
+	const unsigned width = 517, height = 333;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> hdr(FreeImage_AllocateT(FIT_RGBF, width, height), &::FreeImage_Unload);
+	assert(hdr != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		auto pixel = reinterpret_cast<FIRGBF*>(FreeImage_GetScanLine(hdr.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			const float value = std::exp(4.0f * std::sin(x * 0.013f) * std::cos(y * 0.021f)) + ((x ^ y) & 15) * 0.05f;
+			pixel[x] = { value, value * 0.7f, value * 0.4f + 0.01f };
+		}
+	}
+
+	// pyramid levels by parallel bands give the serial result
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+	runScalarAndSIMD([&](bool vector) {
+		FreeImage_SetThreadCount(1);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serial(FreeImage_TmoFattal02Ex(hdr.get(), 0.5, 0.85, FIPS_DCT), &::FreeImage_Unload);
+		FreeImage_SetThreadCount(4);
+		results[vector].reset(FreeImage_TmoFattal02Ex(hdr.get(), 0.5, 0.85, FIPS_DCT));
+		assert(serial != nullptr && results[vector] != nullptr);
+		assert(isSameBitmap(serial.get(), results[vector].get()));
+	});
+
+	// decimating kernels may only differ by a fused rounding
+	for (unsigned y = 0; y < height; ++y) {
+		const uint8_t *scalar = FreeImage_GetScanLine(results[0].get(), y);
+		const uint8_t *vector = FreeImage_GetScanLine(results[1].get(), y);
+		for (unsigned x = 0; x < width * 3; ++x) {
+			assert(std::abs(scalar[x] - vector[x]) <= 1);
+		}
+	}
+
+	// images smaller than the coarsest pyramid level
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> small(FreeImage_Copy(hdr.get(), 0, 0, 20, 20), &::FreeImage_Unload);
+	assert(small != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> ldr(FreeImage_TmoFattal02(small.get()), &::FreeImage_Unload);
+	assert(ldr != nullptr && FreeImage_GetWidth(ldr.get()) == 20);
+}
+
+void testToneMapParallel()
+{
+	const unsigned width = 389, height = 271;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> hdr(FreeImage_AllocateT(FIT_RGBF, width, height), &::FreeImage_Unload);
+	assert(hdr != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		auto pixel = reinterpret_cast<FIRGBF*>(FreeImage_GetScanLine(hdr.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			const float value = std::exp(5.0f * std::sin(x * 0.017f) * std::cos(y * 0.023f)) + ((x ^ y) & 7) * 0.03f;
+			pixel[x] = { value, value * 0.6f + 0.02f, value * 0.3f + 0.05f };
+		}
+	}
+
+	const std::function<FIBITMAP*(FIBITMAP*)> operators[] = {
+		[](FIBITMAP *dib) { return FreeImage_TmoDrago03(dib, 2.2, 0); },
+		[](FIBITMAP *dib) { return FreeImage_TmoDrago03(dib, 1, 1.5); },
+		[](FIBITMAP *dib) { return FreeImage_TmoReinhard05Ex(dib, 0, 0, 1, 0); },
+		[](FIBITMAP *dib) { return FreeImage_TmoReinhard05Ex(dib, 0.5, 0.8, 0.5, 0.5); }
+	};
+	for (const auto &tmo : operators) {
+		// fused passes by parallel bands give the serial result
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+		runScalarAndSIMD([&](bool vector) {
+			FreeImage_SetThreadCount(1);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serial(tmo(hdr.get()), &::FreeImage_Unload);
+			FreeImage_SetThreadCount(4);
+			results[vector].reset(tmo(hdr.get()));
+			assert(serial != nullptr && results[vector] != nullptr);
+			assert(FreeImage_GetBPP(serial.get()) == 24);
+			assert(isSameBitmap(serial.get(), results[vector].get()));
+		});
+
+		// log and pow kernels may only differ by a fused rounding
+		unsigned darkest = 255, brightest = 0;
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t *scalar = FreeImage_GetScanLine(results[0].get(), y);
+			const uint8_t *vector = FreeImage_GetScanLine(results[1].get(), y);
+			for (unsigned x = 0; x < width * 3; ++x) {
+				assert(std::abs(scalar[x] - vector[x]) <= 1);
+				darkest = std::min<unsigned>(darkest, vector[x]);
+				brightest = std::max<unsigned>(brightest, vector[x]);
+			}
+		}
+		assert(brightest > darkest + 128);
+	}
+}
+
+void testToneMapColorKernels()
+{
+	// rows of every length around the kernel widths, with black, negative and very bright samples
+	for (const unsigned width : { 1u, 3u, 4u, 7u, 8u, 9u, 15u, 17u, 31u }) {
+		const unsigned height = 5;
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> hdr(FreeImage_AllocateT(FIT_RGBF, width, height), &::FreeImage_Unload);
+		assert(hdr != nullptr);
+		for (unsigned y = 0; y < height; ++y) {
+			auto pixel = reinterpret_cast<FIRGBF*>(FreeImage_GetScanLine(hdr.get(), y));
+			for (unsigned x = 0; x < width; ++x) {
+				const float samples[] = { 0.0f, -0.25f, 0.001f, 1.0f, 250.0f, 3.5f, 0.2f };
+				pixel[x] = { samples[(x + y) % 7], samples[(2 * x + y) % 7], samples[(x + 3 * y) % 7] };
+			}
+		}
+
+		const std::function<FIBITMAP*(FIBITMAP*)> operators[] = {
+			[](FIBITMAP *dib) { return FreeImage_TmoDrago03(dib, 1, 0); },
+			[](FIBITMAP *dib) { return FreeImage_TmoReinhard05Ex(dib, 0, 0.5, 1, 0); }
+		};
+		for (const auto &tmo : operators) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+			runScalarAndSIMD([&](bool vector) {
+				results[vector].reset(tmo(hdr.get()));
+				assert(results[vector] != nullptr);
+			});
+			for (unsigned y = 0; y < height; ++y) {
+				const uint8_t *s = FreeImage_GetScanLine(results[0].get(), y);
+				const uint8_t *v = FreeImage_GetScanLine(results[1].get(), y);
+				for (unsigned x = 0; x < width * 3; ++x) {
+					assert(std::abs(s[x] - v[x]) <= 1);
+				}
+			}
+		}
+	}
+}
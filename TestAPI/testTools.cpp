@@ -23,6 +23,11 @@
 #include "TestSuite.h"
 #include <cmath>
 #include <memory>
+#include <cstring>
+#include <initializer_list>
+#include <algorithm>
+#include <functional>
+#include <vector>
 
 
 // ----------------------------------------------------------
@@ -308,3 +313,1562 @@ void testFindMinMax()
 	}
 }
 
+
+bool isSameBitmap(FIBITMAP* lhs, FIBITMAP* rhs)
+{
+	if (FreeImage_GetWidth(lhs) != FreeImage_GetWidth(rhs) || FreeImage_GetHeight(lhs) != FreeImage_GetHeight(rhs) || FreeImage_GetLine(lhs) != FreeImage_GetLine(rhs)) {
+		return false;
+	}
+	for (unsigned y = 0; y < FreeImage_GetHeight(lhs); ++y) {
+		if (0 != memcmp(FreeImage_GetScanLine(lhs, y), FreeImage_GetScanLine(rhs, y), FreeImage_GetLine(lhs))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+Calls run(false) with the scalar kernels on a single thread, then run(true) with all the SIMD kernels on 4 threads.
+Restores the default CPU features and the previous thread count.
+*/
+void runScalarAndSIMD(const std::function<void(bool vector)> &run)
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	for (const bool vector : { false, true }) {
+		FreeImage_SetCPUFeatures(vector ? FI_CPU_ALL : FI_CPU_NONE);
+		FreeImage_SetThreadCount(vector ? 4 : 1);
+		run(vector);
+	}
+	FreeImage_SetCPUFeatures(FI_CPU_ALL);
+	FreeImage_SetThreadCount(defaultCount);
+}
+
+/**
+Builds an image with make() under both settings of runScalarAndSIMD and compares the pixels
+*/
+bool isSameScalarAndSIMD(const std::function<FIBITMAP*()> &make)
+{
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+	runScalarAndSIMD([&](bool vector) {
+		results[vector].reset(make());
+	});
+	return results[0] && results[1] && isSameBitmap(results[0].get(), results[1].get());
+}
+
+void testRescaleParallel()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> plate(createZonePlateImage(640, 480, 64), &::FreeImage_Unload);
+	assert(plate != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo24Bits(plate.get()), &::FreeImage_Unload);
+	assert(color != nullptr);
+
+	for (FIBITMAP* src : { plate.get(), color.get() }) {
+		for (const auto filter : { FILTER_BOX, FILTER_BILINEAR, FILTER_CATMULLROM, FILTER_LANCZOS3 }) {
+			FreeImage_SetThreadCount(1);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serialDown(FreeImage_Rescale(src, 257, 101, filter), &::FreeImage_Unload);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serialUp(FreeImage_Rescale(src, 900, 700, filter), &::FreeImage_Unload);
+
+			FreeImage_SetThreadCount(4);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> parallelDown(FreeImage_Rescale(src, 257, 101, filter), &::FreeImage_Unload);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> parallelUp(FreeImage_Rescale(src, 900, 700, filter), &::FreeImage_Unload);
+
+			assert(serialDown && serialUp && parallelDown && parallelUp);
+			assert(isSameBitmap(serialDown.get(), parallelDown.get()));
+			assert(isSameBitmap(serialUp.get(), parallelUp.get()));
+		}
+	}
+
+	FreeImage_SetThreadCount(defaultCount);
+}
+
+void testRescaleRectFloat()
+{
+	// a rectangle with a non-zero left edge is filtered like a copy of it
+	for (const auto type : { FIT_RGBF, FIT_RGBAF }) {
+		const unsigned floatspp = (type == FIT_RGBF) ? 3 : 4;
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(type, 173, 41), &::FreeImage_Unload);
+		assert(src != nullptr);
+		for (unsigned y = 0; y < 41; y++) {
+			auto *bits = reinterpret_cast<float*>(FreeImage_GetScanLine(src.get(), y));
+			for (unsigned x = 0; x < 173 * floatspp; x++) {
+				bits[x] = (float)((x * 7 + y * 13) % 101) / 100.0f;
+			}
+		}
+
+		for (const auto filter : { FILTER_BOX, FILTER_BILINEAR, FILTER_CATMULLROM }) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rect(FreeImage_RescaleRect(src.get(), 30, 10, 13, 5, 113, 36, filter), &::FreeImage_Unload);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> copy(FreeImage_Copy(src.get(), 13, 5, 113, 36), &::FreeImage_Unload);
+			assert(rect && copy);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_Rescale(copy.get(), 30, 10, filter), &::FreeImage_Unload);
+			assert(expected != nullptr);
+			assert(isSameBitmap(rect.get(), expected.get()));
+		}
+	}
+
+	// half floats are filtered as RGBAF
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbaf(FreeImage_AllocateT(FIT_RGBAF, 173, 41), &::FreeImage_Unload);
+	assert(rgbaf != nullptr);
+	for (unsigned y = 0; y < 41; y++) {
+		auto *bits = reinterpret_cast<float*>(FreeImage_GetScanLine(rgbaf.get(), y));
+		for (unsigned x = 0; x < 173 * 4; x++) {
+			bits[x] = (float)((x * 7 + y * 13) % 101) / 100.0f;
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbah(FreeImage_ConvertToRGBAH(rgbaf.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> wide(FreeImage_ConvertToRGBAF(rgbah.get()), &::FreeImage_Unload);
+	assert(rgbah != nullptr && wide != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rect(FreeImage_RescaleRect(rgbah.get(), 30, 10, 13, 5, 113, 36, FILTER_CATMULLROM), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rectF(FreeImage_RescaleRect(wide.get(), 30, 10, 13, 5, 113, 36, FILTER_CATMULLROM), &::FreeImage_Unload);
+	assert(rect != nullptr && rectF != nullptr && FreeImage_GetImageType(rect.get()) == FIT_RGBAH);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_ConvertToRGBAH(rectF.get()), &::FreeImage_Unload);
+	assert(isSameBitmap(rect.get(), expected.get()));
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> thumbnail(FreeImage_MakeThumbnail(rgbah.get(), 64, TRUE), &::FreeImage_Unload);
+	assert(thumbnail != nullptr && FreeImage_GetImageType(thumbnail.get()) == FIT_BITMAP);
+}
+
+void testRotateKernels()
+{
+	struct Format { FREE_IMAGE_TYPE type; unsigned bpp; };
+	const Format formats[] = {
+		{ FIT_BITMAP, 8 }, { FIT_BITMAP, 24 }, { FIT_BITMAP, 32 }, { FIT_UINT16, 16 }, { FIT_RGB16, 48 },
+		{ FIT_RGBA16, 64 }, { FIT_FLOAT, 32 }, { FIT_RGBF, 96 }, { FIT_RGBAF, 128 }, { FIT_RGBAH, 64 }
+	};
+	// sizes leave partial tiles and strips
+	const unsigned sizes[][2] = { { 37, 29 }, { 133, 70 } };
+	for (const auto &format : formats) {
+		for (const auto &size : sizes) {
+			const unsigned width = size[0], height = size[1];
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(format.type, width, height, format.bpp), &::FreeImage_Unload);
+			assert(src != nullptr);
+			for (unsigned y = 0; y < height; ++y) {
+				uint8_t *bits = FreeImage_GetScanLine(src.get(), y);
+				for (unsigned x = 0; x < FreeImage_GetLine(src.get()); ++x) {
+					bits[x] = static_cast<uint8_t>(x * 37 + y * 101 + (x >> 3));
+				}
+			}
+			const unsigned bytespp = FreeImage_GetLine(src.get()) / width;
+			for (const double angle : { 90.0, -90.0, 180.0 }) {
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+				runScalarAndSIMD([&](bool vector) {
+					results[vector].reset(FreeImage_Rotate(src.get(), angle));
+					assert(results[vector] != nullptr);
+				});
+				assert(isSameBitmap(results[0].get(), results[1].get()));
+
+				// bottom-up scanlines: +90 moves src (x, y) to (height - 1 - y, x), -90 to (y, width - 1 - x)
+				FIBITMAP *dst = results[1].get();
+				for (unsigned y = 0; y < height; ++y) {
+					const uint8_t *s = FreeImage_GetScanLine(src.get(), y);
+					for (unsigned x = 0; x < width; ++x, s += bytespp) {
+						const uint8_t *d;
+						if (angle == 90.0) {
+							d = FreeImage_GetScanLine(dst, x) + (height - 1 - y) * bytespp;
+						} else if (angle == -90.0) {
+							d = FreeImage_GetScanLine(dst, width - 1 - x) + y * bytespp;
+						} else {
+							d = FreeImage_GetScanLine(dst, height - 1 - y) + (width - 1 - x) * bytespp;
+						}
+						assert(memcmp(d, s, bytespp) == 0);
+					}
+				}
+			}
+		}
+	}
+
+	// other angles rotate half floats as RGBAF
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbaf(FreeImage_AllocateT(FIT_RGBAF, 61, 43), &::FreeImage_Unload);
+	assert(rgbaf != nullptr);
+	for (unsigned y = 0; y < 43; ++y) {
+		auto *bits = reinterpret_cast<float*>(FreeImage_GetScanLine(rgbaf.get(), y));
+		for (unsigned x = 0; x < 61 * 4; ++x) {
+			bits[x] = (float)((x * 7 + y * 13) % 101) / 100.0f;
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbah(FreeImage_ConvertToRGBAH(rgbaf.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> wide(FreeImage_ConvertToRGBAF(rgbah.get()), &::FreeImage_Unload);
+	assert(rgbah != nullptr && wide != nullptr);
+	const FIRGBAH halfColor = { 0x3800, 0x0000, 0x3C00, 0x3C00 };	// 0.5, 0, 1, 1
+	const FIRGBAF floatColor = { 0.5f, 0.f, 1.f, 1.f };
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rotated(FreeImage_Rotate(rgbah.get(), 30, &halfColor), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rotatedF(FreeImage_Rotate(wide.get(), 30, &floatColor), &::FreeImage_Unload);
+	assert(rotated != nullptr && rotatedF != nullptr && FreeImage_GetImageType(rotated.get()) == FIT_RGBAH);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_ConvertToRGBAH(rotatedF.get()), &::FreeImage_Unload);
+	assert(isSameBitmap(rotated.get(), expected.get()));
+}
+
+void testFlipKernels()
+{
+	struct Format { FREE_IMAGE_TYPE type; unsigned bpp; };
+	const Format formats[] = {
+		{ FIT_BITMAP, 1 }, { FIT_BITMAP, 4 }, { FIT_BITMAP, 8 }, { FIT_BITMAP, 16 }, { FIT_BITMAP, 24 }, { FIT_BITMAP, 32 },
+		{ FIT_RGB16, 48 }, { FIT_RGBA16, 64 }, { FIT_RGBF, 96 }, { FIT_RGBAF, 128 }
+	};
+	// pixel (x, y) as bytes, packed pixels as a value
+	auto pixelAt = [](FIBITMAP *dib, unsigned x, unsigned y) {
+		const unsigned bpp = FreeImage_GetBPP(dib);
+		const uint8_t *line = FreeImage_GetScanLine(dib, y);
+		std::vector<uint8_t> pixel;
+		if (bpp < 8) {
+			const unsigned bit = x * bpp;
+			pixel.push_back(static_cast<uint8_t>((line[bit >> 3] >> (8 - bpp - (bit & 7))) & ((1 << bpp) - 1)));
+		} else {
+			pixel.assign(line + x * (bpp / 8), line + (x + 1) * (bpp / 8));
+		}
+		return pixel;
+	};
+	for (const auto &format : formats) {
+		// widths leave partial registers and odd packed rows
+		for (const unsigned width : { 1u, 7u, 37u, 133u }) {
+			const unsigned height = 9;
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(format.type, width, height, format.bpp), &::FreeImage_Unload);
+			assert(src != nullptr);
+			for (unsigned y = 0; y < height; ++y) {
+				uint8_t *bits = FreeImage_GetScanLine(src.get(), y);
+				for (unsigned x = 0; x < FreeImage_GetLine(src.get()); ++x) {
+					bits[x] = static_cast<uint8_t>(x * 37 + y * 101 + (x >> 3));
+				}
+			}
+
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+			runScalarAndSIMD([&](bool vector) {
+				results[vector].reset(FreeImage_Clone(src.get()));
+				assert(results[vector] != nullptr);
+				assert(FreeImage_FlipHorizontal(results[vector].get()));
+			});
+			assert(isSameBitmap(results[0].get(), results[1].get()));
+
+			FIBITMAP *flipped = results[1].get();
+			for (unsigned y = 0; y < height; ++y) {
+				for (unsigned x = 0; x < width; ++x) {
+					assert(pixelAt(flipped, width - 1 - x, y) == pixelAt(src.get(), x, y));
+				}
+			}
+
+			assert(FreeImage_FlipVertical(flipped));
+			for (unsigned y = 0; y < height; ++y) {
+				for (unsigned x = 0; x < width; ++x) {
+					assert(pixelAt(flipped, width - 1 - x, height - 1 - y) == pixelAt(src.get(), x, y));
+				}
+			}
+		}
+	}
+}
+
+void testAffineTransform()
+{
+	const unsigned width = 133, height = 70;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> plate(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(plate != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_ConvertTo32Bits(plate.get()), &::FreeImage_Unload);
+	assert(src != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *bits = FreeImage_GetScanLine(src.get(), y);
+		for (unsigned x = 0; x < width; ++x) {
+			bits[4 * x + 3] = static_cast<uint8_t>(x * 7 + y * 3);
+		}
+	}
+
+	// identity and integer translations copy pixels
+	const double identity[6] = { 1, 0, 0, 0, 1, 0 };
+	for (const auto filter : { FILTER_BOX, FILTER_BILINEAR, FILTER_CATMULLROM }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst(FreeImage_AffineTransform(src.get(), identity, filter), &::FreeImage_Unload);
+		assert(dst != nullptr);
+		assert(isSameBitmap(src.get(), dst.get()));
+	}
+	const double translation[6] = { 1, 0, 3, 0, 1, -2 };
+	const uint8_t background[4] = { 10, 20, 30, 40 };
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> moved(FreeImage_AffineTransform(src.get(), translation, FILTER_BILINEAR, background, width, height), &::FreeImage_Unload);
+	assert(moved != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		// scanlines are bottom-up, the translation moves top-down rows
+		const uint8_t *d = FreeImage_GetScanLine(moved.get(), y);
+		for (unsigned x = 0; x < width; ++x, d += 4) {
+			const int sx = static_cast<int>(x) - 3, sy = static_cast<int>(y) - 2;
+			if ((sx < 0) || (sy < 0)) {
+				assert(memcmp(d, background, 4) == 0);
+			} else {
+				assert(memcmp(d, FreeImage_GetScanLine(src.get(), sy) + 4 * sx, 4) == 0);
+			}
+		}
+	}
+
+	// vector and scalar bilinear kernels give the same result
+	const double angle = 0.5;
+	const double rotation[6] = { cos(angle), -sin(angle), 0, sin(angle), cos(angle), 0 };
+	assert(isSameScalarAndSIMD([&] { return FreeImage_AffineTransform(src.get(), rotation, FILTER_BILINEAR, background); }));
+
+	// a quarter turn matches FreeImage_Rotate, the bounding box sets the translation
+	const double quarter[6] = { 0, 1, 0, -1, 0, 0 };
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> turned(FreeImage_AffineTransform(src.get(), quarter), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rotated(FreeImage_Rotate(src.get(), 90), &::FreeImage_Unload);
+	assert(turned && rotated);
+	assert(isSameBitmap(turned.get(), rotated.get()));
+
+	// filters are normalized: a flat image stays flat when reduced
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> flat(FreeImage_AllocateT(FIT_RGB16, width, height), &::FreeImage_Unload);
+	assert(flat != nullptr);
+	const uint16_t value[3] = { 1000, 30000, 65535 };
+	for (unsigned y = 0; y < height; ++y) {
+		uint16_t *bits = reinterpret_cast<uint16_t *>(FreeImage_GetScanLine(flat.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			memcpy(bits + 3 * x, value, sizeof(value));
+		}
+	}
+	const double reduce[6] = { 0.3 * cos(angle), -0.3 * sin(angle), 0, 0.3 * sin(angle), 0.3 * cos(angle), 0 };
+	for (const auto filter : { FILTER_BOX, FILTER_BICUBIC, FILTER_LANCZOS3 }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> small(FreeImage_AffineTransform(flat.get(), reduce, filter, value), &::FreeImage_Unload);
+		assert(small != nullptr);
+		assert(FreeImage_GetImageType(small.get()) == FIT_RGB16);
+		for (unsigned y = 0; y < FreeImage_GetHeight(small.get()); ++y) {
+			const uint16_t *bits = reinterpret_cast<const uint16_t *>(FreeImage_GetScanLine(small.get(), y));
+			for (unsigned x = 0; x < FreeImage_GetWidth(small.get()); ++x) {
+				assert(memcmp(bits + 3 * x, value, sizeof(value)) == 0);
+			}
+		}
+	}
+
+	// destination size from the bounding box
+	const double twice[6] = { 2, 0, 5, 0, 2, 7 };
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> doubled(FreeImage_AffineTransform(src.get(), twice), &::FreeImage_Unload);
+	assert(doubled != nullptr);
+	assert((FreeImage_GetWidth(doubled.get()) == 2 * width) && (FreeImage_GetHeight(doubled.get()) == 2 * height));
+
+	// a singular matrix has no inverse
+	const double singular[6] = { 1, 2, 0, 2, 4, 0 };
+	assert(FreeImage_AffineTransform(src.get(), singular) == nullptr);
+}
+
+void testRotateExParallel()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> plate(createZonePlateImage(301, 187, 64), &::FreeImage_Unload);
+	assert(plate != nullptr);
+
+	for (const unsigned bpp : { 8u, 24u, 32u }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(bpp == 8 ? FreeImage_Clone(plate.get()) : bpp == 24 ? FreeImage_ConvertTo24Bits(plate.get()) : FreeImage_ConvertTo32Bits(plate.get()), &::FreeImage_Unload);
+		assert(src != nullptr);
+
+		// spline interpolation at the sample positions gives back the samples
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> same(FreeImage_RotateEx(src.get(), 0, 0, 0, 0, 0, FALSE), &::FreeImage_Unload);
+		assert(same != nullptr);
+		assert(isSameBitmap(src.get(), same.get()));
+
+		// rows, columns and output rows split over threads give the same result
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+		for (int parallel = 0; parallel < 2; ++parallel) {
+			FreeImage_SetThreadCount(parallel ? 4 : 1);
+			results[parallel].reset(FreeImage_RotateEx(src.get(), 33, 2.5, -4, 150, 90, TRUE));
+			assert(results[parallel] != nullptr);
+		}
+		assert(isSameBitmap(results[0].get(), results[1].get()));
+		assert(FreeImage_GetBPP(results[1].get()) == bpp);
+	}
+
+	FreeImage_SetThreadCount(defaultCount);
+}
+
+void testRescaleFixedPoint()
+{
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> plate(createZonePlateImage(320, 240, 64), &::FreeImage_Unload);
+	assert(plate != nullptr);
+
+	for (const unsigned bpp : { 24u, 32u }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(bpp == 24 ? FreeImage_ConvertTo24Bits(plate.get()) : FreeImage_ConvertTo32Bits(plate.get()), &::FreeImage_Unload);
+		assert(src != nullptr);
+
+		for (const auto filter : { FILTER_BOX, FILTER_BILINEAR, FILTER_BSPLINE, FILTER_CATMULLROM, FILTER_LANCZOS3 }) {
+			for (const auto size : { std::make_pair(97u, 61u), std::make_pair(517u, 389u) }) {
+				// greyscale images are filtered in double precision
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_Rescale(plate.get(), size.first, size.second, filter), &::FreeImage_Unload);
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst(FreeImage_Rescale(src.get(), size.first, size.second, filter), &::FreeImage_Unload);
+				assert(expected && dst);
+				assert(FreeImage_GetBPP(expected.get()) == 8);
+				assert(FreeImage_GetBPP(dst.get()) == bpp);
+
+				// 8-bit fixed point result must match up to rounding of both passes
+				const unsigned bytespp = bpp / 8;
+				int maxDiff = 0;
+				for (unsigned y = 0; y < size.second; ++y) {
+					const uint8_t* line = FreeImage_GetScanLine(dst.get(), y);
+					const uint8_t* lineExpected = FreeImage_GetScanLine(expected.get(), y);
+					for (unsigned x = 0; x < size.first; ++x) {
+						for (unsigned c = 0; c < 3; ++c) {
+							maxDiff = std::max(maxDiff, std::abs(static_cast<int>(lineExpected[x]) - line[x * bytespp + c]));
+						}
+					}
+				}
+				assert(maxDiff <= 2);
+			}
+		}
+	}
+
+	// flat images stay exactly flat
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> flat(FreeImage_Allocate(123, 77, 32), &::FreeImage_Unload);
+	const FIRGBA8 color{ 17, 200, 99, 255 };
+	assert(FreeImage_FillBackground(flat.get(), &color));
+	for (const auto filter : { FILTER_BICUBIC, FILTER_CATMULLROM, FILTER_LANCZOS3 }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst(FreeImage_Rescale(flat.get(), 301, 45, filter), &::FreeImage_Unload);
+		assert(dst != nullptr);
+		for (unsigned y = 0; y < FreeImage_GetHeight(dst.get()); ++y) {
+			const auto line = reinterpret_cast<const FIRGBA8*>(FreeImage_GetScanLine(dst.get(), y));
+			for (unsigned x = 0; x < FreeImage_GetWidth(dst.get()); ++x) {
+				assert(0 == memcmp(&line[x], &color, sizeof(FIRGBA8)));
+			}
+		}
+	}
+}
+
+void testPasteKernels()
+{
+	auto fill = [](FIBITMAP *dib, unsigned seed) {
+		for (unsigned y = 0; y < FreeImage_GetHeight(dib); ++y) {
+			uint8_t *bits = FreeImage_GetScanLine(dib, y);
+			for (unsigned x = 0; x < FreeImage_GetLine(dib); ++x) {
+				bits[x] = static_cast<uint8_t>(x * 31 + y * 17 + seed);
+			}
+		}
+	};
+
+	struct Format { FREE_IMAGE_TYPE type; unsigned bpp; };
+	const Format formats[] = {
+		{ FIT_BITMAP, 8 }, { FIT_BITMAP, 16 }, { FIT_BITMAP, 24 }, { FIT_BITMAP, 32 }, { FIT_UINT16, 16 }, { FIT_FLOAT, 32 }, { FIT_RGBAF, 128 }
+	};
+	for (const auto &format : formats) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst(FreeImage_AllocateT(format.type, 301, 203, format.bpp), &::FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(format.type, 133, 77, format.bpp), &::FreeImage_Unload);
+		assert(dst != nullptr && src != nullptr);
+		fill(dst.get(), 3);
+		fill(src.get(), 101);
+
+		// alpha > 255 copies, other values blend 8-bit channels
+		for (const int alpha : { 256, 0, 100, 255 }) {
+			if ((format.type != FIT_BITMAP) && (alpha < 256)) {
+				continue;
+			}
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+			runScalarAndSIMD([&](bool vector) {
+				results[vector].reset(FreeImage_Clone(dst.get()));
+				assert(results[vector] != nullptr);
+				assert(FreeImage_Paste(results[vector].get(), src.get(), 21, 45, alpha));
+			});
+			assert(isSameBitmap(results[0].get(), results[1].get()));
+
+			// bottom-up scanline of the top row of src in dst
+			const unsigned bytespp = FreeImage_GetLine(src.get()) / FreeImage_GetWidth(src.get());
+			const uint8_t *pasted = FreeImage_GetScanLine(results[1].get(), 203 - 45 - 77) + 21 * bytespp;
+			const uint8_t *under = FreeImage_GetScanLine(dst.get(), 203 - 45 - 77) + 21 * bytespp;
+			const uint8_t *over = FreeImage_GetScanLine(src.get(), 0);
+			if (alpha > 255) {
+				assert(memcmp(pasted, over, FreeImage_GetLine(src.get())) == 0);
+			} else if (format.bpp != 16) {
+				for (unsigned x = 0; x < FreeImage_GetLine(src.get()); ++x) {
+					assert(pasted[x] == static_cast<uint8_t>(((over[x] - under[x]) * alpha + (under[x] << 8)) >> 8));
+				}
+			}
+		}
+	}
+
+	// views are returned when the rectangle allows it, copies otherwise
+	for (const unsigned bpp : { 1u, 24u }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_Allocate(64, 48, bpp), &::FreeImage_Unload);
+		assert(src != nullptr);
+		fill(src.get(), 7);
+		for (const int left : { 8, 3 }) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> copy(FreeImage_Copy(src.get(), left, 5, left + 40, 35), &::FreeImage_Unload);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> view(FreeImage_Copy(src.get(), left, 5, left + 40, 35, FI_COPY_VIEW), &::FreeImage_Unload);
+			assert(copy != nullptr && view != nullptr);
+			assert(isSameBitmap(copy.get(), view.get()));
+
+			const uint8_t *begin = FreeImage_GetBits(src.get());
+			const uint8_t *end = begin + FreeImage_GetPitch(src.get()) * FreeImage_GetHeight(src.get());
+			const uint8_t *bits = FreeImage_GetBits(view.get());
+			const bool shared = (bits >= begin) && (bits < end);
+			assert(shared == ((bpp != 1) || (left % 8 == 0)));
+		}
+	}
+}
+void testBlendKernels()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+
+	// premultiplied pixels, colors never exceed alpha
+	auto fill = [](FIBITMAP *dib, unsigned seed) {
+		for (unsigned y = 0; y < FreeImage_GetHeight(dib); ++y) {
+			FIRGBA8 *bits = reinterpret_cast<FIRGBA8 *>(FreeImage_GetScanLine(dib, y));
+			for (unsigned x = 0; x < FreeImage_GetWidth(dib); ++x) {
+				const unsigned alpha = (x * 53 + y * 29 + seed) % 3 ? (x * 7 + y * 13 + seed) & 0xFF : ((x + y) & 1) * 255;
+				bits[x].alpha = static_cast<uint8_t>(alpha);
+				bits[x].red = static_cast<uint8_t>((x * 31 + seed) % (alpha + 1));
+				bits[x].green = static_cast<uint8_t>((y * 17 + seed) % (alpha + 1));
+				bits[x].blue = static_cast<uint8_t>((x * y + seed) % (alpha + 1));
+			}
+		}
+	};
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst(FreeImage_Allocate(77, 41, 32), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_Allocate(53, 29, 32), &::FreeImage_Unload);
+	assert(dst != nullptr && src != nullptr);
+	fill(dst.get(), 5);
+	fill(src.get(), 91);
+
+	for (const FREE_IMAGE_ALPHA_OPERATION op : { FIAO_SrcAlpha, FIAO_SrcOver, FIAO_Multiply, FIAO_Screen, FIAO_Add }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+		runScalarAndSIMD([&](bool vector) {
+			results[vector].reset(FreeImage_Clone(dst.get()));
+			assert(results[vector] != nullptr);
+			// src is clipped on the left and at the bottom
+			assert(FreeImage_DrawBitmap(results[vector].get(), src.get(), op, -5, 20));
+		});
+		assert(isSameBitmap(results[0].get(), results[1].get()));
+
+		// top left pixel of dst is src (5, 20)
+		const FIRGBA8 &s = reinterpret_cast<const FIRGBA8 *>(FreeImage_GetScanLine(src.get(), 29 - 1))[5];
+		const FIRGBA8 &d = reinterpret_cast<const FIRGBA8 *>(FreeImage_GetScanLine(dst.get(), 41 - 1 - 20))[0];
+		const FIRGBA8 &r = reinterpret_cast<const FIRGBA8 *>(FreeImage_GetScanLine(results[1].get(), 41 - 1 - 20))[0];
+		if (op == FIAO_SrcOver) {
+			assert(r.red == s.red + (d.red * (255 - s.alpha) + 127) / 255);
+			assert(r.alpha == s.alpha + (d.alpha * (255 - s.alpha) + 127) / 255);
+		} else if (op == FIAO_SrcAlpha) {
+			assert(r.green == (s.alpha * s.green + (255 - s.alpha) * d.green) / 255);
+			assert(r.alpha == d.alpha);
+		} else if (op == FIAO_Add) {
+			assert(r.blue == std::min(255, s.blue + d.blue));
+		}
+	}
+
+	// float and half float images, values are exact in both types
+	for (const FREE_IMAGE_TYPE type : { FIT_RGBAF, FIT_RGBAH }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dstF(FreeImage_AllocateT(FIT_RGBAF, 19, 7), &::FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> srcF(FreeImage_AllocateT(FIT_RGBAF, 19, 7), &::FreeImage_Unload);
+		assert(dstF != nullptr && srcF != nullptr);
+		for (unsigned y = 0; y < 7; ++y) {
+			FIRGBAF *d = reinterpret_cast<FIRGBAF *>(FreeImage_GetScanLine(dstF.get(), y));
+			FIRGBAF *s = reinterpret_cast<FIRGBAF *>(FreeImage_GetScanLine(srcF.get(), y));
+			for (unsigned x = 0; x < 19; ++x) {
+				d[x] = { 0.f, 0.f, 1.f, 1.f };
+				s[x] = { 0.5f, 0.f, 0.f, 0.5f };
+			}
+		}
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dstT(type == FIT_RGBAF ? FreeImage_Clone(dstF.get()) : FreeImage_ConvertToRGBAH(dstF.get()), &::FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> srcT(type == FIT_RGBAF ? FreeImage_Clone(srcF.get()) : FreeImage_ConvertToRGBAH(srcF.get()), &::FreeImage_Unload);
+		assert(dstT != nullptr && srcT != nullptr);
+		assert(FreeImage_DrawBitmap(dstT.get(), srcT.get(), FIAO_SrcOver, 3, 2));
+
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> result(type == FIT_RGBAF ? FreeImage_Clone(dstT.get()) : FreeImage_ConvertToRGBAF(dstT.get()), &::FreeImage_Unload);
+		assert(result != nullptr);
+		const FIRGBAF *line = reinterpret_cast<const FIRGBAF *>(FreeImage_GetScanLine(result.get(), 7 - 1 - 2));
+		assert(line[2].red == 0.f && line[2].blue == 1.f);
+		assert(line[3].red == 0.5f && line[3].green == 0.f && line[3].blue == 0.5f && line[3].alpha == 1.f);
+	}
+
+	// composition against a checkerboard is independent of the thread count
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> composites[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+	for (int threads = 0; threads < 2; ++threads) {
+		FreeImage_SetThreadCount(threads ? 4 : 1);
+		composites[threads].reset(FreeImage_Composite(dst.get()));
+		assert(composites[threads] != nullptr);
+	}
+	assert(isSameBitmap(composites[0].get(), composites[1].get()));
+
+	FreeImage_SetThreadCount(defaultCount);
+}
+void testPreMultiplyKernels()
+{
+	for (const FREE_IMAGE_TYPE type : { FIT_BITMAP, FIT_RGBA16, FIT_RGBAF }) {
+		// odd widths leave pixels to the scalar code
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(type, 67, 23, type == FIT_BITMAP ? 32 : 0), &::FreeImage_Unload);
+		assert(src != nullptr);
+		for (unsigned y = 0; y < FreeImage_GetHeight(src.get()); ++y) {
+			uint8_t *bits = FreeImage_GetScanLine(src.get(), y);
+			for (unsigned x = 0; x < FreeImage_GetWidth(src.get()); ++x) {
+				const unsigned value = x * 97 + y * 61;
+				if (type == FIT_BITMAP) {
+					FIRGBA8 &p = reinterpret_cast<FIRGBA8 *>(bits)[x];
+					p = { static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 2), static_cast<uint8_t>(value * 3), static_cast<uint8_t>(value * 7) };
+				} else if (type == FIT_RGBA16) {
+					FIRGBA16 &p = reinterpret_cast<FIRGBA16 *>(bits)[x];
+					p = { static_cast<uint16_t>(value * 331), static_cast<uint16_t>(value * 59), static_cast<uint16_t>(value * 7919), static_cast<uint16_t>(value * 4099) };
+				} else {
+					FIRGBAF &p = reinterpret_cast<FIRGBAF *>(bits)[x];
+					p = { (value % 101) / 100.f, (value % 37) / 36.f, (value % 13) / 12.f, (value % 17) / 16.f };
+				}
+			}
+		}
+
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+		runScalarAndSIMD([&](bool vector) {
+			results[vector].reset(FreeImage_Clone(src.get()));
+			assert(results[vector] != nullptr);
+			assert(FreeImage_PreMultiplyWithAlpha(results[vector].get()));
+		});
+		assert(isSameBitmap(results[0].get(), results[1].get()));
+
+		// premultiplied colors come back from the un-premultiplication unchanged once premultiplied again
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> restored(FreeImage_Clone(results[1].get()), &::FreeImage_Unload);
+		assert(restored != nullptr);
+		assert(FreeImage_UnPreMultiplyWithAlpha(restored.get()));
+		for (unsigned y = 0; y < FreeImage_GetHeight(src.get()); ++y) {
+			const uint8_t *original = FreeImage_GetScanLine(src.get(), y);
+			const uint8_t *premultiplied = FreeImage_GetScanLine(results[1].get(), y);
+			const uint8_t *unpremultiplied = FreeImage_GetScanLine(restored.get(), y);
+			for (unsigned x = 0; x < FreeImage_GetWidth(src.get()); ++x) {
+				if (type == FIT_BITMAP) {
+					const FIRGBA8 &o = reinterpret_cast<const FIRGBA8 *>(original)[x];
+					const FIRGBA8 &p = reinterpret_cast<const FIRGBA8 *>(premultiplied)[x];
+					const FIRGBA8 &u = reinterpret_cast<const FIRGBA8 *>(unpremultiplied)[x];
+					assert(p.alpha == o.alpha && u.alpha == o.alpha);
+					assert(p.green == (o.alpha * o.green + 127) / 255);
+					assert((o.alpha * u.green + 127) / 255 == p.green);
+					if (o.alpha == 255) {
+						assert(u.red == o.red && u.green == o.green && u.blue == o.blue);
+					}
+				} else if (type == FIT_RGBA16) {
+					const FIRGBA16 &o = reinterpret_cast<const FIRGBA16 *>(original)[x];
+					const FIRGBA16 &p = reinterpret_cast<const FIRGBA16 *>(premultiplied)[x];
+					assert(p.alpha == o.alpha);
+					assert(p.blue == (static_cast<uint32_t>(o.alpha) * o.blue + 32767) / 65535);
+				} else {
+					const FIRGBAF &o = reinterpret_cast<const FIRGBAF *>(original)[x];
+					const FIRGBAF &p = reinterpret_cast<const FIRGBAF *>(premultiplied)[x];
+					const FIRGBAF &u = reinterpret_cast<const FIRGBAF *>(unpremultiplied)[x];
+					assert(p.red == o.red * o.alpha && p.alpha == o.alpha);
+					assert(o.alpha == 0 ? u.red == 0 : std::fabs(u.red - o.red) < 1e-5f);
+				}
+			}
+		}
+	}
+
+	// opaque red next to transparent green: green must not bleed into the rescaled edge
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> edge(FreeImage_Allocate(64, 8, 32), &::FreeImage_Unload);
+	assert(edge != nullptr);
+	for (unsigned y = 0; y < 8; ++y) {
+		FIRGBA8 *bits = reinterpret_cast<FIRGBA8 *>(FreeImage_GetScanLine(edge.get(), y));
+		for (unsigned x = 0; x < 64; ++x) {
+			bits[x] = (x < 32) ? FIRGBA8{ 255, 0, 0, 255 } : FIRGBA8{ 0, 255, 0, 0 };
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scaled(FreeImage_RescaleRect(edge.get(), 16, 8, 0, 0, 64, 8, FILTER_BILINEAR, FI_RESCALE_PREMULTIPLY_ALPHA), &::FreeImage_Unload);
+	assert(scaled != nullptr);
+	for (unsigned x = 0; x < 16; ++x) {
+		const FIRGBA8 &p = reinterpret_cast<const FIRGBA8 *>(FreeImage_GetScanLine(scaled.get(), 4))[x];
+		assert(p.green == 0);
+		assert((p.alpha == 0) || (p.red == 255));
+	}
+}
+void testFillKernels()
+{
+	runScalarAndSIMD([&](bool) {
+		// 8 MB of floats take the non-temporal path, odd widths leave unaligned row ends
+		for (const unsigned width : { 3u, 2047u }) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_AllocateT(FIT_RGBF, width, 4096 / width * 181, 0), &::FreeImage_Unload);
+			assert(dib != nullptr);
+			const FIRGBF value = { 0.25f, -1.5f, 3.f };
+			assert(FreeImage_Fill(dib.get(), &value, sizeof(value)));
+			for (unsigned y = 0; y < FreeImage_GetHeight(dib.get()); y += 7) {
+				const FIRGBF *line = reinterpret_cast<const FIRGBF *>(FreeImage_GetScanLine(dib.get(), y));
+				for (unsigned x = 0; x < width; ++x) {
+					assert(memcmp(&line[x], &value, sizeof(value)) == 0);
+				}
+			}
+		}
+
+		// background of 24-bit and 16-bit bitmaps
+		for (const unsigned bpp : { 16u, 24u, 32u }) {
+			FIRGBA8 color;
+			color.red = 0xF0;
+			color.green = 0x80;
+			color.blue = 0x10;
+			color.alpha = 0xFF;
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_AllocateEx(1501, 1003, bpp, &color), &::FreeImage_Unload);
+			assert(dib != nullptr);
+			const unsigned bytespp = bpp / 8;
+			const uint8_t *first = FreeImage_GetScanLine(dib.get(), 0);
+			for (unsigned y = 0; y < FreeImage_GetHeight(dib.get()); y += 13) {
+				const uint8_t *line = FreeImage_GetScanLine(dib.get(), y);
+				assert(memcmp(line, first, FreeImage_GetLine(dib.get())) == 0);
+				assert(memcmp(line + 1500 * bytespp, first, bytespp) == 0);
+			}
+			if (bpp >= 24) {
+				assert(first[FI_RGBA_RED] == 0xF0 && first[FI_RGBA_GREEN] == 0x80 && first[FI_RGBA_BLUE] == 0x10);
+			}
+		}
+
+		// black backgrounds are left to the zeroed allocation
+		const FIRGBA8 black = { 0, 0, 0, 0 };
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_AllocateEx(4099, 1031, 32, &black), &::FreeImage_Unload);
+		assert(dib != nullptr);
+		for (unsigned y = 0; y < FreeImage_GetHeight(dib.get()); y += 97) {
+			const uint8_t *line = FreeImage_GetScanLine(dib.get(), y);
+			for (unsigned x = 0; x < FreeImage_GetLine(dib.get()); ++x) {
+				assert(line[x] == 0);
+			}
+		}
+	});
+}
+
+void testEnlargeCanvas()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	FreeImage_SetThreadCount(4);
+
+	FIRGBA8 color;
+	color.red = 0x20;
+	color.green = 0x40;
+	color.blue = 0x60;
+	color.alpha = 0x80;
+	const float fcolor = -2.5f;
+
+	const struct { FREE_IMAGE_TYPE type; unsigned bpp; const void *color; } formats[] = {
+		{ FIT_BITMAP, 8, &color }, { FIT_BITMAP, 16, &color }, { FIT_BITMAP, 24, &color }, { FIT_BITMAP, 32, &color }, { FIT_FLOAT, 32, &fcolor }
+	};
+	const int margins[][4] = {
+		{ 10, 20, 30, 40 }, { 0, 17, 0, 17 }, { -5, 3, 7, -9 }, { 6, -11, -2, 0 }
+	};
+
+	for (const auto &format : formats) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(format.type, 203, 151, format.bpp), &::FreeImage_Unload);
+		assert(src != nullptr);
+		for (unsigned y = 0; y < 151; ++y) {
+			uint8_t *line = FreeImage_GetScanLine(src.get(), y);
+			for (unsigned x = 0; x < FreeImage_GetLine(src.get()); ++x) {
+				line[x] = static_cast<uint8_t>(x * 7 + y * 13);
+			}
+		}
+		if (format.bpp == 8) {
+			FIRGBA8 *pal = FreeImage_GetPalette(src.get());
+			for (unsigned i = 0; i < 256; ++i) {
+				pal[i].red = pal[i].green = pal[i].blue = static_cast<uint8_t>(i);
+			}
+			pal[77] = color;
+		}
+
+		for (const auto &m : margins) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst(FreeImage_EnlargeCanvas(src.get(), m[0], m[1], m[2], m[3], format.color, FI_COLOR_FIND_EQUAL_COLOR), &::FreeImage_Unload);
+			assert(dst != nullptr);
+
+			// reference: fill the whole canvas, then paste the visible part of src
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> ref(FreeImage_AllocateExT(format.type, 203 + m[0] + m[2], 151 + m[1] + m[3], format.bpp, format.color, FI_COLOR_FIND_EQUAL_COLOR,
+				FreeImage_GetPalette(src.get()), FreeImage_GetRedMask(src.get()), FreeImage_GetGreenMask(src.get()), FreeImage_GetBlueMask(src.get())), &::FreeImage_Unload);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> part(FreeImage_Copy(src.get(), std::max(0, -m[0]), std::max(0, -m[1]), std::min(203, 203 + m[2]), std::min(151, 151 + m[3])), &::FreeImage_Unload);
+			assert(ref != nullptr && part != nullptr);
+			assert(FreeImage_Paste(ref.get(), part.get(), std::max(0, m[0]), std::max(0, m[1]), 256));
+			assert(isSameBitmap(dst.get(), ref.get()));
+		}
+	}
+
+	// a pure crop may share the pixels of src
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_Allocate(320, 240, 24), &::FreeImage_Unload);
+	assert(src != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> view(FreeImage_EnlargeCanvas(src.get(), -8, -4, -16, -2, nullptr, FI_CANVAS_VIEW), &::FreeImage_Unload);
+	assert(view != nullptr);
+	assert(FreeImage_GetWidth(view.get()) == 296 && FreeImage_GetHeight(view.get()) == 234);
+	assert(FreeImage_GetConstScanLine(view.get(), 0) == FreeImage_GetConstScanLine(src.get(), 2) + 8 * 3);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> copy(FreeImage_EnlargeCanvas(src.get(), -8, -4, -16, -2, nullptr), &::FreeImage_Unload);
+	assert(copy != nullptr && isSameBitmap(copy.get(), view.get()));
+	assert(FreeImage_GetConstScanLine(copy.get(), 0) != FreeImage_GetConstScanLine(src.get(), 2) + 8 * 3);
+
+	FreeImage_SetThreadCount(defaultCount);
+}
+
+void testMinMaxParallel()
+{
+	const unsigned width = 1001, height = 523;
+
+	// 16-bit stack with its extrema repeated, ties keep the first pixel in scan order
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey16(FreeImage_AllocateT(FIT_UINT16, width, height), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> sint16(FreeImage_AllocateT(FIT_INT16, width, height), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> flt(FreeImage_AllocateT(FIT_FLOAT, width, height), &::FreeImage_Unload);
+	assert(grey16 != nullptr && sint16 != nullptr && flt != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		auto u = reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(grey16.get(), y));
+		auto s = reinterpret_cast<int16_t*>(FreeImage_GetScanLine(sint16.get(), y));
+		auto f = reinterpret_cast<float*>(FreeImage_GetScanLine(flt.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			u[x] = static_cast<uint16_t>(1000 + (x * 31 + y * 17) % 50000);
+			s[x] = static_cast<int16_t>(static_cast<int>(u[x]) - 26000);
+			f[x] = (x + y) % 7 == 0 ? std::nanf("") : u[x] / 65535.0f;
+		}
+	}
+	reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(grey16.get(), 100))[7] = 65535;
+	reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(grey16.get(), 400))[9] = 65535;
+	reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(grey16.get(), 300))[3] = 3;
+	reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(grey16.get(), 500))[3] = 3;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgb16(FreeImage_ConvertToType(grey16.get(), FIT_RGB16), &::FreeImage_Unload);
+	assert(rgb16 != nullptr);
+
+	for (FIBITMAP *dib : { grey16.get(), sint16.get(), flt.get(), rgb16.get() }) {
+		double minimum[2] = {}, maximum[2] = {};
+		void *minPtr[2] = {}, *maxPtr[2] = {};
+		uint8_t minValue[2][16] = {}, maxValue[2][16] = {};
+		runScalarAndSIMD([&](bool vector) {
+			assert(FreeImage_FindMinMax(dib, &minimum[vector], &maximum[vector], &minPtr[vector], &maxPtr[vector]));
+			assert(minimum[vector] < maximum[vector]);
+
+			// without pointers to locate
+			double lo = 0.0, hi = 0.0;
+			assert(FreeImage_FindMinMax(dib, &lo, &hi));
+			assert(lo == minimum[vector] && hi == maximum[vector]);
+
+			assert(FreeImage_FindMinMaxValue(dib, minValue[vector], maxValue[vector]));
+		});
+		assert(minimum[0] == minimum[1] && maximum[0] == maximum[1]);
+		assert(minPtr[0] == minPtr[1] && maxPtr[0] == maxPtr[1]);
+		assert(memcmp(minValue[0], minValue[1], sizeof(minValue[0])) == 0);
+		assert(memcmp(maxValue[0], maxValue[1], sizeof(maxValue[0])) == 0);
+	}
+
+	const uint8_t *bits = FreeImage_GetBits(grey16.get());
+	const unsigned pitch = FreeImage_GetPitch(grey16.get());
+	void *minPtr = nullptr, *maxPtr = nullptr;
+	double minBrightness = 0.0, maxBrightness = 0.0;
+	assert(FreeImage_FindMinMax(grey16.get(), &minBrightness, &maxBrightness, &minPtr, &maxPtr));
+	assert(minBrightness == 3.0 && maxBrightness == 65535.0);
+	assert(minPtr == bits + 300 * pitch + 3 * sizeof(uint16_t));
+	assert(maxPtr == bits + 100 * pitch + 7 * sizeof(uint16_t));
+
+	float minFloat = 0.f, maxFloat = 0.f;
+	assert(FreeImage_FindMinMaxValue(flt.get(), &minFloat, &maxFloat));
+	assert(!std::isnan(minFloat) && !std::isnan(maxFloat) && minFloat < maxFloat);
+}
+
+void testComputeBackend()
+{
+	// the CPU is always available, unavailable backends are refused
+	assert(FreeImage_IsComputeBackendAvailable(FICB_CPU));
+	assert(FreeImage_GetComputeBackend() == FICB_CPU);
+	const bool opencl = FreeImage_IsComputeBackendAvailable(FICB_OPENCL) != FALSE;
+	assert(FreeImage_SetComputeBackend(FICB_OPENCL) == (opencl ? TRUE : FALSE));
+	assert(FreeImage_GetComputeBackend() == (opencl ? FICB_OPENCL : FICB_CPU));
+	assert(FreeImage_SetComputeBackend(FICB_CPU));
+
+	const unsigned width = 203, height = 117;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> hdr(FreeImage_AllocateT(FIT_RGBAF, width, height), &::FreeImage_Unload);
+	assert(hdr != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		auto pixel = reinterpret_cast<FIRGBAF*>(FreeImage_GetScanLine(hdr.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			const float value = std::exp(4.0f * std::sin(x * 0.031f) * std::cos(y * 0.047f));
+			pixel[x] = { value, value * 0.6f + 0.02f, value * 0.3f + 0.05f, (float)((x + y) % 5) / 4 };
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbf(FreeImage_ConvertToRGBF(hdr.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey(FreeImage_ConvertToFloat(hdr.get()), &::FreeImage_Unload);
+	assert(rgbf != nullptr && grey != nullptr);
+
+	// the device accumulates in single precision, the CPU in double precision
+	const auto isCloseFloats = [](FIBITMAP *lhs, FIBITMAP *rhs) {
+		assert(FreeImage_GetImageType(lhs) == FreeImage_GetImageType(rhs));
+		assert(FreeImage_GetWidth(lhs) == FreeImage_GetWidth(rhs) && FreeImage_GetHeight(lhs) == FreeImage_GetHeight(rhs));
+		const unsigned count = FreeImage_GetLine(lhs) / sizeof(float);
+		for (unsigned y = 0; y < FreeImage_GetHeight(lhs); ++y) {
+			auto l = reinterpret_cast<const float*>(FreeImage_GetScanLine(lhs, y));
+			auto r = reinterpret_cast<const float*>(FreeImage_GetScanLine(rhs, y));
+			for (unsigned x = 0; x < count; ++x) {
+				if (std::abs(l[x] - r[x]) > 1e-4f * (1 + std::abs(r[x]))) {
+					return false;
+				}
+			}
+		}
+		return true;
+	};
+	const auto isCloseBytes = [](FIBITMAP *lhs, FIBITMAP *rhs) {
+		assert(FreeImage_GetWidth(lhs) == FreeImage_GetWidth(rhs) && FreeImage_GetHeight(lhs) == FreeImage_GetHeight(rhs));
+		for (unsigned y = 0; y < FreeImage_GetHeight(lhs); ++y) {
+			const uint8_t *l = FreeImage_GetScanLine(lhs, y);
+			const uint8_t *r = FreeImage_GetScanLine(rhs, y);
+			for (unsigned x = 0; x < FreeImage_GetLine(lhs); ++x) {
+				if (std::abs(l[x] - r[x]) > 2) {
+					return false;
+				}
+			}
+		}
+		return true;
+	};
+
+	// results of the selected backend (or of the CPU fallback) match the CPU code
+	const std::function<FIBITMAP*(unsigned)> rescales[] = {
+		[&](unsigned flags) { return FreeImage_RescaleRect(hdr.get(), 97, 61, 0, 0, width, height, FILTER_CATMULLROM, flags); },
+		[&](unsigned flags) { return FreeImage_RescaleRect(rgbf.get(), 311, 173, 11, 7, 190, 100, FILTER_LANCZOS3, flags); },
+		[&](unsigned flags) { return FreeImage_RescaleRect(grey.get(), 64, 250, 3, 0, 200, 117, FILTER_BILINEAR, flags); }
+	};
+	for (const auto &rescale : rescales) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> cpu(rescale(FI_RESCALE_DEFAULT), &::FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> device(rescale(FI_RESCALE_COMPUTE_DEVICE), &::FreeImage_Unload);
+		assert(cpu != nullptr && device != nullptr);
+		assert(isCloseFloats(device.get(), cpu.get()));
+		if (opencl) {
+			FreeImage_SetComputeBackend(FICB_OPENCL);
+			device.reset(rescale(FI_RESCALE_DEFAULT));
+			FreeImage_SetComputeBackend(FICB_CPU);
+			assert(device != nullptr && isCloseFloats(device.get(), cpu.get()));
+		}
+	}
+
+	const std::function<FIBITMAP*(FIBITMAP*)> operators[] = {
+		[](FIBITMAP *dib) { return FreeImage_TmoDrago03(dib, 2.2, 0); },
+		[](FIBITMAP *dib) { return FreeImage_TmoDrago03(dib, 1, 1.5); },
+		[](FIBITMAP *dib) { return FreeImage_TmoReinhard05Ex(dib, 0, 0, 1, 0); },
+		[](FIBITMAP *dib) { return FreeImage_TmoReinhard05Ex(dib, 0.5, 0.8, 0.5, 0.5); }
+	};
+	for (const auto &tmo : operators) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> cpu(tmo(rgbf.get()), &::FreeImage_Unload);
+		assert(cpu != nullptr);
+		if (opencl) {
+			FreeImage_SetComputeBackend(FICB_OPENCL);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> device(tmo(rgbf.get()), &::FreeImage_Unload);
+			FreeImage_SetComputeBackend(FICB_CPU);
+			assert(device != nullptr && isCloseBytes(device.get(), cpu.get()));
+		}
+	}
+}
+
+void testConvolve()
+{
+	const unsigned width = 233, height = 171;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo24Bits(zone.get()), &::FreeImage_Unload);
+	assert(color != nullptr);
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t *pixel = FreeImage_GetScanLine(color.get(), y);
+		for (unsigned x = 0; x < width; ++x, pixel += 3) {
+			pixel[FI_RGBA_RED] = static_cast<uint8_t>(x + y);
+		}
+	}
+
+	auto max_difference = [](FIBITMAP *a, FIBITMAP *b) {
+		int difference = 0;
+		for (unsigned y = 0; y < FreeImage_GetHeight(a); ++y) {
+			const uint8_t *pa = FreeImage_GetScanLine(a, y);
+			const uint8_t *pb = FreeImage_GetScanLine(b, y);
+			for (unsigned i = 0; i < FreeImage_GetLine(a); ++i) {
+				difference = std::max(difference, abs(pa[i] - pb[i]));
+			}
+		}
+		return difference;
+	};
+
+	// box blur: mean of the neighbourhood with replicated edges
+	for (const unsigned radius : { 1u, 4u, 40u }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> box(FreeImage_BoxBlur(zone.get(), radius), &::FreeImage_Unload);
+		assert(box != nullptr && FreeImage_GetBPP(box.get()) == 8);
+		const int r = static_cast<int>(radius);
+		for (unsigned y = 0; y < height; y += 13) {
+			for (unsigned x = 0; x < width; x += 7) {
+				double sum = 0;
+				for (int j = -r; j <= r; ++j) {
+					for (int i = -r; i <= r; ++i) {
+						const int sx = std::min(std::max(static_cast<int>(x) + i, 0), static_cast<int>(width) - 1);
+						const int sy = std::min(std::max(static_cast<int>(y) + j, 0), static_cast<int>(height) - 1);
+						sum += FreeImage_GetScanLine(zone.get(), sy)[sx];
+					}
+				}
+				const double mean = sum / ((2 * r + 1) * (2 * r + 1));
+				assert(fabs(FreeImage_GetScanLine(box.get(), y)[x] - mean) <= 0.5 + 1e-6);
+			}
+		}
+	}
+
+	// results do not depend on the number of threads, SIMD kernels match the scalar code
+	const double sharpen[] = { -0.5, 2.0, -0.5 };
+	for (int filter = 0; filter < 5; ++filter) {
+		auto apply = [&](FIBITMAP *dib) {
+			switch (filter) {
+				case 0: return FreeImage_BoxBlur(dib, 3);
+				case 1: return FreeImage_GaussianBlur(dib, 1.5);
+				case 2: return FreeImage_GaussianBlur(dib, 12.0);
+				case 3: return FreeImage_UnsharpMask(dib, 1.0, 0.8);
+				default: return FreeImage_Convolve(dib, sharpen, 3);
+			}
+		};
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serial(nullptr, &::FreeImage_Unload);
+		runScalarAndSIMD([&](bool vector) {
+			if (vector) {
+				FreeImage_SetThreadCount(1);
+				serial.reset(apply(color.get()));
+				FreeImage_SetThreadCount(4);
+			}
+			results[vector].reset(apply(color.get()));
+			assert(results[vector] != nullptr);
+		});
+		assert(serial != nullptr);
+		assert(FreeImage_GetBPP(results[1].get()) == 24);
+		assert(max_difference(serial.get(), results[1].get()) == 0);
+		assert(max_difference(results[0].get(), serial.get()) <= 1);
+	}
+
+	// identity kernels and a null amount keep the image
+	const double identity[] = { 0, 1, 0 };
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> same(FreeImage_Convolve(color.get(), identity, 3), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> unchanged(FreeImage_UnsharpMask(color.get(), 2.0, 0), &::FreeImage_Unload);
+	assert(same != nullptr && unchanged != nullptr);
+	assert(max_difference(same.get(), color.get()) == 0);
+	assert(max_difference(unchanged.get(), color.get()) == 0);
+	assert(FreeImage_Convolve(color.get(), identity, 2) == nullptr);
+	assert(FreeImage_GaussianBlur(color.get(), 0) == nullptr);
+
+	// unsharp mask overshoots both sides of an edge
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> edge(FreeImage_Allocate(64, 8, 8), &::FreeImage_Unload);
+	FIRGBA8 *pal = FreeImage_GetPalette(edge.get());
+	for (unsigned i = 0; i < 256; ++i) {
+		pal[i].red = pal[i].green = pal[i].blue = static_cast<uint8_t>(i);
+	}
+	for (unsigned y = 0; y < 8; ++y) {
+		memset(FreeImage_GetScanLine(edge.get(), y), 64, 32);
+		memset(FreeImage_GetScanLine(edge.get(), y) + 32, 192, 32);
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> sharp(FreeImage_UnsharpMask(edge.get(), 1.0, 1.0), &::FreeImage_Unload);
+	assert(sharp != nullptr);
+	assert(FreeImage_GetScanLine(sharp.get(), 4)[31] < 64 && FreeImage_GetScanLine(sharp.get(), 4)[32] > 192);
+	assert(FreeImage_GetScanLine(sharp.get(), 4)[0] == 64 && FreeImage_GetScanLine(sharp.get(), 4)[63] == 192);
+
+	// other image types keep their type, a constant image stays constant
+	for (const FREE_IMAGE_TYPE type : { FIT_UINT16, FIT_INT32, FIT_FLOAT, FIT_DOUBLE, FIT_RGB16, FIT_RGBAF, FIT_RGBAH, FIT_COMPLEX }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> flat(FreeImage_AllocateT(type, 67, 45), &::FreeImage_Unload);
+		assert(flat != nullptr);
+		const unsigned line = FreeImage_GetLine(flat.get());
+		std::vector<uint8_t> pattern(line);
+		switch (type) {
+			case FIT_FLOAT: case FIT_RGBAF: {
+				std::vector<float> values(line / sizeof(float), 0.75f);
+				memcpy(pattern.data(), values.data(), line);
+				break;
+			}
+			case FIT_DOUBLE: case FIT_COMPLEX: {
+				std::vector<double> values(line / sizeof(double), 0.75);
+				memcpy(pattern.data(), values.data(), line);
+				break;
+			}
+			case FIT_RGBAH: {
+				std::vector<uint16_t> values(line / sizeof(uint16_t), 0x3A00);	// 0.75
+				memcpy(pattern.data(), values.data(), line);
+				break;
+			}
+			case FIT_INT32: {
+				std::vector<int32_t> values(line / sizeof(int32_t), -1234567);
+				memcpy(pattern.data(), values.data(), line);
+				break;
+			}
+			default: {
+				std::vector<uint16_t> values(line / sizeof(uint16_t), 40000);
+				memcpy(pattern.data(), values.data(), line);
+				break;
+			}
+		}
+		for (unsigned y = 0; y < 45; ++y) {
+			memcpy(FreeImage_GetScanLine(flat.get(), y), pattern.data(), line);
+		}
+		for (const double sigma : { 2.0, 20.0 }) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> blurred(FreeImage_GaussianBlur(flat.get(), sigma), &::FreeImage_Unload);
+			assert(blurred != nullptr);
+			assert(FreeImage_GetImageType(blurred.get()) == type);
+			for (unsigned y = 0; y < 45; ++y) {
+				const uint8_t *bits = FreeImage_GetScanLine(blurred.get(), y);
+				if ((type == FIT_FLOAT) || (type == FIT_RGBAF)) {
+					for (unsigned i = 0; i < line / sizeof(float); ++i) {
+						assert(fabs(reinterpret_cast<const float *>(bits)[i] - 0.75f) < 1e-5);
+					}
+				} else if ((type == FIT_DOUBLE) || (type == FIT_COMPLEX)) {
+					for (unsigned i = 0; i < line / sizeof(double); ++i) {
+						assert(fabs(reinterpret_cast<const double *>(bits)[i] - 0.75) < 1e-9);
+					}
+				} else {
+					assert(memcmp(bits, pattern.data(), line) == 0);
+				}
+			}
+		}
+	}
+
+	// thumbnail pipeline: rescale then sharpen
+	FIPIPELINE *pipeline = FreeImage_CreatePipeline();
+	assert(pipeline != nullptr);
+	assert(FreeImage_PipelineRescale(pipeline, 100, 80));
+	assert(FreeImage_PipelineUnsharpMask(pipeline, 0.8, 0.6));
+	assert(!FreeImage_PipelineUnsharpMask(pipeline, 0, 0.6));
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> thumbnail(FreeImage_ExecutePipeline(pipeline, color.get()), &::FreeImage_Unload);
+	FreeImage_DeletePipeline(pipeline);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rescaled(FreeImage_Rescale(color.get(), 100, 80), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_UnsharpMask(rescaled.get(), 0.8, 0.6), &::FreeImage_Unload);
+	assert(thumbnail != nullptr && expected != nullptr);
+	assert(max_difference(thumbnail.get(), expected.get()) == 0);
+}
+
+void testRescaleSharpen()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+	const unsigned width = 311, height = 427;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo32Bits(zone.get()), &::FreeImage_Unload);
+	assert(color != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbf(FreeImage_ConvertToRGBF(zone.get()), &::FreeImage_Unload);
+	assert(rgbf != nullptr);
+
+	auto same_pixels = [](FIBITMAP *a, FIBITMAP *b) {
+		if ((FreeImage_GetImageType(a) != FreeImage_GetImageType(b)) || (FreeImage_GetBPP(a) != FreeImage_GetBPP(b))) return false;
+		if ((FreeImage_GetWidth(a) != FreeImage_GetWidth(b)) || (FreeImage_GetHeight(a) != FreeImage_GetHeight(b))) return false;
+		for (unsigned y = 0; y < FreeImage_GetHeight(a); ++y) {
+			if (memcmp(FreeImage_GetScanLine(a, y), FreeImage_GetScanLine(b, y), FreeImage_GetLine(a)) != 0) return false;
+		}
+		return true;
+	};
+
+	// sharpening while rescaling gives the unsharp mask of the rescaled image, whatever the number of threads
+	const unsigned flags = FI_RESCALE_SHARPEN_AMOUNT(80) | FI_RESCALE_SHARPEN_RADIUS(12);
+	for (FIBITMAP *src : { zone.get(), color.get(), rgbf.get() }) {
+		for (const unsigned size : { 97u, 300u, 640u }) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scaled(FreeImage_Rescale(src, size, size * 2 / 3, FILTER_BICUBIC), &::FreeImage_Unload);
+			assert(scaled != nullptr);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_UnsharpMask(scaled.get(), 1.2, 0.8), &::FreeImage_Unload);
+			assert(expected != nullptr);
+			for (const unsigned threads : { 1u, 4u }) {
+				FreeImage_SetThreadCount(threads);
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> sharp(FreeImage_RescaleRect(src, size, size * 2 / 3, 0, 0, width, height, FILTER_BICUBIC, flags), &::FreeImage_Unload);
+				assert(sharp != nullptr);
+				assert(same_pixels(sharp.get(), expected.get()));
+
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> into(FreeImage_Clone(scaled.get()), &::FreeImage_Unload);
+				assert(into != nullptr);
+				assert(FreeImage_RescaleInto(into.get(), src, FILTER_BICUBIC, flags));
+				assert(same_pixels(into.get(), expected.get()));
+			}
+			FreeImage_SetThreadCount(defaultCount);
+		}
+	}
+
+	// default amount and radius, the flag also sharpens a copy of the same size
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> copy(FreeImage_RescaleRect(color.get(), width, height, 0, 0, width, height, FILTER_BOX, FI_RESCALE_SHARPEN), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_UnsharpMask(color.get(), 0.8, 0.5), &::FreeImage_Unload);
+	assert(copy != nullptr && expected != nullptr);
+	assert(same_pixels(copy.get(), expected.get()));
+}
+
+void testRescaleBoxReduction()
+{
+	const unsigned width = 2400, height = 1610;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo24Bits(zone.get()), &::FreeImage_Unload);
+	assert(color != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgb16(FreeImage_ConvertToRGB16(color.get()), &::FreeImage_Unload);
+	assert(rgb16 != nullptr);
+
+
+	// a large downscale first averages blocks of 12 x 12 pixels (the last row of blocks is partial), then filters 200 x 135 pixels
+	const unsigned factor = 12, reduced_width = 200, reduced_height = (height + factor - 1) / factor;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> reduced(FreeImage_Allocate(reduced_width, reduced_height, 24), &::FreeImage_Unload);
+	assert(reduced != nullptr);
+	for (unsigned t = 0; t < reduced_height; ++t) {
+		uint8_t *dst = FreeImage_GetScanLine(reduced.get(), reduced_height - 1 - t);
+		const unsigned rows = std::min(factor, height - t * factor);
+		for (unsigned x = 0; x < reduced_width; ++x) {
+			for (unsigned c = 0; c < 3; ++c) {
+				unsigned sum = 0;
+				for (unsigned j = 0; j < rows; ++j) {
+					const uint8_t *src = FreeImage_GetScanLine(color.get(), height - 1 - (t * factor + j));
+					for (unsigned i = 0; i < factor; ++i) {
+						sum += src[(x * factor + i) * 3 + c];
+					}
+				}
+				const unsigned area = rows * factor;
+				dst[x * 3 + c] = static_cast<uint8_t>((sum + area / 2) / area);
+			}
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_Rescale(reduced.get(), 100, 67, FILTER_CATMULLROM), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> small(FreeImage_Rescale(color.get(), 100, 67, FILTER_CATMULLROM), &::FreeImage_Unload);
+	assert(expected != nullptr && small != nullptr);
+	assert(isSameBitmap(small.get(), expected.get()));
+
+	// greyscale images are reduced the same way
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey(FreeImage_Rescale(zone.get(), 100, 67, FILTER_CATMULLROM), &::FreeImage_Unload);
+	assert(grey != nullptr && FreeImage_GetBPP(grey.get()) == 8);
+	for (unsigned y = 0; y < 67; ++y) {
+		for (unsigned x = 0; x < 100; ++x) {
+			assert(std::abs(FreeImage_GetScanLine(grey.get(), y)[x] - FreeImage_GetScanLine(small.get(), y)[x * 3]) <= 2);
+		}
+	}
+
+	// SIMD kernels and bands give the scalar results
+	for (FIBITMAP *src : { color.get(), rgb16.get() }) {
+		assert(isSameScalarAndSIMD([&] { return FreeImage_Rescale(src, 151, 37, FILTER_BILINEAR); }));
+	}
+
+	// flat images stay flat
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> flat(FreeImage_Allocate(1999, 1001, 32), &::FreeImage_Unload);
+	const FIRGBA8 background{ 17, 200, 99, 255 };
+	assert(FreeImage_FillBackground(flat.get(), &background));
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst(FreeImage_Rescale(flat.get(), 77, 30, FILTER_LANCZOS3), &::FreeImage_Unload);
+	assert(dst != nullptr);
+	for (unsigned y = 0; y < FreeImage_GetHeight(dst.get()); ++y) {
+		const auto line = reinterpret_cast<const FIRGBA8*>(FreeImage_GetScanLine(dst.get(), y));
+		for (unsigned x = 0; x < FreeImage_GetWidth(dst.get()); ++x) {
+			assert(0 == memcmp(&line[x], &background, sizeof(FIRGBA8)));
+		}
+	}
+}
+
+void testRescaleFloatKernels()
+{
+	const unsigned width = 331, height = 207;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey(FreeImage_ConvertToFloat(zone.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbf(FreeImage_ConvertToRGBF(zone.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbaf(FreeImage_ConvertToRGBAF(zone.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> words(FreeImage_ConvertToUINT16(zone.get()), &::FreeImage_Unload);
+	assert(grey != nullptr && rgbf != nullptr && rgbaf != nullptr && words != nullptr);
+
+	auto max_difference = [](FIBITMAP *a, FIBITMAP *b) {
+		assert(FreeImage_GetLine(a) == FreeImage_GetLine(b) && FreeImage_GetHeight(a) == FreeImage_GetHeight(b));
+		float difference = 0;
+		for (unsigned y = 0; y < FreeImage_GetHeight(a); ++y) {
+			const float *pa = reinterpret_cast<const float *>(FreeImage_GetScanLine(a, y));
+			const float *pb = reinterpret_cast<const float *>(FreeImage_GetScanLine(b, y));
+			for (unsigned i = 0; i < FreeImage_GetLine(a) / sizeof(float); ++i) {
+				difference = std::max(difference, std::fabs(pa[i] - pb[i]));
+			}
+		}
+		return difference;
+	};
+
+	const std::pair<unsigned, unsigned> sizes[] = { { 97, 61 }, { 160, 307 }, { 700, 100 } };
+	for (FIBITMAP *src : { grey.get(), rgbf.get(), rgbaf.get() }) {
+		for (const auto &size : sizes) {
+			for (const auto filter : { FILTER_BILINEAR, FILTER_BSPLINE, FILTER_CATMULLROM, FILTER_LANCZOS3 }) {
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_Rescale(words.get(), size.first, size.second, filter), &::FreeImage_Unload);
+				assert(expected != nullptr);
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+				runScalarAndSIMD([&](bool vector) {
+					results[vector].reset(FreeImage_Rescale(src, size.first, size.second, filter));
+					assert(results[vector] != nullptr);
+				});
+				assert(max_difference(results[0].get(), results[1].get()) <= 1e-5f);
+
+				// single precision filtering matches the double precision filtering of the 16-bit image,
+				// with filters that do not overshoot (16-bit samples are clamped after the first pass)
+				if ((filter != FILTER_BILINEAR) && (filter != FILTER_BSPLINE)) {
+					continue;
+				}
+				const unsigned channels = FreeImage_GetBPP(src) / 32;
+				for (unsigned y = 0; y < size.second; ++y) {
+					const float *line = reinterpret_cast<const float *>(FreeImage_GetScanLine(results[1].get(), y));
+					const uint16_t *lineExpected = reinterpret_cast<const uint16_t *>(FreeImage_GetScanLine(expected.get(), y));
+					for (unsigned x = 0; x < size.first; ++x) {
+						// 8-bit samples were converted to v / 255 and to v << 8
+						const float value = std::min(std::max(line[x * channels] * 65280.0f, 0.0f), 65535.0f);
+						assert(std::fabs(value - lineExpected[x]) <= 2.0f);
+					}
+				}
+			}
+		}
+	}
+}
+
+void testRescaleWordKernels()
+{
+	const unsigned width = 331, height = 207;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo32Bits(zone.get()), &::FreeImage_Unload);
+	assert(color != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> sources[] = {
+		{ FreeImage_ConvertToUINT16(zone.get()), &::FreeImage_Unload },
+		{ FreeImage_ConvertToRGB16(color.get()), &::FreeImage_Unload },
+		{ FreeImage_ConvertToRGBA16(color.get()), &::FreeImage_Unload }
+	};
+
+	const std::pair<unsigned, unsigned> sizes[] = { { 97, 61 }, { 160, 307 }, { 700, 100 } };
+	for (const auto &src : sources) {
+		assert(src != nullptr);
+		const unsigned channels = FreeImage_GetBPP(src.get()) / 16;
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> floats((channels == 1) ? FreeImage_ConvertToFloat(src.get()) : FreeImage_ConvertToRGBAF(src.get()), &::FreeImage_Unload);
+		assert(floats != nullptr);
+		for (const auto &size : sizes) {
+			for (const auto filter : { FILTER_BILINEAR, FILTER_BSPLINE, FILTER_CATMULLROM, FILTER_LANCZOS3 }) {
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> results[2] = { { nullptr, &::FreeImage_Unload }, { nullptr, &::FreeImage_Unload } };
+				runScalarAndSIMD([&](bool vector) {
+					results[vector].reset(FreeImage_Rescale(src.get(), size.first, size.second, filter));
+					assert(results[vector] != nullptr);
+				});
+				assert(FreeImage_GetImageType(results[1].get()) == FreeImage_GetImageType(src.get()));
+				assert(isSameBitmap(results[0].get(), results[1].get()));
+				// SSE2 alone as well as all the features (AVX2 kernels when supported)
+				FreeImage_SetCPUFeatures(FI_CPU_SSE2);
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> sse2(FreeImage_Rescale(src.get(), size.first, size.second, filter), &::FreeImage_Unload);
+				FreeImage_SetCPUFeatures(FI_CPU_ALL);
+				assert(sse2 != nullptr);
+				assert(isSameBitmap(results[0].get(), sse2.get()));
+
+				// the filtering of the float image, up to the rounding of the 16-bit samples between the passes,
+				// with filters that do not overshoot
+				if ((filter != FILTER_BILINEAR) && (filter != FILTER_BSPLINE)) {
+					continue;
+				}
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_Rescale(floats.get(), size.first, size.second, filter), &::FreeImage_Unload);
+				assert(expected != nullptr);
+				const unsigned floatspp = FreeImage_GetBPP(expected.get()) / 32;
+				for (unsigned y = 0; y < size.second; ++y) {
+					const uint16_t *line = reinterpret_cast<const uint16_t *>(FreeImage_GetScanLine(results[1].get(), y));
+					const float *lineExpected = reinterpret_cast<const float *>(FreeImage_GetScanLine(expected.get(), y));
+					for (unsigned x = 0; x < size.first; ++x) {
+						for (unsigned c = 0; c < channels; ++c) {
+							assert(std::fabs(line[x * channels + c] - lineExpected[x * floatspp + c] * 65535.0f) <= 1.0f);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void testRescaleVerticalTiles()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+
+	// wide images, the vertical pass runs by tiles of columns and accumulates rows
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(3001, 45, 128), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> uint16(FreeImage_ConvertToUINT16(zone.get()), &::FreeImage_Unload);
+	assert(uint16 != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo24Bits(zone.get()), &::FreeImage_Unload);
+	assert(color != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgb16(FreeImage_ConvertToRGB16(color.get()), &::FreeImage_Unload);
+	assert(rgb16 != nullptr);
+
+	auto same_pixels = [](FIBITMAP *a, FIBITMAP *b) {
+		if ((FreeImage_GetBPP(a) != FreeImage_GetBPP(b)) || (FreeImage_GetWidth(a) != FreeImage_GetWidth(b)) || (FreeImage_GetHeight(a) != FreeImage_GetHeight(b))) return false;
+		for (unsigned y = 0; y < FreeImage_GetHeight(a); ++y) {
+			if (memcmp(FreeImage_GetScanLine(a, y), FreeImage_GetScanLine(b, y), FreeImage_GetLine(a)) != 0) return false;
+		}
+		return true;
+	};
+
+	// 16-bit samples are filtered in single precision, the transposition mirrors the windows so that their taps are
+	// added in the reverse order: the results may differ by one
+	auto max_word_difference = [](FIBITMAP *a, FIBITMAP *b) {
+		assert(FreeImage_GetLine(a) == FreeImage_GetLine(b) && FreeImage_GetHeight(a) == FreeImage_GetHeight(b));
+		int difference = 0;
+		for (unsigned y = 0; y < FreeImage_GetHeight(a); ++y) {
+			const uint16_t *pa = reinterpret_cast<const uint16_t *>(FreeImage_GetScanLine(a, y));
+			const uint16_t *pb = reinterpret_cast<const uint16_t *>(FreeImage_GetScanLine(b, y));
+			for (unsigned i = 0; i < FreeImage_GetLine(a) / sizeof(uint16_t); ++i) {
+				difference = std::max(difference, std::abs(pa[i] - pb[i]));
+			}
+		}
+		return difference;
+	};
+
+	// a vertical rescale gives the horizontal rescale of the transposed image, both passes use the same weights
+	for (FIBITMAP *src : { zone.get(), uint16.get(), color.get(), rgb16.get() }) {
+		for (unsigned dst_height : { 17u, 97u }) {
+			for (FREE_IMAGE_FILTER filter : { FILTER_BSPLINE, FILTER_LANCZOS3 }) {
+				for (uint32_t threads : { 1u, 4u }) {
+					FreeImage_SetThreadCount(threads);
+					std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scaled(FreeImage_Rescale(src, 3001, dst_height, filter), &::FreeImage_Unload);
+					std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rotated(FreeImage_Rotate(src, 90), &::FreeImage_Unload);
+					assert(scaled != nullptr && rotated != nullptr);
+					std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> transposed(FreeImage_Rescale(rotated.get(), dst_height, 3001, filter), &::FreeImage_Unload);
+					assert(transposed != nullptr);
+					std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_Rotate(transposed.get(), -90), &::FreeImage_Unload);
+					assert(expected != nullptr);
+					if (FreeImage_GetImageType(src) == FIT_BITMAP) {
+						assert(same_pixels(scaled.get(), expected.get()));
+					} else {
+						assert(max_word_difference(scaled.get(), expected.get()) <= 1);
+					}
+				}
+			}
+		}
+	}
+
+	FreeImage_SetThreadCount(defaultCount);
+}
+
+/// Receives the rows of a streaming resizer in a bitmap, counting them
+struct ResizedRows {
+	FIBITMAP *dib;
+	unsigned count;
+};
+
+static void DLL_CALLCONV
+storeResizedRow(const uint8_t *bits, unsigned row, void *user_data) {
+	ResizedRows *rows = static_cast<ResizedRows *>(user_data);
+	assert(row == rows->count);
+	memcpy(FreeImage_GetScanLine(rows->dib, FreeImage_GetHeight(rows->dib) - 1 - row), bits, FreeImage_GetLine(rows->dib));
+	rows->count++;
+}
+
+void testStreamingResize()
+{
+	const unsigned width = 613, height = 409;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(width, height, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo32Bits(zone.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgb16(FreeImage_ConvertToRGB16(zone.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgbf(FreeImage_ConvertToRGBF(zone.get()), &::FreeImage_Unload);
+	assert(color != nullptr && rgb16 != nullptr && rgbf != nullptr);
+
+	// palettized images can't be filtered row by row
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> palette(FreeImage_Allocate(16, 16, 8), &::FreeImage_Unload);
+	assert(palette != nullptr);
+	FreeImage_GetPalette(palette.get())[0].red = 255;
+	assert(FreeImage_CreateResizer(palette.get(), 8, 8, FILTER_BILINEAR, storeResizedRow) == nullptr);
+
+	const struct { unsigned width, height; } sizes[] = { { 211, 151 }, { 1000, 700 }, { 200, height }, { width, 150 } };
+	for (FIBITMAP *src : { zone.get(), color.get(), rgb16.get(), rgbf.get() }) {
+		const FREE_IMAGE_TYPE type = FreeImage_GetImageType(src);
+		for (const auto& size : sizes) {
+			for (FREE_IMAGE_FILTER filter : { FILTER_BILINEAR, FILTER_BSPLINE }) {
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> streamed(FreeImage_AllocateT(type, size.width, size.height, FreeImage_GetBPP(src)), &::FreeImage_Unload);
+				assert(streamed != nullptr);
+				ResizedRows rows = { streamed.get(), 0 };
+				FIRESIZER *resizer = FreeImage_CreateResizer(src, size.width, size.height, filter, storeResizedRow, &rows);
+				assert(resizer != nullptr);
+
+				// push a few rows at a time from the top, destination rows come out before the end of the image
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> flipped(FreeImage_Clone(src), &::FreeImage_Unload);
+				assert(flipped != nullptr && FreeImage_FlipVertical(flipped.get()));
+				const unsigned chunk = 7;
+				for (unsigned y = 0; y < height; y += chunk) {
+					const unsigned count = std::min(chunk, height - y);
+					const unsigned before = rows.count;
+					const unsigned emitted = FreeImage_ResizerPushRows(resizer, FreeImage_GetScanLine(flipped.get(), y), count, FreeImage_GetPitch(src));
+					assert(emitted == rows.count - before);
+					if (y + count >= height / 2 + 8) {
+						assert(rows.count >= size.height / 2 - 8);
+					}
+				}
+				assert(rows.count == size.height);
+				assert(FreeImage_ResizerPushRows(resizer, FreeImage_GetScanLine(src, 0), 1, 0) == 0);
+				FreeImage_DeleteResizer(resizer);
+
+				// the rows are filtered in float, the resize engine rounds its intermediate 8 or 16-bit image
+				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> expected(FreeImage_Rescale(src, size.width, size.height, filter), &::FreeImage_Unload);
+				assert(expected != nullptr && FreeImage_GetBPP(expected.get()) == FreeImage_GetBPP(src));
+				for (unsigned y = 0; y < size.height; ++y) {
+					const uint8_t *a = FreeImage_GetScanLine(streamed.get(), y);
+					const uint8_t *b = FreeImage_GetScanLine(expected.get(), y);
+					for (unsigned x = 0; x < size.width * (FreeImage_GetBPP(src) / 8); ++x) {
+						if (type == FIT_BITMAP) {
+							assert(std::abs(a[x] - b[x]) <= 2);
+						} else if (type == FIT_RGB16) {
+							assert(std::abs(((const uint16_t *)a)[x / 2] - ((const uint16_t *)b)[x / 2]) <= 2);
+						} else {
+							assert(std::abs(((const float *)a)[x / 4] - ((const float *)b)[x / 4]) <= 1e-4F);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void testRescaleLinearLight()
+{
+	const uint32_t defaultCount = FreeImage_GetThreadCount();
+
+	// a black and white checkerboard is a mid grey in linear light, 188 in sRGB (128 if filtered as is)
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey(FreeImage_Allocate(64, 48, 8), &::FreeImage_Unload);
+	assert(grey != nullptr);
+	for (unsigned y = 0; y < 48; ++y) {
+		uint8_t *bits = FreeImage_GetScanLine(grey.get(), y);
+		for (unsigned x = 0; x < 64; ++x) {
+			bits[x] = ((x + y) & 1) ? 255 : 0;
+		}
+	}
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> color(FreeImage_ConvertTo24Bits(grey.get()), &::FreeImage_Unload);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgba(FreeImage_ConvertTo32Bits(grey.get()), &::FreeImage_Unload);
+	assert(color != nullptr && rgba != nullptr);
+
+	for (FIBITMAP *src : { grey.get(), color.get(), rgba.get() }) {
+		const unsigned bytespp = FreeImage_GetBPP(src) / 8;
+		const struct { unsigned width, height; } sizes[] = { { 32, 24 }, { 64, 24 }, { 32, 48 } };
+		for (const auto& size : sizes) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> linear(FreeImage_RescaleRect(src, size.width, size.height, 0, 0, 64, 48, FILTER_BILINEAR, FI_RESCALE_LINEAR_LIGHT), &::FreeImage_Unload);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> plain(FreeImage_Rescale(src, size.width, size.height, FILTER_BILINEAR), &::FreeImage_Unload);
+			assert(linear != nullptr && plain != nullptr && FreeImage_GetBPP(linear.get()) == FreeImage_GetBPP(src));
+			for (unsigned y = 4; y < size.height - 4; ++y) {
+				const uint8_t *a = FreeImage_GetScanLine(linear.get(), y);
+				const uint8_t *b = FreeImage_GetScanLine(plain.get(), y);
+				for (unsigned x = 4; x < size.width - 4; ++x) {
+					for (unsigned c = 0; c < bytespp; ++c) {
+						if (c == FI_RGBA_ALPHA && bytespp == 4) {
+							assert(a[x * 4 + c] == 255);
+						} else {
+							assert(std::abs(a[x * bytespp + c] - 188) <= 2);
+							assert(std::abs(b[x * bytespp + c] - 128) <= 2);
+						}
+					}
+				}
+			}
+		}
+
+		// flat areas keep their values, from black to white
+		for (unsigned v = 0; v < 256; ++v) {
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> flat(FreeImage_Allocate(8, 8, FreeImage_GetBPP(src)), &::FreeImage_Unload);
+			assert(flat != nullptr);
+			for (unsigned y = 0; y < 8; ++y) {
+				memset(FreeImage_GetScanLine(flat.get(), y), v, FreeImage_GetLine(flat.get()));
+			}
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scaled(FreeImage_RescaleRect(flat.get(), 5, 13, 0, 0, 8, 8, FILTER_CATMULLROM, FI_RESCALE_LINEAR_LIGHT | FI_RESCALE_PREMULTIPLY_ALPHA), &::FreeImage_Unload);
+			assert(scaled != nullptr);
+			for (unsigned y = 0; y < 13; ++y) {
+				const uint8_t *bits = FreeImage_GetScanLine(scaled.get(), y);
+				for (unsigned x = 0; x < 5 * bytespp; ++x) {
+					assert(bits[x] == v);
+				}
+			}
+		}
+	}
+
+	// opaque red next to transparent green, in linear light: no green fringe, no dark edge
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> edge(FreeImage_Allocate(64, 16, 32), &::FreeImage_Unload);
+	assert(edge != nullptr);
+	for (unsigned y = 0; y < 16; ++y) {
+		FIRGBA8 *bits = reinterpret_cast<FIRGBA8 *>(FreeImage_GetScanLine(edge.get(), y));
+		for (unsigned x = 0; x < 64; ++x) {
+			bits[x] = (x < 32) ? FIRGBA8{ 255, 0, 0, 255 } : FIRGBA8{ 0, 255, 0, 0 };
+		}
+	}
+	for (unsigned flags : { (unsigned)FI_RESCALE_PREMULTIPLY_ALPHA, (unsigned)(FI_RESCALE_PREMULTIPLY_ALPHA | FI_RESCALE_LINEAR_LIGHT) }) {
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scaled(FreeImage_RescaleRect(edge.get(), 16, 6, 0, 0, 64, 16, FILTER_BILINEAR, flags), &::FreeImage_Unload);
+		assert(scaled != nullptr);
+		for (unsigned y = 0; y < 6; ++y) {
+			for (unsigned x = 0; x < 16; ++x) {
+				const FIRGBA8 &p = reinterpret_cast<const FIRGBA8 *>(FreeImage_GetScanLine(scaled.get(), y))[x];
+				assert(p.green == 0);
+				assert((p.alpha == 0) || (p.red == 255));
+				assert((x > 6) || (p.alpha == 255));
+			}
+		}
+	}
+
+	// bands give the results of a single thread
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone(createZonePlateImage(517, 333, 64), &::FreeImage_Unload);
+	assert(zone != nullptr);
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> zone32(FreeImage_ConvertTo32Bits(zone.get()), &::FreeImage_Unload);
+	assert(zone32 != nullptr);
+	for (const auto& size : { std::make_pair(200u, 111u), std::make_pair(999u, 201u), std::make_pair(300u, 700u) }) {
+		FreeImage_SetThreadCount(1);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> serial(FreeImage_RescaleRect(zone32.get(), size.first, size.second, 0, 0, 517, 333, FILTER_LANCZOS3, FI_RESCALE_LINEAR_LIGHT | FI_RESCALE_PREMULTIPLY_ALPHA), &::FreeImage_Unload);
+		FreeImage_SetThreadCount(4);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> parallel(FreeImage_RescaleRect(zone32.get(), size.first, size.second, 0, 0, 517, 333, FILTER_LANCZOS3, FI_RESCALE_LINEAR_LIGHT | FI_RESCALE_PREMULTIPLY_ALPHA), &::FreeImage_Unload);
+		assert(serial != nullptr && parallel != nullptr);
+		for (unsigned y = 0; y < size.second; ++y) {
+			assert(memcmp(FreeImage_GetScanLine(serial.get(), y), FreeImage_GetScanLine(parallel.get(), y), FreeImage_GetLine(serial.get())) == 0);
+		}
+	}
+
+	FreeImage_SetThreadCount(defaultCount);
+}
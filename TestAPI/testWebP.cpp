@@ -0,0 +1,233 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static FIBITMAP* makeRGB(unsigned width, unsigned height) {
+	FIBITMAP *dib = FreeImage_Allocate(width, height, 24);
+	assert(dib != NULL);
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < width; x++) {
+			bits[FI_RGBA_RED] = (uint8_t)(x * 255 / width);
+			bits[FI_RGBA_GREEN] = (uint8_t)(y * 255 / height);
+			bits[FI_RGBA_BLUE] = (uint8_t)((x ^ y) & 0xFF);
+			bits += 3;
+		}
+	}
+	return dib;
+}
+
+static FIBITMAP* reloadWebP(FIBITMAP *dib, int save_flags, long *size) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_WEBP, dib, hmem, save_flags);
+	assert(bResult);
+	*size = FreeImage_TellMemory(hmem);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_WEBP, hmem, 0);
+	assert(loaded != NULL);
+	FreeImage_CloseMemory(hmem);
+	assert(FreeImage_GetWidth(loaded) == FreeImage_GetWidth(dib) && FreeImage_GetHeight(loaded) == FreeImage_GetHeight(dib));
+	return loaded;
+}
+
+static unsigned DLL_CALLCONV
+fileReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return (unsigned)fread(buffer, size, count, (FILE *)handle);
+}
+
+static int DLL_CALLCONV
+fileSeekProc(fi_handle handle, long offset, int origin) {
+	return fseek((FILE *)handle, offset, origin);
+}
+
+static long DLL_CALLCONV
+fileTellProc(fi_handle handle) {
+	return ftell((FILE *)handle);
+}
+
+struct RowReport {
+	unsigned next_row;
+	unsigned calls;
+};
+
+static void DLL_CALLCONV
+RowsDecoded(FIBITMAP *dib, unsigned first_row, unsigned count, void *user_data) {
+	RowReport *report = (RowReport*)user_data;
+	assert(first_row == report->next_row);
+	assert(count > 0 && first_row + count <= FreeImage_GetHeight(dib));
+	report->next_row = first_row + count;
+	report->calls++;
+}
+
+// Main test function
+// ----------------------------------------------------------
+
+void testWebPOptions() {
+	printf("testWebPOptions ...\n");
+
+	FIBITMAP *dib = makeRGB(640, 480);
+	long size = 0;
+
+	// lossless output is the same whatever the speed and threading options
+	const int lossless[] = { WEBP_LOSSLESS, WEBP_LOSSLESS | WEBP_MULTITHREAD, WEBP_LOSSLESS | WEBP_FAST, WEBP_LOSSLESS | WEBP_METHOD(3) };
+	for (int save_flags : lossless) {
+		FIBITMAP *loaded = reloadWebP(dib, save_flags, &size);
+		for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+			assert(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(loaded, y), FreeImage_GetLine(dib)) == 0);
+		}
+		FreeImage_Unload(loaded);
+	}
+
+	// lossy encoding with methods, partitions and threads
+	const int lossy[] = { WEBP_DEFAULT, WEBP_METHOD(0), WEBP_METHOD(6) | WEBP_MULTITHREAD, WEBP_PARTITIONS(3) | WEBP_MULTITHREAD, WEBP_FAST | 50 };
+	for (int save_flags : lossy) {
+		FIBITMAP *loaded = reloadWebP(dib, save_flags, &size);
+		assert(size > 0);
+		FreeImage_Unload(loaded);
+	}
+
+	FreeImage_Unload(dib);
+}
+
+void testWebPStreaming() {
+	printf("testWebPStreaming ...\n");
+
+	// noisy blue channel, so that the file is read by several chunks
+	FIBITMAP *dib = makeRGB(1500, 1000);
+	uint32_t seed = 1;
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < FreeImage_GetWidth(dib); x++) {
+			seed = seed * 1664525 + 1013904223;
+			bits[FI_RGBA_BLUE] = (uint8_t)(seed >> 24);
+			bits += 3;
+		}
+	}
+
+	const char *path = "stream.webp";
+	FIBOOL bResult = FreeImage_Save(FIF_WEBP, dib, path, WEBP_LOSSLESS | WEBP_FAST);
+	assert(bResult);
+
+	FreeImageIO io = { fileReadProc, NULL, fileSeekProc, fileTellProc };
+	FILE *file = fopen(path, "rb");
+	assert(file != NULL);
+
+	// rows are reported in order while the file is read
+	RowReport report = { 0, 0 };
+	FIBITMAP *loaded = FreeImage_LoadWithRowCallback(FIF_WEBP, &io, (fi_handle)file, 0, RowsDecoded, &report);
+	fclose(file);
+	assert(loaded != NULL);
+	assert(report.next_row == FreeImage_GetHeight(loaded));
+	assert(report.calls > 1);
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		assert(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(loaded, y), FreeImage_GetLine(dib)) == 0);
+	}
+	FreeImage_Unload(loaded);
+
+	// a truncated stream fails
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	bResult = FreeImage_SaveToMemory(FIF_WEBP, dib, hmem, WEBP_LOSSLESS | WEBP_FAST);
+	assert(bResult);
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+	FreeImage_AcquireMemory(hmem, &data, &size);
+	FIMEMORY *truncated = FreeImage_OpenMemory(data, size / 2);
+	loaded = FreeImage_LoadFromMemory(FIF_WEBP, truncated, 0);
+	assert(loaded == NULL);
+	FreeImage_CloseMemory(truncated);
+	FreeImage_CloseMemory(hmem);
+
+	FreeImage_Unload(dib);
+	remove(path);
+}
+
+void testWebPAnimation() {
+	printf("testWebPAnimation ...\n");
+
+	const char *tiff_path = "anim.tif";
+	const unsigned frame_count = 5;
+
+	// frames of a multipage TIFF
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(FIF_TIFF, tiff_path, TRUE, FALSE, TRUE);
+	assert(src != NULL);
+	FIBITMAP *frames[frame_count];
+	for (unsigned i = 0; i < frame_count; i++) {
+		frames[i] = makeRGB(160, 120);
+		// move a bar across the frames
+		for (unsigned y = 0; y < 120; y++) {
+			uint8_t *bits = FreeImage_GetScanLine(frames[i], y) + 3 * (i * 30);
+			memset(bits, 0xFF, 3 * 10);
+		}
+		FreeImage_AppendPage(src, frames[i]);
+	}
+	FIBOOL bResult = FreeImage_CloseMultiBitmap(src, TIFF_DEFAULT);
+	assert(bResult);
+
+	// pages are encoded as the frames of an animation
+	src = FreeImage_OpenMultiBitmap(FIF_TIFF, tiff_path, FALSE, TRUE, TRUE);
+	assert(src != NULL);
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	bResult = FreeImage_SaveMultiBitmapToMemory(FIF_WEBP, src, hmem, WEBP_LOSSLESS | WEBP_FAST);
+	assert(bResult);
+	FreeImage_CloseMultiBitmap(src);
+
+	// a plain load gets the first frame
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *first = FreeImage_LoadFromMemory(FIF_WEBP, hmem, 0);
+	assert(first != NULL && FreeImage_GetWidth(first) == 160 && FreeImage_GetHeight(first) == 120);
+	FreeImage_Unload(first);
+
+	// frames are decoded on demand, in any order
+	FIMULTIBITMAP *anim = FreeImage_LoadMultiBitmapFromMemory(FIF_WEBP, hmem, 0);
+	assert(anim != NULL);
+	assert(FreeImage_GetPageCount(anim) == (int)frame_count);
+	const unsigned order[] = { 0, 3, 1, 4, 2 };
+	for (unsigned i : order) {
+		FIBITMAP *page = FreeImage_LockPage(anim, i);
+		assert(page != NULL && FreeImage_GetBPP(page) == 32);
+		for (unsigned y = 0; y < 120; y++) {
+			const uint8_t *src_bits = FreeImage_GetScanLine(frames[i], y);
+			const uint8_t *dst_bits = FreeImage_GetScanLine(page, y);
+			for (unsigned x = 0; x < 160; x++) {
+				assert(memcmp(src_bits + 3 * x, dst_bits + 4 * x, 3) == 0);
+			}
+		}
+		// frames without a FrameTime are shown 100 ms
+		FITAG *tag = NULL;
+		FreeImage_GetMetadata(FIMD_ANIMATION, page, "FrameTime", &tag);
+		assert(tag != NULL && *(const uint32_t*)FreeImage_GetTagValue(tag) == 100);
+		FreeImage_UnlockPage(anim, page, FALSE);
+	}
+	FreeImage_CloseMultiBitmap(anim);
+	FreeImage_CloseMemory(hmem);
+
+	for (unsigned i = 0; i < frame_count; i++) {
+		FreeImage_Unload(frames[i]);
+	}
+	remove(tiff_path);
+}
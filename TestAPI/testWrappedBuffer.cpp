@@ -21,6 +21,8 @@
 
 
 #include "TestSuite.h"
+#include "FreeImage.hpp"
+#include <string.h>
 
 // Local test functions
 // ----------------------------------------------------------
@@ -161,3 +163,142 @@ void testCreateView(const char *lpszPathName, int flags) {
 
 	FreeImage_Unload(dib);
 }
+
+void testOrientedView() {
+	const unsigned width = 37, height = 29;
+	FIBITMAP *dib = FreeImage_Allocate(width, height, 24);
+	assert(dib != NULL);
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < FreeImage_GetLine(dib); x++) {
+			bits[x] = (uint8_t)(x * 37 + y * 101 + (x >> 3));
+		}
+	}
+
+	for (unsigned orientation = 0; orientation < 8; orientation++) {
+		FIBITMAP *view = FreeImage_CreateView(dib, 0, 0, width, height, orientation);
+		assert(view != NULL);
+		assert(FreeImage_GetOrientation(view) == orientation);
+		assert(FreeImage_GetWidth(view) == width && FreeImage_GetHeight(view) == height);
+
+		// the layout walks the displayed image, as stored by FreeImage_ApplyOrientation
+		FIBITMAP *upright = FreeImage_ApplyOrientation(view);
+		assert(upright != NULL);
+		assert(FreeImage_GetOrientation(upright) == FIO_NORMAL);
+		unsigned display_width = 0, display_height = 0;
+		uint8_t *origin = NULL;
+		int row_step = 0, pixel_step = 0;
+		assert(FreeImage_GetOrientedLayout(view, &display_width, &display_height, &origin, &row_step, &pixel_step));
+		assert(display_width == FreeImage_GetWidth(upright) && display_height == FreeImage_GetHeight(upright));
+		for (unsigned y = 0; y < display_height; y++) {
+			const uint8_t *line = FreeImage_GetScanLine(upright, display_height - 1 - y);
+			for (unsigned x = 0; x < display_width; x++) {
+				assert(memcmp(origin + (int)y * row_step + (int)x * pixel_step, line + 3 * x, 3) == 0);
+			}
+		}
+
+		// a view of a view displays both orientations one after the other
+		for (unsigned second = 0; second < 8; second++) {
+			FIBITMAP *nested = FreeImage_CreateView(view, 0, 0, width, height, second);
+			FIBITMAP *expected = FreeImage_Clone(upright);
+			assert(nested != NULL && expected != NULL);
+			FreeImage_SetOrientation(expected, second);
+			FIBITMAP *lhs = FreeImage_ApplyOrientation(nested);
+			FIBITMAP *rhs = FreeImage_ApplyOrientation(expected);
+			assert(lhs != NULL && rhs != NULL);
+			assert(FreeImage_GetWidth(lhs) == FreeImage_GetWidth(rhs) && FreeImage_GetHeight(lhs) == FreeImage_GetHeight(rhs));
+			for (unsigned y = 0; y < FreeImage_GetHeight(lhs); y++) {
+				assert(memcmp(FreeImage_GetScanLine(lhs, y), FreeImage_GetScanLine(rhs, y), FreeImage_GetLine(lhs)) == 0);
+			}
+			FreeImage_Unload(lhs);
+			FreeImage_Unload(rhs);
+			FreeImage_Unload(expected);
+			FreeImage_Unload(nested);
+		}
+
+		FreeImage_Unload(upright);
+		FreeImage_Unload(view);
+	}
+
+	// Exif orientation 6 (right side, top) is a quarter turn clockwise
+	FIBITMAP *view = FreeImage_CreateView(dib, 0, 0, width, height, FIO_TRANSPOSE | FIO_FLIP_HORIZONTAL);
+	FIBITMAP *upright = FreeImage_ApplyOrientation(view);
+	FIBITMAP *rotated = FreeImage_Rotate(dib, -90);
+	assert(upright != NULL && rotated != NULL);
+	for (unsigned y = 0; y < FreeImage_GetHeight(rotated); y++) {
+		assert(memcmp(FreeImage_GetScanLine(upright, y), FreeImage_GetScanLine(rotated, y), FreeImage_GetLine(rotated)) == 0);
+	}
+	FreeImage_Unload(rotated);
+	FreeImage_Unload(upright);
+	FreeImage_Unload(view);
+
+	// packed pixels are only walked by rows
+	FIBITMAP *mono = FreeImage_Allocate(width, height, 1);
+	FIBITMAP *flipped = FreeImage_CreateView(mono, 0, 0, width, height, FIO_FLIP_VERTICAL);
+	FIBITMAP *mirrored = FreeImage_CreateView(mono, 0, 0, width, height, FIO_FLIP_HORIZONTAL);
+	uint8_t *origin = NULL;
+	int row_step = 0;
+	assert(FreeImage_GetOrientedLayout(flipped, NULL, NULL, &origin, &row_step, NULL));
+	assert(origin == FreeImage_GetScanLine(mono, 0) && row_step == (int)FreeImage_GetPitch(mono));
+	assert(!FreeImage_GetOrientedLayout(mirrored, NULL, NULL, NULL, NULL, NULL));
+	FreeImage_Unload(mirrored);
+	FreeImage_Unload(flipped);
+	FreeImage_Unload(mono);
+
+	FreeImage_Unload(dib);
+}
+
+void testImageView() {
+	printf("testImageView ...\n");
+
+	fi::Bitmap bitmap(37u, 23u, 32u);
+	fi::ImageView<FIRGBA8> view = bitmap.View<FIRGBA8>();
+	assert(view.GetWidth() == 37 && view.GetHeight() == 23);
+	assert(view.GetPitch() == (std::ptrdiff_t)bitmap.GetPitch());
+
+	// fill through the row iterators
+	uint32_t y = 0;
+	for (auto row : view) {
+		for (uint32_t x = 0; x < row.size(); x++) {
+			row[x] = FIRGBA8{ (uint8_t)x, (uint8_t)y, 0, 255 };
+		}
+		y++;
+	}
+	assert(y == 23);
+	for (y = 0; y < 23; y++) {
+		const FIRGBA8 *line = bitmap.GetScanLineAs<FIRGBA8>(y);
+		for (uint32_t x = 0; x < 37; x++) {
+			assert(line[x].red == x && line[x].green == y && line[x].alpha == 255);
+			assert(&view(x, y) == &line[x]);
+		}
+	}
+
+	// subviews share the pixels
+	fi::ImageView<FIRGBA8> sub = view.SubView(5, 3, 10, 4);
+	assert(sub.GetWidth() == 10 && sub.GetHeight() == 4);
+	assert(sub(0, 0).red == 5 && sub(0, 0).green == 3);
+	assert(sub(9, 3).red == 14 && sub(9, 3).green == 6);
+	sub(2, 1).blue = 77;
+	assert(view(7, 4).blue == 77);
+
+	// flipped views walk the rows from the top
+	fi::ImageView<const FIRGBA8> top_down = view.Flipped();
+	assert(top_down(0, 0).green == 22 && top_down(0, 22).green == 0);
+	assert(top_down.end() - top_down.begin() == 23);
+	assert(top_down[1][4].red == 4 && top_down[1][4].green == 21);
+
+	// read-only views of const bitmaps
+	const fi::Bitmap &cref = bitmap;
+	fi::ImageView<const FIRGBA8> cview = cref.View<FIRGBA8>();
+	assert(cview(7, 4).blue == 77);
+
+	// the pixel type must match the bpp
+	bool thrown = false;
+	try {
+		bitmap.View<FIRGB8>();
+	}
+	catch (const fi::ImageError &) {
+		thrown = true;
+	}
+	assert(thrown);
+}
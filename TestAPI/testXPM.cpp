@@ -0,0 +1,121 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// Design and implementation by
+// - Herv Drolon (drolon@infonie.fr)
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+
+#include "TestSuite.h"
+#include <string.h>
+
+// Local test functions
+// ----------------------------------------------------------
+
+static FIBITMAP* reloadXPM(FIBITMAP *dib) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBOOL bResult = FreeImage_SaveToMemory(FIF_XPM, dib, hmem, 0);
+	assert(bResult);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_XPM, hmem, 0);
+	assert(loaded != NULL);
+	FreeImage_CloseMemory(hmem);
+	return loaded;
+}
+
+void testXPM() {
+	printf("testXPM ...\n");
+
+	// 8-bit, 1 or 2 chars per pixel
+	const unsigned colors[] = { 50, 256 };
+	for (unsigned ncolors : colors) {
+		FIBITMAP *dib = FreeImage_Allocate(173, 91, 8);
+		assert(dib != NULL);
+		FIRGBA8 *pal = FreeImage_GetPalette(dib);
+		for (unsigned i = 0; i < 256; i++) {
+			pal[i].red = (uint8_t)i;
+			pal[i].green = (uint8_t)(255 - i);
+			pal[i].blue = (uint8_t)(i * 7);
+		}
+		for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+			uint8_t *bits = FreeImage_GetScanLine(dib, y);
+			for (unsigned x = 0; x < FreeImage_GetWidth(dib); x++) {
+				bits[x] = (uint8_t)((x * 31 + y * 17) % ncolors);
+			}
+		}
+		// the colors are renumbered in order of appearance, compare the colors of the pixels
+		FIBITMAP *loaded = reloadXPM(dib);
+		assert(FreeImage_GetBPP(loaded) == 8);
+		const FIRGBA8 *loaded_pal = FreeImage_GetPalette(loaded);
+		for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+			const uint8_t *src = FreeImage_GetScanLine(dib, y);
+			const uint8_t *dst = FreeImage_GetScanLine(loaded, y);
+			for (unsigned x = 0; x < FreeImage_GetWidth(dib); x++) {
+				assert(memcmp(&pal[src[x]], &loaded_pal[dst[x]], 3) == 0);
+			}
+		}
+		FreeImage_Unload(loaded);
+		FreeImage_Unload(dib);
+	}
+
+	// 24-bit with 3 chars per pixel
+	FIBITMAP *dib = FreeImage_Allocate(211, 97, 24);
+	assert(dib != NULL);
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for (unsigned x = 0; x < FreeImage_GetWidth(dib); x++, bits += 3) {
+			bits[0] = (uint8_t)x;
+			bits[1] = (uint8_t)y;
+			bits[2] = (uint8_t)(x ^ y);
+		}
+	}
+	FIBITMAP *loaded = reloadXPM(dib);
+	assert(FreeImage_GetBPP(loaded) == 24);
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		assert(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(loaded, y), FreeImage_GetLine(dib)) == 0);
+	}
+	FreeImage_Unload(loaded);
+	FreeImage_Unload(dib);
+
+	// named colors, transparent color, tabs and a color redefined
+	const char xpm[] =
+		"/* XPM */\n"
+		"static char *test[] = {\n"
+		"\"4 2 4 2\",\n"
+		"\"aa\tc light Blue\",\n"
+		"\"..  c None\",\n"
+		"\"ab c #102030\",\n"
+		"\"aa c #ff0000 m white\",\n"
+		"\"aa..abaa\",\n"
+		"\"abababzz\"\n"
+		"};\n";
+	FIMEMORY *hmem = FreeImage_OpenMemory((uint8_t *)xpm, (uint32_t)strlen(xpm));
+	loaded = FreeImage_LoadFromMemory(FIF_XPM, hmem, 0);
+	assert(loaded != NULL);
+	const FIRGBA8 *pal = FreeImage_GetPalette(loaded);
+	const uint8_t *top = FreeImage_GetScanLine(loaded, 1);
+	const uint8_t *bottom = FreeImage_GetScanLine(loaded, 0);
+	assert(top[0] == 3 && top[1] == 1 && top[2] == 2 && top[3] == 3);
+	assert(pal[3].red == 0xFF && pal[3].green == 0 && pal[3].blue == 0);
+	assert(pal[0].red == 173 && pal[0].green == 216 && pal[0].blue == 230);
+	assert(pal[1].red == 0xFF && pal[1].green == 0xFF && pal[1].blue == 0xFF);
+	// unknown codes give index 0
+	assert(bottom[0] == 2 && bottom[3] == 0);
+	FreeImage_Unload(loaded);
+	FreeImage_CloseMemory(hmem);
+}
@@ -0,0 +1,101 @@
+// ==========================================================
+// FreeImageRe benchmarks
+//
+// ==========================================================
+
+#ifndef FREEIMAGE_BENCH_SUITE_H
+#define FREEIMAGE_BENCH_SUITE_H
+
+#include "FreeImage.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Bitmaps
+// ==========================================================
+
+using BitmapPtr = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
+
+/**
+ * Deterministic 24-bit test image: a colour zone plate with seeded noise, the same pixels on every run and machine.
+ */
+BitmapPtr CreateBenchImage(unsigned width, unsigned height);
+
+/**
+ * Wraps dib, which may be NULL.
+ */
+inline BitmapPtr MakeBitmap(FIBITMAP *dib) {
+	return BitmapPtr(dib, &::FreeImage_Unload);
+}
+
+
+// Runner
+// ==========================================================
+
+struct BenchResult {
+	std::string group;          //! e.g. "rescale"
+	std::string name;           //! e.g. "bilinear 1920x1080->960x540"
+	double megapixels = 0;      //! pixels processed by one iteration, in millions
+	unsigned iterations = 0;
+	double median_ms = 0;       //! median time of one iteration
+	double min_ms = 0;
+	double mp_per_s = 0;        //! megapixels / median time
+	uint64_t peak_rss_kb = 0;   //! peak resident set size of the process after the benchmark
+	bool failed = false;
+};
+
+struct BenchOptions {
+	double min_time = 0.5;      //! seconds spent measuring each benchmark, after one warm-up iteration
+	unsigned min_iterations = 5;
+	unsigned max_iterations = 1000;
+	unsigned width = 1920;      //! size of the source images
+	unsigned height = 1080;
+	std::string filter;         //! only benchmarks whose "group/name" contains the filter are run
+};
+
+class BenchRunner {
+public:
+	explicit BenchRunner(const BenchOptions &options)
+		: m_options(options) {
+	}
+
+	const BenchOptions& Options() const {
+		return m_options;
+	}
+
+	/**
+	 * Times body, which processes megapixels per call and returns false on failure.
+	 * Nothing is done when the benchmark is filtered out.
+	 */
+	void Run(const std::string &group, const std::string &name, double megapixels, const std::function<bool()> &body);
+
+	const std::vector<BenchResult>& Results() const {
+		return m_results;
+	}
+
+private:
+	BenchOptions m_options;
+	std::vector<BenchResult> m_results;
+};
+
+/**
+ * Peak resident set size of the process in KB, 0 if unknown.
+ */
+uint64_t GetPeakRSS();
+
+
+// Benchmark groups
+// ==========================================================
+
+void benchLoadSave(BenchRunner &runner);
+void benchRescale(BenchRunner &runner);
+void benchConversions(BenchRunner &runner);
+void benchToneMapping(BenchRunner &runner);
+void benchQuantizers(BenchRunner &runner);
+void benchRotations(BenchRunner &runner);
+
+#endif // FREEIMAGE_BENCH_SUITE_H
@@ -0,0 +1,253 @@
+// ==========================================================
+// FreeImageRe benchmarks
+//
+// Usage: FreeImageBench [--threads N] [--filter TEXT] [--min-time SECONDS] [--size WxH] [--json FILE]
+//
+// Each benchmark runs one warm-up iteration, then iterates for at least --min-time seconds and reports
+// the median time per iteration, the throughput in megapixels per second and the peak RSS of the process.
+// Source images are synthetic and seeded, results of two runs on one machine are comparable.
+// The JSON report is written to FILE, or to stdout with --json -.
+// ==========================================================
+
+#include "BenchSuite.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// ----------------------------------------------------------
+
+BitmapPtr
+CreateBenchImage(unsigned width, unsigned height) {
+	BitmapPtr dib = MakeBitmap(FreeImage_Allocate(width, height, 24));
+	if (!dib) {
+		return dib;
+	}
+	// zone plate rings on each channel at a different scale, plus xorshift noise so that
+	// encoders and quantizers don't see a trivially compressible image
+	const double cx = width / 2.0;
+	const double cy = height / 2.0;
+	const double k = 3.14159265358979 / std::max(width, height);
+	uint32_t seed = 0x9E3779B9u;
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib.get(), y);
+		for (unsigned x = 0; x < width; x++, bits += 3) {
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			const double r2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+			const int noise = static_cast<int>(seed & 15) - 8;
+			bits[FI_RGBA_RED]   = static_cast<uint8_t>(std::clamp(static_cast<int>(127.5 + 120 * std::sin(k * r2 / 16)) + noise, 0, 255));
+			bits[FI_RGBA_GREEN] = static_cast<uint8_t>(std::clamp(static_cast<int>(127.5 + 120 * std::sin(k * r2 / 24)) + noise, 0, 255));
+			bits[FI_RGBA_BLUE]  = static_cast<uint8_t>(std::clamp(static_cast<int>(255.0 * y / height) + noise, 0, 255));
+		}
+	}
+	return dib;
+}
+
+// ----------------------------------------------------------
+
+uint64_t
+GetPeakRSS() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return static_cast<uint64_t>(counters.PeakWorkingSetSize) / 1024;
+	}
+	return 0;
+#else
+	struct rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss) / 1024;	// bytes
+#else
+	return static_cast<uint64_t>(usage.ru_maxrss);			// KB
+#endif
+#endif
+}
+
+// ----------------------------------------------------------
+
+void
+BenchRunner::Run(const std::string &group, const std::string &name, double megapixels, const std::function<bool()> &body) {
+	const std::string full_name = group + "/" + name;
+	if (!m_options.filter.empty() && full_name.find(m_options.filter) == std::string::npos) {
+		return;
+	}
+
+	BenchResult result;
+	result.group = group;
+	result.name = name;
+	result.megapixels = megapixels;
+
+	using Clock = std::chrono::steady_clock;
+
+	// warm-up: first touch of the pages, lazy tables, thread pool start
+	result.failed = !body();
+
+	std::vector<double> times;
+	const Clock::time_point start = Clock::now();
+	while (!result.failed && times.size() < m_options.max_iterations) {
+		const Clock::time_point t0 = Clock::now();
+		result.failed = !body();
+		const Clock::time_point t1 = Clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+
+		const double elapsed = std::chrono::duration<double>(t1 - start).count();
+		if (times.size() >= m_options.min_iterations && elapsed >= m_options.min_time) {
+			break;
+		}
+	}
+
+	if (!result.failed && !times.empty()) {
+		std::sort(times.begin(), times.end());
+		const size_t n = times.size();
+		result.iterations = static_cast<unsigned>(n);
+		result.min_ms = times.front();
+		result.median_ms = (n % 2) ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+		result.mp_per_s = (result.median_ms > 0) ? megapixels * 1000.0 / result.median_ms : 0;
+	}
+	result.peak_rss_kb = GetPeakRSS();
+
+	if (result.failed) {
+		fprintf(stderr, "%-14s %-40s FAILED\n", group.c_str(), name.c_str());
+	} else {
+		fprintf(stderr, "%-14s %-40s %10.3f ms %10.1f MP/s %8llu KB\n", group.c_str(), name.c_str(),
+			result.median_ms, result.mp_per_s, static_cast<unsigned long long>(result.peak_rss_kb));
+	}
+	m_results.push_back(result);
+}
+
+// ----------------------------------------------------------
+
+static std::string
+JsonEscape(const std::string &s) {
+	std::string out;
+	out.reserve(s.size());
+	for (const char c : s) {
+		switch (c) {
+			case '"':  out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", c);
+					out += buf;
+				} else {
+					out += c;
+				}
+				break;
+		}
+	}
+	return out;
+}
+
+static void
+WriteJson(FILE *file, const BenchRunner &runner) {
+	const BenchOptions &options = runner.Options();
+	fprintf(file, "{\n");
+	fprintf(file, "  \"library\": \"%s\",\n", JsonEscape(FreeImage_GetVersion()).c_str());
+	fprintf(file, "  \"threads\": %u,\n", FreeImage_GetThreadCount());
+	fprintf(file, "  \"image_width\": %u,\n", options.width);
+	fprintf(file, "  \"image_height\": %u,\n", options.height);
+	fprintf(file, "  \"min_time_s\": %g,\n", options.min_time);
+	fprintf(file, "  \"peak_rss_kb\": %llu,\n", static_cast<unsigned long long>(GetPeakRSS()));
+	fprintf(file, "  \"results\": [");
+	const std::vector<BenchResult> &results = runner.Results();
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult &r = results[i];
+		fprintf(file, "%s\n    {\"group\": \"%s\", \"name\": \"%s\", \"failed\": %s, \"iterations\": %u, "
+			"\"megapixels\": %.6f, \"median_ms\": %.6f, \"min_ms\": %.6f, \"mp_per_s\": %.3f, \"peak_rss_kb\": %llu}",
+			i ? "," : "", JsonEscape(r.group).c_str(), JsonEscape(r.name).c_str(), r.failed ? "true" : "false", r.iterations,
+			r.megapixels, r.median_ms, r.min_ms, r.mp_per_s, static_cast<unsigned long long>(r.peak_rss_kb));
+	}
+	fprintf(file, "\n  ]\n}\n");
+}
+
+// ----------------------------------------------------------
+
+static void
+PrintUsage() {
+	fprintf(stderr, "Usage: FreeImageBench [--threads N] [--filter TEXT] [--min-time SECONDS] [--size WxH] [--json FILE|-]\n");
+}
+
+int
+main(int argc, char *argv[]) {
+	BenchOptions options;
+	unsigned threads = 0;
+	const char *json_path = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = (i + 1 < argc);
+		if (!strcmp(argv[i], "--threads") && has_value) {
+			threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+		} else if (!strcmp(argv[i], "--filter") && has_value) {
+			options.filter = argv[++i];
+		} else if (!strcmp(argv[i], "--min-time") && has_value) {
+			options.min_time = strtod(argv[++i], nullptr);
+		} else if (!strcmp(argv[i], "--size") && has_value) {
+			unsigned w = 0, h = 0;
+			if (sscanf(argv[++i], "%ux%u", &w, &h) != 2 || !w || !h) {
+				PrintUsage();
+				return 1;
+			}
+			options.width = w;
+			options.height = h;
+		} else if (!strcmp(argv[i], "--json") && has_value) {
+			json_path = argv[++i];
+		} else {
+			PrintUsage();
+			return 1;
+		}
+	}
+
+#if defined(FREEIMAGE_LIB) || !defined(WIN32)
+	FreeImage_Initialise();
+#endif
+	// 0 selects the number of hardware threads
+	FreeImage_SetThreadCount(threads);
+
+	fprintf(stderr, "FreeImage %s, %u threads, %ux%u images\n", FreeImage_GetVersion(), FreeImage_GetThreadCount(), options.width, options.height);
+
+	BenchRunner runner(options);
+	benchLoadSave(runner);
+	benchRescale(runner);
+	benchConversions(runner);
+	benchToneMapping(runner);
+	benchQuantizers(runner);
+	benchRotations(runner);
+
+	int status = 0;
+	if (json_path) {
+		FILE *file = strcmp(json_path, "-") ? fopen(json_path, "w") : stdout;
+		if (file) {
+			WriteJson(file, runner);
+			if (file != stdout) {
+				fclose(file);
+			}
+		} else {
+			fprintf(stderr, "Failed to open %s\n", json_path);
+			status = 1;
+		}
+	}
+
+#if defined(FREEIMAGE_LIB) || !defined(WIN32)
+	FreeImage_DeInitialise();
+#endif
+
+	return status;
+}
@@ -0,0 +1,93 @@
+// ==========================================================
+// FreeImageRe benchmarks
+//
+// Load and save of every plugin able to read and write, through memory streams
+// so that disk speed doesn't enter the results.
+// ==========================================================
+
+#include "BenchSuite.h"
+
+#include <string>
+
+namespace {
+
+	using MemoryPtr = std::unique_ptr<FIMEMORY, decltype(&::FreeImage_CloseMemory)>;
+
+	struct SaveSource {
+		BitmapPtr dib{ nullptr, &::FreeImage_Unload };
+		std::string description;
+	};
+
+	/**
+	 * Converts the 24-bit source to the first layout fif can save: 24, 32 or 8-bit, then RGBF or float images.
+	 */
+	SaveSource MakeSaveSource(FREE_IMAGE_FORMAT fif, FIBITMAP *rgb) {
+		SaveSource source;
+		if (FreeImage_FIFSupportsExportType(fif, FIT_BITMAP)) {
+			if (FreeImage_FIFSupportsExportBPP(fif, 24)) {
+				source.dib = MakeBitmap(FreeImage_Clone(rgb));
+				source.description = "24-bit";
+			} else if (FreeImage_FIFSupportsExportBPP(fif, 32)) {
+				source.dib = MakeBitmap(FreeImage_ConvertTo32Bits(rgb));
+				source.description = "32-bit";
+			} else if (FreeImage_FIFSupportsExportBPP(fif, 8)) {
+				source.dib = MakeBitmap(FreeImage_ConvertToGreyscale(rgb));
+				source.description = "8-bit";
+			}
+		} else if (FreeImage_FIFSupportsExportType(fif, FIT_RGBF)) {
+			source.dib = MakeBitmap(FreeImage_ConvertToRGBF(rgb));
+			source.description = "RGBF";
+		} else if (FreeImage_FIFSupportsExportType(fif, FIT_FLOAT)) {
+			source.dib = MakeBitmap(FreeImage_ConvertToType(rgb, FIT_FLOAT));
+			source.description = "float";
+		}
+		return source;
+	}
+
+} // namespace
+
+void
+benchLoadSave(BenchRunner &runner) {
+	const BenchOptions &options = runner.Options();
+	BitmapPtr rgb = CreateBenchImage(options.width, options.height);
+	if (!rgb) {
+		return;
+	}
+	const double megapixels = options.width * static_cast<double>(options.height) / 1e6;
+
+	for (int index = 0; index < FreeImage_GetFIFCount2(); index++) {
+		const FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromIndex(index);
+		if (!FreeImage_FIFSupportsReading(fif) || !FreeImage_FIFSupportsWriting(fif)) {
+			continue;
+		}
+		const SaveSource source = MakeSaveSource(fif, rgb.get());
+		if (!source.dib) {
+			continue;
+		}
+		const std::string name = std::string(FreeImage_GetFormatFromFIF(fif)) + " " + source.description;
+
+		// encoded once for the load benchmark, the stream keeps the bytes
+		MemoryPtr encoded(FreeImage_OpenMemory(), &::FreeImage_CloseMemory);
+		if (!encoded || !FreeImage_SaveToMemory(fif, source.dib.get(), encoded.get(), 0)) {
+			runner.Run("save", name, megapixels, []() { return false; });
+			continue;
+		}
+		uint8_t *data = nullptr;
+		uint32_t size = 0;
+		FreeImage_AcquireMemory(encoded.get(), &data, &size);
+
+		runner.Run("save", name, megapixels, [&]() {
+			MemoryPtr stream(FreeImage_OpenMemory(), &::FreeImage_CloseMemory);
+			return stream && FreeImage_SaveToMemory(fif, source.dib.get(), stream.get(), 0);
+		});
+
+		runner.Run("load", name, megapixels, [&]() {
+			MemoryPtr stream(FreeImage_OpenMemory(data, size), &::FreeImage_CloseMemory);
+			if (!stream) {
+				return false;
+			}
+			BitmapPtr loaded = MakeBitmap(FreeImage_LoadFromMemory(fif, stream.get(), 0));
+			return loaded != nullptr;
+		});
+	}
+}
@@ -0,0 +1,190 @@
+// ==========================================================
+// FreeImageRe benchmarks
+//
+// Toolkit: rescale, conversions, tone mapping, quantizers and rotations.
+// ==========================================================
+
+#include "BenchSuite.h"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+
+	std::string SizeName(unsigned width, unsigned height) {
+		return std::to_string(width) + "x" + std::to_string(height);
+	}
+
+	double Megapixels(FIBITMAP *dib) {
+		return FreeImage_GetWidth(dib) * static_cast<double>(FreeImage_GetHeight(dib)) / 1e6;
+	}
+
+	/**
+	 * Runs a benchmark of an operation returning a new bitmap, which is released at once.
+	 */
+	template <typename Op_>
+	void RunAllocating(BenchRunner &runner, const std::string &group, const std::string &name, double megapixels, Op_ op) {
+		runner.Run(group, name, megapixels, [&]() {
+			BitmapPtr result = MakeBitmap(op());
+			return result != nullptr;
+		});
+	}
+
+} // namespace
+
+// ----------------------------------------------------------
+
+void
+benchRescale(BenchRunner &runner) {
+	const BenchOptions &options = runner.Options();
+	BitmapPtr rgb = CreateBenchImage(options.width, options.height);
+	if (!rgb) {
+		return;
+	}
+	BitmapPtr rgbf = MakeBitmap(FreeImage_ConvertToRGBF(rgb.get()));
+
+	static const struct {
+		FREE_IMAGE_FILTER filter;
+		const char *name;
+	} filters[] = {
+		{ FILTER_BOX, "box" },
+		{ FILTER_BILINEAR, "bilinear" },
+		{ FILTER_BICUBIC, "bicubic" },
+		{ FILTER_BSPLINE, "bspline" },
+		{ FILTER_CATMULLROM, "catmullrom" },
+		{ FILTER_LANCZOS3, "lanczos3" }
+	};
+	// throughput is counted on the larger of the source and destination sizes
+	const unsigned sizes[][2] = {
+		{ options.width / 2, options.height / 2 },
+		{ options.width / 8, options.height / 8 },
+		{ options.width * 2, options.height * 2 }
+	};
+
+	for (FIBITMAP *src : { rgb.get(), rgbf.get() }) {
+		if (!src) {
+			continue;
+		}
+		const std::string type_name = (FreeImage_GetImageType(src) == FIT_RGBF) ? "RGBF" : "24-bit";
+		for (const auto &f : filters) {
+			for (const auto &size : sizes) {
+				if (!size[0] || !size[1]) {
+					continue;
+				}
+				const double megapixels = std::max(Megapixels(src), size[0] * static_cast<double>(size[1]) / 1e6);
+				const std::string name = type_name + " " + f.name + " " + SizeName(options.width, options.height) + "->" + SizeName(size[0], size[1]);
+				RunAllocating(runner, "rescale", name, megapixels, [&]() {
+					return FreeImage_Rescale(src, static_cast<int>(size[0]), static_cast<int>(size[1]), f.filter);
+				});
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------
+
+void
+benchConversions(BenchRunner &runner) {
+	const BenchOptions &options = runner.Options();
+	BitmapPtr rgb = CreateBenchImage(options.width, options.height);
+	if (!rgb) {
+		return;
+	}
+	BitmapPtr rgba = MakeBitmap(FreeImage_ConvertTo32Bits(rgb.get()));
+	BitmapPtr grey = MakeBitmap(FreeImage_ConvertToGreyscale(rgb.get()));
+	BitmapPtr rgbf = MakeBitmap(FreeImage_ConvertToRGBF(rgb.get()));
+	BitmapPtr rgb16 = MakeBitmap(FreeImage_ConvertToType(rgb.get(), FIT_RGB16));
+	if (!rgba || !grey || !rgbf || !rgb16) {
+		return;
+	}
+	const double megapixels = Megapixels(rgb.get());
+	FIBITMAP *src24 = rgb.get();
+
+	RunAllocating(runner, "convert", "24-bit->32-bit", megapixels, [&]() { return FreeImage_ConvertTo32Bits(src24); });
+	RunAllocating(runner, "convert", "32-bit->24-bit", megapixels, [&]() { return FreeImage_ConvertTo24Bits(rgba.get()); });
+	RunAllocating(runner, "convert", "24-bit->greyscale", megapixels, [&]() { return FreeImage_ConvertToGreyscale(src24); });
+	RunAllocating(runner, "convert", "8-bit->24-bit", megapixels, [&]() { return FreeImage_ConvertTo24Bits(grey.get()); });
+	RunAllocating(runner, "convert", "24-bit->16-bit 565", megapixels, [&]() { return FreeImage_ConvertTo16Bits565(src24); });
+	RunAllocating(runner, "convert", "24-bit->RGBF", megapixels, [&]() { return FreeImage_ConvertToRGBF(src24); });
+	RunAllocating(runner, "convert", "24-bit->float", megapixels, [&]() { return FreeImage_ConvertToFloat(src24); });
+	RunAllocating(runner, "convert", "24-bit->RGB16", megapixels, [&]() { return FreeImage_ConvertToType(src24, FIT_RGB16); });
+	RunAllocating(runner, "convert", "RGB16->24-bit", megapixels, [&]() { return FreeImage_ConvertToStandardType(rgb16.get()); });
+	RunAllocating(runner, "convert", "RGBF->24-bit", megapixels, [&]() { return FreeImage_ConvertToStandardType(rgbf.get()); });
+}
+
+// ----------------------------------------------------------
+
+void
+benchToneMapping(BenchRunner &runner) {
+	const BenchOptions &options = runner.Options();
+	BitmapPtr rgb = CreateBenchImage(options.width, options.height);
+	if (!rgb) {
+		return;
+	}
+	BitmapPtr rgbf = MakeBitmap(FreeImage_ConvertToRGBF(rgb.get()));
+	if (!rgbf) {
+		return;
+	}
+	const double megapixels = Megapixels(rgbf.get());
+	FIBITMAP *src = rgbf.get();
+
+	RunAllocating(runner, "tonemap", "drago03", megapixels, [&]() { return FreeImage_TmoDrago03(src); });
+	RunAllocating(runner, "tonemap", "reinhard05", megapixels, [&]() { return FreeImage_TmoReinhard05(src); });
+	RunAllocating(runner, "tonemap", "reinhard05ex", megapixels, [&]() { return FreeImage_TmoReinhard05Ex(src, 0, 0, 0.5, 0.5); });
+	RunAllocating(runner, "tonemap", "fattal02", megapixels, [&]() { return FreeImage_TmoFattal02(src); });
+	RunAllocating(runner, "tonemap", "clamp", megapixels, [&]() { return FreeImage_TmoClamp(src); });
+	RunAllocating(runner, "tonemap", "linear", megapixels, [&]() { return FreeImage_TmoLinear(src); });
+}
+
+// ----------------------------------------------------------
+
+void
+benchQuantizers(BenchRunner &runner) {
+	const BenchOptions &options = runner.Options();
+	BitmapPtr rgb = CreateBenchImage(options.width, options.height);
+	if (!rgb) {
+		return;
+	}
+	const double megapixels = Megapixels(rgb.get());
+	FIBITMAP *src = rgb.get();
+
+	RunAllocating(runner, "quantize", "wu 256", megapixels, [&]() { return FreeImage_ColorQuantizeEx(src, FIQ_WUQUANT, 256); });
+	RunAllocating(runner, "quantize", "wu 16", megapixels, [&]() { return FreeImage_ColorQuantizeEx(src, FIQ_WUQUANT, 16); });
+	RunAllocating(runner, "quantize", "nn 256", megapixels, [&]() { return FreeImage_ColorQuantizeEx(src, FIQ_NNQUANT, 256); });
+
+	// LFP is lossless, it only succeeds on images with few colours
+	BitmapPtr few_colors = MakeBitmap(FreeImage_ColorQuantizeEx(src, FIQ_WUQUANT, 200));
+	BitmapPtr few_colors24 = MakeBitmap(few_colors ? FreeImage_ConvertTo24Bits(few_colors.get()) : nullptr);
+	if (few_colors24) {
+		RunAllocating(runner, "quantize", "lfp 256", megapixels, [&]() { return FreeImage_ColorQuantizeEx(few_colors24.get(), FIQ_LFPQUANT, 256); });
+	}
+}
+
+// ----------------------------------------------------------
+
+void
+benchRotations(BenchRunner &runner) {
+	const BenchOptions &options = runner.Options();
+	BitmapPtr rgb = CreateBenchImage(options.width, options.height);
+	if (!rgb) {
+		return;
+	}
+	BitmapPtr grey = MakeBitmap(FreeImage_ConvertToGreyscale(rgb.get()));
+	if (!grey) {
+		return;
+	}
+	const double megapixels = Megapixels(rgb.get());
+
+	for (FIBITMAP *src : { rgb.get(), grey.get() }) {
+		const std::string type_name = std::to_string(FreeImage_GetBPP(src)) + "-bit";
+		RunAllocating(runner, "rotate", type_name + " 90", megapixels, [&]() { return FreeImage_Rotate(src, 90); });
+		RunAllocating(runner, "rotate", type_name + " 180", megapixels, [&]() { return FreeImage_Rotate(src, 180); });
+		RunAllocating(runner, "rotate", type_name + " 30", megapixels, [&]() { return FreeImage_Rotate(src, 30); });
+		RunAllocating(runner, "rotate", type_name + " 30 ex", megapixels, [&]() {
+			return FreeImage_RotateEx(src, 30, 0, 0, FreeImage_GetWidth(src) / 2.0, FreeImage_GetHeight(src) / 2.0, TRUE);
+		});
+		// in place, flipping twice leaves the source as it was
+		runner.Run("rotate", type_name + " flip horizontal", megapixels, [&]() { return FreeImage_FlipHorizontal(src) != FALSE; });
+		runner.Run("rotate", type_name + " flip vertical", megapixels, [&]() { return FreeImage_FlipVertical(src) != FALSE; });
+	}
+}
@@ -0,0 +1,37 @@
+# LibDeflate dependency
+# https://github.com/ebiggers/libdeflate
+#
+# Output target: LibDeflate
+
+include(${CMAKE_SOURCE_DIR}/cmake/external_project_common.cmake)
+
+
+ExternalProject_Add(DEFLATE
+    PREFIX "${CMAKE_BINARY_DIR}/libdeflate"
+    URL "https://github.com/ebiggers/libdeflate/archive/refs/tags/v1.24.zip"
+    DOWNLOAD_DIR "${CMAKE_SOURCE_DIR}/dependencies/libdeflate"
+    DOWNLOAD_EXTRACT_TIMESTAMP TRUE
+    SOURCE_DIR "${EXTERNALPROJECT_SOURCE_PREFIX}/dependencies/libdeflate/source"
+    BINARY_DIR "${CMAKE_BINARY_DIR}/libdeflate/build"
+    INSTALL_DIR "${CMAKE_BINARY_DIR}/libdeflate/install"
+    UPDATE_COMMAND ""
+    BUILD_COMMAND ${BUILD_COMMAND_FOR_TARGET} -t libdeflate_static
+    INSTALL_COMMAND ${BUILD_COMMAND_FOR_TARGET} -t install
+    CMAKE_ARGS ${CMAKE_BUILD_TYPE_RELEASE} "-DCMAKE_INSTALL_PREFIX:PATH=${CMAKE_BINARY_DIR}/libdeflate/install"
+        "-DLIBDEFLATE_BUILD_STATIC_LIB=ON" "-DLIBDEFLATE_BUILD_SHARED_LIB=OFF" "-DLIBDEFLATE_BUILD_GZIP=OFF" "-DLIBDEFLATE_BUILD_TESTS=OFF"
+        "-DCMAKE_C_FLAGS:STRING=${ZERO_WARNINGS_FLAG} -fPIC"
+)
+
+ExternalProject_Get_Property(DEFLATE INSTALL_DIR)
+
+add_library(LibDeflate INTERFACE)
+add_dependencies(LibDeflate DEFLATE)
+target_include_directories(LibDeflate INTERFACE ${INSTALL_DIR}/include)
+if(MSVC)
+    link_library_path2(LibDeflate ${INSTALL_DIR}/lib deflatestatic${CMAKE_STATIC_LIBRARY_SUFFIX} deflatestatic${CMAKE_STATIC_LIBRARY_SUFFIX})
+else()
+    target_link_libraries(LibDeflate INTERFACE "${INSTALL_DIR}/lib/libdeflate${CMAKE_STATIC_LIBRARY_SUFFIX}")
+endif()
+set_property(TARGET DEFLATE PROPERTY FOLDER "Dependencies")
+
+unset(INSTALL_DIR)
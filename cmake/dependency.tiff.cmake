@@ -6,6 +6,22 @@
 
 include(${CMAKE_SOURCE_DIR}/cmake/external_project_common.cmake)
 
+# TIFF_DEFLATE and TIFF_ADOBE_DEFLATE strips are coded with libdeflate when FreeImage uses it
+if (FREEIMAGE_WITH_LIBDEFLATE)
+    ExternalProject_Get_Property(DEFLATE INSTALL_DIR)
+    if(MSVC)
+        set(TIFF_DEFLATE_LIBRARY "${INSTALL_DIR}/lib/deflatestatic${CMAKE_STATIC_LIBRARY_SUFFIX}")
+    else()
+        set(TIFF_DEFLATE_LIBRARY "${INSTALL_DIR}/lib/libdeflate${CMAKE_STATIC_LIBRARY_SUFFIX}")
+    endif()
+    set(TIFF_DEFLATE_ARGS "-Dlibdeflate=ON" "-DDeflate_INCLUDE_DIR:PATH=${INSTALL_DIR}/include" "-DDeflate_LIBRARY_RELEASE:FILEPATH=${TIFF_DEFLATE_LIBRARY}")
+    set(TIFF_DEFLATE_DEPENDS DEFLATE)
+    unset(INSTALL_DIR)
+else()
+    set(TIFF_DEFLATE_ARGS "-Dlibdeflate=OFF")
+    set(TIFF_DEFLATE_DEPENDS "")
+endif()
+
 ExternalProject_Add(TIFF
     PREFIX ${CMAKE_BINARY_DIR}/tiff
     URL "http://download.osgeo.org/libtiff/tiff-4.7.0.zip"
@@ -18,11 +34,11 @@ ExternalProject_Add(TIFF
     PATCH_COMMAND ""
     BUILD_COMMAND ${BUILD_COMMAND_FOR_TARGET} -t tiff
     INSTALL_COMMAND ""
-    CMAKE_ARGS ${CMAKE_BUILD_TYPE_ARG} "-DZLIB_ROOT:PATH=${ZLIB_ROOT}" "-Dzlib=ON" "-Dlibdeflate=OFF" "-Djpeg=OFF" "-Dold-jpeg=OFF" "-Djpeg12=OFF" "-Djbig=OFF" "-Dwebp=OFF"
+    CMAKE_ARGS ${CMAKE_BUILD_TYPE_ARG} "-DZLIB_ROOT:PATH=${ZLIB_ROOT}" "-Dzlib=ON" ${TIFF_DEFLATE_ARGS} "-Djpeg=OFF" "-Dold-jpeg=OFF" "-Djpeg12=OFF" "-Djbig=OFF" "-Dwebp=OFF"
         "-Dtiff-tools=OFF" "-Dtiff-tests=OFF" "-Dtiff-docs=OFF" "-Dtiff-install=OFF" "-Dwin32-io=OFF" "-Dcxx=OFF"
         "-DBUILD_SHARED_LIBS=OFF" "-DCMAKE_C_FLAGS:STRING=${ZERO_WARNINGS_FLAG} -fPIC"
     EXCLUDE_FROM_ALL
-    DEPENDS ZLIB
+    DEPENDS ZLIB ${TIFF_DEFLATE_DEPENDS}
 )
 
 ExternalProject_Get_Property(TIFF SOURCE_DIR)
@@ -32,8 +48,14 @@ add_library(LibTIFF INTERFACE)
 add_dependencies(LibTIFF TIFF)
 link_config_aware_library_path2(LibTIFF ${BINARY_DIR}/libtiff ${CMAKE_STATIC_LIBRARY_PREFIX}tiff${CMAKE_STATIC_LIBRARY_SUFFIX} ${CMAKE_STATIC_LIBRARY_PREFIX}tiffd${CMAKE_STATIC_LIBRARY_SUFFIX})
 target_include_directories(LibTIFF INTERFACE ${SOURCE_DIR}/libtiff ${BINARY_DIR}/libtiff)
+if (FREEIMAGE_WITH_LIBDEFLATE)
+    target_link_libraries(LibTIFF INTERFACE LibDeflate)
+endif()
 set_property(TARGET TIFF PROPERTY FOLDER "Dependencies")
 
 unset(SOURCE_DIR)
 unset(BINARY_DIR)
+unset(TIFF_DEFLATE_LIBRARY)
+unset(TIFF_DEFLATE_ARGS)
+unset(TIFF_DEFLATE_DEPENDS)
 
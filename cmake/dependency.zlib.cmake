@@ -1,11 +1,28 @@
 # ZLib dependency
 # https://github.com/madler/zlib
+# https://github.com/zlib-ng/zlib-ng (FREEIMAGE_WITH_ZLIBNG, built in zlib compatible mode)
 #
 # Output target: LibZLIB
 
 include(${CMAKE_SOURCE_DIR}/cmake/external_project_common.cmake)
 
 
+if (FREEIMAGE_WITH_ZLIBNG)
+ExternalProject_Add(ZLIB
+    PREFIX "${CMAKE_BINARY_DIR}/zlib"
+    URL "https://github.com/zlib-ng/zlib-ng/archive/refs/tags/2.2.4.zip"
+    DOWNLOAD_DIR "${CMAKE_SOURCE_DIR}/dependencies/zlib-ng"
+    DOWNLOAD_EXTRACT_TIMESTAMP TRUE
+    SOURCE_DIR "${EXTERNALPROJECT_SOURCE_PREFIX}/dependencies/zlib-ng/source"
+    BINARY_DIR "${CMAKE_BINARY_DIR}/zlib/build"
+    INSTALL_DIR "${CMAKE_BINARY_DIR}/zlib/install"
+    UPDATE_COMMAND ""
+    INSTALL_COMMAND ${BUILD_COMMAND_FOR_TARGET} -t install
+    CMAKE_ARGS ${CMAKE_BUILD_TYPE_RELEASE} "-DCMAKE_INSTALL_PREFIX:PATH=${CMAKE_BINARY_DIR}/zlib/install" "-DZLIB_COMPAT=ON" "-DBUILD_SHARED_LIBS=OFF"
+        "-DZLIB_ENABLE_TESTS=OFF" "-DZLIBNG_ENABLE_TESTS=OFF" "-DWITH_GTEST=OFF" "-DWITH_NATIVE_INSTRUCTIONS=OFF"
+        "-DCMAKE_C_FLAGS:STRING=${ZERO_WARNINGS_FLAG} -fPIC"
+)
+else()
 ExternalProject_Add(ZLIB
     PREFIX "${CMAKE_BINARY_DIR}/zlib"
     URL "https://github.com/madler/zlib/archive/refs/tags/v1.3.1.zip"
@@ -22,6 +39,7 @@ ExternalProject_Add(ZLIB
     CMAKE_ARGS ${CMAKE_BUILD_TYPE_RELEASE} "-DCMAKE_INSTALL_PREFIX:PATH=${CMAKE_BINARY_DIR}/zlib/install" "-DZLIB_BUILD_EXAMPLES=OFF"
         "-DCMAKE_C_FLAGS:STRING=${ZERO_WARNINGS_FLAG} -fPIC"
 )
+endif()
 
 # For configuring other dependencies
 ExternalProject_Get_Property(ZLIB INSTALL_DIR)